@@ -1,15 +1,148 @@
+// Framed mode, shared by both platforms.
+//
+// A client that sends the line "!framed" first talks in frames from then
+// on, instead of lines.  A frame is a 4-byte length and a 4-byte id, both
+// little-endian, then that many bytes of UTF-8, which may hold any bytes.
+// The client may send many requests before it reads:  each is posted at
+// once, and its response comes back in a frame with the same id, in
+// batches, as the commands finish.
+
+#include <atomic>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+void PostRequest(unsigned long id, const char *pIn, size_t len);
+bool ReceiveResponse(unsigned long &id, std::string &response, int msWait);
+
+static const char framedHello[] = "!framed";
+// Bigger requests are taken for garbage, and end the session
+static const unsigned long maxFrame = 16 * 1024 * 1024;
+
+static bool IsFramedHello(const char *line)
+{
+   const size_t len = sizeof(framedHello) - 1;
+   if (strncmp(line, framedHello, len) != 0)
+      return false;
+   return line[len] == '\0' || line[len] == '\r' || line[len] == '\n';
+}
+
+static void PutU32(char *p, unsigned long value)
+{
+   for (int ii = 0; ii < 4; ++ii)
+      p[ii] = static_cast<char>((value >> (8 * ii)) & 0xff);
+}
+
+static unsigned long GetU32(const unsigned char *p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned long)p[3] << 24);
+}
+
+// readBytes(p, n) reads exactly n bytes, or fails;
+// writeBytes(p, n) writes them all, or fails
+template<typename Read, typename Write>
+static void ServeFrames(Read readBytes, Write writeBytes)
+{
+   std::atomic<unsigned long> posted{ 0 };
+   std::atomic<bool> done{ false };
+
+   // Writes the responses while the requests are read
+   std::thread writer([&]{
+      unsigned long written = 0;
+      bool connected = true;
+      std::string batch, response;
+      unsigned long id;
+      for (;;) {
+         if (!ReceiveResponse(id, response, 100)) {
+            if (done && written == posted)
+               break;
+            continue;
+         }
+
+         // All the responses that are ready, in one write
+         batch.clear();
+         do {
+            char header[8];
+            PutU32(header, response.size());
+            PutU32(header + 4, id);
+            batch.append(header, sizeof header);
+            batch.append(response);
+            ++written;
+         } while (ReceiveResponse(id, response, 0));
+
+         // Once the client is gone, the rest are only counted
+         if (connected)
+            connected = writeBytes(batch.data(), batch.size());
+      }
+   });
+
+   std::vector<char> request;
+   for (;;) {
+      unsigned char header[8];
+      if (!readBytes(reinterpret_cast<char*>(header), sizeof header))
+         break;
+      const unsigned long len = GetU32(header), id = GetU32(header + 4);
+      if (len > maxFrame)
+         break;
+      request.resize(len);
+      if (len > 0 && !readBytes(request.data(), len))
+         break;
+      ++posted;
+      PostRequest(id, request.data(), len);
+   }
+
+   done = true;
+   writer.join();
+}
+
 #if defined(WIN32)
 
 #define WIN32_LEAN_AND_MEAN  // Exclude rarely-used stuff from Windows headers
 #include <windows.h>
 #include <stdio.h>
 #include <tchar.h>
+#include <algorithm>
 
 const int nBuff = 1024;
 
 extern "C" int DoSrv( char * pIn );
 extern "C" int DoSrvMore( char * pOut, int nMax );
 
+// Serve frames on the pipes, starting with what followed the hello in its
+// message
+static void ServeFramesOnPipes(HANDLE hPipeToSrv, HANDLE hPipeFromSrv,
+                               std::string pending)
+{
+   size_t used = 0;
+   auto readBytes = [&](char *p, size_t n) {
+      while (n > 0) {
+         if (used < pending.size()) {
+            const size_t count = std::min(n, pending.size() - used);
+            memcpy(p, pending.data() + used, count);
+            used += count, p += count, n -= count;
+            continue;
+         }
+         // A message bigger than the buffer comes in pieces
+         DWORD cbBytesRead;
+         BOOL bSuccess = ReadFile(hPipeToSrv, p, n < nBuff ? n : nBuff,
+                                  &cbBytesRead, NULL);
+         if ((!bSuccess && GetLastError() != ERROR_MORE_DATA) ||
+             cbBytesRead == 0)
+            return false;
+         p += cbBytesRead, n -= cbBytesRead;
+      }
+      return true;
+   };
+   auto writeBytes = [&](const char *p, size_t n) {
+      DWORD cbBytesWritten;
+      return WriteFile(hPipeFromSrv, p, n, &cbBytesWritten, NULL) &&
+         cbBytesWritten == n;
+   };
+   ServeFrames(readBytes, writeBytes);
+}
+
 void PipeServer()
 {
    HANDLE hPipeToSrv;
@@ -79,6 +212,17 @@ void PipeServer()
 
             printf( "Rxd %s\n", chRequest );
 
+            if( IsFramedHello( chRequest ) )
+            {
+               // The rest of the session is in frames
+               const char *pEnd = chRequest + cbBytesRead;
+               const char *pRest = strchr( chRequest, '\n' );
+               pRest = pRest ? pRest + 1 : pEnd;
+               ServeFramesOnPipes( hPipeToSrv, hPipeFromSrv,
+                                   std::string( pRest, pEnd ) );
+               break;
+            }
+
             DoSrv( chRequest );
             jj++;
             while( true )
@@ -172,6 +316,16 @@ void PipeServer()
          continue;
       }
 
+      if (IsFramedHello(buf))
+      {
+         // The rest of the session is in frames
+         ServeFrames(
+            [&](char *p, size_t n) { return fread(p, 1, n, toFifo) == n; },
+            [&](const char *p, size_t n) {
+               return fwrite(p, 1, n, fromFifo) == n && fflush(fromFifo) == 0; });
+         break;
+      }
+
       buf[len - 1] = '\0';
 
       printf("Server received %s\n", buf);
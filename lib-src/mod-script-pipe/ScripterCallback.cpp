@@ -14,6 +14,12 @@
 // security risk.  Use at your own risk.
 
 #include <wx/wx.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <utility>
 #include "ScripterCallback.h"
 //#include "../lib_widget_extra/ShuttleGuiBase.h"
 #include "../../src/Audacity.h"
@@ -62,6 +68,12 @@ extern void PipeServer();
 typedef SCRIPT_PIPE_DLL_IMPORT int (*tpExecScriptServerFunc)( wxString * pIn, wxString * pOut);
 static tpExecScriptServerFunc pScriptServerFn=NULL;
 
+// These must match the typedefs in ScriptCommandRelay.h
+typedef SCRIPT_PIPE_DLL_IMPORT int (*tpPostScriptServerFunc)( long id, wxString * pIn);
+typedef SCRIPT_PIPE_DLL_IMPORT int (*tpReceiveScriptServerFunc)( long * pId, wxString * pOut, int msWait);
+static tpPostScriptServerFunc pPostScriptServerFn=NULL;
+static tpReceiveScriptServerFunc pReceiveScriptServerFn=NULL;
+
 
 extern "C" {
 
@@ -105,6 +117,24 @@ int SCRIPT_PIPE_DLL_API RegScriptServerFunc( tpExecScriptServerFunc pFn )
    if( pFn )
    {
       pScriptServerFn = pFn;
+      pPostScriptServerFn = NULL;
+      pReceiveScriptServerFn = NULL;
+      PipeServer();
+   }
+
+   return 4;
+}
+
+// The same, for an application that can take pipelined requests:  many
+// in flight at once, each answered later with its id.
+int SCRIPT_PIPE_DLL_API RegPipelinedScriptServerFunc( tpExecScriptServerFunc pFn,
+   tpPostScriptServerFunc pPostFn, tpReceiveScriptServerFunc pReceiveFn )
+{
+   if( pFn && pPostFn && pReceiveFn )
+   {
+      pScriptServerFn = pFn;
+      pPostScriptServerFn = pPostFn;
+      pReceiveScriptServerFn = pReceiveFn;
       PipeServer();
    }
 
@@ -193,3 +223,53 @@ int DoSrvMore(char *pOut, size_t nMax)
 }
 
 } // End extern "C"
+
+// Requests in frames, from PipeServer.  If the application can't take
+// pipelined requests, each is done at once, and its response waits here.
+static std::mutex responsesMutex;
+static std::condition_variable responsesReady;
+static std::deque< std::pair<unsigned long, std::string> > responses;
+
+// Start the request; its response comes from ReceiveResponse()
+void PostRequest(unsigned long id, const char *pIn, size_t len)
+{
+   wxString request = wxString::FromUTF8(pIn, len);
+   if( pPostScriptServerFn )
+   {
+      (*pPostScriptServerFn)( static_cast<long>(id), &request );
+      return;
+   }
+
+   wxString response;
+   (*pScriptServerFn)( &request, &response );
+   const auto utf8 = response.utf8_str();
+   std::lock_guard<std::mutex> lock(responsesMutex);
+   responses.emplace_back(id, std::string(utf8.data(), utf8.length()));
+   responsesReady.notify_one();
+}
+
+// Get the response of one request, as UTF-8, waiting at most msWait
+// milliseconds.  False if none came.
+bool ReceiveResponse(unsigned long &id, std::string &response, int msWait)
+{
+   if( pReceiveScriptServerFn )
+   {
+      long longId;
+      wxString str;
+      if( !(*pReceiveScriptServerFn)( &longId, &str, msWait ) )
+         return false;
+      id = static_cast<unsigned long>(longId);
+      const auto utf8 = str.utf8_str();
+      response.assign(utf8.data(), utf8.length());
+      return true;
+   }
+
+   std::unique_lock<std::mutex> lock(responsesMutex);
+   if( !responsesReady.wait_for(lock, std::chrono::milliseconds(msWait),
+                                []{ return !responses.empty(); }) )
+      return false;
+   id = responses.front().first;
+   response = std::move(responses.front().second);
+   responses.pop_front();
+   return true;
+}
@@ -0,0 +1,240 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   AggregateCapture.cpp
+
+*******************************************************************//**
+
+\class AggregateCapture
+\brief Records the channels of a second input device into extra tracks.
+
+AudioIO::StartStream() opens one, when the recording has tracks for it,
+after its own stream has chosen the rate.  Each time FillBuffers() finds
+new frames from the main device, it asks Transfer() for as many frames of
+the second device, so the tracks stay the same length.
+
+The two devices run on their own clocks, which drift apart by some parts
+per million.  Transfer() watches how many frames of the second device
+are waiting.  When more pile up than the level it saw at the start, it
+resamples them slightly faster, and when fewer, slightly slower, within
+kMaxDrift.  So the main device is the master clock, and the second
+device follows it with a constant offset of about one buffer.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "AggregateCapture.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <wx/string.h>
+
+#include "Prefs.h"
+#include "Resample.h"
+#include "RingBuffer.h"
+
+// Most that the rates of the devices may differ, as a fraction
+static const double kMaxDrift = 0.002;
+
+// How strongly, and how smoothly, Transfer() corrects the rate
+static const double kGain = 0.01;
+static const double kSmoothing = 0.05;
+
+// Least waiting device input to keep, in seconds
+static const double kMinTargetSecs = 0.05;
+
+// Extra input frames to read, for the resampler's own delay
+static const size_t kSlack = 64;
+
+namespace {
+
+int FindPreferredDevice()
+{
+   const wxString name =
+      gPrefs->Read(wxT("/AudioIO/SecondRecordingDevice"), wxT(""));
+   if (name.empty())
+      return -1;
+
+   const wxString hostName = gPrefs->Read(wxT("/AudioIO/Host"), wxT(""));
+   const int nDevices = Pa_GetDeviceCount();
+   for (int ii = 0; ii < nDevices; ++ii) {
+      const PaDeviceInfo *info = Pa_GetDeviceInfo(ii);
+      if (!info || info->maxInputChannels <= 0)
+         continue;
+      const PaHostApiInfo *host = Pa_GetHostApiInfo(info->hostApi);
+      if (host && !hostName.empty() &&
+          wxString(wxSafeConvertMB2WX(host->name)) != hostName)
+         continue;
+      if (wxString(wxSafeConvertMB2WX(info->name)) == name)
+         return ii;
+   }
+   return -1;
+}
+
+}
+
+// static
+unsigned AggregateCapture::GetPreferredChannels()
+{
+   const int device = FindPreferredDevice();
+   if (device < 0)
+      return 0;
+
+   long channels = 2;
+   gPrefs->Read(wxT("/AudioIO/SecondRecordChannels"), &channels, 2L);
+   return (unsigned)std::max(0L, std::min(channels,
+      (long)Pa_GetDeviceInfo(device)->maxInputChannels));
+}
+
+// static
+std::unique_ptr<AggregateCapture> AggregateCapture::Open(
+   unsigned channels, double rate, double bufferSecs)
+{
+   const int device = FindPreferredDevice();
+   if (device < 0 || channels == 0)
+      return {};
+
+   PaStreamParameters parameters{};
+   parameters.device = device;
+   parameters.channelCount = channels;
+   parameters.sampleFormat = paFloat32;
+   parameters.suggestedLatency =
+      Pa_GetDeviceInfo(device)->defaultHighInputLatency;
+
+   std::unique_ptr<AggregateCapture> result{ safenew AggregateCapture(
+      channels, rate, (size_t)lrint(rate * bufferSecs)) };
+
+   PaStream *stream;
+   if (Pa_OpenStream(&stream, &parameters, NULL, rate,
+                     paFramesPerBufferUnspecified, paNoFlag,
+                     Callback, result.get()) != paNoError)
+      return {};
+
+   result->mStream = stream;
+   return result;
+}
+
+AggregateCapture::AggregateCapture(
+   unsigned channels, double rate, size_t bufferFrames)
+   : mNumChannels{ channels }
+   , mRate{ rate }
+   , mBuffers{ channels }
+   , mResample{ channels }
+   , mScratchSize{ bufferFrames }
+   , mIn{ bufferFrames }
+   , mOut{ bufferFrames }
+   , mPending{ channels }
+{
+   for (unsigned c = 0; c < channels; ++c) {
+      mBuffers[c] = std::make_unique<RingBuffer>(floatSample, bufferFrames);
+      mResample[c] =
+         std::make_unique<Resample>(false, 1.0 - kMaxDrift, 1.0 + kMaxDrift);
+   }
+}
+
+AggregateCapture::~AggregateCapture()
+{
+   Stop();
+   if (mStream)
+      Pa_CloseStream(mStream);
+}
+
+bool AggregateCapture::Start()
+{
+   return Pa_StartStream(mStream) == paNoError;
+}
+
+void AggregateCapture::Stop()
+{
+   if (mStream && Pa_IsStreamActive(mStream) == 1)
+      Pa_AbortStream(mStream);
+}
+
+int AggregateCapture::Callback(const void *inputBuffer, void *,
+                               unsigned long framesPerBuffer,
+                               const PaStreamCallbackTimeInfo *,
+                               PaStreamCallbackFlags, void *userData)
+{
+   auto &self = *static_cast<AggregateCapture *>(userData);
+   const auto input = static_cast<const float *>(inputBuffer);
+   if (!input)
+      return paContinue;
+
+   // Deinterleave straight into the ring buffers; drop what doesn't fit
+   const auto nChannels = self.mNumChannels;
+   for (unsigned c = 0; c < nChannels; ++c) {
+      auto &buffer = *self.mBuffers[c];
+      size_t done = 0;
+      while (done < framesPerBuffer) {
+         const auto region = buffer.GetWriteRegion();
+         const auto count = std::min<size_t>(framesPerBuffer - done, region.second);
+         if (!count)
+            break;
+         const auto dest = (float *)region.first;
+         for (size_t ii = 0; ii < count; ++ii)
+            dest[ii] = input[(done + ii) * nChannels + c];
+         buffer.CommitWrite(count);
+         done += count;
+      }
+   }
+
+   return paContinue;
+}
+
+void AggregateCapture::Transfer(
+   size_t frames, const std::unique_ptr<RingBuffer> *destinations)
+{
+   if (frames == 0)
+      return;
+
+   auto avail = mBuffers[0]->AvailForGet();
+   for (unsigned c = 1; c < mNumChannels; ++c)
+      avail = std::min(avail, mBuffers[c]->AvailForGet());
+
+   // What waits at the first transfer is the level to keep from now on
+   if (!mStarted) {
+      mTargetFill = std::max(avail, (size_t)(kMinTargetSecs * mRate));
+      mStarted = true;
+   }
+
+   // When input piles up, this device runs fast; produce fewer output
+   // frames for each input frame, and more when it runs slow
+   const double error =
+      ((double)avail - (double)mTargetFill) / std::max<size_t>(1, mTargetFill);
+   const double wanted =
+      std::max(1.0 - kMaxDrift, std::min(1.0 + kMaxDrift, 1.0 - kGain * error));
+   mFactor += kSmoothing * (wanted - mFactor);
+
+   // Read only what these frames need, so the cost stays bounded
+   const auto pending = mPending[0].size();
+   size_t toRead = 0;
+   if (pending < frames)
+      toRead = std::min({ avail, mScratchSize,
+         (size_t)ceil((frames - pending) / mFactor) + kSlack });
+
+   for (unsigned c = 0; c < mNumChannels; ++c) {
+      auto &out = mPending[c];
+      const auto got =
+         mBuffers[c]->Get((samplePtr)mIn.get(), floatSample, toRead);
+      size_t used = 0;
+      while (used < got) {
+         const auto results = mResample[c]->Process(mFactor,
+            mIn.get() + used, got - used, false, mOut.get(), mScratchSize);
+         if (results.first == 0 && results.second == 0)
+            break;
+         used += results.first;
+         out.insert(out.end(), mOut.get(), mOut.get() + results.second);
+      }
+
+      const auto count = std::min(frames, out.size());
+      destinations[c]->Put((samplePtr)out.data(), floatSample, count);
+      if (count < frames)
+         // This device fell behind; keep the tracks the same length
+         destinations[c]->Clear(frames - count);
+      out.erase(out.begin(), out.begin() + count);
+   }
+}
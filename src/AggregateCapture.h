@@ -0,0 +1,84 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   AggregateCapture.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_AGGREGATE_CAPTURE__
+#define __AUDACITY_AGGREGATE_CAPTURE__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+
+#include <vector>
+
+#include "portaudio.h"
+#include "SampleFormat.h"
+
+class RingBuffer;
+class Resample;
+
+/// Records from a second input device, together with the stream of
+/// AudioIO.  Its own PortAudio stream fills one RingBuffer per channel.
+/// The audio thread then resamples those into the capture buffers of the
+/// extra tracks, at a rate corrected for the drift between the clocks of
+/// the two devices, as many samples as the main device delivered.
+class AggregateCapture final {
+ public:
+   /// How many channels to record from the device of preference
+   /// "/AudioIO/SecondRecordingDevice", or zero if there is none
+   static unsigned GetPreferredChannels();
+
+   /// Opens the preferred device, at the rate of the main stream; null if
+   /// that fails
+   static std::unique_ptr<AggregateCapture> Open(
+      unsigned channels, double rate, double bufferSecs);
+
+   ~AggregateCapture();
+
+   AggregateCapture(const AggregateCapture&) PROHIBITED;
+   AggregateCapture &operator= (const AggregateCapture&) PROHIBITED;
+
+   bool Start();
+   void Stop();
+
+   unsigned GetNumChannels() const { return mNumChannels; }
+
+   /// Produces exactly this many frames for each channel, with silence if
+   /// the device has fallen behind, and puts them into the destinations.
+   /// Called by the audio thread only; costs about as much as resampling
+   /// that many frames.
+   void Transfer(size_t frames, const std::unique_ptr<RingBuffer> *destinations);
+
+ private:
+   AggregateCapture(unsigned channels, double rate, size_t bufferFrames);
+
+   static int Callback(const void *inputBuffer, void *outputBuffer,
+                       unsigned long framesPerBuffer,
+                       const PaStreamCallbackTimeInfo *timeInfo,
+                       PaStreamCallbackFlags statusFlags, void *userData);
+
+   PaStream *mStream { nullptr };
+   const unsigned mNumChannels;
+   const double mRate;
+
+   // Filled by the callback
+   ArrayOf<std::unique_ptr<RingBuffer>> mBuffers;
+
+   // The rest belongs to the audio thread
+   ArrayOf<std::unique_ptr<Resample>> mResample;
+   const size_t mScratchSize;
+   Floats mIn, mOut;
+   // Resampled but not yet transferred, per channel
+   ArrayOf<std::vector<float>> mPending;
+   // Device frames to keep waiting, so that jitter never starves Transfer()
+   size_t mTargetFill { 0 };
+   bool mStarted { false };
+   double mFactor { 1.0 };
+};
+
+#endif
@@ -31,6 +31,7 @@ It handles initialization and termination by subclassing wxApp.
 #include <wx/menu.h>
 #include <wx/snglinst.h>
 #include <wx/splash.h>
+#include <wx/stopwatch.h>
 #include <wx/stdpaths.h>
 #include <wx/sysopt.h>
 #include <wx/fontmap.h>
@@ -67,8 +68,10 @@ It handles initialization and termination by subclassing wxApp.
 #include "Internat.h"
 #include "LangChoice.h"
 #include "Languages.h"
+#include "MemoryPressure.h"
 #include "Prefs.h"
 #include "Project.h"
+#include "ProjectJournal.h"
 #include "Sequence.h"
 #include "WaveTrack.h"
 #include "prefs/PrefsDialog.h"
@@ -78,12 +81,14 @@ It handles initialization and termination by subclassing wxApp.
 #include "SplashDialog.h"
 #include "BlockFile.h"
 #include "ondemand/ODManager.h"
+#include "blockfile/BlockPrefetcher.h"
+#include "blockfile/BlockReaper.h"
 #include "commands/Keyboard.h"
 #include "widgets/ErrorDialog.h"
 #include "prefs/DirectoriesPrefs.h"
 
 //temporarilly commented out till it is added to all projects
-//#include "Profiler.h"
+#include "Profiler.h"
 
 #include "import/Import.h"
 
@@ -209,9 +214,10 @@ void QuitAudacity(bool bForce)
    //release ODManager Threads
    ODManager::Quit();
 
-   //print out profile if we have one by deleting it
-   //temporarilly commented out till it is added to all projects
-   //DELETE Profiler::Instance();
+   //and the read-ahead thread of playback
+   BlockPrefetcher::Quit();
+
+   //the profile is written when the Profiler is destroyed at exit
 
    //remove our logger
    std::unique_ptr<wxLog>{ wxLog::SetActiveTarget(NULL) }; // DELETE
@@ -229,7 +235,8 @@ void QuitAudacity()
 
 void SaveWindowSize()
 {
-   if (wxGetApp().GetWindowRectAlreadySaved())
+   // Hidden windows have no placement worth keeping
+   if (wxGetApp().GetWindowRectAlreadySaved() || wxGetApp().IsHeadless())
    {
       return;
    }
@@ -1013,6 +1020,32 @@ AudacityApp::~AudacityApp()
 
 // The `main program' equivalent, creating the windows and returning the
 // main frame
+namespace {
+
+// Logs how long each phase of startup takes
+class StartupPhases
+{
+public:
+   void Mark(const wxChar *phase)
+   {
+      const auto now = mWatch.Time();
+      mReport += wxString::Format(wxT(" %s %ld ms;"), phase, now - mLast);
+      mLast = now;
+   }
+
+   void Log()
+   {
+      wxLogMessage(wxT("Startup:%s total %ld ms"), mReport, mWatch.Time());
+   }
+
+private:
+   wxStopWatch mWatch;
+   long mLast { 0 };
+   wxString mReport;
+};
+
+}
+
 bool AudacityApp::OnInit()
 {
    // JKC: ANSWER-ME: Who actually added the event loop guarantor?
@@ -1028,12 +1061,20 @@ bool AudacityApp::OnInit()
    // Ensure we have an event loop during initialization
    wxEventLoopGuarantor eventLoop;
 
+   Profiler::Instance()->SetThreadName("Main");
+
    // wxWidgets will clean up the logger for the main thread, so we can say
    // safenew.  See:
    // http://docs.wxwidgets.org/3.0/classwx_log.html#a2525bf54fa3f31dc50e6e3cd8651e71d
    std::unique_ptr < wxLog >
       { wxLog::SetActiveTarget(safenew AudacityLogger) }; // DELETE old
 
+   StartupPhases phases;
+
+   // PortAudio scans devices while preferences, theme and temporary
+   // directory are set up
+   StartAudioIOInit();
+
    mLocale = NULL;
 
    m_aliasMissingWarningShouldShow = true;
@@ -1181,11 +1222,13 @@ bool AudacityApp::OnInit()
    // TODO - read the number of files to store in history from preferences
    mRecentFiles = std::make_unique<FileHistory>(ID_RECENT_LAST - ID_RECENT_FIRST + 1, ID_RECENT_CLEAR);
    mRecentFiles->Load(*gPrefs, wxT("RecentFiles"));
+   phases.Mark(wxT("preferences"));
 
    theTheme.EnsureInitialised();
 
    // AColor depends on theTheme.
    AColor::Init();
+   phases.Mark(wxT("theme"));
 
    // Init DirManager, which initializes the temp directory
    // If this fails, we must exit the program.
@@ -1199,6 +1242,8 @@ bool AudacityApp::OnInit()
    // If we're waiitng in a dialog before then we can very easily
    // start multiple instances, defeating the single instance checker.
 
+   phases.Mark(wxT("temporary directory"));
+
    // Initialize the CommandHandler
    InitCommandHandler();
 
@@ -1230,47 +1275,53 @@ bool AudacityApp::OnInit()
       Sequence::SetMaxDiskBlockSize(lval);
    }
 
-   // BG: Create a temporary window to set as the top window
-   wxImage logoimage((const char **)AudacityLogoWithName_xpm);
-   logoimage.Rescale(logoimage.GetWidth() / 2, logoimage.GetHeight() / 2);
-   wxBitmap logo(logoimage);
+   mHeadless = parser->Found(wxT("headless"));
 
    AudacityProject *project;
    {
-      // Bug 718: Position splash screen on same screen 
-      // as where Audacity project will appear.
-      wxRect wndRect;
-      bool bMaximized = false;
-      bool bIconized = false;
-      GetNextWindowPlacement(&wndRect, &bMaximized, &bIconized);
-
-      wxSplashScreen temporarywindow(
-         logo,
-         wxSPLASH_CENTRE_ON_SCREEN | wxSPLASH_NO_TIMEOUT,
-         0,
-         NULL,
-         wxID_ANY,
-         wndRect.GetTopLeft(),
-         wxDefaultSize,
-         wxSTAY_ON_TOP);
-      
-      // Unfortunately with the Windows 10 Creators update, the splash screen 
-      // now appears before setting its position.
-      // On a dual monitor screen it will appear on one screen and then 
-      // possibly jump to the second.
-      // We could fix this by writing outr own splash screen and using Hide() 
-      // until the splash scren was correctly positioned, then Show()
-
-      // Possibly move it on to the second screen...
-      temporarywindow.SetPosition( wndRect.GetTopLeft() );
-      // Centered on whichever screen it is on.
-      temporarywindow.Center();
-      temporarywindow.SetTitle(_("Audacity is starting up..."));
-      SetTopWindow(&temporarywindow);
-
-      // ANSWER-ME: Why is YieldFor needed at all?
-      //wxEventLoopBase::GetActive()->YieldFor(wxEVT_CATEGORY_UI|wxEVT_CATEGORY_USER_INPUT|wxEVT_CATEGORY_UNKNOWN);
-      wxEventLoopBase::GetActive()->YieldFor(wxEVT_CATEGORY_UI);
+      // No splash screen for a headless run
+      Maybe<wxSplashScreen> temporarywindow;
+      if (!mHeadless) {
+         // BG: Create a temporary window to set as the top window
+         wxImage logoimage((const char **)AudacityLogoWithName_xpm);
+         logoimage.Rescale(logoimage.GetWidth() / 2, logoimage.GetHeight() / 2);
+         wxBitmap logo(logoimage);
+
+         // Bug 718: Position splash screen on same screen 
+         // as where Audacity project will appear.
+         wxRect wndRect;
+         bool bMaximized = false;
+         bool bIconized = false;
+         GetNextWindowPlacement(&wndRect, &bMaximized, &bIconized);
+
+         temporarywindow.create(
+            logo,
+            wxSPLASH_CENTRE_ON_SCREEN | wxSPLASH_NO_TIMEOUT,
+            0,
+            nullptr,
+            wxID_ANY,
+            wndRect.GetTopLeft(),
+            wxDefaultSize,
+            wxSTAY_ON_TOP);
+
+         // Unfortunately with the Windows 10 Creators update, the splash screen 
+         // now appears before setting its position.
+         // On a dual monitor screen it will appear on one screen and then 
+         // possibly jump to the second.
+         // We could fix this by writing outr own splash screen and using Hide() 
+         // until the splash scren was correctly positioned, then Show()
+
+         // Possibly move it on to the second screen...
+         temporarywindow->SetPosition( wndRect.GetTopLeft() );
+         // Centered on whichever screen it is on.
+         temporarywindow->Center();
+         temporarywindow->SetTitle(_("Audacity is starting up..."));
+         SetTopWindow(temporarywindow.get());
+
+         // ANSWER-ME: Why is YieldFor needed at all?
+         //wxEventLoopBase::GetActive()->YieldFor(wxEVT_CATEGORY_UI|wxEVT_CATEGORY_USER_INPUT|wxEVT_CATEGORY_UNKNOWN);
+         wxEventLoopBase::GetActive()->YieldFor(wxEVT_CATEGORY_UI);
+      }
 
       //JKC: Would like to put module loading here.
 
@@ -1278,6 +1329,8 @@ bool AudacityApp::OnInit()
 
       InitDitherers();
       InitAudioIO();
+      phases.Mark(wxT("audio devices"));
+      MemoryPressure::Get().Start();
 
 #ifdef __WXMAC__
 
@@ -1308,7 +1361,8 @@ bool AudacityApp::OnInit()
       SetExitOnFrameDelete(false);
 
 #endif //__WXMAC__
-      temporarywindow.Show(false);
+      if (temporarywindow)
+         temporarywindow->Show(false);
    }
 
    // Workaround Bug 1377 - Crash after Audacity starts and low disk space warning appears
@@ -1322,6 +1376,7 @@ bool AudacityApp::OnInit()
    {
       project = CreateNewAudacityProject();
       mCmdHandler->SetProject(project);
+      phases.Mark(wxT("project window"));
 	  /*
       wxWindow * pWnd = MakeHijackPanel();
       if (pWnd)
@@ -1334,15 +1389,35 @@ bool AudacityApp::OnInit()
 	  */
    }
 
-   if( project->mShowSplashScreen ){
-      project->OnHelpWelcome(*project);
+   if (!mHeadless) {
+      if( project->mShowSplashScreen ){
+         project->OnHelpWelcome(*project);
+      }
+
+      // Offer back the audio of sessions that crashed.  A headless run
+      // leaves them for the next session that can ask.
+      ProjectJournal::RecoverOrphans(*project);
    }
 
-   #ifdef USE_FFMPEG
-   FFmpegStartup();
-   #endif
+   // Finish removing what the last session left marked at exit
+   DirManager::ResumeCleanup();
+
+   phases.Log();
+
+   // Probing for FFmpeg and registering importers wait until the window
+   // has had its first chance to draw.  Files named on the command line
+   // are opened from OnTimer(), later still.
+   CallAfter([]{
+      StartupPhases deferred;
+      #ifdef USE_FFMPEG
+      FFmpegStartup();
+      deferred.Mark(wxT("FFmpeg"));
+      #endif
 
-   Importer::Get().Initialize();
+      Importer::Get().Initialize();
+      deferred.Mark(wxT("importers"));
+      deferred.Log();
+   });
 
    gInited = true;
 
@@ -1718,6 +1793,9 @@ std::unique_ptr<wxCmdLineParser> AudacityApp::ParseCommandLine()
    parser->AddSwitch(wxT("h"), wxT("help"), _("this help message"),
                      wxCMD_LINE_OPTION_HELP);
 
+   /*i18n-hint: This runs Audacity with no windows shown, for scripts */
+   parser->AddLongSwitch(wxT("headless"), _("run scripted jobs with no window shown"));
+
    /*i18n-hint: This runs a set of automatic tests on Audacity itself */
    parser->AddSwitch(wxT("t"), wxT("test"), _("run self diagnostics"));
 
@@ -1850,6 +1928,7 @@ int AudacityApp::OnExit()
 
    mRecentFiles->Save(*gPrefs, wxT("RecentFiles"));
 
+   MemoryPressure::Get().Stop();
    FinishPreferences();
 
 #ifdef USE_FFMPEG
@@ -1858,6 +1937,11 @@ int AudacityApp::OnExit()
 
    DeinitAudioIO();
 
+   WaveClip::StopPrerendering();
+
+   // Removals in the temporary directory are left for the next start
+   DirManager::GetBlockReaper().Shutdown(DirManager::GetTempDir());
+
    if (mIPCServ)
    {
 #if defined(__UNIX__)
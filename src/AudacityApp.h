@@ -151,6 +151,10 @@ class AudacityApp final : public wxApp {
    bool GetWindowRectAlreadySaved()const {return mWindowRectAlreadySaved;}
    void SetWindowRectAlreadySaved(bool alreadySaved) {mWindowRectAlreadySaved = alreadySaved;}
 
+   /// Whether started with --headless, to run scripted jobs with no window
+   /// shown and no question asked
+   bool IsHeadless() const {return mHeadless;}
+
    AudacityLogger *GetLogger();
 
 #ifdef __WXMAC__
@@ -190,6 +194,7 @@ class AudacityApp final : public wxApp {
    std::unique_ptr<wxCmdLineParser> ParseCommandLine();
 
    bool mWindowRectAlreadySaved;
+   bool mHeadless { false };
 
 #if defined(__WXMSW__)
    std::unique_ptr<IPCServ> mIPCServ;
@@ -11,6 +11,13 @@
 
 Provides thread-safe logging based on the wxWidgets log facility.
 
+A message only goes into a bounded ring, which any thread may write
+without a lock and without waiting for the GUI.  The main thread takes
+the messages out in Flush(), which wxWidgets calls when idle, and
+updates the log window once for all of them.  When the ring is full,
+messages are dropped, and counted.  A message logged many times over is
+written once, with a count of its repeats.
+
 *//*******************************************************************/
 
 
@@ -19,6 +26,8 @@ Provides thread-safe logging based on the wxWidgets log facility.
 #include "FileNames.h"
 #include "ShuttleGui.h"
 
+#include <cstddef>
+
 #include <wx/filedlg.h>
 #include <wx/log.h>
 #include <wx/frame.h>
@@ -55,10 +64,22 @@ AudacityLogger::AudacityLogger()
 {
    mText = NULL;
    mUpdated = false;
+
+   for (size_t ii = 0; ii < kQueueSize; ++ii)
+      mQueue[ii].sequence.store(ii, std::memory_order_relaxed);
+   mQueueTail.store(0, std::memory_order_relaxed);
+   mQueueHead = 0;
+   mDropped.store(0, std::memory_order_relaxed);
+   mRepeats = 0;
 }
 
 void AudacityLogger::Flush()
 {
+   if (!wxIsMainThread())
+      return;
+
+   Drain();
+
    if (mUpdated && mFrame && mFrame->IsShown()) {
       mUpdated = false;
       mText->ChangeValue(mBuffer);
@@ -67,27 +88,84 @@ void AudacityLogger::Flush()
 
 void AudacityLogger::DoLogText(const wxString & str)
 {
-   if (!wxIsMainThread()) {
-      wxMutexGuiEnter();
+   // Claim a slot; sequence equals the position when the slot is free
+   // for it, and is one more once it holds a message
+   auto pos = mQueueTail.load(std::memory_order_relaxed);
+   Slot *slot;
+   while (true) {
+      slot = &mQueue[pos % kQueueSize];
+      const auto sequence = slot->sequence.load(std::memory_order_acquire);
+      if (sequence == pos) {
+         if (mQueueTail.compare_exchange_weak(
+               pos, pos + 1, std::memory_order_relaxed))
+            break;
+      }
+      else if ((std::ptrdiff_t)(sequence - pos) < 0) {
+         // Full; the main thread can make room, any other must not wait
+         if (wxIsMainThread()) {
+            Drain();
+            pos = mQueueTail.load(std::memory_order_relaxed);
+            if (mQueue[pos % kQueueSize].sequence.load(
+                   std::memory_order_acquire) == pos)
+               continue;
+         }
+         mDropped.fetch_add(1, std::memory_order_relaxed);
+         return;
+      }
+      else
+         pos = mQueueTail.load(std::memory_order_relaxed);
    }
 
-   if (mBuffer.IsEmpty()) {
-      wxString stamp;
-
-      TimeStamp(&stamp);
+   slot->text = str;
+   slot->sequence.store(pos + 1, std::memory_order_release);
+}
 
-      mBuffer << stamp << _TS("Audacity ") << AUDACITY_VERSION_STRING << wxT("\n");
-   }
+void AudacityLogger::Drain()
+{
+   const auto append = [this](const wxString &text) {
+      if (mBuffer.IsEmpty()) {
+         wxString stamp;
 
-   mBuffer << str << wxT("\n");
+         TimeStamp(&stamp);
 
-   mUpdated = true;
+         mBuffer << stamp << _TS("Audacity ") << AUDACITY_VERSION_STRING << wxT("\n");
+      }
 
-   Flush();
+      mBuffer << text << wxT("\n");
 
-   if (!wxIsMainThread()) {
-      wxMutexGuiLeave();
+      mUpdated = true;
+   };
+   const auto appendRepeats = [&] {
+      if (mRepeats > 0) {
+         append(wxString::Format(
+            wxT("Last message repeated %u times."), mRepeats));
+         mRepeats = 0;
+      }
+   };
+
+   while (true) {
+      auto &slot = mQueue[mQueueHead % kQueueSize];
+      if (slot.sequence.load(std::memory_order_acquire) != mQueueHead + 1)
+         break;
+      wxString text;
+      text.swap(slot.text);
+      slot.sequence.store(mQueueHead + kQueueSize, std::memory_order_release);
+      ++mQueueHead;
+
+      if (text == mLastText && !text.IsEmpty()) {
+         ++mRepeats;
+         continue;
+      }
+      appendRepeats();
+      append(text);
+      mLastText = text;
    }
+   appendRepeats();
+
+   const auto dropped = mDropped.exchange(0, std::memory_order_relaxed);
+   if (dropped > 0)
+      append(wxString::Format(
+         wxT("%u messages were dropped; too many at once."), dropped));
 }
 
 void AudacityLogger::Show(bool show)
@@ -100,6 +178,8 @@ void AudacityLogger::Show(bool show)
       return;
    }
 
+   Drain();
+
    // If the frame already exists, refresh its contents and show it
    if (mFrame) {
       if (!mFrame->IsShown()) {
@@ -216,12 +296,17 @@ void AudacityLogger::OnClose(wxCommandEvent & WXUNUSED(e))
 
 void AudacityLogger::OnClear(wxCommandEvent & WXUNUSED(e))
 {
+   Drain();
    mBuffer = wxEmptyString;
+   mLastText = wxEmptyString;
    DoLogText(wxT("Log Cleared."));
+   Flush();
 }
 
 void AudacityLogger::OnSave(wxCommandEvent & WXUNUSED(e))
 {
+   Flush();
+
    wxString fName = _("log.txt");
 
    fName = FileNames::SelectFile(FileNames::Operation::Export,
@@ -17,6 +17,7 @@
 #include "Audacity.h"
 
 #include "MemoryX.h"
+#include <atomic>
 #include <wx/event.h>
 #include <wx/log.h>
 #include <wx/frame.h>
@@ -41,10 +42,29 @@ class AudacityLogger final : public wxEvtHandler, public wxLog {
    void OnClear(wxCommandEvent & e);
    void OnSave(wxCommandEvent & e);
 
+   // Main thread only: move the queued messages into mBuffer
+   void Drain();
+
    Destroy_ptr<wxFrame> mFrame;
    wxTextCtrl *mText;
    wxString mBuffer;
    bool mUpdated;
+
+   // Messages not yet in mBuffer, in a bounded ring that any thread may
+   // write without a lock, and the main thread reads
+   struct Slot {
+      std::atomic<size_t> sequence;
+      wxString text;
+   };
+   static const size_t kQueueSize = 1024;
+   Slot mQueue[kQueueSize];
+   std::atomic<size_t> mQueueTail;
+   size_t mQueueHead;
+   std::atomic<unsigned> mDropped;
+
+   // For collapsing a message repeated many times
+   wxString mLastText;
+   unsigned mRepeats;
 };
 
 #endif
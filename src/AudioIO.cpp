@@ -400,12 +400,17 @@ AudioIOListener and whether the playback is looped.
 #include "Audacity.h"
 #include "Experimental.h"
 #include "AudioIO.h"
+#include "AggregateCapture.h"
+#include "DeviceManager.h"
 #include "float_cast.h"
 
 #include <cfloat>
+#include <chrono>
+#include <cstdint>
 #include <math.h>
 #include <stdlib.h>
 #include <algorithm>
+#include <set>
 
 #ifdef __WXMSW__
 #include <malloc.h>
@@ -426,10 +431,14 @@ AudioIOListener and whether the playback is looped.
 #include "AudacityApp.h"
 #include "AudacityException.h"
 #include "Mix.h"
+#include "MixerPool.h"
 #include "Resample.h"
 #include "RingBuffer.h"
 #include "prefs/GUISettings.h"
 #include "Prefs.h"
+#include "Profiler.h"
+#include "ThreadPriority.h"
+#include "blockfile/BlockIOStats.h"
 #include "Project.h"
 #include "WaveTrack.h"
 
@@ -572,6 +581,57 @@ class AudioThread /* not final */ : public wxThread {
 //
 //////////////////////////////////////////////////////////////////////
 
+namespace {
+
+// Pa_Initialize() scans every host API and its devices, which can take a
+// good part of a second
+class PaInitThread final : public wxThread
+{
+public:
+   PaInitThread() : wxThread{ wxTHREAD_JOINABLE } {}
+
+   PaError Finish()
+   {
+      Wait();
+      return mErr;
+   }
+
+protected:
+   ExitCode Entry() override
+   {
+      mErr = Pa_Initialize();
+      return 0;
+   }
+
+private:
+   PaError mErr { paNoError };
+};
+
+std::unique_ptr<PaInitThread> sPaInitThread;
+
+PaError InitPortAudio()
+{
+   if (sPaInitThread) {
+      const auto err = sPaInitThread->Finish();
+      sPaInitThread.reset();
+      return err;
+   }
+   return Pa_Initialize();
+}
+
+}
+
+void StartAudioIOInit()
+{
+#if !defined(__WXMSW__)
+   // Not on Windows, where host APIs initialize COM for the calling thread
+   // and keep objects made in its apartment
+   auto thread = std::make_unique<PaInitThread>();
+   if (thread->Run() == wxTHREAD_NO_ERROR)
+      sPaInitThread = std::move(thread);
+#endif
+}
+
 void InitAudioIO()
 {
    ugAudioIO.reset(safenew AudioIO());
@@ -631,6 +691,16 @@ bool AudioIO::ValidateDeviceNames(const wxString &play, const wxString &rec)
    return true;
 }
 
+// Threads besides the audio thread that run playback mixers, at most
+static const unsigned kMaxMixerHelpers = 7;
+
+// Fewer playback tracks than this are mixed in the audio thread alone
+static const size_t kMinTracksToShare = 4;
+
+// Most frames of captured input that the audio thread splits into channels
+// at a time
+static const size_t kCaptureBatchFrames = 8192;
+
 AudioIO::AudioIO()
 {
    mAudioThreadShouldCallFillBuffersOnce = false;
@@ -646,6 +716,7 @@ AudioIO::AudioIO()
    mNumCaptureChannels = 0;
    mPaused = false;
    mPlayMode = PLAY_STRAIGHT;
+   mPlaybackSpeed = 1.0;
 
    mListener = NULL;
    mUpdateMeters = false;
@@ -654,7 +725,7 @@ AudioIO::AudioIO()
    mOwningProject = NULL;
    mOutputMeter = NULL;
 
-   PaError err = Pa_Initialize();
+   PaError err = InitPortAudio();
 
    if (err != paNoError) {
       wxString errStr = _("Could not find any audio devices.\n");
@@ -676,6 +747,10 @@ AudioIO::AudioIO()
    mThread = std::make_unique<AudioThread>();
    mThread->Create();
 
+   // The audio thread mixes too, so it needs one helper fewer than the cores
+   mMixerPool = std::make_unique<MixerPool>(std::min(kMaxMixerHelpers,
+      (unsigned)std::max(1, wxThread::GetCPUCount()) - 1));
+
    mEmulateMixerOutputVol = true;
    mMixerOutputVol = 1.0;
    mInputMixerWorks = false;
@@ -696,6 +771,7 @@ AudioIO::~AudioIO()
 
    mThread->Delete();
    mThread.reset();
+   mMixerPool.reset();
 
    gAudioIO = nullptr;
 }
@@ -757,12 +833,26 @@ static PaSampleFormat AudacityToPortAudioSampleFormat(sampleFormat format)
    }
 }
 
+// FillBuffers() starts with pieces of this fraction of
+// mPlaybackSamplesToCopy
+static const size_t kFillPieces = 4;
+
+// Longest the audio thread waits without a wakeup, in milliseconds
+static const int kAudioThreadTimeout = 50;
+
+// Buffer sizes that low latency monitoring tries, smallest first
+static const unsigned long kMonitoringBufferFrames[] = { 32, 64, 128, 256 };
+
+// Frames of scratch for the callback, at the least
+static const size_t kMinCallbackFrames = 8192;
+
 bool AudioIO::StartPortAudioStream(double sampleRate,
                                    unsigned int numPlaybackChannels,
                                    unsigned int numCaptureChannels,
                                    sampleFormat captureFormat)
 {
    mOwningProject = GetActiveProject();
+   mTelemetry.Reset();
 
    // PRL:  Protection from crash reported by David Bailes, involving starting
    // and stopping with frequent changes of active window, hard to reproduce
@@ -800,8 +890,9 @@ bool AudioIO::StartPortAudioStream(double sampleRate,
    PaStreamParameters playbackParameters{};
    PaStreamParameters captureParameters{};
 
-   double latencyDuration = DEFAULT_LATENCY_DURATION;
-   gPrefs->Read(wxT("/AudioIO/LatencyDuration"), &latencyDuration);
+   double latencyDuration = PrefsSnapshot::Get().latencyDuration;
+   // The longest latency suggested to PortAudio, in seconds
+   double maxLatency = latencyDuration/1000.0;
 
    if( numPlaybackChannels > 0)
    {
@@ -822,11 +913,12 @@ bool AudioIO::StartPortAudioStream(double sampleRate,
       playbackParameters.hostApiSpecificStreamInfo = NULL;
       playbackParameters.channelCount = mNumPlaybackChannels;
 
-      if (mSoftwarePlaythrough)
+      if (mSoftwarePlaythrough || mLowLatencyMonitoring)
          playbackParameters.suggestedLatency =
             playbackDeviceInfo->defaultLowOutputLatency;
       else
          playbackParameters.suggestedLatency = latencyDuration/1000.0;
+      maxLatency = std::max(maxLatency, playbackParameters.suggestedLatency);
 
       mOutputMeter = mOwningProject->GetPlaybackMeter();
    }
@@ -852,11 +944,15 @@ bool AudioIO::StartPortAudioStream(double sampleRate,
       captureParameters.hostApiSpecificStreamInfo = NULL;
       captureParameters.channelCount = mNumCaptureChannels;
 
-      if (mSoftwarePlaythrough)
+      if (mLowLatencyMonitoring)
+         captureParameters.suggestedLatency =
+            captureDeviceInfo->defaultLowInputLatency;
+      else if (mSoftwarePlaythrough)
          captureParameters.suggestedLatency =
             captureDeviceInfo->defaultHighInputLatency;
       else
          captureParameters.suggestedLatency = latencyDuration/1000.0;
+      maxLatency = std::max(maxLatency, captureParameters.suggestedLatency);
 
       SetCaptureMeter( mOwningProject, mOwningProject->GetCaptureMeter() );
    }
@@ -868,12 +964,67 @@ bool AudioIO::StartPortAudioStream(double sampleRate,
    int  userData = 24;
    int* lpUserData = (captureFormat_saved == int24Sample) ? &userData : NULL;
 
-   mLastPaError = Pa_OpenStream( &mPortStreamV19,
-                                 useCapture ? &captureParameters : NULL,
-                                 usePlayback ? &playbackParameters : NULL,
-                                 mRate, paFramesPerBufferUnspecified,
-                                 paNoFlag,
-                                 audacityAudioCallback, lpUserData );
+   // The buffer size is unspecified, but PortAudio won't give the callback
+   // more than the latency; allow twice that.  Bigger buffers still work,
+   // with temporary space on the stack, as they always did.
+   {
+      const auto channels =
+         std::max(2u, std::max(mNumCaptureChannels, mNumPlaybackChannels));
+      mCallbackFrames = std::max<size_t>(kMinCallbackFrames,
+         (size_t)(2 * maxLatency * mRate));
+      mCallbackTemp.reinit(mCallbackFrames * channels);
+      mCallbackMeterTemp.reinit(mCallbackFrames * channels);
+      mCallbackChannelBufs.reinit(channels, mCallbackFrames);
+      mCallbackChannelPtrs.reinit(channels);
+      mCallbackChans.reinit(channels);
+      for (unsigned c = 0; c < channels; ++c)
+         mCallbackChannelPtrs[c] = mCallbackChannelBufs[c].get();
+   }
+   mSoundActivation.Reset(mRate, mNumCaptureChannels, mSilenceLevelDB);
+
+   // For low latency monitoring, ask for the smallest fixed buffer that the
+   // host accepts, then let PortAudio choose as usual
+   mRoundTripLatency = 0.0;
+   mLastPaError = paInvalidFlag;
+   if (mLowLatencyMonitoring && usePlayback && useCapture) {
+      for (auto frames : kMonitoringBufferFrames) {
+         mLastPaError = Pa_OpenStream( &mPortStreamV19,
+                                       &captureParameters,
+                                       &playbackParameters,
+                                       mRate, frames,
+                                       paNoFlag,
+                                       audacityAudioCallback, lpUserData );
+         if (mLastPaError == paNoError)
+            break;
+      }
+   }
+
+   if (mLastPaError != paNoError)
+      mLastPaError = Pa_OpenStream( &mPortStreamV19,
+                                    useCapture ? &captureParameters : NULL,
+                                    usePlayback ? &playbackParameters : NULL,
+                                    mRate, paFramesPerBufferUnspecified,
+                                    paNoFlag,
+                                    audacityAudioCallback, lpUserData );
+
+   mLatencyDeviceKey.clear();
+   if (mLastPaError == paNoError && usePlayback && useCapture) {
+      // The reported latencies include the buffers of the stream
+      const PaStreamInfo *info = Pa_GetStreamInfo(mPortStreamV19);
+      if (info)
+         mRoundTripLatency = info->inputLatency + info->outputLatency;
+
+      const PaDeviceInfo *captureInfo =
+         Pa_GetDeviceInfo(captureParameters.device);
+      const PaDeviceInfo *playbackInfo =
+         Pa_GetDeviceInfo(playbackParameters.device);
+      const PaHostApiInfo *hostInfo =
+         Pa_GetHostApiInfo(captureInfo->hostApi);
+      mLatencyDeviceKey = wxString::Format(wxT("%s: %s -> %s"),
+         hostInfo ? wxSafeConvertMB2WX(hostInfo->name) : wxString{},
+         wxSafeConvertMB2WX(captureInfo->name),
+         wxSafeConvertMB2WX(playbackInfo->name));
+   }
 
    return (mLastPaError == paNoError);
 }
@@ -884,11 +1035,12 @@ void AudioIO::StartMonitoring(double sampleRate)
       return;
 
    bool success;
-   long captureChannels;
-   sampleFormat captureFormat = (sampleFormat)
-      gPrefs->Read(wxT("/SamplingRate/DefaultProjectSampleFormat"), floatSample);
-   gPrefs->Read(wxT("/AudioIO/RecordChannels"), &captureChannels, 2L);
-   gPrefs->Read(wxT("/AudioIO/SWPlaythrough"), &mSoftwarePlaythrough, false);
+   const auto &prefs = PrefsSnapshot::Get();
+   long captureChannels = prefs.recordChannels;
+   sampleFormat captureFormat = (sampleFormat)prefs.defaultSampleFormat;
+   mSoftwarePlaythrough = prefs.softwarePlaythrough;
+   mLowLatencyMonitoring =
+      prefs.lowLatencyMonitoring && mSoftwarePlaythrough;
    int playbackChannels = 0;
 
    if (mSoftwarePlaythrough)
@@ -900,6 +1052,7 @@ void AudioIO::StartMonitoring(double sampleRate)
    success = StartPortAudioStream(sampleRate, (unsigned int)playbackChannels,
                                   (unsigned int)captureChannels,
                                   captureFormat);
+   mLowLatencyMonitoring = false;
    // TODO: Check return value of success.
    (void)success;
 
@@ -919,6 +1072,10 @@ void AudioIO::StartMonitoring(double sampleRate)
       // advertise the chosen I/O sample rate to the UI
       mListener->OnAudioIORate((int)mRate);
    }
+
+   if (mLastPaError == paNoError && mRoundTripLatency > 0 && mOwningProject)
+      mOwningProject->TP_DisplayStatusMessage(wxString::Format(
+         _("Monitoring latency: %.1f ms"), mRoundTripLatency * 1000.0));
 }
 
 int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
@@ -961,22 +1118,28 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
 #ifdef __WXGTK__
    // Detect whether ALSA is the chosen host, and do the various involved MIDI
    // timing compensations only then.
-   mUsingAlsa = (gPrefs->Read(wxT("/AudioIO/Host"), wxT("")) == "ALSA");
+   mUsingAlsa = (PrefsSnapshot::Get().audioHost == "ALSA");
 #endif
 
-   gPrefs->Read(wxT("/AudioIO/SWPlaythrough"), &mSoftwarePlaythrough, false);
-   gPrefs->Read(wxT("/AudioIO/SoundActivatedRecord"), &mPauseRec, false);
-   int silenceLevelDB;
-   gPrefs->Read(wxT("/AudioIO/SilenceLevel"), &silenceLevelDB, -50);
-   int dBRange;
-   dBRange = gPrefs->Read(ENV_DB_KEY, ENV_DB_RANGE);
-   if(silenceLevelDB < -dBRange)
+   const auto &prefs = PrefsSnapshot::Get();
+   mSoftwarePlaythrough = prefs.softwarePlaythrough;
+   mPauseRec = prefs.soundActivatedRecord;
+   mPauseRecPending = false;
+   mPremixPlayback = prefs.premixPlayback;
+   mRealTimeThreads = prefs.realTimeThreads;
+   mAudioThreadCPU = prefs.audioThreadCPU;
+   mLockBuffers = prefs.lockBuffers;
+   // The threads change their own scheduling, before they next fill buffers
+   mMixerPool->SetRealTime(mRealTimeThreads, kAudioThreadTimeout / 1000.0);
+   mThreadSchedulingStale = true;
+   mSilenceLevelDB = prefs.silenceLevelDB;
+   int dBRange = prefs.envDBRange;
+   if(mSilenceLevelDB < -dBRange)
    {
-      silenceLevelDB = -dBRange + 3;   // meter range was made smaller than SilenceLevel
+      mSilenceLevelDB = -dBRange + 3;   // meter range was made smaller than SilenceLevel
       gPrefs->Write(ENV_DB_KEY, dBRange); // so set SilenceLevel reasonable
       gPrefs->Flush();
    }
-   mSilenceLevel = (silenceLevelDB + dBRange)/(double)dBRange;  // meter goes -dBRange dB -> 0dB
 
    mListener = options.listener;
    mRate    = sampleRate;
@@ -987,6 +1150,9 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
    mLastRecordingOffset = 0;
    mCaptureTracks = captureTracks;
    mPlaybackTracks = playbackTracks;
+   mPunchTracks = options.punchTracks;
+   mPunchIn = options.punchIn;
+   mPunchOut = options.punchOut;
 
    bool commit = false;
    auto cleanupTracks = finally([&]{
@@ -994,16 +1160,20 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
          // Don't keep unnecessary shared pointers to tracks
          mPlaybackTracks.clear();
          mCaptureTracks.clear();
+         mPunchTracks.clear();
       }
    });
 
    mPlayMode = options.playLooped ? PLAY_LOOPED : PLAY_STRAIGHT;
    mCutPreviewGapStart = options.cutPreviewGapStart;
    mCutPreviewGapLen = options.cutPreviewGapLen;
+   mCutPreviewGapPassed = false;
 
    mPlaybackBuffers.reset();
+   mPremixBuffer.reset();
    mPlaybackMixers.reset();
    mCaptureBuffers.reset();
+   mCaptureDeviceBuffer.reset();
    mResample.reset();
 
    double playbackTime = 4.0;
@@ -1017,9 +1187,16 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
    // (ignoring accumulated rounding errors during playback) which fixes the 'missing sound at the end' bug
    mWarpedTime = 0.0;
 
+   // Recording keeps to the clock of the device, so varispeed is only for
+   // playback alone
+   mPlaybackSpeed = captureTracks.empty()
+      ? std::max(kMinPlaybackSpeed,
+                 std::min(kMaxPlaybackSpeed, options.playbackSpeed))
+      : 1.0;
+
 	mWarpedLength = mT1 - mT0;
 	// PRL allow backwards play
-	mWarpedLength = fabs(mWarpedLength);
+	mWarpedLength = fabs(mWarpedLength) / mPlaybackSpeed;
 
    //
    // The RingBuffer sizes, and the max amount of the buffer to
@@ -1037,12 +1214,18 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
    // thread, in many smaller pieces.
    wxASSERT( playbackTime >= 0 );
    mPlaybackSamplesToCopy = playbackTime * mRate;
+   // Start filling in smaller pieces; FillBuffers() makes them bigger if
+   // the callback empties the buffers faster than the audio thread keeps up
+   mPlaybackSamplesToFill =
+      std::max<size_t>(1, mPlaybackSamplesToCopy / kFillPieces);
 
    // Capacity of the playback buffer.
    mPlaybackRingBufferSecs = 10.0;
 
    mCaptureRingBufferSecs = 4.5 + 0.5 * std::min(size_t(16), mCaptureTracks.size());
    mMinCaptureSecsToCopy = 0.2 + 0.2 * std::min(size_t(16), mCaptureTracks.size());
+   mCheckpointSecs = prefs.checkpointSecs;
+   mSecsSinceCheckpoint = 0.0;
 
    unsigned int playbackChannels = 0;
    unsigned int captureChannels = 0;
@@ -1056,8 +1239,12 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
 
    if( captureTracks.size() > 0 )
    {
-      // For capture, every input channel gets its own track
+      // For capture, every input channel gets its own track; the last
+      // ones may come from a second device
       captureChannels = mCaptureTracks.size();
+      if (options.aggregateChannels > 0 &&
+          options.aggregateChannels < captureChannels)
+         captureChannels -= options.aggregateChannels;
       // I don't deal with the possibility of the capture tracks
       // having different sample formats, since it will never happen
       // with the current code.  This code wouldn't *break* if this
@@ -1089,6 +1276,28 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
       return 0;
    }
 
+   mAggregate.reset();
+   if (captureChannels > 0 && captureChannels < mCaptureTracks.size()) {
+      mAggregate = AggregateCapture::Open(
+         mCaptureTracks.size() - captureChannels, mRate,
+         mCaptureRingBufferSecs);
+      if (!mAggregate) {
+         if (mListener)
+            mListener->OnAudioIOStopRecording();
+         Pa_CloseStream(mPortStreamV19);
+         mPortStreamV19 = NULL;
+         mStreamToken = 0;
+         mPlayMode = PLAY_STRAIGHT;
+         return 0;
+      }
+   }
+
+   // Some hosts report no latency; then StopStream() uses what was
+   // measured last for these devices, if anything
+   if (!mLatencyDeviceKey.empty() && mRoundTripLatency > 0)
+      DeviceManager::Instance()->SetMeasuredLatency(
+         mLatencyDeviceKey, mRoundTripLatency);
+
    //
    // The (audio) stream has been opened successfully (assuming we tried
    // to open it). We now proceed to
@@ -1108,25 +1317,88 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
                (size_t)lrint(mRate * mPlaybackRingBufferSecs);
             auto playbackMixBufferSize =
                mPlaybackSamplesToCopy;
+            mPlaybackBufferFrames = playbackBufferSize;
+            mPlaybackBufferFill = 0.0f;
 
             mPlaybackBuffers.reinit(mPlaybackTracks.size());
             mPlaybackMixers.reinit(mPlaybackTracks.size());
+            if (mPremixPlayback && mPlaybackTracks.size() > 0)
+               mPremixBuffer = std::make_unique<RingBuffer>
+                  (floatSample, playbackBufferSize * mNumPlaybackChannels);
 
             for (unsigned int i = 0; i < mPlaybackTracks.size(); i++)
             {
-               mPlaybackBuffers[i] = std::make_unique<RingBuffer>(floatSample, playbackBufferSize);
+               if (!mPremixBuffer)
+                  mPlaybackBuffers[i] =
+                     std::make_unique<RingBuffer>(floatSample, playbackBufferSize);
 
                // MB: use normal time for the end time, not warped time!
+               // In cut preview the mixers read past the gap, out of the
+               // tracks themselves
                WaveTrackConstArray tracks;
                tracks.push_back(mPlaybackTracks[i]);
+               // A punched track is silent from the punch-in on
+               const auto punchEnd = mPunchTracks.end();
+               const bool punched = punchEnd != std::find(
+                  mPunchTracks.begin(), punchEnd, mPlaybackTracks[i]);
+               const double end = punched ? std::min(mT1, mPunchIn) : mT1;
                mPlaybackMixers[i] = std::make_unique<Mixer>
                   (tracks,
                   // Don't throw for read errors, just play silence:
                   false,
-                  mT0, mT1, 1,
+                  StreamToTrackTime(mT0), StreamToTrackTime(end), 1,
                   playbackMixBufferSize, false,
-                  mRate, floatSample, false);
+                  mRate, floatSample, false, nullptr,
+                  // Pan each track into the channels below instead
+                  false,
+                  mPlaybackSpeed, mPlaybackSpeed);
+            }
+
+            // The settings of the tracks are for the interface to change;
+            // the chains take them from here on through mRealtimeQueue
+            mRealtimeQueue.Drain([](int, const RealtimeSettings &){});
+            mTrackChains.assign(mPlaybackTracks.size(), RealtimeChain{});
+            for (size_t ii = 0; ii < mPlaybackTracks.size(); ++ii)
+               mTrackChains[ii].Prepare
+                  (mRate, mPlaybackTracks[ii]->GetRealtimeSettings());
+            mMasterChains.assign(mPremixBuffer
+               ? mNumPlaybackChannels : mPlaybackTracks.size(),
+               RealtimeChain{});
+            for (auto &chain : mMasterChains)
+               chain.Prepare(mRate, mMasterRealtime);
+            mRealtimeScratch.reserve(playbackMixBufferSize);
+
+            // Playback alone can seek
+            mSeekCaches.reset();
+            mSeekPrefetchTime = -1.0;
+            if (mCaptureTracks.empty() && mPlaybackTracks.size() > 0) {
+               mSeekShort = prefs.seekShortSecs;
+               mSeekLong = prefs.seekLongSecs;
+               mSeekCaches.reinit(mPlaybackTracks.size());
+               for (size_t ii = 0; ii < mPlaybackTracks.size(); ++ii)
+                  mSeekCaches[ii] =
+                     std::make_unique<WaveTrackCache>(mPlaybackTracks[ii]);
             }
+
+            // Allocate the loop cache here, not in the audio thread
+            mLoopCacheState = LoopCache::Off;
+            mLoopCacheMaxFrames = 0;
+            mLoopCachePos = 0;
+            mLoopCache.clear();
+            if (mPlayMode == PLAY_LOOPED && mPlaybackTracks.size() > 0) {
+               const double maxMB = prefs.loopCacheMaxMB;
+               // Room for the rounding of the last piece of a pass
+               const double frames = mWarpedLength * mRate + 16;
+               if (frames * mPlaybackTracks.size() * sizeof(float) <=
+                   maxMB * 1024 * 1024) {
+                  mLoopCacheMaxFrames = frames;
+                  mLoopCache.resize(mPlaybackTracks.size());
+                  for (auto &cache : mLoopCache)
+                     cache.reserve(mLoopCacheMaxFrames);
+               }
+            }
+
+            PreparePunchCache();
          }
 
          if( mNumCaptureChannels > 0 )
@@ -1154,6 +1426,14 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
                                                     captureBufferSize );
                mResample[i] = std::make_unique<Resample>(true, mFactor, mFactor); // constant rate resampling
             }
+
+            mCaptureDeviceBuffer = std::make_unique<RingBuffer>
+               (mCaptureFormat, captureBufferSize * mNumCaptureChannels);
+            mCaptureDeviceScratchFrames =
+               std::min<size_t>(captureBufferSize, kCaptureBatchFrames);
+            mCaptureDeviceScratch.Allocate(
+               mCaptureDeviceScratchFrames * mNumCaptureChannels,
+               mCaptureFormat);
          }
       }
       catch(std::bad_alloc&)
@@ -1163,6 +1443,8 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
          StartStreamCleanup(true);
          mPlaybackRingBufferSecs *= 0.5;
          mPlaybackSamplesToCopy /= 2;
+         mPlaybackSamplesToFill = std::max<size_t>(1,
+            std::min<size_t>(mPlaybackSamplesToFill, mPlaybackSamplesToCopy));
          mCaptureRingBufferSecs *= 0.5;
          mMinCaptureSecsToCopy *= 0.5;
          bDone = false;
@@ -1184,10 +1466,22 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
       // Calculate the NEW time position
       mTime = std::max(mT0, std::min(mT1, *options.pStartTime));
       // Reset mixer positions for all playback tracks
-      unsigned numMixers = mPlaybackTracks.size();
-      for (unsigned ii = 0; ii < numMixers; ++ii)
-         mPlaybackMixers[ii]->Reposition(mTime);
-      mWarpedTime = mTime - mT0;
+      RepositionMixers(mTime);
+      mWarpedTime = (mTime - mT0) / mPlaybackSpeed;
+   }
+
+   if (mLockBuffers) {
+      // Where the system refuses, the pages are paged as before
+      const auto lock = [](const std::unique_ptr<RingBuffer> &buffer) {
+         if (buffer)
+            buffer->LockInMemory();
+      };
+      lock(mPremixBuffer);
+      lock(mCaptureDeviceBuffer);
+      for (size_t ii = 0; mPlaybackBuffers && ii < mPlaybackTracks.size(); ++ii)
+         lock(mPlaybackBuffers[ii]);
+      for (size_t ii = 0; mCaptureBuffers && ii < mCaptureTracks.size(); ++ii)
+         lock(mCaptureBuffers[ii]);
    }
 
    // We signal the audio thread to call FillBuffers, to prime the RingBuffers
@@ -1195,9 +1489,11 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
    // audio thread call FillBuffers here makes the code more predictable, since
    // FillBuffers will ALWAYS get called from the Audio thread.
    mAudioThreadShouldCallFillBuffersOnce = true;
+   WakeAudioThread();
 
+   // Look often, so that the stream starts as soon as they are primed
    while( mAudioThreadShouldCallFillBuffersOnce == true ) {
-      wxMilliSleep( 50 );
+      wxMilliSleep( 1 );
    }
 
    if(mNumPlaybackChannels > 0 || mNumCaptureChannels > 0) {
@@ -1237,6 +1533,10 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
       // Now start the PortAudio stream!
       PaError err;
       err = Pa_StartStream( mPortStreamV19 );
+      if (err == paNoError && mAggregate && !mAggregate->Start()) {
+         Pa_AbortStream( mPortStreamV19 );
+         err = paDeviceUnavailable;
+      }
 
       if( err != paNoError )
       {
@@ -1279,15 +1579,73 @@ int AudioIO::StartStream(const WaveTrackConstArray &playbackTracks,
    return mStreamToken;
 }
 
+void AudioIO::PreparePunchCache()
+{
+   mPunchPos = 0;
+   mPunchFrames = 0;
+   mPunchReplay.assign(mPlaybackTracks.size(), nullptr);
+   mPunchKeep.assign(mPlaybackTracks.size(), nullptr);
+
+   const auto project = GetActiveProject();
+   if (mPunchTracks.empty() || mPlaybackTracks.empty() || !project ||
+       mCutPreviewGapLen > 0 || mPunchIn <= mT0)
+      return;
+
+   // Anything edited since, or another place, makes what was kept useless
+   auto &cache = mPunchCache;
+   const auto generation = project->GetTracks()->GetContentGeneration();
+   if (cache.generation != generation || cache.t0 != mT0 ||
+       cache.punchIn != mPunchIn || cache.rate != mRate) {
+      cache.kept.clear();
+      cache.generation = generation;
+      cache.t0 = mT0;
+      cache.punchIn = mPunchIn;
+      cache.rate = mRate;
+   }
+
+   const auto frames = (size_t)lrint((mPunchIn - mT0) * mRate);
+   const double maxMB = PrefsSnapshot::Get().loopCacheMaxMB;
+   if (frames == 0 ||
+       frames * mPlaybackTracks.size() * sizeof(float) > maxMB * 1024 * 1024) {
+      cache.kept.clear();
+      return;
+   }
+
+   mPunchFrames = frames;
+   for (size_t ii = 0; ii < mPlaybackTracks.size(); ++ii) {
+      auto &kept = cache.kept[mPlaybackTracks[ii].get()];
+      if (kept.size() == frames) {
+         mPunchReplay[ii] = &kept;
+         mPlaybackMixers[ii]->Reposition(mPunchIn);
+      }
+      else {
+         // Reserved here, not in the audio thread
+         kept.clear();
+         kept.reserve(frames);
+         mPunchKeep[ii] = &kept;
+      }
+   }
+}
+
 void AudioIO::StartStreamCleanup(bool bOnlyBuffers)
 {
    mPlaybackBuffers.reset();
+   mPremixBuffer.reset();
    mPlaybackMixers.reset();
+   mTrackChains.clear();
+   mMasterChains.clear();
+   mLoopCache.clear();
+   mPunchFrames = 0;
+   mPunchReplay.clear();
+   mPunchKeep.clear();
+   mSeekCaches.reset();
    mCaptureBuffers.reset();
+   mCaptureDeviceBuffer.reset();
    mResample.reset();
 
    if(!bOnlyBuffers)
    {
+      mAggregate.reset();
       Pa_AbortStream( mPortStreamV19 );
       Pa_CloseStream( mPortStreamV19 );
       mPortStreamV19 = NULL;
@@ -1395,6 +1753,8 @@ void AudioIO::StopStream()
       Pa_CloseStream( mPortStreamV19 );
       mPortStreamV19 = NULL;
    }
+   if (mAggregate)
+      mAggregate->Stop();
 
    if (mNumPlaybackChannels > 0)
    {
@@ -1412,6 +1772,9 @@ void AudioIO::StopStream()
       wxTheApp->ProcessEvent(e);
    }
 
+   const auto project = GetActiveProject();
+   bool keepPunchCache = false;
+
    // If there's no token, we were just monitoring, so we can
    // skip this next part...
    if (mStreamToken > 0) {
@@ -1421,6 +1784,7 @@ void AudioIO::StopStream()
       // call FillBuffers one last time (it normally would not do so since
       // Pa_GetStreamActive() would now return false
       mAudioThreadShouldCallFillBuffersOnce = true;
+      WakeAudioThread();
 
       while( mAudioThreadShouldCallFillBuffersOnce == true )
       {
@@ -1429,6 +1793,20 @@ void AudioIO::StopStream()
          wxMilliSleep( 50 );
       }
 
+      // Drop what the stream stopped before keeping whole; and keep the
+      // rest only if nothing was edited while recording
+      if (mPunchFrames > 0) {
+         auto &kept = mPunchCache.kept;
+         for (auto iter = kept.begin(); iter != kept.end();)
+            if (iter->second.size() == mPunchFrames)
+               ++iter;
+            else
+               iter = kept.erase(iter);
+         keepPunchCache = project &&
+            project->GetTracks()->GetContentGeneration() ==
+               mPunchCache.generation;
+      }
+
       //
       // Everything is taken care of.  Now, just free all the resources
       // we allocated in StartStream()
@@ -1437,7 +1815,14 @@ void AudioIO::StopStream()
       if (mPlaybackTracks.size() > 0)
       {
          mPlaybackBuffers.reset();
+         mPremixBuffer.reset();
          mPlaybackMixers.reset();
+         mTrackChains.clear();
+         mMasterChains.clear();
+         mLoopCacheState = LoopCache::Off;
+         mLoopCacheMaxFrames = 0;
+         mLoopCache.clear();
+         mSeekCaches.reset();
       }
 
       //
@@ -1446,7 +1831,9 @@ void AudioIO::StopStream()
       if (mCaptureTracks.size() > 0)
       {
          mCaptureBuffers.reset();
+         mCaptureDeviceBuffer.reset();
          mResample.reset();
+         mAggregate.reset();
 
          //
          // We only apply latency correction when we actually played back
@@ -1455,8 +1842,16 @@ void AudioIO::StopStream()
          // case that we do not apply latency correction when recording the
          // first track in a project.
          //
-         double latencyCorrection = DEFAULT_LATENCY_CORRECTION;
-         gPrefs->Read(wxT("/AudioIO/LatencyCorrection"), &latencyCorrection);
+         const auto &prefs = PrefsSnapshot::Get();
+         double latencyCorrection = prefs.latencyCorrection;
+
+         // Or shift by the measured latency of these devices, instead
+         const bool autoLatency = prefs.autoLatencyCorrection;
+         double measured;
+         if (autoLatency && !mLatencyDeviceKey.empty() &&
+             DeviceManager::Instance()->GetMeasuredLatency(
+                mLatencyDeviceKey, measured))
+            latencyCorrection = -1000.0 * measured;
 
          double recordingOffset =
             mLastRecordingOffset + latencyCorrection / 1000.0;
@@ -1515,7 +1910,8 @@ void AudioIO::StopStream()
                   {  // recording into a NEW track
                      // gives NOFAIL-GUARANTEE though we only need STRONG
                      track->SetOffset(track->GetStartTime() + recordingOffset);
-                     if(track->GetEndTime() < 0.)
+                     // A take of a punch-in is cut at the punch-in anyway
+                     if(track->GetEndTime() < 0. && mPunchTracks.empty())
                      {
                         // Bug 96: Only warn for the first track.
                         if( i==0 )
@@ -1532,6 +1928,20 @@ void AudioIO::StopStream()
                }
             } );
          }
+
+         // Punch-in: what each take recorded from the punch-in on, in
+         // place after the latency correction, replaces the same span of
+         // its punched track
+         for (size_t i = 0;
+              i < mPunchTracks.size() && i < mCaptureTracks.size(); i++)
+            GuardedCall( [&] {
+               const auto &take = mCaptureTracks[i];
+               const double end = std::min(mPunchOut, take->GetEndTime());
+               if (end > mPunchIn) {
+                  auto part = take->Copy(mPunchIn, end);
+                  mPunchTracks[i]->ClearAndPaste(mPunchIn, end, part.get());
+               }
+            } );
       }
    }
 
@@ -1548,16 +1958,29 @@ void AudioIO::StopStream()
    if (mListener && mNumCaptureChannels > 0)
       mListener->OnAudioIOStopRecording();
 
+   // Nothing else was edited while recording, and the punch changed the
+   // tracks only from the punch-in on, so the pre-roll kept holds for the
+   // generation pushed now
+   if (keepPunchCache)
+      mPunchCache.generation = project->GetTracks()->GetContentGeneration();
+   else if (mPunchFrames > 0)
+      mPunchCache.kept.clear();
+   mPunchFrames = 0;
+   mPunchReplay.clear();
+   mPunchKeep.clear();
+
    //
    // Only set token to 0 after we're totally finished with everything
    //
    mStreamToken = 0;
+   mPlaybackBufferFill = 1.0f;
 
    mNumCaptureChannels = 0;
    mNumPlaybackChannels = 0;
 
    mPlaybackTracks.clear();
    mCaptureTracks.clear();
+   mPunchTracks.clear();
 
    if (mListener) {
       // Tell UI to hide sample rate
@@ -1568,6 +1991,31 @@ void AudioIO::StopStream()
    mPlayMode = PLAY_STRAIGHT;
 }
 
+void AudioIO::SetRealtimeSettings(WaveTrack *track,
+                                  const RealtimeSettings &settings)
+{
+   int target = -1;
+   if (track) {
+      track->SetRealtimeSettings(settings);
+      const auto begin = mPlaybackTracks.begin();
+      const auto end = mPlaybackTracks.end();
+      const auto iter = std::find_if(begin, end,
+         [=](const std::shared_ptr<const WaveTrack> &playing) {
+            return playing.get() == track;
+         });
+      if (iter == end)
+         return;
+      target = (int)(iter - begin);
+   }
+   else
+      mMasterRealtime = settings;
+
+   // The audio thread drains the queue at each filling of the buffers, far
+   // more often than the interface could fill it
+   if (IsStreamActive())
+      mRealtimeQueue.Post(target, settings);
+}
+
 void AudioIO::SetPaused(bool state)
 {
    mPaused = state;
@@ -1645,6 +2093,27 @@ double AudioIO::NormalizeStreamTime(double absoluteTime) const
    return absoluteTime;
 }
 
+double AudioIO::StreamToTrackTime(double streamTime) const
+{
+   // Either way of play, the stream is the tracks with the gap taken out
+   if (mCutPreviewGapLen > 0 && streamTime > mCutPreviewGapStart)
+      return streamTime + mCutPreviewGapLen;
+   return streamTime;
+}
+
+void AudioIO::RepositionMixers(double streamTime)
+{
+   // Forwards, the mixers jump at the start of the gap, so a time there is
+   // still before it; backwards, they jump at its end, to that time
+   mCutPreviewGapPassed = mCutPreviewGapLen > 0 &&
+      (ReversedTime()
+         ? streamTime <= mCutPreviewGapStart
+         : streamTime > mCutPreviewGapStart);
+   const auto trackTime = StreamToTrackTime(streamTime);
+   for (size_t ii = 0; ii < mPlaybackTracks.size(); ++ii)
+      mPlaybackMixers[ii]->Reposition(trackTime);
+}
+
 double AudioIO::GetStreamTime()
 {
    if( !IsStreamActive() )
@@ -1654,6 +2123,125 @@ double AudioIO::GetStreamTime()
 }
 
 
+namespace {
+
+std::vector<long> ProbePlaybackRates(int devIndex, int irate);
+std::vector<long> ProbeCaptureRates(int devIndex, int irate);
+
+// The rates found for each device are kept in the preferences, so that
+// the next launch need not open test streams on every device before the
+// window appears.  The key names the host, the device, the direction and
+// the channels probed, and not the index, which PortAudio may change.
+wxString RateCacheKey(const PaDeviceInfo *info, bool isInput, long channels)
+{
+   const PaHostApiInfo *hostInfo = Pa_GetHostApiInfo(info->hostApi);
+   wxString name = wxString::Format(wxT("%s %s %s %ld"),
+      hostInfo ? wxSafeConvertMB2WX(hostInfo->name) : wxString{},
+      wxSafeConvertMB2WX(info->name),
+      isInput ? wxT("in") : wxT("out"),
+      channels);
+   name.Replace(wxT("/"), wxT("_"));
+   name.Replace(wxT("\\"), wxT("_"));
+   return wxT("/AudioIO/RateCache/") + name;
+}
+
+bool ReadRateCache(const wxString &key, std::vector<long> &rates)
+{
+   wxString value;
+   if (!gPrefs->Read(key, &value) || value.empty())
+      return false;
+
+   rates.clear();
+   for (const auto &item : wxSplit(value, wxT(','))) {
+      long rate;
+      if (!item.ToLong(&rate) || rate <= 0)
+         return false;
+      rates.push_back(rate);
+   }
+   return true;
+}
+
+void WriteRateCache(const wxString &key, const std::vector<long> &rates)
+{
+   // An empty list more likely means the device failed than that it
+   // plays nothing; probe it again next time
+   if (rates.empty())
+      return;
+
+   wxString value;
+   for (auto rate : rates) {
+      if (!value.empty())
+         value += wxT(',');
+      value << rate;
+   }
+   gPrefs->Write(key, value);
+   gPrefs->Flush();
+}
+
+// Keys served from the preferences, and probed again or about to be,
+// since the last scan of the devices
+std::set<wxString> sRefreshedRates;
+int sRateScan = 0;
+
+// Once the window is up, and at most once per device and scan, probe
+// again a device whose rates came from the preferences.  A changed list
+// is seen at the next use.
+void ScheduleRateRefresh(const wxString &key, int devIndex, bool isInput)
+{
+   if (!sRefreshedRates.insert(key).second)
+      return;
+
+   const auto scan = sRateScan;
+   wxTheApp->CallAfter([=]{
+      // Indices from before a rescan mean nothing now
+      if (scan != sRateScan)
+         return;
+
+      // Test streams would upset the one running; try at the next use
+      if (gAudioIO && gAudioIO->IsStreamActive()) {
+         sRefreshedRates.erase(key);
+         return;
+      }
+
+      const PaDeviceInfo *info = Pa_GetDeviceInfo(devIndex);
+      if (!info)
+         return;
+      long channels = 1;
+      if (isInput)
+         gPrefs->Read(wxT("/AudioIO/RecordChannels"), &channels);
+      if (RateCacheKey(info, isInput, channels) != key)
+         return;
+
+      std::vector<long> cached;
+      ReadRateCache(key, cached);
+      auto rates = isInput
+         ? ProbeCaptureRates(devIndex, 0)
+         : ProbePlaybackRates(devIndex, 0);
+      if (rates != cached) {
+         WriteRateCache(key, rates);
+         AudioIO::ForgetCachedRates();
+      }
+   });
+}
+
+}
+
+// static
+void AudioIO::ForgetCachedRates()
+{
+   mCachedPlaybackIndex = -1;
+   mCachedCaptureIndex = -1;
+   mCachedBestRateIn = 0.0;
+}
+
+// static
+void AudioIO::RescanCachedRates()
+{
+   ForgetCachedRates();
+   sRefreshedRates.clear();
+   ++sRateScan;
+}
+
 std::vector<long> AudioIO::GetSupportedPlaybackRates(int devIndex, double rate)
 {
    if (devIndex == -1)
@@ -1668,19 +2256,40 @@ std::vector<long> AudioIO::GetSupportedPlaybackRates(int devIndex, double rate)
       return mCachedPlaybackRates;
    }
 
-   std::vector<long> supported;
-   int irate = (int)rate;
-   const PaDeviceInfo* devInfo = NULL;
-   int i;
-
-   devInfo = Pa_GetDeviceInfo(devIndex);
+   const PaDeviceInfo* devInfo = Pa_GetDeviceInfo(devIndex);
 
    if (!devInfo)
    {
       wxLogDebug(wxT("GetSupportedPlaybackRates() Could not get device info!"));
+      return {};
+   }
+
+   const auto key = RateCacheKey(devInfo, false, 1);
+   std::vector<long> supported;
+   if (ReadRateCache(key, supported) &&
+       (rate == 0.0 || make_iterator_range(supported).contains(rate)))
+   {
+      ScheduleRateRefresh(key, devIndex, false);
       return supported;
    }
 
+   supported = ProbePlaybackRates(devIndex, (int)rate);
+   if (rate == 0.0)
+      WriteRateCache(key, supported);
+   return supported;
+}
+
+namespace {
+
+std::vector<long> ProbePlaybackRates(int devIndex, int irate)
+{
+   std::vector<long> supported;
+   const PaDeviceInfo* devInfo = Pa_GetDeviceInfo(devIndex);
+   int i;
+
+   if (!devInfo)
+      return supported;
+
    // LLL: Remove when a proper method of determining actual supported
    //      DirectSound rate is devised.
    const PaHostApiInfo* hostInfo = Pa_GetHostApiInfo(devInfo->hostApi);
@@ -1695,20 +2304,20 @@ std::vector<long> AudioIO::GetSupportedPlaybackRates(int devIndex, double rate)
    pars.hostApiSpecificStreamInfo = NULL;
 
    // JKC: PortAudio Errors handled OK here.  No need to report them
-   for (i = 0; i < NumRatesToTry; i++)
+   for (i = 0; i < AudioIO::NumRatesToTry; i++)
    {
       // LLL: Remove when a proper method of determining actual supported
       //      DirectSound rate is devised.
-      if (!(isDirectSound && RatesToTry[i] > 200000))
-      if (Pa_IsFormatSupported(NULL, &pars, RatesToTry[i]) == 0)
-         supported.push_back(RatesToTry[i]);
+      if (!(isDirectSound && AudioIO::RatesToTry[i] > 200000))
+      if (Pa_IsFormatSupported(NULL, &pars, AudioIO::RatesToTry[i]) == 0)
+         supported.push_back(AudioIO::RatesToTry[i]);
    }
 
    if (irate != 0 && !make_iterator_range(supported).contains(irate))
    {
       // LLL: Remove when a proper method of determining actual supported
       //      DirectSound rate is devised.
-      if (!(isDirectSound && RatesToTry[i] > 200000))
+      if (!(isDirectSound && AudioIO::RatesToTry[i] > 200000))
       if (Pa_IsFormatSupported(NULL, &pars, irate) == 0)
          supported.push_back(irate);
    }
@@ -1716,6 +2325,8 @@ std::vector<long> AudioIO::GetSupportedPlaybackRates(int devIndex, double rate)
    return supported;
 }
 
+}
+
 std::vector<long> AudioIO::GetSupportedCaptureRates(int devIndex, double rate)
 {
    if (devIndex == -1)
@@ -1730,19 +2341,43 @@ std::vector<long> AudioIO::GetSupportedCaptureRates(int devIndex, double rate)
       return mCachedCaptureRates;
    }
 
-   std::vector<long> supported;
-   int irate = (int)rate;
-   const PaDeviceInfo* devInfo = NULL;
-   int i;
-
-   devInfo = Pa_GetDeviceInfo(devIndex);
+   const PaDeviceInfo* devInfo = Pa_GetDeviceInfo(devIndex);
 
    if (!devInfo)
    {
       wxLogDebug(wxT("GetSupportedCaptureRates() Could not get device info!"));
+      return {};
+   }
+
+   long recordChannels = 1;
+   gPrefs->Read(wxT("/AudioIO/RecordChannels"), &recordChannels);
+
+   const auto key = RateCacheKey(devInfo, true, recordChannels);
+   std::vector<long> supported;
+   if (ReadRateCache(key, supported) &&
+       (rate == 0.0 || make_iterator_range(supported).contains(rate)))
+   {
+      ScheduleRateRefresh(key, devIndex, true);
       return supported;
    }
 
+   supported = ProbeCaptureRates(devIndex, (int)rate);
+   if (rate == 0.0)
+      WriteRateCache(key, supported);
+   return supported;
+}
+
+namespace {
+
+std::vector<long> ProbeCaptureRates(int devIndex, int irate)
+{
+   std::vector<long> supported;
+   const PaDeviceInfo* devInfo = Pa_GetDeviceInfo(devIndex);
+   int i;
+
+   if (!devInfo)
+      return supported;
+
    double latencyDuration = DEFAULT_LATENCY_DURATION;
    long recordChannels = 1;
    gPrefs->Read(wxT("/AudioIO/LatencyDuration"), &latencyDuration);
@@ -1761,20 +2396,20 @@ std::vector<long> AudioIO::GetSupportedCaptureRates(int devIndex, double rate)
    pars.suggestedLatency = latencyDuration / 1000.0;
    pars.hostApiSpecificStreamInfo = NULL;
 
-   for (i = 0; i < NumRatesToTry; i++)
+   for (i = 0; i < AudioIO::NumRatesToTry; i++)
    {
       // LLL: Remove when a proper method of determining actual supported
       //      DirectSound rate is devised.
-      if (!(isDirectSound && RatesToTry[i] > 200000))
-      if (Pa_IsFormatSupported(&pars, NULL, RatesToTry[i]) == 0)
-         supported.push_back(RatesToTry[i]);
+      if (!(isDirectSound && AudioIO::RatesToTry[i] > 200000))
+      if (Pa_IsFormatSupported(&pars, NULL, AudioIO::RatesToTry[i]) == 0)
+         supported.push_back(AudioIO::RatesToTry[i]);
    }
 
    if (irate != 0 && !make_iterator_range(supported).contains(irate))
    {
       // LLL: Remove when a proper method of determining actual supported
       //      DirectSound rate is devised.
-      if (!(isDirectSound && RatesToTry[i] > 200000))
+      if (!(isDirectSound && AudioIO::RatesToTry[i] > 200000))
       if (Pa_IsFormatSupported(&pars, NULL, irate) == 0)
          supported.push_back(irate);
    }
@@ -1782,6 +2417,8 @@ std::vector<long> AudioIO::GetSupportedCaptureRates(int devIndex, double rate)
    return supported;
 }
 
+}
+
 std::vector<long> AudioIO::GetSupportedSampleRates(int playDevice, int recDevice, double rate)
 {
    // Not given device indices, look up prefs
@@ -1930,8 +2567,13 @@ finished:
 
 AudioThread::ExitCode AudioThread::Entry()
 {
+   Profiler::Instance()->SetThreadName("AudioThread");
+
    while( !TestDestroy() )
    {
+      if (gAudioIO->mThreadSchedulingStale.exchange(false))
+         gAudioIO->ApplyThreadScheduling();
+
       // Set LoopActive outside the tests to avoid race condition
       gAudioIO->mAudioThreadFillBuffersLoopActive = true;
       if( gAudioIO->mAudioThreadShouldCallFillBuffersOnce )
@@ -1942,17 +2584,152 @@ AudioThread::ExitCode AudioThread::Entry()
       else if( gAudioIO->mAudioThreadFillBuffersLoopRunning )
       {
          gAudioIO->FillBuffers();
+         gAudioIO->PrefetchSeekTargets();
       }
       gAudioIO->mAudioThreadFillBuffersLoopActive = false;
 
-      Sleep(10);
+      gAudioIO->CheckSoundActivatedRecording();
+
+      // Sleep until the callback finds the buffers low, or the timeout
+      gAudioIO->mAudioThreadWakeup.WaitTimeout(kAudioThreadTimeout);
+      gAudioIO->mAudioThreadWakeupPending = false;
    }
 
    return 0;
 }
 
+void AudioIO::ApplyThreadScheduling()
+{
+   // In the audio thread.  Refusals leave the thread as it was; real-time
+   // scheduling on Linux needs the limits to allow it, as for JACK.
+   const bool realTime =
+      SetThreadRealTime(mRealTimeThreads, kAudioThreadTimeout / 1000.0);
+   const bool pinned = PinThreadToCPU(mAudioThreadCPU);
+   if (mRealTimeThreads && !realTime)
+      wxLogDebug(wxT("Audio thread: real-time scheduling refused"));
+   if (!pinned)
+      wxLogDebug(wxT("Audio thread: processor %d refused"), mAudioThreadCPU);
+}
+
+void AudioIO::PrefetchSeekTargets()
+{
+   if (!mSeekCaches)
+      return;
+
+   // Ask again only when the playhead has moved a good part of a short seek
+   const double time = mTime;
+   if (mSeekPrefetchTime >= 0 &&
+       std::abs(time - mSeekPrefetchTime) < std::min(0.25, mSeekShort / 4))
+      return;
+   mSeekPrefetchTime = time;
+
+   // After a seek, the mixers read from the target forwards, or backwards
+   // in reverse play, a piece or two at first
+   const bool backwards = mT1 < mT0;
+   const size_t len = std::min(mPlaybackSamplesToCopy,
+      2 * mPlaybackSamplesToFill.load(std::memory_order_relaxed));
+   const double steps[] = { mSeekShort, -mSeekShort, mSeekLong, -mSeekLong };
+   for (size_t ii = 0; ii < mPlaybackTracks.size(); ++ii) {
+      const auto &track = mPlaybackTracks[ii];
+      const double rate = track->GetRate();
+      // Track samples for the playback samples, at this speed
+      const auto trackLen = (size_t)(len * mPlaybackSpeed * rate / mRate) + 1;
+      std::vector<sampleCount> starts;
+      for (auto step : steps) {
+         const double target = LimitStreamTime(time + step);
+         if (target == time)
+            continue;
+         auto start =
+            sampleCount(floor(StreamToTrackTime(target) * rate + 0.5));
+         if (backwards)
+            start -= trackLen;
+         starts.push_back(start);
+      }
+      mSeekCaches[ii]->Prefetch(starts, trackLen);
+   }
+}
+
+void AudioIO::WakeAudioThread()
+{
+   // Post once per wait, so that wakeups don't pile up in the semaphore
+   if (!mAudioThreadWakeupPending.exchange(true))
+      mAudioThreadWakeup.Post();
+}
+
+void AudioIO::WakeAudioThreadIfLow()
+{
+   if (mAudioThreadWakeupPending.load(std::memory_order_relaxed))
+      return;
+
+   // The buffers fill and drain together, so the first one tells
+   bool low = false;
+   if (mPlaybackTracks.size() > 0) {
+      const auto room = mPremixBuffer
+         ? mPremixBuffer->AvailForPut() / mNumPlaybackChannels
+         : mPlaybackBuffers[0]->AvailForPut();
+      low = room >= mPlaybackSamplesToFill.load(std::memory_order_relaxed);
+   }
+   if (!low && mCaptureTracks.size() > 0)
+      low = mCaptureDeviceBuffer->AvailForGet() / mNumCaptureChannels >=
+         mMinCaptureSecsToCopy * mRate;
+
+   if (low)
+      WakeAudioThread();
+}
+
+void AudioIO::RecordBufferLevels()
+{
+   if (mPlaybackTracks.size() > 0)
+      mTelemetry.RecordPlayback(mPremixBuffer
+         ? mPremixBuffer->AvailForGet() / mNumPlaybackChannels
+         : mPlaybackBuffers[0]->AvailForGet());
+   if (mCaptureTracks.size() > 0)
+      mTelemetry.RecordCaptureRoom(
+         mCaptureDeviceBuffer->AvailForPut() / mNumCaptureChannels);
+}
+
+void AudioIO::CheckSoundActivatedRecording()
+{
+   if (!mPauseRec || !mStreamToken || mNumCaptureChannels == 0 ||
+       !mOwningProject)
+      return;
+
+   const bool paused = IsPaused();
+
+   // ControlToolBar::Pause() toggles, so ask again only after the last
+   // request took effect
+   if (mPauseRecPending) {
+      if (paused == mPauseRecPendingFrom)
+         return;
+      mPauseRecPending = false;
+   }
+
+   // The callback already paused or resumed at the exact buffer, by
+   // mSoundActivation; show that on the toolbar
+   //
+   // LL:  We'd gotten a little "dangerous" with the control toolbar calls
+   //      here because we are not running in the main GUI thread.  Eventually
+   //      the toolbar attempts to update the active project's status bar.
+   //      But, since we're not in the main thread, we can get all manner of
+   //      really weird failures.  Or none at all which is even worse, since
+   //      we don't know a problem exists.
+   //
+   //      By using CallAfter(), we can schedule the call to the toolbar
+   //      to run in the main GUI thread after the next event loop iteration.
+   const bool silent = !mSoundActivation.IsActive();
+   if (silent != paused) {
+      ControlToolBar *bar = mOwningProject->GetControlToolBar();
+      bar->CallAfter(&ControlToolBar::Pause);
+      mPauseRecPending = true;
+      mPauseRecPendingFrom = paused;
+   }
+}
+
 size_t AudioIO::GetCommonlyAvailPlayback()
 {
+   if (mPremixBuffer)
+      return mPremixBuffer->AvailForPut() / mNumPlaybackChannels;
+
    auto commonlyAvail = mPlaybackBuffers[0]->AvailForPut();
    for (unsigned i = 1; i < mPlaybackTracks.size(); ++i)
       commonlyAvail = std::min(commonlyAvail,
@@ -1969,6 +2746,44 @@ size_t AudioIO::GetCommonlyAvailCapture()
    return commonlyAvail;
 }
 
+void AudioIO::DrainCaptureDevice()
+{
+   const auto channels = mNumCaptureChannels;
+   auto frames = mCaptureDeviceBuffer->AvailForGet() / channels;
+   for (unsigned t = 0; t < channels; ++t)
+      frames = std::min(frames, mCaptureBuffers[t]->AvailForPut());
+
+   const auto sampleSize = SAMPLE_SIZE(mCaptureFormat);
+   while (frames > 0) {
+      const auto batch = std::min(frames, mCaptureDeviceScratchFrames);
+      const auto got = mCaptureDeviceBuffer->Get(
+         mCaptureDeviceScratch.ptr(), mCaptureFormat, batch * channels);
+      // wxASSERT(got == batch * channels);
+      wxUnusedVar(got);
+
+      // Take each channel out of the frames and convert it in one pass,
+      // straight into its ring buffer
+      for (unsigned t = 0; t < channels; ++t) {
+         auto &buffer = *mCaptureBuffers[t];
+         const auto format = mCaptureTracks[t]->GetSampleFormat();
+         auto src = mCaptureDeviceScratch.ptr() + t * sampleSize;
+         auto left = batch;
+         while (left > 0) {
+            const auto region = buffer.GetWriteRegion();
+            const auto block = std::min(left, region.second);
+            if (!block)
+               break;
+            CopySamples(src, mCaptureFormat, region.first, format, block,
+                        true, channels);
+            buffer.CommitWrite(block);
+            src += block * channels * sampleSize;
+            left -= block;
+         }
+      }
+      frames -= batch;
+   }
+}
+
 int AudioIO::getPlayDevIndex(const wxString &devNameArg)
 {
    wxString devName(devNameArg);
@@ -2092,7 +2907,8 @@ wxString AudioIO::GetDeviceInfo()
    wxString e(wxT("\n"));
 
    if (IsStreamActive()) {
-      return wxT("Stream is active ... unable to gather information.");
+      return wxString(wxT("Stream is active ... unable to gather information.\n"))
+         + GetTelemetryInfo();
    }
 
 
@@ -2188,17 +3004,310 @@ wxString AudioIO::GetDeviceInfo()
       }
    }else{
       s << wxT("Cannot check mutual sample rates without both devices.") << e;
+      return o.GetString() + GetTelemetryInfo();
+   }
+
+   return o.GetString() + GetTelemetryInfo();
+}
+
+wxString AudioIO::GetTelemetryInfo() const
+{
+   wxStringOutputStream o;
+   wxTextOutputStream s(o, wxEOL_UNIX);
+   wxString e(wxT("\n"));
+   const auto &t = mTelemetry;
+
+   s << wxT("==============================") << e;
+   s << wxT("Last stream") << e;
+   s << wxT("Callbacks: ") << (wxULongLong)t.callbacks.load() << e;
+   if (t.callbacks.load() == 0)
       return o.GetString();
+
+   s << wxT("Callback time, as a share of the buffer duration:") << e;
+   for (int ii = 0; ii < AudioIOTelemetry::nLoadBuckets; ++ii) {
+      if (ii + 1 < AudioIOTelemetry::nLoadBuckets)
+         s << wxString::Format(wxT("    %3d%% - %3d%%: "), 10 * ii, 10 * (ii + 1));
+      else
+         s << wxT("    over 100%: ");
+      s << (wxULongLong)t.loadHistogram[ii].load() << e;
    }
+   s << wxString::Format(wxT("Longest: %.1f%%"), 100.0 * t.maxLoad.load()) << e;
+
+   s << wxT("Input underflows: ") << (wxULongLong)t.inputUnderflows.load() << e;
+   s << wxT("Input overflows: ") << (wxULongLong)t.inputOverflows.load() << e;
+   s << wxT("Output underflows: ") << (wxULongLong)t.outputUnderflows.load() << e;
+   s << wxT("Output overflows: ") << (wxULongLong)t.outputOverflows.load() << e;
+
+   if (t.minPlaybackFrames.load() != SIZE_MAX)
+      s << wxT("Least playback buffered: ")
+        << (wxULongLong)t.minPlaybackFrames.load() << wxT(" frames") << e;
+   if (t.minCaptureRoom.load() != SIZE_MAX)
+      s << wxT("Least capture buffer room: ")
+        << (wxULongLong)t.minCaptureRoom.load() << wxT(" frames") << e;
+
+   const auto latency = [&](const wxChar *name, const LatencyHistogram &h) {
+      const auto count = h.count.load();
+      if (count == 0)
+         return;
+      s << wxString::Format(wxT("%s: %lu, mean %.3f ms, longest %.3f ms"),
+         name, count, h.totalNanoseconds.load() / 1e6 / count,
+         h.maxNanoseconds.load() / 1e6) << e;
+      for (int ii = 0; ii < LatencyHistogram::nBuckets; ++ii) {
+         const auto n = h.buckets[ii].load();
+         if (n == 0)
+            continue;
+         if (ii + 1 < LatencyHistogram::nBuckets)
+            s << wxString::Format(wxT("    %9.4f - %9.4f ms: "),
+               1e3 * LatencyHistogram::BucketSeconds(ii),
+               1e3 * LatencyHistogram::BucketSeconds(ii + 1));
+         else
+            s << wxString::Format(wxT("    over %9.4f ms: "),
+               1e3 * LatencyHistogram::BucketSeconds(ii));
+         s << (wxULongLong)n << e;
+      }
+   };
+   s << wxT("Latency, by stage:") << e;
+   latency(wxT("Input device to callback"), t.inputDevice);
+   latency(wxT("Waiting in capture buffers"), t.captureWait.waits);
+   latency(wxT("Appending to tracks"), t.captureAppend);
+   latency(wxT("Mixing into playback buffers"), t.playbackMix);
+   latency(wxT("Waiting in playback buffers"), t.playbackWait.waits);
+   latency(wxT("Callback to output device"), t.outputDevice);
 
    return o.GetString();
 }
 
+void AudioIOTelemetry::Reset()
+{
+   callbacks = 0;
+   for (auto &bucket : loadHistogram)
+      bucket = 0;
+   maxLoad = 0.0;
+   inputUnderflows = 0;
+   inputOverflows = 0;
+   outputUnderflows = 0;
+   outputOverflows = 0;
+   minPlaybackFrames = SIZE_MAX;
+   minCaptureRoom = SIZE_MAX;
+   inputDevice.Reset();
+   captureWait.Reset();
+   captureAppend.Reset();
+   playbackMix.Reset();
+   playbackWait.Reset();
+   outputDevice.Reset();
+}
+
+void SoundActivationDetector::Reset(
+   double rate, unsigned channels, double silenceLevelDB)
+{
+   mChannels = channels;
+   mWindowFrames = std::max<size_t>(1, (size_t)(rate * 0.010));
+   mHoldFrames = (size_t)(rate * 0.5);
+   // Powers, to compare with mean squares
+   mOnPower = DB_TO_LINEAR(2 * silenceLevelDB);
+   mOffPower = DB_TO_LINEAR(2 * (silenceLevelDB - 4));
+
+   mWindowSum = 0;
+   mWindowFilled = 0;
+   mHoldLeft = 0;
+   mActive.store(false, std::memory_order_relaxed);
+
+   mPreRollFrames = channels > 0 ? (size_t)(rate * 0.1) : 0;
+   mPreRoll.reinit(mPreRollFrames * channels);
+   mPreRollStart = 0;
+   mPreRollFilled = 0;
+}
+
+bool SoundActivationDetector::Process(const float *samples, size_t frames)
+{
+   bool active = IsActive();
+   for (size_t ii = 0; ii < frames; ++ii) {
+      for (unsigned c = 0; c < mChannels; ++c) {
+         const float sample = *samples++;
+         mWindowSum += sample * sample;
+      }
+      if (++mWindowFilled < mWindowFrames)
+         continue;
+
+      const double power = mWindowSum / (mWindowFrames * mChannels);
+      if (power >= mOnPower || (active && power >= mOffPower)) {
+         active = true;
+         mHoldLeft = mHoldFrames;
+      }
+      else if (active) {
+         // Quieter than the hysteresis allows; stop after the hold
+         if (mHoldLeft > mWindowFrames)
+            mHoldLeft -= mWindowFrames;
+         else
+            active = false;
+      }
+      mWindowSum = 0;
+      mWindowFilled = 0;
+   }
+   mActive.store(active, std::memory_order_relaxed);
+   return active;
+}
+
+void SoundActivationDetector::KeepPreRoll(const float *samples, size_t frames)
+{
+   if (mPreRollFrames == 0)
+      return;
+   // Only the last of many frames matter
+   if (frames > mPreRollFrames) {
+      samples += (frames - mPreRollFrames) * mChannels;
+      frames = mPreRollFrames;
+   }
+   auto end = (mPreRollStart + mPreRollFilled) % mPreRollFrames;
+   while (frames > 0) {
+      const auto block = std::min(frames, mPreRollFrames - end);
+      std::copy(samples, samples + block * mChannels,
+                mPreRoll.get() + end * mChannels);
+      samples += block * mChannels;
+      frames -= block;
+      end = (end + block) % mPreRollFrames;
+      if (mPreRollFilled + block > mPreRollFrames)
+         mPreRollStart = end;
+      mPreRollFilled = std::min(mPreRollFrames, mPreRollFilled + block);
+   }
+}
+
+void SoundActivationDetector::PutPreRoll(RingBuffer &buffer)
+{
+   if (mChannels == 0)
+      return;
+   const auto frames =
+      std::min(mPreRollFilled, buffer.AvailForPut() / mChannels);
+   // If there is no room for all, the latest matter most
+   const auto first =
+      (mPreRollStart + (mPreRollFilled - frames)) % mPreRollFrames;
+
+   // In at most two runs, the second after the wrap around
+   const auto firstRun = std::min(frames, mPreRollFrames - first);
+   buffer.Put((samplePtr)(mPreRoll.get() + first * mChannels),
+              floatSample, firstRun * mChannels);
+   buffer.Put((samplePtr)mPreRoll.get(),
+              floatSample, (frames - firstRun) * mChannels);
+   mPreRollStart = 0;
+   mPreRollFilled = 0;
+}
+
+// Only the callback writes, so plain loads and stores suffice: no other
+// thread ever changes these while a stream runs
+
+void AudioIOTelemetry::RecordCallback(double seconds, double bufferSeconds)
+{
+   const double load = bufferSeconds > 0 ? seconds / bufferSeconds : 0;
+   const auto bucket = std::min<int>(nLoadBuckets - 1, (int)(load * 10));
+   loadHistogram[bucket].store(
+      loadHistogram[bucket].load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+   callbacks.store(callbacks.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+   if (load > maxLoad.load(std::memory_order_relaxed))
+      maxLoad.store(load, std::memory_order_relaxed);
+}
+
+void AudioIOTelemetry::RecordFlags(unsigned long statusFlags)
+{
+   const auto count = [](std::atomic<unsigned long> &counter) {
+      counter.store(counter.load(std::memory_order_relaxed) + 1,
+         std::memory_order_relaxed);
+   };
+   if (statusFlags & paInputUnderflow)
+      count(inputUnderflows);
+   if (statusFlags & paInputOverflow)
+      count(inputOverflows);
+   if (statusFlags & paOutputUnderflow)
+      count(outputUnderflows);
+   if (statusFlags & paOutputOverflow)
+      count(outputOverflows);
+}
+
+void AudioIOTelemetry::RecordPlayback(size_t frames)
+{
+   if (frames < minPlaybackFrames.load(std::memory_order_relaxed))
+      minPlaybackFrames.store(frames, std::memory_order_relaxed);
+}
+
+void AudioIOTelemetry::RecordCaptureRoom(size_t frames)
+{
+   if (frames < minCaptureRoom.load(std::memory_order_relaxed))
+      minCaptureRoom.store(frames, std::memory_order_relaxed);
+}
+
+void LatencyHistogram::Reset()
+{
+   count = 0;
+   for (auto &bucket : buckets)
+      bucket = 0;
+   totalNanoseconds = 0;
+   maxNanoseconds = 0;
+}
+
+// As for the telemetry, only one thread writes each histogram
+
+void LatencyHistogram::Record(long long nanoseconds)
+{
+   nanoseconds = std::max(0LL, nanoseconds);
+   int bucket = 0;
+   for (auto q = nanoseconds / 62500; q > 0 && bucket + 1 < nBuckets; q >>= 1)
+      ++bucket;
+   buckets[bucket].store(
+      buckets[bucket].load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+   count.store(count.load(std::memory_order_relaxed) + 1,
+      std::memory_order_relaxed);
+   totalNanoseconds.store(
+      totalNanoseconds.load(std::memory_order_relaxed) + nanoseconds,
+      std::memory_order_relaxed);
+   if (nanoseconds > maxNanoseconds.load(std::memory_order_relaxed))
+      maxNanoseconds.store(nanoseconds, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::BucketSeconds(int bucket)
+{
+   return bucket == 0 ? 0.0 : 62.5e-6 * (1 << (bucket - 1));
+}
+
+void LatencyProbe::Reset()
+{
+   waits.Reset();
+   mHead = 0;
+   mTail = 0;
+   mPut = 0;
+   mTaken = 0;
+}
+
+void LatencyProbe::Mark(size_t frames, long long time)
+{
+   mPut += frames;
+   const auto head = mHead.load(std::memory_order_relaxed);
+   if (head - mTail.load(std::memory_order_acquire) >= nEntries)
+      return;
+   mEntries[head % nEntries] = { mPut, time };
+   mHead.store(head + 1, std::memory_order_release);
+}
+
+void LatencyProbe::Take(size_t frames, long long time, bool record)
+{
+   mTaken += frames;
+   auto tail = mTail.load(std::memory_order_relaxed);
+   const auto head = mHead.load(std::memory_order_acquire);
+   // Each mark is passed when the last frame it counts is taken
+   for (; tail != head && mEntries[tail % nEntries].frames <= mTaken; ++tail)
+      if (record)
+         waits.Record(time - mEntries[tail % nEntries].time);
+   mTail.store(tail, std::memory_order_release);
+}
+
 // This method is the data gateway between the audio thread (which
 // communicates with the disk) and the PortAudio callback thread
 // (which communicates with the audio device).
 void AudioIO::FillBuffers()
 {
+   PROFILE_SCOPE("AudioIO::FillBuffers");
+   BlockIOStats::Scope ioScope{ BlockIOStats::Playback };
+
    unsigned int i;
 
    auto delayedHandler = [this] ( AudacityException * pException ) {
@@ -2222,6 +3331,12 @@ void AudioIO::FillBuffers()
 
    if (mPlaybackTracks.size() > 0)
    {
+      // An edit while the loop was being kept makes what was kept so far
+      // useless
+      if (mLoopCacheState == LoopCache::Recording &&
+          mLoopCacheStale.load(std::memory_order_relaxed))
+         mLoopCacheState = LoopCache::Off;
+
       // Though extremely unlikely, it is possible that some buffers
       // will have more samples available than others.  This could happen
       // if we hit this code during the PortAudio callback.  To keep
@@ -2229,24 +3344,47 @@ void AudioIO::FillBuffers()
       // ALL buffers, and advance the global time by that much.
       // MB: subtract a few samples because the code below has rounding errors
       auto nAvailable = (int)GetCommonlyAvailPlayback() - 10;
+      mPlaybackBufferFill.store(mPlaybackBufferFrames > 0
+         ? 1.0f - std::max(0, nAvailable) / (float)mPlaybackBufferFrames
+         : 1.0f, std::memory_order_relaxed);
+
+      const bool atEnd = mPlayMode == PLAY_STRAIGHT &&
+         nAvailable > 0 &&
+         mWarpedTime+(nAvailable/mRate) >= mWarpedLength;
+
+      // If less than one piece was left for the callback when we got
+      // here, the audio thread is late; fill in bigger pieces from now on
+      auto toFill = mPlaybackSamplesToFill.load(std::memory_order_relaxed);
+      if (!mAudioThreadShouldCallFillBuffersOnce && !atEnd &&
+          nAvailable > 0 &&
+          mPlaybackBufferFrames - nAvailable < toFill &&
+          toFill < mPlaybackSamplesToCopy) {
+         toFill = std::min(mPlaybackSamplesToCopy, 2 * toFill);
+         mPlaybackSamplesToFill = toFill;
+      }
 
       //
-      // Don't fill the buffers at all unless we can do the
-      // full mMaxPlaybackSecsToCopy.  This improves performance
+      // Don't fill the buffers at all unless we can do a full
+      // piece of mPlaybackSamplesToFill.  This improves performance
       // by not always trying to process tiny chunks, eating the
       // CPU unnecessarily.
       //
-      // The exception is if we're at the end of the selected
-      // region - then we should just fill the buffer.
+      // The exceptions are priming the buffers, and the end of the
+      // selected region - then we should just fill the buffer.
       //
-      if (nAvailable >= (int)mPlaybackSamplesToCopy ||
-          (mPlayMode == PLAY_STRAIGHT &&
-           nAvailable > 0 &&
-           mWarpedTime+(nAvailable/mRate) >= mWarpedLength))
+      if (nAvailable >= (int)toFill ||
+          (mAudioThreadShouldCallFillBuffersOnce && nAvailable > 0) ||
+          atEnd)
       {
          // Limit maximum buffer size (increases performance)
          auto available =
             std::min<size_t>( nAvailable, mPlaybackSamplesToCopy );
+         if (mSeekPriming) {
+            // The callback waits for this after a seek; the loop fills the
+            // rest soon after
+            available = std::min<size_t>(available, toFill);
+            mSeekPriming = false;
+         }
 
          // msmeyer: When playing a very short selection in looped
          // mode, the selection must be copied to the buffer multiple
@@ -2254,13 +3392,72 @@ void AudioIO::FillBuffers()
          // This is the purpose of this loop.
          // PRL: or, when scrubbing, we may get work repeatedly from the
          // scrub queue.
+         // What the user changed since the last time
+         mRealtimeQueue.Drain([this](int target,
+                                     const RealtimeSettings &settings) {
+            if (target < 0)
+               for (auto &chain : mMasterChains)
+                  chain.SetSettings(settings);
+            else if ((size_t)target < mTrackChains.size())
+               mTrackChains[target].SetSettings(settings);
+         });
+
          bool done = false;
          Maybe<wxMutexLocker> cleanup;
          do {
+            // Keep the loop from the start of a pass of it
+            if (mLoopCacheState == LoopCache::Off && mLoopCacheMaxFrames > 0 &&
+                mWarpedTime == 0.0) {
+               mLoopCacheStale.store(false, std::memory_order_relaxed);
+               for (auto &cache : mLoopCache)
+                  cache.clear();
+               mLoopCacheState = LoopCache::Recording;
+            }
+            const bool replaying = mLoopCacheState == LoopCache::Ready;
+
             // How many samples to produce for each channel.
             auto frames = available;
             bool progress = true;
+            // Whether frames stop short at the cut preview gap, or at the
+            // end of the pre-roll of a punch-in
+            bool atGap = false;
+            bool atPunch = false;
+            if (replaying) {
+               const auto length = mLoopCache[0].size();
+               frames = std::min(available, length - mLoopCachePos);
+               mLoopCachePos += frames;
+               mWarpedTime = (mLoopCachePos == length)
+                  ? mWarpedLength
+                  : mLoopCachePos / mRate;
+            }
+            else
             {
+               // In cut preview, mix up to the gap, then move the mixers
+               // over it
+               if (mCutPreviewGapLen > 0 && !mCutPreviewGapPassed) {
+                  const double toGap = (std::abs(mCutPreviewGapStart - mT0) /
+                     mPlaybackSpeed - mWarpedTime) * mRate;
+                  if (toGap < 0.5) {
+                     mCutPreviewGapPassed = true;
+                     const double trackTime = ReversedTime()
+                        ? mCutPreviewGapStart
+                        : mCutPreviewGapStart + mCutPreviewGapLen;
+                     for (i = 0; i < mPlaybackTracks.size(); i++)
+                        mPlaybackMixers[i]->Reposition(trackTime);
+                  }
+                  else if (toGap < frames) {
+                     frames = (size_t)(toGap + 0.5);
+                     atGap = true;
+                  }
+               }
+
+               // Kept pre-roll and mixing meet between pieces
+               if (mPunchPos < mPunchFrames &&
+                   mPunchFrames - mPunchPos < frames) {
+                  frames = mPunchFrames - mPunchPos;
+                  atPunch = true;
+               }
+
                double deltat = frames / mRate;
                if (mWarpedTime + deltat > mWarpedLength)
                {
@@ -2278,29 +3475,137 @@ void AudioIO::FillBuffers()
 
             if (!progress)
                frames = available;
-
-            for (i = 0; i < mPlaybackTracks.size(); i++)
+            const bool inPreRoll = !replaying && mPunchPos < mPunchFrames;
+
+            const auto mixStart = Profiler::Now();
+            // Frames mixed for the device channels, zeroes where no track
+            // contributes
+            size_t premixed = 0;
+            // Frames put for the longest track, as the callback will take
+            size_t mostPut = 0;
+            if (mPremixBuffer)
+               mPremixScratch.assign(frames * mNumPlaybackChannels, 0.0f);
+
+            // The mixers of the tracks are independent, so with many
+            // tracks they run on several threads; the ring buffers are then
+            // filled here, in track order
+            const auto numTracks = mPlaybackTracks.size();
+            mPlaybackProcessed.assign(numTracks, 0);
+            //don't do anything if we have no length.  In particular, Process() will fail an wxAssert
+            //that causes a crash since this is not the GUI thread and wxASSERT is a GUI call.
+            const bool silent = false;
+            if (replaying)
+               // The kept loop has the silence in it already
+               mPlaybackProcessed.assign(numTracks, frames);
+            else if (progress && !silent && frames > 0)
             {
                // The mixer here isn't actually mixing: it's just doing
                // resampling, format conversion, and possibly time track
                // warping
-               decltype(mPlaybackMixers[i]->Process(frames))
-                  processed = 0;
+               const auto process = [&](size_t t) {
+                  mPlaybackProcessed[t] = (inPreRoll && mPunchReplay[t])
+                     // Put from what was kept, below
+                     ? frames
+                     : mPlaybackMixers[t]->Process(frames);
+               };
+               if (numTracks >= kMinTracksToShare)
+                  mMixerPool->Run(numTracks, process);
+               else
+                  for (size_t t = 0; t < numTracks; ++t)
+                     process(t);
+            }
+
+            if (mLoopCacheState == LoopCache::Recording && progress) {
+               if (mLoopCache[0].size() + frames > mLoopCacheMaxFrames) {
+                  // Longer than expected; don't grow it in this thread,
+                  // nor try again
+                  mLoopCacheState = LoopCache::Off;
+                  mLoopCacheMaxFrames = 0;
+               }
+               else for (i = 0; i < numTracks; i++) {
+                  auto &cache = mLoopCache[i];
+                  const auto processed =
+                     (!silent && frames > 0) ? mPlaybackProcessed[i] : 0;
+                  const auto src = (const float *)
+                     (processed > 0 ? mPlaybackMixers[i]->GetBuffer() : nullptr);
+                  cache.insert(cache.end(), src, src + processed);
+                  cache.resize(cache.size() + (frames - processed), 0.0f);
+               }
+            }
+
+            if (inPreRoll && progress)
+               for (i = 0; i < numTracks; i++) {
+                  // Within what PreparePunchCache() reserved
+                  const auto keep = mPunchKeep[i];
+                  if (!keep)
+                     continue;
+                  const auto processed = frames > 0 ? mPlaybackProcessed[i] : 0;
+                  const auto src = (const float *)
+                     (processed > 0 ? mPlaybackMixers[i]->GetBuffer() : nullptr);
+                  keep->insert(keep->end(), src, src + processed);
+                  keep->resize(keep->size() + (frames - processed), 0.0f);
+               }
+
+            for (i = 0; i < numTracks; i++)
+            {
+               const auto processed = mPlaybackProcessed[i];
                samplePtr warpedSamples;
-               //don't do anything if we have no length.  In particular, Process() will fail an wxAssert
-               //that causes a crash since this is not the GUI thread and wxASSERT is a GUI call.
-               const bool silent = false;
 
                if (progress && !silent && frames > 0)
                {
-                  processed = mPlaybackMixers[i]->Process(frames);
                   wxASSERT(processed <= frames);
-                  warpedSamples = mPlaybackMixers[i]->GetBuffer();
-                  const auto put = mPlaybackBuffers[i]->Put
-                     (warpedSamples, floatSample, processed);
-                  // wxASSERT(put == processed);
-                  // but we can't assert in this thread
-                  wxUnusedVar(put);
+                  const bool kept = inPreRoll && mPunchReplay[i];
+                  warpedSamples = replaying
+                     ? (samplePtr)(mLoopCache[i].data() + mLoopCachePos - frames)
+                     : kept
+                     ? (samplePtr)(mPunchReplay[i]->data() + mPunchPos)
+                     : mPlaybackMixers[i]->GetBuffer();
+
+                  auto &trackChain = mTrackChains[i];
+                  const auto masterChain =
+                     mPremixBuffer ? nullptr : &mMasterChains[i];
+                  if (processed > 0 && !(trackChain.IsIdle() &&
+                      (!masterChain || masterChain->IsIdle()))) {
+                     if (replaying || kept) {
+                        // Keep the loop, or the pre-roll, as the mixers
+                        // made it
+                        const auto src = (const float *)warpedSamples;
+                        mRealtimeScratch.assign(src, src + processed);
+                        warpedSamples = (samplePtr)mRealtimeScratch.data();
+                     }
+                     const auto buffer = (float *)warpedSamples;
+                     trackChain.Process(buffer, processed);
+                     if (masterChain)
+                        masterChain->Process(buffer, processed);
+                  }
+
+                  if (mPremixBuffer) {
+                     // Add the track into the channels it plays on, as
+                     // the callback would
+                     const auto channel = mPlaybackTracks[i]->GetChannel();
+                     const auto nChannels = mNumPlaybackChannels;
+                     const auto src = (const float *)warpedSamples;
+                     for (unsigned c = 0; c < std::min(2u, nChannels); ++c) {
+                        if (channel == Track::MonoChannel ||
+                            channel == (c == 0
+                               ? Track::LeftChannel : Track::RightChannel)) {
+                           auto dest = &mPremixScratch[c];
+                           const auto gain =
+                              mPlaybackTracks[i]->GetChannelGain(c);
+                           for (size_t f = 0; f < processed; ++f)
+                              dest[f * nChannels] += gain * src[f];
+                        }
+                     }
+                     premixed = std::max(premixed, processed);
+                  }
+                  else {
+                     const auto put = mPlaybackBuffers[i]->Put
+                        (warpedSamples, floatSample, processed);
+                     // wxASSERT(put == processed);
+                     // but we can't assert in this thread
+                     wxUnusedVar(put);
+                     mostPut = std::max(mostPut, processed);
+                  }
                }
                
                //if looping and processed is less than the full chunk/block/buffer that gets pulled from
@@ -2310,18 +3615,44 @@ void AudioIO::FillBuffers()
                // If scrubbing, we may be producing some silence.  Otherwise this should not happen,
                // but makes sure anyway that we produce equal
                // numbers of samples for all channels for this pass of the do-loop.
-               if(processed < frames && mPlayMode != PLAY_STRAIGHT)
+               if(processed < frames && mPlayMode != PLAY_STRAIGHT &&
+                  mPremixBuffer)
+                  // The scratch is silent already
+                  premixed = frames;
+               else if(processed < frames && mPlayMode != PLAY_STRAIGHT)
                {
-                  mSilentBuf.Resize(frames, floatSample);
-                  ClearSamples(mSilentBuf.ptr(), floatSample, 0, frames);
-                  const auto put = mPlaybackBuffers[i]->Put
-                     (mSilentBuf.ptr(), floatSample, frames - processed);
+                  // Write the silence in place
+                  const auto put =
+                     mPlaybackBuffers[i]->Clear(frames - processed);
                   // wxASSERT(put == frames - processed);
                   // but we can't assert in this thread
                   wxUnusedVar(put);
+                  mostPut = frames;
                }
             }
 
+            if (inPreRoll)
+               mPunchPos += frames;
+
+            if (mPremixBuffer) {
+               for (unsigned c = 0; c < mMasterChains.size(); ++c)
+                  mMasterChains[c].Process
+                     (&mPremixScratch[c], premixed, mNumPlaybackChannels);
+               const auto put = mPremixBuffer->Put(
+                  (samplePtr)mPremixScratch.data(), floatSample,
+                  premixed * mNumPlaybackChannels);
+               // wxASSERT(put == premixed * mNumPlaybackChannels);
+               // but we can't assert in this thread
+               wxUnusedVar(put);
+               mostPut = premixed;
+            }
+
+            if (mostPut > 0) {
+               const auto mixEnd = Profiler::Now();
+               mTelemetry.playbackMix.Record(mixEnd - mixStart);
+               mTelemetry.playbackWait.Mark(mostPut, mixEnd);
+            }
+
             available -= frames;
             wxASSERT(available >= 0);
 
@@ -2333,13 +3664,26 @@ void AudioIO::FillBuffers()
 				   // and if yes, restart from the beginning.
 				   if (mWarpedTime >= mWarpedLength)
 				   {
-					  for (i = 0; i < mPlaybackTracks.size(); i++)
-						 mPlaybackMixers[i]->Restart();
+					  if (mLoopCacheState == LoopCache::Recording)
+						 // A pass was kept whole; repeat it from now on,
+						 // if it has anything in it
+						 mLoopCacheState = mLoopCache[0].empty()
+							? LoopCache::Off : LoopCache::Ready;
+					  else if (mLoopCacheState == LoopCache::Ready &&
+						 mLoopCacheStale.load(std::memory_order_relaxed))
+						 // Edited; mix again, and keep the NEW pass
+						 mLoopCacheState = LoopCache::Off;
+					  mLoopCachePos = 0;
+					  // The mixers stay at the start while the loop repeats
+					  if (!replaying)
+						 for (i = 0; i < mPlaybackTracks.size(); i++)
+							mPlaybackMixers[i]->Restart();
 					  mWarpedTime = 0.0;
 				   }
 				   break;
 				default:
-				   done = true;
+				   // Go on past the cut preview gap, or the pre-roll
+				   done = !((atGap || atPunch) && available > 0);
 				   break;
             }
          } while (!done);
@@ -2350,6 +3694,19 @@ void AudioIO::FillBuffers()
        mCaptureTracks.size() > 0)
       GuardedCall( [&] {
          // start record buffering
+
+         DrainCaptureDevice();
+
+         // Bring the tracks of the second device level with the main ones
+         if (mAggregate) {
+            const auto &buffers = mCaptureBuffers;
+            const auto fromMain = buffers[0]->AvailForGet();
+            const auto fromSecond = buffers[mNumCaptureChannels]->AvailForGet();
+            if (fromMain > fromSecond)
+               mAggregate->Transfer(fromMain - fromSecond,
+                                    &buffers[mNumCaptureChannels]);
+         }
+
          auto commonlyAvail = GetCommonlyAvailCapture();
 
          //
@@ -2363,6 +3720,8 @@ void AudioIO::FillBuffers()
             // Append captured samples to the end of the WaveTracks.
             // The WaveTracks have their own buffering for efficiency.
             auto numChannels = mCaptureTracks.size();
+            const auto appendStart = Profiler::Now();
+            mTelemetry.captureWait.Take(commonlyAvail, appendStart);
 
             for( i = 0; i < numChannels; i++ )
             {
@@ -2402,6 +3761,18 @@ void AudioIO::FillBuffers()
                   mCaptureTracks[i]-> Append(temp2.ptr(), floatSample, size, 1);
                }
             }
+            // Including the writing of any block files that filled
+            if (commonlyAvail > 0)
+               mTelemetry.captureAppend.Record(Profiler::Now() - appendStart);
+
+            // Let the listener journal the blocks appended so far, so that
+            // a crash loses only the last few seconds
+            mSecsSinceCheckpoint += deltat;
+            if (mListener && mCheckpointSecs > 0 &&
+                mSecsSinceCheckpoint >= mCheckpointSecs) {
+               mSecsSinceCheckpoint = 0.0;
+               mListener->OnAudioIOCheckpoint(mCaptureTracks);
+            }
          }
          // end of record buffering
       },
@@ -2458,17 +3829,64 @@ static void DoSoftwarePlaythrough(const void *inputBuffer,
          outputBuffer[2*i + 1] = outputBuffer[2*i];
 }
 
+namespace {
+// Records the duration of the callback in the telemetry, on every way out
+class CallbackTimer
+{
+public:
+   CallbackTimer(AudioIOTelemetry &telemetry, double bufferSeconds)
+      : mTelemetry{ telemetry }
+      , mBufferSeconds{ bufferSeconds }
+      , mStart{ std::chrono::steady_clock::now() }
+   {}
+
+   ~CallbackTimer()
+   {
+      const std::chrono::duration<double> elapsed =
+         std::chrono::steady_clock::now() - mStart;
+      mTelemetry.RecordCallback(elapsed.count(), mBufferSeconds);
+   }
+
+private:
+   AudioIOTelemetry &mTelemetry;
+   const double mBufferSeconds;
+   const std::chrono::steady_clock::time_point mStart;
+};
+}
+
 int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
                           unsigned long framesPerBuffer,
-                          const PaStreamCallbackTimeInfo * WXUNUSED(timeInfo),
+                          const PaStreamCallbackTimeInfo *timeInfo,
                           const PaStreamCallbackFlags statusFlags, void * WXUNUSED(userData) )
 {
+   PROFILE_SCOPE("audacityAudioCallback");
+   if (Profiler::Enabled())
+      Profiler::Instance()->SetThreadName("PortAudio callback");
+
+   CallbackTimer timer{ gAudioIO->mTelemetry, framesPerBuffer / gAudioIO->mRate };
+   gAudioIO->mTelemetry.RecordFlags(statusFlags);
+
+   // The latency of the device on each side, where the host reports it
+   if (timeInfo) {
+      if (inputBuffer && timeInfo->inputBufferAdcTime > 0)
+         gAudioIO->mTelemetry.inputDevice.Record((long long)(1e9 *
+            (timeInfo->currentTime - timeInfo->inputBufferAdcTime)));
+      if (outputBuffer && timeInfo->outputBufferDacTime > 0)
+         gAudioIO->mTelemetry.outputDevice.Record((long long)(1e9 *
+            (timeInfo->outputBufferDacTime - timeInfo->currentTime)));
+   }
+
    auto numPlaybackChannels = gAudioIO->mNumPlaybackChannels;
    auto numPlaybackTracks = gAudioIO->mPlaybackTracks.size();
    auto numCaptureChannels = gAudioIO->mNumCaptureChannels;
    int callbackReturn = paContinue;
-   void *tempBuffer = alloca(framesPerBuffer*sizeof(float)*
-                             MAX(numCaptureChannels,numPlaybackChannels));
+   // Use the scratch that StartPortAudioStream() allocated, unless the
+   // host gives us a bigger buffer than it allowed for
+   const bool preallocated = framesPerBuffer <= gAudioIO->mCallbackFrames;
+   void *tempBuffer = preallocated
+      ? gAudioIO->mCallbackTemp.get()
+      : alloca(framesPerBuffer*sizeof(float)*
+               MAX(numCaptureChannels,numPlaybackChannels));
    float *tempFloats = (float*)tempBuffer;
 
    // output meter may need samples untouched by volume emulation
@@ -2476,7 +3894,10 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
    outputMeterFloats =
       (outputBuffer && gAudioIO->mEmulateMixerOutputVol &&
                        gAudioIO->mMixerOutputVol != 1.0) ?
-         (float *)alloca(framesPerBuffer*numPlaybackChannels * sizeof(float)) :
+         (preallocated
+            ? gAudioIO->mCallbackMeterTemp.get()
+            : (float *)alloca(framesPerBuffer*numPlaybackChannels *
+                              sizeof(float))) :
          (float *)outputBuffer;
 
    unsigned int i;
@@ -2514,34 +3935,35 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
       gAudioIO->mUpdatingMeters = false;
    }  // end recording VU meter update
 
-   // Stop recording if 'silence' is detected
-   //
-   // LL:  We'd gotten a little "dangerous" with the control toolbar calls
-   //      here because we are not running in the main GUI thread.  Eventually
-   //      the toolbar attempts to update the active project's status bar.
-   //      But, since we're not in the main thread, we can get all manner of
-   //      really weird failures.  Or none at all which is even worse, since
-   //      we don't know a problem exists.
-   //
-   //      By using CallAfter(), we can schedule the call to the toolbar
-   //      to run in the main GUI thread after the next event loop iteration.
-   if(gAudioIO->mPauseRec && inputBuffer && gAudioIO->mInputMeter) {
-      if(gAudioIO->mInputMeter->GetMaxPeak() < gAudioIO->mSilenceLevel ) {
-         if(!gAudioIO->IsPaused()) {
-            AudacityProject *p = GetActiveProject();
-            ControlToolBar *bar = p->GetControlToolBar();
-            bar->CallAfter(&ControlToolBar::Pause);
-         }
+   // Sound activated recording pauses and resumes here, at the buffer where
+   // the input crosses the silence level, whatever the meter does; the
+   // audio thread then updates the toolbar, in
+   // AudioIO::CheckSoundActivatedRecording()
+   bool paused = gAudioIO->mPaused;
+   if (gAudioIO->mPauseRec && inputBuffer && numCaptureChannels > 0 &&
+       gAudioIO->mStreamToken > 0 && gAudioIO->mCaptureTracks.size() > 0) {
+      const float *inputFloats = (const float *)inputBuffer;
+      if (gAudioIO->mCaptureFormat != floatSample) {
+         CopySamples((samplePtr)inputBuffer, gAudioIO->mCaptureFormat,
+                     (samplePtr)tempFloats, floatSample,
+                     framesPerBuffer * numCaptureChannels);
+         inputFloats = tempFloats;
+      }
+      auto &detector = gAudioIO->mSoundActivation;
+      const bool wasActive = detector.IsActive();
+      if (detector.Process(inputFloats, framesPerBuffer)) {
+         // Record the moments before the sound too
+         if (!wasActive)
+            detector.PutPreRoll(*gAudioIO->mCaptureDeviceBuffer);
+         paused = false;
       }
       else {
-         if(gAudioIO->IsPaused()) {
-            AudacityProject *p = GetActiveProject();
-            ControlToolBar *bar = p->GetControlToolBar();
-            bar->CallAfter(&ControlToolBar::Pause);
-         }
+         detector.KeepPreRoll(inputFloats, framesPerBuffer);
+         paused = true;
       }
    }
-   if( gAudioIO->mPaused )
+
+   if( paused )
    {
       if (outputBuffer && numPlaybackChannels > 0)
       {
@@ -2596,9 +4018,11 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
 
             // Pause audio thread and wait for it to finish
             gAudioIO->mAudioThreadFillBuffersLoopRunning = false;
+            // The thread polls every few milliseconds; a longer sleep here
+            // only delays the seek
             while( gAudioIO->mAudioThreadFillBuffersLoopActive == true )
             {
-               wxMilliSleep( 50 );
+               wxMilliSleep( 1 );
             }
 
             // Calculate the NEW time position
@@ -2608,12 +4032,19 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
 
             // Reset mixer positions and flush buffers for all tracks
             gAudioIO->mWarpedTime = gAudioIO->mTime - gAudioIO->mT0;
-            gAudioIO->mWarpedTime = std::abs(gAudioIO->mWarpedTime);
+            gAudioIO->mWarpedTime =
+               std::abs(gAudioIO->mWarpedTime) / gAudioIO->mPlaybackSpeed;
+
+            // The loop kept from the mixers no longer matches them
+            gAudioIO->mLoopCacheState = AudioIO::LoopCache::Off;
 
             // Reset mixer positions and flush buffers for all tracks
+            gAudioIO->RepositionMixers(gAudioIO->mTime);
+            size_t framesDiscarded = 0;
             for (i = 0; i < numPlaybackTracks; i++)
             {
-               gAudioIO->mPlaybackMixers[i]->Reposition(gAudioIO->mTime);
+               if (gAudioIO->mPremixBuffer)
+                  continue;
                const auto toDiscard =
                   gAudioIO->mPlaybackBuffers[i]->AvailForGet();
                const auto discarded =
@@ -2621,13 +4052,25 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
                // wxASSERT( discarded == toDiscard );
                // but we can't assert in this thread
                wxUnusedVar(discarded);
+               framesDiscarded = std::max(framesDiscarded, discarded);
             }
 
-            // Reload the ring buffers
+            if (gAudioIO->mPremixBuffer)
+               framesDiscarded = gAudioIO->mPremixBuffer->Discard(
+                  gAudioIO->mPremixBuffer->AvailForGet()) /
+                  numPlaybackChannels;
+            gAudioIO->mTelemetry.playbackWait.Take(
+               framesDiscarded, Profiler::Now(), false);
+
+            // Reload the ring buffers, a piece only, from blocks that
+            // PrefetchSeekTargets() likely decoded already
+            gAudioIO->mSeekPriming = true;
+            gAudioIO->mSeekPrefetchTime = -1.0;
             gAudioIO->mAudioThreadShouldCallFillBuffersOnce = true;
+            gAudioIO->WakeAudioThread();
             while( gAudioIO->mAudioThreadShouldCallFillBuffersOnce == true )
             {
-               wxMilliSleep( 50 );
+               wxMilliSleep( 1 );
             }
 
             // Reenable the audio thread
@@ -2636,18 +4079,64 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
             return paContinue;
          }
 
-         const WaveTrack **chans = (const WaveTrack **) alloca(numPlaybackChannels * sizeof(WaveTrack *));
-         float **tempBufs = (float **) alloca(numPlaybackChannels * sizeof(float *));
-         for (unsigned int c = 0; c < numPlaybackChannels; c++)
-         {
-            tempBufs[c] = (float *) alloca(framesPerBuffer * sizeof(float));
+         // With premixing, the audio thread mixed the tracks already.  Add
+         // them to the output in place, from the ring buffer.
+         unsigned numTracksToMix = numPlaybackTracks;
+         size_t framesTaken = 0;
+         if (const auto premix = gAudioIO->mPremixBuffer.get()) {
+            numTracksToMix = 0;
+            const float gain = gAudioIO->mEmulateMixerOutputVol
+               ? gAudioIO->mMixerOutputVol : 1.0f;
+            const auto wanted = framesPerBuffer * numPlaybackChannels;
+            decltype(framesPerBuffer) done = 0;
+            while (done < wanted) {
+               const auto region = premix->GetReadRegion();
+               const auto count = std::min<size_t>(wanted - done, region.second);
+               if (!count)
+                  break;
+               const auto src = (const float *)region.first;
+               if (outputMeterFloats != outputFloats)
+                  for (size_t k = 0; k < count; ++k)
+                     outputMeterFloats[done + k] += src[k];
+               for (size_t k = 0; k < count; ++k)
+                  outputFloats[done + k] += gain * src[k];
+               premix->Discard(count);
+               done += count;
+            }
+            framesTaken = done / numPlaybackChannels;
+
+            // If our buffer is empty and the time indicator is past
+            // the end, then we've actually finished playing the entire
+            // selection.
+            if (done == 0 &&
+                gAudioIO->mPlayMode == AudioIO::PLAY_STRAIGHT) {
+               if ((gAudioIO->ReversedTime()
+                  ? gAudioIO->mTime <= gAudioIO->mT1
+                  : gAudioIO->mTime >= gAudioIO->mT1))
+                  callbackReturn = paComplete;
+            }
+         }
+
+         const WaveTrack **chans;
+         float **tempBufs;
+         if (preallocated) {
+            chans = gAudioIO->mCallbackChans.get();
+            tempBufs = gAudioIO->mCallbackChannelPtrs.get();
+         }
+         else {
+            chans = (const WaveTrack **) alloca(numPlaybackChannels * sizeof(WaveTrack *));
+            tempBufs = (float **) alloca(numPlaybackChannels * sizeof(float *));
+            for (unsigned int c = 0; c < numPlaybackChannels; c++)
+            {
+               tempBufs[c] = (float *) alloca(framesPerBuffer * sizeof(float));
+            }
          }
 
          bool selected = false;
          int group = 0;
          int chanCnt = 0;
          decltype(framesPerBuffer) maxLen = 0;
-         for (unsigned t = 0; t < numPlaybackTracks; t++)
+         for (unsigned t = 0; t < numTracksToMix; t++)
          {
             const WaveTrack *vt = gAudioIO->mPlaybackTracks[t].get();
 
@@ -2752,7 +4241,7 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
                if (vt->GetChannel() == Track::LeftChannel ||
                    vt->GetChannel() == Track::MonoChannel)
                {
-                  float gain = 1.0;
+                  float gain = vt->GetChannelGain(0);
 
                   // Output volume emulation: possibly copy meter samples, then
                   // apply volume, then copy to the output buffer
@@ -2771,7 +4260,7 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
                if (vt->GetChannel() == Track::RightChannel ||
                    vt->GetChannel() == Track::MonoChannel)
                {
-                  float gain = 1.0;
+                  float gain = vt->GetChannelGain(1);
 
                   // Output volume emulation (as above)
                   if (outputMeterFloats != outputFloats)
@@ -2789,6 +4278,9 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
 
             chanCnt = 0;
          }
+         framesTaken = std::max<size_t>(framesTaken, maxLen);
+         gAudioIO->mTelemetry.playbackWait.Take(framesTaken, Profiler::Now());
+
          // Poke: If there are no playback tracks, then the earlier check
          // about the time indicator being passed the end won't happen;
          // do it here instead (but not if looping or scrubbing)
@@ -2852,10 +4344,8 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
          // So we have not decided to enable this extra detection yet in
          // production
 
-         size_t len = framesPerBuffer;
-         for(unsigned t = 0; t < numCaptureChannels; t++)
-            len = std::min( len,
-                           gAudioIO->mCaptureBuffers[t]->AvailForPut());
+         size_t len = std::min<size_t>(framesPerBuffer,
+            gAudioIO->mCaptureDeviceBuffer->AvailForPut() / numCaptureChannels);
 
          if (gAudioIO->mSimulateRecordingErrors && 100LL * rand() < RAND_MAX)
             // Make spurious errors for purposes of testing the error
@@ -2884,53 +4374,19 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
          }
 
          if (len > 0) {
-            for(unsigned t = 0; t < numCaptureChannels; t++) {
-
-               // dmazzoni:
-               // Un-interleave.  Ugly special-case code required because the
-               // capture channels could be in three different sample formats;
-               // it'd be nice to be able to call CopySamples, but it can't
-               // handle multiplying by the gain and then clipping.  Bummer.
-
-               switch(gAudioIO->mCaptureFormat) {
-               case floatSample: {
-                  float *inputFloats = (float *)inputBuffer;
-                  for( i = 0; i < len; i++)
-                     tempFloats[i] =
-                        inputFloats[numCaptureChannels*i+t];
-               } break;
-               case int24Sample:
-                  // We should never get here. Audacity's int24Sample format
-                  // is different from PortAudio's sample format and so we
-                  // make PortAudio return float samples when recording in
-                  // 24-bit samples.
-                  wxASSERT(false);
-                  break;
-               case int16Sample: {
-                  short *inputShorts = (short *)inputBuffer;
-                  short *tempShorts = (short *)tempBuffer;
-                  for( i = 0; i < len; i++) {
-                     float tmp = inputShorts[numCaptureChannels*i+t];
-                     if (tmp > 32767)
-                        tmp = 32767;
-                     if (tmp < -32768)
-                        tmp = -32768;
-                     tempShorts[i] = (short)(tmp);
-                  }
-               } break;
-               } // switch
-
-               const auto put =
-                  gAudioIO->mCaptureBuffers[t]->Put(
-                     (samplePtr)tempBuffer, gAudioIO->mCaptureFormat, len);
-               // wxASSERT(put == len);
-               // but we can't assert in this thread
-               wxUnusedVar(put);
-            }
+            // Only a copy here; the audio thread splits the channels and
+            // converts them, in DrainCaptureDevice()
+            const auto put = gAudioIO->mCaptureDeviceBuffer->Put(
+               (samplePtr)inputBuffer, gAudioIO->mCaptureFormat,
+               len * numCaptureChannels);
+            // wxASSERT(put == len * numCaptureChannels);
+            // but we can't assert in this thread
+            wxUnusedVar(put);
+            gAudioIO->mTelemetry.captureWait.Mark(len, Profiler::Now());
          }
       }
 
-	double delta = framesPerBuffer / gAudioIO->mRate;
+	double delta = framesPerBuffer * gAudioIO->mPlaybackSpeed / gAudioIO->mRate;
 	if (gAudioIO->ReversedTime())
 		delta *= -1.0;
 
@@ -2978,6 +4434,11 @@ int audacityAudioCallback(const void *inputBuffer, void *outputBuffer,
       }
 
    }
+   if (gAudioIO->mStreamToken > 0) {
+      gAudioIO->RecordBufferLevels();
+      gAudioIO->WakeAudioThreadIfLow();
+   }
+
    /* Send data to playback VU meter if applicable */
    if (gAudioIO->mOutputMeter &&
       !gAudioIO->mOutputMeter->IsMeterDisabled() &&
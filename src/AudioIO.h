@@ -18,6 +18,8 @@
 #include "Experimental.h"
 
 #include "MemoryX.h"
+#include <atomic>
+#include <map>
 #include <utility>
 #include <vector>
 #include <wx/atomic.h>
@@ -28,14 +30,18 @@
 #include <wx/thread.h>
 
 #include "SampleFormat.h"
+#include "RealtimeChain.h"
 
 class AudioIO;
 class RingBuffer;
 class Mixer;
 class Resample;
+class AggregateCapture;
 class AudioThread;
 class MeterPanel;
+class MixerPool;
 class SelectedRegion;
+class WaveTrackCache;
 
 class AudacityProject;
 
@@ -45,6 +51,9 @@ using WaveTrackConstArray = std::vector < std::shared_ptr < const WaveTrack > >;
 
 extern AUDACITY_DLL_API AudioIO *gAudioIO;
 
+/// Begin PortAudio's scan of host APIs and devices, where it can run while
+/// the rest of startup does; InitAudioIO() waits for it
+void StartAudioIOInit();
 void InitAudioIO();
 void DeinitAudioIO();
 wxString DeviceName(const PaDeviceInfo* info);
@@ -80,6 +89,10 @@ struct AudioIOStartStreamOptions
       , cutPreviewGapStart(0.0)
       , cutPreviewGapLen(0.0)
       , pStartTime(NULL)
+      , aggregateChannels(0)
+      , playbackSpeed(1.0)
+      , punchIn(0.0)
+      , punchOut(0.0)
    {}
 
    AudioIOListener* listener;
@@ -88,6 +101,162 @@ struct AudioIOStartStreamOptions
    double cutPreviewGapStart;
    double cutPreviewGapLen;
    double * pStartTime;
+   // How many of the capture tracks, at the end, record from the second
+   // recording device
+   unsigned aggregateChannels;
+   // Factor on the speed of play, as a tape machine's varispeed, so the
+   // pitch follows; limited to the range of kMinPlaybackSpeed to
+   // kMaxPlaybackSpeed, and ignored when recording
+   double playbackSpeed;
+   // Punch-in: the capture tracks are takes, recorded from t0, and when
+   // the stream stops, what they recorded from punchIn to punchOut
+   // replaces the same span of these tracks, one for one.  These tracks,
+   // if they play, play only up to punchIn.
+   WaveTrackArray punchTracks;
+   double punchIn;
+   double punchOut;
+};
+
+static const double kMinPlaybackSpeed = 0.5;
+static const double kMaxPlaybackSpeed = 2.0;
+
+/// Counts of durations, in buckets doubling from 62.5 microseconds, the
+/// last for a second and more.  Written by one thread, read by any.
+struct LatencyHistogram
+{
+   enum { nBuckets = 16 };
+
+   std::atomic<unsigned long> count;
+   std::atomic<unsigned long> buckets[nBuckets];
+   std::atomic<long long>     totalNanoseconds;
+   std::atomic<long long>     maxNanoseconds;
+
+   LatencyHistogram() { Reset(); }
+   void Reset();
+
+   void Record(long long nanoseconds);
+
+   /// The least duration of a bucket, in seconds
+   static double BucketSeconds(int bucket);
+};
+
+/// The waits of frames passing from one thread to another through ring
+/// buffers.  The writer marks the frames it has put, and when; the reader,
+/// as it takes frames, records the waits of the marks it has passed.  Takes
+/// no lock, for one writer and one reader.
+class LatencyProbe
+{
+public:
+   LatencyHistogram waits;
+
+   /// Neither side may be running
+   void Reset();
+
+   /// For the writer: so many more frames, ready at the time, as
+   /// Profiler::Now() gives it.  If the reader is far behind, the mark is
+   /// dropped and its wait not recorded.
+   void Mark(size_t frames, long long time);
+
+   /// For the reader: so many more frames taken at the time.  Frames
+   /// discarded are taken with record false.
+   void Take(size_t frames, long long time, bool record = true);
+
+private:
+   struct Entry { size_t frames; long long time; };
+   enum { nEntries = 256 };
+   Entry mEntries[nEntries];
+   std::atomic<size_t> mHead{ 0 };
+   std::atomic<size_t> mTail{ 0 };
+
+   // Counts of all frames put and taken; each side's own
+   size_t mPut{ 0 };
+   size_t mTaken{ 0 };
+};
+
+/// How close to the edge the audio callback ran, for tuning buffer sizes.
+/// Reset when a stream starts; written by the callback only, and read by
+/// any thread.
+struct AudioIOTelemetry
+{
+   /// Callbacks by load, the time each took as a fraction of the duration
+   /// of its buffer: one bucket per tenth, and the last for overruns
+   enum { nLoadBuckets = 11 };
+
+   std::atomic<unsigned long> callbacks;
+   std::atomic<unsigned long> loadHistogram[nLoadBuckets];
+   std::atomic<double>        maxLoad;
+
+   /// Counts of the status flags that PortAudio passed to the callback
+   std::atomic<unsigned long> inputUnderflows;
+   std::atomic<unsigned long> inputOverflows;
+   std::atomic<unsigned long> outputUnderflows;
+   std::atomic<unsigned long> outputOverflows;
+
+   /// Least playback buffered, and least room for capture, in frames, that
+   /// the callback saw; SIZE_MAX if never seen
+   std::atomic<size_t>        minPlaybackFrames;
+   std::atomic<size_t>        minCaptureRoom;
+
+   /// Latency, stage by stage.  Capture: from the device to the callback,
+   /// waiting in the capture buffers for the audio thread, and appending
+   /// to the tracks, which writes the block files.  Playback: mixing and
+   /// putting into the playback buffers, waiting there for the callback,
+   /// and from the callback to the device.  The device stages are as the
+   /// host reports them, which some do not.
+   LatencyHistogram           inputDevice;
+   LatencyProbe               captureWait;
+   LatencyHistogram           captureAppend;
+   LatencyHistogram           playbackMix;
+   LatencyProbe               playbackWait;
+   LatencyHistogram           outputDevice;
+
+   AudioIOTelemetry() { Reset(); }
+   void Reset();
+
+   void RecordCallback(double seconds, double bufferSeconds);
+   void RecordFlags(unsigned long statusFlags);
+   void RecordPlayback(size_t frames);
+   void RecordCaptureRoom(size_t frames);
+};
+
+/// Decides, for sound activated recording, when the input is loud enough
+/// to record: the RMS of all channels in windows of 10 ms, rising above the
+/// silence level to start, and staying 4 dB below it for half a second to
+/// stop.  While silent, it keeps the last 100 ms or so of input, to be put
+/// into the capture buffers when sound starts, so the onset is recorded.
+/// Reset when a stream starts; the callback does the rest, and any thread
+/// may ask IsActive().
+struct SoundActivationDetector
+{
+   void Reset(double rate, unsigned channels, double silenceLevelDB);
+
+   /// Returns IsActive() after the given interleaved frames
+   bool Process(const float *samples, size_t frames);
+   bool IsActive() const { return mActive.load(std::memory_order_relaxed); }
+
+   /// Remember interleaved frames for the pre-roll
+   void KeepPreRoll(const float *samples, size_t frames);
+   /// Put the pre-roll into the buffer of interleaved device frames, and
+   /// forget it
+   void PutPreRoll(RingBuffer &buffer);
+
+private:
+   unsigned mChannels{ 0 };
+   size_t mWindowFrames{ 1 };
+   size_t mHoldFrames{ 0 };
+   double mOnPower{ 0 };
+   double mOffPower{ 0 };
+
+   double mWindowSum{ 0 };
+   size_t mWindowFilled{ 0 };
+   size_t mHoldLeft{ 0 };
+   std::atomic<bool> mActive{ false };
+
+   // Interleaved, mPreRollFrames long
+   Floats mPreRoll;
+   size_t mPreRollFrames{ 0 };
+   size_t mPreRollStart{ 0 };
+   size_t mPreRollFilled{ 0 };
 };
 
 // This workaround makes pause and stop work when output is to GarageBand,
@@ -133,6 +302,21 @@ class AUDACITY_DLL_API AudioIO final {
     * by the specified amount from where it is now */
    void SeekStream(double seconds) { mSeek = seconds; }
 
+   /** \brief Tracks were edited, so that looped playback must mix them
+    * again, from its next pass, instead of repeating the loop it kept */
+   void InvalidateLoopCache()
+   { mLoopCacheStale.store(true, std::memory_order_relaxed); }
+
+   /** \brief Changes what playback does to a track, or to all of them if
+    * track is null, without changing any samples.
+    *
+    * Call from the thread of the interface only.  A stream playing the
+    * track applies the change when the audio thread next fills the
+    * buffers, after the samples already in them. */
+   void SetRealtimeSettings(WaveTrack *track, const RealtimeSettings &settings);
+   const RealtimeSettings &GetMasterRealtimeSettings() const
+   { return mMasterRealtime; }
+
    /** \brief  Returns true if audio i/o is busy starting, stopping, playing,
     * or recording.
     *
@@ -149,6 +333,14 @@ class AUDACITY_DLL_API AudioIO final {
    bool IsStreamActive(int token);
 
    wxLongLong GetLastPlaybackTime() const { return mLastPlaybackTimeMillis; }
+
+   /** \brief How full the playback buffers were, from 0 to 1, when the
+    * audio thread last came to fill them; 1 when nothing plays.
+    *
+    * Any thread may call this, so that background work can make way
+    * for playback that runs short */
+   float GetPlaybackBufferFill() const
+   { return mPlaybackBufferFill.load(std::memory_order_relaxed); }
    AudacityProject *GetOwningProject() const { return mOwningProject; }
 
    /** \brief Returns true if the stream is active, or even if audio I/O is
@@ -162,6 +354,10 @@ class AUDACITY_DLL_API AudioIO final {
     * playing actual audio) */
    bool IsMonitoring();
 
+   /** \brief Input plus output latency of the open stream, in seconds, as
+    * PortAudio reports it; zero if unknown or the stream is not duplex */
+   double GetRoundTripLatency() const { return mRoundTripLatency; }
+
    /** \brief Pause and un-pause playback and recording */
    void SetPaused(bool state);
    /** \brief Find out if playback / recording is currently paused */
@@ -199,6 +395,15 @@ class AUDACITY_DLL_API AudioIO final {
     * GetSupported*Rate functions considerably */
    void HandleDeviceChange();
 
+   /** \brief Forget the rates kept for the devices last chosen, so that
+    * they are looked up again at the next use */
+   static void ForgetCachedRates();
+
+   /** \brief Forget the rates kept for the devices last chosen, and have
+    * each device whose rates come from the preferences probed again once,
+    * after a rescan of the devices */
+   static void RescanCachedRates();
+
    /** \brief Get a list of sample rates the output (playback) device
     * supports.
     *
@@ -282,6 +487,12 @@ class AUDACITY_DLL_API AudioIO final {
     */
    wxString GetDeviceInfo();
 
+   /** \brief What the callback recorded about the last or current stream */
+   const AudioIOTelemetry &GetTelemetry() const { return mTelemetry; }
+
+   /** \brief GetTelemetry() as text, for the Audio Device Info dialog */
+   wxString GetTelemetryInfo() const;
+
    /** \brief Ensure selected device names are valid
     *
     */
@@ -323,6 +534,23 @@ private:
                              unsigned int numCaptureChannels,
                              sampleFormat captureFormat);
    void FillBuffers();
+   /// Moves the frames the callback put in mCaptureDeviceBuffer into the
+   /// buffers of the capture channels, in the formats of their tracks;
+   /// called by the audio thread
+   void DrainCaptureDevice();
+   /// Has the blocks where a short or long seek from the playhead would
+   /// land decoded ahead of time; called by the audio thread
+   void PrefetchSeekTargets();
+   /// Pauses or resumes sound activated recording, as the input level says;
+   /// called by the audio thread, so that the callback need not
+   void CheckSoundActivatedRecording();
+   /// Lets the audio thread run FillBuffers() now, not at its next timeout
+   void WakeAudioThread();
+   /// Called by the callback, which wakes the audio thread only when
+   /// FillBuffers() has something to do
+   void WakeAudioThreadIfLow();
+   /// Called by the callback, for mTelemetry
+   void RecordBufferLevels();
 
    /** \brief Get the number of audio samples free in all of the playback
    * buffers.
@@ -390,6 +618,22 @@ private:
     */
    double NormalizeStreamTime(double absoluteTime) const;
 
+   /** \brief The time in the tracks that the mixers read for a time of the
+    * stream, which in cut preview does not have the gap in it
+    */
+   double StreamToTrackTime(double streamTime) const;
+
+   /** \brief Moves all playback mixers to a time of the stream, on the
+    * side of the cut preview gap where it lies
+    */
+   void RepositionMixers(double streamTime);
+
+   /** \brief In punch-in, finds what was kept of the pre-roll for the
+    * playback tracks, moving their mixers past it, and makes room to keep
+    * it for the others
+    */
+   void PreparePunchCache();
+
    /** \brief Clean up after StartStream if it fails.
      *
      * If bOnlyBuffers is specified, it only cleans up the buffers. */
@@ -398,10 +642,112 @@ private:
    std::unique_ptr<AudioThread> mThread;
    ArrayOf<std::unique_ptr<Resample>> mResample;
    ArrayOf<std::unique_ptr<RingBuffer>> mCaptureBuffers;
+   // The callback only copies the frames of the main capture device here,
+   // interleaved and in mCaptureFormat, and the audio thread splits them
+   // into mCaptureBuffers, a batch of mCaptureDeviceScratch at a time
+   std::unique_ptr<RingBuffer> mCaptureDeviceBuffer;
+   SampleBuffer        mCaptureDeviceScratch;
+   size_t              mCaptureDeviceScratchFrames { 0 };
    WaveTrackArray      mCaptureTracks;
    ArrayOf<std::unique_ptr<RingBuffer>> mPlaybackBuffers;
    WaveTrackConstArray mPlaybackTracks;
 
+   // With preference "/AudioIO/PremixPlayback", FillBuffers() mixes all the
+   // playback tracks into this one buffer of interleaved device channels,
+   // instead of mPlaybackBuffers, and the callback just adds it to the output
+   bool                mPremixPlayback { false };
+
+   // Preferences "/AudioIO/RealTimeThreads", "/AudioIO/AudioThreadCPU" and
+   // "/AudioIO/LockBuffers": scheduling of the audio thread and the mixing
+   // helpers, the one processor for the audio thread, or -1 for any, and
+   // whether the ring buffers are locked in memory.  The audio thread
+   // applies them to itself when mThreadSchedulingStale.
+   bool                mRealTimeThreads { true };
+   int                 mAudioThreadCPU { -1 };
+   bool                mLockBuffers { false };
+   std::atomic<bool>   mThreadSchedulingStale { false };
+   void ApplyThreadScheduling();
+   std::unique_ptr<RingBuffer> mPremixBuffer;
+   std::vector<float>  mPremixScratch; // for FillBuffers() only
+
+   // FillBuffers() runs what the mixers make through these before the ring
+   // buffers: the chain of each playback track, then the master's, one for
+   // each track, or for each device channel when premixing.  The thread of
+   // the interface changes them through mRealtimeQueue, where the master is
+   // target -1, and keeps the master's settings in mMasterRealtime.
+   std::vector<RealtimeChain> mTrackChains;
+   std::vector<RealtimeChain> mMasterChains;
+   RealtimeSettingsQueue mRealtimeQueue;
+   RealtimeSettings    mMasterRealtime;
+   std::vector<float>  mRealtimeScratch; // for FillBuffers() only
+
+   // Records the last capture tracks from a second device, if any; the
+   // first mNumCaptureChannels tracks are the main stream's
+   std::unique_ptr<AggregateCapture> mAggregate;
+
+   // Runs the playback mixers of many tracks on several threads at once
+   std::unique_ptr<MixerPool> mMixerPool;
+   std::vector<size_t> mPlaybackProcessed; // for FillBuffers() only
+
+   // With PLAY_LOOPED, when all the tracks of one pass of the loop fit in
+   // "/AudioIO/LoopCacheMax" megabytes, FillBuffers() keeps what the mixers
+   // made on the first pass, silence included, and puts that into the ring
+   // buffers on the later ones, instead of reading and mixing again.  A
+   // seek drops it at once; an edit, at the end of the pass.
+   enum class LoopCache { Off, Recording, Ready };
+   LoopCache           mLoopCacheState { LoopCache::Off };
+   size_t              mLoopCacheMaxFrames { 0 }; // zero if not kept
+   size_t              mLoopCachePos { 0 };
+   std::vector< std::vector<float> > mLoopCache; // one for each track
+   std::atomic<bool>   mLoopCacheStale { false };
+
+   // Punch-in, from the options of StartStream()
+   WaveTrackArray      mPunchTracks;
+   double              mPunchIn { 0.0 };
+   double              mPunchOut { 0.0 };
+
+   // In punch-in, what the mixer of each playback track made of the
+   // pre-roll, kept across streams while the contents of the tracks stay
+   // of the same generation, so that punching in again at the same place
+   // puts it into the ring buffers without reading and mixing.  Replayed
+   // tracks have their mixers at mPunchIn from the start.  Within the
+   // budget of the loop cache.  Only StartStream() and StopStream() change
+   // the map, and FillBuffers() fills the vectors reserved for it.
+   struct PunchCache {
+      unsigned long generation { 0 };
+      double t0 { 0.0 };
+      double punchIn { 0.0 };
+      double rate { 0.0 };
+      std::map<const WaveTrack *, std::vector<float>> kept;
+   };
+   PunchCache          mPunchCache;
+   size_t              mPunchPos { 0 };
+   size_t              mPunchFrames { 0 }; // of the pre-roll; zero if none
+   // For each playback track, the kept pre-roll to put, or what to keep it
+   // in, or neither
+   std::vector<const std::vector<float> *> mPunchReplay;
+   std::vector<std::vector<float> *> mPunchKeep;
+
+   // For PrefetchSeekTargets(), one for each playback track, apart from the
+   // mixers' own, with the seek steps of "/AudioIO/SeekShortPeriod" and
+   // "/AudioIO/SeekLongPeriod"
+   ArrayOf<std::unique_ptr<WaveTrackCache>> mSeekCaches;
+   double              mSeekShort { 1.0 };
+   double              mSeekLong { 15.0 };
+   double              mSeekPrefetchTime { -1.0 }; // playhead when last asked
+   // After a seek, FillBuffers() puts in one piece only, so that the
+   // callback waiting for it can go on sooner
+   bool                mSeekPriming { false };
+
+   // Scratch for audacityAudioCallback, sized by StartPortAudioStream() for
+   // the largest buffer we expect, so that the callback never allocates
+   size_t              mCallbackFrames { 0 };
+   Floats              mCallbackTemp;
+   Floats              mCallbackMeterTemp;
+   FloatBuffers        mCallbackChannelBufs;
+   ArrayOf<float *>    mCallbackChannelPtrs;
+   ArrayOf<const WaveTrack *> mCallbackChans;
+
    ArrayOf<std::unique_ptr<Mixer>> mPlaybackMixers;
    volatile int        mStreamToken;
    static int          mNextStreamToken;
@@ -425,18 +771,41 @@ private:
    /// Length in real seconds between mT0 and mT1.  Always positive.
    double              mWarpedLength;
 
+   /// Track seconds played in each real second
+   double              mPlaybackSpeed;
+
    double              mSeek;
    double              mPlaybackRingBufferSecs;
    double              mCaptureRingBufferSecs;
    size_t              mPlaybackSamplesToCopy;
+   // The least room in the playback buffers that FillBuffers() fills; the
+   // audio thread adapts it, up to mPlaybackSamplesToCopy
+   std::atomic<size_t> mPlaybackSamplesToFill { 0 };
+   size_t              mPlaybackBufferFrames { 0 };
+   std::atomic<float>  mPlaybackBufferFill { 1.0f };
    double              mMinCaptureSecsToCopy;
+   /// Seconds of recording between checkpoints to the listener; 0 for none
+   double              mCheckpointSecs { 0.0 };
+   double              mSecsSinceCheckpoint { 0.0 };
    /// True if audio playback is paused
    bool                mPaused;
    PaStream           *mPortStreamV19;
    bool                mSoftwarePlaythrough;
+   /// True while opening a monitoring stream with preference
+   /// "/AudioIO/LowLatencyMonitoring"
+   bool                mLowLatencyMonitoring { false };
+   double              mRoundTripLatency { 0.0 };
+   /// Names the host and devices of a duplex stream, for DeviceManager's
+   /// measured latencies
+   wxString            mLatencyDeviceKey;
    /// True if Sound Activated Recording is enabled
    bool                mPauseRec;
-   float               mSilenceLevel;
+   int                 mSilenceLevelDB;
+   SoundActivationDetector mSoundActivation;
+   // Whether the audio thread asked for a pause or resume that
+   // ControlToolBar has not yet done
+   bool                mPauseRecPending { false };
+   bool                mPauseRecPendingFrom { false };
    unsigned int        mNumCaptureChannels;
    unsigned int        mNumPlaybackChannels;
    sampleFormat        mCaptureFormat;
@@ -444,6 +813,8 @@ private:
    volatile bool       mAudioThreadShouldCallFillBuffersOnce;
    volatile bool       mAudioThreadFillBuffersLoopRunning;
    volatile bool       mAudioThreadFillBuffersLoopActive;
+   wxSemaphore         mAudioThreadWakeup;
+   std::atomic<bool>   mAudioThreadWakeupPending { false };
 
    wxLongLong          mLastPlaybackTimeMillis;
 
@@ -473,8 +844,9 @@ private:
    }                   mPlayMode;
    double              mCutPreviewGapStart;
    double              mCutPreviewGapLen;
+   // Whether the mixers have jumped over the gap
+   bool                mCutPreviewGapPassed { false };
 
-   GrowableSampleBuffer mSilentBuf;
 
    AudioIOListener*    mListener;
 
@@ -536,6 +908,8 @@ private:
    std::vector< std::pair<double, double> > mLostCaptureIntervals;
    bool mDetectDropouts{ true };
 
+   AudioIOTelemetry mTelemetry;
+
 public:
    // Pairs of starting time and duration
    const std::vector< std::pair<double, double> > &LostCaptureIntervals()
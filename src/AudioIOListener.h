@@ -13,8 +13,13 @@
 #ifndef __AUDACITY_AUDIO_IO_LISTENER__
 #define __AUDACITY_AUDIO_IO_LISTENER__
 
+#include <memory>
+#include <vector>
 #include <wx/string.h>
 
+class WaveTrack;
+using WaveTrackArray = std::vector < std::shared_ptr < WaveTrack > >;
+
 class AUDACITY_DLL_API AudioIOListener /* not final */ {
 public:
    AudioIOListener() {}
@@ -25,6 +30,10 @@ public:
 
    virtual void OnAudioIOStartRecording() = 0;
    virtual void OnAudioIOStopRecording() = 0;
+
+   // Called on the audio thread, every few seconds of recording; must
+   // not wait on the disk
+   virtual void OnAudioIOCheckpoint(const WaveTrackArray &captureTracks) = 0;
 };
 
 #endif
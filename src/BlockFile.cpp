@@ -42,8 +42,11 @@ out.
 #include "Audacity.h"
 #include "BlockFile.h"
 
+#include <algorithm>
+#include <chrono>
 #include <float.h>
 #include <cmath>
+#include <functional>
 #include "../src/FileException.h"
 
 #include <wx/utils.h>
@@ -56,6 +59,11 @@ out.
 #include "sndfile.h"
 #include "FileFormats.h"
 #include "AudacityApp.h"
+#include "DirManager.h"
+#include "blockfile/AliasFile.h"
+#include "blockfile/BlockIOStats.h"
+#include "blockfile/BlockReaper.h"
+#include "SampleConvert.h"
 
 // msmeyer: Define this to add debug output via wxPrintf()
 //#define DEBUG_BLOCKFILE
@@ -68,6 +76,70 @@ out.
 #define BLOCKFILE_DEBUG_OUTPUT(op, i)
 #endif
 
+// Vector kernels for the summary of a full frame of 256 samples.  SSE2 is
+// part of every x86-64 processor, and NEON of every 64 bit ARM, so these
+// are chosen at compile time; other targets use the scalar loop.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLOCKFILE_SUMMARY_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define BLOCKFILE_SUMMARY_NEON
+#endif
+
+namespace {
+
+void Summarize256(const float *samples, float &min, float &max, float &sumsq)
+{
+#if defined(BLOCKFILE_SUMMARY_SSE2)
+   __m128 v = _mm_loadu_ps(samples);
+   __m128 vmin = v, vmax = v, vsum = _mm_mul_ps(v, v);
+   for (int j = 4; j < 256; j += 4) {
+      v = _mm_loadu_ps(samples + j);
+      vmin = _mm_min_ps(vmin, v);
+      vmax = _mm_max_ps(vmax, v);
+      vsum = _mm_add_ps(vsum, _mm_mul_ps(v, v));
+   }
+   float mins[4], maxes[4], sums[4];
+   _mm_storeu_ps(mins, vmin);
+   _mm_storeu_ps(maxes, vmax);
+   _mm_storeu_ps(sums, vsum);
+   min = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+   max = std::max(std::max(maxes[0], maxes[1]), std::max(maxes[2], maxes[3]));
+   sumsq = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#elif defined(BLOCKFILE_SUMMARY_NEON)
+   float32x4_t v = vld1q_f32(samples);
+   float32x4_t vmin = v, vmax = v, vsum = vmulq_f32(v, v);
+   for (int j = 4; j < 256; j += 4) {
+      v = vld1q_f32(samples + j);
+      vmin = vminq_f32(vmin, v);
+      vmax = vmaxq_f32(vmax, v);
+      vsum = vmlaq_f32(vsum, v, v);
+   }
+   float mins[4], maxes[4], sums[4];
+   vst1q_f32(mins, vmin);
+   vst1q_f32(maxes, vmax);
+   vst1q_f32(sums, vsum);
+   min = std::min(std::min(mins[0], mins[1]), std::min(mins[2], mins[3]));
+   max = std::max(std::max(maxes[0], maxes[1]), std::max(maxes[2], maxes[3]));
+   sumsq = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+#else
+   min = max = samples[0];
+   sumsq = samples[0] * samples[0];
+   for (int j = 1; j < 256; j++) {
+      const float f1 = samples[j];
+      sumsq += f1 * f1;
+      if (f1 < min)
+         min = f1;
+      else if (f1 > max)
+         max = f1;
+   }
+#endif
+}
+
+}
+
 static const int headerTagLen = 20;
 static char headerTag[headerTagLen + 1] = "AudacityBlockFile112";
 
@@ -101,7 +173,7 @@ ArrayOf<char> BlockFile::fullSummary;
 /// @param samples  The number of samples this BlockFile contains.
 BlockFile::BlockFile(wxFileNameWrapper &&fileName, size_t samples):
    mLockCount(0),
-   mFileName(std::move(fileName)),
+   mFileName(fileName),
    mLen(samples),
    mSummaryInfo(samples)
 {
@@ -114,8 +186,9 @@ unsigned long BlockFile::gBlockFileDestructionCount { 0 };
 BlockFile::~BlockFile()
 {
    if (!IsLocked() && mFileName.HasName())
-      // PRL: what should be done if this fails?
-      wxRemoveFile(mFileName.GetFullPath());
+      // Removed on another thread, so that letting go of many blocks at
+      // once, as closing a project does, doesn't wait on the disk
+      DirManager::GetBlockReaper().RemoveFile(mFileName.GetFullPath());
 
    ++gBlockFileDestructionCount;
 }
@@ -127,13 +200,13 @@ BlockFile::~BlockFile()
 ///  disk and have empty file names)
 auto BlockFile::GetFileName() const -> GetFileNameResult
 {
-   return { mFileName };
+   return { mFileName.Get() };
 }
 
 ///sets the file name the summary info will be saved in.  threadsafe.
 void BlockFile::SetFileName(wxFileNameWrapper &&name)
 {
-   mFileName=std::move(name);
+   mFileName = BlockFileName{ name };
 }
 
 
@@ -216,21 +289,25 @@ void BlockFile::CalcSummaryFromBuffer(const float *fbuffer, size_t len,
    int summaries = 256;
 
    for (decltype(sumLen) i = 0; i < sumLen; i++) {
-      min = fbuffer[i * 256];
-      max = fbuffer[i * 256];
-      sumsq = ((float)min) * ((float)min);
       decltype(len) jcount = 256;
       if (jcount > len - i * 256) {
          jcount = len - i * 256;
          fraction = 1.0 - (jcount / 256.0);
       }
-      for (decltype(jcount) j = 1; j < jcount; j++) {
-         float f1 = fbuffer[i * 256 + j];
-         sumsq += ((float)f1) * ((float)f1);
-         if (f1 < min)
-            min = f1;
-         else if (f1 > max)
-            max = f1;
+      if (jcount == 256)
+         Summarize256(fbuffer + i * 256, min, max, sumsq);
+      else {
+         min = fbuffer[i * 256];
+         max = fbuffer[i * 256];
+         sumsq = ((float)min) * ((float)min);
+         for (decltype(jcount) j = 1; j < jcount; j++) {
+            float f1 = fbuffer[i * 256 + j];
+            sumsq += ((float)f1) * ((float)f1);
+            if (f1 < min)
+               min = f1;
+            else if (f1 > max)
+               max = f1;
+         }
       }
 
       totalSquares += sumsq;
@@ -417,6 +494,7 @@ bool BlockFile::Read256(float *buffer,
                         size_t start, size_t len)
 {
    wxASSERT(start >= 0);
+   BlockIOStats::Add(BlockIOStats::SummaryReads);
 
    ArrayOf< char > summary;
    // In case of failure, summary is filled with zeroes
@@ -456,6 +534,7 @@ bool BlockFile::Read64K(float *buffer,
                         size_t start, size_t len)
 {
    wxASSERT(start >= 0);
+   BlockIOStats::Add(BlockIOStats::SummaryReads);
 
    ArrayOf< char > summary;
    // In case of failure, summary is filled with zeroes
@@ -481,6 +560,171 @@ bool BlockFile::Read64K(float *buffer,
    return result;
 }
 
+auto BlockFile::GetPyramid() -> const std::vector<PyramidLevel> &
+{
+   // Once built, the pyramid does not change, so callers may read it
+   // after the lock is released
+   ODLocker locker{ &mPyramidMutex };
+   if (!mPyramid.empty() || !IsSummaryAvailable())
+      return mPyramid;
+
+   const auto frames = mSummaryInfo.frames256;
+   Floats summary{ frames * 3 };
+   if (!Read256(summary.get(), 0, frames))
+      return mPyramid;
+
+   // Start from the 256 level, with counts of samples
+   PyramidLevel finer(frames);
+   for (size_t ii = 0; ii < frames; ++ii) {
+      const auto count =
+         ii * 256 < mLen ? std::min<size_t>(256, mLen - ii * 256) : 0;
+      const auto rms = summary[3 * ii + 2];
+      finer[ii] = { summary[3 * ii], summary[3 * ii + 1],
+                    rms * rms * count, float(count) };
+   }
+
+   // frames256 is a multiple of 256, so each level divides evenly
+   std::vector<PyramidLevel> pyramid;
+   for (size_t divisor = 1024; divisor <= 65536; divisor *= 4) {
+      PyramidLevel level(finer.size() / 4,
+                         PyramidFrame{ FLT_MAX, -FLT_MAX, 0, 0 });
+      for (size_t ii = 0; ii < finer.size(); ++ii) {
+         auto &frame = level[ii / 4];
+         const auto &part = finer[ii];
+         frame.min = std::min(frame.min, part.min);
+         frame.max = std::max(frame.max, part.max);
+         frame.sumsq += part.sumsq;
+         frame.count += part.count;
+      }
+      pyramid.push_back(level);
+      finer = std::move(level);
+   }
+
+   mPyramid.swap(pyramid);
+   return mPyramid;
+}
+
+bool BlockFile::ReadSummaryLevel(size_t divisor, float *buffer,
+                                 size_t start, size_t len)
+{
+   if (IsSilent()) {
+      ClearSamples((samplePtr)buffer, floatSample, 0, len * 3);
+      return true;
+   }
+
+   if (divisor == 256)
+      return Read256(buffer, start, len);
+
+   size_t index = 0;
+   for (size_t levelDivisor = 1024; levelDivisor < divisor; levelDivisor *= 4)
+      ++index;
+
+   const auto &pyramid = GetPyramid();
+   if (index >= pyramid.size()) {
+      if (divisor == 65536)
+         return Read64K(buffer, start, len);
+      ClearSamples((samplePtr)buffer, floatSample, 0, len * 3);
+      return false;
+   }
+
+   BlockIOStats::Add(BlockIOStats::SummaryReads);
+   const auto &level = pyramid[index];
+   start = std::min( start, level.size() );
+   len = std::min( len, level.size() - start );
+   for (size_t ii = 0; ii < len; ++ii) {
+      const auto &frame = level[start + ii];
+      buffer[3 * ii] = frame.min;
+      buffer[3 * ii + 1] = frame.max;
+      buffer[3 * ii + 2] =
+         frame.count > 0 ? sqrt(frame.sumsq / frame.count) : 0.0f;
+   }
+
+   return true;
+}
+
+auto BlockFile::GetMinMaxRMSFromSummary(size_t start, size_t len,
+                                        bool mayThrow) -> MinMaxRMS
+{
+   if (IsSilent())
+      return { 0.f, 0.f, 0.f };
+
+   // Frames cover [256 * first, 256 * last); those past the end of the
+   // block hold no samples
+   const auto end = start + len;
+   const size_t first = (start + 255) / 256;
+   const size_t last = (end == mLen) ? (mLen + 255) / 256 : end / 256;
+
+   // Only float summaries hold the exact extremes of float samples
+   if (first >= last || !IsSummaryAvailable() ||
+       mSummaryInfo.format != floatSample || mSummaryInfo.fields != 3)
+      return GetMinMaxRMS(start, len, mayThrow);
+
+   const auto &pyramid = GetPyramid();
+   if (pyramid.empty())
+      return GetMinMaxRMS(start, len, mayThrow);
+
+   float min = FLT_MAX, max = -FLT_MAX;
+   double sumsq = 0;
+   auto addSamples = [&](size_t from, size_t to) {
+      if (from >= to)
+         return;
+      const auto values = GetMinMaxRMS(from, to - from, mayThrow);
+      min = std::min(min, values.min);
+      max = std::max(max, values.max);
+      sumsq += double(values.RMS) * values.RMS * (to - from);
+   };
+   auto addFrame = [&](const PyramidFrame &frame) {
+      min = std::min(min, frame.min);
+      max = std::max(max, frame.max);
+      sumsq += frame.sumsq;
+   };
+
+   // Read the frames of the 256 level only if some are needed, and once
+   Floats summary256;
+   auto add256 = [&](size_t from, size_t to) {
+      if (!summary256) {
+         summary256.reinit(3 * (last - first));
+         Read256(summary256.get(), first, last - first);
+      }
+      for (auto ii = from; ii < to; ++ii) {
+         const auto count = ii * 256 < mLen
+            ? std::min<size_t>(256, mLen - ii * 256) : 0;
+         const auto rms = summary256[3 * (ii - first) + 2];
+         addFrame({ summary256[3 * (ii - first)],
+                    summary256[3 * (ii - first) + 1],
+                    rms * rms * count, float(count) });
+      }
+   };
+
+   // Cover [from, to) of the 256 level with the coarsest frames that fit,
+   // from pyramid level index down
+   std::function<void(size_t, size_t, int)> addFrames =
+   [&](size_t from, size_t to, int index) {
+      if (from >= to)
+         return;
+      if (index < 0) {
+         add256(from, to);
+         return;
+      }
+      const size_t ratio = size_t(4) << (2 * index);
+      const auto lo = (from + ratio - 1) / ratio, hi = to / ratio;
+      if (lo >= hi) {
+         addFrames(from, to, index - 1);
+         return;
+      }
+      addFrames(from, lo * ratio, index - 1);
+      for (auto ii = lo; ii < hi; ++ii)
+         addFrame(pyramid[index][ii]);
+      addFrames(hi * ratio, to, index - 1);
+   };
+
+   addSamples(start, std::min(end, first * 256));
+   addFrames(first, last, int(pyramid.size()) - 1);
+   addSamples(std::max(start, last * 256), end);
+
+   return { min, max, float(sqrt(sumsq / len)) };
+}
+
 size_t BlockFile::CommonReadData(
    bool mayThrow,
    const wxFileName &fileName, bool &mSilentLog,
@@ -519,21 +763,36 @@ size_t BlockFile::CommonReadData(
 
    wxFile f;   // will be closed when it goes out of scope
    SFFile sf;
-
-   {
+   const auto sndfileStart = std::chrono::steady_clock::now();
+
+   // Aliased files stay open between reads, in a table of all projects;
+   // readers of one file take turns, since they share its position
+   AliasFileTable::Ptr aliasFile;
+   Maybe<ODLocker> aliasFileLocker;
+   if (pAliasFile && !pLegacyFormat)
+      aliasFile = DirManager::GetAliasFiles().Acquire(fileName.GetFullPath());
+   SNDFILE *sndFile = nullptr;
+   if (aliasFile) {
+      aliasFileLocker.create(&aliasFile->GetLock());
+      sndFile = aliasFile->GetSndFile();
+      info = aliasFile->GetInfo();
+   }
+   else {
       Maybe<wxLogNull> silence{};
       if (mSilentLog)
          silence.create();
 
       const auto fullPath = fileName.GetFullPath();
       if (wxFile::Exists(fullPath) && f.Open(fullPath)) {
+         BlockIOStats::Add(BlockIOStats::FilesOpened);
          // Even though there is an sf_open() that takes a filename, use the one that
          // takes a file descriptor since wxWidgets can open a file with a Unicode name and
          // libsndfile can't (under Windows).
          sf.reset(SFCall<SNDFILE*>(sf_open_fd, f.fd(), SFM_READ, &info, FALSE));
+         sndFile = sf.get();
       }
 
-      if (!sf) {
+      if (!sndFile) {
 
          memset(data, 0, SAMPLE_SIZE(format)*len);
 
@@ -544,14 +803,19 @@ size_t BlockFile::CommonReadData(
          }
       }
    }
-   mSilentLog = !sf;
+   mSilentLog = !sndFile;
 
    size_t framesRead = 0;
-   if (sf) {
-      auto seek_result = SFCall<sf_count_t>(
-         sf_seek, sf.get(), ( origin + start ).as_long_long(), SEEK_SET);
-
-      if (seek_result < 0)
+   if (sndFile) {
+      const auto frame = ( origin + start ).as_long_long();
+      bool seek_result;
+      if (aliasFile)
+         seek_result = aliasFile->Seek(frame);
+      else
+         seek_result =
+            SFCall<sf_count_t>(sf_seek, sndFile, frame, SEEK_SET) >= 0;
+
+      if (!seek_result)
          // error
          ;
       else {
@@ -565,13 +829,13 @@ size_t BlockFile::CommonReadData(
             // If both the src and dest formats are integer formats,
             // read integers directly from the file, comversions not needed
             framesRead = SFCall<sf_count_t>(
-               sf_readf_short, sf.get(), (short *)data, len);
+               sf_readf_short, sndFile, (short *)data, len);
          }
          else if (channels == 1 &&
                   format == int24Sample &&
                   sf_subtype_is_integer(info.format)) {
             framesRead = SFCall<sf_count_t>(
-               sf_readf_int, sf.get(), (int *)data, len);
+               sf_readf_int, sndFile, (int *)data, len);
 
             // libsndfile gave us the 3 byte sample in the 3 most
             // significant bytes -- we want it in the 3 least
@@ -588,7 +852,7 @@ size_t BlockFile::CommonReadData(
             // case, as most audio files are 16-bit.
             SampleBuffer buffer(len * channels, int16Sample);
             framesRead = SFCall<sf_count_t>(
-               sf_readf_short, sf.get(), (short *)buffer.ptr(), len);
+               sf_readf_short, sndFile, (short *)buffer.ptr(), len);
             for (size_t i = 0; i < framesRead; i++)
                ((short *)data)[i] =
                ((short *)buffer.ptr())[(channels * i) + channel];
@@ -599,17 +863,31 @@ size_t BlockFile::CommonReadData(
             // then convert to whatever format we want.
             SampleBuffer buffer(len * channels, floatSample);
             framesRead = SFCall<sf_count_t>(
-               sf_readf_float, sf.get(), (float *)buffer.ptr(), len);
+               sf_readf_float, sndFile, (float *)buffer.ptr(), len);
             auto bufferPtr = (samplePtr)((float *)buffer.ptr() + channel);
-            CopySamples(bufferPtr, floatSample,
-                        (samplePtr)data, format,
-                        framesRead,
-                        true /* high quality by default */,
-                        channels /* source stride */);
+            if (format == floatSample && channels == 2)
+               // The usual case, a stereo file read for a track
+               ConvertSamples<floatSample, floatSample, NoDither, 2>(
+                  (const float *)bufferPtr, (float *)data, framesRead);
+            else
+               CopySamples(bufferPtr, floatSample,
+                           (samplePtr)data, format,
+                           framesRead,
+                           true /* high quality by default */,
+                           channels /* source stride */);
          }
+
+         if (aliasFile)
+            aliasFile->Advance(framesRead);
       }
    }
 
+   BlockIOStats::Add(BlockIOStats::BytesRead,
+                     framesRead * SAMPLE_SIZE(format));
+   BlockIOStats::Add(BlockIOStats::SndfileNanoseconds,
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+         std::chrono::steady_clock::now() - sndfileStart).count());
+
    if ( framesRead < len ) {
       if (mayThrow)
          throw FileException{ FileException::Cause::Read, fileName };
@@ -646,7 +924,7 @@ AliasBlockFile::AliasBlockFile(wxFileNameWrapper &&baseFileName,
       (baseFileName.SetExt(wxT("auf")), std::move(baseFileName)),
       aliasLen
    },
-   mAliasedFileName(std::move(aliasedFileName)),
+   mAliasedFileName(InternAliasedFileName(aliasedFileName)),
    mAliasStart(aliasStart),
    mAliasChannel(aliasChannel)
 {
@@ -660,7 +938,7 @@ AliasBlockFile::AliasBlockFile(wxFileNameWrapper &&existingSummaryFileName,
                                int aliasChannel,
                                float min, float max, float rms):
    BlockFile{ std::move(existingSummaryFileName), aliasLen },
-   mAliasedFileName(std::move(aliasedFileName)),
+   mAliasedFileName(InternAliasedFileName(aliasedFileName)),
    mAliasStart(aliasStart),
    mAliasChannel(aliasChannel)
 {
@@ -688,6 +966,12 @@ void AliasBlockFile::WriteSummary()
    // I would much rather have this code as part of the constructor, but
    // I can't call virtual functions from the constructor.  So we just
    // need to ensure that every derived class calls this in *its* constructor
+
+   // When recovering, make a NEW file, rather than write through a link
+   // that another project may share
+   if (wxFileExists(mFileName.GetFullPath()))
+      wxRemoveFile(mFileName.GetFullPath());
+
    wxFFile summaryFile(mFileName.GetFullPath(), wxT("wb"));
 
    if( !summaryFile.IsOpened() ){
@@ -698,11 +982,13 @@ void AliasBlockFile::WriteSummary()
       // If we can't write, there's nothing to do.
       return;
    }
+   BlockIOStats::Add(BlockIOStats::FilesOpened);
 
    ArrayOf<char> cleanup;
    void *summaryData = BlockFile::CalcSummary(sampleData.ptr(), mLen,
                                             floatSample, cleanup);
-   summaryFile.Write(summaryData, mSummaryInfo.totalSummaryBytes);
+   BlockIOStats::Add(BlockIOStats::BytesWritten,
+      summaryFile.Write(summaryData, mSummaryInfo.totalSummaryBytes));
 }
 
 AliasBlockFile::~AliasBlockFile()
@@ -740,8 +1026,10 @@ bool AliasBlockFile::ReadSummary(ArrayOf<char> &data)
       }
       else mSilentLog = FALSE; // worked properly, any future error is NEW
    }
+   BlockIOStats::Add(BlockIOStats::FilesOpened);
 
    auto read = summaryFile.Read(data.get(), mSummaryInfo.totalSummaryBytes);
+   BlockIOStats::Add(BlockIOStats::BytesRead, read);
    if (read != mSummaryInfo.totalSummaryBytes) {
       memset(data.get(), 0, mSummaryInfo.totalSummaryBytes);
       return false;
@@ -757,7 +1045,7 @@ bool AliasBlockFile::ReadSummary(ArrayOf<char> &data)
 /// DirManager::EnsureSafeFilename().
 void AliasBlockFile::ChangeAliasedFileName(wxFileNameWrapper &&newAliasedFile)
 {
-   mAliasedFileName = std::move(newAliasedFile);
+   mAliasedFileName = InternAliasedFileName(newAliasedFile);
 }
 
 auto AliasBlockFile::GetSpaceUsage() const -> DiskByteCount
@@ -13,6 +13,7 @@
 #define __AUDACITY_BLOCKFILE__
 
 #include "MemoryX.h"
+#include <vector>
 #include <wx/string.h>
 #include <wx/ffile.h>
 #include <wx/filename.h>
@@ -20,6 +21,7 @@
 #include "SampleFormat.h"
 
 #include "wxFileNameWrapper.h"
+#include "blockfile/BlockFileName.h"
 
 #include "ondemand/ODTaskThread.h"
 
@@ -85,16 +87,16 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    /// Gets the filename of the disk file associated with this BlockFile
    /// (can be empty -- some BlockFiles, like SilentBlockFile, correspond to
    ///  no file on disk)
-   /// Avoids copying wxFileName by returning a reference, but for some subclasses
-   /// of BlockFile, you must exclude other threads from changing the name so long
-   /// as you have only a reference.  Thus, this wrapper object that guarantees release
+   /// The name is made from the compact BlockFileName each time, but for some
+   /// subclasses of BlockFile, you must exclude other threads from changing the
+   /// name so long as you use it.  Thus, this wrapper object that guarantees release
    /// of any lock when it goes out of scope.  Call mLocker.reset() to unlock it sooner.
    struct GetFileNameResult {
-      const wxFileName &name;
+      const wxFileNameWrapper name;
       ODLocker mLocker;
 
-      GetFileNameResult(const wxFileName &name_, ODLocker &&locker = ODLocker{})
-      : name{ name_ }, mLocker{ std::move(locker) } {}
+      GetFileNameResult(wxFileNameWrapper &&name_, ODLocker &&locker = ODLocker{})
+      : name{ std::move(name_) }, mLocker{ std::move(locker) } {}
 
       GetFileNameResult(const GetFileNameResult&) PROHIBITED;
       GetFileNameResult &operator= (const GetFileNameResult&) PROHIBITED;
@@ -126,10 +128,34 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
    virtual bool Read256(float *buffer, size_t start, size_t len);
    /// Returns the 64K summary data block
    virtual bool Read64K(float *buffer, size_t start, size_t len);
+   /// Like Read256(), for frames of any divisor 256 * 4^n up to 64K.  The
+   /// levels above 256 are made from the 256 level when first needed, and
+   /// kept in memory.
+   bool ReadSummaryLevel(size_t divisor, float *buffer, size_t start, size_t len);
+   /// Like GetMinMaxRMS(start, len), but reads samples only at the ends of
+   /// the region, and takes the rest from the coarsest summary frames that
+   /// fit in it
+   MinMaxRMS GetMinMaxRMSFromSummary(size_t start, size_t len,
+                                     bool mayThrow = true);
 
    /// Returns TRUE if this block references another disk file
    virtual bool IsAlias() const { return false; }
 
+   /// Returns TRUE if this block holds only silence, and no disk file, so
+   /// that its samples and summaries need no reading
+   virtual bool IsSilent() const { return false; }
+
+   /// Returns TRUE if this block is a SliceBlockFile, a view of part of
+   /// another
+   virtual bool IsSlice() const { return false; }
+
+   /// Returns TRUE if this block's data are in a shared BlockPack file
+   virtual bool IsPacked() const { return false; }
+
+   /// Returns TRUE if this block is an alias that ODCopyInTask may yet make
+   /// self-contained
+   virtual bool CanCopyIn() const { return false; }
+
    /// Returns TRUE if this block's complete summary has been computed and is ready (for OD)
    virtual bool IsSummaryAvailable() const {return true;}
 
@@ -233,8 +259,20 @@ class PROFILE_DLL_API BlockFile /* not final, abstract */ {
 
    static ArrayOf<char> fullSummary;
 
+   // A summary frame, with sum of squares and count of samples in place of
+   // RMS, so that frames combine exactly
+   struct PyramidFrame { float min, max, sumsq, count; };
+   using PyramidLevel = std::vector<PyramidFrame>;
+
+   // Levels of divisor 1K, 4K, 16K and 64K, or none if not yet built or the
+   // summary can't be read
+   const std::vector<PyramidLevel> &GetPyramid();
+
+   ODLock mPyramidMutex;
+   std::vector<PyramidLevel> mPyramid;
+
  protected:
-   wxFileNameWrapper mFileName;
+   BlockFileName mFileName;
    size_t mLen;
    SummaryInfo mSummaryInfo;
    float mMin, mMax, mRMS;
@@ -277,7 +315,9 @@ class AliasBlockFile /* not final */ : public BlockFile
    //
    // These methods are for advanced use only!
    //
-   const wxFileName &GetAliasedFileName() const { return mAliasedFileName; }
+   const wxFileName &GetAliasedFileName() const { return *mAliasedFileName; }
+   sampleCount GetAliasStart() const { return mAliasStart; }
+   int GetAliasChannel() const { return mAliasChannel; }
    void ChangeAliasedFileName(wxFileNameWrapper &&newAliasedFile);
    bool IsAlias() const override { return true; }
 
@@ -288,7 +328,8 @@ class AliasBlockFile /* not final */ : public BlockFile
    /// Read the summary into a buffer
    bool ReadSummary(ArrayOf<char> &data) override;
 
-   wxFileNameWrapper mAliasedFileName;
+   // Shared by all blocks that point into the same file
+   std::shared_ptr<const wxFileNameWrapper> mAliasedFileName;
    sampleCount mAliasStart;
    const int         mAliasChannel;
    mutable bool        mSilentAliasLog;
@@ -7,22 +7,37 @@
 *******************************************************************//**
 
 \class CrossFader
-\brief Not used by Audacity (yet) apparently work in progress that has
-been abandoned.
+\brief Crossfades abutting clips of a WaveTrack during playback.
+
+Where one clip ends exactly where the next starts, as
+WaveClip::SharesBoundaryWithNextClip() tells, the waveform usually jumps,
+and plays as a click.  Mixer gives a CrossFader for each track the
+samples it reads, before it applies the envelope or resamples them, and
+the CrossFader replaces those near each boundary.
+
+Abutting clips have no samples in common to fade between, so each clip
+continues past the boundary as its mirror image.  Around the boundary,
+the first clip and its mirror fade out while the second and its mirror
+fade in, with gains that add to one.  The result starts and ends on the
+original samples, whatever the jump was, and nothing is written to the
+clips, so there is no render pass and no new blocks.
+
+The fades come from a table made once, and the crossfaded samples of a
+boundary are computed once and then copied, however many buffers the
+boundary spans.
 
 *//********************************************************************/
 
 #include "CrossFade.h"
 
-#include "SampleFormat.h"
-#include "WaveClip.h"
+#include <algorithm>
+#include <cmath>
 
-#include <iostream>
-#include <vector>
+#include "WaveClip.h"
+#include "WaveTrack.h"
 
-using std::vector;
-using std::cout;
-using std::endl;
+// Steepness of the exponential fade
+static const double kExponent = 4.0;
 
 CrossFader::CrossFader():
   mType(FT_MIX)
@@ -35,259 +50,130 @@ CrossFader::~CrossFader()
 {
 }
 
-
-
-bool CrossFader::GetSamples(samplePtr buffer, sampleFormat format,
-                            sampleCount start, size_t len)
+float CrossFader::FadeOut(size_t index, size_t length) const
 {
+   // At the middle of each sample, so that the fades are symmetric
+   const double x = (index + 0.5) / length;
    switch (mType)
    {
-   case FT_MIX:
-      return CrossFadeMix(buffer,format, start,len);
-      break;
    case FT_TRIANGULAR:
-      return CrossFadeMix(buffer,format, start,len);
-      break;
+      return 1.0 - x;
    case FT_EXPONENTIAL:
+      return (exp(-kExponent * x) - exp(-kExponent)) /
+         (1.0 - exp(-kExponent));
+   case FT_MIX:
    default:
-      return CrossFadeMix(buffer,format, start,len);
-      break;
-
+      return 0.5 + 0.5 * cos(2 * acos(0.0) * x);
    }
-
 }
 
-bool CrossFader::CrossFadeMix(samplePtr buffer, sampleFormat format, sampleCount start, size_t len)
+void CrossFader::MakeTables()
 {
+   mFadeOut.reinit(mLength);
+   for (size_t ii = 0; ii < mLength; ++ii)
+      mFadeOut[ii] = FadeOut(ii, mLength);
 
-   std::cout << "Crossfading from " << start.as_long_long()
-      << " to " << ( len + start ).as_long_long()
-      << std::endl;
-
-   // start refers to the position in the wave.
-
-
-   //just mix the right things together.
-
-
-   //For each relevant clip, we need to construct a buffer.
-   //we should use one of the size len, because this has already
-   //been determined to be good in Mixer
-
-   //Go through each clip, adding it to the total in the appropriate way.
-
-   //this could be 'optimized' by getting all of the sequences and then
-   //iterating through each of them.
-
-   int numclips = mClips.size();
-
-   //create vectors to store the important info for each clip.
-   std::vector<sampleCount> clipStart(numclips);
-   std::vector<sampleCount> clipLength(numclips);
-   std::vector<Sequence*> tmpSequence(numclips);
-
-
-   unsigned int i = 0;
-   //Now, go through the clips and load up the vectors.
-   for(const auto &tmpclip: mClips)
-   {
-      tmpSequence[i] = tmpclip->GetSequence();
-
-
-      //start is the position of the beginning of the buffer
-      //relative to the beginning of the clip.  It could be negative.
-      clipStart[i]= start - tmpclip->GetStartSample();
-
-
-
-      //determine the index of the last sample to get, relative to the start of the clip
-
-      //it will be no longer than  the clip itself.
-      clipLength[i] = tmpclip->GetNumSamples()-clipStart[i];
+   // Fades made with another table are stale
+   mWindowIndex = mBoundaries.size();
+}
 
-      std::cout << "X:" <<  " "
-         << clipLength[i].as_long_long()
-         << "  "
-         << tmpclip->GetStartSample().as_long_long()
-         <<  " ";
-      //if the buffer ends before the clip does, adjust the length
-      if(clipStart[i] + len   < clipLength[i])
-      {
-         clipLength[i] = len  +  clipStart[i];
+void CrossFader::SetTrack(const WaveTrack *track, size_t fadeLength)
+{
+   mTrack = track;
+   mBoundaries.clear();
+
+   // An even length, so the boundary is in the middle
+   const size_t half = fadeLength / 2;
+   mLength = 2 * half;
+   if (track && half > 0) {
+      const auto clips = track->SortedClipArray();
+      for (size_t ii = 1; ii < clips.size(); ++ii) {
+         const auto prev = clips[ii - 1], next = clips[ii];
+         if (!prev->SharesBoundaryWithNextClip(next))
+            continue;
+
+         // Fade over no more than half of either clip, so that the fades
+         // at both ends of a short clip do not meet
+         const auto shortest =
+            std::min(prev->GetNumSamples(), next->GetNumSamples());
+         const auto clipHalf = limitSampleBufferSize(half, shortest / 2);
+         if (clipHalf > 0)
+            mBoundaries.push_back({ next->GetStartSample(), clipHalf });
       }
-      std::cout
-         << clipStart[i].as_long_long()
-         << " "
-         << clipLength[i].as_long_long()
-         << " "
-         << ( clipLength[i] - clipStart[i] ).as_long_long()
-         <<  std::endl;
    }
-   std::cout << "-------------\n";
-
-   //Now, determine the sample format:
-   switch(format) {
-   case int16Sample:
-   {
-      std::cout << "int\n";
-      short *dest = (short *)buffer;
-      vector<short*> shortSeq;
-
-      //Copy the sequences over to the NEW vector, casting as you go.
-      for(int i = 0; i < numclips; i++)
-         // PRL: what the ... ?  This cast is just wrong!
-         shortSeq.push_back((short*)tmpSequence[i]);
 
+   mRaw.reinit(mLength);
+   mWindow.reinit(mLength);
+   MakeTables();
+}
 
-      int clips;
-      double f;
-      //now, shortSeq contains the samples to mix together.
-      for (int j = 0; j < len; j++)
-      {
-
-         //Go through each clip
-         for(int i = 0; i < numclips; i++)
-         {
-            clips = 0;
-            f = 0;
-            if(j + clipStart[i] >= 0 &&
-               clipStart[i]+len < clipLength[i])//only copy if we are within the clip
-            {
-               // UNSAFE_SAMPLE_COUNT_TRUNCATION
-               // -- but class CrossFader is not used as of this writing
-               f += shortSeq[ i ][ j+ clipStart[i].as_long_long() ];
-               clips++;
-            }
-
-            f/= clips;
-
-            //Do bounds-checking
-            if (f > 32767)
-               f = 32767;
-            if (f < -32768)
-               f = -32768;
+bool CrossFader::Overlaps(sampleCount start, size_t len) const
+{
+   // The first boundary whose fade ends after start
+   const auto end = start + len;
+   const auto found = std::upper_bound(mBoundaries.begin(), mBoundaries.end(),
+      start, [](sampleCount value, const Boundary &boundary) {
+         return value < boundary.position + boundary.half;
+      });
+   return found != mBoundaries.end() &&
+      found->position - found->half < end;
+}
 
-            //Set value
-            *dest = (short)f;
-         }
-         dest++;
+void CrossFader::FillWindow(size_t index)
+{
+   const auto &boundary = mBoundaries[index];
+   const auto half = boundary.half;
+   const auto length = 2 * half;
+
+   // On failure the samples are zeroes, as the cache would give
+   mTrack->Get((samplePtr)mRaw.get(), floatSample,
+      boundary.position - half, length, fillZero, false);
+
+   // The mirror of the other side stands in for the clip that is absent
+   const float *raw = mRaw.get();
+   float *window = mWindow.get();
+   if (half * 2 == mLength) {
+      const float *fadeOut = mFadeOut.get();
+      for (size_t ii = 0; ii < length; ++ii) {
+         const float mirror = raw[length - 1 - ii];
+         const float first = ii < half ? raw[ii] : mirror;
+         const float second = ii < half ? mirror : raw[ii];
+         window[ii] = second + (first - second) * fadeOut[ii];
       }
    }
-   break;
-
-
-   case int24Sample:
-   {
-      std::cout << "int24\n";
-      int *dest = (int *)buffer;
-      vector<int *> intSeq;
-
-
-      //Copy the sequences over to the NEW vector, casting as you go.
-      for(int i = 0; i < numclips; i++)
-         // Murder most foul!  As in the best it is,
-         // But this most foul, strange, and unnatural.
-         intSeq.push_back((int*)tmpSequence[i]);
-
-      int clips=0;
-      double f;
-      //Go through each sample position
-      for (int j = 0; j < len; j++) {
-
-         //go through each clip.
-         for(int i= 0; i < numclips; i++)
-         {
-            clips = 0;
-            f = 0;
-
-            //only copy if we are within the clip
-            if(j + clipStart[i] >= 0 && clipStart[i] + len < clipLength[i])
-            {
-               // UNSAFE_SAMPLE_COUNT_TRUNCATION
-               // -- but class CrossFader is not used as of this writing
-               f+= intSeq[ i ][ j + clipStart[ i ].as_long_long() ];
-               clips++;
-            }
-
-            f /= clips;
-
-            if (f > 8388607)
-               f = 8388607;
-            if (f < -8388608)
-               f = -8388608;
-            *dest = (int)f;
-
-         }
-         dest ++;
+   else {
+      // A clip shorter than the fade; no table for this length
+      for (size_t ii = 0; ii < length; ++ii) {
+         const float mirror = raw[length - 1 - ii];
+         const float first = ii < half ? raw[ii] : mirror;
+         const float second = ii < half ? mirror : raw[ii];
+         window[ii] = second + (first - second) * FadeOut(ii, length);
       }
    }
-   break;
-
-
-   case floatSample: {
-      std::cout << "float\n";
-      float *dest = (float *)buffer;
-      vector<float*> floatSeq;
-
-      int clips = 0;
-      float f;
-
-      //go through each sample position
-      for (int j = 0; j < len; j++) {
-
-
-         clips = 0;
-         f = 0;
-
-         for(int i = 0; i < numclips; i++)
-         {
-
-            cout << numclips << " " ;
 
-            cout <<f << " " ;
-
-            if(j + clipStart[i] >= 0 &&
-               clipStart[i] + j < clipLength[i])//only copy if we are within the clip
-            {
-               // UNSAFE_SAMPLE_COUNT_TRUNCATION
-               // -- but class CrossFader is not used as of this writing
-               // -- hey wait, you never even tried to initialize floatSeq,
-               // not even with bad casts!!!
-               // Subscripts out of bounds, bombs away!!!
-               f += floatSeq[ i ][ ( j + clipStart[ i ] ).as_long_long() ];
-               clips++;
-            }
-            cout << f << " "<< i << " "
-               << floatSeq[ i ][ j + clipStart[ i ].as_long_long() ] << "|";
-         }
-         if(clips == 0)
-            *dest = 0.0f;
-         else
-         {
-
-            f /= clips;
-            cout << f << "--";
-            // MM: XXX Should probably go outside the loop
-            if (f > 1.0f)
-               *dest = 1.0f;
-            else if (f < -1.0f)
-               *dest = -1.0f;
-            else
-               *dest = (float)f;
-
-         }
-         cout << *dest << endl;
-         dest++;
-      }
-   } break;
-   } // switch
-
-
-   return true;
+   mWindowIndex = index;
 }
 
-
-void CrossFader::ClearClips()
+void CrossFader::Apply(float *buffer, sampleCount start, size_t len)
 {
-   mClips.clear();
+   const auto end = start + len;
+   auto found = std::upper_bound(mBoundaries.begin(), mBoundaries.end(),
+      start, [](sampleCount value, const Boundary &boundary) {
+         return value < boundary.position + boundary.half;
+      });
+
+   for (; found != mBoundaries.end() &&
+          found->position - found->half < end; ++found) {
+      const size_t index = found - mBoundaries.begin();
+      if (index != mWindowIndex)
+         FillWindow(index);
+
+      // The part of the fade within the buffer
+      const auto fadeStart = found->position - found->half;
+      const auto from = std::max(start, fadeStart);
+      const auto to = std::min(end, found->position + found->half);
+      std::copy(mWindow.get() + (from - fadeStart).as_size_t(),
+                mWindow.get() + (to - fadeStart).as_size_t(),
+                buffer + (from - start).as_size_t());
+   }
 }
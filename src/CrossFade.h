@@ -11,13 +11,15 @@
 #ifndef __AUDACITY_CROSSFADE__
 #define __AUDACITY_CROSSFADE__
 
-/// This defines a crossfader class that
-/// accepts a list of WaveClips and can do a mini-mixing
-/// to produce the desired crossfading
+/// This defines a crossfader class that finds where the clips of
+/// a WaveTrack abut, and crossfades them there as Mixer reads them
 
+#include "MemoryX.h"
 #include "SampleFormat.h"
-#include "WaveClip.h"
 
+#include <vector>
+
+class WaveTrack;
 
 enum FadeType
 {
@@ -33,27 +35,53 @@ class CrossFader
   CrossFader();
   ~CrossFader();
 
-  //This sets a crossfade mode where the overlapping
-  //tracks are simply mixed equally.
-  void SetMixCrossFade(){mType = FT_MIX;};
-  void SetTriangularCrossFade(){mType = FT_TRIANGULAR;};
-  void SetExponentialCrossFade(){mType = FT_EXPONENTIAL;};
+  CrossFader(const CrossFader&) PROHIBITED;
+  CrossFader &operator= (const CrossFader&) PROHIBITED;
+
+  //This sets a crossfade mode where the clips are mixed with
+  //equal gain, along a raised cosine, a line or an exponential.
+  void SetMixCrossFade(){mType = FT_MIX; MakeTables();};
+  void SetTriangularCrossFade(){mType = FT_TRIANGULAR; MakeTables();};
+  void SetExponentialCrossFade(){mType = FT_EXPONENTIAL; MakeTables();};
 
-  void ClearClips();
-  //Produces samples according to crossfading rules.
-  bool  GetSamples(samplePtr buffer, sampleFormat format,
-                   sampleCount start, size_t len);
+  /// Finds the boundaries where clips of the track abut, and fades over
+  /// this many samples of the track around each; zero disables it.
+  /// Call again when the clips change.
+  void SetTrack(const WaveTrack *track, size_t fadeLength);
 
- protected:
-  WaveClipHolders mClips;
+  /// Whether any fade meets the samples of the track from start
+  bool Overlaps(sampleCount start, size_t len) const;
+
+  /// Buffer holds samples of the track from start; overwrites those
+  /// within the fades with the crossfaded samples
+  void Apply(float *buffer, sampleCount start, size_t len);
 
  private:
 
-  bool CrossFadeMix(samplePtr buffer, sampleFormat format, sampleCount start, size_t len);
+  struct Boundary {
+     sampleCount position;
+     // Samples faded on either side; fewer than half the fade when a
+     // clip is shorter than the fade
+     size_t half;
+  };
+
+  void MakeTables();
+  float FadeOut(size_t index, size_t length) const;
+  // Computes the fade around mBoundaries[index] into mWindow
+  void FillWindow(size_t index);
 
+  const WaveTrack *mTrack { nullptr };
   FadeType mType;
+  size_t mLength { 0 };
+  std::vector<Boundary> mBoundaries;
 
+  // The fade out of the first clip, for the full length; the second clip
+  // fades in by the complement
+  Floats mFadeOut;
 
+  Floats mRaw, mWindow;
+  // Which boundary mWindow holds; none, if not less than mBoundaries.size()
+  size_t mWindowIndex { 0 };
 };
 
 
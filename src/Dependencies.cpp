@@ -44,10 +44,13 @@ AliasedFile s.
 #include <wx/hashmap.h>
 #include <wx/progdlg.h>
 #include <wx/choice.h>
+#include <wx/evtloop.h>
+#include <wx/thread.h>
 
 #include "BlockFile.h"
 #include "DirManager.h"
 #include "Internat.h"
+#include "MixerPool.h"
 #include "Prefs.h"
 #include "Project.h"
 #include "Sequence.h"
@@ -56,8 +59,15 @@ AliasedFile s.
 #include "WaveClip.h"
 #include "widgets/ErrorDialog.h"
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <vector>
+
 #ifndef __AUDACITY_OLD_STD__
 #include <unordered_map>
+#include <unordered_set>
 #endif
 
 using AliasedFileHash = std::unordered_map<wxString, AliasedFile*>;
@@ -65,7 +75,6 @@ using AliasedFileHash = std::unordered_map<wxString, AliasedFile*>;
 // These two hash types are used only inside short scopes
 // so it is safe to key them by plain pointers.
 using ReplacedBlockFileHash = std::unordered_map<BlockFile *, BlockFilePtr>;
-using BoolBlockFileHash = std::unordered_map<BlockFile *, bool>;
 
 // Given a project, returns a single array of all SeqBlocks
 // in the current set of tracks.  Enumerating that array allows
@@ -110,6 +119,100 @@ static void ReplaceBlockFiles(BlockPtrArray &blocks,
    }
 }
 
+namespace {
+
+// Runs job(0) ... job(count - 1) on as many threads as there are
+// processors, and rethrows the first exception of any, when all are done
+void RunJobs(size_t count, const MixerPool::Job &job)
+{
+   if (count == 0)
+      return;
+
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   MixerPool pool{ unsigned(std::min<size_t>(nThreads, count) - 1) };
+   std::vector<std::exception_ptr> errors(count);
+   pool.Run(count, [&](size_t ii) {
+      // Exceptions must not escape the helper threads
+      try {
+         job(ii);
+      }
+      catch (...) {
+         errors[ii] = std::current_exception();
+      }
+   });
+
+   for (auto &error : errors)
+      if (error)
+         std::rethrow_exception(error);
+}
+
+// Does some work on a thread of its own, so that the main thread is free
+// for the progress dialog
+class DependencyThread final : public wxThread
+{
+public:
+   explicit DependencyThread(std::function< void() > work)
+      : wxThread{ wxTHREAD_JOINABLE }
+      , mWork{ std::move(work) }
+   {}
+
+   // Also called on the main thread, if no thread could start
+   void RunAll()
+   {
+      try {
+         mWork();
+      }
+      catch (...) {
+         mError = std::current_exception();
+      }
+      mDone = true;
+   }
+
+   bool IsDone() const { return mDone; }
+
+   // Call after Wait()
+   void RethrowError() const
+   {
+      if (mError)
+         std::rethrow_exception(mError);
+   }
+
+protected:
+   ExitCode Entry() override
+   {
+      RunAll();
+      return 0;
+   }
+
+private:
+   const std::function< void() > mWork;
+   std::exception_ptr mError;
+   std::atomic<bool> mDone{ false };
+};
+
+// Each alias block file of the blocks once, in the order first met,
+// though blocks may share them
+std::vector<AliasBlockFile*> GetAliasBlockFiles(const BlockPtrArray &blocks)
+{
+   std::vector<AliasBlockFile*> result;
+   std::unordered_set<BlockFile*> seen;
+   for (const auto &blockFile : blocks) {
+      const auto &f = blockFile->f;
+      if (f->IsAlias() && seen.insert(&*f).second)
+         result.push_back(static_cast<AliasBlockFile*>(&*f));
+   }
+   return result;
+}
+
+// Alias block files to find the files of, in one job of FindDependencies()
+const size_t kScanChunk = 4096;
+
+// Alias block files to copy, in one job of RemoveDependencies(), all of one
+// source, read through in order
+const size_t kCopyRun = 64;
+
+}
+
 void FindDependencies(AudacityProject *project,
                       AliasedFileArray &outAliasedFiles)
 {
@@ -117,17 +220,24 @@ void FindDependencies(AudacityProject *project,
 
    BlockPtrArray blocks;
    GetAllSeqBlocks(project, &blocks);
-
-   AliasedFileHash aliasedFileHash;
-   BoolBlockFileHash blockFileHash;
-
-   for (const auto &blockFile : blocks) {
-      const auto &f = blockFile->f;
-      if (f->IsAlias() && (blockFileHash.count( &*f ) == 0))
-      {
-         // f is an alias block we have not yet counted.
-         blockFileHash[ &*f ] = true; // Don't count the same blockfile twice.
-         auto aliasBlockFile = static_cast<AliasBlockFile*>( &*f );
+   const auto aliasBlockFiles = GetAliasBlockFiles(blocks);
+
+   // Work out the paths on all cores, in chunks of the alias block files,
+   // each chunk listing its files in the order first met and their bytes
+   struct ChunkFile {
+      wxFileName fileName;
+      wxString fileNameStr;
+      wxLongLong byteCount;
+   };
+   const auto nChunks = (aliasBlockFiles.size() + kScanChunk - 1) / kScanChunk;
+   std::vector< std::vector<ChunkFile> > chunks(nChunks);
+   RunJobs(nChunks, [&](size_t ii) {
+      auto &files = chunks[ii];
+      std::unordered_map<wxString, size_t> fileIndex;
+      const auto begin = ii * kScanChunk;
+      const auto end = std::min(begin + kScanChunk, aliasBlockFiles.size());
+      for (auto jj = begin; jj < end; ++jj) {
+         const auto aliasBlockFile = aliasBlockFiles[jj];
          const wxFileName &fileName = aliasBlockFile->GetAliasedFileName();
 
          // In DirManager::ProjectFSCK(), if the user has chosen to
@@ -136,30 +246,50 @@ void FindDependencies(AudacityProject *project,
          if (!fileName.IsOk())
             continue;
 
-         const wxString &fileNameStr = fileName.GetFullPath();
+         auto fileNameStr = fileName.GetFullPath();
          auto blockBytes = (SAMPLE_SIZE(format) *
                            aliasBlockFile->GetLength());
-         if (aliasedFileHash.count(fileNameStr) > 0)
-            // Already put this AliasBlockFile in aliasedFileHash.
-            // Update block count.
-            aliasedFileHash[fileNameStr]->mByteCount += blockBytes;
+         auto found = fileIndex.find(fileNameStr);
+         if (found != fileIndex.end())
+            files[found->second].byteCount += blockBytes;
+         else {
+            fileIndex.emplace(fileNameStr, files.size());
+            files.push_back(
+               { fileName, std::move(fileNameStr), wxLongLong(blockBytes) });
+         }
+      }
+   });
+
+   // Merge the chunks in order, so that the files are listed as they were
+   // when this was done on one thread
+   AliasedFileHash aliasedFileHash;
+   std::vector<AliasedFile*> newFiles;
+   for (auto &files : chunks) {
+      for (auto &file : files) {
+         auto &pAliasedFile = aliasedFileHash[file.fileNameStr];
+         if (pAliasedFile)
+            // Already listed this file.  Update block count.
+            pAliasedFile->mByteCount += file.byteCount;
          else
          {
-            // Haven't counted this AliasBlockFile yet.
-            // Add to return array and internal hash.
-
             // PRL: do this in two steps so that we move instead of copying.
             // We don't have a moving push_back in all compilers.
             outAliasedFiles.push_back(AliasedFile{});
             outAliasedFiles.back() =
                AliasedFile {
-                  wxFileNameWrapper { fileName },
-                  wxLongLong(blockBytes), fileName.FileExists()
+                  wxFileNameWrapper { file.fileName },
+                  file.byteCount, false
                };
-            aliasedFileHash[fileNameStr] = &outAliasedFiles.back();
+            pAliasedFile = &outAliasedFiles.back();
+            newFiles.push_back(pAliasedFile);
          }
       }
    }
+
+   // Sources may be on slow or remote disks; look for them all at once
+   RunJobs(newFiles.size(), [&](size_t ii) {
+      newFiles[ii]->mbOriginalExists = newFiles[ii]->mFileName.FileExists();
+   });
 }
 
 // Given a project and a list of aliased files that should no
@@ -174,7 +304,6 @@ static void RemoveDependencies(AudacityProject *project,
    ProgressDialog progress
       (_("Removing Dependencies"),
       _("Copying audio data into project..."));
-   auto updateResult = ProgressResult::Success;
 
    // Hash aliasedFiles based on their full paths and
    // count total number of bytes to process.
@@ -189,44 +318,96 @@ static void RemoveDependencies(AudacityProject *project,
    BlockPtrArray blocks;
    GetAllSeqBlocks(project, &blocks);
 
-   const sampleFormat format = project->GetDefaultFormat();
-   ReplacedBlockFileHash blockFileHash;
-   wxLongLong completedBytes = 0;
-   for (const auto blockFile : blocks) {
-      const auto &f = blockFile->f;
-      if (f->IsAlias() && (blockFileHash.count( &*f ) == 0))
-      {
-         // f is an alias block we have not yet processed.
-         auto aliasBlockFile = static_cast<AliasBlockFile*>( &*f );
-         const wxFileName &fileName = aliasBlockFile->GetAliasedFileName();
-         const wxString &fileNameStr = fileName.GetFullPath();
-
+   // Group the alias block files to copy by their source, each group in the
+   // order of the source, so that each is read through from start to end
+   std::vector< std::vector<AliasBlockFile*> > groups;
+   {
+      std::unordered_map<wxString, size_t> groupIndex;
+      for (const auto aliasBlockFile : GetAliasBlockFiles(blocks)) {
+         const wxString &fileNameStr =
+            aliasBlockFile->GetAliasedFileName().GetFullPath();
          if (aliasedFileHash.count(fileNameStr) == 0)
             // This aliased file was not selected to be replaced. Skip it.
             continue;
+         auto found = groupIndex.emplace(fileNameStr, groups.size());
+         if (found.second)
+            groups.emplace_back();
+         groups[found.first->second].push_back(aliasBlockFile);
+      }
+   }
+   for (auto &group : groups)
+      std::sort(group.begin(), group.end(),
+         [](const AliasBlockFile *a, const AliasBlockFile *b) {
+            return std::make_pair(a->GetAliasStart(), a->GetAliasChannel()) <
+               std::make_pair(b->GetAliasStart(), b->GetAliasChannel());
+         });
+
+   // Each job copies a run of one group, so that one large source is still
+   // shared among the threads
+   struct Run {
+      AliasBlockFile *const *begin, *const *end;
+      std::vector<BlockFilePtr> copies;
+   };
+   std::vector<Run> runs;
+   for (const auto &group : groups)
+      for (size_t ii = 0; ii < group.size(); ii += kCopyRun)
+         runs.push_back({ group.data() + ii,
+            group.data() + std::min(ii + kCopyRun, group.size()), {} });
 
-         // Convert it from an aliased file to an actual file in the project.
-         auto len = aliasBlockFile->GetLength();
-         BlockFilePtr newBlockFile;
-         {
-            SampleBuffer buffer(len, format);
-            // We tolerate exceptions from NewSimpleBlockFile and so we
-            // can allow exceptions from ReadData too
-            f->ReadData(buffer.ptr(), format, 0, len);
-            newBlockFile =
-               dirManager->NewSimpleBlockFile(buffer.ptr(), len, format);
-         }
+   const sampleFormat format = project->GetDefaultFormat();
+   const wxLongLong_t totalBytes = totalBytesToProcess.GetValue();
+   std::atomic<wxLongLong_t> completedBytes{ 0 };
+   auto copyRun = [&](size_t ii) {
+      auto &run = runs[ii];
+      run.copies.reserve(run.end - run.begin);
+      SampleBuffer buffer;
+      size_t bufferLen = 0;
+      for (auto pp = run.begin; pp != run.end; ++pp) {
+         if (progress.Poll() != ProgressResult::Success)
+            return;
 
-         // Update our hash so we know what block files we've done
-         blockFileHash[ &*f ] = newBlockFile;
+         // Convert it from an aliased file to an actual file in the project.
+         const auto f = *pp;
+         auto len = f->GetLength();
+         if (len > bufferLen)
+            buffer.Allocate(bufferLen = len, format);
+         // We tolerate exceptions from NewSimpleBlockFile and so we
+         // can allow exceptions from ReadData too
+         f->ReadData(buffer.ptr(), format, 0, len);
+         run.copies.push_back(
+            dirManager->NewSimpleBlockFile(buffer.ptr(), len, format));
 
          // Update the progress bar
-         completedBytes += SAMPLE_SIZE(format) * len;
-         updateResult = progress.Update(completedBytes, totalBytesToProcess);
-         if (updateResult != ProgressResult::Success)
-            // leave the project unchanged
-            return;
+         progress.Publish(
+            completedBytes += SAMPLE_SIZE(format) * len, totalBytes);
       }
+   };
+
+   DependencyThread thread{ [&]{ RunJobs(runs.size(), copyRun); } };
+   if (thread.Run() != wxTHREAD_NO_ERROR)
+      thread.RunAll();
+   else {
+      while (!thread.IsDone()) {
+         wxMilliSleep(10);
+         // Take the clicks of the buttons, and the timer events of the
+         // dialog, which show what the workers publish
+         wxEventLoopBase::GetActive()->YieldFor(wxEVT_CATEGORY_UI |
+            wxEVT_CATEGORY_USER_INPUT | wxEVT_CATEGORY_TIMER);
+      }
+      thread.Wait();
+   }
+   thread.RethrowError();
+
+   if (progress.Poll() != ProgressResult::Success)
+      // leave the project unchanged
+      return;
+
+   // Update our hash so we know what block files we've done
+   ReplacedBlockFileHash blockFileHash;
+   for (const auto &run : runs) {
+      auto copy = run.copies.begin();
+      for (auto pp = run.begin; pp != run.end; ++pp)
+         blockFileHash[ *pp ] = *copy++;
    }
 
    // COMMIT OPERATIONS needing NOFAIL-GUARANTEE:
@@ -214,11 +214,26 @@ static void AddSources(int deviceIndex, int rate, std::vector<DeviceSourceMap> *
 
 /// Gets a NEW list of devices by terminating and restarting portaudio
 /// Assumes that DeviceManager is only used on the main thread.
+void DeviceManager::SetMeasuredLatency(const wxString &key, double seconds)
+{
+   mMeasuredLatencies[key] = seconds;
+}
+
+bool DeviceManager::GetMeasuredLatency(const wxString &key, double &seconds) const
+{
+   const auto iter = mMeasuredLatencies.find(key);
+   if (iter == mMeasuredLatencies.end())
+      return false;
+   seconds = iter->second;
+   return true;
+}
+
 void DeviceManager::Rescan()
 {
    // get rid of the previous scan info
    this->mInputDeviceSourceMaps.clear();
    this->mOutputDeviceSourceMaps.clear();
+   this->mMeasuredLatencies.clear();
 
    // if we are doing a second scan then restart portaudio to get NEW devices
    if (m_inited) {
@@ -237,6 +252,10 @@ void DeviceManager::Rescan()
       // FIXME: TRAP_ERR restarting PortAudio
       Pa_Terminate();
       Pa_Initialize();
+
+      // Device indices may have changed, and devices plugged in again may
+      // play other rates
+      AudioIO::RescanCachedRates();
    }
 
    // FIXME: TRAP_ERR PaErrorCode not handled in ReScan()
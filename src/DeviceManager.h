@@ -20,6 +20,7 @@
 
 #include "Experimental.h"
 
+#include <map>
 #include <vector>
 #include "wx/wx.h"
 
@@ -52,6 +53,16 @@ class DeviceManager final
    const std::vector<DeviceSourceMap> &GetInputDeviceMaps();
    const std::vector<DeviceSourceMap> &GetOutputDeviceMaps();
 
+   /// Whether the devices have been scanned, so that the maps come from
+   /// the cache and not from a scan
+   bool IsScanned() const { return m_inited; }
+
+   /// Input plus output latency, in seconds, last measured for a pair of
+   /// devices; the key is AudioIO's, naming the host and both devices.
+   /// Forgotten when the devices are rescanned.
+   void SetMeasuredLatency(const wxString &key, double seconds);
+   bool GetMeasuredLatency(const wxString &key, double &seconds) const;
+
  protected:
    //private constructor - Singleton.
    DeviceManager();
@@ -67,6 +78,8 @@ class DeviceManager final
    std::vector<DeviceSourceMap> mInputDeviceSourceMaps;
    std::vector<DeviceSourceMap> mOutputDeviceSourceMaps;
 
+   std::map<wxString, double> mMeasuredLatencies;
+
    static DeviceManager dm;
 };
 
@@ -66,6 +66,9 @@
 #include "MemoryX.h"
 
 #include <time.h> // to use time() for srand()
+#include <algorithm>
+#include <cmath>
+#include <string.h>
 
 #include <wx/defs.h>
 #include <wx/app.h>
@@ -77,13 +80,26 @@
 #include <wx/timer.h>
 #include <wx/intl.h>
 #include <wx/file.h>
+#include <wx/stopwatch.h>
 #include <wx/filename.h>
+#include <wx/thread.h>
 #include <wx/object.h>
 
 // chmod
 #ifdef __UNIX__
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#endif
+
+#if defined(__linux__)
+#include <linux/fiemap.h>
+#if !defined(FS_IOC_FIEMAP)
+// From linux/fs.h, which conflicts with other system headers
+#define FS_IOC_FIEMAP _IOWR('f', 11, struct fiemap)
+#endif
 #endif
 
 #include "AudacityApp.h"
@@ -94,12 +110,26 @@
 #include "blockfile/LegacyBlockFile.h"
 #include "blockfile/LegacyAliasBlockFile.h"
 #include "blockfile/SimpleBlockFile.h"
+#include "blockfile/FLACBlockFile.h"
+#include "blockfile/PackedBlockFile.h"
+#include "blockfile/BlockPack.h"
 #include "blockfile/SilentBlockFile.h"
 #include "blockfile/PCMAliasBlockFile.h"
 #include "blockfile/ODPCMAliasBlockFile.h"
 #include "blockfile/ODDecodeBlockFile.h"
+#include "blockfile/MappedFile.h"
+#include "blockfile/AliasFile.h"
+#include "blockfile/BlockCache.h"
+#include "blockfile/BlockIOStats.h"
+#include "blockfile/BlockManifest.h"
+#include "blockfile/BlockWriter.h"
+#include "blockfile/BlockReaper.h"
+#include "blockfile/SpareBlockFiles.h"
+#include "blockfile/SummaryCache.h"
 #include "InconsistencyException.h"
 #include "Internat.h"
+#include "MemoryPressure.h"
+#include "MixerPool.h"
 #include "Project.h"
 #include "Prefs.h"
 #include "Sequence.h"
@@ -398,6 +428,19 @@ DirManager::DirManager()
    mLoadingTargetIdx = 0;
    mMaxSamples = ~size_t(0);
 
+   UpdateMappedFilesPrefs();
+   UpdateAliasFilesPrefs();
+   UpdateSummaryCachePrefs();
+   UpdateBlockWriterPrefs();
+   UpdateBlockReaperPrefs();
+
+   mBlockCache = std::make_unique<BlockCache>();
+   mIOStats = std::make_unique<BlockIOStats>();
+   UpdateBlockCachePrefs();
+   UpdateBlockFormatPrefs();
+   UpdateBlockSizePrefs();
+   UpdateBlockCompactionPrefs();
+
    // toplevel pool hash is fully populated to begin
    {
       // We can bypass the accessor function while initializing
@@ -421,10 +464,17 @@ DirManager::~DirManager()
 {
    numDirManagers--;
    if (numDirManagers == 0) {
+      // Finish pending writes before the files might be cleaned away
+      GetBlockWriter().Stop();
       CleanTempDir();
       //::wxRmdir(temp);
-   } else if( projFull.IsEmpty() && !mytemp.IsEmpty()) {
-      CleanDir(mytemp, wxEmptyString, ".DS_Store", _("Cleaning project temporary files"), kCleanTopDirToo | kCleanDirsOnlyIfEmpty );
+   } else if( projFull.IsEmpty() && !mytemp.IsEmpty() &&
+              !dontDeleteTempFiles && wxDirExists(mytemp)) {
+      // Other projects may still hold blocks from here, as the clipboard
+      // does, so only what is empty goes now; the mark says that the rest
+      // may go at the next start
+      BlockReaper::Mark(mytemp);
+      GetBlockReaper().RemoveDir(mytemp, false);
    }
 }
 
@@ -435,9 +485,52 @@ DirManager::~DirManager()
 // project but just something else called project.
 void DirManager::CleanTempDir()
 {
-   // with default flags (none) this does not clean the top directory, and may remove non-empty 
-   // directories.
-   CleanDir(globaltemp, wxT("project*"), wxEmptyString, _("Cleaning up temporary files"));
+   if (dontDeleteTempFiles)
+      return; // do nothing
+
+   // This does not clean the top directory, and removes non-empty
+   // directories, in the background
+   wxArrayString dirs;
+   {
+      wxDir dir(globaltemp);
+      if (!dir.IsOpened())
+         return;
+      wxString name;
+      for (bool cont = dir.GetFirst(&name, wxT("project*"), wxDIR_DIRS);
+           cont; cont = dir.GetNext(&name))
+         dirs.push_back(globaltemp + wxFILE_SEP_PATH + name);
+   }
+
+   for (const auto &path : dirs) {
+      BlockReaper::Mark(path);
+      GetBlockReaper().RemoveDir(path, true);
+   }
+}
+
+// static
+void DirManager::ResumeCleanup()
+{
+   if (dontDeleteTempFiles)
+      return; // do nothing
+
+   // Only the directories marked at the last exit; others may hold
+   // projects to recover
+   wxArrayString dirs;
+   {
+      wxDir dir(globaltemp);
+      if (!dir.IsOpened())
+         return;
+      wxString name;
+      for (bool cont = dir.GetFirst(&name, wxT("project*"), wxDIR_DIRS);
+           cont; cont = dir.GetNext(&name)) {
+         const auto path = globaltemp + wxFILE_SEP_PATH + name;
+         if (wxFileExists(path + wxFILE_SEP_PATH + BlockReaper::MarkerName()))
+            dirs.push_back(path);
+      }
+   }
+
+   for (const auto &path : dirs)
+      GetBlockReaper().RemoveDir(path, true);
 }
 
 // static
@@ -528,6 +621,9 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
       }
    }
 
+   // All block files must exist before they can be moved
+   GetBlockWriter().Flush();
+
    /* Move all files into this NEW directory.  Files which are
       "locked" get copied instead of moved.  (This happens when
       we perform a Save As - the files which belonged to the last
@@ -546,6 +642,7 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
       bool success = true;
       int count = 0;
       wxArrayString newPaths;
+      std::vector<FileCopy> copies;
       for (const auto &pair : mBlockFileHash)
       {
          wxString newPath;
@@ -562,7 +659,7 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
                success = false;
             else {
                moving = moving && !b->IsLocked();
-               auto result = CopyToNewProjectDirectory( &*b );
+               auto result = CopyToNewProjectDirectory( &*b, copies );
                success = result.first;
                newPath = result.second;
             }
@@ -580,6 +677,21 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
       // in case there are any nulls
       trueTotal = count;
 
+      if (success)
+         success = CopyFiles(copies, progress);
+
+      // Packed blocks need only one copy, of the whole pack.  It is
+      // written compactly, without the space of removed blocks.
+      wxString oldPackPath, newPackPath;
+      BlockPack::Index newPackIndex;
+      if (success && mBlockPack) {
+         oldPackPath = mBlockPack->GetPath();
+         newPackPath =
+            GetDataFilesDir() + wxFILE_SEP_PATH + wxT("blocks.pack");
+         if (newPackPath != oldPackPath)
+            success = mBlockPack->WriteCopy(newPackPath, newPackIndex);
+      }
+
       if (success) {
          auto size = newPaths.size();
          wxASSERT( size == mBlockFileHash.size() );
@@ -623,6 +735,17 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
 
             ++ii;
          }
+
+         if (mBlockPack) {
+            if (newPackPath != oldPackPath) {
+               mBlockPack->Relocate(newPackPath, std::move(newPackIndex));
+               if (moving)
+                  wxRemoveFile(oldPackPath);
+            }
+            else if (mBlockPack->GetWastedBytes() > 0)
+               // Failure leaves the pack as it was, which is harmless
+               mBlockPack->Compact();
+         }
       }
       else {
          this->projFull = oldFull;
@@ -673,6 +796,14 @@ bool DirManager::SetProject(wxString& newProjPath, wxString& newProjName, const
       //Dont know if this will make the project dirty, but I doubt it. (mchinen)
       //      count += RecursivelyEnumerate(cleanupLoc2, dirlist, wxEmptyString, false, true);
    }
+
+   // Let ProjectFSCK() trust the saved files without scanning them
+   if (trueTotal > 0)
+      BlockManifest::Write(GetDataFilesDir(), GetBlockFilePaths());
+
+   // The project may now be on another disk
+   UpdateBlockSizePrefs();
+
    return true;
 }
 
@@ -1074,14 +1205,141 @@ wxFileNameWrapper DirManager::MakeBlockFileName()
    return ret;
 }
 
+namespace {
+
+// A fast hash of sample data, not meant to resist attack; blocks with equal
+// hashes are compared sample by sample before they are shared
+unsigned long long HashSamples(constSamplePtr data, size_t bytes)
+{
+   unsigned long long hash = 0xcbf29ce484222325ULL ^ bytes;
+   size_t ii = 0;
+   for (; ii + sizeof(hash) <= bytes; ii += sizeof(hash)) {
+      unsigned long long word;
+      memcpy(&word, data + ii, sizeof(word));
+      hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+      hash ^= hash >> 29;
+   }
+   for (; ii < bytes; ++ii)
+      hash = (hash ^ (unsigned char)data[ii]) * 0x100000001b3ULL;
+   return hash;
+}
+
+}
+
 BlockFilePtr DirManager::NewSimpleBlockFile(
                                  samplePtr sampleData, size_t sampleLen,
                                  sampleFormat format,
                                  bool allowDeferredWrite)
+{
+   ODLocker locker{ &mNewBlockFileMutex };
+   BlockIOStats::Scope ioScope{ *mIOStats };
+
+   if (!mDedupeBlockFiles)
+      return MakeSimpleBlockFile(
+         sampleData, sampleLen, format, allowDeferredWrite);
+
+   // Block files are never changed once made, so any number of sequences
+   // may refer to one, as after copy and paste.  The undo history then
+   // counts its space only once.
+   const auto hash =
+      HashSamples(sampleData, sampleLen * SAMPLE_SIZE(format));
+   if (auto file = FindDuplicateBlock(hash, sampleData, sampleLen, format))
+      return file;
+
+   auto newBlockFile = MakeSimpleBlockFile(
+      sampleData, sampleLen, format, allowDeferredWrite);
+   AddToContentIndex(hash, format, newBlockFile);
+   return newBlockFile;
+}
+
+BlockFilePtr DirManager::FindDuplicateBlock(unsigned long long hash,
+   samplePtr sampleData, size_t sampleLen, sampleFormat format)
+{
+   const auto range = mContentIndex.equal_range(hash);
+   if (range.first == range.second)
+      return {};
+
+   SampleBuffer buffer;
+   for (auto iter = range.first; iter != range.second; ++iter) {
+      auto file = iter->second.file.lock();
+      // A locked file is being saved, and CopyBlockFile() would not share it
+      if (!file || iter->second.format != format ||
+          file->GetLength() != sampleLen || file->IsLocked())
+         continue;
+
+      if (!buffer.ptr())
+         buffer.Allocate(sampleLen, format);
+      if (file->ReadData(buffer.ptr(), format, 0, sampleLen, false)
+             == sampleLen &&
+          0 == memcmp(buffer.ptr(), sampleData,
+                      sampleLen * SAMPLE_SIZE(format)))
+         return file;
+   }
+
+   return {};
+}
+
+void DirManager::AddToContentIndex(unsigned long long hash,
+   sampleFormat format, const BlockFilePtr &file)
+{
+   // Forget deleted blocks now and then, so that the index stays bounded
+   // by a multiple of the live blocks
+   if (mContentIndex.size() >= mContentIndexSweepSize) {
+      for (auto iter = mContentIndex.begin(); iter != mContentIndex.end();) {
+         if (iter->second.file.expired())
+            iter = mContentIndex.erase(iter);
+         else
+            ++iter;
+      }
+      mContentIndexSweepSize =
+         std::max<size_t>(1024, 2 * mContentIndex.size());
+   }
+
+   mContentIndex.emplace(hash, ContentEntry{ file, format });
+}
+
+BlockFilePtr DirManager::MakeSimpleBlockFile(
+                                 samplePtr sampleData, size_t sampleLen,
+                                 sampleFormat format,
+                                 bool allowDeferredWrite)
 {
    wxFileNameWrapper filePath{ MakeBlockFileName() };
    const wxString fileName{ filePath.GetName() };
 
+   // Deferral of the write is only permitted, never required; packed and
+   // compressed blocks are written at once
+   if (mPackBlockFiles || mPackingScopes > 0) {
+      // The name stays unique, but no file is made in the subdirectories
+      filePath.AssignDir(GetDataFilesDir());
+      filePath.SetName(fileName);
+      auto newBlockFile = make_blockfile<PackedBlockFile>
+         (std::move(filePath), GetBlockPack(), sampleData, sampleLen, format);
+      mBlockFileHash[fileName] = newBlockFile;
+      return newBlockFile;
+   }
+
+#ifdef USE_LIBFLAC
+   unsigned bitsPerSample;
+   if (mCompressBlockFiles &&
+       FLACBlockFile::CanCompress(sampleData, sampleLen, format, bitsPerSample)) {
+      auto newBlockFile = make_blockfile<FLACBlockFile>
+         (std::move(filePath), sampleData, sampleLen, format);
+      mBlockFileHash[fileName] = newBlockFile;
+      return newBlockFile;
+   }
+#endif
+
+   auto &writer = GetBlockWriter();
+   const auto bytes = sampleLen * SAMPLE_SIZE(format);
+   if (allowDeferredWrite && writer.IsEnabled() && writer.HasRoom(bytes)) {
+      auto newBlockFile = make_blockfile<SimpleBlockFile>
+         (std::move(filePath), sampleData, sampleLen, format,
+          true, false, true);
+      mBlockFileHash[fileName] = newBlockFile;
+      writer.Enqueue(newBlockFile, bytes);
+      return newBlockFile;
+   }
+
    auto newBlockFile = make_blockfile<SimpleBlockFile>
       (std::move(filePath), sampleData, sampleLen, format, allowDeferredWrite);
 
@@ -1094,6 +1352,9 @@ BlockFilePtr DirManager::NewAliasBlockFile(
                                  const wxString &aliasedFile, sampleCount aliasStart,
                                  size_t aliasLen, int aliasChannel)
 {
+   ODLocker locker{ &mNewBlockFileMutex };
+   BlockIOStats::Scope ioScope{ *mIOStats };
+
    wxFileNameWrapper filePath{ MakeBlockFileName() };
    const wxString fileName = filePath.GetName();
 
@@ -1111,6 +1372,8 @@ BlockFilePtr DirManager::NewODAliasBlockFile(
                                  const wxString &aliasedFile, sampleCount aliasStart,
                                  size_t aliasLen, int aliasChannel)
 {
+   ODLocker locker{ &mNewBlockFileMutex };
+
    wxFileNameWrapper filePath{ MakeBlockFileName() };
    const wxString fileName{ filePath.GetName() };
 
@@ -1128,6 +1391,8 @@ BlockFilePtr DirManager::NewODDecodeBlockFile(
                                  const wxString &aliasedFile, sampleCount aliasStart,
                                  size_t aliasLen, int aliasChannel, int decodeType)
 {
+   ODLocker locker{ &mNewBlockFileMutex };
+
    wxFileNameWrapper filePath{ MakeBlockFileName() };
    const wxString fileName{ filePath.GetName() };
 
@@ -1171,6 +1436,9 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
    if (!b)
       THROW_INCONSISTENCY_EXCEPTION;
 
+   // Tracks may be pasted into on several threads at once
+   ODLocker locker{ &mNewBlockFileMutex };
+
    auto result = b->GetFileName();
    const auto &fn = result.name;
 
@@ -1203,9 +1471,10 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
 
       //some block files such as ODPCMAliasBlockFIle don't always have
       //a summary file, so we should check before we copy.
-      if(b->IsSummaryAvailable())
+      //packed block files copy their data into the pack themselves.
+      if(b->IsSummaryAvailable() && !b->IsPacked())
       {
-         if( !FileNames::CopyFile(fn.GetFullPath(),
+         if( !CopyOrShareFile(fn.GetFullPath(),
                   newFile.GetFullPath()) )
             // Disk space exhaustion, maybe
             throw FileException{
@@ -1227,7 +1496,8 @@ BlockFilePtr DirManager::CopyBlockFile(const BlockFilePtr &b)
    return b2;
 }
 
-std::pair<bool, wxString> DirManager::CopyToNewProjectDirectory(BlockFile *f)
+std::pair<bool, wxString> DirManager::CopyToNewProjectDirectory(BlockFile *f,
+   std::vector<FileCopy> &copies)
 {
    wxString newPath;
    auto result = f->GetFileName();
@@ -1240,6 +1510,21 @@ std::pair<bool, wxString> DirManager::CopyToNewProjectDirectory(BlockFile *f)
       return { true, newPath };
    }
 
+   if (f->IsPacked()) {
+      // SetProject() moves the pack as a whole.  Only blocks pasted from
+      // another project need their data brought into this one's pack.
+      try {
+         static_cast<PackedBlockFile*>(f)->MoveToPack(GetBlockPack());
+      }
+      catch (const FileException&) {
+         return { false, {} };
+      }
+      wxFileNameWrapper newFileName{ oldFileNameRef };
+      newFileName.AssignDir(GetDataFilesDir());
+      newFileName.SetFullName(oldFileNameRef.GetFullName());
+      return { true, newFileName.GetFullPath() };
+   }
+
    wxFileNameWrapper newFileName;
    if (!this->AssignFile(newFileName, oldFileNameRef.GetFullName(), false)
        // Another sanity check against blockfiles getting reassigned an empty
@@ -1255,9 +1540,12 @@ std::pair<bool, wxString> DirManager::CopyToNewProjectDirectory(BlockFile *f)
       bool summaryExisted = f->IsSummaryAvailable();
       auto oldPath = oldFileNameRef.GetFullPath();
       if (summaryExisted) {
-         auto success = FileNames::CopyFile(oldPath, newPath);
-         if (!success)
-            return { false, {} };
+         // The file is complete and never changes; CopyFiles() copies it
+         // with the rest
+         FileCopy copy;
+         copy.from = oldPath;
+         copy.to = newPath;
+         copies.push_back(std::move(copy));
       }
 
       if (!summaryExisted && (f->IsSummaryAvailable() || f->IsSummaryBeingComputed())) {
@@ -1384,6 +1672,11 @@ bool DirManager::EnsureSafeFilename(const wxFileName &fName)
    }
 
    if (needToRename) {
+      // Close the file if it is open for reads, which the locks now hold
+      // off, so that it can be renamed, and no later read of a NEW file
+      // at this path finds the old one
+      GetAliasFiles().Release(fullPath);
+
       if (!wxRenameFile(fullPath,
                         renamedFullPath))
       {
@@ -1479,16 +1772,27 @@ int DirManager::ProjectFSCK(const bool bForceError, const bool bAutoRecoverMode)
          nResult = FSCKstatus_CHANGED | FSCKstatus_SAVE_AUP;
    }
 
+   // Don't mistake blocks not yet written for missing ones
+   GetBlockWriter().Flush();
+   // ...nor files of deleted blocks not yet removed for orphans
+   GetBlockReaper().Flush();
+
    wxArrayString filePathArray; // *all* files in the project directory/subdirectories
    wxString dirPath = (projFull != wxT("") ? projFull : mytemp);
-   RecursivelyEnumerateWithProgress(
-      dirPath,
-      filePathArray,          // output: all files in project directory tree
-      wxEmptyString,          // All dirs
-      wxEmptyString,          // All files
-      true, false,
-      mBlockFileHash.size(),  // rough guess of how many BlockFiles will be found/processed, for progress
-      _("Inspecting project file data"));
+
+   // If the data files are as they were at the last save, there is nothing
+   // missing and nothing orphaned, and the directory need not be scanned
+   const bool bUnchanged =
+      !bForceError && BlockManifest::Matches(dirPath, GetBlockFilePaths());
+   if (!bUnchanged)
+      RecursivelyEnumerateWithProgress(
+         dirPath,
+         filePathArray,          // output: all files in project directory tree
+         wxEmptyString,          // All dirs
+         wxEmptyString,          // All files
+         true, false,
+         mBlockFileHash.size(),  // rough guess of how many BlockFiles will be found/processed, for progress
+         _("Inspecting project file data"));
 
    //
    // MISSING ALIASED AUDIO FILES
@@ -1583,7 +1887,8 @@ _("Project check of \"%s\" folder \
    // Alias summary regeneration must happen after checking missing aliased files.
    //
    BlockHash missingAUFHash;              // missing (.auf) AliasBlockFiles
-   this->FindMissingAUFs(missingAUFHash);
+   if (!bUnchanged)
+      this->FindMissingAUFs(missingAUFHash);
    if ((nResult != FSCKstatus_CLOSE_REQ) && !missingAUFHash.empty())
    {
       // In auto-recover mode, we just recreate the alias files, and do not ask user.
@@ -1649,7 +1954,8 @@ _("Project check of \"%s\" folder \
    // MISSING (.AU) SimpleBlockFiles
    //
    BlockHash missingAUHash;               // missing data (.au) blockfiles
-   this->FindMissingAUs(missingAUHash);
+   if (!bUnchanged)
+      this->FindMissingAUs(missingAUHash);
    if ((nResult != FSCKstatus_CLOSE_REQ) && !missingAUHash.empty())
    {
       // In auto-recover mode, we just always create silent blocks.
@@ -1768,7 +2074,8 @@ other projects. \
       }
    }
 
-   if ((nResult != FSCKstatus_CLOSE_REQ) && !ODManager::HasLoadedODFlag())
+   if ((nResult != FSCKstatus_CLOSE_REQ) && !bUnchanged &&
+       !ODManager::HasLoadedODFlag())
    {
       // Remove any empty directories.
       ProgressDialog pProgress
@@ -1797,6 +2104,14 @@ other projects. \
             wxOK  | wxICON_EXCLAMATION);
    }
 
+   // Recovery may have replaced block contents with silence
+   if (nResult & FSCKstatus_CHANGED)
+      mBlockCache->Clear();
+
+   // Record the checked state, so the next check can be quick
+   if (nResult != FSCKstatus_CLOSE_REQ && !bUnchanged)
+      BlockManifest::Write(dirPath, GetBlockFilePaths());
+
    wxGetApp().SetMissingAliasedFileWarningShouldShow(true);
    return nResult;
 }
@@ -1805,34 +2120,45 @@ void DirManager::FindMissingAliasedFiles(
       BlockHash& missingAliasedFileAUFHash,     // output: (.auf) AliasBlockFiles whose aliased files are missing
       BlockHash& missingAliasedFilePathHash)    // output: full paths of missing aliased files
 {
-   BlockHash::iterator iter = mBlockFileHash.begin();
-   while (iter != mBlockFileHash.end())
+   // Gather each aliased file once, then test them all in parallel
+   std::unordered_map<wxString, size_t> pathIndices;
+   wxArrayString paths;
+   std::vector< std::pair<wxString, size_t> > aliases; // block key, path index
+   for (const auto &pair : mBlockFileHash)
    {
-      wxString key = iter->first;   // file name and extension
-      BlockFilePtr b = iter->second.lock();
-      if (b) {
-         if (b->IsAlias())
+      BlockFilePtr b = pair.second.lock();
+      if (b && b->IsAlias())
+      {
+         const wxFileName &aliasedFileName =
+         static_cast< AliasBlockFile* > ( &*b )->GetAliasedFileName();
+         wxString aliasedFileFullPath = aliasedFileName.GetFullPath();
+         // wxEmptyString can happen if user already chose to "replace... with silence".
+         if (aliasedFileFullPath != wxEmptyString)
          {
-            const wxFileName &aliasedFileName =
-            static_cast< AliasBlockFile* > ( &*b )->GetAliasedFileName();
-            wxString aliasedFileFullPath = aliasedFileName.GetFullPath();
-            // wxEmptyString can happen if user already chose to "replace... with silence".
-            if ((aliasedFileFullPath != wxEmptyString) &&
-                !aliasedFileName.FileExists())
-            {
-               missingAliasedFileAUFHash[key] = b;
-               if (missingAliasedFilePathHash.find(aliasedFileFullPath) ==
-                   missingAliasedFilePathHash.end()) // Add it only once.
-                  // Not actually using the block here, just the path,
-                  // so set the block to NULL to create the entry.
-                  missingAliasedFilePathHash[aliasedFileFullPath] = {};
+            auto found = pathIndices.find(aliasedFileFullPath);
+            if (found == pathIndices.end()) {
+               found = pathIndices.emplace(aliasedFileFullPath, paths.size()).first;
+               paths.push_back(aliasedFileFullPath);
             }
+            aliases.emplace_back(pair.first, found->second);
          }
       }
-      ++iter;
    }
 
-   iter = missingAliasedFilePathHash.begin();
+   const auto exists = BlockManifest::CheckFiles(paths, false);
+
+   for (const auto &alias : aliases)
+   {
+      if (!exists[alias.second])
+      {
+         missingAliasedFileAUFHash[alias.first] = mBlockFileHash[alias.first];
+         // Not actually using the block here, just the path,
+         // so set the block to NULL to create the entry.
+         missingAliasedFilePathHash[paths[alias.second]] = {};
+      }
+   }
+
+   BlockHash::iterator iter = missingAliasedFilePathHash.begin();
    while (iter != missingAliasedFilePathHash.end())
    {
       wxLogWarning(_("Missing aliased audio file: '%s'"), iter->first);
@@ -1843,56 +2169,98 @@ void DirManager::FindMissingAliasedFiles(
 void DirManager::FindMissingAUFs(
       BlockHash& missingAUFHash)                // output: missing (.auf) AliasBlockFiles
 {
-   BlockHash::iterator iter = mBlockFileHash.begin();
-   while (iter != mBlockFileHash.end())
+   wxArrayString paths;
+   std::vector<wxString> keys;
+   for (const auto &pair : mBlockFileHash)
    {
-      const wxString &key = iter->first;
-      BlockFilePtr b = iter->second.lock();
-      if (b) {
-         if (b->IsAlias() && b->IsSummaryAvailable())
-         {
-            /* don't look in hash; that might find files the user moved
-             that the Blockfile abstraction can't find itself */
-            wxFileNameWrapper fileName{ MakeBlockFilePath(key) };
-            fileName.SetName(key);
-            fileName.SetExt(wxT("auf"));
-            if (!fileName.FileExists())
-            {
-               missingAUFHash[key] = b;
-               wxLogWarning(_("Missing alias (.auf) block file: '%s'"),
-                            fileName.GetFullPath());
-            }
-         }
+      const wxString &key = pair.first;
+      BlockFilePtr b = pair.second.lock();
+      if (b && b->IsAlias() && b->IsSummaryAvailable())
+      {
+         /* don't look in hash; that might find files the user moved
+          that the Blockfile abstraction can't find itself */
+         wxFileNameWrapper fileName{ MakeBlockFilePath(key) };
+         fileName.SetName(key);
+         fileName.SetExt(wxT("auf"));
+         paths.push_back(fileName.GetFullPath());
+         keys.push_back(key);
+      }
+   }
+
+   const auto exists = BlockManifest::CheckFiles(paths, false);
+
+   for (size_t ii = 0; ii < keys.size(); ++ii)
+   {
+      if (!exists[ii])
+      {
+         missingAUFHash[keys[ii]] = mBlockFileHash[keys[ii]];
+         wxLogWarning(_("Missing alias (.auf) block file: '%s'"), paths[ii]);
       }
-      ++iter;
    }
 }
 
 void DirManager::FindMissingAUs(
       BlockHash& missingAUHash)                 // missing data (.au) blockfiles
 {
-   BlockHash::iterator iter = mBlockFileHash.begin();
-   while (iter != mBlockFileHash.end())
+   wxArrayString paths;
+   std::vector<wxString> keys;
+   for (const auto &pair : mBlockFileHash)
    {
-      const wxString &key = iter->first;
-      BlockFilePtr b = iter->second.lock();
-      if (b) {
-         if (!b->IsAlias())
+      const wxString &key = pair.first;
+      BlockFilePtr b = pair.second.lock();
+      if (!b)
+         continue;
+
+      if (b->IsPacked())
+      {
+         if (!static_cast<PackedBlockFile&>(*b).IsStored())
          {
-            wxFileNameWrapper fileName{ MakeBlockFilePath(key) };
-            fileName.SetName(key);
-            fileName.SetExt(wxT("au"));
-            const auto path = fileName.GetFullPath();
-            if (!fileName.FileExists() ||
-                wxFile{ path }.Length() == 0)
-            {
-               missingAUHash[key] = b;
-               wxLogWarning(_("Missing data block file: '%s'"), path);
-            }
+            missingAUHash[key] = b;
+            wxLogWarning(_("Missing data block in pack file: '%s'"), key);
          }
       }
-      ++iter;
+      else if (!b->IsAlias())
+      {
+         wxFileNameWrapper fileName{ MakeBlockFilePath(key) };
+         fileName.SetName(key);
+         // .au, or .auc if compressed
+         fileName.SetExt(b->GetFileName().name.GetExt());
+         paths.push_back(fileName.GetFullPath());
+         keys.push_back(key);
+      }
+   }
+
+   // Missing or empty files are both bad
+   const auto exists = BlockManifest::CheckFiles(paths, true);
+
+   for (size_t ii = 0; ii < keys.size(); ++ii)
+   {
+      if (!exists[ii])
+      {
+         missingAUHash[keys[ii]] = mBlockFileHash[keys[ii]];
+         wxLogWarning(_("Missing data block file: '%s'"), paths[ii]);
+      }
+   }
+}
+
+wxArrayString DirManager::GetBlockFilePaths()
+{
+   wxArrayString paths;
+   for (const auto &pair : mBlockFileHash)
+   {
+      BlockFilePtr b = pair.second.lock();
+      // Packed blocks are all in the one pack file
+      if (!b || b->IsPacked() || !b->IsSummaryAvailable())
+         continue;
+      auto result = b->GetFileName();
+      if (result.name.IsOk())
+         paths.push_back(result.name.GetFullPath());
    }
+
+   if (mBlockPack && !mBlockPack->IsEmpty())
+      paths.push_back(mBlockPack->GetPath());
+
+   return paths;
 }
 
 // Find .au and .auf files that are not in the project.
@@ -1911,6 +2279,7 @@ void DirManager::FindOrphanBlockFiles(
             // Consider only Audacity data files.
             // Specifically, ignore <branding> JPG and <import> OGG ("Save Compressed Copy").
             (ext.IsSameAs(wxT("au")) ||
+               ext.IsSameAs(wxT("auc")) ||
                ext.IsSameAs(wxT("auf"))))
       {
          if (!clipboardDM) {
@@ -1959,19 +2328,10 @@ void DirManager::RemoveOrphanBlockfiles()
 
 void DirManager::FillBlockfilesCache()
 {
-#ifdef DEPRECATED_AUDIO_CACHE
-   // See http://bugzilla.audacityteam.org/show_bug.cgi?id=545.
-   bool cacheBlockFiles = false;
-   gPrefs->Read(wxT("/Directories/CacheBlockFiles"), &cacheBlockFiles);
-
-   if (!cacheBlockFiles)
+   if (!PrefsSnapshot::Get().cacheBlockFiles || !mBlockCache->IsEnabled())
       return; // user opted not to cache block files
-
-   int lowMem = gPrefs->Read(wxT("/Directories/CacheLowMem"), 16l);
-   if (lowMem < 16) {
-      lowMem = 16;
-   }
-   lowMem <<= 20;
+   if (MemoryPressure::Get().GetLevel() != MemoryPressure::Normal)
+      return; // the cache would only be shed again
 
    BlockHash::iterator iter;
    int numNeed = 0;
@@ -1980,10 +2340,8 @@ void DirManager::FillBlockfilesCache()
    while (iter != mBlockFileHash.end())
    {
       BlockFilePtr b = iter->second.lock();
-      if (b) {
-         if (b->GetNeedFillCache())
-            numNeed++;
-      }
+      if (b)
+         numNeed++;
       ++iter;
    }
 
@@ -1999,21 +2357,374 @@ void DirManager::FillBlockfilesCache()
    {
       BlockFilePtr b = iter->second.lock();
       if (b) {
-         if (b->GetNeedFillCache() && (GetFreeMemory() > lowMem)) {
-            b->FillCache();
-         }
+         // Stop when the budget is used up, rather than evicting what
+         // was just loaded
+         if (!mBlockCache->Prefetch(b))
+            break;
 
-         if (!progress.Update(current, numNeed))
+         if (progress.Update(current, numNeed) != ProgressResult::Success)
             break; // user cancelled progress dialog, stop caching
          current++;
       }
       ++iter;
    }
-#endif // DEPRECATED_AUDIO_CACHE
+}
+
+void DirManager::UpdateBlockCachePrefs()
+{
+   // The budget is for all the projects together
+   long budget = gPrefs->Read(wxT("/Directories/BlockCacheBudget"), 64L);
+   if (budget < 0)
+      budget = 0;
+   BlockCache::SetBudget(size_t(budget) << 20);
+
+   long quota = gPrefs->Read(wxT("/Directories/BlockCacheProjectQuota"), 100L);
+   quota = std::max(0L, std::min(100L, quota));
+   mBlockCache->SetQuota((size_t(budget) << 20) / 100 * quota);
+}
+
+void DirManager::UpdateBlockFormatPrefs()
+{
+   mCompressBlockFiles = false;
+#ifdef USE_LIBFLAC
+   gPrefs->Read(wxT("/Directories/CompressBlockFiles"), &mCompressBlockFiles);
+#endif
+
+   mPackBlockFiles = false;
+   gPrefs->Read(wxT("/Directories/PackBlockFiles"), &mPackBlockFiles);
+
+   mShareBlockFiles = true;
+   gPrefs->Read(wxT("/Directories/ShareBlockFiles"), &mShareBlockFiles);
+
+   mDedupeBlockFiles = true;
+   gPrefs->Read(wxT("/Directories/DedupeBlockFiles"), &mDedupeBlockFiles);
+}
+
+void DirManager::UpdateBlockCompactionPrefs()
+{
+   long level = gPrefs->Read(wxT("/Directories/CompactBlocks"), 1L);
+   mBlockCompactionLevel = std::max(0L, std::min(3L, level));
+}
+
+void DirManager::UpdateBlockSizePrefs()
+{
+   bool calibrate = false;
+   gPrefs->Read(wxT("/Directories/CalibrateBlockSize"), &calibrate);
+   mMaxDiskBlockSize = calibrate
+      ? CalibrateBlockSize(projPath.IsEmpty() ? globaltemp : projPath)
+      : Sequence::GetMaxDiskBlockSize();
+}
+
+// static
+size_t DirManager::CalibrateBlockSize(const wxString &dir)
+{
+   static std::unordered_map<wxString, size_t> calibrated;
+   const auto iter = calibrated.find(dir);
+   if (iter != calibrated.end())
+      return iter->second;
+
+   auto &result = calibrated[dir];
+   result = Sequence::GetMaxDiskBlockSize();
+
+   // Writing and reading back one file takes about
+   // overhead + size / throughput.  Time two sizes to find both.
+   const size_t sizes[] = { 64 * 1024, 4 * 1024 * 1024 };
+   const int counts[] = { 16, 2 };
+   double seconds[2];
+   ArrayOf<char> data{ sizes[1], true };
+   for (int ii = 0; ii < 2; ++ii) {
+      wxStopWatch watch;
+      for (int nn = 0; nn < counts[ii]; ++nn) {
+         const auto path = dir + wxFILE_SEP_PATH +
+            wxString::Format(wxT("calibrate%d.tmp"), nn);
+         bool ok;
+         {
+            wxFile file;
+            ok = file.Create(path, true) &&
+               file.Write(data.get(), sizes[ii]) == sizes[ii];
+         }
+         if (ok) {
+            wxFile file;
+            ok = file.Open(path) &&
+               file.Read(data.get(), sizes[ii]) == ssize_t(sizes[ii]);
+         }
+         if (wxFileExists(path))
+            wxRemoveFile(path);
+         if (!ok)
+            return result;
+      }
+      seconds[ii] = watch.TimeInMicro().ToDouble() / 1e6 / counts[ii];
+   }
+
+   if (!(seconds[1] > seconds[0]))
+      return result;
+   const auto throughput = (sizes[1] - sizes[0]) / (seconds[1] - seconds[0]);
+   const auto overhead = seconds[0] - sizes[0] / throughput;
+   if (!(overhead > 0))
+      return result;
+
+   // Make the overhead a tenth of the time to read or write a whole block,
+   // and round down to a power of two, within sensible bounds
+   const double ideal = 9 * overhead * throughput;
+   size_t size = 256 * 1024;
+   while (size < 16 * 1024 * 1024 && 2 * size <= ideal)
+      size *= 2;
+
+   wxLogDebug(wxT("Block size for %s: overhead %g s, %g MB/s, using %lu bytes"),
+      dir, overhead, throughput / 1e6, (unsigned long)size);
+   return result = size;
+}
+
+bool DirManager::CopyOrShareFile(const wxString &from, const wxString &to)
+{
+   // Block files are never rewritten in place (Recover() makes a NEW
+   // file), so projects may share them; the file system then keeps the
+   // count of references, and removal of one name leaves the others
+   if (mShareBlockFiles)
+      return FileNames::ShareFile(from, to);
+   return FileNames::CopyFileData(from, to);
+}
+
+namespace {
+
+// Files copied at once by CopyFiles(): enough to keep the queue of a
+// device busy, few enough that reads stay near each other
+const unsigned kCopyStreams = 4;
+
+// Where the data of a file begin on its device, as nearly as can be
+// told cheaply: the physical offset of the first extent on Linux, else
+// the number of the inode, near which file systems mostly put the data
+unsigned long long DiskOrder(const wxString &path)
+{
+#if defined(__UNIX__)
+   const int fd = open(OSFILENAME(path), O_RDONLY);
+   if (fd < 0)
+      return 0;
+   unsigned long long order = 0;
+#if defined(__linux__)
+   // Room for the first extent after the header
+   union {
+      struct fiemap map;
+      char bytes[sizeof(struct fiemap) + sizeof(struct fiemap_extent)];
+   } request;
+   memset(&request, 0, sizeof(request));
+   request.map.fm_length = FIEMAP_MAX_OFFSET;
+   request.map.fm_extent_count = 1;
+   if (ioctl(fd, FS_IOC_FIEMAP, &request.map) == 0 &&
+       request.map.fm_mapped_extents > 0)
+      order = request.map.fm_extents[0].fe_physical;
+#endif
+   struct stat st;
+   if (order == 0 && fstat(fd, &st) == 0)
+      order = st.st_ino;
+   close(fd);
+   return order;
+#else
+   // Names of block files go up as they are made, and so, mostly, do
+   // their places on the device
+   wxUnusedVar(path);
+   return 0;
+#endif
+}
+
+}
+
+bool DirManager::CopyFiles(std::vector<FileCopy> &copies,
+                           ProgressDialog &progress)
+{
+   if (copies.empty())
+      return true;
+
+   // The block files were visited in the order of a hash table, which
+   // left the reads scattered all over the device
+   MixerPool pool{ kCopyStreams - 1 };
+   pool.Run(copies.size(), [&](size_t ii) {
+      copies[ii].order = DiskOrder(copies[ii].from);
+   });
+   std::sort(copies.begin(), copies.end(),
+      [](const FileCopy &a, const FileCopy &b) {
+         return a.order != b.order ? a.order < b.order : a.from < b.from;
+      });
+
+   // The helpers take the copies in that order; the calling thread takes
+   // its share too, and updates the progress between them
+   const auto total = copies.size();
+   std::atomic<size_t> done{ 0 };
+   std::atomic<bool> cancelled{ false };
+   pool.Run(total, [&](size_t ii) {
+      auto &copy = copies[ii];
+      if (!cancelled.load(std::memory_order_relaxed))
+         copy.copied = CopyOrShareFile(copy.from, copy.to);
+      ++done;
+      if (wxThread::IsMain() &&
+          progress.Update(done.load(), total) != ProgressResult::Success)
+         cancelled.store(true, std::memory_order_relaxed);
+   });
+
+   return !cancelled.load() &&
+      std::all_of(copies.begin(), copies.end(),
+         [](const FileCopy &copy) { return copy.copied; });
+}
+
+DirManager::PackingScope::PackingScope(DirManager &dirManager)
+   : mDirManager{ dirManager }
+{
+   ++mDirManager.mPackingScopes;
+}
+
+DirManager::PackingScope::~PackingScope()
+{
+   --mDirManager.mPackingScopes;
+}
+
+const std::shared_ptr<BlockPack> &DirManager::GetBlockPack()
+{
+   if (!mBlockPack)
+      mBlockPack = std::make_shared<BlockPack>(
+         GetDataFilesDir() + wxFILE_SEP_PATH + wxT("blocks.pack"));
+   return mBlockPack;
+}
+
+// static
+BlockWriter &DirManager::GetBlockWriter()
+{
+   static BlockWriter writer;
+   return writer;
+}
+
+// static
+void DirManager::UpdateBlockWriterPrefs()
+{
+   long budget = gPrefs->Read(wxT("/Directories/BackgroundWriteBudget"), 32L);
+   if (budget < 0)
+      budget = 0;
+   GetBlockWriter().SetBudget(size_t(budget) << 20);
+}
+
+// static
+BlockReaper &DirManager::GetBlockReaper()
+{
+   static BlockReaper reaper;
+   return reaper;
+}
+
+// static
+SpareBlockFiles &DirManager::GetSpareFiles()
+{
+   static SpareBlockFiles spares;
+   return spares;
+}
+
+namespace {
+   // Seconds of recording that the spare files are for
+   const double kRecordingReserveSecs = 30.0;
+   // Files made at each refill
+   const size_t kSpareFilesBatch = 8;
+}
+
+void DirManager::ReserveRecordingSpace(sampleFormat format, unsigned channels,
+                                       double rate)
+{
+   auto &spares = GetSpareFiles();
+   if (mPackBlockFiles || channels == 0 || rate <= 0) {
+      spares.Release();
+      return;
+   }
+
+   // Recorded blocks are of the greatest size, as in Sequence
+   const size_t maxSamples = mMaxDiskBlockSize / SAMPLE_SIZE(format);
+   const size_t count = channels +
+      (size_t)ceil(kRecordingReserveSecs * rate * channels / maxSamples);
+   spares.Reserve(GetDataFilesDir(),
+      SimpleBlockFile::GetFileSize(maxSamples, format), count);
+   RefillRecordingSpace();
+}
+
+bool DirManager::RefillRecordingSpace()
+{
+   return GetSpareFiles().Refill(kSpareFilesBatch);
+}
+
+void DirManager::ReleaseRecordingSpace()
+{
+   GetSpareFiles().Release();
+}
+
+wxLongLong DirManager::GetReservedRecordingSpace() const
+{
+   return GetSpareFiles().GetReservedBytes();
+}
+
+// static
+void DirManager::UpdateBlockReaperPrefs()
+{
+   long threads = gPrefs->Read(wxT("/Directories/CleanupThreads"), 2L);
+   if (threads < 1)
+      threads = 1;
+   GetBlockReaper().SetThreads(threads);
+}
+
+// static
+MappedFileTable &DirManager::GetMappedFiles()
+{
+   static MappedFileTable table;
+   return table;
+}
+
+// static
+void DirManager::UpdateMappedFilesPrefs()
+{
+   bool mapBlockFiles = false;
+   gPrefs->Read(wxT("/Directories/MapBlockFiles"), &mapBlockFiles);
+
+   long maxMapped = gPrefs->Read(wxT("/Directories/MapBlockFilesMax"), 256L);
+   if (maxMapped < 0)
+      maxMapped = 0;
+
+   GetMappedFiles().SetCapacity(mapBlockFiles ? maxMapped : 0);
+}
+
+// static
+AliasFileTable &DirManager::GetAliasFiles()
+{
+   static AliasFileTable table;
+   return table;
+}
+
+// static
+void DirManager::UpdateAliasFilesPrefs()
+{
+   // Zero opens the aliased file for each read
+   long maxOpen = gPrefs->Read(wxT("/Directories/AliasFilesMax"), 32L);
+   if (maxOpen < 0)
+      maxOpen = 0;
+
+   GetAliasFiles().SetCapacity(maxOpen);
+}
+
+// static
+SummaryCache &DirManager::GetSummaryCache()
+{
+   static SummaryCache cache;
+   return cache;
+}
+
+// static
+void DirManager::UpdateSummaryCachePrefs()
+{
+   // Zero keeps no summaries
+   long megabytes = gPrefs->Read(wxT("/Directories/SummaryCacheMB"), 256L);
+   if (megabytes < 0)
+      megabytes = 0;
+
+   GetSummaryCache().SetBudget((unsigned long long)megabytes << 20);
 }
 
 void DirManager::WriteCacheToDisk()
 {
+   // Blocks queued for the background writer are written there
+   GetBlockWriter().Flush();
+
    BlockHash::iterator iter;
    int numNeed = 0;
 
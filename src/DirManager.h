@@ -20,14 +20,27 @@
 
 #include "audacity/Types.h"
 #include "wxFileNameWrapper.h"
+#include "ondemand/ODTaskThread.h"
 
 #ifndef __AUDACITY_OLD_STD__
+#include <atomic>
 #include <unordered_map>
 #endif
+#include <vector>
 
 class wxHashTable;
 class BlockArray;
 class BlockFile;
+class MappedFileTable;
+class AliasFileTable;
+class BlockCache;
+class BlockIOStats;
+class BlockPack;
+class BlockWriter;
+class BlockReaper;
+class ProgressDialog;
+class SummaryCache;
+class SpareBlockFiles;
 
 #define FSCKstatus_CLOSE_REQ 0x1
 #define FSCKstatus_CHANGED   0x2
@@ -59,6 +72,7 @@ class PROFILE_DLL_API DirManager final {
    virtual ~DirManager();
 
    static void SetTempDir(const wxString &_temp) { globaltemp = _temp; }
+   static const wxString &GetTempDir() { return globaltemp; }
 
    // Returns true on success.
    // If SetProject is told NOT to create the directory
@@ -103,7 +117,17 @@ class PROFILE_DLL_API DirManager final {
    BlockFile *LoadBlockFile(const wxChar **attrs, sampleFormat format);
    void SaveBlockFile(BlockFile *f, int depth, FILE *fp);
 
-   std::pair<bool, wxString> CopyToNewProjectDirectory(BlockFile *f);
+   // A copy of a block file that SetProject() makes with the others
+   struct FileCopy {
+      wxString from, to;
+      // Where the data begin on the device, as nearly as is known
+      unsigned long long order { 0 };
+      bool copied { false };
+   };
+   // Assigns f its path in the project, and adds the copy to make there,
+   // if any, to copies
+   std::pair<bool, wxString> CopyToNewProjectDirectory(BlockFile *f,
+      std::vector<FileCopy> &copies);
 
    bool EnsureSafeFilename(const wxFileName &fName);
 
@@ -122,8 +146,10 @@ class PROFILE_DLL_API DirManager final {
 
    // Clean the temp dir. Note that now where we have auto recovery the temp
    // dir is not cleaned at start up anymore. But it is cleaned when the
-   // program is exited normally.
+   // program is exited normally, in the background; what that leaves
+   // undone is marked, and ResumeCleanup() finishes it at the next start.
    static void CleanTempDir();
+   static void ResumeCleanup();
    static void CleanDir(
       const wxString &path, 
       const wxString &dirSpec, 
@@ -172,10 +198,84 @@ class PROFILE_DLL_API DirManager final {
    void WriteCacheToDisk();
 
    // (Try to) fill cache of blockfiles, if caching is enabled (otherwise do
-   // nothing)
+   // nothing), stopping when the budget of the BlockCache is used up
    // A no-fail operation that does not throw
    void FillBlockfilesCache();
 
+   // Decoded sample data of recently read blocks of this project, kept
+   // with those of the other projects within one budget
+   BlockCache &GetBlockCache() { return *mBlockCache; }
+   void UpdateBlockCachePrefs();
+
+   // Counts of the reading and writing of the blocks of this project
+   BlockIOStats &GetIOStats() { return *mIOStats; }
+
+   // Whether NEW simple block files are compressed, when lossless, or
+   // packed together into one file, whether copies share files, and
+   // whether blocks with identical samples are made only once
+   void UpdateBlockFormatPrefs();
+
+   // While one exists, NEW simple block files of the project are packed,
+   // whatever the preference
+   class PackingScope {
+    public:
+      explicit PackingScope(DirManager &dirManager);
+      ~PackingScope();
+      PackingScope(const PackingScope&) PROHIBITED;
+      PackingScope &operator= (const PackingScope&) PROHIBITED;
+    private:
+      DirManager &mDirManager;
+   };
+
+   // The block size in bytes for NEW sequences of this project: either
+   // Sequence::GetMaxDiskBlockSize(), or, if the preference is set, a size
+   // chosen by timing writes and reads of the disk holding the project
+   size_t GetMaxDiskBlockSize() const { return mMaxDiskBlockSize; }
+   void UpdateBlockSizePrefs();
+
+   // How eagerly the project merges runs of small blocks while the program
+   // is idle: 0 for not at all, up to 3 for most
+   int GetBlockCompactionLevel() const { return mBlockCompactionLevel; }
+   void UpdateBlockCompactionPrefs();
+
+   // Table of memory mappings of block files, shared by all projects,
+   // sized by the preferences when a DirManager is constructed
+   static MappedFileTable &GetMappedFiles();
+   static void UpdateMappedFilesPrefs();
+
+   // Table of the aliased files kept open between reads of alias blocks,
+   // shared by all projects
+   static AliasFileTable &GetAliasFiles();
+   static void UpdateAliasFilesPrefs();
+
+   // Summaries of the blocks of aliased files, kept for the user across
+   // projects and sessions
+   static SummaryCache &GetSummaryCache();
+   static void UpdateSummaryCachePrefs();
+
+   // Thread writing NEW blocks of all projects while recording
+   static BlockWriter &GetBlockWriter();
+   static void UpdateBlockWriterPrefs();
+
+   // Threads removing the files of deleted blocks and closed projects
+   static BlockReaper &GetBlockReaper();
+   static void UpdateBlockReaperPrefs();
+
+   // Preallocated files that the simple blocks of a recording are written
+   // into, shared by all projects, as only one records at a time
+   static SpareBlockFiles &GetSpareFiles();
+
+   // Have files made, by RefillRecordingSpace(), for the blocks of about
+   // the next half minute of recording so many channels, unless NEW blocks
+   // are packed into one file
+   void ReserveRecordingSpace(sampleFormat format, unsigned channels,
+                              double rate);
+   // Make some of the files still missing; false if the disk is full
+   bool RefillRecordingSpace();
+   void ReleaseRecordingSpace();
+   // The space the files not yet written hold on the disk
+   wxLongLong GetReservedRecordingSpace() const;
+
  private:
 
    wxFileNameWrapper MakeBlockFileName();
@@ -183,6 +283,58 @@ class PROFILE_DLL_API DirManager final {
 
    BlockHash mBlockFileHash; // repository for blockfiles
 
+   // Held while the New...BlockFile() functions make a block, so that the
+   // worker threads of a batch import may make them for one project at once
+   ODLock mNewBlockFileMutex;
+
+   std::unique_ptr<BlockCache> mBlockCache;
+   std::unique_ptr<BlockIOStats> mIOStats;
+
+   bool mCompressBlockFiles { false };
+   bool mPackBlockFiles { false };
+   std::atomic<int> mPackingScopes { 0 };
+   bool mShareBlockFiles { true };
+   bool mDedupeBlockFiles { true };
+
+   size_t mMaxDiskBlockSize;
+   int mBlockCompactionLevel { 1 };
+
+   // Measured once per directory and remembered
+   static size_t CalibrateBlockSize(const wxString &dir);
+
+   BlockFilePtr MakeSimpleBlockFile(samplePtr sampleData, size_t sampleLen,
+                                    sampleFormat format,
+                                    bool allowDeferredWrite);
+
+   // Blocks made by NewSimpleBlockFile(), by hash of their samples, so that
+   // NEW blocks with identical contents can share them instead
+   BlockFilePtr FindDuplicateBlock(unsigned long long hash,
+                                   samplePtr sampleData, size_t sampleLen,
+                                   sampleFormat format);
+   void AddToContentIndex(unsigned long long hash, sampleFormat format,
+                          const BlockFilePtr &file);
+   struct ContentEntry {
+      std::weak_ptr<BlockFile> file;
+      sampleFormat format;
+   };
+   std::unordered_multimap<unsigned long long, ContentEntry> mContentIndex;
+   size_t mContentIndexSweepSize { 1024 };
+
+   // Copy a block file, or link to it if sharing is enabled
+   bool CopyOrShareFile(const wxString &from, const wxString &to);
+
+   // Make the copies in the order of their data on the device, a few at
+   // once; false if any fails or the user cancels
+   bool CopyFiles(std::vector<FileCopy> &copies, ProgressDialog &progress);
+
+   // Holds the data of packed block files; created when first needed,
+   // and moved as a whole by SetProject()
+   const std::shared_ptr<BlockPack> &GetBlockPack();
+
+   // Full paths of the files holding this project's block data
+   wxArrayString GetBlockFilePaths();
+   std::shared_ptr<BlockPack> mBlockPack;
+
    // Hashes for management of the sub-directory tree of _data
    struct BalanceInfo
    {
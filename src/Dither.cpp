@@ -43,6 +43,7 @@ and get deterministic behaviour.
 #include <stdlib.h>
 #include <math.h>
 #include <string.h>
+#include <atomic>
 //#include <sys/types.h>
 //#include <memory.h>
 //#include <assert.h>
@@ -61,7 +62,10 @@ const int Dither::BUF_SIZE = 8;
 const float Dither::SHAPED_BS[] = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
 
 // This is supposed to produce white noise and no dc
-#define DITHER_NOISE (rand() / (float)RAND_MAX - 0.5f)
+#define DITHER_NOISE Noise()
+
+// Scale of the top 24 bits of a generator, for noise in [-0.5, 0.5)
+#define NOISE_SCALE (1.0f / float(1<<24))
 
 // The following is a rather ugly, but fast implementation
 // of a dither loop. The macro "DITHER" is expanded to an implementation
@@ -143,9 +147,257 @@ const float Dither::SHAPED_BS[] = { 2.033f, -2.165f, 1.959f, -1.590f, 0.6149f };
     else { wxASSERT(false); } \
     } while (0)
 
+// Vector kernels for the conversions, done four or eight samples at a
+// time.  As for the mixing kernels in Mix.cpp, the instruction set is
+// chosen at compile time.  Conversion to an int rounds to nearest as
+// lrintf() does, which needs 64 bit NEON on ARM; elsewhere only the
+// loops above remain.
+//
+// The results are those of the loops, except that the noise comes from
+// all four generators.  Shaped dither feeds back each rounding error into
+// the next sample, so it has no vector kernel.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define DITHER_SIMD_SSE2
+#elif defined(__aarch64__) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+#include <arm_neon.h>
+#define DITHER_SIMD_NEON
+#endif
+
+namespace {
+
+#if defined(DITHER_SIMD_SSE2)
+using Vec = __m128;
+using IVec = __m128i;
+inline Vec Splat(float f) { return _mm_set1_ps(f); }
+inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+// NaN becomes the lower bound, as the loops make it after lrintf()
+inline Vec Clip(Vec v, float lo, float hi)
+   { return _mm_min_ps(_mm_max_ps(v, Splat(lo)), Splat(hi)); }
+inline Vec LoadFloats(const float *p) { return _mm_loadu_ps(p); }
+inline void StoreFloats(float *p, Vec v) { _mm_storeu_ps(p, v); }
+inline IVec LoadInts(const int *p)
+   { return _mm_loadu_si128((const __m128i *)p); }
+inline void StoreInts(int *p, IVec v) { _mm_storeu_si128((__m128i *)p, v); }
+// Eight shorts, sign extended into two vectors of ints
+inline void LoadShorts(const short *p, IVec &lo, IVec &hi)
+{
+   const auto v = _mm_loadu_si128((const __m128i *)p);
+   lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+   hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+}
+// Saturates, as STORE_INT16 clips
+inline void StoreShorts(short *p, IVec lo, IVec hi)
+   { _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(lo, hi)); }
+inline Vec ToFloat(IVec v) { return _mm_cvtepi32_ps(v); }
+// In the current rounding mode, as lrintf()
+inline IVec Round(Vec v) { return _mm_cvtps_epi32(v); }
+inline IVec ShiftLeft8(IVec v) { return _mm_slli_epi32(v, 8); }
+inline IVec LoadRandom(const unsigned int *p)
+   { return _mm_loadu_si128((const __m128i *)p); }
+inline void StoreRandom(unsigned int *p, IVec v)
+   { _mm_storeu_si128((__m128i *)p, v); }
+inline IVec NextRandom(IVec x)
+{
+   x = _mm_xor_si128(x, _mm_slli_epi32(x, 13));
+   x = _mm_xor_si128(x, _mm_srli_epi32(x, 17));
+   return _mm_xor_si128(x, _mm_slli_epi32(x, 5));
+}
+inline Vec Uniform(IVec x)
+{
+   return _mm_sub_ps(_mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(x, 8)),
+      Splat(NOISE_SCALE)), Splat(0.5f));
+}
+// (last[3], v[0], v[1], v[2])
+inline Vec Previous(Vec last, Vec v)
+{
+   const auto t = _mm_shuffle_ps(last, v, _MM_SHUFFLE(0, 0, 3, 3));
+   return _mm_shuffle_ps(t, v, _MM_SHUFFLE(2, 1, 2, 0));
+}
+inline float LastLane(Vec v)
+   { return _mm_cvtss_f32(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3))); }
+#define DITHER_SIMD
+#elif defined(DITHER_SIMD_NEON)
+using Vec = float32x4_t;
+using IVec = int32x4_t;
+inline Vec Splat(float f) { return vdupq_n_f32(f); }
+inline Vec Add(Vec a, Vec b) { return vaddq_f32(a, b); }
+inline Vec Sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+inline Vec Mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+inline Vec Clip(Vec v, float lo, float hi)
+   { return vminq_f32(vmaxq_f32(v, Splat(lo)), Splat(hi)); }
+inline Vec LoadFloats(const float *p) { return vld1q_f32(p); }
+inline void StoreFloats(float *p, Vec v) { vst1q_f32(p, v); }
+inline IVec LoadInts(const int *p) { return vld1q_s32(p); }
+inline void StoreInts(int *p, IVec v) { vst1q_s32(p, v); }
+inline void LoadShorts(const short *p, IVec &lo, IVec &hi)
+{
+   const auto v = vld1q_s16(p);
+   lo = vmovl_s16(vget_low_s16(v));
+   hi = vmovl_s16(vget_high_s16(v));
+}
+inline void StoreShorts(short *p, IVec lo, IVec hi)
+   { vst1q_s16(p, vcombine_s16(vqmovn_s32(lo), vqmovn_s32(hi))); }
+inline Vec ToFloat(IVec v) { return vcvtq_f32_s32(v); }
+inline IVec Round(Vec v) { return vcvtnq_s32_f32(v); }
+inline IVec ShiftLeft8(IVec v) { return vshlq_n_s32(v, 8); }
+inline IVec LoadRandom(const unsigned int *p)
+   { return vreinterpretq_s32_u32(vld1q_u32(p)); }
+inline void StoreRandom(unsigned int *p, IVec v)
+   { vst1q_u32(p, vreinterpretq_u32_s32(v)); }
+inline IVec NextRandom(IVec v)
+{
+   auto x = vreinterpretq_u32_s32(v);
+   x = veorq_u32(x, vshlq_n_u32(x, 13));
+   x = veorq_u32(x, vshrq_n_u32(x, 17));
+   return vreinterpretq_s32_u32(veorq_u32(x, vshlq_n_u32(x, 5)));
+}
+inline Vec Uniform(IVec x)
+{
+   return vsubq_f32(vmulq_f32(vcvtq_f32_u32(
+      vshrq_n_u32(vreinterpretq_u32_s32(x), 8)), Splat(NOISE_SCALE)),
+      Splat(0.5f));
+}
+inline Vec Previous(Vec last, Vec v) { return vextq_f32(last, v, 3); }
+inline float LastLane(Vec v) { return vgetq_lane_f32(v, 3); }
+#define DITHER_SIMD
+#endif
+
+#ifdef DITHER_SIMD
+
+struct NoiseState {
+   IVec random;
+   // The noise of the last vector, for the triangle filter
+   Vec last;
+};
+
+// One vector of RectangleDither() or TriangleDither(), or of NoDither()
+template<Dither::DitherType Type>
+inline Vec AddNoise(Vec sample, NoiseState &state)
+{
+   if (Type == Dither::none)
+      return sample;
+   state.random = NextRandom(state.random);
+   const auto r = Uniform(state.random);
+   if (Type == Dither::rectangle)
+      return Sub(sample, r);
+   const auto result = Sub(Add(sample, r), Previous(state.last, r));
+   state.last = r;
+   return result;
+}
+
+// FROM_FLOAT or FROM_INT24, then PROMOTE_TO_INT16
+inline Vec LoadPromoted16(const float *p)
+   { return Mul(Clip(LoadFloats(p), -1.0f, 1.0f), Splat(CONVERT_DIV16)); }
+inline Vec LoadPromoted16(const int *p)
+{
+   return Mul(Mul(ToFloat(LoadInts(p)), Splat(1.0f / CONVERT_DIV24)),
+      Splat(CONVERT_DIV16));
+}
+
+template<Dither::DitherType Type, typename Source>
+size_t DitherToInt16(const Source *src, short *dst, size_t len,
+                     NoiseState &state)
+{
+   size_t ii = 0;
+   for (; ii + 8 <= len; ii += 8) {
+      const auto lo = AddNoise<Type>(LoadPromoted16(src + ii), state);
+      const auto hi = AddNoise<Type>(LoadPromoted16(src + ii + 4), state);
+      StoreShorts(dst + ii, Round(lo), Round(hi));
+   }
+   return ii;
+}
+
+template<Dither::DitherType Type>
+size_t DitherToInt24(const float *src, int *dst, size_t len,
+                     NoiseState &state)
+{
+   size_t ii = 0;
+   for (; ii + 4 <= len; ii += 4) {
+      const auto sample = AddNoise<Type>(
+         Mul(Clip(LoadFloats(src + ii), -1.0f, 1.0f), Splat(CONVERT_DIV24)),
+         state);
+      // Clipping before rounding to the integral bounds is the same
+      StoreInts(dst + ii, Round(Clip(sample, -8388608.0f, 8388607.0f)));
+   }
+   return ii;
+}
+
+size_t ShortsToFloats(const short *src, float *dst, size_t len)
+{
+   size_t ii = 0;
+   for (; ii + 8 <= len; ii += 8) {
+      IVec lo, hi;
+      LoadShorts(src + ii, lo, hi);
+      StoreFloats(dst + ii, Mul(ToFloat(lo), Splat(1.0f / CONVERT_DIV16)));
+      StoreFloats(dst + ii + 4, Mul(ToFloat(hi), Splat(1.0f / CONVERT_DIV16)));
+   }
+   return ii;
+}
+
+size_t IntsToFloats(const int *src, float *dst, size_t len)
+{
+   size_t ii = 0;
+   for (; ii + 4 <= len; ii += 4)
+      StoreFloats(dst + ii,
+         Mul(ToFloat(LoadInts(src + ii)), Splat(1.0f / CONVERT_DIV24)));
+   return ii;
+}
+
+size_t ShortsToInts(const short *src, int *dst, size_t len)
+{
+   size_t ii = 0;
+   for (; ii + 8 <= len; ii += 8) {
+      IVec lo, hi;
+      LoadShorts(src + ii, lo, hi);
+      StoreInts(dst + ii, ShiftLeft8(lo));
+      StoreInts(dst + ii + 4, ShiftLeft8(hi));
+   }
+   return ii;
+}
+
+template<Dither::DitherType Type>
+size_t DitherVectors(const samplePtr source, sampleFormat sourceFormat,
+                     samplePtr dest, sampleFormat destFormat,
+                     size_t len, NoiseState &state)
+{
+   if (sourceFormat == int24Sample && destFormat == int16Sample)
+      return DitherToInt16<Type>((const int*)source, (short*)dest, len, state);
+   else if (sourceFormat == floatSample && destFormat == int16Sample)
+      return DitherToInt16<Type>((const float*)source, (short*)dest, len, state);
+   else if (sourceFormat == floatSample && destFormat == int24Sample)
+      return DitherToInt24<Type>((const float*)source, (int*)dest, len, state);
+   return 0;
+}
+
+#else
+
+size_t ShortsToFloats(const short *, float *, size_t) { return 0; }
+size_t IntsToFloats(const int *, float *, size_t) { return 0; }
+size_t ShortsToInts(const short *, int *, size_t) { return 0; }
+
+#endif
+
+}
+
 
 Dither::Dither()
 {
+    // Seed each generator differently, also across instances, which may be
+    // converting blocks of one track on several threads; xorshift needs a
+    // state that is not zero
+    static std::atomic<unsigned int> sInstances{ 0 };
+    const unsigned int instance = sInstances++;
+    for (unsigned int i = 0; i < 4; i++)
+    {
+        mRandom[i] = (instance * 4 + i + 1) * 2654435761u;
+        if (mRandom[i] == 0)
+            mRandom[i] = 1;
+    }
+
     // On startup, initialize dither by resetting values
     Reset();
 }
@@ -157,6 +409,37 @@ void Dither::Reset()
     memset(mBuffer, 0, sizeof(float) * BUF_SIZE);
 }
 
+unsigned int Dither::ApplyVectorized(DitherType ditherType,
+                                     const samplePtr source, sampleFormat sourceFormat,
+                                     samplePtr dest, sampleFormat destFormat,
+                                     unsigned int len)
+{
+#ifdef DITHER_SIMD
+    NoiseState state{ LoadRandom(mRandom), Splat(mTriangleState) };
+    size_t done = 0;
+    switch (ditherType)
+    {
+    case none:
+        done = DitherVectors<none>(source, sourceFormat, dest, destFormat, len, state);
+        break;
+    case rectangle:
+        done = DitherVectors<rectangle>(source, sourceFormat, dest, destFormat, len, state);
+        break;
+    case triangle:
+        done = DitherVectors<triangle>(source, sourceFormat, dest, destFormat, len, state);
+        if (done > 0)
+            mTriangleState = LastLane(state.last);
+        break;
+    default:
+        break;
+    }
+    StoreRandom(mRandom, state.random);
+    return done;
+#else
+    return 0;
+#endif
+}
+
 // This only decides if we must dither at all, the dithers
 // are all implemented using macros.
 //
@@ -241,13 +524,17 @@ void Dither::Apply(enum DitherType ditherType,
         if (sourceFormat == int16Sample)
         {
             short* s = (short*)source;
-            for (i = 0; i < len; i++, d += destStride, s += sourceStride)
+            i = (destStride == 1 && sourceStride == 1)
+                ? ShortsToFloats(s, d, len) : 0;
+            for (d += i, s += i; i < len; i++, d += destStride, s += sourceStride)
                 *d = FROM_INT16(s);
         } else
         if (sourceFormat == int24Sample)
         {
             int* s = (int*)source;
-            for (i = 0; i < len; i++, d += destStride, s += sourceStride)
+            i = (destStride == 1 && sourceStride == 1)
+                ? IntsToFloats(s, d, len) : 0;
+            for (d += i, s += i; i < len; i++, d += destStride, s += sourceStride)
                 *d = FROM_INT24(s);
         } else {
             wxASSERT(false); // source format unknown
@@ -258,26 +545,37 @@ void Dither::Apply(enum DitherType ditherType,
         // Special case when promoting 16 bit to 24 bit
         int* d = (int*)dest;
         short* s = (short*)source;
-        for (i = 0; i < len; i++, d += destStride, s += sourceStride)
+        i = (destStride == 1 && sourceStride == 1)
+            ? ShortsToInts(s, d, len) : 0;
+        for (d += i, s += i; i < len; i++, d += destStride, s += sourceStride)
             *d = ((int)*s) << 8;
     } else
     {
         // We must do dithering
+        if (ditherType == triangle || ditherType == shaped)
+            Reset(); // reset dither filter for this NEW conversion
+
+        // The vector kernels do what they can, the loops the rest
+        i = (destStride == 1 && sourceStride == 1)
+            ? ApplyVectorized(ditherType, source, sourceFormat, dest, destFormat, len)
+            : 0;
+        const samplePtr sourceRest = source + i * SAMPLE_SIZE(sourceFormat);
+        const samplePtr destRest = dest + i * SAMPLE_SIZE(destFormat);
+        const unsigned int rest = len - i;
+
         switch (ditherType)
         {
         case none:
-            DITHER(NoDither, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
+            DITHER(NoDither, destRest, destFormat, destStride, sourceRest, sourceFormat, sourceStride, rest);
             break;
         case rectangle:
-            DITHER(RectangleDither, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
+            DITHER(RectangleDither, destRest, destFormat, destStride, sourceRest, sourceFormat, sourceStride, rest);
             break;
         case triangle:
-            Reset(); // reset dither filter for this NEW conversion
-            DITHER(TriangleDither, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
+            DITHER(TriangleDither, destRest, destFormat, destStride, sourceRest, sourceFormat, sourceStride, rest);
             break;
         case shaped:
-            Reset(); // reset dither filter for this NEW conversion
-            DITHER(ShapedDither, dest, destFormat, destStride, source, sourceFormat, sourceStride, len);
+            DITHER(ShapedDither, destRest, destFormat, destStride, sourceRest, sourceFormat, sourceStride, rest);
             break;
         default:
             wxASSERT(false); // unknown dither algorithm
@@ -287,6 +585,16 @@ void Dither::Apply(enum DitherType ditherType,
 
 // Dither implementations
 
+// Next noise of the first generator, as Uniform() makes it of each
+inline float Dither::Noise()
+{
+    unsigned int &x = mRandom[0];
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    return (x >> 8) * NOISE_SCALE - 0.5f;
+}
+
 // No dither, just return sample
 inline float Dither::NoDither(float sample)
 {
@@ -43,6 +43,16 @@ private:
     float TriangleDither(float sample);
     float ShapedDither(float sample);
 
+    // White noise in [-0.5, 0.5), from the first generator of mRandom
+    float Noise();
+
+    // Vector kernels for both strides 1 and any ditherer but shaped.
+    // Returns how many samples they did, leaving the rest to the loops.
+    unsigned int ApplyVectorized(DitherType ditherType,
+                                 const samplePtr source, sampleFormat sourceFormat,
+                                 samplePtr dest, sampleFormat destFormat,
+                                 unsigned int len);
+
     // Dither constants
     static const int BUF_SIZE; /* = 8 */
     static const int BUF_MASK; /* = 7 */
@@ -52,6 +62,9 @@ private:
     int mPhase;
     float mTriangleState;
     float mBuffer[8 /* = BUF_SIZE */];
+    // Four xorshift generators, one for each lane of the vector kernels.
+    // Reset() keeps them, so that the noise never repeats.
+    unsigned int mRandom[4];
 };
 
 #endif /* __AUDACITY_DITHER_H__ */
@@ -30,6 +30,8 @@ a draggable point type.
 #include "Experimental.h"
 #include "ViewInfo.h"
 
+#include <algorithm>
+#include <limits>
 #include <math.h>
 
 #include <wx/dc.h>
@@ -65,6 +67,7 @@ Envelope::Envelope(const Envelope &orig, double t0, double t1)
 
    auto range1 = orig.EqualRange( t0 - orig.mOffset, 0 );
    auto range2 = orig.EqualRange( t1 - orig.mOffset, 0 );
+   CopyRange(orig, range1.first, range2.second);
 }
 
 Envelope::Envelope(const Envelope &orig)
@@ -74,6 +77,141 @@ Envelope::Envelope(const Envelope &orig)
 {
    mOffset = orig.mOffset;
    mTrackLen = orig.mTrackLen;
+   mEnv = orig.mEnv;
+}
+
+void Envelope::CopyRange(const Envelope &orig, size_t begin, size_t end)
+{
+   size_t len = orig.mEnv.size();
+   size_t i = begin;
+   mEnv.reserve(end - begin + 2);
+
+   // Create the point at 0 if it needs interpolated representation
+   if ( i > 0 )
+      AddPointAtEnd(0, orig.GetValue(mOffset));
+
+   // Copy points from inside the copied region
+   for (; i < end; ++i) {
+      const EnvPoint &point = orig[i];
+      const double when = point.GetT() + (orig.mOffset - mOffset);
+      AddPointAtEnd(when, point.GetVal());
+   }
+
+   // Create the final point if it needs interpolated representation
+   // If the last point of e was exactly at t1, this effectively copies it too.
+   if (mTrackLen > 0 && i < len)
+      AddPointAtEnd( mTrackLen, orig.GetValue(mOffset + mTrackLen));
+}
+
+void Envelope::AddPointAtEnd( double t, double val )
+{
+   mEnv.push_back( EnvPoint{ t, val } );
+
+   // Assume copied points were stored by nondecreasing time.
+   // Allow no more than two points at exactly the same time.
+   // Maybe that happened, because extra points were inserted at the boundary
+   // of the copied range, which were not in the source envelope.
+   auto nn = mEnv.size() - 1;
+   while ( nn >= 2 && mEnv[ nn - 2 ].GetT() == t ) {
+      // Of three or more points at the same time, erase one in the middle,
+      // not the one newly added.
+      mEnv.erase( mEnv.begin() + nn - 1 );
+      --nn;
+   }
+}
+
+int Envelope::InsertOrReplaceRelative(double when, double value)
+{
+   value = ClampValue(value);
+
+   // Recording automation adds each point after the last
+   if (mEnv.empty() || when > mEnv.back().GetT()) {
+      // Indices of the points before are unchanged, and so the search guess
+      mEnv.push_back( EnvPoint{ when, value } );
+      return mEnv.size() - 1;
+   }
+
+   auto range = EqualRange( when, 0 );
+   int index = range.first;
+   if ( index < range.second )
+      // In case of a discontinuity, change the left limit only
+      mEnv[ index ].SetVal( this, value );
+   else
+      mEnv.insert( mEnv.begin() + index, EnvPoint{ when, value } );
+   mSearchGuess = -2;
+   return index;
+}
+
+void Envelope::InsertPoints(EnvArray &&points)
+{
+   if (points.empty())
+      return;
+
+   const auto compare = [](const EnvPoint &point1, const EnvPoint &point2)
+      { return point1.GetT() < point2.GetT(); };
+   for (auto &point : points)
+      point.SetVal( this, point.GetVal() );
+   std::stable_sort(points.begin(), points.end(), compare);
+
+   if (mEnv.empty())
+      mEnv = std::move(points);
+   else {
+      const auto middle = mEnv.size();
+      mEnv.insert(mEnv.end(), points.begin(), points.end());
+      if (mEnv[middle].GetT() < mEnv[middle - 1].GetT())
+         std::inplace_merge(
+            mEnv.begin(), mEnv.begin() + middle, mEnv.end(), compare);
+   }
+   mSearchGuess = -2;
+}
+
+size_t Envelope::Simplify(double tolerance)
+{
+   const size_t len = mEnv.size();
+   if (len <= 2)
+      return 0;
+
+   // Whether point i makes a step with a neighbour.  Points are kept by
+   // moving them down in place, never over a point not yet looked at.
+   const auto isStep = [&](size_t i) {
+      return mEnv[i - 1].GetT() == mEnv[i].GetT() ||
+         mEnv[i + 1].GetT() == mEnv[i].GetT();
+   };
+
+   // One pass: the slopes from the last point kept that pass within
+   // tolerance of every point dropped since narrow to [lo, hi], and a point
+   // is dropped if the slope to the point after it is still among them
+   const auto infinity = std::numeric_limits<double>::infinity();
+   double lo = -infinity, hi = infinity;
+   size_t kept = 1;
+   for (size_t i = 1; i < len; ++i) {
+      const auto point = mEnv[i];
+      if (i + 1 < len && !isStep(i)) {
+         const auto &anchor = mEnv[kept - 1];
+         const auto &next = mEnv[i + 1];
+         const double dt = point.GetT() - anchor.GetT();
+         if (dt > 0) {
+            const double pointLo =
+               (point.GetVal() - tolerance - anchor.GetVal()) / dt;
+            const double pointHi =
+               (point.GetVal() + tolerance - anchor.GetVal()) / dt;
+            const double newLo = std::max(lo, pointLo);
+            const double newHi = std::min(hi, pointHi);
+            const double slope = (next.GetVal() - anchor.GetVal()) /
+               (next.GetT() - anchor.GetT());
+            if (newLo <= slope && slope <= newHi) {
+               lo = newLo, hi = newHi;
+               continue;
+            }
+         }
+      }
+      mEnv[kept++] = point;
+      lo = -infinity, hi = infinity;
+   }
+
+   mEnv.resize(kept);
+   mSearchGuess = -2;
+   return len - kept;
 }
 
 // Private methods
@@ -114,34 +252,25 @@ double Envelope::GetValue( double t, double sampleDur ) const
 /// @param Hi returns first index after this time, maybe past the end
 void Envelope::BinarySearchForTime( int &Lo, int &Hi, double t ) const
 {
-   // Optimizations for the usual pattern of repeated calls with
-   // small increases of t.
-   {
-      if (mSearchGuess >= 0 && mSearchGuess < (int)mEnv.size()) {
-         if (t >= mEnv[mSearchGuess].GetT() &&
-             (1 + mSearchGuess == (int)mEnv.size() ||
-              t < mEnv[1 + mSearchGuess].GetT())) {
-            Lo = mSearchGuess;
-            Hi = 1 + mSearchGuess;
-            return;
-         }
-      }
-
-      ++mSearchGuess;
-      if (mSearchGuess >= 0 && mSearchGuess < (int)mEnv.size()) {
-         if (t >= mEnv[mSearchGuess].GetT() &&
-             (1 + mSearchGuess == (int)mEnv.size() ||
-              t < mEnv[1 + mSearchGuess].GetT())) {
-            Lo = mSearchGuess;
-            Hi = 1 + mSearchGuess;
-            return;
-         }
+   const int len = mEnv.size();
+   Lo = -1;
+   Hi = len;
+
+   // Optimization for the usual pattern of repeated calls with
+   // small increases of t: search on from the last interval found, in
+   // steps that double, so that the same or the next interval is found in
+   // constant time, and one k intervals on in time of log k.
+   if (mSearchGuess >= 0 && mSearchGuess < len &&
+       t >= mEnv[mSearchGuess].GetT()) {
+      Lo = mSearchGuess;
+      int step = 1;
+      while (step < len - Lo && t >= mEnv[Lo + step].GetT()) {
+         Lo += step;
+         step *= 2;
       }
+      Hi = std::min(len, Lo + step);
    }
 
-   Lo = -1;
-   Hi = mEnv.size();
-
    // Invariants:  Lo is not less than -1, Hi not more than size
    while (Hi > (Lo + 1)) {
       int mid = (Lo + Hi) / 2;
@@ -204,48 +333,68 @@ void Envelope::GetValuesRelative
 {
    // JC: If bufferLen ==0 we have probably just allocated a zero sized buffer.
    // wxASSERT( bufferLen > 0 );
+   if (bufferLen <= 0)
+      return;
+
+   const int len = mEnv.size();
+
+   // Get easiest cases out the way first...
+   // IF empty envelope THEN default value
+   if (len <= 0) {
+      std::fill(buffer, buffer + bufferLen, mDefaultValue);
+      return;
+   }
+   // IF one point THEN its value, before it and after it alike
+   if (len == 1) {
+      std::fill(buffer, buffer + bufferLen, mEnv[0].GetVal());
+      return;
+   }
 
    const auto epsilon = tstep / 2;
-   int len = mEnv.size();
 
-   double t = t0;
    double increment = 0;
-   if ( len > 1 && t <= mEnv[0].GetT() && mEnv[0].GetT() == mEnv[1].GetT() )
+   if ( t0 <= mEnv[0].GetT() && mEnv[0].GetT() == mEnv[1].GetT() )
       increment = leftLimit ? -epsilon : epsilon;
 
-   double tprev, vprev, tnext = 0, vnext, vstep = 0;
-
-   for (int b = 0; b < bufferLen; b++) {
-
-      // Get easiest cases out the way first...
-      // IF empty envelope THEN default value
-      if (len <= 0) {
-         buffer[b] = mDefaultValue;
-         t += tstep;
-         continue;
-      }
-
-      auto tplus = t + increment;
-
-      // IF before envelope THEN first value
-      if ( leftLimit ? tplus <= mEnv[0].GetT() : tplus < mEnv[0].GetT() ) {
-         buffer[b] = mEnv[0].GetVal();
-         t += tstep;
-         continue;
+   // Whether time tt falls in the interval that ends before the point at
+   // time tpoint; be careful to get the correct limit even in case
+   // epsilon == 0
+   auto before = [leftLimit](double tt, double tpoint) {
+      return leftLimit ? tt <= tpoint : tt < tpoint;
+   };
+
+   // Index after the run of samples, starting from first, that are before
+   // the point at time tpoint.  Sample times are computed from t0, not
+   // accumulated, so runs agree however the buffer is divided.
+   auto runEnd = [&](int first, double tpoint) {
+      auto end = first + 1;
+      while (end < bufferLen &&
+             before(t0 + end * tstep + increment, tpoint))
+         ++end;
+      return end;
+   };
+
+   // Fill whole runs at once, constant before the first point and after the
+   // last, linear in each interval between points, in simple loops that the
+   // compiler can vectorize
+   for (int b = 0; b < bufferLen;) {
+      const double t = t0 + b * tstep;
+      const auto tplus = t + increment;
+      int end;
+
+      if ( before( tplus, mEnv[0].GetT() ) ) {
+         // IF before envelope THEN first value
+         end = runEnd( b, mEnv[0].GetT() );
+         std::fill(buffer + b, buffer + end, mEnv[0].GetVal());
       }
-      // IF after envelope THEN last value
-      if ( leftLimit
-            ? tplus > mEnv[len - 1].GetT() : tplus >= mEnv[len - 1].GetT() ) {
-         buffer[b] = mEnv[len - 1].GetVal();
-         t += tstep;
-         continue;
+      else if ( !before( tplus, mEnv[len - 1].GetT() ) ) {
+         // IF after envelope THEN last value, for the rest, because time
+         // only increases
+         end = bufferLen;
+         std::fill(buffer + b, buffer + end, mEnv[len - 1].GetVal());
       }
-
-      // be careful to get the correct limit even in case epsilon == 0
-      if ( b == 0 ||
-           ( leftLimit ? tplus > tnext : tplus >= tnext ) ) {
-
-         // We're beyond our tnext, so find the next one.
+      else {
+         // Find the interval.
          // Don't just increment lo or hi because we might
          // be zoomed far out and that could be a large number of
          // points to move over.  That's why we binary search.
@@ -260,8 +409,8 @@ void Envelope::GetValuesRelative
          // mEnv[len - 1] is after tplus, therefore hi <= len - 1
          wxASSERT( lo >= 0 && hi <= len - 1 );
 
-         tprev = mEnv[lo].GetT();
-         tnext = mEnv[hi].GetT();
+         const double tprev = mEnv[lo].GetT();
+         const double tnext = mEnv[hi].GetT();
 
          if ( hi + 1 < len && tnext == mEnv[ hi + 1 ].GetT() )
             // There is a discontinuity after this point-to-point interval.
@@ -276,13 +425,13 @@ void Envelope::GetValuesRelative
          else
             increment = 0;
 
-         vprev = GetInterpolationStartValueAtPoint( lo );
-         vnext = GetInterpolationStartValueAtPoint( hi );
+         const double vprev = GetInterpolationStartValueAtPoint( lo );
+         const double vnext = GetInterpolationStartValueAtPoint( hi );
 
-         // Interpolate, either linear or log depending on mDB.
+         // Interpolate linearly
          double dt = (tnext - tprev);
          double to = t - tprev;
-         double v;
+         double v, vstep;
          if (dt > 0.0)
          {
             v = (vprev * (dt - to) + vnext * to) / dt;
@@ -294,12 +443,13 @@ void Envelope::GetValuesRelative
             vstep = 0.0;
          }
 
-         buffer[b] = v;
-      } else {
-         buffer[b] = buffer[b - 1] + vstep;
+         end = runEnd( b, tnext );
+         const auto run = buffer + b;
+         for (int k = 0, n = end - b; k < n; ++k)
+            run[k] = v + k * vstep;
       }
 
-      t += tstep;
+      b = end;
    }
 }
 
@@ -312,6 +462,13 @@ void Envelope::GetValues
    // Getting many envelope values, corresponding to pixel columns, which may
    // not be uniformly spaced in time when there is a fisheye.
 
+   // A constant envelope needs no times
+   if (mEnv.size() <= 1) {
+      std::fill(buffer, buffer + std::max(0, bufferLen),
+         mEnv.empty() ? mDefaultValue : mEnv[0].GetVal());
+      return;
+   }
+
    for ( int xx = 0; xx < bufferLen; ++xx ) 
    {
       auto time = zoomInfo.PositionToTime( xx, -leftOffset );
@@ -323,6 +480,14 @@ void Envelope::GetValues
    }
 }
 
+bool Envelope::IsUnity() const
+{
+   if (mEnv.empty())
+      return mDefaultValue == 1.0;
+   return std::all_of(mEnv.begin(), mEnv.end(),
+      [](const EnvPoint &point) { return point.GetVal() == 1.0; });
+}
+
 void Envelope::print() const
 {
    for( unsigned int i = 0; i < mEnv.size(); i++ )
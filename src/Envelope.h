@@ -79,6 +79,40 @@ public:
     * more than one value in a row. */
    void GetValues(double *buffer, int len, double t0, double tstep) const;
 
+   /** \brief Whether the value is 1 at all times, so that applying the
+    * envelope changes nothing */
+   bool IsUnity() const;
+
+   /** \brief Return number of points */
+   size_t GetNumberOfPoints() const { return mEnv.size(); }
+
+   /** \brief The points, in relative time, for saving */
+   const EnvArray &GetPoints() const { return mEnv; }
+   /** \brief Replace the points with saved ones, sorted by relative time */
+   void SetPoints(EnvArray &&points)
+   {
+      mEnv = std::move(points);
+      mSearchGuess = -2;
+   }
+
+   /** \brief Add a point at a relative time, or replace the value of the
+    * last point at that time.  Returns the index of the point.
+    *
+    * Adding after the last point, as in recording automation, takes
+    * constant time. */
+   int InsertOrReplaceRelative(double when, double value);
+
+   /** \brief Add many points, in relative time, in any order, with one
+    * merge into the points there are.  The new points go after those
+    * already at the same times. */
+   void InsertPoints(EnvArray &&points);
+
+   /** \brief Remove points that the line between their neighbours passes
+    * within tolerance of, leaving the first and last, and the pairs of
+    * points at the same time that make a step.  Returns how many were
+    * removed. */
+   size_t Simplify(double tolerance);
+
    /** \brief Get many envelope points for pixel columns at once,
     * but don't assume uniform time per pixel.
    */
@@ -105,6 +139,11 @@ private:
 
    std::pair<int, int> EqualRange( double when, double sampleDur ) const;
 
+   // Copy the points [begin, end) of orig, with points at the bounds of
+   // this envelope where orig goes on past them
+   void CopyRange(const Envelope &orig, size_t begin, size_t end);
+   void AddPointAtEnd( double t, double val );
+
 private:
    // relative time
    void BinarySearchForTime( int &Lo, int &Hi, double t ) const;
@@ -32,10 +32,4 @@
 #define CFG_A( x ) x
 #define CFG_DA( x ) 
 
-// PRL 17 Mar 2018
-// Hoping to commit to use of this branch before 2.3.0 is out.
-// Don't use our own RingBuffer class, but reuse PortAudio's which includes
-// proper memory fences.
-#undef EXPERIMENTAL_REWRITE_RING_BUFFER
-
 #endif
@@ -814,6 +814,12 @@ extern "C" {
       (AVPacket *pkt),
       (pkt)
    );
+   FFMPEG_FUNCTION_WITH_RETURN(
+      int,
+      av_dup_packet,
+      (AVPacket *pkt),
+      (pkt)
+   );
    FFMPEG_FUNCTION_WITH_RETURN(
       AVFifoBuffer*,
       av_fifo_alloc,
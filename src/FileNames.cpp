@@ -22,6 +22,8 @@ used throughout Audacity into this one place.
 
 #include "Audacity.h"
 
+#include <algorithm>
+
 #include <wx/defs.h>
 #include <wx/filename.h>
 #include <wx/intl.h>
@@ -29,6 +31,7 @@ used throughout Audacity into this one place.
 #include "Prefs.h"
 #include "FileNames.h"
 #include "Internat.h"
+#include "MemoryX.h"
 #include "PlatformCompatibility.h"
 #include "wxFileNameWrapper.h"
 #include "../lib-src/FileDialog/FileDialog.h"
@@ -39,6 +42,23 @@ used throughout Audacity into this one place.
 
 #if defined(__WXMSW__)
 #include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#endif
+
+#if defined(__linux__)
+#include <sys/sendfile.h>
+#elif defined(__WXMAC__)
+#include <copyfile.h>
+#endif
+
+#if defined(__linux__) && !defined(FICLONE)
+// From linux/fs.h, where kernel headers are older than 4.5
+#define FICLONE _IOW(0x94, 9, int)
 #endif
 
 static wxString gDataDir;
@@ -69,6 +89,128 @@ bool FileNames::CopyFile(
 #endif
 }
 
+bool FileNames::ShareFile(const wxString& file1, const wxString& file2)
+{
+   if (wxFileExists(file2))
+      wxRemoveFile(file2);
+
+#if defined(__WXMSW__)
+
+   // Hard links need NTFS and the same volume
+   if (::CreateHardLinkW(file2.wc_str(), file1.wc_str(), NULL))
+      return true;
+
+#else
+
+#if defined(FICLONE)
+   {
+      // Copy-on-write clone (btrfs, XFS); the files stay independent
+      int in = open(OSFILENAME(file1), O_RDONLY);
+      if (in >= 0) {
+         int out = open(OSFILENAME(file2), O_WRONLY | O_CREAT | O_EXCL, 0666);
+         bool cloned = false;
+         if (out >= 0) {
+            cloned = ioctl(out, FICLONE, in) == 0;
+            close(out);
+            if (!cloned)
+               unlink(OSFILENAME(file2));
+         }
+         close(in);
+         if (cloned)
+            return true;
+      }
+   }
+#endif
+
+   // Same data, same inode, one more link
+   if (link(OSFILENAME(file1), OSFILENAME(file2)) == 0)
+      return true;
+
+#endif
+
+   return CopyFileData(file1, file2);
+}
+
+bool FileNames::CopyFileData(const wxString& file1, const wxString& file2)
+{
+#if defined(__WXMSW__)
+
+   // Windows chooses large unbuffered transfers itself
+   return ::CopyFileW(file1.wc_str(), file2.wc_str(), FALSE) != 0;
+
+#else
+
+   int in = open(OSFILENAME(file1), O_RDONLY);
+   if (in < 0)
+      return false;
+   struct stat st;
+   int out = -1;
+   if (fstat(in, &st) == 0)
+      out = open(OSFILENAME(file2), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+   if (out < 0) {
+      close(in);
+      return false;
+   }
+
+   bool copied = false;
+
+#if defined(__linux__)
+   // In the kernel, without passing the data through user space; where
+   // that fails, the loop below goes on from where it stopped
+   off_t left = st.st_size;
+   while (left > 0) {
+      const auto sent = sendfile(out, in, nullptr,
+         std::min<off_t>(left, 1 << 30));
+      if (sent < 0 && errno == EINTR)
+         continue;
+      if (sent <= 0)
+         break;
+      left -= sent;
+   }
+   copied = left == 0;
+#elif defined(__WXMAC__)
+   copied = fcopyfile(in, out, nullptr, COPYFILE_DATA) == 0;
+#endif
+
+   if (!copied) {
+      // Large reads and writes, so that several at once stay near the
+      // bandwidth of the device
+      const size_t bufferSize = 1024 * 1024;
+      ArrayOf<char> buffer{ bufferSize };
+      copied = true;
+      for (;;) {
+         const auto got = read(in, buffer.get(), bufferSize);
+         if (got < 0 && errno == EINTR)
+            continue;
+         if (got <= 0) {
+            copied = got == 0;
+            break;
+         }
+         for (ssize_t put = 0; copied && put < got;) {
+            const auto wrote = write(out, buffer.get() + put, got - put);
+            if (wrote < 0 && errno == EINTR)
+               continue;
+            copied = wrote > 0;
+            put += std::max<ssize_t>(wrote, 0);
+         }
+         if (!copied)
+            break;
+      }
+   }
+
+   // As CopyFile() checks, for the same reason
+   struct stat written;
+   copied = copied && fstat(out, &written) == 0 &&
+      written.st_size == st.st_size;
+   copied = close(out) == 0 && copied;
+   close(in);
+   if (!copied)
+      unlink(OSFILENAME(file2));
+   return copied;
+
+#endif
+}
+
 wxString FileNames::MkDir(const wxString &Str)
 {
    // Behaviour of wxFileName::DirExists() and wxFileName::MkDir() has
@@ -27,6 +27,17 @@ public:
    static bool CopyFile(
       const wxString& file1, const wxString& file2, bool overwrite = true);
 
+   // Make file2 share the data of file1 without copying them, by a
+   // copy-on-write clone if the file system supports it, else by a hard
+   // link; failing both, copy.  Only for files never modified in place,
+   // such as block files.  Overwrites file2.
+   static bool ShareFile(const wxString& file1, const wxString& file2);
+
+   // Copy the data of file1, not its times or permissions, to file2, in
+   // the kernel where the system can, else in large pieces.  Overwrites
+   // file2.  Logs nothing, so that several threads may copy at once.
+   static bool CopyFileData(const wxString& file1, const wxString& file2);
+
    static wxString MkDir(const wxString &Str);
    static wxString TempDir();
 
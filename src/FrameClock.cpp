@@ -0,0 +1,192 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  FrameClock.cpp
+
+*******************************************************************//**
+
+\class FrameClock
+\brief One timer for the periodic updates of all windows.
+
+The track panels, the meters and the projects each had a timer of their
+own, which woke the main thread at times of their own, and painted each
+window as it went.  Now each subscribes for a period, and the clock ticks
+at a whole number of frames of the display, the refresh rate of which
+wxDisplay gives, or 60 Hz if it does not know.  wxWidgets cannot wait
+for the vertical blank itself, so the ticks are only at the rate of the
+frames, not in step with them.
+
+The tick is the shortest period of the subscribers, rounded to frames,
+and the timer runs only while there is a subscriber.  A subscriber is
+called on the first tick that is within half a tick of its period.  A
+callback that invalidates a window asks RequestUpdate() to paint it,
+and that happens once, after all the callbacks of the tick.
+
+As the timer of the track panel did, the timer does not call the
+subscribers itself, but queues an event, so that they are not called
+within the Yield() of clipboard operations (Debian bug #765341).
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "FrameClock.h"
+
+#include <algorithm>
+
+#include <wx/display.h>
+#include <wx/time.h>
+
+namespace {
+   const int kDefaultRefreshRate = 60;
+}
+
+FrameClock::Subscription::Subscription(Subscription &&other)
+   : mId{ other.mId }
+{
+   other.mId = 0;
+}
+
+auto FrameClock::Subscription::operator= (Subscription &&other)
+   -> Subscription &
+{
+   if (this != &other) {
+      reset();
+      mId = other.mId;
+      other.mId = 0;
+   }
+   return *this;
+}
+
+void FrameClock::Subscription::reset()
+{
+   if (mId) {
+      FrameClock::Get().Unsubscribe(mId);
+      mId = 0;
+   }
+}
+
+FrameClock &FrameClock::Get()
+{
+   static FrameClock clock;
+   return clock;
+}
+
+FrameClock::FrameClock()
+{
+   Bind(wxEVT_TIMER, &FrameClock::OnTick, this);
+}
+
+void FrameClock::Timer::Notify()
+{
+   // QueueEvent() will take ownership of the event
+   mClock.QueueEvent(safenew wxTimerEvent(*this));
+}
+
+auto FrameClock::Subscribe(int periodMs, Callback callback) -> Subscription
+{
+   const auto id = mNextId++;
+   mSubscribers.push_back(
+      { id, std::max(1, periodMs), wxGetLocalTimeMillis(),
+        std::move(callback) });
+   Reschedule();
+   return Subscription{ id };
+}
+
+void FrameClock::Unsubscribe(unsigned id)
+{
+   const auto iter = std::find_if(mSubscribers.begin(), mSubscribers.end(),
+      [=](const Subscriber &subscriber){ return subscriber.id == id; });
+   if (iter == mSubscribers.end())
+      return;
+
+   if (mInTick)
+      // OnTick() erases it after the loop
+      iter->callback = nullptr;
+   else {
+      mSubscribers.erase(iter);
+      Reschedule();
+   }
+}
+
+void FrameClock::Reschedule()
+{
+   if (mSubscribers.empty()) {
+      mTimer.reset();
+      mTickMs = 0;
+      return;
+   }
+
+   if (mFrameMs == 0) {
+      int rate = 0;
+      if (wxDisplay::GetCount() > 0)
+         rate = wxDisplay(0u).GetCurrentMode().refresh;
+      if (rate <= 0)
+         rate = kDefaultRefreshRate;
+      mFrameMs = std::max(1, (1000 + rate / 2) / rate);
+   }
+
+   int shortest = mSubscribers.front().periodMs;
+   for (const auto &subscriber : mSubscribers)
+      shortest = std::min(shortest, subscriber.periodMs);
+   const int frames = std::max(1, (shortest + mFrameMs / 2) / mFrameMs);
+   const int tickMs = frames * mFrameMs;
+
+   if (!mTimer)
+      mTimer = std::make_unique<Timer>(*this);
+   if (tickMs != mTickMs || !mTimer->IsRunning()) {
+      mTickMs = tickMs;
+      mTimer->Start(mTickMs, wxTIMER_CONTINUOUS);
+   }
+}
+
+void FrameClock::RequestUpdate(wxWindow *window)
+{
+   if (!mInTick) {
+      window->Update();
+      return;
+   }
+   const auto iter = std::find_if(
+      mPendingUpdates.begin(), mPendingUpdates.end(),
+      [=](const wxWeakRef<wxWindow> &pending){
+         return pending.get() == window; });
+   if (iter == mPendingUpdates.end())
+      mPendingUpdates.push_back(window);
+}
+
+void FrameClock::OnTick(wxTimerEvent &)
+{
+   if (mInTick)
+      return;
+
+   const auto now = wxGetLocalTimeMillis();
+   mInTick = true;
+   {
+      auto cleanup = finally([&]{
+         mInTick = false;
+         mSubscribers.erase(
+            std::remove_if(mSubscribers.begin(), mSubscribers.end(),
+               [](const Subscriber &subscriber){
+                  return !subscriber.callback; }),
+            mSubscribers.end());
+         mPendingUpdates.clear();
+         Reschedule();
+      });
+
+      // Those subscribing meanwhile wait for the next tick
+      for (size_t ii = 0, nn = mSubscribers.size(); ii < nn; ++ii) {
+         auto &subscriber = mSubscribers[ii];
+         if (!subscriber.callback ||
+             (now - subscriber.last) + mTickMs / 2 < subscriber.periodMs)
+            continue;
+         subscriber.last = now;
+         // Copy it, as the callback may subscribe, and move the vector
+         const auto callback = subscriber.callback;
+         callback();
+      }
+
+      for (const auto &window : mPendingUpdates)
+         if (window)
+            window->Update();
+   }
+}
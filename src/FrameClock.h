@@ -0,0 +1,89 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  FrameClock.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_FRAME_CLOCK__
+#define __AUDACITY_FRAME_CLOCK__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+
+#include <functional>
+#include <vector>
+
+#include <wx/event.h>
+#include <wx/timer.h>
+#include <wx/weakref.h>
+#include <wx/window.h>
+
+/// One timer for the periodic updates of all windows, ticking at frames of
+/// the display, so that the track panels, the meters and the projects wake
+/// up together, and each window is painted once a tick.
+class AUDACITY_DLL_API FrameClock final : public wxEvtHandler {
+ public:
+   using Callback = std::function< void() >;
+
+   /// Unsubscribes when destroyed or reset
+   class Subscription {
+    public:
+      Subscription() = default;
+      Subscription(Subscription &&other);
+      Subscription &operator= (Subscription &&other);
+      ~Subscription() { reset(); }
+
+      void reset();
+      explicit operator bool() const { return mId != 0; }
+
+    private:
+      friend FrameClock;
+      explicit Subscription(unsigned id) : mId{ id } {}
+      unsigned mId { 0 };
+   };
+
+   static FrameClock &Get();
+
+   /// Calls callback on the main thread, on the first tick at least
+   /// periodMs after it last did
+   Subscription Subscribe(int periodMs, Callback callback);
+
+   /// Within a callback, paint the window after all the callbacks of the
+   /// tick, once, however many of them invalidated it; otherwise, now
+   void RequestUpdate(wxWindow *window);
+
+ private:
+   FrameClock();
+
+   struct Subscriber {
+      unsigned id;
+      int periodMs;
+      wxLongLong last;
+      Callback callback; // empty when unsubscribed during a tick
+   };
+
+   void Unsubscribe(unsigned id);
+   void Reschedule();
+   void OnTick(wxTimerEvent &evt);
+
+   class Timer final : public wxTimer {
+    public:
+      explicit Timer(FrameClock &clock) : mClock(clock) {}
+      void Notify() override;
+    private:
+      FrameClock &mClock;
+   };
+   // Only while there are subscribers
+   std::unique_ptr<Timer> mTimer;
+
+   std::vector<Subscriber> mSubscribers;
+   std::vector< wxWeakRef<wxWindow> > mPendingUpdates;
+   unsigned mNextId { 1 };
+   int mFrameMs { 0 };
+   int mTickMs { 0 };
+   bool mInTick { false };
+};
+
+#endif
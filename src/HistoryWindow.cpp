@@ -14,6 +14,9 @@
 and undo previous commands.  Also allows you to selectively clear the
 undo memory so as to free up space.
 
+The list is virtual: it asks for the text of the rows it shows only, so
+that updating it costs as much for a long history as for a short one.
+
 *//*******************************************************************/
 
 #include "Audacity.h"
@@ -47,6 +50,52 @@ enum {
    ID_DISCARD_CLIPBOARD
 };
 
+namespace {
+
+// Takes its rows from the UndoManager as it draws them
+class HistoryListCtrl final : public wxListCtrl
+{
+public:
+   HistoryListCtrl(wxWindow *parent, UndoManager *manager, const int &selected)
+      : wxListCtrl(parent, wxID_ANY, wxDefaultPosition, wxSize(230, 120),
+           wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL |
+           wxLC_HRULES | wxLC_VRULES | wxSUNKEN_BORDER)
+      , mManager{ manager }
+      , mSelected{ selected }
+   {
+      mGreyAttr.SetTextColour(*wxLIGHT_GREY);
+   }
+
+   wxString OnGetItemText(long item, long column) const override
+   {
+      if (item < 0 || item >= (long)mManager->GetNumStates())
+         return {};
+      wxString desc, size;
+      mManager->GetLongDescription(item + 1, &desc, &size);
+      return column == 0 ? desc : size;
+   }
+
+   int OnGetItemImage(long item) const override
+   {
+      return item == mSelected ? 1 : 0;
+   }
+
+   wxListItemAttr *OnGetItemAttr(long item) const override
+   {
+      // States after the selected one are what Redo may reach
+      return item > mSelected
+         ? const_cast<wxListItemAttr*>(&mGreyAttr)
+         : nullptr;
+   }
+
+private:
+   UndoManager *const mManager;
+   const int &mSelected;
+   wxListItemAttr mGreyAttr;
+};
+
+}
+
 BEGIN_EVENT_TABLE(HistoryWindow, wxDialogWrapper)
    EVT_SIZE(HistoryWindow::OnSize)
    EVT_CLOSE(HistoryWindow::OnCloseWindow)
@@ -80,10 +129,10 @@ HistoryWindow::HistoryWindow(AudacityProject *parent, UndoManager *manager):
    {
       S.StartStatic(_("&Manage History"), 1);
       {
-         mList = S.AddListControlReportMode();
-         // Do this BEFORE inserting the columns.  On the Mac at least, the
-         // columns are deleted and later InsertItem()s will cause Audacity to crash.
-         mList->SetSingleStyle(wxLC_SINGLE_SEL);
+         // Single selection is in the style, as setting it later deletes
+         // the columns, on the Mac at least
+         mList = safenew HistoryListCtrl(S.GetParent(), mManager, mSelected);
+         S.Prop(1).AddWindow(mList, wxEXPAND | wxALL);
          mList->InsertColumn(0, _("Action"), wxLIST_FORMAT_LEFT, 260);
          mList->InsertColumn(1, _("Reclaimable Space"), wxLIST_FORMAT_LEFT, 125);
 
@@ -176,23 +225,17 @@ void HistoryWindow::UpdateDisplay()
 
 void HistoryWindow::DoUpdate()
 {
-   int i;
-
+   // Counts again only what changed since the last time
    mManager->CalculateSpaceUsage();
 
-   mList->DeleteAllItems();
-
-   wxLongLong_t total = 0;
    mSelected = mManager->GetCurrentState() - 1;
-   for (i = 0; i < (int)mManager->GetNumStates(); i++) {
-      wxString desc, size;
-
-      total += mManager->GetLongDescription(i + 1, &desc, &size);
-      mList->InsertItem(i, desc, i == mSelected ? 1 : 0);
-      mList->SetItem(i, 1, size);
-   }
+   const long count = mManager->GetNumStates();
+   if (mList->GetItemCount() != count)
+      mList->SetItemCount(count);
+   if (count > 0)
+      mList->RefreshItems(0, count - 1);
 
-   mTotal->SetValue(Internat::FormatSize(total));
+   mTotal->SetValue(Internat::FormatSize(mManager->GetTotalSpaceUsage()));
 
    auto clipboardUsage = mManager->GetClipboardSpaceUsage();
    mClipboard->SetValue(Internat::FormatSize(clipboardUsage));
@@ -238,12 +281,8 @@ void HistoryWindow::OnDiscard(wxCommandEvent & WXUNUSED(event))
 {
    int i = mLevels->GetValue();
 
-   mSelected -= i;
    mManager->RemoveStates(i);
 
-   while(--i >= 0)
-      mList->DeleteItem(i);
-
    DoUpdate();
 }
 
@@ -262,19 +301,11 @@ void HistoryWindow::OnItemSelected(wxListEvent &event)
       return;
    }
 
-   int selected = event.GetIndex();
-   int i;
+   mSelected = event.GetIndex();
 
-   for (i = 0; i < mList->GetItemCount(); i++) {
-      mList->SetItemImage(i, 0);
-      if (i > selected)
-         mList->SetItemTextColour(i, *wxLIGHT_GREY);
-      else
-         mList->SetItemTextColour(i, mList->GetTextColour());
-   }
-   mList->SetItemImage(selected, 1);
-
-   mSelected = selected;
+   // Only the rows shown are drawn again
+   if (mList->GetItemCount() > 0)
+      mList->RefreshItems(0, mList->GetItemCount() - 1);
 
    UpdateLevels();
 }
@@ -29,6 +29,67 @@ channel.  This collection of functions fills that gap.
 #include "AllThemeResources.h"
 #include "Theme.h"
 
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <tuple>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_MANIPULATION_SSE2
+#endif
+
+namespace {
+
+// dst[i] = (a[i] * (255 - w[i]) + b[i] * w[i]) / 255, rounded down, for n
+// bytes.  dst may be a or b.
+void BlendBytes(unsigned char *dst, const unsigned char *a,
+                const unsigned char *b, const unsigned char *w, size_t n)
+{
+   size_t i = 0;
+#ifdef IMAGE_MANIPULATION_SSE2
+   // Sixteen bytes at once, in two halves of 16 bit lanes; the sum is at
+   // most 255 * 255, and (x + 1 + (x >> 8)) >> 8 is x / 255 for all such x
+   const __m128i zero = _mm_setzero_si128();
+   const __m128i max = _mm_set1_epi16(255);
+   const __m128i one = _mm_set1_epi16(1);
+   auto blend = [&](__m128i va, __m128i vb, __m128i vw) {
+      const __m128i sum = _mm_add_epi16(
+         _mm_mullo_epi16(va, _mm_sub_epi16(max, vw)), _mm_mullo_epi16(vb, vw));
+      return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(sum, one),
+         _mm_srli_epi16(sum, 8)), 8);
+   };
+   for (; i + 16 <= n; i += 16) {
+      const __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+      const __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+      const __m128i vw = _mm_loadu_si128((const __m128i *)(w + i));
+      const __m128i lo = blend(_mm_unpacklo_epi8(va, zero),
+         _mm_unpacklo_epi8(vb, zero), _mm_unpacklo_epi8(vw, zero));
+      const __m128i hi = blend(_mm_unpackhi_epi8(va, zero),
+         _mm_unpackhi_epi8(vb, zero), _mm_unpackhi_epi8(vw, zero));
+      _mm_storeu_si128((__m128i *)(dst + i), _mm_packus_epi16(lo, hi));
+   }
+#endif
+   for (; i < n; ++i)
+      dst[i] = (a[i] * (255 - w[i]) + b[i] * w[i]) / 255;
+}
+
+// Each of n weights, taken every stride bytes, three times over, for the
+// three colour bytes of a pixel
+void SpreadWeights(unsigned char *dst, const unsigned char *src,
+                   size_t n, size_t stride)
+{
+   for (size_t i = 0; i < n; ++i, src += stride) {
+      *dst++ = *src;
+      *dst++ = *src;
+      *dst++ = *src;
+   }
+}
+
+}
+
 /// This looks at the first pixel in the image, and shifts
 /// the entire image by the vector difference between that
 /// pixel and the dstColour.  For better control, use
@@ -80,17 +141,21 @@ std::unique_ptr<wxImage> ChangeImageColour(wxImage * srcImage,
       dstOpp[i] = 255 - dstVal[i];
    }
 
-   int c = 0;
-   for (i = 0; i < width * height * 3; i++) {
-      int s = (int) *src;
-
-      if (s >= srcVal[c])
-         *dst++ = dstVal[c] + dstOpp[c] * (s - srcVal[c]) / srcOpp[c];
+   // Work out the NEW value of each of the 256 of each channel once, rather
+   // than dividing for each byte
+   unsigned char table[3][256];
+   for (int c = 0; c < 3; c++)
+      for (int s = 0; s < 256; s++) {
+         if (s >= srcVal[c])
+            table[c][s] = dstVal[c] + dstOpp[c] * (s - srcVal[c]) / srcOpp[c];
+         else
+            table[c][s] = dstVal[c] * s / srcVal[c];
+      }
 
-      else
-         *dst++ = dstVal[c] * s / srcVal[c];
-      src++;
-      c = (c + 1) % 3;
+   for (i = 0; i < width * height; i++) {
+      *dst++ = table[0][*src++];
+      *dst++ = table[1][*src++];
+      *dst++ = table[2][*src++];
    }
 
    return dstImage;
@@ -142,22 +207,19 @@ std::unique_ptr<wxImage> OverlayImage(wxImage * background, wxImage * foreground
    // background, at an offset of xoff,yoff.
    // BUT...Don't go beyond the size of the background image,
    // the foreground image, or the mask
-   int x, y;
+   if (wCutoff <= 0)
+      return dstImage;
+   std::vector<unsigned char> weights(3 * wCutoff);
+   int y;
    for (y = 0; y < hCutoff; y++) {
 
       unsigned char *bkp = bg + 3 * ((y + yoff) * bgWidth + xoff);
       unsigned char *dstp = dst + 3 * ((y + yoff) * bgWidth + xoff);
 
-      for (x = 0; x < wCutoff; x++) {
-
-         int value = mk[3 * (y * mkWidth + x)];
-         int opp = 255 - value;
-
-         for (int c = 0; c < 3; c++)
-            dstp[x * 3 + c] =
-               ((bkp[x * 3 + c] * opp) +
-                (fg[3 * (y * fgWidth + x) + c] * value)) / 255;
-      }
+      // The mask is grey; its red is the weight of the foreground
+      SpreadWeights(weights.data(), mk + 3 * (y * mkWidth), wCutoff, 3);
+      BlendBytes(dstp, bkp, fg + 3 * (y * fgWidth), weights.data(),
+                 3 * wCutoff);
    }
    return dstImage;
 }
@@ -167,12 +229,9 @@ std::unique_ptr<wxImage> OverlayImage(wxImage * background, wxImage * foreground
 /// returns an NEW image where the foreground has been
 /// overlaid onto the background using alpha-blending,
 /// at location (xoff, yoff).
-std::unique_ptr<wxImage> OverlayImage(teBmps eBack, teBmps eForeground,
-                      int xoff, int yoff)
+static std::unique_ptr<wxImage> ComposeOverlayImage(
+   const wxImage &imgBack, const wxImage &imgFore, int xoff, int yoff)
 {
-   wxImage imgBack(theTheme.Image( eBack       ));
-   wxImage imgFore(theTheme.Image( eForeground ));
-
 
    // TMP: dmazzoni - just so the code runs even though not all of
    // our images have transparency...
@@ -217,17 +276,18 @@ std::unique_ptr<wxImage> OverlayImage(teBmps eBack, teBmps eForeground,
    if( imgBack.HasAlpha() ){
       unsigned char *pAlpha = imgBack.GetAlpha();
       wxColour c = theTheme.Colour( clrMedium  );
-      unsigned char onePixImage[3];
       // GetData() guarantees RGB order [wxWidgets does the ocnversion]
-      onePixImage[ 0 ] = c.Red();
-      onePixImage[ 1 ] = c.Green();
-      onePixImage[ 2 ] = c.Blue();
-      for( int i=0;i< bgWidth*bgHeight;i++){
-         unsigned char * pPix = &dst[ 3*i];
-         float alpha = 1.0 - (pAlpha[i]/255.0);
-         pPix[0] = pPix[0] + alpha *( (int)onePixImage[0]-(int)pPix[0]);
-         pPix[1] = pPix[1] + alpha *( (int)onePixImage[1]-(int)pPix[1]);
-         pPix[2] = pPix[2] + alpha *( (int)onePixImage[2]-(int)pPix[2]);
+      std::vector<unsigned char> colourRow( 3 * bgWidth );
+      for( int i=0;i< bgWidth;i++){
+         colourRow[ 3*i ] = c.Red();
+         colourRow[ 3*i + 1 ] = c.Green();
+         colourRow[ 3*i + 2 ] = c.Blue();
+      }
+      std::vector<unsigned char> weights( 3 * bgWidth );
+      for( int y=0;y< bgHeight;y++){
+         unsigned char * pRow = &dst[ 3*y*bgWidth ];
+         SpreadWeights( weights.data(), pAlpha + y*bgWidth, bgWidth, 1 );
+         BlendBytes( pRow, colourRow.data(), pRow, weights.data(), 3*bgWidth );
       }
    }
 
@@ -235,24 +295,51 @@ std::unique_ptr<wxImage> OverlayImage(teBmps eBack, teBmps eForeground,
    // background, at an offset of xoff,yoff.
    // BUT...Don't go beyond the size of the background image,
    // the foreground image, or the mask
-   int x, y;
+   if (wCutoff <= 0)
+      return dstImage;
+   std::vector<unsigned char> weights(3 * wCutoff);
+   int y;
    for (y = 0; y < hCutoff; y++) {
 
       unsigned char *bkp = bg + 3 * ((y + yoff) * bgWidth + xoff);
       unsigned char *dstp = dst + 3 * ((y + yoff) * bgWidth + xoff);
 
-      for (x = 0; x < wCutoff; x++) {
+      SpreadWeights(weights.data(), mk + y * fgWidth, wCutoff, 1);
+      BlendBytes(dstp, bkp, fg + 3 * (y * fgWidth), weights.data(),
+                 3 * wCutoff);
+   }
+   return dstImage;
+}
 
-         int value = mk[(y * fgWidth + x)];// Don't multiply by 3...
-         int opp = 255 - value;
+std::unique_ptr<wxImage> OverlayImage(teBmps eBack, teBmps eForeground,
+                      int xoff, int yoff)
+{
+   wxImage imgBack(theTheme.Image( eBack       ));
+   wxImage imgFore(theTheme.Image( eForeground ));
 
-         for (int c = 0; c < 3; c++)
-            dstp[x * 3 + c] =
-               ((bkp[x * 3 + c] * opp) +
-                (fg[3 * (y * fgWidth + x) + c] * value)) / 255;
-      }
+   // Toolbars make the same few buttons again at each relayout and change
+   // of theme, so keep what was composed.  An entry holds the theme images
+   // it was made from, which keeps their data alive, so the data of
+   // different images can't be taken for the same.
+   struct Composed {
+      wxImage back, fore;
+      wxColour medium;
+      wxImage result;
+   };
+   static std::map< std::tuple<teBmps, teBmps, int, int>, Composed > cache;
+
+   const auto medium = theTheme.Colour( clrMedium );
+   auto &composed = cache[ std::make_tuple( eBack, eForeground, xoff, yoff ) ];
+   if ( !composed.result.IsOk() ||
+        !composed.back.IsSameAs( imgBack ) ||
+        !composed.fore.IsSameAs( imgFore ) ||
+        composed.medium != medium ) {
+      composed = Composed{ imgBack, imgFore, medium,
+         *ComposeOverlayImage( imgBack, imgFore, xoff, yoff ) };
    }
-   return dstImage;
+
+   // A copy of its own, which the caller may change
+   return std::make_unique<wxImage>( composed.result.Copy() );
 }
 
 // Creates an image with a solid background color
@@ -268,11 +355,15 @@ std::unique_ptr<wxImage> CreateBackground(int width, int height, wxColour colour
    srcVal[2] = colour.Blue();
 
    ip = i->GetData();
-   for(x=0; x<width*height; x++) {
-      *ip++ = srcVal[0];
-      *ip++ = srcVal[1];
-      *ip++ = srcVal[2];
-   }
+   const size_t total = 3 * (size_t)std::max(0, width * height);
+   if (total == 0)
+      return i;
+
+   // One pixel, then copies of what is done, doubling each time
+   for(x=0; x<3; x++)
+      ip[x] = srcVal[x];
+   for (size_t done = 3; done < total; done *= 2)
+      memcpy(ip + done, ip, std::min(done, total - done));
 
    return i;
 }
@@ -0,0 +1,264 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   LoudnessAnalysis.cpp
+
+*******************************************************************//**
+
+\file LoudnessAnalysis.cpp
+\brief Integrated loudness, true peak, sample peak and RMS of a track.
+
+The sample peak and the RMS come from the summaries of the blocks,
+through WaveTrack::GetMinMax() and WaveTrack::GetRMS(), without reading
+the samples.  The rest reads them, in chunks of five seconds at once on
+a MixerPool, each chunk through a WaveTrackCache of its own.  A chunk
+that lies between clips or in blocks of silence is not read at all.
+
+For the loudness, each chunk K-weights its samples, and gives the mean
+square of every 100 ms of them.  The filters settle over the 400 ms
+before the chunk.  The 400 ms gating blocks of BS.1770, overlapping by
+three quarters, are sums of four of these, and are gated after all the
+chunks are done.  For the true peak, each chunk goes through a Resample
+at four times the rate, with a few samples after it so that the filter
+of the resampler sees past the end.  The coefficients of the
+K-weighting are those of libebur128, for any rate.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "LoudnessAnalysis.h"
+
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <vector>
+
+#include <wx/thread.h>
+
+#include "MixerPool.h"
+#include "Resample.h"
+#include "WaveTrack.h"
+
+namespace {
+
+const double kStepSecs = 0.1;
+const size_t kStepsPerBlock = 4;
+const size_t kStepsPerChunk = 50;
+const double kOversampling = 4.0;
+// Samples after a chunk for the resampler to see
+const size_t kResampleTail = 256;
+
+struct Biquad
+{
+   double b0, b1, b2, a1, a2;
+   double z1 { 0.0 }, z2 { 0.0 };
+
+   double Process(double x)
+   {
+      const double y = b0 * x + z1;
+      z1 = b1 * x - a1 * y + z2;
+      z2 = b2 * x - a2 * y;
+      return y;
+   }
+};
+
+// The head of the ear, then the high pass of the revised low frequency
+// B-curve
+void DesignKWeighting(double rate, Biquad &shelf, Biquad &highPass)
+{
+   const double pi = 3.14159265358979323846;
+   {
+      const double f0 = 1681.974450955533;
+      const double G = 3.999843853973347;
+      const double Q = 0.7071752369554196;
+      const double K = std::tan(pi * f0 / rate);
+      const double Vh = std::pow(10.0, G / 20.0);
+      const double Vb = std::pow(Vh, 0.4996667741545416);
+      const double a0 = 1.0 + K / Q + K * K;
+      shelf.b0 = (Vh + Vb * K / Q + K * K) / a0;
+      shelf.b1 = 2.0 * (K * K - Vh) / a0;
+      shelf.b2 = (Vh - Vb * K / Q + K * K) / a0;
+      shelf.a1 = 2.0 * (K * K - 1.0) / a0;
+      shelf.a2 = (1.0 - K / Q + K * K) / a0;
+   }
+   {
+      const double f0 = 38.13547087602444;
+      const double Q = 0.5003270373238773;
+      const double K = std::tan(pi * f0 / rate);
+      const double a0 = 1.0 + K / Q + K * K;
+      highPass.b0 = 1.0;
+      highPass.b1 = -2.0;
+      highPass.b2 = 1.0;
+      highPass.a1 = 2.0 * (K * K - 1.0) / a0;
+      highPass.a2 = (1.0 - K / Q + K * K) / a0;
+   }
+}
+
+double AmplitudeToDB(double amplitude)
+{
+   return amplitude > 0
+      ? 20.0 * std::log10(amplitude)
+      : -std::numeric_limits<double>::infinity();
+}
+
+double PowerToLUFS(double power)
+{
+   return power > 0
+      ? -0.691 + 10.0 * std::log10(power)
+      : -std::numeric_limits<double>::infinity();
+}
+
+// What one chunk finds
+struct Partial
+{
+   std::vector<double> power; // K-weighted, for each whole step
+   double truePeak { 0.0 };
+};
+
+void Read(const WaveTrack &track, sampleCount start, size_t len, float *dest)
+{
+   const auto pTrack = Track::Pointer<const WaveTrack>(&track);
+   if (!pTrack) {
+      // Not in a project, so no cache
+      track.Get((samplePtr)dest, floatSample, start, len);
+      return;
+   }
+   WaveTrackCache cache{ pTrack };
+   const auto src = (const float *)cache.Get(floatSample, start, len, true);
+   std::copy(src, src + len, dest);
+}
+
+}
+
+LoudnessMeasures MeasureLoudness(const WaveTrack &left, const WaveTrack *right,
+                                 double t0, double t1)
+{
+   std::vector<const WaveTrack *> channels{ &left };
+   if (right)
+      channels.push_back(right);
+
+   LoudnessMeasures result;
+
+   // From the summaries
+   double peak = 0.0, sumSquares = 0.0;
+   for (const auto channel : channels) {
+      const auto minMax = channel->GetMinMax(t0, t1);
+      peak = std::max(peak,
+         (double)std::max(std::abs(minMax.first), std::abs(minMax.second)));
+      const double rms = channel->GetRMS(t0, t1);
+      sumSquares += rms * rms;
+   }
+   result.samplePeakDB = AmplitudeToDB(peak);
+   result.rmsDB = AmplitudeToDB(std::sqrt(sumSquares / channels.size()));
+
+   const double rate = left.GetRate();
+   const auto start = left.TimeToLongSamples(t0);
+   const auto end = left.TimeToLongSamples(t1);
+   const auto step =
+      std::max<size_t>(1, (size_t)std::lround(rate * kStepSecs));
+   const auto chunkLen = step * kStepsPerChunk;
+   const auto nChunks = end > start
+      ? ((end - start - 1) / chunkLen).as_size_t() + 1
+      : 0;
+
+   std::vector<Partial> partials(nChunks);
+   std::vector<std::exception_ptr> errors(nChunks);
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   MixerPool pool{
+      unsigned(std::max<size_t>(1, std::min<size_t>(nThreads, nChunks)) - 1) };
+   pool.Run(nChunks, [&](size_t cc) {
+      // Exceptions must not escape the helper threads
+      try {
+         auto &partial = partials[cc];
+         const auto chunkStart = start + cc * chunkLen;
+         const auto len = limitSampleBufferSize(chunkLen, end - chunkStart);
+         const auto pre =
+            limitSampleBufferSize(kStepsPerBlock * step, chunkStart - start);
+         const auto post =
+            limitSampleBufferSize(kResampleTail, end - (chunkStart + len));
+         const auto from = chunkStart - pre;
+         const auto total = pre + len + post;
+         const auto nSteps = len / step;
+         partial.power.assign(nSteps, 0.0);
+
+         if (std::all_of(channels.begin(), channels.end(),
+               [&](const WaveTrack *channel) {
+                  return channel->IsSilent(from, total);
+               }))
+            return;
+
+         std::vector<float> samples(total);
+         std::vector<float> oversampled(
+            (size_t)(total * kOversampling) + kResampleTail);
+         for (const auto channel : channels) {
+            Read(*channel, from, total, samples.data());
+
+            Biquad shelf, highPass;
+            DesignKWeighting(rate, shelf, highPass);
+            for (size_t ii = 0; ii < pre + nSteps * step; ++ii) {
+               const double y =
+                  highPass.Process(shelf.Process(samples[ii]));
+               if (ii >= pre)
+                  partial.power[(ii - pre) / step] += y * y;
+            }
+
+            Resample resample(true, kOversampling, kOversampling);
+            for (size_t used = 0; used < total;) {
+               const auto results = resample.Process(kOversampling,
+                  samples.data() + used, total - used, true,
+                  oversampled.data(), oversampled.size());
+               for (size_t ii = 0; ii < results.second; ++ii)
+                  partial.truePeak = std::max(partial.truePeak,
+                     (double)std::abs(oversampled[ii]));
+               if (results.first == 0 && results.second == 0)
+                  break;
+               used += results.first;
+            }
+         }
+         for (auto &power : partial.power)
+            power /= step;
+      }
+      catch (...) {
+         errors[cc] = std::current_exception();
+      }
+   });
+   for (auto &error : errors)
+      if (error)
+         std::rethrow_exception(error);
+
+   // Gate the blocks of four steps
+   std::vector<double> steps;
+   double truePeak = peak;
+   for (const auto &partial : partials) {
+      steps.insert(steps.end(), partial.power.begin(), partial.power.end());
+      truePeak = std::max(truePeak, partial.truePeak);
+   }
+   result.truePeakDB = AmplitudeToDB(truePeak);
+
+   std::vector<double> blocks;
+   for (size_t ii = 0; ii + kStepsPerBlock <= steps.size(); ++ii) {
+      double power = 0.0;
+      for (size_t jj = 0; jj < kStepsPerBlock; ++jj)
+         power += steps[ii + jj];
+      power /= kStepsPerBlock;
+      if (PowerToLUFS(power) > -70.0)
+         blocks.push_back(power);
+   }
+   const auto mean = [](const std::vector<double> &powers) {
+      double sum = 0.0;
+      for (const auto power : powers)
+         sum += power;
+      return powers.empty() ? 0.0 : sum / powers.size();
+   };
+   const double relativeGate = PowerToLUFS(mean(blocks)) - 10.0;
+   blocks.erase(std::remove_if(blocks.begin(), blocks.end(),
+      [&](double power) { return PowerToLUFS(power) <= relativeGate; }),
+      blocks.end());
+   result.integratedLUFS = PowerToLUFS(mean(blocks));
+
+   return result;
+}
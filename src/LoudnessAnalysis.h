@@ -0,0 +1,33 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   LoudnessAnalysis.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_LOUDNESS_ANALYSIS__
+#define __AUDACITY_LOUDNESS_ANALYSIS__
+
+#include "Audacity.h"
+
+class WaveTrack;
+
+/// The level of a mono or stereo track over a time range, in decibels, or
+/// -infinity for silence
+struct LoudnessMeasures
+{
+   double integratedLUFS; // gated, as ITU-R BS.1770-4
+   double truePeakDB;     // the peak between samples too, oversampled 4 times
+   double samplePeakDB;
+   double rmsDB;
+};
+
+/// Measure the track from t0 to t1, with right the second channel of a
+/// stereo track, or null.  Reads on all cores at once.
+LoudnessMeasures MeasureLoudness(const WaveTrack &left, const WaveTrack *right,
+                                 double t0, double t1);
+
+#endif
@@ -0,0 +1,318 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MemoryPressure.cpp
+
+*******************************************************************//**
+
+\class MemoryPressure
+\brief Frees caches while the system is short of memory.
+
+Twice a second, on the main thread, it measures how short of memory the
+process is, and notes any notification the system sent meanwhile:
+
+- On Linux, the pressure stall information of /proc/pressure/memory,
+the use against the limit of the cgroup (v2) of the process, and
+MemAvailable of /proc/meminfo.
+- On Windows, the low memory resource notification, and the memory
+load of GlobalMemoryStatusEx().
+- On the Mac, the level of the last event of a dispatch source of
+memory pressure.
+
+At Moderate, the decoded blocks of the BlockCache are cut to a quarter
+of the budget, and the wave and spectrogram caches of the clips of the
+open projects are dropped, all of them cheap to make again.  At
+Critical, the BlockCache is emptied of all but pinned blocks, and the
+BlockWriter takes nothing more to write in the background, so that new
+blocks go to disk at once.  A level is shed when it is reached, and again
+every ten seconds while it lasts.  After ten seconds back at Normal, the
+limits of the preferences return.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "MemoryPressure.h"
+
+#include <algorithm>
+
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <wx/tokenzr.h>
+
+#include "DirManager.h"
+#include "Project.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+#include "blockfile/BlockCache.h"
+#include "blockfile/BlockWriter.h"
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#elif defined(__WXMAC__)
+#include <dispatch/dispatch.h>
+#endif
+
+namespace {
+
+const int kPollMs = 500;
+// Polls between sheddings at one level, and before restoring
+const int kRepeatPolls = 20;
+
+#if defined(__WXGTK__) || defined(__linux__)
+
+bool ReadFile(const wxString &path, wxString &contents)
+{
+   if (!wxFileName::FileExists(path))
+      return false;
+   wxFFile file(path, wxT("r"));
+   return file.IsOpened() && file.ReadAll(&contents);
+}
+
+// "avg10" of the line of /proc/pressure/memory beginning with kind
+double Stall(const wxString &contents, const wxString &kind)
+{
+   wxStringTokenizer lines(contents, wxT("\n"));
+   while (lines.HasMoreTokens()) {
+      const auto line = lines.GetNextToken();
+      if (!line.StartsWith(kind + wxT(" ")))
+         continue;
+      const auto pos = line.Find(wxT("avg10="));
+      double value = 0;
+      if (pos != wxNOT_FOUND && line.Mid(pos + 6).BeforeFirst(' ').ToCDouble(&value))
+         return value;
+   }
+   return 0;
+}
+
+// How much of its limit the cgroup of the process uses, or 0
+double CgroupUse()
+{
+   wxString cgroup;
+   if (!ReadFile(wxT("/proc/self/cgroup"), cgroup))
+      return 0;
+   // The v2 line is "0::/path"
+   wxString path;
+   wxStringTokenizer lines(cgroup, wxT("\n"));
+   while (lines.HasMoreTokens()) {
+      const auto line = lines.GetNextToken();
+      if (line.StartsWith(wxT("0::"), &path))
+         break;
+   }
+   if (path.empty())
+      return 0;
+
+   const wxString dir = wxT("/sys/fs/cgroup") + path.Trim();
+   wxString max, current;
+   double limit = 0, used = 0;
+   if (!ReadFile(dir + wxT("/memory.max"), max) ||
+       !ReadFile(dir + wxT("/memory.current"), current) ||
+       !max.Trim().ToCDouble(&limit) || // "max" for no limit
+       !current.Trim().ToCDouble(&used) ||
+       limit <= 0)
+      return 0;
+   return used / limit;
+}
+
+// MemAvailable over MemTotal, or 1
+double AvailableShare()
+{
+   wxString meminfo;
+   if (!ReadFile(wxT("/proc/meminfo"), meminfo))
+      return 1;
+   double total = 0, available = -1;
+   wxStringTokenizer lines(meminfo, wxT("\n"));
+   while (lines.HasMoreTokens()) {
+      const auto line = lines.GetNextToken();
+      wxString rest;
+      if (line.StartsWith(wxT("MemTotal:"), &rest))
+         rest.Trim(false).BeforeFirst(' ').ToCDouble(&total);
+      else if (line.StartsWith(wxT("MemAvailable:"), &rest))
+         rest.Trim(false).BeforeFirst(' ').ToCDouble(&available);
+   }
+   return (total > 0 && available >= 0) ? available / total : 1;
+}
+
+#endif
+
+}
+
+struct MemoryPressure::Platform {
+#if defined(__WXMSW__)
+   HANDLE lowMemory { NULL };
+#elif defined(__WXMAC__)
+   dispatch_source_t source { nullptr };
+   std::atomic<int> *notified { nullptr };
+
+   // On a queue of dispatch, not the main thread
+   static void OnEvent(void *context)
+   {
+      auto &platform = *static_cast<Platform*>(context);
+      const auto data = dispatch_source_get_data(platform.source);
+      platform.notified->store(
+         (data & DISPATCH_MEMORYPRESSURE_CRITICAL) ? Critical
+            : (data & DISPATCH_MEMORYPRESSURE_WARN) ? Moderate
+            : Normal,
+         std::memory_order_relaxed);
+   }
+#endif
+};
+
+MemoryPressure &MemoryPressure::Get()
+{
+   static MemoryPressure instance;
+   return instance;
+}
+
+MemoryPressure::MemoryPressure()
+   : mPlatform{ std::make_unique<Platform>() }
+{
+   mTimer.SetOwner(this);
+   Bind(wxEVT_TIMER, &MemoryPressure::OnTimer, this);
+}
+
+MemoryPressure::~MemoryPressure()
+{
+   Stop();
+}
+
+void MemoryPressure::Start()
+{
+#if defined(__WXMSW__)
+   if (!mPlatform->lowMemory)
+      mPlatform->lowMemory =
+         CreateMemoryResourceNotification(LowMemoryResourceNotification);
+#elif defined(__WXMAC__)
+   if (!mPlatform->source) {
+      mPlatform->notified = &mNotified;
+      mPlatform->source = dispatch_source_create(
+         DISPATCH_SOURCE_TYPE_MEMORYPRESSURE, 0,
+         DISPATCH_MEMORYPRESSURE_NORMAL | DISPATCH_MEMORYPRESSURE_WARN |
+            DISPATCH_MEMORYPRESSURE_CRITICAL,
+         dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+      if (mPlatform->source) {
+         dispatch_set_context(mPlatform->source, mPlatform.get());
+         dispatch_source_set_event_handler_f(
+            mPlatform->source, &Platform::OnEvent);
+         dispatch_resume(mPlatform->source);
+      }
+   }
+#endif
+   if (!mTimer.IsRunning())
+      mTimer.Start(kPollMs);
+}
+
+void MemoryPressure::Stop()
+{
+   mTimer.Stop();
+#if defined(__WXMSW__)
+   if (mPlatform->lowMemory) {
+      CloseHandle(mPlatform->lowMemory);
+      mPlatform->lowMemory = NULL;
+   }
+#elif defined(__WXMAC__)
+   if (mPlatform->source) {
+      // Waits for no handler, but the context outlives the source, as
+      // this is a static object
+      dispatch_source_cancel(mPlatform->source);
+      dispatch_release(mPlatform->source);
+      mPlatform->source = nullptr;
+   }
+#endif
+   if (mLevel.load(std::memory_order_relaxed) != Normal)
+      Restore();
+}
+
+void MemoryPressure::OnTimer(wxTimerEvent &)
+{
+   const auto level =
+      std::max(Measure(), (Level)mNotified.load(std::memory_order_relaxed));
+   const auto was = mLevel.load(std::memory_order_relaxed);
+
+   if (level == Normal) {
+      if (was != Normal && ++mQuietPolls >= kRepeatPolls)
+         Restore();
+      return;
+   }
+
+   mQuietPolls = 0;
+   if (level > was) {
+      mLevel.store(level, std::memory_order_relaxed);
+      mRepeatPolls = 0;
+      Shed(level);
+   }
+   else if (++mRepeatPolls >= kRepeatPolls) {
+      // Still short, maybe of what was made again since
+      mRepeatPolls = 0;
+      Shed(was);
+   }
+}
+
+MemoryPressure::Level MemoryPressure::Measure()
+{
+   Level level = Normal;
+   const auto raise = [&](Level other) { level = std::max(level, other); };
+
+#if defined(__WXMSW__)
+   BOOL low = FALSE;
+   if (mPlatform->lowMemory &&
+       QueryMemoryResourceNotification(mPlatform->lowMemory, &low) && low)
+      raise(Critical);
+
+   MEMORYSTATUSEX status;
+   status.dwLength = sizeof(status);
+   if (GlobalMemoryStatusEx(&status) && status.dwMemoryLoad > 90)
+      raise(Moderate);
+#elif defined(__WXGTK__) || defined(__linux__)
+   // Percentages of the last ten seconds in which some, or all, tasks
+   // stalled waiting for memory; kernels since 4.20
+   wxString stalls;
+   if (ReadFile(wxT("/proc/pressure/memory"), stalls)) {
+      if (Stall(stalls, wxT("full")) > 10.0)
+         raise(Critical);
+      else if (Stall(stalls, wxT("some")) > 10.0)
+         raise(Moderate);
+   }
+
+   // A container may be short long before the system is
+   const auto use = CgroupUse();
+   if (use > 0.95)
+      raise(Critical);
+   else if (use > 0.85)
+      raise(Moderate);
+
+   const auto available = AvailableShare();
+   if (available < 0.05)
+      raise(Critical);
+   else if (available < 0.10)
+      raise(Moderate);
+#endif
+
+   return level;
+}
+
+void MemoryPressure::Shed(Level level)
+{
+   const auto budget = BlockCache::GetBudget();
+   BlockCache::SetPressureLimit(level == Critical ? 0 : budget / 4);
+
+   for (const auto &project : gAudacityProjects) {
+      TrackListOfKindIterator iter(Track::Wave, project->GetTracks());
+      for (Track *t = iter.First(); t; t = iter.Next())
+         // Not the cut lines, which are not drawn
+         for (const auto &clip : static_cast<WaveTrack*>(t)->GetClips())
+            clip->ClearDisplayCaches();
+   }
+
+   if (level == Critical)
+      // New blocks go to disk at once
+      DirManager::GetBlockWriter().SetBudget(0);
+}
+
+void MemoryPressure::Restore()
+{
+   mLevel.store(Normal, std::memory_order_relaxed);
+   mQuietPolls = mRepeatPolls = 0;
+   BlockCache::SetPressureLimit(~size_t(0));
+   DirManager::UpdateBlockWriterPrefs();
+}
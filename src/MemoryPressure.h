@@ -0,0 +1,60 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  MemoryPressure.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_MEMORY_PRESSURE__
+#define __AUDACITY_MEMORY_PRESSURE__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+
+#include <atomic>
+
+#include <wx/event.h>
+#include <wx/timer.h>
+
+/// Watches how short of memory the system, or the cgroup or job of the
+/// process, is, and frees caches, the cheapest to make again first, while
+/// it is short
+class AUDACITY_DLL_API MemoryPressure final : public wxEvtHandler {
+ public:
+   enum Level {
+      Normal,
+      Moderate, // caches shrink
+      Critical, // caches empty, and writes in the background stop
+   };
+
+   static MemoryPressure &Get();
+
+   /// Start watching; from the main thread, after InitPreferences()
+   void Start();
+   void Stop();
+
+   /// Any thread may ask
+   Level GetLevel() const { return mLevel.load(std::memory_order_relaxed); }
+
+ private:
+   MemoryPressure();
+   ~MemoryPressure();
+
+   void OnTimer(wxTimerEvent &evt);
+   Level Measure();
+   void Shed(Level level);
+   void Restore();
+
+   wxTimer mTimer;
+   std::atomic<Level> mLevel { Normal };
+   // Set by notifications of the system, between polls
+   std::atomic<int> mNotified { Normal };
+   int mQuietPolls { 0 };
+   int mRepeatPolls { 0 };
+
+   struct Platform;
+   std::unique_ptr<Platform> mPlatform;
+};
+
+#endif
@@ -69,6 +69,7 @@ simplifies construction of menu items.
 #include "Internat.h"
 #include "FileFormats.h"
 #include "Prefs.h"
+#include "Profiler.h"
 #include "Mix.h"
 #include "AboutDialog.h"
 #include "ondemand/ODManager.h"
@@ -92,6 +93,7 @@ simplifies construction of menu items.
 #include "widgets/HelpSystem.h"
 #include "DeviceManager.h"
 
+#include "TrackEditBatch.h"
 #include "UndoManager.h"
 #include "WaveTrack.h"
 
@@ -127,6 +129,7 @@ static CommandHandlerObject &ident(AudacityProject &project) { return project; }
 
 void AudacityProject::CreateMenusAndCommands()
 {
+   PROFILE_SCOPE("AudacityProject::CreateMenusAndCommands");
    CommandManager *c = &mCommandManager;
    wxArrayString names;
    std::vector<int> indices;
@@ -465,6 +468,10 @@ void AudacityProject::CreateMenusAndCommands()
          FN(OnRecord2ndChoice),
          wxT("Shift+R")
       );
+      c->AddItem(wxT("PunchAndRoll"), XXO("Punch and Rol&l Record"),
+         FN(OnPunchAndRoll), wxT("Shift+D"),
+         AudioIONotBusyFlag | WaveTracksSelectedFlag,
+         AudioIONotBusyFlag | WaveTracksSelectedFlag);
 
       // JKC: I decided to duplicate this between play and record, rather than put it
       // at the top level.  AddItem can now cope with simple duplicated items.
@@ -961,6 +968,46 @@ CommandFlag AudacityProject::GetFocusedFrame()
    return AlwaysEnabledFlag;
 }
 
+CommandFlag AudacityProject::GetTrackFlags(bool audioBusy)
+{
+   // Walking hundreds of tracks on every idle event adds up, so the result
+   // is kept until the list says that the tracks changed.  Recording adds
+   // to them without saying so, hence no caching while audio runs.
+   auto tracks = GetTracks();
+   if (mTrackFlagsValid && !audioBusy &&
+       mTrackFlagsGeneration == tracks->GetGeneration())
+      return mTrackFlags;
+
+   auto flags = AlwaysEnabledFlag;
+   TrackListIterator iter(tracks);
+   Track *t = iter.First();
+   while (t) {
+      flags |= TracksExistFlag;
+      if (t->GetKind() == Track::Wave) {
+         flags |= WaveTracksExistFlag;
+         flags |= PlayableTracksExistFlag;
+         if (t->GetSelected()) {
+            flags |= TracksSelectedFlag;
+            if (t->GetLinked()) {
+               flags |= StereoRequiredFlag;
+            }
+            else {
+               flags |= WaveTracksSelectedFlag;
+               flags |= AudioTracksSelectedFlag;
+            }
+         }
+         if( t->GetEndTime() > t->GetStartTime() )
+            flags |= HasWaveDataFlag;
+      }
+      t = iter.Next();
+   }
+
+   mTrackFlags = flags;
+   mTrackFlagsGeneration = tracks->GetGeneration();
+   mTrackFlagsValid = !audioBusy;
+   return flags;
+}
+
 CommandFlag AudacityProject::GetUpdateFlags(bool checkActive)
 {
    // This method determines all of the flags that determine whether
@@ -999,28 +1046,7 @@ CommandFlag AudacityProject::GetUpdateFlags(bool checkActive)
    if (!mViewInfo.selectedRegion.isPoint())
       flags |= TimeSelectedFlag;
 
-   TrackListIterator iter(GetTracks());
-   Track *t = iter.First();
-   while (t) {
-      flags |= TracksExistFlag;
-      if (t->GetKind() == Track::Wave) {
-         flags |= WaveTracksExistFlag;
-         flags |= PlayableTracksExistFlag;
-         if (t->GetSelected()) {
-            flags |= TracksSelectedFlag;
-            if (t->GetLinked()) {
-               flags |= StereoRequiredFlag;
-            }
-            else {
-               flags |= WaveTracksSelectedFlag;
-               flags |= AudioTracksSelectedFlag;
-            }
-         }
-         if( t->GetEndTime() > t->GetStartTime() )
-            flags |= HasWaveDataFlag;
-      }
-      t = iter.Next();
-   }
+   flags |= GetTrackFlags((flags & AudioIOBusyFlag) != 0);
 
    if((msClipT1 - msClipT0) > 0.0)
       flags |= ClipboardFlag;
@@ -1455,6 +1481,11 @@ void AudacityProject::OnRecord2ndChoice(const CommandContext &WXUNUSED(context)
    GetControlToolBar()->OnRecord(evt);
 }
 
+void AudacityProject::OnPunchAndRoll(const CommandContext &WXUNUSED(context) )
+{
+   GetControlToolBar()->OnPunch();
+}
+
 // The code for "OnPlayStopSelect" is simply the code of "OnPlayStop" and "OnStopSelect" merged.
 void AudacityProject::OnPlayStopSelect(const CommandContext &WXUNUSED(context) )
 {
@@ -2298,87 +2329,137 @@ void AudacityProject::OnInputChannels(const CommandContext &WXUNUSED(context) )
    }
 }
 
+namespace {
+
+// Fills oneDist with scores of the samples of one track in a window
+// centred on time t0, lowest at the zero crossings to prefer
+void ZeroCrossingScores(const WaveTrack &one, double t0,
+                        float *oneDist, size_t oneWindowSize)
+{
+   auto s = one.TimeToLongSamples(t0);
+   // fillTwo to ensure that missing values are treated as 2, and hence do not
+   // get used as zero crossings.
+   one.Get((samplePtr)oneDist, floatSample,
+            s - (int)oneWindowSize/2, oneWindowSize, fillTwo);
+
+   // Start by penalizing downward motion.  We prefer upward
+   // zero crossings.
+   if (oneDist[1] - oneDist[0] < 0)
+      oneDist[0] = oneDist[0]*6 + (oneDist[0] > 0 ? 0.3 : -0.3);
+   for(size_t i=1; i<oneWindowSize; i++)
+      if (oneDist[i] - oneDist[i-1] < 0)
+         oneDist[i] = oneDist[i]*6 + (oneDist[i] > 0 ? 0.3 : -0.3);
+
+   // Taking the absolute value -- apply a tiny LPF so square waves work.
+   float newVal, oldVal = oneDist[0];
+   oneDist[0] = fabs(.75 * oneDist[0] + .25 * oneDist[1]);
+   for(size_t i=1; i + 1 < oneWindowSize; i++)
+   {
+      newVal = fabs(.25 * oldVal + .5 * oneDist[i] + .25 * oneDist[i+1]);
+      oldVal = oneDist[i];
+      oneDist[i] = newVal;
+   }
+   oneDist[oneWindowSize-1] = fabs(.25 * oldVal +
+         .75 * oneDist[oneWindowSize-1]);
+}
+
+}
+
 double AudacityProject::NearestZeroCrossing(double t0)
+{
+   NearestZeroCrossings(&t0, 1);
+   return t0;
+}
+
+void AudacityProject::NearestZeroCrossings(double *times, size_t nTimes)
 {
    // Window is 1/100th of a second.
    auto windowSize = size_t(std::max(1.0, GetRate() / 100));
-   Floats dist{ windowSize, true };
 
+   // The windows of all tracks at all times go in one buffer, each at an
+   // offset, and are scored on all cores.  Floats are read through the
+   // block cache, so a block read for one edge of the selection is not
+   // read again for the other.
+   struct Window {
+      const WaveTrack *track;
+      double t0;
+      size_t offset;
+      size_t size;
+   };
+   std::vector<Window> windows;
+   size_t scratchSize = 0;
    TrackListIterator iter(GetTracks());
-   Track *track = iter.First();
-   while (track) {
-      if (!track->GetSelected() || track->GetKind() != (Track::Wave)) {
-         track = iter.Next();
+   for (Track *track = iter.First(); track; track = iter.Next()) {
+      if (!track->GetSelected() || track->GetKind() != (Track::Wave))
          continue;
-      }
-      WaveTrack *one = (WaveTrack *)track;
+      const auto one = static_cast<const WaveTrack *>(track);
       auto oneWindowSize = size_t(std::max(1.0, one->GetRate() / 100));
-      Floats oneDist{ oneWindowSize };
-      auto s = one->TimeToLongSamples(t0);
-      // fillTwo to ensure that missing values are treated as 2, and hence do not
-      // get used as zero crossings.
-      one->Get((samplePtr)oneDist.get(), floatSample,
-               s - (int)oneWindowSize/2, oneWindowSize, fillTwo);
-
-      // Start by penalizing downward motion.  We prefer upward
-      // zero crossings.
-      if (oneDist[1] - oneDist[0] < 0)
-         oneDist[0] = oneDist[0]*6 + (oneDist[0] > 0 ? 0.3 : -0.3);
-      for(size_t i=1; i<oneWindowSize; i++)
-         if (oneDist[i] - oneDist[i-1] < 0)
-            oneDist[i] = oneDist[i]*6 + (oneDist[i] > 0 ? 0.3 : -0.3);
-
-      // Taking the absolute value -- apply a tiny LPF so square waves work.
-      float newVal, oldVal = oneDist[0];
-      oneDist[0] = fabs(.75 * oneDist[0] + .25 * oneDist[1]);
-      for(size_t i=1; i + 1 < oneWindowSize; i++)
-      {
-         newVal = fabs(.25 * oldVal + .5 * oneDist[i] + .25 * oneDist[i+1]);
-         oldVal = oneDist[i];
-         oneDist[i] = newVal;
+      for (size_t jj = 0; jj < nTimes; ++jj) {
+         windows.push_back({ one, times[jj], scratchSize, oneWindowSize });
+         scratchSize += oneWindowSize;
       }
-      oneDist[oneWindowSize-1] = fabs(.25 * oldVal +
-            .75 * oneDist[oneWindowSize-1]);
-
-      // TODO: The mixed rate zero crossing code is broken,
-      // if oneWindowSize > windowSize we'll miss out some
-      // samples - so they will still be zero, so we'll use them.
-      for(size_t i = 0; i < windowSize; i++) {
-         size_t j;
-         if (windowSize != oneWindowSize)
-            j = i * (oneWindowSize-1) / (windowSize-1);
-         else
-            j = i;
+   }
 
-         dist[i] += oneDist[j];
-         // Apply a small penalty for distance from the original endpoint
-         dist[i] += 0.1 * (abs(int(i) - int(windowSize/2))) / float(windowSize/2);
-      }
+   Floats scratch{ scratchSize };
+   TrackEditBatch batch;
+   for (const auto &window : windows)
+      batch.Add([&scratch, window] {
+         ZeroCrossingScores(*window.track, window.t0,
+            scratch.get() + window.offset, window.size);
+      });
+   batch.Run();
+
+   Floats dist{ windowSize };
+   for (size_t jj = 0; jj < nTimes; ++jj) {
+      std::fill(dist.get(), dist.get() + windowSize, 0.0f);
+
+      // Windows are in order of track, then time
+      for (size_t kk = jj; kk < windows.size(); kk += nTimes) {
+         const auto oneDist = scratch.get() + windows[kk].offset;
+         const auto oneWindowSize = windows[kk].size;
+
+         // TODO: The mixed rate zero crossing code is broken,
+         // if oneWindowSize > windowSize we'll miss out some
+         // samples - so they will still be zero, so we'll use them.
+         for(size_t i = 0; i < windowSize; i++) {
+            size_t j;
+            if (windowSize != oneWindowSize)
+               j = i * (oneWindowSize-1) / (windowSize-1);
+            else
+               j = i;
 
-      track = iter.Next();
-   }
+            dist[i] += oneDist[j];
+            // Apply a small penalty for distance from the original endpoint
+            dist[i] += 0.1 * (abs(int(i) - int(windowSize/2))) / float(windowSize/2);
+         }
+      }
 
-   // Find minimum
-   int argmin = 0;
-   float min = 3.0;
-   for(size_t i=0; i<windowSize; i++) {
-      if (dist[i] < min) {
-         argmin = i;
-         min = dist[i];
+      // Find minimum
+      int argmin = 0;
+      float min = 3.0;
+      for(size_t i=0; i<windowSize; i++) {
+         if (dist[i] < min) {
+            argmin = i;
+            min = dist[i];
+         }
       }
-   }
 
-   return t0 + (argmin - (int)windowSize/2)/GetRate();
+      times[jj] += (argmin - (int)windowSize/2)/GetRate();
+   }
 }
 
 void AudacityProject::OnZeroCrossing(const CommandContext &WXUNUSED(context) )
 {
-   const double t0 = NearestZeroCrossing(mViewInfo.selectedRegion.t0());
-   if (mViewInfo.selectedRegion.isPoint())
-      mViewInfo.selectedRegion.setTimes(t0, t0);
+   // Both edges in one pass over the tracks
+   double times[] = {
+      mViewInfo.selectedRegion.t0(), mViewInfo.selectedRegion.t1() };
+   if (mViewInfo.selectedRegion.isPoint()) {
+      NearestZeroCrossings(times, 1);
+      mViewInfo.selectedRegion.setTimes(times[0], times[0]);
+   }
    else {
-      const double t1 = NearestZeroCrossing(mViewInfo.selectedRegion.t1());
-      mViewInfo.selectedRegion.setTimes(t0, t1);
+      NearestZeroCrossings(times, 2);
+      mViewInfo.selectedRegion.setTimes(times[0], times[1]);
    }
 
    ModifyState();
@@ -2459,6 +2540,9 @@ void AudacityProject::OnPreferences(const CommandContext &WXUNUSED(context) )
    // LL:  Moved from PrefsDialog since wxWidgets on OSX can't deal with
    //      rebuilding the menus while the PrefsDialog is still in the modal
    //      state.
+   // The first project makes its commands again under the new preferences,
+   // and the others share them.
+   CommandManager::DiscardSharedCommands();
    for (size_t i = 0; i < gAudacityProjects.size(); i++) {
       AudacityProject *p = gAudacityProjects[i].get();
 
@@ -2494,6 +2578,9 @@ void AudacityProject::OnReloadPreferences(const CommandContext &WXUNUSED(context
    // LL:  Moved from PrefsDialog since wxWidgets on OSX can't deal with
    //      rebuilding the menus while the PrefsDialog is still in the modal
    //      state.
+   // The first project makes its commands again under the new preferences,
+   // and the others share them.
+   CommandManager::DiscardSharedCommands();
    for (size_t i = 0; i < gAudacityProjects.size(); i++) {
       AudacityProject *p = gAudacityProjects[i].get();
 
@@ -2618,31 +2705,37 @@ void AudacityProject::OnCut(const CommandContext &WXUNUSED(context) )
    // Proceed to change the project.  If this throws, the project will be
    // rolled back by the top level handler.
 
+   const double t0 = mViewInfo.selectedRegion.t0();
+   const double t1 = mViewInfo.selectedRegion.t1();
+   const bool cutLines = gPrefs->Read(wxT("/GUI/EnableCutLines"), (long)0);
+   TrackEditBatch batch;
+
    n = iter.First();
    while (n) {
       // We clear from selected tracks.
       if (n->GetSelected()) {
          switch (n->GetKind())
          {
-            case Track::Wave:
-               if (gPrefs->Read(wxT("/GUI/EnableCutLines"), (long)0)) {
-                  ((WaveTrack*)n)->ClearAndAddCutLine(
-                     mViewInfo.selectedRegion.t0(),
-                     mViewInfo.selectedRegion.t1());
-                  break;
-               }
-
-               // Fall through
+            case Track::Wave: {
+               // Wave tracks are cleared together, below
+               const auto wt = static_cast<WaveTrack*>(n);
+               if (cutLines)
+                  batch.Add([=]{ wt->ClearAndAddCutLine(t0, t1); });
+               else
+                  batch.Add([=]{ wt->Clear(t0, t1); });
+               break;
+            }
 
             default:
-               n->Clear(mViewInfo.selectedRegion.t0(),
-                        mViewInfo.selectedRegion.t1());
+               n->Clear(t0, t1);
             break;
          }
       }
       n = iter.Next();
    }
 
+   batch.Run();
+
    msClipT0 = mViewInfo.selectedRegion.t0();
    msClipT1 = mViewInfo.selectedRegion.t1();
    msClipProject = this;
@@ -2726,6 +2819,23 @@ void AudacityProject::OnPaste(const CommandContext &WXUNUSED(context) )
    bool bAdvanceClipboard = true;
    bool bPastedSomething = false;
 
+   // Wave tracks are pasted into together, when the loops below are done
+   TrackEditBatch batch;
+   const auto pasteWave = [&](WaveTrack *dest, const Track *src) {
+      bPastedSomething = true;
+      batch.Add([=]{ dest->ClearAndPaste(t0, t1, src, true); });
+   };
+
+   // Cause duplication of block files on disk, when copy is
+   // between projects.  Lock each clipboard track once, for as long as
+   // any paste from it may run.
+   std::vector<WaveTrack::Locker> lockers;
+   if (msClipProject != this) {
+      TrackListOfKindIterator clipWaveIter(Track::Wave, msClipboard.get());
+      for (auto wt = clipWaveIter.First(); wt; wt = clipWaveIter.Next())
+         lockers.emplace_back(static_cast<const WaveTrack*>(wt));
+   }
+
    while (n && c) {
       if (n->GetSelected()) {
          bAdvanceClipboard = true;
@@ -2781,18 +2891,9 @@ void AudacityProject::OnPaste(const CommandContext &WXUNUSED(context) )
          if (!ff)
             ff = n;
 
-         Maybe<WaveTrack::Locker> locker;
-         if (msClipProject != this && c->GetKind() == Track::Wave)
-            // Cause duplication of block files on disk, when copy is
-            // between projects
-            locker.create(static_cast<const WaveTrack*>(c));
-
          wxASSERT( n && c );
          if (c->GetKind() == Track::Wave && n->GetKind() == Track::Wave)
-         {
-            bPastedSomething = true;
-            ((WaveTrack*)n)->ClearAndPaste(t0, t1, (WaveTrack*)c, true);
-         }
+            pasteWave(static_cast<WaveTrack*>(n), c);
          else
          {
             bPastedSomething = true;
@@ -2806,10 +2907,8 @@ void AudacityProject::OnPaste(const CommandContext &WXUNUSED(context) )
          {
             n = iter.Next();
 
-            if (n->GetKind() == Track::Wave) {
-               bPastedSomething = true;
-               ((WaveTrack *)n)->ClearAndPaste(t0, t1, c, true);
-            }
+            if (n->GetKind() == Track::Wave)
+               pasteWave(static_cast<WaveTrack*>(n), c);
             else
             {
                n->Clear(t0, t1);
@@ -2830,6 +2929,8 @@ void AudacityProject::OnPaste(const CommandContext &WXUNUSED(context) )
    // than the amount of selected destination tracks. We take the
    // last wave track, and paste that one into the remaining
    // selected tracks.
+   // The silent tracks must outlive the batch
+   std::vector<WaveTrack::Holder> silences;
    if ( n && !c )
    {
       TrackListOfKindIterator clipWaveIter(Track::Wave, msClipboard.get());
@@ -2839,22 +2940,23 @@ void AudacityProject::OnPaste(const CommandContext &WXUNUSED(context) )
          if (n->GetSelected() && n->GetKind()==Track::Wave) {
             if (c) {
                wxASSERT(c->GetKind() == Track::Wave);
-               bPastedSomething = true;
-               ((WaveTrack *)n)->ClearAndPaste(t0, t1, (WaveTrack *)c, true);
+               pasteWave(static_cast<WaveTrack*>(n), c);
             }
             else {
                auto tmp = mTrackFactory->NewWaveTrack( ((WaveTrack*)n)->GetSampleFormat(), ((WaveTrack*)n)->GetRate());
                tmp->InsertSilence(0.0, msClipT1 - msClipT0); // MJS: Is this correct?
                tmp->Flush();
 
-               bPastedSomething = true;
-               ((WaveTrack *)n)->ClearAndPaste(t0, t1, tmp.get(), true);
+               pasteWave(static_cast<WaveTrack*>(n), tmp.get());
+               silences.push_back(std::move(tmp));
             }
          }
          n = iter.Next();
       }
    }
 
+   batch.Run();
+
    // TODO: What if we clicked past the end of the track?
 
    if (bPastedSomething)
@@ -3722,10 +3824,13 @@ void AudacityProject::OnImport(const CommandContext &WXUNUSED(context) )
       wxString fileName = selectedFiles[ff];
 
       FileNames::UpdateDefaultPath(FileNames::Operation::Open, fileName);
-
-      Import(fileName);
    }
 
+   if (selectedFiles.GetCount() > 1)
+      ImportBatch(selectedFiles);
+   else
+      Import(selectedFiles[0]);
+
    ZoomAfterImport(nullptr);
 }
 
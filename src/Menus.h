@@ -28,6 +28,9 @@ void CreateRecentFilesMenu(CommandManager *c);
 void ModifyUndoMenuItems();
 
 CommandFlag GetFocusedFrame();
+// The flags worked out from the tracks, cached until the track list
+// changes
+CommandFlag GetTrackFlags(bool audioBusy);
 
 public:
 // If checkActive, do not do complete flags testing on an
@@ -36,6 +39,9 @@ CommandFlag GetUpdateFlags(bool checkActive = false);
 
 private:
 double NearestZeroCrossing(double t0);
+// Moves each of the times to its nearest zero crossing, reading each
+// selected wave track once for all of them
+void NearestZeroCrossings(double *times, size_t nTimes);
 
 public:
         // Audio I/O Commands
@@ -44,6 +50,7 @@ void OnStop(const CommandContext &context );
 void OnPause(const CommandContext &context );
 void OnRecord(const CommandContext &context );
 void OnRecord2ndChoice(const CommandContext &context );
+void OnPunchAndRoll(const CommandContext &context );
 void OnStopSelect(const CommandContext &context );
 void OnSkipStart(const CommandContext &context );
 void OnSkipEnd(const CommandContext &context );
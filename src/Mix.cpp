@@ -18,12 +18,19 @@
 \class MixerSpec
 \brief Class used with Mixer.
 
+Routes each track to the channels of the output, with a gain for each
+route, so that a surround mix folds down to stereo, or a stereo one
+spreads to more channels, in the one pass of the Mixer.  The gains go
+into those the kernels already apply for the pan of the track, so a
+weighted route costs no more than a plain one.
+
 *//*******************************************************************/
 
 
 #include "Audacity.h"
 #include "Mix.h"
 
+#include <algorithm>
 #include <math.h>
 
 #include <wx/textctrl.h>
@@ -31,12 +38,15 @@
 #include <wx/timer.h>
 #include <wx/intl.h>
 
+#include "CrossFade.h"
 #include "WaveTrack.h"
 #include "DirManager.h"
 #include "Internat.h"
 #include "Prefs.h"
+#include "Profiler.h"
 #include "Project.h"
 #include "Resample.h"
+#include "SampleConvert.h"
 #include "float_cast.h"
 
 Mixer::Mixer(const WaveTrackConstArray &inputTracks,
@@ -44,7 +54,8 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
              double startTime, double stopTime,
              unsigned numOutChannels, size_t outBufferSize, bool outInterleaved,
              double outRate, sampleFormat outFormat,
-             bool highQuality, MixerSpec *mixerSpec)
+             bool highQuality, MixerSpec *mixerSpec, bool applyTrackGains,
+             double minSpeed, double maxSpeed)
    : mNumInputTracks { inputTracks.size() }
 
    // This is the number of samples grabbed in one go from a track
@@ -55,17 +66,40 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
 
    , mNumChannels{ numOutChannels }
 
+   , mMinSpeed{ std::min(minSpeed, maxSpeed) }
+   , mMaxSpeed{ std::max(minSpeed, maxSpeed) }
+
+   , mApplyTrackGains{ applyTrackGains }
+   , mGains{ mNumChannels }
+   , mChannelFlags{ mNumChannels }
+
    , mMayThrow{ mayThrow }
 {
+   wxASSERT(mMinSpeed > 0.0);
+
    mHighQuality = highQuality;
    mInputTrack.reinit(mNumInputTracks);
 
    // mSamplePos holds for each track the next sample position not
    // yet processed.
    mSamplePos.reinit(mNumInputTracks);
+
+   // Crossfade the clips at boundaries, in playback and export alike,
+   // instead of rendering fades into them
+   bool crossfade = true;
+   double crossfadeMs = 10.0;
+   gPrefs->Read(wxT("/AudioIO/CrossfadeClips"), &crossfade, true);
+   gPrefs->Read(wxT("/AudioIO/CrossfadeClipsMs"), &crossfadeMs, 10.0);
+   mCrossFaders.reinit(mNumInputTracks);
+
    for(size_t i=0; i<mNumInputTracks; i++) {
       mInputTrack[i].SetTrack(inputTracks[i]);
+      mInputTrack[i].SetReadAhead(true);
       mSamplePos[i] = inputTracks[i]->TimeToLongSamples(startTime);
+      mCrossFaders[i].SetTrack(inputTracks[i].get(), crossfade
+         ? (size_t)std::max(0.0,
+            inputTracks[i]->GetRate() * crossfadeMs / 1000.0)
+         : 0);
    }
    mT0 = startTime;
    mT1 = stopTime;
@@ -73,8 +107,15 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
    mBufferSize = outBufferSize;
    mInterleaved = outInterleaved;
    mRate = outRate;
-   mSpeed = 1.0;
+   mSpeed = mTargetSpeed = ClampSpeed(1.0);
    mFormat = outFormat;
+
+   // int16 tracks mix exactly as integers into int16 output, where
+   // nothing scales them
+   mIntMix = false;
+   if (mFormat == int16Sample)
+      gPrefs->Read(wxT("/Quality/Int16FastMix"), &mIntMix, true);
+
    if( mixerSpec && mixerSpec->GetNumChannels() == mNumChannels &&
          mixerSpec->GetNumTracks() == mNumInputTracks )
       mMixerSpec = mixerSpec;
@@ -97,6 +138,8 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
       mTemp[c].Allocate(mInterleavedBufferSize, floatSample);
    }
    mFloatBuffer = Floats{ mInterleavedBufferSize };
+   if (mIntMix)
+      mIntTemp = ArraysOf<int>{ mNumBuffers, mInterleavedBufferSize };
 
    // But cut the queue into blocks of this finer size
    // for variable rate resampling.  Each block is resampled at some
@@ -109,15 +152,7 @@ Mixer::Mixer(const WaveTrackConstArray &inputTracks,
    // For each queue, the number of available samples after the queue start.
    mQueueLen.reinit(mNumInputTracks);
    mResample.reinit(mNumInputTracks);
-   for(size_t i=0; i<mNumInputTracks; i++) {
-      double factor = (mRate / mInputTrack[i].GetTrack()->GetRate());
-      double minFactor, maxFactor;
-      minFactor = maxFactor = factor;
-
-      mResample[i] = std::make_unique<Resample>(mHighQuality, minFactor, maxFactor);
-      mQueueStart[i] = 0;
-      mQueueLen[i] = 0;
-   }
+   MakeResamplers();
 
    const auto envLen = std::max(mQueueMaxLen, mInterleavedBufferSize);
    mEnvValues.reinit(envLen);
@@ -127,43 +162,468 @@ Mixer::~Mixer()
 {
 }
 
+void Mixer::MakeResamplers()
+{
+   // Fresh resamplers hold no history from before a jump.
+   // highQuality chooses the best method, for export, else the fast one,
+   // for playback; see Resample::GetBestMethodKey() and GetFastMethodKey()
+   for(size_t i=0; i<mNumInputTracks; i++) {
+      mQueueStart[i] = 0;
+      mQueueLen[i] = 0;
+
+      // Faster play takes more samples of the track for each one out
+      double factor = (mRate / mInputTrack[i].GetTrack()->GetRate());
+      double minFactor, maxFactor;
+      if (mMinSpeed != mMaxSpeed) {
+         // soxr in variable-rate mode, so that SetSpeed() can change the
+         // factor of each block
+         minFactor = factor / mMaxSpeed;
+         maxFactor = factor / mMinSpeed;
+      }
+      else if ((factor /= mSpeed) == 1.0) {
+         // MixSameRate() needs none
+         mResample[i].reset();
+         continue;
+      }
+      else
+         minFactor = maxFactor = factor;
+
+      mResample[i] = std::make_unique<Resample>(mHighQuality, minFactor, maxFactor);
+   }
+}
+
 void Mixer::Clear()
 {
    for (unsigned int c = 0; c < mNumBuffers; c++) {
       memset(mTemp[c].ptr(), 0, mInterleavedBufferSize * SAMPLE_SIZE(floatSample));
    }
+   mIntUsed = mFloatUsed = false;
+}
+
+bool Mixer::CanMixInts(const WaveTrack *track, const int *channelFlags,
+                       const CrossFader &fader, sampleCount pos,
+                       size_t len) const
+{
+   if (!mIntMix || track->GetSampleFormat() != int16Sample ||
+       fader.Overlaps(pos, len))
+      return false;
+   for (size_t c = 0; c < mNumChannels; c++)
+      if (channelFlags[c] && mGains[c] != 1.0f)
+         return false;
+   const auto env = mEnvValues.get();
+   return std::all_of(env, env + len, [](double value){ return value == 1.0; });
 }
 
-void MixBuffers(unsigned numChannels, int *channelFlags, 
-                samplePtr src, SampleBuffer *dests,
-                int len, bool interleaved)
+// Vector kernels for accumulating a track into the mix.  As for the
+// summaries in BlockFile.cpp, SSE2 and NEON are baseline on x86-64 and 64
+// bit ARM, so the choice is made at compile time; elsewhere the scalar
+// loops remain, still with the channel count fixed for the common layouts.
+//
+// Each kernel makes one pass, multiplying every sample by the envelope and
+// the gain of its channel as it adds it, so there is no temporary buffer.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MIX_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MIX_SIMD_NEON
+#endif
+
+namespace {
+
+#if defined(MIX_SIMD_SSE2)
+using Vec = __m128;
+inline Vec Load(const float *p) { return _mm_loadu_ps(p); }
+// Four envelope values, narrowed to float
+inline Vec Load(const double *p)
 {
-   for (unsigned int c = 0; c < numChannels; c++) {
+   return _mm_movelh_ps(
+      _mm_cvtpd_ps(_mm_loadu_pd(p)), _mm_cvtpd_ps(_mm_loadu_pd(p + 2)));
+}
+inline void Store(float *p, Vec v) { _mm_storeu_ps(p, v); }
+inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+inline Vec Splat(float f) { return _mm_set1_ps(f); }
+inline Vec Make(float a, float b, float c, float d)
+   { return _mm_setr_ps(a, b, c, d); }
+// (a, a, b, b) and (c, c, d, d) from (a, b, c, d)
+inline Vec DupLow(Vec v) { return _mm_unpacklo_ps(v, v); }
+inline Vec DupHigh(Vec v) { return _mm_unpackhi_ps(v, v); }
+// All bits set in the lanes of enabled channels, so that And() passes
+// their samples and makes exact zeroes of the others
+inline Vec Mask(bool a, bool b, bool c, bool d)
+   { return _mm_castsi128_ps(_mm_setr_epi32(-a, -b, -c, -d)); }
+inline Vec And(Vec v, Vec mask) { return _mm_and_ps(v, mask); }
+#define MIX_SIMD
+#elif defined(MIX_SIMD_NEON)
+using Vec = float32x4_t;
+inline Vec Load(const float *p) { return vld1q_f32(p); }
+inline Vec Make(float a, float b, float c, float d)
+   { const float f[4] = { a, b, c, d }; return vld1q_f32(f); }
+// 32 bit NEON has no double lanes
+inline Vec Load(const double *p)
+   { return Make(float(p[0]), float(p[1]), float(p[2]), float(p[3])); }
+inline void Store(float *p, Vec v) { vst1q_f32(p, v); }
+inline Vec Add(Vec a, Vec b) { return vaddq_f32(a, b); }
+inline Vec Mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+inline Vec Splat(float f) { return vdupq_n_f32(f); }
+inline Vec DupLow(Vec v) { return vzipq_f32(v, v).val[0]; }
+inline Vec DupHigh(Vec v) { return vzipq_f32(v, v).val[1]; }
+inline Vec Mask(bool a, bool b, bool c, bool d)
+{
+   const uint32_t m[4] = { a ? ~0u : 0u, b ? ~0u : 0u,
+                           c ? ~0u : 0u, d ? ~0u : 0u };
+   return vreinterpretq_f32_u32(vld1q_u32(m));
+}
+inline Vec And(Vec v, Vec mask)
+{
+   return vreinterpretq_f32_u32(
+      vandq_u32(vreinterpretq_u32_f32(v), vreinterpretq_u32_f32(mask)));
+}
+#define MIX_SIMD
+#endif
+
+// Stands for an envelope of ones, where the caller has none to apply;
+// the compiler multiplies it away
+struct Unity {
+   float operator[] (size_t) const { return 1.0f; }
+   Unity operator+ (size_t) const { return {}; }
+};
+#ifdef MIX_SIMD
+inline Vec Load(Unity) { return Splat(1.0f); }
+#endif
+
+// Channel counts fixed at compile time, to choose among the kernels
+template<unsigned N> struct Channels {};
+
+// dest[j] += src[j] * env[j] * gain
+template<typename Env>
+void AddTo(float *dest, const float *src, Env env, float gain, size_t len)
+{
+   size_t j = 0;
+#ifdef MIX_SIMD
+   const Vec g = Splat(gain);
+   for (; j + 4 <= len; j += 4)
+      Store(dest + j, Add(Load(dest + j),
+         Mul(Mul(Load(src + j), Load(env + j)), g)));
+#endif
+   for (; j < len; ++j)
+      dest[j] += src[j] * float(env[j]) * gain;
+}
+
+// Any channel count: the stride is a variable
+template<typename Env>
+void MixInterleaved(unsigned numChannels, const int *channelFlags,
+                    const float *gains, const float *src, Env env,
+                    float *dest, size_t len)
+{
+   for (unsigned c = 0; c < numChannels; c++) {
       if (!channelFlags[c])
          continue;
+      const float gain = gains[c];
+      float *d = dest + c;
+      for (size_t j = 0; j < len; j++) {
+         *d += src[j] * float(env[j]) * gain;
+         d += numChannels;
+      }
+   }
+}
+
+// A fixed channel count, so the compiler unrolls the channels
+template<unsigned N, typename Env>
+void MixInterleaved(Channels<N>, const int *channelFlags,
+                    const float *gains, const float *src, Env env,
+                    float *dest, size_t len)
+{
+   bool on[N];
+   for (unsigned c = 0; c < N; ++c)
+      on[c] = channelFlags[c] != 0;
+   for (size_t j = 0; j < len; ++j, dest += N) {
+      const float sample = src[j] * float(env[j]);
+      for (unsigned c = 0; c < N; ++c)
+         if (on[c])
+            dest[c] += sample * gains[c];
+   }
+}
 
-      samplePtr destPtr;
-      unsigned skip;
+#ifdef MIX_SIMD
 
-      if (interleaved) {
-         destPtr = dests[0].ptr() + c*SAMPLE_SIZE(floatSample);
-         skip = numChannels;
-      } else {
-         destPtr = dests[c].ptr();
-         skip = 1;
-      }
+// Stereo: two frames in each vector
+template<typename Env>
+void MixInterleaved(Channels<2>, const int *channelFlags,
+                    const float *gains, const float *src, Env env,
+                    float *dest, size_t len)
+{
+   const bool l = channelFlags[0] != 0, r = channelFlags[1] != 0;
+   const Vec mask = Mask(l, r, l, r);
+   const Vec g = Make(gains[0], gains[1], gains[0], gains[1]);
+   size_t j = 0;
+   for (; j + 4 <= len; j += 4, dest += 8) {
+      const Vec v = Mul(Load(src + j), Load(env + j));
+      Store(dest, Add(Load(dest), And(Mul(DupLow(v), g), mask)));
+      Store(dest + 4, Add(Load(dest + 4), And(Mul(DupHigh(v), g), mask)));
+   }
+   MixInterleaved(2, channelFlags, gains, src + j, env + j, dest, len - j);
+}
+
+// 5.1: two frames in three vectors
+template<typename Env>
+void MixInterleaved(Channels<6>, const int *channelFlags,
+                    const float *gains, const float *src, Env env,
+                    float *dest, size_t len)
+{
+   bool on[6];
+   for (unsigned c = 0; c < 6; ++c)
+      on[c] = channelFlags[c] != 0;
+   const Vec mask0 = Mask(on[0], on[1], on[2], on[3]);
+   const Vec mask1 = Mask(on[4], on[5], on[0], on[1]);
+   const Vec mask2 = Mask(on[2], on[3], on[4], on[5]);
+   const Vec g0 = Make(gains[0], gains[1], gains[2], gains[3]);
+   const Vec g1 = Make(gains[4], gains[5], gains[0], gains[1]);
+   const Vec g2 = Make(gains[2], gains[3], gains[4], gains[5]);
+   size_t j = 0;
+   for (; j + 2 <= len; j += 2, dest += 12) {
+      const float s0 = src[j] * float(env[j]);
+      const float s1 = src[j + 1] * float(env[j + 1]);
+      Store(dest, Add(Load(dest), And(Mul(Splat(s0), g0), mask0)));
+      Store(dest + 4, Add(Load(dest + 4),
+         And(Mul(Make(s0, s0, s1, s1), g1), mask1)));
+      Store(dest + 8, Add(Load(dest + 8), And(Mul(Splat(s1), g2), mask2)));
+   }
+   MixInterleaved(6, channelFlags, gains, src + j, env + j, dest, len - j);
+}
+
+// 7.1: one frame in two vectors
+template<typename Env>
+void MixInterleaved(Channels<8>, const int *channelFlags,
+                    const float *gains, const float *src, Env env,
+                    float *dest, size_t len)
+{
+   bool on[8];
+   for (unsigned c = 0; c < 8; ++c)
+      on[c] = channelFlags[c] != 0;
+   const Vec mask0 = Mask(on[0], on[1], on[2], on[3]);
+   const Vec mask1 = Mask(on[4], on[5], on[6], on[7]);
+   const Vec g0 = Make(gains[0], gains[1], gains[2], gains[3]);
+   const Vec g1 = Make(gains[4], gains[5], gains[6], gains[7]);
+   for (size_t j = 0; j < len; ++j, dest += 8) {
+      const Vec v = Splat(src[j] * float(env[j]));
+      Store(dest, Add(Load(dest), And(Mul(v, g0), mask0)));
+      Store(dest + 4, Add(Load(dest + 4), And(Mul(v, g1), mask1)));
+   }
+}
+
+#endif
+
+template<typename Env>
+void MixBuffers(unsigned numChannels, const int *channelFlags,
+                const float *gains, const float *src, Env env,
+                SampleBuffer *dests, size_t len, bool interleaved)
+{
+   if (!interleaved) {
+      for (unsigned int c = 0; c < numChannels; c++)
+         if (channelFlags[c])
+            AddTo((float *)dests[c].ptr(), src, env, gains[c], len);
+      return;
+   }
+
+   const auto dest = (float *)dests[0].ptr();
+   switch (numChannels) {
+   case 1:
+      if (channelFlags[0])
+         AddTo(dest, src, env, gains[0], len);
+      break;
+   case 2:
+      MixInterleaved(Channels<2>{}, channelFlags, gains, src, env, dest, len);
+      break;
+   case 6:
+      MixInterleaved(Channels<6>{}, channelFlags, gains, src, env, dest, len);
+      break;
+   case 8:
+      MixInterleaved(Channels<8>{}, channelFlags, gains, src, env, dest, len);
+      break;
+   default:
+      MixInterleaved(numChannels, channelFlags, gains, src, env, dest, len);
+      break;
+   }
+}
 
-      float *dest = (float *)destPtr;
-      float *temp = (float *)src;
-      for (int j = 0; j < len; j++) {
-         *dest += temp[j];  
-         dest += skip;
+// Integer kernels, for int16 tracks mixed into int16 output with no gain.
+// The sums are kept in 32 bits and saturate to 16 only at the end, so they
+// equal the float mix without dither, sample for sample, at half the
+// memory traffic and with no conversions.
+#if defined(MIX_SIMD_SSE2)
+using IVec = __m128i;    // four ints
+using SVec = __m128i;    // eight shorts
+inline IVec Load(const int *p) { return _mm_loadu_si128((const __m128i *)p); }
+inline SVec Load(const short *p)
+   { return _mm_loadu_si128((const __m128i *)p); }
+inline void Store(int *p, IVec v) { _mm_storeu_si128((__m128i *)p, v); }
+inline IVec IAdd(IVec a, IVec b) { return _mm_add_epi32(a, b); }
+// The first and last four shorts, sign extended
+inline IVec WidenLow(SVec v)
+   { return _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16); }
+inline IVec WidenHigh(SVec v)
+   { return _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16); }
+inline IVec IDupLow(IVec v) { return _mm_unpacklo_epi32(v, v); }
+inline IVec IDupHigh(IVec v) { return _mm_unpackhi_epi32(v, v); }
+inline IVec IMask(bool a, bool b, bool c, bool d)
+   { return _mm_setr_epi32(-a, -b, -c, -d); }
+inline IVec IAnd(IVec v, IVec mask) { return _mm_and_si128(v, mask); }
+// Eight ints, saturated to shorts
+inline void StoreSaturated(short *p, IVec a, IVec b)
+   { _mm_storeu_si128((__m128i *)p, _mm_packs_epi32(a, b)); }
+inline Vec ToFloat(IVec v) { return _mm_cvtepi32_ps(v); }
+#elif defined(MIX_SIMD_NEON)
+using IVec = int32x4_t;
+using SVec = int16x8_t;
+inline IVec Load(const int *p) { return vld1q_s32(p); }
+inline SVec Load(const short *p) { return vld1q_s16(p); }
+inline void Store(int *p, IVec v) { vst1q_s32(p, v); }
+inline IVec IAdd(IVec a, IVec b) { return vaddq_s32(a, b); }
+inline IVec WidenLow(SVec v) { return vmovl_s16(vget_low_s16(v)); }
+inline IVec WidenHigh(SVec v) { return vmovl_s16(vget_high_s16(v)); }
+inline IVec IDupLow(IVec v) { return vzipq_s32(v, v).val[0]; }
+inline IVec IDupHigh(IVec v) { return vzipq_s32(v, v).val[1]; }
+inline IVec IMask(bool a, bool b, bool c, bool d)
+   { const int m[4] = { -a, -b, -c, -d }; return vld1q_s32(m); }
+inline IVec IAnd(IVec v, IVec mask) { return vandq_s32(v, mask); }
+inline void StoreSaturated(short *p, IVec a, IVec b)
+   { vst1q_s16(p, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b))); }
+inline Vec ToFloat(IVec v) { return vcvtq_f32_s32(v); }
+#endif
+
+// dest[j] += src[j]
+void AddTo(int *dest, const short *src, size_t len)
+{
+   size_t j = 0;
+#ifdef MIX_SIMD
+   for (; j + 8 <= len; j += 8) {
+      const SVec v = Load(src + j);
+      Store(dest + j, IAdd(Load(dest + j), WidenLow(v)));
+      Store(dest + j + 4, IAdd(Load(dest + j + 4), WidenHigh(v)));
+   }
+#endif
+   for (; j < len; ++j)
+      dest[j] += src[j];
+}
+
+void MixInterleaved(unsigned numChannels, const int *channelFlags,
+                    const short *src, int *dest, size_t len)
+{
+   for (unsigned c = 0; c < numChannels; c++) {
+      if (!channelFlags[c])
+         continue;
+      int *d = dest + c;
+      for (size_t j = 0; j < len; j++) {
+         *d += src[j];
+         d += numChannels;
       }
    }
 }
 
+#ifdef MIX_SIMD
+// Stereo: eight frames in four vectors
+void MixInterleaved(Channels<2>, const int *channelFlags,
+                    const short *src, int *dest, size_t len)
+{
+   const bool l = channelFlags[0] != 0, r = channelFlags[1] != 0;
+   const IVec mask = IMask(l, r, l, r);
+   size_t j = 0;
+   for (; j + 8 <= len; j += 8, dest += 16) {
+      const SVec v = Load(src + j);
+      const IVec low = WidenLow(v), high = WidenHigh(v);
+      Store(dest, IAdd(Load(dest), IAnd(IDupLow(low), mask)));
+      Store(dest + 4, IAdd(Load(dest + 4), IAnd(IDupHigh(low), mask)));
+      Store(dest + 8, IAdd(Load(dest + 8), IAnd(IDupLow(high), mask)));
+      Store(dest + 12, IAdd(Load(dest + 12), IAnd(IDupHigh(high), mask)));
+   }
+   MixInterleaved(2, channelFlags, src + j, dest, len - j);
+}
+#endif
+
+void MixBuffers(unsigned numChannels, const int *channelFlags,
+                const short *src, ArrayOf<int> *dests, size_t len,
+                bool interleaved)
+{
+   if (!interleaved) {
+      for (unsigned int c = 0; c < numChannels; c++)
+         if (channelFlags[c])
+            AddTo(dests[c].get(), src, len);
+      return;
+   }
+
+   const auto dest = dests[0].get();
+   switch (numChannels) {
+   case 1:
+      if (channelFlags[0])
+         AddTo(dest, src, len);
+      break;
+#ifdef MIX_SIMD
+   case 2:
+      MixInterleaved(Channels<2>{}, channelFlags, src, dest, len);
+      break;
+#endif
+   default:
+      MixInterleaved(numChannels, channelFlags, src, dest, len);
+      break;
+   }
+}
+
+// The sums, saturated to int16, as Dither::none would clip them
+void Saturate(const int *src, short *dest, size_t len)
+{
+   size_t j = 0;
+#ifdef MIX_SIMD
+   for (; j + 8 <= len; j += 8)
+      StoreSaturated(dest + j, Load(src + j), Load(src + j + 4));
+#endif
+   for (; j < len; ++j)
+      dest[j] = std::max(-32768, std::min(32767, src[j]));
+}
+
+// dest[j] += src[j] / 32768, where float tracks were mixed too
+void AddTo(float *dest, const int *src, size_t len)
+{
+   const float scale = 1.0f / 32768.0f;
+   size_t j = 0;
+#ifdef MIX_SIMD
+   const Vec s = Splat(scale);
+   for (; j + 4 <= len; j += 4)
+      Store(dest + j, Add(Load(dest + j), Mul(ToFloat(Load(src + j)), s)));
+#endif
+   for (; j < len; ++j)
+      dest[j] += src[j] * scale;
+}
+
+}
+
+void MixBuffers(unsigned numChannels, const int *channelFlags,
+                const float *gains, constSamplePtr src, const double *envelope,
+                SampleBuffer *dests, int len, bool interleaved)
+{
+   const auto source = (const float *)src;
+   const size_t slen = std::max(0, len);
+   if (envelope)
+      MixBuffers(numChannels, channelFlags, gains, source, envelope,
+                 dests, slen, interleaved);
+   else
+      MixBuffers(numChannels, channelFlags, gains, source, Unity{},
+                 dests, slen, interleaved);
+}
+
+void Mixer::SetGains(const WaveTrack *track)
+{
+   for (size_t c = 0; c < mNumChannels; c++) {
+      mGains[c] = mApplyTrackGains ? track->GetChannelGain(c) : 1.0f;
+      if (mSpecGains)
+         mGains[c] *= mSpecGains[c];
+   }
+}
+
 size_t Mixer::MixSameRate(int *channelFlags, WaveTrackCache &cache,
-                               sampleCount *pos)
+                               CrossFader &fader, sampleCount *pos)
 {
    const WaveTrack *const track = cache.GetTrack();
    const double t = ( *pos ).as_double() / track->GetRate();
@@ -182,19 +642,137 @@ size_t Mixer::MixSameRate(int *channelFlags, WaveTrackCache &cache,
       sampleCount{ (tEnd - t) * track->GetRate() + 0.5 }
    );
 
-      auto results = cache.Get(floatSample, *pos, slen, mMayThrow);
-      if (results)
-         memcpy(mFloatBuffer.get(), results, sizeof(float) * slen);
-      else
-         memset(mFloatBuffer.get(), 0, sizeof(float) * slen);
+   // Silence adds nothing, and needs no reading or mixing
+   if (track->IsSilent(*pos, slen)) {
+      *pos += slen;
+      return slen;
+   }
+
+   track->GetEnvelopeValues(mEnvValues.get(), slen, t);
+   SetGains(track);
+
+   if (CanMixInts(track, channelFlags, fader, *pos, slen)) {
+      // Unread samples are silence, adding nothing
+      const auto results = (const short *)
+         cache.Get(int16Sample, *pos, slen, mMayThrow);
       *pos += slen;
+      if (results) {
+         if (!mIntUsed)
+            for (unsigned int c = 0; c < mNumBuffers; c++)
+               std::fill(mIntTemp[c].get(),
+                         mIntTemp[c].get() + mInterleavedBufferSize, 0);
+         mIntUsed = true;
+         MixBuffers(mNumChannels, channelFlags, results, mIntTemp.get(),
+                    slen, mInterleaved);
+      }
+      return slen;
+   }
 
-   MixBuffers(mNumChannels, channelFlags,
-              (samplePtr)mFloatBuffer.get(), mTemp.get(), slen, mInterleaved);
+   // Mix straight from the cache; copy nothing, except near a boundary
+   // of clips, which the fader changes
+   constSamplePtr results = cache.Get(floatSample, *pos, slen, mMayThrow);
+   if (!results) {
+      memset(mFloatBuffer.get(), 0, sizeof(float) * slen);
+      results = (constSamplePtr)mFloatBuffer.get();
+   }
+   else if (fader.Overlaps(*pos, slen)) {
+      memcpy(mFloatBuffer.get(), results, sizeof(float) * slen);
+      fader.Apply(mFloatBuffer.get(), *pos, slen);
+      results = (constSamplePtr)mFloatBuffer.get();
+   }
+   *pos += slen;
+
+   mFloatUsed = true;
+   MixBuffers(mNumChannels, channelFlags, mGains.get(),
+              results, mEnvValues.get(), mTemp.get(), slen, mInterleaved);
 
    return slen;
 }
 
+size_t Mixer::MixVariableRates(int *channelFlags, WaveTrackCache &cache,
+                               CrossFader &fader,
+                               sampleCount *pos, float *queue,
+                               int *queueStart, int *queueLen,
+                               Resample *pResample)
+{
+   const WaveTrack *const track = cache.GetTrack();
+   const double trackRate = track->GetRate();
+   const double factor = mRate / trackRate;
+   // The speed ramps linearly with the output, the same for each track
+   const double startSpeed = mSpeed, speedStep =
+      mMaxOut > 0 ? (mTargetSpeed - mSpeed) / mMaxOut : 0.0;
+   const auto endPos =
+      track->TimeToLongSamples(std::min(track->GetEndTime(), mT1));
+
+   size_t out = 0;
+   while (out < mMaxOut) {
+      if (*queueLen < (int)mProcessLen) {
+         // Shift pending portion to start of the buffer
+         memmove(queue, &queue[*queueStart], (*queueLen) * sizeof(float));
+         *queueStart = 0;
+
+         const auto getLen =
+            limitSampleBufferSize(mQueueMaxLen - *queueLen, endPos - *pos);
+
+         // Nothing to do if past end of play interval
+         if (getLen > 0) {
+            // The envelope is in the time of the track, so apply it before
+            // resampling, as the samples go into the queue
+            const auto results = (const float *)
+               cache.Get(floatSample, *pos, getLen, mMayThrow);
+            float *dest = &queue[*queueLen];
+            if (results) {
+               track->GetEnvelopeValues(mEnvValues.get(), getLen,
+                  (*pos).as_double() / trackRate);
+               if (fader.Overlaps(*pos, getLen)) {
+                  memcpy(dest, results, sizeof(float) * getLen);
+                  fader.Apply(dest, *pos, getLen);
+                  results = dest;
+               }
+               for (size_t i = 0; i < getLen; i++)
+                  dest[i] = results[i] * mEnvValues[i];
+            }
+            else
+               memset(dest, 0, sizeof(float) * getLen);
+
+            *pos += getLen;
+            *queueLen += getLen;
+         }
+      }
+
+      auto thisProcessLen = mProcessLen;
+      bool last = (*queueLen < (int)mProcessLen);
+      if (last)
+         thisProcessLen = *queueLen;
+
+      // A fixed rate resampler ignores the factor
+      auto results = pResample->Process(factor / (startSpeed + speedStep * out),
+                                        &queue[*queueStart],
+                                        thisProcessLen,
+                                        last,
+                                        &mFloatBuffer[out],
+                                        mMaxOut - out);
+
+      const auto input_used = results.first;
+      *queueStart += input_used;
+      *queueLen -= input_used;
+      out += results.second;
+
+      if (last)
+         break;
+   }
+
+   SetGains(track);
+
+   // The envelope was applied already
+   mFloatUsed = true;
+   MixBuffers(mNumChannels, channelFlags, mGains.get(),
+              (constSamplePtr)mFloatBuffer.get(), nullptr,
+              mTemp.get(), out, mInterleaved);
+
+   return out;
+}
+
 size_t Mixer::Process(size_t maxToProcess)
 {
    // MB: this is wrong! mT represented warped time, and mTime is too inaccurate to use
@@ -202,8 +780,11 @@ size_t Mixer::Process(size_t maxToProcess)
    //if (mT >= mT1)
    //   return 0;
 
+   PROFILE_SCOPE("Mixer::Process");
+
    decltype(Process(0)) maxOut = 0;
-   ArrayOf<int> channelFlags{ mNumChannels };
+   // A member, so that playback allocates nothing here
+   auto &channelFlags = mChannelFlags;
 
    mMaxOut = maxToProcess;
 
@@ -213,10 +794,12 @@ size_t Mixer::Process(size_t maxToProcess)
       for(size_t j=0; j<mNumChannels; j++)
          channelFlags[j] = 0;
 
+      mSpecGains = nullptr;
       if( mMixerSpec ) {
          //ignore left and right when downmixing is not required
          for(size_t j = 0; j < mNumChannels; j++ )
             channelFlags[ j ] = mMixerSpec->mMap[ i ][ j ] ? 1 : 0;
+         mSpecGains = mMixerSpec->mGain[ i ].get();
       }
       else {
          switch(track->GetChannel()) {
@@ -237,8 +820,15 @@ size_t Mixer::Process(size_t maxToProcess)
          }
       
 	  }
-      maxOut = std::max(maxOut,
-            MixSameRate(channelFlags.get(), mInputTrack[i], &mSamplePos[i]));
+      if (mResample[i])
+         maxOut = std::max(maxOut,
+            MixVariableRates(channelFlags.get(), mInputTrack[i],
+               mCrossFaders[i], &mSamplePos[i], mSampleQueue[i].get(),
+               &mQueueStart[i], &mQueueLen[i], mResample[i].get()));
+      else
+         maxOut = std::max(maxOut,
+            MixSameRate(channelFlags.get(), mInputTrack[i], mCrossFaders[i],
+               &mSamplePos[i]));
 
       double t = mSamplePos[i].as_double() / (double)track->GetRate();
       if (mT0 > mT1)
@@ -248,7 +838,28 @@ size_t Mixer::Process(size_t maxToProcess)
          // forwards (the usual)
          mTime = std::min(std::max(t, mTime), mT1);
    }
-   if(mInterleaved) {
+   mSpeed = mTargetSpeed;
+
+   const size_t outLen = maxOut * (mInterleaved ? mNumChannels : 1);
+   if (mIntUsed && !mFloatUsed) {
+      // Only integers were mixed; no dither, as there is nothing to round
+      for(size_t c=0; c<mNumBuffers; c++)
+         Saturate(mIntTemp[c].get(), (short *)mBuffer[c].ptr(), outLen);
+      return maxOut;
+   }
+   if (mIntUsed)
+      for(size_t c=0; c<mNumBuffers; c++)
+         AddTo((float *)mTemp[c].ptr(), mIntTemp[c].get(), outLen);
+
+   if(mFormat == floatSample) {
+      // As for playback; no dither, and the channels interleave alike in
+      // both buffers, so each one is a single copy
+      for(size_t c=0; c<mNumBuffers; c++)
+         ConvertSamples<floatSample, floatSample>(
+            (const float *)mTemp[c].ptr(), (float *)mBuffer[c].ptr(),
+            outLen);
+   }
+   else if(mInterleaved) {
       for(size_t c=0; c<mNumChannels; c++) {
          CopySamples(mTemp[0].ptr() + (c * SAMPLE_SIZE(floatSample)),
             floatSample,
@@ -293,10 +904,7 @@ void Mixer::Restart()
    for(size_t i=0; i<mNumInputTracks; i++)
       mSamplePos[i] = mInputTrack[i].GetTrack()->TimeToLongSamples(mT0);
 
-   for(size_t i=0; i<mNumInputTracks; i++) {
-      mQueueStart[i] = 0;
-      mQueueLen[i] = 0;
-   }
+   MakeResamplers();
 }
 
 void Mixer::Reposition(double t)
@@ -308,11 +916,10 @@ void Mixer::Reposition(double t)
    else
       mTime = std::max(mT0, (std::min(mT1, mTime)));
 
-   for(size_t i=0; i<mNumInputTracks; i++) {
+   for(size_t i=0; i<mNumInputTracks; i++)
       mSamplePos[i] = mInputTrack[i].GetTrack()->TimeToLongSamples(mTime);
-      mQueueStart[i] = 0;
-      mQueueLen[i] = 0;
-   }
+
+   MakeResamplers();
 }
 
 void Mixer::SetTimesAndSpeed(double t0, double t1, double speed)
@@ -320,10 +927,21 @@ void Mixer::SetTimesAndSpeed(double t0, double t1, double speed)
    wxASSERT(std::isfinite(speed));
    mT0 = t0;
    mT1 = t1;
-   mSpeed = fabs(speed);
+   mSpeed = mTargetSpeed = ClampSpeed(fabs(speed));
    Reposition(t0);
 }
 
+void Mixer::SetSpeed(double speed)
+{
+   wxASSERT(std::isfinite(speed));
+   mTargetSpeed = ClampSpeed(fabs(speed));
+}
+
+double Mixer::ClampSpeed(double speed) const
+{
+   return std::max(mMinSpeed, std::min(mMaxSpeed, speed));
+}
+
 MixerSpec::MixerSpec( unsigned numTracks, unsigned maxNumChannels )
 {
    mNumTracks = mNumChannels = numTracks;
@@ -349,12 +967,18 @@ MixerSpec::MixerSpec( const MixerSpec &mixerSpec )
 
    for( unsigned int i = 0; i < mNumTracks; i++ )
       for( unsigned int j = 0; j < mNumChannels; j++ )
+      {
          mMap[ i ][ j ] = mixerSpec.mMap[ i ][ j ];
+         mGain[ i ][ j ] = mixerSpec.mGain[ i ][ j ];
+      }
 }
 
 void MixerSpec::Alloc()
 {
    mMap.reinit(mNumTracks, mMaxNumChannels);
+   mGain.reinit(mNumTracks, mMaxNumChannels);
+   for( unsigned int i = 0; i < mNumTracks; i++ )
+      std::fill(mGain[ i ].get(), mGain[ i ].get() + mMaxNumChannels, 1.0f);
 }
 
 MixerSpec::~MixerSpec()
@@ -375,13 +999,42 @@ bool MixerSpec::SetNumChannels( unsigned newNumChannels )
          mMap[ i ][ j ] = false;
 
       for( unsigned int j = mNumChannels; j < newNumChannels; j++ )
+      {
          mMap[ i ][ j ] = false;
+         mGain[ i ][ j ] = 1.0f;
+      }
    }
 
    mNumChannels = newNumChannels;
    return true;
 }
 
+bool MixerSpec::SetSurroundDownmix()
+{
+   if( mNumTracks != 6 || mMaxNumChannels < 2 )
+      return false;
+
+   // ITU-R BS.775 coefficients
+   const float minus3dB = 0.70710678f;
+   const struct { bool left, right; float gain; } routes[] = {
+      { true,  false, 1.0f },     // L
+      { false, true,  1.0f },     // R
+      { true,  true,  minus3dB }, // C
+      { false, false, 1.0f },     // LFE
+      { true,  false, minus3dB }, // Ls
+      { false, true,  minus3dB }, // Rs
+   };
+
+   SetNumChannels( 2 );
+   for( unsigned int i = 0; i < mNumTracks; i++ )
+   {
+      mMap[ i ][ 0 ] = routes[ i ].left;
+      mMap[ i ][ 1 ] = routes[ i ].right;
+      mGain[ i ][ 0 ] = mGain[ i ][ 1 ] = routes[ i ].gain;
+   }
+   return true;
+}
+
 MixerSpec& MixerSpec::operator=( const MixerSpec &mixerSpec )
 {
    mNumTracks = mixerSpec.mNumTracks;
@@ -392,7 +1045,10 @@ MixerSpec& MixerSpec::operator=( const MixerSpec &mixerSpec )
 
    for( unsigned int i = 0; i < mNumTracks; i++ )
       for( unsigned int j = 0; j < mNumChannels; j++ )
+      {
          mMap[ i ][ j ] = mixerSpec.mMap[ i ][ j ];
+         mGain[ i ][ j ] = mixerSpec.mGain[ i ][ j ];
+      }
 
    return *this;
 }
@@ -25,6 +25,7 @@
 #include "SampleFormat.h"
 #include <vector>
 
+class CrossFader;
 class Resample;
 class DirManager;
 class TrackFactory;
@@ -45,9 +46,11 @@ class WaveTrackCache;
  * no explicit time range to process, and the whole occupied length of the
  * input tracks is processed.
  */
-void MixBuffers(unsigned numChannels, int *channelFlags,
-                samplePtr src,
-                samplePtr *dests, int len, bool interleaved);
+// Adds src, times the envelope (if not null) and the gain of each enabled
+// channel, into the channels of dests
+void MixBuffers(unsigned numChannels, const int *channelFlags,
+                const float *gains, constSamplePtr src, const double *envelope,
+                SampleBuffer *dests, int len, bool interleaved);
 
 class AUDACITY_DLL_API MixerSpec
 {
@@ -57,6 +60,8 @@ class AUDACITY_DLL_API MixerSpec
 
 public:
    ArraysOf<bool> mMap;
+   // The gain of each track in each channel it goes to; one, unless set
+   ArraysOf<float> mGain;
 
    MixerSpec( unsigned numTracks, unsigned maxNumChannels );
    MixerSpec( const MixerSpec &mixerSpec );
@@ -68,6 +73,12 @@ public:
    unsigned GetMaxNumChannels() { return mMaxNumChannels; }
    unsigned GetNumTracks() { return mNumTracks; }
 
+   /// Route and weight six tracks, in the order L, R, C, LFE, Ls, Rs, into
+   /// two channels, the centre and surrounds at -3 dB and without the LFE.
+   /// False, changing nothing, if there are not six tracks or two channels
+   /// are too many.
+   bool SetSurroundDownmix();
+
    MixerSpec& operator=( const MixerSpec &mixerSpec );
 };
 
@@ -82,7 +93,9 @@ class AUDACITY_DLL_API Mixer {
          double startTime, double stopTime,
          unsigned numOutChannels, size_t outBufferSize, bool outInterleaved,
          double outRate, sampleFormat outFormat,
-         bool highQuality = true, MixerSpec *mixerSpec = NULL);
+         bool highQuality = true, MixerSpec *mixerSpec = NULL,
+         bool applyTrackGains = true,
+         double minSpeed = 1.0, double maxSpeed = 1.0);
 
    virtual ~ Mixer();
 
@@ -107,6 +120,11 @@ class AUDACITY_DLL_API Mixer {
    // Used in scrubbing.
    void SetTimesAndSpeed(double t0, double t1, double speed);
 
+   /// Change the speed of play, as a factor limited to the range given to
+   /// the constructor, without a jump: it ramps from the current speed to
+   /// this one over the next call to Process().  The pitch follows it.
+   void SetSpeed(double speed);
+
    /// Retrieve the main buffer or the interleaved buffer
    samplePtr GetBuffer();
 
@@ -116,14 +134,31 @@ class AUDACITY_DLL_API Mixer {
  private:
 
    void Clear();
+   void MakeResamplers();
    size_t MixSameRate(int *channelFlags, WaveTrackCache &cache,
-                           sampleCount *pos);
+                           CrossFader &fader, sampleCount *pos);
+   // For tracks whose rate is not the mixer's
+   size_t MixVariableRates(int *channelFlags, WaveTrackCache &cache,
+                           CrossFader &fader,
+                           sampleCount *pos, float *queue,
+                           int *queueStart, int *queueLen,
+                           Resample *pResample);
+   double ClampSpeed(double speed) const;
+   // The gains of the track in each channel, with those of the MixerSpec
+   void SetGains(const WaveTrack *track);
+   // Whether MixSameRate() may add the int16 samples of the track unscaled,
+   // given the gains and envelope values it found
+   bool CanMixInts(const WaveTrack *track, const int *channelFlags,
+                   const CrossFader &fader, sampleCount pos,
+                   size_t len) const;
 
  private:
 
     // Input
    size_t           mNumInputTracks;
    ArrayOf<WaveTrackCache> mInputTrack;
+   // Smooth the boundaries of abutting clips of each track
+   ArrayOf<CrossFader> mCrossFaders;
    ArrayOf<sampleCount> mSamplePos;
    Doubles          mEnvValues;
    double           mT0; // Start time
@@ -147,10 +182,26 @@ class AUDACITY_DLL_API Mixer {
    bool             mInterleaved;
    ArrayOf<SampleBuffer> mBuffer, mTemp;
    Floats           mFloatBuffer;
+   // Sums of int16 tracks, in 32 bits, when mixing for int16 output
+   bool             mIntMix;
+   ArraysOf<int>    mIntTemp;
+   // What the current Process() mixed into mIntTemp and into mTemp
+   bool             mIntUsed { false }, mFloatUsed { false };
    double           mRate;
+   // Speeds the resamplers allow; when they differ, they vary the rate
+   const double     mMinSpeed, mMaxSpeed;
    double           mSpeed;
+   // Where the ramp of the next Process() ends
+   double           mTargetSpeed;
    bool             mHighQuality;
 
+   // Whether to apply the pan of each track; if not, AudioIO does
+   const bool       mApplyTrackGains;
+   Floats           mGains;
+   ArrayOf<int>     mChannelFlags;
+   // The row of the MixerSpec for the track being mixed, or null
+   const float      *mSpecGains { nullptr };
+
    bool             mMayThrow;
 };
 
@@ -0,0 +1,161 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   MixerPool.cpp
+
+*******************************************************************//**
+
+\class MixerPool
+\brief Runs a batch of independent jobs on a few threads at once.
+
+AudioIO::FillBuffers() uses it for the Mixer::Process() of each playback
+track, which are independent of each other, and then fills the ring
+buffers in the audio thread as before.  The calling thread works on the
+batch too.  Jobs are taken one at a time from a shared counter, so a
+thread that finishes early takes more, and the batch balances even when
+some tracks cost much more than others.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "MixerPool.h"
+
+#include <wx/thread.h>
+
+#include "ThreadPriority.h"
+
+class MixerPool::Thread final : public wxThread
+{
+public:
+   Thread(MixerPool &pool, unsigned generation)
+      : wxThread{ wxTHREAD_JOINABLE }, mPool{ pool }, mGeneration{ generation }
+   {}
+
+protected:
+   ExitCode Entry() override
+   {
+      mPool.Help(mGeneration);
+      return 0;
+   }
+
+private:
+   MixerPool &mPool;
+   // The batch before the first one this thread may help with
+   const unsigned mGeneration;
+};
+
+MixerPool::MixerPool(unsigned nHelpers)
+   : mnHelpers{ nHelpers }
+{
+}
+
+MixerPool::~MixerPool()
+{
+   Stop();
+}
+
+void MixerPool::Start()
+{
+   // Called with mLock held
+   mStopping = false;
+   for (unsigned ii = 0; ii < mnHelpers; ++ii) {
+      auto thread = std::make_unique<Thread>(*this, mGeneration);
+      if (thread->Run() == wxTHREAD_NO_ERROR)
+         mThreads.push_back(std::move(thread));
+   }
+}
+
+void MixerPool::Stop()
+{
+   decltype(mThreads) threads;
+   {
+      ODLocker locker{ &mLock };
+      mStopping = true;
+      mStarted.Broadcast();
+      threads.swap(mThreads);
+   }
+
+   for (auto &thread : threads)
+      thread->Wait();
+}
+
+void MixerPool::Drain(const Job &job, size_t count)
+{
+   for (size_t index; (index = mNext++) < count;)
+      job(index);
+}
+
+void MixerPool::Run(size_t count, const Job &job)
+{
+   if (count == 0)
+      return;
+
+   ODLocker locker{ &mLock };
+
+   // Not worth waking anybody for a single job
+   if (count > 1 && mThreads.empty() && mnHelpers > 0)
+      Start();
+   if (count == 1 || mThreads.empty()) {
+      locker.reset();
+      for (size_t index = 0; index < count; ++index)
+         job(index);
+      return;
+   }
+
+   mJob = &job;
+   mIOContext = BlockIOStats::Current();
+   mCount = count;
+   mNext = 0;
+   mBusy = mThreads.size();
+   ++mGeneration;
+   mStarted.Broadcast();
+   locker.reset();
+
+   Drain(job, count);
+
+   locker.reset(&mLock);
+   while (mBusy > 0)
+      mFinished.Wait();
+   mJob = nullptr;
+}
+
+void MixerPool::SetRealTime(bool realTime, double periodSecs)
+{
+   ODLocker locker{ &mLock };
+   mRealTime = realTime;
+   mPeriodSecs = periodSecs;
+   ++mScheduling;
+}
+
+void MixerPool::Help(unsigned generation)
+{
+   // Threads start with the scheduling of the system
+   unsigned scheduling = 0;
+   ODLocker locker{ &mLock };
+   for (;;) {
+      while (generation == mGeneration && !mStopping)
+         mStarted.Wait();
+      if (mStopping)
+         break;
+      generation = mGeneration;
+
+      const auto &job = *mJob;
+      const auto count = mCount;
+      const bool reschedule = scheduling != mScheduling;
+      scheduling = mScheduling;
+      const bool realTime = mRealTime;
+      const double periodSecs = mPeriodSecs;
+      BlockIOStats::Scope ioScope{ mIOContext };
+      locker.reset();
+      if (reschedule)
+         SetThreadRealTime(realTime, periodSecs);
+      Drain(job, count);
+      locker.reset(&mLock);
+
+      if (--mBusy == 0)
+         mFinished.Signal();
+   }
+}
@@ -0,0 +1,79 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   MixerPool.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_MIXER_POOL__
+#define __AUDACITY_MIXER_POOL__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+
+#include <atomic>
+#include <functional>
+#include <vector>
+
+#include "ondemand/ODTaskThread.h"
+#include "blockfile/BlockIOStats.h"
+
+/// A few threads that help one other thread, usually the audio thread,
+/// run many independent jobs, such as the Process() of one Mixer for each
+/// playback track.
+class MixerPool final {
+ public:
+   using Job = std::function< void(size_t index) >;
+
+   /// Threads start on the first Run() that can use them.
+   /// Zero helpers makes Run() do everything in the calling thread.
+   explicit MixerPool(unsigned nHelpers);
+   ~MixerPool();
+
+   MixerPool(const MixerPool&) PROHIBITED;
+   MixerPool &operator= (const MixerPool&) PROHIBITED;
+
+   /// Calls job(0) ... job(count - 1), in any order and in the calling
+   /// thread and the helpers together, and returns when all are done.
+   /// Not reentrant; call it from one thread only.
+   void Run(size_t count, const Job &job);
+
+   /// Whether the helpers run with real-time scheduling, as the audio
+   /// thread they help; each changes at its next job
+   void SetRealTime(bool realTime, double periodSecs);
+
+ private:
+   class Thread;
+   friend Thread;
+   void Help(unsigned generation);
+   void Start();
+   void Stop();
+
+   // Take jobs until none are left; each thread that finishes one early
+   // takes the next, so uneven jobs still balance
+   void Drain(const Job &job, size_t count);
+
+   const unsigned mnHelpers;
+
+   ODLock mLock;
+   ODCondition mStarted { &mLock };
+   ODCondition mFinished { &mLock };
+   const Job *mJob { nullptr };
+   BlockIOStats::Context mIOContext {};
+   size_t mCount { 0 };
+   unsigned mGeneration { 0 };
+   unsigned mBusy { 0 };
+   bool mStopping { false };
+   std::atomic<size_t> mNext { 0 };
+
+   bool mRealTime { false };
+   double mPeriodSecs { 0 };
+   unsigned mScheduling { 0 }; // counts the changes of the two above
+
+   std::vector< std::unique_ptr<Thread> > mThreads;
+};
+
+#endif
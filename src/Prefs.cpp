@@ -59,15 +59,140 @@
 #include <wx/fileconf.h>
 #include <wx/filename.h>
 #include <wx/stdpaths.h>
+#include <wx/thread.h>
+
+#include <atomic>
+#include <vector>
 
 #include "AudacityApp.h"
+#include "AudioIO.h"
 #include "FileNames.h"
 #include "Languages.h"
 
 #include "Prefs.h"
+#include "SampleFormat.h"
+#include "prefs/GUISettings.h"
 #include "widgets/ErrorDialog.h"
 #include "Internat.h"
 
+// wxFileConfig with each call serialized, so that worker threads, such as
+// those of a batch import, may read preferences while the main thread does.
+// A sequence of calls that relies on SetPath() is still for one thread only.
+// The lock is recursive, because wxFileConfig reads numbers as strings.
+// A Flush() after any write publishes a new PrefsSnapshot.
+class AudacityPrefs final : public wxFileConfig
+{
+public:
+   AudacityPrefs(const wxString &appName, const wxString &vendorName,
+                 const wxString &localFilename, const wxString &globalFilename,
+                 long style)
+   : wxFileConfig(appName, vendorName, localFilename, globalFilename, style)
+   , mMutex(wxMUTEX_RECURSIVE)
+   {}
+
+   void SetPath(const wxString &strPath) override
+   { wxMutexLocker locker(mMutex); wxFileConfig::SetPath(strPath); }
+   bool HasGroup(const wxString &strName) const override
+   { wxMutexLocker locker(mMutex); return wxFileConfig::HasGroup(strName); }
+   bool HasEntry(const wxString &strName) const override
+   { wxMutexLocker locker(mMutex); return wxFileConfig::HasEntry(strName); }
+   bool Flush(bool bCurrentOnly = false) override
+   {
+      bool result;
+      {
+         wxMutexLocker locker(mMutex);
+         result = wxFileConfig::Flush(bCurrentOnly);
+      }
+      if (mChanged.exchange(false))
+         PrefsSnapshot::Update();
+      return result;
+   }
+   bool DeleteEntry(const wxString &key, bool bGroupIfEmptyAlso = true) override
+   { wxMutexLocker locker(mMutex); mChanged = true; return wxFileConfig::DeleteEntry(key, bGroupIfEmptyAlso); }
+   bool DeleteGroup(const wxString &szKey) override
+   { wxMutexLocker locker(mMutex); mChanged = true; return wxFileConfig::DeleteGroup(szKey); }
+
+protected:
+   bool DoReadString(const wxString &key, wxString *pStr) const override
+   { wxMutexLocker locker(mMutex); return wxFileConfig::DoReadString(key, pStr); }
+   bool DoReadLong(const wxString &key, long *pl) const override
+   { wxMutexLocker locker(mMutex); return wxFileConfig::DoReadLong(key, pl); }
+   bool DoWriteString(const wxString &key, const wxString &szValue) override
+   { wxMutexLocker locker(mMutex); mChanged = true; return wxFileConfig::DoWriteString(key, szValue); }
+   bool DoWriteLong(const wxString &key, long lValue) override
+   { wxMutexLocker locker(mMutex); mChanged = true; return wxFileConfig::DoWriteLong(key, lValue); }
+
+private:
+   mutable wxMutex mMutex;
+   std::atomic<bool> mChanged { false };
+};
+
+namespace {
+   std::atomic<const PrefsSnapshot *> sSnapshot { nullptr };
+   // Every snapshot published, as a thread may still read an old one
+   std::vector< std::unique_ptr<const PrefsSnapshot> > sSnapshots;
+   wxMutex sSnapshotsMutex;
+}
+
+PrefsSnapshot::PrefsSnapshot()
+   : latencyDuration{ DEFAULT_LATENCY_DURATION }
+   , latencyCorrection{ DEFAULT_LATENCY_CORRECTION }
+   , defaultSampleFormat{ floatSample }
+   , envDBRange{ ENV_DB_RANGE }
+{
+}
+
+const PrefsSnapshot &PrefsSnapshot::Get()
+{
+   static const PrefsSnapshot defaults;
+   const auto snapshot = sSnapshot.load(std::memory_order_acquire);
+   return snapshot ? *snapshot : defaults;
+}
+
+void PrefsSnapshot::Update()
+{
+   if (!gPrefs)
+      return;
+
+   auto snapshot = std::make_unique<PrefsSnapshot>();
+   auto &s = *snapshot;
+   gPrefs->Read(wxT("/AudioIO/Host"), &s.audioHost, wxT(""));
+   gPrefs->Read(wxT("/AudioIO/RecordChannels"), &s.recordChannels, 2L);
+   gPrefs->Read(wxT("/AudioIO/SWPlaythrough"), &s.softwarePlaythrough, false);
+   gPrefs->Read(wxT("/AudioIO/LowLatencyMonitoring"),
+                &s.lowLatencyMonitoring, false);
+   gPrefs->Read(wxT("/AudioIO/SoundActivatedRecord"),
+                &s.soundActivatedRecord, false);
+   gPrefs->Read(wxT("/AudioIO/SilenceLevel"), &s.silenceLevelDB, -50);
+   gPrefs->Read(wxT("/AudioIO/PremixPlayback"), &s.premixPlayback, false);
+   gPrefs->Read(wxT("/AudioIO/RealTimeThreads"), &s.realTimeThreads, true);
+   gPrefs->Read(wxT("/AudioIO/AudioThreadCPU"), &s.audioThreadCPU, -1);
+   gPrefs->Read(wxT("/AudioIO/LockBuffers"), &s.lockBuffers, false);
+   gPrefs->Read(wxT("/AudioIO/CheckpointSeconds"), &s.checkpointSecs, 10.0);
+   gPrefs->Read(wxT("/AudioIO/SeekShortPeriod"), &s.seekShortSecs, 1.0);
+   gPrefs->Read(wxT("/AudioIO/SeekLongPeriod"), &s.seekLongSecs, 15.0);
+   gPrefs->Read(wxT("/AudioIO/LoopCacheMax"), &s.loopCacheMaxMB, 64.0);
+   gPrefs->Read(wxT("/AudioIO/LatencyDuration"), &s.latencyDuration,
+                DEFAULT_LATENCY_DURATION);
+   gPrefs->Read(wxT("/AudioIO/LatencyCorrection"), &s.latencyCorrection,
+                DEFAULT_LATENCY_CORRECTION);
+   gPrefs->Read(wxT("/AudioIO/AutoLatencyCorrection"),
+                &s.autoLatencyCorrection, false);
+   s.defaultSampleFormat =
+      gPrefs->Read(wxT("/SamplingRate/DefaultProjectSampleFormat"),
+                   (long)floatSample);
+   s.envDBRange = gPrefs->Read(ENV_DB_KEY, ENV_DB_RANGE);
+   gPrefs->Read(wxT("/GUI/SampleView"), &s.sampleView, 1);
+   gPrefs->Read(wxT("/GUI/ShowTrackNameInWaveform"),
+                &s.showTrackNameInWaveform, false);
+   gPrefs->Read(wxT("/Directories/CacheBlockFiles"), &s.cacheBlockFiles,
+                false);
+
+   wxMutexLocker locker(sSnapshotsMutex);
+   sSnapshot.store(snapshot.get(), std::memory_order_release);
+   sSnapshots.push_back(std::move(snapshot));
+}
+
 std::unique_ptr<wxFileConfig> ugPrefs {};
 wxFileConfig *gPrefs = NULL;
 int gMenusDirty = 0;
@@ -78,7 +203,7 @@ void InitPreferences()
 
    wxFileName configFileName(FileNames::DataDir(), wxT("audacity.cfg"));
 
-   ugPrefs = std::make_unique<wxFileConfig>
+   ugPrefs = std::make_unique<AudacityPrefs>
       (appName, wxEmptyString,
        configFileName.GetFullPath(),
        wxEmptyString, wxCONFIG_USE_LOCAL_FILE);
@@ -274,6 +399,12 @@ void InitPreferences()
 
 void FinishPreferences()
 {
+   {
+      wxMutexLocker locker(sSnapshotsMutex);
+      sSnapshot.store(nullptr, std::memory_order_release);
+      sSnapshots.clear();
+   }
+
    if (gPrefs) {
       wxConfigBase::Set(NULL);
       ugPrefs.reset();
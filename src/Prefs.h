@@ -40,4 +40,50 @@ void FinishPreferences();
 extern AUDACITY_DLL_API wxFileConfig *gPrefs;
 extern int gMenusDirty;
 
+/// Preferences read when starting streams, drawing and the like, typed and
+/// read from gPrefs once.  A snapshot never changes; a Flush() of gPrefs
+/// after a write builds a new one and publishes it, so any thread may call
+/// Get() without a lock or a lookup of a string.  Snapshots live until
+/// FinishPreferences(), so a reference from Get() stays good.
+struct AUDACITY_DLL_API PrefsSnapshot
+{
+   // "/AudioIO/..."
+   wxString audioHost;                 // "Host"
+   long recordChannels { 2 };          // "RecordChannels"
+   bool softwarePlaythrough { false }; // "SWPlaythrough"
+   bool lowLatencyMonitoring { false }; // "LowLatencyMonitoring"
+   bool soundActivatedRecord { false }; // "SoundActivatedRecord"
+   int silenceLevelDB { -50 };         // "SilenceLevel"
+   bool premixPlayback { false };      // "PremixPlayback"
+   bool realTimeThreads { true };      // "RealTimeThreads"
+   int audioThreadCPU { -1 };          // "AudioThreadCPU"
+   bool lockBuffers { false };         // "LockBuffers"
+   double checkpointSecs { 10.0 };     // "CheckpointSeconds"
+   double seekShortSecs { 1.0 };       // "SeekShortPeriod"
+   double seekLongSecs { 15.0 };       // "SeekLongPeriod"
+   double loopCacheMaxMB { 64.0 };     // "LoopCacheMax"
+   double latencyDuration;             // "LatencyDuration", milliseconds
+   double latencyCorrection;           // "LatencyCorrection", milliseconds
+   bool autoLatencyCorrection { false }; // "AutoLatencyCorrection"
+
+   // "/SamplingRate/DefaultProjectSampleFormat", as a sampleFormat
+   long defaultSampleFormat;
+
+   // "/GUI/..."
+   int envDBRange;                     // "EnvdBRange"
+   int sampleView { 1 };               // "SampleView"
+   bool showTrackNameInWaveform { false }; // "ShowTrackNameInWaveform"
+
+   // "/Directories/CacheBlockFiles"
+   bool cacheBlockFiles { false };
+
+   PrefsSnapshot();
+
+   /// The latest snapshot; the defaults before InitPreferences()
+   static const PrefsSnapshot &Get();
+
+   /// Read gPrefs again, and publish the result
+   static void Update();
+};
+
 #endif
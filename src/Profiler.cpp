@@ -11,147 +11,449 @@
 ******************************************************************//**
 
 \class Profiler
-\brief A simple profiler to measure the average time lengths that a
-particular task/function takes.  Currently not thread-safe and not thread-smart,
-but it will probably work fine if you use it on a high level.
+\brief A profiler that records how long tasks take, on any thread, and
+at exit writes their statistics to a log and, if asked, a trace of all of
+them that Chrome's about:tracing or Perfetto shows on one timeline.
 
-\class TaskProfile
-\brief a simple class to keep track of one task that may be called multiple times.
+\class ProfileScope
+\brief Records the time from its construction to its destruction, and
+the allocations made in it, when tracing is on.
 
 *//*******************************************************************/
 
 #include "Audacity.h"
 #include "Profiler.h"
+#include "blockfile/BlockIOStats.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <new>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <string>
+#include <time.h>
 #include <wx/crt.h>
+#include <wx/ffile.h>
 
-///write to a profile at the end of the test.
-Profiler::~Profiler()
-{
-   if(mTasks.size())
-   {
-      //print everything out.  append to a log.
-      FILE* log = fopen("AudacityProfilerLog.txt", "a");
-      time_t now;
-
-      time(&now);
-      wxFprintf(log,"Audacity Profiler Run, Ended at ");
-      wxFprintf(log,"%s",ctime(&now));
-      wxFprintf(log,"****************************************\n");
-      //print out the tasks
-      for(int i=0;i<(int)mTasks.size();i++)
-      {
-         if(mTasks[i]->mNumHits>0)
-         {
-            wxFprintf(log,"Task: %s\n(begins at line %d in %s)\n\n",mTasks[i]->mDescription.get(), mTasks[i]->mLine, mTasks[i]->mFileName.get());
-            wxFprintf(log,"Number of times run: %d\n",mTasks[i]->mNumHits);
-            wxFprintf(log,"Total run time (seconds): %f\n", (double)mTasks[i]->mCumTime/CLOCKS_PER_SEC);
-            wxFprintf(log,"Average run time (seconds): %f\n",mTasks[i]->ComputeAverageRunTime());
-
-            if(i < ((int)mTasks.size()) -1)
-               wxFprintf(log,"----------------------------\n");
-         }
-      }
-      wxFprintf(log,"\n****************************************\n\n\n");
+#ifdef TRACK_ALLOCATIONS
 
-      fclose(log);
+namespace {
+
+// Plain counters of each thread, which need no construction, no lock, and
+// no allocation of their own
+thread_local unsigned long long tAllocations = 0;
+thread_local unsigned long long tAllocatedBytes = 0;
+
+void *Allocate(std::size_t size)
+{
+   ++tAllocations;
+   tAllocatedBytes += size;
+   for (;;) {
+      if (void *p = malloc(size ? size : 1))
+         return p;
+      const auto handler = std::get_new_handler();
+      if (!handler)
+         return nullptr;
+      handler();
    }
 }
 
-///start the task timer.
-void Profiler::Begin(const char* fileName, int lineNum, const char* taskDescription)
+}
+
+// Replace the global allocation functions, counting each call.  The
+// allocations of C libraries, with malloc, are not counted.
+
+void *operator new(std::size_t size)
 {
-   mTasksMutex.Lock();
-   GetOrCreateTaskProfile(fileName,lineNum)->Begin(fileName,lineNum,taskDescription);
-   mTasksMutex.Unlock();
+   if (void *p = Allocate(size))
+      return p;
+   throw std::bad_alloc{};
 }
 
-///end the task timer.
-void Profiler::End(const char* fileName, int lineNum, const char* taskDescription)
+void *operator new[](std::size_t size)
 {
-   mTasksMutex.Lock();
-   TaskProfile* tp;
-   tp=GetTaskProfileByDescription(taskDescription);
-   if(tp)
-      tp->End(fileName,lineNum,taskDescription);
-   mTasksMutex.Unlock();
+   return operator new(size);
 }
 
-///Gets the singleton instance
-Profiler* Profiler::Instance()
+void *operator new(std::size_t size, const std::nothrow_t&) noexcept
 {
-   static Profiler pro;
-   //this isn't 100% threadsafe but I think Okay for this purpose.
+   try { return Allocate(size); }
+   catch (...) { return nullptr; }
+}
 
-   return &pro;
+void *operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+   return operator new(size, std::nothrow);
 }
 
-///find a taskProfile for the given task, otherwise create
-TaskProfile* Profiler::GetOrCreateTaskProfile(const char* fileName, int lineNum)
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, std::size_t) noexcept { free(p); }
+void operator delete[](void *p, std::size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t&) noexcept { free(p); }
+
+#endif
+
+class Profiler::ThreadBuffer
 {
-   for(int i=0;i<(int)mTasks.size();i++)
+public:
+   struct Event
    {
-      if(strcmp(fileName, mTasks[i]->mFileName.get())==0 && lineNum == mTasks[i]->mLine)
-         return mTasks[i].get();
-   }
+      const char* name;
+      long long begin;
+      long long end;
+      // Made during the task; while it is open, the count at its beginning
+      unsigned long long allocations;
+   };
 
-   auto tp = make_movable<TaskProfile>();
-   mTasks.push_back(std::move(tp));
-   return mTasks.back().get();
-}
+   // Enough for a few minutes of audio callbacks; later events are counted
+   // but dropped, so that nothing written is ever moved or overwritten
+   // while another thread might read it
+   static const size_t Capacity = 1 << 18;
+
+   explicit ThreadBuffer(int id)
+      : mId{ id }, mEvents( Capacity )
+   {}
+
+   const int mId;
+
+   // Written by the owning thread only, and published by the count
+   std::vector<Event> mEvents;
+   std::atomic<size_t> mCount{ 0 };
+   std::atomic<size_t> mDropped{ 0 };
 
-TaskProfile* Profiler::GetTaskProfileByDescription(const char* description)
+   // Written once, before mNamed is set
+   char mName[64]{};
+   std::atomic<bool> mNamed{ false };
+
+   // The allocations of the thread as of its latest task, published for
+   // the log
+   std::atomic<unsigned long long> mAllocations{ 0 };
+   std::atomic<unsigned long long> mAllocatedBytes{ 0 };
+
+   // Tasks begun and not yet ended; the owning thread's only
+   std::vector<Event> mOpen;
+};
+
+bool Profiler::sEnabled = (getenv("AUDACITY_PROFILE_TRACE") != NULL);
+
+Profiler::Profiler()
 {
-   for(int i=0;i<(int)mTasks.size();i++)
-   {
-      if(strcmp(description, mTasks[i]->mDescription.get())==0)
-         return mTasks[i].get();
-   }
+   // Made first, so that it outlives the writing of the log at exit
+   BlockIOStats::Program();
 
-   return NULL;
+   if (sEnabled)
+      mTracePath = wxString::FromUTF8(getenv("AUDACITY_PROFILE_TRACE"));
+}
 
+///write the log and the trace at the end of the test.
+Profiler::~Profiler()
+{
+   ODLocker locker{ &mBuffersMutex };
+   WriteLog();
+   WriteTrace();
 }
 
+// static
+long long Profiler::Now()
+{
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
 
-///Task Profile
-TaskProfile::TaskProfile()
+// static
+unsigned long long Profiler::Allocations()
 {
-   mCumTime=0;
-   mNumHits=0;
+#ifdef TRACK_ALLOCATIONS
+   return tAllocations;
+#else
+   return 0;
+#endif
 }
 
-TaskProfile::~TaskProfile()
+// static
+unsigned long long Profiler::AllocatedBytes()
 {
+#ifdef TRACK_ALLOCATIONS
+   return tAllocatedBytes;
+#else
+   return 0;
+#endif
 }
 
 ///start the task timer.
-void TaskProfile::Begin(const char* fileName, int lineNum, const char* taskDescription)
+void Profiler::Begin(const char* WXUNUSED(fileName), int WXUNUSED(lineNum), const char* taskDescription)
+{
+   auto &open = GetThreadBuffer().mOpen;
+   open.push_back({ taskDescription, Now(), 0, 0 });
+   // After the push, which may allocate
+   open.back().allocations = Allocations();
+}
+
+///end the task timer.
+void Profiler::End(const char* WXUNUSED(fileName), int WXUNUSED(lineNum), const char* taskDescription)
+{
+   const auto now = Now();
+   auto &open = GetThreadBuffer().mOpen;
+
+   // The innermost task of that description begun on this thread
+   auto iter = std::find_if(open.rbegin(), open.rend(),
+      [&](const ThreadBuffer::Event &event){
+         return strcmp(event.name, taskDescription) == 0; });
+   if (iter == open.rend())
+      return;
+
+   Record(iter->name, iter->begin, now, Allocations() - iter->allocations);
+   open.erase(std::next(iter).base());
+}
+
+void Profiler::Record(const char* name, long long begin, long long end,
+                      unsigned long long allocations)
+{
+   auto &buffer = GetThreadBuffer();
+   buffer.mAllocations.store(Allocations(), std::memory_order_relaxed);
+   buffer.mAllocatedBytes.store(AllocatedBytes(), std::memory_order_relaxed);
+
+   const auto count = buffer.mCount.load(std::memory_order_relaxed);
+   if (count >= buffer.mEvents.size()) {
+      buffer.mDropped.store(
+         buffer.mDropped.load(std::memory_order_relaxed) + 1,
+         std::memory_order_relaxed);
+      return;
+   }
+
+   buffer.mEvents[count] = { name, begin, end, allocations };
+   buffer.mCount.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char* name)
 {
-   if(!mFileName)
+   if (!sEnabled)
+      return;
+
+   auto &buffer = GetThreadBuffer();
+   if (buffer.mNamed.load(std::memory_order_relaxed))
+      return;
+
+   strncpy(buffer.mName, name, sizeof(buffer.mName) - 1);
+   buffer.mNamed.store(true, std::memory_order_release);
+}
+
+Profiler::ThreadBuffer &Profiler::GetThreadBuffer()
+{
+   static thread_local ThreadBuffer *tBuffer = nullptr;
+   if (!tBuffer) {
+      // The only lock, once for each thread
+      ODLocker locker{ &mBuffersMutex };
+      mBuffers.push_back(
+         std::make_unique<ThreadBuffer>((int)mBuffers.size() + 1));
+      tBuffer = mBuffers.back().get();
+   }
+   return *tBuffer;
+}
+
+///Gets the singleton instance
+Profiler* Profiler::Instance()
+{
+   static Profiler pro;
+
+   return &pro;
+}
+
+///print the statistics of each task.  append to a log.
+void Profiler::WriteLog()
+{
+   // Durations in nanoseconds, and the allocations of all runs, by task
+   std::map<std::string, std::vector<long long>> tasks;
+   std::map<std::string, unsigned long long> allocations;
+   size_t dropped = 0;
+   for (const auto &pBuffer : mBuffers) {
+      const auto count = pBuffer->mCount.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; ++i) {
+         const auto &event = pBuffer->mEvents[i];
+         tasks[event.name].push_back(event.end - event.begin);
+         allocations[event.name] += event.allocations;
+      }
+      dropped += pBuffer->mDropped.load(std::memory_order_relaxed);
+   }
+
+   if (tasks.empty())
+      return;
+
+   FILE* log = fopen("AudacityProfilerLog.txt", "a");
+   if (!log)
+      return;
+
+   time_t now;
+
+   time(&now);
+   wxFprintf(log,"Audacity Profiler Run, Ended at ");
+   wxFprintf(log,"%s",ctime(&now));
+   wxFprintf(log,"****************************************\n");
+   //print out the tasks
+   size_t i = 0;
+   for (auto &task : tasks)
    {
-      mFileName.reinit( strlen(fileName) + 1 );
-      strcpy(mFileName.get(), fileName);
-      mDescription.reinit( strlen(taskDescription) + 1 );
-      strcpy(mDescription.get(), taskDescription);
-      mLine = lineNum;
+      auto &times = task.second;
+      std::sort(times.begin(), times.end());
+
+      long long total = 0;
+      for (auto time : times)
+         total += time;
+
+      // The time that the given fraction of the runs took at most
+      auto percentile = [&](double fraction) {
+         return times[ std::min(times.size() - 1,
+            (size_t)(fraction * times.size())) ] / 1e9;
+      };
+
+      wxFprintf(log,"Task: %s\n\n",task.first.c_str());
+      wxFprintf(log,"Number of times run: %d\n",(int)times.size());
+      wxFprintf(log,"Total run time (seconds): %f\n", total / 1e9);
+      wxFprintf(log,"Average run time (seconds): %f\n", total / 1e9 / times.size());
+      wxFprintf(log,"Median run time (seconds): %f\n", percentile(0.5));
+      wxFprintf(log,"90th percentile run time (seconds): %f\n", percentile(0.9));
+      wxFprintf(log,"99th percentile run time (seconds): %f\n", percentile(0.99));
+      wxFprintf(log,"Longest run time (seconds): %f\n", times.back() / 1e9);
+#ifdef TRACK_ALLOCATIONS
+      wxFprintf(log,"Average allocations per run: %f\n",
+                (double)allocations[task.first] / times.size());
+#endif
+
+      if(++i < tasks.size())
+         wxFprintf(log,"----------------------------\n");
    }
+   if (dropped > 0)
+      wxFprintf(log,"\n%d runs were not recorded, the buffers being full\n",(int)dropped);
 
-   mLastTime = clock();
+#ifdef TRACK_ALLOCATIONS
+   //print the allocations of each thread, as of its latest task
+   wxFprintf(log,"\nAllocations, by thread:\n");
+   for (const auto &pBuffer : mBuffers) {
+      const char* name = pBuffer->mNamed.load(std::memory_order_acquire)
+         ? pBuffer->mName : "";
+      wxFprintf(log,"%d %s: %llu allocations, %llu bytes\n",
+                pBuffer->mId, name,
+                pBuffer->mAllocations.load(std::memory_order_relaxed),
+                pBuffer->mAllocatedBytes.load(std::memory_order_relaxed));
+   }
+#endif
+
+   //print the reading and writing of block files, where there was any
+   const auto &stats = BlockIOStats::Program();
+   wxFprintf(log,"\nBlock files, by purpose:\n");
+   for (int p = 0; p < BlockIOStats::nPurposes; ++p) {
+      const auto purpose = BlockIOStats::Purpose(p);
+      bool any = false;
+      for (int c = 0; c < BlockIOStats::nCounters; ++c)
+         any = any || stats.Get(purpose, BlockIOStats::Counter(c)) > 0;
+      if (!any)
+         continue;
+      wxFprintf(log,"%s:",BlockIOStats::PurposeName(purpose));
+      for (int c = 0; c < BlockIOStats::nCounters; ++c) {
+         const auto counter = BlockIOStats::Counter(c);
+         wxFprintf(log," %s %llu",BlockIOStats::CounterName(counter),
+                   stats.Get(purpose, counter));
+      }
+      wxFprintf(log,"\n");
+   }
+   wxFprintf(log,"\n****************************************\n\n\n");
 
+   fclose(log);
 }
 
-///end the task timer.
-void TaskProfile::End(const char* WXUNUSED(fileName), int WXUNUSED(lineNum), const char* WXUNUSED(taskDescription))
+namespace {
+
+// Quote a string for JSON
+std::string Quote(const char* str)
 {
-   mCumTime += clock() - mLastTime;
-   mNumHits++;
+   std::string result{ "\"" };
+   for (; *str; ++str) {
+      const unsigned char c = *str;
+      if (c == '"' || c == '\\')
+         result += '\\', result += c;
+      else if (c < 0x20) {
+         char escape[8];
+         snprintf(escape, sizeof(escape), "\\u%04x", c);
+         result += escape;
+      }
+      else
+         result += c;
+   }
+   return result += '"';
+}
+
 }
 
-double TaskProfile::ComputeAverageRunTime()
+///write all tasks as complete events of the Chrome trace format, a
+///thread of the trace for each thread that recorded
+void Profiler::WriteTrace()
 {
-   if(mNumHits)
-      return (double) ((double)mCumTime/CLOCKS_PER_SEC)/mNumHits;
-   else
-      return 0.0;
+   if (mTracePath.empty())
+      return;
+
+   wxFFile file(mTracePath, wxT("w"));
+   if (!file.IsOpened())
+      return;
+   FILE* trace = file.fp();
+
+   // Times are in microseconds, from the earliest event
+   long long start = 0;
+   bool any = false;
+   for (const auto &pBuffer : mBuffers) {
+      const auto count = pBuffer->mCount.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; ++i) {
+         const auto begin = pBuffer->mEvents[i].begin;
+         if (!any || begin < start)
+            start = begin, any = true;
+      }
+   }
+
+   fprintf(trace, "{\"traceEvents\":[\n");
+   const char* separator = "";
+   for (const auto &pBuffer : mBuffers) {
+      const auto tid = pBuffer->mId;
+      if (pBuffer->mNamed.load(std::memory_order_acquire)) {
+         fprintf(trace,
+            "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":%s}}",
+            separator, tid, Quote(pBuffer->mName).c_str());
+         separator = ",\n";
+      }
+
+      const auto count = pBuffer->mCount.load(std::memory_order_acquire);
+      for (size_t i = 0; i < count; ++i) {
+         const auto &event = pBuffer->mEvents[i];
+         fprintf(trace,
+            "%s{\"name\":%s,\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+            "\"ts\":%.3f,\"dur\":%.3f",
+            separator, Quote(event.name).c_str(), tid,
+            (event.begin - start) / 1e3, (event.end - event.begin) / 1e3);
+#ifdef TRACK_ALLOCATIONS
+         fprintf(trace, ",\"args\":{\"allocations\":%llu}", event.allocations);
+#endif
+         fprintf(trace, "}");
+         separator = ",\n";
+      }
+   }
+   fprintf(trace, "\n],\n");
+
+   // The reading and writing of block files, as data of the whole trace
+   const auto &stats = BlockIOStats::Program();
+   fprintf(trace, "\"otherData\":{\"blockio\":{");
+   for (int p = 0; p < BlockIOStats::nPurposes; ++p) {
+      const auto purpose = BlockIOStats::Purpose(p);
+      fprintf(trace, "%s\"%s\":{", p ? "," : "",
+              BlockIOStats::PurposeName(purpose));
+      for (int c = 0; c < BlockIOStats::nCounters; ++c) {
+         const auto counter = BlockIOStats::Counter(c);
+         fprintf(trace, "%s\"%s\":%llu", c ? "," : "",
+                 BlockIOStats::CounterName(counter), stats.Get(purpose, counter));
+      }
+      fprintf(trace, "}");
+   }
+   fprintf(trace, "}}}\n");
 }
@@ -11,12 +11,23 @@
 ******************************************************************//**
 
 \class Profiler
-\brief A simple profiler to measure the average time lengths that a
-particular task/function takes.  Currently not thread-safe and not thread-smart,
-but it will probably work fine if you use it on a high level.
+\brief A profiler that records how long tasks take, on any thread, and
+at exit writes their statistics to a log and, if asked, a trace of all of
+them that Chrome's about:tracing or Perfetto shows on one timeline.
 
-\class TaskProfile
-\brief a simple class to keep track of one task that may be called multiple times.
+Each thread records into a buffer of its own, which no other thread
+writes, so that recording takes no lock.  Set the environment variable
+AUDACITY_PROFILE_TRACE to the path of the trace to write; the markers
+placed in the code record only then.
+
+Configured with --enable-allocation-tracking, which defines
+TRACK_ALLOCATIONS, the program counts the allocations of operator new on
+each thread, and the log adds those made during each task, and by each
+thread, so that the hot paths can be kept from allocating at all.
+
+\class ProfileScope
+\brief Records the time from its construction to its destruction, and
+the allocations made in it, when tracing is on.
 
 *//*******************************************************************/
 
@@ -26,66 +37,100 @@ but it will probably work fine if you use it on a high level.
 
 #ifndef __AUDACITY_PROFILER__
 #define __AUDACITY_PROFILER__
+#include "Audacity.h"
 #include "MemoryX.h"
 #include <vector>
-#include <time.h>
+#include <wx/string.h>
 #include "ondemand/ODTaskThread.h"
 
 
 #define BEGIN_TASK_PROFILING(TASK_DESCRIPTION) Profiler::Instance()->Begin(__FILE__,__LINE__,TASK_DESCRIPTION)
 #define END_TASK_PROFILING(TASK_DESCRIPTION) Profiler::Instance()->End(__FILE__,__LINE__,TASK_DESCRIPTION)
 
-class TaskProfile;
+// Times the rest of the enclosing block.  NAME must be a string literal,
+// or other string that lives as long as the program.
+#define PROFILE_SCOPE(NAME) ProfileScope profileScope{ NAME }
+
 class Profiler
 {
  public:
 
-   ///write to a profile at the end of the test.
+   ///write the log and the trace at the end of the test.
    virtual ~Profiler();
 
-   ///start the task timer.
+   ///start the task timer.  Tasks may nest, on each thread.
    void Begin(const char* fileName, int lineNum, const char* taskDescription);
    ///end the task timer.
    void End(const char* fileName, int lineNum, const char* taskDescription);
 
+   ///Record a task that ran on the calling thread from begin to end, as
+   ///Now() gives them, making the given number of allocations.  Takes no
+   ///lock, but at the first task of a thread.
+   void Record(const char* name, long long begin, long long end,
+               unsigned long long allocations = 0);
+
+   ///Name the calling thread in the trace.  Does nothing if tracing is off
+   ///or the thread is named already.
+   void SetThreadName(const char* name);
+
+   ///Whether the markers of the code record
+   static bool Enabled() { return sEnabled; }
+
+   ///Nanoseconds on a steady clock
+   static long long Now();
+
+   ///Allocations by operator new on the calling thread so far, and their
+   ///bytes; always 0 unless built with TRACK_ALLOCATIONS
+   static unsigned long long Allocations();
+   static unsigned long long AllocatedBytes();
+
    ///Gets the singleton instance
    static Profiler* Instance();
 
   protected:
    ///private constructor - Singleton.
-   Profiler(){};
+   Profiler();
+
+   class ThreadBuffer;
+   ThreadBuffer &GetThreadBuffer();
 
-   ///find a taskProfile for the given task, otherwise create
-   TaskProfile* GetOrCreateTaskProfile(const char* fileName, int lineNum);
-   TaskProfile* GetTaskProfileByDescription(const char* description);
+   void WriteLog();
+   void WriteTrace();
 
-   //List of current Task to do.
-   std::vector<movable_ptr<TaskProfile>> mTasks;
+   static bool sEnabled;
+
+   //Buffers of the threads that recorded
+   std::vector<std::unique_ptr<ThreadBuffer>> mBuffers;
    //mutex for above variable
-   ODLock mTasksMutex;
+   ODLock mBuffersMutex;
 
+   wxString mTracePath;
 };
 
- class TaskProfile
+class ProfileScope
+{
+ public:
+   explicit ProfileScope(const char* name)
+      : mName{ Profiler::Enabled() ? name : nullptr }
+      , mBegin{ mName ? Profiler::Now() : 0 }
+      , mAllocations{ mName ? Profiler::Allocations() : 0 }
+   {}
+
+   ~ProfileScope()
    {
-   public:
-      TaskProfile();
-      virtual ~TaskProfile();
-
-      ///start the task timer.
-      void Begin(const char* fileName, int lineNum, const char* taskDescription);
-      ///end the task timer.
-      void End(const char* fileName, int lineNum, const char* taskDescription);
-
-      double ComputeAverageRunTime();
-
-      ArrayOf<char> mFileName;
-      int mLine;
-      ArrayOf<char> mDescription;
-      int mNumHits;
-      clock_t mCumTime;
-      clock_t mLastTime;
-   };
+      if (mName)
+         Profiler::Instance()->Record(mName, mBegin, Profiler::Now(),
+            Profiler::Allocations() - mAllocations);
+   }
+
+   ProfileScope(const ProfileScope&) PROHIBITED;
+   ProfileScope &operator= (const ProfileScope&) PROHIBITED;
+
+ private:
+   const char* mName;
+   long long mBegin;
+   unsigned long long mAllocations;
+};
 
 
 #endif
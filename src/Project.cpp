@@ -54,6 +54,7 @@ scroll information.  It also has some status flags.
 
 #include <stdio.h>
 #include <iostream>
+#include <algorithm>
 #include <wx/wxprec.h>
 #include <wx/apptrait.h>
 
@@ -79,6 +80,7 @@ scroll information.  It also has some status flags.
 #include <wx/string.h>
 #include <wx/textfile.h>
 #include <wx/timer.h>
+#include <wx/evtloop.h>
 #include <wx/display.h>
 
 #if defined(__WXMAC__)
@@ -99,6 +101,9 @@ scroll information.  It also has some status flags.
 #include "import/Import.h"
 #include "Mix.h"
 #include "Prefs.h"
+#include "Profiler.h"
+#include "ProjectJournal.h"
+#include "ProjectManifest.h"
 #include "Sequence.h"
 #include "Snap.h"
 #include "TrackPanel.h"
@@ -115,15 +120,19 @@ scroll information.  It also has some status flags.
 #include "export/Export.h"
 #include "FileNames.h"
 #include "BlockFile.h"
+#include "blockfile/SimpleBlockFile.h"
 #include "ondemand/ODManager.h"
 #include "ondemand/ODTask.h"
 #include "ondemand/ODComputeSummaryTask.h"
+#include "ondemand/ODDecodeMP3Task.h"
+#include "ondemand/ODDecodeOggTask.h"
 
 #include "Theme.h"
 #include "AllThemeResources.h"
 
 #include "FileDialog.h"
 
+#include "TrackEditBatch.h"
 #include "UndoManager.h"
 
 #include "toolbars/ToolManager.h"
@@ -434,9 +443,10 @@ public:
             mProject->HandleResize(); // Adjust scrollers for NEW track sizes.
          } );
 
-         for (const auto &name : sortednames) {
-               mProject->Import(name);
-         }
+         if (sortednames.GetCount() > 1)
+            mProject->ImportBatch(sortednames);
+         else if (sortednames.GetCount() == 1)
+            mProject->Import(sortednames[0]);
 
          mProject->ZoomAfterImport(nullptr);
 
@@ -473,7 +483,8 @@ AudacityProject *CreateNewAudacityProject()
    // and then manually positioning it.
    p->SetPosition(wndRect.GetPosition());
 
-   if(bMaximized) {
+   // Maximizing would show it, on Windows
+   if(bMaximized && !wxGetApp().IsHeadless()) {
       p->Maximize(true);
    }
    else if (bIconized) {
@@ -491,7 +502,9 @@ AudacityProject *CreateNewAudacityProject()
    // and add the shortcut keys to the tooltips.
    p->GetToolManager()->RegenerateTooltips();
 
-   p->Show(true);
+   // Scripts drive a headless project; no one looks at it
+   if (!wxGetApp().IsHeadless())
+      p->Show(true);
 
    return p;
 }
@@ -802,7 +815,6 @@ BEGIN_EVENT_TABLE(AudacityProject, wxFrame)
    EVT_COMMAND_SCROLL_LINEDOWN(HSBarID, AudacityProject::OnScrollRightButton)
    EVT_COMMAND_SCROLL(HSBarID, AudacityProject::OnScroll)
    EVT_COMMAND_SCROLL(VSBarID, AudacityProject::OnScroll)
-   EVT_TIMER(AudacityProjectTimerID, AudacityProject::OnTimer)
    // Fires for menu with ID #1...first menu defined
    EVT_UPDATE_UI(1, AudacityProject::OnUpdateUI)
    EVT_ICONIZE(AudacityProject::OnIconize)
@@ -826,6 +838,9 @@ AudacityProject::AudacityProject(wxWindow * parent, wxWindowID id,
      mBandwidthSelectionFormatName(gPrefs->Read(wxT("/BandwidthSelectionFormatName"), wxT(""))),
      mUndoManager(std::make_unique<UndoManager>())
 {
+   // The phases of opening a window are timed under their own names too
+   PROFILE_SCOPE("AudacityProject::AudacityProject");
+
    mTracks = TrackList::Create();
 
    // Note that the first field of the status bar is a dummy, and it's width is set
@@ -884,11 +899,14 @@ AudacityProject::AudacityProject(wxWindow * parent, wxWindowID id,
    //
    // Create the horizontal ruler
    //
-   mRuler = safenew AdornedRulerPanel( this, mTopPanel,
-                                   wxID_ANY,
-                                   wxDefaultPosition,
-                                   wxSize( -1, AdornedRulerPanel::GetRulerHeight() ),
-                                   &mViewInfo );
+   {
+      PROFILE_SCOPE("AdornedRulerPanel::AdornedRulerPanel");
+      mRuler = safenew AdornedRulerPanel( this, mTopPanel,
+                                      wxID_ANY,
+                                      wxDefaultPosition,
+                                      wxSize( -1, AdornedRulerPanel::GetRulerHeight() ),
+                                      &mViewInfo );
+   }
 
    //
    // Create the TrackPanel and the scrollbars
@@ -932,15 +950,18 @@ AudacityProject::AudacityProject(wxWindow * parent, wxWindowID id,
 
    // The right hand side translates to NEW TrackPanel(...) in normal
    // Audacity without additional DLLs.
-   mTrackPanel = TrackPanel::FactoryFunction(pPage,
-                                             TrackPanelID,
-                                             wxDefaultPosition,
-                                             wxDefaultSize,
-                                             mTracks,
-                                             &mViewInfo,
-                                             this,
-                                             mRuler);
-   mTrackPanel->UpdatePrefs();
+   {
+      PROFILE_SCOPE("TrackPanel::TrackPanel");
+      mTrackPanel = TrackPanel::FactoryFunction(pPage,
+                                                TrackPanelID,
+                                                wxDefaultPosition,
+                                                wxDefaultSize,
+                                                mTracks,
+                                                &mViewInfo,
+                                                this,
+                                                mRuler);
+      mTrackPanel->UpdatePrefs();
+   }
 
    mIndicatorOverlay = std::make_unique<PlayIndicatorOverlay>(this);
 
@@ -1020,10 +1041,13 @@ AudacityProject::AudacityProject(wxWindow * parent, wxWindowID id,
    }
 
    // Lay it out
-   pPage->SetAutoLayout(true);
-   pPage->Layout();
+   {
+      PROFILE_SCOPE("AudacityProject::Layout");
+      pPage->SetAutoLayout(true);
+      pPage->Layout();
 
-   mMainPanel->Layout();
+      mMainPanel->Layout();
+   }
 
    wxASSERT( mTrackPanel->GetProject()==this);
 
@@ -1064,8 +1088,10 @@ AudacityProject::AudacityProject(wxWindow * parent, wxWindowID id,
    GetControlToolBar()->UpdateStatusBar(this);
    mLastStatusUpdateTime = ::wxGetUTCTime();
 
-   mTimer = std::make_unique<wxTimer>(this, AudacityProjectTimerID);
-   mTimer->Start(200);
+   mFrames = FrameClock::Get().Subscribe(200, [this]{
+      wxTimerEvent event;
+      OnTimer(event);
+   });
 
 #if wxUSE_DRAG_AND_DROP
    // We can import now, so become a drag target
@@ -1113,6 +1139,7 @@ AudioIOStartStreamOptions AudacityProject::GetDefaultPlayOptions()
 {
    AudioIOStartStreamOptions options { GetRate() };
    options.listener = this;
+   gPrefs->Read(wxT("/AudioIO/PlaybackSpeed"), &options.playbackSpeed, 1.0);
    return options;
 }
 
@@ -1160,6 +1187,18 @@ void AudacityProject::UpdatePrefs()
    if (mRuler) {
       mRuler->UpdatePrefs();
    }
+
+   if (mDirManager) {
+      DirManager::UpdateMappedFilesPrefs();
+      DirManager::UpdateAliasFilesPrefs();
+      DirManager::UpdateSummaryCachePrefs();
+      DirManager::UpdateBlockWriterPrefs();
+      DirManager::UpdateBlockReaperPrefs();
+      mDirManager->UpdateBlockCachePrefs();
+      mDirManager->UpdateBlockFormatPrefs();
+      mDirManager->UpdateBlockSizePrefs();
+      mDirManager->UpdateBlockCompactionPrefs();
+   }
 }
 
 void AudacityProject::SetMissingAliasFileDialog(wxDialog *dialog)
@@ -1671,18 +1710,9 @@ void AudacityProject::FixScrollbars()
 std::shared_ptr<Track> AudacityProject::GetFirstVisible()
 {
    std::shared_ptr<Track> pTrack;
-   if (GetTracks()) {
-      TrackListIterator iter(GetTracks());
-      for (Track *t = iter.First(); t; t = iter.Next()) {
-         int y = t->GetY();
-         int h = t->GetHeight();
-         if (y + h - 1 >= mViewInfo.vpos) {
-            // At least the bottom row of pixels is not scrolled away above
-            pTrack = Track::Pointer(t);
-            break;
-         }
-      }
-   }
+   if (GetTracks())
+      // At least the bottom row of pixels is not scrolled away above
+      pTrack = Track::Pointer(GetTracks()->FindTrackReaching(mViewInfo.vpos));
 
    return pTrack;
 }
@@ -1840,7 +1870,15 @@ void AudacityProject::OnShow(wxShowEvent & event)
 ///
 void AudacityProject::OnToolBarUpdate(wxCommandEvent & event)
 {
-   HandleResize();
+   // Showing, hiding or docking several bars, or loading a configuration,
+   // queues an event for each, but one resize after them all will do
+   if (!mToolBarUpdatePending) {
+      mToolBarUpdatePending = true;
+      CallAfter( [this]{
+         mToolBarUpdatePending = false;
+         HandleResize();
+      } );
+   }
 
    event.Skip(false);             /* No need to propagate any further */
 }
@@ -1896,7 +1934,7 @@ void AudacityProject::DoScroll()
    //SetActiveProject(this);
 
    if (!mAutoScrolling) {
-      mTrackPanel->Refresh(false);
+      mTrackPanel->RefreshAfterScroll();
    }
 
    CallAfter(
@@ -2200,8 +2238,8 @@ void AudacityProject::OnCloseWindow(wxCloseEvent & event)
    ShowFullScreen(false);
 #endif
 
-   // Stop the timer since there's no need to update anything anymore
-   mTimer.reset();
+   // Stop the ticks since there's no need to update anything anymore
+   mFrames.reset();
 
    // DMM: Save the size of the last window the user closes
    //
@@ -2290,6 +2328,9 @@ void AudacityProject::OnCloseWindow(wxCloseEvent & event)
    // references to the DirManager.
    GetUndoManager()->ClearStates();
 
+   // A clean close leaves no journal to recover
+   mJournal.reset();
+
    // MM: Tell the DirManager it can now DELETE itself
    // if it finds it is no longer needed. If it is still
    // used (f.e. by the clipboard), it will recognize this
@@ -2504,6 +2545,18 @@ void AudacityProject::EnqueueODTasks()
                   newTask = make_movable<ODComputeSummaryTask>();
                   createdODTasks= createdODTasks | ODTask::eODPCMSummary;
                }
+#ifdef USE_LIBMAD
+               else if(!(createdODTasks&ODTask::eODMP3) && (odFlags & ODTask::eODMP3)) {
+                  newTask = make_movable<ODDecodeMP3Task>();
+                  createdODTasks= createdODTasks | ODTask::eODMP3;
+               }
+#endif
+#ifdef USE_LIBVORBIS
+               else if(!(createdODTasks&ODTask::eODOGG) && (odFlags & ODTask::eODOGG)) {
+                  newTask = make_movable<ODDecodeOggTask>();
+                  createdODTasks= createdODTasks | ODTask::eODOGG;
+               }
+#endif
                else {
                   wxPrintf("unrecognized OD Flag in block file.\n");
                   //TODO:ODTODO: display to user.  This can happen when we build audacity on a system that doesnt have libFLAC
@@ -2528,12 +2581,113 @@ bool AudacityProject::Save()
    if ( !IsProjectSaved() )
       return SaveAs();
 
+   return WriteProjectFile();
+}
+
+bool AudacityProject::WriteProjectFile()
+{
+   wxString project = mFileName;
+   if (project.Len() > 4 && project.Mid(project.Len() - 4) == wxT(".aup"))
+      project = project.Mid(0, project.Len() - 4);
+   wxString projName = wxFileNameFromPath(project) + wxT("_data");
+   wxString projPath = wxPathOnly(project);
+
+   // The journal is in the old data directory, which may go away
+   mJournal.reset();
+
+   // Make the block files that a lazy open or a cut line left for later,
+   // so that SetProject() moves them with the rest
+   TrackListOfKindIterator iter(Track::Wave, GetTracks());
+   for (Track *t = iter.First(); t; t = iter.Next())
+      for (const WaveClip *clip : static_cast<WaveTrack*>(t)->GetAllClips())
+         clip->GetSequenceBlockArray();
+
+   if (!mDirManager->SetProject(projPath, projName, true)) {
+      AudacityMessageBox(wxString::Format(_("Could not save project. Path not found. Try creating \ndirectory \"%s\" before saving project with this name."),
+                                          projPath),
+                         _("Error Saving Project"),
+                         wxICON_ERROR, this);
+      return false;
+   }
+
+   wxString error;
+   if (!ProjectManifest::Write(mFileName, *GetTracks(), mRate,
+                               mDirManager->GetDataFilesDir(), error)) {
+      AudacityMessageBox(error, _("Error Saving Project"),
+                         wxICON_ERROR, this);
+      return false;
+   }
+
+   GetUndoManager()->StateSaved();
+   KeepSavedTracks();
+   return true;
+}
+
+void AudacityProject::KeepSavedTracks()
+{
+   // Blocks are shared with the tracks, not copied
+   auto saved = TrackList::Create();
+   for (auto t : *GetTracks())
+      saved->Add(t->Duplicate());
+
+   if (mLastSavedTracks)
+      mLastSavedTracks->Clear();
+   mLastSavedTracks = std::move(saved);
+}
+
+bool AudacityProject::OpenProjectFile(const wxString &fileName)
+{
+   if (IsAlreadyOpen(fileName))
+      return false;
+
+   // Only an untouched project can take the data directory of another
+   if (GetDirty() || !GetIsEmpty() || IsProjectSaved()) {
+      AudacityMessageBox(_("Open the saved project from a new, empty window."),
+                         _("Error Opening Project"), wxOK | wxICON_ERROR, this);
+      return false;
+   }
+
+   wxString projName = wxFileName{ fileName }.GetName() + wxT("_data");
+   wxString projPath = wxPathOnly(fileName);
+   if (!mDirManager->SetProject(projPath, projName, false)) {
+      AudacityMessageBox(wxString::Format(_("Couldn't find the project data folder: \"%s\""),
+                                          projName),
+                         _("Error Opening Project"), wxOK | wxICON_ERROR, this);
+      return false;
+   }
+
+   // A lazy open makes the block files of each clip only when it is
+   // first drawn, played or edited
+   const bool lazy = gPrefs->Read(wxT("/Directories/LazyProjectOpen"), true);
+   double rate;
+   size_t lostBlocks;
+   if (!ProjectManifest::Read(fileName, mDirManager, *GetTrackFactory(),
+                              *GetTracks(), rate, lazy, lostBlocks)) {
+      AudacityMessageBox(wxString::Format(_("Could not read the project file %s."),
+                                          fileName),
+                         _("Error Opening Project"), wxOK | wxICON_ERROR, this);
+      return false;
+   }
+
+   mFileName = fileName;
+   mbLoadedFromAup = true;
+   mRate = rate;
+   GetSelectionBar()->SetRate(mRate);
+   SetProjectTitle();
+   wxGetApp().AddFileToHistory(fileName);
+   InitialState();
+   KeepSavedTracks();
+
+   if (lostBlocks > 0)
+      AudacityMessageBox(wxString::Format(_("%llu blocks of audio were missing and have been replaced with silence."),
+                                          (unsigned long long)lostBlocks),
+                         _("Warning"), wxOK | wxICON_EXCLAMATION, this);
    return true;
 }
 
 std::vector< std::shared_ptr< Track > >
 AudacityProject::AddImportedTracks(const wxString &fileName,
-                                   TrackHolders &&newTracks)
+                                   TrackHolders &&newTracks, bool pushState)
 {
    std::vector< std::shared_ptr< Track > > results;
 
@@ -2572,8 +2726,9 @@ AudacityProject::AddImportedTracks(const wxString &fileName,
       GetSelectionBar()->SetRate(mRate);
    }
 
-   PushState(wxString::Format(_("Imported '%s'"), fileName),
-             _("Import"));
+   if (pushState)
+      PushState(wxString::Format(_("Imported '%s'"), fileName),
+                _("Import"));
 
 #if defined(__WXGTK__)
    // See bug #1224
@@ -2611,10 +2766,14 @@ void AudacityProject::ZoomAfterImport(Track *pTrack)
 }
 
 // If pNewTrackList is passed in non-NULL, it gets filled with the pointers to NEW tracks.
-bool AudacityProject::Import(const wxString &fileName, WaveTrackArray* pTrackArray /*= NULL*/)
+bool AudacityProject::Import(const wxString &fileName, WaveTrackArray* pTrackArray /*= NULL*/,
+                             bool pushState /*= true*/)
 {
 	// goal: I want this to function as the new "Open File"
 
+   if (ProjectManifest::IsManifest(fileName))
+      return OpenProjectFile(fileName);
+
    TrackHolders newTracks;
    wxString errorMessage = wxEmptyString;
 
@@ -2648,7 +2807,8 @@ bool AudacityProject::Import(const wxString &fileName, WaveTrackArray* pTrackArr
    }
 
    // PRL: Undo history is incremented inside this:
-   auto newSharedTracks = AddImportedTracks(fileName, std::move(newTracks));
+   auto newSharedTracks =
+      AddImportedTracks(fileName, std::move(newTracks), pushState);
 
    if (pTrackArray) {
       for (const auto &newTrack : newSharedTracks) {
@@ -2663,6 +2823,122 @@ bool AudacityProject::Import(const wxString &fileName, WaveTrackArray* pTrackArr
    return true;
 }
 
+void AudacityProject::ImportBatch(const wxArrayString &fileNames,
+                                  std::vector<WaveTrackArray> *pTrackArrays)
+{
+   auto &importer = Importer::Get();
+
+   // One item for each distinct name
+   Importer::BatchItems items;
+   std::vector<size_t> itemIndices;
+   for (const auto &fileName : fileNames) {
+      const auto found = std::find_if(items.begin(), items.end(),
+         [&](const movable_ptr<Importer::BatchItem> &item) {
+            return item->fileName == fileName;
+         });
+      itemIndices.push_back(found - items.begin());
+      if (found != items.end())
+         continue;
+
+      auto item = make_movable<Importer::BatchItem>();
+      item->fileName = fileName;
+      importer.OpenForBatch(*item);
+      items.push_back(std::move(item));
+   }
+
+   importer.ImportBatch(items, GetTrackFactory());
+
+   bool cancelled = false;
+   for (const auto &item : items)
+      if (item->progress.userChoice.load() ==
+          (unsigned) ProgressResult::Cancelled)
+         cancelled = true;
+
+   // Adds the tracks of an item, importing a file that the batch could not
+   // take as Import() would
+   const auto addItem = [&](Importer::BatchItem &item, WaveTrackArray &newTracks)
+   {
+      const auto &fileName = item.fileName;
+      const auto result = item.result;
+      if (item.handle) {
+         if ((result == ProgressResult::Success ||
+              result == ProgressResult::Stopped) && !item.tracks.empty()) {
+            wxGetApp().AddFileToHistory(fileName);
+            for (const auto &track :
+                 AddImportedTracks(fileName, std::move(item.tracks), false))
+               if (track->GetKind() == Track::Wave)
+                  newTracks.push_back(
+                     std::static_pointer_cast<WaveTrack>(track));
+            return true;
+         }
+         // Another plugin may yet understand the file
+         if (result != ProgressResult::Success &&
+             result != ProgressResult::Stopped)
+            return false;
+      }
+      else if (result == ProgressResult::Cancelled)
+         return false;
+
+      if (cancelled)
+         return false;
+      item.handle.reset();
+      return Import(fileName, &newTracks, false);
+   };
+
+   if (pTrackArrays) {
+      pTrackArrays->clear();
+      pTrackArrays->resize(fileNames.size());
+   }
+
+   // Add the tracks in the order of the files
+   wxString lastName;
+   int nImported = 0;
+   std::vector<bool> added(items.size(), false);
+   std::vector<WaveTrackArray> itemTracks(items.size());
+   for (size_t ii = 0; ii < fileNames.size(); ++ii) {
+      const auto &fileName = fileNames[ii];
+      const auto index = itemIndices[ii];
+      auto &tracks = itemTracks[index];
+      WaveTrackArray newTracks;
+
+      if (!added[index]) {
+         added[index] = true;
+         if (!addItem(*items[index], newTracks))
+            continue;
+         tracks = newTracks;
+      }
+      else {
+         // Named before; copy the tracks, which shares their blocks
+         if (tracks.empty())
+            continue;
+         TrackHolders copies;
+         for (const auto &track : tracks) {
+            copies.emplace_back();
+            copies.back() = std::unique_ptr<WaveTrack>{
+               static_cast<WaveTrack*>(track->Duplicate().release()) };
+         }
+         for (const auto &track :
+              AddImportedTracks(fileName, std::move(copies), false))
+            newTracks.push_back(std::static_pointer_cast<WaveTrack>(track));
+      }
+
+      lastName = fileName;
+      ++nImported;
+      if (pTrackArrays)
+         (*pTrackArrays)[ii] = std::move(newTracks);
+   }
+
+   if (nImported == 1)
+      PushState(wxString::Format(_("Imported '%s'"), lastName),
+                _("Import"));
+   else if (nImported > 1)
+      PushState(wxString::Format(_("Imported %d files"), nImported),
+                _("Import"));
+
+   // This is a no-fail:
+   GetDirManager()->FillBlockfilesCache();
+}
+
 bool AudacityProject::SaveAs(const wxString & newFileName, bool addToHistory /*= true*/)
 {
    // This version of SaveAs is invoked only from scripting and does not
@@ -2694,7 +2970,7 @@ bool AudacityProject::SaveAs(const wxString & newFileName, bool addToHistory /*=
    //Don't change the title, unless we succeed.
    //SetProjectTitle();
 
-   success = true;
+   success = WriteProjectFile();
 
    if (success && addToHistory) {
       wxGetApp().AddFileToHistory(mFileName);
@@ -2760,6 +3036,9 @@ void AudacityProject::PushState(const wxString &desc,
                                 const wxString &shortDesc,
                                 UndoPush flags )
 {
+   // Every edit of the contents of tracks ends in a push or a modify
+   GetTracks()->Touch();
+   gAudioIO->InvalidateLoopCache();
    GetUndoManager()->PushState(GetTracks(), mViewInfo.selectedRegion,
                           desc, shortDesc, flags);
 
@@ -2782,7 +3061,10 @@ void AudacityProject::PushState(const wxString &desc,
 
 void AudacityProject::ModifyState()
 {
+   GetTracks()->Touch();
+   gAudioIO->InvalidateLoopCache();
    GetUndoManager()->ModifyState(GetTracks(), mViewInfo.selectedRegion);
+   AutoSave();
    GetTrackPanel()->HandleCursorForPresentMouseState();
 }
 
@@ -2872,13 +3154,23 @@ void AudacityProject::Clear()
 
    Track *n = iter.First();
 
+   // Wave tracks are cleared together, on all cores
+   const double t0 = mViewInfo.selectedRegion.t0();
+   const double t1 = mViewInfo.selectedRegion.t1();
+   TrackEditBatch batch;
+
    while (n) {
       if (n->GetSelected()) {
-         n->Clear(mViewInfo.selectedRegion.t0(), mViewInfo.selectedRegion.t1());
+         if (n->GetKind() == Track::Wave)
+            batch.Add([=]{ n->Clear(t0, t1); });
+         else
+            n->Clear(t0, t1);
       }
       n = iter.Next();
    }
 
+   batch.Run();
+
    double seconds = mViewInfo.selectedRegion.duration();
 
    mViewInfo.selectedRegion.collapseToT0();
@@ -3022,12 +3314,19 @@ void AudacityProject::SetCaptureMeter(MeterPanel *capture)
 
 void AudacityProject::OnTimer(wxTimerEvent& WXUNUSED(event))
 {
+   CompactBlocks();
+
+   const bool recording =
+      GetAudioIOToken() > 0 && gAudioIO->GetNumCaptureChannels() > 0;
+   if (recording)
+      mDirManager->RefillRecordingSpace();
+
    if (::wxGetUTCTime() - mLastStatusUpdateTime < 3)
       return;
 
    // gAudioIO->GetNumCaptureChannels() should only be positive
    // when we are recording.
-   if (GetAudioIOToken() > 0 && gAudioIO->GetNumCaptureChannels() > 0) {
+   if (recording) {
       wxLongLong freeSpace = mDirManager->GetFreeDiskSpace();
       if (freeSpace >= 0) {
          wxString sMessage;
@@ -3059,12 +3358,20 @@ void AudacityProject::OnTimer(wxTimerEvent& WXUNUSED(event))
             mStatusBar->SetStatusText(msg, mainStatusBarField);
 
          }
-         else if(numTasks>1)
-            msg.Printf(_("Import(s) complete. Running %d on-demand waveform calculations. Overall %2.0f%% complete."),
-              numTasks,ratioComplete*100.0);
          else
-            msg.Printf(_("Import complete. Running an on-demand waveform calculation. %2.0f%% complete."),
-             ratioComplete*100.0);
+         {
+            if(numTasks>1)
+               msg.Printf(_("Import(s) complete. Running %d on-demand waveform calculations. Overall %2.0f%% complete."),
+                 numTasks,ratioComplete*100.0);
+            else
+               msg.Printf(_("Import complete. Running an on-demand waveform calculation. %2.0f%% complete."),
+                ratioComplete*100.0);
+
+            const double secondsLeft = ODManager::Instance()->GetOverallSecondsLeft();
+            if(secondsLeft >= 0)
+               msg += wxT(" ") + wxString::Format(_("About %s left."),
+                  ODManager::FormatSecondsLeft(secondsLeft));
+         }
 
 
          mStatusBar->SetStatusText(msg, mainStatusBarField);
@@ -3171,6 +3478,49 @@ void AudacityProject::GetPlayRegion(double* playRegionStart,
 
 void AudacityProject::AutoSave()
 {
+   if (!mJournal)
+      mJournal = std::make_unique<ProjectJournal>(mDirManager);
+   if (!mJournal->Record(*GetTracks()))
+      wxLogMessage(wxT("Could not write the journal of project %s"),
+                   GetName());
+}
+
+// Merge some runs of small blocks, left by many edits, while nothing else
+// is going on.  The samples are the same, so there is no NEW undo step; the
+// current one is made to share the merged blocks instead, so that the old
+// ones may go.
+void AudacityProject::CompactBlocks()
+{
+   const int level = mDirManager ? mDirManager->GetBlockCompactionLevel() : 0;
+   if (level <= 0 || mIsDeleting || mbBusyImporting || ::wxIsBusy() ||
+       gAudioIO->IsBusy() ||
+       (mTrackPanel && mTrackPanel->HasCapture()))
+      return;
+   // Not in the middle of some other command that yields
+   const auto loop = wxEventLoopBase::GetActive();
+   if (loop && loop->IsYielding())
+      return;
+
+   // Blocks shorter than a quarter, a half, or all of the maximum, and
+   // about so many merged per tick of the timer
+   const double fraction = level == 1 ? 0.25 : level == 2 ? 0.5 : 1.0;
+   const size_t maxBlocks = 4 << level;
+
+   const auto merged = GuardedCall<size_t>( [&] {
+      size_t merged = 0;
+      TrackListOfKindIterator iter(Track::Wave, GetTracks());
+      for (Track *t = iter.First(); t && merged < maxBlocks; t = iter.Next())
+         merged += static_cast<WaveTrack*>(t)
+            ->CompactBlocks(fraction, maxBlocks - merged);
+      return merged;
+   },
+      // Leave it for another time, as when the disk is full
+      SimpleGuard<size_t>{ 0 },
+      [](AudacityException *) {}
+   );
+
+   if (merged > 0)
+      GetUndoManager()->ModifyState(GetTracks(), mViewInfo.selectedRegion);
 }
 
 void AudacityProject::OnAudioIORate(int rate)
@@ -3195,6 +3545,13 @@ void AudacityProject::OnAudioIOStartRecording()
    // Before recording is started, auto-save the file. The file will have
    // empty tracks at the bottom where the recording will be put into
    AutoSave();
+
+   // Allocate the disk space of the first blocks now; OnTimer() keeps
+   // ahead of the recording
+   sampleFormat format = (sampleFormat)
+      gPrefs->Read(wxT("/SamplingRate/DefaultProjectSampleFormat"), floatSample);
+   mDirManager->ReserveRecordingSpace(
+      format, gAudioIO->GetNumCaptureChannels(), GetRate());
 }
 
 // This is called after recording has stopped and all tracks have flushed.
@@ -3214,10 +3571,20 @@ void AudacityProject::OnAudioIOStopRecording()
    // Write all cached files to disk, if any
    mDirManager->WriteCacheToDisk();
 
+   mDirManager->ReleaseRecordingSpace();
+
    // Now we auto-save again to get the project to a "normal" state again.
    AutoSave();
 }
 
+// This is called on the audio thread, while recording.
+void AudacityProject::OnAudioIOCheckpoint(const WaveTrackArray &captureTracks)
+{
+   // The journal was made when recording started
+   if (mJournal)
+      mJournal->Checkpoint(captureTracks);
+}
+
 int AudacityProject::GetSnapTo() const
 {
    return false;
@@ -3348,7 +3715,7 @@ bool AudacityProject::SaveFromTimerRecording(wxFileName fnFile) {
          mFileName = sOldFilename;
    } );
 
-   bSuccess = true;
+   bSuccess = WriteProjectFile();
 
    if (bSuccess) {
       wxGetApp().AddFileToHistory(mFileName);
@@ -3406,15 +3773,22 @@ int AudacityProject::GetEstimatedRecordingMinsLeftOnDisk(long lCaptureChannels)
       gPrefs->Read(wxT("/AudioIO/RecordChannels"), &lCaptureChannels, 2L);
    }
 
-   // Find out how much free space we have on disk
+   // Find out how much free space we have on disk, counting the space
+   // already set aside for the blocks of the recording
    wxLongLong lFreeSpace = mDirManager->GetFreeDiskSpace();
    if (lFreeSpace < 0) {
       return 0;
    }
+   lFreeSpace += mDirManager->GetReservedRecordingSpace();
 
-   // Calculate the remaining time
+   // Calculate the remaining time, with the headers and summaries of the
+   // block files
    double dRecTime = 0.0;
-   double bytesOnDiskPerSample = SAMPLE_SIZE_DISK(oCaptureFormat);
+   const size_t maxSamples =
+      mDirManager->GetMaxDiskBlockSize() / SAMPLE_SIZE(oCaptureFormat);
+   double bytesOnDiskPerSample =
+      (double)SimpleBlockFile::GetFileSize(maxSamples, oCaptureFormat) /
+      maxSamples;
    dRecTime = lFreeSpace.GetHi() * 4294967296.0 + lFreeSpace.GetLo();
    dRecTime /= bytesOnDiskPerSample;   
    dRecTime /= lCaptureChannels;
@@ -20,6 +20,7 @@
 
 #include "Audacity.h"
 #include "Experimental.h"
+#include "FrameClock.h"
 
 #include "widgets/OverlayPanel.h"
 
@@ -42,8 +43,6 @@
 
 #include "import/ImportRaw.h" // defines TrackHolders
 
-const int AudacityProjectTimerID = 5200;
-
 class wxWindow;
 class wxDialog;
 class wxBoxSizer;
@@ -80,6 +79,7 @@ class Regions;
 
 class LWSlider;
 class UndoManager;
+class ProjectJournal;
 enum class UndoPush : unsigned char;
 
 class Track;
@@ -227,18 +227,36 @@ private:
 
 public:
    // If pNewTrackList is passed in non-NULL, it gets filled with the pointers to NEW tracks.
-   bool Import(const wxString &fileName, WaveTrackArray *pTrackArray = NULL);
+   // If pushState is false, the caller pushes the undo state.
+   bool Import(const wxString &fileName, WaveTrackArray *pTrackArray = NULL,
+               bool pushState = true);
+
+   // Imports the files as the same number of calls to Import() would, and
+   // in their order, but decodes those whose importers allow it on worker
+   // threads at once; makes one undo state for all.  A file named more than
+   // once is decoded once, and its copies share its blocks.
+   // If pTrackArrays is passed in non-NULL, it gets the NEW tracks of each name.
+   void ImportBatch(const wxArrayString &fileNames,
+                    std::vector<WaveTrackArray> *pTrackArrays = NULL);
 
    void ZoomAfterImport(Track *pTrack);
 
    // Takes array of unique pointers; returns array of shared
    std::vector< std::shared_ptr<Track> >
    AddImportedTracks(const wxString &fileName,
-                     TrackHolders &&newTracks);
+                     TrackHolders &&newTracks, bool pushState = true);
 
    bool Save();
    bool SaveAs();
    bool SaveAs(const wxString & newFileName, bool addToHistory = true);
+private:
+   // Move the data files beside mFileName, and write it as a manifest
+   bool WriteProjectFile();
+   // Open a project that WriteProjectFile() saved into this empty one
+   bool OpenProjectFile(const wxString &fileName);
+   // Keep a copy of the tracks as saved, whose blocks are locked at close,
+   // so that their files outlive the project
+   void KeepSavedTracks();
 public:
 
    void Clear();
@@ -423,6 +441,7 @@ public:
    void OnAudioIORate(int rate) override;
    void OnAudioIOStartRecording() override;
    void OnAudioIOStopRecording() override;
+   void OnAudioIOCheckpoint(const WaveTrackArray &captureTracks) override;
 
    // Command Handling
    bool ReportIfActionNotAllowed
@@ -448,6 +467,7 @@ public:
    void PopState(const UndoState &state);
 
    void AutoSave();
+   void CompactBlocks();
 
    double GetZoomOfToFit();
    double GetZoomOfSelection();
@@ -498,6 +518,8 @@ public:
 private:
    // History/Undo manager
    std::unique_ptr<UndoManager> mUndoManager;
+   // Made at the first AutoSave(); its file is removed when the project closes
+   std::unique_ptr<ProjectJournal> mJournal;
    bool mDirty{ false };
 
    // Commands
@@ -505,10 +527,14 @@ private:
    CommandManager mCommandManager;
 
    CommandFlag mLastFlags;
+   CommandFlag mTrackFlags;
+   unsigned long mTrackFlagsGeneration{};
+   bool mTrackFlagsValid{ false };
 
    // Window elements
 
-   std::unique_ptr<wxTimer> mTimer;
+   // Calls OnTimer() five times a second
+   FrameClock::Subscription mFrames;
    long mLastStatusUpdateTime;
 
    wxStatusBar *mStatusBar;
@@ -533,6 +559,10 @@ private:
 
    bool mShownOnce{ false };
 
+   // An update of the toolbars is queued; any more before it runs are
+   // handled by the one
+   bool mToolBarUpdatePending{ false };
+
    // Project owned meters
    MeterPanel *mPlaybackMeter{};
    MeterPanel *mCaptureMeter{};
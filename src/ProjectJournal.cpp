@@ -0,0 +1,925 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectJournal.cpp
+
+*******************************************************************//**
+
+\class ProjectJournal
+\brief Appends the changes of each undo state to a file, from which
+the wave tracks can be rebuilt after a crash.
+
+AudacityProject::AutoSave() calls Record() after each PushState() or
+PopState().  Record() compares each clip with what it wrote last time:
+a clip whose sequence still shares its block array costs one pointer
+comparison, and a changed one writes only the blocks between the
+longest common prefix and suffix of its old and new block lists.
+
+The file is text, one record per line, fields separated by tabs:
+
+   T  track channel linked rate format pan mute name
+   C  track clips                 (number of clips; new ones are empty)
+   P  track clip offset
+   S  track clip at removed added (replace blocks; "B" lines follow)
+   B  kind length min max rms path
+      [start baseKind baseLength baseMin baseMax baseRms]
+                                  (for a slice, kind "v", of the block
+                                   at path)
+   O  track track ...             (the order; tracks not named are gone)
+   E                              (end of one call to Record())
+
+Replay() applies only what is followed by an "E", so a write torn by
+the crash loses the last state and no more.  Record() waits for the
+BlockWriter first, so every block file named is on disk.
+
+While recording, the audio thread calls Checkpoint() every few seconds
+(preference "/AudioIO/CheckpointSeconds").  That only shares the block
+arrays of the capture tracks; a thread of the journal's own waits for
+the BlockWriter and writes the differences, so that a crash loses at
+most the last few seconds and the samples not yet in a whole block.
+
+When the file grows to several times what a snapshot of the present
+state would take, a thread writes the snapshot to a NEW file, and
+the records made meanwhile are appended to it before it replaces the
+old one.
+
+Envelopes are not recorded, because nothing in the tracks changes
+them after a clip is made; nor are the cut lines of clips.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "ProjectJournal.h"
+
+#include <algorithm>
+
+#include <wx/dir.h>
+#include <wx/filename.h>
+#include <wx/intl.h>
+#include <wx/log.h>
+#include <wx/thread.h>
+#include <wx/tokenzr.h>
+
+#include "BlockFile.h"
+#include "DirManager.h"
+#include "Internat.h"
+#include "Project.h"
+#include "Sequence.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+#include "blockfile/BlockWriter.h"
+#include "blockfile/FLACBlockFile.h"
+#include "blockfile/ODDecodeBlockFile.h"
+#include "blockfile/SilentBlockFile.h"
+#include "blockfile/SimpleBlockFile.h"
+#include "blockfile/SliceBlockFile.h"
+#include "widgets/ErrorDialog.h"
+#include "wxFileNameWrapper.h"
+
+namespace {
+
+const wxChar *const Header = wxT("AudacityJournal\t1");
+
+// Don't bother compacting less than this
+const size_t MinCompactBytes = 1024 * 1024;
+
+std::string ToUTF8(const wxString &str)
+{
+   const auto buffer = str.ToUTF8();
+   return std::string(buffer.data(), buffer.length());
+}
+
+// Enough digits to read back the same value, whatever the locale
+wxString ToText(double value, int digits)
+{
+   auto result = wxString::Format(wxT("%.*g"), digits, value);
+   result.Replace(wxString(Internat::GetDecimalSeparator()), wxT("."));
+   return result;
+}
+
+// Names and paths may contain anything but the separators
+wxString Escape(const wxString &str)
+{
+   wxString result;
+   for (auto ch : str) {
+      if (ch == wxT('\\'))
+         result += wxT("\\\\");
+      else if (ch == wxT('\t'))
+         result += wxT("\\t");
+      else if (ch == wxT('\n'))
+         result += wxT("\\n");
+      else if (ch == wxT('\r'))
+         result += wxT("\\r");
+      else
+         result += ch;
+   }
+   return result;
+}
+
+wxString Unescape(const wxString &str)
+{
+   wxString result;
+   for (size_t ii = 0; ii < str.length(); ++ii) {
+      auto ch = str[ii];
+      if (ch == wxT('\\') && ii + 1 < str.length()) {
+         ch = str[++ii];
+         if (ch == wxT('t'))
+            ch = wxT('\t');
+         else if (ch == wxT('n'))
+            ch = wxT('\n');
+         else if (ch == wxT('r'))
+            ch = wxT('\r');
+      }
+      result += ch;
+   }
+   return result;
+}
+
+// The fields of a "T" record after the serial
+std::string MetaFields(const WaveTrack &track)
+{
+   return ToUTF8(wxString::Format(wxT("%d\t%d\t%s\t%d\t%s\t%d\t%s\n"),
+      track.GetChannel(),
+      (int)track.GetLinked(),
+      ToText(track.GetRate(), 17),
+      (int)track.GetSampleFormat(),
+      ToText(track.GetPan(), 9),
+      (int)track.GetMute(),
+      Escape(track.GetName())));
+}
+
+wxChar BlockKind(const BlockFile &file)
+{
+   // Only these kinds can be made again from their files alone
+   if (dynamic_cast<const SilentBlockFile*>(&file))
+      return wxT('z');
+   else if (dynamic_cast<const FLACBlockFile*>(&file))
+      return wxT('f');
+   else if (dynamic_cast<const SimpleBlockFile*>(&file) &&
+            !dynamic_cast<const ODDecodeBlockFile*>(&file))
+      return wxT('s');
+   else if (file.IsSlice())
+      return wxT('v');
+   return wxT('?');
+}
+
+wxString StatsText(const BlockFile &file)
+{
+   const auto stats = file.GetMinMaxRMS(false);
+   return wxString::Format(wxT("%llu\t%s\t%s\t%s"),
+      (unsigned long long)file.GetLength(),
+      ToText(stats.min, 9),
+      ToText(stats.max, 9),
+      ToText(stats.RMS, 9));
+}
+
+std::string BlockRecord(const BlockFile &file)
+{
+   const auto kind = BlockKind(file);
+   if (kind == wxT('v')) {
+      // A slice names its base's file, and all that is needed to make the
+      // base again, if no other record does
+      const auto &slice = static_cast<const SliceBlockFile&>(file);
+      const auto &base = *slice.GetBase();
+      return ToUTF8(wxString::Format(wxT("B\tv\t%s\t%s\t%llu\t%c\t%s\n"),
+         StatsText(file),
+         Escape(base.GetFileName().name.GetFullPath()),
+         (unsigned long long)slice.GetStart(),
+         BlockKind(base),
+         StatsText(base)));
+   }
+
+   wxString path;
+   if (kind != wxT('z'))
+      path = file.GetFileName().name.GetFullPath();
+
+   return ToUTF8(wxString::Format(wxT("B\t%c\t%s\t%s\n"),
+      kind,
+      StatsText(file),
+      Escape(path)));
+}
+
+std::string OrderRecord(const std::vector<long> &order)
+{
+   wxString result{ wxT("O") };
+   for (auto serial : order)
+      result += wxString::Format(wxT("\t%ld"), serial);
+   return ToUTF8(result + wxT("\n"));
+}
+
+// What Replay() rebuilds, before it makes tracks of it
+struct JournalBlock {
+   wxChar kind;
+   size_t len;
+   float min, max, rms;
+   wxString path;
+   // For slices, of the block at path
+   size_t start;
+   wxChar baseKind;
+   size_t baseLen;
+   float baseMin, baseMax, baseRms;
+};
+
+struct JournalClip {
+   double offset { 0.0 };
+   std::vector<JournalBlock> blocks;
+};
+
+struct JournalTrack {
+   int channel;
+   bool linked;
+   double rate;
+   sampleFormat format;
+   float pan;
+   bool mute;
+   wxString name;
+   std::vector<JournalClip> clips;
+};
+
+struct JournalState {
+   std::map<long, JournalTrack> tracks;
+   std::vector<long> order;
+
+   bool Apply(const std::vector<wxArrayString> &group);
+};
+
+bool ToDouble(const wxString &str, double &result)
+{
+   return Internat::CompatibleToDouble(str, &result);
+}
+
+bool ToFloat(const wxString &str, float &result)
+{
+   double value;
+   if (!ToDouble(str, value))
+      return false;
+   result = value;
+   return true;
+}
+
+bool JournalState::Apply(const std::vector<wxArrayString> &group)
+{
+   long serial, value;
+   unsigned long count;
+   for (size_t ii = 0; ii < group.size(); ++ii) {
+      const auto &fields = group[ii];
+      if (fields.empty())
+         return false;
+      const auto &type = fields[0];
+      if (type == wxT("O")) {
+         order.clear();
+         for (size_t jj = 1; jj < fields.size(); ++jj) {
+            if (!fields[jj].ToLong(&serial) || !tracks.count(serial))
+               return false;
+            order.push_back(serial);
+         }
+         // Tracks left out were removed
+         for (auto it = tracks.begin(); it != tracks.end();)
+            if (std::find(order.begin(), order.end(), it->first) == order.end())
+               it = tracks.erase(it);
+            else
+               ++it;
+         continue;
+      }
+
+      if (fields.size() < 3 || !fields[1].ToLong(&serial))
+         return false;
+
+      if (type == wxT("T")) {
+         if (fields.size() != 9)
+            return false;
+         auto &track = tracks[serial];
+         double pan;
+         if (!fields[2].ToLong(&value))
+            return false;
+         track.channel = value;
+         if (!fields[3].ToLong(&value))
+            return false;
+         track.linked = value != 0;
+         if (!ToDouble(fields[4], track.rate) ||
+             !fields[5].ToLong(&value))
+            return false;
+         track.format = (sampleFormat)value;
+         if (!ToDouble(fields[6], pan) || !fields[7].ToLong(&value))
+            return false;
+         track.pan = pan;
+         track.mute = value != 0;
+         track.name = Unescape(fields[8]);
+         continue;
+      }
+
+      auto found = tracks.find(serial);
+      if (found == tracks.end())
+         return false;
+      auto &clips = found->second.clips;
+
+      if (type == wxT("C")) {
+         if (!fields[2].ToULong(&count))
+            return false;
+         clips.resize(count);
+         continue;
+      }
+
+      if (fields.size() < 4 || !fields[2].ToULong(&count) ||
+          count >= clips.size())
+         return false;
+      auto &clip = clips[count];
+
+      if (type == wxT("P")) {
+         if (!ToDouble(fields[3], clip.offset))
+            return false;
+      }
+      else if (type == wxT("S")) {
+         unsigned long at, removed, added;
+         if (fields.size() != 6 ||
+             !fields[3].ToULong(&at) ||
+             !fields[4].ToULong(&removed) ||
+             !fields[5].ToULong(&added) ||
+             at + removed > clip.blocks.size() ||
+             ii + added >= group.size())
+            return false;
+
+         std::vector<JournalBlock> blocks;
+         for (unsigned long jj = 0; jj < added; ++jj) {
+            const auto &block = group[++ii];
+            JournalBlock b{};
+            unsigned long long len;
+            if (block.size() < 7 || block[0] != wxT("B") ||
+                block[1].length() != 1 ||
+                !block[2].ToULongLong(&len) ||
+                !ToFloat(block[3], b.min) ||
+                !ToFloat(block[4], b.max) ||
+                !ToFloat(block[5], b.rms))
+               return false;
+            b.kind = block[1][0];
+            b.len = len;
+            b.path = Unescape(block[6]);
+            if (b.kind == wxT('v')) {
+               unsigned long long start, baseLen;
+               if (block.size() != 13 ||
+                   !block[7].ToULongLong(&start) ||
+                   block[8].length() != 1 ||
+                   !block[9].ToULongLong(&baseLen) ||
+                   !ToFloat(block[10], b.baseMin) ||
+                   !ToFloat(block[11], b.baseMax) ||
+                   !ToFloat(block[12], b.baseRms) ||
+                   start > baseLen || len > baseLen - start)
+                  return false;
+               b.start = start;
+               b.baseKind = block[8][0];
+               b.baseLen = baseLen;
+            }
+            else if (block.size() != 7)
+               return false;
+            blocks.push_back(b);
+         }
+
+         auto where = clip.blocks.begin() + at;
+         where = clip.blocks.erase(where, where + removed);
+         clip.blocks.insert(where, blocks.begin(), blocks.end());
+      }
+      else
+         return false;
+   }
+   return true;
+}
+
+}
+
+//----------------------------------------------------------------------------
+// ProjectJournal::Compactor
+//----------------------------------------------------------------------------
+
+/// Writes a snapshot to a file, away from the main thread
+class ProjectJournal::Compactor final : public wxThread
+{
+public:
+   Compactor(const wxString &path, std::string &&snapshot)
+      : wxThread{ wxTHREAD_JOINABLE }
+      , mPath{ path }
+      , mSnapshot{ std::move(snapshot) }
+   {}
+
+   bool IsDone() const { return mDone.load(std::memory_order_acquire); }
+   bool Succeeded() const { return mSucceeded; }
+   size_t GetSize() const { return mSnapshot.size(); }
+
+protected:
+   ExitCode Entry() override
+   {
+      wxFFile file(mPath, wxT("wb"));
+      mSucceeded = file.IsOpened() &&
+         file.Write(mSnapshot.data(), mSnapshot.size()) == mSnapshot.size() &&
+         file.Flush() &&
+         file.Close();
+      mDone.store(true, std::memory_order_release);
+      return 0;
+   }
+
+private:
+   const wxString mPath;
+   const std::string mSnapshot;
+   bool mSucceeded { false };
+   std::atomic<bool> mDone { false };
+};
+
+//----------------------------------------------------------------------------
+// ProjectJournal::Checkpointer
+//----------------------------------------------------------------------------
+
+/// Writes the checkpoints of the audio thread
+class ProjectJournal::Checkpointer final : public wxThread
+{
+public:
+   Checkpointer(ProjectJournal &journal)
+      : wxThread{ wxTHREAD_JOINABLE }, mJournal{ journal }
+   {}
+
+protected:
+   ExitCode Entry() override
+   {
+      mJournal.RunCheckpoints();
+      return 0;
+   }
+
+private:
+   ProjectJournal &mJournal;
+};
+
+//----------------------------------------------------------------------------
+// ProjectJournal
+//----------------------------------------------------------------------------
+
+const wxChar *ProjectJournal::FileName()
+{
+   return wxT("journal.txt");
+}
+
+ProjectJournal::ProjectJournal(const std::shared_ptr<DirManager> &dirManager)
+   : mDirManager{ dirManager }
+{
+   const auto dir = mDirManager->GetDataFilesDir();
+   if (!wxDirExists(dir))
+      wxFileName::Mkdir(dir, 0777, wxPATH_MKDIR_FULL);
+   mPath = dir + wxFILE_SEP_PATH + FileName();
+
+   const auto header = ToUTF8(wxString{ Header } + wxT("\n"));
+   if (mFile.Open(mPath, wxT("wb")) &&
+       mFile.Write(header.data(), header.size()) == header.size())
+      mFileBytes = header.size();
+}
+
+ProjectJournal::~ProjectJournal()
+{
+   std::unique_ptr<Checkpointer> checkpointer;
+   {
+      ODLocker locker{ &mQueueLock };
+      // The thread writes what is pending before it sees this
+      mStopping = true;
+      mQueued.Signal();
+      checkpointer = std::move(mCheckpointer);
+   }
+   if (checkpointer)
+      checkpointer->Wait();
+
+   if (mCompactor) {
+      mCompactor->Wait();
+      mCompactor.reset();
+      wxRemoveFile(mPath + wxT(".new"));
+   }
+   if (mFile.IsOpened())
+      mFile.Close();
+   if (wxFileExists(mPath))
+      wxRemoveFile(mPath);
+}
+
+auto ProjectJournal::Capture(const WaveTrack &track) -> TrackCapture
+{
+   TrackCapture capture;
+   capture.id = track.GetId();
+   capture.meta = MetaFields(track);
+   for (const auto &clip : track.GetClips()) {
+      capture.offsets.push_back(clip->GetOffset());
+      capture.blocks.push_back(clip->GetSequence()->ShareBlockArray());
+   }
+   return capture;
+}
+
+void ProjectJournal::Compare(TrackState &state, TrackCapture &&capture,
+                             std::string &record)
+{
+   const auto serial = state.serial;
+   if (capture.meta != state.meta) {
+      record += ToUTF8(wxString::Format(wxT("T\t%ld\t"), serial));
+      record += capture.meta;
+      state.meta = std::move(capture.meta);
+   }
+
+   const auto nClips = capture.blocks.size();
+   if (nClips != state.clips.size()) {
+      record += ToUTF8(wxString::Format(wxT("C\t%ld\t%llu\n"),
+         serial, (unsigned long long)nClips));
+      state.clips.resize(nClips, ClipState{ 0.0, {}, {} });
+   }
+
+   for (size_t ii = 0; ii < nClips; ++ii) {
+      auto &clipState = state.clips[ii];
+
+      if (capture.offsets[ii] != clipState.offset) {
+         clipState.offset = capture.offsets[ii];
+         record += ToUTF8(wxString::Format(wxT("P\t%ld\t%llu\t%s\n"),
+            serial, (unsigned long long)ii,
+            ToText(clipState.offset, 17)));
+      }
+
+      auto &blocks = capture.blocks[ii];
+      if (blocks == clipState.blocks)
+         continue;
+
+      // Replace only what lies between the common prefix and suffix
+      static const BlockArray empty;
+      const auto &oldBlocks = clipState.blocks ? *clipState.blocks : empty;
+      const auto &newBlocks = *blocks;
+      const auto oldSize = oldBlocks.size(), newSize = newBlocks.size();
+      size_t prefix = 0;
+      while (prefix < std::min(oldSize, newSize) &&
+             oldBlocks[prefix].f == newBlocks[prefix].f)
+         ++prefix;
+      size_t suffix = 0;
+      while (suffix < std::min(oldSize, newSize) - prefix &&
+             oldBlocks[oldSize - 1 - suffix].f ==
+                newBlocks[newSize - 1 - suffix].f)
+         ++suffix;
+      const auto removed = oldSize - prefix - suffix;
+      const auto added = newSize - prefix - suffix;
+
+      if (removed || added) {
+         record += ToUTF8(wxString::Format(
+            wxT("S\t%ld\t%llu\t%llu\t%llu\t%llu\n"),
+            serial, (unsigned long long)ii,
+            (unsigned long long)prefix, (unsigned long long)removed,
+            (unsigned long long)added));
+
+         auto &lines = clipState.blockLines;
+         auto where = lines.begin() + prefix;
+         where = lines.erase(where, where + removed);
+         std::vector<std::string> newLines;
+         for (size_t jj = prefix; jj < prefix + added; ++jj) {
+            newLines.push_back(BlockRecord(*newBlocks[jj].f));
+            record += newLines.back();
+         }
+         lines.insert(where, newLines.begin(), newLines.end());
+      }
+
+      clipState.blocks = std::move(blocks);
+   }
+}
+
+bool ProjectJournal::Record(const TrackList &tracks)
+{
+   // Name no block before its file is on disk
+   DirManager::GetBlockWriter().Flush();
+
+   ODLocker locker{ &mLock };
+
+   std::string record;
+   TrackStates states;
+   std::vector<long> order;
+
+   TrackListConstIterator iter(&tracks);
+   for (auto t = iter.First(); t; t = iter.Next()) {
+      if (t->GetKind() != Track::Wave)
+         continue;
+      const auto track = static_cast<const WaveTrack*>(t);
+
+      TrackState state;
+      auto found = mStates.find(track->GetId());
+      if (found != mStates.end()) {
+         state = std::move(found->second);
+         mStates.erase(found);
+      }
+      else
+         state.serial = mNextSerial++;
+
+      Compare(state, Capture(*track), record);
+
+      order.push_back(state.serial);
+      states.emplace(track->GetId(), std::move(state));
+   }
+
+   if (order != mOrder) {
+      record += OrderRecord(order);
+      mOrder = order;
+   }
+
+   // What remains of the old states are removed tracks
+   mStates.swap(states);
+
+   return Write(std::move(record));
+}
+
+bool ProjectJournal::Write(std::string &&record)
+{
+   if (mCompactor && mCompactor->IsDone())
+      FinishCompaction();
+
+   if (!mFile.IsOpened())
+      return false;
+   if (record.empty())
+      return true;
+   record += "E\n";
+
+   if (mFile.Write(record.data(), record.size()) != record.size() ||
+       !mFile.Flush()) {
+      // Stop at the torn record, which Replay() leaves out
+      mFile.Close();
+      return false;
+   }
+   mFileBytes += record.size();
+
+   if (mCompactor)
+      mSinceSnapshot += record;
+   else if (mFileBytes > std::max(MinCompactBytes, 4 * mSnapshotBytes))
+      StartCompaction();
+
+   return true;
+}
+
+void ProjectJournal::Checkpoint(const WaveTrackArray &tracks)
+{
+   // Sharing the block arrays is all the work done on this thread
+   std::vector<TrackCapture> captures;
+   for (const auto &track : tracks)
+      captures.push_back(Capture(*track));
+
+   ODLocker locker{ &mQueueLock };
+   mCheckpoint.swap(captures);
+   mCheckpointPending = true;
+   mQueued.Signal();
+
+   if (!mCheckpointer) {
+      mCheckpointer = std::make_unique<Checkpointer>(*this);
+      if (mCheckpointer->Run() != wxTHREAD_NO_ERROR)
+         // Lose the checkpoint, rather than wait on the disk here
+         mCheckpointer.reset();
+   }
+}
+
+void ProjectJournal::RunCheckpoints()
+{
+   for (;;) {
+      std::vector<TrackCapture> captures;
+      {
+         ODLocker locker{ &mQueueLock };
+         while (!mCheckpointPending && !mStopping)
+            mQueued.Wait();
+         if (!mCheckpointPending)
+            break;
+         captures.swap(mCheckpoint);
+         mCheckpointPending = false;
+      }
+
+      DirManager::GetBlockWriter().Flush();
+      WriteCheckpoint(std::move(captures));
+   }
+}
+
+void ProjectJournal::WriteCheckpoint(std::vector<TrackCapture> &&captures)
+{
+   ODLocker locker{ &mLock };
+
+   std::string record;
+   bool added = false;
+   for (auto &capture : captures) {
+      auto found = mStates.find(capture.id);
+      if (found == mStates.end()) {
+         // A track the last Record() did not see goes last
+         TrackState state;
+         state.serial = mNextSerial++;
+         mOrder.push_back(state.serial);
+         found = mStates.emplace(capture.id, std::move(state)).first;
+         added = true;
+      }
+      Compare(found->second, std::move(capture), record);
+   }
+   if (added)
+      record += OrderRecord(mOrder);
+
+   Write(std::move(record));
+}
+
+std::string ProjectJournal::Snapshot(const TrackStates &states,
+                                     const std::vector<long> &order)
+{
+   std::string result = ToUTF8(wxString{ Header } + wxT("\n"));
+   for (const auto &pair : states) {
+      const auto &state = pair.second;
+      result += ToUTF8(wxString::Format(wxT("T\t%ld\t"), state.serial));
+      result += state.meta;
+      result += ToUTF8(wxString::Format(wxT("C\t%ld\t%llu\n"),
+         state.serial, (unsigned long long)state.clips.size()));
+      for (size_t ii = 0; ii < state.clips.size(); ++ii) {
+         const auto &clipState = state.clips[ii];
+         if (clipState.offset != 0.0)
+            result += ToUTF8(wxString::Format(wxT("P\t%ld\t%llu\t%s\n"),
+               state.serial, (unsigned long long)ii,
+               ToText(clipState.offset, 17)));
+         if (clipState.blockLines.empty())
+            continue;
+         result += ToUTF8(wxString::Format(wxT("S\t%ld\t%llu\t0\t0\t%llu\n"),
+            state.serial, (unsigned long long)ii,
+            (unsigned long long)clipState.blockLines.size()));
+         for (const auto &line : clipState.blockLines)
+            result += line;
+      }
+   }
+   result += OrderRecord(order);
+   result += "E\n";
+   return result;
+}
+
+void ProjectJournal::StartCompaction()
+{
+   mSinceSnapshot.clear();
+   mCompactor = std::make_unique<Compactor>(
+      mPath + wxT(".new"), Snapshot(mStates, mOrder));
+   if (mCompactor->Run() != wxTHREAD_NO_ERROR)
+      mCompactor.reset();
+}
+
+bool ProjectJournal::FinishCompaction()
+{
+   mCompactor->Wait();
+   const auto snapshotBytes = mCompactor->GetSize();
+   bool success = mCompactor->Succeeded();
+   mCompactor.reset();
+
+   const auto newPath = mPath + wxT(".new");
+   if (success) {
+      wxFFile file(newPath, wxT("ab"));
+      success = file.IsOpened() &&
+         file.Write(mSinceSnapshot.data(), mSinceSnapshot.size()) ==
+            mSinceSnapshot.size() &&
+         file.Flush() &&
+         file.Close();
+   }
+
+   if (success) {
+      mFile.Close();
+      success = wxRenameFile(newPath, mPath, true);
+      // If the rename failed, the old journal is still whole
+      mFile.Open(mPath, wxT("ab"));
+   }
+
+   if (success) {
+      mSnapshotBytes = snapshotBytes;
+      mFileBytes = snapshotBytes + mSinceSnapshot.size();
+   }
+   else {
+      wxRemoveFile(newPath);
+      // Don't try again until the journal grows as much again
+      mSnapshotBytes = mFileBytes / 4;
+   }
+   mSinceSnapshot.clear();
+   return success;
+}
+
+bool ProjectJournal::Replay(const wxString &path, DirManager &dirManager,
+                            TrackFactory &factory, TrackList &tracks,
+                            size_t &lostBlocks)
+{
+   lostBlocks = 0;
+
+   wxString contents;
+   {
+      wxFFile file(path, wxT("rb"));
+      if (!file.IsOpened() || !file.ReadAll(&contents, wxConvUTF8))
+         return false;
+   }
+   // A line without its newline was torn by the crash
+   contents.Truncate(contents.rfind(wxT('\n')) + 1);
+
+   JournalState state;
+   std::vector<wxArrayString> group;
+   wxStringTokenizer lines(contents, wxT("\n"), wxTOKEN_RET_EMPTY);
+   if (!lines.HasMoreTokens() || lines.GetNextToken() != Header)
+      return false;
+   while (lines.HasMoreTokens()) {
+      const auto line = lines.GetNextToken();
+      if (line == wxT("E")) {
+         if (!state.Apply(group))
+            return false;
+         group.clear();
+      }
+      else
+         group.push_back(wxSplit(line, wxT('\t'), 0));
+   }
+   // The lines of an unfinished record are left out
+
+   // Blocks shared among clips must stay shared, or the first to go
+   // would delete the file under the others
+   std::map<wxString, BlockFilePtr> files;
+   auto findFile = [&](wxChar kind, size_t len,
+                       float min, float max, float rms,
+                       const wxString &path) -> BlockFilePtr {
+      if (kind != wxT('s') && kind != wxT('f'))
+         return {};
+      auto &file = files[path];
+      if (!file && wxFileExists(path)) {
+         wxFileNameWrapper fileName{ wxFileName{ path } };
+         if (kind == wxT('s'))
+            file = std::make_shared<SimpleBlockFile>(
+               std::move(fileName), len, min, max, rms);
+         else
+            file = std::make_shared<FLACBlockFile>(
+               std::move(fileName), len, min, max, rms);
+      }
+      if (file)
+         return dirManager.CopyBlockFile(file);
+      return {};
+   };
+   auto makeFile = [&](const JournalBlock &block) -> BlockFilePtr {
+      if (block.kind == wxT('v')) {
+         if (auto base = findFile(block.baseKind, block.baseLen,
+               block.baseMin, block.baseMax, block.baseRms, block.path))
+            return std::make_shared<SliceBlockFile>(base,
+               block.start, block.len, block.min, block.max, block.rms);
+      }
+      else if (auto file = findFile(block.kind, block.len,
+               block.min, block.max, block.rms, block.path))
+         return file;
+      if (block.kind != wxT('z'))
+         ++lostBlocks;
+      return std::make_shared<SilentBlockFile>(block.len);
+   };
+
+   for (auto serial : state.order) {
+      const auto &journalTrack = state.tracks[serial];
+      auto track = factory.NewWaveTrack(journalTrack.format, journalTrack.rate);
+      track->SetName(journalTrack.name);
+      track->SetChannel(journalTrack.channel);
+      track->SetLinked(journalTrack.linked);
+      track->SetPan(journalTrack.pan);
+      track->SetMute(journalTrack.mute);
+      for (const auto &journalClip : journalTrack.clips) {
+         const auto clip = track->CreateClip();
+         clip->SetOffset(journalClip.offset);
+         for (const auto &block : journalClip.blocks)
+            clip->GetSequence()->AppendBlockFile(makeFile(block));
+         clip->MarkChanged();
+      }
+      tracks.Add(std::move(track));
+   }
+
+   return true;
+}
+
+void ProjectJournal::RecoverOrphans(AudacityProject &project)
+{
+   const auto &tempDir = DirManager::GetTempDir();
+   const auto ownDir = project.GetDirManager()->GetDataFilesDir();
+   wxArrayString paths;
+   {
+      wxDir dir;
+      if (tempDir.empty() || !wxDirExists(tempDir) || !dir.Open(tempDir))
+         return;
+      wxString name;
+      for (bool more = dir.GetFirst(&name, wxT("project*"), wxDIR_DIRS);
+           more; more = dir.GetNext(&name)) {
+         const auto dirPath = tempDir + wxFILE_SEP_PATH + name;
+         const auto path = dirPath + wxFILE_SEP_PATH + FileName();
+         if (dirPath != ownDir && wxFileExists(path))
+            paths.Add(path);
+      }
+   }
+   if (paths.empty())
+      return;
+
+   if (AudacityMessageBox(
+         _("Audacity did not close properly the last time.\n\nRecover the audio that was open then?"),
+         _("Recover Audio"), wxYES_NO | wxICON_QUESTION) != wxYES)
+      return;
+
+   size_t lost = 0;
+   bool failed = false;
+   for (const auto &path : paths) {
+      size_t lostBlocks;
+      if (Replay(path, *project.GetDirManager(), *project.GetTrackFactory(),
+                 *project.GetTracks(), lostBlocks))
+         wxRemoveFile(path);
+      else
+         failed = true;
+      lost += lostBlocks;
+   }
+
+   project.PushState(_("Recovered audio"), _("Recover"));
+   project.RedrawProject();
+
+   if (failed)
+      AudacityMessageBox(_("Some of the audio could not be recovered, because its journal is damaged."));
+   else if (lost > 0)
+      AudacityMessageBox(wxString::Format(
+         _("%llu blocks of audio were missing and have been replaced with silence."),
+         (unsigned long long)lost));
+}
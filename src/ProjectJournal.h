@@ -0,0 +1,138 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectJournal.h
+
+  Records the changes to the wave tracks of a project, one undo state
+  at a time, in a file that is only ever appended to, so that a
+  project can be recovered after a crash by replaying the file.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PROJECT_JOURNAL__
+#define __AUDACITY_PROJECT_JOURNAL__
+
+#include "MemoryX.h"
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <wx/ffile.h>
+#include <wx/string.h>
+
+#include "Track.h"
+#include "ondemand/ODTaskThread.h"
+
+class AudacityProject;
+class BlockArray;
+class DirManager;
+class TrackFactory;
+class TrackList;
+class WaveTrack;
+
+class ProjectJournal final
+{
+ public:
+   /// The journal lives in the data directory of dirManager, which must
+   /// outlive it
+   explicit ProjectJournal(const std::shared_ptr<DirManager> &dirManager);
+   /// Removes the file:  a journal left behind means a crash
+   ~ProjectJournal();
+
+   ProjectJournal(const ProjectJournal&) PROHIBITED;
+   ProjectJournal &operator= (const ProjectJournal&) PROHIBITED;
+
+   /// Append what changed in tracks since the last call.  Clips whose
+   /// block arrays are still shared with the last call cost nothing.
+   /// Returns false if the file could not be written.
+   bool Record(const TrackList &tracks);
+
+   /// Like Record(), for these tracks alone, but returns at once:  a
+   /// thread of the journal's own writes the record.  The audio thread
+   /// calls this while recording.  A checkpoint not yet written gives way
+   /// to a newer one.
+   void Checkpoint(const WaveTrackArray &tracks);
+
+   /// Rebuild the wave tracks a journal describes, adding them to
+   /// tracks.  Blocks whose files are gone, or of kinds that can't be
+   /// reopened, come back as silence and are counted in lostBlocks.
+   static bool Replay(const wxString &path, DirManager &dirManager,
+                      TrackFactory &factory, TrackList &tracks,
+                      size_t &lostBlocks);
+
+   /// Offer to recover the journals that crashed sessions left in the
+   /// temporary directory, into project
+   static void RecoverOrphans(AudacityProject &project);
+
+   static const wxChar *FileName();
+
+ private:
+   struct ClipState {
+      double offset;
+      std::shared_ptr<const BlockArray> blocks;
+      std::vector<std::string> blockLines;  // one "B" record per block
+   };
+
+   struct TrackState {
+      long serial;
+      std::string meta;  // the fields of its "T" record after the serial
+      std::vector<ClipState> clips;
+   };
+
+   using TrackStates = std::map<TrackId, TrackState>;
+
+   // What a track is now, taken without touching the disk
+   struct TrackCapture {
+      TrackId id;
+      std::string meta;
+      std::vector<double> offsets;
+      std::vector<std::shared_ptr<const BlockArray>> blocks;
+   };
+
+   static TrackCapture Capture(const WaveTrack &track);
+   // Append to record what changed from state to capture, and update state
+   static void Compare(TrackState &state, TrackCapture &&capture,
+                       std::string &record);
+   bool Write(std::string &&record);
+
+   class Checkpointer;
+   void RunCheckpoints();
+   void WriteCheckpoint(std::vector<TrackCapture> &&captures);
+
+   void StartCompaction();
+   bool FinishCompaction();
+   static std::string Snapshot(const TrackStates &states,
+                               const std::vector<long> &order);
+
+   class Compactor;
+
+   // Guards all below but the checkpoint queue
+   ODLock mLock;
+
+   std::shared_ptr<DirManager> mDirManager;
+   wxString mPath;
+   wxFFile mFile;
+
+   TrackStates mStates;
+   std::vector<long> mOrder;
+   long mNextSerial { 0 };
+
+   size_t mFileBytes { 0 };
+   size_t mSnapshotBytes { 0 };
+
+   // Records made while a compaction runs, to append to its snapshot
+   std::unique_ptr<Compactor> mCompactor;
+   std::string mSinceSnapshot;
+
+   ODLock mQueueLock;
+   ODCondition mQueued { &mQueueLock };
+   std::vector<TrackCapture> mCheckpoint;
+   bool mCheckpointPending { false };
+   bool mStopping { false };
+   std::unique_ptr<Checkpointer> mCheckpointer;
+};
+
+#endif
@@ -0,0 +1,690 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectManifest.cpp
+
+*******************************************************************//**
+
+\class ProjectManifest
+\brief Saves and opens projects as one binary file, without formatting
+or parsing a string per attribute.
+
+The file is a header, then sections, each a 4-byte tag, 4 reserved
+bytes and a 64-bit length, so that a reader can skip sections it does
+not know.  Numbers are in the byte order of the machine that wrote
+them, which the header records; a reader of the other order refuses
+the file.
+
+   STRS  every string, once:  a count, then a length and UTF-8 bytes
+         for each.  Others refer to strings by index.
+   PROJ  the project rate
+   BLKS  the block table:  a count, then one fixed-size record for each
+         distinct block file, of kind, directory, name, length, min,
+         max, rms, and for aliases the aliased file, start and channel;
+         for slices of blocks, the index of the base in the table in
+         place of the aliased directory, and the start in the base
+   TRKS  the wave tracks with their settings, and for each clip its
+         offset, envelope points, and indices into the block table
+
+Directories of block files are relative to the data directory, so that
+a project moved with its data directory still opens.  The file is
+written beside the old one and renamed over it.
+
+A lazy read makes the tracks and clips, but leaves each clip to make its
+block files when something first reads or changes its samples, from a
+block table that the clips share.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "ProjectManifest.h"
+
+#include <cstring>
+#include <functional>
+#include <map>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <wx/intl.h>
+#include <wx/log.h>
+
+#include "BlockFile.h"
+#include "DirManager.h"
+#include "Envelope.h"
+#include "Sequence.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+#include "blockfile/FLACBlockFile.h"
+#include "blockfile/PCMAliasBlockFile.h"
+#include "blockfile/SilentBlockFile.h"
+#include "blockfile/SimpleBlockFile.h"
+#include "blockfile/SliceBlockFile.h"
+#include "ondemand/ODTaskThread.h"
+#include "wxFileNameWrapper.h"
+
+namespace {
+
+const char Magic[8] = { 'A', 'u', 'd', 'P', 'r', 'o', 'j', '\x1a' };
+const uint32_t Version = 1;
+const uint32_t ByteOrderMark = 0x01020304;
+
+uint32_t Tag(const char (&name)[5])
+{
+   uint32_t result;
+   memcpy(&result, name, 4);
+   return result;
+}
+
+enum BlockKind : uint8_t {
+   kSilent, kSimple, kFLAC, kAlias, kSlice
+};
+
+const uint32_t NoString = ~uint32_t(0);
+
+// Appends numbers and strings to a buffer
+class ManifestWriter
+{
+public:
+   template<typename T> void Put(T value)
+   {
+      const auto at = mBuffer.size();
+      mBuffer.resize(at + sizeof(T));
+      memcpy(&mBuffer[at], &value, sizeof(T));
+   }
+
+   void PutBytes(const char *bytes, size_t len)
+   {
+      mBuffer.insert(mBuffer.end(), bytes, bytes + len);
+   }
+
+   void PutSection(const char (&tag)[5], const ManifestWriter &section)
+   {
+      Put(Tag(tag));
+      Put<uint32_t>(0);
+      Put<uint64_t>(section.mBuffer.size());
+      PutBytes(section.mBuffer.data(), section.mBuffer.size());
+   }
+
+   const std::vector<char> &GetBuffer() const { return mBuffer; }
+
+private:
+   std::vector<char> mBuffer;
+};
+
+// Reads what ManifestWriter wrote, checking bounds
+class ManifestReader
+{
+public:
+   ManifestReader(const char *begin, const char *end)
+      : mPos{ begin }, mEnd{ end }
+   {}
+
+   template<typename T> bool Get(T &value)
+   {
+      if (size_t(mEnd - mPos) < sizeof(T))
+         return false;
+      memcpy(&value, mPos, sizeof(T));
+      mPos += sizeof(T);
+      return true;
+   }
+
+   bool GetBytes(const char *&bytes, size_t len)
+   {
+      if (size_t(mEnd - mPos) < len)
+         return false;
+      bytes = mPos;
+      mPos += len;
+      return true;
+   }
+
+   bool AtEnd() const { return mPos == mEnd; }
+
+private:
+   const char *mPos;
+   const char *const mEnd;
+};
+
+// Gives each distinct string one index
+class StringTable
+{
+public:
+   uint32_t Intern(const wxString &str)
+   {
+      auto result = mIndices.emplace(str, mStrings.size());
+      if (result.second)
+         mStrings.push_back(str);
+      return result.first->second;
+   }
+
+   void Write(ManifestWriter &writer) const
+   {
+      writer.Put<uint32_t>(mStrings.size());
+      for (const auto &str : mStrings) {
+         const auto utf8 = str.ToUTF8();
+         writer.Put<uint32_t>(utf8.length());
+         writer.PutBytes(utf8.data(), utf8.length());
+      }
+   }
+
+private:
+   std::unordered_map<wxString, uint32_t> mIndices;
+   std::vector<wxString> mStrings;
+};
+
+wxString RelativeDir(const wxFileName &fileName, const wxString &dataDir)
+{
+   wxFileName dir{ fileName.GetPath(), wxEmptyString };
+   // Leaves the path absolute if it is on another volume
+   dir.MakeRelativeTo(dataDir);
+   return dir.GetPath(wxPATH_GET_VOLUME);
+}
+
+struct BlockRecord {
+   uint8_t kind;
+   uint32_t dir, name;
+   uint64_t len;
+   float min, max, rms;
+   uint32_t aliasDir, aliasName;
+   int64_t aliasStart;
+   int32_t aliasChannel;
+};
+
+bool GetBlockRecord(ManifestReader &reader, BlockRecord &record)
+{
+   return reader.Get(record.kind) &&
+      reader.Get(record.dir) &&
+      reader.Get(record.name) &&
+      reader.Get(record.len) &&
+      reader.Get(record.min) &&
+      reader.Get(record.max) &&
+      reader.Get(record.rms) &&
+      reader.Get(record.aliasDir) &&
+      reader.Get(record.aliasName) &&
+      reader.Get(record.aliasStart) &&
+      reader.Get(record.aliasChannel);
+}
+
+void PutBlockRecord(ManifestWriter &writer, const BlockRecord &record)
+{
+   writer.Put(record.kind);
+   writer.Put(record.dir);
+   writer.Put(record.name);
+   writer.Put(record.len);
+   writer.Put(record.min);
+   writer.Put(record.max);
+   writer.Put(record.rms);
+   writer.Put(record.aliasDir);
+   writer.Put(record.aliasName);
+   writer.Put(record.aliasStart);
+   writer.Put(record.aliasChannel);
+}
+
+// The block table of a manifest, making each block file when a clip
+// first needs it.  Clips opened lazily share it, and may need their
+// blocks on any thread.
+class BlockSource
+{
+public:
+   BlockSource(const std::shared_ptr<DirManager> &dirManager,
+               std::vector<wxString> &&strings,
+               std::vector<BlockRecord> &&records)
+      : mDirManager{ dirManager }
+      , mDataDir{ dirManager->GetDataFilesDir() }
+      , mStrings{ std::move(strings) }
+      , mRecords{ std::move(records) }
+      , mBlocks( mRecords.size() )
+   {}
+
+   size_t size() const { return mRecords.size(); }
+   bool GetString(uint32_t index, wxString &result) const
+   {
+      if (index >= mStrings.size())
+         return false;
+      result = mStrings[index];
+      return true;
+   }
+   sampleCount GetLength(uint32_t index) const
+   { return sampleCount{ (long long)mRecords[index].len }; }
+
+   // The string indices of the records must have been checked, and the
+   // bases of slices must come before them
+   BlockFilePtr Get(uint32_t index, size_t &lostBlocks)
+   {
+      const auto &record = mRecords[index];
+      BlockFilePtr base;
+      if (record.kind == kSlice)
+         base = Get(record.aliasDir, lostBlocks);
+
+      ODLocker locker{ &mLock };
+      auto &file = mBlocks[index];
+      if (!file)
+         file = base ? MakeSlice(record, base) : Make(record, lostBlocks);
+      return file;
+   }
+
+   BlockArray MakeArray(const std::vector<uint32_t> &indices,
+                        size_t &lostBlocks)
+   {
+      BlockArray result;
+      result.reserve(indices.size());
+      sampleCount start = 0;
+      for (auto index : indices) {
+         result.push_back(SeqBlock(Get(index, lostBlocks), start));
+         start += GetLength(index);
+      }
+      return result;
+   }
+
+private:
+   static BlockFilePtr MakeSlice
+      (const BlockRecord &record, const BlockFilePtr &base)
+   {
+      // A lost base was made silent, and so is what remains of it
+      if (base->IsSilent())
+         return std::make_shared<SilentBlockFile>(record.len);
+      return std::make_shared<SliceBlockFile>(base,
+         record.aliasStart, record.len, record.min, record.max, record.rms);
+   }
+
+   BlockFilePtr Make(const BlockRecord &record, size_t &lostBlocks)
+   {
+      if (record.kind == kSilent)
+         return std::make_shared<SilentBlockFile>(record.len);
+
+      wxFileName fileName{ mStrings[record.dir], mStrings[record.name] };
+      if (fileName.IsRelative())
+         fileName.MakeAbsolute(mDataDir);
+
+      BlockFilePtr file;
+      if (wxFileExists(fileName.GetFullPath())) {
+         wxFileNameWrapper wrapped{ fileName };
+         if (record.kind == kSimple)
+            file = std::make_shared<SimpleBlockFile>(std::move(wrapped),
+               record.len, record.min, record.max, record.rms);
+         else if (record.kind == kFLAC)
+            file = std::make_shared<FLACBlockFile>(std::move(wrapped),
+               record.len, record.min, record.max, record.rms);
+         else {
+            wxFileNameWrapper aliased{ wxFileName{
+               mStrings[record.aliasDir], mStrings[record.aliasName] } };
+            if (wxFileExists(aliased.GetFullPath()))
+               file = std::make_shared<PCMAliasBlockFile>(
+                  std::move(wrapped), std::move(aliased),
+                  sampleCount{ (long long)record.aliasStart }, record.len,
+                  record.aliasChannel,
+                  record.min, record.max, record.rms);
+         }
+      }
+
+      if (file)
+         return mDirManager->CopyBlockFile(file);
+      ++lostBlocks;
+      return std::make_shared<SilentBlockFile>(record.len);
+   }
+
+   const std::shared_ptr<DirManager> mDirManager;
+   const wxString mDataDir;
+   const std::vector<wxString> mStrings;
+   const std::vector<BlockRecord> mRecords;
+
+   // Blocks shared among clips are made once, and stay shared
+   ODLock mLock;
+   std::vector<BlockFilePtr> mBlocks;
+};
+
+}
+
+// static
+bool ProjectManifest::IsManifest(const wxString &path)
+{
+   wxFFile file(path, wxT("rb"));
+   char magic[sizeof Magic];
+   return file.IsOpened() &&
+      file.Read(magic, sizeof magic) == sizeof magic &&
+      memcmp(magic, Magic, sizeof Magic) == 0;
+}
+
+// static
+bool ProjectManifest::Write(const wxString &path, const TrackList &tracks,
+                            double rate, const wxString &dataDir,
+                            wxString &error)
+{
+   StringTable strings;
+   ManifestWriter blocks, trackSection;
+
+   // Blocks shared among clips are listed once, and stay shared
+   std::unordered_map<const BlockFile*, uint32_t> blockIndices;
+   uint32_t nBlocks = 0;
+   std::function<bool(const BlockFile &, uint32_t &)> blockIndex;
+   blockIndex = [&](const BlockFile &file, uint32_t &index) {
+      auto found = blockIndices.find(&file);
+      if (found != blockIndices.end()) {
+         index = found->second;
+         return true;
+      }
+
+      BlockRecord record{};
+      record.dir = record.name = record.aliasDir = record.aliasName = NoString;
+      record.len = file.GetLength();
+      const auto stats = file.GetMinMaxRMS(false);
+      record.min = stats.min, record.max = stats.max, record.rms = stats.RMS;
+
+      // Only these kinds can be made again from what is recorded here
+      const auto &type = typeid(file);
+      if (type == typeid(SilentBlockFile))
+         record.kind = kSilent;
+      else if (type == typeid(SimpleBlockFile))
+         record.kind = kSimple;
+      else if (type == typeid(FLACBlockFile))
+         record.kind = kFLAC;
+      else if (type == typeid(PCMAliasBlockFile)) {
+         const auto &alias = static_cast<const PCMAliasBlockFile&>(file);
+         record.kind = kAlias;
+         const auto &aliased = alias.GetAliasedFileName();
+         record.aliasDir = strings.Intern(aliased.GetPath());
+         record.aliasName = strings.Intern(aliased.GetFullName());
+         record.aliasStart = alias.GetAliasStart().as_long_long();
+         record.aliasChannel = alias.GetAliasChannel();
+      }
+      else if (type == typeid(SliceBlockFile)) {
+         // The base is listed first
+         const auto &slice = static_cast<const SliceBlockFile&>(file);
+         uint32_t baseIndex;
+         if (!blockIndex(*slice.GetBase(), baseIndex))
+            return false;
+         record.kind = kSlice;
+         record.aliasDir = baseIndex;
+         record.aliasStart = slice.GetStart();
+      }
+      else {
+         error = _("Some of the audio is still being loaded or is packed, and can't be saved yet.");
+         return false;
+      }
+
+      if (record.kind != kSilent && record.kind != kSlice) {
+         const auto fileName = file.GetFileName().name;
+         record.dir = strings.Intern(RelativeDir(fileName, dataDir));
+         record.name = strings.Intern(fileName.GetFullName());
+      }
+
+      PutBlockRecord(blocks, record);
+      index = nBlocks++;
+      blockIndices.emplace(&file, index);
+      return true;
+   };
+
+   uint32_t nTracks = 0;
+   TrackListConstIterator iter(&tracks);
+   for (auto t = iter.First(); t; t = iter.Next()) {
+      if (t->GetKind() != Track::Wave)
+         continue;
+      const auto track = static_cast<const WaveTrack*>(t);
+      ++nTracks;
+
+      trackSection.Put(strings.Intern(track->GetName()));
+      trackSection.Put<int32_t>(track->GetChannel());
+      trackSection.Put<uint8_t>(track->GetLinked());
+      trackSection.Put<uint8_t>(track->GetMute());
+      trackSection.Put<uint16_t>(0);
+      trackSection.Put<int32_t>(track->GetSampleFormat());
+      trackSection.Put<double>(track->GetRate());
+      trackSection.Put<float>(track->GetPan());
+
+      const auto &clips = track->GetClips();
+      trackSection.Put<uint32_t>(clips.size());
+      for (const auto &clip : clips) {
+         trackSection.Put<double>(clip->GetOffset());
+
+         const auto &points = clip->GetEnvelope()->GetPoints();
+         trackSection.Put<uint32_t>(points.size());
+         for (const auto &point : points) {
+            trackSection.Put<double>(point.GetT());
+            trackSection.Put<double>(point.GetVal());
+         }
+
+         const auto &blockArray = clip->GetSequence()->GetBlockArray();
+         trackSection.Put<uint32_t>(blockArray.size());
+         for (const auto &block : blockArray) {
+            uint32_t index;
+            if (!blockIndex(*block.f, index))
+               return false;
+            trackSection.Put(index);
+         }
+      }
+   }
+
+   ManifestWriter stringSection, blockSection, projectSection, trackTable;
+   strings.Write(stringSection);
+   projectSection.Put<double>(rate);
+   blockSection.Put<uint32_t>(nBlocks);
+   blockSection.PutBytes(blocks.GetBuffer().data(), blocks.GetBuffer().size());
+   trackTable.Put<uint32_t>(nTracks);
+   trackTable.PutBytes(
+      trackSection.GetBuffer().data(), trackSection.GetBuffer().size());
+
+   ManifestWriter whole;
+   whole.PutBytes(Magic, sizeof Magic);
+   whole.Put(Version);
+   whole.Put(ByteOrderMark);
+   whole.PutSection("STRS", stringSection);
+   whole.PutSection("PROJ", projectSection);
+   whole.PutSection("BLKS", blockSection);
+   whole.PutSection("TRKS", trackTable);
+
+   // Write beside the old file, then replace it, so that a failure
+   // leaves the old project whole
+   const auto &buffer = whole.GetBuffer();
+   const auto tempPath = path + wxT(".tmp");
+   bool success;
+   {
+      wxFFile file(tempPath, wxT("wb"));
+      success = file.IsOpened() &&
+         file.Write(buffer.data(), buffer.size()) == buffer.size() &&
+         file.Close();
+   }
+   if (success)
+      success = wxRenameFile(tempPath, path, true);
+   if (!success) {
+      wxRemoveFile(tempPath);
+      error = wxString::Format(_("Could not write the project file %s."), path);
+   }
+   return success;
+}
+
+// static
+bool ProjectManifest::Read(const wxString &path,
+                           const std::shared_ptr<DirManager> &dirManager,
+                           TrackFactory &factory, TrackList &tracks,
+                           double &rate, bool lazy, size_t &lostBlocks)
+{
+   lostBlocks = 0;
+
+   // The whole file, in one read
+   std::vector<char> buffer;
+   {
+      wxFFile file(path, wxT("rb"));
+      if (!file.IsOpened())
+         return false;
+      const auto length = file.Length();
+      if (length < 0)
+         return false;
+      buffer.resize(length);
+      if (file.Read(buffer.data(), buffer.size()) != buffer.size())
+         return false;
+   }
+
+   ManifestReader reader{ buffer.data(), buffer.data() + buffer.size() };
+   const char *magic;
+   uint32_t version, byteOrder;
+   if (!reader.GetBytes(magic, sizeof Magic) ||
+       memcmp(magic, Magic, sizeof Magic) != 0 ||
+       !reader.Get(version) || version != Version ||
+       !reader.Get(byteOrder) || byteOrder != ByteOrderMark)
+      return false;
+
+   // Find the sections
+   std::map<uint32_t, ManifestReader> sections;
+   while (!reader.AtEnd()) {
+      uint32_t tag, reserved;
+      uint64_t size;
+      const char *bytes;
+      if (!reader.Get(tag) || !reader.Get(reserved) || !reader.Get(size) ||
+          !reader.GetBytes(bytes, size))
+         return false;
+      sections.emplace(tag, ManifestReader{ bytes, bytes + size });
+   }
+   const auto section = [&](const char (&tag)[5]) -> ManifestReader* {
+      auto found = sections.find(Tag(tag));
+      return found == sections.end() ? nullptr : &found->second;
+   };
+
+   auto stringSection = section("STRS");
+   auto projectSection = section("PROJ");
+   auto blockSection = section("BLKS");
+   auto trackSection = section("TRKS");
+   if (!stringSection || !projectSection || !blockSection || !trackSection)
+      return false;
+
+   // Each string is converted once, however many refer to it
+   std::vector<wxString> strings;
+   uint32_t count;
+   if (!stringSection->Get(count))
+      return false;
+   strings.reserve(count);
+   for (uint32_t ii = 0; ii < count; ++ii) {
+      uint32_t len;
+      const char *bytes;
+      if (!stringSection->Get(len) || !stringSection->GetBytes(bytes, len))
+         return false;
+      strings.push_back(wxString::FromUTF8(bytes, len));
+   }
+
+   if (!projectSection->Get(rate))
+      return false;
+
+   std::vector<BlockRecord> records;
+   if (!blockSection->Get(count))
+      return false;
+   records.reserve(count);
+   for (uint32_t ii = 0; ii < count; ++ii) {
+      BlockRecord record;
+      if (!GetBlockRecord(*blockSection, record) || record.kind > kSlice)
+         return false;
+      const auto valid = [&](uint32_t index) { return index < strings.size(); };
+      if (record.kind == kSlice) {
+         // Of an earlier block, that is not itself a slice, and within it
+         if (record.aliasDir >= ii)
+            return false;
+         const auto &base = records[record.aliasDir];
+         if (!(base.kind == kSimple || base.kind == kFLAC) ||
+             record.aliasStart < 0 || record.len > base.len ||
+             uint64_t(record.aliasStart) > base.len - record.len)
+            return false;
+         records.push_back(record);
+         continue;
+      }
+      if (record.kind != kSilent &&
+          !(valid(record.dir) && valid(record.name)))
+         return false;
+      if (record.kind == kAlias &&
+          !(valid(record.aliasDir) && valid(record.aliasName)))
+         return false;
+      records.push_back(record);
+   }
+
+   const auto source = std::make_shared<BlockSource>(
+      dirManager, std::move(strings), std::move(records));
+   // Add no track unless all are read, and make no block file before then:
+   // an unlocked block file that goes away takes its file with it
+   std::vector<std::unique_ptr<WaveTrack>> newTracks;
+   std::vector<std::pair<Sequence*, std::vector<uint32_t>>> pending;
+   if (!trackSection->Get(count))
+      return false;
+   for (uint32_t ii = 0; ii < count; ++ii) {
+      uint32_t name, nClips;
+      int32_t channel, format;
+      uint8_t linked, mute;
+      uint16_t reserved;
+      double trackRate;
+      float pan;
+      wxString trackName;
+      if (!trackSection->Get(name) || !source->GetString(name, trackName) ||
+          !trackSection->Get(channel) ||
+          !trackSection->Get(linked) ||
+          !trackSection->Get(mute) ||
+          !trackSection->Get(reserved) ||
+          !trackSection->Get(format) ||
+          !trackSection->Get(trackRate) ||
+          !trackSection->Get(pan) ||
+          !trackSection->Get(nClips))
+         return false;
+
+      auto track = factory.NewWaveTrack((sampleFormat)format, trackRate);
+      track->SetName(trackName);
+      track->SetChannel(channel);
+      track->SetLinked(linked != 0);
+      track->SetMute(mute != 0);
+      track->SetPan(pan);
+
+      for (uint32_t jj = 0; jj < nClips; ++jj) {
+         double offset;
+         uint32_t nPoints, nClipBlocks;
+         if (!trackSection->Get(offset) || !trackSection->Get(nPoints))
+            return false;
+
+         const auto clip = track->CreateClip();
+         clip->SetOffset(offset);
+
+         EnvArray points;
+         points.reserve(nPoints);
+         for (uint32_t kk = 0; kk < nPoints; ++kk) {
+            double t, value;
+            if (!trackSection->Get(t) || !trackSection->Get(value))
+               return false;
+            points.emplace_back(t, value);
+         }
+         if (!points.empty())
+            clip->GetEnvelope()->SetPoints(std::move(points));
+
+         if (!trackSection->Get(nClipBlocks))
+            return false;
+         std::vector<uint32_t> indices(nClipBlocks);
+         sampleCount numSamples = 0;
+         for (auto &index : indices) {
+            if (!trackSection->Get(index) || index >= source->size())
+               return false;
+            numSamples += source->GetLength(index);
+         }
+
+         const auto sequence = clip->GetSequence();
+         if (lazy)
+            sequence->SetBlockLoader(
+               [source, indices = std::move(indices)]{
+                  size_t lost = 0;
+                  auto result = source->MakeArray(indices, lost);
+                  if (lost > 0)
+                     wxLogMessage(wxT("%llu blocks of audio were missing and have been replaced with silence."),
+                                  (unsigned long long)lost);
+                  return result;
+               },
+               numSamples);
+         else
+            pending.emplace_back(sequence, std::move(indices));
+         clip->MarkChanged();
+      }
+
+      newTracks.push_back(std::move(track));
+   }
+
+   for (const auto &pair : pending)
+      for (auto index : pair.second)
+         pair.first->AppendBlockFile(source->Get(index, lostBlocks));
+
+   for (auto &track : newTracks)
+      tracks.Add(std::move(track));
+   return true;
+}
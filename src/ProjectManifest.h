@@ -0,0 +1,43 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ProjectManifest.h
+
+  A compact binary description of the wave tracks of a project, and of
+  the block files they are made of, which loads with one read.
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PROJECT_MANIFEST__
+#define __AUDACITY_PROJECT_MANIFEST__
+
+#include "MemoryX.h"
+#include <wx/string.h>
+
+class DirManager;
+class TrackFactory;
+class TrackList;
+
+class ProjectManifest final
+{
+ public:
+   /// Whether the file begins as a manifest does
+   static bool IsManifest(const wxString &path);
+
+   /// Describe tracks, whose block files are in or under dataDir.  Fails,
+   /// with a message in error, if a block is of a kind it can't describe.
+   static bool Write(const wxString &path, const TrackList &tracks,
+                     double rate, const wxString &dataDir, wxString &error);
+
+   /// Add the wave tracks a manifest describes to tracks.  Blocks whose
+   /// files are gone come back as silence and are counted in lostBlocks.
+   /// If lazy, each clip makes its blocks only when first needed, and
+   /// missing files are logged then instead of counted.
+   static bool Read(const wxString &path,
+                    const std::shared_ptr<DirManager> &dirManager,
+                    TrackFactory &factory, TrackList &tracks,
+                    double &rate, bool lazy, size_t &lostBlocks);
+};
+
+#endif
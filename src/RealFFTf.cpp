@@ -0,0 +1,178 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   RealFFTf.cpp
+
+*******************************************************************//**
+
+\file RealFFTf.cpp
+\brief Fast Fourier transforms of real samples, for the spectrogram.
+
+A real transform of N points is a complex one of N / 2, of the even
+samples as the real parts and the odd as the imaginary, split apart
+afterwards.  The complex transform is radix 2, decimation in time, after
+a bit reversal by table.  From the passes of length 4 on, each does two
+butterflies at once in SSE2, where that is the baseline, as in
+VectorMath.cpp; elsewhere the same loop is scalar.
+
+The twiddle factors of all passes are made once for each length, in
+double precision, and laid out in the order the passes read them.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "RealFFTf.h"
+
+#include <cmath>
+#include <map>
+#include <mutex>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define REAL_FFTF_SSE2
+#endif
+
+FFTParam::FFTParam(size_t fftLen_)
+   : fftLen{ fftLen_ }
+   , points{ fftLen_ / 2 }
+   , bitReversed{ points }
+   , twiddles{ 2 * points }
+   , splitTwiddles{ points + 2 }
+{
+   wxASSERT(fftLen >= 4 && (fftLen & (fftLen - 1)) == 0);
+
+   unsigned bits = 0;
+   while ((size_t(1) << bits) < points)
+      ++bits;
+   for (size_t ii = 0; ii < points; ++ii) {
+      size_t reversed = 0;
+      for (unsigned bit = 0; bit < bits; ++bit)
+         if (ii & (size_t(1) << bit))
+            reversed |= size_t(1) << (bits - 1 - bit);
+      bitReversed[ii] = reversed;
+   }
+
+   auto *twiddle = twiddles.get();
+   for (size_t length = 4; length <= points; length *= 2)
+      for (size_t jj = 0; jj < length / 2; ++jj) {
+         const double angle = 2 * M_PI * jj / length;
+         *twiddle++ = cos(angle);
+         *twiddle++ = -sin(angle);
+      }
+
+   for (size_t kk = 0; kk <= points / 2; ++kk) {
+      const double angle = 2 * M_PI * kk / fftLen;
+      splitTwiddles[2 * kk] = cos(angle);
+      splitTwiddles[2 * kk + 1] = -sin(angle);
+   }
+}
+
+HFFT GetFFT(size_t fftLen)
+{
+   static std::mutex mutex;
+   static std::map<size_t, HFFT> params;
+
+   std::lock_guard<std::mutex> lock{ mutex };
+   auto &param = params[fftLen];
+   if (!param)
+      param = std::make_shared<FFTParam>(fftLen);
+   return param;
+}
+
+namespace {
+
+// In place, of param.points complex values, interleaved
+void ComplexFFT(float *zz, const FFTParam &param)
+{
+   const auto points = param.points;
+   for (size_t ii = 0; ii < points; ++ii) {
+      const auto jj = param.bitReversed[ii];
+      if (ii < jj) {
+         std::swap(zz[2 * ii], zz[2 * jj]);
+         std::swap(zz[2 * ii + 1], zz[2 * jj + 1]);
+      }
+   }
+
+   // Passes of length 2 need no twiddles
+   for (size_t ii = 0; ii < 2 * points; ii += 4) {
+      const float ar = zz[ii], ai = zz[ii + 1];
+      const float br = zz[ii + 2], bi = zz[ii + 3];
+      zz[ii] = ar + br, zz[ii + 1] = ai + bi;
+      zz[ii + 2] = ar - br, zz[ii + 3] = ai - bi;
+   }
+
+   const float *twiddle = param.twiddles.get();
+   for (size_t length = 4; length <= points; length *= 2) {
+      const auto half = length / 2;
+      for (size_t group = 0; group < points; group += length) {
+         float *aa = zz + 2 * group;
+         float *bb = aa + 2 * half;
+#ifdef REAL_FFTF_SSE2
+         const __m128 negateReal = _mm_castsi128_ps(
+            _mm_set_epi32(0, int(0x80000000), 0, int(0x80000000)));
+         for (size_t jj = 0; jj < 2 * half; jj += 4) {
+            const __m128 w = _mm_loadu_ps(twiddle + jj);
+            const __m128 b = _mm_loadu_ps(bb + jj);
+            // (br wr - bi wi, bi wr + br wi), for two butterflies
+            const __m128 wr = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2, 2, 0, 0));
+            const __m128 wi = _mm_shuffle_ps(w, w, _MM_SHUFFLE(3, 3, 1, 1));
+            const __m128 swapped = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 0, 1));
+            const __m128 t = _mm_add_ps(_mm_mul_ps(b, wr),
+               _mm_xor_ps(_mm_mul_ps(swapped, wi), negateReal));
+            const __m128 a = _mm_loadu_ps(aa + jj);
+            _mm_storeu_ps(aa + jj, _mm_add_ps(a, t));
+            _mm_storeu_ps(bb + jj, _mm_sub_ps(a, t));
+         }
+#else
+         for (size_t jj = 0; jj < 2 * half; jj += 2) {
+            const float wr = twiddle[jj], wi = twiddle[jj + 1];
+            const float tr = bb[jj] * wr - bb[jj + 1] * wi;
+            const float ti = bb[jj + 1] * wr + bb[jj] * wi;
+            const float ar = aa[jj], ai = aa[jj + 1];
+            aa[jj] = ar + tr, aa[jj + 1] = ai + ti;
+            bb[jj] = ar - tr, bb[jj + 1] = ai - ti;
+         }
+#endif
+      }
+      twiddle += 2 * half;
+   }
+}
+
+}
+
+void RealFFTf(float *buffer, const FFTParam &param)
+{
+   ComplexFFT(buffer, param);
+
+   // Split the transform of the even and odd samples, Z, into that of all,
+   // X: with A = Z[k] and B = conj(Z[M - k]), E = (A + B) / 2 and
+   // O = -i (A - B) / 2, X[k] = E + W^k O and X[M - k] = conj(E - W^k O)
+   const auto points = param.points;
+   const float dc = buffer[0], nyquist = buffer[1];
+   buffer[0] = dc + nyquist;
+   buffer[1] = dc - nyquist;
+   for (size_t kk = 1; kk <= points / 2; ++kk) {
+      float *low = buffer + 2 * kk, *high = buffer + 2 * (points - kk);
+      const float er = 0.5f * (low[0] + high[0]);
+      const float ei = 0.5f * (low[1] - high[1]);
+      const float orr = 0.5f * (low[1] + high[1]);
+      const float oi = -0.5f * (low[0] - high[0]);
+      const float wr = param.splitTwiddles[2 * kk];
+      const float wi = param.splitTwiddles[2 * kk + 1];
+      const float tr = orr * wr - oi * wi;
+      const float ti = orr * wi + oi * wr;
+      low[0] = er + tr, low[1] = ei + ti;
+      high[0] = er - tr, high[1] = ti - ei;
+   }
+}
+
+void PowerSpectrum(float *buffer, float *power, const FFTParam &param)
+{
+   RealFFTf(buffer, param);
+   power[0] = buffer[0] * buffer[0];
+   for (size_t kk = 1; kk < param.points; ++kk)
+      power[kk] = buffer[2 * kk] * buffer[2 * kk] +
+         buffer[2 * kk + 1] * buffer[2 * kk + 1];
+}
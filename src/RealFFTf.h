@@ -0,0 +1,47 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   RealFFTf.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_REAL_FFTF__
+#define __AUDACITY_REAL_FFTF__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+#include "SampleFormat.h"
+
+/// Tables for transforms of one length: the bit reversal, and the twiddle
+/// factors of each pass, one after another.  Made once for each length,
+/// and shared by all threads.
+struct FFTParam {
+   FFTParam(size_t fftLen);
+
+   /// Length of the real transform, a power of two, at least 4
+   size_t fftLen;
+   /// Half that: the complex transform that does the work
+   size_t points;
+   ArrayOf<size_t> bitReversed;
+   /// cos and -sin, interleaved, of each pass of length 4 and more
+   Floats twiddles;
+   /// The same, for the split of the complex result into the real one
+   Floats splitTwiddles;
+};
+
+using HFFT = std::shared_ptr<const FFTParam>;
+
+/// The tables for fftLen, made on first use; thread safe
+HFFT GetFFT(size_t fftLen);
+
+/// Transforms fftLen real samples in place, into fftLen / 2 + 1 complex
+/// values: buffer[0] is the DC, buffer[1] the Nyquist, and then the real
+/// and imaginary parts of each other frequency, in ascending order
+void RealFFTf(float *buffer, const FFTParam &param);
+
+/// Transforms fftLen real samples, destroying them, and puts the power of
+/// each of the first fftLen / 2 frequencies into power
+void PowerSpectrum(float *buffer, float *power, const FFTParam &param);
+
+#endif
@@ -0,0 +1,190 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   RealtimeChain.cpp
+
+*******************************************************************//**
+
+\class RealtimeChain
+\brief A gain and equalizer applied to played samples as they are mixed.
+
+AudioIO::FillBuffers() runs one chain for each playback track, after its
+mixer and before its ring buffer, and the chains of the master after
+those.  As every stage is linear and time invariant, the master may run
+on each track apart, where the callback would otherwise have to run it
+on the sum; the pan the callback applies later is only a factor, and
+changes nothing.
+
+The filters are biquads of the "Audio EQ Cookbook" of Robert
+Bristow-Johnson.  A change of the settings takes effect at the next
+buffer, with the gain gliding over that buffer to its new value, so
+that dragging a control does not click.
+
+\class RealtimeSettingsQueue
+\brief Passes RealtimeSettings to the audio thread, which takes them
+between buffers, without either thread waiting for the other.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "RealtimeChain.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+const double kBassHz = 250.0;
+const double kTrebleHz = 4000.0;
+
+enum Shape { LowShelf, Peak, HighShelf };
+
+// Coefficients normalized by a0, for a slope or Q of one
+void Design(double &b0, double &b1, double &b2, double &a1, double &a2,
+            Shape shape, double rate, double hz, double dB)
+{
+   hz = std::max(10.0, std::min(hz, 0.45 * rate));
+   const double A = std::pow(10.0, dB / 40.0);
+   const double w0 = 2.0 * kPi * hz / rate;
+   const double cosw = std::cos(w0);
+   const double sinw = std::sin(w0);
+   double a0;
+   if (shape == Peak) {
+      const double alpha = sinw / 2.0;
+      b0 = 1.0 + alpha * A;
+      b1 = -2.0 * cosw;
+      b2 = 1.0 - alpha * A;
+      a0 = 1.0 + alpha / A;
+      a1 = -2.0 * cosw;
+      a2 = 1.0 - alpha / A;
+   }
+   else {
+      const double twoSqrtAAlpha = std::sqrt(A) * sinw * std::sqrt(2.0);
+      const double sign = (shape == LowShelf) ? 1.0 : -1.0;
+      b0 = A * ((A + 1) - sign * (A - 1) * cosw + twoSqrtAAlpha);
+      b1 = sign * 2.0 * A * ((A - 1) - sign * (A + 1) * cosw);
+      b2 = A * ((A + 1) - sign * (A - 1) * cosw - twoSqrtAAlpha);
+      a0 = (A + 1) + sign * (A - 1) * cosw + twoSqrtAAlpha;
+      a1 = -sign * 2.0 * ((A - 1) + sign * (A + 1) * cosw);
+      a2 = (A + 1) + sign * (A - 1) * cosw - twoSqrtAAlpha;
+   }
+   b0 /= a0; b1 /= a0; b2 /= a0; a1 /= a0; a2 /= a0;
+}
+
+float TargetGain(const RealtimeSettings &settings)
+{
+   return settings.bypass
+      ? 1.0f
+      : (float)std::pow(10.0, settings.gainDB / 20.0);
+}
+
+}
+
+bool RealtimeSettings::IsNeutral() const
+{
+   return bypass ||
+      (gainDB == 0.0f && bassDB == 0.0f && midDB == 0.0f && trebleDB == 0.0f);
+}
+
+void RealtimeChain::Prepare(double rate, const RealtimeSettings &settings)
+{
+   mRate = rate;
+   mSettings = settings;
+   mActive = !settings.IsNeutral();
+   mGain = TargetGain(settings);
+   for (auto &filter : mFilters)
+      filter.z1 = filter.z2 = 0.0;
+   UpdateFilters();
+}
+
+void RealtimeChain::SetSettings(const RealtimeSettings &settings)
+{
+   const bool wasFiltered = mFiltered;
+   mSettings = settings;
+   mActive = !settings.IsNeutral();
+   UpdateFilters();
+   if (mFiltered && !wasFiltered)
+      // Don't resume from the state of long ago
+      for (auto &filter : mFilters)
+         filter.z1 = filter.z2 = 0.0;
+}
+
+void RealtimeChain::UpdateFilters()
+{
+   mFiltered = !mSettings.bypass &&
+      (mSettings.bassDB != 0.0f || mSettings.midDB != 0.0f ||
+       mSettings.trebleDB != 0.0f);
+   if (!mFiltered)
+      return;
+
+   const struct { Shape shape; double hz; double dB; } bands[] = {
+      { LowShelf, kBassHz, mSettings.bassDB },
+      { Peak, mSettings.midHz, mSettings.midDB },
+      { HighShelf, kTrebleHz, mSettings.trebleDB },
+   };
+   for (size_t ii = 0; ii < 3; ++ii) {
+      auto &filter = mFilters[ii];
+      Design(filter.b0, filter.b1, filter.b2, filter.a1, filter.a2,
+             bands[ii].shape, mRate, bands[ii].hz, bands[ii].dB);
+   }
+}
+
+bool RealtimeChain::IsIdle() const
+{
+   return !mActive && mGain == TargetGain(mSettings);
+}
+
+void RealtimeChain::Process(float *buffer, size_t len, size_t stride)
+{
+   if (IsIdle() || len == 0)
+      return;
+   const float target = TargetGain(mSettings);
+
+   if (mFiltered)
+      for (auto &filter : mFilters) {
+         if (filter.b0 == 1.0 && filter.b1 == filter.a1 &&
+             filter.b2 == filter.a2)
+            // A band at zero decibels
+            continue;
+         double z1 = filter.z1, z2 = filter.z2;
+         float *sample = buffer;
+         for (size_t ii = 0; ii < len; ++ii, sample += stride) {
+            const double x = *sample;
+            const double y = filter.b0 * x + z1;
+            z1 = filter.b1 * x - filter.a1 * y + z2;
+            z2 = filter.b2 * x - filter.a2 * y;
+            *sample = (float)y;
+         }
+         filter.z1 = z1, filter.z2 = z2;
+      }
+
+   if (mGain != target) {
+      const float step = (target - mGain) / len;
+      float gain = mGain;
+      float *sample = buffer;
+      for (size_t ii = 0; ii < len; ++ii, sample += stride) {
+         gain += step;
+         *sample *= gain;
+      }
+      mGain = target;
+   }
+   else if (mGain != 1.0f) {
+      float *sample = buffer;
+      for (size_t ii = 0; ii < len; ++ii, sample += stride)
+         *sample *= mGain;
+   }
+}
+
+bool RealtimeSettingsQueue::Post(int target, const RealtimeSettings &settings)
+{
+   const auto write = mWrite.load(std::memory_order_relaxed);
+   const auto next = (write + 1) % kSize;
+   if (next == mRead.load(std::memory_order_acquire))
+      return false;
+   mUpdates[write].target = target;
+   mUpdates[write].settings = settings;
+   mWrite.store(next, std::memory_order_release);
+   return true;
+}
@@ -0,0 +1,99 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   RealtimeChain.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_REALTIME_CHAIN__
+#define __AUDACITY_REALTIME_CHAIN__
+
+#include "Audacity.h"
+
+#include <atomic>
+#include <stddef.h>
+
+/// What a RealtimeChain does to the samples going through it: a gain and a
+/// three band equalizer, with bass and treble shelves and a mid peak
+struct RealtimeSettings
+{
+   bool  bypass { false };
+   float gainDB { 0.0f };
+   float bassDB { 0.0f };
+   float midDB { 0.0f };
+   float midHz { 1000.0f };
+   float trebleDB { 0.0f };
+
+   /// Whether the chain would leave the samples as they are
+   bool IsNeutral() const;
+};
+
+/// Processing of played samples, in place, in the audio thread, so that
+/// the user hears a change of the settings without rendering the tracks.
+/// Every stage is linear and time invariant.
+class RealtimeChain final
+{
+public:
+   /// Clear the state of the filters, and take the settings at once
+   void Prepare(double rate, const RealtimeSettings &settings);
+
+   /// The gain glides to the new value over the next buffer
+   void SetSettings(const RealtimeSettings &settings);
+
+   /// Whether Process() would leave the samples as they are
+   bool IsIdle() const;
+
+   /// Process len samples, each stride floats after the last
+   void Process(float *buffer, size_t len, size_t stride = 1);
+
+private:
+   struct Biquad
+   {
+      double b0 { 1.0 }, b1 { 0.0 }, b2 { 0.0 }, a1 { 0.0 }, a2 { 0.0 };
+      double z1 { 0.0 }, z2 { 0.0 };
+   };
+
+   void UpdateFilters();
+
+   double mRate { 44100.0 };
+   RealtimeSettings mSettings;
+   bool mActive { false };
+   bool mFiltered { false };
+   float mGain { 1.0f }; // reached at the end of the last buffer
+   Biquad mFilters[3];
+};
+
+/// Settings that the thread of the interface sends to the audio thread,
+/// each for a numbered chain, without a lock; there must be one thread
+/// posting and one draining
+class RealtimeSettingsQueue final
+{
+public:
+   /// False if the queue is full, when the audio thread is not draining
+   bool Post(int target, const RealtimeSettings &settings);
+
+   /// Call f(target, settings) for each posted, oldest first
+   template< typename F > void Drain(const F &f)
+   {
+      auto read = mRead.load(std::memory_order_relaxed);
+      const auto write = mWrite.load(std::memory_order_acquire);
+      for (; read != write; read = (read + 1) % kSize)
+         f(mUpdates[read].target, mUpdates[read].settings);
+      mRead.store(read, std::memory_order_release);
+   }
+
+private:
+   struct Update
+   {
+      int target { 0 };
+      RealtimeSettings settings;
+   };
+
+   static const size_t kSize = 64;
+   Update mUpdates[kSize];
+   std::atomic<size_t> mWrite { 0 };
+   std::atomic<size_t> mRead { 0 };
+};
+
+#endif
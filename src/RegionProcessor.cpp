@@ -0,0 +1,189 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   RegionProcessor.cpp
+
+*******************************************************************//**
+
+\class RegionProcessor
+\brief Processes regions of wave tracks in chunks, on a MixerPool.
+
+Each region is cut into chunks at the blocks of its track, so that
+WaveTrack::Set() replaces whole blocks.  A round of a few chunks for each
+thread is read and processed on all cores at once, from all the regions
+together; then each track takes the results with WaveTrack::Set(), in
+order, one thread to a track, as the block array of a track is not safe
+to change from two threads.  On an hour long track, normalizing,
+amplifying or fading so runs on all cores, where a loop over
+WaveTrack::Get() and Set() runs on one.
+
+A processor with state, such as a filter, asks for an overlap: each
+chunk comes with that many samples before it, as they were before
+processing, over which it settles its state.  The samples before the
+first chunk of a round were written already in the round before, so
+each region keeps their originals, and the chunks of the next round
+take them from there.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "RegionProcessor.h"
+
+#include <algorithm>
+#include <exception>
+
+#include <wx/thread.h>
+
+#include "MixerPool.h"
+#include "WaveTrack.h"
+#include "widgets/ProgressDialog.h"
+
+void RegionProcessor::Add(WaveTrack &track, double t0, double t1)
+{
+   const auto start = track.TimeToLongSamples(t0);
+   const auto end = track.TimeToLongSamples(t1);
+   if (end > start)
+      mRegions.push_back({ &track, start, end });
+}
+
+bool RegionProcessor::Run(const Process &process, ProgressDialog *progress)
+{
+   // Cut the regions at the blocks of their tracks
+   std::vector<Chunk> chunks;
+   size_t maxLen = 0;
+   sampleCount total = 0;
+   for (size_t rr = 0; rr < mRegions.size(); ++rr) {
+      const auto &region = mRegions[rr];
+      for (auto start = region.start; start < region.end;) {
+         const auto len = limitSampleBufferSize(
+            region.track->GetBestBlockSize(start), region.end - start);
+         const auto offset = start - region.start;
+         const auto overlap = limitSampleBufferSize(mOverlap, offset);
+         chunks.push_back({ rr, start, offset, overlap, len });
+         maxLen = std::max(maxLen, len);
+         start += len;
+      }
+      total += region.end - region.start;
+   }
+   if (chunks.empty())
+      return true;
+
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   const auto batch = std::min<size_t>(chunks.size(), 2 * nThreads);
+   MixerPool pool{ unsigned(std::min<size_t>(nThreads, batch) - 1) };
+
+   ArrayOf<Floats> buffers{ batch };
+   for (size_t ii = 0; ii < batch; ++ii)
+      buffers[ii].reinit(mOverlap + maxLen);
+   std::vector<std::exception_ptr> errors(batch);
+   const auto rethrow = [&](size_t count) {
+      for (size_t ii = 0; ii < count; ++ii)
+         if (errors[ii])
+            std::rethrow_exception(errors[ii]);
+   };
+
+   // The original samples before the first chunk of the round, for each
+   // region, and those the round leaves for the next
+   const auto nRegions = mRegions.size();
+   ArrayOf<Floats> history{ nRegions }, nextHistory{ nRegions };
+   if (mOverlap > 0)
+      for (size_t rr = 0; rr < nRegions; ++rr) {
+         history[rr].reinit(mOverlap);
+         nextHistory[rr].reinit(mOverlap);
+      }
+   std::vector<sampleCount> roundStart(nRegions);
+   std::vector<char> lastInRound(batch);
+
+   sampleCount done = 0;
+   for (size_t first = 0, nn = chunks.size(); first < nn; first += batch) {
+      const auto count = std::min(batch, nn - first);
+      for (size_t ii = 0; ii < count; ++ii) {
+         const auto &chunk = chunks[first + ii];
+         if (ii == 0 || chunks[first + ii - 1].region != chunk.region)
+            roundStart[chunk.region] = chunk.start;
+         lastInRound[ii] =
+            ii + 1 == count || chunks[first + ii + 1].region != chunk.region;
+      }
+
+      pool.Run(count, [&](size_t ii) {
+         // Exceptions must not escape the helper threads
+         try {
+            const auto &chunk = chunks[first + ii];
+            const auto &region = mRegions[chunk.region];
+            const auto buffer = buffers[ii].get();
+
+            // Samples before the round are written already; take their
+            // originals from the history
+            const auto from = chunk.start - chunk.overlap;
+            const auto fromTrack = std::max(from, roundStart[chunk.region]);
+            const auto fromHistory = (fromTrack - from).as_size_t();
+            if (fromHistory > 0) {
+               const auto historyLen = limitSampleBufferSize(
+                  mOverlap, roundStart[chunk.region] - region.start);
+               const auto src = history[chunk.region].get();
+               std::copy(src + historyLen - fromHistory, src + historyLen,
+                         buffer);
+            }
+            region.track->Get((samplePtr)(buffer + fromHistory), floatSample,
+               fromTrack, chunk.overlap - fromHistory + chunk.len);
+
+            if (mOverlap > 0 && lastInRound[ii]) {
+               const auto end = chunk.overlap + chunk.len;
+               const auto keep = std::min(mOverlap, end);
+               std::copy(buffer + end - keep, buffer + end,
+                         nextHistory[chunk.region].get());
+            }
+
+            process(chunk, buffer);
+         }
+         catch (...) {
+            errors[ii] = std::current_exception();
+         }
+      });
+      rethrow(count);
+      for (size_t ii = 0; ii < count; ++ii)
+         if (mOverlap > 0 && lastInRound[ii])
+            history[chunks[first + ii].region].swap(
+               nextHistory[chunks[first + ii].region]);
+
+      // Each track is written by one thread, in order
+      std::vector< std::vector<size_t> > byTrack;
+      std::vector< WaveTrack* > tracks;
+      for (size_t ii = 0; ii < count; ++ii) {
+         const auto track = mRegions[chunks[first + ii].region].track;
+         const auto iter = std::find(tracks.begin(), tracks.end(), track);
+         if (iter == tracks.end()) {
+            tracks.push_back(track);
+            byTrack.push_back({ ii });
+         }
+         else
+            byTrack[iter - tracks.begin()].push_back(ii);
+      }
+      pool.Run(tracks.size(), [&](size_t tt) {
+         try {
+            for (const auto ii : byTrack[tt]) {
+               const auto &chunk = chunks[first + ii];
+               tracks[tt]->Set(
+                  (samplePtr)(buffers[ii].get() + chunk.overlap), floatSample,
+                  chunk.start, chunk.len);
+            }
+         }
+         catch (...) {
+            errors[byTrack[tt].front()] = std::current_exception();
+         }
+      });
+      rethrow(count);
+
+      for (size_t ii = 0; ii < count; ++ii)
+         done += chunks[first + ii].len;
+      if (progress &&
+          progress->Update(done.as_long_long(), total.as_long_long()) !=
+             ProgressResult::Success)
+         return false;
+   }
+
+   return true;
+}
@@ -0,0 +1,73 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   RegionProcessor.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_REGION_PROCESSOR__
+#define __AUDACITY_REGION_PROCESSOR__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+#include "audacity/Types.h"
+
+#include <functional>
+#include <vector>
+
+class ProgressDialog;
+class WaveTrack;
+
+/// Changes the samples of regions of wave tracks in place, a chunk at a
+/// time, with the chunks of all the regions processed on all cores at
+/// once.  Commands using it push one undo state when Run() returns true.
+class RegionProcessor final {
+ public:
+   /// A piece of one region, at the blocks of its track
+   struct Chunk {
+      size_t region;      // in the order of Add()
+      sampleCount start;  // in the track
+      sampleCount offset; // from the start of the region
+      size_t overlap;     // samples before start, given to read only
+      size_t len;         // samples to process
+   };
+
+   /// Processes the len samples after the overlap ones in buffer, in
+   /// place.  Called on several threads at once, for different chunks;
+   /// a processor with state settles it over the overlap, which is shorter
+   /// at the start of a region, where a pass in order would begin anew.
+   using Process = std::function< void(const Chunk &chunk, float *buffer) >;
+
+   /// overlap is how many of the samples before each chunk the processor
+   /// needs to see
+   explicit RegionProcessor(size_t overlap = 0) : mOverlap{ overlap } {}
+   RegionProcessor(const RegionProcessor&) PROHIBITED;
+   RegionProcessor &operator= (const RegionProcessor&) PROHIBITED;
+
+   /// Add the samples of track from t0 to t1; regions of one track must
+   /// not overlap
+   void Add(WaveTrack &track, double t0, double t1);
+
+   sampleCount GetRegionLength(size_t region) const
+   { return mRegions[region].end - mRegions[region].start; }
+
+   /// Process all the regions.  False if the user cancelled; then, or if
+   /// it throws, the tracks are partly processed, and the command must
+   /// roll the project back to its last undo state.
+   bool Run(const Process &process, ProgressDialog *progress = nullptr);
+
+ private:
+   struct Region {
+      WaveTrack *track;
+      sampleCount start;
+      sampleCount end;
+   };
+
+   const size_t mOverlap;
+   std::vector<Region> mRegions;
+};
+
+#endif
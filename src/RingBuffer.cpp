@@ -19,63 +19,50 @@
   AvailForPut and AvailForGet may underestimate but will never
   overestimate.
 
+  The writer publishes samples by a release store of the count written,
+  after copying them; the reader acquires that count before copying them
+  out, and likewise in the other direction for the space freed.  There
+  are no locks.
+
 *//*******************************************************************/
 
 
 #include "RingBuffer.h"
-#include "Experimental.h"
-
-#undef REWRITE_RING_BUFFER
 
-// For now enabling the rewrite only for Mac
+#include <algorithm>
 
-#ifdef EXPERIMENTAL_REWRITE_RING_BUFFER
-#define REWRITE_RING_BUFFER
-#elif defined (__APPLE__)
-#define REWRITE_RING_BUFFER
-#endif
+#include "ThreadPriority.h"
 
 namespace {
    size_t roundUp(size_t n)
    {
-#ifdef REWRITE_RING_BUFFER
-      // PaUtilRingBuffer requires a power of 2
-      if (n == 0)
-         return 1;
-
-      size_t prev = n;
-      for (size_t temp = n; temp != 0; prev = temp, temp = ((temp - 1) & temp))
-         ;
-      return prev == n ? prev : prev << 1;
-#else
-      return n;
-#endif
+      // Positions are found by masking, which requires a power of 2
+      size_t result = 1;
+      while (result < n)
+         result <<= 1;
+      return result;
    }
 }
 
 RingBuffer::RingBuffer(sampleFormat format, size_t size)
    : mFormat{ format }
    , mBufferSize{ roundUp( std::max<size_t>(size, 64) ) }
+   , mMask{ mBufferSize - 1 }
    , mBuffer{ mBufferSize, mFormat }
 {
-#ifdef REWRITE_RING_BUFFER
-   PaUtil_InitializeRingBuffer(
-      &mRingBuffer, SAMPLE_SIZE(format), mBufferSize, mBuffer.ptr() );
-#endif
 }
 
 RingBuffer::~RingBuffer()
 {
+   if (mLocked)
+      UnlockMemory(mBuffer.ptr(), mBufferSize * SAMPLE_SIZE(mFormat));
 }
 
-size_t RingBuffer::Len()
+bool RingBuffer::LockInMemory()
 {
-#ifndef REWRITE_RING_BUFFER
-   return (mEnd + mBufferSize - mStart) % mBufferSize;
-#else
-   assert(false);
-   return 0;
-#endif
+   if (!mLocked)
+      mLocked = ::LockMemory(mBuffer.ptr(), mBufferSize * SAMPLE_SIZE(mFormat));
+   return mLocked;
 }
 
 //
@@ -84,41 +71,65 @@ size_t RingBuffer::Len()
 
 size_t RingBuffer::AvailForPut()
 {
-#ifdef REWRITE_RING_BUFFER
-   return PaUtil_GetRingBufferWriteAvailable(&mRingBuffer);
-#else
-   return std::max<size_t>(mBufferSize - Len(), 4) - 4;
-#endif
+   const auto written = mWritten.load(std::memory_order_relaxed);
+   const auto read = mRead.load(std::memory_order_acquire);
+   return mBufferSize - (written - read);
+}
+
+std::pair<samplePtr, size_t> RingBuffer::GetWriteRegion()
+{
+   const auto pos = mWritten.load(std::memory_order_relaxed) & mMask;
+   const auto len = std::min(AvailForPut(), mBufferSize - pos);
+   return { mBuffer.ptr() + pos * SAMPLE_SIZE(mFormat), len };
+}
+
+void RingBuffer::CommitWrite(size_t samples)
+{
+   const auto written = mWritten.load(std::memory_order_relaxed);
+   mWritten.store(written + samples, std::memory_order_release);
 }
 
 size_t RingBuffer::Put(samplePtr buffer, sampleFormat format,
                     size_t samplesToCopy)
 {
-#ifdef REWRITE_RING_BUFFER
-   return PaUtil_WriteRingBuffer(&mRingBuffer, buffer, samplesToCopy);
-#else
-   samplesToCopy = std::min( samplesToCopy, AvailForPut() );
    auto src = buffer;
    size_t copied = 0;
-   auto pos = mEnd;
 
-   while(samplesToCopy) {
-      auto block = std::min( samplesToCopy, mBufferSize - pos );
+   while (samplesToCopy) {
+      const auto region = GetWriteRegion();
+      const auto block = std::min( samplesToCopy, region.second );
+      if (!block)
+         break;
 
-      CopySamples(src, format,
-                  mBuffer.ptr() + pos * SAMPLE_SIZE(mFormat), mFormat,
-                  block);
+      CopySamples(src, format, region.first, mFormat, block);
+      CommitWrite(block);
 
       src += block * SAMPLE_SIZE(format);
-      pos = (pos + block) % mBufferSize;
       samplesToCopy -= block;
       copied += block;
    }
 
-   mEnd = pos;
-
    return copied;
-#endif
+}
+
+size_t RingBuffer::Clear(size_t samplesToClear)
+{
+   size_t cleared = 0;
+
+   while (samplesToClear) {
+      const auto region = GetWriteRegion();
+      const auto block = std::min( samplesToClear, region.second );
+      if (!block)
+         break;
+
+      ClearSamples(region.first, mFormat, 0, block);
+      CommitWrite(block);
+
+      samplesToClear -= block;
+      cleared += block;
+   }
+
+   return cleared;
 }
 
 //
@@ -127,48 +138,47 @@ size_t RingBuffer::Put(samplePtr buffer, sampleFormat format,
 
 size_t RingBuffer::AvailForGet()
 {
-#ifdef REWRITE_RING_BUFFER
-   return PaUtil_GetRingBufferReadAvailable(&mRingBuffer);
-#else
-   return Len();
-#endif
+   const auto written = mWritten.load(std::memory_order_acquire);
+   const auto read = mRead.load(std::memory_order_relaxed);
+   return written - read;
+}
+
+std::pair<samplePtr, size_t> RingBuffer::GetReadRegion()
+{
+   const auto pos = mRead.load(std::memory_order_relaxed) & mMask;
+   const auto len = std::min(AvailForGet(), mBufferSize - pos);
+   return { mBuffer.ptr() + pos * SAMPLE_SIZE(mFormat), len };
 }
 
 size_t RingBuffer::Get(samplePtr buffer, sampleFormat format,
                        size_t samplesToCopy)
 {
-#ifdef REWRITE_RING_BUFFER
-   return PaUtil_ReadRingBuffer(&mRingBuffer, buffer, samplesToCopy);
-#else
-   samplesToCopy = std::min( samplesToCopy, Len() );
    auto dest = buffer;
    size_t copied = 0;
 
-   while(samplesToCopy) {
-      auto block = std::min( samplesToCopy, mBufferSize - mStart );
+   while (samplesToCopy) {
+      const auto region = GetReadRegion();
+      const auto block = std::min( samplesToCopy, region.second );
+      if (!block)
+         break;
 
-      CopySamples(mBuffer.ptr() + mStart * SAMPLE_SIZE(mFormat), mFormat,
-                  dest, format,
-                  block);
+      CopySamples(region.first, mFormat, dest, format, block);
+      Discard(block);
 
       dest += block * SAMPLE_SIZE(format);
-      mStart = (mStart + block) % mBufferSize;
       samplesToCopy -= block;
       copied += block;
    }
 
    return copied;
-#endif
 }
 
 size_t RingBuffer::Discard(size_t samplesToDiscard)
 {
-#ifdef REWRITE_RING_BUFFER
-   PaUtil_AdvanceRingBufferReadIndex(&mRingBuffer, samplesToDiscard);
-#else
-   samplesToDiscard = std::min( samplesToDiscard, Len() );
+   samplesToDiscard = std::min( samplesToDiscard, AvailForGet() );
+
+   const auto read = mRead.load(std::memory_order_relaxed);
+   mRead.store(read + samplesToDiscard, std::memory_order_release);
 
-   mStart = (mStart + samplesToDiscard) % mBufferSize;
-#endif
    return samplesToDiscard;
 }
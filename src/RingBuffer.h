@@ -13,20 +13,32 @@
 
 #include "SampleFormat.h"
 
-#include "../lib-src/portaudio-v19/src/common/pa_ringbuffer.h"
+#include <atomic>
+#include <utility>
 
 class RingBuffer {
  public:
    RingBuffer(sampleFormat format, size_t size);
    ~RingBuffer();
 
+   // Keep the samples in physical memory until destruction; false if the
+   // system refused
+   bool LockInMemory();
+
    //
    // For the writer only:
    //
 
    size_t AvailForPut();
    size_t Put(samplePtr buffer, sampleFormat format, size_t samples);
-//   size_t Clear(sampleFormat format, size_t samples);
+   size_t Clear(size_t samples);
+
+   // Contiguous free space, in this buffer's format, to write in place.
+   // If it is short of AvailForPut(), the rest follows the wrap around and
+   // is offered after CommitWrite().
+   std::pair<samplePtr, size_t> GetWriteRegion();
+   // Make so many samples written in place available to the reader
+   void CommitWrite(size_t samples);
 
    //
    // For the reader only:
@@ -36,16 +48,27 @@ class RingBuffer {
    size_t Get(samplePtr buffer, sampleFormat format, size_t samples);
    size_t Discard(size_t samples);
 
- private:
-   size_t Len();
+   // Contiguous samples, in this buffer's format, to read in place.  Like
+   // GetWriteRegion(), it may be short of AvailForGet().  Discard() them
+   // when done.
+   std::pair<samplePtr, size_t> GetReadRegion();
 
+ private:
    sampleFormat  mFormat;
-   size_t        mStart { 0 };
-   size_t        mEnd { 0 };
-   size_t        mBufferSize;
+   size_t        mBufferSize; // a power of two
+   size_t        mMask;
    SampleBuffer  mBuffer;
-
-   PaUtilRingBuffer mRingBuffer;
+   bool          mLocked { false };
+
+   // Counts of samples ever written and read; positions are these modulo
+   // the size.  Each is stored only by its own side, and they are kept on
+   // separate cache lines, so that the two threads do not contend for one.
+   enum { CacheLine = 64 };
+   char mPad0[CacheLine];
+   std::atomic<size_t> mWritten { 0 };
+   char mPad1[CacheLine - sizeof(std::atomic<size_t>)];
+   std::atomic<size_t> mRead { 0 };
+   char mPad2[CacheLine - sizeof(std::atomic<size_t>)];
 };
 
 #endif /*  __AUDACITY_RING_BUFFER__ */
@@ -0,0 +1,148 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  SampleConvert.h
+
+*******************************************************************//*!
+
+\file SampleConvert.h
+\brief Sample format conversions chosen at compile time.
+
+  CopySamples() and Dither::Apply() choose the formats, the strides and
+  the ditherer at run time, for each call.  Where the caller knows the
+  formats itself, ConvertSamples<Src, Dst>() does the same conversion in
+  a loop the compiler can inline and vectorise.
+
+  The results are those of Dither::Apply() with Dither::none: integers
+  widen exactly, and narrowing rounds with lrintf() and clips.  The
+  ditherers that add noise keep state, so they stay in Dither.
+
+*//*******************************************************************/
+
+#ifndef __AUDACITY_SAMPLE_CONVERT__
+#define __AUDACITY_SAMPLE_CONVERT__
+
+// Erik de Castro Lopo's header file that
+// makes sure that we have lrint and lrintf
+#include "float_cast.h"
+
+#include "SampleFormat.h"
+
+/// The type in memory of each format, and the scale of its integers
+template<sampleFormat Format> struct SampleTraits;
+
+template<> struct SampleTraits<int16Sample> {
+   using type = short;
+   static float Scale() { return float(1 << 15); }
+   static int Min() { return -32768; }
+   static int Max() { return 32767; }
+};
+
+template<> struct SampleTraits<int24Sample> {
+   using type = int;
+   static float Scale() { return float(1 << 23); }
+   static int Min() { return -8388608; }
+   static int Max() { return 8388607; }
+};
+
+template<> struct SampleTraits<floatSample> {
+   using type = float;
+};
+
+/// The ditherer of Dither::none, which adds nothing before rounding
+struct NoDither {
+   float operator () (float sample) const { return sample; }
+};
+
+namespace SampleConvertDetail {
+
+template<sampleFormat Src, sampleFormat Dst, typename Ditherer>
+struct Convert;
+
+// Same format, just a copy; as in Dither::Apply(), no clipping
+template<sampleFormat Format, typename Ditherer>
+struct Convert<Format, Format, Ditherer> {
+   using Sample = typename SampleTraits<Format>::type;
+   static Sample Do(Sample sample, Ditherer &) { return sample; }
+};
+
+template<typename Ditherer>
+struct Convert<int16Sample, floatSample, Ditherer> {
+   static float Do(short sample, Ditherer &)
+      { return sample / SampleTraits<int16Sample>::Scale(); }
+};
+
+template<typename Ditherer>
+struct Convert<int24Sample, floatSample, Ditherer> {
+   static float Do(int sample, Ditherer &)
+      { return sample / SampleTraits<int24Sample>::Scale(); }
+};
+
+template<typename Ditherer>
+struct Convert<int16Sample, int24Sample, Ditherer> {
+   static int Do(short sample, Ditherer &) { return ((int)sample) << 8; }
+};
+
+// Promote to the range of the integers, dither, round and clip
+template<sampleFormat Dst, typename Ditherer>
+inline typename SampleTraits<Dst>::type Store(float sample, Ditherer &dither)
+{
+   using Traits = SampleTraits<Dst>;
+   const int x = lrintf(dither(sample * Traits::Scale()));
+   return typename Traits::type(
+      x > Traits::Max() ? Traits::Max() : x < Traits::Min() ? Traits::Min() : x);
+}
+
+// Floats may exceed 1.0 inside Audacity; clip before dithering
+template<sampleFormat Dst, typename Ditherer>
+struct FromFloat {
+   static typename SampleTraits<Dst>::type Do(float sample, Ditherer &dither)
+   {
+      return Store<Dst>(
+         sample > 1.0f ? 1.0f : sample < -1.0f ? -1.0f : sample, dither);
+   }
+};
+
+template<typename Ditherer>
+struct Convert<floatSample, int16Sample, Ditherer>
+   : FromFloat<int16Sample, Ditherer> {};
+
+template<typename Ditherer>
+struct Convert<floatSample, int24Sample, Ditherer>
+   : FromFloat<int24Sample, Ditherer> {};
+
+template<typename Ditherer>
+struct Convert<int24Sample, int16Sample, Ditherer> {
+   static short Do(int sample, Ditherer &dither)
+   {
+      return Store<int16Sample>(
+         sample / SampleTraits<int24Sample>::Scale(), dither);
+   }
+};
+
+}
+
+/// Converts one sample
+template<sampleFormat Src, sampleFormat Dst, typename Ditherer = NoDither>
+inline typename SampleTraits<Dst>::type ConvertSample(
+   typename SampleTraits<Src>::type sample, Ditherer &&dither = Ditherer{})
+{
+   return SampleConvertDetail::Convert<Src, Dst, Ditherer>::Do(sample, dither);
+}
+
+/// Converts len samples, taking every SrcStride-th and storing every
+/// DstStride-th, as CopySamples() does with the same strides and no dither
+template<sampleFormat Src, sampleFormat Dst, typename Ditherer = NoDither,
+         unsigned SrcStride = 1, unsigned DstStride = 1>
+inline void ConvertSamples(const typename SampleTraits<Src>::type *src,
+                           typename SampleTraits<Dst>::type *dst,
+                           size_t len, Ditherer &&dither = Ditherer{})
+{
+   for (size_t ii = 0; ii < len; ++ii)
+      dst[ii * DstStride] =
+         SampleConvertDetail::Convert<Src, Dst, Ditherer>::Do(
+            src[ii * SrcStride], dither);
+}
+
+#endif
@@ -68,6 +68,7 @@ public:
 
    samplePtr ptr() const { return mPtr; }
 
+   void swap(SampleBuffer &other) { std::swap(mPtr, other.mPtr); }
 
 private:
    samplePtr mPtr;
@@ -78,19 +79,22 @@ class GrowableSampleBuffer : private SampleBuffer
 public:
    GrowableSampleBuffer()
       : SampleBuffer()
-      , mCount(0)
+      , mBytes(0)
    {}
 
    GrowableSampleBuffer(size_t count, sampleFormat format)
       : SampleBuffer(count, format)
-      , mCount(count)
+      , mBytes(count * SAMPLE_SIZE(format))
    {}
 
+   // In bytes, so that a buffer used for several formats is always big
+   // enough
    GrowableSampleBuffer &Resize(size_t count, sampleFormat format)
    {
-      if (!ptr() || mCount < count) {
+      const size_t bytes = count * SAMPLE_SIZE(format);
+      if (!ptr() || mBytes < bytes) {
          Allocate(count, format);
-         mCount = count;
+         mBytes = bytes;
       }
       return *this;
    }
@@ -98,13 +102,13 @@ public:
    void Free()
    {
       SampleBuffer::Free();
-      mCount = 0;
+      mBytes = 0;
    }
 
    using SampleBuffer::ptr;
 
 private:
-   size_t mCount;
+   size_t mBytes;
 };
 
 //
@@ -117,6 +121,17 @@ void      CopySamples(samplePtr src, sampleFormat srcFormat,
                       unsigned int srcStride=1,
                       unsigned int dstStride=1);
 
+class Dither;
+
+// Like the above, but with the caller's own dither state, so that several
+// threads may convert at once
+void      CopySamples(samplePtr src, sampleFormat srcFormat,
+                      samplePtr dst, sampleFormat dstFormat,
+                      unsigned int len, Dither &dither,
+                      bool highQuality=true,
+                      unsigned int srcStride=1,
+                      unsigned int dstStride=1);
+
 void      CopySamplesNoDither(samplePtr src, sampleFormat srcFormat,
                       samplePtr dst, sampleFormat dstFormat,
                       unsigned int len,
@@ -109,11 +109,28 @@ void SelectionState::ChangeSelectionOnShiftClick
          pExtendFrom = Track::Pointer( pLast );
    }
 
-   SelectNone( tracks );
-   if( pExtendFrom )
-      SelectRangeOfTracks( tracks, track, *pExtendFrom );
-   else
-      SelectTrack( tracks, track, true, true );
+   // Leave the tracks as SelectNone() and then SelectRangeOfTracks() would,
+   // but in one pass that changes only those that must change, so that only
+   // those are redrawn.
+   Track *sTrack = &track;
+   Track *eTrack = pExtendFrom ? pExtendFrom.get() : &track;
+   if (eTrack->GetIndex() < sTrack->GetIndex())
+      std::swap(sTrack, eTrack);
+   // Stretch the range over stereo partners, as TrackList::Select() does
+   int first = sTrack->GetIndex(), last = eTrack->GetIndex();
+   if (const auto prev = tracks.GetPrev(sTrack))
+      if (prev->GetLinked())
+         first = prev->GetIndex();
+   if (eTrack->GetLinked())
+      if (const auto next = tracks.GetNext(eTrack))
+         last = next->GetIndex();
+
+   TrackListIterator iter( &tracks );
+   for (Track *t = iter.First(); t; t = iter.Next()) {
+      const auto index = t->GetIndex();
+      t->SetSelected( index >= first && index <= last );
+   }
+
    mLastPickedTrack = pExtendFrom;
 }
 
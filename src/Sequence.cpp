@@ -32,34 +32,50 @@
 #include "Sequence.h"
 
 #include <algorithm>
+#include <exception>
 #include <float.h>
+#include <iterator>
 #include <math.h>
+#include <vector>
 
 #include <wx/intl.h>
 #include <wx/filefn.h>
 #include <wx/ffile.h>
 #include <wx/log.h>
+#include <wx/thread.h>
 
 #include "AudacityException.h"
 
 #include "BlockFile.h"
+#include "Dither.h"
+#include "MixerPool.h"
+#include "Profiler.h"
 #include "blockfile/ODDecodeBlockFile.h"
+#include "blockfile/BlockCache.h"
+#include "blockfile/BlockIOStats.h"
 #include "DirManager.h"
 
 #include "blockfile/SimpleBlockFile.h"
 #include "blockfile/SilentBlockFile.h"
+#include "blockfile/SliceBlockFile.h"
 
 #include "InconsistencyException.h"
 
 #include "widgets/ErrorDialog.h"
 
+// Debug builds check the whole sequence after each edit; others check only
+// the blocks an edit made, and how they meet the rest
+#if defined(__WXDEBUG__) || defined(VERY_SLOW_CHECKING)
+#define CHECK_WHOLE_SEQUENCE
+#endif
+
 size_t Sequence::sMaxDiskBlockSize = 1048576;
 
 // Sequence methods
 Sequence::Sequence(const std::shared_ptr<DirManager> &projDirManager, sampleFormat format)
    : mDirManager(projDirManager)
    , mSampleFormat(format)
-   , mMinSamples(sMaxDiskBlockSize / SAMPLE_SIZE(mSampleFormat) / 2)
+   , mMinSamples(projDirManager->GetMaxDiskBlockSize() / SAMPLE_SIZE(mSampleFormat) / 2)
    , mMaxSamples(mMinSamples * 2)
 {
 }
@@ -73,7 +89,18 @@ Sequence::Sequence(const Sequence &orig, const std::shared_ptr<DirManager> &proj
    , mMinSamples(orig.mMinSamples)
    , mMaxSamples(orig.mMaxSamples)
 {
-   Paste(0, &orig);
+   // Within one project, share the blocks until either copy changes them,
+   // unless a save has locked them, and their files must be copied.
+   // Blocks not yet loaded are not locked, and stay unloaded.
+   if (orig.mDirManager == projDirManager &&
+       (!orig.mBlock.IsLoaded() ||
+        std::none_of(orig.mBlock.begin(), orig.mBlock.end(),
+          [](const SeqBlock &block) { return block.f->IsLocked(); }))) {
+      mBlock = orig.mBlock;
+      mNumSamples = orig.mNumSamples;
+   }
+   else
+      Paste(0, &orig);
 }
 
 Sequence::~Sequence()
@@ -92,24 +119,30 @@ size_t Sequence::GetIdealBlockSize() const
 
 bool Sequence::Lock()
 {
-   for (unsigned int i = 0; i < mBlock.size(); i++)
-      mBlock[i].f->Lock();
+   for (const auto &block : mBlock.Get())
+      block.f->Lock();
 
    return true;
 }
 
 bool Sequence::CloseLock()
 {
-   for (unsigned int i = 0; i < mBlock.size(); i++)
-      mBlock[i].f->CloseLock();
+   // Blocks never loaded were never made, and there is nothing to keep;
+   // or, for a cut line, belong to the clip it was cut from, which keeps
+   // them if saved
+   if (!mBlock.IsLoaded())
+      return true;
+
+   for (const auto &block : mBlock.Get())
+      block.f->CloseLock();
 
    return true;
 }
 
 bool Sequence::Unlock()
 {
-   for (unsigned int i = 0; i < mBlock.size(); i++)
-      mBlock[i].f->Unlock();
+   for (const auto &block : mBlock.Get())
+      block.f->Unlock();
 
    return true;
 }
@@ -173,7 +206,7 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format)
 
    const auto oldMinSamples = mMinSamples, oldMaxSamples = mMaxSamples;
    // These are the same calculations as in the constructor.
-   mMinSamples = sMaxDiskBlockSize / SAMPLE_SIZE(mSampleFormat) / 2;
+   mMinSamples = mDirManager->GetMaxDiskBlockSize() / SAMPLE_SIZE(mSampleFormat) / 2;
    mMaxSamples = mMinSamples * 2;
 
    bool bSuccess = false;
@@ -193,35 +226,67 @@ bool Sequence::ConvertToSampleFormat(sampleFormat format)
       (1 + mBlock.size() * ((float)oldMaxSamples / (float)mMaxSamples));
 
    {
-      size_t oldSize = oldMaxSamples;
-      SampleBuffer bufferOld(oldSize, oldFormat);
-      size_t newSize = oldMaxSamples;
-      SampleBuffer bufferNew(newSize, format);
+      // Blocks convert independently, so read and convert a batch of them
+      // on all cores at once.  Then make their NEW block files, in order,
+      // on this thread, because DirManager is not thread safe.
+      const auto nThreads = std::max(1, wxThread::GetCPUCount());
+      MixerPool pool{ unsigned(nThreads - 1) };
+      const size_t batch = 2 * nThreads;
+
+      ArrayOf<SampleBuffer> buffersOld{ batch }, buffersNew{ batch };
+      ArrayOf<size_t> oldSizes{ batch }, newSizes{ batch };
+      ArrayOf<Dither> dithers{ batch };
+      std::vector<std::exception_ptr> errors(batch);
+      for (size_t ii = 0; ii < batch; ++ii) {
+         oldSizes[ii] = newSizes[ii] = oldMaxSamples;
+         buffersOld[ii].Allocate(oldMaxSamples, oldFormat);
+         buffersNew[ii].Allocate(oldMaxSamples, format);
+      }
 
-      for (size_t i = 0, nn = mBlock.size(); i < nn; i++)
+      for (size_t first = 0, nn = mBlock.size(); first < nn; first += batch)
       {
-         SeqBlock &oldSeqBlock = mBlock[i];
-         const auto &oldBlockFile = oldSeqBlock.f;
-         const auto len = oldBlockFile->GetLength();
-         ensureSampleBufferSize(bufferOld, oldFormat, oldSize, len);
-         Read(bufferOld.ptr(), oldFormat, oldSeqBlock, 0, len, true);
-
-         ensureSampleBufferSize(bufferNew, format, newSize, len);
-         CopySamples(bufferOld.ptr(), oldFormat, bufferNew.ptr(), format, len);
-
-         // Note this fix for http://bugzilla.audacityteam.org/show_bug.cgi?id=451,
-         // using Blockify, allows (len < mMinSamples).
-         // This will happen consistently when going from more bytes per sample to fewer...
-         // This will create a block that's smaller than mMinSamples, which
-         // shouldn't be allowed, but we agreed it's okay for now.
-         //vvv ANSWER-ME: Does this cause any bugs, or failures on write, elsewhere?
-         //    If so, need to special-case (len < mMinSamples) and start combining data
-         //    from the old blocks... Oh no!
-
-         // Using Blockify will handle the cases where len > the NEW mMaxSamples. Previous code did not.
-         const auto blockstart = oldSeqBlock.start;
-         Blockify(*mDirManager, mMaxSamples, mSampleFormat,
-                  newBlockArray, blockstart, bufferNew.ptr(), len);
+         const auto count = std::min(batch, nn - first);
+         pool.Run(count, [&](size_t ii) {
+            // Exceptions must not escape the helper threads
+            try {
+               const SeqBlock &oldSeqBlock = mBlock[first + ii];
+               const auto len = oldSeqBlock.f->GetLength();
+               ensureSampleBufferSize(
+                  buffersOld[ii], oldFormat, oldSizes[ii], len);
+               Read(buffersOld[ii].ptr(), oldFormat, oldSeqBlock, 0, len, true);
+
+               ensureSampleBufferSize(
+                  buffersNew[ii], format, newSizes[ii], len);
+               CopySamples(buffersOld[ii].ptr(), oldFormat,
+                           buffersNew[ii].ptr(), format, len, dithers[ii]);
+            }
+            catch (...) {
+               errors[ii] = std::current_exception();
+            }
+         });
+         for (size_t ii = 0; ii < count; ++ii)
+            if (errors[ii])
+               std::rethrow_exception(errors[ii]);
+
+         for (size_t ii = 0; ii < count; ++ii) {
+            const SeqBlock &oldSeqBlock = mBlock[first + ii];
+            const auto len = oldSeqBlock.f->GetLength();
+            SampleBuffer &bufferNew = buffersNew[ii];
+
+            // Note this fix for http://bugzilla.audacityteam.org/show_bug.cgi?id=451,
+            // using Blockify, allows (len < mMinSamples).
+            // This will happen consistently when going from more bytes per sample to fewer...
+            // This will create a block that's smaller than mMinSamples, which
+            // shouldn't be allowed, but we agreed it's okay for now.
+            //vvv ANSWER-ME: Does this cause any bugs, or failures on write, elsewhere?
+            //    If so, need to special-case (len < mMinSamples) and start combining data
+            //    from the old blocks... Oh no!
+
+            // Using Blockify will handle the cases where len > the NEW mMaxSamples. Previous code did not.
+            const auto blockstart = oldSeqBlock.start;
+            Blockify(*mDirManager, mMaxSamples, mSampleFormat,
+                     newBlockArray, blockstart, bufferNew.ptr(), len);
+         }
       }
    }
 
@@ -289,7 +354,7 @@ std::pair<float, float> Sequence::GetMinMax(
          wxASSERT(maxl0 <= mMaxSamples); // Vaughan, 2011-10-19
          const auto l0 = limitSampleBufferSize ( maxl0, len );
 
-         results = theFile->GetMinMaxRMS(s0, l0, mayThrow);
+         results = theFile->GetMinMaxRMSFromSummary(s0, l0, mayThrow);
          if (results.min < min)
             min = results.min;
          if (results.max > max)
@@ -309,7 +374,7 @@ std::pair<float, float> Sequence::GetMinMax(
          const auto l0 = ( start + len - theBlock.start ).as_size_t();
          wxASSERT(l0 <= mMaxSamples); // Vaughan, 2011-10-19
 
-         results = theFile->GetMinMaxRMS(0, l0, mayThrow);
+         results = theFile->GetMinMaxRMSFromSummary(0, l0, mayThrow);
          if (results.min < min)
             min = results.min;
          if (results.max > max)
@@ -361,7 +426,7 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
       wxASSERT(maxl0 <= mMaxSamples); // Vaughan, 2011-10-19
       const auto l0 = limitSampleBufferSize( maxl0, len );
 
-      auto results = theFile->GetMinMaxRMS(s0, l0, mayThrow);
+      auto results = theFile->GetMinMaxRMSFromSummary(s0, l0, mayThrow);
       const auto partialRMS = results.RMS;
       sumsq += partialRMS * partialRMS * l0;
       length += l0;
@@ -375,7 +440,7 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
       const auto l0 = ( start + len - theBlock.start ).as_size_t();
       wxASSERT(l0 <= mMaxSamples); // PRL: I think Vaughan missed this
 
-      auto results = theFile->GetMinMaxRMS(0, l0, mayThrow);
+      auto results = theFile->GetMinMaxRMSFromSummary(0, l0, mayThrow);
       const auto partialRMS = results.RMS;
       sumsq += partialRMS * partialRMS * l0;
       length += l0;
@@ -387,9 +452,22 @@ float Sequence::GetRMS(sampleCount start, sampleCount len, bool mayThrow) const
    return sqrt(sumsq / length.as_double() );
 }
 
+std::unique_ptr<Sequence> Sequence::Snapshot() const
+{
+   auto result = std::make_unique<Sequence>(mDirManager, mSampleFormat);
+   result->mMinSamples = mMinSamples;
+   result->mMaxSamples = mMaxSamples;
+   result->mBlock = mBlock;
+   result->mNumSamples = mNumSamples;
+   return result;
+}
+
 std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
 {
    auto dest = std::make_unique<Sequence>(mDirManager, mSampleFormat);
+   // The block size of the project may have changed since this was made
+   dest->mMinSamples = mMinSamples;
+   dest->mMaxSamples = mMaxSamples;
    if (s0 >= s1 || s0 >= mNumSamples || s1 < 0) {
       return dest;
    }
@@ -411,6 +489,16 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
 
    int blocklen;
 
+   // A block cut by the range becomes a slice of it, if it can
+   const auto slice = [&](const SeqBlock &block, size_t start, size_t len) {
+      auto file = MakeSlice(block, start, len);
+      if (!file)
+         return false;
+      dest->mBlock.push_back(SeqBlock(file, dest->mNumSamples));
+      dest->mNumSamples += len;
+      return true;
+   };
+
    // Do the first block
 
    const SeqBlock &block0 = mBlock[b0];
@@ -420,10 +508,12 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
       blocklen =
          ( std::min(s1, block0.start + file->GetLength()) - s0 ).as_size_t();
       wxASSERT(file->IsAlias() || (blocklen <= (int)mMaxSamples)); // Vaughan, 2012-02-29
-      ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
-      Get(b0, buffer.ptr(), mSampleFormat, s0, blocklen, true);
+      if (!slice(block0, (s0 - block0.start).as_size_t(), blocklen)) {
+         ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
+         Get(b0, buffer.ptr(), mSampleFormat, s0, blocklen, true);
 
-      dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+         dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+      }
    }
    else
       --b0;
@@ -441,9 +531,11 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
       blocklen = (s1 - block.start).as_size_t();
       wxASSERT(file->IsAlias() || (blocklen <= (int)mMaxSamples)); // Vaughan, 2012-02-29
       if (blocklen < (int)file->GetLength()) {
-         ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
-         Get(b1, buffer.ptr(), mSampleFormat, block.start, blocklen, true);
-         dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+         if (!slice(block, 0, blocklen)) {
+            ensureSampleBufferSize(buffer, mSampleFormat, bufferSize, blocklen);
+            Get(b1, buffer.ptr(), mSampleFormat, block.start, blocklen, true);
+            dest->Append(buffer.ptr(), mSampleFormat, blocklen);
+         }
       }
       else
          // Special case, copy exactly
@@ -456,6 +548,40 @@ std::unique_ptr<Sequence> Sequence::Copy(sampleCount s0, sampleCount s1) const
    return dest;
 }
 
+std::unique_ptr<Sequence> Sequence::CopyWhenNeeded
+   (sampleCount s0, sampleCount s1) const
+{
+   auto dest = std::make_unique<Sequence>(mDirManager, mSampleFormat);
+   dest->mMinSamples = mMinSamples;
+   dest->mMaxSamples = mMaxSamples;
+   if (s0 >= s1 || s0 >= mNumSamples || s1 < 0) {
+      return dest;
+   }
+
+   // The touched blocks, as a sequence of their own starting at zero,
+   // which changes to this one don't reach
+   const int b0 = FindBlock(s0);
+   const int b1 = FindBlock(s1 - 1);
+   const auto origin = mBlock[b0].start;
+   auto source = std::make_shared<Sequence>(mDirManager, mSampleFormat);
+   source->mMinSamples = mMinSamples;
+   source->mMaxSamples = mMaxSamples;
+   source->mBlock.reserve(b1 - b0 + 1);
+   for (int bb = b0; bb <= b1; ++bb)
+      source->mBlock.push_back(mBlock[bb].Plus(-origin));
+   const SeqBlock &last = mBlock[b1];
+   source->mNumSamples = last.start + last.f->GetLength() - origin;
+
+   const auto start = s0 - origin, end = s1 - origin;
+   dest->SetBlockLoader([source, start, end]{
+      BlockArray blocks;
+      blocks.swap(source->Copy(start, end)->GetBlockArray());
+      return blocks;
+   }, s1 - s0);
+
+   return dest;
+}
+
 namespace {
    inline bool Overflows(double numSamples)
    {
@@ -495,6 +621,11 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
       THROW_INCONSISTENCY_EXCEPTION;
    }
 
+   // Blocks from a project with larger blocks must be split first
+   const auto reblocked = Reblocked(*src);
+   if (reblocked)
+      src = reblocked.get();
+
    const BlockArray &srcBlock = src->mBlock;
    auto addedLen = src->mNumSamples;
    const unsigned int srcNumBlocks = srcBlock.size();
@@ -511,8 +642,10 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
       // onto the end because the current last block is longer than the
       // minimum size
 
-      // Build and swap a copy so there is a strong exception safety guarantee
-      BlockArray newBlock{ mBlock };
+      // Build only the added blocks, then append them, so there is a
+      // strong exception safety guarantee without copying the array
+      BlockArray newBlock;
+      newBlock.reserve(srcNumBlocks);
       sampleCount samples = mNumSamples;
       for (unsigned int i = 0; i < srcNumBlocks; i++)
          // AppendBlock may throw for limited disk space, if pasting from
@@ -520,8 +653,8 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
          AppendBlock(*mDirManager, newBlock, samples, srcBlock[i]);
          // Increase ref count or duplicate file
 
-      CommitChangesIfConsistent
-         (newBlock, samples, wxT("Paste branch one"));
+      AppendBlocksIfConsistent
+         (newBlock, false, samples, wxT("Paste branch one"));
       return;
    }
 
@@ -530,6 +663,36 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
    SeqBlock *const pBlock = &mBlock[b];
    const auto length = pBlock->f->GetLength();
    const auto largerBlockLen = addedLen + length;
+
+   if (addedLen >= mMinSamples) {
+      // Special case: the split block is kept as slices of it before and
+      // after the pasted blocks, so it is neither read nor rewritten, if
+      // the slices are not small
+      const SeqBlock &splitBlock = *pBlock;
+      const auto splitPoint = ( s - splitBlock.start ).as_size_t();
+      const auto rightSplit = length - splitPoint;
+      BlockFilePtr pre, post;
+      if (splitPoint >= mMinSamples)
+         pre = MakeSlice(splitBlock, 0, splitPoint);
+      if (rightSplit >= mMinSamples)
+         post = MakeSlice(splitBlock, splitPoint, rightSplit);
+      if ((splitPoint == 0 || pre) && (rightSplit == 0 || post)) {
+         BlockArray newBlock;
+         newBlock.reserve(srcNumBlocks + 2);
+         if (pre)
+            newBlock.push_back(SeqBlock(pre, splitBlock.start));
+         sampleCount samples = s;
+         for (unsigned int i = 0; i < srcNumBlocks; i++)
+            AppendBlock(*mDirManager, newBlock, samples, srcBlock[i]);
+         if (post)
+            newBlock.push_back(SeqBlock(post, samples));
+
+         SpliceBlocksIfConsistent
+            (b, b + 1, newBlock, addedLen, wxT("Paste slices"));
+         return;
+      }
+   }
+
    // PRL: when insertion point is the first sample of a block,
    // and the following test fails, perhaps we could test
    // whether coalescence with the previous block is possible.
@@ -570,7 +733,7 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
 
       // This consistency check won't throw, it asserts.
       // Proof that we kept consistency is not hard.
-      ConsistencyCheck(wxT("Paste branch two"), false);
+      ConsistencyCheckChanged(b, b + 1, wxT("Paste branch two"));
       return;
    }
 
@@ -578,11 +741,12 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
    // it's simplest to just lump all the data together
    // into one big block along with the split block,
    // then resplit it all
+   // Only the blocks replacing the split block are built; those before
+   // are kept, and those after are moved, by SpliceBlocksIfConsistent
    BlockArray newBlock;
-   newBlock.reserve(numBlocks + srcNumBlocks + 2);
-   newBlock.insert(newBlock.end(), mBlock.begin(), mBlock.begin() + b);
+   newBlock.reserve(srcNumBlocks + 2);
 
-   SeqBlock &splitBlock = mBlock[b];
+   const SeqBlock &splitBlock = mBlock.Get()[b];
    auto splitLen = splitBlock.f->GetLength();
    // s lies within splitBlock
    auto splitPoint = ( s - splitBlock.start ).as_size_t();
@@ -635,7 +799,7 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
 
       for (i = 2; i < srcNumBlocks - 2; i++) {
          const SeqBlock &block = srcBlock[i];
-         auto file = mDirManager->CopyBlockFile(block.f);
+         auto file = PasteBlockFile(*mDirManager, block.f);
          // We can assume file is not null
          newBlock.push_back(SeqBlock(file, block.start + s));
       }
@@ -650,13 +814,35 @@ void Sequence::Paste(sampleCount s, const Sequence *src)
                newBlock, s + lastStart, sampleBuffer.ptr(), rightLen);
    }
 
-   // Copy remaining blocks to NEW block array and
-   // swap the NEW block array in for the old
-   for (i = b + 1; i < numBlocks; i++)
-      newBlock.push_back(mBlock[i].Plus(addedLen));
+   SpliceBlocksIfConsistent
+      (b, b + 1, newBlock, addedLen, wxT("Paste branch three"));
+}
 
-   CommitChangesIfConsistent
-      (newBlock, mNumSamples + addedLen, wxT("Paste branch three"));
+std::unique_ptr<Sequence> Sequence::Reblocked(const Sequence &src) const
+{
+   if (src.mMaxSamples <= mMaxSamples)
+      return {};
+
+   auto result = std::make_unique<Sequence>(mDirManager, mSampleFormat);
+   result->mMinSamples = mMinSamples;
+   result->mMaxSamples = mMaxSamples;
+
+   SampleBuffer buffer;
+   for (const auto &block : src.mBlock) {
+      const auto &file = block.f;
+      const auto len = file->GetLength();
+      if (file->IsAlias() || len <= mMaxSamples)
+         AppendBlock(*mDirManager, result->mBlock, result->mNumSamples, block);
+      else {
+         buffer.Allocate(len, mSampleFormat);
+         src.Read(buffer.ptr(), mSampleFormat, block, 0, len, true);
+         Blockify(*mDirManager, mMaxSamples, mSampleFormat,
+                  result->mBlock, result->mNumSamples, buffer.ptr(), len);
+         result->mNumSamples += len;
+      }
+   }
+
+   return result;
 }
 
 void Sequence::SetSilence(sampleCount s0, sampleCount len)
@@ -675,6 +861,72 @@ void Sequence::InsertSilence(sampleCount s0, sampleCount len)
    if (len <= 0)
       return;
 
+   if (s0 < 0 || s0 > mNumSamples)
+      THROW_INCONSISTENCY_EXCEPTION;
+
+   if (len >= mMinSamples && !mBlock.empty()) {
+      // A long silence goes in as SilentBlockFiles, between the halves of
+      // the block split at s0, so that no zeroes are written into the
+      // blocks about it
+      const auto &blocks = mBlock.Get();
+      BlockArray newBlock;
+      size_t first = blocks.size(), last = first;
+      sampleCount after = 0;
+      SeqBlock post;
+      if (s0 < mNumSamples) {
+         first = last = FindBlock(s0);
+         const SeqBlock &block = blocks[first];
+         if (block.start < s0) {
+            ++last;
+            const auto length = block.f->GetLength();
+            const auto split = ( s0 - block.start ).as_size_t();
+            // A piece of the block, made silent again if the block is
+            auto piece = [&](samplePtr buffer, size_t start, size_t pieceLen)
+            {
+               return buffer
+                  ? mDirManager->NewSimpleBlockFile(
+                       buffer + start * SAMPLE_SIZE(mSampleFormat),
+                       pieceLen, mSampleFormat)
+                  : BlockFilePtr{ make_blockfile<SilentBlockFile>(pieceLen) };
+            };
+            SampleBuffer buffer;
+            if (!block.f->IsSilent()) {
+               buffer.Allocate(length, mSampleFormat);
+               Read(buffer.ptr(), mSampleFormat, block, 0, length, true);
+            }
+            newBlock.push_back(
+               SeqBlock(piece(buffer.ptr(), 0, split), block.start));
+            post = SeqBlock(piece(buffer.ptr(), split, length - split), s0);
+            after = length - split;
+         }
+      }
+
+      auto idealSamples = GetIdealBlockSize();
+      auto pos = s0;
+      auto remaining = len;
+      BlockFilePtr silentFile {};
+      if (remaining >= idealSamples)
+         silentFile = make_blockfile<SilentBlockFile>(idealSamples);
+      while (remaining >= idealSamples) {
+         newBlock.push_back(SeqBlock(silentFile, pos));
+         pos += idealSamples;
+         remaining -= idealSamples;
+      }
+      if (remaining != 0) {
+         newBlock.push_back(SeqBlock(
+            // remaining is less than idealSamples:
+            make_blockfile<SilentBlockFile>( remaining.as_size_t() ), pos));
+         pos += remaining;
+      }
+
+      if (after > 0)
+         newBlock.push_back(post.Plus(len));
+
+      SpliceBlocksIfConsistent
+         (first, last, newBlock, len, wxT("InsertSilence"));
+      return;
+   }
+
    // Create a NEW track containing as much silence as we
    // need to insert, and then call Paste to do the insertion.
    // We make use of a SilentBlockFile, which takes up no
@@ -713,6 +965,88 @@ void Sequence::InsertSilence(sampleCount s0, sampleCount len)
    Paste(s0, &sTrack);
 }
 
+size_t Sequence::Compact(double fraction, size_t maxBlocks)
+// STRONG-GUARANTEE
+{
+   const size_t threshold = fraction * mMaxSamples;
+   const auto &oldBlocks = mBlock.Get();
+   const auto numBlocks = oldBlocks.size();
+   // Even one block may be a slice to rewrite
+   if (threshold == 0 || numBlocks == 0)
+      return 0;
+
+   auto isSmall = [&](const SeqBlock &block) {
+      const auto &file = block.f;
+      return !file->IsAlias() && !file->IsSilent() &&
+         file->IsDataAvailable() &&
+         (file->GetLength() < threshold || file->IsSlice());
+   };
+
+   // On-demand threads look at the blocks, as for Delete
+   DeleteUpdateMutexLocker locker(*this);
+
+   BlockArray newBlock;
+   newBlock.reserve(numBlocks);
+   SampleBuffer buffer;
+   size_t merged = 0, looked = 0;
+   size_t b = 0;
+   while (b < numBlocks && looked < maxBlocks) {
+      if (!isSmall(oldBlocks[b])) {
+         newBlock.push_back(oldBlocks[b++]);
+         continue;
+      }
+
+      // Find a run of small blocks, no longer in all than a few blocks
+      // of the maximum size, so that the buffer stays small
+      size_t end = b, sum = 0;
+      bool hasSlice = false;
+      while (end < numBlocks && looked < maxBlocks &&
+             isSmall(oldBlocks[end])) {
+         const auto length = oldBlocks[end].f->GetLength();
+         if (end > b && sum + length > 4 * mMaxSamples)
+            break;
+         sum += length;
+         hasSlice = hasSlice || oldBlocks[end].f->IsSlice();
+         ++end, ++looked;
+      }
+
+      // Slices are rewritten even if no fewer blocks result, so that the
+      // unused parts of the blocks they keep alive can be freed
+      const auto count = end - b;
+      const auto numNew = (sum + mMaxSamples - 1) / mMaxSamples;
+      if (numNew >= count && !hasSlice) {
+         // Nothing to gain
+         for (; b < end; ++b)
+            newBlock.push_back(oldBlocks[b]);
+         continue;
+      }
+
+      buffer.Allocate(sum, mSampleFormat);
+      size_t offset = 0;
+      for (auto ii = b; ii < end; ++ii) {
+         const auto &block = oldBlocks[ii];
+         const auto length = block.f->GetLength();
+         Read(buffer.ptr() + offset * SAMPLE_SIZE(mSampleFormat),
+              mSampleFormat, block, 0, length, true);
+         offset += length;
+      }
+      Blockify(*mDirManager, mMaxSamples, mSampleFormat,
+               newBlock, oldBlocks[b].start, buffer.ptr(), sum);
+
+      merged += count;
+      b = end;
+   }
+
+   if (merged == 0)
+      return 0;
+
+   for (; b < numBlocks; ++b)
+      newBlock.push_back(oldBlocks[b]);
+
+   CommitChangesIfConsistent(newBlock, mNumSamples, wxT("Compact"));
+   return merged;
+}
+
 void Sequence::AppendAlias(const wxString &fullPath,
                            sampleCount start,
                            size_t len, int channel, bool useOD)
@@ -757,7 +1091,7 @@ void Sequence::AppendBlock
       THROW_INCONSISTENCY_EXCEPTION;
 
    SeqBlock newBlock(
-      mDirManager.CopyBlockFile(b.f), // Bump ref count if not locked, else copy
+      PasteBlockFile(mDirManager, b.f),
       mNumSamples
    );
    // We can assume newBlock.f is not null
@@ -769,12 +1103,44 @@ void Sequence::AppendBlock
    // function gets called in an inner loop.
 }
 
+BlockFilePtr Sequence::PasteBlockFile
+   (DirManager &dirManager, const BlockFilePtr &file)
+{
+   if (file->IsSlice()) {
+      // The base is shared or copied as a block would be, and sliced again
+      // if copied
+      const auto &slice = static_cast<const SliceBlockFile&>(*file);
+      const auto &base = slice.GetBase();
+      auto newBase = dirManager.CopyBlockFile(base);
+      if (newBase == base)
+         return file;
+      return make_blockfile<SliceBlockFile>(
+         newBase, slice.GetStart(), file->GetLength());
+   }
+
+   // Bump ref count if not locked, else copy
+   return dirManager.CopyBlockFile(file);
+}
+
+BlockFilePtr Sequence::MakeSlice
+   (const SeqBlock &block, size_t start, size_t len) const
+{
+   const auto &file = block.f;
+   if (start == 0 && len == file->GetLength())
+      return file;
+   if (file->IsSilent())
+      return make_blockfile<SilentBlockFile>(len);
+   if (!SliceBlockFile::CanSlice(*file))
+      return {};
+   return make_blockfile<SliceBlockFile>(file, start, len);
+}
+
 ///gets an int with OD flags so that we can determine which ODTasks should be run on this track after save/open, etc.
 unsigned int Sequence::GetODFlags()
 {
    unsigned int ret = 0;
-   for (unsigned int i = 0; i < mBlock.size(); i++) {
-      const auto &file = mBlock[i].f;
+   for (const auto &block : mBlock.Get()) {
+      const auto &file = block.f;
       if(!file->IsDataAvailable())
          ret |= (static_cast< ODDecodeBlockFile * >( &*file ))->GetDecodeType();
       else if(!file->IsSummaryAvailable())
@@ -789,6 +1155,13 @@ sampleCount Sequence::GetBlockStart(sampleCount position) const
    return mBlock[b].start;
 }
 
+BlockFilePtr Sequence::GetBlockFile(sampleCount position) const
+{
+   if (position < 0 || position >= mNumSamples)
+      return {};
+   return mBlock[FindBlock(position)].f;
+}
+
 size_t Sequence::GetBestBlockSize(sampleCount start) const
 {
    // This method returns a nice number of samples you should try to grab in
@@ -799,7 +1172,11 @@ size_t Sequence::GetBestBlockSize(sampleCount start) const
    if (start < 0 || start >= mNumSamples)
       return mMaxSamples;
 
-   int b = FindBlock(start);
+   return GetBestBlockSize(FindBlock(start), start);
+}
+
+size_t Sequence::GetBestBlockSize(int b, sampleCount start) const
+{
    int numBlocks = mBlock.size();
 
    const SeqBlock &block = mBlock[b];
@@ -867,15 +1244,85 @@ int Sequence::FindBlock(sampleCount pos) const
    return rval;
 }
 
-//static
+int Sequence::FindBlock(sampleCount pos, int hint) const
+{
+   const int numBlocks = mBlock.size();
+   for (int b = hint; b <= hint + 1; ++b) {
+      if (b >= 0 && b < numBlocks) {
+         const SeqBlock &block = mBlock[b];
+         if (pos >= block.start && pos < block.start + block.f->GetLength())
+            return b;
+      }
+   }
+   return FindBlock(pos);
+}
+
+bool Sequence::Reader::Get(samplePtr buffer, sampleFormat format,
+   sampleCount start, size_t len, bool mayThrow)
+{
+   if (start == mSequence->mNumSamples || start < 0 ||
+       start + len > mSequence->mNumSamples)
+      // Let the sequence treat the edge cases
+      return mSequence->Get(buffer, format, start, len, mayThrow);
+
+   mHint = mSequence->FindBlock(start, mBlock);
+   return mSequence->Get(mHint, buffer, format, start, len, mayThrow);
+}
+
+sampleCount Sequence::Reader::GetBlockStart(sampleCount position)
+{
+   mHint = mSequence->FindBlock(position, mBlock);
+   return mSequence->mBlock[mHint].start;
+}
+
+BlockFilePtr Sequence::Reader::GetBlockFile(sampleCount position)
+{
+   if (position < 0 || position >= mSequence->mNumSamples)
+      return {};
+   mHint = mSequence->FindBlock(position, mBlock);
+   return mSequence->mBlock[mHint].f;
+}
+
+size_t Sequence::Reader::GetBestBlockSize(sampleCount start)
+{
+   if (start < 0 || start >= mSequence->mNumSamples)
+      return mSequence->mMaxSamples;
+   mHint = mSequence->FindBlock(start, mBlock);
+   return mSequence->GetBestBlockSize(mHint, start);
+}
+
 bool Sequence::Read(samplePtr buffer, sampleFormat format,
                     const SeqBlock &b, size_t blockRelativeStart, size_t len,
-                    bool mayThrow)
+                    bool mayThrow) const
 {
    const auto &f = b.f;
 
    wxASSERT(blockRelativeStart + len <= f->GetLength());
 
+   // Silence is known without reading, or taking room in the cache
+   if (f->IsSilent()) {
+      ClearSamples(buffer, format, 0, len);
+      return true;
+   }
+
+   BlockIOStats::Scope ioScope{ mDirManager->GetIOStats() };
+   BlockIOStats::Add(BlockIOStats::SampleReads);
+
+   // Only float data are cached, so that other formats are never dithered
+   auto &cache = mDirManager->GetBlockCache();
+   if (format == floatSample &&
+       cache.Read(f, (float *)buffer, blockRelativeStart, len))
+      return true;
+   // Samples of the format of the sequence were float exactly, and convert
+   // back so too
+   if (format == mSampleFormat && cache.IsEnabled()) {
+      SampleBuffer floats(len, floatSample);
+      if (cache.Read(f, (float *)floats.ptr(), blockRelativeStart, len)) {
+         CopySamplesNoDither(floats.ptr(), floatSample, buffer, format, len);
+         return true;
+      }
+   }
+
    // Either throws, or of !mayThrow, tells how many were really read
    auto result = f->ReadData(buffer, format, blockRelativeStart, len, mayThrow);
 
@@ -929,6 +1376,22 @@ bool Sequence::Get(int b, samplePtr buffer, sampleFormat format,
    return result;
 }
 
+bool Sequence::IsSilent(sampleCount start, sampleCount len) const
+{
+   if (len <= 0)
+      return true;
+   if (start < 0 || start + len > mNumSamples)
+      return false;
+
+   const auto &blocks = mBlock.Get();
+   const auto end = start + len;
+   for (size_t b = FindBlock(start);
+        b < blocks.size() && blocks[b].start < end; ++b)
+      if (!blocks[b].f->IsSilent())
+         return false;
+   return true;
+}
+
 // Pass NULL to set silence
 void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
                    sampleCount start, sampleCount len)
@@ -948,9 +1411,10 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
       temp.Allocate(tempSize, mSampleFormat);
    }
 
-   int b = FindBlock(start);
+   const int first = FindBlock(start);
+   int b = first;
+   // Only the blocks overwritten are built again
    BlockArray newBlock;
-   std::copy( mBlock.begin(), mBlock.begin() + b, std::back_inserter(newBlock) );
 
    while (len > 0
       // Redundant termination condition,
@@ -959,7 +1423,7 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
       // that cause the loop to make no progress because blen == 0
       && b < (int)size
    ) {
-      newBlock.push_back( mBlock[b] );
+      newBlock.push_back( mBlock.Get()[b] );
       SeqBlock &block = newBlock.back();
       // start is within block
       const auto bstart = ( start - block.start ).as_size_t();
@@ -987,7 +1451,54 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
       // we copy the old block entirely into memory, dereference it,
       // make the change, and then write the NEW block to disk.
 
-      if ( bstart > 0 || blen < fileLength ) {
+      const auto after = bstart + blen;
+      const auto postLen = fileLength - after;
+      // When much of the block is overwritten, the parts of it that are
+      // not, if not small, are kept as slices of it, and not read
+      BlockFilePtr pre, post;
+      if ( blen < fileLength && blen >= mMinSamples ) {
+         if (bstart >= mMinSamples)
+            pre = MakeSlice(block, 0, bstart);
+         if (postLen >= mMinSamples)
+            post = MakeSlice(block, after, postLen);
+      }
+
+      if ( useBuffer && blen < fileLength && blen >= mMinSamples &&
+           (bstart == 0 || pre) && (postLen == 0 || post) ) {
+         // Split the block, writing only the samples given
+         const SeqBlock old = block;
+         newBlock.pop_back();
+         if (pre)
+            newBlock.push_back(SeqBlock(pre, old.start));
+         newBlock.push_back(SeqBlock(
+            mDirManager->NewSimpleBlockFile(useBuffer, blen, mSampleFormat),
+            old.start + bstart));
+         if (post)
+            newBlock.push_back(SeqBlock(post, old.start + after));
+      }
+      else if ( !useBuffer && blen < fileLength && blen >= mMinSamples &&
+           !block.f->IsSilent() ) {
+         // Much of the block is silenced: split it, keeping the silence
+         // as a SilentBlockFile, rather than writing zeroes
+         const SeqBlock old = block;
+         newBlock.pop_back();
+         if ((bstart > 0 && !pre) || (postLen > 0 && !post))
+            Read(scratch.ptr(), mSampleFormat, old, 0, fileLength, true);
+         if (bstart > 0)
+            newBlock.push_back(SeqBlock(
+               pre ? pre : mDirManager->NewSimpleBlockFile(
+                  scratch.ptr(), bstart, mSampleFormat),
+               old.start));
+         newBlock.push_back(SeqBlock(
+            make_blockfile<SilentBlockFile>(blen), old.start + bstart));
+         if (postLen > 0)
+            newBlock.push_back(SeqBlock(
+               post ? post : mDirManager->NewSimpleBlockFile(
+                  scratch.ptr() + after * SAMPLE_SIZE(mSampleFormat),
+                  postLen, mSampleFormat),
+               old.start + after));
+      }
+      else if ( bstart > 0 || blen < fileLength ) {
          // First or last block is only partially overwritten
          Read(scratch.ptr(), mSampleFormat, block, 0, fileLength, true);
 
@@ -1022,9 +1533,7 @@ void Sequence::SetSamples(samplePtr buffer, sampleFormat format,
       b++;
    }
 
-   std::copy( mBlock.begin() + b, mBlock.end(), std::back_inserter(newBlock) );
-
-   CommitChangesIfConsistent( newBlock, mNumSamples, wxT("SetSamples") );
+   SpliceBlocksIfConsistent( first, b, newBlock, 0, wxT("SetSamples") );
 }
 
 namespace {
@@ -1048,6 +1557,9 @@ struct MinMaxSumsq
             sumsq += v * v;
             break;
          case 256:
+         case 1024:
+         case 4096:
+         case 16384:
          case 65536:
             // array holds triples of min, max, and rms values
             v = *pv++;
@@ -1073,6 +1585,8 @@ struct MinMaxSumsq
 bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
                               size_t len, const sampleCount *where) const
 {
+   PROFILE_SCOPE("Sequence::GetWaveDisplay");
+
    wxASSERT(len > 0);
    const auto s0 = std::max(sampleCount(0), where[0]);
    if (s0 >= mNumSamples)
@@ -1084,7 +1598,12 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
    // ... unless the mNumSamples ceiling applies, and then there are other defenses
    const auto s1 =
       std::min(mNumSamples, std::max(1 + where[len - 1], where[len]));
-   Floats temp{ mMaxSamples };
+   BlockIOStats::Scope ioScope{ mDirManager->GetIOStats() };
+   // Scratch for samples or summary triples, grown only as far as some
+   // block needs.  Zoomed out, that is a few triples, not a whole block.
+   // Kept from call to call, so that redrawing allocates nothing here.
+   static thread_local Floats temp;
+   static thread_local size_t tempSize = 0;
 
    decltype(len) pixel = 0;
 
@@ -1127,6 +1646,55 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
                 (whereNext = std::min(s1 - 1, where[nextPixel])) < nextSrcX)
             ++nextPixel;
       }
+      // Zoomed out so far that the block is no wider than a column?  Then
+      // use the extremes and RMS of the whole block, which every BlockFile
+      // keeps in memory, and read nothing, so that the cost of drawing the
+      // whole of a long track does not grow with its number of blocks.
+      // (A block straddling two columns counts in both.)
+      const auto blockLen = seqBlock.f->GetLength();
+      if (srcX == start && nextSrcX == start + blockLen &&
+          seqBlock.f->IsSummaryAvailable() &&
+          (nextPixel == pixel ||
+           ((nextPixel == len ? s1 : whereNext) - whereNow).as_double() /
+              (nextPixel - pixel) >= blockLen)) {
+         const auto results = seqBlock.f->GetMinMaxRMS(false);
+
+         // Samples of the block in the column before pixel
+         const auto before = (nextPixel == pixel)
+            ? blockLen
+            : std::max(sampleCount(0), whereNow - start).as_size_t();
+         if (pixel > 0 && before > 0) {
+            const int lastPixel = pixel - 1;
+            min[lastPixel] = std::min(min[lastPixel], results.min);
+            max[lastPixel] = std::max(max[lastPixel], results.max);
+            const int lastNumSamples = lastRmsDenom * lastDivisor;
+            float &lastRms = rms[lastPixel];
+            lastRms = sqrt(
+               (lastRms * lastRms * lastNumSamples +
+                results.RMS * results.RMS * before) /
+               (lastNumSamples + before)
+            );
+            lastRmsDenom = lastNumSamples + before;
+            lastDivisor = 1;
+         }
+
+         if (nextPixel > pixel) {
+            std::fill(&min[pixel], &min[nextPixel], results.min);
+            std::fill(&max[pixel], &max[nextPixel], results.max);
+            std::fill(&rms[pixel], &rms[nextPixel], results.RMS);
+            std::fill(&bl[pixel], &bl[nextPixel], int(b));
+
+            // Samples of the block in the last column it covers
+            const auto lastStart =
+               std::max(start, std::min(s1 - 1, where[nextPixel - 1]));
+            lastRmsDenom = (nextSrcX - lastStart).as_size_t();
+            lastDivisor = 1;
+            whereNow = whereNext;
+            pixel = nextPixel;
+         }
+         continue;
+      }
+
       if (nextPixel == pixel)
          // The entire block's samples fall within one pixel column.
          // Either it's a rare odd block at the end, or else,
@@ -1139,13 +1707,14 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
       if (nextPixel == len)
          whereNext = s1;
 
-      // Decide the summary level
+      // Decide the summary level: the coarsest, of 256 and every fourfold
+      // up to 64K, whose frames are no wider than a column
       const double samplesPerPixel =
          (whereNext - whereNow).as_double() / (nextPixel - pixel);
-      const int divisor =
-           (samplesPerPixel >= 65536) ? 65536
-         : (samplesPerPixel >= 256) ? 256
-         : 1;
+      int divisor = 1;
+      for (int level = 256; level <= 65536 && samplesPerPixel >= level;
+           level *= 4)
+         divisor = level;
 
       int blockStatus = b;
 
@@ -1171,6 +1740,10 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
          continue;
       }
 
+      const size_t needed = num * (divisor == 1 ? 1 : 3);
+      if (tempSize < needed)
+         temp.reinit(tempSize = needed);
+
       // Read from the block file or its summary
       switch (divisor) {
       default:
@@ -1180,23 +1753,17 @@ bool Sequence::GetWaveDisplay(float *min, float *max, float *rms, int* bl,
          Read((samplePtr)temp.get(), floatSample, seqBlock, startPosition, num, false);
          break;
       case 256:
-         // Read triples
-         //check to see if summary data has been computed
-         if (seqBlock.f->IsSummaryAvailable())
-            // Ignore the return value.
-            // This function fills with zeroes if read fails
-            seqBlock.f->Read256(temp.get(), startPosition, num);
-         else
-            //otherwise, mark the display as not yet computed
-            blockStatus = -1 - b;
-         break;
+      case 1024:
+      case 4096:
+      case 16384:
       case 65536:
          // Read triples
          //check to see if summary data has been computed
          if (seqBlock.f->IsSummaryAvailable())
             // Ignore the return value.
             // This function fills with zeroes if read fails
-            seqBlock.f->Read64K(temp.get(), startPosition, num);
+            seqBlock.f->ReadSummaryLevel(
+               divisor, temp.get(), startPosition, num);
          else
             //otherwise, mark the display as not yet computed
             blockStatus = -1 - b;
@@ -1329,9 +1896,11 @@ void Sequence::Append(samplePtr buffer, sampleFormat format, size_t len)
 
       const auto newLastBlockLen = length + addLen;
 
+      // Let the DirManager write in the background; recording calls this
+      // on the audio thread, which must not wait on the disk
       SeqBlock newLastBlock(
          mDirManager->NewSimpleBlockFile(
-            buffer2.ptr(), newLastBlockLen, mSampleFormat
+            buffer2.ptr(), newLastBlockLen, mSampleFormat, true
          ),
          lastBlock.start
       );
@@ -1351,12 +1920,12 @@ void Sequence::Append(samplePtr buffer, sampleFormat format, size_t len)
       BlockFilePtr pFile;
       if (format == mSampleFormat) {
          pFile = mDirManager->NewSimpleBlockFile(
-            buffer, addedLen, mSampleFormat);
+            buffer, addedLen, mSampleFormat, true);
       }
       else {
          CopySamples(buffer, format, buffer2.ptr(), mSampleFormat, addedLen);
          pFile = mDirManager->NewSimpleBlockFile(
-            buffer2.ptr(), addedLen, mSampleFormat);
+            buffer2.ptr(), addedLen, mSampleFormat, true);
       }
 
       newBlock.push_back(SeqBlock(pFile, newNumSamples));
@@ -1429,6 +1998,33 @@ void Sequence::Delete(sampleCount start, sampleCount len)
    // The maximum size that should ever be needed
    auto scratchSize = mMaxSamples + mMinSamples;
 
+   // Special case: if the samples to DELETE are all within a single
+   // block, and the parts left on either side are each empty or not too
+   // small, keep them as slices of the block, which is not read or written
+   if (b0 == b1) {
+      const SeqBlock &block = mBlock.Get()[b0];
+      const auto blockLen = block.f->GetLength();
+      // start and start + len - 1 are within block
+      const auto pos = ( start - block.start ).as_size_t();
+      const auto after = ( start + len - block.start ).as_size_t();
+      const auto postLen = blockLen - after;
+      BlockFilePtr pre, post;
+      if (pos >= mMinSamples)
+         pre = MakeSlice(block, 0, pos);
+      if (postLen >= mMinSamples)
+         post = MakeSlice(block, after, postLen);
+      if ((pos == 0 || pre) && (postLen == 0 || post)) {
+         BlockArray newBlock;
+         if (pre)
+            newBlock.push_back(SeqBlock(pre, block.start));
+         if (post)
+            newBlock.push_back(SeqBlock(post, start));
+         SpliceBlocksIfConsistent
+            (b0, b0 + 1, newBlock, -len, wxT("Delete slices"));
+         return;
+      }
+   }
+
    // Special case: if the samples to DELETE are all within a single
    // block and the resulting length is not too small, perform the
    // deletion within this block:
@@ -1472,28 +2068,31 @@ void Sequence::Delete(sampleCount start, sampleCount len)
 
       // This consistency check won't throw, it asserts.
       // Proof that we kept consistency is not hard.
-      ConsistencyCheck(wxT("Delete - branch one"), false);
+      ConsistencyCheckChanged(b0, b0 + 1, wxT("Delete - branch one"));
       return;
    }
 
-   // Create a NEW array of blocks
+   // Create a NEW array of only the blocks that replace those from
+   // first through b1
    BlockArray newBlock;
-   newBlock.reserve(numBlocks - (b1 - b0) + 2);
-
-   // Copy the blocks before the deletion point over to
-   // the NEW array
-   newBlock.insert(newBlock.end(), mBlock.begin(), mBlock.begin() + b0);
-   unsigned int i;
+   newBlock.reserve(4);
+   unsigned int first = b0;
 
    // First grab the samples in block b0 before the deletion point
    // into preBuffer.  If this is enough samples for its own block,
-   // or if this would be the first block in the array, write it out.
+   // keep them as a slice of b0, if it can be sliced, else write them out;
+   // write them out too if this would be the first block in the array.
    // Otherwise combine it with the previous block (splitting them
    // 50/50 if necessary).
-   const SeqBlock &preBlock = mBlock[b0];
+   const SeqBlock &preBlock = mBlock.Get()[b0];
    // start is within preBlock
    auto preBufferLen = ( start - preBlock.start ).as_size_t();
-   if (preBufferLen) {
+   BlockFilePtr preSlice;
+   if (preBufferLen >= mMinSamples)
+      preSlice = MakeSlice(preBlock, 0, preBufferLen);
+   if (preSlice)
+      newBlock.push_back(SeqBlock(preSlice, preBlock.start));
+   else if (preBufferLen) {
       if (preBufferLen >= mMinSamples || b0 == 0) {
          if (!scratch.ptr())
             scratch.Allocate(scratchSize, mSampleFormat);
@@ -1504,7 +2103,7 @@ void Sequence::Delete(sampleCount start, sampleCount len)
 
          newBlock.push_back(SeqBlock(pFile, preBlock.start));
       } else {
-         const SeqBlock &prepreBlock = mBlock[b0 - 1];
+         const SeqBlock &prepreBlock = mBlock.Get()[b0 - 1];
          const auto prepreLen = prepreBlock.f->GetLength();
          const auto sum = prepreLen + preBufferLen;
 
@@ -1517,7 +2116,7 @@ void Sequence::Delete(sampleCount start, sampleCount len)
          Read(scratch.ptr() + prepreLen*sampleSize, mSampleFormat,
               preBlock, 0, preBufferLen, true);
 
-         newBlock.pop_back();
+         first = b0 - 1;
          Blockify(*mDirManager, mMaxSamples, mSampleFormat,
                   newBlock, prepreBlock.start, scratch.ptr(), sum);
       }
@@ -1529,15 +2128,21 @@ void Sequence::Delete(sampleCount start, sampleCount len)
 
    // Now, symmetrically, grab the samples in block b1 after the
    // deletion point into postBuffer.  If this is enough samples
-   // for its own block, or if this would be the last block in
-   // the array, write it out.  Otherwise combine it with the
-   // subsequent block (splitting them 50/50 if necessary).
-   const SeqBlock &postBlock = mBlock[b1];
+   // for its own block, slice it, or failing that, or if this would be
+   // the last block in the array, write it out.  Otherwise combine it
+   // with the subsequent block (splitting them 50/50 if necessary).
+   const SeqBlock &postBlock = mBlock.Get()[b1];
    // start + len - 1 lies within postBlock
    const auto postBufferLen = (
        (postBlock.start + postBlock.f->GetLength()) - (start + len)
    ).as_size_t();
-   if (postBufferLen) {
+   BlockFilePtr postSlice;
+   if (postBufferLen >= mMinSamples)
+      postSlice = MakeSlice(postBlock,
+         (start + len - postBlock.start).as_size_t(), postBufferLen);
+   if (postSlice)
+      newBlock.push_back(SeqBlock(postSlice, start));
+   else if (postBufferLen) {
       if (postBufferLen >= mMinSamples || b1 == numBlocks - 1) {
          if (!scratch.ptr())
             // Last use of scratch, can ask for smaller
@@ -1550,7 +2155,7 @@ void Sequence::Delete(sampleCount start, sampleCount len)
 
          newBlock.push_back(SeqBlock(file, start));
       } else {
-         SeqBlock &postpostBlock = mBlock[b1 + 1];
+         const SeqBlock &postpostBlock = mBlock.Get()[b1 + 1];
          const auto postpostLen = postpostBlock.f->GetLength();
          const auto sum = postpostLen + postBufferLen;
 
@@ -1573,20 +2178,43 @@ void Sequence::Delete(sampleCount start, sampleCount len)
       // right on the end of a block.
    }
 
-   // Copy the remaining blocks over from the old array
-   for (i = b1 + 1; i < numBlocks; i++)
-      newBlock.push_back(mBlock[i].Plus(-len));
+   SpliceBlocksIfConsistent
+      (first, b1 + 1, newBlock, -len, wxT("Delete - branch two"));
+}
 
-   CommitChangesIfConsistent
-      (newBlock, mNumSamples - len, wxT("Delete - branch two"));
+bool Sequence::ConsistencyCheck(const wxChar *whereStr, bool mayThrow) const
+{
+   return ConsistencyCheck(
+      mBlock, mMaxSamples, 0, mNumSamples, whereStr, mayThrow);
 }
 
-void Sequence::ConsistencyCheck(const wxChar *whereStr, bool mayThrow) const
+void Sequence::ConsistencyCheckChanged
+   (size_t first, size_t last, const wxChar *whereStr) const
 {
-   ConsistencyCheck(mBlock, mMaxSamples, 0, mNumSamples, whereStr, mayThrow);
+#ifdef CHECK_WHOLE_SEQUENCE
+   ConsistencyCheck(whereStr, false);
+#else
+   // The blocks before first and from last on were consistent before, and
+   // the edit moved those after by the same amount; so it is enough to
+   // check that the changed blocks fit between them
+   const auto &blocks = mBlock.Get();
+   const auto numBlocks = blocks.size();
+   if (first > last || last > numBlocks) {
+      ReportInconsistency(blocks, mNumSamples, __LINE__, whereStr);
+      return;
+   }
+   const auto from = first > 0 ? first - 1 : 0;
+   const auto to = std::min(last + 1, numBlocks);
+   const auto end = to < numBlocks ? blocks[to].start : mNumSamples;
+   BlockArray changed(blocks.begin() + from, blocks.begin() + to);
+   ConsistencyCheckBetween(changed, mMaxSamples,
+      from < numBlocks ? blocks[from].start : mNumSamples, end, whereStr);
+   if (from == 0 && !blocks.empty() && blocks[0].start != 0)
+      ReportInconsistency(blocks, mNumSamples, __LINE__, whereStr);
+#endif
 }
 
-void Sequence::ConsistencyCheck
+bool Sequence::ConsistencyCheck
    (const BlockArray &mBlock, size_t maxSamples, size_t from,
     sampleCount mNumSamples, const wxChar *whereStr,
     bool WXUNUSED(mayThrow))
@@ -1621,21 +2249,56 @@ void Sequence::ConsistencyCheck
       ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
 
    if ( bError )
-   {
-      wxLogError(wxT("*** Consistency check failed at %d after %s. ***"),
-                 ex.GetLine(), whereStr);
-      wxString str;
-      DebugPrintf(mBlock, mNumSamples, &str);
-      wxLogError(wxT("%s"), str);
-      wxLogError(wxT("*** Please report this error to https://forum.audacityteam.org/. ***\n\n")
-                 wxT("Recommended course of action:\n")
-                 wxT("Undo the failed operation(s), then export or save your work and quit."));
-
-      //if (mayThrow)
-         //throw ex;
-      //else
-         wxASSERT(false);
+      ReportInconsistency(mBlock, mNumSamples, ex.GetLine(), whereStr);
+   return !bError;
+}
+
+void Sequence::ConsistencyCheckBetween
+   (const BlockArray &blocks, size_t maxSamples,
+    sampleCount start, sampleCount end, const wxChar *whereStr)
+{
+   bool bError = false;
+   InconsistencyException ex;
+
+   sampleCount pos = start;
+   for (const auto &seqBlock : blocks) {
+      if (pos != seqBlock.start)
+         ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
+      else if (!seqBlock.f)
+         ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
+      else {
+         const auto length = seqBlock.f->GetLength();
+         if (length > maxSamples)
+            ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
+         pos += length;
+      }
+      if (bError)
+         break;
    }
+   if ( !bError && pos != end )
+      ex = CONSTRUCT_INCONSISTENCY_EXCEPTION, bError = true;
+
+   if ( bError )
+      ReportInconsistency(blocks, end, ex.GetLine(), whereStr);
+}
+
+void Sequence::ReportInconsistency
+   (const BlockArray &block, sampleCount numSamples, unsigned line,
+    const wxChar *whereStr)
+{
+   wxLogError(wxT("*** Consistency check failed at %d after %s. ***"),
+              line, whereStr);
+   wxString str;
+   DebugPrintf(block, numSamples, &str);
+   wxLogError(wxT("%s"), str);
+   wxLogError(wxT("*** Please report this error to https://forum.audacityteam.org/. ***\n\n")
+              wxT("Recommended course of action:\n")
+              wxT("Undo the failed operation(s), then export or save your work and quit."));
+
+   //if (mayThrow)
+      //throw ex;
+   //else
+      wxASSERT(false);
 }
 
 void Sequence::CommitChangesIfConsistent
@@ -1646,8 +2309,65 @@ void Sequence::CommitChangesIfConsistent
    // now commit
    // use NOFAIL-GUARANTEE
 
-   mBlock.swap(newBlock);
+   mBlock.Assign(std::move(newBlock));
+   mNumSamples = numSamples;
+}
+
+void Sequence::SpliceBlocksIfConsistent
+   (size_t first, size_t last, BlockArray &newBlocks, sampleCount delta,
+    const wxChar *whereStr)
+{
+   // Blocks first up to last are replaced with newBlocks, and those after
+   // move by delta.  Those before and after are unchanged but for that, so
+   // only the new ones, and how they meet the others, need checking; and
+   // the array is changed in place, not copied, unless it is shared with
+   // some state of the undo history.
+   const auto &oldBlocks = mBlock.Get();
+   const auto numBlocks = oldBlocks.size();
+   if (first > last || last > numBlocks)
+      THROW_INCONSISTENCY_EXCEPTION;
+
+   const auto numSamples = mNumSamples + delta;
+   sampleCount start = 0;
+   if (first > 0) {
+      const auto &prev = oldBlocks[first - 1];
+      start = prev.start + prev.f->GetLength();
+   }
+   const auto end = last < numBlocks
+      ? oldBlocks[last].start + delta
+      : numSamples;
+   ConsistencyCheckBetween
+      (newBlocks, mMaxSamples, start, end, whereStr); // may throw
+
+   auto &blocks = mBlock.GetMutable(); // may throw
+   blocks.reserve(numBlocks - (last - first) + newBlocks.size()); // may throw
+
+   // now commit
+   // use NOFAIL-GUARANTEE; moving a SeqBlock does not throw, and the
+   // capacity is reserved
+
+   const auto overlap = std::min(last - first, newBlocks.size());
+   std::move(newBlocks.begin(), newBlocks.begin() + overlap,
+             blocks.begin() + first);
+   if (overlap < newBlocks.size())
+      blocks.insert(blocks.begin() + first + overlap,
+                    std::make_move_iterator(newBlocks.begin() + overlap),
+                    std::make_move_iterator(newBlocks.end()));
+   else
+      blocks.erase(blocks.begin() + first + overlap,
+                   blocks.begin() + last);
+
+   if (delta != 0)
+      for (auto ii = first + newBlocks.size(), nn = blocks.size();
+           ii < nn; ++ii)
+         blocks[ii].start += delta;
+
    mNumSamples = numSamples;
+   newBlocks.clear();
+
+#ifdef CHECK_WHOLE_SEQUENCE
+   ConsistencyCheck(whereStr, false);
+#endif
 }
 
 void Sequence::AppendBlocksIfConsistent
@@ -1737,6 +2457,13 @@ size_t Sequence::GetMaxDiskBlockSize()
    return sMaxDiskBlockSize;
 }
 
+void Sequence::SetBlockLoader(SharedBlockArray::Loader loader,
+                              sampleCount numSamples)
+{
+   mBlock.SetLoader(std::move(loader));
+   mNumSamples = numSamples;
+}
+
 void Sequence::AppendBlockFile(const BlockFilePtr &blockFile)
 {
    // We assume blockFile has the correct ref count already
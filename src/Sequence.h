@@ -12,6 +12,9 @@
 #define __AUDACITY_SEQUENCE__
 
 #include "MemoryX.h"
+#include <atomic>
+#include <functional>
+#include <mutex>
 #include <vector>
 #include <wx/string.h>
 
@@ -49,6 +52,106 @@ class SeqBlock {
 class BlockArray : public std::vector<SeqBlock> {};
 using BlockPtrArray = std::vector<SeqBlock*>; // non-owning pointers
 
+// The blocks of a Sequence, shared among copies of it, as in the states of
+// the undo history, until one of them changes.  Access through a const
+// reference reads the shared array; any other access first takes a copy
+// of it, unless this is its only owner.
+//
+// The array may instead be given a loader, which fills it at the first
+// access through this or any copy, on whatever thread makes it.
+class SharedBlockArray {
+ public:
+   using value_type = SeqBlock;
+   using const_reference = const SeqBlock &;
+   using Loader = std::function< BlockArray() >;
+
+   SharedBlockArray() : mArray{ std::make_shared<BlockArray>() } {}
+
+   // Replace the contents with what loader will make when first needed
+   void SetLoader(Loader loader)
+   {
+      mArray = std::make_shared<BlockArray>();
+      mLazy = std::make_shared<Lazy>();
+      mLazy->loader = std::move(loader);
+   }
+
+   // False until the loader, if any, has run; doesn't run it
+   bool IsLoaded() const
+   {
+      return !mLazy || mLazy->loaded.load(std::memory_order_acquire);
+   }
+
+   const BlockArray &Get() const { Load(); return *mArray; }
+   // Another owner, which sees the array only as it is now
+   std::shared_ptr<const BlockArray> Share() const { Load(); return mArray; }
+   BlockArray &GetMutable()
+   {
+      Load();
+      if (mArray.use_count() > 1)
+         mArray = std::make_shared<BlockArray>(*mArray);
+      else
+         // Other owners may have let go on other threads
+         std::atomic_thread_fence(std::memory_order_acquire);
+      return *mArray;
+   }
+
+   operator const BlockArray &() const { return Get(); }
+   operator BlockArray &() { return GetMutable(); }
+
+   size_t size() const { return Get().size(); }
+   bool empty() const { return Get().empty(); }
+
+   BlockArray::const_iterator begin() const { return Get().begin(); }
+   BlockArray::const_iterator end() const { return Get().end(); }
+   BlockArray::iterator begin() { return GetMutable().begin(); }
+   BlockArray::iterator end() { return GetMutable().end(); }
+
+   const SeqBlock &operator [] (size_t ii) const { return Get()[ii]; }
+   SeqBlock &operator [] (size_t ii) { return GetMutable()[ii]; }
+   const SeqBlock &back() const { return Get().back(); }
+   SeqBlock &back() { return GetMutable().back(); }
+
+   void push_back(const SeqBlock &block) { GetMutable().push_back(block); }
+   void pop_back() { GetMutable().pop_back(); }
+   void reserve(size_t size) { GetMutable().reserve(size); }
+   void resize(size_t size) { GetMutable().resize(size); }
+
+   // Take the contents of blocks, leaving it empty; doesn't throw when
+   // this is the only owner of the array
+   void Assign(BlockArray &&blocks)
+   {
+      mLazy.reset();
+      if (mArray.use_count() > 1)
+         mArray = std::make_shared<BlockArray>(std::move(blocks));
+      else {
+         std::atomic_thread_fence(std::memory_order_acquire);
+         mArray->swap(blocks);
+      }
+      blocks.clear();
+   }
+
+ private:
+   struct Lazy {
+      std::once_flag once;
+      Loader loader;
+      std::atomic<bool> loaded{ false };
+   };
+
+   void Load() const
+   {
+      if (mLazy)
+         std::call_once(mLazy->once, [this]{
+            *mArray = mLazy->loader();
+            mLazy->loaded.store(true, std::memory_order_release);
+         });
+   }
+
+   std::shared_ptr<BlockArray> mArray;
+   // Shared with the array, so that a copy made before loading sees what
+   // any other copy loads
+   std::shared_ptr<Lazy> mLazy;
+};
+
 class PROFILE_DLL_API Sequence final {
  public:
 
@@ -56,6 +159,8 @@ class PROFILE_DLL_API Sequence final {
    // Static methods
    //
 
+   // The block size in bytes of projects, unless DirManager calibrates
+   // its own; see DirManager::GetMaxDiskBlockSize()
    static void SetMaxDiskBlockSize(size_t bytes);
    static size_t GetMaxDiskBlockSize();
 
@@ -85,6 +190,10 @@ class PROFILE_DLL_API Sequence final {
    bool Get(samplePtr buffer, sampleFormat format,
             sampleCount start, size_t len, bool mayThrow) const;
 
+   // True if the samples from start, for len, lie all in silent blocks,
+   // so that there is nothing to read
+   bool IsSilent(sampleCount start, sampleCount len) const;
+
    // Note that len is not size_t, because nullptr may be passed for buffer, in
    // which case, silence is inserted, possibly a large amount.
    void SetSamples(samplePtr buffer, sampleFormat format,
@@ -102,6 +211,14 @@ class PROFILE_DLL_API Sequence final {
 
    // Return non-null, or else throw!
    std::unique_ptr<Sequence> Copy(sampleCount s0, sampleCount s1) const;
+   // The same, but holding only the blocks that the range touches until
+   // its own are first needed, when Copy() makes them.  For cut lines,
+   // most of which are never expanded.
+   std::unique_ptr<Sequence> CopyWhenNeeded
+      (sampleCount s0, sampleCount s1) const;
+   // A copy sharing all the block files, even locked ones, cheaply; meant
+   // only for reading, as on another thread while this sequence changes
+   std::unique_ptr<Sequence> Snapshot() const;
    void Paste(sampleCount s0, const Sequence *src);
 
    size_t GetIdealAppendLen() const;
@@ -128,6 +245,14 @@ class PROFILE_DLL_API Sequence final {
    void SetSilence(sampleCount s0, sampleCount len);
    void InsertSilence(sampleCount s0, sampleCount len);
 
+   // Merge runs of blocks shorter than fraction of the maximum block size
+   // into blocks of the ideal size, looking at no more than maxBlocks of
+   // them; the samples are unchanged.  Alias blocks, silent blocks, and
+   // blocks still waiting on on-demand loading, are left alone.  Slices
+   // of blocks are rewritten as blocks of their own, however long.
+   // Returns the number of old blocks that were replaced.
+   size_t Compact(double fraction, size_t maxBlocks);
+
    const std::shared_ptr<DirManager> &GetDirManager() { return mDirManager; }
 
    //
@@ -167,17 +292,55 @@ class PROFILE_DLL_API Sequence final {
    // This returns a possibly large or negative value
    sampleCount GetBlockStart(sampleCount position) const;
 
+   // The block containing position, or null if out of range
+   BlockFilePtr GetBlockFile(sampleCount position) const;
+
    // These return a nonnegative number of samples meant to size a memory buffer
    size_t GetBestBlockSize(sampleCount start) const;
    size_t GetMaxBlockSize() const;
    size_t GetIdealBlockSize() const;
 
+   // Does the same lookups as the methods above, but remembers the block
+   // found last, so that reads marching forward through the sequence, as
+   // for playback and export, find the next block without a search.  A seek
+   // elsewhere falls back to FindBlock().  The remembered block is only a
+   // hint, checked before use, so a Reader stays correct (if slower) when
+   // the sequence is edited, but it must not outlive the sequence.
+   class Reader {
+   public:
+      Reader() {}
+      explicit Reader(const Sequence *sequence) : mSequence{ sequence } {}
+
+      const Sequence *GetSequence() const { return mSequence; }
+      void Reset(const Sequence *sequence)
+         { mSequence = sequence; mHint = 0; }
+
+      bool Get(samplePtr buffer, sampleFormat format,
+               sampleCount start, size_t len, bool mayThrow);
+      sampleCount GetBlockStart(sampleCount position);
+      BlockFilePtr GetBlockFile(sampleCount position);
+      size_t GetBestBlockSize(sampleCount start);
+
+   private:
+      const Sequence *mSequence {};
+      int mHint { 0 };
+   };
+
    //
    // This should only be used if you really, really know what
    // you're doing!
    //
 
-   BlockArray &GetBlockArray() {return mBlock;}
+   BlockArray &GetBlockArray() {return mBlock.GetMutable();}
+   const BlockArray &GetBlockArray() const {return mBlock.Get();}
+   std::shared_ptr<const BlockArray> ShareBlockArray() const
+      {return mBlock.Share();}
+
+   // Let loader make the blocks when they are first needed; numSamples
+   // must be the sum of their lengths.  For opening projects quickly.
+   void SetBlockLoader(SharedBlockArray::Loader loader, sampleCount numSamples);
+   // False while the loader given above has not yet run
+   bool IsBlockArrayLoaded() const {return mBlock.IsLoaded();}
 
    ///
    void LockDeleteUpdateMutex(){mDeleteUpdateMutex.Lock();}
@@ -212,7 +375,7 @@ class PROFILE_DLL_API Sequence final {
 
    std::shared_ptr<DirManager> mDirManager;
 
-   BlockArray    mBlock;
+   SharedBlockArray mBlock;
    sampleFormat  mSampleFormat;
 
    // Not size_t!  May need to be large:
@@ -229,14 +392,30 @@ class PROFILE_DLL_API Sequence final {
    //
 
    int FindBlock(sampleCount pos) const;
+   // Tries block hint and its successor before searching
+   int FindBlock(sampleCount pos, int hint) const;
+
+   size_t GetBestBlockSize(int b, sampleCount start) const;
 
    static void AppendBlock
       (DirManager &dirManager,
        BlockArray &blocks, sampleCount &numSamples, const SeqBlock &b);
 
-   static bool Read(samplePtr buffer, sampleFormat format,
+   // The block file to put in a sequence of dirManager, for one pasted
+   // from another sequence
+   static BlockFilePtr PasteBlockFile
+      (DirManager &dirManager, const BlockFilePtr &file);
+
+   // A block for samples start through start + len of block, made with no
+   // reading or writing: the block itself, silence, or a SliceBlockFile;
+   // null if the kind of block can't be sliced
+   BlockFilePtr MakeSlice
+      (const SeqBlock &block, size_t start, size_t len) const;
+
+   // Float reads go through the DirManager's BlockCache
+   bool Read(samplePtr buffer, sampleFormat format,
              const SeqBlock &b,
-             size_t blockRelativeStart, size_t len, bool mayThrow);
+             size_t blockRelativeStart, size_t len, bool mayThrow) const;
 
    // Accumulate NEW block files onto the end of a block array.
    // Does not change this sequence.  The intent is to use
@@ -248,6 +427,11 @@ class PROFILE_DLL_API Sequence final {
    bool Get(int b, samplePtr buffer, sampleFormat format,
       sampleCount start, size_t len, bool mayThrow) const;
 
+   // A copy of src split into blocks no longer than this sequence allows,
+   // as after a paste from a project with larger blocks; null if src needs
+   // no splitting
+   std::unique_ptr<Sequence> Reblocked(const Sequence &src) const;
+
 public:
 
    //
@@ -255,8 +439,10 @@ public:
    //
 
    // This function throws if the track is messed up
-   // because of inconsistent block starts & lengths
-   void ConsistencyCheck (const wxChar *whereStr, bool mayThrow = true) const;
+   // because of inconsistent block starts & lengths.  It walks the whole
+   // block array; edits check only what they change, but for debug builds.
+   // Returns whether the sequence is consistent.
+   bool ConsistencyCheck (const wxChar *whereStr, bool mayThrow = true) const;
 
    // This function prints information to stdout about the blocks in the
    // tracks and indicates if there are inconsistencies.
@@ -264,12 +450,28 @@ public:
       (const BlockArray &block, sampleCount numSamples, wxString *dest);
 
 private:
-   static void ConsistencyCheck
+   static bool ConsistencyCheck
       (const BlockArray &block, size_t maxSamples, size_t from,
        sampleCount numSamples, const wxChar *whereStr,
        bool mayThrow = true);
 
-   // The next two are used in methods that give a strong guarantee.
+   // After an edit in place of the blocks from first up to last, checks
+   // them and how they meet their neighbours, or in debug builds, the
+   // whole sequence.  Asserts, and does not throw.
+   void ConsistencyCheckChanged
+      (size_t first, size_t last, const wxChar *whereStr) const;
+
+   // Checks blocks that are to lie, one after another, from sample start
+   // to sample end of the sequence
+   static void ConsistencyCheckBetween
+      (const BlockArray &blocks, size_t maxSamples,
+       sampleCount start, sampleCount end, const wxChar *whereStr);
+
+   static void ReportInconsistency
+      (const BlockArray &block, sampleCount numSamples, unsigned line,
+       const wxChar *whereStr);
+
+   // The next three are used in methods that give a strong guarantee.
    // They either throw because final consistency check fails, or swap the
    // changed contents into place.
 
@@ -280,6 +482,13 @@ private:
       (BlockArray &additionalBlocks, bool replaceLast,
        sampleCount numSamples, const wxChar *whereStr);
 
+   // Replaces the blocks from first up to last with newBlocks, leaving it
+   // empty, and moves the start of each later block by delta; the work is
+   // in proportion to the blocks after first, not to the whole array
+   void SpliceBlocksIfConsistent
+      (size_t first, size_t last, BlockArray &newBlocks, sampleCount delta,
+       const wxChar *whereStr);
+
 };
 
 #endif // __AUDACITY_SEQUENCE__
@@ -66,6 +66,32 @@ SnapManager::~SnapManager()
 {
 }
 
+namespace {
+
+// The boundaries of the clips of all tracks, sorted, and filtered to the
+// time grid, as the last SnapManager found them.  Kept until the tracks
+// or the grid change, so that a drag does not collect and format them all
+// again; the exclusions of each drag are left out in the copy it takes.
+struct SnapIndex
+{
+   struct Entry
+   {
+      SnapPoint point;
+      const WaveClip *clip;
+   };
+
+   const TrackList *tracks{};
+   unsigned long generation{};
+   bool snapToTime{};
+   double rate{};
+   wxString format;
+   std::vector<Entry> entries;
+};
+
+SnapIndex sSnapIndex;
+
+}
+
 void SnapManager::Reinit()
 {
    int snapTo = mProject->GetSnapTo();
@@ -96,55 +122,73 @@ void SnapManager::Reinit()
       mConverter.SetFormatName(mFormat);
    }
 
-   // Add a SnapPoint at t=0
-   mSnapPoints.push_back(SnapPoint{});
+   auto &index = sSnapIndex;
+   // Generations are never shared by two lists, so a list made where a
+   // destroyed one was cannot match
+   const auto generation = mTracks->GetContentGeneration();
+   if (index.tracks != mTracks || index.generation != generation ||
+       index.snapToTime != mSnapToTime ||
+       (mSnapToTime && (index.rate != mRate || index.format != mFormat)))
+   {
+      index.tracks = mTracks;
+      index.generation = generation;
+      index.snapToTime = mSnapToTime;
+      index.rate = mRate;
+      index.format = mFormat;
+      index.entries.clear();
+
+      // Add a SnapPoint at t=0
+      index.entries.push_back({ SnapPoint{}, nullptr });
+
+      TrackListConstIterator iter(mTracks);
+      for (const Track *track = iter.First();  track; track = iter.Next())
+      {
+         if (track->GetKind() == Track::Wave)
+         {
+            auto waveTrack = static_cast<const WaveTrack *>(track);
+            for (const auto &clip: waveTrack->GetClips())
+            {
+               CondListAdd(clip->GetStartTime(), waveTrack, clip.get());
+               CondListAdd(clip->GetEndTime(), waveTrack, clip.get());
+            }
+         }
+      }
+
+      // Sort all by time
+      std::stable_sort(index.entries.begin(), index.entries.end(),
+         [](const SnapIndex::Entry &a, const SnapIndex::Entry &b)
+            { return a.point < b.point; });
+   }
 
-   TrackListConstIterator iter(mTracks);
-   for (const Track *track = iter.First();  track; track = iter.Next())
+   // Copy, in order, all but the points of excluded tracks and clips
+   mSnapPoints.reserve(index.entries.size());
+   for (const auto &entry : index.entries)
    {
-      if (mTrackExclusions &&
+      const auto track = entry.point.track;
+      if (track && mTrackExclusions &&
           mTrackExclusions->end() !=
           std::find(mTrackExclusions->begin(), mTrackExclusions->end(), track))
       {
          continue;
       }
 
-      if (track->GetKind() == Track::Wave)
+      if (entry.clip && mClipExclusions &&
+          mClipExclusions->end() !=
+          std::find_if(mClipExclusions->begin(), mClipExclusions->end(),
+             [&](const TrackClip &trackClip)
+                { return trackClip.track == track &&
+                         trackClip.clip == entry.clip; }))
       {
-         auto waveTrack = static_cast<const WaveTrack *>(track);
-         for (const auto &clip: waveTrack->GetClips())
-         {
-            if (mClipExclusions)
-            {
-               bool skip = false;
-               for (size_t j = 0, cnt = mClipExclusions->size(); j < cnt; ++j)
-               {
-                  if ((*mClipExclusions)[j].track == waveTrack &&
-                      (*mClipExclusions)[j].clip == clip.get())
-                  {
-                     skip = true;
-                     break;
-                  }
-               }
-
-               if (skip)
-               {
-                  continue;
-               }
-            }
-
-            CondListAdd(clip->GetStartTime(), waveTrack);
-            CondListAdd(clip->GetEndTime(), waveTrack);
-         }
+         continue;
       }
-   }
 
-   // Sort all by time
-   std::sort(mSnapPoints.begin(), mSnapPoints.end());
+      mSnapPoints.push_back(entry.point);
+   }
 }
 
-// Adds to mSnapPoints, filtering by TimeConverter
-void SnapManager::CondListAdd(double t, const Track *track)
+// Adds to the index, filtering by TimeConverter
+void SnapManager::CondListAdd
+(double t, const Track *track, const WaveClip *clip)
 {
    if (mSnapToTime)
    {
@@ -153,7 +197,7 @@ void SnapManager::CondListAdd(double t, const Track *track)
 
    if (!mSnapToTime || mConverter.GetValue() == t)
    {
-      mSnapPoints.push_back(SnapPoint{ t, track });
+      sSnapIndex.entries.push_back({ SnapPoint{ t, track }, clip });
    }
 }
 
@@ -170,30 +214,16 @@ wxInt64 SnapManager::PixelDiff(double t, size_t index)
                    mZoomInfo->TimeToPosition(Get(index), 0));
 }
 
-// Find the index where this SnapPoint should go in
-// sorted order, between i0 (inclusive) and i1 (exclusive).
-size_t SnapManager::Find(double t, size_t i0, size_t i1)
-{
-   if (i1 <= i0 + 1)
-   {
-      return i0;
-   }
-
-   size_t half = (i0 + i1) / 2;
-
-   if (t < Get(half))
-   {
-      return Find(t, i0, half);
-   }
-
-   return Find(t, half, i1);
-}
-
 // Find the SnapPoint nearest to time t
 size_t SnapManager::Find(double t)
 {
    size_t cnt = mSnapPoints.size();
-   size_t index = Find(t, 0, cnt);
+
+   // The last point not after t, or the first if none is
+   auto found = std::upper_bound(mSnapPoints.begin(), mSnapPoints.end(), t,
+      [](double time, const SnapPoint &point){ return time < point.t; });
+   size_t index =
+      found == mSnapPoints.begin() ? 0 : (found - mSnapPoints.begin()) - 1;
 
    // At this point, either index is the closest, or the next one
    // to the right is.  Keep moving to the right until we get a
@@ -110,10 +110,9 @@ public:
 private:
 
    void Reinit();
-   void CondListAdd(double t, const Track *track);
+   void CondListAdd(double t, const Track *track, const WaveClip *clip);
    double Get(size_t index);
    wxInt64 PixelDiff(double t, size_t index);
-   size_t Find(double t, size_t i0, size_t i1);
    size_t Find(double t);
    bool SnapToPoints(Track *currentTrack, double t, bool rightEdge, double *outT);
 
@@ -320,6 +320,12 @@ void ThemeBase::LoadTheme( teThemeType Theme )
 
 void ThemeBase::RecolourBitmap( int iIndex, wxColour From, wxColour To )
 {
+   if( mImagePending[iIndex] ){
+      // Recoloured when it is cut
+      mRecolours[iIndex] = { From, To };
+      return;
+   }
+
    wxImage Image( Bitmap( iIndex ).ConvertToImage() );
 
    std::unique_ptr<wxImage> pResult = ChangeImageColour(
@@ -436,19 +442,11 @@ void ThemeBase::RegisterImage( int &iIndex, const wxImage &Image, const wxString
 {
    wxASSERT( iIndex == -1 ); // Don't initialise same bitmap twice!
    mImages.push_back( Image );
-
-#ifdef __APPLE__
-   // On Mac, bitmaps with alpha don't work.
-   // So we convert to a mask and use that.
-   // It isn't quite as good, as alpha gives smoother edges.
-   //[Does not affect the large control buttons, as for those we do
-   // the blending ourselves anyway.]
-   wxImage TempImage( Image );
-   TempImage.ConvertAlphaToMask();
-   mBitmaps.push_back( wxBitmap( TempImage ) );
-#else
-   mBitmaps.push_back( wxBitmap( Image ) );
-#endif
+   // Made when first used
+   mBitmaps.push_back( wxBitmap() );
+   mImageRects.push_back( wxRect() );
+   mImagePending.push_back( false );
+   mBitmapPending.push_back( true );
 
    mBitmapNames.Add( Name );
    mBitmapFlags.push_back( mFlow.mFlags );
@@ -618,7 +616,7 @@ const int ImageCacheHeight = 836;
 
 void ThemeBase::CreateImageCache( bool bBinarySave )
 {
-   EnsureInitialised();
+   EnsureAllImages();
    wxBusyCursor busy;
 
    wxImage ImageCache( ImageCacheWidth, ImageCacheHeight );
@@ -753,7 +751,7 @@ void ThemeBase::CreateImageCache( bool bBinarySave )
 /// Very handy for seeing what each part is for.
 void ThemeBase::WriteImageMap( )
 {
-   EnsureInitialised();
+   EnsureAllImages();
    wxBusyCursor busy;
 
    int i;
@@ -806,7 +804,7 @@ void ThemeBase::WriteImageMap( )
 /// Writes a series of Macro definitions that can be used in the include file.
 void ThemeBase::WriteImageDefs( )
 {
-   EnsureInitialised();
+   EnsureAllImages();
    wxBusyCursor busy;
 
    int i;
@@ -955,7 +953,8 @@ bool ThemeBase::ReadImageCache( teThemeType type, bool bOkIfNotFound)
    int i;
    mFlow.Init(ImageCacheWidth);
    mFlow.mBorderWidth = 1;
-   // Load the bitmaps
+   mRecolours.clear();
+   // Find the bitmaps; EnsureImage() cuts each one out when first used
    for(i = 0; i < (int)mImages.size(); i++)
    {
       wxImage &Image = mImages[i];
@@ -964,8 +963,10 @@ bool ThemeBase::ReadImageCache( teThemeType type, bool bOkIfNotFound)
       {
          mFlow.GetNextPosition( Image.GetWidth(),Image.GetHeight() );
          //      wxLogDebug(wxT("Copy at %i %i (%i,%i)"), mxPos, myPos, xWidth1, yHeight1 );
-         Image = GetSubImageWithAlpha( ImageCache, mFlow.RectInner() );
-         mBitmaps[i] = wxBitmap(Image);
+         mImageRects[i] = mFlow.RectInner();
+         if( !mImagePending[i] )
+            ++mnImagesPending;
+         mImagePending[i] = true;
       }
    }
 
@@ -995,11 +996,16 @@ bool ThemeBase::ReadImageCache( teThemeType type, bool bOkIfNotFound)
             mColours[i] = TempColour;
       }
    }
+
+   // Kept until every image is cut from it
+   mImageCache = mnImagesPending > 0 ? ImageCache : wxImage();
    return true;
 }
 
 void ThemeBase::LoadComponents( bool bOkIfNotFound )
 {
+   EnsureAllImages();
+
    // IF directory doesn't exist THEN return early.
    if( !wxDirExists( FileNames::ThemeComponentsDir() ))
       return;
@@ -1050,6 +1056,8 @@ void ThemeBase::LoadComponents( bool bOkIfNotFound )
 
 void ThemeBase::SaveComponents()
 {
+   EnsureAllImages();
+
    // IF directory doesn't exist THEN create it
    if( !wxDirExists( FileNames::ThemeComponentsDir() ))
    {
@@ -1157,10 +1165,57 @@ void ThemeBase::SetPenColour(   wxPen & Pen, int iIndex )
    Pen.SetColour( Colour( iIndex ));
 }
 
+void ThemeBase::EnsureImage( int iIndex )
+{
+   if( mImagePending[iIndex] )
+   {
+      wxImage &Image = mImages[iIndex];
+      Image = GetSubImageWithAlpha( mImageCache, mImageRects[iIndex] );
+      auto found = mRecolours.find( iIndex );
+      if( found != mRecolours.end() )
+      {
+         std::unique_ptr<wxImage> pResult = ChangeImageColour(
+            &Image, found->second.first, found->second.second );
+         Image = *pResult;
+         mRecolours.erase( found );
+      }
+      mBitmaps[iIndex] = wxBitmap( Image );
+      mImagePending[iIndex] = false;
+      mBitmapPending[iIndex] = false;
+      if( --mnImagesPending == 0 )
+         mImageCache = wxImage();
+   }
+   else if( mBitmapPending[iIndex] )
+   {
+      const wxImage &Image = mImages[iIndex];
+#ifdef __APPLE__
+      // On Mac, bitmaps with alpha don't work.
+      // So we convert to a mask and use that.
+      // It isn't quite as good, as alpha gives smoother edges.
+      //[Does not affect the large control buttons, as for those we do
+      // the blending ourselves anyway.]
+      wxImage TempImage( Image );
+      TempImage.ConvertAlphaToMask();
+      mBitmaps[iIndex] = wxBitmap( TempImage );
+#else
+      mBitmaps[iIndex] = wxBitmap( Image );
+#endif
+      mBitmapPending[iIndex] = false;
+   }
+}
+
+void ThemeBase::EnsureAllImages()
+{
+   EnsureInitialised();
+   for( int i = 0; i < (int)mImages.size(); i++ )
+      EnsureImage( i );
+}
+
 wxBitmap & ThemeBase::Bitmap( int iIndex )
 {
    wxASSERT( iIndex >= 0 );
    EnsureInitialised();
+   EnsureImage( iIndex );
    return mBitmaps[iIndex];
 }
 
@@ -1168,6 +1223,7 @@ wxImage  & ThemeBase::Image( int iIndex )
 {
    wxASSERT( iIndex >= 0 );
    EnsureInitialised();
+   EnsureImage( iIndex );
    return mImages[iIndex];
 }
 wxSize  ThemeBase::ImageSize( int iIndex )
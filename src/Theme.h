@@ -16,6 +16,7 @@
 
 #include "Audacity.h"
 
+#include <map>
 #include <vector>
 #include <wx/wx.h>
 #include <wx/bitmap.h>
@@ -142,12 +143,26 @@ public:
    wxImage MakeImageWithAlpha( wxBitmap & Bmp );
 
 protected:
+   // Cut the image from the cache, and make its bitmap, if not yet done
+   void EnsureImage( int iIndex );
+   void EnsureAllImages();
+
    // wxImage, wxBitmap copy cheaply using reference counting
    std::vector<wxImage> mImages;
    std::vector<wxBitmap> mBitmaps;
    wxArrayString mBitmapNames;
    std::vector<int> mBitmapFlags;
 
+   // ReadImageCache() only finds where each image is.  The image is cut
+   // from mImageCache, recoloured, and made into a bitmap at first use, so
+   // that images never shown cost nothing at startup.
+   wxImage mImageCache;
+   std::vector<wxRect> mImageRects;
+   std::vector<char> mImagePending;   // to be cut from mImageCache
+   std::vector<char> mBitmapPending;  // to be made from mImages
+   size_t mnImagesPending { 0 };
+   std::map<int, std::pair<wxColour, wxColour>> mRecolours;
+
    std::vector<wxColour> mColours;
    wxArrayString mColourNames;
    FlowPacker mFlow;
@@ -0,0 +1,208 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   ThreadPriority.cpp
+
+*******************************************************************//**
+
+\file ThreadPriority.cpp
+\brief Real-time scheduling, processor affinity and memory locking for
+the audio thread and the mixing helpers.
+
+Under load, the threads of the interface and of on-demand loading could
+take the processor from the audio thread long enough for the ring
+buffers to run dry.  With real-time scheduling, only the device's own
+callback and the kernel come before it.  On Linux the priority is a
+quarter of the way up the SCHED_FIFO range, below that of the callback
+threads of JACK and ALSA.  On Windows, avrt.dll is loaded when first
+needed, as it is missing from some older systems.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "ThreadPriority.h"
+
+#include <algorithm>
+
+#include <wx/defs.h>
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#elif defined(__WXMAC__)
+#include <pthread.h>
+#include <sys/mman.h>
+#include <mach/mach.h>
+#include <mach/mach_time.h>
+#include <mach/thread_policy.h>
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#if defined(__WXMSW__)
+
+namespace {
+
+using SetCharacteristics = HANDLE (WINAPI *)(LPCWSTR, LPDWORD);
+using RevertCharacteristics = BOOL (WINAPI *)(HANDLE);
+
+struct Avrt {
+   Avrt()
+   {
+      module = LoadLibraryW(L"avrt.dll");
+      if (module) {
+         set = (SetCharacteristics)
+            GetProcAddress(module, "AvSetMmThreadCharacteristicsW");
+         revert = (RevertCharacteristics)
+            GetProcAddress(module, "AvRevertMmThreadCharacteristics");
+      }
+   }
+   HMODULE module { nullptr };
+   SetCharacteristics set { nullptr };
+   RevertCharacteristics revert { nullptr };
+};
+
+const Avrt &GetAvrt()
+{
+   static Avrt avrt;
+   return avrt;
+}
+
+// The MMCSS task of the calling thread, if it joined one
+thread_local HANDLE sTask = nullptr;
+
+}
+
+bool SetThreadRealTime(bool realTime, double WXUNUSED(periodSecs))
+{
+   const auto &avrt = GetAvrt();
+   if (!realTime) {
+      if (sTask && avrt.revert)
+         avrt.revert(sTask);
+      sTask = nullptr;
+      return SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_NORMAL) != 0;
+   }
+
+   if (!sTask && avrt.set) {
+      DWORD taskIndex = 0;
+      sTask = avrt.set(L"Pro Audio", &taskIndex);
+   }
+   if (sTask)
+      return true;
+   // Without MMCSS, the most a process of normal class may have
+   return SetThreadPriority(GetCurrentThread(),
+                            THREAD_PRIORITY_TIME_CRITICAL) != 0;
+}
+
+bool PinThreadToCPU(int cpu)
+{
+   DWORD_PTR processMask = 0, systemMask = 0;
+   if (!GetProcessAffinityMask(GetCurrentProcess(), &processMask, &systemMask))
+      return false;
+   DWORD_PTR mask = processMask;
+   if (cpu >= 0) {
+      if (cpu >= (int)(8 * sizeof(DWORD_PTR)))
+         return false;
+      mask &= DWORD_PTR(1) << cpu;
+   }
+   return mask && SetThreadAffinityMask(GetCurrentThread(), mask) != 0;
+}
+
+bool LockMemory(const void *start, size_t bytes)
+{
+   return bytes == 0 || VirtualLock(const_cast<void*>(start), bytes) != 0;
+}
+
+void UnlockMemory(const void *start, size_t bytes)
+{
+   if (bytes > 0)
+      VirtualUnlock(const_cast<void*>(start), bytes);
+}
+
+#else
+
+#if defined(__WXMAC__)
+
+bool SetThreadRealTime(bool realTime, double periodSecs)
+{
+   const auto thread = pthread_mach_thread_np(pthread_self());
+   if (!realTime) {
+      thread_standard_policy_data_t policy {};
+      return thread_policy_set(thread, THREAD_STANDARD_POLICY,
+         (thread_policy_t)&policy, THREAD_STANDARD_POLICY_COUNT) ==
+         KERN_SUCCESS;
+   }
+
+   mach_timebase_info_data_t timebase;
+   mach_timebase_info(&timebase);
+   const double ticksPerSec = 1e9 * timebase.denom / timebase.numer;
+   // The kernel refuses constraints much longer than this
+   const double period = std::max(0.001, std::min(0.05, periodSecs));
+
+   thread_time_constraint_policy_data_t policy;
+   policy.period = (uint32_t)(period * ticksPerSec);
+   policy.computation = policy.period / 4;
+   policy.constraint = policy.period;
+   policy.preemptible = true;
+   return thread_policy_set(thread, THREAD_TIME_CONSTRAINT_POLICY,
+      (thread_policy_t)&policy, THREAD_TIME_CONSTRAINT_POLICY_COUNT) ==
+      KERN_SUCCESS;
+}
+
+bool PinThreadToCPU(int cpu)
+{
+   // Threads of one nonzero tag share a processor, if the kernel agrees
+   thread_affinity_policy_data_t policy { cpu >= 0 ? cpu + 1 : 0 };
+   return thread_policy_set(pthread_mach_thread_np(pthread_self()),
+      THREAD_AFFINITY_POLICY, (thread_policy_t)&policy,
+      THREAD_AFFINITY_POLICY_COUNT) == KERN_SUCCESS;
+}
+
+#else
+
+bool SetThreadRealTime(bool realTime, double WXUNUSED(periodSecs))
+{
+   sched_param param {};
+   int policy = SCHED_OTHER;
+   if (realTime) {
+      policy = SCHED_FIFO;
+      const int low = sched_get_priority_min(SCHED_FIFO);
+      const int high = sched_get_priority_max(SCHED_FIFO);
+      param.sched_priority = low + (high - low) / 4;
+   }
+   return pthread_setschedparam(pthread_self(), policy, &param) == 0;
+}
+
+bool PinThreadToCPU(int cpu)
+{
+   const long count = sysconf(_SC_NPROCESSORS_CONF);
+   if (cpu >= count || cpu >= CPU_SETSIZE)
+      return false;
+
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   if (cpu >= 0)
+      CPU_SET(cpu, &set);
+   else
+      for (long ii = 0; ii < std::min<long>(count, CPU_SETSIZE); ++ii)
+         CPU_SET(ii, &set);
+   return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
+
+#endif
+
+bool LockMemory(const void *start, size_t bytes)
+{
+   return bytes == 0 || mlock(start, bytes) == 0;
+}
+
+void UnlockMemory(const void *start, size_t bytes)
+{
+   if (bytes > 0)
+      munlock(start, bytes);
+}
+
+#endif
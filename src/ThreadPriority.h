@@ -0,0 +1,36 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   ThreadPriority.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_THREAD_PRIORITY__
+#define __AUDACITY_THREAD_PRIORITY__
+
+#include "Audacity.h"
+
+#include <stddef.h>
+
+/// Scheduling of the threads that must keep up with the audio device,
+/// each as the system offers it: SCHED_FIFO on Linux, the "Pro Audio"
+/// task of MMCSS on Windows, and the time constraint policy on the Mac.
+/// Each call acts on the calling thread, and returns false if the system
+/// refused, as when the user may not raise priorities; the thread then
+/// runs as before.
+
+/// Raise the calling thread to real-time scheduling, for work done about
+/// every periodSecs, or, if not realTime, put it back to normal
+bool SetThreadRealTime(bool realTime, double periodSecs);
+
+/// Run the calling thread on the one processor only, or, if cpu is
+/// negative, on any.  Only a hint on the Mac.
+bool PinThreadToCPU(int cpu);
+
+/// Keep the pages of a buffer in physical memory, so that the threads
+/// filling and draining it never wait for them to be paged in
+bool LockMemory(const void *start, size_t bytes);
+void UnlockMemory(const void *start, size_t bytes);
+
+#endif
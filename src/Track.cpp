@@ -22,6 +22,7 @@ Classes derived form it include the WaveTrack, NoteTrack.
 
 #include <algorithm>
 #include <numeric>
+#include <unordered_set>
 #include "Track.h"
 
 #include <float.h>
@@ -94,7 +95,11 @@ void Track::Init(const Track &orig)
 
 void Track::SetSelected(bool s)
 {
-   mSelected = s;
+   if (mSelected != s) {
+      mSelected = s;
+      if (auto pList = mList.lock())
+         pList->SelectionChanged(*this, !s);
+   }
 }
 
 void Track::Merge(const Track &orig)
@@ -554,6 +559,41 @@ VisibleTrackIterator::VisibleTrackIterator(AudacityProject *project)
    mPanelRect.SetSize(mProject->GetTPTracksUsableArea());
 }
 
+Track *VisibleTrackIterator::First(TrackList *val)
+{
+   if (val != NULL)
+      l = val;
+   if (l == NULL)
+      return NULL;
+
+   Track *t = l->FindTrackReaching(mPanelRect.GetTop());
+   if (!t)
+      return NULL;
+
+   // The first channel of a pair is visible when the second is
+   auto partner = t->GetLink();
+   if (partner && !t->GetLinked())
+      t = partner;
+
+   t = TrackListIterator::StartWith(t);
+   while (t && !this->Condition(t))
+      t = Next();
+   return t;
+}
+
+Track *VisibleTrackIterator::Next(bool skiplinked)
+{
+   while (Track *t = TrackListIterator::Next(skiplinked)) {
+      // Tracks are stacked in order; none after this one is in view
+      if (t->GetY() > mPanelRect.GetBottom())
+         return NULL;
+      if (this->Condition(t))
+         return t;
+   }
+
+   return NULL;
+}
+
 bool VisibleTrackIterator::Condition(Track *t)
 {
    wxRect r(0, t->GetY(), 1, t->GetHeight());
@@ -692,6 +732,7 @@ wxDEFINE_EVENT(EVT_TRACKLIST_DELETION, wxCommandEvent);
 
 // same value as in the default constructed TrackId:
 long TrackList::sCounter = -1;
+unsigned long TrackList::sGenerations = 0;
 
 TrackList::TrackList()
 :  wxEvtHandler()
@@ -731,6 +772,8 @@ void TrackList::Swap(TrackList &that)
    SwapLOTs( *this, mSelf, that, that.mSelf );
    SwapLOTs( this->mPendingUpdates, mSelf, that.mPendingUpdates, that.mSelf );
    mUpdaters.swap(that.mUpdaters);
+   Touch();
+   that.Touch();
 }
 
 TrackList::~TrackList()
@@ -740,6 +783,8 @@ TrackList::~TrackList()
 
 void TrackList::RecalcPositions(TrackNodePointer node)
 {
+   Touch();
+
    if ( isNull( node ) )
       return;
 
@@ -765,8 +810,154 @@ void TrackList::RecalcPositions(TrackNodePointer node)
    UpdatePendingTracks();
 }
 
+void TrackList::UpdatePositionIndex()
+{
+   // Selection does not move tracks, so it need not rebuild the index
+   if (mIndexValid && mIndexGeneration == mContentGeneration)
+      return;
+
+   mByPosition.clear();
+   mGroups.clear();
+   for (auto &tracks : mByKind)
+      tracks.clear();
+   bool partner = false;
+   for (const auto &pTrack : static_cast<ListOfTracks&>(*this)) {
+      mByPosition.push_back(pTrack.get());
+      const auto kind = pTrack->GetKind();
+      if (kind >= 0 && kind < Track::All)
+         mByKind[kind].push_back(pTrack.get());
+      if (!partner)
+         mGroups.push_back(pTrack.get());
+      // As TrackListIterator::Next(true) skips the second channel
+      partner = !partner && pTrack->GetLinked();
+   }
+
+   mByKind[Track::All] = mByPosition;
+
+   mIndexGeneration = mContentGeneration;
+   mIndexValid = true;
+}
+
+void TrackList::UpdateSelectionIndex()
+{
+   UpdatePositionIndex();
+   if (mSelectionIndexValid && mSelectionIndexGeneration == mGeneration)
+      return;
+
+   for (int kind = 0; kind <= Track::All; ++kind) {
+      auto &selected = mSelectedByKind[kind];
+      selected.clear();
+      for (const auto track : mByKind[kind])
+         if (track->GetSelected())
+            selected.push_back(track);
+   }
+
+   mSelectionIndexGeneration = mGeneration;
+   mSelectionIndexValid = true;
+}
+
+namespace {
+// Beyond this many, a change of selection is as good as a change of all
+const size_t kMaxSelectionChanges = 4096;
+}
+
+void TrackList::SelectionChanged(Track &track, bool wasSelected)
+{
+   TouchSelection();
+   if (mSelectionChangesOverflowed)
+      return;
+   if (mSelectionChanges.size() >= kMaxSelectionChanges) {
+      mSelectionChanges.clear();
+      mSelectionChangesOverflowed = true;
+      return;
+   }
+   mSelectionChanges.emplace_back(Track::Pointer(&track), wasSelected);
+}
+
+bool TrackList::TakeSelectionChanges(std::vector<Track*> &changed)
+{
+   changed.clear();
+   if (mSelectionChangesOverflowed) {
+      mSelectionChangesOverflowed = false;
+      return false;
+   }
+
+   // The first record of each track has what it was before; a track that
+   // changed back is left out
+   std::unordered_set<const Track*> seen;
+   for (const auto &change : mSelectionChanges) {
+      auto pTrack = change.first.lock();
+      if (!pTrack || pTrack->mList.lock().get() != this ||
+          !seen.insert(pTrack.get()).second)
+         continue;
+      if (pTrack->GetSelected() != change.second)
+         changed.push_back(pTrack.get());
+   }
+   mSelectionChanges.clear();
+   return true;
+}
+
+Track *TrackList::FindTrackReaching(int y)
+{
+   UpdatePositionIndex();
+
+   // RecalcPositions() stacks the tracks in order, so that their bottoms
+   // never decrease
+   auto iter = std::partition_point(mByPosition.begin(), mByPosition.end(),
+      [=](const Track *t){ return t->GetY() + t->GetHeight() <= y; });
+   return iter == mByPosition.end() ? nullptr : *iter;
+}
+
+size_t TrackList::GetGroupCount()
+{
+   UpdatePositionIndex();
+   return mGroups.size();
+}
+
+Track *TrackList::GetGroup(size_t n)
+{
+   UpdatePositionIndex();
+   return n < mGroups.size() ? mGroups[n] : nullptr;
+}
+
+int TrackList::FindGroup(const Track *track)
+{
+   if (!track)
+      return -1;
+
+   UpdatePositionIndex();
+
+   // The indices RecalcPositions() assigns increase along the list
+   auto iter = std::lower_bound(mGroups.begin(), mGroups.end(), track,
+      [](const Track *a, const Track *b){ return a->GetIndex() < b->GetIndex(); });
+   if (iter == mGroups.end() || *iter != track)
+      return -1;
+   return iter - mGroups.begin();
+}
+
+Track *TrackList::GetTrack(size_t n)
+{
+   UpdatePositionIndex();
+   return n < mByPosition.size() ? mByPosition[n] : nullptr;
+}
+
+const std::vector<Track*> &TrackList::GetTracksOfKind(int kind)
+{
+   UpdatePositionIndex();
+   wxASSERT(kind >= 0 && kind <= Track::All);
+   return mByKind[std::max(0, std::min<int>(kind, Track::All))];
+}
+
+const std::vector<Track*> &TrackList::GetSelectedTracksOfKind(int kind)
+{
+   UpdateSelectionIndex();
+   wxASSERT(kind >= 0 && kind <= Track::All);
+   return mSelectedByKind[std::max(0, std::min<int>(kind, Track::All))];
+}
+
 void TrackList::PermutationEvent()
 {
+   Touch();
    auto e = std::make_unique<wxCommandEvent>(EVT_TRACKLIST_PERMUTED);
    // wxWidgets will own the event object
    QueueEvent(e.release());
@@ -774,6 +965,7 @@ void TrackList::PermutationEvent()
 
 void TrackList::DeletionEvent()
 {
+   Touch();
    auto e = std::make_unique<wxCommandEvent>(EVT_TRACKLIST_DELETION);
    // wxWidgets will own the event object
    QueueEvent(e.release());
@@ -781,6 +973,7 @@ void TrackList::DeletionEvent()
 
 void TrackList::ResizingEvent(TrackNodePointer node)
 {
+   Touch();
    auto e = std::make_unique<TrackListEvent>(EVT_TRACKLIST_RESIZING);
    e->mpTrack = *node.first;
    // wxWidgets will own the event object
@@ -921,6 +1114,7 @@ void TrackList::Clear(bool sendEvent)
    updating.swap( mPendingUpdates );
 
    mUpdaters.clear();
+   Touch();
 
    if (sendEvent)
       DeletionEvent();
@@ -1208,19 +1402,19 @@ unsigned TrackList::GetNumExportChannels(bool selectionOnly) const
 
 namespace {
    template<typename Array>
-   Array GetWaveTracks(TrackListIterator p, const TrackListIterator end,
-                       bool selectionOnly, bool includeMuted)
+   Array GetWaveTracks(TrackList &list, bool selectionOnly, bool includeMuted)
    {
       Array waveTrackArray;
 
-      for (; p != end; ++p) {
-         const auto &track = *p;
-         auto wt = static_cast<const WaveTrack *>(&*track);
-         if (track->GetKind() == Track::Wave &&
-            (includeMuted || !wt->GetMute()) &&
-            (track->GetSelected() || !selectionOnly)) {
+      // The index has the wave tracks, or the selected ones, already
+      const auto &tracks = selectionOnly
+         ? list.GetSelectedTracksOfKind(Track::Wave)
+         : list.GetTracksOfKind(Track::Wave);
+      waveTrackArray.reserve(tracks.size());
+      for (const auto track : tracks) {
+         auto wt = static_cast<const WaveTrack *>(track);
+         if (includeMuted || !wt->GetMute())
             waveTrackArray.push_back( Track::Pointer< WaveTrack >( track ) );
-         }
       }
 
       return waveTrackArray;
@@ -1229,14 +1423,14 @@ namespace {
 
 WaveTrackArray TrackList::GetWaveTrackArray(bool selectionOnly, bool includeMuted)
 {
-   return GetWaveTracks<WaveTrackArray>(begin(), end(), selectionOnly, includeMuted);
+   return GetWaveTracks<WaveTrackArray>(*this, selectionOnly, includeMuted);
 }
 
 WaveTrackConstArray TrackList::GetWaveTrackConstArray(bool selectionOnly, bool includeMuted) const
 {
    auto list = const_cast<TrackList*>(this);
    return GetWaveTracks<WaveTrackConstArray>(
-      list->begin(), list->end(), selectionOnly, includeMuted);
+      *list, selectionOnly, includeMuted);
 }
 
 int TrackList::GetHeight() const
@@ -1343,6 +1537,7 @@ void TrackList::ClearPendingTracks( ListOfTracks *pAdded )
       pTrack->SetOwner( {}, {} );
    mPendingUpdates.clear();
    mUpdaters.clear();
+   Touch();
 
    if (pAdded)
       pAdded->clear();
@@ -503,6 +503,12 @@ class AUDACITY_DLL_API VisibleTrackIterator final : public TrackListCondIterator
    VisibleTrackIterator(AudacityProject *project);
    virtual ~VisibleTrackIterator() {}
 
+   // Begin at the first track in view, found by TrackList's index, and
+   // end at the first track below the view, so that tracks scrolled away
+   // are not visited
+   Track *First(TrackList *val = NULL) override;
+   Track *Next(bool skiplinked = false) override;
+
  protected:
    bool Condition(Track *t) override;
 
@@ -780,7 +786,75 @@ public:
 
    bool HasPendingTracks() const;
 
+   // Changes whenever tracks are added, removed, reordered, resized,
+   // linked or selected, or when Touch() marks an edit of their contents,
+   // so that what is worked out from them can be kept until it does.
+   // Generations are drawn from one count for all lists, so that no two
+   // lists ever share one.
+   unsigned long GetGeneration() const { return mGeneration; }
+   // As GetGeneration(), but unchanged by selection
+   unsigned long GetContentGeneration() const { return mContentGeneration; }
+   void Touch() { mGeneration = mContentGeneration = ++sGenerations; }
+   void TouchSelection() { mGeneration = ++sGenerations; }
+
+   // Records a track whose selectedness changed; called by
+   // Track::SetSelected()
+   void SelectionChanged(Track &track, bool wasSelected);
+   bool HasSelectionChanges() const
+   { return mSelectionChangesOverflowed || !mSelectionChanges.empty(); }
+   // Puts into changed the tracks of this list whose selectedness is not
+   // what it was at the last call, each once, and forgets them.  False if
+   // there were too many to list, when all count as changed.
+   bool TakeSelectionChanges(std::vector<Track*> &changed);
+   // As when all have been redrawn
+   void ForgetSelectionChanges()
+   { mSelectionChanges.clear(); mSelectionChangesOverflowed = false; }
+
+   // The first track whose area reaches below y, in the coordinates of
+   // GetY(), or null; a binary search, so that the panel touches only the
+   // tracks in view however many there are
+   Track *FindTrackReaching(int y);
+
+   // Tracks as TrackPanelAx numbers them, a stereo pair counting once
+   size_t GetGroupCount();
+   // n counts from 0; null if there is no such group
+   Track *GetGroup(size_t n);
+   // The number of the group that track begins, counting from 0, or -1
+   int FindGroup(const Track *track);
+
+   // Tracks counted one channel at a time, as the scripting commands
+   // number them, from 0; null if there is no such track
+   Track *GetTrack(size_t n);
+   // The tracks of one kind, or all of them for Track::All, in order, and
+   // those of them selected; good until the generation changes, so copy
+   // them to change the list or the selection while visiting them
+   const std::vector<Track*> &GetTracksOfKind(int kind);
+   const std::vector<Track*> &GetSelectedTracksOfKind(int kind);
+
 private:
+   static unsigned long sGenerations;
+   unsigned long mGeneration { ++sGenerations };
+   unsigned long mContentGeneration { mGeneration };
+
+   // Tracks in order, those beginning groups, and those of each kind, for
+   // the finding functions above; built again when the content generation
+   // changes, and the selected ones of each kind when the generation does
+   void UpdatePositionIndex();
+   void UpdateSelectionIndex();
+   std::vector<Track*> mByPosition;
+   std::vector<Track*> mGroups;
+   std::vector<Track*> mByKind[Track::All + 1];
+   std::vector<Track*> mSelectedByKind[Track::All + 1];
+   unsigned long mIndexGeneration { 0 };
+   unsigned long mSelectionIndexGeneration { 0 };
+   bool mIndexValid { false };
+   bool mSelectionIndexValid { false };
+
+   // For TakeSelectionChanges(): tracks with their selectedness before
+   // their first change since the last take, in the order changed
+   std::vector< std::pair< std::weak_ptr<Track>, bool > > mSelectionChanges;
+   bool mSelectionChangesOverflowed { false };
+
    // Need to put pending tracks into a list so that GetLink() works
    ListOfTracks mPendingUpdates;
    // This is in correspondence with mPendingUpdates
@@ -790,17 +864,18 @@ private:
 class AUDACITY_DLL_API TrackFactory
 {
  private:
+   const std::shared_ptr<DirManager> mDirManager;
+   const ZoomInfo *const mZoomInfo;
+
+ public:
+   // Each project has one; programs with no project, such as the
+   // benchmarks, may make their own
    TrackFactory(const std::shared_ptr<DirManager> &dirManager, const ZoomInfo *zoomInfo):
       mDirManager(dirManager)
       , mZoomInfo(zoomInfo)
    {
    }
 
-   const std::shared_ptr<DirManager> mDirManager;
-   const ZoomInfo *const mZoomInfo;
-   friend class AudacityProject;
-
- public:
    // These methods are defined in WaveTrack.cpp
    std::unique_ptr<WaveTrack> DuplicateWaveTrack(const WaveTrack &orig);
    std::unique_ptr<WaveTrack> NewWaveTrack(sampleFormat format = (sampleFormat)0,
@@ -145,6 +145,7 @@ audio tracks.
 
 #include <math.h>
 #include <float.h>
+#include <algorithm>
 #include <limits>
 
 #ifdef HAVE_ALLOCA_H
@@ -159,15 +160,19 @@ audio tracks.
 #include <wx/graphics.h>
 #include <wx/image.h>
 #include <wx/pen.h>
+#include <wx/rawbmp.h>
+#include <wx/thread.h>
 #include <wx/log.h>
 #include <wx/datetime.h>
 
 #include "AColor.h"
 #include "BlockFile.h"
+#include "blockfile/BlockIOStats.h"
 #include "Envelope.h"
 #include "WaveTrack.h"
 #include "Prefs.h"
 #include "prefs/GUISettings.h"
+#include "prefs/SpectrogramSettings.h"
 #include "prefs/WaveformSettings.h"
 #include "ViewInfo.h"
 #include "widgets/Ruler.h"
@@ -175,6 +180,8 @@ audio tracks.
 #include "AllThemeResources.h"
 #include "Experimental.h"
 #include "TrackPanelDrawingContext.h"
+#include "VectorMath.h"
+#include "MixerPool.h"
 
 
 #undef PROFILE_WAVEFORM
@@ -224,6 +231,10 @@ namespace {
 }
 #endif
 
+// How many calls of DrawTracks() may pass before the bitmap of a clip
+// that was not drawn is let go
+static const unsigned kColumnBitmapLifetime = 32;
+
 TrackArtist::TrackArtist()
 {
    mMarginLeft   = 0;
@@ -332,8 +343,20 @@ void TrackArtist::DrawTracks(TrackPanelDrawingContext &context,
    dc.DrawRectangle(clip);
 #endif
 
-   gPrefs->Read(wxT("/GUI/ShowTrackNameInWaveform"), &mbShowTrackNameInWaveform, false);
+   mbShowTrackNameInWaveform = PrefsSnapshot::Get().showTrackNameInWaveform;
+
+   // Let go of the bitmaps of clips not drawn for a while
+   ++mGeneration;
+   for (auto it = mColumnBitmaps.begin(); it != mColumnBitmaps.end();) {
+      if (mGeneration - it->second.generation > kColumnBitmapLifetime)
+         it = mColumnBitmaps.erase(it);
+      else
+         ++it;
+   }
 
+   // Find what to draw first, so that the display data of all of it can
+   // be made at once
+   std::vector< std::pair<const Track*, wxRect> > toDraw;
    t = iter.StartWith(start);
    while (t) {
       auto other = tracks->FindPendingChangedTrack(t->GetId());
@@ -384,12 +407,16 @@ void TrackArtist::DrawTracks(TrackPanelDrawingContext &context,
          rr.y += mMarginTop;
          rr.width -= (mMarginLeft + mMarginRight);
          rr.height -= (mMarginTop + mMarginBottom);
-         DrawTrack(context, t, rr,
-                   selectedRegion, zoomInfo, hasSolo);
+         toDraw.emplace_back(t, rr);
       }
 
       t = iter.Next();
    }
+
+   PrepareWaveDisplays(toDraw, selectedRegion, zoomInfo);
+   for (const auto &item : toDraw)
+      DrawTrack(context, item.first, item.second,
+                selectedRegion, zoomInfo, hasSolo);
 }
 
 void TrackArtist::DrawTrack(TrackPanelDrawingContext &context,
@@ -399,6 +426,7 @@ void TrackArtist::DrawTrack(TrackPanelDrawingContext &context,
                             const ZoomInfo &zoomInfo,
                             bool hasSolo)
 {
+   BlockIOStats::Scope ioScope{ BlockIOStats::Display };
    auto &dc = context.dc;
    switch (t->GetKind()) {
    case Track::Wave:
@@ -421,6 +449,9 @@ void TrackArtist::DrawTrack(TrackPanelDrawingContext &context,
       case WaveTrack::Waveform: 
          DrawWaveform(context, wt, rect, selectedRegion, zoomInfo, muted);
          break;
+      case WaveTrack::Spectrum:
+         DrawSpectrum(context, wt, rect, selectedRegion, zoomInfo);
+         break;
       default:
          wxASSERT(false);
       }
@@ -657,6 +688,18 @@ void TrackArtist::UpdateVRuler(const Track *t, wxRect & rect)
             vruler->SetLog(false);
          }
       }
+      else if (display == WaveTrack::Spectrum) {
+         // Hz, on the linear scale of DrawClipSpectrum()
+         const auto &settings = wt->GetSpectrogramSettings();
+         const double minFreq = std::max(0, settings.minFreq);
+         const double maxFreq = std::max(minFreq + 1,
+            std::min<double>(settings.maxFreq, wt->GetRate() / 2));
+         vruler->SetBounds(rect.x, rect.y, rect.x + rect.width, rect.y + rect.height - 1);
+         vruler->SetRange(maxFreq, minFreq);
+         vruler->SetFormat(Ruler::IntFormat);
+         vruler->SetLabelEdges(true);
+         vruler->SetLog(false);
+      }
    }
    vruler->GetMaxSize(&t->vrulerSize.x, &t->vrulerSize.y);
 }
@@ -669,6 +712,17 @@ void TrackArtist::UpdateVRuler(const Track *t, wxRect & rect)
 int GetWaveYPos(float value, float min, float max,
                 int height, bool dB, bool outer,
                 float dBr, bool clip)
+{
+   const float db =
+      (dB && height != 0 && value != 0.) ? LINEAR_TO_DB(fabs(value)) : 0;
+   return GetWaveYPos(value, db, min, max, height, dB, outer, dBr, clip);
+}
+
+/// The same, given db, the decibels of value if dB, so that the caller may
+/// compute them for many values at once
+int GetWaveYPos(float value, float db, float min, float max,
+                int height, bool dB, bool outer,
+                float dBr, bool clip)
 {
    if (dB) {
       if (height == 0) {
@@ -678,7 +732,6 @@ int GetWaveYPos(float value, float min, float max,
       float sign = (value >= 0 ? 1 : -1);
 
       if (value != 0.) {
-         float db = LINEAR_TO_DB(fabs(value));
          value = (db + dBr) / dBr;
          if (!outer) {
             value -= 0.5;
@@ -879,7 +932,60 @@ void TrackArtist::DrawWaveformBackground(wxDC &dc, int leftOffset, const wxRect
 }
 
 
-void TrackArtist::DrawMinMaxRMS(wxDC &dc, const wxRect & rect, const double env[],
+namespace {
+// Paint the min-max columns of a waveform, with the rms columns over them,
+// into a bitmap with a transparent background, so that it can be drawn with
+// one call instead of one line per column per pass.  Returns false if the
+// platform can't do it; then draw lines.
+bool MakeColumnBitmap(wxBitmap &bitmap, const wxRect &rect,
+                      const int *h1, const int *h2,
+                      const int *r1, const int *r2,
+                      const wxColour &sampleColour, const wxColour &rmsColour)
+{
+   bitmap = wxBitmap{ rect.width, rect.height, 32 };
+   if (!bitmap.IsOk())
+      return false;
+#ifdef __WXMSW__
+   bitmap.UseAlpha();
+#endif
+
+   {
+      wxAlphaPixelData data{ bitmap };
+      if (!data)
+         return false;
+
+      wxAlphaPixelData::Iterator row{ data };
+      for (int yy = 0; yy < rect.height; ++yy) {
+         auto pixel = row;
+         for (int x0 = 0; x0 < rect.width; ++x0, ++pixel) {
+            // Same extents as the lines, which include both ends
+            const wxColour *colour = nullptr;
+            if (r1[x0] != r2[x0] && r2[x0] <= yy && yy <= r1[x0])
+               colour = &rmsColour;
+            else if (std::min(h1[x0], h2[x0]) <= yy &&
+                     yy <= std::max(h1[x0], h2[x0]))
+               colour = &sampleColour;
+
+            if (colour) {
+               pixel.Red() = colour->Red();
+               pixel.Green() = colour->Green();
+               pixel.Blue() = colour->Blue();
+               pixel.Alpha() = wxALPHA_OPAQUE;
+            }
+            else
+               pixel.Red() = pixel.Green() = pixel.Blue() =
+                  pixel.Alpha() = wxALPHA_TRANSPARENT;
+         }
+         row.OffsetY(data, 1);
+      }
+   }
+
+   return true;
+}
+}
+
+void TrackArtist::DrawMinMaxRMS(wxDC &dc, const WaveClip *clip,
+   const wxRect & rect, const double env[],
    float zoomMin, float zoomMax,
    bool dB, float dBRange,
    const float *min, const float *max, const float *rms, const int *bl,
@@ -889,59 +995,118 @@ void TrackArtist::DrawMinMaxRMS(wxDC &dc, const wxRect & rect, const double env[
    // min and max of the samples in this region
    int lasth1 = std::numeric_limits<int>::max();
    int lasth2 = std::numeric_limits<int>::min();
-   int h1;
-   int h2;
-   ArrayOf<int> r1{ size_t(rect.width) };
-   ArrayOf<int> r2{ size_t(rect.width) };
+   auto &h1 = mScratch.h1, &h2 = mScratch.h2;
+   auto &r1 = mScratch.r1, &r2 = mScratch.r2;
+   h1.resize(rect.width), h2.resize(rect.width);
+   r1.resize(rect.width), r2.resize(rect.width);
    ArrayOf<int> clipped;
    int clipcnt = 0;
+   bool anyUnloaded = false;
+
+   // The values to draw of each column, min, max and rms, and if dB their
+   // decibels, computed all at once
+   auto &values = mScratch.values, &dBs = mScratch.dBs;
+   values.resize(3 * rect.width);
+   dBs.resize(3 * rect.width);
+   const auto mins = values.data(), maxes = mins + rect.width,
+      rmses = maxes + rect.width;
+   for (int x0 = 0; x0 < rect.width; ++x0) {
+      mins[x0] = min[x0] * env[x0];
+      maxes[x0] = max[x0] * env[x0];
+      rmses[x0] = rms[x0] * env[x0];
+   }
+   if (dB)
+      VectorLinearToDB(values.data(), dBs.data(), values.size());
+   const auto minDBs = dBs.data(), maxDBs = minDBs + rect.width,
+      rmsDBs = maxDBs + rect.width;
 
-   long pixAnimOffset = (long)fabs((double)(wxDateTime::Now().GetTicks() * -10)) +
-      wxDateTime::Now().GetMillisecond() / 100; //10 pixels a second
-
-   bool drawStripes = true;
-   bool drawWaveform = true;
-
-   dc.SetPen(muted ? muteSamplePen : samplePen);
    for (int x0 = 0; x0 < rect.width; ++x0) {
-      int xx = rect.x + x0;
-      double v;
-      v = min[x0] * env[x0];
-      h1 = GetWaveYPos(v, zoomMin, zoomMax,
+      h1[x0] = GetWaveYPos(mins[x0], minDBs[x0], zoomMin, zoomMax,
                        rect.height, dB, true, dBRange, true);
 
-      v = max[x0] * env[x0];
-      h2 = GetWaveYPos(v, zoomMin, zoomMax,
+      h2[x0] = GetWaveYPos(maxes[x0], maxDBs[x0], zoomMin, zoomMax,
                        rect.height, dB, true, dBRange, true);
 
       // JKC: This adjustment to h1 and h2 ensures that the drawn
       // waveform is continuous.
       if (x0 > 0) {
-         if (h1 < lasth2) {
-            h1 = lasth2 - 1;
+         if (h1[x0] < lasth2) {
+            h1[x0] = lasth2 - 1;
          }
-         if (h2 > lasth1) {
-            h2 = lasth1 + 1;
+         if (h2[x0] > lasth1) {
+            h2[x0] = lasth1 + 1;
          }
       }
-      lasth1 = h1;
-      lasth2 = h2;
+      lasth1 = h1[x0];
+      lasth2 = h2[x0];
 
-      r1[x0] = GetWaveYPos(-rms[x0] * env[x0], zoomMin, zoomMax,
+      r1[x0] = GetWaveYPos(-rmses[x0], rmsDBs[x0], zoomMin, zoomMax,
                           rect.height, dB, true, dBRange, true);
-      r2[x0] = GetWaveYPos(rms[x0] * env[x0], zoomMin, zoomMax,
+      r2[x0] = GetWaveYPos(rmses[x0], rmsDBs[x0], zoomMin, zoomMax,
                           rect.height, dB, true, dBRange, true);
       // Make sure the rms isn't larger than the waveform min/max
-      if (r1[x0] > h1 - 1) {
-         r1[x0] = h1 - 1;
+      if (r1[x0] > h1[x0] - 1) {
+         r1[x0] = h1[x0] - 1;
       }
-      if (r2[x0] < h2 + 1) {
-         r2[x0] = h2 + 1;
+      if (r2[x0] < h2[x0] + 1) {
+         r2[x0] = h2[x0] + 1;
       }
       if (r2[x0] > r1[x0]) {
          r2[x0] = r1[x0];
       }
 
+      if (bl[x0] <= -1)
+         anyUnloaded = true;
+   }
+
+   // Columns still loading on demand get the animated placeholder, which
+   // only the lines can draw.  So do printers and other devices that may
+   // scale.
+   if (!anyUnloaded && !rect.IsEmpty() && dc.IsKindOf(CLASSINFO(wxMemoryDC))) {
+      auto &columns = mScratch.columns;
+      columns.clear();
+      columns.push_back(rect.width);
+      columns.push_back(rect.height);
+      for (int x0 = 0; x0 < rect.width; ++x0) {
+         columns.push_back(h1[x0]);
+         columns.push_back(h2[x0]);
+         columns.push_back(r1[x0]);
+         columns.push_back(r2[x0]);
+      }
+      const auto sampleColour = (muted ? muteSamplePen : samplePen).GetColour();
+      const auto rmsColour = (muted ? muteRmsPen : rmsPen).GetColour();
+
+      auto &cached = mColumnBitmaps[{ clip, rect.x }];
+      bool ok = cached.bitmap.IsOk() && cached.columns == columns &&
+         cached.sampleColour == sampleColour && cached.rmsColour == rmsColour;
+      if (!ok &&
+          MakeColumnBitmap(cached.bitmap, rect,
+             h1.data(), h2.data(), r1.data(), r2.data(),
+             sampleColour, rmsColour)) {
+         // Copying reuses the capacity of both vectors
+         cached.columns = columns;
+         cached.sampleColour = sampleColour;
+         cached.rmsColour = rmsColour;
+         ok = true;
+      }
+
+      if (ok) {
+         cached.generation = mGeneration;
+         dc.DrawBitmap(cached.bitmap, rect.x, rect.y, true);
+         return;
+      }
+      mColumnBitmaps.erase({ clip, rect.x });
+   }
+
+   long pixAnimOffset = (long)fabs((double)(wxDateTime::Now().GetTicks() * -10)) +
+      wxDateTime::Now().GetMillisecond() / 100; //10 pixels a second
+
+   bool drawStripes = true;
+   bool drawWaveform = true;
+
+   dc.SetPen(muted ? muteSamplePen : samplePen);
+   for (int x0 = 0; x0 < rect.width; ++x0) {
+      int xx = rect.x + x0;
       if (bl[x0] <= -1) {
          if (drawStripes) {
             // TODO:unify with buffer drawing.
@@ -973,7 +1138,7 @@ void TrackArtist::DrawMinMaxRMS(wxDC &dc, const wxRect & rect, const double env[
          dc.SetPen(muted ? muteSamplePen : samplePen);
       }
       else {
-         AColor::Line(dc, xx, rect.y + h2, xx, rect.y + h1);
+         AColor::Line(dc, xx, rect.y + h2[x0], xx, rect.y + h1[x0]);
       }
    }
 
@@ -1088,11 +1253,14 @@ void TrackArtist::DrawIndividualSamples(wxDC &dc, int leftOffset, const wxRect &
       }
    }
    else {
-      // Connect samples with straight lines
-      for (decltype(slen) s = 0; s < slen - 1; s++) {
-         AColor::Line(dc,
-                     rect.x + xpos[s], rect.y + ypos[s],
-                     rect.x + xpos[s + 1], rect.y + ypos[s + 1]);
+      // Connect samples with straight lines, all in one call
+      ArrayOf<wxPoint> points{ size_t(slen) };
+      for (decltype(slen) s = 0; s < slen; s++)
+         points[s] = wxPoint{ xpos[s], ypos[s] };
+      if (slen > 1) {
+         dc.DrawLines(int(slen), points.get(), rect.x, rect.y);
+         // Include the last point, as AColor::Line() does
+         dc.DrawPoint(rect.x + xpos[slen - 1], rect.y + ypos[slen - 1]);
       }
    }
 
@@ -1405,7 +1573,8 @@ void TrackArtist::DrawClipWaveform(TrackPanelDrawingContext &context,
    float zoomMin, zoomMax;
    track->GetDisplayBounds(&zoomMin, &zoomMax);
 
-   std::vector<double> vEnv(mid.width);
+   auto &vEnv = mScratch.env;
+   vEnv.resize(mid.width);
    double *const env = &vEnv[0];
    clip->GetEnvelope()->GetValues( 0, env, mid.width, leftOffset, zoomInfo ); // removing this line messes with the blue "selection" bar
 
@@ -1535,10 +1704,11 @@ void TrackArtist::DrawClipWaveform(TrackPanelDrawingContext &context,
 
       if (rect.width > 0) {
          if (!showIndividualSamples) {
-            std::vector<double> vEnv2(rect.width);
+            auto &vEnv2 = mScratch.env2;
+            vEnv2.resize(rect.width);
             double *const env2 = &vEnv2[0];
             clip->GetEnvelope()->GetValues( 0, env2, rect.width, leftOffset, zoomInfo ); // removing this line makes the waveform invisible
-            DrawMinMaxRMS(dc, rect, env2,
+            DrawMinMaxRMS(dc, clip, rect, env2,
                zoomMin, zoomMax,
                dB, dBRange,
                useMin, useMax, useRms, useBl,
@@ -1576,6 +1746,71 @@ void TrackArtist::DrawClipWaveform(TrackPanelDrawingContext &context,
    }
 }
 
+void TrackArtist::PrepareWaveDisplays(
+   const std::vector< std::pair<const Track*, wxRect> > &toDraw,
+   const SelectedRegion &selectedRegion, const ZoomInfo &zoomInfo)
+{
+   // The clips that DrawClipWaveform() will ask for a WaveDisplay, with
+   // what it will ask
+   struct Job {
+      const WaveClip *clip;
+      double t0;
+      double pps;
+      int width;
+   };
+   std::vector<Job> jobs;
+   for (const auto &item : toDraw) {
+      if (item.first->GetKind() != Track::Wave)
+         continue;
+      const auto track = static_cast<const WaveTrack*>(item.first);
+      if (track->GetDisplay() != WaveTrack::Waveform)
+         continue;
+      const wxRect &rect = item.second;
+      for (const auto &clip : track->GetClips()) {
+         const ClipParameters params
+            (false, track, clip.get(), rect, selectedRegion, zoomInfo);
+         if (params.hiddenMid.width <= 0)
+            continue;
+         std::vector<WavePortion> portions;
+         FindWavePortions(portions, rect, zoomInfo, params);
+         const double threshold1 = 0.5 * params.rate;
+         if (std::any_of(portions.begin(), portions.end(),
+               [=](const WavePortion &portion) {
+                  return !portion.inFisheye && portion.averageZoom > threshold1;
+               }))
+            // Drawn as individual samples
+            continue;
+         jobs.push_back({ clip.get(), params.t0,
+            params.averagePixelsPerSample * params.rate,
+            params.hiddenMid.width });
+      }
+   }
+
+   // One clip alone gains nothing from the helpers
+   if (jobs.size() < 2)
+      return;
+
+   if (!mDisplayPool) {
+      const auto nThreads = std::max(1, wxThread::GetCPUCount());
+      mDisplayPool = std::make_unique<MixerPool>(unsigned(nThreads - 1));
+   }
+
+   BlockIOStats::Scope ioScope{ BlockIOStats::Display };
+   mDisplayPool->Run(jobs.size(), [&](size_t ii) {
+      const auto &job = jobs[ii];
+      // Only to fill the cache of the clip, which drawing then finds
+      WaveDisplay display(job.width);
+      bool isLoadingOD = false;
+      // Exceptions must not escape the helper threads; drawing asks
+      // again, and meets the error there
+      try {
+         job.clip->GetWaveDisplay(display, job.t0, job.pps, isLoadingOD);
+      }
+      catch (...) {
+      }
+   });
+}
+
 static inline float findValue
 (const float *spectrum, float bin0, float bin1, unsigned nBins,
  bool autocorrelation, int gain, int range)
@@ -1610,10 +1845,91 @@ static inline float findValue
    return value;
 }
 
+void TrackArtist::DrawSpectrum(TrackPanelDrawingContext &context,
+                               const WaveTrack *track,
+                               const wxRect & rect,
+                               const SelectedRegion &selectedRegion,
+                               const ZoomInfo &zoomInfo)
+{
+   DrawBackgroundWithSelection(&context.dc, rect, track, blankSelectedBrush,
+      blankBrush, selectedRegion, zoomInfo);
+
+   for (const auto &clip: track->GetClips())
+      DrawClipSpectrum(context, track, clip.get(), rect, selectedRegion,
+                       zoomInfo);
+}
+
+void TrackArtist::DrawClipSpectrum(TrackPanelDrawingContext &context,
+                                   const WaveTrack *track,
+                                   const WaveClip *clip,
+                                   const wxRect & rect,
+                                   const SelectedRegion &selectedRegion,
+                                   const ZoomInfo &zoomInfo)
+{
+   auto &dc = context.dc;
+   const auto &settings = track->GetSpectrogramSettings();
+
+   const ClipParameters params(true, track, clip, rect, selectedRegion, zoomInfo);
+   const wxRect &hiddenMid = params.hiddenMid;
+   // The "hiddenMid" rect contains the part of the display actually
+   // containing the spectrum.  If it's empty, we're done.
+   if (hiddenMid.width <= 0 || hiddenMid.height <= 0)
+      return;
+
+   const double &t0 = params.t0;
+   const double &rate = params.rate;
+   const auto &ssel0 = params.ssel0;
+   const auto &ssel1 = params.ssel1;
+
+   // If we get to this point, the clip is actually visible on the
+   // screen, so remember the display rectangle.
+   clip->SetDisplayRect(hiddenMid);
+
+   const float *freq = nullptr;
+   const sampleCount *where = nullptr;
+   const double pps = params.averagePixelsPerSample * rate;
+   if (!clip->GetSpectrogram(freq, where, hiddenMid.width, t0, pps, settings))
+      return;
+
+   // The bins that each row spans, on a linear scale of frequency
+   const auto nBins = settings.NBins();
+   const double binUnit = rate / settings.GetFFTLength();
+   const double minFreq = std::max(0, settings.minFreq);
+   const double maxFreq = std::max(minFreq + 1,
+      std::min<double>(settings.maxFreq, rate / 2));
+   const int height = hiddenMid.height;
+   std::vector<float> bins(height + 1);
+   for (int yy = 0; yy <= height; ++yy)
+      bins[yy] = (minFreq + (maxFreq - minFreq) * yy / height) / binUnit;
+
+   wxImage image(hiddenMid.width, height);
+   unsigned char *const data = image.GetData();
+   const bool selected = track->GetSelected();
+   for (int xx = 0; xx < hiddenMid.width; ++xx) {
+      const auto *const column = freq + nBins * xx;
+      const auto selection = (selected && ssel0 <= where[xx] && where[xx] < ssel1)
+         ? AColor::ColorGradientTimeSelected
+         : AColor::ColorGradientUnselected;
+      for (int yy = 0; yy < height; ++yy) {
+         const float value = findValue(column, bins[yy], bins[yy + 1], nBins,
+            false, settings.gain, settings.range);
+         // Row zero of the image is the top, for the highest frequency
+         unsigned char *const pixel = data + 3 * ((height - 1 - yy) *
+            hiddenMid.width + xx);
+         GetColorGradient(value, selection, settings.isGrayscale,
+                          &pixel[0], &pixel[1], &pixel[2]);
+      }
+   }
+
+   wxBitmap converted(image);
+   dc.DrawBitmap(converted, hiddenMid.x, hiddenMid.y);
+}
+
 void TrackArtist::UpdatePrefs()
 {
-   mdBrange = gPrefs->Read(ENV_DB_KEY, mdBrange);
-   gPrefs->Read(wxT("/GUI/SampleView"), &mSampleDisplay, 1);
+   const auto &prefs = PrefsSnapshot::Get();
+   mdBrange = prefs.envDBRange;
+   mSampleDisplay = prefs.sampleView;
    SetColours(0);
 }
 
@@ -19,6 +19,9 @@
 #define __AUDACITY_TRACKARTIST__
 
 #include "MemoryX.h"
+#include <map>
+#include <vector>
+#include <wx/bitmap.h>
 #include <wx/brush.h>
 #include <wx/pen.h>
 #include "Experimental.h"
@@ -28,6 +31,7 @@ class wxDC;
 class wxRect;
 class wxHashTable;
 
+class MixerPool;
 class Track;
 class WaveDisplay;
 class WaveTrack;
@@ -72,6 +76,10 @@ class AUDACITY_DLL_API TrackArtist {
 
    void UpdatePrefs();
 
+   // Whether the last drawing put the names of tracks over their waveforms,
+   // which stay put when the view scrolls
+   bool ShowsTrackNameInWaveform() const { return mbShowTrackNameInWaveform; }
+
    void SetBackgroundBrushes(wxBrush unselectedBrush, wxBrush selectedBrush,
                              wxPen unselectedPen, wxPen selectedPen) {
      this->unselectedBrush = unselectedBrush;
@@ -103,6 +111,16 @@ class AUDACITY_DLL_API TrackArtist {
                          const SelectedRegion &selectedRegion, const ZoomInfo &zoomInfo,
                          bool dB, bool muted);
 
+   void DrawSpectrum(TrackPanelDrawingContext &context,
+                     const WaveTrack *track,
+                     const wxRect & rect,
+                     const SelectedRegion &selectedRegion, const ZoomInfo &zoomInfo);
+
+   void DrawClipSpectrum(TrackPanelDrawingContext &context,
+                         const WaveTrack *track, const WaveClip *clip,
+                         const wxRect & rect,
+                         const SelectedRegion &selectedRegion, const ZoomInfo &zoomInfo);
+
    // Waveform utility functions
 
    void DrawWaveformBackground(wxDC & dc, int leftOffset, const wxRect &rect,
@@ -111,7 +129,8 @@ class AUDACITY_DLL_API TrackArtist {
                                int zeroLevelYCoordinate,
                                bool dB, float dBRange,
                                double t0, double t1, const ZoomInfo &zoomInfo);
-   void DrawMinMaxRMS(wxDC &dc, const wxRect & rect, const double env[],
+   void DrawMinMaxRMS(wxDC &dc, const WaveClip *clip,
+                      const wxRect & rect, const double env[],
                       float zoomMin, float zoomMax,
                       bool dB, float dBRange,
                       const float *min, const float *max, const float *rms, const int *bl,
@@ -160,11 +179,43 @@ class AUDACITY_DLL_API TrackArtist {
    wxPen blankSelectedPen;
 
    std::unique_ptr<Ruler> vruler;
+
+   // The bitmap DrawMinMaxRMS() last made for each portion of a clip, with
+   // everything it depends on, to draw again while that stays the same.
+   // Tracks that did not change then cost no more than a blit to repaint.
+   struct ColumnBitmap {
+      std::vector<int> columns; // size, then extents of each column
+      wxColour sampleColour, rmsColour;
+      wxBitmap bitmap;
+      unsigned generation {};
+   };
+   std::map< std::pair<const WaveClip*, int>, ColumnBitmap > mColumnBitmaps;
+   unsigned mGeneration {};  // counts calls of DrawTracks()
+
+   // Before DrawTracks() draws, fills the display caches of all the clips
+   // it will draw as min, max and rms, each on a thread of mDisplayPool,
+   // so that the first paint after a zoom reads and sums up the blocks of
+   // many tracks at once
+   void PrepareWaveDisplays(
+      const std::vector< std::pair<const Track*, wxRect> > &toDraw,
+      const SelectedRegion &selectedRegion, const ZoomInfo &zoomInfo);
+   std::unique_ptr<MixerPool> mDisplayPool;
+
+   // Scratch space for drawing waveforms.  It keeps its capacity from paint
+   // to paint, so that steady painting does not allocate.
+   struct Scratch {
+      std::vector<double> env, env2;
+      std::vector<int> h1, h2, r1, r2, columns;
+      std::vector<float> values, dBs;
+   } mScratch;
 };
 
 extern int GetWaveYPos(float value, float min, float max,
                        int height, bool dB, bool outer, float dBr,
                        bool clip);
+extern int GetWaveYPos(float value, float db, float min, float max,
+                       int height, bool dB, bool outer, float dBr,
+                       bool clip);
 extern float FromDB(float value, double dBRange);
 extern float ValueOfPixel(int yy, int height, bool offset,
                           bool dB, double dBRange, float zoomMin, float zoomMax);
@@ -0,0 +1,65 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   TrackEditBatch.cpp
+
+*******************************************************************//**
+
+\class TrackEditBatch
+\brief Runs the edits of one command to many wave tracks on a MixerPool.
+
+Cut, Delete and Paste clear and paste each selected wave track by
+itself, and the copying of block arrays and block files inside each is
+independent of the other tracks, so a session of many tracks is edited
+on all cores at once.  DirManager locks its making and copying of block
+files, and the sequences lock against their on-demand tasks, as before.
+
+The edits are not committed one by one: if any fails, the command throws
+as it did when the tracks were edited in turn, and the project goes back
+to its last undo state, undoing the edits that succeeded too.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "TrackEditBatch.h"
+
+#include <algorithm>
+#include <exception>
+
+#include <wx/thread.h>
+
+#include "MixerPool.h"
+
+void TrackEditBatch::Run()
+{
+   auto edits = std::move(mEdits);
+   mEdits.clear();
+
+   // Starting threads costs more than one edit saves
+   if (edits.size() < 2) {
+      for (auto &edit : edits)
+         edit();
+      return;
+   }
+
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   MixerPool pool{
+      unsigned(std::min<size_t>(nThreads, edits.size()) - 1) };
+   std::vector<std::exception_ptr> errors(edits.size());
+   pool.Run(edits.size(), [&](size_t ii) {
+      // Exceptions must not escape the helper threads
+      try {
+         edits[ii]();
+      }
+      catch (...) {
+         errors[ii] = std::current_exception();
+      }
+   });
+
+   for (auto &error : errors)
+      if (error)
+         std::rethrow_exception(error);
+}
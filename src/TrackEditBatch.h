@@ -0,0 +1,42 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   TrackEditBatch.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_TRACK_EDIT_BATCH__
+#define __AUDACITY_TRACK_EDIT_BATCH__
+
+#include "Audacity.h"
+#include "MemoryX.h"
+
+#include <functional>
+#include <vector>
+
+/// The edits of one command to each of several tracks, which touch no
+/// track but their own, run together on all cores.
+class TrackEditBatch final {
+ public:
+   using Edit = std::function< void() >;
+
+   TrackEditBatch() = default;
+   TrackEditBatch(const TrackEditBatch&) PROHIBITED;
+   TrackEditBatch &operator= (const TrackEditBatch&) PROHIBITED;
+
+   void Add(Edit edit) { mEdits.push_back(std::move(edit)); }
+
+   /// Runs the edits added since the last Run(), in any order, and
+   /// returns when all are done.  If any throws, the first exception is
+   /// rethrown after the others finish, so that the top level handler
+   /// rolls the whole command back.
+   void Run();
+
+ private:
+   std::vector<Edit> mEdits;
+};
+
+#endif
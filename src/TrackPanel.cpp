@@ -98,12 +98,6 @@ subset of the TrackPanel methods from all over the place.
 
 *//**************************************************************//**
 
-\class TrackPanel::AudacityTimer
-\brief Timer class dedicated to infomring the TrackPanel that it
-is time to refresh some aspect of the screen.
-
-*//*****************************************************************//**
-
 \page TrackPanelRefactor Track Panel Refactor
 \brief Planned refactoring of TrackPanel.cpp
 
@@ -165,6 +159,7 @@ is time to refresh some aspect of the screen.
 #include "float_cast.h"
 
 #include "Prefs.h"
+#include "Profiler.h"
 #include "RefreshCode.h"
 #include "TrackArtist.h"
 #include "TrackPanelAx.h"
@@ -172,6 +167,7 @@ is time to refresh some aspect of the screen.
 #include "HitTestResult.h"
 #include "WaveTrack.h"
 
+#include "ondemand/ODManager.h"
 #include "toolbars/ControlToolBar.h"
 
 //This loads the appropriate set of cursors, depending on platform.
@@ -180,6 +176,9 @@ is time to refresh some aspect of the screen.
 #include "widgets/ASlider.h"
 #include "widgets/Ruler.h"
 #include <algorithm>
+#include <math.h>
+
+#include <wx/dc.h>
 
 wxDEFINE_EVENT(EVT_TRACK_PANEL_TIMER, wxCommandEvent);
 
@@ -261,7 +260,6 @@ BEGIN_EVENT_TABLE(TrackPanel, OverlayPanel)
     EVT_KILL_FOCUS(TrackPanel::OnKillFocus)
     EVT_CONTEXT_MENU(TrackPanel::OnContextMenu)
 
-    EVT_TIMER(wxID_ANY, TrackPanel::OnTimer)
 END_EVENT_TABLE()
 
 /// Makes a cursor from an XPM, uses CursorId as a fallback.
@@ -331,8 +329,7 @@ TrackPanel::TrackPanel(wxWindow * parent, wxWindowID id,
    mTrackArtist->SetMargins(1, kTopMargin, kRightMargin, kBottomMargin);
 
    mTimeCount = 0;
-   mTimer.parent = this;
-   // Timer is started after the window is visible
+   // Ticks begin after the window is visible
    GetProject()->Bind(wxEVT_IDLE, &TrackPanel::OnIdle, this);
 
    // Register for tracklist updates
@@ -350,7 +347,7 @@ TrackPanel::TrackPanel(wxWindow * parent, wxWindowID id,
 
 TrackPanel::~TrackPanel()
 {
-   mTimer.Stop();
+   mFrames.reset();
 
    // This can happen if a label is being edited and the user presses
    // ALT+F4 or Command+Q
@@ -419,9 +416,12 @@ void TrackPanel::OnIdle(wxIdleEvent& event)
    // The window must be ready when the timer fires (#1401)
    if (IsShownOnScreen())
    {
-      mTimer.Start(kTimerInterval, FALSE);
+      mFrames = FrameClock::Get().Subscribe(kTimerInterval, [this]{
+         wxTimerEvent event;
+         OnTimer(event);
+      });
 
-      // Timer is started, we don't need the event anymore
+      // Ticks are started, we don't need the event anymore
       GetProject()->Unbind(wxEVT_IDLE, &TrackPanel::OnIdle, this);
    }
    else
@@ -451,6 +451,8 @@ void TrackPanel::OnTimer(wxTimerEvent& )
 
    AudacityProject *const p = GetProject();
 
+   UpdateODFocus();
+
    // Check whether we were playing or recording, but the stream has stopped.
    if (p->GetAudioIOToken()>0 && !IsAudioActive())
    {
@@ -473,7 +475,8 @@ void TrackPanel::OnTimer(wxTimerEvent& )
       //ANSWER-ME: Was DisplaySelection added to solve a repaint problem?
       DisplaySelection();
    }
-   if (mLastDrawnSelectedRegion != mViewInfo->selectedRegion) {
+   if (mLastDrawnSelectedRegion != mViewInfo->selectedRegion ||
+       GetTracks()->HasSelectionChanges()) {
       UpdateSelectionDisplay();
    }
 
@@ -509,6 +512,28 @@ void TrackPanel::OnTimer(wxTimerEvent& )
       mTimeCount = 0;
 }
 
+void TrackPanel::UpdateODFocus()
+{
+   // No tasks until something is loaded on demand
+   if (!ODManager::IsInstanceCreated())
+      return;
+
+   const double t0 = mViewInfo->h, t1 = GetScreenEndTime();
+   const double playhead =
+      IsAudioActive() && gAudioIO->GetNumCaptureChannels() == 0
+         ? gAudioIO->GetStreamTime() : -1.0;
+   if (t0 == mODViewStart && t1 == mODViewEnd && playhead == mODPlayhead)
+      return;
+   mODViewStart = t0, mODViewEnd = t1, mODPlayhead = playhead;
+
+   // The tasks ignore small moves of the playhead
+   TrackListIterator iter(GetTracks());
+   for (auto t = iter.First(); t; t = iter.Next())
+      if (t->GetKind() == Track::Wave)
+         ODManager::Instance()->DemandViewUpdate(
+            static_cast<WaveTrack*>(t), t0, t1, playhead);
+}
+
 double TrackPanel::GetScreenEndTime() const
 {
    int width;
@@ -520,6 +545,8 @@ double TrackPanel::GetScreenEndTime() const
 ///  completing a repaint operation.
 void TrackPanel::OnPaint(wxPaintEvent & /* event */)
 {
+   PROFILE_SCOPE("TrackPanel::OnPaint");
+
    mLastDrawnSelectedRegion = mViewInfo->selectedRegion;
 
 #if DEBUG_DRAW_TIMING
@@ -538,15 +565,28 @@ void TrackPanel::OnPaint(wxPaintEvent & /* event */)
       {
          // Reset (should a mutex be used???)
          mRefreshBacking = false;
+         mDamage.Clear();
+         GetTracks()->ForgetSelectionChanges();
 
          // Redraw the backing bitmap
          DrawTracks(&GetBackingDCForRepaint());
+         RecordDrawnView();
 
          // Copy it to the display
          DisplayBitmap(dc);
       }
       else
       {
+         if (!mDamage.IsEmpty()) {
+            // Redraw only the areas given to RefreshArea()
+            auto &backingDC = GetBackingDCForRepaint();
+            {
+               wxDCClipper clipper{ backingDC, mDamage };
+               DrawTracks(&backingDC);
+            }
+            mDamage.Clear();
+         }
+
          // Copy full, possibly clipped, damage rectangle
          RepairBitmap(dc, box.x, box.y, box.width, box.height);
       }
@@ -649,7 +689,11 @@ namespace
       // This flag is superfluous if you do full refresh,
       // because TrackPanel::Refresh() does this too
       if (refreshResult & UpdateSelection) {
-         panel->DisplaySelection();
+         if (refreshAll)
+            panel->DisplaySelection();
+         else
+            // Repaints just the tracks whose selection changed
+            panel->UpdateSelectionDisplay();
 
          {
             // Formerly in TrackPanel::UpdateSelectionDisplay():
@@ -975,9 +1019,55 @@ bool TrackPanel::ChangeTarget(bool forward, bool cycle)
 
 void TrackPanel::UpdateSelectionDisplay()
 {
-   // Full refresh since the label area may need to indicate
-   // newly selected tracks.
-   Refresh(false);
+   const auto &oldRegion = mLastDrawnSelectedRegion;
+   const auto &newRegion = mViewInfo->selectedRegion;
+   std::vector<Track*> flipped;
+   if (!GetTracks()->TakeSelectionChanges(flipped) ||
+       oldRegion.f0() != newRegion.f0() || oldRegion.f1() != newRegion.f1())
+      // Too many tracks changed to list, or the frequencies changed, which
+      // shade the spectra of all selected tracks
+      Refresh(false);
+   else {
+      const auto rect = GetRect();
+      auto refreshTrack = [&](const Track *t, int x0, int x1) {
+         const int y = t->GetY() - mViewInfo->vpos;
+         if (x1 > x0 && y + t->GetHeight() > 0 && y < rect.height)
+            RefreshArea({ x0, y, x1 - x0, t->GetHeight() });
+      };
+
+      // Whole rows, since the label area indicates the selection
+      for (auto t : flipped)
+         refreshTrack(t, 0, rect.width);
+
+      if (oldRegion.t0() != newRegion.t0() ||
+          oldRegion.t1() != newRegion.t1()) {
+         // Of wave tracks selected before and after, only the shading
+         // changed, between the old and NEW positions of each edge
+         const int left = GetLeftOffset();
+         auto edgeBand = [&](double t0, double t1) {
+            const auto x0 = mViewInfo->TimeToPosition(t0, left);
+            const auto x1 = mViewInfo->TimeToPosition(t1, left);
+            const int lo = std::max<wxInt64>(left, std::min(x0, x1) - 1);
+            const int hi = std::min<wxInt64>(rect.width, std::max(x0, x1) + 2);
+            return std::make_pair(lo, hi);
+         };
+         const auto bands = { edgeBand(oldRegion.t0(), newRegion.t0()),
+                              edgeBand(oldRegion.t1(), newRegion.t1()) };
+         std::sort(flipped.begin(), flipped.end());
+         TrackListIterator iter(GetTracks());
+         for (auto t = iter.First(); t; t = iter.Next()) {
+            if (!t->GetSelected() ||
+                std::binary_search(flipped.begin(), flipped.end(), t))
+               continue;
+            if (t->GetKind() == Track::Wave)
+               for (const auto &band : bands)
+                  refreshTrack(t, band.first, band.second);
+            else
+               // Others may draw the selection anywhere, as labels do
+               refreshTrack(t, left, rect.width);
+         }
+      }
+   }
 
    // Make sure the ruler follows suit.
    mRuler->DrawSelection();
@@ -1491,14 +1581,6 @@ try
       // parent window 'come alive' if it didn't have focus.
       wxActivateEvent e;
       GetParent()->GetEventHandler()->ProcessEvent(e);
-
-      // wxTimers seem to be a little unreliable, so this
-      // "primes" it to make sure it keeps going for a while...
-
-      // When this timer fires, we call TrackPanel::OnTimer and
-      // possibly update the screen for offscreen scrolling.
-      mTimer.Stop();
-      mTimer.Start(kTimerInterval, FALSE);
    }
 
    if (event.ButtonDown()) {
@@ -1685,6 +1767,61 @@ void TrackPanel::RefreshTrack(Track *trk, bool refreshbacking)
 }
 
 
+void TrackPanel::RefreshArea(const wxRect &rect)
+{
+   mDamage.Union(rect);
+   wxWindow::Refresh(false, &rect);
+}
+
+void TrackPanel::RecordDrawnView()
+{
+   mDrawnValid = true;
+   mDrawnH = mViewInfo->h;
+   mDrawnZoom = mViewInfo->GetZoom();
+   mDrawnVpos = mViewInfo->vpos;
+   mDrawnGeneration = GetTracks()->GetGeneration();
+}
+
+void TrackPanel::RefreshAfterScroll()
+{
+   // Where the column drawn first is now
+   const double shift = mViewInfo->TimeToPosition(mDrawnH, 0);
+   const int dx = (int)floor(shift + 0.5);
+
+   int width, height;
+   GetTracksUsableArea(&width, &height);
+   const wxRect area{ GetLeftOffset(), 0, width, height };
+
+   // Only a whole number of pixels, of a view that is otherwise as drawn,
+   // can be moved.  Recording adds to the tracks without touching them,
+   // and the names over waveforms do not move with the view.
+   const bool recording =
+      IsAudioActive() && gAudioIO->GetNumCaptureChannels() > 0;
+   if (!mDrawnValid || mRefreshBacking || !mDamage.IsEmpty() ||
+       recording || mTrackArtist->ShowsTrackNameInWaveform() ||
+       fabs(shift - dx) > 0.001 ||
+       mDrawnZoom != mViewInfo->GetZoom() ||
+       mDrawnVpos != mViewInfo->vpos ||
+       mDrawnGeneration != GetTracks()->GetGeneration() ||
+       mLastDrawnSelectedRegion != mViewInfo->selectedRegion ||
+       !ScrollBacking(area, dx)) {
+      Refresh(false);
+      return;
+   }
+
+   mDrawnH = mViewInfo->h;
+   if (dx == 0)
+      return;
+
+   // Draw the columns uncovered, and copy the rest from the backing bitmap
+   // as moved
+   if (dx > 0)
+      mDamage.Union(wxRect{ area.x, 0, dx, height });
+   else
+      mDamage.Union(wxRect{ area.GetRight() + 1 + dx, 0, -dx, height });
+   wxWindow::Refresh(false, &area);
+}
+
 /// This method overrides Refresh() of wxWindow so that the
 /// boolean play indictaor can be set to false, so that an old play indicator that is
 /// no longer there won't get  XORed (to erase it), thus redrawing it on the
@@ -14,10 +14,12 @@
 #include "MemoryX.h"
 #include <vector>
 
+#include <wx/region.h>
 #include <wx/timer.h>
 
 #include "Experimental.h"
 
+#include "FrameClock.h"
 #include "HitTestResult.h"
 
 #include "SelectedRegion.h"
@@ -191,6 +193,9 @@ class AUDACITY_DLL_API TrackPanel final : public OverlayPanel {
 
    void OnIdle(wxIdleEvent & event);
    void OnTimer(wxTimerEvent& event);
+   // Tells on-demand tasks what is visible and where play is, so that
+   // they load and summarize there first
+   void UpdateODFocus();
 
    int GetLeftOffset() const { return GetLabelWidth() + 1;}
 
@@ -204,6 +209,17 @@ class AUDACITY_DLL_API TrackPanel final : public OverlayPanel {
 
    void RefreshTrack(Track *trk, bool refreshbacking = true);
 
+   // Redraw just this part of the panel, in panel coordinates, into the
+   // backing bitmap and the screen.  Areas accumulate until the next paint,
+   // which draws only the tracks they touch.
+   void RefreshArea(const wxRect &rect);
+
+   // After the view scrolled sideways, move what the backing bitmap shows
+   // of the tracks by as many pixels, and redraw only the columns that
+   // come into view.  Redraw everything instead if anything else changed
+   // since the last full drawing.
+   void RefreshAfterScroll();
+
    void DisplaySelection();
 
    void HandleInterruptedDrag();
@@ -248,10 +264,11 @@ public:
    size_t GetTrackCount() const;
    size_t GetSelectedTrackCount() const;
 
-protected:
+   // Repaints what changed of the selection since the last paint: the
+   // tracks selected or deselected, and the bands between the old and NEW
+   // times of those selected throughout
    void UpdateSelectionDisplay();
 
-public:
    void UpdateAccessibility();
    void MessageForScreenReader(const wxString& message);
 
@@ -347,26 +364,27 @@ protected:
 
    std::unique_ptr<TrackArtist> mTrackArtist;
 
-   class AUDACITY_DLL_API AudacityTimer final : public wxTimer {
-   public:
-     void Notify() override{
-       // (From Debian)
-       //
-       // Don't call parent->OnTimer(..) directly here, but instead post
-       // an event. This ensures that this is a pure wxWidgets event
-       // (no GDK event behind it) and that it therefore isn't processed
-       // within the YieldFor(..) of the clipboard operations (workaround
-       // for Debian bug #765341).
-       // QueueEvent() will take ownership of the event
-       parent->GetEventHandler()->QueueEvent(safenew wxTimerEvent(*this));
-     }
-     TrackPanel *parent;
-   } mTimer;
+   // Calls OnTimer() every kTimerInterval, in the ticks of the FrameClock
+   FrameClock::Subscription mFrames;
 
    int mTimeCount;
 
+   // What UpdateODFocus() last told the tasks
+   double mODViewStart { 0.0 }, mODViewEnd { 0.0 }, mODPlayhead { -1.0 };
+
    bool mRefreshBacking;
 
+   // Areas given to RefreshArea() since the last paint
+   wxRegion mDamage;
+
+   // The view that the backing bitmap shows, for RefreshAfterScroll()
+   bool mDrawnValid { false };
+   double mDrawnH {};
+   double mDrawnZoom {};
+   int mDrawnVpos {};
+   unsigned long mDrawnGeneration {};
+   void RecordDrawnView();
+
    bool mRedrawAfterStop;
 
    wxMouseState mLastMouseState;
@@ -17,6 +17,8 @@
 #include "Audacity.h"
 #include "TrackPanelAx.h"
 
+#include <algorithm>
+
 // For compilers that support precompilation, includes "wx/wx.h".
 #include <wx/wxprec.h>
 
@@ -31,6 +33,13 @@
 #include "Track.h"
 #include "Internat.h"
 
+#if wxUSE_ACCESSIBILITY
+namespace {
+// Least time between sending events, in milliseconds
+const int kFlushMs = 100;
+}
+#endif
+
 TrackPanelAx::TrackPanelAx( wxWindow *window )
 #if wxUSE_ACCESSIBILITY
    :wxWindowAccessible( window )
@@ -78,10 +87,7 @@ std::shared_ptr<Track> TrackPanelAx::SetFocus( std::shared_ptr<Track> track )
    auto focusedTrack = mFocusedTrack.lock();
    if( focusedTrack && !focusedTrack->GetSelected() )
    {
-      NotifyEvent( wxACC_EVENT_OBJECT_SELECTIONREMOVE,
-                   mTrackPanel,
-                   wxOBJID_CLIENT,
-                   TrackNum( focusedTrack ) );
+      Notify( wxACC_EVENT_OBJECT_SELECTIONREMOVE, OfTrack, focusedTrack );
    }
 #endif
 
@@ -96,27 +102,16 @@ std::shared_ptr<Track> TrackPanelAx::SetFocus( std::shared_ptr<Track> track )
 #if wxUSE_ACCESSIBILITY
    if( track )
    {
-      int num = TrackNum( track );
-
-      NotifyEvent( wxACC_EVENT_OBJECT_FOCUS,
-                   mTrackPanel,
-                   wxOBJID_CLIENT,
-                   num );
+      Notify( wxACC_EVENT_OBJECT_FOCUS, OfTrack, track );
 
       if( track->GetSelected() )
       {
-         NotifyEvent( wxACC_EVENT_OBJECT_SELECTION,
-                      mTrackPanel,
-                      wxOBJID_CLIENT,
-                      num );
+         Notify( wxACC_EVENT_OBJECT_SELECTION, OfTrack, track );
       }
    }
    else
    {
-      NotifyEvent(wxACC_EVENT_OBJECT_FOCUS,
-         mTrackPanel,
-         wxOBJID_CLIENT,
-         wxACC_SELF);
+      Notify( wxACC_EVENT_OBJECT_FOCUS, Self );
    }
 
 #endif
@@ -150,64 +145,36 @@ int TrackPanelAx::TrackNum( const std::shared_ptr<Track> &target )
 {
    // Find 1-based position of the target in the visible tracks, or 0 if not
    // found
-   TrackListIterator iter( mTrackPanel->GetTracks() );
-   Track *t = iter.First();
-   int ndx = 0;
-
-   while( t != NULL )
-   {
-      ndx++;
-      if( t == target.get() )
-      {
-         return ndx;
-      }
-
-      t = iter.Next( true );
-   }
-
-   return 0;
+   return mTrackPanel->GetTracks()->FindGroup( target.get() ) + 1;
 }
 
 std::shared_ptr<Track> TrackPanelAx::FindTrack( int num )
 {
-   TrackListIterator iter( mTrackPanel->GetTracks() );
-   Track *t = iter.First();
-   int ndx = 0;
-
-   while( t != NULL )
-   {
-      ndx++;
-      if( ndx == num )
-      {
-         break;
-      }
-
-      t = iter.Next( true );
-   }
+   if( num < 1 )
+      return {};
 
-   return Track::Pointer( t );
+   return Track::Pointer( mTrackPanel->GetTracks()->GetGroup( num - 1 ) );
 }
 
 void TrackPanelAx::Updated()
 {
 #if wxUSE_ACCESSIBILITY
-   auto t = GetFocus();
    mTrackName = true;
 
    // logically, this should be an OBJECT_NAMECHANGE event, but Window eyes 9.1
    // does not read out the name with this event type, hence use OBJECT_FOCUS.
-   NotifyEvent(wxACC_EVENT_OBJECT_FOCUS,
-               mTrackPanel,
-               wxOBJID_CLIENT,
-               TrackNum(t));
+   Notify(wxACC_EVENT_OBJECT_FOCUS, OfFocus);
 #endif
 }
 
 void TrackPanelAx::MessageForScreenReader(const wxString& message)
 {
 #if wxUSE_ACCESSIBILITY
-   if (mTrackPanel == wxWindow::FindFocus())
+   if (mQueried && mTrackPanel == wxWindow::FindFocus())
    {
+      // Send the events that wait first, so that the message comes last
+      Flush();
+
       auto t = GetFocus();
       int childId = t ? TrackNum(t) : 0;
 
@@ -231,6 +198,56 @@ void TrackPanelAx::MessageForScreenReader(const wxString& message)
 
 #if wxUSE_ACCESSIBILITY
 
+void TrackPanelAx::Notify(int type, Target target,
+                          const std::shared_ptr<Track> &track)
+{
+   // Nobody would hear it
+   if (!mQueried)
+      return;
+
+   // A later event of a kind for a child replaces the earlier, and only
+   // the last change of focus matters
+   mPending.erase(std::remove_if(mPending.begin(), mPending.end(),
+      [&](const PendingEvent &event) {
+         return event.type == type &&
+            (type == wxACC_EVENT_OBJECT_FOCUS ||
+             (event.target == target && event.track.lock() == track));
+      }), mPending.end());
+   mPending.push_back({ type, target, track });
+
+   const auto now = ::wxGetLocalTimeMillis();
+   if (now - mLastFlush >= kFlushMs)
+      Flush();
+   else if (!mFlushTimer.IsRunning())
+      mFlushTimer.StartOnce((mLastFlush + kFlushMs - now).ToLong());
+}
+
+void TrackPanelAx::Flush()
+{
+   mFlushTimer.Stop();
+   mLastFlush = ::wxGetLocalTimeMillis();
+
+   // GetFocus() may add more, for next time
+   std::vector<PendingEvent> pending;
+   pending.swap(mPending);
+   for (const auto &event : pending)
+   {
+      int childId = wxACC_SELF;
+      if (event.target == OfTrack)
+      {
+         auto track = event.track.lock();
+         // Removed since
+         if (!track)
+            continue;
+         childId = TrackNum(track);
+      }
+      else if (event.target == OfFocus)
+         childId = TrackNum(GetFocus());
+
+      NotifyEvent(event.type, mTrackPanel, wxOBJID_CLIENT, childId);
+   }
+}
+
 // Retrieves the address of an IDispatch interface for the specified child.
 // All objects must support this property.
 wxAccStatus TrackPanelAx::GetChild( int childId, wxAccessible** child )
@@ -250,23 +267,8 @@ wxAccStatus TrackPanelAx::GetChild( int childId, wxAccessible** child )
 // Gets the number of children.
 wxAccStatus TrackPanelAx::GetChildCount( int* childCount )
 {
-   TrackListIterator iter( mTrackPanel->GetTracks() );
-   Track *t = iter.First();
-   int cnt = 0;
-
-   while( t != NULL )
-   {
-      cnt++;
-
-      if( t->GetLink() != NULL )
-      {
-         t = iter.Next();
-      }
-
-      t = iter.Next();
-   }
-
-   *childCount = cnt;
+   Queried();
+   *childCount = mTrackPanel->GetTracks()->GetGroupCount();
 
    return wxACC_OK;
 }
@@ -313,6 +315,7 @@ wxAccStatus TrackPanelAx::GetKeyboardShortcut( int WXUNUSED(childId), wxString *
 // rect is in screen coordinates.
 wxAccStatus TrackPanelAx::GetLocation( wxRect& rect, int elementId )
 {
+   Queried();
    wxRect client;
 
    if( elementId == wxACC_SELF )
@@ -347,6 +350,7 @@ wxAccStatus TrackPanelAx::GetLocation( wxRect& rect, int elementId )
 // Gets the name of the specified object.
 wxAccStatus TrackPanelAx::GetName( int childId, wxString* name )
 {
+   Queried();
 #if defined(__WXMSW__) || defined(__WXMAC__)
    if (mTrackName)
    {
@@ -423,6 +427,7 @@ wxAccStatus TrackPanelAx::GetName( int childId, wxString* name )
 // Returns a role constant.
 wxAccStatus TrackPanelAx::GetRole( int childId, wxAccRole* role )
 {
+   Queried();
 #if defined(__WXMSW__)
    if (mTrackName)
    {
@@ -471,6 +476,7 @@ wxAccStatus TrackPanelAx::GetSelections( wxVariant * WXUNUSED(selections) )
 // Returns a state constant.
 wxAccStatus TrackPanelAx::GetState( int childId, long* state )
 {
+   Queried();
 #if defined(__WXMSW__)
    if( childId > 0 )
    {
@@ -573,6 +579,7 @@ wxAccStatus TrackPanelAx::GetValue( int WXUNUSED(childId), wxString* WXUNUSED(st
 // If this object has the focus, child should be 'this'.
 wxAccStatus TrackPanelAx::GetFocus( int *childId, wxAccessible **child )
 {
+   Queried();
 #if defined(__WXMSW__)
 
    if (mTrackPanel == wxWindow::FindFocus())
@@ -13,6 +13,9 @@
 
 #include <wx/window.h>
 #include <wx/panel.h>
+#include <wx/timer.h>
+
+#include <vector>
 
 #if wxUSE_ACCESSIBILITY
 #include <wx/access.h>
@@ -41,7 +44,8 @@ public:
    // Returns TRUE if passed track has the focus
    bool IsFocused( Track *track );
 
-   // Called to signal changes to a track
+   // Called to signal changes to a track; the name is made when a client
+   // asks for it
    void Updated();
 
    void MessageForScreenReader(const wxString& message);
@@ -124,6 +128,36 @@ private:
    wxString mMessage;
    bool mTrackName;
    int mMessageCount;
+
+#if wxUSE_ACCESSIBILITY
+   // Events wait here until a tenth of a second has passed since the last
+   // were sent, so that a burst of changes, as in a drag or in playback,
+   // sends each event once.  The children they concern are found when
+   // sent, and none at all are sent before a client, such as a screen
+   // reader, has asked for something.
+   enum Target { Self, OfTrack, OfFocus };
+   struct PendingEvent {
+      int type;
+      Target target;
+      std::weak_ptr<Track> track;
+   };
+   void Notify(int type, Target target, const std::shared_ptr<Track> &track = {});
+   void Flush();
+   void Queried() { mQueried = true; }
+
+   class FlushTimer final : public wxTimer {
+    public:
+      explicit FlushTimer(TrackPanelAx &ax) : mAx(ax) {}
+      void Notify() override { mAx.Flush(); }
+    private:
+      TrackPanelAx &mAx;
+   };
+   FlushTimer mFlushTimer{ *this };
+
+   std::vector<PendingEvent> mPending;
+   wxLongLong mLastFlush{ 0 };
+   bool mQueried{ false };
+#endif
 };
 
 #endif // __AUDACITY_TRACK_PANEL_ACCESSIBILITY__
@@ -26,10 +26,13 @@ UndoManager
 
 #include "BlockFile.h"
 #include "Diags.h"
+#include "Envelope.h"
 #include "Internat.h"
+#include "Prefs.h"
 #include "Project.h"
 #include "Sequence.h"
 #include "WaveTrack.h"          // temp
+#include "blockfile/SliceBlockFile.h"
 #include "Diags.h"
 
 #include "UndoManager.h"
@@ -40,6 +43,7 @@ UndoManager
 
 using ConstBlockFilePtr = const BlockFile*;
 using Set = std::unordered_set<ConstBlockFilePtr>;
+using ArraySet = std::unordered_set<const BlockArray*>;
 
 struct UndoStackElem {
 
@@ -72,7 +76,7 @@ UndoManager::~UndoManager()
 
 namespace {
    SpaceArray::value_type
-   CalculateUsage(TrackList *tracks, Set *seen)
+   CalculateUsage(TrackList *tracks, Set *seen, ArraySet *seenArrays)
    {
       SpaceArray::value_type result = 0;
 
@@ -85,10 +89,29 @@ namespace {
          for(const auto &clip : wt->GetAllClips())
          {
             // Scan all blockfiles within current clip
-            BlockArray *blocks = clip->GetSequenceBlockArray();
+            // Read through a const clip, not to unshare its blocks
+            const WaveClip *constClip = clip;
+
+            // Blocks that a lazy open has not yet made are in the saved
+            // project, and those of a cut line not yet needed are in the
+            // state it was cut from; reading them here would make them all
+            if (!constClip->GetSequence()->IsBlockArrayLoaded())
+               continue;
+
+            const BlockArray *blocks = constClip->GetSequenceBlockArray();
+
+            // States share the block arrays of the clips that did not
+            // change between them, and all the files of an array were
+            // counted where it was first seen
+            if (seenArrays && !seenArrays->insert(blocks).second)
+               continue;
+
             for (const auto &block : *blocks)
             {
-               const auto &file = block.f;
+               // A slice uses the space of its base
+               const auto &file = block.f->IsSlice()
+                  ? static_cast<const SliceBlockFile&>(*block.f).GetBase()
+                  : block.f;
 
                // Accumulate space used by the file if the file was not
                // yet seen
@@ -111,12 +134,95 @@ namespace {
    }
 }
 
+namespace {
+   // Bytes of memory that the track holds, not counting block arrays
+   // already seen, as the states share those of unchanged clips
+   size_t EstimateMemory(Track *t, ArraySet &seenArrays)
+   {
+      size_t result = sizeof(WaveTrack);
+      if (t->GetKind() != Track::Wave)
+         return result;
+
+      for (const auto &clip : static_cast<WaveTrack*>(t)->GetAllClips()) {
+         const WaveClip *constClip = clip;
+         result += sizeof(WaveClip) + sizeof(Sequence) + sizeof(Envelope) +
+            constClip->GetEnvelope()->GetNumberOfPoints() * sizeof(EnvPoint);
+
+         if (!constClip->GetSequence()->IsBlockArrayLoaded())
+            continue;
+         const BlockArray *blocks = constClip->GetSequenceBlockArray();
+         if (seenArrays.insert(blocks).second)
+            result += blocks->capacity() * sizeof(SeqBlock);
+      }
+
+      return result;
+   }
+
+   size_t EstimateMemory(TrackList *tracks, ArraySet &seenArrays)
+   {
+      size_t result = 0;
+
+      TrackListIterator iter(tracks);
+      for (Track *t = iter.First(); t; t = iter.Next())
+         result += EstimateMemory(t, seenArrays);
+
+      return result;
+   }
+}
+
+unsigned long long UndoManager::EstimateTrackMemory(TrackId id)
+{
+   unsigned long long result = 0;
+   ArraySet seenArrays;
+   for (const auto &elem : stack) {
+      TrackListIterator iter(elem->state.tracks.get());
+      for (Track *t = iter.First(); t; t = iter.Next())
+         if (t->GetId() == id)
+            result += EstimateMemory(t, seenArrays);
+   }
+   return result;
+}
+
+void UndoManager::EnforceMemoryLimit()
+{
+   const long limitMB = gPrefs->Read(wxT("/GUI/UndoMemoryLimitMB"), 512L);
+   if (limitMB <= 0)
+      return;
+   const unsigned long long limit = limitMB * 1024ULL * 1024ULL;
+
+   // Charge each shared array to the latest state having it, so that what
+   // is charged to the oldest state is what discarding it frees
+   std::vector<size_t> usage(stack.size());
+   unsigned long long total = 0;
+   ArraySet seenArrays;
+   for (size_t nn = stack.size(); nn--;)
+      total += usage[nn] =
+         EstimateMemory(stack[nn]->state.tracks.get(), seenArrays);
+
+   // Keep the current state, and the states that Redo may reach
+   size_t nn = 0;
+   while (total > limit && (int)nn < current)
+      total -= usage[nn++];
+   if (nn > 0)
+      RemoveStates(nn);
+}
+
 void UndoManager::CalculateSpaceUsage()
 {
+   // Clipboard changes are not seen here, so always count it
+   mClipboardSpaceUsage = CalculateUsage
+      (AudacityProject::GetClipboardTracks(), nullptr, nullptr);
+
+   // Mark valid before counting, so that changes by on-demand tasks
+   // meanwhile are counted next time
+   if (mSpaceValid.exchange(true) && space.size() == stack.size())
+      return;
+
    space.clear();
    space.resize(stack.size(), 0);
 
    Set seen;
+   ArraySet seenArrays;
 
    // After copies and pastes, a block file may be used in more than
    // one place in one undo history state, and it may be used in more than
@@ -136,12 +242,9 @@ void UndoManager::CalculateSpaceUsage()
    {
       // Scan all tracks at current level
       auto tracks = stack[nn]->state.tracks.get();
-      space[nn] = CalculateUsage(tracks, &seen);
+      space[nn] = CalculateUsage(tracks, &seen, &seenArrays);
    }
 
-   mClipboardSpaceUsage = CalculateUsage
-      (AudacityProject::GetClipboardTracks(), nullptr);
-
    //TIMER_STOP( space_calc );
 }
 
@@ -160,6 +263,14 @@ wxLongLong_t UndoManager::GetLongDescription(unsigned int n, wxString *desc,
    return space[n];
 }
 
+wxLongLong_t UndoManager::GetTotalSpaceUsage() const
+{
+   wxLongLong_t total = 0;
+   for (const auto usage : space)
+      total += usage;
+   return total;
+}
+
 void UndoManager::GetShortDescription(unsigned int n, wxString *desc)
 {
    n -= 1; // 1 based to zero based
@@ -181,6 +292,13 @@ void UndoManager::SetLongDescription(unsigned int n, const wxString &desc)
 void UndoManager::RemoveStateAt(int n)
 {
    stack.erase(stack.begin() + n);
+
+   // Files are counted in the last state having them, so removing the
+   // oldest state leaves the others as they were
+   if (n == 0 && space.size() == stack.size() + 1)
+      space.erase(space.begin());
+   else
+      mSpaceValid = false;
 }
 
 void UndoManager::RemoveStates(int num)
@@ -239,6 +357,7 @@ void UndoManager::ModifyState(const TrackList * l,
 
    // Replace
    stack[current]->state.tracks = std::move(tracksCopy);
+   mSpaceValid = false;
 
    stack[current]->state.selectedRegion = selectedRegion;
 }
@@ -287,12 +406,15 @@ void UndoManager::PushState(const TrackList * l,
    );
 
    current++;
+   mSpaceValid = false;
 
    if (saved >= current) {
       saved = -1;
    }
 
    lastAction = longDescription;
+
+   EnforceMemoryLimit();
 }
 
 const UndoState &UndoManager::SetStateTo
@@ -386,6 +508,8 @@ void UndoManager::SetODChangesFlag()
    mODChangesMutex.Lock();
    mODChanges=true;
    mODChangesMutex.Unlock();
+   // Decoding and summaries change the sizes of files
+   mSpaceValid = false;
 }
 
 bool UndoManager::HasODChangesFlag()
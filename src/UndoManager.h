@@ -9,8 +9,10 @@
   After each operation, call UndoManager's PushState, pass it
   the entire track hierarchy.  The UndoManager makes a duplicate
   of every single track using its Duplicate method, which should
-  increment reference counts.  If we were not at the top of
-  the stack when this is called, DELETE above first.
+  increment reference counts.  The copies share the block arrays of
+  their sequences until either side changes them, so a state costs
+  little more than its clips and envelopes.  If we were not at the top
+  of the stack when this is called, DELETE above first.
 
   If a minor change is made, for example changing the visual
   display of a track or changing the selection, you can call
@@ -50,12 +52,14 @@
 #define __AUDACITY_UNDOMANAGER__
 
 #include "MemoryX.h"
+#include <atomic>
 #include <vector>
 #include <wx/string.h>
 #include "ondemand/ODTaskThread.h"
 #include "SelectedRegion.h"
 
 class Track;
+class TrackId;
 class TrackList;
 
 struct UndoStackElem;
@@ -106,9 +110,19 @@ class AUDACITY_DLL_API UndoManager {
 
    void StopConsolidating() { mayConsolidate = false; }
 
+   // Discards the oldest states, while their tracks take more memory than
+   // the preference allows, but never the current state
+   void EnforceMemoryLimit();
+
+   // Bytes of memory that all the states hold for the track of the id,
+   // counting once the block arrays that states share
+   unsigned long long EstimateTrackMemory(TrackId id);
+
    void GetShortDescription(unsigned int n, wxString *desc);
    // Return value must first be calculated by CalculateSpaceUsage():
    wxLongLong_t GetLongDescription(unsigned int n, wxString *desc, wxString *size);
+   // Return value must first be calculated by CalculateSpaceUsage():
+   wxLongLong_t GetTotalSpaceUsage() const;
    void SetLongDescription(unsigned int n, const wxString &desc);
 
    const UndoState &SetStateTo(unsigned int n, SelectedRegion *selectedRegion);
@@ -127,6 +141,8 @@ class AUDACITY_DLL_API UndoManager {
    wxLongLong_t GetClipboardSpaceUsage() const
    { return mClipboardSpaceUsage; }
 
+   // Recalculates the usage of the states only if they changed since the
+   // last time, or on-demand tasks may have changed the files
    void CalculateSpaceUsage();
 
    // void Debug(); // currently unused
@@ -145,6 +161,8 @@ class AUDACITY_DLL_API UndoManager {
    bool mayConsolidate { false };
 
    SpaceArray space;
+   // Whether space is up to date; on-demand threads may clear it
+   std::atomic<bool> mSpaceValid { false };
    unsigned long long mClipboardSpaceUsage {};
 
    bool mODChanges;
@@ -0,0 +1,310 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   VectorMath.cpp
+
+*******************************************************************//**
+
+\file VectorMath.cpp
+\brief Logarithms, exponentials and decibels of buffers of floats, and
+the levels of blocks of samples.
+
+The polynomials are those of the cephes library, as Julien Pommier
+vectorised them in SseMathFuncs.h.  Here they are written once, over a
+few inline wrappers of SSE2 or NEON, rather than once for each
+instruction set.  As for the kernels of Mix.cpp and Dither.cpp, the
+instruction set is chosen at compile time, since SSE2 and NEON are the
+baselines of x86-64 and 64 bit ARM; elsewhere, and for the last few
+samples of a buffer, the functions of <cmath> do the work.
+
+Wider vectors would need compiler flags for single files and a choice at
+run time, which nothing else in Audacity does; the callers convert a
+column or a meter update at a time, so four lanes already take the cost
+below that of the drawing.
+
+*//*******************************************************************/
+
+#include "Audacity.h"
+#include "VectorMath.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VECTOR_MATH_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define VECTOR_MATH_NEON
+#endif
+
+namespace {
+
+#if defined(VECTOR_MATH_SSE2)
+using Vec = __m128;
+using IVec = __m128i;
+inline Vec Load(const float *p) { return _mm_loadu_ps(p); }
+inline void Store(float *p, Vec v) { _mm_storeu_ps(p, v); }
+inline Vec Splat(float f) { return _mm_set1_ps(f); }
+inline Vec Add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec Sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+inline Vec Mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+inline Vec Min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+inline Vec Max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+inline Vec Abs(Vec v)
+   { return _mm_and_ps(v, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff))); }
+// All bits set in lanes where the comparison holds
+inline Vec Less(Vec a, Vec b) { return _mm_cmplt_ps(a, b); }
+inline Vec LessEqual(Vec a, Vec b) { return _mm_cmple_ps(a, b); }
+inline Vec And(Vec a, Vec b) { return _mm_and_ps(a, b); }
+inline Vec Or(Vec a, Vec b) { return _mm_or_ps(a, b); }
+inline IVec Bits(Vec v) { return _mm_castps_si128(v); }
+inline Vec FromBits(IVec v) { return _mm_castsi128_ps(v); }
+inline IVec SplatInt(int i) { return _mm_set1_epi32(i); }
+inline IVec AddInt(IVec a, IVec b) { return _mm_add_epi32(a, b); }
+inline IVec SubInt(IVec a, IVec b) { return _mm_sub_epi32(a, b); }
+inline IVec AndInt(IVec a, IVec b) { return _mm_and_si128(a, b); }
+inline IVec OrInt(IVec a, IVec b) { return _mm_or_si128(a, b); }
+inline IVec ShiftRight23(IVec v) { return _mm_srli_epi32(v, 23); }
+inline IVec ShiftLeft23(IVec v) { return _mm_slli_epi32(v, 23); }
+inline Vec ToFloat(IVec v) { return _mm_cvtepi32_ps(v); }
+inline IVec Truncate(Vec v) { return _mm_cvttps_epi32(v); }
+#define VECTOR_MATH
+#elif defined(VECTOR_MATH_NEON)
+using Vec = float32x4_t;
+using IVec = int32x4_t;
+inline Vec Load(const float *p) { return vld1q_f32(p); }
+inline void Store(float *p, Vec v) { vst1q_f32(p, v); }
+inline Vec Splat(float f) { return vdupq_n_f32(f); }
+inline Vec Add(Vec a, Vec b) { return vaddq_f32(a, b); }
+inline Vec Sub(Vec a, Vec b) { return vsubq_f32(a, b); }
+inline Vec Mul(Vec a, Vec b) { return vmulq_f32(a, b); }
+inline Vec Min(Vec a, Vec b) { return vminq_f32(a, b); }
+inline Vec Max(Vec a, Vec b) { return vmaxq_f32(a, b); }
+inline Vec Abs(Vec v) { return vabsq_f32(v); }
+inline Vec Less(Vec a, Vec b)
+   { return vreinterpretq_f32_u32(vcltq_f32(a, b)); }
+inline Vec LessEqual(Vec a, Vec b)
+   { return vreinterpretq_f32_u32(vcleq_f32(a, b)); }
+inline Vec And(Vec a, Vec b)
+{
+   return vreinterpretq_f32_u32(
+      vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+inline Vec Or(Vec a, Vec b)
+{
+   return vreinterpretq_f32_u32(
+      vorrq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b)));
+}
+inline IVec Bits(Vec v) { return vreinterpretq_s32_f32(v); }
+inline Vec FromBits(IVec v) { return vreinterpretq_f32_s32(v); }
+inline IVec SplatInt(int i) { return vdupq_n_s32(i); }
+inline IVec AddInt(IVec a, IVec b) { return vaddq_s32(a, b); }
+inline IVec SubInt(IVec a, IVec b) { return vsubq_s32(a, b); }
+inline IVec AndInt(IVec a, IVec b) { return vandq_s32(a, b); }
+inline IVec OrInt(IVec a, IVec b) { return vorrq_s32(a, b); }
+inline IVec ShiftRight23(IVec v)
+   { return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(v), 23)); }
+inline IVec ShiftLeft23(IVec v) { return vshlq_n_s32(v, 23); }
+inline Vec ToFloat(IVec v) { return vcvtq_f32_s32(v); }
+inline IVec Truncate(Vec v) { return vcvtq_s32_f32(v); }
+#define VECTOR_MATH
+#endif
+
+#ifdef VECTOR_MATH
+
+// a * x + b
+inline Vec MulAdd(Vec a, Vec x, Vec b) { return Add(Mul(a, x), b); }
+
+// log_ps() of SseMathFuncs.h
+inline Vec Log(Vec x)
+{
+   const auto one = Splat(1.0f);
+   const auto invalid = LessEqual(x, Splat(0.0f));
+
+   // Keep denormals and zero finite; the invalid mask makes NaN of them
+   x = Max(x, Splat(FLT_MIN));
+
+   // Split into exponent and a mantissa in [0.5, 1)
+   auto bits = Bits(x);
+   auto emm0 = ShiftRight23(bits);
+   bits = AndInt(bits, SplatInt(~0x7f800000));
+   bits = OrInt(bits, Bits(Splat(0.5f)));
+   x = FromBits(bits);
+   emm0 = SubInt(emm0, SplatInt(0x7f));
+   auto e = Add(ToFloat(emm0), one);
+
+   // if (x < SQRTHF) { e -= 1; x = x + x - 1.0; } else { x = x - 1.0; }
+   const auto mask = Less(x, Splat(0.707106781186547524f));
+   const auto tmp = And(x, mask);
+   x = Sub(x, one);
+   e = Sub(e, And(one, mask));
+   x = Add(x, tmp);
+
+   const auto z = Mul(x, x);
+   auto y = Splat(7.0376836292E-2f);
+   y = MulAdd(y, x, Splat(-1.1514610310E-1f));
+   y = MulAdd(y, x, Splat(1.1676998740E-1f));
+   y = MulAdd(y, x, Splat(-1.2420140846E-1f));
+   y = MulAdd(y, x, Splat(1.4249322787E-1f));
+   y = MulAdd(y, x, Splat(-1.6668057665E-1f));
+   y = MulAdd(y, x, Splat(2.0000714765E-1f));
+   y = MulAdd(y, x, Splat(-2.4999993993E-1f));
+   y = MulAdd(y, x, Splat(3.3333331174E-1f));
+   y = Mul(Mul(y, x), z);
+
+   y = Add(y, Mul(e, Splat(-2.12194440e-4f)));
+   y = Sub(y, Mul(z, Splat(0.5f)));
+   x = Add(x, y);
+   x = Add(x, Mul(e, Splat(0.693359375f)));
+   return Or(x, invalid);
+}
+
+// exp_ps() of SseMathFuncs.h
+inline Vec Exp(Vec x)
+{
+   const auto one = Splat(1.0f);
+   x = Min(x, Splat(88.3762626647949f));
+   x = Max(x, Splat(-88.3762626647949f));
+
+   // exp(x) = exp(g + n*log(2)), n the nearest integer to x / log(2)
+   auto fx = MulAdd(x, Splat(1.44269504088896341f), Splat(0.5f));
+   // floor(fx), of a truncation that rounds negative values up
+   auto tmp = ToFloat(Truncate(fx));
+   fx = Sub(tmp, And(Less(fx, tmp), one));
+
+   x = Sub(x, Mul(fx, Splat(0.693359375f)));
+   x = Sub(x, Mul(fx, Splat(-2.12194440e-4f)));
+   const auto z = Mul(x, x);
+
+   auto y = Splat(1.9875691500E-4f);
+   y = MulAdd(y, x, Splat(1.3981999507E-3f));
+   y = MulAdd(y, x, Splat(8.3334519073E-3f));
+   y = MulAdd(y, x, Splat(4.1665795894E-2f));
+   y = MulAdd(y, x, Splat(1.6666665459E-1f));
+   y = MulAdd(y, x, Splat(5.0000001201E-1f));
+   y = Add(MulAdd(y, z, x), one);
+
+   // 2^n
+   const auto pow2n = FromBits(ShiftLeft23(
+      AddInt(Truncate(fx), SplatInt(0x7f))));
+   return Mul(y, pow2n);
+}
+
+#endif
+
+}
+
+// log10(e), and ln(10) / 20
+static const float kLog10E = 0.434294481903251828f;
+static const float kDBToLn = 0.115129254649702284f;
+
+void VectorLog(const float *in, float *out, size_t len)
+{
+   size_t ii = 0;
+#ifdef VECTOR_MATH
+   for (; ii + 4 <= len; ii += 4)
+      Store(out + ii, Log(Load(in + ii)));
+#endif
+   for (; ii < len; ++ii)
+      out[ii] = std::log(in[ii]);
+}
+
+void VectorExp(const float *in, float *out, size_t len)
+{
+   size_t ii = 0;
+#ifdef VECTOR_MATH
+   for (; ii + 4 <= len; ii += 4)
+      Store(out + ii, Exp(Load(in + ii)));
+#endif
+   for (; ii < len; ++ii)
+      out[ii] = std::exp(in[ii]);
+}
+
+void VectorLog10(const float *in, float *out, size_t len)
+{
+   size_t ii = 0;
+#ifdef VECTOR_MATH
+   for (; ii + 4 <= len; ii += 4)
+      Store(out + ii, Mul(Log(Load(in + ii)), Splat(kLog10E)));
+#endif
+   for (; ii < len; ++ii)
+      out[ii] = std::log10(in[ii]);
+}
+
+void VectorPow(const float *base, float exponent, float *out, size_t len)
+{
+   size_t ii = 0;
+#ifdef VECTOR_MATH
+   for (; ii + 4 <= len; ii += 4)
+      Store(out + ii, Exp(Mul(Log(Load(base + ii)), Splat(exponent))));
+#endif
+   for (; ii < len; ++ii)
+      out[ii] = std::pow(base[ii], exponent);
+}
+
+void VectorLinearToDB(const float *in, float *out, size_t len)
+{
+   size_t ii = 0;
+#ifdef VECTOR_MATH
+   for (; ii + 4 <= len; ii += 4)
+      Store(out + ii, Mul(Log(Max(Abs(Load(in + ii)), Splat(FLT_MIN))),
+         Splat(20.0f * kLog10E)));
+#endif
+   for (; ii < len; ++ii)
+      out[ii] = 20.0f * std::log10(std::max(std::fabs(in[ii]), FLT_MIN));
+}
+
+void VectorDBToLinear(const float *in, float *out, size_t len)
+{
+   size_t ii = 0;
+#ifdef VECTOR_MATH
+   for (; ii + 4 <= len; ii += 4)
+      Store(out + ii, Exp(Mul(Load(in + ii), Splat(kDBToLn))));
+#endif
+   for (; ii < len; ++ii)
+      out[ii] = std::exp(in[ii] * kDBToLn);
+}
+
+void VectorLevels(const float *in, size_t frames, unsigned channels,
+                  unsigned count, float *peak, float *sumSquares)
+{
+   std::fill(peak, peak + count, 0.0f);
+   std::fill(sumSquares, sumSquares + count, 0.0f);
+
+   const size_t len = frames * channels;
+   size_t ii = 0;
+#ifdef VECTOR_MATH
+   // Lane l holds channel l % channels throughout, when channels divides 4
+   if (4 % channels == 0) {
+      Vec vPeak = Splat(0.0f);
+      Vec vSum = Splat(0.0f);
+      for (; ii + 4 <= len; ii += 4) {
+         const Vec v = Load(in + ii);
+         vPeak = Max(vPeak, Abs(v));
+         vSum = MulAdd(v, v, vSum);
+      }
+
+      float lanePeak[4], laneSum[4];
+      Store(lanePeak, vPeak);
+      Store(laneSum, vSum);
+      for (unsigned l = 0; l < 4; ++l) {
+         const auto c = l % channels;
+         if (c < count) {
+            peak[c] = std::max(peak[c], lanePeak[l]);
+            sumSquares[c] += laneSum[l];
+         }
+      }
+   }
+#endif
+   for (; ii < len; ++ii) {
+      const auto c = ii % channels;
+      if (c < count) {
+         peak[c] = std::max(peak[c], std::fabs(in[ii]));
+         sumSquares[c] += in[ii] * in[ii];
+      }
+   }
+}
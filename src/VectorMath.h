@@ -0,0 +1,44 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+
+   VectorMath.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_VECTOR_MATH__
+#define __AUDACITY_VECTOR_MATH__
+
+#include "Audacity.h"
+
+#include <stddef.h>
+
+/// Logarithms, exponentials and decibels of whole buffers, four floats at
+/// a time where SSE2 or NEON are available, for the display and metering
+/// code that takes them per column or per sample.  Accurate to a few
+/// units in the last place; in and out may be the same buffer.
+
+/// Natural logarithm; NaN for values not above zero, and denormals count
+/// as the least normal float
+void VectorLog(const float *in, float *out, size_t len);
+
+/// Natural exponential; saturates beyond about +/-88
+void VectorExp(const float *in, float *out, size_t len);
+
+void VectorLog10(const float *in, float *out, size_t len);
+
+/// base[i] to the power exponent, for bases above zero
+void VectorPow(const float *base, float exponent, float *out, size_t len);
+
+/// 20 log10(|in|), as LINEAR_TO_DB; zero gives about -758, below any range
+void VectorLinearToDB(const float *in, float *out, size_t len);
+
+/// 10 ^ (in / 20), as DB_TO_LINEAR
+void VectorDBToLinear(const float *in, float *out, size_t len);
+
+/// The peak magnitude and the sum of squares of each of the first count
+/// channels of frames of interleaved samples
+void VectorLevels(const float *in, size_t frames, unsigned channels,
+                  unsigned count, float *peak, float *sumSquares);
+
+#endif
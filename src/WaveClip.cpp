@@ -23,19 +23,28 @@
 
 #include <math.h>
 #include "MemoryX.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <exception>
 #include <functional>
 #include <vector>
 #include <wx/log.h>
+#include <wx/thread.h>
 
 #include "Sequence.h"
 #include "Prefs.h"
 #include "Envelope.h"
+#include "MixerPool.h"
+#include "RealFFTf.h"
 #include "Resample.h"
 #include "Project.h"
 #include "WaveTrack.h"
 #include "Profiler.h"
 #include "InconsistencyException.h"
 #include "UserException.h"
+#include "VectorMath.h"
+#include "prefs/SpectrogramSettings.h"
 
 #include <wx/listimpl.cpp>
 
@@ -348,15 +357,42 @@ WaveClip::WaveClip(const WaveClip& orig,
       }
 }
 
+WaveClip::WaveClip(const WaveClip& orig, double t0, double t1)
+{
+   mOffset = orig.mOffset;
+   mRate = orig.mRate;
+   mColourIndex = orig.mColourIndex;
+
+   // Cut lines are not drawn; ClearWaveCache() and ClearDisplayCaches()
+   // make the caches, if ever needed
+
+   mIsPlaceholder = orig.GetIsPlaceholder();
+
+   sampleCount s0, s1;
+
+   orig.TimeToSamplesClip(t0, &s0);
+   orig.TimeToSamplesClip(t1, &s1);
+
+   mSequence = orig.mSequence->CopyWhenNeeded(s0, s1);
+
+   mEnvelope = std::make_unique<Envelope>(
+      *orig.mEnvelope,
+      mOffset + s0.as_double()/mRate,
+      mOffset + s1.as_double()/mRate
+   );
+}
 
 WaveClip::~WaveClip()
 {
+   ODLocker locker(&mWaveCacheMutex);
+   DropPrerenders(true);
 }
 
 void WaveClip::SetOffset(double offset)
 // NOFAIL-GUARANTEE
 {
     mOffset = offset;
+    ExtentChanged();
 }
 
 bool WaveClip::GetSamples(samplePtr buffer, sampleFormat format,
@@ -373,7 +409,7 @@ void WaveClip::SetSamples(samplePtr buffer, sampleFormat format,
    mSequence->SetSamples(buffer, format, start, len);
 
    // use NOFAIL-GUARANTEE
-   MarkChanged();
+   MarkChanged(start, start + len);
 }
 
 BlockArray* WaveClip::GetSequenceBlockArray()
@@ -381,6 +417,11 @@ BlockArray* WaveClip::GetSequenceBlockArray()
    return &mSequence->GetBlockArray();
 }
 
+const BlockArray* WaveClip::GetSequenceBlockArray() const
+{
+   return &static_cast<const Sequence&>(*mSequence).GetBlockArray();
+}
+
 double WaveClip::GetStartTime() const
 {
    // JS: mOffset is the minimum value and it is returned; no clipping to 0
@@ -436,6 +477,15 @@ void WaveClip::ClearWaveCache()
 {
    ODLocker locker(&mWaveCacheMutex);
    mWaveCache = std::make_unique<WaveCache>();
+   // Do not drop them here, where this may be a thread other than the main
+   for (auto &job : mPrerenders)
+      job->cancelled = true;
+}
+
+void WaveClip::ClearDisplayCaches()
+{
+   ClearWaveCache();
+   mSpecCache = std::make_unique<SpecCache>();
 }
 
 ///Adds an invalid region to the wavecache so it redraws that portion only.
@@ -444,6 +494,61 @@ void WaveClip::AddInvalidRegion(sampleCount startSample, sampleCount endSample)
    ODLocker locker(&mWaveCacheMutex);
    if(mWaveCache!=NULL)
       mWaveCache->AddInvalidRegion(startSample,endSample);
+   for (auto &job : mPrerenders)
+      job->cancelled = true;
+}
+
+std::atomic<unsigned long> WaveClip::sExtentGeneration{ 0 };
+
+void WaveClip::NoteLength()
+{
+   // Changes of the samples alone, as by SetSamples(), leave indices of
+   // clips by time as they were
+   const auto numSamples = mSequence->GetNumSamples();
+   if (numSamples != mNotedNumSamples ||
+       mAppendBufferLen != mNotedAppendBufferLen) {
+      mNotedNumSamples = numSamples;
+      mNotedAppendBufferLen = mAppendBufferLen;
+      ExtentChanged();
+   }
+}
+
+// How many changes of known extent WaveClip remembers for its display cache
+static const size_t kMaxChanges = 16;
+
+void WaveClip::MarkChanged()
+{
+   NoteLength();
+   ODLocker locker(&mWaveCacheMutex);
+   mDirty++;
+   mChanges.clear();
+}
+
+void WaveClip::MarkChanged(sampleCount start, sampleCount end)
+{
+   NoteLength();
+   ODLocker locker(&mWaveCacheMutex);
+   mDirty++;
+   if (mChanges.size() >= kMaxChanges)
+      mChanges.erase(mChanges.begin());
+   mChanges.push_back({ mDirty, start, end });
+}
+
+bool WaveClip::CatchUpWaveCache(WaveCache &cache) const
+{
+   // The invalid regions are reloaded from the Sequence alone
+   if (cache.dirty == mDirty || mAppendBufferLen > 0 || mChanges.empty())
+      return false;
+
+   auto first = std::find_if(mChanges.begin(), mChanges.end(),
+      [&](const Change &change){ return change.dirty == cache.dirty + 1; });
+   if (first == mChanges.end())
+      return false;
+
+   for (auto it = first; it != mChanges.end(); ++it)
+      cache.AddInvalidRegion(it->start, it->end);
+   cache.dirty = mDirty;
+   return true;
 }
 
 namespace {
@@ -503,6 +608,256 @@ fillWhere(std::vector<sampleCount> &where, size_t len, double bias, double corre
       where[x] = sampleCount( floor(w0 + double(x) * samplesPerPixel) );
 }
 
+// Tolerant comparison of pps values: accumulated difference of times over
+// the number of pixels is less than a sample period
+inline bool ppsMatches(double pps1, double pps2, size_t numPixels, int rate)
+{
+   return fabs(1.0 / pps1 - 1.0 / pps2) * numPixels < (1.0 / rate);
+}
+
+}
+
+/// A view of a clip whose display cache is computed ahead of need, on the
+/// thread of WaveCacheWorker, from a snapshot of the clip's sequence
+class WaveCachePrerender
+{
+public:
+   WaveCachePrerender(const std::shared_ptr<const Sequence> &sequence_,
+                      size_t len_, double pps_, int rate_, double t0_,
+                      int dirty_)
+      : sequence{ sequence_ }
+      , len{ len_ }, pps{ pps_ }, rate{ rate_ }, t0{ t0_ }, dirty{ dirty_ }
+   {}
+
+   void Compute()
+   {
+      auto cache =
+         std::make_unique<WaveCache>(len, pps, rate, t0, dirty);
+      fillWhere(cache->where, len, 0.0, 0.0, t0, rate, rate / pps);
+      if (!sequence->GetWaveDisplay(&cache->min[0], &cache->max[0],
+                                    &cache->rms[0], &cache->bl[0],
+                                    len, &cache->where[0]))
+         return;
+      // A view still waiting for on-demand summaries is not worth keeping
+      if (cache->CountODPixels(0, len) > 0)
+         return;
+      result = std::move(cache);
+      done = true;
+   }
+
+   const std::shared_ptr<const Sequence> sequence;
+   const size_t len;
+   const double pps;
+   const int rate;
+   const double t0;
+   const int dirty;
+
+   // Set by the clip, when the sequence changes
+   std::atomic<bool> cancelled { false };
+   // Set by the worker when result may be taken
+   std::atomic<bool> done { false };
+   std::unique_ptr<WaveCache> result;
+};
+
+/// The thread computing WaveCachePrerender jobs of all clips.  It holds
+/// only weak references to queued jobs, and the clip waits for a running
+/// job before it drops its own, so that jobs, and the sequence snapshots
+/// in them, are always destroyed on the main thread.
+class WaveCacheWorker final
+{
+public:
+   static WaveCacheWorker &Get()
+   {
+      static WaveCacheWorker instance;
+      return instance;
+   }
+
+   ~WaveCacheWorker() { Stop(); }
+
+   void Enqueue(const std::shared_ptr<WaveCachePrerender> &job)
+   {
+      ODLocker locker{ &mLock };
+      if (!mThread) {
+         mStopping = false;
+         mThread = std::make_unique<Thread>(*this);
+         if (mThread->Run() != wxTHREAD_NO_ERROR) {
+            // No speculation, then
+            mThread.reset();
+            return;
+         }
+      }
+      mQueue.push_back(job);
+      mQueued.Signal();
+   }
+
+   bool IsRunning(const WaveCachePrerender *job) const
+   {
+      ODLocker locker{ &mLock };
+      return mRunning == job;
+   }
+
+   void WaitFor(const WaveCachePrerender *job)
+   {
+      ODLocker locker{ &mLock };
+      while (mRunning == job)
+         mFinished.Wait();
+   }
+
+   void Stop()
+   {
+      std::unique_ptr<Thread> thread;
+      {
+         ODLocker locker{ &mLock };
+         mStopping = true;
+         mQueue.clear();
+         mQueued.Signal();
+         thread = std::move(mThread);
+      }
+      if (thread)
+         thread->Wait();
+   }
+
+private:
+   WaveCacheWorker() {}
+
+   class Thread final : public wxThread
+   {
+   public:
+      Thread(WaveCacheWorker &worker)
+         : wxThread{ wxTHREAD_JOINABLE }, mWorker{ worker }
+      {}
+
+   protected:
+      ExitCode Entry() override
+      {
+         mWorker.Run();
+         return 0;
+      }
+
+   private:
+      WaveCacheWorker &mWorker;
+   };
+
+   void Run()
+   {
+      ODLocker locker{ &mLock };
+      for (;;) {
+         while (mQueue.empty() && !mStopping)
+            mQueued.Wait();
+         if (mStopping)
+            break;
+
+         auto job = mQueue.front().lock();
+         mQueue.pop_front();
+         if (!job || job->cancelled)
+            continue;
+
+         mRunning = job.get();
+         locker.reset();
+         job->Compute();
+         locker.reset(&mLock);
+
+         // The clip still holds the job, so this is not the last reference
+         job.reset();
+         mRunning = nullptr;
+         mFinished.Broadcast();
+      }
+   }
+
+   mutable ODLock mLock;
+   ODCondition mQueued { &mLock };
+   ODCondition mFinished { &mLock };
+   std::deque< std::weak_ptr<WaveCachePrerender> > mQueue;
+   const WaveCachePrerender *mRunning {};
+   bool mStopping { false };
+   std::unique_ptr<Thread> mThread;
+};
+
+// static
+void WaveClip::StopPrerendering()
+{
+   WaveCacheWorker::Get().Stop();
+}
+
+void WaveClip::RequestPrerender(double t0, double pixelsPerSecond,
+                                size_t numPixels) const
+{
+   DropPrerenders(false);
+
+   // While recording, the clip changes with every repaint
+   if (mAppendBufferLen > 0 || numPixels == 0 || pixelsPerSecond <= 0)
+      return;
+
+   const double width = numPixels / pixelsPerSecond;
+   const double center = t0 + width / 2;
+   const struct { double t0, pps; } views[] = {
+      { center - width / 4, 2 * pixelsPerSecond }, // zoom in
+      { center - width, pixelsPerSecond / 2 },     // zoom out
+      { t0 + width, pixelsPerSecond },             // next page
+      { t0 - width, pixelsPerSecond },             // previous page
+   };
+
+   const auto numSamples = mSequence->GetNumSamples().as_double();
+   std::shared_ptr<const Sequence> snapshot;
+   for (const auto &view : views) {
+      // Skip views showing none of the clip
+      const double s0 = view.t0 * mRate;
+      const double s1 = s0 + numPixels * mRate / view.pps;
+      if (s1 <= 0 || std::max(0.0, s0) >= numSamples)
+         continue;
+
+      if (!snapshot)
+         snapshot = mSequence->Snapshot();
+      auto job = std::make_shared<WaveCachePrerender>(
+         snapshot, numPixels, view.pps, mRate, view.t0, mDirty);
+      mPrerenders.push_back(job);
+      WaveCacheWorker::Get().Enqueue(job);
+   }
+}
+
+std::unique_ptr<WaveCache> WaveClip::TakePrerender(
+   double t0, double pixelsPerSecond, size_t numPixels, bool exactOnly) const
+{
+   // Prefer a view starting at t0, else take any at the same zoom, of
+   // which the display may reuse a part
+   auto best = mPrerenders.end();
+   for (auto iter = mPrerenders.begin(); iter != mPrerenders.end(); ++iter) {
+      const auto &job = **iter;
+      if (!job.done || job.cancelled || job.dirty != mDirty ||
+          job.len < numPixels ||
+          !ppsMatches(pixelsPerSecond, job.pps, numPixels, mRate))
+         continue;
+      if (job.t0 == t0) {
+         best = iter;
+         break;
+      }
+      if (!exactOnly && best == mPrerenders.end())
+         best = iter;
+   }
+
+   if (best == mPrerenders.end())
+      return {};
+
+   // It is done, so the worker no longer refers to it
+   auto result = std::move((*best)->result);
+   mPrerenders.erase(best);
+   return result;
+}
+
+void WaveClip::DropPrerenders(bool wait) const
+{
+   auto &worker = WaveCacheWorker::Get();
+   std::vector< std::shared_ptr<WaveCachePrerender> > running;
+   for (auto &job : mPrerenders) {
+      job->cancelled = true;
+      if (worker.IsRunning(job.get())) {
+         if (wait)
+            worker.WaitFor(job.get());
+         else
+            running.push_back(job);
+      }
+   }
+   mPrerenders.swap(running);
 }
 
 //
@@ -526,6 +881,8 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
    int *bl;
    std::vector<sampleCount> *pWhere;
 
+   bool tookPrerender = false;
+
    if (allocated) {
       // assume ownWhere is filled.
       min = &display.min[0];
@@ -544,14 +901,30 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
       // Make a tolerant comparison of the pps values in this wise:
       // accumulated difference of times over the number of pixels is less than
       // a sample period.
-      const bool ppsMatch = mWaveCache &&
-         (fabs(tstep - 1.0 / mWaveCache->pps) * numPixels < (1.0 / mRate));
-
-      const bool match =
-         mWaveCache &&
-         ppsMatch &&
-         mWaveCache->len > 0 &&
-         mWaveCache->dirty == mDirty;
+      if (mWaveCache && mWaveCache->len > 0 &&
+          ppsMatches(pixelsPerSecond, mWaveCache->pps, numPixels, mRate))
+         CatchUpWaveCache(*mWaveCache);
+
+      auto matches = [&] {
+         return mWaveCache &&
+            ppsMatches(pixelsPerSecond, mWaveCache->pps, numPixels, mRate) &&
+            mWaveCache->len > 0 &&
+            mWaveCache->dirty == mDirty;
+      };
+      bool match = matches();
+
+      if (!(match &&
+            mWaveCache->start == t0 &&
+            mWaveCache->len >= numPixels)) {
+         // Perhaps this view was computed ahead of need; if the present
+         // cache is at this zoom, replace it only with an exact match
+         if (auto prerendered =
+             TakePrerender(t0, pixelsPerSecond, numPixels, match)) {
+            mWaveCache = std::move(prerendered);
+            match = matches();
+            tookPrerender = true;
+         }
+      }
 
       if (match &&
          mWaveCache->start == t0 &&
@@ -566,6 +939,9 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
          display.bl = &mWaveCache->bl[0];
          display.where = &mWaveCache->where[0];
          isLoadingOD = mWaveCache->numODPixels > 0;
+         // Look ahead one step more
+         if (tookPrerender)
+            RequestPrerender(t0, pixelsPerSecond, numPixels);
          return true;
       }
 
@@ -723,6 +1099,9 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
       display.bl = bl;
       display.where = &(*pWhere)[0];
       isLoadingOD = mWaveCache->numODPixels > 0;
+
+      ODLocker locker(&mWaveCacheMutex);
+      RequestPrerender(t0, pixelsPerSecond, numPixels);
    }
    else {
       using namespace std;
@@ -736,6 +1115,153 @@ bool WaveClip::GetWaveDisplay(WaveDisplay &display, double t0,
 
 namespace {
 
+// Fewer columns than this are computed on the calling thread alone
+const size_t kMinParallelColumns = 64;
+// Columns given to a thread at a time
+const size_t kColumnsPerJob = 16;
+
+}
+
+bool SpecCache::Matches(int dirty_, double pixelsPerSecond,
+   const SpectrogramSettings &settings, size_t numPixels, int rate) const
+{
+   return
+      len > 0 &&
+      dirty == dirty_ &&
+      windowType == settings.windowType &&
+      windowSize == settings.WindowSize() &&
+      zeroPaddingFactor == settings.ZeroPaddingFactor() &&
+      frequencyGain == settings.frequencyGain &&
+      ppsMatches(pixelsPerSecond, pps, numPixels, rate);
+}
+
+void SpecCache::Populate(const SpectrogramSettings &settings,
+   const Sequence &sequence, size_t x0, size_t x1)
+{
+   if (x1 <= x0)
+      return;
+
+   const auto hFFT = GetFFT(settings.GetFFTLength());
+   const auto &param = *hFFT;
+   const auto nBins = settings.NBins();
+   const auto numSamples = sequence.GetNumSamples();
+   const auto nColumns = x1 - x0;
+   const auto nJobs = (nColumns + kColumnsPerJob - 1) / kColumnsPerJob;
+
+   const auto nThreads = nColumns >= kMinParallelColumns
+      ? std::max(1, wxThread::GetCPUCount()) : 1;
+   MixerPool pool{ unsigned(nThreads - 1) };
+   pool.Run(nJobs, [&](size_t job) {
+      Floats buffer{ param.fftLen };
+      const auto first = x0 + job * kColumnsPerJob;
+      const auto last = std::min(x1, first + kColumnsPerJob);
+      for (auto xx = first; xx < last; ++xx) {
+         // The window is centered on the column, and zero beyond the clip
+         std::fill(buffer.get(), buffer.get() + param.fftLen, 0.0f);
+         const auto start = where[xx] - sampleCount(windowSize / 2);
+         const auto from = std::max(start, sampleCount{ 0 });
+         const auto to = std::min(start + windowSize, numSamples);
+         if (to > from) {
+            auto *const dest = buffer.get() + (from - start).as_size_t();
+            const auto count = (to - from).as_size_t();
+            // Not mayThrow: a missing block file draws as silence
+            sequence.Get((samplePtr)dest, floatSample, from, count, false);
+            const auto *const pWindow = window.data() +
+               (from - start).as_size_t();
+            for (size_t ii = 0; ii < count; ++ii)
+               dest[ii] *= pWindow[ii];
+         }
+
+         float *const out = &freq[xx * nBins];
+         PowerSpectrum(buffer.get(), out, param);
+         // Power to dB; zero maps far below any range
+         for (size_t ii = 0; ii < nBins; ++ii)
+            out[ii] = std::max(out[ii], 1e-30f);
+         VectorLog10(out, out, nBins);
+         for (size_t ii = 0; ii < nBins; ++ii)
+            out[ii] = 10.0f * out[ii] + gainFactors[ii];
+      }
+   });
+}
+
+bool WaveClip::GetSpectrogram(const float *& spectrogram,
+                              const sampleCount *& where,
+                              size_t numPixels,
+                              double t0, double pixelsPerSecond,
+                              const SpectrogramSettings &settings) const
+{
+   const auto nBins = settings.NBins();
+   const bool match = mSpecCache &&
+      mSpecCache->Matches(mDirty, pixelsPerSecond, settings, numPixels, mRate);
+
+   if (match &&
+       mSpecCache->start == t0 &&
+       mSpecCache->len >= numPixels) {
+      spectrogram = &mSpecCache->freq[0];
+      where = &mSpecCache->where[0];
+      return true;
+   }
+
+   // Reuse the columns of the old cache that are still in view, as
+   // GetWaveDisplay() does, so scrolling computes only the new columns
+   std::unique_ptr<SpecCache> oldCache(std::move(mSpecCache));
+   const double samplesPerPixel = mRate / pixelsPerSecond;
+   int oldX0 = 0;
+   double correction = 0.0;
+   size_t copyBegin = 0, copyEnd = 0;
+   if (match) {
+      findCorrection(oldCache->where, oldCache->len, numPixels,
+         t0, mRate, samplesPerPixel,
+         oldX0, correction);
+      copyBegin = std::min<size_t>(numPixels, std::max(0, -oldX0));
+      copyEnd = std::min<size_t>(numPixels, std::max(0,
+         (int)oldCache->len - oldX0
+      ));
+   }
+   if (!(copyEnd > copyBegin))
+      copyBegin = copyEnd = 0;
+
+   mSpecCache = std::make_unique<SpecCache>();
+   auto &cache = *mSpecCache;
+   cache.len = numPixels;
+   cache.algorithm = 0;
+   cache.pps = pixelsPerSecond;
+   cache.start = t0;
+   cache.windowType = settings.windowType;
+   cache.windowSize = settings.WindowSize();
+   cache.zeroPaddingFactor = settings.ZeroPaddingFactor();
+   cache.frequencyGain = settings.frequencyGain;
+   cache.dirty = mDirty;
+   cache.freq.resize(numPixels * nBins);
+   cache.where.resize(numPixels + 1);
+   // where[x] is the sample at the middle of column x
+   fillWhere(cache.where, numPixels, 0.5, correction,
+      t0, mRate, samplesPerPixel);
+
+   if (copyEnd > copyBegin) {
+      cache.window = std::move(oldCache->window);
+      cache.gainFactors = std::move(oldCache->gainFactors);
+      const size_t srcIdx = (int)copyBegin + oldX0;
+      std::copy(oldCache->freq.begin() + srcIdx * nBins,
+                oldCache->freq.begin() + (srcIdx + copyEnd - copyBegin) * nBins,
+                cache.freq.begin() + copyBegin * nBins);
+   }
+   else {
+      settings.MakeWindow(cache.window);
+      // Boost of the higher frequencies, as dB per decade of the bin
+      cache.gainFactors.resize(nBins);
+      for (size_t ii = 0; ii < nBins; ++ii)
+         cache.gainFactors[ii] =
+            settings.frequencyGain * log10(std::max<size_t>(1, ii));
+   }
+   oldCache.reset();
+
+   cache.Populate(settings, *mSequence, 0, copyBegin);
+   cache.Populate(settings, *mSequence, copyEnd, numPixels);
+
+   spectrogram = &cache.freq[0];
+   where = &cache.where[0];
+   return true;
 }
 
 std::pair<float, float> WaveClip::GetMinMax(
@@ -831,11 +1357,14 @@ void WaveClip::Append(samplePtr buffer, sampleFormat format,
    if (!mAppendBuffer.ptr())
       mAppendBuffer.Allocate(maxBlockSize, seqFormat);
 
+   const auto oldLen = mSequence->GetNumSamples() + mAppendBufferLen;
    auto cleanup = finally( [&] {
       // use NOFAIL-GUARANTEE
-      MarkChanged();
+      MarkChanged(oldLen, mSequence->GetNumSamples() + mAppendBufferLen);
    } );
 
+   const bool direct = (format == seqFormat && stride == 1);
+
    for(;;) {
       if (mAppendBufferLen >= blockSize) {
          // flush some previously appended contents
@@ -850,12 +1379,31 @@ void WaveClip::Append(samplePtr buffer, sampleFormat format,
          blockSize = mSequence->GetIdealAppendLen();
       }
 
+      // Whole blocks of samples already in the format of the sequence go to
+      // it straight from the caller's buffer, without staging in the
+      // append buffer; the sequence makes each block file from them
+      if (direct && mAppendBufferLen == 0) {
+         while (len >= blockSize) {
+            // use STRONG-GUARANTEE
+            mSequence->Append(buffer, seqFormat, blockSize);
+
+            // use NOFAIL-GUARANTEE for rest of this "while"
+            buffer += blockSize * SAMPLE_SIZE(seqFormat);
+            len -= blockSize;
+            blockSize = mSequence->GetIdealAppendLen();
+         }
+      }
+
       if (len == 0)
          break;
 
       // use NOFAIL-GUARANTEE for rest of this "for"
       wxASSERT(mAppendBufferLen <= maxBlockSize);
       auto toCopy = std::min(len, maxBlockSize - mAppendBufferLen);
+      if (direct && mAppendBufferLen < blockSize)
+         // Stage only up to the end of the block, so that the rest of the
+         // buffer may skip the staging
+         toCopy = std::min(toCopy, blockSize - mAppendBufferLen);
 
       CopySamples(buffer, format,
                   mAppendBuffer.ptr() + mAppendBufferLen * SAMPLE_SIZE(seqFormat),
@@ -874,22 +1422,26 @@ void WaveClip::AppendAlias(const wxString &fName, sampleCount start,
                             size_t len, int channel,bool useOD)
 // STRONG-GUARANTEE
 {
+   const auto oldLen = mSequence->GetNumSamples();
+
    // use STRONG-GUARANTEE
    mSequence->AppendAlias(fName, start, len, channel,useOD);
 
    // use NOFAIL-GUARANTEE
-   MarkChanged();
+   MarkChanged(oldLen, mSequence->GetNumSamples());
 }
 
 void WaveClip::AppendCoded(const wxString &fName, sampleCount start,
                             size_t len, int channel, int decodeType)
 // STRONG-GUARANTEE
 {
+   const auto oldLen = mSequence->GetNumSamples();
+
    // use STRONG-GUARANTEE
    mSequence->AppendCoded(fName, start, len, channel, decodeType);
 
    // use NOFAIL-GUARANTEE
-   MarkChanged();
+   MarkChanged(oldLen, mSequence->GetNumSamples());
 }
 
 void WaveClip::Flush()
@@ -904,13 +1456,14 @@ void WaveClip::Flush()
 
    if (mAppendBufferLen > 0) {
 
+      const auto oldLen = mSequence->GetNumSamples();
       auto cleanup = finally( [&] {
          // Blow away the append buffer even in case of failure.  May lose some
          // data but don't leave the track in an un-flushed state.
 
          // Use NOFAIL-GUARANTEE of these steps.
+         MarkChanged(oldLen, oldLen + mAppendBufferLen);
          mAppendBufferLen = 0;
-         MarkChanged();
       } );
 
       mSequence->Append(mAppendBuffer.ptr(), mSequence->GetSampleFormat(),
@@ -962,12 +1515,13 @@ void WaveClip::Paste(double t0, const WaveClip* other)
 
    sampleCount s0;
    TimeToSamplesClip(t0, &s0);
+   const auto oldLen = mSequence->GetNumSamples();
 
    // Assume STRONG-GUARANTEE from Sequence::Paste
    mSequence->Paste(s0, pastedClip->mSequence.get());
 
    // Assume NOFAIL-GUARANTEE in the remaining
-   MarkChanged();
+   MarkChanged(s0, std::max(oldLen, mSequence->GetNumSamples()));
    OffsetCutLines(t0, pastedClip->GetEndTime() - pastedClip->GetStartTime());
 
    for (auto &holder : newCutlines)
@@ -987,7 +1541,7 @@ void WaveClip::InsertSilence( double t, double len )
    // use NOFAIL-GUARANTEE
    OffsetCutLines(t, len);
 
-   MarkChanged();
+   MarkChanged(s0, GetSequence()->GetNumSamples());
 }
 
 void WaveClip::AppendSilence( double len )
@@ -1004,6 +1558,7 @@ void WaveClip::Clear(double t0, double t1)
 
    TimeToSamplesClip(t0, &s0);
    TimeToSamplesClip(t1, &s1);
+   const auto oldLen = GetSequence()->GetNumSamples();
 
    // use STRONG-GUARANTEE
    GetSequence()->Delete(s0, s1-s0);
@@ -1052,7 +1607,7 @@ void WaveClip::Clear(double t0, double t1)
    if (t0 < GetStartTime())
       Offset(-(GetStartTime() - t0));
 
-   MarkChanged();
+   MarkChanged(s0, oldLen);
 }
 
 void WaveClip::ClearAndAddCutLine(double t0, double t1)
@@ -1066,20 +1621,24 @@ void WaveClip::ClearAndAddCutLine(double t0, double t1)
    const double clip_t0 = std::max( t0, GetStartTime() );
    const double clip_t1 = std::min( t1, GetEndTime() );
 
-   auto newClip = make_movable< WaveClip >
-      (*this, mSequence->GetDirManager(), true, clip_t0, clip_t1);
+   auto newClip = make_movable< WaveClip >(*this, clip_t0, clip_t1);
 
    newClip->SetOffset( clip_t0 - mOffset );
 
-   // Remove cutlines from this clip that were in the selection, shift
-   // left those that were after the selection
+   // Move cutlines from this clip that were in the selection into the new
+   // one, rather than copying them there, shift left those that were
+   // after the selection
    // May DELETE as we iterate, so don't use range-for
    for (auto it = mCutLines.begin(); it != mCutLines.end();)
    {
       WaveClip* clip = it->get();
       double cutlinePosition = mOffset + clip->GetOffset();
       if (cutlinePosition >= t0 && cutlinePosition <= t1)
+      {
+         clip->SetOffset( cutlinePosition - clip_t0 );
+         newClip->mCutLines.push_back(std::move(*it));
          it = mCutLines.erase(it);
+      }
       else
       {
          if (cutlinePosition >= t1)
@@ -1095,6 +1654,7 @@ void WaveClip::ClearAndAddCutLine(double t0, double t1)
 
    TimeToSamplesClip(t0, &s0);
    TimeToSamplesClip(t1, &s1);
+   const auto oldLen = GetSequence()->GetNumSamples();
 
    // use WEAK-GUARANTEE
    GetSequence()->Delete(s0, s1-s0);
@@ -1102,7 +1662,7 @@ void WaveClip::ClearAndAddCutLine(double t0, double t1)
    if (t0 < GetStartTime())
       Offset(-(GetStartTime() - t0));
 
-   MarkChanged();
+   MarkChanged(s0, oldLen);
 
    mCutLines.push_back(std::move(newClip));
 }
@@ -1201,89 +1761,171 @@ void WaveClip::Unlock()
       cutline->Unlock();
 }
 
-void WaveClip::Resample(int rate, ProgressDialog *progress)
-// STRONG-GUARANTEE
+namespace {
+
+// Input samples in each chunk that resamples on its own thread
+const long long kResampleChunk = 1 << 20;
+// Input on either side of a chunk, that primes and drains its resampler;
+// longer than any filter of the resampler
+const long long kResampleMargin = 1 << 15;
+
+long long RoundUp(long long value, long long multiple)
 {
-   // Note:  it is not necessary to do this recursively to cutlines.
-   // They get resampled as needed when they are expanded.
+   return (value + multiple - 1) / multiple * multiple;
+}
 
-   if (rate == mRate)
-      return; // Nothing to do
+long long GreatestCommonDivisor(long long a, long long b)
+{
+   while (b != 0) {
+      const auto r = a % b;
+      a = b;
+      b = r;
+   }
+   return a;
+}
 
-   double factor = (double)rate / (double)mRate;
+// Resample input [start, end) of the sequence as if alone, and keep the
+// output from skip on, at most keep samples of it if keep is not negative
+void ResampleRange(const Sequence &sequence, double factor,
+                   sampleCount start, sampleCount end,
+                   long long skip, long long keep, std::vector<float> &output)
+{
    ::Resample resample(true, factor, factor); // constant rate resampling
 
    const size_t bufsize = 65536;
    Floats inBuffer{ bufsize };
    Floats outBuffer{ bufsize };
-   sampleCount pos = 0;
-   bool error = false;
-   int outGenerated = 0;
-   auto numSamples = mSequence->GetNumSamples();
+   sampleCount pos = start;
+   size_t outGenerated = 0;
+   long long produced = 0;
 
-   auto newSequence =
-      std::make_unique<Sequence>(mSequence->GetDirManager(), mSequence->GetSampleFormat());
+   output.clear();
 
    /**
     * We want to keep going as long as we have something to feed the resampler
     * with OR as long as the resampler spews out samples (which could continue
     * for a few iterations after we stop feeding it)
     */
-   while (pos < numSamples || outGenerated > 0)
+   while (pos < end || outGenerated > 0)
    {
-      const auto inLen = limitSampleBufferSize( bufsize, numSamples - pos );
+      const auto inLen = limitSampleBufferSize( bufsize, end - pos );
 
-      bool isLast = ((pos + inLen) == numSamples);
+      bool isLast = ((pos + inLen) == end);
 
-      if (!mSequence->Get((samplePtr)inBuffer.get(), floatSample, pos, inLen, true))
-      {
-         error = true;
-         break;
-      }
+      if (!sequence.Get((samplePtr)inBuffer.get(), floatSample, pos, inLen, true))
+         throw SimpleMessageBoxException{
+            _("Resampling failed.")
+         };
 
       const auto results = resample.Process(factor, inBuffer.get(), inLen, isLast,
                                             outBuffer.get(), bufsize);
       outGenerated = results.second;
-
       pos += results.first;
 
-      if (outGenerated < 0)
-      {
-         error = true;
+      // Keep only the part of the output that belongs to this range
+      const auto from = std::max(0LL, skip - produced);
+      auto to = (long long)outGenerated;
+      if (keep >= 0)
+         to = std::min(to, skip + keep - produced);
+      if (to > from)
+         output.insert(output.end(),
+            outBuffer.get() + from, outBuffer.get() + to);
+      produced += outGenerated;
+
+      if (keep >= 0 && produced >= skip + keep)
          break;
-      }
+   }
+}
+
+}
+
+void WaveClip::Resample(int rate, ProgressDialog *progress)
+// STRONG-GUARANTEE
+{
+   // Note:  it is not necessary to do this recursively to cutlines.
+   // They get resampled as needed when they are expanded.
 
-      newSequence->Append((samplePtr)outBuffer.get(), floatSample,
-                          outGenerated);
+   if (rate == mRate)
+      return; // Nothing to do
+
+   double factor = (double)rate / (double)mRate;
+   auto numSamples = mSequence->GetNumSamples();
+
+   auto newSequence =
+      std::make_unique<Sequence>(mSequence->GetDirManager(), mSequence->GetSampleFormat());
+
+   // A long clip is cut into chunks, resampled on all cores at once, each
+   // with a margin of input on either side that it discards the output of.
+   // Chunks start on multiples of the input count in the reduced ratio of
+   // the rates, so each chunk's output starts on a whole output sample, and
+   // the chunks join seamlessly.  The appending of the output stays on this
+   // thread, because DirManager is not thread safe.
+   const long long divisor = GreatestCommonDivisor(rate, mRate);
+   const long long ratioIn = mRate / divisor, ratioOut = rate / divisor;
+   const auto chunk = RoundUp(kResampleChunk, ratioIn);
+   const auto margin = RoundUp(kResampleMargin, ratioIn);
+   const auto total = numSamples.as_long_long();
+   const auto nChunks = std::max(1LL, (total + chunk - 1) / chunk);
+
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   MixerPool pool{ unsigned(nThreads - 1) };
+   const size_t batch = nThreads;
+   std::vector<std::vector<float>> outputs(batch);
+   std::vector<std::exception_ptr> errors(batch);
+
+   for (long long first = 0; first < nChunks; first += batch)
+   {
+      const auto count = (size_t)std::min<long long>(batch, nChunks - first);
+      pool.Run(count, [&](size_t ii) {
+         // Exceptions must not escape the helper threads
+         try {
+            const auto index = first + ii;
+            const bool isLast = (index == nChunks - 1);
+            const auto chunkStart = index * chunk;
+            const auto chunkEnd = std::min(total, chunkStart + chunk);
+            const auto start = std::max(0LL, chunkStart - margin);
+            const auto end = isLast ? total : std::min(total, chunkEnd + margin);
+            const auto skip = (chunkStart - start) / ratioIn * ratioOut;
+            const auto keep = isLast
+               ? -1 : (chunkEnd - chunkStart) / ratioIn * ratioOut;
+            ResampleRange(*mSequence, factor, start, end, skip, keep,
+                          outputs[ii]);
+         }
+         catch (...) {
+            errors[ii] = std::current_exception();
+         }
+      });
+      for (size_t ii = 0; ii < count; ++ii)
+         if (errors[ii])
+            std::rethrow_exception(errors[ii]);
+
+      for (size_t ii = 0; ii < count; ++ii)
+         newSequence->Append((samplePtr)outputs[ii].data(), floatSample,
+                             outputs[ii].size());
 
       if (progress)
       {
          auto updateResult = progress->Update(
-            pos.as_long_long(),
-            numSamples.as_long_long()
+            std::min(total, (first + (long long)count) * chunk),
+            total
          );
-         error = (updateResult != ProgressResult::Success);
-         if (error)
-            throw UserException{};
+         if (updateResult != ProgressResult::Success)
+            throw SimpleMessageBoxException{
+               _("Resampling failed.")
+            };
       }
    }
 
-   if (error)
-      throw SimpleMessageBoxException{
-         _("Resampling failed.")
-      };
-   else
-   {
-      // Use NOFAIL-GUARANTEE in these steps
+   // Use NOFAIL-GUARANTEE in these steps
 
-      // Invalidate wave display cache
-      mWaveCache = std::make_unique<WaveCache>();
-      // Invalidate the spectrum display cache
-      mSpecCache = std::make_unique<SpecCache>();
+   // Invalidate wave display cache
+   mWaveCache = std::make_unique<WaveCache>();
+   // Invalidate the spectrum display cache
+   mSpecCache = std::make_unique<SpecCache>();
 
-      mSequence = std::move(newSequence);
-      mRate = rate;
-   }
+   mSequence = std::move(newSequence);
+   mRate = rate;
+   ExtentChanged();
 }
 
 // Used by commands which interact with clips using the keyboard.
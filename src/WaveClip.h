@@ -23,13 +23,16 @@
 #include <wx/gdicmn.h>
 #include <wx/longlong.h>
 
+#include <atomic>
 #include <vector>
 
 class BlockArray;
 class DirManager;
 class Envelope;
 class Sequence;
+class SpectrogramSettings;
 class WaveCache;
+class WaveCachePrerender;
 class WaveTrackCache;
 
 class SpecCache {
@@ -62,6 +65,19 @@ public:
    std::vector<sampleCount> where;
 
    int          dirty;
+
+   // Made once for the settings above, and shared by the columns
+   std::vector<float> window;
+   std::vector<float> gainFactors;
+
+   bool Matches(int dirty_, double pixelsPerSecond,
+                const SpectrogramSettings &settings, size_t numPixels,
+                int rate) const;
+
+   // The dB of each bin of the columns from x0 to x1, from the samples
+   // around where[x]; on all cores, if there are enough columns
+   void Populate(const SpectrogramSettings &settings,
+                 const Sequence &sequence, size_t x0, size_t x1);
 };
 
 class SpecPxCache {
@@ -171,6 +187,11 @@ public:
             bool copyCutlines,
             double t0, double t1);
 
+   // Copy a range, without cut lines, to be a cut line: it refers to the
+   // blocks of the range, and makes its own only when first needed, as
+   // when expanded.  It has no display caches.
+   WaveClip(const WaveClip& orig, double t0, double t1);
+
    virtual ~WaveClip();
 
    void ConvertToSampleFormat(sampleFormat format);
@@ -212,22 +233,41 @@ public:
    Envelope* GetEnvelope() { return mEnvelope.get(); }
    const Envelope* GetEnvelope() const { return mEnvelope.get(); }
    BlockArray* GetSequenceBlockArray();
+   const BlockArray* GetSequenceBlockArray() const;
 
    // Get low-level access to the sequence. Whenever possible, don't use this,
    // but use more high-level functions inside WaveClip (or add them if you
    // think they are useful for general use)
    Sequence* GetSequence() { return mSequence.get(); }
+   const Sequence* GetSequence() const { return mSequence.get(); }
 
    /** WaveTrack calls this whenever data in the wave clip changes. It is
     * called automatically when WaveClip has a chance to know that something
     * has changed, like when member functions SetSamples() etc. are called. */
-   void MarkChanged() // NOFAIL-GUARANTEE
-      { mDirty++; }
+   void MarkChanged(); // NOFAIL-GUARANTEE
+
+   /** Like MarkChanged(), but says that only the samples from start up to
+    * end changed, so that the display cache can recompute just the pixel
+    * columns that show them.  An edit that shifts the samples after it
+    * should pass the greater of the old and NEW lengths as end. */
+   void MarkChanged(sampleCount start, sampleCount end); // NOFAIL-GUARANTEE
+
+   /** Counts changes of the offset, rate or length of any clip, so that an
+    * index of clips by time can tell when it must be made again. */
+   static unsigned long GetExtentGeneration()
+      { return sExtentGeneration.load(std::memory_order_acquire); }
 
    /** Getting high-level data for screen display and clipping
     * calculations and Contrast */
    bool GetWaveDisplay(WaveDisplay &display,
                        double t0, double pixelsPerSecond, bool &isLoadingOD) const;
+   /// Columns of the dB of each frequency bin, settings.NBins() for each
+   /// pixel, reusing the columns of the last call that are still in view
+   bool GetSpectrogram(const float *& spectrogram,
+                       const sampleCount *& where,
+                       size_t numPixels,
+                       double t0, double pixelsPerSecond,
+                       const SpectrogramSettings &settings) const;
    std::pair<float, float> GetMinMax(
       double t0, double t1, bool mayThrow = true) const;
    float GetRMS(double t0, double t1, bool mayThrow = true) const;
@@ -301,10 +341,16 @@ public:
 
    ///Delete the wave cache - force redraw.  Thread-safe
    void ClearWaveCache();
+   ///Delete the wave and spectrogram caches, to free memory.  Main thread
+   ///only, as drawing uses the spectrogram cache unlocked
+   void ClearDisplayCaches();
 
    ///Adds an invalid region to the wavecache so it redraws that portion only.
    void AddInvalidRegion(sampleCount startSample, sampleCount endSample);
 
+   /// End the thread that computes display caches ahead of need
+   static void StopPrerendering();
+
    // AWD, Oct 2009: for pasting whitespace at the end of selection
    bool GetIsPlaceholder() const { return mIsPlaceholder; }
    void SetIsPlaceholder(bool val) { mIsPlaceholder = val; }
@@ -313,6 +359,14 @@ public:
    bool SharesBoundaryWithNextClip(const WaveClip* next) const;
 
 protected:
+   static void ExtentChanged()
+      { sExtentGeneration.fetch_add(1, std::memory_order_acq_rel); }
+   // Calls ExtentChanged() if the length differs from when last called
+   void NoteLength();
+   static std::atomic<unsigned long> sExtentGeneration;
+   sampleCount mNotedNumSamples{ 0 };
+   size_t mNotedAppendBufferLen{ 0 };
+
    mutable wxRect mDisplayRect {};
 
    double mOffset { 0 };
@@ -325,6 +379,31 @@ protected:
 
    mutable std::unique_ptr<WaveCache> mWaveCache;
    mutable ODLock       mWaveCacheMutex {};
+
+   // The last few changes of known extent, each with the value of mDirty
+   // it made, oldest first and consecutive.  A change of unknown extent
+   // empties it.  Lock mWaveCacheMutex to use these.
+   struct Change {
+      int dirty;
+      sampleCount start, end;
+   };
+   std::vector<Change> mChanges;
+   // If every change since the cache was made is known, invalidate just
+   // the regions they touched and bring the cache up to date
+   bool CatchUpWaveCache(WaveCache &cache) const;
+
+   // Display caches for the views the user may go to next, computed on
+   // another thread: the next zoom step in and out, and the pages before
+   // and after.  Lock mWaveCacheMutex to use these.
+   void RequestPrerender(double t0, double pixelsPerSecond,
+                         size_t numPixels) const;
+   std::unique_ptr<WaveCache> TakePrerender(double t0, double pixelsPerSecond,
+                                            size_t numPixels,
+                                            bool exactOnly) const;
+   // Forget queued and finished ones; if wait, wait for a running one
+   // too, else keep it until finished
+   void DropPrerenders(bool wait) const;
+   mutable std::vector< std::shared_ptr<WaveCachePrerender> > mPrerenders;
    mutable std::unique_ptr<SpecCache> mSpecCache;
    SampleBuffer  mAppendBuffer {};
    size_t        mAppendBufferLen { 0 };
@@ -35,12 +35,15 @@ Track classes.
 #include <float.h>
 #include <math.h>
 #include <algorithm>
+#include <cstdlib>
 #include "MemoryX.h"
 
 #include "float_cast.h"
 
 #include "Envelope.h"
 #include "Sequence.h"
+#include "BlockFile.h"
+#include "DirManager.h"
 
 #include "Project.h"
 #include "Internat.h"
@@ -49,8 +52,10 @@ Track classes.
 #include "Prefs.h"
 
 #include "ondemand/ODManager.h"
+#include "ondemand/ODTaskThread.h"
 
 #include "prefs/TracksPrefs.h"
+#include "prefs/SpectrogramSettings.h"
 #include "prefs/WaveformPrefs.h"
 
 #include "InconsistencyException.h"
@@ -61,6 +66,21 @@ Track classes.
 
 using std::max;
 
+namespace {
+
+// Tracks are edited on several threads at once by TrackEditBatch, and
+// the preferences must be read by one at a time
+bool EditClipsCanMove()
+{
+   static ODLock prefsLock;
+   ODLocker locker{ &prefsLock };
+   bool editClipCanMove = true;
+   gPrefs->Read(wxT("/GUI/EditClipCanMove"), &editClipCanMove);
+   return editClipCanMove;
+}
+
+}
+
 WaveTrack::Holder TrackFactory::DuplicateWaveTrack(const WaveTrack &orig)
 {
    return std::unique_ptr<WaveTrack>
@@ -131,6 +151,7 @@ void WaveTrack::Init(const WaveTrack &orig)
    mWaveColorIndex = orig.mWaveColorIndex;
    mRate = orig.mRate;
    mPan = orig.mPan;
+   mRealtime = orig.mRealtime;
    SetDefaultName(orig.GetDefaultName());
    SetName(orig.GetName());
    mDisplay = orig.mDisplay;
@@ -161,6 +182,7 @@ void WaveTrack::Merge(const Track &orig)
       const WaveTrack &wt = static_cast<const WaveTrack&>(orig);
       mDisplay = wt.mDisplay;
       mPan     = wt.mPan;
+      mRealtime = wt.mRealtime;
       mDisplayMin = wt.mDisplayMin;
       mDisplayMax = wt.mDisplayMax;
       SetWaveformSettings
@@ -261,6 +283,7 @@ WaveTrack::ValidateWaveTrackDisplay(WaveTrackDisplay display)
       // non-obsolete codes
    case Waveform:
    case obsoleteWaveformDBDisplay:
+   case Spectrum:
       return display;
 
       // codes out of bounds (from future prefs files?)
@@ -333,6 +356,22 @@ void WaveTrack::SetPan(float newPan)
       mPan = newPan;
 }
 
+float WaveTrack::GetChannelGain(int channel) const
+{
+   float left = 1.0;
+   float right = 1.0;
+
+   if (mPan < 0)
+      right = (mPan + 1.0);
+   else if (mPan > 0)
+      left = 1.0 - mPan;
+
+   if ((channel % 2) == 0)
+      return left;
+   else
+      return right;
+}
+
 void WaveTrack::SetWaveColorIndex(int colorIndex)
 // STRONG-GUARANTEE
 {
@@ -449,6 +488,7 @@ Track::Holder WaveTrack::Copy(double t0, double t1, bool forClipboard) const
       placeholder->Offset(newTrack->GetEndTime());
       newTrack->mClips.push_back(std::move(placeholder)); // transfer ownership
    }
+   newTrack->ClipsChanged();
 
    return result;
 }
@@ -470,6 +510,11 @@ void WaveTrack::ClearAndAddCutLine(double t0, double t1)
    HandleClear(t0, t1, true, false);
 }
 
+const SpectrogramSettings &WaveTrack::GetSpectrogramSettings() const
+{
+   return SpectrogramSettings::defaults();
+}
+
 const WaveformSettings &WaveTrack::GetWaveformSettings() const
 {
    if (mpWaveformSettings)
@@ -681,6 +726,7 @@ std::shared_ptr<WaveClip> WaveTrack::RemoveAndReturnClip(WaveClip* clip)
    if (it != mClips.end()) {
       auto result = std::move(*it); // Array stops owning the clip, before we shrink it
       mClips.erase(it);
+      ClipsChanged();
       return result;
    }
    else
@@ -692,6 +738,7 @@ void WaveTrack::AddClip(std::shared_ptr<WaveClip> &&clip)
    // Uncomment the following line after we correct the problem of zero-length clips
    //if (CanInsertClip(clip))
       mClips.push_back(std::move(clip)); // transfer ownership
+   ClipsChanged();
 }
 
 void WaveTrack::HandleClear(double t0, double t1,
@@ -701,8 +748,7 @@ void WaveTrack::HandleClear(double t0, double t1,
    if (t1 < t0)
       THROW_INCONSISTENCY_EXCEPTION;
 
-   bool editClipCanMove = true;
-   gPrefs->Read(wxT("/GUI/EditClipCanMove"), &editClipCanMove);
+   const bool editClipCanMove = EditClipsCanMove();
 
    WaveClipPointers clipsToDelete;
    WaveClipHolders clipsToAdd;
@@ -830,13 +876,14 @@ void WaveTrack::HandleClear(double t0, double t1,
 
    for (auto &clip: clipsToAdd)
       mClips.push_back(std::move(clip)); // transfer ownership
+
+   ClipsChanged();
 }
 
 void WaveTrack::Paste(double t0, const Track *src)
 // WEAK-GUARANTEE
 {
-   bool editClipCanMove = true;
-   gPrefs->Read(wxT("/GUI/EditClipCanMove"), &editClipCanMove);
+   const bool editClipCanMove = EditClipsCanMove();
 
    if( src == NULL )
       // THROW_INCONSISTENCY_EXCEPTION; // ?
@@ -988,6 +1035,7 @@ void WaveTrack::Paste(double t0, const Track *src)
          newClip->Offset(t0);
          newClip->MarkChanged();
          mClips.push_back(std::move(newClip)); // transfer ownership
+         ClipsChanged();
       }
    }
 }
@@ -1021,7 +1069,7 @@ void WaveTrack::Silence(double t0, double t1)
          }
 
          clip->GetSequence()->SetSilence(inclipDelta, samplesToCopy);
-         clip->MarkChanged();
+         clip->MarkChanged(inclipDelta, inclipDelta + samplesToCopy);
       }
    }
 }
@@ -1043,6 +1091,7 @@ void WaveTrack::InsertSilence(double t, double len)
       clip->InsertSilence(0, len);
       // use NOFAIL-GUARANTEE
       mClips.push_back( std::move( clip ) );
+      ClipsChanged();
       return;
    }
    else {
@@ -1099,6 +1148,20 @@ unsigned int WaveTrack::GetODFlags() const
 }
 
 
+size_t WaveTrack::CompactBlocks(double fraction, size_t maxBlocks)
+{
+   size_t merged = 0;
+   for (const auto &clip : mClips)
+   {
+      if (merged >= maxBlocks)
+         break;
+      auto sequence = clip->GetSequence();
+      if (sequence->IsBlockArrayLoaded())
+         merged += sequence->Compact(fraction, maxBlocks - merged);
+   }
+   return merged;
+}
+
 sampleCount WaveTrack::GetBlockStart(sampleCount s) const
 {
    for (const auto &clip : mClips)
@@ -1112,6 +1175,19 @@ sampleCount WaveTrack::GetBlockStart(sampleCount s) const
    return -1;
 }
 
+BlockFilePtr WaveTrack::GetBlockFile(sampleCount s) const
+{
+   for (const auto &clip : mClips)
+   {
+      const auto startSample = (sampleCount)floor(0.5 + clip->GetStartTime()*mRate);
+      const auto endSample = startSample + clip->GetNumSamples();
+      if (s >= startSample && s < endSample)
+         return clip->GetSequence()->GetBlockFile(s - startSample);
+   }
+
+   return {};
+}
+
 size_t WaveTrack::GetBestBlockSize(sampleCount s) const
 {
    auto bestBlockSize = GetMaxBlockSize();
@@ -1327,14 +1403,12 @@ bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
    // everything to be on the safe side.
    bool doClear = true;
    bool result = true;
-   for (const auto &clip: mClips)
-   {
-      if (start >= clip->GetStartSample() && start+len <= clip->GetEndSample())
-      {
+   // Only the clips that overlap the buffer are looked at
+   const auto index = GetClipIndex();
+   index->ForSamples(start, start + len, [&](const ClipIndex::Entry &entry) {
+      if (start >= entry.startSample && start+len <= entry.endSample)
          doClear = false;
-         break;
-      }
-   }
+   });
    if (doClear)
    {
       // Usually we fill in empty space with zero
@@ -1354,8 +1428,9 @@ bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
       }
    }
 
-   for (const auto &clip: mClips)
+   index->ForSamples(start, start + len, [&](const ClipIndex::Entry &entry)
    {
+      const auto clip = entry.clip;
       auto clipStart = clip->GetStartSample();
       auto clipEnd = clip->GetEndSample();
 
@@ -1390,17 +1465,36 @@ bool WaveTrack::Get(samplePtr buffer, sampleFormat format,
                format, inclipDelta, samplesToCopy.as_size_t(), mayThrow ))
             result = false;
       }
-   }
+   });
 
    return result;
 }
 
+bool WaveTrack::IsSilent(sampleCount start, size_t len) const
+{
+   const auto end = start + len;
+   bool silent = true;
+   GetClipIndex()->ForSamples(start, end, [&](const ClipIndex::Entry &entry) {
+      const auto clipStart = entry.startSample;
+      const auto clipEnd = entry.endSample;
+      const auto s0 = std::max(start, clipStart) - clipStart;
+      const auto s1 = std::min(end, clipEnd) - clipStart;
+      if (silent && !entry.clip->GetSequence()->IsSilent(s0, s1 - s0))
+         silent = false;
+   });
+   return silent;
+}
+
 void WaveTrack::Set(samplePtr buffer, sampleFormat format,
                     sampleCount start, size_t len)
 // WEAK-GUARANTEE
 {
-   for (const auto &clip: mClips)
+   // Setting samples changes no extents; this index stays good throughout
+   const auto index = GetClipIndex();
+
+   index->ForSamples(start, start + len, [&](const ClipIndex::Entry &entry)
    {
+      const auto clip = entry.clip;
       auto clipStart = clip->GetStartSample();
       auto clipEnd = clip->GetEndSample();
 
@@ -1433,9 +1527,8 @@ void WaveTrack::Set(samplePtr buffer, sampleFormat format,
                            startDelta.as_size_t() *
                            SAMPLE_SIZE(format)),
                           format, inclipDelta, samplesToCopy.as_size_t() );
-         clip->MarkChanged();
       }
-   }
+   });
 }
 
 void WaveTrack::GetEnvelopeValues(double *buffer, size_t bufferLen,
@@ -1451,10 +1544,7 @@ void WaveTrack::GetEnvelopeValues(double *buffer, size_t bufferLen,
    // be set twice.  Unfortunately, there is no easy way around this since the clips are not
    // stored in increasing time order.  If they were, we could just track the time as the
    // buffer is filled.
-   for (decltype(bufferLen) i = 0; i < bufferLen; i++)
-   {
-      buffer[i] = 1.0;
-   }
+   std::fill(buffer, buffer + bufferLen, 1.0);
 
    double startTime = t0;
    auto tstep = 1.0 / mRate;
@@ -1519,39 +1609,45 @@ WaveClip* WaveTrack::GetClipAtX(int xcoord)
 
 WaveClip* WaveTrack::GetClipAtSample(sampleCount sample)
 {
-   for (const auto &clip: mClips)
-   {
-      auto start = clip->GetStartSample();
-      auto len   = clip->GetNumSamples();
-
-      if (sample >= start && sample < start + len)
-         return clip.get();
-   }
-
-   return NULL;
+   WaveClip *result = NULL;
+   GetClipIndex()->ForSamples(sample, sample + 1,
+      [&](const ClipIndex::Entry &entry) {
+         if (!result)
+            result = entry.clip;
+      });
+   return result;
 }
 
 // When the time is both the end of a clip and the start of the next clip, the
 // latter clip is returned.
 WaveClip* WaveTrack::GetClipAtTime(double time)
 {
-   
-   const auto clips = SortedClipArray();
-   auto p = std::find_if(clips.rbegin(), clips.rend(), [&] (WaveClip* const& clip) {
-      return time >= clip->GetStartTime() && time <= clip->GetEndTime(); });
+   const auto index = GetClipIndex();
+   const auto &entries = index->entries;
+
+   // The last clip to start at or before the time, and not to end before
+   // it: search back from the last to start, until the greatest end so far
+   // is before the time
+   size_t ii = std::upper_bound(entries.begin(), entries.end(), time,
+      [](double t, const ClipIndex::Entry &entry)
+      { return t < entry.startTime; }) - entries.begin();
+   bool found = false;
+   while (!found && ii > 0 && index->maxEndTime[ii - 1] >= time)
+      found = time <= entries[--ii].endTime;
+   if (!found)
+      return nullptr;
 
    // When two clips are immediately next to each other, the GetEndTime() of the first clip
    // and the GetStartTime() of the second clip may not be exactly equal due to rounding errors.
    // If "time" is the end time of the first of two such clips, and the end time is slightly
    // less than the start time of the second clip, then the first rather than the
    // second clip is found by the above code. So correct this.
-   if (p != clips.rend() && p != clips.rbegin() &&
-      time == (*p)->GetEndTime() &&
-      (*p)->SharesBoundaryWithNextClip(*(p-1))) {
-      p--;
-   }
+   if (ii + 1 < entries.size() &&
+       time == entries[ii].endTime &&
+       entries[ii].clip->SharesBoundaryWithNextClip(entries[ii + 1].clip))
+      ++ii;
 
-   return p != clips.rend() ? *p : nullptr;
+   return entries[ii].clip;
 }
 
 Envelope* WaveTrack::GetEnvelopeAtX(int xcoord)
@@ -1575,6 +1671,7 @@ Sequence* WaveTrack::GetSequenceAtX(int xcoord)
 WaveClip* WaveTrack::CreateClip()
 {
    mClips.push_back(make_movable<WaveClip>(mDirManager, mFormat, mRate, GetWaveColorIndex()));
+   ClipsChanged();
    return mClips.back().get();
 }
 
@@ -1644,13 +1741,19 @@ bool WaveTrack::CanOffsetClip(WaveClip* clip, double amount,
    if (allowedAmount)
       *allowedAmount = amount;
 
-   for (const auto &c: mClips)
+   // Only the clips that overlap the moved clip are looked at
+   bool overlaps = false;
+   GetClipIndex()->ForTimes(
+      clip->GetStartTime() + amount, clip->GetEndTime() + amount,
+      [&](const ClipIndex::Entry &entry)
    {
-      if (c.get() != clip && c->GetStartTime() < clip->GetEndTime()+amount &&
-                       c->GetEndTime() > clip->GetStartTime()+amount)
+      const auto c = entry.clip;
+      if (c != clip && !overlaps)
       {
-         if (!allowedAmount)
-            return false; // clips overlap
+         if (!allowedAmount) {
+            overlaps = true; // clips overlap
+            return;
+         }
 
          if (amount > 0)
          {
@@ -1666,7 +1769,9 @@ bool WaveTrack::CanOffsetClip(WaveClip* clip, double amount,
                *allowedAmount = 0;
          }
       }
-   }
+   });
+   if (overlaps)
+      return false;
 
    if (allowedAmount)
    {
@@ -1687,7 +1792,16 @@ bool WaveTrack::CanOffsetClip(WaveClip* clip, double amount,
 
 bool WaveTrack::CanInsertClip(WaveClip* clip,  double &slideBy, double &tolerance)
 {
-   for (const auto &c : mClips)
+   // Rescues move the clip by less than twice the tolerance in all, so no
+   // clip farther than that from where it starts can come to overlap it
+   const auto margin = 2 * tolerance;
+   WaveClipPointers clips;
+   GetClipIndex()->ForTimes(
+      clip->GetStartTime() + slideBy - margin,
+      clip->GetEndTime() + slideBy + margin,
+      [&](const ClipIndex::Entry &entry) { clips.push_back(entry.clip); });
+
+   for (const auto c : clips)
    {
       double d1 = c->GetStartTime() - (clip->GetEndTime()+slideBy);
       double d2 = (clip->GetStartTime()+slideBy) - c->GetEndTime();
@@ -1744,6 +1858,7 @@ void WaveTrack::SplitAt(double t)
          // This could invalidate the iterators for the loop!  But we return
          // at once so it's okay
          mClips.push_back(std::move(newClip)); // transfer ownership
+         ClipsChanged();
          return;
       }
    }
@@ -1754,8 +1869,7 @@ void WaveTrack::ExpandCutLine(double cutLinePosition, double* cutlineStart,
                               double* cutlineEnd)
 // STRONG-GUARANTEE
 {
-   bool editClipCanMove = true;
-   gPrefs->Read(wxT("/GUI/EditClipCanMove"), &editClipCanMove);
+   const bool editClipCanMove = EditClipsCanMove();
 
    // Find clip which contains this cut line
    double start = 0, end = 0;
@@ -1828,6 +1942,7 @@ void WaveTrack::MergeClips(int clipidx1, int clipidx2)
    // Delete second clip
    auto it = FindClip(mClips, clip2);
    mClips.erase(it);
+   ClipsChanged();
 }
 
 void WaveTrack::Resample(int rate, ProgressDialog *progress)
@@ -1840,28 +1955,109 @@ void WaveTrack::Resample(int rate, ProgressDialog *progress)
    mRate = rate;
 }
 
-namespace {
-   template < typename Cont1, typename Cont2 >
-   Cont1 FillSortedClipArray(const Cont2& mClips)
+struct WaveTrack::ClipIndex
+{
+   struct Entry {
+      WaveClip *clip;
+      double startTime, endTime;
+      sampleCount startSample, endSample;
+   };
+
+   // WaveClip::GetExtentGeneration() when this was made
+   unsigned long generation;
+   // By start time
+   std::vector<Entry> entries;
+   // The greatest end of the entries up to each
+   std::vector<double> maxEndTime;
+   std::vector<sampleCount> maxEndSample;
+
+   // Calls f for each entry, in order, that overlaps the times from t0
+   // up to t1
+   template<typename F> void ForTimes(double t0, double t1, const F &f) const
    {
-      Cont1 clips;
-      for (const auto &clip : mClips)
-         clips.push_back(clip.get());
-      std::sort(clips.begin(), clips.end(),
-         [](const WaveClip *a, const WaveClip *b)
-      { return a->GetStartTime() < b->GetStartTime(); });
-      return clips;
+      auto ii = std::upper_bound(maxEndTime.begin(), maxEndTime.end(), t0)
+         - maxEndTime.begin();
+      for (auto nn = entries.size(); ii < nn; ++ii) {
+         const auto &entry = entries[ii];
+         if (entry.startTime >= t1)
+            break;
+         if (entry.endTime > t0)
+            f(entry);
+      }
+   }
+
+   // The same, for the samples from s0 up to s1
+   template<typename F>
+   void ForSamples(sampleCount s0, sampleCount s1, const F &f) const
+   {
+      auto ii = std::upper_bound(maxEndSample.begin(), maxEndSample.end(), s0)
+         - maxEndSample.begin();
+      for (auto nn = entries.size(); ii < nn; ++ii) {
+         const auto &entry = entries[ii];
+         if (entry.startSample >= s1)
+            break;
+         if (entry.endSample > s0)
+            f(entry);
+      }
+   }
+};
+
+auto WaveTrack::GetClipIndex() const -> std::shared_ptr<const ClipIndex>
+{
+   ODLocker locker{ &mClipIndexMutex };
+   // Read the generation before the clips, so that a change while they are
+   // read makes the index again next time
+   const auto generation = WaveClip::GetExtentGeneration();
+   if (mClipIndex && mClipIndex->generation == generation)
+      return mClipIndex;
+
+   auto index = std::make_shared<ClipIndex>();
+   index->generation = generation;
+   index->entries.reserve(mClips.size());
+   for (const auto &clip : mClips)
+      index->entries.push_back({ clip.get(),
+         clip->GetStartTime(), clip->GetEndTime(),
+         clip->GetStartSample(), clip->GetEndSample() });
+   std::stable_sort(index->entries.begin(), index->entries.end(),
+      [](const ClipIndex::Entry &a, const ClipIndex::Entry &b)
+      { return a.startTime < b.startTime; });
+
+   const auto nn = index->entries.size();
+   index->maxEndTime.reserve(nn);
+   index->maxEndSample.reserve(nn);
+   for (const auto &entry : index->entries) {
+      index->maxEndTime.push_back(index->maxEndTime.empty()
+         ? entry.endTime
+         : std::max(index->maxEndTime.back(), entry.endTime));
+      index->maxEndSample.push_back(index->maxEndSample.empty()
+         ? entry.endSample
+         : std::max(index->maxEndSample.back(), entry.endSample));
    }
+
+   mClipIndex = index;
+   return mClipIndex;
+}
+
+void WaveTrack::ClipsChanged()
+{
+   ODLocker locker{ &mClipIndexMutex };
+   mClipIndex.reset();
 }
 
 WaveClipPointers WaveTrack::SortedClipArray()
 {
-   return FillSortedClipArray<WaveClipPointers>(mClips);
+   WaveClipPointers clips;
+   for (const auto &entry : GetClipIndex()->entries)
+      clips.push_back(entry.clip);
+   return clips;
 }
 
 WaveClipConstPointers WaveTrack::SortedClipArray() const
 {
-   return FillSortedClipArray<WaveClipConstPointers>(mClips);
+   WaveClipConstPointers clips;
+   for (const auto &entry : GetClipIndex()->entries)
+      clips.push_back(entry.clip);
+   return clips;
 }
 
 ///Deletes all clips' wavecaches.  Careful, This may not be threadsafe.
@@ -1878,33 +2074,76 @@ void WaveTrack::AddInvalidRegion(sampleCount startSample, sampleCount endSample)
       clip->AddInvalidRegion(startSample, endSample);
 }
 
+// Blocks a read-ahead ring keeps pinned for each track
+static const size_t kReadAheadBlocks = 4;
+// How many more requests like the last one may be read ahead
+static const int kReadAheadRequests = 8;
+// A move of more than this many buffers is a seek, not playback
+static const int kMaxReadAheadStep = 4;
+// Blocks Prefetch() keeps pinned, and asks for from each start
+static const size_t kPrefetchBlocks = 8;
+static const size_t kPrefetchBlocksEach = 2;
+
 WaveTrackCache::~WaveTrackCache()
 {
+   CancelReadAhead();
+}
+
+void WaveTrackCache::SetReadAhead(bool readAhead)
+{
+   if (readAhead == bool(mRing))
+      return;
+   CancelReadAhead();
+   if (readAhead)
+      mRing = std::make_unique<BlockPrefetcher::Ring>(kReadAheadBlocks);
+   else
+      mRing.reset();
+}
+
+void WaveTrackCache::CancelReadAhead()
+{
+   if (mRing)
+      BlockPrefetcher::Get().Cancel(*mRing);
+   mLastStart = -1;
+   mFrontier = -1;
+   mBackwards = false;
 }
 
 void WaveTrackCache::SetTrack(const std::shared_ptr<const WaveTrack> &pTrack)
 {
    if (mPTrack != pTrack) {
+      // The ring refers to the cache of the old track's project
+      CancelReadAhead();
+      // Pins refer to the cache of the old track's project
+      mBuffers[0].pin.reset();
+      mBuffers[1].pin.reset();
       if (pTrack) {
-         mBufferSize = pTrack->GetMaxBlockSize();
-         if (!mPTrack ||
-             mPTrack->GetMaxBlockSize() != mBufferSize) {
-            Free();
-            mBuffers[0].data = Floats{ mBufferSize };
-            mBuffers[1].data = Floats{ mBufferSize };
-         }
+         const auto size = pTrack->GetMaxBlockSize();
+         const auto format = pTrack->GetSampleFormat();
+         if (!mPTrack || size != mBufferSize || format != mFormat)
+            Allocate(size, format);
       }
       else
          Free();
       mPTrack = pTrack;
       mNValidBuffers = 0;
+      mReader.Reset(nullptr);
    }
 }
 
 constSamplePtr WaveTrackCache::Get(sampleFormat format,
    sampleCount start, size_t len, bool mayThrow)
 {
-   if (format == floatSample && len > 0) {
+   // The track was converted since the last call
+   if (mPTrack && mPTrack->GetSampleFormat() != mFormat)
+      Allocate(mBufferSize, mPTrack->GetSampleFormat());
+
+   // The formats are in order of precision, so a wider one holds the
+   // samples exactly, without dither
+   if (format >= mFormat && len > 0) {
+      if (mRing)
+         ReadAhead(start, len);
+
       const auto end = start + len;
 
       bool fillFirst = (mNValidBuffers < 1);
@@ -1930,7 +2169,7 @@ constSamplePtr WaveTrackCache::Get(sampleFormat format,
       }
       else if (mNValidBuffers > 0 &&
          start < mBuffers[0].start &&
-         0 <= mPTrack->GetBlockStart(start)) {
+         0 <= GetBlockStart(start)) {
          // Request is not a total miss but starts before the cache,
          // and there is a clip to fetch from.
          // Not the access pattern for drawing spectrogram or playback,
@@ -1948,16 +2187,15 @@ constSamplePtr WaveTrackCache::Get(sampleFormat format,
 
       // Refill buffers as needed
       if (fillFirst) {
-         const auto start0 = mPTrack->GetBlockStart(start);
+         const auto start0 = GetBlockStart(start);
          if (start0 >= 0) {
-            const auto len0 = mPTrack->GetBestBlockSize(start0);
+            const auto len0 = GetBestBlockSize(start0);
             wxASSERT(len0 <= mBufferSize);
-            if (!mPTrack->Get(
-                  samplePtr(mBuffers[0].data.get()), floatSample, start0, len0,
-                  fillZero, mayThrow))
+            if (!GetFromClip(mBuffers[0].data.ptr(), start0, len0, mayThrow))
                return 0;
             mBuffers[0].start = start0;
             mBuffers[0].len = len0;
+            mBuffers[0].pin = PinBlock(start0);
             if (!fillSecond &&
                 mBuffers[0].end() != mBuffers[1].start)
                fillSecond = true;
@@ -1976,14 +2214,15 @@ constSamplePtr WaveTrackCache::Get(sampleFormat format,
          mNValidBuffers = 1;
          const auto end0 = mBuffers[0].end();
          if (end > end0) {
-            const auto start1 = mPTrack->GetBlockStart(end0);
+            const auto start1 = GetBlockStart(end0);
             if (start1 == end0) {
-               const auto len1 = mPTrack->GetBestBlockSize(start1);
+               const auto len1 = GetBestBlockSize(start1);
                wxASSERT(len1 <= mBufferSize);
-               if (!mPTrack->Get(samplePtr(mBuffers[1].data.get()), floatSample, start1, len1, fillZero, mayThrow))
+               if (!GetFromClip(mBuffers[1].data.ptr(), start1, len1, mayThrow))
                   return 0;
                mBuffers[1].start = start1;
                mBuffers[1].len = len1;
+               mBuffers[1].pin = PinBlock(start1);
                mNValidBuffers = 2;
             }
          }
@@ -2024,11 +2263,13 @@ constSamplePtr WaveTrackCache::Get(sampleFormat format,
          // This may be negative
          const auto leni =
             std::min( sampleCount( remaining ), mBuffers[ii].len - starti );
-         if (initLen <= 0 && leni == len) {
+         const auto src = mBuffers[ii].data.ptr() +
+            starti.as_size_t() * SAMPLE_SIZE(mFormat);
+         if (initLen <= 0 && leni == len && format == mFormat) {
             // All is contiguous already.  We can completely avoid copying
             // leni is nonnegative, therefore start falls within mBuffers[ii],
             // so starti is bounded between 0 and buffer length
-            return samplePtr(mBuffers[ii].data.get() + starti.as_size_t() );
+            return src;
          }
          else if (leni > 0) {
             // leni is nonnegative, therefore start falls within mBuffers[ii]
@@ -2038,9 +2279,13 @@ constSamplePtr WaveTrackCache::Get(sampleFormat format,
                buffer = mOverlapBuffer.ptr();
             }
             // leni is positive and not more than remaining
-            const size_t size = sizeof(float) * leni.as_size_t();
+            const size_t size = SAMPLE_SIZE(format) * leni.as_size_t();
             // starti is less than mBuffers[ii].len and nonnegative
-            memcpy(buffer, mBuffers[ii].data.get() + starti.as_size_t(), size);
+            if (format == mFormat)
+               memcpy(buffer, src, size);
+            else
+               CopySamplesNoDither(src, mFormat, buffer, format,
+                                   leni.as_size_t());
             wxASSERT( leni <= remaining );
             remaining -= leni.as_size_t();
             start += leni;
@@ -2062,7 +2307,7 @@ constSamplePtr WaveTrackCache::Get(sampleFormat format,
       return mOverlapBuffer.ptr();
    }
 
-   // Cache works only for float format.
+   // A narrower format would need dither, as the track gives it
    mOverlapBuffer.Resize(len, format);
    if (mPTrack->Get(mOverlapBuffer.ptr(), format, start, len, fillZero, mayThrow))
       return mOverlapBuffer.ptr();
@@ -2070,6 +2315,160 @@ constSamplePtr WaveTrackCache::Get(sampleFormat format,
       return 0;
 }
 
+sampleCount WaveTrackCache::FindClip(sampleCount s)
+{
+   for (const auto &clip : mPTrack->GetClips())
+   {
+      const auto startSample = clip->GetStartSample();
+      const auto endSample = startSample + clip->GetNumSamples();
+      if (s >= startSample && s < endSample) {
+         // Compare pointers only; the sequence of a deleted clip is never
+         // dereferenced, because mReader is reset before any other use
+         const auto sequence = clip->GetSequence();
+         if (mReader.GetSequence() != sequence)
+            mReader.Reset(sequence);
+         return startSample;
+      }
+   }
+
+   return -1;
+}
+
+sampleCount WaveTrackCache::GetBlockStart(sampleCount s)
+{
+   const auto clipStart = FindClip(s);
+   if (clipStart < 0)
+      return -1;
+   return clipStart + mReader.GetBlockStart(s - clipStart);
+}
+
+size_t WaveTrackCache::GetBestBlockSize(sampleCount s)
+{
+   const auto clipStart = FindClip(s);
+   if (clipStart < 0)
+      return mPTrack->GetMaxBlockSize();
+   return mReader.GetBestBlockSize(s - clipStart);
+}
+
+bool WaveTrackCache::GetFromClip(samplePtr buffer, sampleCount start,
+                                 size_t len, bool mayThrow)
+{
+   const auto clipStart = FindClip(start);
+   if (clipStart < 0) {
+      ClearSamples(buffer, mFormat, 0, len);
+      return true;
+   }
+   return mReader.Get(buffer, mFormat, start - clipStart, len, mayThrow);
+}
+
+BlockCache::Pin WaveTrackCache::PinBlock(sampleCount start)
+{
+   const auto clipStart = FindClip(start);
+   if (clipStart < 0)
+      return {};
+   auto file = mReader.GetBlockFile(start - clipStart);
+   if (!file)
+      return {};
+   return mPTrack->GetDirManager()->GetBlockCache().PinBlock(file);
+}
+
+void WaveTrackCache::ReadAhead(sampleCount start, size_t len)
+{
+   auto &cache = mPTrack->GetDirManager()->GetBlockCache();
+   if (!cache.IsEnabled())
+      return;
+
+   // Guess the direction and speed of playback from the last move
+   const auto pos = start.as_long_long();
+   const auto step = mLastStart < 0 ? 0 : pos - mLastStart;
+   mLastStart = pos;
+   const bool seek =
+      std::abs(step) > kMaxReadAheadStep * (long long)mBufferSize;
+   const bool backwards = (step == 0 || seek) ? mBackwards : step < 0;
+   const auto speed = (step == 0 || seek)
+      ? (long long)len : std::max<long long>(len, std::abs(step));
+
+   // After a jump, forget what was asked for before
+   const bool replace = seek || backwards != mBackwards || mFrontier < 0;
+   mBackwards = backwards;
+
+   // Look at least one whole block beyond the request
+   const auto reach =
+      std::max<long long>(speed * kReadAheadRequests, mBufferSize);
+
+   std::vector<BlockFilePtr> files;
+   if (!backwards) {
+      auto s = pos + (long long)len;
+      if (!replace)
+         s = std::max(s, mFrontier);
+      const auto limit = pos + (long long)len + reach;
+      while (s < limit && files.size() < kReadAheadBlocks) {
+         const auto clipStart = FindClip(s);
+         if (clipStart < 0)
+            // Stop at the end of the clip; later requests resume beyond
+            break;
+         auto file = mReader.GetBlockFile(s - clipStart);
+         if (!file)
+            break;
+         const auto blockStart =
+            (clipStart + mReader.GetBlockStart(s - clipStart)).as_long_long();
+         s = blockStart + (long long)file->GetLength();
+         files.push_back(std::move(file));
+      }
+      mFrontier = s;
+   }
+   else {
+      auto s = pos;
+      if (!replace)
+         s = std::min(s, mFrontier);
+      const auto limit = pos - reach;
+      while (s > limit && s > 0 && files.size() < kReadAheadBlocks) {
+         const auto clipStart = FindClip(s - 1);
+         if (clipStart < 0)
+            break;
+         auto file = mReader.GetBlockFile(s - 1 - clipStart);
+         if (!file)
+            break;
+         s = (clipStart + mReader.GetBlockStart(s - 1 - clipStart))
+            .as_long_long();
+         files.push_back(std::move(file));
+      }
+      mFrontier = s;
+   }
+
+   if (replace || !files.empty())
+      BlockPrefetcher::Get().Request(*mRing, cache, std::move(files), replace);
+}
+
+void WaveTrackCache::Prefetch(
+   const std::vector<sampleCount> &starts, size_t len)
+{
+   auto &cache = mPTrack->GetDirManager()->GetBlockCache();
+   if (!cache.IsEnabled())
+      return;
+   if (!mRing)
+      mRing = std::make_unique<BlockPrefetcher::Ring>(kPrefetchBlocks);
+
+   std::vector<BlockFilePtr> files;
+   for (const auto start : starts) {
+      auto s = std::max<long long>(0, start.as_long_long());
+      const auto limit = start.as_long_long() + (long long)len;
+      for (size_t count = 0; s < limit && count < kPrefetchBlocksEach; ++count) {
+         const auto clipStart = FindClip(s);
+         if (clipStart < 0)
+            break;
+         auto file = mReader.GetBlockFile(s - clipStart);
+         if (!file)
+            break;
+         s = (clipStart + mReader.GetBlockStart(s - clipStart)).as_long_long()
+            + (long long)file->GetLength();
+         files.push_back(std::move(file));
+      }
+   }
+
+   BlockPrefetcher::Get().Request(*mRing, cache, std::move(files), true);
+}
+
 void WaveTrackCache::Free()
 {
    mBuffers[0].Free();
@@ -2077,3 +2476,12 @@ void WaveTrackCache::Free()
    mOverlapBuffer.Free();
    mNValidBuffers = 0;
 }
+
+void WaveTrackCache::Allocate(size_t size, sampleFormat format)
+{
+   Free();
+   mBufferSize = size;
+   mFormat = format;
+   mBuffers[0].data.Allocate(mBufferSize, mFormat);
+   mBuffers[1].data.Allocate(mBufferSize, mFormat);
+}
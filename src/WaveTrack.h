@@ -14,6 +14,7 @@
 #include "Track.h"
 #include "SampleFormat.h"
 #include "WaveClip.h"
+#include "Sequence.h"
 #include "Experimental.h"
 #include "widgets/ProgressDialog.h"
 
@@ -23,7 +24,11 @@
 #include <wx/thread.h>
 
 #include "WaveTrackLocation.h"
+#include "RealtimeChain.h"
+#include "blockfile/BlockCache.h"
+#include "blockfile/BlockPrefetcher.h"
 
+class SpectrogramSettings;
 class WaveformSettings;
 
 class CutlineHandle;
@@ -120,6 +125,14 @@ private:
    // -1.0 (left) -> 1.0 (right)
    float GetPan() const;
    void SetPan(float newPan) override;
+   // Takes pan into account; channel 0 is left, 1 right
+   float GetChannelGain(int channel) const;
+
+   // What AudioIO applies to the track as it plays, without changing the
+   // samples; change it through AudioIO::SetRealtimeSettings()
+   const RealtimeSettings &GetRealtimeSettings() const { return mRealtime; }
+   void SetRealtimeSettings(const RealtimeSettings &settings)
+      { mRealtime = settings; }
 
    int GetWaveColorIndex() const { return mWaveColorIndex; };
    void SetWaveColorIndex(int colorIndex);
@@ -127,6 +140,9 @@ private:
    sampleFormat GetSampleFormat() const { return mFormat; }
    void ConvertToSampleFormat(sampleFormat format);
 
+   // The same for all tracks, for now
+   const SpectrogramSettings &GetSpectrogramSettings() const;
+
    const WaveformSettings &GetWaveformSettings() const;
    WaveformSettings &GetWaveformSettings();
    WaveformSettings &GetIndependentWaveformSettings();
@@ -195,6 +211,11 @@ private:
    ///gets an int with OD flags so that we can determine which ODTasks should be run on this track after save/open, etc.
    unsigned int GetODFlags() const;
 
+   /// Merges runs of small blocks of the clips, as Sequence::Compact() does,
+   /// until about maxBlocks are replaced; returns how many were.  Clips
+   /// whose blocks are not yet loaded are skipped.
+   size_t CompactBlocks(double fraction, size_t maxBlocks);
+
    ///Invalidates all clips' wavecaches.  Careful, This may not be threadsafe.
    void ClearWaveCaches();
 
@@ -216,6 +237,9 @@ private:
                    fillFormat fill = fillZero, bool mayThrow = true) const;
    void Set(samplePtr buffer, sampleFormat format,
                    sampleCount start, size_t len);
+   /// True if Get() would give only zeroes for these samples, because
+   /// they fall between clips or in silent blocks, without reading
+   bool IsSilent(sampleCount start, size_t len) const;
 
    // Fetch envelope values corresponding to uniformly separated sample times
    // starting at the given time.
@@ -254,6 +278,9 @@ private:
    size_t GetMaxBlockSize() const;
    size_t GetIdealBlockSize();
 
+   // The block file holding sample s, or null if s is between clips
+   BlockFilePtr GetBlockFile(sampleCount s) const;
+
    //
    // Lock and unlock the track: you must lock the track before
    // doing a copy and paste between projects.
@@ -476,6 +503,8 @@ private:
       obsoleteWaveformDBDisplay,
 
       NoDisplay,            // Preview track has no display
+
+      Spectrum,
    };
 
    // Only two types of sample display for now, but
@@ -541,6 +570,7 @@ private:
    int           mRate;
    float         mPan;
    int           mWaveColorIndex;
+   RealtimeSettings mRealtime;
 
 
    //
@@ -561,12 +591,24 @@ private:
 
  private:
 
+   // The clips sorted by start, with the greatest end so far, to find
+   // those at a time or in a range without looking at all of them
+   struct ClipIndex;
+   // Made again when clips are added or removed, or the offset, rate or
+   // length of any clip has changed since; safe to call on any thread
+   std::shared_ptr<const ClipIndex> GetClipIndex() const;
+   // Call after adding or removing clips
+   void ClipsChanged();
+
    //
    // Private variables
    //
 
    std::unique_ptr<WaveformSettings> mpWaveformSettings;
 
+   mutable ODLock mClipIndexMutex;
+   mutable std::shared_ptr<const ClipIndex> mClipIndex;
+
 protected:
    std::shared_ptr<TrackControls> GetControls() override;
 };
@@ -596,23 +638,57 @@ public:
    const WaveTrack *GetTrack() const { return mPTrack.get(); }
    void SetTrack(const std::shared_ptr<const WaveTrack> &pTrack);
 
+   // In read-ahead mode, each Get() also asks the BlockPrefetcher for the
+   // blocks that the next few calls will probably want, judging from the
+   // direction and distance from the previous call
+   void SetReadAhead(bool readAhead);
+
+   // Ask the BlockPrefetcher for the blocks of the len samples that follow
+   // each of starts, nearest first, instead of what was asked for before,
+   // as for the places that a seek may jump to.  Not for a cache that
+   // also reads ahead.
+   void Prefetch(const std::vector<sampleCount> &starts, size_t len);
+
    // Uses fillZero always
    // Returns null on failure
    // Returned pointer may be invalidated if Get is called again
    // Do not DELETE[] the pointer
+   // The cache holds samples in the format of the track; a format that
+   // holds them exactly is cached too, and converted to only here
    constSamplePtr Get(
       sampleFormat format, sampleCount start, size_t len, bool mayThrow);
 
 private:
    void Free();
+   void Allocate(size_t size, sampleFormat format);
+
+   // Point mReader at the sequence of the clip containing track sample s,
+   // and return the clip's first sample, or -1 if no clip contains s
+   sampleCount FindClip(sampleCount s);
+
+   // Like the WaveTrack methods of the same names, but the lookups in the
+   // clip go through mReader, so that playing forward needs no searches
+   sampleCount GetBlockStart(sampleCount s);
+   size_t GetBestBlockSize(sampleCount s);
+   // [start, start + len) must lie in one clip
+   bool GetFromClip(samplePtr buffer, sampleCount start, size_t len,
+                    bool mayThrow);
+
+   // Keep the block behind a buffer resident in the project's BlockCache
+   BlockCache::Pin PinBlock(sampleCount start);
+
+   // Predict from a request what will follow, and prefetch it
+   void ReadAhead(sampleCount start, size_t len);
+   void CancelReadAhead();
 
    struct Buffer {
-      Floats data;
+      SampleBuffer data;
       sampleCount start;
       sampleCount len;
+      BlockCache::Pin pin;
 
       Buffer() : start(0), len(0) {}
-      void Free() { data.reset(); start = 0; len = 0; }
+      void Free() { data.Free(); start = 0; len = 0; pin.reset(); }
       sampleCount end() const { return start + len; }
 
       void swap ( Buffer &other )
@@ -620,14 +696,26 @@ private:
          data .swap ( other.data );
          std::swap( start, other.start );
          std::swap( len, other.len );
+         std::swap( pin, other.pin );
       }
    };
 
    std::shared_ptr<const WaveTrack> mPTrack;
    size_t mBufferSize;
+   // Of mBuffers: that of the track, so that an int16 track takes half
+   // the memory of float
+   sampleFormat mFormat { floatSample };
    Buffer mBuffers[2];
    GrowableSampleBuffer mOverlapBuffer;
    int mNValidBuffers;
+   Sequence::Reader mReader;
+
+   // Read-ahead state, used only when mRing exists
+   std::unique_ptr<BlockPrefetcher::Ring> mRing;
+   long long mLastStart { -1 };
+   // Blocks up to here (or down to here, backwards) were already requested
+   long long mFrontier { -1 };
+   bool mBackwards { false };
 };
 
 #endif // __AUDACITY_WAVETRACK__
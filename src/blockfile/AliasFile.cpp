@@ -0,0 +1,210 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   AliasFile.cpp
+
+*******************************************************************//**
+
+\class AliasFile
+\brief An audio file that alias block files point into, held open with
+libsndfile.
+
+*//****************************************************************//**
+
+\class AliasFileTable
+\brief A bounded, thread-safe, least-recently-used table of AliasFile
+objects, keyed by full path.
+
+The DirManager owns one such table for the reads of all alias block
+files, so that playing an imported file in place does not open, seek
+and close it for each block, which on a network share costs round trips
+enough to stutter.  When the blocks of a file are read in order, as in
+playback or export, the system is asked to fetch the next few megabytes
+before they are needed.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "AliasFile.h"
+
+#include <algorithm>
+#include <wx/filefn.h>
+#include <wx/log.h>
+#include <wx/time.h>
+
+#include "BlockIOStats.h"
+
+#if !defined(__WXMSW__)
+#include <fcntl.h>
+#endif
+
+namespace {
+
+// How far ahead of reads in order to have the system fetch the file
+const wxFileOffset kReadAheadBytes = 4 * 1024 * 1024;
+
+// Reads in order before reading ahead, so that scattered reads, as for
+// drawing, fetch nothing they won't use
+const unsigned kReadsBeforeReadAhead = 2;
+
+// How often to look at the disk for a change of an open file
+const long long kCheckInterval = 1000; // milliseconds
+
+}
+
+std::shared_ptr<AliasFile> AliasFile::Open(const wxString &fullPath)
+{
+   std::shared_ptr<AliasFile> result{ safenew AliasFile };
+   result->mFullPath = fullPath;
+   result->mModified = wxFileModificationTime(fullPath);
+   if (result->mModified == (time_t)-1)
+      return {};
+
+   {
+      // A failure is reported by the caller, which then opens the file
+      // itself, as it did before files were kept open
+      wxLogNull silence;
+      if (!result->mFile.Open(fullPath))
+         return {};
+   }
+   BlockIOStats::Add(BlockIOStats::FilesOpened);
+
+   // Even though there is an sf_open() that takes a filename, use the one that
+   // takes a file descriptor since wxWidgets can open a file with a Unicode name and
+   // libsndfile can't (under Windows).
+   result->mSndFile.reset(SFCall<SNDFILE*>(sf_open_fd,
+      result->mFile.fd(), SFM_READ, &result->mInfo, FALSE));
+   if (!result->mSndFile)
+      return {};
+
+   result->mPosition = 0;
+   result->mLastChecked = wxGetLocalTimeMillis().GetValue();
+   return result;
+}
+
+AliasFile::~AliasFile()
+{
+}
+
+bool AliasFile::Seek(sf_count_t frame)
+{
+   if (frame == mPosition) {
+      ++mSequentialReads;
+      return true;
+   }
+
+   mSequentialReads = 0;
+   mReadAheadEnd = 0;
+   mPosition = -1;
+   if (SFCall<sf_count_t>(sf_seek, mSndFile.get(), frame, SEEK_SET) < 0)
+      return false;
+   mPosition = frame;
+   return true;
+}
+
+void AliasFile::Advance(sf_count_t frames)
+{
+   if (mPosition >= 0)
+      mPosition += frames;
+
+#if defined(POSIX_FADV_WILLNEED)
+   if (mSequentialReads < kReadsBeforeReadAhead)
+      return;
+
+   // Ask again when half of what was asked for has been read
+   const auto offset = mFile.Tell();
+   if (offset == wxInvalidOffset || offset + kReadAheadBytes / 2 < mReadAheadEnd)
+      return;
+   const auto start = std::max(offset, mReadAheadEnd);
+   mReadAheadEnd = offset + kReadAheadBytes;
+   posix_fadvise(mFile.fd(), start, mReadAheadEnd - start, POSIX_FADV_WILLNEED);
+#endif
+}
+
+bool AliasFile::IsCurrent() const
+{
+   const long long now = wxGetLocalTimeMillis().GetValue();
+   if (now - mLastChecked.load(std::memory_order_relaxed) < kCheckInterval)
+      return true;
+   mLastChecked.store(now, std::memory_order_relaxed);
+
+   // Also false if the file is gone
+   return wxFileModificationTime(mFullPath) == mModified;
+}
+
+void AliasFileTable::SetCapacity(size_t capacity)
+{
+   ODLocker locker{ &mLock };
+   mCapacity = capacity;
+   TrimToCapacity();
+}
+
+auto AliasFileTable::Acquire(const wxString &fullPath) -> Ptr
+{
+   ODLocker locker{ &mLock };
+   if (mCapacity == 0)
+      return {};
+
+   auto found = mIndex.find(fullPath);
+   if (found != mIndex.end()) {
+      // Move to the front
+      mRecent.splice(mRecent.begin(), mRecent, found->second);
+      Ptr ptr = found->second->second;
+
+      // Don't hold the lock while looking at the disk
+      locker.reset();
+      if (ptr->IsCurrent())
+         return ptr;
+
+      // Changed or removed since opened; open it again
+      Release(fullPath);
+   }
+   else
+      // Don't hold the lock while the file is opened
+      locker.reset();
+
+   Ptr ptr{ AliasFile::Open(fullPath) };
+   if (!ptr)
+      return {};
+
+   locker.reset(&mLock);
+   found = mIndex.find(fullPath);
+   if (found != mIndex.end())
+      // Another thread was quicker; use its file and let ours close
+      return found->second->second;
+
+   mRecent.emplace_front(fullPath, ptr);
+   mIndex[fullPath] = mRecent.begin();
+   TrimToCapacity();
+
+   return ptr;
+}
+
+void AliasFileTable::Release(const wxString &fullPath)
+{
+   ODLocker locker{ &mLock };
+   auto found = mIndex.find(fullPath);
+   if (found != mIndex.end()) {
+      mRecent.erase(found->second);
+      mIndex.erase(found);
+   }
+}
+
+void AliasFileTable::Clear()
+{
+   ODLocker locker{ &mLock };
+   mIndex.clear();
+   mRecent.clear();
+}
+
+void AliasFileTable::TrimToCapacity()
+{
+   // Lock is already held
+   while (mRecent.size() > mCapacity) {
+      mIndex.erase(mRecent.back().first);
+      mRecent.pop_back();
+   }
+}
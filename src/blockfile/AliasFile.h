@@ -0,0 +1,113 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   AliasFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_ALIAS_FILE__
+#define __AUDACITY_ALIAS_FILE__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <wx/file.h>
+#include <wx/string.h>
+
+#include "../FileFormats.h"
+#include "../ondemand/ODTaskThread.h"
+
+/// An audio file that alias block files point into, kept open with
+/// libsndfile between reads, so that reading a block costs a read, and a
+/// seek only when the blocks are not read in order.
+class AliasFile final {
+ public:
+   /// Open the file; returns null if it is missing or not audio
+   static std::shared_ptr<AliasFile> Open(const wxString &fullPath);
+
+   ~AliasFile();
+
+   AliasFile(const AliasFile&) PROHIBITED;
+   AliasFile &operator= (const AliasFile&) PROHIBITED;
+
+   /// Readers share the position in the file, so each holds this while
+   /// it seeks and reads
+   ODLock &GetLock() const { return mLock; }
+
+   SNDFILE *GetSndFile() const { return mSndFile.get(); }
+   const SF_INFO &GetInfo() const { return mInfo; }
+
+   /// Move to the frame, unless the last read ended there; false on error
+   bool Seek(sf_count_t frame);
+   /// Note the frames just read from where Seek() moved, and, when reads
+   /// come in order, ask the system to fetch what follows ahead of them
+   void Advance(sf_count_t frames);
+
+   /// False if the file was changed or removed since it was opened.
+   /// Looks at the disk no more than once a second.
+   bool IsCurrent() const;
+
+ private:
+   AliasFile() {}
+
+   mutable ODLock mLock;
+   wxFile mFile;
+   SFFile mSndFile;
+   SF_INFO mInfo {};
+   wxString mFullPath;
+   time_t mModified { 0 };
+   mutable std::atomic<long long> mLastChecked { 0 };
+
+   // The frame after the last read, or -1 if unknown
+   sf_count_t mPosition { -1 };
+   // Consecutive reads that started where the one before ended
+   unsigned mSequentialReads { 0 };
+   // Where the last request to read ahead ends, in bytes
+   wxFileOffset mReadAheadEnd { 0 };
+};
+
+/// A bounded table of open alias files, shared by all projects, closing
+/// the least recently used file when it is full.  Readers hold a
+/// shared_ptr, so a file is never closed under a read on another thread.
+class AliasFileTable final {
+ public:
+   using Ptr = std::shared_ptr<AliasFile>;
+
+   AliasFileTable() {}
+
+   AliasFileTable(const AliasFileTable&) PROHIBITED;
+   AliasFileTable &operator= (const AliasFileTable&) PROHIBITED;
+
+   /// Zero capacity opens the file for each read, as before; shrinking
+   /// closes files at once
+   void SetCapacity(size_t capacity);
+   size_t GetCapacity() const { return mCapacity; }
+
+   /// Find or open the file; null when disabled, or when the file can't
+   /// be opened, which the caller then reports as it did before
+   Ptr Acquire(const wxString &fullPath);
+
+   /// Close a file that is about to be renamed or rewritten
+   void Release(const wxString &fullPath);
+
+   void Clear();
+
+ private:
+   void TrimToCapacity();
+
+   using Entry = std::pair<wxString, Ptr>;
+   using List = std::list<Entry>;
+
+   ODLock mLock;
+   size_t mCapacity { 0 };
+   List mRecent; // most recently used at the front
+   std::unordered_map<wxString, List::iterator> mIndex;
+};
+
+#endif
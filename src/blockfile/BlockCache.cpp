@@ -0,0 +1,414 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockCache.cpp
+
+*******************************************************************//**
+
+\class BlockCache
+\brief Holds decoded float samples of recently read blocks within a
+byte budget.
+
+Each DirManager owns one BlockCache, but the blocks of all of them are
+in one store for the process, with one budget, the preference
+"/Directories/BlockCacheBudget" (in megabytes), and one order of
+eviction, so that the projects open together do not each take a budget
+of their own.  The preference "/Directories/BlockCacheProjectQuota" (a
+percentage of the budget, all of it by default) limits what one
+project may hold; a project over its quota evicts its own blocks first.
+While memory is short, MemoryPressure limits the store to less than the
+budget.
+
+Sequence::Read() goes through the cache for all float reads, and for
+reads in the format of the sequence, which convert back from float
+exactly, so display, playback and analysis share decoded data.  When the budget is exhausted
+the least recently used block is evicted, except for blocks held by a
+BlockCache::Pin, which the playback mixers take for the blocks they are
+reading.
+
+Entries are keyed by BlockFile address, but hold only a weak pointer,
+so a destroyed block file is never mistaken for a NEW one at the same
+address.  Blocks that tracks share by copy on write are one BlockFile,
+and so one entry.  Alias blocks of the same range of the same file,
+which projects importing one file each make, share their samples too:
+the first decodes them, the others take them from it, and the budget
+counts them once.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockCache.h"
+
+#include <algorithm>
+
+#include "../BlockFile.h"
+#include "BlockIOStats.h"
+
+struct BlockCache::Store {
+   ODLock lock;
+   size_t budget { 0 };
+   size_t limit { ~size_t(0) }; // while memory is short
+   size_t bytes { 0 }; // of distinct samples
+
+   size_t Room() const { return std::min(budget, limit); }
+   Map entries;
+   std::list<const BlockFile*> recent; // most recently used at the front
+   std::unordered_map< wxString, std::weak_ptr<Samples> > aliases;
+};
+
+namespace {
+   wxString AliasKey(const BlockFile &file)
+   {
+      if (!file.IsAlias())
+         return {};
+      const auto &alias = static_cast<const AliasBlockFile&>(file);
+      return alias.GetAliasedFileName().GetFullPath() +
+         wxString::Format(wxT("|%lld|%d|%lld"),
+            alias.GetAliasStart().as_long_long(),
+            alias.GetAliasChannel(),
+            (long long)file.GetLength());
+   }
+}
+
+auto BlockCache::Pin::operator= (Pin &&that) -> Pin &
+{
+   if (this != &that) {
+      reset();
+      mCache = that.mCache;
+      mFile = std::move(that.mFile);
+      that.mCache = nullptr;
+   }
+   return *this;
+}
+
+void BlockCache::Pin::reset()
+{
+   if (mCache && mFile)
+      mCache->Unpin(mFile.get());
+   mCache = nullptr;
+   mFile.reset();
+}
+
+auto BlockCache::GetStore() -> Store &
+{
+   static Store store;
+   return store;
+}
+
+BlockCache::~BlockCache()
+{
+   auto &store = GetStore();
+   ODLocker locker{ &store.lock };
+   for (auto iter = store.entries.begin(); iter != store.entries.end();) {
+      auto next = iter;
+      ++next;
+      if (iter->second.owner == this)
+         Erase(iter);
+      iter = next;
+   }
+}
+
+void BlockCache::SetBudget(size_t bytes)
+{
+   auto &store = GetStore();
+   ODLocker locker{ &store.lock };
+   store.budget = bytes;
+   Shrink(store);
+}
+
+void BlockCache::SetPressureLimit(size_t bytes)
+{
+   auto &store = GetStore();
+   ODLocker locker{ &store.lock };
+   store.limit = bytes;
+   Shrink(store);
+}
+
+void BlockCache::Shrink(Store &store)
+{
+   // Walk from least recently used, skipping pinned blocks
+   auto position = store.recent.end();
+   while (store.bytes > store.Room() && position != store.recent.begin()) {
+      --position;
+      auto iter = store.entries.find(*position);
+      if (iter->second.pins > 0)
+         continue;
+      auto next = position;
+      ++next;
+      auto owner = iter->second.owner;
+      if (!iter->second.file.expired())
+         ++owner->mStatistics.evictions;
+      owner->Erase(iter);
+      position = next;
+   }
+}
+
+size_t BlockCache::GetBudget()
+{
+   auto &store = GetStore();
+   ODLocker locker{ &store.lock };
+   return store.budget;
+}
+
+void BlockCache::SetQuota(size_t bytes)
+{
+   ODLocker locker{ &GetStore().lock };
+   mQuota = bytes;
+   MakeRoom(0, 0);
+}
+
+bool BlockCache::Read(const BlockFilePtr &file,
+                      float *buffer, size_t start, size_t len)
+{
+   if (!IsEnabled() || !file)
+      return false;
+
+   ODLocker locker{ &GetStore().lock };
+   auto iter = Find(file.get());
+   if (iter != GetStore().entries.end()) {
+      ++mStatistics.hits;
+      BlockIOStats::Add(BlockIOStats::CacheHits);
+   }
+   else {
+      ++mStatistics.misses;
+      BlockIOStats::Add(BlockIOStats::CacheMisses);
+      iter = Load(locker, file);
+      if (iter == GetStore().entries.end())
+         return false;
+   }
+
+   const auto &samples = *iter->second.samples;
+   if (start + len > samples.len)
+      return false;
+
+   memcpy(buffer, samples.data.get() + start, len * sizeof(float));
+   return true;
+}
+
+bool BlockCache::Prefetch(const BlockFilePtr &file)
+{
+   if (!IsEnabled() || !file)
+      return false;
+
+   ODLocker locker{ &GetStore().lock };
+   if (Find(file.get()) != GetStore().entries.end())
+      return true;
+   return Load(locker, file) != GetStore().entries.end();
+}
+
+auto BlockCache::PinBlock(const BlockFilePtr &file) -> Pin
+{
+   if (!IsEnabled() || !file)
+      return {};
+
+   ODLocker locker{ &GetStore().lock };
+   auto iter = Find(file.get());
+   if (iter == GetStore().entries.end()) {
+      iter = Load(locker, file);
+      if (iter == GetStore().entries.end())
+         return {};
+   }
+
+   ++iter->second.pins;
+   return { this, file };
+}
+
+void BlockCache::Unpin(const BlockFile *file)
+{
+   auto &store = GetStore();
+   ODLocker locker{ &store.lock };
+   auto iter = store.entries.find(file);
+   if (iter != store.entries.end() && iter->second.pins > 0)
+      --iter->second.pins;
+}
+
+void BlockCache::Invalidate(const BlockFile *file)
+{
+   auto &store = GetStore();
+   ODLocker locker{ &store.lock };
+   auto iter = store.entries.find(file);
+   if (iter != store.entries.end() && iter->second.pins == 0)
+      iter->second.owner->Erase(iter);
+}
+
+void BlockCache::Clear()
+{
+   auto &store = GetStore();
+   ODLocker locker{ &store.lock };
+   for (auto iter = store.entries.begin(); iter != store.entries.end();) {
+      auto next = iter;
+      ++next;
+      if (iter->second.owner == this && iter->second.pins == 0)
+         Erase(iter);
+      iter = next;
+   }
+}
+
+auto BlockCache::GetStatistics() const -> Statistics
+{
+   ODLocker locker{ &GetStore().lock };
+   return mStatistics;
+}
+
+void BlockCache::ResetStatistics()
+{
+   ODLocker locker{ &GetStore().lock };
+   auto blocks = mStatistics.blocks;
+   auto bytes = mStatistics.bytes;
+   mStatistics = Statistics{};
+   mStatistics.blocks = blocks;
+   mStatistics.bytes = mStatistics.peakBytes = bytes;
+}
+
+auto BlockCache::Find(const BlockFile *file) -> Map::iterator
+{
+   auto &store = GetStore();
+   auto iter = store.entries.find(file);
+   if (iter == store.entries.end())
+      return iter;
+
+   if (iter->second.file.expired()) {
+      // Stale entry for a destroyed block at a reused address
+      iter->second.owner->Erase(iter);
+      return store.entries.end();
+   }
+
+   // Mark as most recently used
+   store.recent.splice(store.recent.begin(), store.recent,
+                       iter->second.position);
+   return iter;
+}
+
+auto BlockCache::Load(ODLocker &locker, const BlockFilePtr &file)
+   -> Map::iterator
+{
+   auto &store = GetStore();
+
+   // Blocks still being decoded on demand, and silent blocks with no
+   // file, are not worth caching
+   if (!file->IsDataAvailable() || !file->GetFileName().name.IsOk())
+      return store.entries.end();
+
+   const auto len = file->GetLength();
+   const auto bytes = len * sizeof(float);
+   if (bytes > std::min(mQuota, store.Room()))
+      return store.entries.end();
+
+   // Samples of the same alias, loaded for another block
+   auto key = AliasKey(*file);
+   std::shared_ptr<Samples> samples;
+   if (!key.empty()) {
+      auto alias = store.aliases.find(key);
+      if (alias != store.aliases.end())
+         samples = alias->second.lock();
+   }
+
+   if (!samples) {
+      // Decode without holding the lock
+      locker.reset();
+      Floats data{ len };
+      auto framesRead =
+         file->ReadData((samplePtr)data.get(), floatSample, 0, len, false);
+      locker.reset(&store.lock);
+
+      if (framesRead != len)
+         // Let the caller read again and report the error
+         return store.entries.end();
+
+      auto iter = Find(file.get());
+      if (iter != store.entries.end())
+         // Another thread loaded it meanwhile
+         return iter;
+
+      if (!key.empty()) {
+         auto alias = store.aliases.find(key);
+         if (alias != store.aliases.end())
+            samples = alias->second.lock();
+      }
+      if (!samples) {
+         samples = std::make_shared<Samples>();
+         samples->data = std::move(data);
+         samples->len = len;
+         samples->aliasKey = key;
+      }
+   }
+
+   const bool shared = samples.use_count() > 1;
+   if (!MakeRoom(bytes, shared ? 0 : bytes)) {
+      ++mStatistics.rejections;
+      return store.entries.end();
+   }
+   if (!shared) {
+      store.bytes += bytes;
+      if (!key.empty())
+         store.aliases[key] = samples;
+   }
+
+   store.recent.push_front(file.get());
+   auto &entry = store.entries[file.get()];
+   entry.file = file;
+   entry.samples = std::move(samples);
+   entry.owner = this;
+   entry.position = store.recent.begin();
+
+   ++mStatistics.blocks;
+   mStatistics.bytes += bytes;
+   mStatistics.peakBytes = std::max(mStatistics.peakBytes, mStatistics.bytes);
+
+   return store.entries.find(file.get());
+}
+
+void BlockCache::Erase(Map::iterator iter)
+{
+   auto &store = GetStore();
+   auto &entry = iter->second;
+   const auto bytes = entry.samples->len * sizeof(float);
+   if (entry.samples.use_count() == 1) {
+      // The last block having these samples
+      store.bytes -= bytes;
+      if (!entry.samples->aliasKey.empty())
+         store.aliases.erase(entry.samples->aliasKey);
+   }
+   --mStatistics.blocks;
+   mStatistics.bytes -= bytes;
+   store.recent.erase(entry.position);
+   store.entries.erase(iter);
+}
+
+bool BlockCache::MakeRoom(size_t bytes, size_t newBytes)
+{
+   auto &store = GetStore();
+
+   // Walk from least recently used, skipping pinned blocks, first for the
+   // quota of this cache, then for the budget of all
+   for (const bool own : { true, false }) {
+      const auto over = [&]{
+         return own
+            ? mStatistics.bytes + bytes > mQuota
+            : store.bytes + newBytes > store.Room();
+      };
+      auto position = store.recent.end();
+      while (over() && position != store.recent.begin()) {
+         --position;
+         auto iter = store.entries.find(*position);
+         auto owner = iter->second.owner;
+         if (iter->second.pins > 0 || (own && owner != this))
+            continue;
+
+         // Erasing invalidates position; step forward first
+         auto next = position;
+         ++next;
+         if (!iter->second.file.expired())
+            ++owner->mStatistics.evictions;
+         owner->Erase(iter);
+         position = next;
+      }
+      if (over())
+         return false;
+   }
+
+   return true;
+}
@@ -0,0 +1,143 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_CACHE__
+#define __AUDACITY_BLOCK_CACHE__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+#include "../SampleFormat.h"
+
+#include <wx/string.h>
+
+#include <list>
+#include <unordered_map>
+
+#include "../ondemand/ODTaskThread.h"
+
+class BlockFile;
+using BlockFilePtr = std::shared_ptr<BlockFile>;
+
+/// A least-recently-used cache of decoded float sample data of whole
+/// blocks.  Each project has one, with a quota of its own, but the blocks
+/// of all of them are kept together, within one budget for the process.
+class PROFILE_DLL_API BlockCache final {
+ public:
+   struct Statistics {
+      unsigned long long hits { 0 };
+      unsigned long long misses { 0 };
+      unsigned long long evictions { 0 };
+      // Blocks not cached because pinned blocks used up the budget
+      unsigned long long rejections { 0 };
+      // Of this cache
+      size_t blocks { 0 };
+      size_t bytes { 0 };
+      size_t peakBytes { 0 };
+   };
+
+   /// While a Pin exists, its block is never evicted.  Movable, not copyable.
+   class Pin {
+    public:
+      Pin() {}
+      Pin(Pin &&that) : mCache{ that.mCache }, mFile{ std::move(that.mFile) }
+      { that.mCache = nullptr; }
+      Pin &operator= (Pin &&that);
+      ~Pin() { reset(); }
+
+      void reset();
+      explicit operator bool () const { return mFile.get() != nullptr; }
+
+    private:
+      friend BlockCache;
+      Pin(BlockCache *cache, const BlockFilePtr &file)
+         : mCache{ cache }, mFile{ file } {}
+
+      BlockCache *mCache {};
+      BlockFilePtr mFile;
+   };
+
+   BlockCache() {}
+   /// Drops the blocks that this cache loaded
+   ~BlockCache();
+
+   BlockCache(const BlockCache&) PROHIBITED;
+   BlockCache &operator= (const BlockCache&) PROHIBITED;
+
+   /// The budget of all the caches together.  Zero disables them all;
+   /// shrinking evicts at once.
+   static void SetBudget(size_t bytes);
+   static size_t GetBudget();
+
+   /// While memory is short, all the caches together hold at most this
+   /// much, less than the budget; evicts at once.  ~size_t(0) for no limit.
+   static void SetPressureLimit(size_t bytes);
+
+   /// The most of the budget that this cache may use.  Zero disables it;
+   /// shrinking evicts at once.
+   void SetQuota(size_t bytes);
+   size_t GetQuota() const { return mQuota; }
+
+   bool IsEnabled() const { return mQuota > 0 && GetBudget() > 0; }
+
+   /// Fill buffer from the cache, decoding the whole block first on a miss.
+   /// Returns false if the cache could not be used, in which case the
+   /// caller should read the block file directly.
+   bool Read(const BlockFilePtr &file,
+             float *buffer, size_t start, size_t len);
+
+   /// Decode a block into the cache without reading it.
+   /// Returns false if it could not be made resident.
+   bool Prefetch(const BlockFilePtr &file);
+
+   /// Make the block resident if possible and keep it so while the
+   /// result exists.  The result is empty if the block could not be cached.
+   Pin PinBlock(const BlockFilePtr &file);
+
+   /// Forget one block, e.g. after its data were recovered on disk
+   void Invalidate(const BlockFile *file);
+   /// Forget the blocks that this cache loaded
+   void Clear();
+
+   Statistics GetStatistics() const;
+   void ResetStatistics();
+
+ private:
+   // Decoded samples, shared by the alias blocks of the same range of the
+   // same file, in whatever project
+   struct Samples {
+      Floats data;
+      size_t len { 0 };
+      wxString aliasKey; // empty if not an alias block
+   };
+   struct Entry {
+      std::weak_ptr<BlockFile> file;
+      std::shared_ptr<Samples> samples;
+      BlockCache *owner {};
+      unsigned pins { 0 };
+      std::list<const BlockFile*>::iterator position;
+   };
+   using Map = std::unordered_map<const BlockFile*, Entry>;
+   struct Store;
+
+   static Store &GetStore();
+   static void Shrink(Store &store);
+
+   // These require the lock of the store to be held
+   Map::iterator Find(const BlockFile *file);
+   Map::iterator Load(ODLocker &locker, const BlockFilePtr &file);
+   void Erase(Map::iterator iter);
+   bool MakeRoom(size_t bytes, size_t newBytes);
+   void Unpin(const BlockFile *file);
+
+   size_t mQuota { 0 };
+   Statistics mStatistics;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockFileName.cpp
+
+*******************************************************************//**
+
+\class BlockFileName
+\brief The file name of a BlockFile, in a few tens of bytes.
+
+A wxFileName holds the volume, each directory, the name and the
+extension as strings of their own, which for a block file comes to some
+hundreds of bytes, more than the rest of the block.  Blocks in one
+directory share a single copy of the directory and extension, from a
+table of weak pointers that forgets a directory when no block uses it.
+
+Alias blocks share the name of the file they point into from a table of
+the same kind.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockFileName.h"
+
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+
+namespace {
+
+// Shared, immutable values by key, held weakly, so that the table keeps
+// none alive
+template< typename Value > class InternTable
+{
+public:
+   template< typename Make >
+   std::shared_ptr< const Value > Intern(const wxString &key, const Make &make)
+   {
+      std::lock_guard< std::mutex > lock{ mMutex };
+      auto &entry = mEntries[key];
+      std::shared_ptr< const Value > result = entry.lock();
+      if (!result) {
+         result = make();
+         entry = result;
+         if (mEntries.size() >= mSweepSize) {
+            // Forget the values that no one holds any more
+            for (auto iter = mEntries.begin(); iter != mEntries.end();)
+               if (iter->second.expired())
+                  iter = mEntries.erase(iter);
+               else
+                  ++iter;
+            mSweepSize = std::max< size_t >(1024, 2 * mEntries.size());
+         }
+      }
+      return result;
+   }
+
+private:
+   std::mutex mMutex;
+   std::unordered_map< wxString, std::weak_ptr< const Value > > mEntries;
+   size_t mSweepSize { 1024 };
+};
+
+// The most digits that fit in mNumber
+const size_t kMaxDigits = 2 * sizeof(unsigned long long) - 1;
+
+}
+
+BlockFileName::BlockFileName(const wxFileName &fileName)
+{
+   if (!fileName.IsOk())
+      return;
+
+   mLocation = InternLocation(fileName.GetPathWithSep(), fileName.GetExt());
+
+   // DirManager names blocks "e" and lower case hexadecimal digits
+   const wxString name = fileName.GetName();
+   bool numbered = name.length() > 1 && name.length() <= kMaxDigits + 1 &&
+      name[0] == wxT('e');
+   unsigned long long number = 0;
+   for (size_t ii = 1; numbered && ii < name.length(); ++ii) {
+      const wxChar c = name[ii];
+      if (c >= wxT('0') && c <= wxT('9'))
+         number = 16 * number + (c - wxT('0'));
+      else if (c >= wxT('a') && c <= wxT('f'))
+         number = 16 * number + (c - wxT('a') + 10);
+      else
+         numbered = false;
+   }
+
+   if (numbered) {
+      mNumber = number;
+      mDigits = name.length() - 1;
+   }
+   else
+      mName = name;
+}
+
+wxFileNameWrapper BlockFileName::Get() const
+{
+   wxFileNameWrapper result;
+   if (!mLocation)
+      return result;
+   result.AssignDir(mLocation->dir);
+   result.SetName(GetName());
+   result.SetExt(mLocation->ext);
+   return result;
+}
+
+wxString BlockFileName::GetFullPath() const
+{
+   if (!mLocation)
+      return GetFullName();
+   return mLocation->dir + GetFullName();
+}
+
+wxString BlockFileName::GetFullName() const
+{
+   auto result = GetName();
+   if (mLocation && !mLocation->ext.empty())
+      result << wxT('.') << mLocation->ext;
+   return result;
+}
+
+wxString BlockFileName::GetName() const
+{
+   if (mDigits == 0)
+      return mName;
+   return wxString::Format(wxT("e%0*llx"), (int)mDigits, mNumber);
+}
+
+wxString BlockFileName::GetExt() const
+{
+   return mLocation ? mLocation->ext : wxString{};
+}
+
+auto BlockFileName::InternLocation(const wxString &dir, const wxString &ext)
+   -> std::shared_ptr<const Location>
+{
+   static InternTable< Location > table;
+   // An extension never holds a separator
+   return table.Intern(ext + wxFILE_SEP_PATH + dir, [&]{
+      return std::make_shared< Location >( Location{ dir, ext } );
+   });
+}
+
+std::shared_ptr<const wxFileNameWrapper>
+   InternAliasedFileName(const wxFileName &fileName)
+{
+   static InternTable< wxFileNameWrapper > table;
+   return table.Intern(fileName.GetFullPath(), [&]{
+      return std::make_shared< wxFileNameWrapper >( fileName );
+   });
+}
@@ -0,0 +1,64 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockFileName.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_FILE_NAME__
+#define __AUDACITY_BLOCK_FILE_NAME__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <wx/filename.h>
+#include <wx/string.h>
+#include "../wxFileNameWrapper.h"
+
+/// The name of the file of one block, kept small because a long project
+/// has a million blocks.  The directory and extension are shared by all
+/// blocks in the same directory, and a name that DirManager made, "e"
+/// and hexadecimal digits, is kept as the number.  A wxFileName is made
+/// only when asked for.
+class BlockFileName final {
+ public:
+   BlockFileName() {}
+   explicit BlockFileName(const wxFileName &fileName);
+
+   /// Make the whole wxFileName
+   wxFileNameWrapper Get() const;
+
+   wxString GetFullPath() const;
+   wxString GetFullName() const;
+   wxString GetName() const;
+   wxString GetExt() const;
+
+   bool HasName() const { return mDigits > 0 || !mName.empty(); }
+   /// As wxFileName::IsOk(): there is a name, or at least a directory
+   bool IsOk() const { return mLocation || HasName(); }
+
+ private:
+   struct Location {
+      wxString dir; // with the separator at the end
+      wxString ext;
+   };
+   static std::shared_ptr<const Location>
+      InternLocation(const wxString &dir, const wxString &ext);
+
+   std::shared_ptr<const Location> mLocation;
+   // The number after the "e", when mDigits is not zero
+   unsigned long long mNumber { 0 };
+   unsigned char mDigits { 0 };
+   // Any other name, as of a legacy block
+   wxString mName;
+};
+
+/// The one shared copy of the name of a file that alias blocks point into,
+/// which is the same for all blocks of an imported file
+std::shared_ptr<const wxFileNameWrapper>
+   InternAliasedFileName(const wxFileName &fileName);
+
+#endif
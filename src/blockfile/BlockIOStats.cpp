@@ -0,0 +1,119 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockIOStats.cpp
+
+*******************************************************************//**
+
+\class BlockIOStats
+\brief Counts of files opened, bytes read and written, reads of summaries
+and of samples, hits and misses of the BlockCache, and time spent in
+libsndfile, by purpose: playback, display, export, on-demand loading, or
+other.
+
+Scopes are placed where the purpose is known: AudioIO filling its
+buffers, TrackArtist drawing a track, an exporter mixing, and an ODTask
+doing some of its work.  The threads of a MixerPool take the scopes of
+the thread they help.  Sequence adds the scope of the counts of its
+project around its reads, and DirManager around making block files.
+Get Info shows the counts of the program and of the project, and the
+Profiler writes those of the program to its log.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockIOStats.h"
+
+namespace {
+
+thread_local BlockIOStats::Purpose tPurpose = BlockIOStats::Other;
+thread_local BlockIOStats *tStats = nullptr;
+
+}
+
+const char *BlockIOStats::PurposeName(Purpose purpose)
+{
+   static const char *const names[nPurposes] = {
+      "other", "playback", "display", "export", "ondemand"
+   };
+   return names[purpose];
+}
+
+const char *BlockIOStats::CounterName(Counter counter)
+{
+   static const char *const names[nCounters] = {
+      "filesopened", "bytesread", "byteswritten", "summaryreads",
+      "samplereads", "cachehits", "cachemisses", "sndfilenanoseconds"
+   };
+   return names[counter];
+}
+
+BlockIOStats::BlockIOStats()
+{
+   Reset();
+}
+
+unsigned long long BlockIOStats::Total(Counter counter) const
+{
+   unsigned long long total = 0;
+   for (int purpose = 0; purpose < nPurposes; ++purpose)
+      total += Get(Purpose(purpose), counter);
+   return total;
+}
+
+void BlockIOStats::Reset()
+{
+   for (auto &counts : mCounts)
+      for (auto &count : counts)
+         count.store(0, std::memory_order_relaxed);
+}
+
+void BlockIOStats::Add(Counter counter, unsigned long long amount)
+{
+   Program().mCounts[tPurpose][counter].fetch_add(
+      amount, std::memory_order_relaxed);
+   if (tStats)
+      tStats->mCounts[tPurpose][counter].fetch_add(
+         amount, std::memory_order_relaxed);
+}
+
+BlockIOStats &BlockIOStats::Program()
+{
+   static BlockIOStats stats;
+   return stats;
+}
+
+auto BlockIOStats::Current() -> Context
+{
+   return { tPurpose, tStats };
+}
+
+BlockIOStats::Scope::Scope(Purpose purpose)
+   : mOuterPurpose{ tPurpose }, mOuterStats{ tStats }
+{
+   tPurpose = purpose;
+}
+
+BlockIOStats::Scope::Scope(BlockIOStats &stats)
+   : mOuterPurpose{ tPurpose }, mOuterStats{ tStats }
+{
+   // The program's counts are always added to, and not twice
+   if (&stats != &Program())
+      tStats = &stats;
+}
+
+BlockIOStats::Scope::Scope(const Context &context)
+   : mOuterPurpose{ tPurpose }, mOuterStats{ tStats }
+{
+   tPurpose = context.purpose;
+   tStats = context.stats;
+}
+
+BlockIOStats::Scope::~Scope()
+{
+   tPurpose = mOuterPurpose;
+   tStats = mOuterStats;
+}
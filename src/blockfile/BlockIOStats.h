@@ -0,0 +1,104 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockIOStats.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_IO_STATS__
+#define __AUDACITY_BLOCK_IO_STATS__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <atomic>
+
+/// Counts of the reading and writing of block files, by what they were
+/// read or written for.  Each DirManager has one for its project, and
+/// there is one for the whole program.
+///
+/// Block files do not know their project, nor why they are read, so the
+/// thread doing the reading says so with a BlockIOStats::Scope; the block
+/// files add to the counts of the innermost scopes of their thread, and
+/// always to those of the program.
+class PROFILE_DLL_API BlockIOStats final {
+ public:
+   enum Purpose {
+      Other,
+      Playback,
+      Display,
+      Export,
+      OnDemand,
+      nPurposes
+   };
+
+   enum Counter {
+      FilesOpened,
+      BytesRead,
+      BytesWritten,
+      // Reads of summaries of blocks, and of samples of blocks by sequences
+      SummaryReads,
+      SampleReads,
+      // Of the BlockCache of decoded samples
+      CacheHits,
+      CacheMisses,
+      // Opening, seeking and reading files with libsndfile
+      SndfileNanoseconds,
+      nCounters
+   };
+
+   static const char *PurposeName(Purpose purpose);
+   static const char *CounterName(Counter counter);
+
+   BlockIOStats();
+   BlockIOStats(const BlockIOStats&) PROHIBITED;
+   BlockIOStats &operator= (const BlockIOStats&) PROHIBITED;
+
+   unsigned long long Get(Purpose purpose, Counter counter) const
+   { return mCounts[purpose][counter].load(std::memory_order_relaxed); }
+   unsigned long long Total(Counter counter) const;
+
+   void Reset();
+
+   /// Add to the counts of the program, and of the project of the calling
+   /// thread's innermost scope, if any, under the purpose of its innermost
+   /// scope that names one.  Takes no lock.
+   static void Add(Counter counter, unsigned long long amount = 1);
+
+   /// The counts of all projects together
+   static BlockIOStats &Program();
+
+   /// What the innermost scopes of the calling thread name, to be given
+   /// to a Scope in threads that work on its behalf
+   struct Context {
+      Purpose purpose;
+      BlockIOStats *stats;
+   };
+   static Context Current();
+
+   /// Attributes the reading and writing of the calling thread, until
+   /// destroyed, to a purpose, or to the counts of a project.  Scopes nest;
+   /// what a scope does not name, it takes from the enclosing one.
+   class PROFILE_DLL_API Scope {
+    public:
+      explicit Scope(Purpose purpose);
+      explicit Scope(BlockIOStats &stats);
+      explicit Scope(const Context &context);
+      ~Scope();
+
+      Scope(const Scope&) PROHIBITED;
+      Scope &operator= (const Scope&) PROHIBITED;
+
+    private:
+      Purpose mOuterPurpose;
+      BlockIOStats *mOuterStats;
+   };
+
+ private:
+   std::atomic<unsigned long long> mCounts[nPurposes][nCounters];
+};
+
+#endif
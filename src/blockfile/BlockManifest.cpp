@@ -0,0 +1,215 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockManifest.cpp
+
+*******************************************************************//**
+
+\class BlockManifest
+\brief Lets DirManager::ProjectFSCK() skip the scan of the project data
+directory when nothing changed since the project was saved.
+
+The manifest is a text file, blocks.manifest, in the data directory.
+After a header line, each line holds the path of one block file
+relative to the data directory, its size in bytes, and its modification
+time, separated by tabs.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockManifest.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#include <wx/ffile.h>
+#include <wx/filefn.h>
+#include <wx/filename.h>
+#include <wx/textfile.h>
+#include <wx/thread.h>
+#include <wx/tokenzr.h>
+
+#include "../MemoryX.h"
+
+static const wxChar *kManifestName = wxT("blocks.manifest");
+static const wxChar *kManifestHeader = wxT("Audacity block manifest 1");
+
+// How many of the listed files Matches() examines on disk
+static const size_t kSampleCount = 64;
+
+// Files per thread below which CheckFiles() doesn't bother with threads
+static const size_t kFilesPerThread = 256;
+
+namespace {
+
+wxString ManifestPath(const wxString &dataDir)
+{
+   return dataDir + wxFILE_SEP_PATH + kManifestName;
+}
+
+wxString RelativePath(const wxString &dataDir, const wxString &path)
+{
+   wxFileName name{ path };
+   name.MakeRelativeTo(dataDir);
+   return name.GetFullPath(wxPATH_UNIX);
+}
+
+struct FileState {
+   wxULongLong size;
+   long long modified;
+
+   bool operator == (const FileState &other) const
+   { return size == other.size && modified == other.modified; }
+};
+
+bool GetFileState(const wxString &path, FileState &state)
+{
+   state.size = wxFileName::GetSize(path);
+   if (state.size == wxInvalidSize)
+      return false;
+   state.modified = wxFileModificationTime(path);
+   return state.modified != -1;
+}
+
+class FileCheckThread final : public wxThread
+{
+public:
+   FileCheckThread(const wxArrayString &paths, bool nonEmpty,
+                   std::vector<char> &results, size_t begin, size_t end)
+      : wxThread{ wxTHREAD_JOINABLE }
+      , mPaths{ paths }, mNonEmpty{ nonEmpty }
+      , mResults{ results }, mBegin{ begin }, mEnd{ end }
+   {}
+
+   // Each thread writes only its own range of results
+   static void CheckRange(const wxArrayString &paths, bool nonEmpty,
+                          std::vector<char> &results, size_t begin, size_t end)
+   {
+      for (auto ii = begin; ii < end; ++ii) {
+         const auto size = wxFileName::GetSize(paths[ii]);
+         results[ii] = size != wxInvalidSize && (!nonEmpty || size != 0);
+      }
+   }
+
+protected:
+   ExitCode Entry() override
+   {
+      CheckRange(mPaths, mNonEmpty, mResults, mBegin, mEnd);
+      return 0;
+   }
+
+private:
+   const wxArrayString &mPaths;
+   const bool mNonEmpty;
+   std::vector<char> &mResults;
+   const size_t mBegin, mEnd;
+};
+
+}
+
+// static
+bool BlockManifest::Write(const wxString &dataDir, const wxArrayString &paths)
+{
+   wxString contents{ kManifestHeader };
+   contents += wxT("\n");
+   for (const auto &path : paths) {
+      FileState state;
+      if (!GetFileState(path, state))
+         continue;
+      contents += wxString::Format(wxT("%s\t%s\t%lld\n"),
+         RelativePath(dataDir, path), state.size.ToString(), state.modified);
+   }
+
+   wxFFile file(ManifestPath(dataDir), wxT("wb"));
+   return file.IsOpened() && file.Write(contents, wxConvUTF8) &&
+      file.Close();
+}
+
+// static
+bool BlockManifest::Matches(const wxString &dataDir, const wxArrayString &paths)
+{
+   wxTextFile file;
+   if (!wxFileExists(ManifestPath(dataDir)) ||
+       !file.Open(ManifestPath(dataDir), wxConvUTF8) ||
+       file.GetLineCount() == 0 ||
+       file.GetFirstLine() != kManifestHeader)
+      return false;
+
+   std::unordered_map<wxString, FileState> listed;
+   for (size_t ii = 1; ii < file.GetLineCount(); ++ii) {
+      wxStringTokenizer tokens{ file[ii], wxT("\t") };
+      if (tokens.CountTokens() != 3)
+         return false;
+      const auto name = tokens.GetNextToken();
+      unsigned long long size;
+      long long modified;
+      if (!tokens.GetNextToken().ToULongLong(&size) ||
+          !tokens.GetNextToken().ToLongLong(&modified))
+         return false;
+      listed[name] = FileState{ size, modified };
+   }
+
+   if (listed.size() != paths.size())
+      return false;
+
+   // Compare the lists for exact agreement, in memory
+   for (const auto &path : paths)
+      if (listed.find(RelativePath(dataDir, path)) == listed.end())
+         return false;
+
+   // Compare a bounded, evenly spread sample with the disk
+   const auto step = std::max<size_t>(1, paths.size() / kSampleCount);
+   for (size_t ii = 0; ii < paths.size(); ii += step) {
+      FileState state;
+      if (!GetFileState(paths[ii], state) ||
+          !(state == listed[RelativePath(dataDir, paths[ii])]))
+         return false;
+   }
+
+   return true;
+}
+
+// static
+void BlockManifest::Remove(const wxString &dataDir)
+{
+   const auto path = ManifestPath(dataDir);
+   if (wxFileExists(path))
+      wxRemoveFile(path);
+}
+
+// static
+std::vector<char> BlockManifest::CheckFiles(
+   const wxArrayString &paths, bool nonEmpty)
+{
+   std::vector<char> results(paths.size(), 0);
+
+   const size_t nThreads = std::min<size_t>(
+      std::max(1, wxThread::GetCPUCount()),
+      (paths.size() + kFilesPerThread - 1) / kFilesPerThread);
+
+   if (nThreads <= 1) {
+      FileCheckThread::CheckRange(paths, nonEmpty, results, 0, paths.size());
+      return results;
+   }
+
+   std::vector< std::unique_ptr<FileCheckThread> > threads;
+   const auto perThread = (paths.size() + nThreads - 1) / nThreads;
+   for (size_t begin = 0; begin < paths.size(); begin += perThread) {
+      const auto end = std::min(paths.size(), begin + perThread);
+      auto thread = std::make_unique<FileCheckThread>(
+         paths, nonEmpty, results, begin, end);
+      if (thread->Run() == wxTHREAD_NO_ERROR)
+         threads.push_back(std::move(thread));
+      else
+         // Could not start a thread; do this range here
+         FileCheckThread::CheckRange(paths, nonEmpty, results, begin, end);
+   }
+
+   for (auto &thread : threads)
+      thread->Wait();
+
+   return results;
+}
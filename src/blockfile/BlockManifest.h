@@ -0,0 +1,42 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockManifest.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_MANIFEST__
+#define __AUDACITY_BLOCK_MANIFEST__
+
+#include "../Audacity.h"
+
+#include <vector>
+#include <wx/arrstr.h>
+#include <wx/string.h>
+
+/// A record, in the project data directory, of the size and
+/// modification time of every block file, so that a project unchanged
+/// since it was saved can be checked without scanning the directory
+class PROFILE_DLL_API BlockManifest final {
+ public:
+   /// Record the given files, which are in the tree under dataDir
+   static bool Write(const wxString &dataDir, const wxArrayString &paths);
+
+   /// Whether the manifest lists exactly the given files, and a sample
+   /// of them is unchanged on disk
+   static bool Matches(const wxString &dataDir, const wxArrayString &paths);
+
+   /// Delete the manifest, when the files may have been changed
+   static void Remove(const wxString &dataDir);
+
+   /// Test on several threads whether each file exists and, optionally,
+   /// is not empty.  The result has one nonzero element for each file
+   /// that passed.
+   static std::vector<char> CheckFiles(
+      const wxArrayString &paths, bool nonEmpty);
+};
+
+#endif
@@ -0,0 +1,284 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockPack.cpp
+
+*******************************************************************//**
+
+\class BlockPack
+\brief Stores the data of many blocks in one file.
+
+A project with hours of audio has tens of thousands of blocks; as
+separate files they make copying, enumeration at open and Save As take
+time proportional to the number of blocks.  When the preference
+"/Directories/PackBlockFiles" is set, DirManager instead appends NEW
+blocks to one BlockPack per project, so that those operations handle
+one file.  See PackedBlockFile.
+
+The import of a file of many channels packs its blocks whatever the
+preference.  It appends a block of each channel in turn, so the blocks
+of all the channels at one time lie together, and playing them reads
+forward through the file.  A read that follows closely on the last
+therefore reads a window ahead with it, and the reads of the other
+channels are served from there: one read of the disk, not one for each
+channel.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockPack.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <wx/filefn.h>
+
+#include "../FileException.h"
+
+// Bytes copied at a time by WriteCopy()
+static const size_t kCopyBufferSize = 1 << 20;
+// Bytes read ahead of a read going forward, and how far past the end of
+// the last read it may start, skipping the summary of a block
+static const size_t kReadAheadBytes = 1 << 20;
+static const wxFileOffset kReadAheadGap = 64 * 1024;
+
+BlockPack::BlockPack(const wxString &path)
+   : mPath{ path }
+{
+}
+
+BlockPack::~BlockPack()
+{
+}
+
+wxString BlockPack::GetPath() const
+{
+   ODLocker locker{ &mLock };
+   return mPath;
+}
+
+bool BlockPack::OpenFile() const
+{
+   if (mFile.IsOpened())
+      return true;
+
+   if (!wxFileExists(mPath) && !wxFile{}.Create(mPath))
+      return false;
+   return mFile.Open(mPath, wxFile::read_write);
+}
+
+bool BlockPack::ReadAt(wxFileOffset offset, void *buffer, size_t size) const
+{
+   if (!OpenFile())
+      return false;
+   return mFile.Seek(offset) == offset &&
+      mFile.Read(buffer, size) == (ssize_t)size;
+}
+
+bool BlockPack::ReadThrough(wxFileOffset offset, void *buffer,
+                            size_t size) const
+{
+   const auto lastEnd = mLastEnd;
+   mLastEnd = offset + size;
+
+   if (offset >= mAheadOffset &&
+       offset + (wxFileOffset)size <= mAheadOffset + (wxFileOffset)mAheadSize) {
+      memcpy(buffer, mAhead.get() + (offset - mAheadOffset), size);
+      return true;
+   }
+
+   if (size >= kReadAheadBytes || lastEnd < 0 || offset < lastEnd ||
+       offset - lastEnd > kReadAheadGap)
+      return ReadAt(offset, buffer, size);
+
+   if (!mAhead)
+      mAhead.reinit(kReadAheadBytes);
+   mAheadSize = 0;
+   const auto count =
+      (size_t)std::min<wxFileOffset>(kReadAheadBytes, mEnd - offset);
+   if (!OpenFile() || mFile.Seek(offset) != offset)
+      return false;
+   const auto got = mFile.Read(mAhead.get(), std::max(count, size));
+   if (got < (ssize_t)size)
+      return false;
+   mAheadOffset = offset;
+   mAheadSize = got;
+   memcpy(buffer, mAhead.get(), size);
+   return true;
+}
+
+bool BlockPack::WriteAt(wxFileOffset offset, const void *data, size_t size)
+{
+   // Any write may change what was read ahead
+   mAheadSize = 0;
+   if (!OpenFile())
+      return false;
+   return mFile.Seek(offset) == offset &&
+      mFile.Write(data, size) == size;
+}
+
+auto BlockPack::Add(const void *data, size_t size) -> Id
+{
+   ODLocker locker{ &mLock };
+
+   // Best fit among the holes, else append
+   Extent extent{ mEnd, size };
+   auto hole = mHoles.lower_bound(size);
+   const bool reuse = hole != mHoles.end();
+   if (reuse)
+      extent.offset = hole->second;
+
+   if (!WriteAt(extent.offset, data, size))
+      throw FileException{ FileException::Cause::Write, mPath };
+
+   if (reuse) {
+      const auto rest = hole->first - size;
+      const auto restOffset = hole->second + size;
+      mHoles.erase(hole);
+      if (rest > 0)
+         mHoles.emplace(rest, restOffset);
+      mWasted -= size;
+   }
+   else
+      mEnd += size;
+
+   const auto id = mNextId++;
+   mIndex[id] = extent;
+   return id;
+}
+
+void BlockPack::Remove(Id id)
+{
+   ODLocker locker{ &mLock };
+   auto iter = mIndex.find(id);
+   if (iter == mIndex.end())
+      return;
+
+   mHoles.emplace(iter->second.size, iter->second.offset);
+   mWasted += iter->second.size;
+   mIndex.erase(iter);
+}
+
+bool BlockPack::Read(Id id, size_t offset, void *buffer, size_t size) const
+{
+   ODLocker locker{ &mLock };
+   auto iter = mIndex.find(id);
+   if (iter == mIndex.end() || offset + size > iter->second.size)
+      return false;
+   return ReadThrough(iter->second.offset + offset, buffer, size);
+}
+
+bool BlockPack::Write(Id id, size_t offset, const void *data, size_t size)
+{
+   ODLocker locker{ &mLock };
+   auto iter = mIndex.find(id);
+   if (iter == mIndex.end() || offset + size > iter->second.size)
+      return false;
+   return WriteAt(iter->second.offset + offset, data, size);
+}
+
+bool BlockPack::Contains(Id id) const
+{
+   ODLocker locker{ &mLock };
+   return mIndex.find(id) != mIndex.end() && wxFileExists(mPath);
+}
+
+size_t BlockPack::GetSize(Id id) const
+{
+   ODLocker locker{ &mLock };
+   auto iter = mIndex.find(id);
+   return iter == mIndex.end() ? 0 : iter->second.size;
+}
+
+bool BlockPack::IsEmpty() const
+{
+   ODLocker locker{ &mLock };
+   return mIndex.empty();
+}
+
+wxFileOffset BlockPack::GetWastedBytes() const
+{
+   ODLocker locker{ &mLock };
+   return mWasted;
+}
+
+bool BlockPack::WriteCopy(const wxString &path, Index &index) const
+{
+   ODLocker locker{ &mLock };
+   return DoWriteCopy(path, index);
+}
+
+bool BlockPack::DoWriteCopy(const wxString &path, Index &index) const
+{
+   wxFile copy;
+   if (!copy.Create(path, true))
+      return false;
+
+   ArrayOf<char> buffer{ kCopyBufferSize };
+   wxFileOffset position = 0;
+   index.clear();
+   // Ascending ids are in order of creation, which keeps neighbouring
+   // blocks of a track close
+   for (const auto &pair : mIndex) {
+      const auto &extent = pair.second;
+      for (size_t done = 0; done < extent.size;) {
+         const auto count = std::min(kCopyBufferSize, extent.size - done);
+         if (!ReadAt(extent.offset + done, buffer.get(), count) ||
+             copy.Write(buffer.get(), count) != count) {
+            copy.Close();
+            wxRemoveFile(path);
+            return false;
+         }
+         done += count;
+      }
+      index[pair.first] = Extent{ position, extent.size };
+      position += extent.size;
+   }
+
+   return copy.Close();
+}
+
+void BlockPack::Relocate(const wxString &path, Index &&index)
+{
+   ODLocker locker{ &mLock };
+   DoRelocate(path, std::move(index));
+}
+
+void BlockPack::DoRelocate(const wxString &path, Index &&index)
+{
+   mFile.Close();
+   mPath = path;
+   mIndex = std::move(index);
+   mAheadSize = 0;
+   mLastEnd = -1;
+   mHoles.clear();
+   mWasted = 0;
+   mEnd = 0;
+   for (const auto &pair : mIndex)
+      mEnd = std::max(mEnd, pair.second.offset + (wxFileOffset)pair.second.size);
+
+   // Ids must stay unique over the life of this object
+   if (!mIndex.empty())
+      mNextId = std::max(mNextId, mIndex.rbegin()->first + 1);
+}
+
+bool BlockPack::Compact()
+{
+   ODLocker locker{ &mLock };
+   const auto tempPath = mPath + wxT(".tmp");
+
+   Index index;
+   if (!DoWriteCopy(tempPath, index))
+      return false;
+
+   mFile.Close();
+   if (!wxRenameFile(tempPath, mPath, true)) {
+      wxRemoveFile(tempPath);
+      return false;
+   }
+   DoRelocate(mPath, std::move(index));
+   return true;
+}
@@ -0,0 +1,101 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockPack.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_PACK__
+#define __AUDACITY_BLOCK_PACK__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <map>
+#include <wx/file.h>
+#include <wx/string.h>
+
+#include "../ondemand/ODTaskThread.h"
+
+/// One large file holding the data of many blocks, with an index of
+/// their extents.  Space of removed blocks is reused for NEW blocks of
+/// no greater size, and reclaimed entirely by Compact() or WriteCopy().
+/// All members are thread-safe.
+class PROFILE_DLL_API BlockPack final {
+ public:
+   using Id = unsigned long long; // never 0
+
+   struct Extent {
+      wxFileOffset offset;
+      size_t size;
+   };
+   using Index = std::map<Id, Extent>;
+
+   /// The file is created when the first block is added
+   explicit BlockPack(const wxString &path);
+   ~BlockPack();
+
+   BlockPack(const BlockPack&) PROHIBITED;
+   BlockPack &operator= (const BlockPack&) PROHIBITED;
+
+   wxString GetPath() const;
+
+   /// Store the bytes.  Throws FileException if the pack can't be written.
+   Id Add(const void *data, size_t size);
+   /// Forget the block; its space may be reused
+   void Remove(Id id);
+
+   /// Read or overwrite part of a block; false if out of range or on
+   /// failure of the file
+   bool Read(Id id, size_t offset, void *buffer, size_t size) const;
+   bool Write(Id id, size_t offset, const void *data, size_t size);
+
+   bool Contains(Id id) const;
+   size_t GetSize(Id id) const;
+   bool IsEmpty() const;
+
+   /// Bytes of the file not used by any block
+   wxFileOffset GetWastedBytes() const;
+
+   /// Write only the stored blocks, contiguously, to a NEW file, and
+   /// compute their extents there.  This pack is unchanged.
+   bool WriteCopy(const wxString &path, Index &index) const;
+   /// Continue with a file made by WriteCopy; does not throw.  The old
+   /// file is left on disk.
+   void Relocate(const wxString &path, Index &&index);
+
+   /// Rewrite the file in place without free space
+   bool Compact();
+
+ private:
+   // These require the lock to be held
+   bool OpenFile() const;
+   bool ReadAt(wxFileOffset offset, void *buffer, size_t size) const;
+   // ReadAt(), through the window read ahead
+   bool ReadThrough(wxFileOffset offset, void *buffer, size_t size) const;
+   bool WriteAt(wxFileOffset offset, const void *data, size_t size);
+   bool DoWriteCopy(const wxString &path, Index &index) const;
+   void DoRelocate(const wxString &path, Index &&index);
+
+   mutable ODLock mLock;
+   wxString mPath;
+   mutable wxFile mFile;
+
+   Index mIndex;
+   Id mNextId { 1 };
+   std::multimap<size_t, wxFileOffset> mHoles; // by size, for best fit
+   wxFileOffset mEnd { 0 };
+   wxFileOffset mWasted { 0 };
+
+   // Bytes read ahead of a read going forward through the file, and where
+   // the last read ended
+   mutable ArrayOf<char> mAhead;
+   mutable wxFileOffset mAheadOffset { 0 };
+   mutable size_t mAheadSize { 0 };
+   mutable wxFileOffset mLastEnd { -1 };
+};
+
+#endif
@@ -0,0 +1,172 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockPrefetcher.cpp
+
+*******************************************************************//**
+
+\class BlockPrefetcher
+\brief Reads blocks ahead of playback on a background thread.
+
+A WaveTrackCache in read-ahead mode predicts, from the direction and
+distance between its successive requests, which blocks the next few will
+need, and asks for them here.  The thread decodes each into the project's
+BlockCache and pins it in the reader's Ring.  So when Mixer::MixSameRate()
+gets there, Sequence::Read() finds the samples in memory instead of
+waiting on the disk.
+
+Readers are served one block at a time in turn, so that one track far
+ahead never starves the others.  Nothing happens when the BlockCache is
+disabled, because there is then nowhere to put decoded blocks.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockPrefetcher.h"
+
+#include <algorithm>
+
+#include <wx/thread.h>
+
+class BlockPrefetcher::Thread final : public wxThread
+{
+public:
+   explicit Thread(BlockPrefetcher &prefetcher)
+      : wxThread{ wxTHREAD_JOINABLE }, mPrefetcher{ prefetcher }
+   {}
+
+protected:
+   ExitCode Entry() override
+   {
+      mPrefetcher.Work();
+      return 0;
+   }
+
+private:
+   BlockPrefetcher &mPrefetcher;
+};
+
+// static
+BlockPrefetcher &BlockPrefetcher::Get()
+{
+   static BlockPrefetcher instance;
+   return instance;
+}
+
+// static
+void BlockPrefetcher::Quit()
+{
+   Get().Stop();
+}
+
+BlockPrefetcher::BlockPrefetcher()
+{
+}
+
+BlockPrefetcher::~BlockPrefetcher()
+{
+   Stop();
+}
+
+void BlockPrefetcher::Stop()
+{
+   std::unique_ptr<Thread> thread;
+   {
+      ODLocker locker{ &mLock };
+      mStopping = true;
+      mWake.Signal();
+      thread = std::move(mThread);
+   }
+
+   if (thread)
+      thread->Wait();
+}
+
+void BlockPrefetcher::Request(Ring &ring, BlockCache &cache,
+                              std::vector<BlockFilePtr> &&files, bool replace)
+{
+   ODLocker locker{ &mLock };
+   if (mStopping)
+      return;
+
+   // A Cancel() must come between two caches
+   wxASSERT(!ring.mCache || ring.mCache == &cache);
+   ring.mCache = &cache;
+
+   if (replace)
+      ring.mWanted.clear();
+   for (auto &file : files)
+      ring.mWanted.push_back(std::move(file));
+   if (ring.mWanted.empty())
+      return;
+
+   if (!mThread) {
+      auto thread = std::make_unique<Thread>(*this);
+      if (thread->Run() != wxTHREAD_NO_ERROR)
+         return;
+      mThread = std::move(thread);
+   }
+
+   if (!ring.mQueued) {
+      ring.mQueued = true;
+      mQueue.push_back(&ring);
+   }
+   mWake.Signal();
+}
+
+void BlockPrefetcher::Cancel(Ring &ring)
+{
+   std::deque<BlockCache::Pin> pins;
+   {
+      ODLocker locker{ &mLock };
+      if (ring.mQueued) {
+         mQueue.erase(std::find(mQueue.begin(), mQueue.end(), &ring));
+         ring.mQueued = false;
+      }
+      ring.mWanted.clear();
+      while (mBusy == &ring)
+         mIdle.Wait();
+      pins.swap(ring.mPins);
+      ring.mCache = nullptr;
+   }
+   // pins unpin as they go out of scope, without our lock
+}
+
+void BlockPrefetcher::Work()
+{
+   ODLocker locker{ &mLock };
+   for (;;) {
+      while (mQueue.empty() && !mStopping)
+         mWake.Wait();
+      if (mStopping)
+         break;
+
+      auto &ring = *mQueue.front();
+      mQueue.pop_front();
+      const auto file = std::move(ring.mWanted.front());
+      ring.mWanted.pop_front();
+      if (ring.mWanted.empty())
+         ring.mQueued = false;
+      else
+         mQueue.push_back(&ring);
+
+      // Cancel() waits till this block is done, so ring and cache survive
+      mBusy = &ring;
+      auto &cache = *ring.mCache;
+      locker.reset();
+
+      auto pin = cache.PinBlock(file);
+
+      locker.reset(&mLock);
+      mBusy = nullptr;
+      if (pin) {
+         ring.mPins.push_back(std::move(pin));
+         if (ring.mPins.size() > ring.mSize)
+            ring.mPins.pop_front();
+      }
+      mIdle.Broadcast();
+   }
+}
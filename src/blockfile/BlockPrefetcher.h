@@ -0,0 +1,87 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockPrefetcher.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_PREFETCHER__
+#define __AUDACITY_BLOCK_PREFETCHER__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <deque>
+#include <vector>
+
+#include "BlockCache.h"
+#include "../ondemand/ODTaskThread.h"
+
+/// One background thread that decodes blocks into the BlockCache of their
+/// project before a reader, such as a playback track, gets to them
+class PROFILE_DLL_API BlockPrefetcher final {
+ public:
+   /// What one reader has asked for, and the few blocks most recently
+   /// decoded for it, which stay pinned in the cache until newer ones
+   /// displace them.  The reader owns it, and must Cancel() it before
+   /// destroying it or letting the cache go.
+   class Ring {
+    public:
+      explicit Ring(size_t size) : mSize{ size } {}
+      ~Ring() { wxASSERT(!mQueued); }
+
+      Ring(const Ring&) PROHIBITED;
+      Ring &operator= (const Ring&) PROHIBITED;
+
+    private:
+      friend BlockPrefetcher;
+      const size_t mSize;
+
+      // The rest is guarded by the lock of the prefetcher
+      BlockCache *mCache {};
+      std::deque<BlockFilePtr> mWanted; // nearest first
+      std::deque<BlockCache::Pin> mPins; // oldest first
+      bool mQueued { false };
+   };
+
+   static BlockPrefetcher &Get();
+   /// Stops the thread for good; called at exit, after all projects close
+   static void Quit();
+
+   BlockPrefetcher(const BlockPrefetcher&) PROHIBITED;
+   BlockPrefetcher &operator= (const BlockPrefetcher&) PROHIBITED;
+
+   /// Queue these blocks of the cache for the ring, nearest first, after
+   /// those it wanted before, or instead of them if replace is true.
+   /// Returns at once.
+   void Request(Ring &ring, BlockCache &cache,
+                std::vector<BlockFilePtr> &&files, bool replace);
+
+   /// Forget what the ring wanted, and unpin its blocks.  Waits if the
+   /// thread is decoding for it now.
+   void Cancel(Ring &ring);
+
+ private:
+   class Thread;
+   friend Thread;
+
+   BlockPrefetcher();
+   ~BlockPrefetcher();
+
+   void Stop();
+   void Work();
+
+   ODLock mLock;
+   ODCondition mWake { &mLock };
+   ODCondition mIdle { &mLock };
+   // Served round robin, one block at a time
+   std::deque<Ring*> mQueue;
+   Ring *mBusy {};
+   bool mStopping { false };
+   std::unique_ptr<Thread> mThread;
+};
+
+#endif
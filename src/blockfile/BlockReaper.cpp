@@ -0,0 +1,263 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockReaper.cpp
+
+*******************************************************************//**
+
+\class BlockReaper
+\brief Removes the files of deleted blocks and the directories of closed
+projects on threads of its own.
+
+~BlockFile() queues its file here instead of removing it, so that
+closing a big project, which lets go of thousands of blocks at once,
+does not wait for as many unlinks.  Several threads (preference
+"/Directories/CleanupThreads") take files from one queue.
+
+~DirManager() marks the directory of a project never saved, or at the
+last close the whole temporary directory, and queues it.  Directories
+are removed in one batch whenever the queue of files runs dry.
+
+At exit, work under the temporary directory is dropped, and the window
+closes without waiting.  The marks stay, and at the next launch
+DirManager::ResumeCleanup() queues the directories again.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockReaper.h"
+
+#include <algorithm>
+
+#include <wx/dir.h>
+#include <wx/ffile.h>
+#include <wx/filefn.h>
+#include <wx/thread.h>
+
+class BlockReaper::Thread final : public wxThread
+{
+public:
+   Thread(BlockReaper &reaper)
+      : wxThread{ wxTHREAD_JOINABLE }, mReaper{ reaper }
+   {}
+
+protected:
+   ExitCode Entry() override
+   {
+      mReaper.Run(*this);
+      return 0;
+   }
+
+private:
+   BlockReaper &mReaper;
+};
+
+namespace {
+
+// Remove the directories under path and then path itself, each with its
+// files if all; else only if nothing is left but the marker, and such
+// files as the Finder leaves.  Returns whether path is gone.
+bool RemoveTree(const wxString &path, bool all)
+{
+   wxArrayString files, dirs;
+   {
+      // Closed again before the removals, as Windows requires
+      wxDir dir(path);
+      if (!dir.IsOpened())
+         return !wxDirExists(path);
+      wxString name;
+      for (bool cont = dir.GetFirst(&name, wxEmptyString,
+                                    wxDIR_FILES | wxDIR_HIDDEN);
+           cont; cont = dir.GetNext(&name))
+         files.push_back(name);
+      for (bool cont = dir.GetFirst(&name, wxEmptyString,
+                                    wxDIR_DIRS | wxDIR_HIDDEN);
+           cont; cont = dir.GetNext(&name))
+         dirs.push_back(name);
+   }
+
+   bool empty = true;
+   for (const auto &name : dirs)
+      empty = RemoveTree(path + wxFILE_SEP_PATH + name, all) && empty;
+
+   // The marker goes last, so that it stays until nothing else does
+   bool marked = false;
+   for (const auto &name : files) {
+      if (name == BlockReaper::MarkerName())
+         marked = true;
+      else if (all || name == wxT(".DS_Store"))
+         empty = ::wxRemoveFile(path + wxFILE_SEP_PATH + name) && empty;
+      else
+         empty = false;
+   }
+   if (!empty)
+      return false;
+
+   if (marked)
+      ::wxRemoveFile(path + wxFILE_SEP_PATH + BlockReaper::MarkerName());
+   return ::wxRmdir(path);
+}
+
+}
+
+BlockReaper::BlockReaper()
+{
+}
+
+BlockReaper::~BlockReaper()
+{
+   Shutdown();
+}
+
+// static
+const wxChar *BlockReaper::MarkerName()
+{
+   return wxT("remove.me");
+}
+
+// static
+bool BlockReaper::Mark(const wxString &path)
+{
+   wxFFile file(path + wxFILE_SEP_PATH + MarkerName(), wxT("w"));
+   return file.IsOpened() && file.Close();
+}
+
+void BlockReaper::SetThreads(size_t count)
+{
+   ODLocker locker{ &mLock };
+   mThreadCount = std::max<size_t>(1, count);
+}
+
+bool BlockReaper::StartThreads()
+{
+   // The lock is held; the threads wait on it before they look at the
+   // queues
+   if (mShutDown)
+      return false;
+   if (mThreads.empty()) {
+      mStopping = false;
+      for (size_t ii = 0; ii < mThreadCount; ++ii) {
+         auto thread = std::make_unique<Thread>(*this);
+         if (thread->Run() != wxTHREAD_NO_ERROR)
+            break;
+         mThreads.push_back(std::move(thread));
+      }
+   }
+   return !mThreads.empty();
+}
+
+void BlockReaper::RemoveFile(const wxString &path)
+{
+   ODLocker locker{ &mLock };
+
+   if (!StartThreads()) {
+      const bool abandon =
+         mShutDown && !mAbandonUnder.empty() &&
+         path.StartsWith(mAbandonUnder);
+      locker.reset();
+      // No thread; remove it now
+      if (!abandon)
+         ::wxRemoveFile(path);
+      return;
+   }
+
+   mFiles.push_back(path);
+   mQueued.Signal();
+}
+
+void BlockReaper::RemoveDir(const wxString &path, bool all)
+{
+   ODLocker locker{ &mLock };
+
+   // Without threads, the marker leaves it for the next launch
+   if (!StartThreads())
+      return;
+
+   mDirs.push_back({ path, all });
+   mQueued.Signal();
+}
+
+void BlockReaper::Flush()
+{
+   ODLocker locker{ &mLock };
+   while (!mThreads.empty() &&
+          (!mFiles.empty() || !mDirs.empty() || mBusy > 0))
+      mDone.Wait();
+}
+
+void BlockReaper::Shutdown(const wxString &abandonUnder)
+{
+   std::vector<std::unique_ptr<Thread>> threads;
+   {
+      ODLocker locker{ &mLock };
+      mShutDown = true;
+      mAbandonUnder = abandonUnder;
+      if (!abandonUnder.empty()) {
+         mFiles.erase(std::remove_if(mFiles.begin(), mFiles.end(),
+            [&](const wxString &path) {
+               return path.StartsWith(abandonUnder); }),
+            mFiles.end());
+         mDirs.erase(std::remove_if(mDirs.begin(), mDirs.end(),
+            [&](const DirItem &item) {
+               return item.path.StartsWith(abandonUnder); }),
+            mDirs.end());
+      }
+
+      // The threads empty the queues before they see this
+      mStopping = true;
+      mQueued.Broadcast();
+      threads.swap(mThreads);
+   }
+
+   for (auto &thread : threads)
+      thread->Wait();
+}
+
+bool BlockReaper::ReadyForDirs() const
+{
+   return !mDirs.empty() && mFiles.empty() && mBusy == 0;
+}
+
+void BlockReaper::Run(Thread &)
+{
+   ODLocker locker{ &mLock };
+   for (;;) {
+      while (mFiles.empty() && !ReadyForDirs() && !mStopping)
+         mQueued.Wait();
+
+      if (!mFiles.empty()) {
+         auto path = std::move(mFiles.front());
+         mFiles.pop_front();
+
+         // Remove without the lock, so that RemoveFile() never waits on
+         // the disk
+         ++mBusy;
+         locker.reset();
+         ::wxRemoveFile(path);
+         locker.reset(&mLock);
+         --mBusy;
+      }
+      else if (ReadyForDirs()) {
+         // All the directories queued so far, in one batch
+         std::vector<DirItem> dirs;
+         dirs.swap(mDirs);
+
+         ++mBusy;
+         locker.reset();
+         for (const auto &item : dirs)
+            RemoveTree(item.path, item.all);
+         locker.reset(&mLock);
+         --mBusy;
+      }
+      else
+         // Stopping, and nothing is left that this thread may take; a
+         // busy thread takes any directories when it is done
+         break;
+
+      if (mFiles.empty() && mDirs.empty() && mBusy == 0)
+         mDone.Broadcast();
+   }
+}
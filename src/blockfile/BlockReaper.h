@@ -0,0 +1,86 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockReaper.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_REAPER__
+#define __AUDACITY_BLOCK_REAPER__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <deque>
+#include <vector>
+
+#include <wx/string.h>
+
+#include "../ondemand/ODTaskThread.h"
+
+/// Threads that remove the files of deleted blocks, and the directories
+/// of closed projects, so that neither the thread letting go of the
+/// blocks nor the closing window waits on the disk.
+class PROFILE_DLL_API BlockReaper final {
+ public:
+   BlockReaper();
+   ~BlockReaper();
+
+   BlockReaper(const BlockReaper&) PROHIBITED;
+   BlockReaper &operator= (const BlockReaper&) PROHIBITED;
+
+   /// How many threads remove files, from when they next start
+   void SetThreads(size_t count);
+
+   /// Remove the file.  Never waits.
+   void RemoveFile(const wxString &path);
+
+   /// Once the files queued before are gone, remove the directory and
+   /// those under it, if nothing but the marker is left in them, or, if
+   /// all, with whatever is left.  The directory should hold the marker,
+   /// so that what is not done now is done at the next launch.
+   void RemoveDir(const wxString &path, bool all);
+
+   /// Wait until everything queued so far is done
+   void Flush();
+
+   /// Finish the work queued, but for what is under abandonUnder, which
+   /// is left for the next launch, and end the threads for good.  After
+   /// this, files are removed at once, and directories not at all.
+   void Shutdown(const wxString &abandonUnder = {});
+
+   /// The name of the file marking a directory to be removed
+   static const wxChar *MarkerName();
+
+   /// Put the marker into the directory
+   static bool Mark(const wxString &path);
+
+ private:
+   class Thread;
+   friend Thread;
+   void Run(Thread &thread);
+   bool StartThreads();
+   bool ReadyForDirs() const;
+
+   struct DirItem {
+      wxString path;
+      bool all;
+   };
+
+   ODLock mLock;
+   ODCondition mQueued { &mLock };
+   ODCondition mDone { &mLock };
+   std::deque<wxString> mFiles;
+   std::vector<DirItem> mDirs;
+   size_t mBusy { 0 };  // threads removing something now
+   size_t mThreadCount { 2 };
+   bool mStopping { false };
+   bool mShutDown { false };
+   wxString mAbandonUnder;
+   std::vector<std::unique_ptr<Thread>> mThreads;
+};
+
+#endif
@@ -0,0 +1,144 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockWriter.cpp
+
+*******************************************************************//**
+
+\class BlockWriter
+\brief Writes NEW block files on a thread of its own.
+
+Sequence::Append() lets DirManager::NewSimpleBlockFile() defer the
+write of each NEW block.  If the BlockWriter is enabled (preference
+"/Directories/BackgroundWriteBudget", in megabytes) and has room, the
+SimpleBlockFile keeps its data in memory, where any reader finds them,
+and is queued here.  When the queue is full, blocks are written at
+once, as before, so memory use stays bounded.
+
+DirManager::WriteCacheToDisk(), SetProject() and ProjectFSCK() flush
+the queue first, because they need the files.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "BlockWriter.h"
+
+#include <wx/thread.h>
+
+#include "../BlockFile.h"
+
+class BlockWriter::Thread final : public wxThread
+{
+public:
+   Thread(BlockWriter &writer)
+      : wxThread{ wxTHREAD_JOINABLE }, mWriter{ writer }
+   {}
+
+protected:
+   ExitCode Entry() override
+   {
+      mWriter.Run(*this);
+      return 0;
+   }
+
+private:
+   BlockWriter &mWriter;
+};
+
+BlockWriter::BlockWriter()
+{
+}
+
+BlockWriter::~BlockWriter()
+{
+   Stop();
+}
+
+void BlockWriter::SetBudget(size_t bytes)
+{
+   ODLocker locker{ &mLock };
+   mBudget = bytes;
+}
+
+bool BlockWriter::IsEnabled() const
+{
+   ODLocker locker{ &mLock };
+   return mBudget > 0;
+}
+
+bool BlockWriter::HasRoom(size_t bytes) const
+{
+   ODLocker locker{ &mLock };
+   return mPendingBytes + bytes <= mBudget;
+}
+
+void BlockWriter::Enqueue(const BlockFilePtr &file, size_t bytes)
+{
+   ODLocker locker{ &mLock };
+
+   if (!mThread) {
+      mStopping = false;
+      mThread = std::make_unique<Thread>(*this);
+      if (mThread->Run() != wxTHREAD_NO_ERROR) {
+         mThread.reset();
+         locker.reset();
+         // No thread; write it now
+         file->WriteCacheToDisk();
+         return;
+      }
+   }
+
+   mQueue.push_back({ file, bytes });
+   mPendingBytes += bytes;
+   mQueued.Signal();
+}
+
+void BlockWriter::Flush()
+{
+   ODLocker locker{ &mLock };
+   while (mPendingBytes > 0)
+      mWritten.Wait();
+}
+
+void BlockWriter::Stop()
+{
+   std::unique_ptr<Thread> thread;
+   {
+      ODLocker locker{ &mLock };
+      // The thread empties the queue before it sees this
+      mStopping = true;
+      mQueued.Signal();
+      thread = std::move(mThread);
+   }
+
+   if (thread)
+      thread->Wait();
+}
+
+void BlockWriter::Run(Thread &)
+{
+   ODLocker locker{ &mLock };
+   for (;;) {
+      while (mQueue.empty() && !mStopping)
+         mQueued.Wait();
+      if (mQueue.empty())
+         break;
+
+      auto item = mQueue.front();
+      mQueue.pop_front();
+
+      // Write without the lock, so that Enqueue() never waits on the disk
+      locker.reset();
+      if (auto file = item.file.lock())
+         // Does nothing if somebody else wrote it already.  May destroy
+         // the block here, if this was the last reference.
+         file->WriteCacheToDisk();
+      locker.reset(&mLock);
+
+      mPendingBytes -= item.bytes;
+      mWritten.Broadcast();
+   }
+}
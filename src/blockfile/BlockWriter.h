@@ -0,0 +1,74 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   BlockWriter.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_BLOCK_WRITER__
+#define __AUDACITY_BLOCK_WRITER__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <deque>
+
+#include "../ondemand/ODTaskThread.h"
+
+class BlockFile;
+using BlockFilePtr = std::shared_ptr<BlockFile>;
+
+/// A thread that writes the data of NEW block files to disk, so that the
+/// thread making them, usually the audio thread when recording, does not
+/// wait on the disk.  Until written, the data are read from memory.
+class PROFILE_DLL_API BlockWriter final {
+ public:
+   BlockWriter();
+   ~BlockWriter();
+
+   BlockWriter(const BlockWriter&) PROHIBITED;
+   BlockWriter &operator= (const BlockWriter&) PROHIBITED;
+
+   /// Bound on the bytes of sample data waiting to be written.
+   /// Zero disables writing in the background.
+   void SetBudget(size_t bytes);
+   bool IsEnabled() const;
+
+   /// Whether a block of this many bytes may be queued now; if not, the
+   /// caller should write it itself
+   bool HasRoom(size_t bytes) const;
+
+   /// Queue a block whose GetNeedWriteCacheToDisk() is true.
+   /// Never waits.
+   void Enqueue(const BlockFilePtr &file, size_t bytes);
+
+   /// Wait until everything queued so far is on disk
+   void Flush();
+
+   /// Flush, and end the thread; it starts again on the next Enqueue()
+   void Stop();
+
+ private:
+   class Thread;
+   friend Thread;
+   void Run(Thread &thread);
+
+   struct Item {
+      std::weak_ptr<BlockFile> file;
+      size_t bytes;
+   };
+
+   mutable ODLock mLock;
+   ODCondition mQueued { &mLock };
+   ODCondition mWritten { &mLock };
+   std::deque<Item> mQueue;
+   size_t mBudget { 0 };
+   size_t mPendingBytes { 0 };  // queued or being written
+   bool mStopping { false };
+   std::unique_ptr<Thread> mThread;
+};
+
+#endif
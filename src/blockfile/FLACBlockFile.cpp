@@ -0,0 +1,423 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   FLACBlockFile.cpp
+
+*******************************************************************//**
+
+\class FLACBlockFile
+\brief A BlockFile that stores its samples losslessly compressed
+with libFLAC.
+
+The .auc file holds a flacBlockHeader, then the summary data exactly
+as SimpleBlockFile writes it, then a complete FLAC stream of one
+channel.  Keeping the summary uncompressed and at a fixed offset means
+drawing of zoomed out waveforms costs no decoding.
+
+DirManager::NewSimpleBlockFile() chooses this class instead of
+SimpleBlockFile when the preference "/Directories/CompressBlockFiles"
+is set and the data can be stored without loss.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "FLACBlockFile.h"
+
+#ifdef USE_LIBFLAC
+
+#include <vector>
+
+#include <wx/ffile.h>
+#include <wx/filefn.h>
+#include <wx/log.h>
+
+#include "FLAC++/encoder.h"
+#include "FLAC++/decoder.h"
+
+#include "../FileException.h"
+#include "../Internat.h"
+#include "../MemoryX.h"
+
+static const wxUint32 kFLACBlockMagic = 0x41754666; // 'AuFl'
+
+namespace {
+
+// Collects the encoded stream in memory, so the file is written once
+class FLACBlockEncoder final : public FLAC::Encoder::Stream
+{
+public:
+   std::vector<FLAC__byte> mBytes;
+
+protected:
+   ::FLAC__StreamEncoderWriteStatus write_callback(
+      const FLAC__byte buffer[], size_t bytes,
+      unsigned, unsigned) override
+   {
+      mBytes.insert(mBytes.end(), buffer, buffer + bytes);
+      return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+   }
+};
+
+// Decodes from memory into a caller's buffer, skipping samples before
+// the start and stopping as soon as the request is satisfied
+class FLACBlockDecoder final : public FLAC::Decoder::Stream
+{
+public:
+   FLACBlockDecoder(const FLAC__byte *bytes, size_t nBytes,
+                    int *buffer, size_t start, size_t len)
+      : mBytes{ bytes }, mNBytes{ nBytes }
+      , mBuffer{ buffer }, mStart{ start }, mLen{ len }
+   {}
+
+   size_t mDecoded { 0 };
+
+protected:
+   ::FLAC__StreamDecoderReadStatus read_callback(
+      FLAC__byte buffer[], size_t *bytes) override
+   {
+      const auto remaining = mNBytes - mPosition;
+      if (remaining == 0) {
+         *bytes = 0;
+         return FLAC__STREAM_DECODER_READ_STATUS_END_OF_STREAM;
+      }
+      *bytes = std::min(*bytes, remaining);
+      memcpy(buffer, mBytes + mPosition, *bytes);
+      mPosition += *bytes;
+      return FLAC__STREAM_DECODER_READ_STATUS_CONTINUE;
+   }
+
+   ::FLAC__StreamDecoderWriteStatus write_callback(
+      const ::FLAC__Frame *frame, const FLAC__int32 * const buffer[]) override
+   {
+      const size_t blocksize = frame->header.blocksize;
+      const auto frameStart = mFrameStart;
+      mFrameStart += blocksize;
+
+      // Overlap of this frame with the requested range
+      const auto begin = std::max(frameStart, mStart);
+      const auto end = std::min(mFrameStart, mStart + mLen);
+      if (begin < end) {
+         memcpy(mBuffer + (begin - mStart), buffer[0] + (begin - frameStart),
+                (end - begin) * sizeof(int));
+         mDecoded += end - begin;
+      }
+
+      return mFrameStart >= mStart + mLen
+         ? FLAC__STREAM_DECODER_WRITE_STATUS_ABORT
+         : FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
+   }
+
+   void error_callback(::FLAC__StreamDecoderErrorStatus) override
+   {
+   }
+
+private:
+   const FLAC__byte *mBytes;
+   size_t mNBytes;
+   size_t mPosition { 0 };
+
+   int *mBuffer;
+   size_t mStart, mLen;
+   size_t mFrameStart { 0 };
+};
+
+}
+
+/// Constructs a FLACBlockFile from sample data and writes it to disk.
+///
+/// @param baseFileName The filename to use, but without an extension.
+///                     This constructor will add the .auc extension.
+FLACBlockFile::FLACBlockFile(wxFileNameWrapper &&baseFileName,
+                             samplePtr sampleData, size_t sampleLen,
+                             sampleFormat format):
+   BlockFile {
+      (baseFileName.SetExt(wxT("auc")), std::move(baseFileName)),
+      sampleLen
+   }
+{
+   unsigned bitsPerSample;
+   if (!CanCompress(sampleData, sampleLen, format, bitsPerSample) ||
+       !WriteFLACBlockFile(sampleData, sampleLen, format, bitsPerSample))
+      throw FileException{
+         FileException::Cause::Write, GetFileName().name };
+}
+
+/// Construct a FLACBlockFile memory structure that will point to an
+/// existing block file.  This file must exist and be a valid block file.
+FLACBlockFile::FLACBlockFile(wxFileNameWrapper &&existingFile, size_t len,
+                             float min, float max, float rms):
+   BlockFile{ std::move(existingFile), len }
+{
+   mMin = min;
+   mMax = max;
+   mRMS = rms;
+}
+
+FLACBlockFile::~FLACBlockFile()
+{
+}
+
+// static
+bool FLACBlockFile::CanCompress(samplePtr sampleData, size_t sampleLen,
+                                sampleFormat format, unsigned &bitsPerSample)
+{
+   switch (format) {
+   case int16Sample:
+      bitsPerSample = 16;
+      return true;
+   case int24Sample:
+      bitsPerSample = 24;
+      return true;
+   case floatSample:
+      break;
+   default:
+      return false;
+   }
+
+   // Find the fewest bits that reproduce every float sample exactly
+   const float *fbuffer = (const float *)sampleData;
+   bitsPerSample = 16;
+   for (size_t i = 0; i < sampleLen; ++i) {
+      const auto value = fbuffer[i];
+      for (;;) {
+         const float scale = float(1 << (bitsPerSample - 1));
+         const auto scaled = value * scale;
+         if (scaled >= -scale && scaled < scale && scaled == floorf(scaled))
+            break;
+         if (bitsPerSample == 24)
+            return false;
+         bitsPerSample = 24;
+      }
+   }
+   return true;
+}
+
+bool FLACBlockFile::WriteFLACBlockFile(samplePtr sampleData, size_t sampleLen,
+                                       sampleFormat format,
+                                       unsigned bitsPerSample)
+{
+   // Convert to the integers the encoder wants
+   ArrayOf<FLAC__int32> ints{ sampleLen };
+   switch (format) {
+   case int16Sample: {
+      const short *src = (const short *)sampleData;
+      for (size_t i = 0; i < sampleLen; ++i)
+         ints[i] = src[i];
+      break;
+   }
+   case int24Sample:
+      memcpy(ints.get(), sampleData, sampleLen * sizeof(FLAC__int32));
+      break;
+   default:
+   case floatSample: {
+      const float *src = (const float *)sampleData;
+      const float scale = float(1 << (bitsPerSample - 1));
+      for (size_t i = 0; i < sampleLen; ++i)
+         ints[i] = (FLAC__int32)(src[i] * scale);
+      break;
+   }
+   }
+
+   FLACBlockEncoder encoder;
+   encoder.set_channels(1);
+   encoder.set_bits_per_sample(bitsPerSample);
+   // Doesn't matter, but must be valid
+   encoder.set_sample_rate(44100);
+   encoder.set_compression_level(5);
+   encoder.set_total_samples_estimate(sampleLen);
+   if (encoder.init() != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+      return false;
+
+   const FLAC__int32 *channels[1] = { ints.get() };
+   if (!encoder.process(channels, sampleLen) || !encoder.finish())
+      return false;
+
+   ArrayOf<char> cleanup;
+   void *summaryData = CalcSummary(sampleData, sampleLen, format, cleanup);
+
+   flacBlockHeader header;
+   header.magic = kFLACBlockMagic;
+   header.format = format;
+   header.bitsPerSample = bitsPerSample;
+   header.dataOffset = sizeof(header) + mSummaryInfo.totalSummaryBytes;
+   header.dataSize = encoder.mBytes.size();
+
+   wxFFile file(mFileName.GetFullPath(), wxT("wb"));
+   if (!file.IsOpened())
+      return false;
+
+   if (file.Write(&header, sizeof(header)) != sizeof(header) ||
+       file.Write(summaryData, mSummaryInfo.totalSummaryBytes) !=
+          mSummaryInfo.totalSummaryBytes ||
+       file.Write(encoder.mBytes.data(), encoder.mBytes.size()) !=
+          encoder.mBytes.size()) {
+      wxLogDebug(wxT("Failed to write compressed block file %s"),
+                 mFileName.GetFullPath());
+      return false;
+   }
+
+   mSpaceUsage = header.dataOffset + header.dataSize;
+   return true;
+}
+
+/// Read the summary section of the disk file.
+///
+/// @param *data The buffer to write the data to.  It must be at least
+/// mSummaryinfo.totalSummaryBytes long.
+bool FLACBlockFile::ReadSummary(ArrayOf<char> &data)
+{
+   data.reinit( mSummaryInfo.totalSummaryBytes );
+
+   wxFFile file(mFileName.GetFullPath(), wxT("rb"));
+
+   {
+      Maybe<wxLogNull> silence{};
+      if (mSilentLog)
+         silence.create();
+      if (!file.IsOpened()){
+         memset(data.get(), 0, mSummaryInfo.totalSummaryBytes);
+         mSilentLog = TRUE;
+         return false;
+      }
+   }
+   mSilentLog = FALSE;
+
+   // The offset is just past the header
+   if( !file.Seek(sizeof(flacBlockHeader)) ||
+       file.Read(data.get(), mSummaryInfo.totalSummaryBytes) !=
+          mSummaryInfo.totalSummaryBytes ) {
+      memset(data.get(), 0, mSummaryInfo.totalSummaryBytes);
+      return false;
+   }
+
+   FixSummary(data.get());
+
+   return true;
+}
+
+size_t FLACBlockFile::Decode(int *buffer, flacBlockHeader &header,
+                             size_t start, size_t len) const
+{
+   wxFFile file(mFileName.GetFullPath(), wxT("rb"));
+   {
+      Maybe<wxLogNull> silence{};
+      if (mSilentLog)
+         silence.create();
+      if (!file.IsOpened()) {
+         mSilentLog = TRUE;
+         return 0;
+      }
+   }
+   mSilentLog = FALSE;
+
+   if (file.Read(&header, sizeof(header)) != sizeof(header) ||
+       header.magic != kFLACBlockMagic ||
+       !file.Seek(header.dataOffset))
+      return 0;
+
+   ArrayOf<FLAC__byte> bytes{ header.dataSize };
+   if (file.Read(bytes.get(), header.dataSize) != header.dataSize)
+      return 0;
+   file.Close();
+
+   FLACBlockDecoder decoder{
+      bytes.get(), header.dataSize, buffer, start, len };
+   if (decoder.init() != FLAC__STREAM_DECODER_INIT_STATUS_OK)
+      return 0;
+   // Stops early, by design, once the request is satisfied
+   decoder.process_until_end_of_stream();
+   decoder.finish();
+
+   return decoder.mDecoded;
+}
+
+/// Decode the data portion of the block file.  Convert it
+/// to the given format if it is not already.
+///
+/// @param data   The buffer where the data will be stored
+/// @param format The format the data will be stored in
+/// @param start  The offset in this block file
+/// @param len    The number of samples to read
+size_t FLACBlockFile::ReadData(samplePtr data, sampleFormat format,
+                               size_t start, size_t len, bool mayThrow) const
+{
+   start = std::min(start, mLen);
+   const auto toRead = std::min(len, mLen - start);
+
+   ArrayOf<int> ints{ toRead };
+   flacBlockHeader header;
+   const auto framesRead = Decode(ints.get(), header, start, toRead);
+
+   if (framesRead > 0) {
+      switch ((sampleFormat)header.format) {
+      case int16Sample: {
+         SampleBuffer shorts(framesRead, int16Sample);
+         short *dst = (short *)shorts.ptr();
+         for (size_t i = 0; i < framesRead; ++i)
+            dst[i] = ints[i];
+         CopySamples(shorts.ptr(), int16Sample, data, format, framesRead);
+         break;
+      }
+      case int24Sample:
+         CopySamples((samplePtr)ints.get(), int24Sample,
+                     data, format, framesRead);
+         break;
+      default:
+      case floatSample: {
+         // Exact, because CanCompress checked that the samples were
+         // representable in bitsPerSample
+         SampleBuffer floats(framesRead, floatSample);
+         float *dst = (float *)floats.ptr();
+         const float scale = 1.0f / (1 << (header.bitsPerSample - 1));
+         for (size_t i = 0; i < framesRead; ++i)
+            dst[i] = ints[i] * scale;
+         CopySamples(floats.ptr(), floatSample, data, format, framesRead);
+         break;
+      }
+      }
+   }
+
+   if ( framesRead < len ) {
+      if (mayThrow)
+         throw FileException{ FileException::Cause::Read, mFileName.Get() };
+      ClearSamples(data, format, framesRead, len - framesRead);
+   }
+
+   return framesRead;
+}
+
+/// Create a copy of this BlockFile, but using a different disk file.
+///
+/// @param newFileName The name of the NEW file to use.
+BlockFilePtr FLACBlockFile::Copy(wxFileNameWrapper &&newFileName)
+{
+   auto newBlockFile = make_blockfile<FLACBlockFile>
+      (std::move(newFileName), mLen, mMin, mMax, mRMS);
+
+   return newBlockFile;
+}
+
+auto FLACBlockFile::GetSpaceUsage() const -> DiskByteCount
+{
+   if (mSpaceUsage == 0) {
+      wxFFile file(mFileName.GetFullPath(), wxT("rb"));
+      if (file.IsOpened())
+         mSpaceUsage = file.Length();
+   }
+   return mSpaceUsage;
+}
+
+void FLACBlockFile::Recover()
+{
+   // Rewrite as silence, in a NEW file, in case the old one is shared
+   if (wxFileExists(mFileName.GetFullPath()))
+      wxRemoveFile(mFileName.GetFullPath());
+   SampleBuffer silence(mLen, int16Sample);
+   ClearSamples(silence.ptr(), int16Sample, 0, mLen);
+   WriteFLACBlockFile(silence.ptr(), mLen, int16Sample, 16);
+}
+
+#endif // USE_LIBFLAC
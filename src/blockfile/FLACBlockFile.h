@@ -0,0 +1,91 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   FLACBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_FLAC_BLOCKFILE__
+#define __AUDACITY_FLAC_BLOCKFILE__
+
+#include "../Audacity.h"
+
+#ifdef USE_LIBFLAC
+
+#include <wx/string.h>
+#include <wx/filename.h>
+
+#include "../BlockFile.h"
+#include "../DirManager.h"
+
+// The header of a .auc file.  Always native-endian; block files never
+// leave the machine that wrote them.
+typedef struct {
+   wxUint32 magic;         // 'AuFl'
+   wxUint32 format;        // sampleFormat of the data as given
+   wxUint32 bitsPerSample; // of the encoded stream, 16 or 24
+   wxUint32 dataOffset;    // byte offset of the FLAC stream
+   wxUint32 dataSize;      // length of the FLAC stream, in bytes
+} flacBlockHeader;
+
+/// A BlockFile storing its samples losslessly compressed with libFLAC,
+/// followed by the usual summary data
+
+/// Integer samples can always be stored.  Float samples can be stored
+/// only if every one is exactly representable with 24 bits or fewer, as
+/// is the case for audio imported from integer files; CanCompress() tells.
+/// Each read decodes independently, so reads of different blocks may
+/// proceed in parallel on several threads.
+class FLACBlockFile final : public BlockFile {
+ public:
+
+   // Constructor / Destructor
+
+   /// Compress the sample data and write it with its summary to disk.
+   /// The data must have passed CanCompress().
+   FLACBlockFile(wxFileNameWrapper &&baseFileName,
+                 samplePtr sampleData, size_t sampleLen,
+                 sampleFormat format);
+   /// Create the memory structure to refer to the given block file
+   FLACBlockFile(wxFileNameWrapper &&existingFile, size_t len,
+                 float min, float max, float rms);
+
+   virtual ~FLACBlockFile();
+
+   /// Whether the samples can be stored without loss; if so, also
+   /// returns the bits per sample needed
+   static bool CanCompress(samplePtr sampleData, size_t sampleLen,
+                           sampleFormat format, unsigned &bitsPerSample);
+
+   // Reading
+
+   /// Read the summary section of the disk file
+   bool ReadSummary(ArrayOf<char> &data) override;
+   /// Decode the data section of the disk file
+   size_t ReadData(samplePtr data, sampleFormat format,
+                        size_t start, size_t len, bool mayThrow) const override;
+
+   /// Create a NEW block file identical to this one
+   BlockFilePtr Copy(wxFileNameWrapper &&newFileName) override;
+
+   DiskByteCount GetSpaceUsage() const override;
+   void Recover() override;
+
+ private:
+   bool WriteFLACBlockFile(samplePtr sampleData, size_t sampleLen,
+                           sampleFormat format, unsigned bitsPerSample);
+
+   // Decode len samples from start, as the integers given to the
+   // encoder; returns how many were decoded
+   size_t Decode(int *buffer, flacBlockHeader &header,
+                 size_t start, size_t len) const;
+
+   mutable DiskByteCount mSpaceUsage { 0 }; // may be found lazily
+};
+
+#endif // USE_LIBFLAC
+
+#endif
@@ -37,7 +37,7 @@ LegacyAliasBlockFile::LegacyAliasBlockFile(wxFileNameWrapper &&fileName,
    else
       format = floatSample;
 
-   ComputeLegacySummaryInfo(mFileName,
+   ComputeLegacySummaryInfo(mFileName.Get(),
                             summaryLen, format,
                             &mSummaryInfo, noRMS, FALSE,
                             &mMin, &mMax, &mRMS);
@@ -54,7 +54,7 @@ LegacyAliasBlockFile::~LegacyAliasBlockFile()
 BlockFilePtr LegacyAliasBlockFile::Copy(wxFileNameWrapper &&newFileName)
 {
    auto newBlockFile = make_blockfile<LegacyAliasBlockFile>
-      (std::move(newFileName), wxFileNameWrapper{ mAliasedFileName },
+      (std::move(newFileName), wxFileNameWrapper{ *mAliasedFileName },
        mAliasStart, mLen, mAliasChannel,
        mSummaryInfo.totalSummaryBytes, mSummaryInfo.fields < 3);
 
@@ -140,7 +140,7 @@ LegacyBlockFile::LegacyBlockFile(wxFileNameWrapper &&existingFile,
    else
       summaryFormat = floatSample;
 
-   ComputeLegacySummaryInfo(mFileName,
+   ComputeLegacySummaryInfo(mFileName.Get(),
                             summaryLen, summaryFormat,
                             &mSummaryInfo, noRMS, FALSE,
                             &mMin, &mMax, &mRMS);
@@ -198,7 +198,7 @@ size_t LegacyBlockFile::ReadData(samplePtr data, sampleFormat format,
 {
    sf_count_t origin = (mSummaryInfo.totalSummaryBytes / SAMPLE_SIZE(mFormat));
    return CommonReadData( mayThrow,
-      mFileName, mSilentLog, nullptr, origin, 0, data, format, start, len,
+      mFileName.Get(), mSilentLog, nullptr, origin, 0, data, format, start, len,
       &mFormat, mLen
    );
 }
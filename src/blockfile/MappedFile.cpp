@@ -0,0 +1,167 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   MappedFile.cpp
+
+*******************************************************************//**
+
+\class MappedFile
+\brief A read-only memory mapping of a whole file.
+
+*//****************************************************************//**
+
+\class MappedFileTable
+\brief A bounded, thread-safe, least-recently-used table of MappedFile
+objects, keyed by full path.
+
+The DirManager owns one such table for all SimpleBlockFile reads, so
+that hot blocks are served from the page cache without an open, seek,
+read and close for each call to ReadData.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "MappedFile.h"
+
+#include "../Internat.h"
+
+#if defined(__WXMSW__)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#endif
+
+std::shared_ptr<MappedFile> MappedFile::Open(const wxString &fullPath)
+{
+   std::shared_ptr<MappedFile> result{ safenew MappedFile };
+
+#if defined(__WXMSW__)
+   HANDLE file = ::CreateFileW(fullPath.wc_str(), GENERIC_READ,
+      FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING,
+      FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE)
+      return {};
+   result->mFile = file;
+
+   LARGE_INTEGER size;
+   if (!::GetFileSizeEx(file, &size) || size.QuadPart <= 0)
+      return {};
+   result->mSize = size.QuadPart;
+
+   HANDLE mapping =
+      ::CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (!mapping)
+      return {};
+   result->mMapping = mapping;
+
+   result->mData = static_cast<const char*>(
+      ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+   if (!result->mData)
+      return {};
+#else
+   int fd = open(OSFILENAME(fullPath), O_RDONLY);
+   if (fd < 0)
+      return {};
+   auto cleanup = finally( [&] { close(fd); } );
+
+   struct stat st;
+   if (fstat(fd, &st) != 0 || st.st_size <= 0)
+      return {};
+
+   // The mapping survives closing of the descriptor
+   void *data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+   if (data == MAP_FAILED)
+      return {};
+   result->mData = static_cast<const char*>(data);
+   result->mSize = st.st_size;
+#endif
+
+   return result;
+}
+
+MappedFile::~MappedFile()
+{
+#if defined(__WXMSW__)
+   if (mData)
+      ::UnmapViewOfFile(mData);
+   if (mMapping)
+      ::CloseHandle(mMapping);
+   if (mFile)
+      ::CloseHandle(mFile);
+#else
+   if (mData)
+      munmap(const_cast<char*>(mData), mSize);
+#endif
+}
+
+void MappedFileTable::SetCapacity(size_t capacity)
+{
+   ODLocker locker{ &mLock };
+   mCapacity = capacity;
+   TrimToCapacity();
+}
+
+auto MappedFileTable::Acquire(const wxString &fullPath) -> Ptr
+{
+   ODLocker locker{ &mLock };
+   if (mCapacity == 0)
+      return {};
+
+   auto found = mIndex.find(fullPath);
+   if (found != mIndex.end()) {
+      // Move to the front
+      mRecent.splice(mRecent.begin(), mRecent, found->second);
+      return found->second->second;
+   }
+
+   // Don't hold the lock while the system call maps the file
+   locker.reset();
+   Ptr ptr{ MappedFile::Open(fullPath) };
+   if (!ptr)
+      return {};
+
+   locker.reset(&mLock);
+   found = mIndex.find(fullPath);
+   if (found != mIndex.end())
+      // Another thread was quicker; use its mapping and let ours go
+      return found->second->second;
+
+   mRecent.emplace_front(fullPath, ptr);
+   mIndex[fullPath] = mRecent.begin();
+   TrimToCapacity();
+
+   return ptr;
+}
+
+void MappedFileTable::Release(const wxString &fullPath)
+{
+   ODLocker locker{ &mLock };
+   auto found = mIndex.find(fullPath);
+   if (found != mIndex.end()) {
+      mRecent.erase(found->second);
+      mIndex.erase(found);
+   }
+}
+
+void MappedFileTable::Clear()
+{
+   ODLocker locker{ &mLock };
+   mIndex.clear();
+   mRecent.clear();
+}
+
+void MappedFileTable::TrimToCapacity()
+{
+   // Lock is already held
+   while (mRecent.size() > mCapacity) {
+      mIndex.erase(mRecent.back().first);
+      mRecent.pop_back();
+   }
+}
@@ -0,0 +1,86 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   MappedFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_MAPPED_FILE__
+#define __AUDACITY_MAPPED_FILE__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <list>
+#include <unordered_map>
+#include <wx/string.h>
+
+#include "../ondemand/ODTaskThread.h"
+
+/// A read-only view of an entire file mapped into the address space.
+class MappedFile final {
+ public:
+   /// Map the whole file; returns null if it can't be opened or mapped
+   static std::shared_ptr<MappedFile> Open(const wxString &fullPath);
+
+   ~MappedFile();
+
+   MappedFile(const MappedFile&) PROHIBITED;
+   MappedFile &operator= (const MappedFile&) PROHIBITED;
+
+   const char *GetData() const { return mData; }
+   size_t GetSize() const { return mSize; }
+
+ private:
+   MappedFile() {}
+
+   const char *mData {};
+   size_t mSize {};
+#ifdef __WXMSW__
+   void *mFile {};
+   void *mMapping {};
+#endif
+};
+
+/// A bounded table of open file mappings, evicting the least recently
+/// used mapping when it is full.  Readers hold a shared_ptr, so an
+/// eviction on another thread never unmaps memory that is still in use.
+class MappedFileTable final {
+ public:
+   using Ptr = std::shared_ptr<const MappedFile>;
+
+   MappedFileTable() {}
+
+   MappedFileTable(const MappedFileTable&) PROHIBITED;
+   MappedFileTable &operator= (const MappedFileTable&) PROHIBITED;
+
+   /// Zero capacity disables mapping; shrinking evicts at once
+   void SetCapacity(size_t capacity);
+   size_t GetCapacity() const { return mCapacity; }
+   bool IsEnabled() const { return mCapacity > 0; }
+
+   /// Find or make the mapping for a file; null when disabled or on failure
+   Ptr Acquire(const wxString &fullPath);
+
+   /// Forget the mapping of a file that is about to be rewritten,
+   /// renamed or deleted
+   void Release(const wxString &fullPath);
+
+   void Clear();
+
+ private:
+   void TrimToCapacity();
+
+   using Entry = std::pair<wxString, Ptr>;
+   using List = std::list<Entry>;
+
+   ODLock mLock;
+   size_t mCapacity { 0 };
+   List mRecent; // most recently used at the front
+   std::unordered_map<wxString, List::iterator> mIndex;
+};
+
+#endif
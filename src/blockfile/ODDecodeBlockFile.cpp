@@ -269,7 +269,7 @@ int ODDecodeBlockFile::WriteODDecodeBlockFile()
 void ODDecodeBlockFile::SetFileName(wxFileNameWrapper &&name)
 {
    mFileNameMutex.Lock();
-   mFileName=std::move(name);
+   mFileName = BlockFileName{ name };
 /* mchinen oct 9 2009 don't think we need the char* but leaving it in for now just as a reminder that we might
    if wxFileName isn't threadsafe.
    mFileNameChar.reinit(strlen(mFileName.GetFullPath().mb_str(wxConvUTF8))+1);
@@ -280,7 +280,7 @@ void ODDecodeBlockFile::SetFileName(wxFileNameWrapper &&name)
 ///sets the file name the summary info will be saved in.  threadsafe.
 auto ODDecodeBlockFile::GetFileName() const -> GetFileNameResult
 {
-   return { mFileName, ODLocker{ &mFileNameMutex } };
+   return { mFileName.Get(), ODLocker{ &mFileNameMutex } };
 }
 
 /// A thread-safe version of CalcSummary.  BlockFile::CalcSummary
@@ -14,12 +14,18 @@
 \brief ODPCMAliasBlockFile is a special type of PCMAliasBlockFile that does not necessarily have summary data available
 The summary is eventually computed and written to a file in a background thread.
 
+The block of a copy import is also copied into a SimpleBlockFile in the
+background, by ODCopyInTask, and then delegates its reads to that.
+
 *//*******************************************************************/
 
 #include "../Audacity.h"
 #include "ODPCMAliasBlockFile.h"
 
 #include <float.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 
 #include <wx/file.h>
 #include <wx/utils.h>
@@ -29,7 +35,9 @@ The summary is eventually computed and written to a file in a background thread.
 #include <sndfile.h>
 
 #include "../AudacityApp.h"
+#include "BlockIOStats.h"
 #include "PCMAliasBlockFile.h"
+#include "SummaryCache.h"
 #include "../FileFormats.h"
 #include "../Internat.h"
 
@@ -81,25 +89,25 @@ ODPCMAliasBlockFile::~ODPCMAliasBlockFile()
 //Check to see if we have the file for these calls.
 auto ODPCMAliasBlockFile::GetSpaceUsage() const -> DiskByteCount
 {
+   DiskByteCount ret = 0;
+   if(mCopiedIn)
+      ret += mCopy->GetSpaceUsage();
    if(IsSummaryAvailable())
    {
-      DiskByteCount ret;
       mFileNameMutex.Lock();
       wxFFile summaryFile(mFileName.GetFullPath());
-      ret= summaryFile.Length();
+      ret += summaryFile.Length();
       mFileNameMutex.Unlock();
-      return ret;
-   }
-   else
-   {
-      return 0;
    }
+   return ret;
 }
 
 /// Locks the blockfile only if it has a file that exists.  This needs to be done
 /// so that the unsaved ODPCMAliasBlockfiles are deleted upon exit
 void ODPCMAliasBlockFile::Lock()
 {
+   if(mCopiedIn)
+      mCopy->Lock();
    if(IsSummaryAvailable()&&mHasBeenSaved)
       PCMAliasBlockFile::Lock();
 }
@@ -108,6 +116,8 @@ void ODPCMAliasBlockFile::Lock()
 // It calls this so we can check if it has been saved before.
 void ODPCMAliasBlockFile::CloseLock()
 {
+   if(mCopiedIn)
+      mCopy->CloseLock();
    if(mHasBeenSaved)
       PCMAliasBlockFile::Lock();
 }
@@ -117,6 +127,8 @@ void ODPCMAliasBlockFile::CloseLock()
 /// so that the unsaved ODPCMAliasBlockfiles are deleted upon exit
 void ODPCMAliasBlockFile::Unlock()
 {
+   if(mCopiedIn)
+      mCopy->Unlock();
    if(IsSummaryAvailable() && IsLocked())
       PCMAliasBlockFile::Unlock();
 }
@@ -126,6 +138,8 @@ void ODPCMAliasBlockFile::Unlock()
 auto ODPCMAliasBlockFile::GetMinMaxRMS(
    size_t start, size_t len, bool mayThrow) const -> MinMaxRMS
 {
+   if(mCopiedIn)
+      return mCopy->GetMinMaxRMS(start, len, mayThrow);
    if(IsSummaryAvailable())
    {
       return PCMAliasBlockFile::GetMinMaxRMS(start, len, mayThrow);
@@ -148,6 +162,8 @@ auto ODPCMAliasBlockFile::GetMinMaxRMS(
 /// Gets extreme values for the entire block
 auto ODPCMAliasBlockFile::GetMinMaxRMS(bool mayThrow) const -> MinMaxRMS
 {
+  if(mCopiedIn)
+     return mCopy->GetMinMaxRMS(mayThrow);
   if(IsSummaryAvailable())
    {
       return PCMAliasBlockFile::GetMinMaxRMS(mayThrow);
@@ -171,6 +187,8 @@ auto ODPCMAliasBlockFile::GetMinMaxRMS(bool mayThrow) const -> MinMaxRMS
 /// Fill with zeroes and return false if data are unavailable for any reason.
 bool ODPCMAliasBlockFile::Read256(float *buffer, size_t start, size_t len)
 {
+   if(mCopiedIn)
+      return mCopy->Read256(buffer, start, len);
    if(IsSummaryAvailable())
    {
       return PCMAliasBlockFile::Read256(buffer,start,len);
@@ -187,6 +205,8 @@ bool ODPCMAliasBlockFile::Read256(float *buffer, size_t start, size_t len)
 /// Fill with zeroes and return false if data are unavailable for any reason.
 bool ODPCMAliasBlockFile::Read64K(float *buffer, size_t start, size_t len)
 {
+   if(mCopiedIn)
+      return mCopy->Read64K(buffer, start, len);
    if(IsSummaryAvailable())
    {
       return PCMAliasBlockFile::Read64K(buffer,start,len);
@@ -209,6 +229,18 @@ BlockFilePtr ODPCMAliasBlockFile::Copy(wxFileNameWrapper &&newFileName)
 
    //mAliasedFile can change so we lock readdatamutex, which is responsible for it.
    auto locker = LockForRead();
+   //A copied in block shares its copy, which is immutable, so the NEW one
+   //is self-contained too
+   if(mCopiedIn)
+   {
+      auto newODFile = make_blockfile<ODPCMAliasBlockFile>
+         (std::move(newFileName), wxFileNameWrapper{*mAliasedFileName},
+          mAliasStart, mLen, mAliasChannel, mMin, mMax, mRMS,
+          IsSummaryAvailable());
+      newODFile->mCopy = mCopy;
+      newODFile->mCopiedIn = true;
+      return newODFile;
+   }
    //If the file has been written AND it has been saved, we create a PCM alias blockfile because for
    //all intents and purposes, it is the same.
    //However, if it hasn't been saved yet, we shouldn't create one because the default behavior of the
@@ -216,7 +248,7 @@ BlockFilePtr ODPCMAliasBlockFile::Copy(wxFileNameWrapper &&newFileName)
    if(IsSummaryAvailable() && mHasBeenSaved)
    {
       newBlockFile  = make_blockfile<PCMAliasBlockFile>
-         (std::move(newFileName), wxFileNameWrapper{mAliasedFileName},
+         (std::move(newFileName), wxFileNameWrapper{*mAliasedFileName},
           mAliasStart, mLen, mAliasChannel, mMin, mMax, mRMS);
 
    }
@@ -224,7 +256,7 @@ BlockFilePtr ODPCMAliasBlockFile::Copy(wxFileNameWrapper &&newFileName)
    {
       //Summary File might exist in this case, but it might not.
       newBlockFile  = make_blockfile<ODPCMAliasBlockFile>
-         (std::move(newFileName), wxFileNameWrapper{mAliasedFileName},
+         (std::move(newFileName), wxFileNameWrapper{*mAliasedFileName},
           mAliasStart, mLen, mAliasChannel, mMin, mMax, mRMS,
           IsSummaryAvailable());
       //The client code will need to schedule this blockfile for OD summarizing if it is going to a NEW track.
@@ -258,18 +290,207 @@ void ODPCMAliasBlockFile::DoWriteSummary()
       WriteSummary();
 }
 
+void ODPCMAliasBlockFile::DoCopyIn(DirManager &dirManager, sampleFormat format)
+{
+   if(mCopiedIn)
+      return;
+
+   // Read and write before the switch, so that a failure leaves the alias
+   // as it was
+   SampleBuffer sampleData(mLen, format);
+   this->ReadData(sampleData.ptr(), format, 0, mLen, true);
+   auto copy = dirManager.NewSimpleBlockFile(sampleData.ptr(), mLen, format);
+   // Saved with the project, as this block is
+   if(IsLocked())
+      copy->Lock();
+
+   // Reads hold this lock, so none sees half of the switch
+   auto locker = LockForRead();
+   if(mCopiedIn)
+      // Another thread was first
+      return;
+   mCopy = std::move(copy);
+   mCopiedIn = true;
+}
+
+wxString ODPCMAliasBlockFile::GetAliasedPath() const
+{
+   auto locker = LockForRead();
+   return GetAliasedFileName().GetFullPath();
+}
+
+/// A summary file is whole when it has the length and header tag that
+/// WriteSummary gives it; one that a crash cut short is written again.
+/// Without one, a summary of the same samples that any project computed
+/// before is taken from the SummaryCache, and written as the file.
+/// mMin, mMax and mRMS come from the 64K and 256 summaries, as
+/// CalcSummaryFromBuffer makes them.  Uses fopen for the thread safety,
+/// as WriteSummary does.
+bool ODPCMAliasBlockFile::ReadExistingSummary()
+{
+   const auto aliasedPath = GetAliasedPath();
+   ODLocker locker { &mWriteSummaryMutex };
+   if(IsSummaryAvailable())
+      return true;
+   if(mLen == 0)
+      return false;
+
+   const auto totalBytes = mSummaryInfo.totalSummaryBytes;
+   ArrayOf<char> data{ totalBytes + 1 };
+   size_t read = 0;
+   {
+      ODLocker nameLocker { &mFileNameMutex };
+      wxString sFullPath = mFileName.GetFullPath();
+      FILE *summaryFile = fopen(sFullPath.mb_str(wxConvFile), "rb");
+      if (summaryFile) {
+         //read one byte more, to reject longer files
+         read = fread(data.get(), 1, totalBytes + 1, summaryFile);
+         fclose(summaryFile);
+      }
+   }
+   if (read == totalBytes && memcmp(data.get(), aheaderTag, aheaderTagLen) == 0)
+      FixSummary(data.get());
+   else if (aliasedPath.empty() ||
+            !DirManager::GetSummaryCache().Fetch(aliasedPath, mAliasStart,
+               mLen, mAliasChannel, data.get(), totalBytes) ||
+            memcmp(data.get(), aheaderTag, aheaderTagLen) != 0 ||
+            !WriteSummaryFile(data.get()))
+      return false;
+
+   const float *summary64K = (const float *)(data.get() + mSummaryInfo.offset64K);
+   const float *summary256 = (const float *)(data.get() + mSummaryInfo.offset256);
+
+   float min = summary64K[0], max = summary64K[1];
+   const auto frames64K = (mLen + 65535) / 65536;
+   for (decltype(mLen) i = 1; i < frames64K; i++) {
+      min = std::min(min, summary64K[3 * i]);
+      max = std::max(max, summary64K[3 * i + 1]);
+   }
+
+   //the rms of each 256 summary is over 256 samples, but for the last
+   double totalSquares = 0.0;
+   const auto frames256 = (mLen + 255) / 256;
+   for (decltype(mLen) i = 0; i < frames256; i++) {
+      const double rms = summary256[3 * i + 2];
+      totalSquares += rms * rms * std::min<size_t>(256, mLen - i * 256);
+   }
+
+   mMin = min;
+   mMax = max;
+   mRMS = sqrt(totalSquares / mLen);
+
+   mSummaryAvailableMutex.Lock();
+   mSummaryAvailable=true;
+   mSummaryAvailableMutex.Unlock();
+   return true;
+}
+
+//frames of the aliased file read at once by DoWriteSummaries
+static const size_t kSummaryReadFrames = 65536;
+
+bool ODPCMAliasBlockFile::DoWriteSummaries
+   (const std::vector< std::shared_ptr<ODPCMAliasBlockFile> > &blocks)
+{
+   if (blocks.empty())
+      return true;
+
+   sampleCount spanStart, spanEnd;
+   std::vector<Floats> samples(blocks.size());
+   {
+      //EnsureSafeFilename() takes the read locks of all the blocks of an
+      //aliased file before it renames it, so holding one of them is
+      //enough, and taking more could deadlock with it.
+      auto locker = blocks[0]->LockForRead();
+      const auto &fileName = *blocks[0]->mAliasedFileName;
+      if (!fileName.IsOk())
+         return false;
+      spanStart = spanEnd = blocks[0]->mAliasStart;
+      for (const auto &block : blocks) {
+         // Aliased file names are interned, so equal names are one object
+         if (block->mAliasedFileName != blocks[0]->mAliasedFileName ||
+             block->mAliasStart > spanEnd)
+            return false;
+         spanEnd = std::max(spanEnd, block->mAliasStart + block->mLen);
+      }
+
+      SF_INFO info;
+      memset(&info, 0, sizeof(info));
+      wxFile f;   // will be closed when it goes out of scope
+      SFFile sf;
+      const auto sndfileStart = std::chrono::steady_clock::now();
+      auto sndfileTime = finally([&]{
+         BlockIOStats::Add(BlockIOStats::SndfileNanoseconds,
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now() - sndfileStart).count());
+      });
+      {
+         //errors are reported when the blocks are read one at a time
+         wxLogNull silence;
+         const auto fullPath = fileName.GetFullPath();
+         if (wxFile::Exists(fullPath) && f.Open(fullPath)) {
+            BlockIOStats::Add(BlockIOStats::FilesOpened);
+            sf.reset(SFCall<SNDFILE*>(sf_open_fd, f.fd(), SFM_READ, &info, FALSE));
+         }
+      }
+      if (!sf ||
+          SFCall<sf_count_t>(sf_seek, sf.get(), spanStart.as_long_long(), SEEK_SET) < 0)
+         return false;
+
+      const auto channels = (unsigned) info.channels;
+      for (size_t i = 0; i < blocks.size(); i++) {
+         if (blocks[i]->mAliasChannel < 0 ||
+             (unsigned) blocks[i]->mAliasChannel >= channels)
+            return false;
+         samples[i].reinit(blocks[i]->mLen);
+      }
+
+      Floats buffer{ kSummaryReadFrames * channels };
+      for (auto pos = spanStart; pos < spanEnd;) {
+         const auto want = limitSampleBufferSize(kSummaryReadFrames, spanEnd - pos);
+         const auto got = SFCall<sf_count_t>(
+            sf_readf_float, sf.get(), buffer.get(), want);
+         if (got < (sf_count_t) want)
+            return false;
+         BlockIOStats::Add(BlockIOStats::BytesRead,
+                           got * channels * sizeof(float));
+
+         //give each block the part of this read that it covers
+         for (size_t i = 0; i < blocks.size(); i++) {
+            const auto &block = blocks[i];
+            const auto from = std::max(pos, block->mAliasStart);
+            const auto to = std::min(pos + want, block->mAliasStart + block->mLen);
+            if (from >= to)
+               continue;
+            const float *src =
+               buffer.get() + (from - pos).as_size_t() * channels + block->mAliasChannel;
+            float *dst = samples[i].get() + (from - block->mAliasStart).as_size_t();
+            for (auto n = (to - from).as_size_t(); n--; src += channels)
+               *dst++ = *src;
+         }
+         pos += want;
+      }
+   }
+
+   for (size_t i = 0; i < blocks.size(); i++) {
+      ODLocker locker { &blocks[i]->mWriteSummaryMutex };
+      if (!blocks[i]->IsSummaryAvailable())
+         blocks[i]->WriteSummaryFromData(samples[i].get());
+   }
+   return true;
+}
+
 ///sets the file name the summary info will be saved in.  threadsafe.
 void ODPCMAliasBlockFile::SetFileName(wxFileNameWrapper &&name)
 {
    mFileNameMutex.Lock();
-   mFileName = std::move(name);
+   mFileName = BlockFileName{ name };
    mFileNameMutex.Unlock();
 }
 
 ///sets the file name the summary info will be saved in.  threadsafe.
 auto ODPCMAliasBlockFile::GetFileName() const -> GetFileNameResult
 {
-   return { mFileName, ODLocker{ &mFileNameMutex } };
+   return { mFileName.Get(), ODLocker{ &mFileNameMutex } };
 }
 
 /// Write the summary to disk, using the derived ReadData() to get the data
@@ -282,6 +503,30 @@ void ODPCMAliasBlockFile::WriteSummary()
    SampleBuffer sampleData(mLen, floatSample);
    this->ReadData(sampleData.ptr(), floatSample, 0, mLen, true);
 
+   WriteSummaryFromData((const float *)sampleData.ptr());
+}
+
+void ODPCMAliasBlockFile::WriteSummaryFromData(const float *samples)
+{
+   ArrayOf<char> cleanup;
+   void *summaryData = CalcSummary((samplePtr)samples, mLen,
+                                            floatSample, cleanup);
+   if (!WriteSummaryFile(summaryData))
+      throw FileException{
+         FileException::Cause::Read, wxFileName{ GetFileName().name } };
+
+   const auto aliasedPath = GetAliasedPath();
+   if (!aliasedPath.empty())
+      DirManager::GetSummaryCache().Store(aliasedPath, mAliasStart, mLen,
+         mAliasChannel, summaryData, mSummaryInfo.totalSummaryBytes);
+
+   mSummaryAvailableMutex.Lock();
+   mSummaryAvailable=true;
+   mSummaryAvailableMutex.Unlock();
+}
+
+bool ODPCMAliasBlockFile::WriteSummaryFile(const void *summaryData)
+{
    ArrayOf< char > fileNameChar;
    FILE *summaryFile{};
    {
@@ -299,6 +544,8 @@ void ODPCMAliasBlockFile::WriteSummary()
       wxString sFullPath = mFileName.GetFullPath();
       fileNameChar.reinit( strlen(sFullPath.mb_str(wxConvFile)) + 1 );
       strcpy(fileNameChar.get(), sFullPath.mb_str(wxConvFile));
+      // Don't write through a link that another project may share
+      remove(fileNameChar.get());
       summaryFile = fopen(fileNameChar.get(), "wb");
    }
 
@@ -310,14 +557,9 @@ void ODPCMAliasBlockFile::WriteSummary()
       //and wxLog calls are not thread safe.
       wxPrintf("Unable to write summary data to file: %s", fileNameChar.get());
 
-      throw FileException{
-         FileException::Cause::Read, wxFileName{ fileNameChar.get() } };
+      return false;
    }
 
-   ArrayOf<char> cleanup;
-   void *summaryData = CalcSummary(sampleData.ptr(), mLen,
-                                            floatSample, cleanup);
-
    //summaryFile.Write(summaryData, mSummaryInfo.totalSummaryBytes);
    fwrite(summaryData, 1, mSummaryInfo.totalSummaryBytes, summaryFile);
    fclose(summaryFile);
@@ -325,9 +567,7 @@ void ODPCMAliasBlockFile::WriteSummary()
 
     //     wxPrintf("write successful. filename: %s\n", fileNameChar);
 
-   mSummaryAvailableMutex.Lock();
-   mSummaryAvailable=true;
-   mSummaryAvailableMutex.Unlock();
+   return true;
 }
 
 
@@ -398,13 +638,16 @@ size_t ODPCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
 
    auto locker = LockForRead();
 
-   if(!mAliasedFileName.IsOk()){ // intentionally silenced
+   if(mCopy)
+      return mCopy->ReadData(data, format, start, len, mayThrow);
+
+   if(!mAliasedFileName->IsOk()){ // intentionally silenced
       memset(data,0,SAMPLE_SIZE(format)*len);
       return len;
    }
 
    return CommonReadData( mayThrow,
-      mAliasedFileName, mSilentAliasLog, this, mAliasStart, mAliasChannel,
+      *mAliasedFileName, mSilentAliasLog, this, mAliasStart, mAliasChannel,
       data, format, start, len);
 }
 
@@ -416,6 +659,9 @@ size_t ODPCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
 ///              be at least mSummaryInfo.totalSummaryBytes long.
 bool ODPCMAliasBlockFile::ReadSummary(ArrayOf<char> &data)
 {
+   if(mCopiedIn)
+      return mCopy->ReadSummary(data);
+
    data.reinit( mSummaryInfo.totalSummaryBytes );
 
    ODLocker locker{ &mFileNameMutex };
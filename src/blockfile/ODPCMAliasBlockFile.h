@@ -36,6 +36,7 @@ Some of these methods have been overridden only because they used the unsafe wxL
 #ifndef __AUDACITY_ODPCMALIASBLOCKFILE__
 #define __AUDACITY_ODPCMALIASBLOCKFILE__
 
+#include <atomic>
 #include "PCMAliasBlockFile.h"
 #include "../BlockFile.h"
 #include "../ondemand/ODTaskThread.h"
@@ -83,6 +84,34 @@ class ODPCMAliasBlockFile final : public PCMAliasBlockFile
    ///A public interface to WriteSummary
    void DoWriteSummary();
 
+   ///Copies the samples into a NEW block of the project, which from then on
+   ///takes the place of the aliased file for the data and summaries, so
+   ///the block no longer depends on it.  The switch-over is atomic: any read
+   ///is either of the aliased file or of the copy.  Thread safe.
+   void DoCopyIn(DirManager &dirManager, sampleFormat format);
+
+   /// Not an alias any more, once copied in
+   bool IsAlias() const override { return !mCopiedIn; }
+   bool CanCopyIn() const override { return !mCopiedIn; }
+
+   ///Takes up a whole summary file that an earlier session wrote, or else
+   ///the summary of the same part of the aliased file from the
+   ///SummaryCache, so the summary is not computed again.  Returns whether
+   ///the summary is available.
+   bool ReadExistingSummary();
+
+   ///Writes the summaries of blocks of one aliased file, sorted by their
+   ///alias start, that together cover one range of it.  Reads the range
+   ///through one open file with large sequential reads.  Returns false if
+   ///the range can't be read; the blocks whose summaries are not available
+   ///can then write them one at a time.
+   static bool DoWriteSummaries
+      (const std::vector< std::shared_ptr<ODPCMAliasBlockFile> > &blocks);
+
+   ///Where this block's samples lie in the aliased file.
+   sampleCount GetAliasStart() const { return mAliasStart; }
+   int GetAliasChannel() const { return mAliasChannel; }
+
    ///Sets the value that indicates where the first sample in this block corresponds to the global sequence/clip.  Only for display use.
    void SetStart(sampleCount startSample){mStart = startSample;}
 
@@ -137,6 +166,16 @@ protected:
       sampleFormat format, ArrayOf<char> &cleanup) override;
 
   private:
+   ///Computes the summary of the samples of this block and writes the file
+   void WriteSummaryFromData(const float *samples);
+   ///Writes the summary file; false if it can't be opened.  Does not throw.
+   bool WriteSummaryFile(const void *summaryData);
+   wxString GetAliasedPath() const;
+
+   ///The copy of the samples, once mCopiedIn.  Set with the read lock held,
+   ///before mCopiedIn, and not changed after.
+   BlockFilePtr mCopy;
+   std::atomic<bool> mCopiedIn{ false };
 
    ODLock mWriteSummaryMutex;
 
@@ -77,13 +77,13 @@ PCMAliasBlockFile::~PCMAliasBlockFile()
 size_t PCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
                                 size_t start, size_t len, bool mayThrow) const
 {
-   if(!mAliasedFileName.IsOk()){ // intentionally silenced
+   if(!mAliasedFileName->IsOk()){ // intentionally silenced
       memset(data, 0, SAMPLE_SIZE(format) * len);
       return len;
    }
 
    return CommonReadData( mayThrow,
-      mAliasedFileName, mSilentAliasLog, this, mAliasStart, mAliasChannel,
+      *mAliasedFileName, mSilentAliasLog, this, mAliasStart, mAliasChannel,
       data, format, start, len);
 }
 
@@ -94,7 +94,7 @@ size_t PCMAliasBlockFile::ReadData(samplePtr data, sampleFormat format,
 BlockFilePtr PCMAliasBlockFile::Copy(wxFileNameWrapper &&newFileName)
 {
    auto newBlockFile = make_blockfile<PCMAliasBlockFile>
-      (std::move(newFileName), wxFileNameWrapper{mAliasedFileName},
+      (std::move(newFileName), wxFileNameWrapper{*mAliasedFileName},
        mAliasStart, mLen, mAliasChannel, mMin, mMax, mRMS);
 
    return newBlockFile;
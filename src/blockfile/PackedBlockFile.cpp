@@ -0,0 +1,182 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   PackedBlockFile.cpp
+
+*******************************************************************//**
+
+\class PackedBlockFile
+\brief A BlockFile stored as one extent of a BlockPack.
+
+The extent holds the summary data exactly as SimpleBlockFile writes it,
+followed by the samples in the format given, native-endian.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "PackedBlockFile.h"
+
+#include "../FileException.h"
+
+/// Constructs a PackedBlockFile, writing its data into the pack.
+///
+/// @param baseFileName The unique name of the block, without extension.
+///                     This constructor will add the .pkb extension,
+///                     but creates no such file.
+PackedBlockFile::PackedBlockFile(wxFileNameWrapper &&baseFileName,
+                                 const std::shared_ptr<BlockPack> &pack,
+                                 samplePtr sampleData, size_t sampleLen,
+                                 sampleFormat format):
+   BlockFile {
+      (baseFileName.SetExt(wxT("pkb")), std::move(baseFileName)),
+      sampleLen
+   },
+   mPack{ pack },
+   mFormat{ format }
+{
+   ArrayOf<char> cleanup;
+   void *summaryData = CalcSummary(sampleData, sampleLen, format, cleanup);
+
+   const auto summaryBytes = mSummaryInfo.totalSummaryBytes;
+   const auto sampleBytes = sampleLen * SAMPLE_SIZE(format);
+   ArrayOf<char> bytes{ summaryBytes + sampleBytes };
+   memcpy(bytes.get(), summaryData, summaryBytes);
+   memcpy(bytes.get() + summaryBytes, sampleData, sampleBytes);
+
+   mId = mPack->Add(bytes.get(), summaryBytes + sampleBytes);
+}
+
+PackedBlockFile::PackedBlockFile(wxFileNameWrapper &&fileName,
+                                 const std::shared_ptr<BlockPack> &pack,
+                                 BlockPack::Id id,
+                                 size_t len, sampleFormat format,
+                                 float min, float max, float rms):
+   BlockFile{ std::move(fileName), len },
+   mPack{ pack },
+   mId{ id },
+   mFormat{ format }
+{
+   mMin = min;
+   mMax = max;
+   mRMS = rms;
+}
+
+PackedBlockFile::~PackedBlockFile()
+{
+   // As BlockFile's destructor keeps the files of locked blocks
+   if (!IsLocked())
+      mPack->Remove(mId);
+}
+
+/// Read the summary section of the extent.
+///
+/// @param *data The buffer to write the data to.  It must be at least
+/// mSummaryinfo.totalSummaryBytes long.
+bool PackedBlockFile::ReadSummary(ArrayOf<char> &data)
+{
+   data.reinit( mSummaryInfo.totalSummaryBytes );
+
+   if (!mPack->Read(mId, 0, data.get(), mSummaryInfo.totalSummaryBytes)) {
+      memset(data.get(), 0, mSummaryInfo.totalSummaryBytes);
+      return false;
+   }
+
+   FixSummary(data.get());
+
+   return true;
+}
+
+/// Read the data portion of the extent.  Convert it
+/// to the given format if it is not already.
+///
+/// @param data   The buffer where the data will be stored
+/// @param format The format the data will be stored in
+/// @param start  The offset in this block file
+/// @param len    The number of samples to read
+size_t PackedBlockFile::ReadData(samplePtr data, sampleFormat format,
+                                 size_t start, size_t len, bool mayThrow) const
+{
+   start = std::min(start, mLen);
+   const auto toRead = std::min(len, mLen - start);
+   const auto sampleSize = SAMPLE_SIZE(mFormat);
+
+   size_t framesRead = 0;
+   if (toRead > 0) {
+      const auto offset =
+         mSummaryInfo.totalSummaryBytes + start * sampleSize;
+      if (format == mFormat) {
+         if (mPack->Read(mId, offset, data, toRead * sampleSize))
+            framesRead = toRead;
+      }
+      else {
+         SampleBuffer buffer(toRead, mFormat);
+         if (mPack->Read(mId, offset, buffer.ptr(), toRead * sampleSize)) {
+            CopySamples(buffer.ptr(), mFormat, data, format, toRead);
+            framesRead = toRead;
+         }
+      }
+   }
+
+   if ( framesRead < len ) {
+      if (mayThrow)
+         throw FileException{ FileException::Cause::Read, mPack->GetPath() };
+      ClearSamples(data, format, framesRead, len - framesRead);
+   }
+
+   return framesRead;
+}
+
+/// Create a copy of this BlockFile, with its own extent in the same pack.
+///
+/// @param newFileName The NEW unique name to use.
+BlockFilePtr PackedBlockFile::Copy(wxFileNameWrapper &&newFileName)
+{
+   const auto size = mPack->GetSize(mId);
+   ArrayOf<char> bytes{ size };
+   if (!mPack->Read(mId, 0, bytes.get(), size))
+      throw FileException{ FileException::Cause::Read, mPack->GetPath() };
+   const auto id = mPack->Add(bytes.get(), size);
+
+   auto newBlockFile = make_blockfile<PackedBlockFile>
+      (std::move(newFileName), mPack, id, mLen, mFormat, mMin, mMax, mRMS);
+
+   return newBlockFile;
+}
+
+auto PackedBlockFile::GetSpaceUsage() const -> DiskByteCount
+{
+   return mPack->GetSize(mId);
+}
+
+void PackedBlockFile::Recover()
+{
+   // Overwrite with silence, in place
+   const auto size = mPack->GetSize(mId);
+   ArrayOf<char> zeroes{ size, true };
+   mPack->Write(mId, 0, zeroes.get(), size);
+}
+
+bool PackedBlockFile::IsStored() const
+{
+   return mPack->Contains(mId);
+}
+
+void PackedBlockFile::MoveToPack(const std::shared_ptr<BlockPack> &pack)
+{
+   if (pack == mPack)
+      return;
+
+   const auto size = mPack->GetSize(mId);
+   ArrayOf<char> bytes{ size };
+   if (!mPack->Read(mId, 0, bytes.get(), size))
+      throw FileException{ FileException::Cause::Read, mPack->GetPath() };
+   const auto id = pack->Add(bytes.get(), size);
+
+   if (!IsLocked())
+      mPack->Remove(mId);
+   mPack = pack;
+   mId = id;
+}
@@ -0,0 +1,69 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   PackedBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_PACKED_BLOCKFILE__
+#define __AUDACITY_PACKED_BLOCKFILE__
+
+#include "../BlockFile.h"
+#include "BlockPack.h"
+
+/// A BlockFile whose summary and sample data are one extent of a
+/// BlockPack, rather than a file of its own
+
+/// The file name is still unique, and names the block in DirManager,
+/// but no file of that name exists.
+class PackedBlockFile final : public BlockFile {
+ public:
+
+   // Constructor / Destructor
+
+   /// Write summary and sample data into the pack
+   PackedBlockFile(wxFileNameWrapper &&baseFileName,
+                   const std::shared_ptr<BlockPack> &pack,
+                   samplePtr sampleData, size_t sampleLen,
+                   sampleFormat format);
+   /// Create the memory structure to refer to an extent already in the pack
+   PackedBlockFile(wxFileNameWrapper &&fileName,
+                   const std::shared_ptr<BlockPack> &pack, BlockPack::Id id,
+                   size_t len, sampleFormat format,
+                   float min, float max, float rms);
+
+   virtual ~PackedBlockFile();
+
+   // Reading
+
+   /// Read the summary section of the extent
+   bool ReadSummary(ArrayOf<char> &data) override;
+   /// Read the data section of the extent
+   size_t ReadData(samplePtr data, sampleFormat format,
+                        size_t start, size_t len, bool mayThrow) const override;
+
+   bool IsPacked() const override { return true; }
+
+   /// Create a NEW block file identical to this one, in a NEW extent
+   BlockFilePtr Copy(wxFileNameWrapper &&newFileName) override;
+
+   DiskByteCount GetSpaceUsage() const override;
+   void Recover() override;
+
+   /// Whether the extent is still in a pack file on disk
+   bool IsStored() const;
+
+   /// Move the data into another pack, if not there already.
+   /// Throws FileException on failure.
+   void MoveToPack(const std::shared_ptr<BlockPack> &pack);
+
+ private:
+   std::shared_ptr<BlockPack> mPack;
+   BlockPack::Id mId;
+   sampleFormat mFormat;
+};
+
+#endif
@@ -39,6 +39,28 @@ size_t SilentBlockFile::ReadData(samplePtr data, sampleFormat format,
    return len;
 }
 
+auto SilentBlockFile::GetMinMaxRMS(size_t, size_t, bool) const -> MinMaxRMS
+{
+   return { 0.f, 0.f, 0.f };
+}
+
+auto SilentBlockFile::GetMinMaxRMS(bool) const -> MinMaxRMS
+{
+   return { 0.f, 0.f, 0.f };
+}
+
+bool SilentBlockFile::Read256(float *buffer, size_t, size_t len)
+{
+   ClearSamples((samplePtr)buffer, floatSample, 0, len * 3);
+   return true;
+}
+
+bool SilentBlockFile::Read64K(float *buffer, size_t, size_t len)
+{
+   ClearSamples((samplePtr)buffer, floatSample, 0, len * 3);
+   return true;
+}
+
 /// Create a copy of this BlockFile
 BlockFilePtr SilentBlockFile::Copy(wxFileNameWrapper &&)
 {
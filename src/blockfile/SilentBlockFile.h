@@ -38,6 +38,14 @@ class SilentBlockFile final : public BlockFile {
    size_t ReadData(samplePtr data, sampleFormat format,
                         size_t start, size_t len, bool mayThrow) const override;
 
+   // Summaries of silence are all zero, and need no reading or allocating
+   bool IsSilent() const override { return true; }
+   MinMaxRMS GetMinMaxRMS(size_t start, size_t len,
+                          bool mayThrow = true) const override;
+   MinMaxRMS GetMinMaxRMS(bool mayThrow = true) const override;
+   bool Read256(float *buffer, size_t start, size_t len) override;
+   bool Read64K(float *buffer, size_t start, size_t len) override;
+
    /// Create a NEW block file identical to this one
    BlockFilePtr Copy(wxFileNameWrapper &&newFileName) override;
    DiskByteCount GetSpaceUsage() const override;
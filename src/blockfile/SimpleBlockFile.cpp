@@ -48,6 +48,12 @@ default is to disable caching.
   manual auto recovery, because the files are never written physically to
   disk).
 
+* Mapped reads: If the preference "/Directories/MapBlockFiles" is set,
+  ReadData() serves sample data from a memory mapping of the .au file,
+  taken from a bounded table owned by the DirManager, instead of opening
+  the file with libsndfile for every read.  Files not in native byte
+  order still go through libsndfile.
+
 *//****************************************************************//**
 
 \class auHeader
@@ -68,12 +74,22 @@ to get its definition, rather than rolling our own.
 
 #include "../FileException.h"
 #include "../Prefs.h"
+#include "BlockIOStats.h"
+#include "MappedFile.h"
+#include "SpareBlockFiles.h"
 
 #include "../FileFormats.h"
 
 #include "sndfile.h"
 #include "../Internat.h"
 #include "../MemoryX.h"
+#include "../SampleConvert.h"
+
+#if defined(__WXMSW__)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
 
 
 static wxUint32 SwapUintEndianess(wxUint32 in)
@@ -88,6 +104,37 @@ static wxUint32 SwapUintEndianess(wxUint32 in)
   return out;
 }
 
+// Cuts an open file to what was written so far
+static bool TruncateHere(wxFFile &file)
+{
+   const auto length = file.Tell();
+   if (length == wxInvalidOffset || !file.Flush())
+      return false;
+#if defined(__WXMSW__)
+   return _chsize_s(_fileno(file.fp()), length) == 0;
+#else
+   return ftruncate(fileno(file.fp()), length) == 0;
+#endif
+}
+
+// Unpads the packed 24-bit samples of the disk, and converts them to the
+// given format in the same pass
+template<sampleFormat Format>
+static void Unpack24(const char *src,
+                     typename SampleTraits<Format>::type *dst, size_t len)
+{
+   auto bytes = (const unsigned char *)src;
+   for (size_t i = 0; i < len; ++i, bytes += 3) {
+      #if wxBYTE_ORDER == wxBIG_ENDIAN
+         int value = (bytes[0] << 16) | (bytes[1] << 8) | bytes[2];
+      #else
+         int value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16);
+      #endif
+      // sign-extend
+      dst[i] = ConvertSample<int24Sample, Format>((value ^ 0x800000) - 0x800000);
+   }
+}
+
 /// Constructs a SimpleBlockFile based on sample data and writes
 /// it to disk.
 ///
@@ -98,11 +145,13 @@ static wxUint32 SwapUintEndianess(wxUint32 in)
 /// @param sampleLen    The number of samples to be written to this block.
 /// @param format       The format of the given samples.
 /// @param allowDeferredWrite    Allow deferred write-caching
+/// @param writeInBackground     Defer the write to DirManager's BlockWriter
 SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&baseFileName,
                                  samplePtr sampleData, size_t sampleLen,
                                  sampleFormat format,
                                  bool allowDeferredWrite /* = false */,
-                                 bool bypassCache /* = false */):
+                                 bool bypassCache /* = false */,
+                                 bool writeInBackground /* = false */):
    BlockFile {
       (baseFileName.SetExt(wxT("au")), std::move(baseFileName)),
       sampleLen
@@ -112,7 +161,10 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&baseFileName,
 
    mCache.active = false;
 
-   bool useCache = GetCache() && (!bypassCache);
+   const bool keepCache = GetCache();
+   if (writeInBackground)
+      allowDeferredWrite = true;
+   bool useCache = (keepCache || writeInBackground) && (!bypassCache);
 
    if (!(allowDeferredWrite && useCache) && !bypassCache)
    {
@@ -126,6 +178,7 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&baseFileName,
       //wxLogDebug("SimpleBlockFile::SimpleBlockFile(): Caching block file data.");
       mCache.active = true;
       mCache.needWrite = true;
+      mCache.dropAfterWrite = !keepCache;
       mCache.format = format;
       const auto sampleDataSize = sampleLen * SAMPLE_SIZE(format);
       mCache.sampleData.reinit(sampleDataSize);
@@ -159,6 +212,21 @@ SimpleBlockFile::SimpleBlockFile(wxFileNameWrapper &&existingFile, size_t len,
 
 SimpleBlockFile::~SimpleBlockFile()
 {
+   // Unmap before BlockFile's destructor removes the file
+   ReleaseMapping();
+}
+
+void SimpleBlockFile::SetFileName(wxFileNameWrapper &&name)
+{
+   ReleaseMapping();
+   BlockFile::SetFileName(std::move(name));
+}
+
+void SimpleBlockFile::ReleaseMapping() const
+{
+   auto &table = DirManager::GetMappedFiles();
+   if (table.IsEnabled() && mFileName.HasName())
+      table.Release(mFileName.GetFullPath());
 }
 
 bool SimpleBlockFile::WriteSimpleBlockFile(
@@ -167,11 +235,19 @@ bool SimpleBlockFile::WriteSimpleBlockFile(
     sampleFormat format,
     void* summaryData)
 {
-   wxFFile file(mFileName.GetFullPath(), wxT("wb"));
+   ReleaseMapping();
+
+   // While recording, write over a file with its space already allocated,
+   // if one is left, and cut it to length at the end
+   const auto fullPath = mFileName.GetFullPath();
+   const bool spare = DirManager::GetSpareFiles().Take(
+      fullPath, GetFileSize(sampleLen, format));
+   wxFFile file(fullPath, spare ? wxT("r+b") : wxT("wb"));
    if( !file.IsOpened() ){
       // Can't do anything else.
       return false;
    }
+   BlockIOStats::Add(BlockIOStats::FilesOpened);
 
    auHeader header;
 
@@ -268,9 +344,21 @@ bool SimpleBlockFile::WriteSimpleBlockFile(
       }
    }
 
+   if (spare && !TruncateHere(file))
+      return false;
+
+   BlockIOStats::Add(BlockIOStats::BytesWritten, sizeof(header) +
+      mSummaryInfo.totalSummaryBytes + sampleLen * SAMPLE_SIZE_DISK(format));
    return true;
 }
 
+// static
+size_t SimpleBlockFile::GetFileSize(size_t sampleLen, sampleFormat format)
+{
+   return sizeof(auHeader) + SummaryInfo(sampleLen).totalSummaryBytes +
+      sampleLen * SAMPLE_SIZE_DISK(format);
+}
+
 // This function should try to fill the cache, but just return without effect
 // (not throwing) if there is failure.
 void SimpleBlockFile::FillCache()
@@ -346,6 +434,10 @@ void SimpleBlockFile::FillCache()
 bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
 {
    data.reinit( mSummaryInfo.totalSummaryBytes );
+   ODLocker locker;
+   if (mCache.active)
+      // Check again with the lock; the cache may have been freed meanwhile
+      locker.reset(&mCacheMutex);
    if (mCache.active) {
       //wxLogDebug("SimpleBlockFile::ReadSummary(): Summary is already in cache.");
       memcpy(data.get(), mCache.summaryData.get(), mSummaryInfo.totalSummaryBytes);
@@ -353,6 +445,8 @@ bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
    }
    else
    {
+      locker.reset();
+
       //wxLogDebug("SimpleBlockFile::ReadSummary(): Reading summary from disk.");
 
       wxFFile file(mFileName.GetFullPath(), wxT("rb"));
@@ -370,6 +464,7 @@ bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
          }
       }
       mSilentLog = FALSE;
+      BlockIOStats::Add(BlockIOStats::FilesOpened);
 
       // The offset is just past the au header
       if( !file.Seek(sizeof(auHeader)) ||
@@ -380,6 +475,8 @@ bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
       }
 
       FixSummary(data.get());
+      BlockIOStats::Add(BlockIOStats::BytesRead,
+                        mSummaryInfo.totalSummaryBytes);
 
       return true;
    }
@@ -395,6 +492,10 @@ bool SimpleBlockFile::ReadSummary(ArrayOf<char> &data)
 size_t SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
                         size_t start, size_t len, bool mayThrow) const
 {
+   ODLocker locker;
+   if (mCache.active)
+      // Check again with the lock; the cache may have been freed meanwhile
+      locker.reset(&mCacheMutex);
    if (mCache.active)
    {
       //wxLogDebug("SimpleBlockFile::ReadData(): Data are already in cache.");
@@ -408,15 +509,93 @@ size_t SimpleBlockFile::ReadData(samplePtr data, sampleFormat format,
       if ( framesRead < len ) {
          if (mayThrow)
             // Not the best exception class?
-            throw FileException{ FileException::Cause::Read, mFileName };
+            throw FileException{ FileException::Cause::Read, mFileName.Get() };
          ClearSamples(data, format, framesRead, len - framesRead);
       }
 
       return framesRead;
    }
-   else
+   else {
+      locker.reset();
+      size_t framesRead;
+      if (ReadMappedData(data, format, start, len, framesRead)) {
+         if ( framesRead < len ) {
+            if (mayThrow)
+               throw FileException{ FileException::Cause::Read, mFileName.Get() };
+            ClearSamples(data, format, framesRead, len - framesRead);
+         }
+         return framesRead;
+      }
+
       return CommonReadData( mayThrow,
-         mFileName, mSilentLog, nullptr, 0, 0, data, format, start, len);
+         mFileName.Get(), mSilentLog, nullptr, 0, 0, data, format, start, len);
+   }
+}
+
+bool SimpleBlockFile::ReadMappedData(samplePtr data, sampleFormat format,
+   size_t start, size_t len, size_t &framesRead) const
+{
+   auto &table = DirManager::GetMappedFiles();
+   if (!table.IsEnabled())
+      return false;
+
+   auto mapping = table.Acquire(mFileName.GetFullPath());
+   if (!mapping || mapping->GetSize() < sizeof(auHeader))
+      return false;
+
+   auHeader header;
+   memcpy(&header, mapping->GetData(), sizeof(header));
+
+   // Let libsndfile deal with files written in the other byte order
+   if (header.magic != 0x2e736e64)
+      return false;
+
+   sampleFormat diskFormat;
+   switch (header.encoding)
+   {
+   case AU_SAMPLE_FORMAT_16:
+      diskFormat = int16Sample;
+      break;
+   case AU_SAMPLE_FORMAT_24:
+      diskFormat = int24Sample;
+      break;
+   case AU_SAMPLE_FORMAT_FLOAT:
+      diskFormat = floatSample;
+      break;
+   default:
+      return false;
+   }
+
+   if (header.dataOffset > mapping->GetSize())
+      return false;
+
+   const auto diskSampleSize = SAMPLE_SIZE_DISK(diskFormat);
+   const size_t available = std::min(mLen,
+      (mapping->GetSize() - header.dataOffset) / diskSampleSize);
+   framesRead = std::min(len, std::max(start, available) - start);
+   BlockIOStats::Add(BlockIOStats::BytesRead, framesRead * diskSampleSize);
+
+   auto src = mapping->GetData() + header.dataOffset +
+      start * diskSampleSize;
+
+   if (diskFormat == int24Sample) {
+      // 24-bit samples are packed on disk; unpad them the way
+      // WriteSimpleBlockFile padded them
+      if (format == floatSample)
+         // The usual case, converted as they are unpacked
+         Unpack24<floatSample>(src, (float *)data, framesRead);
+      else if (format == int24Sample)
+         Unpack24<int24Sample>(src, (int *)data, framesRead);
+      else {
+         SampleBuffer buffer(framesRead, int24Sample);
+         Unpack24<int24Sample>(src, (int *)buffer.ptr(), framesRead);
+         CopySamples(buffer.ptr(), int24Sample, data, format, framesRead);
+      }
+   }
+   else
+      CopySamples((samplePtr)src, diskFormat, data, format, framesRead);
+
+   return true;
 }
 
 /// Create a copy of this BlockFile, but using a different disk file.
@@ -432,7 +611,7 @@ BlockFilePtr SimpleBlockFile::Copy(wxFileNameWrapper &&newFileName)
 
 auto SimpleBlockFile::GetSpaceUsage() const -> DiskByteCount
 {
-   if (mCache.active && mCache.needWrite)
+   if (mCache.active && mCache.needWrite && !mCache.dropAfterWrite)
    {
       // We don't know space usage yet
       return 0;
@@ -489,6 +668,13 @@ auto SimpleBlockFile::GetSpaceUsage() const -> DiskByteCount
 }
 
 void SimpleBlockFile::Recover(){
+   ReleaseMapping();
+
+   // Make a NEW file, rather than write through a link that another
+   // project may share
+   if (wxFileExists(mFileName.GetFullPath()))
+      wxRemoveFile(mFileName.GetFullPath());
+
    wxFFile file(mFileName.GetFullPath(), wxT("wb"));
 
    if( !file.IsOpened() ){
@@ -518,12 +704,24 @@ void SimpleBlockFile::Recover(){
 
 void SimpleBlockFile::WriteCacheToDisk()
 {
+   ODLocker writeLocker{ &mWriteMutex };
    if (!GetNeedWriteCacheToDisk())
       return;
 
+   // The data don't change while needWrite is set, so readers may
+   // proceed during the write
    if (WriteSimpleBlockFile(mCache.sampleData.get(), mLen, mCache.format,
-                            mCache.summaryData.get()))
+                            mCache.summaryData.get())) {
       mCache.needWrite = false;
+
+      if (mCache.dropAfterWrite) {
+         // From now on, read the file
+         ODLocker locker{ &mCacheMutex };
+         mCache.active = false;
+         mCache.sampleData.reset();
+         mCache.summaryData.reset();
+      }
+   }
 }
 
 bool SimpleBlockFile::GetNeedWriteCacheToDisk()
@@ -11,6 +11,7 @@
 #ifndef __AUDACITY_SIMPLE_BLOCKFILE__
 #define __AUDACITY_SIMPLE_BLOCKFILE__
 
+#include <atomic>
 #include <wx/string.h>
 #include <wx/filename.h>
 
@@ -18,8 +19,12 @@
 #include "../DirManager.h"
 
 struct SimpleBlockFileCache {
-   bool active;
+   // active may be cleared by the BlockWriter thread, while other
+   // threads read; see SimpleBlockFile::mCacheMutex
+   std::atomic<bool> active;
    bool needWrite;
+   // Whether to free the data once written, rather than keep them
+   bool dropAfterWrite { false };
    sampleFormat format;
    ArrayOf<char> sampleData, summaryData;
 
@@ -47,12 +52,15 @@ class PROFILE_DLL_API SimpleBlockFile /* not final */ : public BlockFile {
 
    // Constructor / Destructor
 
-   /// Create a disk file and write summary and sample data to it
+   /// Create a disk file and write summary and sample data to it.
+   /// If writeInBackground, keep the data in memory instead, for
+   /// the caller to give to DirManager's BlockWriter.
    SimpleBlockFile(wxFileNameWrapper &&baseFileName,
                    samplePtr sampleData, size_t sampleLen,
                    sampleFormat format,
                    bool allowDeferredWrite = false,
-                   bool bypassCache = false );
+                   bool bypassCache = false,
+                   bool writeInBackground = false );
    /// Create the memory structure to refer to the given block file
    SimpleBlockFile(wxFileNameWrapper &&existingFile, size_t len,
                    float min, float max, float rms);
@@ -80,6 +88,11 @@ class PROFILE_DLL_API SimpleBlockFile /* not final */ : public BlockFile {
 
    void FillCache() /* noexcept */ override;
 
+   void SetFileName(wxFileNameWrapper &&name) override;
+
+   /// The length of the file of a block of so many samples
+   static size_t GetFileSize(size_t sampleLen, sampleFormat format);
+
  protected:
 
    bool WriteSimpleBlockFile(samplePtr sampleData, size_t sampleLen,
@@ -87,7 +100,20 @@ class PROFILE_DLL_API SimpleBlockFile /* not final */ : public BlockFile {
    static bool GetCache();
    void ReadIntoCache();
 
+   /// Read sample data through DirManager's table of mapped files.
+   /// Returns false if mapping is disabled or not usable for this file.
+   bool ReadMappedData(samplePtr data, sampleFormat format,
+                       size_t start, size_t len, size_t &framesRead) const;
+   /// Drop any mapping before the file is rewritten, renamed or removed
+   void ReleaseMapping() const;
+
    SimpleBlockFileCache mCache;
+   // Held while reading the cache, and while freeing it after a
+   // background write
+   mutable ODLock mCacheMutex;
+   // Serializes writes of the cache, by the BlockWriter and by
+   // DirManager::WriteCacheToDisk()
+   ODLock mWriteMutex;
 
  private:
    mutable sampleFormat mFormat; // may be found lazily
@@ -0,0 +1,140 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   SliceBlockFile.cpp
+
+*******************************************************************//**
+
+\class SliceBlockFile
+\brief A view of a range of another BlockFile.
+
+Deleting, pasting into, or copying part of a block used to read the
+samples that survive and write them as NEW blocks.  Sequence now keeps
+such parts as slices of the block instead, when they are long enough to
+be blocks by themselves, so that an edit of a long recording costs a few
+changes to the block array and no reading or writing of samples.
+
+A slice refers to its base, never to another slice.  It has no file, and
+shares its base with other slices and with the undo history.  The project
+file and the journal record it as its base and range.  Its summary is
+made from its samples, the first time it is drawn, and kept.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "SliceBlockFile.h"
+
+#include <cstring>
+#include <typeinfo>
+
+#include "FLACBlockFile.h"
+#include "SimpleBlockFile.h"
+
+bool SliceBlockFile::CanSlice(const BlockFile &file)
+{
+   const auto &type = typeid(file);
+   return type == typeid(SimpleBlockFile) ||
+      type == typeid(FLACBlockFile) ||
+      type == typeid(SliceBlockFile);
+}
+
+namespace {
+
+// Slices of slices are views of the same base
+const BlockFilePtr &BaseOf(const BlockFilePtr &file)
+{
+   return file->IsSlice()
+      ? static_cast<const SliceBlockFile&>(*file).GetBase() : file;
+}
+
+size_t StartIn(const BlockFilePtr &file)
+{
+   return file->IsSlice()
+      ? static_cast<const SliceBlockFile&>(*file).GetStart() : 0;
+}
+
+}
+
+SliceBlockFile::SliceBlockFile(const BlockFilePtr &base,
+                               size_t start, size_t len)
+   : BlockFile{ wxFileNameWrapper{}, len }
+   , mBase{ BaseOf(base) }
+   , mStart{ StartIn(base) + start }
+   , mHaveStats{ false }
+{
+   wxASSERT(start + len <= base->GetLength());
+   mMin = mMax = mRMS = 0;
+   mStats = { 0.f, 0.f, 0.f };
+}
+
+SliceBlockFile::SliceBlockFile(const BlockFilePtr &base,
+                               size_t start, size_t len,
+                               float min, float max, float rms)
+   : SliceBlockFile{ base, start, len }
+{
+   mStats = { min, max, rms };
+   mHaveStats = true;
+}
+
+SliceBlockFile::~SliceBlockFile()
+{
+}
+
+bool SliceBlockFile::ReadSummary(ArrayOf<char> &data)
+{
+   ODLocker locker{ &mStatsMutex };
+   if (!mSummary) {
+      Floats samples{ mLen };
+      if (ReadData((samplePtr)samples.get(), floatSample, 0, mLen, false)
+          != mLen) {
+         // Try again another time
+         data.reinit(mSummaryInfo.totalSummaryBytes);
+         memset(data.get(), 0, mSummaryInfo.totalSummaryBytes);
+         return false;
+      }
+
+      mSummary.reinit(mSummaryInfo.totalSummaryBytes);
+      memset(mSummary.get(), 0, mSummaryInfo.totalSummaryBytes);
+      CalcSummaryFromBuffer(samples.get(), mLen,
+         (float *)(mSummary.get() + mSummaryInfo.offset256),
+         (float *)(mSummary.get() + mSummaryInfo.offset64K));
+   }
+
+   data.reinit(mSummaryInfo.totalSummaryBytes);
+   memcpy(data.get(), mSummary.get(), mSummaryInfo.totalSummaryBytes);
+   return true;
+}
+
+size_t SliceBlockFile::ReadData(samplePtr data, sampleFormat format,
+                                size_t start, size_t len, bool mayThrow) const
+{
+   return mBase->ReadData(data, format, mStart + start, len, mayThrow);
+}
+
+auto SliceBlockFile::GetMinMaxRMS(size_t start, size_t len, bool mayThrow)
+   const -> MinMaxRMS
+{
+   return mBase->GetMinMaxRMSFromSummary(mStart + start, len, mayThrow);
+}
+
+auto SliceBlockFile::GetMinMaxRMS(bool mayThrow) const -> MinMaxRMS
+{
+   ODLocker locker{ &mStatsMutex };
+   if (!mHaveStats) {
+      mStats = mBase->GetMinMaxRMSFromSummary(mStart, mLen, mayThrow);
+      mHaveStats = true;
+   }
+   return mStats;
+}
+
+BlockFilePtr SliceBlockFile::Copy(wxFileNameWrapper &&)
+{
+   ODLocker locker{ &mStatsMutex };
+   if (mHaveStats)
+      return make_blockfile<SliceBlockFile>(
+         mBase, mStart, mLen, mStats.min, mStats.max, mStats.RMS);
+   return make_blockfile<SliceBlockFile>(mBase, mStart, mLen);
+}
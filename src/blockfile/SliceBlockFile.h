@@ -0,0 +1,83 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   SliceBlockFile.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SLICE_BLOCKFILE__
+#define __AUDACITY_SLICE_BLOCKFILE__
+
+#include "../BlockFile.h"
+
+/// A BlockFile that is a view of a range of the samples of another, with
+/// no disk file of its own
+
+/// Edits that cut a block keep the parts that survive as slices of it,
+/// instead of reading and writing their samples.  The base stays while
+/// any slice of it does; Sequence::Compact() rewrites slices as blocks of
+/// their own, when the program is idle, so that the bases may go.
+class SliceBlockFile final : public BlockFile {
+ public:
+
+   /// Whether slices may be made of file: those that the project file
+   /// and the journal can make again from their files, and slices
+   static bool CanSlice(const BlockFile &file);
+
+   // Constructor / Destructor
+
+   /// A view of len samples of base from start on
+   SliceBlockFile(const BlockFilePtr &base, size_t start, size_t len);
+   /// The same, with the statistics of the range already known
+   SliceBlockFile(const BlockFilePtr &base, size_t start, size_t len,
+                  float min, float max, float rms);
+
+   virtual ~SliceBlockFile();
+
+   // Reading
+
+   /// Computes the summary from the samples when first needed, as the
+   /// frames of the base's summary don't line up with the slice
+   bool ReadSummary(ArrayOf<char> &data) override;
+   /// Reads the samples from the base
+   size_t ReadData(samplePtr data, sampleFormat format,
+                        size_t start, size_t len, bool mayThrow) const override;
+
+   MinMaxRMS GetMinMaxRMS(size_t start, size_t len,
+                          bool mayThrow = true) const override;
+   /// From the summaries of the base, when first needed
+   MinMaxRMS GetMinMaxRMS(bool mayThrow = true) const override;
+
+   bool IsSlice() const override { return true; }
+
+   const BlockFilePtr &GetBase() const { return mBase; }
+   size_t GetStart() const { return mStart; }
+
+   /// Create another view of the same samples
+   BlockFilePtr Copy(wxFileNameWrapper &&newFileName) override;
+   /// The space is the base's
+   DiskByteCount GetSpaceUsage() const override { return 0; }
+   void Recover() override { }
+
+   /// A slice is locked as its base is, so that a saved project keeps the
+   /// base's file
+   void Lock() override { mBase->Lock(); }
+   void CloseLock() override { mBase->CloseLock(); }
+   void Unlock() override { mBase->Unlock(); }
+   bool IsLocked() override { return mBase->IsLocked(); }
+
+ private:
+   const BlockFilePtr mBase;
+   const size_t mStart;
+
+   // Guards the statistics and the summary, made when first needed
+   mutable ODLock mStatsMutex;
+   mutable MinMaxRMS mStats;
+   mutable bool mHaveStats;
+   ArrayOf<char> mSummary;
+};
+
+#endif
@@ -0,0 +1,184 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   SpareBlockFiles.cpp
+
+*******************************************************************//**
+
+\class SpareBlockFiles
+\brief Preallocated files for the blocks of a recording.
+
+When a recording starts, the project asks for enough files for the
+blocks of the next half minute or so, and tops them up from its timer
+while it records.  Each is made at the largest size of a block file,
+with the space allocated by posix_fallocate(), or what there is like it
+elsewhere.  SimpleBlockFile::WriteSimpleBlockFile() renames one to the
+name of the new block, writes over it and cuts it to length, so that
+the thread appending the recorded samples neither makes nor grows a
+file, and a full disk shows before the recording needs the space.
+
+The files have the extension "spare", which the check of the project
+for orphans ignores, and a recording cleans away any left by a crash.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "SpareBlockFiles.h"
+
+#include <algorithm>
+
+#include <wx/dir.h>
+#include <wx/file.h>
+#include <wx/filefn.h>
+#include <wx/log.h>
+
+#if defined(__WXMSW__)
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const wxChar *const kSpareExt = wxT("spare");
+
+// Make the file with its space allocated; false if there is not room
+bool Preallocate(const wxString &path, size_t bytes)
+{
+   wxFile file;
+   {
+      wxLogNull silence;
+      if (!file.Create(path, true))
+         return false;
+   }
+
+   const int fd = file.fd();
+#if defined(__WXMSW__)
+   // Extending allocates on NTFS
+   bool ok = _chsize_s(fd, bytes) == 0;
+#elif defined(__WXMAC__)
+   fstore_t store = { F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)bytes, 0 };
+   bool ok = fcntl(fd, F_PREALLOCATE, &store) != -1;
+   if (!ok) {
+      store.fst_flags = F_ALLOCATEALL;
+      ok = fcntl(fd, F_PREALLOCATE, &store) != -1;
+   }
+   ok = ok && ftruncate(fd, bytes) == 0;
+#else
+   bool ok = posix_fallocate(fd, 0, bytes) == 0;
+#endif
+
+   file.Close();
+   if (!ok)
+      wxRemoveFile(path);
+   return ok;
+}
+
+}
+
+SpareBlockFiles::~SpareBlockFiles()
+{
+   Release();
+}
+
+void SpareBlockFiles::Reserve(const wxString &dir, size_t fileBytes,
+                              size_t count)
+{
+   ODLocker locker{ &mLock };
+   if (dir != mDir || fileBytes != mFileBytes) {
+      RemoveAll();
+
+      // Those a crash left behind
+      wxArrayString leftOver;
+      if (wxDirExists(dir))
+         wxDir::GetAllFiles(dir, &leftOver,
+            wxString(wxT("*.")) + kSpareExt, wxDIR_FILES);
+      for (const auto &path : leftOver)
+         wxRemoveFile(path);
+
+      mDir = dir;
+      mFileBytes = fileBytes;
+   }
+   mCount = count;
+   mFull = false;
+}
+
+bool SpareBlockFiles::Refill(size_t batch)
+{
+   ODLocker locker{ &mLock };
+   if (mFull)
+      return false;
+   if (mFiles.size() >= mCount || mDir.empty())
+      return true;
+
+   const auto dir = mDir;
+   const auto bytes = mFileBytes;
+   const auto toMake = std::min(batch, mCount - mFiles.size());
+   std::vector<wxString> made;
+   for (size_t ii = 0; ii < toMake; ++ii)
+      made.push_back(dir + wxFILE_SEP_PATH +
+         wxString::Format(wxT("spare%05u."), mSerial++) + kSpareExt);
+
+   // Don't hold the lock while the disk works
+   locker.reset();
+   bool full = false;
+   size_t count = 0;
+   for (; count < made.size(); ++count)
+      if (!Preallocate(made[count], bytes)) {
+         full = true;
+         break;
+      }
+   made.resize(count);
+
+   locker.reset(&mLock);
+   if (dir != mDir || bytes != mFileBytes) {
+      // Released or reserved again meanwhile
+      for (const auto &path : made)
+         wxRemoveFile(path);
+      return true;
+   }
+   mFiles.insert(mFiles.end(), made.begin(), made.end());
+   mFull = full;
+   return !full;
+}
+
+bool SpareBlockFiles::Take(const wxString &path, size_t bytes)
+{
+   ODLocker locker{ &mLock };
+   if (mFiles.empty() || bytes > mFileBytes || !path.StartsWith(mDir))
+      return false;
+
+   const auto spare = mFiles.back();
+   mFiles.pop_back();
+   // Renaming within one directory tree is within one volume
+   if (wxRenameFile(spare, path, false))
+      return true;
+   wxRemoveFile(spare);
+   return false;
+}
+
+void SpareBlockFiles::Release()
+{
+   ODLocker locker{ &mLock };
+   RemoveAll();
+   mDir.clear();
+   mFileBytes = 0;
+   mCount = 0;
+}
+
+wxLongLong SpareBlockFiles::GetReservedBytes() const
+{
+   ODLocker locker{ &mLock };
+   return wxLongLong((long long)mFiles.size() * (long long)mFileBytes);
+}
+
+void SpareBlockFiles::RemoveAll()
+{
+   for (const auto &path : mFiles)
+      wxRemoveFile(path);
+   mFiles.clear();
+}
@@ -0,0 +1,67 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   SpareBlockFiles.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SPARE_BLOCK_FILES__
+#define __AUDACITY_SPARE_BLOCK_FILES__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <vector>
+
+#include <wx/longlong.h>
+#include <wx/string.h>
+
+#include "../ondemand/ODTaskThread.h"
+
+/// Files made ahead of a recording, with their space allocated on the
+/// disk, that new simple block files take by renaming instead of making
+/// and growing a file each.  Only one project records at a time, so one
+/// table serves all.
+class SpareBlockFiles final {
+ public:
+   SpareBlockFiles() {}
+   ~SpareBlockFiles();
+
+   SpareBlockFiles(const SpareBlockFiles&) PROHIBITED;
+   SpareBlockFiles &operator= (const SpareBlockFiles&) PROHIBITED;
+
+   /// Keep count files of fileBytes each in dir, which Refill() makes;
+   /// removes those kept for another directory or size
+   void Reserve(const wxString &dir, size_t fileBytes, size_t count);
+
+   /// Make up to batch of the files missing; false if the disk is full,
+   /// after which no more are made until the next Reserve()
+   bool Refill(size_t batch);
+
+   /// Rename a spare file of at least bytes to path, which must be under
+   /// the directory; false if there is none to take
+   bool Take(const wxString &path, size_t bytes);
+
+   /// Remove the spare files, and keep no more
+   void Release();
+
+   /// The space the spare files hold on the disk
+   wxLongLong GetReservedBytes() const;
+
+ private:
+   // Lock is already held
+   void RemoveAll();
+
+   mutable ODLock mLock;
+   wxString mDir;
+   size_t mFileBytes { 0 };
+   size_t mCount { 0 };
+   unsigned mSerial { 0 };
+   bool mFull { false };
+   std::vector<wxString> mFiles;
+};
+
+#endif
@@ -0,0 +1,277 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   SummaryCache.cpp
+
+*******************************************************************//**
+
+\class SummaryCache
+\brief Keeps the summaries of blocks of aliased files in a directory of
+the user, across projects and sessions.
+
+An alias import of a long file computes the summaries of its blocks in
+ODComputeSummaryTask, reading the whole file; importing the same file
+again, in this project or another, computed them all again.  Now each
+summary written is stored here too, under the identity of the file, and
+ODPCMAliasBlockFile::ReadExistingSummary() takes it from here when the
+block has no summary file yet, so the waveform is drawn at once.
+
+The identity of a file is its path, its size, the time it was last
+changed, and a hash of its first and last 64 KiB, so that a file
+rewritten in place is not mistaken for the one before.  Entries are
+files named by a hash of the identity and the place of the block in the
+file, with a header that Fetch() checks.  When they pass the budget, the
+oldest go, until a quarter of it is free.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "SummaryCache.h"
+
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#include <wx/dir.h>
+#include <wx/filefn.h>
+#include <wx/filename.h>
+#include <wx/log.h>
+
+#include "../FileNames.h"
+
+namespace {
+
+// Bytes of the start and the end of a file hashed for its identity
+const size_t kIdentityBytes = 64 * 1024;
+
+const char kEntryTag[8] = { 'A', 'u', 'd', 'S', 'u', 'm', 'C', '1' };
+
+struct EntryHeader {
+   char tag[8];
+   unsigned long long identity;
+   long long start;
+   unsigned long long len;
+   long long channel;
+   unsigned long long bytes;
+};
+
+unsigned long long Mix(unsigned long long hash, unsigned long long word)
+{
+   hash = (hash ^ word) * 0x9e3779b97f4a7c15ULL;
+   return hash ^ (hash >> 29);
+}
+
+unsigned long long HashBytes(unsigned long long hash,
+                             const char *data, size_t bytes)
+{
+   size_t ii = 0;
+   for (; ii + sizeof(hash) <= bytes; ii += sizeof(hash)) {
+      unsigned long long word;
+      memcpy(&word, data + ii, sizeof(word));
+      hash = Mix(hash, word);
+   }
+   for (; ii < bytes; ++ii)
+      hash = (hash ^ (unsigned char)data[ii]) * 0x100000001b3ULL;
+   return hash;
+}
+
+// The C library, not wxFile, as the threads of on-demand tasks call this,
+// and wxLog is not safe for them
+FILE *Open(const wxString &path, const char *mode)
+{
+   return fopen(path.mb_str(wxConvFile), mode);
+}
+
+bool Remove(const wxString &path)
+{
+   return remove(path.mb_str(wxConvFile)) == 0;
+}
+
+}
+
+SummaryCache::SummaryCache()
+   : mDir{ FileNames::MkDir(
+        wxFileName{ FileNames::DataDir(), wxT("SummaryCache") }.GetFullPath()) }
+{
+}
+
+SummaryCache::~SummaryCache()
+{
+}
+
+void SummaryCache::SetBudget(unsigned long long bytes)
+{
+   ODLocker locker{ &mLock };
+   mBudget = bytes;
+   if (mCounted)
+      Trim();
+}
+
+unsigned long long SummaryCache::Identify(const wxString &path)
+{
+   wxStructStat st;
+   if (wxStat(path, &st) != 0)
+      return 0;
+
+   auto &identity = mIdentities[path];
+   if (identity.hash != 0 &&
+       identity.size == (wxFileOffset)st.st_size &&
+       identity.modified == st.st_mtime)
+      return identity.hash;
+
+   FILE *file = Open(path, "rb");
+   if (!file)
+      return 0;
+   const wxFileOffset size = st.st_size;
+   unsigned long long hash = Mix(0xcbf29ce484222325ULL, size);
+   hash = Mix(hash, st.st_mtime);
+   hash = HashBytes(hash, (const char *)path.wx_str(),
+                    path.length() * sizeof(wxChar));
+
+   ArrayOf<char> buffer{ kIdentityBytes };
+   auto read = fread(buffer.get(), 1, kIdentityBytes, file);
+   hash = HashBytes(hash, buffer.get(), read);
+   if (size > (wxFileOffset)(2 * kIdentityBytes) &&
+       0 == fseek(file, -(long)kIdentityBytes, SEEK_END)) {
+      read = fread(buffer.get(), 1, kIdentityBytes, file);
+      hash = HashBytes(hash, buffer.get(), read);
+   }
+   fclose(file);
+
+   // Zero means unknown
+   hash = std::max(hash, 1ULL);
+   identity = Identity{ size, st.st_mtime, hash };
+   return hash;
+}
+
+wxString SummaryCache::EntryPath(unsigned long long key) const
+{
+   return mDir + wxFILE_SEP_PATH +
+      wxString::Format(wxT("%016llx.sum"), key);
+}
+
+bool SummaryCache::Fetch(const wxString &path, sampleCount start, size_t len,
+                         int channel, void *summary, size_t bytes)
+{
+   ODLocker locker{ &mLock };
+   if (mBudget == 0)
+      return false;
+   const auto identity = Identify(path);
+   if (identity == 0)
+      return false;
+
+   const EntryHeader expected{ {}, identity, start.as_long_long(), len,
+      channel, bytes };
+   const auto key = Mix(Mix(Mix(identity, expected.start), len), channel);
+   FILE *file = Open(EntryPath(key), "rb");
+   if (!file)
+      return false;
+
+   EntryHeader header;
+   // Read one byte more, to reject longer files
+   ArrayOf<char> data{ bytes + 1 };
+   const bool ok =
+      fread(&header, sizeof(header), 1, file) == 1 &&
+      memcmp(header.tag, kEntryTag, sizeof(kEntryTag)) == 0 &&
+      header.identity == expected.identity &&
+      header.start == expected.start &&
+      header.len == expected.len &&
+      header.channel == expected.channel &&
+      header.bytes == expected.bytes &&
+      fread(data.get(), 1, bytes + 1, file) == bytes;
+   fclose(file);
+   if (ok)
+      memcpy(summary, data.get(), bytes);
+   return ok;
+}
+
+void SummaryCache::Store(const wxString &path, sampleCount start, size_t len,
+                         int channel, const void *summary, size_t bytes)
+{
+   ODLocker locker{ &mLock };
+   if (mBudget == 0)
+      return;
+   const auto identity = Identify(path);
+   if (identity == 0)
+      return;
+
+   EntryHeader header{ {}, identity, start.as_long_long(), len,
+      channel, bytes };
+   memcpy(header.tag, kEntryTag, sizeof(kEntryTag));
+   const auto key = Mix(Mix(Mix(identity, header.start), len), channel);
+   const auto entryPath = EntryPath(key);
+
+   // Written under another name, then renamed, so that another instance
+   // of the program never reads half an entry
+   const auto tempPath = entryPath + wxT(".tmp");
+   FILE *file = Open(tempPath, "wb");
+   if (!file)
+      return;
+   const bool ok =
+      fwrite(&header, sizeof(header), 1, file) == 1 &&
+      fwrite(summary, 1, bytes, file) == bytes;
+   if (fclose(file) != 0 || !ok) {
+      Remove(tempPath);
+      return;
+   }
+   wxStructStat st;
+   const bool replacing = wxStat(entryPath, &st) == 0 && Remove(entryPath);
+   if (rename(tempPath.mb_str(wxConvFile), entryPath.mb_str(wxConvFile)) != 0) {
+      Remove(tempPath);
+      return;
+   }
+
+   if (!mCounted) {
+      mCounted = true;
+      wxLogNull silence;
+      wxArrayString files;
+      wxDir::GetAllFiles(mDir, &files, wxT("*.sum"), wxDIR_FILES);
+      mUsed = 0;
+      for (const auto &name : files)
+         if (wxStat(name, &st) == 0)
+            mUsed += st.st_size;
+   }
+   else if (!replacing)
+      mUsed += sizeof(header) + bytes;
+   if (mUsed > mBudget)
+      Trim();
+}
+
+void SummaryCache::Trim()
+{
+   if (mUsed <= mBudget)
+      return;
+
+   struct Entry {
+      wxString path;
+      time_t modified;
+      unsigned long long size;
+   };
+   std::vector<Entry> entries;
+   wxLogNull silence;
+   wxArrayString files;
+   wxDir::GetAllFiles(mDir, &files, wxT("*.sum"), wxDIR_FILES);
+   mUsed = 0;
+   for (const auto &name : files) {
+      wxStructStat st;
+      if (wxStat(name, &st) == 0) {
+         entries.push_back({ name, st.st_mtime,
+            (unsigned long long)st.st_size });
+         mUsed += st.st_size;
+      }
+   }
+   std::sort(entries.begin(), entries.end(),
+      [](const Entry &a, const Entry &b){ return a.modified < b.modified; });
+
+   const auto target = mBudget - mBudget / 4;
+   for (const auto &entry : entries) {
+      if (mUsed <= target)
+         break;
+      if (Remove(entry.path))
+         mUsed -= entry.size;
+   }
+}
@@ -0,0 +1,71 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   License: GPL v2.  See License.txt.
+
+   SummaryCache.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SUMMARY_CACHE__
+#define __AUDACITY_SUMMARY_CACHE__
+
+#include "../Audacity.h"
+#include "../MemoryX.h"
+
+#include <unordered_map>
+
+#include <wx/string.h>
+
+#include "audacity/Types.h"
+#include "../ondemand/ODTaskThread.h"
+
+/// Summaries of the blocks of aliased files, kept for the user across
+/// projects and sessions, so that importing a file again need not read it
+/// to draw its waveform.  All members are thread-safe.
+class PROFILE_DLL_API SummaryCache final {
+ public:
+   SummaryCache();
+   ~SummaryCache();
+
+   SummaryCache(const SummaryCache&) PROHIBITED;
+   SummaryCache &operator= (const SummaryCache&) PROHIBITED;
+
+   /// Bytes the entries may use on disk; zero stores and finds nothing
+   void SetBudget(unsigned long long bytes);
+
+   /// Copy the summary of len samples of one channel of the file, from
+   /// start, into summary, if stored before for the file as it is now.
+   /// Returns whether it was.
+   bool Fetch(const wxString &path, sampleCount start, size_t len,
+              int channel, void *summary, size_t bytes);
+
+   /// Store the summary; failures are ignored
+   void Store(const wxString &path, sampleCount start, size_t len,
+              int channel, const void *summary, size_t bytes);
+
+ private:
+   // These require the lock to be held
+   // Zero if the file can't be read
+   unsigned long long Identify(const wxString &path);
+   wxString EntryPath(unsigned long long key) const;
+   void Trim();
+
+   ODLock mLock;
+   const wxString mDir;
+   unsigned long long mBudget { 0 };
+   // Bytes of the entries, counted when first needed
+   unsigned long long mUsed { 0 };
+   bool mCounted { false };
+
+   // Of each file seen, its size and time, and the identity they had
+   struct Identity {
+      wxFileOffset size;
+      time_t modified;
+      unsigned long long hash;
+   };
+   std::unordered_map<wxString, Identity> mIdentities;
+};
+
+#endif
@@ -19,6 +19,16 @@ command string, and producing a suitable command object. For now, it doesn't
 actually do any processing - it just passes everything on to the BatchCommand
 system by constructing BatchCommandEval objects.
 
+\class PreparedCommand
+\brief A command string, parsed and checked once, from which commands are
+built with new parameter values.
+
+A script that sends the same command many times, or the same command
+with other values, pays for splitting the string, finding the command
+and checking the parameter names only once.  CommandBuilder keeps the
+commands of the last few strings it was given prepared, so a script
+sending the same string again is served from there.
+
 *//*******************************************************************/
 
 #include "../Audacity.h"
@@ -29,6 +39,154 @@ system by constructing BatchCommandEval objects.
 #include "CommandTargets.h"
 #include "ScriptCommandRelay.h"
 #include "CommandContext.h"
+#include "CommandSignature.h"
+
+#include <list>
+
+// Prepared commands of the most recent command strings
+static const size_t kPreparedCacheSize = 16;
+
+PreparedCommand::PreparedCommand()
+   : mParsed(false)
+   , mType(nullptr)
+{
+}
+
+bool PreparedCommand::Prepare(const wxString &cmdName,
+                              const wxString &cmdParams)
+{
+   mName = cmdName;
+   mParamString = cmdParams;
+   mParams.clear();
+   mParsed = false;
+   mError.clear();
+
+#ifdef OLD_BATCH_SYSTEM
+   mType = CommandDirectory::Get()->LookUp(cmdName);
+   if (mType == NULL)
+#endif
+      // Fall back to hoping the Batch Command system can handle it
+      mType = CommandDirectory::Get()->LookUp(wxT("BatchCommand"));
+   if (mType == NULL)
+   {
+      mError = wxT("Unknown command: '") + cmdName + wxT("'");
+      return false;
+   }
+
+   // The Batch Command system parses the string itself; it is split here
+   // only once a value is bound
+   if (mType->GetName() == wxT("BatchCommand"))
+      return true;
+   return ParseParams(cmdParams);
+}
+
+// Handling of quoted strings is quite limited.
+// You start and end with a " or a '.
+// There is no escaping in the string.
+bool PreparedCommand::ParseParams(const wxString &cmdParams)
+{
+   mParsed = true;
+#ifdef OLD_BATCH_SYSTEM
+   const bool check = mType->GetName() != wxT("BatchCommand");
+   const auto defaults = mType->GetSignature().GetDefaults();
+#endif
+   const auto end = cmdParams.end();
+   auto pos = cmdParams.begin();
+   const auto skipSpaces = [&]{
+      while (pos != end && wxIsspace(*pos))
+         ++pos;
+   };
+   skipSpaces();
+   while (pos != end)
+   {
+      const auto nameStart = pos;
+      while (pos != end && *pos != wxT('='))
+         ++pos;
+      if (pos == end)
+      {
+         mError = wxT("Parameter string is missing '='");
+         return false;
+      }
+      wxString name(nameStart, pos);
+#ifdef OLD_BATCH_SYSTEM
+      if (check && defaults.find(name) == defaults.end())
+      {
+         mError = wxT("Unrecognized parameter: '") + name + wxT("'");
+         return false;
+      }
+#endif
+      ++pos;
+
+      wxChar terminator = wxT(' ');
+      if (pos != end && (*pos == wxT('\"') || *pos == wxT('\'')))
+         terminator = *pos++;
+      const auto valueStart = pos;
+      while (pos != end && *pos != terminator)
+         ++pos;
+      mParams.emplace_back(std::move(name), wxString(valueStart, pos));
+      if (pos != end)
+         ++pos;
+      skipSpaces();
+   }
+   return true;
+}
+
+bool PreparedCommand::Bind(const wxString &paramName, const wxString &value)
+{
+#ifdef OLD_BATCH_SYSTEM
+   if (mType && mType->GetName() != wxT("BatchCommand"))
+   {
+      const auto defaults = mType->GetSignature().GetDefaults();
+      if (defaults.find(paramName) == defaults.end())
+      {
+         mError = wxT("Unrecognized parameter: '") + paramName + wxT("'");
+         return false;
+      }
+   }
+#endif
+   if (!mParsed && !ParseParams(mParamString))
+      return false;
+   // The string is made again from the parameters when next built
+   mParamString.clear();
+   for (auto &param : mParams)
+      if (param.first == paramName)
+      {
+         param.second = value;
+         return true;
+      }
+   mParams.emplace_back(paramName, value);
+   return true;
+}
+
+OldStyleCommandPointer PreparedCommand::Build()
+{
+   if (mType == NULL)
+      return {};
+   auto command = mType->Create(nullptr);
+
+   if (mType->GetName() == wxT("BatchCommand"))
+   {
+      if (mParamString.empty())
+         for (const auto &param : mParams)
+         {
+            // Quoted, with whichever quote the value lacks
+            const wxChar quote =
+               param.second.Find(wxT('"')) == wxNOT_FOUND ? wxT('"') : wxT('\'');
+            if (!mParamString.empty())
+               mParamString += wxT(' ');
+            mParamString += param.first + wxT('=') + quote + param.second + quote;
+         }
+      command->SetParameter(wxT("CommandName"), mName);
+      command->SetParameter(wxT("ParamString"), mParamString);
+      return command;
+   }
+
+   // Only the values are checked, by their validators
+   for (const auto &param : mParams)
+      if (!command->SetParameter(param.first, param.second))
+         return {};
+   return command;
+}
 
 CommandBuilder::CommandBuilder(const wxString &cmdString)
    : mValid(false)
@@ -77,112 +235,49 @@ void CommandBuilder::Success(const OldStyleCommandPointer &cmd)
    mValid = true;
 }
 
-void CommandBuilder::BuildCommand(const wxString &cmdName,
-                                  const wxString &cmdParamsArg)
+void CommandBuilder::BuildCommand(PreparedCommand &prepared)
 {
-   // Stage 1: create a Command object of the right type
+   auto command = prepared.Build();
+   if (!command)
+   {
+      Failure(prepared.GetErrorMessage());
+      return;
+   }
 
    auto scriptOutput = ScriptCommandRelay::GetResponseTarget();
    auto output
       = std::make_unique<CommandOutputTargets>(std::make_unique<NullProgressTarget>(),
                                 scriptOutput,
                                 scriptOutput);
+   mCommand = command;
+   auto aCommand = std::make_shared<ApplyAndSendResponse>(mCommand, output);
+   Success(aCommand);
+}
 
-#ifdef OLD_BATCH_SYSTEM
-   OldStyleCommandType *factory = CommandDirectory::Get()->LookUp(cmdName);
-
-   if (factory == NULL)
+void CommandBuilder::BuildCommand(const wxString &cmdName,
+                                  const wxString &cmdParamsArg)
+{
+   PreparedCommand prepared;
+   if (!prepared.Prepare(cmdName, cmdParamsArg))
    {
-      // Fall back to hoping the Batch Command system can handle it
-#endif
-      OldStyleCommandType *type = CommandDirectory::Get()->LookUp(wxT("BatchCommand"));
-      wxASSERT(type != NULL);
-      mCommand = type->Create(nullptr);
-      mCommand->SetParameter(wxT("CommandName"), cmdName);
-      mCommand->SetParameter(wxT("ParamString"), cmdParamsArg);
-      auto aCommand = std::make_shared<ApplyAndSendResponse>(mCommand, output);
-      Success(aCommand);
+      Failure(prepared.GetErrorMessage());
       return;
-#ifdef OLD_BATCH_SYSTEM
    }
+   BuildCommand(prepared);
+}
 
-   CommandSignature &signature = factory->GetSignature();
-   mCommand = factory->Create(nullptr);
-   //mCommand->SetOutput( std::move(output) );
-   // Stage 2: set the parameters
-
-   ShuttleCli shuttle;
-   shuttle.mParams = cmdParamsArg;
-   shuttle.mbStoreInClient = true;
-
-   ParamValueMap::const_iterator iter;
-   ParamValueMap params = signature.GetDefaults();
-
-   // Iterate through the parameters defined by the command
-   for (iter = params.begin(); iter != params.end(); ++iter)
-   {
-      wxString paramString;
-      // IF there is a match in the args actually used
-      if (shuttle.TransferString(iter->first, paramString, wxT("")))
-      {
-         // Then set that parameter.
-         if (!mCommand->SetParameter(iter->first, paramString))
-         {
-            Failure();
-            return;
-         }
-      }
-   }
-
-   // Check for unrecognised parameters
-
-   wxString cmdParams(cmdParamsArg);
-
-   while (cmdParams != wxEmptyString)
-   {
-      cmdParams.Trim(true);
-      cmdParams.Trim(false);
-      int splitAt = cmdParams.Find(wxT('='));
-      if (splitAt < 0 && cmdParams != wxEmptyString)
-      {
-         Failure(wxT("Parameter string is missing '='"));
-         return;
-      }
-      wxString paramName = cmdParams.Left(splitAt);
-      if (params.find(paramName) == params.end())
+void CommandBuilder::BuildCommand(const wxString &cmdStringArg)
+{
+   // Only the script thread builds from strings
+   static std::list< std::pair<wxString, PreparedCommand> > sPrepared;
+   for (auto iter = sPrepared.begin(); iter != sPrepared.end(); ++iter)
+      if (iter->first == cmdStringArg)
       {
-         Failure(wxT("Unrecognized parameter: '") + paramName + wxT("'"));
+         sPrepared.splice(sPrepared.begin(), sPrepared, iter);
+         BuildCommand(sPrepared.front().second);
          return;
       }
-      // Handling of quoted strings is quite limitted.
-      // You start and end with a " or a '.
-      // There is no escaping in the string.
-      cmdParams = cmdParams.Mid(splitAt+1);
-      if( cmdParams.IsEmpty() )
-         splitAt =-1;
-      else if( cmdParams[0] == '\"' ){
-         cmdParams = cmdParams.Mid(1);
-         splitAt = cmdParams.Find(wxT('\"'))+1;
-      }
-      else if( cmdParams[0] == '\'' ){
-         cmdParams = cmdParams.Mid(1);
-         splitAt = cmdParams.Find(wxT('\''))+1;
-      }
-      else
-         splitAt = cmdParams.Find(wxT(' '))+1;
-      if (splitAt < 1)
-      {
-         splitAt = cmdParams.Len();
-      }
-      cmdParams = cmdParams.Mid(splitAt);
-   }
-   auto aCommand = std::make_shared<ApplyAndSendResponse>(mCommand, output);
-   Success(aCommand);
-#endif
-}
 
-void CommandBuilder::BuildCommand(const wxString &cmdStringArg)
-{
    wxString cmdString(cmdStringArg);
 
    // Find the command name terminator...  If there is more than one word and
@@ -204,5 +299,14 @@ void CommandBuilder::BuildCommand(const wxString &cmdStringArg)
    cmdName.Trim(true);
    cmdParams.Trim(false);
 
-   BuildCommand(cmdName, cmdParams);
+   PreparedCommand prepared;
+   if (!prepared.Prepare(cmdName, cmdParams))
+   {
+      Failure(prepared.GetErrorMessage());
+      return;
+   }
+   sPrepared.emplace_front(cmdStringArg, std::move(prepared));
+   if (sPrepared.size() > kPreparedCacheSize)
+      sPrepared.pop_back();
+   BuildCommand(sPrepared.front().second);
 }
@@ -17,12 +17,45 @@
 #define __COMMANDBUILDER__
 
 #include "../MemoryX.h"
+#include <utility>
+#include <vector>
 #include <wx/string.h>
 
 class OldStyleCommand;
 using OldStyleCommandPointer = std::shared_ptr<OldStyleCommand>;
+class OldStyleCommandType;
 class wxString;
 
+// A command string parsed and checked once, which then builds commands
+// many times, with new values bound to its parameters, without parsing
+// the string again.
+
+class PreparedCommand
+{
+   private:
+      wxString mName;
+      // In the order of the string, and the string itself until a value
+      // is bound
+      std::vector< std::pair<wxString, wxString> > mParams;
+      wxString mParamString;
+      bool mParsed;
+      OldStyleCommandType *mType;
+      wxString mError;
+
+      bool ParseParams(const wxString &cmdParams);
+   public:
+      PreparedCommand();
+      // False if the command would not build; see GetErrorMessage()
+      bool Prepare(const wxString &cmdName, const wxString &cmdParams);
+      // Set the value of a parameter, adding it if the command string did
+      // not give it; false if the command has no such parameter
+      bool Bind(const wxString &paramName, const wxString &value);
+      // A new command, with the values bound so far, or null
+      OldStyleCommandPointer Build();
+      const wxString &GetName() const { return mName; }
+      const wxString &GetErrorMessage() const { return mError; }
+};
+
 // CommandBuilder has the task of validating and interpreting a command string.
 // If the string represents a valid command, it builds the command object.
 
@@ -37,6 +70,7 @@ class CommandBuilder
       void Success(const OldStyleCommandPointer &cmd);
       void BuildCommand(const wxString &cmdName, const wxString &cmdParams);
       void BuildCommand(const wxString &cmdString);
+      void BuildCommand(PreparedCommand &prepared);
    public:
       CommandBuilder(const wxString &cmdString);
       CommandBuilder(const wxString &cmdName,
@@ -130,6 +130,13 @@ inline CommandFlag operator | (CommandFlag lhs, CommandFlag rhs)
       static_cast<unsigned long long>(rhs)
    );
 }
+inline CommandFlag operator ^ (CommandFlag lhs, CommandFlag rhs)
+{
+   return static_cast<CommandFlag> (
+      static_cast<unsigned long long>(lhs) ^
+      static_cast<unsigned long long>(rhs)
+   );
+}
 inline CommandFlag & operator |= (CommandFlag &lhs, CommandFlag rhs)
 {
    lhs = lhs | rhs;
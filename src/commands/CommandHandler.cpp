@@ -55,6 +55,7 @@ void CommandHandler::OnReceiveCommand(AppCommandEvent &event)
    // different project.
    cmd->Apply(*mCurrentContext);
 
-   // Redraw the project
-   mCurrentContext->GetProject()->RedrawProject();
+   // Redraw the project, once after a run of pipelined commands
+   if (ScriptCommandRelay::FinishCommand())
+      mCurrentContext->GetProject()->RedrawProject();
 }
@@ -37,6 +37,15 @@
   the same as "don't care".  Any command whose mask is set to zero
   will not be affected by enabling/disabling by flags.
 
+  The commands themselves, with their names, labels, keys and the hashes
+  to find them by, are the same in every project, and are kept in a
+  CommandRegistry that the projects share: the first project to add its
+  commands makes them, reading the key of each from preferences, and the
+  projects opened after find them there.  Each project keeps only its
+  own menus and the state of each command in them.  A change of
+  preferences discards the shared registry, and the first project to
+  rebuild its menus makes a new one for the others.
+
 *//****************************************************************//**
 
 \class CommandFunctor
@@ -60,6 +69,16 @@ CommandManager.  It holds the callback for one command.
 
 *//****************************************************************//**
 
+\class CommandRegistry
+\brief The commands shared by the CommandManagers of all projects.
+
+*//****************************************************************//**
+
+\class CommandState
+\brief The state of a CommandListEntry in one project.
+
+*//****************************************************************//**
+
 \class MenuBarList
 \brief List of MenuBarListEntry.
 
@@ -80,6 +99,8 @@ CommandManager.  It holds the callback for one command.
 #include "CommandManager.h"
 #include "CommandContext.h"
 
+#include <algorithm>
+
 #include <wx/defs.h>
 #include <wx/eventfilter.h>
 #include <wx/hash.h>
@@ -417,8 +438,12 @@ private:
 ///
 ///  Standard Constructor
 ///
+namespace {
+// The registry the next project to add its commands shares
+std::shared_ptr<CommandRegistry> sSharedRegistry;
+}
+
 CommandManager::CommandManager():
-   mCurrentID(17000),
    mCurrentMenuName(COMMAND),
    mDefaultFlags(AlwaysEnabledFlag),
    mDefaultMask(AlwaysEnabledFlag),
@@ -528,19 +553,98 @@ void CommandManager::SetMaxList()
 
 void CommandManager::PurgeData()
 {
-   // mCommandList contains pointers to CommandListEntrys
+   // mCommandList contains pointers to CommandListEntrys of mRegistry
    // mMenuBarList contains MenuBarListEntrys.
    // mSubMenuList contains SubMenuListEntrys
    mCommandList.clear();
+   mStates.clear();
+   mModifiedLabels.clear();
+   mEnableStale.clear();
+   mEnabledValid = false;
    mMenuBarList.clear();
    mSubMenuList.clear();
 
-   mCommandNameHash.clear();
-   mCommandKeyHash.clear();
-   mCommandIDHash.clear();
+   // Other projects may still share it
+   mRegistry.reset();
 
    mCurrentMenuName = COMMAND;
-   mCurrentID = 17000;
+}
+
+void CommandManager::DiscardSharedCommands()
+{
+   sSharedRegistry.reset();
+}
+
+CommandRegistry &CommandManager::Registry()
+{
+   if (!mRegistry) {
+      if (!sSharedRegistry)
+         sSharedRegistry = std::make_shared<CommandRegistry>();
+      mRegistry = sSharedRegistry;
+   }
+   return *mRegistry;
+}
+
+CommandState &CommandManager::State(const CommandListEntry *entry)
+{
+   if (entry->ordinal >= mStates.size())
+      mStates.resize(mRegistry->commandList.size());
+   return mStates[entry->ordinal];
+}
+
+const CommandState *CommandManager::FindState(
+   const CommandListEntry *entry) const
+{
+   if (!entry || entry->ordinal >= mStates.size() ||
+       !mStates[entry->ordinal].added)
+      return nullptr;
+   return &mStates[entry->ordinal];
+}
+
+void CommandManager::AddToProject(CommandListEntry *entry, wxMenu *menu)
+{
+   auto &state = State(entry);
+   if (state.added)
+      return;
+   state.added = true;
+   state.menu = menu;
+   state.enabled = true;
+   mCommandList.push_back(entry);
+   mEnabledValid = false;
+}
+
+CommandListEntry *CommandManager::FindByName(const wxString &name) const
+{
+   if (!mRegistry)
+      return nullptr;
+   const auto &hash = mRegistry->commandNameHash;
+   const auto iter = hash.find(name);
+   if (iter == hash.end() || !FindState(iter->second))
+      return nullptr;
+   return iter->second;
+}
+
+CommandListEntry *CommandManager::FindByKey(
+   const NormalizedKeyString &key) const
+{
+   if (!mRegistry)
+      return nullptr;
+   const auto &hash = mRegistry->commandKeyHash;
+   const auto iter = hash.find(key);
+   if (iter == hash.end() || !FindState(iter->second))
+      return nullptr;
+   return iter->second;
+}
+
+CommandListEntry *CommandManager::FindByID(int id) const
+{
+   if (!mRegistry)
+      return nullptr;
+   const auto &hash = mRegistry->commandIDHash;
+   const auto iter = hash.find(id);
+   if (iter == hash.end() || !FindState(iter->second))
+      return nullptr;
+   return iter->second;
 }
 
 
@@ -848,7 +952,7 @@ void CommandManager::AddGlobalCommand(const wxChar *name,
       NewIdentifier(name, label_in, label_in, hasDialog, accel, NULL, finder, callback,
                     {}, 0, 0, {});
 
-   entry->enabled = false;
+   State(entry).enabled = false;
    entry->isGlobal = true;
    entry->flags = AlwaysEnabledFlag;
    entry->mask = AlwaysEnabledFlag;
@@ -872,6 +976,17 @@ int CommandManager::NextIdentifier(int ID)
    return ID;
 }
 
+// The name of an item of a list, clean for use by automation
+wxString CommandManager::MultiName(const wxString &name,
+                                   const wxString &nameSuffix)
+{
+   wxString cleanedName = wxString::Format(wxT("%s_%s"), name, nameSuffix);
+   cleanedName.Replace( "/", "" );
+   cleanedName.Replace( "&", "" );
+   cleanedName.Replace( " ", "" );
+   return cleanedName;
+}
+
 ///Given all of the information for a command, comes up with a NEW unique
 ///ID, adds it to a list, and returns the ID.
 ///WARNING: Does this conflict with the identifiers set for controls/windows?
@@ -917,14 +1032,32 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
 {
    const bool multi = !nameSuffix.empty();
    wxString name = nameIn;
+   auto &registry = Registry();
 
    // If we have the identifier already, reuse it.
-   CommandListEntry *prev = mCommandNameHash[name];
+   CommandListEntry *prev = registry.commandNameHash[name];
    if (!prev);
    else if( prev->label != label );
    else if( multi );
-   else
+   else {
+      AddToProject(prev, menu);
       return prev;
+   }
+
+   // An item of a list that another project made, found by its cleaned
+   // name, if this project has not added it already
+   if (multi) {
+      const auto found = registry.commandNameHash.find(
+         MultiName(name, nameSuffix));
+      if (found != registry.commandNameHash.end()) {
+         const auto entry = found->second;
+         if (entry && entry->multi && entry->index == index &&
+             entry->label == label && !State(entry).added) {
+            AddToProject(entry, menu);
+            return entry;
+         }
+      }
+   }
 
    {
       // Make a unique_ptr or shared_ptr as appropriate:
@@ -938,14 +1071,8 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
       // For key bindings for commands with a list, such as align,
       // the name in prefs is the category name plus the effect name.
       // This feature is not used for built-in effects.
-      if (multi) {
-         // The name needs to be clean for use by automation.
-         wxString cleanedName = wxString::Format(wxT("%s_%s"), name, nameSuffix);
-         cleanedName.Replace( "/", "" );
-         cleanedName.Replace( "&", "" );
-         cleanedName.Replace( " ", "" );
-         name = cleanedName;
-      }
+      if (multi)
+         name = MultiName(name, nameSuffix);
 
       // wxMac 2.5 and higher will do special things with the
       // Preferences, Exit (Quit), and About menu items,
@@ -956,8 +1083,9 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
       // (untranslated), not the label that actually appears in the
       // menu (which might be translated).
 
-      mCurrentID = NextIdentifier(mCurrentID);
-      entry->id = mCurrentID;
+      registry.currentID = NextIdentifier(registry.currentID);
+      entry->ordinal = registry.commandList.size();
+      entry->id = registry.currentID;
       entry->parameter = parameter;
 
 #if defined(__WXMAC__)
@@ -977,7 +1105,6 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
       entry->defaultKey = entry->key;
       entry->labelPrefix = labelPrefix;
       entry->labelTop = wxMenuItem::GetLabelText(mCurrentMenuName);
-      entry->menu = menu;
       entry->finder = finder;
       entry->callback = callback;
       entry->multi = multi;
@@ -985,7 +1112,6 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
       entry->count = count;
       entry->flags = mDefaultFlags;
       entry->mask = mDefaultMask;
-      entry->enabled = true;
       entry->skipKeydown = (accel.Find(wxT("\tskipKeydown")) != wxNOT_FOUND);
       entry->wantKeyup = (accel.Find(wxT("\twantKeyup")) != wxNOT_FOUND) || entry->skipKeydown;
       entry->isGlobal = false;
@@ -1007,16 +1133,17 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
       }
       gPrefs->SetPath(wxT("/"));
 
-      mCommandList.push_back(std::move(entry));
+      registry.commandList.push_back(std::move(entry));
       // Don't use the variable entry eny more!
    }
 
    // New variable
-   CommandListEntry *entry = &*mCommandList.back();
-   mCommandIDHash[entry->id] = entry;
+   CommandListEntry *entry = &*registry.commandList.back();
+   AddToProject(entry, menu);
+   registry.commandIDHash[entry->id] = entry;
 
 #if defined(__WXDEBUG__)
-   prev = mCommandNameHash[entry->name];
+   prev = registry.commandNameHash[entry->name];
    if (prev) {
       // Under Linux it looks as if we may ask for a newID for the same command
       // more than once.  So it's only an error if two different commands
@@ -1034,10 +1161,10 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
       }
    }
 #endif
-   mCommandNameHash[entry->name] = entry;
+   registry.commandNameHash[entry->name] = entry;
 
    if (!entry->key.empty()) {
-      mCommandKeyHash[entry->key] = entry;
+      registry.commandKeyHash[entry->key] = entry;
    }
 
    return entry;
@@ -1045,7 +1172,9 @@ CommandListEntry *CommandManager::NewIdentifier(const wxString & nameIn,
 
 wxString CommandManager::GetLabel(const CommandListEntry *entry) const
 {
-   wxString label = entry->label;
+   const auto modified = mModifiedLabels.find(entry);
+   wxString label = modified == mModifiedLabels.end()
+      ? entry->label : modified->second;
    if (!entry->key.empty())
    {
       label += wxT("\t") + entry->key.Raw();
@@ -1113,20 +1242,21 @@ wxString CommandManager::GetLabelWithDisabledAccel(const CommandListEntry *entry
 ///of them at once
 void CommandManager::Enable(CommandListEntry *entry, bool enabled)
 {
-   if (!entry->menu) {
-      entry->enabled = enabled;
+   auto &state = State(entry);
+   if (!state.menu) {
+      state.enabled = enabled;
       return;
    }
 
    // LL:  Refresh from real state as we can get out of sync on the
    //      Mac due to its reluctance to enable menus when in a modal
    //      state.
-   entry->enabled = entry->menu->IsEnabled(entry->id);
+   state.enabled = state.menu->IsEnabled(entry->id);
 
    // Only enabled if needed
-   if (entry->enabled != enabled) {
-      entry->menu->Enable(entry->id, enabled);
-      entry->enabled = entry->menu->IsEnabled(entry->id);
+   if (state.enabled != enabled) {
+      state.menu->Enable(entry->id, enabled);
+      state.enabled = state.menu->IsEnabled(entry->id);
    }
 
    if (entry->multi) {
@@ -1138,9 +1268,9 @@ void CommandManager::Enable(CommandListEntry *entry, bool enabled)
 
          // This menu item is not necessarily in the same menu, because
          // multi-items can be spread across multiple sub menus
-         CommandListEntry *multiEntry = mCommandIDHash[ID];
-         if (multiEntry) {
-            wxMenuItem *item = multiEntry->menu->FindItem(ID);
+         CommandListEntry *multiEntry = FindByID(ID);
+         if (multiEntry && State(multiEntry).menu) {
+            wxMenuItem *item = State(multiEntry).menu->FindItem(ID);
 
          if (item) {
             item->Enable(enabled);
@@ -1157,67 +1287,98 @@ void CommandManager::Enable(CommandListEntry *entry, bool enabled)
 
 void CommandManager::Enable(const wxString &name, bool enabled)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
-   if (!entry || !entry->menu) {
+   CommandListEntry *entry = FindByName(name);
+   if (!entry || !State(entry).menu) {
       wxLogDebug(wxT("Warning: Unknown command enabled: '%s'"),
                  (const wxChar*)name);
       return;
    }
 
    Enable(entry, enabled);
+   if (std::find(mEnableStale.begin(), mEnableStale.end(), entry) ==
+       mEnableStale.end())
+      mEnableStale.push_back(entry);
 }
 
 void CommandManager::EnableUsingFlags(CommandFlag flags, CommandMask mask)
 {
-   for(const auto &entry : mCommandList) {
+   // A command's state depends only on the flags in its mask, so unless
+   // the menus were rebuilt, only commands whose masks meet the flags
+   // that changed need a look.  Enable() asks the menu for the real state
+   // of each command it looks at, so the walk is worth saving.
+   const bool incremental = mEnabledValid && mask == mEnabledMask;
+   const auto changed =
+      incremental ? (flags ^ mEnabledFlags) : NoFlagsSpecifed;
+
+   std::vector<CommandListEntry*> stale;
+   stale.swap(mEnableStale);
+   auto update = [&](CommandListEntry *entry) {
       if (entry->multi && entry->index != 0)
-         continue;
+         return;
       if( entry->isOccult )
-         continue;
+         return;
 
       auto combinedMask = (mask & entry->mask);
       if (combinedMask) {
          bool enable = ((flags & combinedMask) ==
                         (entry->flags & combinedMask));
-         Enable(entry.get(), enable);
+         Enable(entry, enable);
+         // As on the Mac in a modal state; try again next time
+         if (State(entry).enabled != enable &&
+             std::find(mEnableStale.begin(), mEnableStale.end(), entry) ==
+                mEnableStale.end())
+            mEnableStale.push_back(entry);
       }
-   }
+   };
+
+   for(const auto &entry : mCommandList)
+      if (!incremental || (changed & entry->mask))
+         update(entry);
+   if (incremental)
+      for (auto entry : stale)
+         if (!(changed & entry->mask))
+            update(entry);
+
+   mEnabledValid = true;
+   mEnabledFlags = flags;
+   mEnabledMask = mask;
 }
 
 bool CommandManager::GetEnabled(const wxString &name)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
-   if (!entry || !entry->menu) {
+   CommandListEntry *entry = FindByName(name);
+   if (!entry || !State(entry).menu) {
       wxLogDebug(wxT("Warning: command doesn't exist: '%s'"),
                  (const wxChar*)name);
       return false;
    }
-   return entry->enabled;
+   return State(entry).enabled;
 }
 
 void CommandManager::Check(const wxString &name, bool checked)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
-   if (!entry || !entry->menu || entry->isOccult) {
+   CommandListEntry *entry = FindByName(name);
+   if (!entry || !State(entry).menu || entry->isOccult) {
       return;
    }
-   entry->menu->Check(entry->id, checked);
+   State(entry).menu->Check(entry->id, checked);
 }
 
 ///Changes the label text of a menu item
 void CommandManager::Modify(const wxString &name, const wxString &newLabel)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
-   if (entry && entry->menu) {
-      entry->label = newLabel;
-      entry->menu->SetLabel(entry->id, GetLabel(entry));
+   CommandListEntry *entry = FindByName(name);
+   if (entry && State(entry).menu) {
+      // The label is this project's; the registry keeps the one added
+      mModifiedLabels[entry] = newLabel;
+      State(entry).menu->SetLabel(entry->id, GetLabel(entry));
    }
 }
 
 void CommandManager::SetKeyFromName(const wxString &name,
                                     const NormalizedKeyString &key)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
+   CommandListEntry *entry = FindByName(name);
    if (entry) {
       entry->key = key;
    }
@@ -1341,7 +1502,7 @@ wxString CommandManager::DescribeCommandsAndShortcuts
 ///
 bool CommandManager::FilterKeyEvent(AudacityProject *project, const wxKeyEvent & evt, bool permit)
 {
-   CommandListEntry *entry = mCommandKeyHash[KeyEventToKeyString(evt)];
+   CommandListEntry *entry = FindByKey(KeyEventToKeyString(evt));
    if (entry == NULL)
    {
       return false;
@@ -1356,8 +1517,9 @@ bool CommandManager::FilterKeyEvent(AudacityProject *project, const wxKeyEvent &
       // rest of the command handling.  But, to use the common handler, we
       // enable them temporarily and then disable them again after handling.
       // LL:  Why do they need to be disabled???
-      entry->enabled = false;
-      auto cleanup = valueRestorer( entry->enabled, true );
+      auto &state = State(entry);
+      state.enabled = false;
+      auto cleanup = valueRestorer( state.enabled, true );
       return HandleCommandEntry(entry, NoFlagsSpecifed, NoFlagsSpecifed, &evt);
    }
 
@@ -1448,7 +1610,7 @@ bool CommandManager::FilterKeyEvent(AudacityProject *project, const wxKeyEvent &
 bool CommandManager::HandleCommandEntry(const CommandListEntry * entry,
                                         CommandFlag flags, CommandMask mask, const wxEvent * evt)
 {
-   if (!entry || !entry->enabled)
+   if (!entry || !State(entry).enabled)
       return false;
 
    auto proj = GetActiveProject();
@@ -1489,7 +1651,7 @@ bool CommandManager::HandleCommandEntry(const CommandListEntry * entry,
 #include "../prefs/KeyConfigPrefs.h"
 bool CommandManager::HandleMenuID(int id, CommandFlag flags, CommandMask mask)
 {
-   CommandListEntry *entry = mCommandIDHash[id];
+   CommandListEntry *entry = FindByID(id);
    return HandleCommandEntry( entry, flags, mask );
 }
 
@@ -1508,7 +1670,7 @@ bool CommandManager::HandleTextualCommand(const wxString & Str, CommandFlag flag
          // Testing against labelPrefix too allows us to call Nyquist functions by name.
          if( Str.IsSameAs( entry->name, false ) || Str.IsSameAs( entry->labelPrefix, false ))
          {
-            return HandleCommandEntry( entry.get(), flags, mask);
+            return HandleCommandEntry( entry, flags, mask);
          }
       }
       else
@@ -1516,7 +1678,7 @@ bool CommandManager::HandleTextualCommand(const wxString & Str, CommandFlag flag
          // Handle multis too...
          if( Str.IsSameAs( entry->name, false ) )
          {
-            return HandleCommandEntry( entry.get(), flags, mask);
+            return HandleCommandEntry( entry, flags, mask);
          }
       }
    }
@@ -1599,7 +1761,7 @@ void CommandManager::GetAllCommandData(
 
 wxString CommandManager::GetNameFromID(int id)
 {
-   CommandListEntry *entry = mCommandIDHash[id];
+   CommandListEntry *entry = FindByID(id);
    if (!entry)
       return wxT("");
    return entry->name;
@@ -1607,7 +1769,7 @@ wxString CommandManager::GetNameFromID(int id)
 
 wxString CommandManager::GetLabelFromName(const wxString &name)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
+   CommandListEntry *entry = FindByName(name);
    if (!entry)
       return wxT("");
 
@@ -1616,7 +1778,7 @@ wxString CommandManager::GetLabelFromName(const wxString &name)
 
 wxString CommandManager::GetPrefixedLabelFromName(const wxString &name)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
+   CommandListEntry *entry = FindByName(name);
    if (!entry)
       return wxT("");
 
@@ -1625,7 +1787,7 @@ wxString CommandManager::GetPrefixedLabelFromName(const wxString &name)
 
 wxString CommandManager::GetCategoryFromName(const wxString &name)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
+   CommandListEntry *entry = FindByName(name);
    if (!entry)
       return wxT("");
 
@@ -1634,9 +1796,7 @@ wxString CommandManager::GetCategoryFromName(const wxString &name)
 
 NormalizedKeyString CommandManager::GetKeyFromName(const wxString &name) const
 {
-   CommandListEntry *entry =
-      // May create a NULL entry
-      const_cast<CommandManager*>(this)->mCommandNameHash[name];
+   CommandListEntry *entry = FindByName(name);
    if (!entry)
       return {};
 
@@ -1645,7 +1805,7 @@ NormalizedKeyString CommandManager::GetKeyFromName(const wxString &name) const
 
 NormalizedKeyString CommandManager::GetDefaultKeyFromName(const wxString &name)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
+   CommandListEntry *entry = FindByName(name);
    if (!entry)
       return {};
 
@@ -1666,10 +1826,11 @@ void CommandManager::SetOccultCommands( bool bOccult)
 void CommandManager::SetCommandFlags(const wxString &name,
                                      CommandFlag flags, CommandMask mask)
 {
-   CommandListEntry *entry = mCommandNameHash[name];
+   CommandListEntry *entry = FindByName(name);
    if (entry) {
       entry->flags = flags;
       entry->mask = mask;
+      mEnabledValid = false;
    }
 }
 
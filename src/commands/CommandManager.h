@@ -59,8 +59,13 @@ struct SubMenuListEntry
    std::unique_ptr<wxMenu> menu;
 };
 
+// What a command is, the same in every project.  What it is in one
+// project, its menu and whether it is enabled, is a CommandState of that
+// project's CommandManager.
 struct CommandListEntry
 {
+   // Position in the CommandRegistry
+   size_t ordinal;
    int id;
    wxString name;
    wxString longLabel;
@@ -69,14 +74,12 @@ struct CommandListEntry
    wxString label;
    wxString labelPrefix;
    wxString labelTop;
-   wxMenu *menu;
    CommandHandlerFinder finder;
    CommandFunctorPointer callback;
    CommandParameter parameter;
    bool multi;
    int index;
    int count;
-   bool enabled;
    bool skipKeydown;
    bool wantKeyup;
    bool isGlobal;
@@ -119,6 +122,29 @@ using CommandKeyHash = std::unordered_map<NormalizedKeyString, CommandListEntry*
 using CommandNameHash = std::unordered_map<wxString, CommandListEntry*>;
 using CommandIDHash = std::unordered_map<int, CommandListEntry*>;
 
+/// The commands of the menus, with the hashes to find them by name, key
+/// and identifier.  Every project adds the same commands, so the first to
+/// add them makes the registry, and the projects opened after share it,
+/// finding each command there instead of making it again.  Entries are
+/// only added, never removed, while any project uses the registry.
+struct CommandRegistry
+{
+   CommandList commandList;
+   CommandNameHash commandNameHash;
+   CommandKeyHash commandKeyHash;
+   CommandIDHash commandIDHash;
+   int currentID { 17000 };
+};
+
+/// The state of one command in one project
+struct CommandState
+{
+   wxMenu *menu {};
+   bool enabled { false };
+   // Whether this project has the command at all
+   bool added { false };
+};
+
 class AudacityProject;
 class CommandContext;
 
@@ -139,6 +165,11 @@ class AUDACITY_DLL_API CommandManager final
    void SetMaxList();
    void PurgeData();
 
+   /// The commands the projects share were made under preferences that
+   /// have changed; the next project to add its commands makes them again,
+   /// and those that rebuild their menus after it share them.
+   static void DiscardSharedCommands();
+
    //
    // Creating menus and adding commands
    //
@@ -335,6 +366,7 @@ protected:
    //
 
    int NextIdentifier(int ID);
+   static wxString MultiName(const wxString &name, const wxString &nameSuffix);
    CommandListEntry *NewIdentifier(const wxString & name,
                                    const wxString & label,
                                    const wxString & longLabel,
@@ -370,6 +402,20 @@ protected:
 
    void Enable(CommandListEntry *entry, bool enabled);
 
+   //
+   // The registry, and the state of its commands in this project
+   //
+
+   CommandRegistry &Registry();
+   CommandState &State(const CommandListEntry *entry);
+   const CommandState *FindState(const CommandListEntry *entry) const;
+   void AddToProject(CommandListEntry *entry, wxMenu *menu);
+
+   // Commands of the registry that this project has added
+   CommandListEntry *FindByName(const wxString &name) const;
+   CommandListEntry *FindByKey(const NormalizedKeyString &key) const;
+   CommandListEntry *FindByID(int id) const;
+
    //
    // Accessing
    //
@@ -388,11 +434,14 @@ private:
 
    MenuBarList  mMenuBarList;
    SubMenuList  mSubMenuList;
-   CommandList  mCommandList;
-   CommandNameHash  mCommandNameHash;
-   CommandKeyHash mCommandKeyHash;
-   CommandIDHash  mCommandIDHash;
-   int mCurrentID;
+
+   std::shared_ptr<CommandRegistry> mRegistry;
+   // The commands this project has added, in the order added
+   std::vector<CommandListEntry*> mCommandList;
+   // Indexed by the ordinal of the entry
+   std::vector<CommandState> mStates;
+   // Labels changed by Modify(), as Undo and Redo name what they do
+   std::unordered_map<const CommandListEntry*, wxString> mModifiedLabels;
 
    bool mbSeparatorAllowed; // false at the start of a menu and immediately after a separator.
 
@@ -405,6 +454,15 @@ private:
    CommandFlag mDefaultFlags;
    CommandMask mDefaultMask;
    bool bMakingOccultCommands;
+
+   // What EnableUsingFlags() last applied, so that the next call need
+   // look only at commands that depend on flags changed since
+   bool mEnabledValid { false };
+   CommandFlag mEnabledFlags;
+   CommandMask mEnabledMask;
+   // Commands enabled by name since, or that a menu would not change;
+   // the next call looks at them too
+   std::vector<CommandListEntry*> mEnableStale;
 };
 
 #endif
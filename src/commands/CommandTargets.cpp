@@ -23,15 +23,92 @@ capture the more lengthy output from some commands.
 
 #include "../Audacity.h"
 #include "CommandTargets.h"
+#include <clocale>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <wx/string.h>
 #include "../ShuttleGui.h"
 #include "../Project.h"
 
+namespace {
+
+// Long responses to the script go in pieces of about this many bytes
+const size_t kResponsePieceBytes = 64 * 1024;
+
+// Strings are mostly ASCII, which needs no conversion
+void AppendUTF8( std::string &dest, const wxString &str, bool escaped )
+{
+   const auto start = dest.size();
+   for( const auto ch : str ){
+      const auto value = ch.GetValue();
+      if( value >= 0x80 ){
+         dest.resize( start );
+         const auto utf8 = str.utf8_str();
+         for( size_t ii = 0; ii < utf8.length(); ++ii ){
+            if( escaped && utf8.data()[ii] == '"' )
+               dest += '\\';
+            dest += utf8.data()[ii];
+         }
+         return;
+      }
+      if( escaped && value == '"' )
+         dest += '\\';
+      dest += char( value );
+   }
+}
+
+// As %g gives it, but always with a point, whatever the locale
+void AppendNumber( std::string &dest, double value )
+{
+   // Counts and indices, most of what is sent
+   if( value == std::floor( value ) && std::fabs( value ) < 1e6 &&
+       !( value == 0 && std::signbit( value ) ) ){
+      char digits[8];
+      char *p = digits + sizeof digits;
+      long n = std::abs( (long)value );
+      do
+         *--p = char( '0' + n % 10 );
+      while( n /= 10 );
+      if( value < 0 )
+         *--p = '-';
+      dest.append( p, digits + sizeof digits );
+      return;
+   }
+   char buffer[32];
+   const int len = snprintf( buffer, sizeof buffer, "%g", value );
+   const char point = *localeconv()->decimal_point;
+   for( int ii = 0; ii < len; ++ii )
+      dest += ( buffer[ii] == point ) ? '.' : buffer[ii];
+}
+
+}
+
+void CommandMessageTarget::UpdateUTF8(const char *utf8, size_t len)
+{
+   Update( wxString::FromUTF8( utf8, len ) );
+}
+
+void CommandMessageTarget::SendScratch()
+{
+   UpdateUTF8( mScratch.data(), mScratch.size() );
+   mScratch.clear();
+}
+
+void CommandMessageTarget::AppendName(const wxString &name)
+{
+   if( !name.IsEmpty() ){
+      AppendUTF8( mScratch, name, false );
+      mScratch += ':';
+   }
+}
+
 void CommandMessageTarget::StartArray()
 {
-   wxString Padding;
-   Padding.Pad( mCounts.GetCount() *2 -2);
-   Update( wxString::Format( "%s%s[ ", ( mCounts.Last() > 0 ) ? ",\n" : "\n", Padding ));
+   mScratch += ( mCounts.Last() > 0 ) ? ",\n" : "\n";
+   mScratch.append( mCounts.GetCount() *2 -2, ' ' );
+   mScratch += "[ ";
+   SendScratch();
    mCounts.Last() += 1;
    mCounts.push_back( 0 );
 }
@@ -40,12 +117,14 @@ void CommandMessageTarget::EndArray(){
    if( mCounts.GetCount() > 1 ){
       mCounts.pop_back();
    }
-   Update( " ]" );
+   mScratch += " ]";
+   SendScratch();
 }
 void CommandMessageTarget::StartStruct(){
-   wxString Padding;
-   Padding.Pad( mCounts.GetCount() *2 -2);
-   Update( wxString::Format( "%s%s{ ", ( mCounts.Last() > 0 ) ? ",\n" : "\n", Padding ));
+   mScratch += ( mCounts.Last() > 0 ) ? ",\n" : "\n";
+   mScratch.append( mCounts.GetCount() *2 -2, ' ' );
+   mScratch += "{ ";
+   SendScratch();
    mCounts.Last() += 1;
    mCounts.push_back( 0 );
 }
@@ -53,26 +132,47 @@ void CommandMessageTarget::EndStruct(){
    if( mCounts.GetCount() > 1 ){
       mCounts.pop_back();
    }
-   Update( " }" );
+   mScratch += " }";
+   SendScratch();
 }
 void CommandMessageTarget::AddItem(const wxString &value, const wxString &name){
-   wxString Padding;
-   Padding.Pad( mCounts.GetCount() *2 -2);
-   Padding = (( value.length() < 15 ) || (mCounts.Last()<=0))  ? "" : wxString("\n") + Padding;
-   Update( wxString::Format( "%s%s%s%s\"%s\"", (mCounts.Last()>0)?", ":"", Padding, name, !name.IsEmpty()?":":"",Escaped(value)));
+   if( mCounts.Last() > 0 ){
+      mScratch += ", ";
+      // Long values start a line of their own
+      if( value.length() >= 15 ){
+         mScratch += '\n';
+         mScratch.append( mCounts.GetCount() *2 -2, ' ' );
+      }
+   }
+   AppendName( name );
+   mScratch += '"';
+   AppendUTF8( mScratch, value, true );
+   mScratch += '"';
+   SendScratch();
    mCounts.Last() += 1;
 }
 void CommandMessageTarget::AddBool(const bool value,      const wxString &name){
-   Update( wxString::Format( "%s%s%s\"%s\"", (mCounts.Last()>0)?", ":"", name, !name.IsEmpty()?":":"",value?"true":"false"));
+   if( mCounts.Last() > 0 )
+      mScratch += ", ";
+   AppendName( name );
+   mScratch += value ? "\"true\"" : "\"false\"";
+   SendScratch();
    mCounts.Last() += 1;
 }
 void CommandMessageTarget::AddItem(const double value,    const wxString &name){
-   Update( wxString::Format( "%s%s%s%g", (mCounts.Last()>0)?", ":"", name, !name.IsEmpty()?":":"",value));
+   if( mCounts.Last() > 0 )
+      mScratch += ", ";
+   AppendName( name );
+   AppendNumber( mScratch, value );
+   SendScratch();
    mCounts.Last() += 1;
 }
 
 void CommandMessageTarget::StartField(const wxString &name){
-   Update( wxString::Format( "%s%s%s", (mCounts.Last()>0)?", ":"", name, !name.IsEmpty()?":":""));
+   if( mCounts.Last() > 0 )
+      mScratch += ", ";
+   AppendName( name );
+   SendScratch();
    mCounts.Last() += 1;
    mCounts.push_back( 0 );
 }
@@ -92,6 +192,31 @@ wxString CommandMessageTarget::Escaped( const wxString & str){
    return Temp;
 }
 
+void ResponseQueueTarget::UpdateUTF8(const char *utf8, size_t len)
+{
+   mBuffer.append( utf8, len );
+   // The script thread takes the pieces of a long response as it grows
+   if( mId < 0 && mBuffer.size() >= kResponsePieceBytes )
+      Send( true );
+}
+
+void ResponseQueueTarget::Send(bool partial)
+{
+   // Not the newline before the first item
+   if( !mStarted && !mBuffer.empty() ){
+      if( mBuffer[0] == '\n' )
+         mBuffer.erase( 0, 1 );
+      mStarted = true;
+   }
+   if( partial ){
+      // A copy, so that the buffer keeps its room for the next piece
+      mResponseQueue.AddResponse( Response( std::string( mBuffer ), mId, true ) );
+      mBuffer.clear();
+   }
+   else
+      mResponseQueue.AddResponse( Response( std::move( mBuffer ), mId, false ) );
+}
+
 
 
 void LispyCommandMessageTarget::StartArray()
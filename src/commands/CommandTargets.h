@@ -56,6 +56,7 @@ and sends it to that message target.
 #define __COMMANDTARGETS__
 
 #include "../MemoryX.h"
+#include <string>
 #include <wx/string.h>
 #include <wx/statusbr.h>
 //#include "../src/Project.h"
@@ -78,6 +79,9 @@ public:
    CommandMessageTarget() {mCounts.push_back(0);}
    virtual ~CommandMessageTarget() { Flush();}
    virtual void Update(const wxString &message) = 0;
+   /// Takes len bytes of UTF-8.  The JSON of the methods below comes this
+   /// way; by default it is converted for Update().
+   virtual void UpdateUTF8(const char *utf8, size_t len);
    virtual void StartArray();
    virtual void EndArray();
    virtual void StartStruct();
@@ -90,6 +94,13 @@ public:
    virtual void Flush();
    wxString Escaped( const wxString & str);
    wxArrayInt mCounts;
+
+protected:
+   // The JSON of one call, in a buffer kept for the next
+   std::string mScratch;
+   // The name, and a colon, of an item that has one
+   void AppendName( const wxString &name );
+   void SendScratch();
 };
 
 class CommandMessageTargetDecorator : public CommandMessageTarget
@@ -98,6 +109,8 @@ public:
    CommandMessageTargetDecorator( CommandMessageTarget & target): mTarget(target) {}
    ~CommandMessageTargetDecorator() override { }
    void Update(const wxString &message) override { mTarget.Update( message );}
+   void UpdateUTF8(const char *utf8, size_t len) override
+      { mTarget.UpdateUTF8( utf8, len );}
    void StartArray() override { mTarget.StartArray();}
    void EndArray() override { mTarget.EndArray();}
    void StartStruct() override { mTarget.StartStruct();}
@@ -229,23 +242,33 @@ class ResponseQueueTarget final : public CommandMessageTarget
 {
 private:
    ResponseQueue &mResponseQueue;
-   wxString mBuffer;
+   // UTF-8, as the script gets it
+   std::string mBuffer;
+   long mId;
+   bool mStarted;
+
+   void Send(bool partial);
 public:
-   ResponseQueueTarget(ResponseQueue &responseQueue)
+   // With an id, of a pipelined request, the response is sent in one
+   // piece; else it is sent in pieces as it grows, and followed by an
+   // empty line
+   ResponseQueueTarget(ResponseQueue &responseQueue, long id = -1)
       : mResponseQueue(responseQueue),
-       mBuffer( wxEmptyString )
+       mId( id ),
+       mStarted( false )
    { }
    virtual ~ResponseQueueTarget()
    {
-      if( mBuffer.StartsWith("\n" ) )
-         mBuffer = mBuffer.Mid( 1 );
-      mResponseQueue.AddResponse( mBuffer  );
-      mResponseQueue.AddResponse(wxString(wxT("\n")));
+      Send( false );
+      if( mId < 0 )
+         mResponseQueue.AddResponse(wxString(wxT("\n")));
    }
    void Update(const wxString &message) override
    {
-      mBuffer += message;
+      const auto utf8 = message.utf8_str();
+      UpdateUTF8( utf8.data(), utf8.length() );
    }
+   void UpdateUTF8(const char *utf8, size_t len) override;
 };
 
 /// Sends messages to two message targets at once
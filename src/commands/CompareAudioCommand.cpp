@@ -26,17 +26,90 @@ threshold of difference in two selected tracks
 #include "Command.h"
 
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
 #include <float.h>
+#include <vector>
 #include <wx/intl.h>
+#include <wx/thread.h>
 
 #include "../ShuttleGui.h"
 #include "../widgets/ErrorDialog.h"
 #include "../widgets/valnum.h"
 #include "../SampleFormat.h"
+#include "../MixerPool.h"
 #include "CommandContext.h"
 
+// Vector kernel counting the samples that differ by more than the
+// threshold.  As in Mix.cpp, SSE2 and NEON are chosen at compile time.
+// The differences are taken in double precision, as CompareSample()
+// takes them, so the counts are the same as the scalar loop's.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COMPARE_SIMD_SSE2
+#elif defined(__aarch64__)
+// 32 bit NEON has no double lanes
+#include <arm_neon.h>
+#define COMPARE_SIMD_NEON
+#endif
+
+namespace {
+
+size_t CountExceeding(
+   const float *buff0, const float *buff1, size_t len, double threshold)
+{
+   size_t count = 0;
+   size_t ii = 0;
+#if defined(COMPARE_SIMD_SSE2)
+   const __m128d sign = _mm_set1_pd(-0.0);
+   const __m128d limit = _mm_set1_pd(threshold);
+   // A true comparison is all bits set, which is -1, so subtracting it
+   // counts one
+   __m128i counts = _mm_setzero_si128();
+   for (; ii + 4 <= len; ii += 4) {
+      const __m128 v0 = _mm_loadu_ps(buff0 + ii);
+      const __m128 v1 = _mm_loadu_ps(buff1 + ii);
+      const __m128d low = _mm_sub_pd(_mm_cvtps_pd(v0), _mm_cvtps_pd(v1));
+      const __m128d high = _mm_sub_pd(
+         _mm_cvtps_pd(_mm_movehl_ps(v0, v0)),
+         _mm_cvtps_pd(_mm_movehl_ps(v1, v1)));
+      counts = _mm_sub_epi64(counts, _mm_castpd_si128(
+         _mm_cmpgt_pd(_mm_andnot_pd(sign, low), limit)));
+      counts = _mm_sub_epi64(counts, _mm_castpd_si128(
+         _mm_cmpgt_pd(_mm_andnot_pd(sign, high), limit)));
+   }
+   long long lanes[2];
+   _mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), counts);
+   count += lanes[0] + lanes[1];
+#elif defined(COMPARE_SIMD_NEON)
+   const float64x2_t limit = vdupq_n_f64(threshold);
+   uint64x2_t counts = vdupq_n_u64(0);
+   for (; ii + 4 <= len; ii += 4) {
+      const float32x4_t v0 = vld1q_f32(buff0 + ii);
+      const float32x4_t v1 = vld1q_f32(buff1 + ii);
+      const float64x2_t low = vabdq_f64(
+         vcvt_f64_f32(vget_low_f32(v0)), vcvt_f64_f32(vget_low_f32(v1)));
+      const float64x2_t high = vabdq_f64(
+         vcvt_high_f64_f32(v0), vcvt_high_f64_f32(v1));
+      counts = vsubq_u64(counts, vcgtq_f64(low, limit));
+      counts = vsubq_u64(counts, vcgtq_f64(high, limit));
+   }
+   count += vgetq_lane_u64(counts, 0) + vgetq_lane_u64(counts, 1);
+#endif
+   for (; ii < len; ++ii)
+      if (fabs((double)buff0[ii] - (double)buff1[ii]) > threshold)
+         ++count;
+   return count;
+}
+
+}
+
 bool CompareAudioCommand::DefineParams( ShuttleParams & S ){
    S.Define( errorThreshold,  wxT("Threshold"),   0.0f,  0.0f,    0.01f,    1.0f );
+   S.Define( mStopAtFirst,    wxT("StopAtFirst"), false );
+   S.Define( mQuickReject,    wxT("QuickReject"), false );
    return true;
 }
 
@@ -51,6 +124,8 @@ void CompareAudioCommand::PopulateOrExchange(ShuttleGui & S)
    S.StartMultiColumn(2, wxALIGN_CENTER);
    {
       S.TieTextBox(_("Threshold:"),errorThreshold);
+      S.TieCheckBox(_("Stop at First Mismatch"),mStopAtFirst);
+      S.TieCheckBox(_("Quick Reject"),mQuickReject);
    }
    S.EndMultiColumn();
 }
@@ -111,46 +186,112 @@ bool CompareAudioCommand::Apply(const CommandContext & context)
       + mTrack1->GetName() + wxT("'.");
    context.Status(msg);
 
-   long errorCount = 0;
-   // Initialize buffers for track data to be analyzed
+   // Compare the tracks block by block, no block longer than either
+   // track's blocks, so that most reads take whole block files
    auto buffSize = std::min(mTrack0->GetMaxBlockSize(), mTrack1->GetMaxBlockSize());
-
-   Floats buff0{ buffSize };
-   Floats buff1{ buffSize };
-
-   // Compare tracks block by block
    auto s0 = mTrack0->TimeToLongSamples(mT0);
    auto s1 = mTrack0->TimeToLongSamples(mT1);
-   auto position = s0;
    auto length = s1 - s0;
-   while (position < s1)
+
+   struct Range { sampleCount start; size_t len; };
+   std::vector<Range> ranges;
+   for (auto position = s0; position < s1;)
    {
-      // Get a block of data into the buffers
       auto block = limitSampleBufferSize(
-         mTrack0->GetBestBlockSize(position), s1 - position
+         std::min(mTrack0->GetBestBlockSize(position), buffSize), s1 - position
       );
-      mTrack0->Get((samplePtr)buff0.get(), floatSample, position, block);
-      mTrack1->Get((samplePtr)buff1.get(), floatSample, position, block);
-
-      for (decltype(block) buffPos = 0; buffPos < block; ++buffPos)
-      {
-         if (CompareSample(buff0[buffPos], buff1[buffPos]) > errorThreshold)
-         {
-            ++errorCount;
+      ranges.push_back({ position, block });
+      position += block;
+   }
+
+   // The blocks compare independently, so compare a batch of them on all
+   // cores at once
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   MixerPool pool{ unsigned(nThreads - 1) };
+   const size_t batch = 2 * nThreads;
+
+   ArrayOf<Floats> buffs0{ batch }, buffs1{ batch };
+   ArrayOf<size_t> counts{ batch };
+   std::vector<std::exception_ptr> errors(batch);
+   for (size_t ii = 0; ii < batch; ++ii) {
+      buffs0[ii].reinit(buffSize);
+      buffs1[ii].reinit(buffSize);
+   }
+
+   long errorCount = 0;
+   std::atomic<bool> mismatch{ false };
+   const bool quickReject = mStopAtFirst && mQuickReject;
+   for (size_t first = 0, nn = ranges.size(); first < nn; first += batch)
+   {
+      const auto count = std::min(batch, nn - first);
+      pool.Run(count, [&](size_t ii) {
+         counts[ii] = 0;
+         // Once a mismatch is found, the rest of the batch need not look
+         if (mStopAtFirst && mismatch.load(std::memory_order_relaxed))
+            return;
+         // Exceptions must not escape the helper threads
+         try {
+            const auto &range = ranges[first + ii];
+            if (quickReject) {
+               // If the peaks or the RMS differ by more than the
+               // threshold, so does some sample.  RMS sums round
+               // differently over different block layouts, hence the
+               // small allowance.
+               const auto t0 = mTrack0->LongSamplesToTime(range.start);
+               const auto t1 =
+                  mTrack0->LongSamplesToTime(range.start + range.len);
+               const auto minMax0 = mTrack0->GetMinMax(t0, t1);
+               const auto minMax1 = mTrack1->GetMinMax(t0, t1);
+               const auto rms0 = mTrack0->GetRMS(t0, t1);
+               const auto rms1 = mTrack1->GetRMS(t0, t1);
+               if (CompareSample(minMax0.first, minMax1.first) > errorThreshold ||
+                   CompareSample(minMax0.second, minMax1.second) > errorThreshold ||
+                   CompareSample(rms0, rms1) >
+                      errorThreshold + 1e-5 * std::max(rms0, rms1)) {
+                  counts[ii] = 1;
+                  mismatch.store(true, std::memory_order_relaxed);
+                  return;
+               }
+            }
+            mTrack0->Get((samplePtr)buffs0[ii].get(), floatSample,
+                         range.start, range.len);
+            mTrack1->Get((samplePtr)buffs1[ii].get(), floatSample,
+                         range.start, range.len);
+            counts[ii] = CountExceeding(buffs0[ii].get(), buffs1[ii].get(),
+                                        range.len, errorThreshold);
+            if (counts[ii] > 0)
+               mismatch.store(true, std::memory_order_relaxed);
+         }
+         catch (...) {
+            errors[ii] = std::current_exception();
          }
-      }
+      });
+      for (size_t ii = 0; ii < count; ++ii)
+         if (errors[ii])
+            std::rethrow_exception(errors[ii]);
 
-      position += block;
+      for (size_t ii = 0; ii < count; ++ii)
+         errorCount += counts[ii];
+
+      const auto &last = ranges[first + count - 1];
       context.Progress(
-         (position - s0).as_double() /
+         (last.start + last.len - s0).as_double() /
          length.as_double()
       );
+
+      if (mStopAtFirst && errorCount > 0)
+         break;
    }
 
    // Output the results
    double errorSeconds = mTrack0->LongSamplesToTime(errorCount);
    context.Status(wxString::Format(wxT("%li"), errorCount));
    context.Status(wxString::Format(wxT("%.4f"), errorSeconds));
-   context.Status(wxString::Format(wxT("Finished comparison: %li samples (%.3f seconds) exceeded the error threshold of %f."), errorCount, errorSeconds, errorThreshold));
+   if (mStopAtFirst && errorCount > 0)
+      // The count covers only the blocks compared, and a quick reject
+      // counts one for its whole block
+      context.Status(wxString::Format(wxT("Stopped comparison at the first mismatch: at least %li samples exceeded the error threshold of %f."), errorCount, errorThreshold));
+   else
+      context.Status(wxString::Format(wxT("Finished comparison: %li samples (%.3f seconds) exceeded the error threshold of %f."), errorCount, errorSeconds, errorThreshold));
    return true;
 }
@@ -42,6 +42,11 @@ public:
 
 private:
    double errorThreshold;
+   // Stop once any sample is known to exceed the threshold
+   bool mStopAtFirst;
+   // With mStopAtFirst, first compare each range's peaks and RMS, which
+   // can prove a mismatch without reading the samples
+   bool mQuickReject;
    double mT0, mT1;
    const WaveTrack *mTrack0;
    const WaveTrack *mTrack1;
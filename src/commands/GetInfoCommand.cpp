@@ -17,11 +17,15 @@ This class now lists
 - Clips
 - Labels
 - Boxes
+- Audio, the glitch counts of the last stream
+- BlockIO, the reading and writing of block files, by purpose
+- ProjectSize, the clips and blocks of each track, with suggestions
 
 *//*******************************************************************/
 
 #include "../Audacity.h"
 #include "GetInfoCommand.h"
+#include "../AudioIO.h"
 #include "../Project.h"
 #include "CommandManager.h"
 #include "../widgets/Overlay.h"
@@ -29,6 +33,13 @@ This class now lists
 #include "../TrackPanel.h"
 #include "../Track.h"
 #include "../WaveTrack.h"
+#include "../ondemand/ODManager.h"
+#include "../DirManager.h"
+#include "../blockfile/BlockIOStats.h"
+#include "../BlockFile.h"
+#include "../Sequence.h"
+#include "../UndoManager.h"
+#include "../WaveClip.h"
 #include "CommandContext.h"
 
 #include "SelectCommand.h"
@@ -46,6 +57,10 @@ enum {
    kClips,
    kLabels,
    kBoxes,
+   kAudio,
+   kOnDemand,
+   kBlockIO,
+   kProjectSize,
    nTypes
 };
 
@@ -56,7 +71,11 @@ static const wxString kTypes[nTypes] =
    XO("Tracks"),
    XO("Clips"),
    XO("Labels"),
-   XO("Boxes")
+   XO("Boxes"),
+   XO("Audio"),
+   XO("OnDemand"),
+   XO("BlockIO"),
+   XO("ProjectSize")
 };
 
 enum {
@@ -131,6 +150,10 @@ bool GetInfoCommand::ApplyInner(const CommandContext &context)
       case kTracks       : return SendTracks( context );
       case kClips        : return SendClips( context );
       case kBoxes        : return SendBoxes( context );
+      case kAudio        : return SendAudio( context );
+      case kOnDemand     : return SendOnDemand( context );
+      case kBlockIO      : return SendBlockIO( context );
+      case kProjectSize  : return SendProjectSize( context );
       default:
          context.Status( "Command options not recognised" );
    }
@@ -203,18 +226,219 @@ bool GetInfoCommand::SendBoxes(const CommandContext &context)
    return true;
 }
 
+bool GetInfoCommand::SendAudio(const CommandContext &context)
+{
+   const auto &t = gAudioIO->GetTelemetry();
+   context.StartStruct();
+   context.AddItem( (double)t.callbacks.load(), "callbacks" );
+   context.StartField( "load" );
+   context.StartArray();
+   for( const auto &bucket : t.loadHistogram )
+      context.AddItem( (double)bucket.load() );
+   context.EndArray();
+   context.EndField();
+   context.AddItem( t.maxLoad.load(), "maxload" );
+   context.AddItem( (double)t.inputUnderflows.load(), "inputunderflows" );
+   context.AddItem( (double)t.inputOverflows.load(), "inputoverflows" );
+   context.AddItem( (double)t.outputUnderflows.load(), "outputunderflows" );
+   context.AddItem( (double)t.outputOverflows.load(), "outputoverflows" );
+   if( t.minPlaybackFrames.load() != SIZE_MAX )
+      context.AddItem( (double)t.minPlaybackFrames.load(), "minplayback" );
+   if( t.minCaptureRoom.load() != SIZE_MAX )
+      context.AddItem( (double)t.minCaptureRoom.load(), "mincaptureroom" );
+   context.EndStruct();
+   return true;
+}
+
+bool GetInfoCommand::SendOnDemand(const CommandContext &context)
+{
+   context.StartArray();
+   if( ODManager::IsInstanceCreated() )
+   {
+      for( const auto &info : ODManager::Instance()->GetTaskInfo() )
+      {
+         context.StartStruct();
+         context.AddItem( info.taskName, "task" );
+         context.StartField( "tracks" );
+         context.StartArray();
+         for( const auto &name : info.trackNames )
+            context.AddItem( name );
+         context.EndArray();
+         context.EndField();
+         context.AddItem( info.progress.percentComplete * 100.0, "percent" );
+         context.AddItem( info.progress.blocksPerSecond, "blockspersecond" );
+         context.AddItem( info.progress.bytesPerSecond / 1000000.0, "mbpersecond" );
+         if( info.progress.secondsLeft >= 0 )
+            context.AddItem( info.progress.secondsLeft, "secondsleft" );
+         context.EndStruct();
+      }
+   }
+   context.EndArray();
+   return true;
+}
+
+// One struct for each purpose, of the counts for it
+static void SendIOStats( const CommandContext &context,
+   const BlockIOStats &stats, const char *name )
+{
+   context.StartField( name );
+   context.StartStruct();
+   for( int p = 0; p < BlockIOStats::nPurposes; ++p )
+   {
+      const auto purpose = BlockIOStats::Purpose( p );
+      context.StartField( BlockIOStats::PurposeName( purpose ) );
+      context.StartStruct();
+      for( int c = 0; c < BlockIOStats::nCounters; ++c )
+      {
+         const auto counter = BlockIOStats::Counter( c );
+         context.AddItem( (double)stats.Get( purpose, counter ),
+            BlockIOStats::CounterName( counter ) );
+      }
+      context.EndStruct();
+      context.EndField();
+   }
+   context.EndStruct();
+   context.EndField();
+}
+
+bool GetInfoCommand::SendBlockIO(const CommandContext &context)
+{
+   context.StartStruct();
+   SendIOStats( context, BlockIOStats::Program(), "program" );
+   SendIOStats( context,
+      context.GetProject()->GetDirManager()->GetIOStats(), "project" );
+   context.EndStruct();
+   return true;
+}
+
+// One struct for each channel of each wave track, of what makes it slow
+// to edit, draw and save, and what to do about it, and whether its block
+// arrays pass a full consistency check
+bool GetInfoCommand::SendProjectSize(const CommandContext &context)
+{
+   // Blocks by length, as a share of the most a block may hold: over a
+   // half, then at most a half, a quarter, an eighth, and less.  Those
+   // under a quarter are counted as fragments.
+   static const char *const sizeNames[] =
+      { "overhalf", "half", "quarter", "eighth", "smaller" };
+   enum { nSizes = sizeof(sizeNames) / sizeof(*sizeNames) };
+
+   AudacityProject *project = context.GetProject();
+   TrackListOfKindIterator iter(Track::Wave, project->GetTracks());
+   context.StartArray();
+   for (Track *t = iter.First(); t; t = iter.Next())
+   {
+      WaveTrack *track = static_cast<WaveTrack*>(t);
+      const auto maxBlockSize = track->GetMaxBlockSize();
+
+      size_t clips = 0, cutLines = 0, unloadedClips = 0;
+      size_t blocks = 0, fragments = 0;
+      size_t sizes[nSizes] = {};
+      size_t simple = 0, alias = 0, onDemand = 0, summaries = 0;
+      unsigned long long diskBytes = 0;
+      bool consistent = true;
+      for (const auto &clip : track->GetAllClips())
+      {
+         ++clips;
+         cutLines += clip->NumCutLines();
+
+         // Read through a const clip, not to unshare its blocks; leave
+         // lazily opened blocks unmade
+         const WaveClip *constClip = clip;
+         const Sequence *sequence = constClip->GetSequence();
+         if (!sequence->IsBlockArrayLoaded())
+         {
+            ++unloadedClips;
+            continue;
+         }
+         // Edits check only the blocks they change; this checks them all
+         if (!sequence->ConsistencyCheck(wxT("Get Info"), false))
+            consistent = false;
+         for (const auto &block : sequence->GetBlockArray())
+         {
+            const auto &file = block.f;
+            ++blocks;
+            const auto len = file->GetLength();
+            int size = 0;
+            while (size + 1 < nSizes && len <= (maxBlockSize >> (size + 1)))
+               ++size;
+            ++sizes[size];
+            if (len < maxBlockSize / 4)
+               ++fragments;
+
+            if (!file->IsDataAvailable() || !file->IsSummaryAvailable())
+               ++onDemand;
+            else if (file->IsAlias())
+               ++alias;
+            else
+               ++simple;
+            if (file->IsSummaryAvailable())
+               ++summaries;
+            diskBytes += file->GetSpaceUsage();
+         }
+      }
+      // Cut lines are clips too, in GetAllClips()
+      clips -= cutLines;
+
+      const auto undoBytes =
+         project->GetUndoManager()->EstimateTrackMemory(track->GetId());
+      const double fragmentation = blocks ? (double)fragments / blocks : 0;
+
+      context.StartStruct();
+      context.AddItem( track->GetName(), "name" );
+      context.AddItem( (double)clips, "clips" );
+      context.AddItem( (double)cutLines, "cutlines" );
+      context.AddItem( (double)blocks, "blocks" );
+      context.AddBool( consistent, "consistent" );
+      context.AddItem( (double)maxBlockSize, "maxblocksize" );
+      context.StartField( "blocksizes" );
+      context.StartStruct();
+      for (int size = 0; size < nSizes; ++size)
+         context.AddItem( (double)sizes[size], sizeNames[size] );
+      context.EndStruct();
+      context.EndField();
+      context.AddItem( fragmentation, "fragmentation" );
+      context.AddItem( (double)simple, "simpleblocks" );
+      context.AddItem( (double)alias, "aliasblocks" );
+      context.AddItem( (double)onDemand, "ondemandblocks" );
+      context.AddItem( (double)track->GetODFlags(), "odflags" );
+      context.AddItem( blocks ? (double)summaries / blocks : 1.0,
+         "summarycoverage" );
+      if (unloadedClips)
+         context.AddItem( (double)unloadedClips, "unloadedclips" );
+      context.AddItem( (double)diskBytes, "diskbytes" );
+      context.AddItem( (double)undoBytes, "undomemory" );
+
+      // What would make the track quicker, worst first
+      context.StartField( "suggestions" );
+      context.StartArray();
+      if (blocks >= 64 && fragmentation > 0.25)
+         context.AddItem( _("Compact the track: many of its blocks are small. "
+            "Mix and Render rewrites it in full blocks.") );
+      if (clips > 100)
+         context.AddItem( _("Join the clips: drawing and playing visit each one.") );
+      if (cutLines > 0)
+         context.AddItem( _("Remove the cut lines, whose hidden audio is kept.") );
+      if (undoBytes > 64 * 1024 * 1024)
+         context.AddItem( _("Discard old Undo History, which holds copies of the track.") );
+      context.EndArray();
+      context.EndField();
+      context.EndStruct();
+   }
+   context.EndArray();
+   return true;
+}
+
 bool GetInfoCommand::SendTracks(const CommandContext & context)
 {
    TrackList *projTracks = context.GetProject()->GetTracks();
    TrackListIterator iter(projTracks);
    Track *trk = iter.First();
+   TrackPanel *panel = context.GetProject()->GetTrackPanel();
+   Track * fTrack = panel->GetFocusedTrack();
    context.StartArray();
    while (trk)
    {
-
-      TrackPanel *panel = context.GetProject()->GetTrackPanel();
-      Track * fTrack = panel->GetFocusedTrack();
-
       context.StartStruct();
       context.AddItem( trk->GetName(), "name" );
       context.AddBool( (trk == fTrack), "focused");
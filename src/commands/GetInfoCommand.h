@@ -52,6 +52,10 @@ private:
    bool SendTracks(const CommandContext & context);
    bool SendClips(const CommandContext & context);
    bool SendBoxes(const CommandContext & context);
+   bool SendAudio(const CommandContext & context);
+   bool SendOnDemand(const CommandContext & context);
+   bool SendBlockIO(const CommandContext & context);
+   bool SendProjectSize(const CommandContext & context);
 
    void ExploreMenu( const CommandContext &context, wxMenu * pMenu, int Id, int depth );
    void ExploreTrackPanel( const CommandContext & context,
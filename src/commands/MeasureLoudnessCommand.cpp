@@ -0,0 +1,101 @@
+/**********************************************************************
+
+   Audacity - A Digital Audio Editor
+   Copyright 1999-2018 Audacity Team
+   File License: wxWidgets
+
+******************************************************************//**
+
+\file MeasureLoudnessCommand.cpp
+\brief Contains the definition of the MeasureLoudnessCommand class
+
+For the checks of a delivery, run headless over many files: the script
+imports each, and asks for the measures of each track.  The second
+channel of a stereo track is measured with the first, as BS.1770 sums
+the channels.  An End of zero measures to the end of the track.  A
+level of silence is reported as "-inf".
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "MeasureLoudnessCommand.h"
+
+#include <cmath>
+
+#include "../LoudnessAnalysis.h"
+#include "../Project.h"
+#include "../Track.h"
+#include "../WaveTrack.h"
+#include "../ShuttleGui.h"
+#include "CommandContext.h"
+
+namespace {
+
+void AddLevel(const CommandContext & context, double value, const wxString &name)
+{
+   if (std::isfinite(value))
+      context.AddItem( value, name );
+   else
+      context.AddItem( wxString{ wxT("-inf") }, name );
+}
+
+}
+
+bool MeasureLoudnessCommand::DefineParams( ShuttleParams & S ){
+   S.Define( mTrackIndex, wxT("Track"),    0, 0, 100 );
+   S.Define( mT0,         wxT("Start"),    0.0, 0.0, 1e12 );
+   S.Define( mT1,         wxT("End"),      0.0, 0.0, 1e12 );
+   return true;
+}
+
+void MeasureLoudnessCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieNumericTextBox(_("Track:"),mTrackIndex);
+      S.TieNumericTextBox(_("Start Time:"),mT0);
+      S.TieNumericTextBox(_("End Time:"),mT1);
+   }
+   S.EndMultiColumn();
+}
+
+bool MeasureLoudnessCommand::Apply(const CommandContext & context)
+{
+   // Tracks are counted as SetTrackBase counts channels
+   WaveTrack *track = nullptr;
+   Track *t = mTrackIndex >= 0
+      ? context.GetProject()->GetTracks()->GetTrack(mTrackIndex)
+      : nullptr;
+   if (t && t->GetKind() == Track::Wave)
+      track = static_cast<WaveTrack *>(t);
+   if (!track)
+   {
+      context.Error(wxString::Format(wxT("Track %d is not a wave track"), mTrackIndex));
+      return false;
+   }
+
+   const WaveTrack *right = nullptr;
+   if (track->GetLinked() && track->GetLink() &&
+       track->GetLink()->GetKind() == Track::Wave)
+      right = static_cast<const WaveTrack *>(track->GetLink());
+
+   const double t1 = mT1 > 0.0 ? mT1 : track->GetEndTime();
+   if (t1 < mT0)
+   {
+      context.Error(wxT("End time is before start time"));
+      return false;
+   }
+
+   const auto measures = MeasureLoudness(*track, right, mT0, t1);
+
+   context.StartStruct();
+   AddLevel( context, measures.integratedLUFS, wxT("integrated") );
+   AddLevel( context, measures.truePeakDB, wxT("truepeak") );
+   AddLevel( context, measures.samplePeakDB, wxT("samplepeak") );
+   AddLevel( context, measures.rmsDB, wxT("rms") );
+   context.AddItem( right ? 2.0 : 1.0, wxT("channels") );
+   context.EndStruct();
+   return true;
+}
@@ -0,0 +1,43 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   File License: wxwidgets
+
+   MeasureLoudnessCommand.h
+
+******************************************************************//**
+
+\class MeasureLoudnessCommand
+\brief Command for measuring the loudness, true peak, sample peak and RMS
+of a track
+
+*//*******************************************************************/
+
+#ifndef __MEASURE_LOUDNESS_COMMAND__
+#define __MEASURE_LOUDNESS_COMMAND__
+
+#include "Command.h"
+#include "CommandType.h"
+
+#define MEASURE_LOUDNESS_PLUGIN_SYMBOL XO("Measure Loudness")
+
+class MeasureLoudnessCommand : public AudacityCommand
+{
+public:
+   // CommandDefinitionInterface overrides
+   wxString GetSymbol() override {return MEASURE_LOUDNESS_PLUGIN_SYMBOL;};
+   wxString GetDescription() override {return _("Measures the integrated loudness, true peak, sample peak and RMS of a track.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Extra_Menu:_Tools#measure_loudness");};
+public:
+   int mTrackIndex;
+   double mT0;
+   double mT1;
+};
+
+#endif /* End of include guard: __MEASURE_LOUDNESS_COMMAND__ */
@@ -0,0 +1,286 @@
+/**********************************************************************
+
+   Audacity - A Digital Audio Editor
+   Copyright 1999-2018 Audacity Team
+   File License: wxWidgets
+
+******************************************************************//**
+
+\file RenderSegmentCommands.cpp
+\brief Contains the definitions of the RenderSegmentCommand and
+StitchSegmentsCommand classes
+
+A long master renders on many machines at once.  Each runs headless, on
+storage shared with the others, opens the same project, and renders one
+segment with Render Segment; then one of them joins the segments with
+Stitch Segments.  Handing out the segments and collecting the results is
+left to the script that drives them.
+
+Segments meet on the sample grid of the project rate: Start and End are
+rounded to samples, and a segment holds exactly the samples from the
+one to the other, padded with silence where the tracks end sooner.  The
+mix starts PreRoll seconds before the segment and runs PostRoll seconds
+past it, and those samples are dropped, so that the resamplers settle
+as they would in one pass; where no track is resampled, the stitched
+file equals a single render sample for sample.
+
+The files are 32 bit float, so that the stitch loses nothing, in a
+container chosen by the extension: W64, CAF or AIFF, else WAV.  WAV is
+limited to 4 GiB, which a long master of many channels passes.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "RenderSegmentCommands.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <wx/file.h>
+#include <wx/tokenzr.h>
+
+#include "../FileFormats.h"
+#include "../Mix.h"
+#include "../Project.h"
+#include "../Track.h"
+#include "../WaveTrack.h"
+#include "../ShuttleGui.h"
+#include "CommandContext.h"
+
+namespace {
+
+// Frames mixed or copied at once
+const size_t kSegmentBufferFrames = 65536;
+
+int FormatForFile(const wxString &fileName)
+{
+   const auto extension = fileName.AfterLast(wxT('.')).Lower();
+   int major = SF_FORMAT_WAV;
+   if (extension == wxT("w64"))
+      major = SF_FORMAT_W64;
+   else if (extension == wxT("caf"))
+      major = SF_FORMAT_CAF;
+   else if (extension == wxT("aif") || extension == wxT("aiff"))
+      major = SF_FORMAT_AIFF;
+   return major | SF_FORMAT_FLOAT;
+}
+
+// Use the descriptor of a wxFile, as ExportPCM does, for names that
+// libsndfile can't open under Windows
+bool OpenForWrite(const wxString &fileName, unsigned channels, double rate,
+                  wxFile &file, SFFile &sf)
+{
+   SF_INFO info;
+   memset(&info, 0, sizeof(info));
+   info.samplerate = (int)(rate + 0.5);
+   info.channels = channels;
+   info.format = FormatForFile(fileName);
+   if (!sf_format_check(&info) || !file.Create(fileName, true))
+      return false;
+   sf.reset(SFCall<SNDFILE*>(sf_open_fd, file.fd(), SFM_WRITE, &info, FALSE));
+   return bool(sf);
+}
+
+bool Write(SFFile &sf, const float *frames, size_t count)
+{
+   return SFCall<sf_count_t>(sf_writef_float, sf.get(), frames,
+      (sf_count_t)count) == (sf_count_t)count;
+}
+
+}
+
+bool RenderSegmentCommand::DefineParams( ShuttleParams & S ){
+   S.Define( mFileName,   wxT("Filename"),    "segment.wav" );
+   S.Define( mT0,         wxT("Start"),       0.0, 0.0, 1e12 );
+   S.Define( mT1,         wxT("End"),         0.0, 0.0, 1e12 );
+   S.Define( mPreRoll,    wxT("PreRoll"),     1.0, 0.0, 60.0 );
+   S.Define( mPostRoll,   wxT("PostRoll"),    1.0, 0.0, 60.0 );
+   S.Define( mnChannels,  wxT("NumChannels"), 2, 1, 32 );
+   return true;
+}
+
+void RenderSegmentCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieTextBox(_("File Name:"),mFileName);
+      S.TieNumericTextBox(_("Start Time:"),mT0);
+      S.TieNumericTextBox(_("End Time:"),mT1);
+      S.TieNumericTextBox(_("Pre-roll:"),mPreRoll);
+      S.TieNumericTextBox(_("Post-roll:"),mPostRoll);
+      S.TieNumericTextBox(_("Number of Channels:"),mnChannels);
+   }
+   S.EndMultiColumn();
+}
+
+bool RenderSegmentCommand::Apply(const CommandContext & context)
+{
+   const auto project = context.GetProject();
+   const double rate = project->GetRate();
+   const auto tracks =
+      project->GetTracks()->GetWaveTrackConstArray(false, false);
+   if (tracks.empty())
+   {
+      context.Error(wxT("There are no unmuted wave tracks to render"));
+      return false;
+   }
+
+   const sampleCount s0{ std::floor(mT0 * rate + 0.5) };
+   const sampleCount s1{ std::floor(mT1 * rate + 0.5) };
+   if (s1 <= s0)
+   {
+      context.Error(wxT("End time is not after start time"));
+      return false;
+   }
+   const auto pre =
+      limitSampleBufferSize(size_t(mPreRoll * rate + 0.5), s0);
+   const double start = (s0 - pre).as_double() / rate;
+   const double stop = s1.as_double() / rate + mPostRoll;
+
+   const unsigned channels = std::max(1, mnChannels);
+   wxFile file;
+   SFFile sf;
+   if (!OpenForWrite(mFileName, channels, rate, file, sf))
+   {
+      context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+      return false;
+   }
+
+   Mixer mixer(tracks, true, start, stop, channels, kSegmentBufferFrames,
+               true, rate, floatSample);
+
+   const auto total = s1 - s0;
+   auto skip = sampleCount{ pre };
+   auto left = total;
+   while (left > 0) {
+      const auto got = mixer.Process(kSegmentBufferFrames);
+      if (got == 0)
+         break;
+      const auto buffer = (const float *)mixer.GetBuffer();
+      const auto from = limitSampleBufferSize(got, skip);
+      skip -= from;
+      const auto count = limitSampleBufferSize(got - from, left);
+      if (count > 0 && !Write(sf, buffer + from * channels, count))
+      {
+         context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+         return false;
+      }
+      left -= count;
+      context.Progress(1.0 - left.as_double() / total.as_double());
+   }
+
+   // The tracks ended before the segment
+   if (left > 0) {
+      Floats silence{ kSegmentBufferFrames * channels, true };
+      while (left > 0) {
+         const auto count = limitSampleBufferSize(kSegmentBufferFrames, left);
+         if (!Write(sf, silence.get(), count))
+         {
+            context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+            return false;
+         }
+         left -= count;
+      }
+   }
+
+   if (sf.close() != 0)
+   {
+      context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+      return false;
+   }
+   context.Status(wxString::Format(wxT("Rendered %lld samples to %s"),
+      total.as_long_long(), mFileName));
+   return true;
+}
+
+bool StitchSegmentsCommand::DefineParams( ShuttleParams & S ){
+   S.Define( mSegments,  wxT("Segments"),  "" );
+   S.Define( mFileName,  wxT("Filename"),  "stitched.wav" );
+   return true;
+}
+
+void StitchSegmentsCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieTextBox(_("Segments:"),mSegments);
+      S.TieTextBox(_("File Name:"),mFileName);
+   }
+   S.EndMultiColumn();
+}
+
+bool StitchSegmentsCommand::Apply(const CommandContext & context)
+{
+   const auto names = wxStringTokenize(mSegments, wxT("|"), wxTOKEN_STRTOK);
+   if (names.empty())
+   {
+      context.Error(wxT("No segments to stitch"));
+      return false;
+   }
+
+   wxFile outFile;
+   SFFile out;
+   int channels = 0, rate = 0;
+   Floats buffer;
+   sampleCount total = 0;
+   for (size_t ii = 0; ii < names.size(); ++ii) {
+      const auto &name = names[ii];
+      wxFile inFile;
+      SF_INFO info;
+      memset(&info, 0, sizeof(info));
+      SFFile in;
+      if (inFile.Open(name))
+         in.reset(SFCall<SNDFILE*>(sf_open_fd, inFile.fd(), SFM_READ, &info, FALSE));
+      if (!in)
+      {
+         context.Error(wxString::Format(wxT("Could not read %s"), name));
+         return false;
+      }
+
+      if (ii == 0) {
+         channels = info.channels;
+         rate = info.samplerate;
+         buffer.reinit(kSegmentBufferFrames * channels);
+         if (!OpenForWrite(mFileName, channels, rate, outFile, out))
+         {
+            context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+            return false;
+         }
+      }
+      else if (info.channels != channels || info.samplerate != rate)
+      {
+         context.Error(wxString::Format(
+            wxT("%s does not match the channels and rate of the first segment"),
+            name));
+         return false;
+      }
+
+      for (;;) {
+         const auto got = SFCall<sf_count_t>(sf_readf_float, in.get(),
+            buffer.get(), (sf_count_t)kSegmentBufferFrames);
+         if (got <= 0)
+            break;
+         if (!Write(out, buffer.get(), got))
+         {
+            context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+            return false;
+         }
+         total += got;
+      }
+      context.Progress(double(ii + 1) / names.size());
+   }
+
+   if (out.close() != 0)
+   {
+      context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+      return false;
+   }
+   context.Status(wxString::Format(wxT("Stitched %d segments, %lld samples, to %s"),
+      (int)names.size(), total.as_long_long(), mFileName));
+   return true;
+}
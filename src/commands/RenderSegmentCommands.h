@@ -0,0 +1,69 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   File License: wxwidgets
+
+   RenderSegmentCommands.h
+
+******************************************************************//**
+
+\class RenderSegmentCommand
+\brief Command for rendering the mix of the project over a time range, on
+its own, so that other processes may render the rest
+
+\class StitchSegmentsCommand
+\brief Command for joining rendered segments into one file
+
+*//*******************************************************************/
+
+#ifndef __RENDER_SEGMENT_COMMANDS__
+#define __RENDER_SEGMENT_COMMANDS__
+
+#include "Command.h"
+#include "CommandType.h"
+
+#define RENDER_SEGMENT_PLUGIN_SYMBOL XO("Render Segment")
+
+class RenderSegmentCommand : public AudacityCommand
+{
+public:
+   // CommandDefinitionInterface overrides
+   wxString GetSymbol() override {return RENDER_SEGMENT_PLUGIN_SYMBOL;};
+   wxString GetDescription() override {return _("Renders the mix of a time range to a file, to be stitched to the others.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Export");};
+public:
+   wxString mFileName;
+   double mT0;
+   double mT1;
+   double mPreRoll;
+   double mPostRoll;
+   int mnChannels;
+};
+
+#define STITCH_SEGMENTS_PLUGIN_SYMBOL XO("Stitch Segments")
+
+class StitchSegmentsCommand : public AudacityCommand
+{
+public:
+   // CommandDefinitionInterface overrides
+   wxString GetSymbol() override {return STITCH_SEGMENTS_PLUGIN_SYMBOL;};
+   wxString GetDescription() override {return _("Joins rendered segments, in order, into one file.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Export");};
+public:
+   // Separated by '|'
+   wxString mSegments;
+   wxString mFileName;
+};
+
+#endif /* End of include guard: __RENDER_SEGMENT_COMMANDS__ */
@@ -44,3 +44,20 @@ Response ResponseQueue::WaitAndGetResponse()
    mResponses.pop();
    return msg;
 }
+
+bool ResponseQueue::WaitAndGetResponse(Response &response, int msWait)
+{
+   wxMutexLocker locker(mMutex);
+   if (msWait < 0) {
+      while (mResponses.empty())
+         mCondition.Wait();
+   }
+   else if (mResponses.empty())
+      mCondition.WaitTimeout(msWait);
+
+   if (mResponses.empty())
+      return false;
+   response = mResponses.front();
+   mResponses.pop();
+   return true;
+}
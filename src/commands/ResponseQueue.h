@@ -46,15 +46,29 @@ class wxMutexLocker;
 class Response {
    private:
       std::string mMessage;
+      // Of the pipelined request this answers whole, or negative
+      long mId;
+      // A piece of a long response, whose next piece follows
+      bool mPartial;
    public:
-      Response(const wxString &response)
+      Response(const wxString &response, long id = -1)
          : mMessage(response.utf8_str())
+         , mId(id)
+         , mPartial(false)
+      { }
+      Response(std::string &&utf8, long id, bool partial)
+         : mMessage(std::move(utf8))
+         , mId(id)
+         , mPartial(partial)
       { }
 
       wxString GetMessage()
       {
          return wxString(mMessage.c_str(), wxConvUTF8);
       }
+
+      long GetId() const { return mId; }
+      bool IsPartial() const { return mPartial; }
 };
 
 class ResponseQueue {
@@ -69,6 +83,9 @@ class ResponseQueue {
 
       void AddResponse(Response response);
       Response WaitAndGetResponse();
+      // Wait at most msWait milliseconds, or forever if negative; false
+      // if nothing came
+      bool WaitAndGetResponse(Response &response, int msWait);
 };
 
 #endif /* End of include guard: __RESPONSEQUEUE__ */
@@ -0,0 +1,186 @@
+/**********************************************************************
+
+   Audacity - A Digital Audio Editor
+   Copyright 1999-2018 Audacity Team
+   File License: wxWidgets
+
+******************************************************************//**
+
+\file SampleDataCommands.cpp
+\brief Contains definitions for the GetSamplesCommand and
+SetSamplesCommand classes
+
+The samples go through a file the script names, as native floats with
+no header, and not through the pipe, whose responses are text.  A file
+on a memory file system, such as /dev/shm, makes the transfer a copy in
+memory.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "SampleDataCommands.h"
+
+#include <wx/ffile.h>
+
+#include "../Project.h"
+#include "../Track.h"
+#include "../WaveTrack.h"
+#include "../ShuttleGui.h"
+#include "CommandContext.h"
+
+namespace {
+
+// Tracks are counted as SetTrackBase counts channels, each channel of a
+// stereo track being a track of its own
+WaveTrack *FindWaveTrack(const CommandContext & context, int index)
+{
+   Track *t = index >= 0
+      ? context.GetProject()->GetTracks()->GetTrack(index)
+      : nullptr;
+   if (t && t->GetKind() == Track::Wave)
+      return static_cast<WaveTrack *>(t);
+   context.Error(wxString::Format(wxT("Track %d is not a wave track"), index));
+   return nullptr;
+}
+
+}
+
+bool GetSamplesCommand::DefineParams( ShuttleParams & S ){
+   S.Define( mTrackIndex, wxT("Track"),    0, 0, 100 );
+   S.Define( mT0,         wxT("Start"),    0.0, 0.0, 1e12 );
+   S.Define( mT1,         wxT("End"),      0.0, 0.0, 1e12 );
+   S.Define( mFileName,   wxT("Filename"), wxT("samples.raw") );
+   return true;
+}
+
+void GetSamplesCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieNumericTextBox(_("Track:"),mTrackIndex);
+      S.TieNumericTextBox(_("Start Time:"),mT0);
+      S.TieNumericTextBox(_("End Time:"),mT1);
+      S.TieTextBox(_("File Name:"),mFileName);
+   }
+   S.EndMultiColumn();
+}
+
+bool GetSamplesCommand::Apply(const CommandContext & context)
+{
+   auto track = FindWaveTrack(context, mTrackIndex);
+   if (!track)
+      return false;
+
+   if (mT1 < mT0)
+   {
+      context.Error(wxT("End time is before start time"));
+      return false;
+   }
+
+   wxFFile file(mFileName, wxT("wb"));
+   if (!file.IsOpened())
+   {
+      context.Error(wxString::Format(wxT("Could not open %s"), mFileName));
+      return false;
+   }
+
+   const auto start = track->TimeToLongSamples(mT0);
+   const auto end = track->TimeToLongSamples(mT1);
+   const auto maxBlock = track->GetMaxBlockSize();
+   Floats buffer{ maxBlock };
+
+   // Gaps between clips read as silence
+   for (auto pos = start; pos < end;)
+   {
+      const auto len = limitSampleBufferSize(maxBlock, end - pos);
+      track->Get((samplePtr)buffer.get(), floatSample, pos, len);
+      if (file.Write(buffer.get(), len * sizeof(float)) != len * sizeof(float))
+      {
+         context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+         return false;
+      }
+      pos += len;
+   }
+
+   if (!file.Close())
+   {
+      context.Error(wxString::Format(wxT("Could not write %s"), mFileName));
+      return false;
+   }
+
+   context.StartStruct();
+   context.AddItem( (end - start).as_double(), wxT("samples") );
+   context.AddItem( track->GetRate(), wxT("rate") );
+   context.AddItem( track->LongSamplesToTime(start), wxT("start") );
+   context.EndStruct();
+   return true;
+}
+
+
+
+bool SetSamplesCommand::DefineParams( ShuttleParams & S ){
+   S.Define( mTrackIndex, wxT("Track"),    0, 0, 100 );
+   S.Define( mT0,         wxT("Start"),    0.0, 0.0, 1e12 );
+   S.Define( mFileName,   wxT("Filename"), wxT("samples.raw") );
+   return true;
+}
+
+void SetSamplesCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieNumericTextBox(_("Track:"),mTrackIndex);
+      S.TieNumericTextBox(_("Start Time:"),mT0);
+      S.TieTextBox(_("File Name:"),mFileName);
+   }
+   S.EndMultiColumn();
+}
+
+bool SetSamplesCommand::Apply(const CommandContext & context)
+{
+   auto track = FindWaveTrack(context, mTrackIndex);
+   if (!track)
+      return false;
+
+   wxFFile file(mFileName, wxT("rb"));
+   if (!file.IsOpened())
+   {
+      context.Error(wxString::Format(wxT("Could not open %s"), mFileName));
+      return false;
+   }
+
+   const auto start = track->TimeToLongSamples(mT0);
+   const auto maxBlock = track->GetMaxBlockSize();
+   Floats buffer{ maxBlock };
+
+   // Samples falling outside the clips are dropped, as WaveTrack::Set
+   // drops them
+   auto pos = start;
+   for (;;)
+   {
+      const auto bytes = file.Read(buffer.get(), maxBlock * sizeof(float));
+      const size_t len = bytes / sizeof(float);
+      if (len == 0)
+         break;
+      track->Set((samplePtr)buffer.get(), floatSample, pos, len);
+      pos += len;
+   }
+
+   if (file.Error())
+   {
+      context.Error(wxString::Format(wxT("Could not read %s"), mFileName));
+      return false;
+   }
+
+   if (pos > start)
+      context.GetProject()->PushState(_("Set Samples"), _("Set Samples"));
+
+   context.StartStruct();
+   context.AddItem( (pos - start).as_double(), wxT("samples") );
+   context.EndStruct();
+   return true;
+}
@@ -0,0 +1,68 @@
+/**********************************************************************
+
+   Audacity: A Digital Audio Editor
+   Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+   File License: wxwidgets
+
+   SampleDataCommands.h
+
+******************************************************************//**
+
+\class GetSamplesCommand
+\brief Command for reading the samples of a track into a file
+
+\class SetSamplesCommand
+\brief Command for writing the samples of a track from a file
+
+*//*******************************************************************/
+
+#ifndef __SAMPLE_DATA_COMMANDS__
+#define __SAMPLE_DATA_COMMANDS__
+
+#include "Command.h"
+#include "CommandType.h"
+
+class WaveTrack;
+
+#define GET_SAMPLES_PLUGIN_SYMBOL XO("Get Samples")
+
+class GetSamplesCommand : public AudacityCommand
+{
+public:
+   // CommandDefinitionInterface overrides
+   wxString GetSymbol() override {return GET_SAMPLES_PLUGIN_SYMBOL;};
+   wxString GetDescription() override {return _("Writes the samples of a track to a file as raw floats.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Extra_Menu:_Tools#get_samples");};
+public:
+   int mTrackIndex;
+   double mT0;
+   double mT1;
+   wxString mFileName;
+};
+
+#define SET_SAMPLES_PLUGIN_SYMBOL XO("Set Samples")
+
+class SetSamplesCommand : public AudacityCommand
+{
+public:
+   // CommandDefinitionInterface overrides
+   wxString GetSymbol() override {return SET_SAMPLES_PLUGIN_SYMBOL;};
+   wxString GetDescription() override {return _("Reads the samples of a track from a file of raw floats.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Extra_Menu:_Tools#set_samples");};
+public:
+   int mTrackIndex;
+   double mT0;
+   wxString mFileName;
+};
+
+#endif /* End of include guard: __SAMPLE_DATA_COMMANDS__ */
@@ -17,6 +17,13 @@
 \brief ScriptCommandRelay is just a way to move some of the scripting-specific
 code out of ModuleManager.
 
+A script may also pipeline its requests:  PostScriptCommand() posts each
+to the main thread and returns without waiting, and the whole response
+of each, with the id of its request, comes later from
+ReceiveScriptResponse().  Many commands are then in flight at once, and
+the main thread redraws once after the last of a run of them, so that
+throughput is not bound by one round trip per command.
+
 *//*******************************************************************/
 
 #include "ScriptCommandRelay.h"
@@ -31,13 +38,23 @@ code out of ModuleManager.
 // Declare static class members
 CommandHandler *ScriptCommandRelay::sCmdHandler;
 tpRegScriptServerFunc ScriptCommandRelay::sScriptFn;
+tpRegPipelinedScriptServerFunc ScriptCommandRelay::sPipelinedScriptFn;
 ResponseQueue ScriptCommandRelay::sResponseQueue;
+ResponseQueue ScriptCommandRelay::sPipelinedQueue;
+long ScriptCommandRelay::sBuildingId = -1;
+std::atomic<int> ScriptCommandRelay::sPending{ 0 };
 
 void ScriptCommandRelay::SetRegScriptServerFunc(tpRegScriptServerFunc scriptFn)
 {
    sScriptFn = scriptFn;
 }
 
+void ScriptCommandRelay::SetRegPipelinedScriptServerFunc(
+   tpRegPipelinedScriptServerFunc scriptFn)
+{
+   sPipelinedScriptFn = scriptFn;
+}
+
 void ScriptCommandRelay::SetCommandHandler(CommandHandler &ch)
 {
    sCmdHandler = &ch;
@@ -46,9 +63,15 @@ void ScriptCommandRelay::SetCommandHandler(CommandHandler &ch)
 /// Calls the script function, passing it the function for obeying commands
 void ScriptCommandRelay::Run()
 {
-   wxASSERT( sScriptFn != NULL );
-   while( true )
-      sScriptFn(&ExecCommand);
+   wxASSERT( sScriptFn != NULL || sPipelinedScriptFn != NULL );
+   while( true ) {
+      // A module that can take pipelined requests is given the means
+      if( sPipelinedScriptFn )
+         sPipelinedScriptFn(&ExecCommand, &PostScriptCommand,
+                            &ReceiveScriptResponse);
+      else
+         sScriptFn(&ExecCommand);
+   }
 }
 
 /// Send a command to a project, to be applied in that context.
@@ -58,9 +81,15 @@ void ScriptCommandRelay::PostCommand(AudacityProject *project, const OldStyleCom
    wxASSERT(cmd != NULL);
    AppCommandEvent ev;
    ev.SetCommand(cmd);
+   ++sPending;
    project->GetEventHandler()->AddPendingEvent(ev);
 }
 
+bool ScriptCommandRelay::FinishCommand()
+{
+   return --sPending <= 0;
+}
+
 /// This is the function which actually obeys one command.  Rather than applying
 /// the command directly, an event containing a reference to the command is sent
 /// to the main (GUI) thread. This is because having more than one thread access
@@ -85,21 +114,77 @@ int ExecCommand(wxString *pIn, wxString *pOut)
    }
 
    // Wait until all responses from the command have been received.
-   // The last response is signalled by an empty line.
-   wxString msg = ScriptCommandRelay::ReceiveResponse().GetMessage();
-   while (msg != wxT("\n"))
+   // The last response is signalled by an empty line.  A long response
+   // comes in pieces, which are joined.
+   while (true)
    {
+      auto response = ScriptCommandRelay::ReceiveResponse();
+      wxString msg = response.GetMessage();
+      if (response.IsPartial())
+      {
+         *pOut += msg;
+         continue;
+      }
+      if (msg == wxT("\n"))
+         break;
       //wxLogDebug( "Msg: %s", msg );
       *pOut += msg + wxT("\n");
-      msg = ScriptCommandRelay::ReceiveResponse().GetMessage();
    }
 
    return 0;
 }
 
+/// Like ExecCommand(), but returns at once; the response, with id, comes
+/// from ReceiveScriptResponse()
+int PostScriptCommand(long id, wxString *pIn)
+{
+   ScriptCommandRelay::PostPipelined(id, *pIn);
+   return 0;
+}
+
+/// Gets the response to one request that PostScriptCommand() posted,
+/// waiting at most msWait milliseconds, or forever if negative.
+/// Returns 1 if there was one, else 0.
+int ReceiveScriptResponse(long *pId, wxString *pOut, int msWait)
+{
+   return ScriptCommandRelay::ReceivePipelined(*pId, *pOut, msWait) ? 1 : 0;
+}
+
+void ScriptCommandRelay::PostPipelined(long id, const wxString &command)
+{
+   wxASSERT(id >= 0);
+
+   // The builder asks GetResponseTarget() for the target of the response
+   sBuildingId = id;
+   CommandBuilder builder(command);
+   sBuildingId = -1;
+
+   if (builder.WasValid())
+      PostCommand(GetActiveProject(), builder.GetCommand());
+   else
+      sPipelinedQueue.AddResponse(Response(
+         wxT("Syntax error!\n") + builder.GetErrorMessage() + wxT("\n"),
+         id));
+}
+
+bool ScriptCommandRelay::ReceivePipelined(
+   long &id, wxString &response, int msWait)
+{
+   Response result{ wxEmptyString };
+   if (!sPipelinedQueue.WaitAndGetResponse(result, msWait))
+      return false;
+   id = result.GetId();
+   response = result.GetMessage();
+   return true;
+}
+
 /// Adds a response to the queue to be sent back to the script
 void ScriptCommandRelay::SendResponse(const wxString &response)
 {
+   // A pipelined request that fails to build is answered whole by
+   // PostPipelined()
+   if (sBuildingId >= 0)
+      return;
    sResponseQueue.AddResponse(response);
 }
 
@@ -114,5 +199,7 @@ Response ScriptCommandRelay::ReceiveResponse()
 std::shared_ptr<ResponseQueueTarget> ScriptCommandRelay::GetResponseTarget()
 {
    // This should be deleted by a Command destructor
+   if (sBuildingId >= 0)
+      return std::make_shared<ResponseQueueTarget>(sPipelinedQueue, sBuildingId);
    return std::make_shared<ResponseQueueTarget>(sResponseQueue);
 }
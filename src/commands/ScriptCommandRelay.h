@@ -18,6 +18,7 @@
 
 #include "../Audacity.h"
 #include "../MemoryX.h"
+#include <atomic>
 
 class CommandHandler;
 class ResponseQueue;
@@ -31,8 +32,16 @@ class wxString;
 typedef int (*tpExecScriptServerFunc)( wxString * pIn, wxString * pOut);
 typedef int (*tpRegScriptServerFunc)(tpExecScriptServerFunc pFn);
 
+// For pipelined requests, which a script may send many of before it reads
+typedef int (*tpPostScriptServerFunc)( long id, wxString * pIn);
+typedef int (*tpReceiveScriptServerFunc)( long * pId, wxString * pOut, int msWait);
+typedef int (*tpRegPipelinedScriptServerFunc)(tpExecScriptServerFunc pFn,
+   tpPostScriptServerFunc pPostFn, tpReceiveScriptServerFunc pReceiveFn);
+
 extern "C" {
       AUDACITY_DLL_API int ExecCommand(wxString *pIn, wxString *pOut);
+      AUDACITY_DLL_API int PostScriptCommand(long id, wxString *pIn);
+      AUDACITY_DLL_API int ReceiveScriptResponse(long *pId, wxString *pOut, int msWait);
 } // End 'extern C'
 
 class ScriptCommandRelay
@@ -41,18 +50,35 @@ class ScriptCommandRelay
       // N.B. Static class members also have to be declared in the .cpp file
       static CommandHandler *sCmdHandler;
       static tpRegScriptServerFunc sScriptFn;
+      static tpRegPipelinedScriptServerFunc sPipelinedScriptFn;
       static ResponseQueue sResponseQueue;
+      // Whole responses to pipelined requests
+      static ResponseQueue sPipelinedQueue;
+      // Of the pipelined request being built; only the script thread
+      // touches it
+      static long sBuildingId;
+      // Commands posted and not yet applied
+      static std::atomic<int> sPending;
 
    public:
 
       static void SetRegScriptServerFunc(tpRegScriptServerFunc scriptFn);
+      static void SetRegPipelinedScriptServerFunc(
+         tpRegPipelinedScriptServerFunc scriptFn);
       static void SetCommandHandler(CommandHandler &ch);
 
       static void Run();
       static void PostCommand(AudacityProject *project, const OldStyleCommandPointer &cmd);
+      // Called on the main thread after applying each posted command.
+      // False while more are waiting, so that one redraw serves them all.
+      static bool FinishCommand();
       static void SendResponse(const wxString &response);
       static Response ReceiveResponse();
       static std::shared_ptr<ResponseQueueTarget> GetResponseTarget();
+
+      // Build a command to answer with id, and post it without waiting
+      static void PostPipelined(long id, const wxString &command);
+      static bool ReceivePipelined(long &id, wxString &response, int msWait);
 };
 
 #endif /* End of include guard: __SCRIPT_COMMAND_RELAY__ */
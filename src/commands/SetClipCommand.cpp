@@ -9,11 +9,16 @@
 ******************************************************************//**
 
 \file SetClipCommand.cpp
-\brief Definitions for SetClipCommand
+\brief Definitions for SetClipCommand and SetClipsCommand
 
 \class SetClipCommand
 \brief Command that sets clip information
 
+\class SetClipsCommand
+\brief Command that sets the information of many clips, pushing one
+undo state for all of them, where a script calling SetClipCommand for
+each pushes one for each
+
 *//*******************************************************************/
 
 #include "../Audacity.h"
@@ -25,6 +30,8 @@
 #include "../ShuttleGui.h"
 #include "CommandContext.h"
 
+#include <wx/tokenzr.h>
+
 SetClipCommand::SetClipCommand()
 {
 }
@@ -102,3 +109,106 @@ bool SetClipCommand::ApplyInner( Track * t )
    }
    return true;
 }
+
+bool SetClipsCommand::DefineParams( ShuttleParams & S ){
+   S.Define( mEdits, wxT("Edits"), wxT("") );
+   return true;
+}
+
+void SetClipsCommand::PopulateOrExchange(ShuttleGui & S)
+{
+   S.AddSpace(0, 5);
+
+   S.StartMultiColumn(2, wxALIGN_CENTER);
+   {
+      S.TieTextBox(_("Edits:"),mEdits);
+   }
+   S.EndMultiColumn();
+}
+
+bool SetClipsCommand::Apply(const CommandContext & context)
+{
+   // Tracks are counted as SetTrackBase counts channels
+   std::vector<Track *> tracks;
+   TrackListIterator iter(context.GetProject()->GetTracks());
+   for (Track *t = iter.First(); t; t = iter.Next())
+      tracks.push_back(t);
+
+   struct Edit {
+      WaveClip *clip;
+      bool bHasT0;
+      double t0;
+      bool bHasColour;
+      long colour;
+   };
+   std::vector<Edit> edits;
+
+   // Find all the clips before moving any, so that each edit names a clip
+   // by where it was when the command began, and so that the index of
+   // clips of a track, which a move makes stale, is built only once.
+   // Nothing is changed unless every edit is good.
+   wxStringTokenizer tokenizer(mEdits, wxT(";"), wxTOKEN_STRTOK);
+   while (tokenizer.HasMoreTokens())
+   {
+      const auto text = tokenizer.GetNextToken().Trim(true).Trim(false);
+      const auto fields = wxSplit(text, wxT(','), wxT('\0'));
+      long trackIndex;
+      double at;
+      Edit edit{};
+      bool good = fields.size() >= 2 && fields.size() <= 4 &&
+         fields[0].ToLong(&trackIndex) &&
+         fields[1].ToCDouble(&at);
+      if (good && fields.size() > 2 && !fields[2].empty())
+      {
+         edit.bHasT0 = true;
+         good = fields[2].ToCDouble(&edit.t0);
+      }
+      if (good && fields.size() > 3 && !fields[3].empty())
+      {
+         edit.bHasColour = true;
+         good = fields[3].ToLong(&edit.colour) &&
+            edit.colour >= 0 && edit.colour < nColours;
+      }
+      if (!good)
+      {
+         context.Error(wxString::Format(wxT("Bad clip edit '%s'"), text));
+         return false;
+      }
+
+      if (trackIndex < 0 || trackIndex >= (long)tracks.size() ||
+          tracks[trackIndex]->GetKind() != Track::Wave)
+      {
+         context.Error(
+            wxString::Format(wxT("Track %ld is not a wave track"), trackIndex));
+         return false;
+      }
+      edit.clip =
+         static_cast<WaveTrack*>(tracks[trackIndex])->GetClipAtTime(at);
+      if (!edit.clip)
+      {
+         context.Error(wxString::Format(
+            wxT("Track %ld has no clip at %g"), trackIndex, at));
+         return false;
+      }
+      edits.push_back(edit);
+   }
+
+   // No validation of overlap yet, as for SetClipCommand
+   for (const auto &edit : edits)
+   {
+      if (edit.bHasColour)
+         edit.clip->SetColourIndex(edit.colour);
+      if (edit.bHasT0)
+         edit.clip->SetOffset(edit.t0);
+   }
+
+   // One state for all the edits, and the project is redrawn once, after
+   // the command
+   if (!edits.empty())
+      context.GetProject()->PushState(_("Set Clips"), _("Set Clips"));
+
+   context.StartStruct();
+   context.AddItem( (double)edits.size(), wxT("clips") );
+   context.EndStruct();
+   return true;
+}
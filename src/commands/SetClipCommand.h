@@ -47,5 +47,28 @@ public:
    bool bHasT0;
 };
 
+#define SET_CLIPS_PLUGIN_SYMBOL XO("Set Clips")
+
+// Many clip edits in one command, as one undoable step.  Edits is a list
+// of edits separated by semicolons, each "track,at,start,color", where
+// track is counted as SetTrackBase counts channels, at is a time in the
+// clip, and start or color may be left empty to leave it as it was.
+class SetClipsCommand : public AudacityCommand
+{
+public:
+   // CommandDefinitionInterface overrides
+   wxString GetSymbol() override {return SET_CLIPS_PLUGIN_SYMBOL;};
+   wxString GetDescription() override {return _("Sets various values for many clips at once.");};
+   bool DefineParams( ShuttleParams & S ) override;
+   void PopulateOrExchange(ShuttleGui & S) override;
+   bool Apply(const CommandContext & context) override;
+
+   // AudacityCommand overrides
+   wxString ManualPage() override {return wxT("Extra_Menu:_Tools#set_clips");};
+
+public:
+   wxString mEdits;
+};
+
 
 #endif /* End of include guard: __SETTRACKINFOCOMMAND__ */
@@ -58,24 +58,15 @@ void SetTrackBase::PopulateOrExchange(ShuttleGui & S)
 
 bool SetTrackBase::Apply(const CommandContext & context  )
 {
-   long i = 0;// track counter
-   long j = 0;// channel counter
-   TrackListIterator iter(context.GetProject()->GetTracks());
-   Track *t = iter.First();
-   bIsSecondChannel = false;
-   while (t )
+   // A copy, as the command may change the selection
+   const auto selected = context.GetProject()->GetTracks()
+      ->GetSelectedTracksOfKind(Track::All);
+   for (const auto t : selected)
    {
-      bool bThisTrack =
-         t->GetSelected();
-
-      if( bThisTrack ){
-         ApplyInner( t );
-      }
-      bIsSecondChannel = t->GetLinked();
-      if( !bIsSecondChannel )
-         ++i;
-      j++;
-      t = iter.Next();
+      const auto partner = t->GetLink();
+      bIsSecondChannel = partner && partner != t && partner->GetLinked() &&
+         partner->GetIndex() < t->GetIndex();
+      ApplyInner( t );
    }
    return true;
 }
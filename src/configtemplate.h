@@ -124,6 +124,9 @@
 /* Define to 1 if you have the ANSI C header files. */
 #undef STDC_HEADERS
 
+/* Define to count heap allocations for the profiler */
+#undef TRACK_ALLOCATIONS
+
 /* Define if Audio Unit plug-ins are enabled (Mac OS X only) */
 #undef USE_AUDIO_UNITS
 
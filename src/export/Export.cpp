@@ -31,6 +31,9 @@
 #include "../Audacity.h"
 #include "Export.h"
 
+#include <algorithm>
+
+#include <wx/button.h>
 #include <wx/file.h>
 #include <wx/filename.h>
 #include <wx/progdlg.h>
@@ -40,11 +43,15 @@
 #include <wx/stattext.h>
 #include <wx/string.h>
 #include <wx/textctrl.h>
+#include <wx/thread.h>
 #include <wx/timer.h>
 #include <wx/dcmemory.h>
 #include <wx/window.h>
 
 #include "ExportPCM.h"
+#include "ExportMP3.h"
+#include "ExportFLAC.h"
+#include "ExportOGG.h"
 
 #include "sndfile.h"
 
@@ -61,7 +68,11 @@
 #include "../widgets/ErrorDialog.h"
 #include "../widgets/Warning.h"
 #include "../AColor.h"
+#include "../CrossFade.h"
 #include "../Dependencies.h"
+#include "../Dither.h"
+#include "../MixerPool.h"
+#include "../blockfile/BlockIOStats.h"
 #include "../FileNames.h"
 
 //----------------------------------------------------------------------------
@@ -225,6 +236,17 @@ wxWindow *ExportPlugin::OptionsCreate(wxWindow *parent, int WXUNUSED(format))
    return p;
 }
 
+namespace {
+   // Blocks that each thread may mix before the exporter takes them
+   const size_t kMixAhead = 2;
+
+   // Don't start more mixers than this, for the memory of their blocks
+   const int kMaxMixers = 16;
+
+   // Nor for exports shorter than this many blocks
+   const size_t kMinBlocksPerMixer = 4;
+}
+
 //Create a mixer by computing the time warp factor
 std::unique_ptr<Mixer> ExportPlugin::CreateMixer(const WaveTrackConstArray &inputTracks,
          double startTime, double stopTime,
@@ -242,6 +264,49 @@ std::unique_ptr<Mixer> ExportPlugin::CreateMixer(const WaveTrackConstArray &inpu
                   highQuality, mixerSpec);
 }
 
+std::unique_ptr<PipelinedMixer> ExportPlugin::CreatePipelinedMixer(
+         const WaveTrackConstArray &inputTracks,
+         double startTime, double stopTime,
+         unsigned numOutChannels, size_t outBufferSize, bool outInterleaved,
+         double outRate, sampleFormat outFormat,
+         bool highQuality, MixerSpec *mixerSpec)
+{
+   // Several mixers take turns at the blocks of a long export, one on each
+   // core.  Each repositions to its next block, which makes fresh
+   // resamplers, so do that only when the tracks need none, and the
+   // samples are the same as from one mixer.
+   size_t nMixers = 1;
+   const bool sameRate = std::all_of(inputTracks.begin(), inputTracks.end(),
+      [=](const std::shared_ptr<const WaveTrack> &track)
+         { return track->GetRate() == outRate; });
+   if (sameRate) {
+      const auto nBlocks =
+         size_t((stopTime - startTime) * outRate / outBufferSize);
+      const auto nCores =
+         std::max(1, std::min(wxThread::GetCPUCount(), kMaxMixers));
+      nMixers = std::max<size_t>(1,
+         std::min<size_t>(nCores, nBlocks / kMinBlocksPerMixer));
+   }
+
+   std::vector<std::unique_ptr<Mixer>> mixers;
+   for (size_t ii = 0; ii < nMixers; ++ii)
+      mixers.push_back(CreateMixer(inputTracks, startTime, stopTime,
+         numOutChannels, outBufferSize, outInterleaved,
+         outRate, outFormat, highQuality, mixerSpec));
+
+   return std::make_unique<PipelinedMixer>(std::move(mixers),
+      startTime, outRate,
+      numOutChannels, outBufferSize, outInterleaved, outFormat);
+}
+
+std::unique_ptr<ExportStream> ExportPlugin::OpenStream(
+         const wxString & WXUNUSED(fName), unsigned WXUNUSED(channels),
+         double WXUNUSED(rate), int WXUNUSED(subformat))
+{
+   AudacityMessageBox(_("This format cannot export several files at once."));
+   return {};
+}
+
 void ExportPlugin::InitProgress(std::unique_ptr<ProgressDialog> &pDialog,
    const wxString &title, const wxString &message)
 {
@@ -254,6 +319,499 @@ void ExportPlugin::InitProgress(std::unique_ptr<ProgressDialog> &pDialog,
    }
 }
 
+//----------------------------------------------------------------------------
+// PipelinedMixer
+//----------------------------------------------------------------------------
+
+class PipelinedMixer::Thread final : public wxThread
+{
+public:
+   Thread(PipelinedMixer &mixer, size_t index)
+      : wxThread{ wxTHREAD_JOINABLE }, mMixer{ mixer }, mIndex{ index }
+   {}
+
+protected:
+   ExitCode Entry() override
+   {
+      mMixer.Run(mIndex);
+      return 0;
+   }
+
+private:
+   PipelinedMixer &mMixer;
+   const size_t mIndex;
+};
+
+PipelinedMixer::PipelinedMixer(std::vector<std::unique_ptr<Mixer>> &&mixers,
+   double t0, double rate,
+   unsigned numChannels, size_t bufferSize, bool interleaved,
+   sampleFormat format)
+   : mMixers{ std::move(mixers) }
+   , mT0{ t0 }
+   , mRate{ rate }
+   , mNumChannels{ numChannels }
+   , mBufferSize{ bufferSize }
+   , mInterleaved{ interleaved }
+   , mFormat{ format }
+{
+   wxASSERT(!mMixers.empty());
+
+   const unsigned numBuffers = mInterleaved ? 1 : mNumChannels;
+   const size_t bufferLen = mInterleaved ? mNumChannels * mBufferSize : mBufferSize;
+   const size_t numBlocks = kMixAhead * mMixers.size() + 1;
+   mBlocks.reinit(numBlocks);
+   for (size_t ii = 0; ii < numBlocks; ++ii) {
+      auto &block = mBlocks[ii];
+      block.buffers.reinit(numBuffers);
+      for (unsigned c = 0; c < numBuffers; ++c)
+         block.buffers[c].Allocate(bufferLen, mFormat);
+   }
+
+   for (size_t ii = 0; ii < mMixers.size(); ++ii) {
+      auto thread = std::make_unique<Thread>(*this, ii);
+      if (thread->Run() != wxTHREAD_NO_ERROR)
+         // Do with the threads that started.  If none did, Process() mixes
+         // on the caller's thread.
+         break;
+      mThreads.push_back(std::move(thread));
+   }
+}
+
+PipelinedMixer::~PipelinedMixer()
+{
+   {
+      ODLocker locker{ &mLock };
+      mStopping = true;
+      mDrained.Broadcast();
+   }
+   for (auto &thread : mThreads)
+      thread->Wait();
+}
+
+size_t PipelinedMixer::Process()
+{
+   if (mThreads.empty()) {
+      const auto length = mMixers[0]->Process(mBufferSize);
+      mSamplesDone += length;
+      return length;
+   }
+
+   ODLocker locker{ &mLock };
+
+   // The caller is done with the block of the previous call
+   if (mHolding) {
+      mHolding = false;
+      mBlocks[mNextOut % mBlocks.size()].ready = false;
+      ++mNextOut;
+      mDrained.Broadcast();
+   }
+
+   // Blocks are returned in order of time, whichever thread mixed them
+   const auto &block = mBlocks[mNextOut % mBlocks.size()];
+   while (!(block.ready && block.number == mNextOut) && !mError)
+      mMixed.Wait();
+
+   if (mError)
+      std::rethrow_exception(mError);
+
+   // The block of no samples stays, to answer any further call
+   if (block.length == 0)
+      return 0;
+
+   mHolding = true;
+   mSamplesDone += block.length;
+   return block.length;
+}
+
+samplePtr PipelinedMixer::GetBuffer()
+{
+   if (mThreads.empty())
+      return mMixers[0]->GetBuffer();
+   return mBlocks[mNextOut % mBlocks.size()].buffers[0].ptr();
+}
+
+samplePtr PipelinedMixer::GetBuffer(int channel)
+{
+   if (mThreads.empty())
+      return mMixers[0]->GetBuffer(channel);
+   return mBlocks[mNextOut % mBlocks.size()].buffers[channel].ptr();
+}
+
+void PipelinedMixer::Run(size_t index)
+{
+   auto &mixer = *mMixers[index];
+   // The block that follows where this mixer stopped
+   size_t next = 0;
+
+   ODLocker locker{ &mLock };
+   for (;;) {
+      // The slot of a block can be filled when the caller has released the
+      // block of the slot before
+      while (!mStopping && mNextJob < mEndJob &&
+             mNextJob >= mNextOut + mBlocks.size())
+         mDrained.Wait();
+      if (mStopping || mNextJob >= mEndJob)
+         break;
+
+      const auto job = mNextJob++;
+      auto &block = mBlocks[job % mBlocks.size()];
+
+      // Mix without the lock, so that the caller writes meanwhile.
+      // Exceptions must not escape this thread; Process() rethrows them.
+      locker.reset();
+      std::exception_ptr error;
+      size_t length = 0;
+      try {
+         // Another mixer did the blocks between.  A jump makes fresh
+         // resamplers, so CreatePipelinedMixer() makes several mixers only
+         // when none of them resamples.
+         if (job != next)
+            mixer.Reposition(mT0 + (job * mBufferSize) / mRate);
+         length = mixer.Process(mBufferSize);
+         next = job + 1;
+
+         const auto size = SAMPLE_SIZE(mFormat);
+         if (mInterleaved)
+            memcpy(block.buffers[0].ptr(), mixer.GetBuffer(),
+                   length * mNumChannels * size);
+         else
+            for (unsigned c = 0; c < mNumChannels; ++c)
+               memcpy(block.buffers[c].ptr(), mixer.GetBuffer(c),
+                      length * size);
+      }
+      catch (...) {
+         error = std::current_exception();
+      }
+      locker.reset(&mLock);
+
+      if (error) {
+         if (!mError)
+            mError = error;
+         mStopping = true;
+         mDrained.Broadcast();
+         mMixed.Signal();
+         break;
+      }
+
+      block.number = job;
+      block.length = length;
+      block.ready = true;
+      if (length == 0)
+         // The mix ends here, and no thread need take a later block
+         mEndJob = std::min(mEndJob, job);
+      mMixed.Signal();
+   }
+}
+
+//----------------------------------------------------------------------------
+// MultiExporter
+//----------------------------------------------------------------------------
+
+ExportStream::~ExportStream()
+{
+}
+
+namespace {
+   // Samples of each track read at once, and mixed into each output
+   const size_t kMultiExportWindow = 65536;
+}
+
+struct MultiExporter::Source
+{
+   std::shared_ptr<const WaveTrack> track;
+   WaveTrackCache cache;
+   CrossFader fader;
+
+   // The samples that some output needs
+   sampleCount start { 0 }, end { 0 };
+
+   // Those of the current window, from samplesStart
+   const float *samples { nullptr };
+   sampleCount samplesStart { 0 };
+   // For samples that the fader changes
+   Floats buffer;
+
+   std::exception_ptr error;
+};
+
+struct MultiExporter::Output
+{
+   std::unique_ptr<ExportStream> stream;
+   unsigned numChannels;
+   sampleFormat format;
+   sampleCount start, end;
+
+   // The tracks at the rate of the output, and the channels of each
+   std::vector<Source *> sources;
+   std::vector<ArrayOf<int>> channelFlags;
+
+   // If any track is at another rate, this mixes all of them instead,
+   // reading them itself
+   std::unique_ptr<Mixer> mixer;
+
+   SampleBuffer mix;
+   SampleBuffer out;
+   Doubles envValues;
+   Floats gains;
+   // One for each channel, so that outputs convert on several threads
+   ArrayOf<Dither> dithers;
+
+   bool failed { false };
+   std::exception_ptr error;
+};
+
+MultiExporter::MultiExporter(double rate)
+   : mRate{ rate }
+   , mPool{ std::make_unique<MixerPool>(
+      (unsigned)std::max(1, wxThread::GetCPUCount()) - 1) }
+{
+}
+
+MultiExporter::~MultiExporter()
+{
+}
+
+void MultiExporter::AddOutput(std::unique_ptr<ExportStream> &&stream,
+   const WaveTrackConstArray &tracks, double t0, double t1,
+   unsigned numChannels)
+{
+   auto output = std::make_unique<Output>();
+   output->numChannels = numChannels;
+   output->format = stream->GetFormat();
+   output->stream = std::move(stream);
+
+   // Like Mixer, end with the last track, if before t1
+   const sampleCount start{ t0 * mRate + 0.5 };
+   sampleCount end = start;
+   for (const auto &track : tracks)
+      end = std::max(end, std::min(sampleCount{ t1 * mRate + 0.5 },
+         sampleCount{ track->GetEndTime() * mRate + 0.5 }));
+   output->start = start;
+   output->end = end;
+
+   const bool sameRate = std::all_of(tracks.begin(), tracks.end(),
+      [=](const std::shared_ptr<const WaveTrack> &track)
+         { return track->GetRate() == mRate; });
+   if (!sameRate)
+      output->mixer = std::make_unique<Mixer>(tracks,
+         // Throw, to stop exporting, if read fails:
+         true,
+         t0, t1, numChannels, kMultiExportWindow, true,
+         mRate, output->format);
+   else {
+      bool crossfade = true;
+      double crossfadeMs = 10.0;
+      gPrefs->Read(wxT("/AudioIO/CrossfadeClips"), &crossfade, true);
+      gPrefs->Read(wxT("/AudioIO/CrossfadeClipsMs"), &crossfadeMs, 10.0);
+
+      for (const auto &track : tracks) {
+         auto iter = std::find_if(mSources.begin(), mSources.end(),
+            [&](const std::unique_ptr<Source> &source)
+               { return source->track == track; });
+         Source *source;
+         if (iter != mSources.end()) {
+            source = iter->get();
+            source->start = std::min(source->start, start);
+            source->end = std::max(source->end, end);
+         }
+         else {
+            mSources.push_back(std::make_unique<Source>());
+            source = mSources.back().get();
+            source->track = track;
+            source->cache.SetTrack(track);
+            source->cache.SetReadAhead(true);
+            source->fader.SetTrack(track.get(), crossfade
+               ? (size_t)std::max(0.0, mRate * crossfadeMs / 1000.0)
+               : 0);
+            source->start = start;
+            source->end = end;
+            source->buffer.reinit(kMultiExportWindow);
+         }
+         output->sources.push_back(source);
+
+         // The channels as Mixer chooses them, without a MixerSpec
+         ArrayOf<int> flags{ numChannels, true };
+         switch (track->GetChannel()) {
+         case Track::MonoChannel:
+         default:
+            std::fill(flags.get(), flags.get() + numChannels, 1);
+            break;
+         case Track::LeftChannel:
+            flags[0] = 1;
+            break;
+         case Track::RightChannel:
+            flags[numChannels >= 2 ? 1 : 0] = 1;
+            break;
+         }
+         output->channelFlags.push_back(std::move(flags));
+      }
+
+      output->mix.Allocate(kMultiExportWindow * numChannels, floatSample);
+      if (output->format != floatSample)
+         output->out.Allocate(kMultiExportWindow * numChannels,
+                              output->format);
+      output->envValues.reinit(kMultiExportWindow);
+      output->gains.reinit(numChannels);
+      output->dithers.reinit(numChannels);
+   }
+
+   mOutputs.push_back(std::move(output));
+}
+
+void MultiExporter::Read(Source &source, sampleCount start, size_t len)
+{
+   const auto s0 = std::max(start, source.start);
+   const auto s1 = std::min(start + len, source.end);
+   source.samples = nullptr;
+   if (s0 >= s1)
+      return;
+
+   const auto slen = (s1 - s0).as_size_t();
+   auto results =
+      (const float *)source.cache.Get(floatSample, s0, slen, true);
+   if (!results) {
+      std::fill(source.buffer.get(), source.buffer.get() + slen, 0.0f);
+      results = source.buffer.get();
+   }
+   else if (source.fader.Overlaps(s0, slen)) {
+      // Fade once here for all the outputs of the track
+      memcpy(source.buffer.get(), results, sizeof(float) * slen);
+      source.fader.Apply(source.buffer.get(), s0, slen);
+      results = source.buffer.get();
+   }
+   source.samples = results;
+   source.samplesStart = s0;
+}
+
+void MultiExporter::Write(Output &output, sampleCount start, size_t len)
+{
+   const auto o0 = std::max(start, output.start);
+   const auto o1 = std::min(start + len, output.end);
+   if (o0 >= o1)
+      return;
+   const auto olen = (o1 - o0).as_size_t();
+   auto &stream = *output.stream;
+
+   if (output.mixer) {
+      for (size_t done = 0; done < olen;) {
+         const auto numSamples = output.mixer->Process(olen - done);
+         if (numSamples == 0)
+            break;
+         if (!stream.Write(output.mixer->GetBuffer(), numSamples)) {
+            output.failed = true;
+            return;
+         }
+         done += numSamples;
+      }
+      return;
+   }
+
+   const auto numChannels = output.numChannels;
+   const auto mix = (float *)output.mix.ptr();
+   std::fill(mix, mix + olen * numChannels, 0.0f);
+   for (size_t ii = 0; ii < output.sources.size(); ++ii) {
+      const auto &source = *output.sources[ii];
+      const auto track = source.track.get();
+      track->GetEnvelopeValues(output.envValues.get(), olen,
+                               o0.as_double() / mRate);
+      for (unsigned c = 0; c < numChannels; ++c)
+         output.gains[c] = track->GetChannelGain(c);
+      MixBuffers(numChannels, output.channelFlags[ii].get(),
+         output.gains.get(),
+         (constSamplePtr)(source.samples +
+            (o0 - source.samplesStart).as_size_t()),
+         output.envValues.get(), &output.mix, olen, true);
+   }
+
+   samplePtr buffer = output.mix.ptr();
+   if (output.format != floatSample) {
+      const auto size = SAMPLE_SIZE(output.format);
+      for (unsigned c = 0; c < numChannels; ++c)
+         CopySamples(output.mix.ptr() + c * SAMPLE_SIZE(floatSample),
+            floatSample,
+            output.out.ptr() + c * size, output.format,
+            olen, output.dithers[c], true, numChannels, numChannels);
+      buffer = output.out.ptr();
+   }
+
+   if (!stream.Write(buffer, olen))
+      output.failed = true;
+}
+
+ProgressResult MultiExporter::Process(ProgressDialog &dialog)
+{
+   auto result = ProgressResult::Success;
+   if (mOutputs.empty())
+      return result;
+
+   sampleCount first = mOutputs[0]->start, last = mOutputs[0]->end;
+   for (const auto &output : mOutputs) {
+      first = std::min(first, output->start);
+      last = std::max(last, output->end);
+   }
+
+   std::vector<Source *> reading;
+   std::vector<Output *> writing;
+   for (auto start = first;
+        start < last && result == ProgressResult::Success;
+        start += kMultiExportWindow) {
+      const auto len = limitSampleBufferSize(kMultiExportWindow, last - start);
+      const auto end = start + len;
+
+      // Read each track of the window once, on all cores, and then mix and
+      // write each output from those reads.  Exceptions must not escape
+      // the helper threads, so rethrow them here.
+      reading.clear();
+      for (const auto &source : mSources)
+         if (source->start < end && start < source->end)
+            reading.push_back(source.get());
+      mPool->Run(reading.size(), [&](size_t index) {
+         auto &source = *reading[index];
+         try { Read(source, start, len); }
+         catch (...) { source.error = std::current_exception(); }
+      });
+      for (auto source : reading)
+         if (source->error)
+            std::rethrow_exception(source->error);
+
+      writing.clear();
+      for (const auto &output : mOutputs)
+         if (output->start < end && start < output->end)
+            writing.push_back(output.get());
+      mPool->Run(writing.size(), [&](size_t index) {
+         auto &output = *writing[index];
+         try { Write(output, start, len); }
+         catch (...) { output.error = std::current_exception(); }
+      });
+      for (auto output : writing) {
+         if (output->error)
+            std::rethrow_exception(output->error);
+         if (output->failed) {
+            AudacityMessageBox(output->stream->GetWriteError());
+            result = ProgressResult::Cancelled;
+            break;
+         }
+      }
+
+      if (result == ProgressResult::Success)
+         result = dialog.Update(
+            (end - first).as_double() / mRate,
+            (last - first).as_double() / mRate);
+   }
+
+   if (result == ProgressResult::Success ||
+       result == ProgressResult::Stopped) {
+      for (const auto &output : mOutputs)
+         if (!output->stream->Close()) {
+            // TODO: more precise message
+            AudacityMessageBox(_("Unable to export"));
+            return ProgressResult::Cancelled;
+         }
+   }
+
+   return result;
+}
+
 //----------------------------------------------------------------------------
 // Export
 //----------------------------------------------------------------------------
@@ -271,6 +829,13 @@ Exporter::Exporter()
    SetFileDialogTitle( _("Export Audio") );
 
    RegisterPlugin(New_ExportPCM());
+   RegisterPlugin(New_ExportMP3());
+#ifdef USE_LIBVORBIS
+   RegisterPlugin(New_ExportOGG());
+#endif
+#ifdef USE_LIBFLAC
+   RegisterPlugin(New_ExportFLAC());
+#endif
 }
 
 Exporter::~Exporter()
@@ -374,6 +939,54 @@ bool Exporter::Process(AudacityProject *project, unsigned numChannels,
    return false;
 }
 
+bool Exporter::ProcessMultiple(AudacityProject *project, const wxChar *type,
+                               const std::vector<Stem> &stems)
+{
+   mProject = project;
+
+   ExportPlugin *plugin = nullptr;
+   int subformat = 0;
+   for (const auto &pPlugin : mPlugins)
+      for (int j = 0; !plugin && j < pPlugin->GetFormatCount(); j++)
+         if (pPlugin->GetFormat(j).IsSameAs(type, false)) {
+            plugin = pPlugin.get();
+            subformat = j;
+         }
+   if (!plugin)
+      return false;
+
+   // Remove the files, and only after their streams are closed, if any
+   // export fails
+   bool success = false;
+   std::vector<wxString> names;
+   auto cleanup = finally( [&] {
+      if ( ! success )
+         for (const auto &name : names)
+            ::wxRemoveFile(name);
+   } );
+
+   const double rate = project->GetRate();
+   MultiExporter exporter{ rate };
+   for (const auto &stem : stems) {
+      const auto name = stem.filename.GetFullPath();
+      auto stream = plugin->OpenStream(name, stem.channels, rate, subformat);
+      if (!stream)
+         return false;
+      names.push_back(name);
+      exporter.AddOutput(std::move(stream),
+         stem.tracks, stem.t0, stem.t1, stem.channels);
+   }
+
+   ProgressDialog dialog{ _("Export Multiple"),
+      wxString::Format(_("Exporting %d files"), (int)stems.size()) };
+   auto result = exporter.Process(dialog);
+
+   success =
+      result == ProgressResult::Success || result == ProgressResult::Stopped;
+
+   return success;
+}
+
 bool Exporter::ExamineTracks()
 {
    // Init
@@ -821,6 +1434,7 @@ bool Exporter::ExportTracks()
    } );
 
    std::unique_ptr<ProgressDialog> pDialog;
+   BlockIOStats::Scope ioScope{ BlockIOStats::Export };
    auto result = mPlugins[mFormat]->Export(mProject,
                                        pDialog,
                                        mChannels,
@@ -1122,10 +1736,27 @@ void ExportMixerPanel::OnPaint(wxPaintEvent & WXUNUSED(event))
    for( unsigned int i = 0; i < mMixerSpec->GetNumTracks(); i++ )
       for( unsigned int j = 0; j < mMixerSpec->GetNumChannels(); j++ )
          if( mMixerSpec->mMap[ i ][ j ] )
+         {
             AColor::Line(memDC, mTrackRects[ i ].x + mBoxWidth,
                   mTrackRects[ i ].y + mTrackHeight / 2, mChannelRects[ j ].x,
                   mChannelRects[ j ].y + mChannelHeight / 2 );
 
+            // Label a weighted link, a third of the way along
+            const float gain = mMixerSpec->mGain[ i ][ j ];
+            if( gain != 1.0f )
+            {
+               const wxString label = gain > 0
+                  ? wxString::Format( _( "%.1f dB" ), 20 * log10( gain ) )
+                  : wxString{ _( "Off" ) };
+               const int x1 = mTrackRects[ i ].x + mBoxWidth,
+                  y1 = mTrackRects[ i ].y + mTrackHeight / 2,
+                  x2 = mChannelRects[ j ].x,
+                  y2 = mChannelRects[ j ].y + mChannelHeight / 2;
+               memDC.DrawText( label, x1 + ( x2 - x1 ) / 3,
+                  y1 + ( y2 - y1 ) / 3 );
+            }
+         }
+
    dc.Blit( 0, 0, mWidth, mHeight, &memDC, 0, 0, wxCOPY, FALSE );
 }
 
@@ -1156,8 +1787,11 @@ void ExportMixerPanel::OnMouseEvent(wxMouseEvent & event)
             {
                mSelectedTrack = i;
                if( mSelectedChannel != -1 )
+               {
                   mMixerSpec->mMap[ mSelectedTrack ][ mSelectedChannel ] =
                      !mMixerSpec->mMap[ mSelectedTrack ][ mSelectedChannel ];
+                  mMixerSpec->mGain[ mSelectedTrack ][ mSelectedChannel ] = 1.0f;
+               }
             }
             goto found;
          }
@@ -1173,8 +1807,11 @@ void ExportMixerPanel::OnMouseEvent(wxMouseEvent & event)
             {
                mSelectedChannel = i;
                if( mSelectedTrack != -1 )
+               {
                   mMixerSpec->mMap[ mSelectedTrack ][ mSelectedChannel ] =
                      !mMixerSpec->mMap[ mSelectedTrack ][ mSelectedChannel ];
+                  mMixerSpec->mGain[ mSelectedTrack ][ mSelectedChannel ] = 1.0f;
+               }
             }
             goto found;
          }
@@ -1203,7 +1840,8 @@ found:
 enum
 {
    ID_MIXERPANEL = 10001,
-   ID_SLIDER_CHANNEL
+   ID_SLIDER_CHANNEL,
+   ID_DOWNMIX
 };
 
 BEGIN_EVENT_TABLE( ExportMixerDialog, wxDialogWrapper )
@@ -1211,6 +1849,7 @@ BEGIN_EVENT_TABLE( ExportMixerDialog, wxDialogWrapper )
    EVT_BUTTON( wxID_CANCEL, ExportMixerDialog::OnCancel )
    EVT_SIZE( ExportMixerDialog::OnSize )
    EVT_SLIDER( ID_SLIDER_CHANNEL, ExportMixerDialog::OnSlider )
+   EVT_BUTTON( ID_DOWNMIX, ExportMixerDialog::OnDownmix )
 END_EVENT_TABLE()
 
 ExportMixerDialog::ExportMixerDialog( const TrackList *tracks, bool selectedOnly,
@@ -1282,6 +1921,12 @@ ExportMixerDialog::ExportMixerDialog( const TrackList *tracks, bool selectedOnly
          channels->SetName(label);
          horSizer->Add(channels, 0, wxEXPAND | wxALL, 5);
 
+         // Six tracks are taken for a 5.1 mix
+         wxButton *downmix = safenew wxButton(this, ID_DOWNMIX,
+            _("&Downmix 5.1 to Stereo"));
+         downmix->Enable(numTracks == 6 && mMixerSpec->GetMaxNumChannels() >= 2);
+         horSizer->Add(downmix, 0, wxALIGN_CENTER_VERTICAL | wxALL, 5);
+
          vertSizer->Add(horSizer.release(), 0, wxALIGN_CENTRE | wxALL, 5);
       }
 
@@ -1323,6 +1968,16 @@ void ExportMixerDialog::OnSlider( wxCommandEvent & WXUNUSED(event))
    channels->SetName( label );
 }
 
+void ExportMixerDialog::OnDownmix( wxCommandEvent & WXUNUSED(event))
+{
+   if( !mMixerSpec->SetSurroundDownmix() )
+      return;
+   wxSlider *channels = ( wxSlider* )FindWindow( ID_SLIDER_CHANNEL );
+   channels->SetValue( mMixerSpec->GetNumChannels() );
+   wxCommandEvent e;
+   OnSlider( e );
+}
+
 void ExportMixerDialog::OnOk(wxCommandEvent & WXUNUSED(event))
 {
    EndModal( wxID_OK );
@@ -12,11 +12,14 @@
 #define __AUDACITY_EXPORT__
 
 #include "../MemoryX.h"
+#include <exception>
+#include <limits>
 #include <vector>
 #include <wx/dialog.h>
 #include <wx/filename.h>
 #include <wx/simplebook.h>
 #include "../SampleFormat.h"
+#include "../ondemand/ODTaskThread.h"
 #include "../widgets/wxPanelWrapper.h"
 
 class FileDialogWrapper;
@@ -30,9 +33,139 @@ class TrackList;
 class MixerSpec;
 class ProgressDialog;
 class Mixer;
+class MixerPool;
 using WaveTrackConstArray = std::vector < std::shared_ptr < const WaveTrack > >;
 enum class ProgressResult : unsigned;
 
+/// Runs Mixers on threads of their own, a few blocks ahead of the exporter
+/// that drains them, so that mixing overlaps encoding and writing.  Given
+/// several mixers of the same tracks and times, they take turns at the
+/// blocks, and the blocks still come out in order.  It offers the
+/// Process() and GetBuffer() of the Mixer.
+class AUDACITY_DLL_API PipelinedMixer final
+{
+public:
+   /// @param t0 the start time of the mixers
+   /// @param rate their output rate
+   PipelinedMixer(std::vector<std::unique_ptr<Mixer>> &&mixers,
+      double t0, double rate,
+      unsigned numChannels, size_t bufferSize, bool interleaved,
+      sampleFormat format);
+   ~PipelinedMixer();
+
+   PipelinedMixer(const PipelinedMixer&) PROHIBITED;
+   PipelinedMixer &operator= (const PipelinedMixer&) PROHIBITED;
+
+   /// Wait for the next block, which stays valid until the next call.
+   /// Returns its number of samples, or 0 when the mix is done.
+   /// Rethrows here what a Mixer threw on its thread.
+   size_t Process();
+
+   /// Retrieve the interleaved buffer of the block
+   samplePtr GetBuffer();
+   /// Retrieve one of the non-interleaved buffers of the block
+   samplePtr GetBuffer(int channel);
+
+   /// Samples per channel that Process() returned so far
+   sampleCount GetSamplesDone() const { return mSamplesDone; }
+
+private:
+   class Thread;
+   friend Thread;
+   void Run(size_t index);
+
+   struct Block {
+      ArrayOf<SampleBuffer> buffers;
+      size_t number { 0 };
+      size_t length { 0 };
+      bool ready { false };
+   };
+
+   std::vector<std::unique_ptr<Mixer>> mMixers;
+   const double mT0;
+   const double mRate;
+   const unsigned mNumChannels;
+   const size_t mBufferSize;
+   const bool mInterleaved;
+   const sampleFormat mFormat;
+
+   // Slots for the blocks mixed ahead, and one more for the block that the
+   // caller holds; block n goes to slot n modulo their number
+   ArrayOf<Block> mBlocks;
+   sampleCount mSamplesDone { 0 };
+
+   ODLock mLock; // for everything below
+   ODCondition mMixed { &mLock };
+   ODCondition mDrained { &mLock };
+   size_t mNextJob { 0 };   // the next block for a thread to mix
+   size_t mEndJob { std::numeric_limits<size_t>::max() };
+   size_t mNextOut { 0 };   // the block the caller holds or waits for
+   bool mHolding { false };
+   bool mStopping { false };
+   std::exception_ptr mError;
+   std::vector<std::unique_ptr<Thread>> mThreads;
+};
+
+/// A file that an ExportPlugin opened, into which the caller writes the
+/// samples, interleaved, and which it closes when done
+class AUDACITY_DLL_API ExportStream /* not final */
+{
+public:
+   virtual ~ExportStream();
+
+   /// The format of the samples that Write() takes
+   virtual sampleFormat GetFormat() const = 0;
+
+   /// Write len samples of each channel; false if they could not all be
+   /// written
+   virtual bool Write(samplePtr buffer, size_t len) = 0;
+
+   /// Finish the file; false on failure
+   virtual bool Close() = 0;
+
+   /// The message to show when Write() fails
+   virtual wxString GetWriteError() const = 0;
+};
+
+/// Exports several files at once, such as a stem of each track, or a file
+/// of each labelled region.  Each track is read once, through one
+/// WaveTrackCache, and all the outputs that use it mix from that read;
+/// the tracks are read, and the outputs mixed and written, on all cores.
+class AUDACITY_DLL_API MultiExporter final
+{
+public:
+   /// @param rate the rate of all the outputs
+   explicit MultiExporter(double rate);
+   ~MultiExporter();
+
+   MultiExporter(const MultiExporter&) PROHIBITED;
+   MultiExporter &operator= (const MultiExporter&) PROHIBITED;
+
+   /// Mix the tracks over [t0, t1) into numChannels of the stream.  Tracks
+   /// are shared among outputs that give the same pointer.
+   void AddOutput(std::unique_ptr<ExportStream> &&stream,
+      const WaveTrackConstArray &tracks, double t0, double t1,
+      unsigned numChannels);
+
+   /// Write all the outputs, and close their streams.  Shows the error,
+   /// and returns ProgressResult::Cancelled, if a write fails.
+   ProgressResult Process(ProgressDialog &dialog);
+
+private:
+   struct Source;
+   struct Output;
+
+   // Read the part of the window that some output needs
+   void Read(Source &source, sampleCount start, size_t len);
+   // Mix the part of the window that the output covers, and write it
+   void Write(Output &output, sampleCount start, size_t len);
+
+   const double mRate;
+   std::vector<std::unique_ptr<Source>> mSources;
+   std::vector<std::unique_ptr<Output>> mOutputs;
+   std::unique_ptr<MixerPool> mPool;
+};
+
 class AUDACITY_DLL_API FormatInfo
 {
    public:
@@ -125,6 +258,17 @@ public:
                        MixerSpec *mixerSpec = NULL,
                        int subformat = 0) = 0;
 
+   /** \brief called to open a file, for a caller that writes the samples
+    * itself, as MultiExporter does.
+    *
+    * @return null if the plug-in cannot, or if it fails, in which case it
+    * has alerted the user.  The default cannot.
+    */
+   virtual std::unique_ptr<ExportStream> OpenStream(const wxString &fName,
+                       unsigned channels,
+                       double rate,
+                       int subformat = 0);
+
 protected:
    std::unique_ptr<Mixer> CreateMixer(const WaveTrackConstArray &inputTracks,
          double startTime, double stopTime,
@@ -132,6 +276,15 @@ protected:
          double outRate, sampleFormat outFormat,
          bool highQuality = true, MixerSpec *mixerSpec = NULL);
 
+   // The same, but mixing on threads of their own while the caller writes,
+   // on all cores for a long export
+   std::unique_ptr<PipelinedMixer> CreatePipelinedMixer(
+         const WaveTrackConstArray &inputTracks,
+         double startTime, double stopTime,
+         unsigned numOutChannels, size_t outBufferSize, bool outInterleaved,
+         double outRate, sampleFormat outFormat,
+         bool highQuality = true, MixerSpec *mixerSpec = NULL);
+
    // Create or recycle a dialog.
    static void InitProgress(std::unique_ptr<ProgressDialog> &pDialog,
          const wxString &title, const wxString &message);
@@ -163,6 +316,19 @@ public:
                 const wxChar *type, const wxString & filename,
                 bool selectedOnly, double t0, double t1);
 
+   /// One file of an export of several at once
+   struct Stem {
+      wxFileName filename;
+      WaveTrackConstArray tracks;
+      double t0;
+      double t1;
+      unsigned channels;
+   };
+   /// Export each stem to its file, in the format of the given name, with
+   /// a MultiExporter that reads each track once for all of them
+   bool ProcessMultiple(AudacityProject *project, const wxChar *type,
+                        const std::vector<Stem> &stems);
+
    void DisplayOptions(int index);
    int FindFormatIndex(int exportindex);
 
@@ -282,6 +448,7 @@ private:
    void OnOk( wxCommandEvent &event );
    void OnCancel( wxCommandEvent &event );
    void OnSlider( wxCommandEvent &event );
+   void OnDownmix( wxCommandEvent &event );
    void OnSize( wxSizeEvent &event );
 
 private:
@@ -0,0 +1,537 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ExportFLAC.cpp
+
+  Frederik M.J.V
+
+*******************************************************************//**
+
+\class ExportFLAC
+\brief Exports FLAC files, encoding their frames on all cores.
+
+FLAC frames are independent, so the samples are cut into segments of
+whole blocks, and an encoder of its own encodes each segment on any
+thread.  The frames of each segment are then renumbered for their place
+in the whole stream, with their checksums redone, and written in order
+after one STREAMINFO for the whole.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "ExportFLAC.h"
+
+#ifdef USE_LIBFLAC
+
+#include <algorithm>
+#include <vector>
+
+#include <wx/defs.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/intl.h>
+#include <wx/string.h>
+#include <wx/thread.h>
+#include <wx/window.h>
+
+#include "FLAC++/encoder.h"
+
+#include "../Internat.h"
+#include "../Mix.h"
+#include "../MixerPool.h"
+#include "../Prefs.h"
+#include "../Project.h"
+#include "../ShuttleGui.h"
+#include "../Track.h"
+#include "../widgets/ErrorDialog.h"
+#include "../widgets/ProgressDialog.h"
+
+#include "Export.h"
+
+namespace {
+
+// Samples of each channel in each frame but the last
+const unsigned kBlockSize = 4096;
+
+// Frames of a segment, about 24 seconds at 44100 Hz
+const size_t kSegmentBlocks = 256;
+
+// Of frame headers: x^8 + x^2 + x + 1
+FLAC__byte CRC8(const FLAC__byte *data, size_t len)
+{
+   unsigned crc = 0;
+   while (len--) {
+      crc ^= *data++;
+      for (int i = 0; i < 8; ++i)
+         crc = ((crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1) & 0xFF;
+   }
+   return crc;
+}
+
+// Of whole frames: x^16 + x^15 + x^2 + 1
+unsigned CRC16(const FLAC__byte *data, size_t len)
+{
+   unsigned crc = 0;
+   while (len--) {
+      crc ^= unsigned(*data++) << 8;
+      for (int i = 0; i < 8; ++i)
+         crc = ((crc & 0x8000) ? (crc << 1) ^ 0x8005 : crc << 1) & 0xFFFF;
+   }
+   return crc;
+}
+
+// The frame number, coded as UTF-8 codes characters
+void AppendNumber(std::vector<FLAC__byte> &out, FLAC__uint32 number)
+{
+   if (number < 0x80) {
+      out.push_back(number);
+      return;
+   }
+   const int bytes = number < 0x800 ? 2 : number < 0x10000 ? 3
+      : number < 0x200000 ? 4 : number < 0x4000000 ? 5 : 6;
+   out.push_back(((0xFF00 >> bytes) & 0xFF) | (number >> (6 * (bytes - 1))));
+   for (int i = bytes - 2; i >= 0; --i)
+      out.push_back(0x80 | ((number >> (6 * i)) & 0x3F));
+}
+
+// The length of the coded number whose first byte this is
+size_t NumberLength(FLAC__byte first)
+{
+   return first < 0x80 ? 1 : first < 0xE0 ? 2 : first < 0xF0 ? 3
+      : first < 0xF8 ? 4 : first < 0xFC ? 5 : 6;
+}
+
+// Append a frame of the fixed block size, as the frame of that number
+void AppendRenumbered(std::vector<FLAC__byte> &out,
+                      const std::vector<FLAC__byte> &frame,
+                      FLAC__uint32 number)
+{
+   const auto start = out.size();
+   out.insert(out.end(), frame.begin(), frame.begin() + 4);
+   AppendNumber(out, number);
+
+   // The block size and rate, when their codes say they follow
+   auto pos = 4 + NumberLength(frame[4]);
+   const int blockCode = frame[2] >> 4, rateCode = frame[2] & 0x0F;
+   const size_t extra =
+      (blockCode == 6 ? 1 : blockCode == 7 ? 2 : 0) +
+      (rateCode == 12 ? 1 : (rateCode == 13 || rateCode == 14) ? 2 : 0);
+   out.insert(out.end(), frame.begin() + pos, frame.begin() + pos + extra);
+   out.push_back(CRC8(&out[start], out.size() - start));
+   pos += extra + 1;
+
+   // The subframes, and the checksum of all
+   out.insert(out.end(), frame.begin() + pos, frame.end() - 2);
+   const auto crc = CRC16(&out[start], out.size() - start);
+   out.push_back(crc >> 8);
+   out.push_back(crc & 0xFF);
+}
+
+// Collects the frames that it encodes, each apart
+class FLACSegmentEncoder final : public FLAC::Encoder::Stream
+{
+public:
+   std::vector<std::vector<FLAC__byte>> mFrames;
+
+protected:
+   ::FLAC__StreamEncoderWriteStatus write_callback(
+      const FLAC__byte buffer[], size_t bytes,
+      unsigned samples, unsigned) override
+   {
+      // The metadata of the segment is of no use
+      if (samples > 0)
+         mFrames.emplace_back(buffer, buffer + bytes);
+      return FLAC__STREAM_ENCODER_WRITE_STATUS_OK;
+   }
+};
+
+struct FLACSegment
+{
+   std::unique_ptr<FLACSegmentEncoder> encoder;
+   std::vector<FLAC__int32> samples;
+   bool failed { false };
+
+   void Encode(unsigned channels)
+   {
+      failed = !encoder->process_interleaved(
+            samples.data(), samples.size() / channels) ||
+         !encoder->finish();
+   }
+};
+
+} // namespace
+
+//----------------------------------------------------------------------------
+// FLACExportStream
+//----------------------------------------------------------------------------
+
+/// The samples of an export, encoded in segments on all cores
+class FLACExportStream final : public ExportStream
+{
+public:
+   FLACExportStream(unsigned channels, unsigned rate, unsigned bitsPerSample,
+                    unsigned level)
+      : mChannels{ channels }
+      , mRate{ rate }
+      , mBitsPerSample{ bitsPerSample }
+      , mLevel{ level }
+      , mThreads{ (unsigned)std::max(1, wxThread::GetCPUCount()) }
+      , mPool{ mThreads - 1 }
+   {}
+
+   // Write the header, with a STREAMINFO that Close() completes
+   bool Open(const wxString &fName)
+   {
+      if (!mFile.Open(fName, wxFile::write))
+         return false;
+      std::vector<FLAC__byte> header;
+      AppendHeader(header);
+      return mFile.Write(header.data(), header.size()) == header.size();
+   }
+
+   sampleFormat GetFormat() const override
+   {
+      return mBitsPerSample == 16 ? int16Sample : int24Sample;
+   }
+
+   bool Write(samplePtr buffer, size_t len) override
+   {
+      const auto count = len * mChannels;
+      if (mBitsPerSample == 16) {
+         const auto src = (const short *)buffer;
+         mPending.insert(mPending.end(), src, src + count);
+      }
+      else {
+         const auto src = (const int *)buffer;
+         mPending.insert(mPending.end(), src, src + count);
+      }
+
+      // Encode once there is a segment for each thread
+      const size_t segmentLen = kSegmentBlocks * kBlockSize * mChannels;
+      return mPending.size() < segmentLen * mThreads || EncodeBatch(false);
+   }
+
+   bool Close() override
+   {
+      while (!mPending.empty())
+         if (!EncodeBatch(true))
+            return false;
+
+      std::vector<FLAC__byte> header;
+      AppendHeader(header);
+      return mFile.Seek(0) == 0 &&
+         mFile.Write(header.data(), header.size()) == header.size() &&
+         mFile.Close();
+   }
+
+   wxString GetWriteError() const override
+   {
+      return _("Unable to write to the FLAC file (disk full?)");
+   }
+
+private:
+   // "fLaC" and the STREAMINFO of what was written so far.  The MD5 of the
+   // samples is left unknown, as each encoder has that only of its own.
+   void AppendHeader(std::vector<FLAC__byte> &out) const
+   {
+      const FLAC__byte magic[] = { 'f', 'L', 'a', 'C' };
+      out.insert(out.end(), magic, magic + 4);
+      // The last metadata block, of type 0, of 34 bytes
+      const FLAC__byte block[] = { 0x80, 0, 0, 34 };
+      out.insert(out.end(), block, block + 4);
+
+      auto put = [&](FLAC__uint64 value, int bytes) {
+         for (int i = bytes - 1; i >= 0; --i)
+            out.push_back((value >> (8 * i)) & 0xFF);
+      };
+      put(kBlockSize, 2);
+      put(kBlockSize, 2);
+      put(mMinFrameSize, 3);
+      put(mMaxFrameSize, 3);
+      // 20 bits of rate, 3 of channels, 5 of bits per sample, 36 of samples
+      put((FLAC__uint64(mRate) << 44) |
+          (FLAC__uint64(mChannels - 1) << 41) |
+          (FLAC__uint64(mBitsPerSample - 1) << 36) |
+          (mTotalSamples & 0xFFFFFFFFFULL), 8);
+      out.insert(out.end(), 16, 0);
+   }
+
+   // Encode a segment for each thread, or, if last, all the rest
+   bool EncodeBatch(bool last)
+   {
+      const size_t segmentLen = kSegmentBlocks * kBlockSize * mChannels;
+      std::vector<FLACSegment> batch;
+      size_t taken = 0;
+      while (batch.size() < mThreads &&
+             (last ? taken < mPending.size()
+                   : mPending.size() - taken >= segmentLen)) {
+         const auto len = std::min(segmentLen, mPending.size() - taken);
+
+         // Initialize here, on one thread
+         FLACSegment segment;
+         segment.encoder = std::make_unique<FLACSegmentEncoder>();
+         auto &encoder = *segment.encoder;
+         encoder.set_channels(mChannels);
+         encoder.set_bits_per_sample(mBitsPerSample);
+         encoder.set_sample_rate(mRate);
+         encoder.set_compression_level(mLevel);
+         // After the level, which sets it too
+         encoder.set_blocksize(kBlockSize);
+         if (encoder.init() != FLAC__STREAM_ENCODER_INIT_STATUS_OK)
+            return false;
+
+         segment.samples.assign(mPending.begin() + taken,
+                                mPending.begin() + taken + len);
+         taken += len;
+         batch.push_back(std::move(segment));
+      }
+      mPending.erase(mPending.begin(), mPending.begin() + taken);
+
+      mPool.Run(batch.size(), [&](size_t index) {
+         batch[index].Encode(mChannels);
+      });
+
+      std::vector<FLAC__byte> out;
+      for (auto &segment : batch) {
+         if (segment.failed)
+            return false;
+         out.clear();
+         for (const auto &frame : segment.encoder->mFrames) {
+            const auto start = out.size();
+            AppendRenumbered(out, frame, mNextFrame++);
+            const auto size = out.size() - start;
+            mMinFrameSize = mMinFrameSize == 0
+               ? size : std::min<size_t>(mMinFrameSize, size);
+            mMaxFrameSize = std::max<size_t>(mMaxFrameSize, size);
+         }
+         mTotalSamples += segment.samples.size() / mChannels;
+         if (mFile.Write(out.data(), out.size()) != out.size())
+            return false;
+      }
+      return true;
+   }
+
+   const unsigned mChannels;
+   const unsigned mRate;
+   const unsigned mBitsPerSample;
+   const unsigned mLevel;
+   const unsigned mThreads;
+   MixerPool mPool;
+
+   wxFile mFile;
+   // Samples not yet encoded, interleaved
+   std::vector<FLAC__int32> mPending;
+
+   FLAC__uint32 mNextFrame { 0 };
+   FLAC__uint64 mTotalSamples { 0 };
+   size_t mMinFrameSize { 0 };
+   size_t mMaxFrameSize { 0 };
+};
+
+//----------------------------------------------------------------------------
+// ExportFLACOptions Class
+//----------------------------------------------------------------------------
+
+class ExportFLACOptions final : public wxPanelWrapper
+{
+public:
+
+   ExportFLACOptions(wxWindow *parent, int format);
+   virtual ~ExportFLACOptions();
+
+   void PopulateOrExchange(ShuttleGui & S);
+   bool TransferDataToWindow() override;
+   bool TransferDataFromWindow() override;
+
+private:
+   wxArrayString mLevelNames;
+   std::vector<int> mLevels;
+   wxArrayString mBitDepthNames;
+   std::vector<int> mBitDepths;
+};
+
+ExportFLACOptions::ExportFLACOptions(wxWindow *parent, int WXUNUSED(format))
+:  wxPanelWrapper(parent, wxID_ANY)
+{
+   for (int level = 0; level <= 8; level++) {
+      mLevelNames.Add(level == 0 ? _("0 (fastest)")
+         : level == 8 ? _("8 (best)")
+         : wxString::Format(wxT("%d"), level));
+      mLevels.push_back(level);
+   }
+
+   mBitDepthNames.Add(_("16 bit"));
+   mBitDepths.push_back(16);
+   mBitDepthNames.Add(_("24 bit"));
+   mBitDepths.push_back(24);
+
+   ShuttleGui S(this, eIsCreatingFromPrefs);
+   PopulateOrExchange(S);
+
+   TransferDataToWindow();
+}
+
+ExportFLACOptions::~ExportFLACOptions()
+{
+   TransferDataFromWindow();
+}
+
+void ExportFLACOptions::PopulateOrExchange(ShuttleGui & S)
+{
+   S.StartVerticalLay();
+   {
+      S.StartHorizontalLay(wxCENTER);
+      {
+         S.StartMultiColumn(2, wxCENTER);
+         {
+            S.TieChoice(_("Level:"), wxT("/FileFormats/FLACLevel"),
+                        5, mLevelNames, mLevels);
+            S.TieChoice(_("Bit depth:"), wxT("/FileFormats/FLACBitDepth"),
+                        16, mBitDepthNames, mBitDepths);
+         }
+         S.EndMultiColumn();
+      }
+      S.EndHorizontalLay();
+   }
+   S.EndVerticalLay();
+}
+
+bool ExportFLACOptions::TransferDataToWindow()
+{
+   return true;
+}
+
+bool ExportFLACOptions::TransferDataFromWindow()
+{
+   ShuttleGui S(this, eIsSavingToPrefs);
+   PopulateOrExchange(S);
+
+   gPrefs->Flush();
+
+   return true;
+}
+
+//----------------------------------------------------------------------------
+// ExportFLAC Class
+//----------------------------------------------------------------------------
+
+class ExportFLAC final : public ExportPlugin
+{
+public:
+
+   ExportFLAC();
+
+   // Required
+
+   wxWindow *OptionsCreate(wxWindow *parent, int format) override;
+   ProgressResult Export(AudacityProject *project,
+               std::unique_ptr<ProgressDialog> &pDialog,
+               unsigned channels,
+               const wxString &fName,
+               bool selectedOnly,
+               double t0,
+               double t1,
+               MixerSpec *mixerSpec = NULL,
+               int subformat = 0) override;
+   std::unique_ptr<ExportStream> OpenStream(const wxString &fName,
+               unsigned channels, double rate, int subformat) override;
+};
+
+ExportFLAC::ExportFLAC()
+:  ExportPlugin()
+{
+   const int format = AddFormat() - 1;
+   SetFormat(wxT("FLAC"), format);
+   AddExtension(wxT("flac"), format);
+   SetMaxChannels(FLAC__MAX_CHANNELS, format);
+   SetCanMetaData(false, format);
+   SetDescription(_("FLAC Files"), format);
+}
+
+wxWindow *ExportFLAC::OptionsCreate(wxWindow *parent, int format)
+{
+   wxASSERT(parent); // to justify safenew
+   return safenew ExportFLACOptions(parent, format);
+}
+
+std::unique_ptr<ExportStream> ExportFLAC::OpenStream(const wxString &fName,
+   unsigned channels, double rate, int WXUNUSED(subformat))
+{
+   const long bitDepth = gPrefs->Read(wxT("/FileFormats/FLACBitDepth"), 16L);
+   const long level = gPrefs->Read(wxT("/FileFormats/FLACLevel"), 5L);
+   auto stream = std::make_unique<FLACExportStream>(channels,
+      (unsigned)(rate + 0.5), bitDepth == 24 ? 24 : 16,
+      (unsigned)std::max(0L, std::min(8L, level)));
+   if (!stream->Open(fName)) {
+      AudacityMessageBox(wxString::Format(_("Cannot export audio to %s"),
+                                          fName));
+      return {};
+   }
+   return stream;
+}
+
+ProgressResult ExportFLAC::Export(AudacityProject *project,
+                       std::unique_ptr<ProgressDialog> &pDialog,
+                       unsigned numChannels,
+                       const wxString &fName,
+                       bool selectionOnly,
+                       double t0,
+                       double t1,
+                       MixerSpec *mixerSpec,
+                       int subformat)
+{
+   const double rate = project->GetRate();
+   const TrackList *tracks = project->GetTracks();
+
+   auto stream = OpenStream(fName, numChannels, rate, subformat);
+   if (!stream)
+      return ProgressResult::Cancelled;
+
+   // A whole number of blocks
+   const size_t maxBlockLen = 16 * kBlockSize;
+
+   const WaveTrackConstArray waveTracks =
+      tracks->GetWaveTrackConstArray(selectionOnly, false);
+   auto mixer = CreatePipelinedMixer(waveTracks,
+                            t0, t1,
+                            numChannels, maxBlockLen, true,
+                            rate, stream->GetFormat(), true, mixerSpec);
+
+   InitProgress( pDialog, wxFileName(fName).GetName(),
+      selectionOnly
+         ? _("Exporting the selected audio as FLAC")
+         : _("Exporting the audio as FLAC") );
+
+   auto updateResult = ProgressResult::Success;
+   while (updateResult == ProgressResult::Success) {
+      const auto numSamples = mixer->Process();
+      if (numSamples == 0)
+         break;
+
+      if (!stream->Write(mixer->GetBuffer(), numSamples)) {
+         AudacityMessageBox(stream->GetWriteError());
+         return ProgressResult::Cancelled;
+      }
+
+      updateResult = pDialog->Update(
+         mixer->GetSamplesDone().as_double() / rate, t1 - t0);
+   }
+
+   if (updateResult == ProgressResult::Success ||
+       updateResult == ProgressResult::Stopped) {
+      if (!stream->Close()) {
+         AudacityMessageBox(stream->GetWriteError());
+         return ProgressResult::Cancelled;
+      }
+   }
+
+   return updateResult;
+}
+
+movable_ptr<ExportPlugin> New_ExportFLAC()
+{
+   return make_movable<ExportFLAC>();
+}
+
+#endif // USE_LIBFLAC
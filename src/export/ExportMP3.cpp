@@ -0,0 +1,791 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ExportMP3.cpp
+
+  Joshua Haberman
+
+*******************************************************************//**
+
+\class ExportMP3
+\brief Exports MP3 files with the LAME library, loaded when first needed.
+
+A long export is cut into segments that encode on all cores at once.  The
+bit reservoir is off for those, so that each frame stands alone, and an
+encoder of a segment then makes the same frames as an encoder of the
+whole.  It starts a few frames early, for its filters and psychoacoustic
+model to settle, and goes a few frames past the end, for the delay of the
+encoder; the frames of those are dropped, and what remains of the
+segments joins into one gapless stream.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "ExportMP3.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <wx/defs.h>
+#include <wx/dynlib.h>
+#include <wx/file.h>
+#include <wx/filedlg.h>
+#include <wx/filename.h>
+#include <wx/intl.h>
+#include <wx/log.h>
+#include <wx/string.h>
+#include <wx/thread.h>
+#include <wx/window.h>
+
+#include <lame/lame.h>
+
+#include "../FileNames.h"
+#include "../Internat.h"
+#include "../Mix.h"
+#include "../MixerPool.h"
+#include "../Prefs.h"
+#include "../Project.h"
+#include "../ShuttleGui.h"
+#include "../Track.h"
+#include "../widgets/ErrorDialog.h"
+#include "../widgets/ProgressDialog.h"
+
+#include "Export.h"
+
+//----------------------------------------------------------------------------
+// MP3Library
+//----------------------------------------------------------------------------
+
+/// The functions of LAME that the exporter uses, from the library that the
+/// user has, or linked with DISABLE_DYNAMIC_LOADING_LAME
+class MP3Library final
+{
+public:
+   static MP3Library &Get();
+
+   /// Load it, if not yet, from the path in the preferences, or else the
+   /// usual places.  If that fails and prompt, ask the user where it is.
+   bool Load(wxWindow *parent, bool prompt);
+   bool IsLoaded() const { return mLoaded; }
+
+   decltype(&::lame_init) init { nullptr };
+   decltype(&::lame_init_params) init_params { nullptr };
+   decltype(&::lame_close) close { nullptr };
+   decltype(&::lame_set_in_samplerate) set_in_samplerate { nullptr };
+   decltype(&::lame_set_num_channels) set_num_channels { nullptr };
+   decltype(&::lame_set_mode) set_mode { nullptr };
+   decltype(&::lame_set_brate) set_brate { nullptr };
+   decltype(&::lame_set_quality) set_quality { nullptr };
+   decltype(&::lame_set_disable_reservoir) set_disable_reservoir { nullptr };
+   decltype(&::lame_set_bWriteVbrTag) set_bWriteVbrTag { nullptr };
+   decltype(&::lame_encode_buffer) encode_buffer { nullptr };
+   decltype(&::lame_encode_buffer_interleaved)
+      encode_buffer_interleaved { nullptr };
+   decltype(&::lame_encode_flush) encode_flush { nullptr };
+   decltype(&::get_lame_version) get_version { nullptr };
+
+private:
+   bool LoadFrom(const wxString &path);
+#if !defined(DISABLE_DYNAMIC_LOADING_LAME)
+   template<typename F> bool Bind(F &function, const wxChar *name)
+   {
+      function = reinterpret_cast<F>(mLibrary->GetSymbol(name));
+      return function != nullptr;
+   }
+
+   std::unique_ptr<wxDynamicLibrary> mLibrary;
+#endif
+   bool mLoaded { false };
+};
+
+MP3Library &MP3Library::Get()
+{
+   static MP3Library library;
+   return library;
+}
+
+bool MP3Library::LoadFrom(const wxString &path)
+{
+#if defined(DISABLE_DYNAMIC_LOADING_LAME)
+   (void)path;
+   init = ::lame_init;
+   init_params = ::lame_init_params;
+   close = ::lame_close;
+   set_in_samplerate = ::lame_set_in_samplerate;
+   set_num_channels = ::lame_set_num_channels;
+   set_mode = ::lame_set_mode;
+   set_brate = ::lame_set_brate;
+   set_quality = ::lame_set_quality;
+   set_disable_reservoir = ::lame_set_disable_reservoir;
+   set_bWriteVbrTag = ::lame_set_bWriteVbrTag;
+   encode_buffer = ::lame_encode_buffer;
+   encode_buffer_interleaved = ::lame_encode_buffer_interleaved;
+   encode_flush = ::lame_encode_flush;
+   get_version = ::get_lame_version;
+   return mLoaded = true;
+#else
+   // Missing libraries and symbols are expected here; don't log them
+   wxLogNull logNo;
+   auto library = std::make_unique<wxDynamicLibrary>();
+   if (!library->Load(path, wxDL_LAZY))
+      return false;
+   mLibrary = std::move(library);
+
+   mLoaded =
+      Bind(init, wxT("lame_init")) &&
+      Bind(init_params, wxT("lame_init_params")) &&
+      Bind(close, wxT("lame_close")) &&
+      Bind(set_in_samplerate, wxT("lame_set_in_samplerate")) &&
+      Bind(set_num_channels, wxT("lame_set_num_channels")) &&
+      Bind(set_mode, wxT("lame_set_mode")) &&
+      Bind(set_brate, wxT("lame_set_brate")) &&
+      Bind(set_quality, wxT("lame_set_quality")) &&
+      Bind(set_disable_reservoir, wxT("lame_set_disable_reservoir")) &&
+      Bind(set_bWriteVbrTag, wxT("lame_set_bWriteVbrTag")) &&
+      Bind(encode_buffer, wxT("lame_encode_buffer")) &&
+      Bind(encode_buffer_interleaved, wxT("lame_encode_buffer_interleaved")) &&
+      Bind(encode_flush, wxT("lame_encode_flush")) &&
+      Bind(get_version, wxT("get_lame_version"));
+   if (!mLoaded)
+      mLibrary.reset();
+   return mLoaded;
+#endif
+}
+
+bool MP3Library::Load(wxWindow *parent, bool prompt)
+{
+   if (mLoaded)
+      return true;
+
+   const auto path = gPrefs->Read(wxT("/MP3/MP3LibPath"), wxT(""));
+   if (!path.empty() && LoadFrom(path))
+      return true;
+
+#if defined(__WXMSW__)
+   const wxChar *names[] = { wxT("libmp3lame.dll"), wxT("lame_enc.dll") };
+#elif defined(__WXMAC__)
+   const wxChar *names[] = { wxT("libmp3lame.dylib"),
+      wxT("/usr/local/lib/audacity/libmp3lame.dylib") };
+#else
+   const wxChar *names[] = { wxT("libmp3lame.so.0"), wxT("libmp3lame.so") };
+#endif
+   for (auto name : names)
+      if (LoadFrom(name))
+         return true;
+
+   if (!prompt)
+      return false;
+
+   const auto name = wxString{ names[0] }.AfterLast(wxT('/'));
+   const auto found = FileNames::SelectFile(FileNames::Operation::_None,
+      wxString::Format(_("Where is %s?"), name),
+      wxEmptyString, name, wxEmptyString,
+      wxString::Format(_("Only %s|%s|All Files|*"), name, name),
+      wxFD_OPEN | wxRESIZE_BORDER, parent);
+   if (found.empty() || !LoadFrom(found)) {
+      if (!found.empty())
+         AudacityMessageBox(wxString::Format(
+            _("%s is not a usable MP3 library."), found));
+      return false;
+   }
+
+   gPrefs->Write(wxT("/MP3/MP3LibPath"), found);
+   gPrefs->Flush();
+   return true;
+}
+
+wxString GetMP3Version(wxWindow *parent, bool prompt)
+{
+   auto &library = MP3Library::Get();
+   if (!library.Load(parent, prompt))
+      return _("MP3 export library not found");
+   return wxString::Format(wxT("LAME %s"),
+      wxString::FromAscii(library.get_version()));
+}
+
+//----------------------------------------------------------------------------
+// Encoding
+//----------------------------------------------------------------------------
+
+namespace {
+
+struct LameCloser {
+   void operator () (lame_global_flags *gfp) const
+   {
+      MP3Library::Get().close(gfp);
+   }
+};
+using LamePtr = std::unique_ptr<lame_global_flags, LameCloser>;
+
+struct MP3Settings
+{
+   int rate;
+   unsigned channels;
+   int bitrate;
+   bool joint;
+};
+
+MP3Settings ReadSettings(double rate, unsigned channels)
+{
+   MP3Settings settings;
+   settings.rate = (int)(rate + 0.5);
+   settings.channels = channels;
+   settings.bitrate = gPrefs->Read(wxT("/FileFormats/MP3Bitrate"), 128L);
+   settings.joint = gPrefs->Read(wxT("/FileFormats/MP3JointStereo"), 1L) != 0;
+   return settings;
+}
+
+// Make an encoder; the bit reservoir is off for an encoder of a segment.
+// Not thread safe, as lame_init() fills shared tables the first time.
+LamePtr MakeEncoder(const MP3Settings &settings, bool reservoir)
+{
+   auto &lib = MP3Library::Get();
+   LamePtr gfp{ lib.init() };
+   if (!gfp)
+      return {};
+   lib.set_in_samplerate(gfp.get(), settings.rate);
+   lib.set_num_channels(gfp.get(), settings.channels);
+   lib.set_mode(gfp.get(), settings.channels == 1
+      ? MONO : settings.joint ? JOINT_STEREO : STEREO);
+   lib.set_brate(gfp.get(), settings.bitrate);
+   // Good quality, at a cost still modest for a long export
+   lib.set_quality(gfp.get(), 2);
+   lib.set_disable_reservoir(gfp.get(), reservoir ? 0 : 1);
+   // The stream is made of frames only, so that segments join, and their
+   // frames can be counted
+   lib.set_bWriteVbrTag(gfp.get(), 0);
+   if (lib.init_params(gfp.get()) < 0)
+      return {};
+   return gfp;
+}
+
+// Samples encoded at once, which bounds the output buffer
+const size_t kEncodeChunk = 65536;
+
+// Encode len interleaved samples of each channel, appending the bytes to
+// output; false on failure
+bool Encode(lame_global_flags *gfp, unsigned channels,
+            short *samples, size_t len, std::vector<unsigned char> &output)
+{
+   auto &lib = MP3Library::Get();
+   for (size_t done = 0; done < len;) {
+      const auto count = std::min(len - done, kEncodeChunk);
+      // The worst case, as lame.h gives it
+      const size_t size = count * 5 / 4 + 7200;
+      const auto oldSize = output.size();
+      output.resize(oldSize + size);
+      const int result = channels == 1
+         ? lib.encode_buffer(gfp, samples + done, samples + done,
+              count, &output[oldSize], size)
+         : lib.encode_buffer_interleaved(gfp, samples + done * channels,
+              count, &output[oldSize], size);
+      if (result < 0) {
+         output.resize(oldSize);
+         return false;
+      }
+      output.resize(oldSize + result);
+      done += count;
+   }
+   return true;
+}
+
+// Pad and encode the last frames
+bool Flush(lame_global_flags *gfp, std::vector<unsigned char> &output)
+{
+   const size_t size = 7200;
+   const auto oldSize = output.size();
+   output.resize(oldSize + size);
+   const int result =
+      MP3Library::Get().encode_flush(gfp, &output[oldSize], size);
+   if (result < 0) {
+      output.resize(oldSize);
+      return false;
+   }
+   output.resize(oldSize + result);
+   return true;
+}
+
+// The length of the layer III frame whose header starts at p, or 0 if none
+// does
+size_t FrameLength(const unsigned char *p, size_t available)
+{
+   if (available < 4 || p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+      return 0;
+   // 3 is MPEG 1, 2 is MPEG 2, 0 is MPEG 2.5
+   const int version = (p[1] >> 3) & 3;
+   const int layer = (p[1] >> 1) & 3;
+   const int bitrateIndex = p[2] >> 4;
+   const int rateIndex = (p[2] >> 2) & 3;
+   const int padding = (p[2] >> 1) & 1;
+   if (version == 1 || layer != 1 ||
+       bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+      return 0;
+
+   static const int kBitrates[2][16] = {
+      { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 0 },
+      { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160, 0 },
+   };
+   static const int kRates[4][3] = {
+      { 11025, 12000, 8000 },
+      { 0, 0, 0 },
+      { 22050, 24000, 16000 },
+      { 44100, 48000, 32000 },
+   };
+   const bool mpeg1 = version == 3;
+   const int bitrate = kBitrates[mpeg1 ? 0 : 1][bitrateIndex] * 1000;
+   const int rate = kRates[version][rateIndex];
+   return (mpeg1 ? 144 : 72) * bitrate / rate + padding;
+}
+
+bool IsMP3Rate(int rate)
+{
+   static const int kRates[] =
+      { 8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000 };
+   return std::find(std::begin(kRates), std::end(kRates), rate) !=
+      std::end(kRates);
+}
+
+// Frames of a segment, about half a minute at 44100 Hz
+const size_t kSegmentFrames = 1024;
+// Frames encoded before and after a segment, and dropped
+const size_t kPreRollFrames = 8;
+const size_t kPostRollFrames = 4;
+
+/// A part of a long export, which an encoder of its own encodes on any
+/// thread
+struct MP3Segment
+{
+   // The frames of the whole stream that it keeps, the last one keeping all
+   // to the end
+   size_t firstFrame;
+   size_t endFrame;
+   // The frame of the whole stream where its input starts
+   size_t inputFrame;
+
+   std::vector<short> samples;
+   LamePtr encoder;
+   std::vector<unsigned char> output;
+   bool failed { false };
+
+   void EncodeSegment(unsigned channels)
+   {
+      std::vector<unsigned char> encoded;
+      if (!Encode(encoder.get(), channels, samples.data(),
+                    samples.size() / channels, encoded) ||
+          !Flush(encoder.get(), encoded)) {
+         failed = true;
+         return;
+      }
+      encoder.reset();
+
+      // Keep the frames of the segment itself
+      size_t frame = inputFrame;
+      for (size_t pos = 0; pos < encoded.size(); ++frame) {
+         const auto length =
+            FrameLength(&encoded[pos], encoded.size() - pos);
+         if (length == 0 || pos + length > encoded.size()) {
+            failed = true;
+            return;
+         }
+         if (frame >= firstFrame && frame < endFrame)
+            output.insert(output.end(),
+               encoded.begin() + pos, encoded.begin() + pos + length);
+         pos += length;
+      }
+   }
+};
+
+} // namespace
+
+//----------------------------------------------------------------------------
+// MP3ExportStream
+//----------------------------------------------------------------------------
+
+/// The samples of an export, encoded by one encoder into the file
+class MP3ExportStream final : public ExportStream
+{
+public:
+   sampleFormat GetFormat() const override { return int16Sample; }
+
+   bool Write(samplePtr buffer, size_t len) override
+   {
+      mOutput.clear();
+      return Encode(mEncoder.get(), mChannels, (short *)buffer, len, mOutput)
+         && WriteOutput();
+   }
+
+   bool Close() override
+   {
+      mOutput.clear();
+      return Flush(mEncoder.get(), mOutput) && WriteOutput() && mFile.Close();
+   }
+
+   wxString GetWriteError() const override
+   {
+      return _("Unable to write to the MP3 file (disk full?)");
+   }
+
+   bool WriteOutput()
+   {
+      return mOutput.empty() ||
+         mFile.Write(mOutput.data(), mOutput.size()) == mOutput.size();
+   }
+
+   wxFile mFile;
+   LamePtr mEncoder;
+   unsigned mChannels;
+   std::vector<unsigned char> mOutput;
+};
+
+//----------------------------------------------------------------------------
+// ExportMP3Options Class
+//----------------------------------------------------------------------------
+
+class ExportMP3Options final : public wxPanelWrapper
+{
+public:
+
+   ExportMP3Options(wxWindow *parent, int format);
+   virtual ~ExportMP3Options();
+
+   void PopulateOrExchange(ShuttleGui & S);
+   bool TransferDataToWindow() override;
+   bool TransferDataFromWindow() override;
+
+private:
+   wxArrayString mBitrateNames;
+   std::vector<int> mBitrates;
+};
+
+ExportMP3Options::ExportMP3Options(wxWindow *parent, int WXUNUSED(format))
+:  wxPanelWrapper(parent, wxID_ANY)
+{
+   for (int bitrate : { 32, 40, 48, 56, 64, 80, 96, 112, 128,
+                        160, 192, 224, 256, 320 }) {
+      mBitrateNames.Add(wxString::Format(_("%d kbps"), bitrate));
+      mBitrates.push_back(bitrate);
+   }
+
+   ShuttleGui S(this, eIsCreatingFromPrefs);
+   PopulateOrExchange(S);
+
+   TransferDataToWindow();
+}
+
+ExportMP3Options::~ExportMP3Options()
+{
+   TransferDataFromWindow();
+}
+
+void ExportMP3Options::PopulateOrExchange(ShuttleGui & S)
+{
+   S.StartVerticalLay();
+   {
+      S.StartHorizontalLay(wxCENTER);
+      {
+         S.StartMultiColumn(2, wxCENTER);
+         {
+            S.TieChoice(_("Bit Rate:"),
+                        wxT("/FileFormats/MP3Bitrate"),
+                        128,
+                        mBitrateNames,
+                        mBitrates);
+         }
+         S.EndMultiColumn();
+      }
+      S.EndHorizontalLay();
+
+      S.TieCheckBox(_("&Joint stereo"),
+                    wxT("/FileFormats/MP3JointStereo"),
+                    true);
+   }
+   S.EndVerticalLay();
+}
+
+bool ExportMP3Options::TransferDataToWindow()
+{
+   return true;
+}
+
+bool ExportMP3Options::TransferDataFromWindow()
+{
+   ShuttleGui S(this, eIsSavingToPrefs);
+   PopulateOrExchange(S);
+
+   gPrefs->Flush();
+
+   return true;
+}
+
+//----------------------------------------------------------------------------
+// ExportMP3 Class
+//----------------------------------------------------------------------------
+
+class ExportMP3 final : public ExportPlugin
+{
+public:
+
+   ExportMP3();
+
+   // Required
+
+   wxWindow *OptionsCreate(wxWindow *parent, int format) override;
+   ProgressResult Export(AudacityProject *project,
+               std::unique_ptr<ProgressDialog> &pDialog,
+               unsigned channels,
+               const wxString &fName,
+               bool selectedOnly,
+               double t0,
+               double t1,
+               MixerSpec *mixerSpec = NULL,
+               int subformat = 0) override;
+   std::unique_ptr<ExportStream> OpenStream(const wxString &fName,
+               unsigned channels, double rate, int subformat) override;
+
+private:
+   // Shows the error, and returns null, if it fails
+   std::unique_ptr<MP3ExportStream> OpenMP3Stream(const wxString &fName,
+               const MP3Settings &settings);
+
+   // Encode segments on all cores, and write them in order
+   ProgressResult ExportSegments(PipelinedMixer &mixer,
+               ProgressDialog &dialog, const MP3Settings &settings,
+               const wxString &fName, double duration);
+};
+
+ExportMP3::ExportMP3()
+:  ExportPlugin()
+{
+   const int format = AddFormat() - 1;
+   SetFormat(wxT("MP3"), format);
+   AddExtension(wxT("mp3"), format);
+   SetMaxChannels(2, format);
+   SetCanMetaData(false, format);
+   SetDescription(_("MP3 Files"), format);
+}
+
+wxWindow *ExportMP3::OptionsCreate(wxWindow *parent, int format)
+{
+   wxASSERT(parent); // to justify safenew
+   return safenew ExportMP3Options(parent, format);
+}
+
+std::unique_ptr<MP3ExportStream> ExportMP3::OpenMP3Stream(
+   const wxString &fName, const MP3Settings &settings)
+{
+   if (!MP3Library::Get().Load(nullptr, true)) {
+      AudacityMessageBox(_("Could not open MP3 encoding library!"));
+      return {};
+   }
+
+   auto stream = std::make_unique<MP3ExportStream>();
+   stream->mChannels = settings.channels;
+   stream->mEncoder = MakeEncoder(settings, true);
+   if (!stream->mEncoder) {
+      AudacityMessageBox(_("Not all the settings of the MP3 export suit the "
+                           "project rate."));
+      return {};
+   }
+
+   if (!stream->mFile.Open(fName, wxFile::write)) {
+      AudacityMessageBox(wxString::Format(_("Cannot export audio to %s"),
+                                          fName));
+      return {};
+   }
+
+   return stream;
+}
+
+std::unique_ptr<ExportStream> ExportMP3::OpenStream(const wxString &fName,
+   unsigned channels, double rate, int WXUNUSED(subformat))
+{
+   return OpenMP3Stream(fName, ReadSettings(rate, channels));
+}
+
+ProgressResult ExportMP3::Export(AudacityProject *project,
+                       std::unique_ptr<ProgressDialog> &pDialog,
+                       unsigned numChannels,
+                       const wxString &fName,
+                       bool selectionOnly,
+                       double t0,
+                       double t1,
+                       MixerSpec *mixerSpec,
+                       int WXUNUSED(subformat))
+{
+   const double rate = project->GetRate();
+   const TrackList *tracks = project->GetTracks();
+   const auto settings = ReadSettings(rate, numChannels);
+
+   // A whole number of the longest frames
+   const size_t maxBlockLen = 64 * 1152;
+
+   const WaveTrackConstArray waveTracks =
+      tracks->GetWaveTrackConstArray(selectionOnly, false);
+   auto mixer = CreatePipelinedMixer(waveTracks,
+                            t0, t1,
+                            numChannels, maxBlockLen, true,
+                            rate, int16Sample, true, mixerSpec);
+
+   // Once the library is loaded
+   const auto message = [&]{
+      return wxString::Format(selectionOnly
+         ? _("Exporting selected audio with %s")
+         : _("Exporting the audio with %s"),
+         GetMP3Version(nullptr, false));
+   };
+
+   // Long exports at the rates of MP3 itself encode in parallel.  Other
+   // rates are resampled inside LAME, which has state across segments.
+   const size_t frameLen = settings.rate >= 32000 ? 1152 : 576;
+   const auto nFrames = size_t((t1 - t0) * rate / frameLen);
+   if (IsMP3Rate(settings.rate) && wxThread::GetCPUCount() > 1 &&
+       nFrames >= 2 * kSegmentFrames) {
+      if (!MP3Library::Get().Load(nullptr, true)) {
+         AudacityMessageBox(_("Could not open MP3 encoding library!"));
+         return ProgressResult::Cancelled;
+      }
+      InitProgress( pDialog, wxFileName(fName).GetName(), message() );
+      return ExportSegments(*mixer, *pDialog, settings, fName, t1 - t0);
+   }
+
+   auto stream = OpenMP3Stream(fName, settings);
+   if (!stream)
+      return ProgressResult::Cancelled;
+
+   InitProgress( pDialog, wxFileName(fName).GetName(), message() );
+
+   auto updateResult = ProgressResult::Success;
+   while (updateResult == ProgressResult::Success) {
+      const auto numSamples = mixer->Process();
+      if (numSamples == 0)
+         break;
+
+      if (!stream->Write(mixer->GetBuffer(), numSamples)) {
+         AudacityMessageBox(stream->GetWriteError());
+         return ProgressResult::Cancelled;
+      }
+
+      updateResult = pDialog->Update(
+         mixer->GetSamplesDone().as_double() / rate, t1 - t0);
+   }
+
+   if (updateResult == ProgressResult::Success ||
+       updateResult == ProgressResult::Stopped) {
+      if (!stream->Close()) {
+         AudacityMessageBox(stream->GetWriteError());
+         return ProgressResult::Cancelled;
+      }
+   }
+
+   return updateResult;
+}
+
+ProgressResult ExportMP3::ExportSegments(PipelinedMixer &mixer,
+   ProgressDialog &dialog, const MP3Settings &settings,
+   const wxString &fName, double duration)
+{
+   wxFile file;
+   if (!file.Open(fName, wxFile::write)) {
+      AudacityMessageBox(wxString::Format(_("Cannot export audio to %s"),
+                                          fName));
+      return ProgressResult::Cancelled;
+   }
+
+   const unsigned channels = settings.channels;
+   const size_t frameLen = settings.rate >= 32000 ? 1152 : 576;
+   const auto nThreads = (unsigned)std::max(1, wxThread::GetCPUCount());
+   MixerPool pool{ nThreads - 1 };
+
+   // Mixed samples, interleaved, from the sample of frame pendingFrame
+   std::vector<short> pending;
+   size_t pendingFrame = 0;
+   bool mixed = false;
+
+   std::vector<MP3Segment> batch;
+   size_t nextSegment = 0;
+   auto updateResult = ProgressResult::Success;
+   while (!mixed || !batch.empty()) {
+      // Gather a segment for each thread, or those that remain
+      while (!mixed && batch.size() < nThreads) {
+         const auto first = nextSegment * kSegmentFrames;
+         const auto end = first + kSegmentFrames;
+         const auto inputFrame = first - std::min(first, kPreRollFrames);
+         const auto inputEnd = (end + kPostRollFrames) * frameLen;
+
+         while (!mixed &&
+                pendingFrame * frameLen + pending.size() / channels < inputEnd) {
+            const auto numSamples = mixer.Process();
+            if (numSamples == 0)
+               mixed = true;
+            else {
+               const auto buffer = (const short *)mixer.GetBuffer();
+               pending.insert(pending.end(),
+                  buffer, buffer + numSamples * channels);
+            }
+         }
+
+         // Make the encoders here, as lame_init() is not thread safe
+         MP3Segment segment;
+         segment.firstFrame = first;
+         segment.endFrame = mixed ? std::numeric_limits<size_t>::max() : end;
+         segment.inputFrame = inputFrame;
+         segment.encoder = MakeEncoder(settings, false);
+         if (!segment.encoder) {
+            AudacityMessageBox(_("Not all the settings of the MP3 export "
+                                 "suit the project rate."));
+            return ProgressResult::Cancelled;
+         }
+         const auto from = (inputFrame - pendingFrame) * frameLen * channels;
+         const auto to = std::min(pending.size(),
+            (inputEnd - pendingFrame * frameLen) * channels);
+         segment.samples.assign(pending.begin() + from, pending.begin() + to);
+         batch.push_back(std::move(segment));
+         ++nextSegment;
+
+         // The next segment starts its input a few frames before its own
+         const auto nextInput = end - kPreRollFrames;
+         if (!mixed) {
+            pending.erase(pending.begin(), pending.begin() +
+               (nextInput - pendingFrame) * frameLen * channels);
+            pendingFrame = nextInput;
+         }
+      }
+
+      pool.Run(batch.size(), [&](size_t index) {
+         batch[index].EncodeSegment(channels);
+      });
+
+      for (const auto &segment : batch) {
+         if (segment.failed ||
+             file.Write(segment.output.data(), segment.output.size()) !=
+                segment.output.size()) {
+            AudacityMessageBox(
+               _("Unable to write to the MP3 file (disk full?)"));
+            return ProgressResult::Cancelled;
+         }
+      }
+      batch.clear();
+
+      updateResult = dialog.Update(
+         mixer.GetSamplesDone().as_double() / settings.rate, duration);
+      if (updateResult != ProgressResult::Success)
+         break;
+   }
+
+   if (updateResult == ProgressResult::Success ||
+       updateResult == ProgressResult::Stopped) {
+      if (!file.Close()) {
+         AudacityMessageBox(_("Unable to export"));
+         return ProgressResult::Cancelled;
+      }
+   }
+
+   return updateResult;
+}
+
+movable_ptr<ExportPlugin> New_ExportMP3()
+{
+   return make_movable<ExportMP3>();
+}
@@ -0,0 +1,32 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ExportMP3.h
+
+  Dominic Mazzoni
+
+**********************************************************************/
+
+#ifndef __AUDACITY_EXPORTMP3__
+#define __AUDACITY_EXPORTMP3__
+
+#include "../MemoryX.h"
+#include <wx/string.h>
+
+class ExportPlugin;
+class wxWindow;
+
+/** The only part of this class which is publically accessible is the
+ * factory method New_ExportMP3() which creates a NEW ExportMP3 object and
+ * returns a pointer to it. The rest of the class declaration is in ExportMP3.cpp
+ */
+movable_ptr<ExportPlugin> New_ExportMP3();
+
+/** Loads the LAME library, if not yet loaded, asking the user where it is
+ * if prompt and it is not found, and returns its version, or a message
+ * that it was not found
+ */
+wxString GetMP3Version(wxWindow *parent, bool prompt);
+
+#endif
@@ -0,0 +1,366 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ExportOGG.cpp
+
+  Joshua Haberman
+
+*******************************************************************//**
+
+\class ExportOGG
+\brief Exports Ogg Vorbis files.
+
+Each Vorbis packet overlaps the one before it, so one encoder takes the
+samples in order; the mixing runs on a thread of its own meanwhile.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "ExportOGG.h"
+
+#ifdef USE_LIBVORBIS
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+#include <wx/defs.h>
+#include <wx/file.h>
+#include <wx/filename.h>
+#include <wx/intl.h>
+#include <wx/string.h>
+#include <wx/window.h>
+
+#include <vorbis/vorbisenc.h>
+
+#include "../Internat.h"
+#include "../Mix.h"
+#include "../Prefs.h"
+#include "../Project.h"
+#include "../ShuttleGui.h"
+#include "../Track.h"
+#include "../widgets/ErrorDialog.h"
+#include "../widgets/ProgressDialog.h"
+
+#include "Export.h"
+
+//----------------------------------------------------------------------------
+// OGGExportStream
+//----------------------------------------------------------------------------
+
+/// The samples of an export, encoded as Vorbis in an Ogg stream
+class OGGExportStream final : public ExportStream
+{
+public:
+   OGGExportStream(unsigned channels)
+      : mChannels{ channels }
+   {
+      vorbis_info_init(&mInfo);
+      vorbis_comment_init(&mComment);
+   }
+
+   ~OGGExportStream()
+   {
+      if (mStarted) {
+         ogg_stream_clear(&mStream);
+         vorbis_block_clear(&mBlock);
+         vorbis_dsp_clear(&mDsp);
+      }
+      vorbis_comment_clear(&mComment);
+      vorbis_info_clear(&mInfo);
+   }
+
+   // Quality is from 0 to 10, as the options show it
+   bool Open(const wxString &fName, long rate, int quality)
+   {
+      if (vorbis_encode_init_vbr(&mInfo, mChannels, rate, quality / 10.0f))
+         return false;
+      if (!mFile.Open(fName, wxFile::write))
+         return false;
+
+      vorbis_comment_add_tag(&mComment, "ENCODER", "Audacity");
+      vorbis_analysis_init(&mDsp, &mInfo);
+      vorbis_block_init(&mDsp, &mBlock);
+      // Any serial number will do, for a stream alone in its file
+      ogg_stream_init(&mStream, rand());
+      mStarted = true;
+
+      // The three headers, each flushed to pages of their own
+      ogg_packet id, comment, codebook;
+      vorbis_analysis_headerout(&mDsp, &mComment, &id, &comment, &codebook);
+      ogg_stream_packetin(&mStream, &id);
+      ogg_stream_packetin(&mStream, &comment);
+      ogg_stream_packetin(&mStream, &codebook);
+      ogg_page page;
+      while (ogg_stream_flush(&mStream, &page))
+         if (!WritePage(page))
+            return false;
+      return true;
+   }
+
+   sampleFormat GetFormat() const override
+   {
+      return floatSample;
+   }
+
+   bool Write(samplePtr buffer, size_t len) override
+   {
+      // Deinterleave into the buffers of the encoder
+      float **vorbis_buffer = vorbis_analysis_buffer(&mDsp, len);
+      const auto src = (const float *)buffer;
+      for (size_t i = 0; i < len; i++)
+         for (unsigned c = 0; c < mChannels; c++)
+            vorbis_buffer[c][i] = src[i * mChannels + c];
+      vorbis_analysis_wrote(&mDsp, len);
+      return Drain();
+   }
+
+   bool Close() override
+   {
+      // Zero samples mark the end of the stream
+      vorbis_analysis_wrote(&mDsp, 0);
+      if (!Drain())
+         return false;
+      // The last page is out only by flushing
+      ogg_page page;
+      while (ogg_stream_flush(&mStream, &page))
+         if (!WritePage(page))
+            return false;
+      return mFile.Close();
+   }
+
+   wxString GetWriteError() const override
+   {
+      return _("Unable to write to the Ogg file (disk full?)");
+   }
+
+private:
+   // Encode the blocks that are ready, and write the pages they fill
+   bool Drain()
+   {
+      ogg_packet packet;
+      ogg_page page;
+      while (vorbis_analysis_blockout(&mDsp, &mBlock) == 1) {
+         vorbis_analysis(&mBlock, NULL);
+         vorbis_bitrate_addblock(&mBlock);
+         while (vorbis_bitrate_flushpacket(&mDsp, &packet)) {
+            ogg_stream_packetin(&mStream, &packet);
+            while (ogg_stream_pageout(&mStream, &page))
+               if (!WritePage(page))
+                  return false;
+         }
+      }
+      return true;
+   }
+
+   bool WritePage(const ogg_page &page)
+   {
+      return
+         mFile.Write(page.header, page.header_len) == (size_t)page.header_len &&
+         mFile.Write(page.body, page.body_len) == (size_t)page.body_len;
+   }
+
+   const unsigned mChannels;
+   wxFile mFile;
+
+   vorbis_info mInfo;
+   vorbis_comment mComment;
+   vorbis_dsp_state mDsp;
+   vorbis_block mBlock;
+   ogg_stream_state mStream;
+   bool mStarted { false };
+};
+
+//----------------------------------------------------------------------------
+// ExportOGGOptions Class
+//----------------------------------------------------------------------------
+
+class ExportOGGOptions final : public wxPanelWrapper
+{
+public:
+
+   ExportOGGOptions(wxWindow *parent, int format);
+   virtual ~ExportOGGOptions();
+
+   void PopulateOrExchange(ShuttleGui & S);
+   bool TransferDataToWindow() override;
+   bool TransferDataFromWindow() override;
+
+private:
+   wxArrayString mQualityNames;
+   std::vector<int> mQualities;
+};
+
+ExportOGGOptions::ExportOGGOptions(wxWindow *parent, int WXUNUSED(format))
+:  wxPanelWrapper(parent, wxID_ANY)
+{
+   for (int quality = 0; quality <= 10; quality++) {
+      mQualityNames.Add(wxString::Format(wxT("%d"), quality));
+      mQualities.push_back(quality);
+   }
+
+   ShuttleGui S(this, eIsCreatingFromPrefs);
+   PopulateOrExchange(S);
+
+   TransferDataToWindow();
+}
+
+ExportOGGOptions::~ExportOGGOptions()
+{
+   TransferDataFromWindow();
+}
+
+void ExportOGGOptions::PopulateOrExchange(ShuttleGui & S)
+{
+   S.StartVerticalLay();
+   {
+      S.StartHorizontalLay(wxCENTER);
+      {
+         S.StartMultiColumn(2, wxCENTER);
+         {
+            S.TieChoice(_("Quality:"), wxT("/FileFormats/OggExportQuality"),
+                        5, mQualityNames, mQualities);
+         }
+         S.EndMultiColumn();
+      }
+      S.EndHorizontalLay();
+   }
+   S.EndVerticalLay();
+}
+
+bool ExportOGGOptions::TransferDataToWindow()
+{
+   return true;
+}
+
+bool ExportOGGOptions::TransferDataFromWindow()
+{
+   ShuttleGui S(this, eIsSavingToPrefs);
+   PopulateOrExchange(S);
+
+   gPrefs->Flush();
+
+   return true;
+}
+
+//----------------------------------------------------------------------------
+// ExportOGG Class
+//----------------------------------------------------------------------------
+
+class ExportOGG final : public ExportPlugin
+{
+public:
+
+   ExportOGG();
+
+   // Required
+
+   wxWindow *OptionsCreate(wxWindow *parent, int format) override;
+   ProgressResult Export(AudacityProject *project,
+               std::unique_ptr<ProgressDialog> &pDialog,
+               unsigned channels,
+               const wxString &fName,
+               bool selectedOnly,
+               double t0,
+               double t1,
+               MixerSpec *mixerSpec = NULL,
+               int subformat = 0) override;
+   std::unique_ptr<ExportStream> OpenStream(const wxString &fName,
+               unsigned channels, double rate, int subformat) override;
+};
+
+ExportOGG::ExportOGG()
+:  ExportPlugin()
+{
+   const int format = AddFormat() - 1;
+   SetFormat(wxT("OGG"), format);
+   AddExtension(wxT("ogg"), format);
+   SetMaxChannels(255, format);
+   SetCanMetaData(false, format);
+   SetDescription(_("Ogg Vorbis Files"), format);
+}
+
+wxWindow *ExportOGG::OptionsCreate(wxWindow *parent, int format)
+{
+   wxASSERT(parent); // to justify safenew
+   return safenew ExportOGGOptions(parent, format);
+}
+
+std::unique_ptr<ExportStream> ExportOGG::OpenStream(const wxString &fName,
+   unsigned channels, double rate, int WXUNUSED(subformat))
+{
+   const long quality = gPrefs->Read(wxT("/FileFormats/OggExportQuality"), 5L);
+   auto stream = std::make_unique<OGGExportStream>(channels);
+   if (!stream->Open(fName, (long)(rate + 0.5),
+                     (int)std::max(0L, std::min(10L, quality)))) {
+      AudacityMessageBox(wxString::Format(_("Cannot export audio to %s"),
+                                          fName));
+      return {};
+   }
+   return stream;
+}
+
+ProgressResult ExportOGG::Export(AudacityProject *project,
+                       std::unique_ptr<ProgressDialog> &pDialog,
+                       unsigned numChannels,
+                       const wxString &fName,
+                       bool selectionOnly,
+                       double t0,
+                       double t1,
+                       MixerSpec *mixerSpec,
+                       int subformat)
+{
+   const double rate = project->GetRate();
+   const TrackList *tracks = project->GetTracks();
+
+   auto stream = OpenStream(fName, numChannels, rate, subformat);
+   if (!stream)
+      return ProgressResult::Cancelled;
+
+   const size_t maxBlockLen = 44100 * 5;
+
+   const WaveTrackConstArray waveTracks =
+      tracks->GetWaveTrackConstArray(selectionOnly, false);
+   auto mixer = CreatePipelinedMixer(waveTracks,
+                            t0, t1,
+                            numChannels, maxBlockLen, true,
+                            rate, floatSample, true, mixerSpec);
+
+   InitProgress( pDialog, wxFileName(fName).GetName(),
+      selectionOnly
+         ? _("Exporting the selected audio as Ogg Vorbis")
+         : _("Exporting the audio as Ogg Vorbis") );
+
+   auto updateResult = ProgressResult::Success;
+   while (updateResult == ProgressResult::Success) {
+      const auto numSamples = mixer->Process();
+      if (numSamples == 0)
+         break;
+
+      if (!stream->Write(mixer->GetBuffer(), numSamples)) {
+         AudacityMessageBox(stream->GetWriteError());
+         return ProgressResult::Cancelled;
+      }
+
+      updateResult = pDialog->Update(
+         mixer->GetSamplesDone().as_double() / rate, t1 - t0);
+   }
+
+   if (updateResult == ProgressResult::Success ||
+       updateResult == ProgressResult::Stopped) {
+      if (!stream->Close()) {
+         AudacityMessageBox(stream->GetWriteError());
+         return ProgressResult::Cancelled;
+      }
+   }
+
+   return updateResult;
+}
+
+movable_ptr<ExportPlugin> New_ExportOGG()
+{
+   return make_movable<ExportOGG>();
+}
+
+#endif // USE_LIBVORBIS
@@ -25,6 +25,13 @@
 
 #include "sndfile.h"
 
+#if !defined(__WXMSW__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../CrossFade.h"
+#include "../Envelope.h"
 #include "../FileFormats.h"
 #include "../Internat.h"
 #include "../MemoryX.h"
@@ -33,8 +40,11 @@
 #include "../Project.h"
 #include "../ShuttleGui.h"
 #include "../Track.h"
+#include "../WaveClip.h"
+#include "../WaveTrack.h"
 #include "../ondemand/ODManager.h"
 #include "../widgets/ErrorDialog.h"
+#include "../widgets/ProgressDialog.h"
 
 #include "Export.h"
 
@@ -73,6 +83,40 @@ static void WriteExportFormatPref(int format)
    gPrefs->Flush();
 }
 
+// Mix about a second at a time, but not more than this many bytes of
+// floats for all the channels, nor less than a few disk blocks
+static size_t ExportBlockLen(double rate, unsigned numChannels)
+{
+   const size_t kMaxBlockBytes = 4 * 1024 * 1024;
+   const size_t kMinBlockLen = 4096;
+   const size_t byBytes =
+      kMaxBlockBytes / (sizeof(float) * std::max(1u, numChannels));
+   return std::max(kMinBlockLen,
+      std::min(byBytes, size_t(std::max(0.0, rate))));
+}
+
+// Bytes of each sample of an uncompressed subtype, or 0 if the length of
+// the file cannot be told in advance
+static size_t SubtypeBytes(int format)
+{
+   switch (format & SF_FORMAT_SUBMASK) {
+   case SF_FORMAT_PCM_S8:
+   case SF_FORMAT_PCM_U8:
+      return 1;
+   case SF_FORMAT_PCM_16:
+      return 2;
+   case SF_FORMAT_PCM_24:
+      return 3;
+   case SF_FORMAT_PCM_32:
+   case SF_FORMAT_FLOAT:
+      return 4;
+   case SF_FORMAT_DOUBLE:
+      return 8;
+   default:
+      return 0;
+   }
+}
+
 //----------------------------------------------------------------------------
 // ExportPCMOptions Class
 //----------------------------------------------------------------------------
@@ -296,6 +340,347 @@ bool ExportPCMOptions::ValidatePair(int format)
 // ExportPCM Class
 //----------------------------------------------------------------------------
 
+#if !defined(__WXMSW__)
+
+/// The file of an export with /FileFormats/ExportDirectIO set, which
+/// libsndfile writes through its virtual I/O.  The writes go to the disk in
+/// large buffers at page aligned offsets, into space allocated in advance
+/// for the expected length.  The pages written are then dropped from the
+/// system's cache, so that a long export does not evict the block files of
+/// the project.
+///
+/// The buffer is not given to O_DIRECT, which would also need aligned
+/// lengths and offsets for the small rewrites of the header at the end.
+class PCMDirectFile final
+{
+public:
+   // A multiple of the page size
+   static const size_t kBufferSize = 8 * 1024 * 1024;
+
+   static SF_VIRTUAL_IO sIO;
+
+   /// @param expected the expected length in bytes, or 0 if not known
+   PCMDirectFile(int fd, sf_count_t expected)
+      : mFd{ fd }
+      , mBuffer{ kBufferSize }
+   {
+#if defined(__linux__)
+      if (expected > 0)
+         // Failure only loses the preallocation
+         posix_fallocate(mFd, 0, expected);
+#elif defined(__WXMAC__)
+      fcntl(mFd, F_NOCACHE, 1);
+      (void)expected;
+#else
+      (void)expected;
+#endif
+   }
+
+   ~PCMDirectFile()
+   {
+      Finish();
+   }
+
+   PCMDirectFile(const PCMDirectFile&) PROHIBITED;
+   PCMDirectFile &operator= (const PCMDirectFile&) PROHIBITED;
+
+   /// Write what remains, and cut the file to its length.  Call it after
+   /// libsndfile closes the file.
+   bool Finish()
+   {
+      if (!mFinished) {
+         mFinished = true;
+         Flush();
+         DropCache(mLength, true);
+         if (ftruncate(mFd, mLength) != 0)
+            mFailed = true;
+      }
+      return !mFailed;
+   }
+
+private:
+   static sf_count_t GetFileLen(void *user)
+   {
+      return static_cast<PCMDirectFile*>(user)->mLength;
+   }
+
+   static sf_count_t Seek(sf_count_t offset, int whence, void *user)
+   {
+      auto &file = *static_cast<PCMDirectFile*>(user);
+      switch (whence) {
+      case SEEK_SET:
+         break;
+      case SEEK_CUR:
+         offset += file.mPos;
+         break;
+      case SEEK_END:
+         offset += file.mLength;
+         break;
+      default:
+         return -1;
+      }
+      if (offset < 0)
+         return -1;
+      return file.mPos = offset;
+   }
+
+   static sf_count_t Read(void *ptr, sf_count_t count, void *user)
+   {
+      auto &file = *static_cast<PCMDirectFile*>(user);
+      if (!file.Flush())
+         return 0;
+      const auto result = pread(file.mFd, ptr, count, file.mPos);
+      if (result <= 0)
+         return 0;
+      file.mPos += result;
+      return result;
+   }
+
+   static sf_count_t Write(const void *ptr, sf_count_t count, void *user)
+   {
+      auto &file = *static_cast<PCMDirectFile*>(user);
+      auto src = static_cast<const char *>(ptr);
+
+      // A write elsewhere, as of the header, starts another buffer
+      if (file.mPos != file.mBufferStart + (sf_count_t)file.mBufferLen) {
+         if (!file.Flush())
+            return 0;
+         file.mBufferStart = file.mPos;
+      }
+
+      sf_count_t written = 0;
+      while (written < count) {
+         const auto len = std::min<sf_count_t>(
+            count - written, kBufferSize - file.mBufferLen);
+         memcpy(file.mBuffer.get() + file.mBufferLen, src + written, len);
+         file.mBufferLen += len;
+         written += len;
+         if (file.mBufferLen == kBufferSize && !file.Flush())
+            break;
+      }
+      file.mPos += written;
+      file.mLength = std::max(file.mLength, file.mPos);
+      return written;
+   }
+
+   static sf_count_t Tell(void *user)
+   {
+      return static_cast<PCMDirectFile*>(user)->mPos;
+   }
+
+   // Write the buffer, and start the next where it ended
+   bool Flush()
+   {
+      size_t done = 0;
+      while (!mFailed && done < mBufferLen) {
+         const auto result = pwrite(mFd, mBuffer.get() + done,
+            mBufferLen - done, mBufferStart + done);
+         if (result <= 0)
+            mFailed = true;
+         else
+            done += result;
+      }
+      if (mFailed)
+         return false;
+
+      mBufferStart += mBufferLen;
+      mBufferLen = 0;
+      DropCache(mBufferStart, false);
+      return true;
+   }
+
+   // Start writing back the pages up to end, and drop those that were
+   // written back before, or all of them if wait
+   void DropCache(sf_count_t end, bool wait)
+   {
+#if defined(__linux__)
+      if (end <= mDropped)
+         return;
+      if (end > mWritten)
+         sync_file_range(mFd, mWritten, end - mWritten,
+                         SYNC_FILE_RANGE_WRITE);
+      // The pages of the previous flush are likely on the disk by now
+      const auto drop = wait ? end : mWritten;
+      if (drop > mDropped) {
+         sync_file_range(mFd, mDropped, drop - mDropped,
+            SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+            SYNC_FILE_RANGE_WAIT_AFTER);
+         posix_fadvise(mFd, mDropped, drop - mDropped, POSIX_FADV_DONTNEED);
+         mDropped = drop;
+      }
+      mWritten = std::max(mWritten, end);
+#else
+      (void)end;
+      (void)wait;
+#endif
+   }
+
+   const int mFd;
+   ArrayOf<char> mBuffer;
+   sf_count_t mBufferStart { 0 };
+   size_t mBufferLen { 0 };
+   sf_count_t mPos { 0 };
+   sf_count_t mLength { 0 };
+   // Pages before these were given to writeback, and dropped
+   sf_count_t mWritten { 0 };
+   sf_count_t mDropped { 0 };
+   bool mFailed { false };
+   bool mFinished { false };
+};
+
+SF_VIRTUAL_IO PCMDirectFile::sIO = {
+   PCMDirectFile::GetFileLen,
+   PCMDirectFile::Seek,
+   PCMDirectFile::Read,
+   PCMDirectFile::Write,
+   PCMDirectFile::Tell,
+};
+
+#endif
+
+// Whether the tracks would mix to just their own samples, so that they
+// may be copied instead: one mono track to one channel, or a stereo pair
+// to two, at the rate of the export and without loss of format, with
+// nothing of pan, envelope or crossfade to apply
+static bool CanCopySamples(const WaveTrackConstArray &tracks,
+                           unsigned numChannels, double rate,
+                           sampleFormat format, double t0, double t1,
+                           const MixerSpec *mixerSpec)
+{
+   if (mixerSpec || tracks.size() != numChannels)
+      return false;
+   if (numChannels == 1) {
+      if (tracks[0]->GetChannel() != Track::MonoChannel)
+         return false;
+   }
+   else if (numChannels != 2 ||
+            tracks[0]->GetChannel() != Track::LeftChannel ||
+            tracks[1]->GetChannel() != Track::RightChannel)
+      return false;
+
+   bool crossfade = true;
+   double crossfadeMs = 10.0;
+   gPrefs->Read(wxT("/AudioIO/CrossfadeClips"), &crossfade, true);
+   gPrefs->Read(wxT("/AudioIO/CrossfadeClipsMs"), &crossfadeMs, 10.0);
+
+   for (const auto &track : tracks) {
+      // Conversion to float is exact; to int16, it wants dither
+      if (track->GetRate() != rate || track->GetPan() != 0.0f ||
+          (format != floatSample && track->GetSampleFormat() != format))
+         return false;
+      for (const auto &clip : track->GetClips())
+         if (!clip->GetEnvelope()->IsUnity())
+            return false;
+      if (crossfade) {
+         CrossFader fader;
+         fader.SetTrack(track.get(),
+            (size_t)std::max(0.0, rate * crossfadeMs / 1000.0));
+         const auto start = track->TimeToLongSamples(t0);
+         const auto end = track->TimeToLongSamples(t1);
+         if (end > start && fader.Overlaps(start, (end - start).as_size_t()))
+            return false;
+      }
+   }
+   return true;
+}
+
+// Export by reading the samples of the tracks straight from their blocks,
+// with silence between the clips, and interleaving them
+static ProgressResult CopySamplesTo(ExportStream &stream,
+                                    const WaveTrackConstArray &tracks,
+                                    double rate, double t0, double t1,
+                                    size_t maxBlockLen,
+                                    ProgressDialog &progress)
+{
+   const auto format = stream.GetFormat();
+   const auto numChannels = tracks.size();
+   const auto start = tracks[0]->TimeToLongSamples(t0);
+   const auto end = tracks[0]->TimeToLongSamples(t1);
+
+   SampleBuffer channel(maxBlockLen, format);
+   SampleBuffer interleaved;
+   if (numChannels > 1)
+      interleaved.Allocate(maxBlockLen * numChannels, format);
+
+   auto updateResult = ProgressResult::Success;
+   for (auto pos = start; pos < end &&
+        updateResult == ProgressResult::Success;) {
+      const auto len = limitSampleBufferSize(maxBlockLen, end - pos);
+      samplePtr buffer;
+      if (numChannels == 1) {
+         tracks[0]->Get(channel.ptr(), format, pos, len);
+         buffer = channel.ptr();
+      }
+      else {
+         for (size_t c = 0; c < numChannels; ++c) {
+            tracks[c]->Get(channel.ptr(), format, pos, len);
+            CopySamplesNoDither(channel.ptr(), format,
+               interleaved.ptr() + c * SAMPLE_SIZE(format), format,
+               len, 1, numChannels);
+         }
+         buffer = interleaved.ptr();
+      }
+
+      if (!stream.Write(buffer, len)) {
+         AudacityMessageBox(stream.GetWriteError());
+         return ProgressResult::Cancelled;
+      }
+
+      pos += len;
+      updateResult = progress.Update((pos - start).as_double() / rate, t1 - t0);
+   }
+   return updateResult;
+}
+
+/// The samples of an export, into a file that libsndfile writes
+class PCMExportStream final : public ExportStream
+{
+public:
+   sampleFormat GetFormat() const override { return mFormat; }
+
+   bool Write(samplePtr buffer, size_t len) override
+   {
+      sf_count_t samplesWritten;
+      if (mFormat == int16Sample)
+         samplesWritten = SFCall<sf_count_t>(sf_writef_short, mSF.get(), (short *)buffer, len);
+      else
+         samplesWritten = SFCall<sf_count_t>(sf_writef_float, mSF.get(), (float *)buffer, len);
+      return static_cast<size_t>(samplesWritten) == len;
+   }
+
+   bool Close() override
+   {
+      bool result = 0 == mSF.close();
+#if !defined(__WXMSW__)
+      if (mDirect)
+         result = mDirect->Finish() && result;
+#endif
+      return result;
+   }
+
+   wxString GetWriteError() const override
+   {
+      char buffer2[1000];
+      sf_error_str(mSF.get(), buffer2, 1000);
+      return wxString::Format(
+         /* i18n-hint: %s will be the error message from libsndfile, which
+          * is usually something unhelpful (and untranslated) like "system
+          * error" */
+         _("Error while writing %s file (disk full?).\nLibsndfile says \"%s\""),
+         mFormatStr,
+         wxString::FromAscii(buffer2));
+   }
+
+   wxFile mFile;   // will be closed when the stream is destroyed
+#if !defined(__WXMSW__)
+   // Writes mFile for mSF, if not null
+   std::unique_ptr<PCMDirectFile> mDirect;
+#endif
+   SFFile mSF;     // wraps mFile, or mDirect
+   wxString mFormatStr;
+   sampleFormat mFormat;
+};
+
 class ExportPCM final : public ExportPlugin
 {
 public:
@@ -314,9 +699,16 @@ public:
                double t1,
                MixerSpec *mixerSpec = NULL,
                int subformat = 0) override;
+   std::unique_ptr<ExportStream> OpenStream(const wxString &fName,
+               unsigned channels, double rate, int subformat) override;
    // optional
    wxString GetExtension(int index);
    bool CheckFileName(wxFileName &filename, int format) override;
+
+private:
+   // Shows the error, and returns null, if it fails
+   std::unique_ptr<PCMExportStream> OpenPCMStream(const wxString &fName,
+               unsigned channels, double rate, double duration, int subformat);
 };
 
 ExportPCM::ExportPCM()
@@ -368,18 +760,10 @@ ExportPCM::ExportPCM()
  * @param subformat Control whether we are doing a "preset" export to a popular
  * file type, or giving the user full control over libsndfile.
  */
-ProgressResult ExportPCM::Export(AudacityProject *project,
-                       std::unique_ptr<ProgressDialog> &pDialog,
-                       unsigned numChannels,
-                       const wxString &fName,
-                       bool selectionOnly,
-                       double t0,
-                       double t1,
-                       MixerSpec *mixerSpec,
-                       int subformat)
+std::unique_ptr<PCMExportStream> ExportPCM::OpenPCMStream(
+                       const wxString &fName, unsigned numChannels,
+                       double rate, double duration, int subformat)
 {
-   double       rate = project->GetRate();
-   const TrackList   *tracks = project->GetTracks();
    int sf_format;
 
    if (subformat < 0 || static_cast<unsigned int>(subformat) >= WXSIZEOF(kFormats))
@@ -391,109 +775,141 @@ ProgressResult ExportPCM::Export(AudacityProject *project,
       sf_format = kFormats[subformat].format;
    }
 
-   auto updateResult = ProgressResult::Success;
-   {
-      wxFile f;   // will be closed when it goes out of scope
-      SFFile       sf; // wraps f
-
-      wxString     formatStr;
-      SF_INFO      info;
-      //int          err;
-
-      //This whole operation should not occur while a file is being loaded on OD,
-      //(we are worried about reading from a file being written to,) so we block.
-      //Furthermore, we need to do this because libsndfile is not threadsafe.
-      formatStr = SFCall<wxString>(sf_header_name, sf_format & SF_FORMAT_TYPEMASK);
-
-      // Use libsndfile to export file
-
-      info.samplerate = (unsigned int)(rate + 0.5);
-      info.frames = (unsigned int)((t1 - t0)*rate + 0.5);
-      info.channels = numChannels;
-      info.format = sf_format;
-      info.sections = 1;
-      info.seekable = 0;
-
-      // If we can't export exactly the format they requested,
-      // try the default format for that header type...
-      if (!sf_format_check(&info))
-         info.format = (info.format & SF_FORMAT_TYPEMASK);
-      if (!sf_format_check(&info)) {
-         AudacityMessageBox(_("Cannot export audio in this format."));
-         return ProgressResult::Cancelled;
-      }
+   auto stream = std::make_unique<PCMExportStream>();
+   SF_INFO      info;
+
+   //This whole operation should not occur while a file is being loaded on OD,
+   //(we are worried about reading from a file being written to,) so we block.
+   //Furthermore, we need to do this because libsndfile is not threadsafe.
+   stream->mFormatStr = SFCall<wxString>(sf_header_name, sf_format & SF_FORMAT_TYPEMASK);
+
+   // Use libsndfile to export file
+
+   info.samplerate = (unsigned int)(rate + 0.5);
+   info.frames = (unsigned int)(duration*rate + 0.5);
+   info.channels = numChannels;
+   info.format = sf_format;
+   info.sections = 1;
+   info.seekable = 0;
+
+   // If we can't export exactly the format they requested,
+   // try the default format for that header type...
+   if (!sf_format_check(&info))
+      info.format = (info.format & SF_FORMAT_TYPEMASK);
+   if (!sf_format_check(&info)) {
+      AudacityMessageBox(_("Cannot export audio in this format."));
+      return {};
+   }
 
-      if (f.Open(fName, wxFile::write)) {
-         // Even though there is an sf_open() that takes a filename, use the one that
-         // takes a file descriptor since wxWidgets can open a file with a Unicode name and
-         // libsndfile can't (under Windows).
-         sf.reset(SFCall<SNDFILE*>(sf_open_fd, f.fd(), SFM_WRITE, &info, FALSE));
-         //add clipping for integer formats.  We allow floats to clip.
-         sf_command(sf.get(), SFC_SET_CLIPPING, NULL, sf_subtype_is_integer(sf_format)?SF_TRUE:SF_FALSE) ;
+   if (stream->mFile.Open(fName, wxFile::write)) {
+      // Even though there is an sf_open() that takes a filename, use the one that
+      // takes a file descriptor since wxWidgets can open a file with a Unicode name and
+      // libsndfile can't (under Windows).
+#if !defined(__WXMSW__)
+      if (gPrefs->Read(wxT("/FileFormats/ExportDirectIO"), 0L) != 0) {
+         // Allow for the header, which is usually much less
+         const sf_count_t expected = SubtypeBytes(info.format) > 0
+            ? info.frames * info.channels * SubtypeBytes(info.format) + 65536
+            : 0;
+         stream->mDirect =
+            std::make_unique<PCMDirectFile>(stream->mFile.fd(), expected);
+         stream->mSF.reset(SFCall<SNDFILE*>(sf_open_virtual,
+            &PCMDirectFile::sIO, SFM_WRITE, &info, stream->mDirect.get()));
       }
+      else
+#endif
+      stream->mSF.reset(SFCall<SNDFILE*>(sf_open_fd, stream->mFile.fd(), SFM_WRITE, &info, FALSE));
+      //add clipping for integer formats.  We allow floats to clip.
+      sf_command(stream->mSF.get(), SFC_SET_CLIPPING, NULL, sf_subtype_is_integer(sf_format)?SF_TRUE:SF_FALSE) ;
+   }
+
+   if (!stream->mSF) {
+      AudacityMessageBox(wxString::Format(_("Cannot export audio to %s"),
+                                    fName));
+      return {};
+   }
+
+   if (sf_subtype_more_than_16_bits(info.format))
+      stream->mFormat = floatSample;
+   else
+      stream->mFormat = int16Sample;
+
+   return stream;
+}
+
+std::unique_ptr<ExportStream> ExportPCM::OpenStream(const wxString &fName,
+                       unsigned channels, double rate, int subformat)
+{
+   // The length goes in the header when the file is closed
+   return OpenPCMStream(fName, channels, rate, 0, subformat);
+}
 
-      if (!sf) {
-         AudacityMessageBox(wxString::Format(_("Cannot export audio to %s"),
-                                       fName));
+ProgressResult ExportPCM::Export(AudacityProject *project,
+                       std::unique_ptr<ProgressDialog> &pDialog,
+                       unsigned numChannels,
+                       const wxString &fName,
+                       bool selectionOnly,
+                       double t0,
+                       double t1,
+                       MixerSpec *mixerSpec,
+                       int subformat)
+{
+   double       rate = project->GetRate();
+   const TrackList   *tracks = project->GetTracks();
+
+   auto updateResult = ProgressResult::Success;
+   {
+      auto stream = OpenPCMStream(fName, numChannels, rate, t1 - t0, subformat);
+      if (!stream)
          return ProgressResult::Cancelled;
-      }
 
-      sampleFormat format;
-      if (sf_subtype_more_than_16_bits(info.format))
-         format = floatSample;
-      else
-         format = int16Sample;
+      const auto format = stream->GetFormat();
+      const auto &formatStr = stream->mFormatStr;
 
-      size_t maxBlockLen = 44100 * 5;
+      const size_t maxBlockLen = ExportBlockLen(rate, numChannels);
 
       const WaveTrackConstArray waveTracks =
       tracks->GetWaveTrackConstArray(selectionOnly, false);
-      {
-         wxASSERT(info.channels >= 0);
-         auto mixer = CreateMixer(waveTracks,
+
+      InitProgress( pDialog, wxFileName(fName).GetName(),
+         selectionOnly
+            ? wxString::Format(_("Exporting the selected audio as %s"),
+               formatStr)
+            : wxString::Format(_("Exporting the audio as %s"),
+               formatStr) );
+
+      if (CanCopySamples(waveTracks, numChannels, rate, format, t0, t1,
+                         mixerSpec))
+         updateResult = CopySamplesTo(*stream, waveTracks, rate, t0, t1,
+                                      maxBlockLen, *pDialog);
+      else {
+         auto mixer = CreatePipelinedMixer(waveTracks,
                                   t0, t1,
-                                  info.channels, maxBlockLen, true,
+                                  numChannels, maxBlockLen, true,
                                   rate, format, true, mixerSpec);
 
-         InitProgress( pDialog, wxFileName(fName).GetName(),
-            selectionOnly
-               ? wxString::Format(_("Exporting the selected audio as %s"),
-                  formatStr)
-               : wxString::Format(_("Exporting the audio as %s"),
-                  formatStr) );
          while (updateResult == ProgressResult::Success) {
-            sf_count_t samplesWritten;
-            size_t numSamples = mixer->Process(maxBlockLen);
+            size_t numSamples = mixer->Process();
 
             if (numSamples == 0)
                break;
 
             samplePtr mixed = mixer->GetBuffer();
 
-            if (format == int16Sample)
-               samplesWritten = SFCall<sf_count_t>(sf_writef_short, sf.get(), (short *)mixed, numSamples);
-            else
-               samplesWritten = SFCall<sf_count_t>(sf_writef_float, sf.get(), (float *)mixed, numSamples);
-
-            if (static_cast<size_t>(samplesWritten) != numSamples) {
-               char buffer2[1000];
-               sf_error_str(sf.get(), buffer2, 1000);
-               AudacityMessageBox(wxString::Format(
-                                             /* i18n-hint: %s will be the error message from libsndfile, which
-                                              * is usually something unhelpful (and untranslated) like "system
-                                              * error" */
-                                             _("Error while writing %s file (disk full?).\nLibsndfile says \"%s\""),
-                                             formatStr,
-                                             wxString::FromAscii(buffer2)));
+            if (!stream->Write(mixed, numSamples)) {
+               AudacityMessageBox(stream->GetWriteError());
                updateResult = ProgressResult::Cancelled;
                break;
             }
+
+            updateResult = pDialog->Update(
+               mixer->GetSamplesDone().as_double() / rate, t1 - t0);
          }
       }
       
       // Install the WAV metata in a "LIST" chunk at the end of the file
       if (updateResult == ProgressResult::Success || updateResult == ProgressResult::Stopped) {
-         if (0 != sf.close()) {
+         if (!stream->Close()) {
             // TODO: more precise message
             AudacityMessageBox(_("Unable to export"));
             return ProgressResult::Cancelled;
@@ -39,6 +39,7 @@ and ImportLOF.cpp.
 #include "Import.h"
 
 #include <algorithm>
+#include <string.h>
 #include "ImportPlugin.h"
 
 #include <wx/textctrl.h>
@@ -47,6 +48,9 @@ and ImportLOF.cpp.
 #include <wx/log.h>
 #include <wx/sizer.h>         //for wxBoxSizer
 #include <wx/listimpl.cpp>
+#include <wx/thread.h>
+#include <wx/utils.h>
+#include <wx/ffile.h>
 #include "../ShuttleGui.h"
 #include "../Project.h"
 
@@ -58,7 +62,10 @@ and ImportLOF.cpp.
 #include "ImportLOF.h"
 #include "ImportFLAC.h"
 #include "ImportFFmpeg.h"
+#include "../AudacityException.h"
+#include "../MixerPool.h"
 #include "../Prefs.h"
+#include "../ondemand/ODManager.h"
 
 // ============================================================================
 //
@@ -332,24 +339,105 @@ bool Importer::IsMidi(const wxString &fName)
       extension.IsSameAs(wxT("mid"), false);
 }
 
-// returns number of tracks imported
-bool Importer::Import(const wxString &fName,
-                     TrackFactory *trackFactory,
-                     TrackHolders &tracks,
-                     wxString &errorMessage)
+namespace {
+
+// The magic numbers of formats with importers of their own.  Where the
+// second is given, both must match.
+struct FileSignature
 {
-   AudacityProject *pProj = GetActiveProject();
-   auto cleanup = valueRestorer( pProj->mbBusyImporting, true );
+   const wxChar *pluginID;
+   size_t offset1;
+   const char *magic1;
+   size_t offset2;
+   const char *magic2;
+};
+
+const FileSignature sFileSignatures[] = {
+   { wxT("libsndfile"),   0, "RIFF",  8, "WAVE" },
+   { wxT("libsndfile"),   0, "RIFX",  8, "WAVE" },
+   { wxT("libsndfile"),   0, "RF64",  8, "WAVE" },
+   { wxT("libsndfile"),   0, "FORM",  8, "AIFF" },
+   { wxT("libsndfile"),   0, "FORM",  8, "AIFC" },
+   { wxT("libsndfile"),   0, "caff",  0, nullptr },
+   { wxT("libsndfile"),   0, ".snd",  0, nullptr },
+   { wxT("libflac"),      0, "fLaC",  0, nullptr },
+   { wxT("liboggvorbis"), 0, "OggS", 28, "\x01vorbis" },
+};
+
+bool MatchesMagic(const unsigned char *header, size_t len,
+                  size_t offset, const char *magic)
+{
+   if (!magic)
+      return true;
+   const auto magicLen = strlen(magic);
+   return offset + magicLen <= len &&
+      0 == memcmp(header + offset, magic, magicLen);
+}
 
-   wxString extension = fName.AfterLast(wxT('.'));
+// An MPEG audio frame header of layer I, II or III; AAC in ADTS, with
+// its layer bits clear, does not match
+bool IsMPEGAudioSync(const unsigned char *header, size_t len)
+{
+   return len >= 4 &&
+      header[0] == 0xFF && (header[1] & 0xE0) == 0xE0 &&
+      ((header[1] >> 1) & 0x03) != 0 &&
+      (header[2] & 0xF0) != 0xF0 && (header[2] & 0x0C) != 0x0C;
+}
 
-   using ImportPluginPtrs = std::vector< ImportPlugin* >;
+}
 
-   // This list is used to call plugins in correct order
-   ImportPluginPtrs importPlugins;
+ImportPlugin *Importer::SniffImportPlugin(const wxString &fName)
+{
+   wxFFile file;
+   {
+      // Unreadable files are for the plugins to report
+      wxLogNull nolog;
+      if (!file.Open(fName, wxT("rb")))
+         return nullptr;
+   }
 
-   // This list is used to remember plugins that should have been compatible with the file.
-   ImportPluginPtrs compatiblePlugins;
+   unsigned char header[64];
+   auto len = file.Read(header, sizeof(header));
+
+   // An ID3v2 tag may come before MPEG audio, and before FLAC; look past it
+   bool tagged = false;
+   if (len >= 10 && 0 == memcmp(header, "ID3", 3)) {
+      tagged = true;
+      const wxFileOffset tagLen = 10 +
+         (((header[6] & 0x7F) << 21) | ((header[7] & 0x7F) << 14) |
+          ((header[8] & 0x7F) << 7) | (header[9] & 0x7F));
+      len = file.Seek(tagLen) ? file.Read(header, sizeof(header)) : 0;
+   }
+
+   // A frame sync alone may be chance, and libmad must not be a fallback
+   // for other formats, so it needs the tag or the extension as well
+   wxString pluginID;
+   if (IsMPEGAudioSync(header, len))
+      pluginID = wxT("libmad");
+   else for (const auto &signature : sFileSignatures) {
+      if (MatchesMagic(header, len, signature.offset1, signature.magic1) &&
+          MatchesMagic(header, len, signature.offset2, signature.magic2)) {
+         pluginID = signature.pluginID;
+         break;
+      }
+   }
+
+   for (const auto &plugin : mImportPluginList)
+      if (plugin->GetPluginStringID().IsSameAs(pluginID)) {
+         if (pluginID == wxT("libmad") && !tagged &&
+             !plugin->SupportsExtension(fName.AfterLast(wxT('.'))))
+            return nullptr;
+         return plugin.get();
+      }
+
+   return nullptr;
+}
+
+Importer::ImportPluginPtrs Importer::GetImportPlugins(const wxString &fName)
+{
+   wxString extension = fName.AfterLast(wxT('.'));
+
+   ImportPluginPtrs importPlugins;
 
    // If user explicitly selected a filter,
    // then we should try importing via corresponding plugin first
@@ -435,6 +523,19 @@ bool Importer::Import(const wxString &fName,
       }
    }
 
+   // Then the plugin that the contents of the file call for, so that a
+   // misnamed or unknown file is not opened first by libraries that
+   // cannot read it
+   if (auto plugin = SniffImportPlugin(fName))
+   {
+      if (importPlugins.end() ==
+          std::find(importPlugins.begin(), importPlugins.end(), plugin))
+      {
+         wxLogDebug(wxT("Appending %s by the file header"),plugin->GetPluginStringID());
+         importPlugins.push_back(plugin);
+      }
+   }
+
    // Add all plugins that support the extension
 
    // Here we rely on the fact that the first plugin in mImportPluginList is libsndfile.
@@ -496,6 +597,26 @@ bool Importer::Import(const wxString &fName,
       }
    }
 
+   return importPlugins;
+}
+
+// returns number of tracks imported
+bool Importer::Import(const wxString &fName,
+                     TrackFactory *trackFactory,
+                     TrackHolders &tracks,
+                     wxString &errorMessage)
+{
+   AudacityProject *pProj = GetActiveProject();
+   auto cleanup = valueRestorer( pProj->mbBusyImporting, true );
+
+   wxString extension = fName.AfterLast(wxT('.'));
+
+   // This list is used to call plugins in correct order
+   const auto importPlugins = GetImportPlugins(fName);
+
+   // This list is used to remember plugins that should have been compatible with the file.
+   ImportPluginPtrs compatiblePlugins;
+
    // Try the import plugins, in the permuted sequences just determined
    for (const auto plugin : importPlugins)
    {
@@ -665,6 +786,129 @@ bool Importer::Import(const wxString &fName,
    return false;
 }
 
+bool Importer::OpenForBatch(BatchItem &item)
+{
+   const auto &fName = item.fileName;
+   for (const auto plugin : GetImportPlugins(fName))
+   {
+      auto inFile = plugin->Open(fName);
+      if ( (inFile == NULL) || (inFile->GetStreamCount() == 0) )
+         continue;
+
+      // The stream selector, and formats whose importers use the GUI,
+      // are for Import() on this thread
+      if (inFile->GetStreamCount() > 1 || !inFile->CanImportConcurrently())
+         return false;
+
+      wxLogMessage(wxT("Opened %s for a batch with %s"),
+                   fName, plugin->GetPluginStringID());
+      inFile->SetStreamUsage(0,TRUE);
+      if (inFile->PrepareImport() != ProgressResult::Success)
+      {
+         item.result = ProgressResult::Cancelled;
+         return false;
+      }
+
+      inFile->SetBatchProgress(&item.progress);
+      item.handle = std::move(inFile);
+      return true;
+   }
+
+   return false;
+}
+
+namespace {
+
+// Runs the imports of a batch on a pool of threads, so that the main thread
+// is free for the progress dialog
+class ImportBatchThread final : public wxThread
+{
+public:
+   using Items = std::vector< Importer::BatchItem* >;
+
+   ImportBatchThread(const Items &items, TrackFactory *trackFactory)
+      : wxThread{ wxTHREAD_JOINABLE }
+      , mItems{ items }, mTrackFactory{ trackFactory }
+   {}
+
+   // Also called on the main thread, if no thread could start
+   void ImportAll()
+   {
+      const auto nThreads = std::max(1, wxThread::GetCPUCount());
+      MixerPool pool{
+         unsigned(std::min<size_t>(nThreads, mItems.size()) - 1) };
+      pool.Run(mItems.size(), [&](size_t ii) {
+         auto &item = *mItems[ii];
+         // Exceptions must not escape the helper threads; the message of
+         // one is shown later, on the main thread
+         item.result = GuardedCall< ProgressResult >( [&] {
+            return item.handle->Import(mTrackFactory, item.tracks);
+         }, MakeSimpleGuard( ProgressResult::Failed ) );
+      });
+      mDone = true;
+   }
+
+   bool IsDone() const { return mDone; }
+
+protected:
+   ExitCode Entry() override
+   {
+      ImportAll();
+      return 0;
+   }
+
+private:
+   const Items &mItems;
+   TrackFactory *const mTrackFactory;
+   std::atomic<bool> mDone{ false };
+};
+
+}
+
+void Importer::ImportBatch(BatchItems &items, TrackFactory *trackFactory)
+{
+   ImportBatchThread::Items opened;
+   for (const auto &item : items)
+      if (item->handle)
+         opened.push_back(item.get());
+   if (opened.empty())
+      return;
+
+   AudacityProject *pProj = GetActiveProject();
+   auto cleanup = valueRestorer( pProj->mbBusyImporting, true );
+
+   // Importers add tasks to the ODManager; make it on this thread
+   ODManager::Instance();
+
+   ImportBatchThread thread{ opened, trackFactory };
+   if (thread.Run() != wxTHREAD_NO_ERROR) {
+      thread.ImportAll();
+      return;
+   }
+
+   {
+      ProgressDialog progress{
+         wxString::Format(_("Importing %d files"), (int)opened.size()) };
+      auto choice = ProgressResult::Success;
+      while (!thread.IsDone()) {
+         wxMilliSleep(50);
+         double done = 0;
+         for (const auto item : opened)
+            done += item->progress.fraction.load();
+         const auto result = progress.Update(done, (double)opened.size());
+         if (choice == ProgressResult::Success &&
+             result != ProgressResult::Success) {
+            // Stop or cancel all the imports at once
+            choice = result;
+            for (const auto item : opened)
+               item->progress.userChoice.store((unsigned) choice);
+         }
+      }
+   }
+
+   thread.Wait();
+}
+
 //-------------------------------------------------------------------------
 // ImportStreamDialog
 //-------------------------------------------------------------------------
@@ -13,6 +13,7 @@
 
 #include "ImportRaw.h" // defines TrackHolders
 #include "ImportForwards.h"
+#include "ImportPlugin.h" // defines ImportFileHandle, ImportProgress
 #include <vector>
 #include <wx/arrstr.h>
 #include <wx/string.h>
@@ -143,7 +144,37 @@ public:
               TrackHolders &tracks,
               wxString &errorMessage);
 
+   // One file of an ImportBatch()
+   struct BatchItem
+   {
+      wxString fileName;
+      std::unique_ptr<ImportFileHandle> handle;
+      ImportProgress progress;
+      ProgressResult result { ProgressResult::Failed };
+      TrackHolders tracks;
+   };
+   using BatchItems = std::vector< movable_ptr<BatchItem> >;
+
+   // Opens item.fileName with the first plugin that can, and asks the user
+   // on this thread whatever its import would ask.  False, unless Import()
+   // of the handle may then run concurrently; item.result becomes
+   // ProgressResult::Cancelled if the user cancelled.
+   bool OpenForBatch(BatchItem &item);
+
+   // Imports the files opened by OpenForBatch() at once, on worker threads,
+   // under one progress dialog, and sets the result and tracks of each.
+   // Failed and unrecognized files are left for Import() to report.
+   void ImportBatch(BatchItems &items, TrackFactory *trackFactory);
+
 private:
+   using ImportPluginPtrs = std::vector< ImportPlugin* >;
+
+   // The plugins to try for the file, in order
+   ImportPluginPtrs GetImportPlugins(const wxString &fName);
+
+   // The plugin that the first bytes of the file say can read it, if any
+   ImportPlugin *SniffImportPlugin(const wxString &fName);
+
    static Importer mInstance;
 
    ExtImportItems mExtImportItems;
@@ -0,0 +1,50 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ImportAppender.cpp
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+**********************************************************************/
+
+#include "../Audacity.h"
+#include "ImportAppender.h"
+
+#include "../WaveTrack.h"
+
+ImportAppender::ImportAppender(const std::vector<WaveTrack*> &tracks,
+                               sampleFormat format, size_t bufferLen)
+   : mTracks{ tracks }
+   , mFormat{ format }
+   , mBufferLen{ bufferLen }
+   , mBuffers{ tracks.size() }
+{
+   for (size_t c = 0; c < mTracks.size(); ++c)
+      mBuffers[c].Allocate(mBufferLen, mFormat);
+}
+
+ImportAppender::~ImportAppender()
+{
+}
+
+void ImportAppender::Commit(size_t len)
+{
+   wxASSERT(len <= Room());
+   mFill += len;
+   if (mFill >= mBufferLen)
+      Flush();
+}
+
+void ImportAppender::Flush()
+{
+   if (mFill == 0)
+      return;
+
+   // The staged samples are forgotten even if an append throws, as when
+   // the disk is full; the import stops then anyway
+   auto cleanup = finally( [&] { mFill = 0; } );
+   for (size_t c = 0; c < mTracks.size(); ++c)
+      mTracks[c]->Append(mBuffers[c].ptr(), mFormat, mFill);
+}
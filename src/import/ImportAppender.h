@@ -0,0 +1,72 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ImportAppender.h
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+******************************************************************//**
+
+\class ImportAppender
+\brief Stages the samples that an importer decodes, for all the
+channels of one stream, and appends them to the tracks a long run at a
+time.
+
+Decoders deliver a frame of a few hundred or thousand samples at once.
+The buffers here are made once for the whole import, so the decode
+loop allocates nothing, and the memory of the import is bounded by
+their size, whatever a decoder delivers.  An importer writes each run
+of samples, converted to the staging format, at Next() of every
+channel, and then calls Commit().
+
+*//*******************************************************************/
+
+#ifndef __AUDACITY_IMPORT_APPENDER__
+#define __AUDACITY_IMPORT_APPENDER__
+
+#include "../MemoryX.h"
+#include "../SampleFormat.h"
+
+#include <vector>
+
+class WaveTrack;
+
+class ImportAppender final
+{
+public:
+   /// Appends to the tracks in the order of the channels
+   ImportAppender(const std::vector<WaveTrack*> &tracks, sampleFormat format,
+                  size_t bufferLen = 65536);
+   ~ImportAppender();
+
+   ImportAppender(const ImportAppender&) PROHIBITED;
+   ImportAppender &operator= (const ImportAppender&) PROHIBITED;
+
+   unsigned GetChannels() const { return mTracks.size(); }
+   sampleFormat GetFormat() const { return mFormat; }
+
+   /// How many more samples of each channel may be written before Commit()
+   size_t Room() const { return mBufferLen - mFill; }
+
+   /// Where the next sample of the channel goes
+   samplePtr Next(unsigned channel) const
+   { return mBuffers[channel].ptr() + mFill * SAMPLE_SIZE(mFormat); }
+
+   /// Takes len samples, at most Room(), written at Next() of every
+   /// channel; appends them all to the tracks when the buffers are full
+   void Commit(size_t len);
+
+   /// Appends the samples staged so far; call it before flushing the tracks
+   void Flush();
+
+private:
+   const std::vector<WaveTrack*> mTracks;
+   const sampleFormat mFormat;
+   const size_t mBufferLen;
+   ArrayOf<SampleBuffer> mBuffers;
+   size_t mFill{ 0 };
+};
+
+#endif
@@ -152,9 +152,14 @@ static const wxChar *exts[] =
 };
 
 // all the includes live here by default
+#include <deque>
+#include <vector>
+#include <wx/thread.h>
 #include "Import.h"
+#include "../AudacityException.h"
 #include "../Internat.h"
 #include "../WaveTrack.h"
+#include "../ondemand/ODTaskThread.h"
 #include "ImportPlugin.h"
 
 extern FFmpegLibs *FFmpegLibsInst();
@@ -216,7 +221,20 @@ public:
 
    ///! Writes decoded data into WaveTracks. Called by DecodeFrame
    ///\param sc - stream context
-   ProgressResult WriteData(streamContext *sc);
+   void WriteData(streamContext *sc);
+
+   ///! Decodes the packet in sc->m_pkt, and writes what it gives
+   ///\param sc - stream context (from ReadNextFrame)
+   void DecodePacket(streamContext *sc);
+
+   ///! Writes the frames that the decoder still holds, at the end of the stream
+   ///\param sc - stream context
+   void FlushDecoder(streamContext *sc);
+
+   ///! Updates the progress indicator for a packet that was read
+   ///\param frameNumber - how many frames of the stream were read so far
+   ///\return the choice of the user, as for Import()
+   ProgressResult ReportProgress(streamContext *sc, const AVPacket &pkt, int64_t frameNumber);
 
    ///! Called by Import.cpp
    ///\return number of readable streams in the file
@@ -243,6 +261,11 @@ public:
 
 private:
 
+   ///! Reads the file on this thread, and decodes each stream on one of its own
+   ///\param res - the result of the import, if it returns true
+   ///\return false if the threads could not start, before anything was read
+   bool DecodeConcurrently(ProgressResult &res);
+
    std::shared_ptr<FFmpegContext> mContext; // An object that does proper IO shutdown in its destructor; may be shared with decoder task.
    AVFormatContext      *mFormatContext; //!< Format description, also contains metadata and some useful info
    int                   mNumStreams;    //!< mNumstreams is less or equal to mFormatContext->nb_streams
@@ -399,6 +422,13 @@ bool FFmpegImportFileHandle::InitCodecs()
             continue;
          }
 
+         // Let FFmpeg decode several frames at once, where the decoder can
+         if (codec->capabilities & CODEC_CAP_FRAME_THREADS)
+         {
+            sc->m_codecCtx->thread_count = 0; // one for each core
+            sc->m_codecCtx->thread_type = FF_THREAD_FRAME;
+         }
+
          if (avcodec_open2(sc->m_codecCtx, codec, NULL) < 0)
          {
             wxLogError(wxT("FFmpeg : avcodec_open() failed. Index[%02d], Codec[%02x - %s]"),i,id,name);
@@ -448,6 +478,179 @@ auto FFmpegImportFileHandle::GetFileUncompressedBytes() -> ByteCount
    return 0;
 }
 
+namespace {
+
+/// Decodes the packets of one stream into its tracks, on a thread of its
+/// own, as the thread that reads the file queues them
+class FFmpegStreamDecoder final : public wxThread
+{
+public:
+   FFmpegStreamDecoder(FFmpegImportFileHandle &handle, streamContext *sc)
+      : wxThread{ wxTHREAD_JOINABLE }, mHandle{ handle }, mSc{ sc }
+   {}
+
+   /// Waits while the queue is full; drops the packet if decoding failed
+   void Enqueue(AVPacketEx &&pkt)
+   {
+      ODLocker locker{ &mLock };
+      while (mQueue.size() >= kMaxQueued && !mFailed)
+         mTaken.Wait();
+      if (mFailed)
+         return;
+      mQueue.push_back(std::move(pkt));
+      mQueued.Signal();
+   }
+
+   /// Decodes what is queued and flushes the decoder, unless abandoning
+   /// the import, and ends the thread
+   void Finish(bool abandon)
+   {
+      {
+         ODLocker locker{ &mLock };
+         mFinishing = true;
+         mAbandoned = abandon;
+         mQueued.Signal();
+      }
+      Wait();
+   }
+
+   bool Failed() const
+   {
+      ODLocker locker{ &mLock };
+      return mFailed;
+   }
+
+protected:
+   ExitCode Entry() override
+   {
+      // Exceptions must not escape the thread; the message is shown later,
+      // on the main thread
+      const bool ok = GuardedCall< bool >( [this] {
+         Decode();
+         return true;
+      }, MakeSimpleGuard( false ) );
+
+      if (!ok) {
+         ODLocker locker{ &mLock };
+         mFailed = true;
+         mQueue.clear();
+         mTaken.Signal();
+      }
+      return 0;
+   }
+
+private:
+   // Enough to ride out the interleaving of most containers
+   static const size_t kMaxQueued = 64;
+
+   void Decode()
+   {
+      ODLocker locker{ &mLock };
+      for (;;) {
+         while (mQueue.empty() && !mFinishing)
+            mQueued.Wait();
+         if (mQueue.empty() || mAbandoned)
+            break;
+
+         mSc->m_pkt.create(std::move(mQueue.front()));
+         mQueue.pop_front();
+         mTaken.Signal();
+
+         // Decode without the lock, so that the reader queues the next
+         locker.reset();
+         mSc->m_pktDataPtr = mSc->m_pkt->data;
+         mSc->m_pktRemainingSiz = mSc->m_pkt->size;
+         mHandle.DecodePacket(mSc);
+         mSc->m_pkt.reset();
+         locker.reset(&mLock);
+      }
+
+      const bool flush = !mAbandoned;
+      locker.reset();
+      if (flush)
+         mHandle.FlushDecoder(mSc);
+   }
+
+   FFmpegImportFileHandle &mHandle;
+   streamContext *const mSc;
+
+   mutable ODLock mLock;
+   ODCondition mQueued{ &mLock };
+   ODCondition mTaken{ &mLock };
+   std::deque<AVPacketEx> mQueue;
+   bool mFinishing{ false };
+   bool mAbandoned{ false };
+   bool mFailed{ false };
+};
+
+}
+
+bool FFmpegImportFileHandle::DecodeConcurrently(ProgressResult &res)
+{
+   const auto scs = mScs->get();
+
+   std::vector< movable_ptr<FFmpegStreamDecoder> > decoders;
+   for (int s = 0; s < mNumStreams; ++s)
+   {
+      auto decoder = make_movable<FFmpegStreamDecoder>(*this, scs[s].get());
+      if (decoder->Run() != wxTHREAD_NO_ERROR)
+      {
+         // Nothing was decoded yet, so decode all of it the old way
+         for (auto &started : decoders)
+            started->Finish(true);
+         return false;
+      }
+      decoders.push_back(std::move(decoder));
+   }
+
+   {
+      auto cleanup = finally( [&] {
+         const bool abandon =
+            res == ProgressResult::Cancelled || res == ProgressResult::Failed;
+         for (auto &decoder : decoders)
+            decoder->Finish(abandon);
+      } );
+
+      // The codec contexts belong to the decoding threads now, so count the
+      // frames read here, for progress
+      std::vector<int64_t> frameNumbers(mNumStreams, 0);
+      while (res == ProgressResult::Success)
+      {
+         AVPacketEx pkt;
+         if (av_read_frame(mFormatContext, &pkt) < 0)
+            break;
+
+         int s = 0;
+         while (s < mNumStreams && scs[s]->m_stream->index != pkt.stream_index)
+            ++s;
+         // Off-stream packet, of a stream that is not imported
+         if (s == mNumStreams)
+            continue;
+
+         // The data of a packet may be the demuxer's, good only until the
+         // next read, so the decoding thread needs a copy of its own
+         if (av_dup_packet(&pkt) < 0)
+         {
+            res = ProgressResult::Failed;
+            break;
+         }
+
+         res = ReportProgress(scs[s].get(), pkt, ++frameNumbers[s]);
+         decoders[s]->Enqueue(std::move(pkt));
+
+         for (auto &decoder : decoders)
+            if (decoder->Failed())
+               res = ProgressResult::Failed;
+      }
+   }
+
+   for (auto &decoder : decoders)
+      if (decoder->Failed())
+         res = ProgressResult::Failed;
+
+   return true;
+}
+
 ProgressResult FFmpegImportFileHandle::Import(TrackFactory *trackFactory,
               TrackHolders &outTracks)
 {
@@ -554,41 +757,29 @@ ProgressResult FFmpegImportFileHandle::Import(TrackFactory *trackFactory,
    // The result of Import() to be returend. It will be something other than zero if user canceled or some error appears.
    auto res = ProgressResult::Success;
 
-   // Read next frame.
-   for (streamContext *sc; (sc = ReadNextFrame()) != NULL && (res == ProgressResult::Success);)
+   // Streams decode at once on threads of their own, but one is as well
+   // decoded here
+   if (!(mNumStreams > 1 && DecodeConcurrently(res)))
    {
-      // ReadNextFrame returns 1 if stream is not to be imported
-      if (sc != (streamContext*)1)
+      // Read next frame.
+      for (streamContext *sc; (sc = ReadNextFrame()) != NULL && (res == ProgressResult::Success);)
       {
-         // Decode frame until it is not possible to decode any further
-         while (sc->m_pktRemainingSiz > 0 && (res == ProgressResult::Success || res == ProgressResult::Stopped))
+         // ReadNextFrame returns 1 if stream is not to be imported
+         if (sc != (streamContext*)1)
          {
-            if (DecodeFrame(sc,false) < 0)
-               break;
+            DecodePacket(sc);
+            res = ReportProgress(sc, *sc->m_pkt, sc->m_codecCtx->frame_number);
 
-            // If something useable was decoded - write it to mChannels
-            if (sc->m_frameValid)
-               res = WriteData(sc);
+            // Cleanup after frame decoding
+            sc->m_pkt.reset();
          }
-
-         // Cleanup after frame decoding
-         sc->m_pkt.reset();
       }
-   }
 
-   // Flush the decoders.
-   if ((mNumStreams != 0) && (res == ProgressResult::Success || res == ProgressResult::Stopped))
-   {
-      for (int i = 0; i < mNumStreams; i++)
+      // Flush the decoders.
+      if (res == ProgressResult::Success || res == ProgressResult::Stopped)
       {
-         auto sc = scs[i].get();
-         sc->m_pkt.create();
-         if (DecodeFrame(sc, true) == 0)
-         {
-            WriteData(sc);
-
-            sc->m_pkt.reset();
-         }
+         for (int i = 0; i < mNumStreams; i++)
+            FlushDecoder(scs[i].get());
       }
    }
 
@@ -624,7 +815,31 @@ int FFmpegImportFileHandle::DecodeFrame(streamContext *sc, bool flushing)
    return import_ffmpeg_decode_frame(sc, flushing);
 }
 
-ProgressResult FFmpegImportFileHandle::WriteData(streamContext *sc)
+void FFmpegImportFileHandle::DecodePacket(streamContext *sc)
+{
+   // Decode frame until it is not possible to decode any further
+   while (sc->m_pktRemainingSiz > 0)
+   {
+      if (DecodeFrame(sc,false) < 0)
+         break;
+
+      // If something useable was decoded - write it to mChannels
+      if (sc->m_frameValid)
+         WriteData(sc);
+   }
+}
+
+void FFmpegImportFileHandle::FlushDecoder(streamContext *sc)
+{
+   // A decoder with frame threading gives one of the frames it holds for
+   // each call, so call until it gives nothing
+   sc->m_pkt.create();
+   while (DecodeFrame(sc, true) == 0 && sc->m_frameValid)
+      WriteData(sc);
+   sc->m_pkt.reset();
+}
+
+void FFmpegImportFileHandle::WriteData(streamContext *sc)
 {
    // Find the stream index in mScs array
    int streamid = -1;
@@ -641,7 +856,7 @@ ProgressResult FFmpegImportFileHandle::WriteData(streamContext *sc)
    // Stream is not found. This should not really happen
    if (streamid == -1)
    {
-      return ProgressResult::Success;
+      return;
    }
 
    // Allocate the buffer to store audio.
@@ -689,7 +904,7 @@ ProgressResult FFmpegImportFileHandle::WriteData(streamContext *sc)
 
                default:
                   wxLogError(wxT("Stream %d has unrecognized sample format %d."), streamid, sc->m_samplefmt);
-                  return ProgressResult::Success;
+                  return;
                break;
             }
          }
@@ -705,31 +920,32 @@ ProgressResult FFmpegImportFileHandle::WriteData(streamContext *sc)
    {
       iter2->get()->Append((samplePtr)tmp[chn].get(), sc->m_osamplefmt, index);
    }
+}
 
+ProgressResult FFmpegImportFileHandle::ReportProgress(streamContext *sc,
+   const AVPacket &pkt, int64_t frameNumber)
+{
    // Try to update the progress indicator (and see if user wants to cancel)
-   auto updateResult = ProgressResult::Success;
    int64_t filesize = avio_size(mFormatContext->pb);
    // PTS (presentation time) is the proper way of getting current position
-   if (sc->m_pkt->pts != int64_t(AV_NOPTS_VALUE) && mFormatContext->duration != int64_t(AV_NOPTS_VALUE))
+   if (pkt.pts != int64_t(AV_NOPTS_VALUE) && mFormatContext->duration != int64_t(AV_NOPTS_VALUE))
    {
-      mProgressPos = sc->m_pkt->pts * sc->m_stream->time_base.num / sc->m_stream->time_base.den;
+      mProgressPos = pkt.pts * sc->m_stream->time_base.num / sc->m_stream->time_base.den;
       mProgressLen = (mFormatContext->duration > 0 ? mFormatContext->duration / AV_TIME_BASE: 1);
    }
    // When PTS is not set, use number of frames and number of current frame
-   else if (sc->m_stream->nb_frames > 0 && sc->m_codecCtx->frame_number > 0 && sc->m_codecCtx->frame_number <= sc->m_stream->nb_frames)
+   else if (sc->m_stream->nb_frames > 0 && frameNumber > 0 && frameNumber <= sc->m_stream->nb_frames)
    {
-      mProgressPos = sc->m_codecCtx->frame_number;
+      mProgressPos = frameNumber;
       mProgressLen = sc->m_stream->nb_frames;
    }
    // When number of frames is unknown, use position in file
-   else if (filesize > 0 && sc->m_pkt->pos > 0 && sc->m_pkt->pos <= filesize)
+   else if (filesize > 0 && pkt.pos > 0 && pkt.pos <= filesize)
    {
-      mProgressPos = sc->m_pkt->pos;
+      mProgressPos = pkt.pos;
       mProgressLen = filesize;
    }
-   updateResult = mProgress->Update(mProgressPos, mProgressLen != 0 ? mProgressLen : 1);
-
-   return updateResult;
+   return UpdateProgress(mProgressPos, mProgressLen != 0 ? mProgressLen : 1);
 }
 
 FFmpegImportFileHandle::~FFmpegImportFileHandle()
@@ -75,9 +75,13 @@ void GetFLACImportPlugin(ImportPluginList &importPluginList,
 
 #include "FLAC++/decoder.h"
 
+#include <algorithm>
+#include <vector>
+
 #include "../FileFormats.h"
 #include "../Prefs.h"
 #include "../WaveTrack.h"
+#include "ImportAppender.h"
 #include "ImportPlugin.h"
 #include "../ondemand/ODDecodeFlacTask.h"
 #include "../ondemand/ODManager.h"
@@ -160,6 +164,8 @@ public:
    void SetStreamUsage(wxInt32 WXUNUSED(StreamID), bool WXUNUSED(Use)) override
    {}
 
+   bool CanImportConcurrently() override { return true; }
+
 private:
    sampleFormat          mFormat;
    std::unique_ptr<MyFLACFile> mFile;
@@ -172,6 +178,7 @@ private:
    bool                  mStreamInfoDone;
    ProgressResult        mUpdateResult;
    TrackHolders          mChannels;
+   std::unique_ptr<ImportAppender> mAppender;
    movable_ptr<ODDecodeFlacTask> mDecoderTask;
 };
 
@@ -247,29 +254,26 @@ FLAC__StreamDecoderWriteStatus MyFLACFile::write_callback(const FLAC__Frame *fra
 {
    // Don't let C++ exceptions propagate through libflac
    return GuardedCall< FLAC__StreamDecoderWriteStatus > ( [&] {
-      auto tmp = ArrayOf< short >{ frame->header.blocksize };
-
-      auto iter = mFile->mChannels.begin();
-      for (unsigned int chn=0; chn<mFile->mNumChannels; ++iter, ++chn) {
-         if (frame->header.bits_per_sample == 16) {
-            for (unsigned int s=0; s<frame->header.blocksize; s++) {
-               tmp[s]=buffer[chn][s];
-            }
-
-            iter->get()->Append((samplePtr)tmp.get(),
-                     int16Sample,
-                     frame->header.blocksize);
-         }
-         else {
-            iter->get()->Append((samplePtr)buffer[chn],
-                     int24Sample,
-                     frame->header.blocksize);
+      // Samples of 16 bits are staged as shorts, others as they come, in
+      // the int24Sample format
+      auto &appender = *mFile->mAppender;
+      const size_t samples = frame->header.blocksize;
+      for (size_t done = 0; done < samples;) {
+         const auto len = std::min(appender.Room(), samples - done);
+         for (unsigned int chn=0; chn<mFile->mNumChannels; ++chn) {
+            const auto src = buffer[chn] + done;
+            if (appender.GetFormat() == int16Sample)
+               std::copy(src, src + len, (short *)appender.Next(chn));
+            else
+               std::copy(src, src + len, (int *)appender.Next(chn));
          }
+         appender.Commit(len);
+         done += len;
       }
 
       mFile->mSamplesDone += frame->header.blocksize;
 
-      mFile->mUpdateResult = mFile->mProgress->Update((wxULongLong_t) mFile->mSamplesDone, mFile->mNumSamples != 0 ? (wxULongLong_t)mFile->mNumSamples : 1);
+      mFile->mUpdateResult = mFile->UpdateProgress((double) mFile->mSamplesDone, mFile->mNumSamples != 0 ? (double)mFile->mNumSamples : 1.0);
       if (mFile->mUpdateResult != ProgressResult::Success)
       {
          return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
@@ -432,6 +436,14 @@ ProgressResult FLACImportFileHandle::Import(TrackFactory *trackFactory,
       }
    }
 
+   {
+      std::vector<WaveTrack*> tracks;
+      for (const auto &channel : mChannels)
+         tracks.push_back(channel.get());
+      mAppender = std::make_unique<ImportAppender>(tracks,
+         mBitsPerSample == 16 ? int16Sample : int24Sample);
+   }
+
 
 //Start OD
    bool useOD = false;
@@ -461,9 +473,9 @@ ProgressResult FLACImportFileHandle::Import(TrackFactory *trackFactory,
          for (size_t c = 0; c < mNumChannels; ++c, ++iter)
             iter->get()->AppendCoded(mFilename, i, blockLen, c, ODTask::eODFLAC);
 
-         mUpdateResult = mProgress->Update(
-            i.as_long_long(),
-            fileTotalFrames.as_long_long()
+         mUpdateResult = UpdateProgress(
+            i.as_double(),
+            fileTotalFrames.as_double()
          );
          if (mUpdateResult != ProgressResult::Success)
             break;
@@ -491,6 +503,7 @@ ProgressResult FLACImportFileHandle::Import(TrackFactory *trackFactory,
       return mUpdateResult;
    }
 
+   mAppender->Flush();
    for (const auto &channel : mChannels) {
       channel->Flush();
    }
@@ -78,6 +78,8 @@
 #include <wx/textfile.h>
 #include <wx/tokenzr.h>
 
+#include <vector>
+
 #include "../WaveTrack.h"
 #include "ImportPlugin.h"
 #include "Import.h"
@@ -136,6 +138,8 @@ public:
 private:
    // Takes a line of text in lof file and interprets it and opens files
    void lofOpenFiles(wxString* ln);
+   // Imports the files of the current window together, and offsets them
+   void doImportFiles();
    void doDurationAndScrollOffset();
 
    std::unique_ptr<wxTextFile> mTextFile;
@@ -153,6 +157,14 @@ private:
    // In order to offset scrollbar, it must be done after files are opened
    bool              callScrollOffset{ false };
    double            scrollOffset{ 0 };
+
+   // The "file" lines since the last "window" line, imported at its end
+   struct FileLine {
+      wxString fileName;
+      bool hasOffset;
+      double offset;
+   };
+   std::vector<FileLine> mFileLines;
 };
 
 LOFImportFileHandle::LOFImportFileHandle
@@ -222,9 +234,10 @@ ProgressResult LOFImportFileHandle::Import(TrackFactory * WXUNUSED(trackFactory)
 {
    // Unlike other ImportFileHandle subclasses, this one never gives any tracks
    // back to the caller.
-   // Instead, it recursively calls AudacityProject::Import for each file listed
-   // in the .lof file.
-   // Each importation creates a NEW undo state.
+   // Instead, it calls AudacityProject::ImportBatch for the files listed
+   // for each window in the .lof file, so that they decode at once, and
+   // a file listed more than once decodes only once.
+   // Each window's importation creates a NEW undo state.
    // If there is an error or exception during one of them, only that one's
    // side effects are rolled back, and the rest of the import list is skipped.
    // The file may have "window" directives that cause NEW AudacityProjects
@@ -256,28 +269,14 @@ ProgressResult LOFImportFileHandle::Import(TrackFactory * WXUNUSED(trackFactory)
    if(!mTextFile->Close())
       return ProgressResult::Failed;
 
+   doImportFiles();
+
    // set any duration/offset factors for last window, as all files were called
    doDurationAndScrollOffset();
 
    return ProgressResult::Success;
 }
 
-static int CountNumTracks(AudacityProject *proj)
-{
-   int count = 0;
-   Track *t;
-   TrackListIterator iter(proj->GetTracks());
-
-   t = iter.First();
-
-   while(t) {
-      count++;
-      t = iter.Next();
-   }
-
-   return count;
-}
-
 /** @brief Processes a single line from a LOF text file, doing whatever is
  * indicated on the line.
  *
@@ -296,6 +295,8 @@ void LOFImportFileHandle::lofOpenFiles(wxString* ln)
 
    if (tokenholder.IsSameAs(wxT("window"), false))
    {
+      doImportFiles();
+
       // set any duration/offset factors for last window, as all files were called
       doDurationAndScrollOffset();
 
@@ -377,8 +378,8 @@ void LOFImportFileHandle::lofOpenFiles(wxString* ln)
          }
       }
 
-      // Do recursive call to import
-         mProject = AudacityProject::OpenProject( mProject );
+      // Imported with the other files of the window
+      FileLine fileLine{ targetfile, false, 0.0 };
 
       // Set tok to right after filename
       temptok2.SetString(targettoken);
@@ -401,43 +402,10 @@ void LOFImportFileHandle::lofOpenFiles(wxString* ln)
          {
             if (tok.HasMoreTokens())
                tokenholder = tok.GetNextToken();
-            double offset;
-
-            // handle an "offset" specifier
-            if (!mProject)
-               // there was an import error,
-               // presumably with its own error message
-               ;
-            else if (Internat::CompatibleToDouble(tokenholder, &offset))
-            {
-               Track *t;
-               TrackListIterator iter(mProject->GetTracks());
-
-               t = iter.First();
-
-               for (int i = 1; i < CountNumTracks(mProject) - 1; i++)
-                  t = iter.Next();
-
-               // t is now the last track in the project, unless the import of
-               // all tracks failed, in which case it will be null. In that
-               // case we return because we cannot offset a non-existent track.
-               if (t == NULL) return;
-               {
-                  if (CountNumTracks(mProject) == 1)
-                     t->SetOffset(offset);
-                  else
-                  {
-                     if (t->GetLinked())
-                        t->SetOffset(offset);
-
-                     t = iter.Next();
-                     t->SetOffset(offset);
-                  }
-               }
-
-               // Amend the undo transaction made by import
-               mProject->TP_ModifyState();
-            } // end of converting "offset" argument
+
+            // handle an "offset" specifier; it applies once the file is imported
+            if (Internat::CompatibleToDouble(tokenholder, &fileLine.offset))
+               fileLine.hasOffset = true;
             else
             {
                /* i18n-hint: You do not need to translate "LOF" */
@@ -446,6 +414,8 @@ void LOFImportFileHandle::lofOpenFiles(wxString* ln)
             }
          }     // End if statement for "offset" parameters
       }     // End if statement (more tokens after file name)
+
+      mFileLines.push_back(fileLine);
    }     // End if statement "file" lines
 
    else if (tokenholder.IsSameAs(wxT("#")))
@@ -459,6 +429,43 @@ void LOFImportFileHandle::lofOpenFiles(wxString* ln)
    }
 }
 
+void LOFImportFileHandle::doImportFiles()
+{
+   if (mFileLines.empty())
+      return;
+
+   auto cleanup = finally( [&] { mFileLines.clear(); } );
+
+   mProject = AudacityProject::OpenProject( mProject );
+   if (!mProject)
+      return;
+
+   wxArrayString fileNames;
+   for (const auto &fileLine : mFileLines)
+      fileNames.Add(fileLine.fileName);
+
+   std::vector<WaveTrackArray> trackArrays;
+   mProject->ImportBatch(fileNames, &trackArrays);
+
+   bool offsetAny = false;
+   for (size_t ii = 0; ii < mFileLines.size(); ++ii)
+   {
+      if (!mFileLines[ii].hasOffset)
+         continue;
+      // No tracks, if there was an import error,
+      // presumably with its own error message
+      for (const auto &track : trackArrays[ii])
+      {
+         track->SetOffset(mFileLines[ii].offset);
+         offsetAny = true;
+      }
+   }
+
+   if (offsetAny)
+      // Amend the undo transaction made by import
+      mProject->TP_ModifyState();
+}
+
 void LOFImportFileHandle::doDurationAndScrollOffset()
 {
    if (!mProject)
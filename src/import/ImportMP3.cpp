@@ -42,6 +42,7 @@
 #include "../AudacityException.h"
 #include "../Prefs.h"
 #include "Import.h"
+#include "ImportAppender.h"
 #include "ImportPlugin.h"
 #include "../Internat.h"
 
@@ -75,13 +76,20 @@ void GetMP3ImportPlugin(ImportPluginList &importPluginList,
 #include <wx/timer.h>
 #include <wx/intl.h>
 
+#include <algorithm>
+
 extern "C" {
 #include "mad.h"
 }
 
 #include "../WaveTrack.h"
+#include "../ondemand/ODManager.h"
+#include "../ondemand/ODDecodeMP3Task.h"
 
 #define INPUT_BUFFER_SIZE 65535
+// As in ImportPCM, decode on demand only files longer than this many
+// seconds.  Otherwise, why wake up extra threads.
+#define MINIMUM_OD_DURATION 30
 #define PROGRESS_SCALING_FACTOR 100000
 
 /* this is a private structure we can use for whatever we like, and it will get
@@ -93,7 +101,8 @@ struct private_data {
    int inputBufferFill;     /* amount of data in inputBuffer */
    TrackFactory *trackFactory;
    TrackHolders channels;
-   ProgressDialog *progress;
+   std::unique_ptr<ImportAppender> appender;
+   ImportFileHandle *handle;
    unsigned numChannels;
    ProgressResult updateResult;
    bool id3checked;
@@ -141,7 +150,13 @@ public:
    void SetStreamUsage(wxInt32 WXUNUSED(StreamID), bool WXUNUSED(Use)) override
    {}
 
+   bool CanImportConcurrently() override { return true; }
+
 private:
+   // Makes tracks of blocks that ODDecodeMP3Task decodes later
+   ProgressResult ImportOnDemand(TrackFactory *trackFactory, TrackHolders &outTracks,
+      sampleCount numSamples, unsigned numChannels, unsigned rate);
+
    std::unique_ptr<wxFile> mFile;
    void *mUserData;
    mad_decoder mDecoder;
@@ -205,12 +220,23 @@ ProgressResult MP3ImportFileHandle::Import(TrackFactory *trackFactory, TrackHold
 
    CreateProgress();
 
+   // Long files open at once, from an index of the frames, and decode
+   // as they are needed
+   bool useOD = true;
+   gPrefs->Read(wxT("/FileFormats/DecodeOnDemand"), &useOD, true);
+   sampleCount numSamples;
+   unsigned numChannels, rate;
+   if (useOD &&
+       ODMP3Decoder::ReadLength(mFilename, numSamples, numChannels, rate) &&
+       numSamples > sampleCount{ MINIMUM_OD_DURATION * rate })
+      return ImportOnDemand(trackFactory, outTracks, numSamples, numChannels, rate);
+
    /* Prepare decoder data, initialize decoder */
 
    private_data privateData;
    privateData.file        = mFile.get();
    privateData.inputBufferFill = 0;
-   privateData.progress    = mProgress.get();
+   privateData.handle      = this;
    privateData.updateResult= ProgressResult::Success;
    privateData.id3checked  = false;
    privateData.numChannels = 0;
@@ -239,6 +265,7 @@ ProgressResult MP3ImportFileHandle::Import(TrackFactory *trackFactory, TrackHold
 
       /* copy the WaveTrack pointers into the Track pointer list that
        * we are expected to fill */
+   privateData.appender->Flush();
    for(const auto &channel : privateData.channels) {
       channel->Flush();
    }
@@ -247,6 +274,55 @@ ProgressResult MP3ImportFileHandle::Import(TrackFactory *trackFactory, TrackHold
    return privateData.updateResult;
 }
 
+ProgressResult MP3ImportFileHandle::ImportOnDemand(
+   TrackFactory *trackFactory, TrackHolders &outTracks,
+   sampleCount numSamples, unsigned numChannels, unsigned rate)
+{
+   sampleFormat format = (sampleFormat) gPrefs->
+      Read(wxT("/SamplingRate/DefaultProjectSampleFormat"), floatSample);
+
+   TrackHolders channels(numChannels);
+   for(auto &channel: channels) {
+      channel = trackFactory->NewWaveTrack(format, rate);
+      channel->SetChannel(Track::MonoChannel);
+   }
+
+   /* special case: 2 channels is understood to be stereo */
+   if(numChannels == 2) {
+      channels.begin()->get()->SetChannel(Track::LeftChannel);
+      channels.rbegin()->get()->SetChannel(Track::RightChannel);
+      channels.begin()->get()->SetLinked(true);
+   }
+
+   auto updateResult = ProgressResult::Success;
+   const auto maxBlockSize = channels.begin()->get()->GetMaxBlockSize();
+   for (decltype(numSamples) i = 0; i < numSamples; i += maxBlockSize) {
+      const auto blockLen =
+         limitSampleBufferSize( maxBlockSize, numSamples - i );
+
+      for (size_t c = 0; c < numChannels; ++c)
+         channels[c]->AppendCoded(mFilename, i, blockLen, c, ODTask::eODMP3);
+
+      updateResult = UpdateProgress(
+         i.as_double(),
+         numSamples.as_double()
+      );
+      if (updateResult != ProgressResult::Success)
+         return updateResult;
+   }
+
+   //if we have a mono or linked track (stereo), we add ONE task for it
+   auto decoderTask = make_movable<ODDecodeMP3Task>();
+   for (const auto &channel : channels) {
+      channel->Flush();
+      decoderTask->AddWaveTrack(channel.get());
+   }
+   ODManager::Instance()->AddNewTask(std::move(decoderTask));
+
+   outTracks.swap(channels);
+   return updateResult;
+}
+
 MP3ImportFileHandle::~MP3ImportFileHandle()
 {
 }
@@ -261,9 +337,9 @@ enum mad_flow input_cb(void *_data, struct mad_stream *stream)
 {
    struct private_data *data = (struct private_data *)_data;
 
-   data->updateResult = data->progress->Update((wxULongLong_t)data->file->Tell(),
-                                             (wxULongLong_t)data->file->Length() != 0 ?
-                                             (wxULongLong_t)data->file->Length() : 1);
+   data->updateResult = data->handle->UpdateProgress((double)data->file->Tell(),
+                                             data->file->Length() != 0 ?
+                                             (double)data->file->Length() : 1.0);
    if(data->updateResult != ProgressResult::Success)
       return MAD_FLOW_STOP;
 
@@ -359,6 +435,12 @@ enum mad_flow output_cb(void *_data,
             data->channels.begin()->get()->SetLinked(true);
          }
          data->numChannels = channels;
+
+         std::vector<WaveTrack*> tracks;
+         for(const auto &channel: data->channels)
+            tracks.push_back(channel.get());
+         data->appender =
+            std::make_unique<ImportAppender>(tracks, floatSample);
       }
       else {
          // This is not the first run, protect us from libmad glitching
@@ -367,19 +449,21 @@ enum mad_flow output_cb(void *_data,
       }
 
       /* TODO: get rid of this by adding fixed-point support to SampleFormat.
-       * For now, we allocate temporary float buffers to convert the fixed
-       * point samples into something we can feed to the WaveTrack.  Allocating
-       * big blocks of data like this isn't a great idea, but it's temporary.
+       * For now, we convert the fixed point samples to floats in the
+       * staging buffers of the appender, which are made once per import.
        */
-      FloatBuffers channelBuffers{ channels, samples };
-      for(size_t smpl = 0; smpl < samples; smpl++)
-         for(int chn = 0; chn < channels; chn++)
-            channelBuffers[chn][smpl] = scale(pcm->samples[chn][smpl]);
-
-      for(int chn = 0; chn < channels; chn++)
-         data->channels[chn]->Append((samplePtr)channelBuffers[chn].get(),
-                                     floatSample,
-                                     samples);
+      auto &appender = *data->appender;
+      for(size_t done = 0; done < samples;) {
+         const auto len = std::min<size_t>(appender.Room(), samples - done);
+         for(int chn = 0; chn < channels; chn++) {
+            const auto src = pcm->samples[chn] + done;
+            const auto dst = (float *)appender.Next(chn);
+            for(size_t smpl = 0; smpl < len; smpl++)
+               dst[smpl] = scale(src[smpl]);
+         }
+         appender.Commit(len);
+         done += len;
+      }
 
       return MAD_FLOW_CONTINUE;
    }, MakeSimpleGuard(MAD_FLOW_BREAK) );
@@ -78,8 +78,18 @@ void GetOGGImportPlugin(ImportPluginList &importPluginList,
 #include <vorbis/vorbisfile.h>
 
 #include "../WaveTrack.h"
+#include "../ondemand/ODManager.h"
+#include "../ondemand/ODDecodeOggTask.h"
+#include "ImportAppender.h"
 #include "ImportPlugin.h"
 
+#include <algorithm>
+#include <vector>
+
+// As in ImportPCM, decode on demand only files longer than this many
+// seconds.  Otherwise, why wake up extra threads.
+#define MINIMUM_OD_DURATION 30
+
 class OggImportPlugin final : public ImportPlugin
 {
 public:
@@ -147,7 +157,13 @@ public:
       }
    }
 
+   bool CanImportConcurrently() override { return true; }
+
 private:
+   // Whether to make tracks of blocks that ODDecodeOggTask decodes later
+   bool UseOnDemand();
+   ProgressResult ImportOnDemand(TrackHolders &outTracks);
+
    std::unique_ptr<wxFFile> mFile;
    std::unique_ptr<OggVorbis_File> mVorbisFile;
 
@@ -278,28 +294,33 @@ ProgressResult OggImportFileHandle::Import(TrackFactory *trackFactory, TrackHold
       }
    }
 
-   /* The number of bytes to get from the codec in each run */
-#define CODEC_TRANSFER_SIZE 4096u
+   if (UseOnDemand())
+      return ImportOnDemand(outTracks);
+
+   /* The number of samples of each channel to get from the codec in each run */
+#define CODEC_TRANSFER_SIZE 4096
 
    /* The number of samples to read between calls to the callback.
     * Balance between responsiveness of the GUI and throughput of import. */
 #define SAMPLES_PER_CALLBACK 100000
 
    auto updateResult = ProgressResult::Success;
-   long bytesRead = 0;
+   long samplesRead = 0;
    {
-      ArrayOf<short> mainBuffer{ CODEC_TRANSFER_SIZE };
-
-      /* determine endianness (clever trick courtesy of Nicholas Devillard,
-       * (http://www.eso.org/~ndevilla/endian/) */
-      int testvar = 1, endian;
-      if (*(char *)&testvar)
-         endian = 0;  // little endian
-      else
-         endian = 1;  // big endian
+      // The codec decodes to floats, which go to the tracks through staging
+      // buffers made once, for each logical bitstream that is used
+      std::vector< std::unique_ptr<ImportAppender> > appenders(mChannels.size());
+      int i = 0;
+      for (auto &link : mChannels) {
+         if (mStreamUsage[i] != 0) {
+            std::vector<WaveTrack*> tracks;
+            for (auto &channel : link)
+               tracks.push_back(channel.get());
+            appenders[i] = std::make_unique<ImportAppender>(tracks, floatSample);
+         }
+         ++i;
+      }
 
-      /* number of samples currently in each channel's buffer */
-      long samplesRead = 0;
       int bitstream = 0;
       int samplesSinceLastCallback = 0;
 
@@ -312,16 +333,14 @@ ProgressResult OggImportFileHandle::Import(TrackFactory *trackFactory, TrackHold
 
       do {
          /* get data from the decoder */
-         bytesRead = ov_read(mVorbisFile.get(), (char *)mainBuffer.get(),
+         float **pcm;
+         samplesRead = ov_read_float(mVorbisFile.get(), &pcm,
             CODEC_TRANSFER_SIZE,
-            endian,
-            2,    // word length (2 for 16 bit samples)
-            1,    // signed
             &bitstream);
 
-         if (bytesRead == OV_HOLE) {
+         if (samplesRead == OV_HOLE) {
             wxFileName ff(mFilename);
-            wxLogError(wxT("Ogg Vorbis importer: file %s is malformed, ov_read() reported a hole"),
+            wxLogError(wxT("Ogg Vorbis importer: file %s is malformed, ov_read_float() reported a hole"),
                ff.GetFullName());
             /* http://lists.xiph.org/pipermail/vorbis-dev/2001-February/003223.html
              * is the justification for doing this - best effort for malformed file,
@@ -329,40 +348,43 @@ ProgressResult OggImportFileHandle::Import(TrackFactory *trackFactory, TrackHold
              */
             continue;
          }
-         else if (bytesRead < 0) {
+         else if (samplesRead < 0) {
             /* Malformed Ogg Vorbis file. */
             /* TODO: Return some sort of meaningful error. */
-            wxLogError(wxT("Ogg Vorbis importer: ov_read() returned error %i"),
-               bytesRead);
+            wxLogError(wxT("Ogg Vorbis importer: ov_read_float() returned error %i"),
+               samplesRead);
             break;
          }
 
-         samplesRead = bytesRead / mVorbisFile->vi[bitstream].channels / sizeof(short);
-
          /* give the data to the wavetracks */
-         auto iter = mChannels.begin();
-         std::advance(iter, bitstream);
-         if (mStreamUsage[bitstream] != 0)
+         if (auto appender = appenders[bitstream].get())
          {
-            auto iter2 = iter->begin();
-            for (int c = 0; c < mVorbisFile->vi[bitstream].channels; ++iter2, ++c)
-               iter2->get()->Append((char *)(mainBuffer.get() + c),
-               int16Sample,
-               samplesRead,
-               mVorbisFile->vi[bitstream].channels);
+            for (size_t done = 0; done < (size_t)samplesRead;) {
+               const auto len =
+                  std::min<size_t>(appender->Room(), samplesRead - done);
+               for (unsigned c = 0; c < appender->GetChannels(); ++c)
+                  std::copy(pcm[c] + done, pcm[c] + done + len,
+                            (float *)appender->Next(c));
+               appender->Commit(len);
+               done += len;
+            }
          }
 
          samplesSinceLastCallback += samplesRead;
          if (samplesSinceLastCallback > SAMPLES_PER_CALLBACK) {
-            updateResult = mProgress->Update(ov_time_tell(mVorbisFile.get()),
+            updateResult = UpdateProgress(ov_time_tell(mVorbisFile.get()),
                ov_time_total(mVorbisFile.get(), bitstream));
             samplesSinceLastCallback -= SAMPLES_PER_CALLBACK;
          }
-      } while (updateResult == ProgressResult::Success && bytesRead != 0);
+      } while (updateResult == ProgressResult::Success && samplesRead != 0);
+
+      for (auto &appender : appenders)
+         if (appender)
+            appender->Flush();
    }
 
    auto res = updateResult;
-   if (bytesRead < 0)
+   if (samplesRead < 0)
      res = ProgressResult::Failed;
 
    if (res == ProgressResult::Failed || res == ProgressResult::Cancelled) {
@@ -380,6 +402,62 @@ ProgressResult OggImportFileHandle::Import(TrackFactory *trackFactory, TrackHold
    return res;
 }
 
+bool OggImportFileHandle::UseOnDemand()
+{
+   bool useOD = true;
+   gPrefs->Read(wxT("/FileFormats/DecodeOnDemand"), &useOD, true);
+
+   // The decoder seeks by sample, within one logical bitstream
+   if (!useOD || mVorbisFile->links != 1 || mStreamUsage[0] == 0 ||
+       !ov_seekable(mVorbisFile.get()))
+      return false;
+
+   const auto total = ov_pcm_total(mVorbisFile.get(), 0);
+   return total > MINIMUM_OD_DURATION * mVorbisFile->vi[0].rate;
+}
+
+ProgressResult OggImportFileHandle::ImportOnDemand(TrackHolders &outTracks)
+{
+   auto &link = mChannels.front();
+   const sampleCount numSamples = ov_pcm_total(mVorbisFile.get(), 0);
+   const auto maxBlockSize = link.begin()->get()->GetMaxBlockSize();
+
+   auto updateResult = ProgressResult::Success;
+   for (decltype(numSamples) i = 0; i < numSamples; i += maxBlockSize) {
+      const auto blockLen =
+         limitSampleBufferSize( maxBlockSize, numSamples - i );
+
+      int c = 0;
+      for (auto &channel : link)
+         channel->AppendCoded(mFilename, i, blockLen, c++, ODTask::eODOGG);
+
+      updateResult = UpdateProgress(
+         i.as_double(),
+         numSamples.as_double()
+      );
+      if (updateResult != ProgressResult::Success)
+         return updateResult;
+   }
+
+   //if we have a mono or linked track (stereo), we add ONE task for it;
+   //more channels are separate tracks, each with its own task
+   const bool moreThanStereo = link.size() > 2;
+   auto decoderTask = make_movable<ODDecodeOggTask>();
+   for (auto &channel : link) {
+      channel->Flush();
+      decoderTask->AddWaveTrack(channel.get());
+      if (moreThanStereo) {
+         ODManager::Instance()->AddNewTask(std::move(decoderTask));
+         decoderTask = make_movable<ODDecodeOggTask>();
+      }
+      outTracks.push_back(std::move(channel));
+   }
+   if (!moreThanStereo)
+      ODManager::Instance()->AddNewTask(std::move(decoderTask));
+
+   return updateResult;
+}
+
 OggImportFileHandle::~OggImportFileHandle()
 {
    ov_clear(mVorbisFile.get());
@@ -37,15 +37,22 @@
 
 #include "../ondemand/ODManager.h"
 #include "../ondemand/ODComputeSummaryTask.h"
+#include "../ondemand/ODCopyInTask.h"
 
 //If OD is enabled, he minimum number of samples a file has to use it.
 //Otherwise, we use the older PCMAliasBlockFile method since it should be fast enough.
 #define kMinimumODFileSampleSize 44100*30
 
+//Bytes of interleaved samples read at once in copy mode, whatever the block size
+#define kCopyReadBytes (4 * 1024 * 1024)
+//Copies of files of at least so many channels are packed into one file
+#define kPackChannels 8
+
 #ifndef SNDFILE_1
 #error Requires libsndfile 1.0 or higher
 #endif
 
+#include "../DirManager.h"
 #include "../FileFormats.h"
 #include "../Prefs.h"
 #include "../WaveTrack.h"
@@ -55,6 +62,64 @@
 
 #define DESC _("WAV, AIFF, and other uncompressed types")
 
+namespace {
+
+// Scatters interleaved frames into one buffer per channel, in one pass over
+// the source.  Frames go in short runs so that the destinations of many
+// channels stay in the cache; the loops for one and two channels are
+// simple enough for the compiler to vectorize.
+template<typename T>
+void Deinterleave(const T *src, const samplePtr *dsts, unsigned nChannels,
+                  size_t frames)
+{
+   if (nChannels == 1) {
+      std::copy(src, src + frames, (T *)dsts[0]);
+      return;
+   }
+
+   if (nChannels == 2) {
+      T *const left = (T *)dsts[0], *const right = (T *)dsts[1];
+      for (size_t j = 0; j < frames; ++j) {
+         left[j] = src[2 * j];
+         right[j] = src[2 * j + 1];
+      }
+      return;
+   }
+
+   const size_t run = 256;
+   for (size_t start = 0; start < frames; start += run) {
+      const auto end = std::min(frames, start + run);
+      for (size_t j = start; j < end; ++j) {
+         const T *frame = src + j * nChannels;
+         for (unsigned c = 0; c < nChannels; ++c)
+            ((T *)dsts[c])[j] = frame[c];
+      }
+   }
+}
+
+// Gives the channels to the ODManager in tasks of type Task: one for a
+// mono track or a linked pair, or one for each of more channels, which
+// import to separate tracks
+template<typename Task>
+void AddODTasks(const TrackHolders &channels)
+{
+   auto task = make_movable<Task>();
+   bool moreThanStereo = channels.size()>2;
+   for (const auto &channel : channels)
+   {
+      task->AddWaveTrack(channel.get());
+      if(moreThanStereo)
+      {
+         ODManager::Instance()->AddNewTask(std::move(task));
+         task = make_movable<Task>();
+      }
+   }
+   if(!moreThanStereo)
+      ODManager::Instance()->AddNewTask(std::move(task));
+}
+
+}
+
 class PCMImportPlugin final : public ImportPlugin
 {
 public:
@@ -93,10 +158,15 @@ public:
    void SetStreamUsage(wxInt32 WXUNUSED(StreamID), bool WXUNUSED(Use)) override
    {}
 
+   bool CanImportConcurrently() override { return true; }
+   ProgressResult PrepareImport() override;
+
 private:
    SFFile                mFile;
    const SF_INFO         mInfo;
    sampleFormat          mFormat;
+   // "copy" or "edit", once PrepareImport() asked
+   wxString              mCopyEdit;
 };
 
 void GetPCMImportPlugin(ImportPluginList & importPluginList,
@@ -321,6 +391,16 @@ static wxString AskCopyOrEdit()
    return oldCopyPref;
 }
 
+ProgressResult PCMImportFileHandle::PrepareImport()
+{
+   // Get the preference / warn the user about aliased files.
+   mCopyEdit = AskCopyOrEdit();
+
+   if (mCopyEdit == wxT("cancel"))
+      return ProgressResult::Cancelled;
+   return ProgressResult::Success;
+}
+
 ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
                                 TrackHolders &outTracks)
 {
@@ -328,11 +408,9 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
 
    wxASSERT(mFile.get());
 
-   // Get the preference / warn the user about aliased files.
-   wxString copyEdit = AskCopyOrEdit();
-
-   if (copyEdit == wxT("cancel"))
+   if (mCopyEdit.empty() && PrepareImport() != ProgressResult::Success)
       return ProgressResult::Cancelled;
+   const wxString copyEdit = mCopyEdit;
 
    // Fall back to "copy" if it doesn't match anything else, since it is safer
    bool doEdit = false;
@@ -376,6 +454,15 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
    if (!mInfo.seekable)
       doEdit = false;
 
+   // A copy of a long file is made of aliases too, so that the project is
+   // usable at once; then ODCopyInTask copies the samples in, after the
+   // summaries
+   bool copyInBackground = false;
+   if (!doEdit && mInfo.seekable && fileTotalFrames > kMinimumODFileSampleSize)
+      gPrefs->Read(wxT("/FileFormats/CopyInBackground"), &copyInBackground, true);
+   if (copyInBackground)
+      doEdit = true;
+
    if (doEdit) {
       // If this mode has been selected, we form the tracks as
       // aliases to the files we're editing, i.e. ("foo.wav", 12000-18000)
@@ -396,9 +483,9 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
             iter->get()->AppendAlias(mFilename, i, blockLen, c,useOD);
 
          if (++updateCounter == 50) {
-            updateResult = mProgress->Update(
-               i.as_long_long(),
-               fileTotalFrames.as_long_long()
+            updateResult = UpdateProgress(
+               i.as_double(),
+               fileTotalFrames.as_double()
             );
             updateCounter = 0;
             if (updateResult != ProgressResult::Success)
@@ -407,28 +494,17 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
       }
 
       // One last update for completion
-      updateResult = mProgress->Update(
-         fileTotalFrames.as_long_long(),
-         fileTotalFrames.as_long_long()
+      updateResult = UpdateProgress(
+         fileTotalFrames.as_double(),
+         fileTotalFrames.as_double()
       );
 
       if(useOD)
       {
-         auto computeTask = make_movable<ODComputeSummaryTask>();
-         bool moreThanStereo = mInfo.channels>2;
-         for (const auto &channel : channels)
-         {
-            computeTask->AddWaveTrack(channel.get());
-            if(moreThanStereo)
-            {
-               //if we have 3 more channels, they get imported on seperate tracks, so we add individual tasks for each.
-               ODManager::Instance()->AddNewTask(std::move(computeTask));
-               computeTask = make_movable<ODComputeSummaryTask>();
-            }
-         }
-         //if we have a linked track, we add ONE task.
-         if(!moreThanStereo)
-            ODManager::Instance()->AddNewTask(std::move(computeTask));
+         AddODTasks<ODComputeSummaryTask>(channels);
+         // Queued after the summaries of the same tracks
+         if(copyInBackground)
+            AddODTasks<ODCopyInTask>(channels);
       }
    }
    else {
@@ -440,23 +516,43 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
       using type = decltype(maxBlockSize);
       if (mInfo.channels < 1)
          return ProgressResult::Failed;
-      auto maxBlock = std::min(maxBlockSize,
-         std::numeric_limits<type>::max() /
-            (mInfo.channels * SAMPLE_SIZE(mFormat))
+      const auto frameBytes = mInfo.channels * SAMPLE_SIZE(mFormat);
+      // Reads are sized by bytes, not by the block size, so that files of
+      // few channels read in long runs and files of many in bounded ones;
+      // Append() makes the blocks
+      auto maxBlock = std::min<type>(
+         std::max<type>(kCopyReadBytes / frameBytes, 4096),
+         std::numeric_limits<type>::max() / frameBytes
       );
       if (maxBlock < 1)
          return ProgressResult::Failed;
 
-      SampleBuffer srcbuffer, buffer;
-      wxASSERT(mInfo.channels >= 0);
-      while (NULL == srcbuffer.Allocate(maxBlock * mInfo.channels, mFormat).ptr() ||
-             NULL == buffer.Allocate(maxBlock, mFormat).ptr())
+      const auto nChannels = (unsigned)mInfo.channels;
+      SampleBuffer srcbuffer;
+      ArrayOf<SampleBuffer> buffers{ nChannels };
+      ArrayOf<samplePtr> bufferPtrs{ nChannels };
+      const auto allocate = [&] {
+         if (NULL == srcbuffer.Allocate(maxBlock * nChannels, mFormat).ptr())
+            return false;
+         for (unsigned c = 0; c < nChannels; ++c)
+            if (NULL == (bufferPtrs[c] =
+                         buffers[c].Allocate(maxBlock, mFormat).ptr()))
+               return false;
+         return true;
+      };
+      while (!allocate())
       {
          maxBlock /= 2;
          if (maxBlock < 1)
             return ProgressResult::Failed;
       }
 
+      // Rather than a file for each block of each channel, one file, with
+      // the blocks of the channels together in the order of time
+      Maybe<DirManager::PackingScope> packing;
+      if (nChannels >= kPackChannels)
+         packing.create(*channels.begin()->get()->GetDirManager());
+
       decltype(fileTotalFrames) framescompleted = 0;
 
       long block;
@@ -475,27 +571,22 @@ ProgressResult PCMImportFileHandle::Import(TrackFactory *trackFactory,
          }
 
          if (block) {
+            if (mFormat==int16Sample)
+               Deinterleave((const short *)srcbuffer.ptr(),
+                  bufferPtrs.get(), nChannels, block);
+            else
+               Deinterleave((const float *)srcbuffer.ptr(),
+                  bufferPtrs.get(), nChannels, block);
+
             auto iter = channels.begin();
-            for(int c=0; c<mInfo.channels; ++iter, ++c) {
-               if (mFormat==int16Sample) {
-                  for(int j=0; j<block; j++)
-                     ((short *)buffer.ptr())[j] =
-                        ((short *)srcbuffer.ptr())[mInfo.channels*j+c];
-               }
-               else {
-                  for(int j=0; j<block; j++)
-                     ((float *)buffer.ptr())[j] =
-                        ((float *)srcbuffer.ptr())[mInfo.channels*j+c];
-               }
-
-               iter->get()->Append(buffer.ptr(), (mFormat == int16Sample)?int16Sample:floatSample, block);
-            }
+            for(unsigned c=0; c<nChannels; ++iter, ++c)
+               iter->get()->Append(bufferPtrs[c], (mFormat == int16Sample)?int16Sample:floatSample, block);
             framescompleted += block;
          }
 
-         updateResult = mProgress->Update(
-            framescompleted.as_long_long(),
-            fileTotalFrames.as_long_long()
+         updateResult = UpdateProgress(
+            framescompleted.as_double(),
+            fileTotalFrames.as_double()
          );
          if (updateResult != ProgressResult::Success)
             break;
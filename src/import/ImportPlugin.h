@@ -64,9 +64,19 @@ but little else.
 
 #include "ImportRaw.h" // defines TrackHolders
 
+#include <atomic>
+
 class TrackFactory;
 class Track;
 
+// How far an import that runs on a worker thread, as one of a batch, has
+// gone, and what the user chose in the progress dialog of the batch
+struct ImportProgress
+{
+   std::atomic<double> fraction{ 0.0 };
+   std::atomic<unsigned> userChoice{ (unsigned) ProgressResult::Success };
+};
+
 class ImportFileHandle;
 
 class ImportPlugin /* not final */
@@ -120,7 +130,8 @@ class ImportFileHandle /* not final */
 public:
    ImportFileHandle(const wxString & filename)
    :  mFilename(filename),
-   mProgress{}
+   mProgress{},
+   mBatchProgress{}
    {
    }
 
@@ -132,6 +143,10 @@ public:
    // identify the filename being imported.
    void CreateProgress()
    {
+      // A batch has one dialog for all its files
+      if (mBatchProgress)
+         return;
+
       wxFileName ff(mFilename);
       wxString title;
 
@@ -167,9 +182,32 @@ public:
    // Set stream "import/don't import" flag
    virtual void SetStreamUsage(wxInt32 StreamID, bool Use) = 0;
 
+   // Whether Import() may run on a worker thread, beside the imports of
+   // other files, after PrepareImport() ran on the main thread.  Such an
+   // Import() must not use the GUI.
+   virtual bool CanImportConcurrently() { return false; }
+
+   // Asks the user, on the main thread, whatever Import() would ask
+   virtual ProgressResult PrepareImport() { return ProgressResult::Success; }
+
+   // Makes Import() report to the batch instead of a dialog of its own
+   void SetBatchProgress(ImportProgress *progress) { mBatchProgress = progress; }
+
+   // The importer calls this in its importing loop, in place of updating the
+   // dialog itself, and stops unless it gives ProgressResult::Success
+   ProgressResult UpdateProgress(double current, double total)
+   {
+      if (mBatchProgress) {
+         mBatchProgress->fraction.store(total > 0 ? current / total : 0.0);
+         return (ProgressResult) mBatchProgress->userChoice.load();
+      }
+      return mProgress->Update(current, total);
+   }
+
 protected:
    wxString mFilename;
    Maybe<ProgressDialog> mProgress;
+   ImportProgress *mBatchProgress;
 };
 
 
@@ -16,6 +16,7 @@ machine endianness representations.
 
 #include "MultiFormatReader.h"
 
+#include <algorithm>
 #include <exception>
 #include <stdexcept>
 #include <cstring>
@@ -24,6 +25,72 @@ machine endianness representations.
 
 #include <wx/defs.h>
 
+// Byte swaps of 16 bytes at a time.  SSE2 is part of every x86-64
+// processor, and NEON of every 64 bit ARM, so these are chosen at compile
+// time; other targets use the scalar loop.
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MULTIFORMAT_SWAP_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MULTIFORMAT_SWAP_NEON
+#endif
+
+// Bytes of the file read at once by a strided read
+#define kStridedReadBytes (1024 * 1024)
+
+namespace {
+
+#if defined(MULTIFORMAT_SWAP_SSE2)
+// Swaps the bytes of each 16 bit word
+inline __m128i Swap16x8(__m128i v)
+{
+   return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+#endif
+
+// Reverses the bytes of each of len samples of size bytes, sixteen bytes
+// at a time where there is a vector unit
+template<size_t size>
+void SwapSamples(uint8_t *buffer, size_t len)
+{
+   size_t i = 0;
+#if defined(MULTIFORMAT_SWAP_SSE2) || defined(MULTIFORMAT_SWAP_NEON)
+   const size_t perVector = 16 / size;
+   for (; i + perVector <= len; i += perVector) {
+      uint8_t *p = buffer + i * size;
+#if defined(MULTIFORMAT_SWAP_SSE2)
+      __m128i v = _mm_loadu_si128((const __m128i *)p);
+      if (size == 4) {
+         v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+         v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+      }
+      else if (size == 8) {
+         v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+         v = _mm_shufflehi_epi16(v, _MM_SHUFFLE(0, 1, 2, 3));
+      }
+      _mm_storeu_si128((__m128i *)p, Swap16x8(v));
+#else
+      uint8x16_t v = vld1q_u8(p);
+      if (size == 2)
+         v = vrev16q_u8(v);
+      else if (size == 4)
+         v = vrev32q_u8(v);
+      else
+         v = vrev64q_u8(v);
+      vst1q_u8(p, v);
+#endif
+   }
+#endif
+   for (; i < len; i++) {
+      uint8_t *p = buffer + i * size;
+      std::reverse(p, p + size);
+   }
+}
+
+}
+
 MachineEndianness::MachineEndianness()
 {
    if (wxBYTE_ORDER == wxLITTLE_ENDIAN)
@@ -114,13 +181,27 @@ size_t MultiFormatReader::Read(void* buffer, size_t size, size_t len, size_t str
    
    if (stride > 1)
    {
-      // There are gaps between consecutive samples,
-      // so do a scattered read
-      for (size_t n = 0; n < len; n++)
+      // There are gaps between consecutive samples, so read whole frames
+      // of stride samples in large pieces, and gather the first of each
+      const size_t frameBytes = size * stride;
+      const size_t framesPerRead =
+         std::max<size_t>(1, kStridedReadBytes / frameBytes);
+      mReadBuffer.resize(framesPerRead * frameBytes);
+      while (actRead < len)
       {
-         actRead += fread(&(pWork[n*size]), size, 1, mpFid);
-         // FIXME: TRAP_ERR fseek return in MultiFormatReader unchecked.
-         fseek(mpFid, (stride - 1) * size, SEEK_CUR);
+         const size_t want = std::min(framesPerRead, len - actRead);
+         const size_t got =
+            fread(mReadBuffer.data(), 1, want * frameBytes, mpFid);
+         // The last frame may be cut short after its sample
+         size_t frames = got / frameBytes;
+         if (frames < want && got % frameBytes >= size)
+            frames++;
+         const uint8_t *pFrame = mReadBuffer.data();
+         for (size_t n = 0; n < frames; n++, pFrame += frameBytes)
+            memcpy(&(pWork[(actRead + n) * size]), pFrame, size);
+         actRead += frames;
+         if (got < want * frameBytes)
+            break;
       }
    }
    else
@@ -142,6 +223,23 @@ void MultiFormatReader::SwapBytes(void* buffer, size_t size, size_t len)
    {
       throw std::runtime_error("SwapBytes Exception: Format width exceeding 8 bytes.");
    }
+
+   switch (size)
+   {
+      case 1:
+         return;
+      case 2:
+         SwapSamples<2>(pResBuffer, len);
+         return;
+      case 4:
+         SwapSamples<4>(pResBuffer, len);
+         return;
+      case 8:
+         SwapSamples<8>(pResBuffer, len);
+         return;
+      default:
+         break;
+   }
    
    for (size_t i = 0; i < len; i++)
    {
@@ -13,6 +13,7 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <vector>
 
 class MachineEndianness
 {
@@ -51,6 +52,8 @@ class MultiFormatReader
    FILE* mpFid;   
    MachineEndianness mEnd;
    uint8_t mSwapBuffer[8];
+   // Whole frames of a strided read, from which the samples are gathered
+   std::vector<uint8_t> mReadBuffer;
 
 public:
    typedef enum
@@ -27,6 +27,11 @@
 #include <wx/ffile.h>
 
 #include "../Internat.h"
+#include "../MixerPool.h"
+
+#include <algorithm>
+#include <vector>
+#include <wx/thread.h>
 
 #define RAW_GUESS_DEBUG 0
 
@@ -328,79 +333,86 @@ static int GuessFloatFormats(unsigned numTests, const ArrayOf<char> rawData[], s
     * floats with a 1-byte offset.
     */
 
-   for(unsigned int prec = 0; prec < 2; prec++) {
-      for(int endian = 0; endian < 2; endian++) {
-         for(size_t offset = 0; offset < (4 * prec + 4); offset++) {
-            unsigned finiteVotes = 0;
-            unsigned maxminVotes = 0;
-            float smoothAvg = 0;
-
-           #if RAW_GUESS_DEBUG
-            wxFprintf(af, "prec=%d endian=%d offset=%d\n",
-                    prec, endian, (int)offset);
-           #endif
-
-            for(unsigned test = 0; test < numTests; test++) {
-               float min, max;
-
-               ExtractFloats(prec == 1, endian == 1,
-                             true, /* stereo */
-                             offset,
-                             rawData[test].get(), dataSize,
-                             data1.get(), data2.get(), &len1, &len2);
-
-               size_t i = 0;
-               for(; i < len1; i++)
-                  // This code is testing for NaNs.
-                  // We'd like to know if all data is finite.
-                  if (!(data1[i]>=0 || data1[i]<=0) ||
-                      !(data2[i]>=0 || data2[i]<=0))
-                     break;
-               if (i == len1)
-                  // all data is finite.
-                  finiteVotes++;
-
-               min = data1[0];
-               max = data1[0];
-               for(i = 1; i < len1; i++) {
-                  if (data1[i]<min)
-                     min = data1[i];
-                  if (data1[i]>max)
-                     max = data1[i];
-               }
-               for(i = 1; i < len2; i++) {
-                  if (data2[i]<min)
-                     min = data2[i];
-                  if (data2[i]>max)
-                     max = data2[i];
-               }
-
-               if (min < -0.01 && min >= -100000 &&
-                   max > 0.01 && max <= 100000)
-                  maxminVotes++;
-
-               smoothAvg += SecondDStat(data1.get(), len1) / max;
+   /*
+    * The candidates are independent, so they are scored on all cores at
+    * once, each with buffers of its own; then the best is chosen in the
+    * same order as before, so the guess does not depend on the threads.
+    */
+
+   struct Candidate {
+      unsigned prec;
+      int endian;
+      size_t offset;
+      unsigned finiteVotes;
+      unsigned maxminVotes;
+      float smoothAvg;
+   };
+   std::vector<Candidate> candidates;
+   for(unsigned int prec = 0; prec < 2; prec++)
+      for(int endian = 0; endian < 2; endian++)
+         for(size_t offset = 0; offset < (4 * prec + 4); offset++)
+            candidates.push_back({ prec, endian, offset, 0, 0, 0 });
+
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   MixerPool pool{ unsigned(std::min<size_t>(nThreads, candidates.size()) - 1) };
+   pool.Run(candidates.size(), [&](size_t index) {
+      auto &candidate = candidates[index];
+      ArrayOf<float> cdata1{ dataSize + 4 };
+      ArrayOf<float> cdata2{ dataSize + 4 };
+      size_t clen1, clen2;
+
+      for(unsigned test = 0; test < numTests; test++) {
+         float min, max;
+
+         ExtractFloats(candidate.prec == 1, candidate.endian == 1,
+                       true, /* stereo */
+                       candidate.offset,
+                       rawData[test].get(), dataSize,
+                       cdata1.get(), cdata2.get(), &clen1, &clen2);
+
+         // One pass tests for NaNs, wanting all data finite, and finds the
+         // range of both channels
+         bool finite = true;
+         min = max = cdata1[0];
+         for(size_t i = 0; i < clen1; i++) {
+            const float x1 = cdata1[i], x2 = cdata2[i];
+            finite = finite && (x1>=0 || x1<=0) && (x2>=0 || x2<=0);
+            if (i > 0) {
+               min = std::min(min, std::min(x1, x2));
+               max = std::max(max, std::max(x1, x2));
             }
+         }
+         if (finite)
+            candidate.finiteVotes++;
 
-            smoothAvg /= numTests;
+         if (min < -0.01 && min >= -100000 &&
+             max > 0.01 && max <= 100000)
+            candidate.maxminVotes++;
 
-           #if RAW_GUESS_DEBUG
-            wxFprintf(af, "finite: %ud/%ud maxmin: %ud/%ud smooth: %f\n",
-                    finiteVotes, numTests, maxminVotes, numTests,
-                    smoothAvg);
-           #endif
+         candidate.smoothAvg += SecondDStat(cdata1.get(), clen1) / max;
+      }
 
-            if (finiteVotes > numTests/2 &&
-                finiteVotes > numTests-2 &&
-                maxminVotes > numTests/2 &&
-                smoothAvg < bestSmoothAvg) {
+      candidate.smoothAvg /= numTests;
+   });
 
-               bestSmoothAvg = smoothAvg;
-               bestOffset = offset;
-               bestPrec = prec;
-               bestEndian = endian;
-            }
-         }
+   for (const auto &candidate : candidates) {
+     #if RAW_GUESS_DEBUG
+      wxFprintf(af, "prec=%d endian=%d offset=%d\n",
+              candidate.prec, candidate.endian, (int)candidate.offset);
+      wxFprintf(af, "finite: %ud/%ud maxmin: %ud/%ud smooth: %f\n",
+              candidate.finiteVotes, numTests, candidate.maxminVotes, numTests,
+              candidate.smoothAvg);
+     #endif
+
+      if (candidate.finiteVotes > numTests/2 &&
+          candidate.finiteVotes > numTests-2 &&
+          candidate.maxminVotes > numTests/2 &&
+          candidate.smoothAvg < bestSmoothAvg) {
+
+         bestSmoothAvg = candidate.smoothAvg;
+         bestOffset = candidate.offset;
+         bestPrec = candidate.prec;
+         bestEndian = candidate.endian;
       }
    }
 
@@ -23,6 +23,7 @@ updating the ODPCMAliasBlockFile and the GUI of the newly available data.
 #include "../blockfile/ODPCMAliasBlockFile.h"
 #include "../Sequence.h"
 #include "../WaveTrack.h"
+#include <algorithm>
 #include <wx/wx.h>
 
 //36 blockfiles > 3 minutes stereo 44.1kHz per ODTask::DoSome
@@ -54,7 +55,8 @@ void ODComputeSummaryTask::Terminate()
    mBlockFilesMutex.Unlock();
 }
 
-///Computes and writes the data for one BlockFile if it still has a refcount.
+///Computes and writes the data for the next BlockFile if it still has a refcount,
+///and for the queued blocks that follow it in its aliased file.
 void ODComputeSummaryTask::DoSomeInternal()
 {
    if(mBlockFiles.size()<=0)
@@ -74,11 +76,17 @@ void ODComputeSummaryTask::DoSomeInternal()
       sampleCount blockStartSample = 0;
       sampleCount blockEndSample = 0;
 
+      std::vector< std::shared_ptr< ODPCMAliasBlockFile > > batch;
       if(bf)
       {
          // WriteSummary might throw, but this is a worker thread, so stop
          // the exceptions here!
-         success = GuardedCall<bool>( [&] {
+         batch = GatherBatch(bf);
+         if(batch.size() > 1)
+            //quietly: a block that fails again alone reports the error
+            GuardedCall( [&] { ODPCMAliasBlockFile::DoWriteSummaries(batch); },
+               MakeSimpleGuard(), [](AudacityException *){} );
+         success = bf->IsSummaryAvailable() || GuardedCall<bool>( [&] {
             bf->DoWriteSummary();
             return true;
          } );
@@ -98,11 +106,32 @@ void ODComputeSummaryTask::DoSomeInternal()
       {
          //take it out of the array - we are done with it.
          mBlockFiles.erase(mBlockFiles.begin());
+         if (bf)
+            AddWorkDone(1, bf->GetLength());
       }
       else
          // The task does not make progress
          ;
 
+      //and the rest of the batch that got its summaries
+      for(size_t j = 1; j < batch.size(); j++)
+      {
+         if(!batch[j]->IsSummaryAvailable())
+            continue;
+         const auto start = batch[j]->GetStart();
+         if(start < blockStartSample)
+            blockStartSample = start;
+         if(start + batch[j]->GetLength() > blockEndSample)
+            blockEndSample = start + batch[j]->GetLength();
+         const auto found = std::find_if(mBlockFiles.begin(), mBlockFiles.end(),
+            [&](const std::weak_ptr< ODPCMAliasBlockFile > &p)
+               { return p.lock() == batch[j]; });
+         if(found != mBlockFiles.end())
+            mBlockFiles.erase(found);
+         AddWorkDone(1, batch[j]->GetLength());
+      }
+      batch.clear();
+
       //This is a bit of a convenience in case someone tries to terminate the task by closing the trackpanel or window.
       //ODComputeSummaryTask::Terminate() uses this lock to remove everything, and we don't want it to wait since the UI is being blocked.
       mBlockFilesMutex.Unlock();
@@ -129,6 +158,38 @@ void ODComputeSummaryTask::DoSomeInternal()
    CalculatePercentComplete();
 }
 
+///Gathers the queued blocks of the aliased file of head that cover one
+///range of it from where head starts, the other channels too, so
+///that DoWriteSummaries can read them together.  head comes first.
+std::vector< std::shared_ptr< ODPCMAliasBlockFile > >
+ODComputeSummaryTask::GatherBatch(const std::shared_ptr< ODPCMAliasBlockFile > &head)
+{
+   std::vector< std::shared_ptr< ODPCMAliasBlockFile > > batch;
+   const auto &fileName = head->GetAliasedFileName();
+   const auto start = head->GetAliasStart();
+   for(size_t i = 1; i < mBlockFiles.size(); i++)
+   {
+      auto ptr = mBlockFiles[i].lock();
+      if(ptr && ptr->GetAliasStart() >= start &&
+         ptr->GetAliasStart() < start + kMaxBatchFrames &&
+         ptr->GetAliasedFileName() == fileName)
+         batch.push_back(std::move(ptr));
+   }
+   std::stable_sort(batch.begin(), batch.end(),
+      [](const std::shared_ptr< ODPCMAliasBlockFile > &a,
+         const std::shared_ptr< ODPCMAliasBlockFile > &b)
+         { return a->GetAliasStart() < b->GetAliasStart(); });
+
+   //keep the blocks up to the first gap
+   auto end = start + head->GetLength();
+   size_t kept = 0;
+   for(; kept < batch.size() && batch[kept]->GetAliasStart() <= end; kept++)
+      end = std::max(end, batch[kept]->GetAliasStart() + batch[kept]->GetLength());
+   batch.resize(kept);
+   batch.insert(batch.begin(), head);
+   return batch;
+}
+
 ///compute the next time we should take a break in terms of overall percentage.
 ///We want to do a constant number of blockfiles.
 float ODComputeSummaryTask::ComputeNextWorkUntilPercentageComplete()
@@ -178,13 +239,17 @@ void ODComputeSummaryTask::Update()
 {
    std::vector< std::weak_ptr< ODPCMAliasBlockFile > > tempBlocks;
 
+   //the first time, take up the summaries that an earlier session finished,
+   //so only the remaining work is queued
+   const bool firstUpdate = !HasUpdateRan();
+
    mWaveTrackMutex.Lock();
 
    for(size_t j=0;j<mWaveTracks.size();j++)
    {
       if(mWaveTracks[j])
       {
-         BlockArray *blocks;
+         const BlockArray *blocks;
          Sequence *seq;
 
          //gather all the blockfiles that we should process in the wavetrack.
@@ -198,7 +263,8 @@ void ODComputeSummaryTask::Update()
             //We don't need the mBlockFilesMutex here because it is only for the vector list.
             //These are existing blocks, and its wavetrack or blockfiles won't be deleted because
             //of the respective mWaveTrackMutex lock and LockDeleteUpdateMutex() call.
-            blocks = clip->GetSequenceBlockArray();
+            // Read through a const clip, not to unshare its blocks
+            blocks = static_cast<const WaveClip*>(clip)->GetSequenceBlockArray();
             int i;
             int insertCursor;
 
@@ -207,7 +273,7 @@ void ODComputeSummaryTask::Update()
             for(i=0; i<(int)blocks->size(); i++)
             {
                //if there is data but no summary, this blockfile needs summarizing.
-               SeqBlock &block = (*blocks)[i];
+               const SeqBlock &block = (*blocks)[i];
                const auto &file = block.f;
                if(file->IsDataAvailable() && !file->IsSummaryAvailable())
                {
@@ -218,6 +284,13 @@ void ODComputeSummaryTask::Update()
                      clip->GetStartTime()*clip->GetRate()
                   ));
 
+                  if(firstUpdate && odpcmaFile->ReadExistingSummary())
+                  {
+                     mWaveTracks[j]->AddInvalidRegion(block.start,
+                        block.start + odpcmaFile->GetLength());
+                     continue;
+                  }
+
                   //these will always be linear within a sequence-lets take advantage of this by keeping a cursor.
                   {
                      std::shared_ptr< ODPCMAliasBlockFile > ptr;
@@ -251,45 +324,26 @@ void ODComputeSummaryTask::OrderBlockFiles
    (std::vector< std::weak_ptr< ODPCMAliasBlockFile > > &unorderedBlocks)
 {
    mBlockFiles.clear();
-   //Order the blockfiles into our queue in a fancy convenient way.  (this could be user-prefs)
-   //for now just put them in linear.  We start the order from the first block that includes the ondemand sample
-   //(which the user sets by clicking.)
-   //Note that this code assumes that the array is sorted in time.
-
-   //find the startpoint
-   auto processStartSample = GetDemandSample();
-   std::shared_ptr< ODPCMAliasBlockFile > firstBlock;
-   for(auto i = unorderedBlocks.size(); i--;)
+   //Order the blockfiles into our queue by how soon the user will want them:  first those in view, then
+   //the ones nearest the view, the playhead and the sample the user clicked, ahead of each before behind.
+   //Ties go left to right.  Note that this code assumes that the array is sorted in time.
+   const auto focus = GetFocus();
+   std::vector< std::pair< long long, size_t > > order;
+   for(size_t i = 0; i < unorderedBlocks.size(); i++)
    {
       auto ptr = unorderedBlocks[i].lock();
       if(ptr)
-      {
-         //test if the blockfiles are near the task cursor.  we use the last mBlockFiles[0] as our point of reference
-         //and add ones that are closer.
-         if(firstBlock &&
-            ptr->GetGlobalEnd() >= processStartSample &&
-                ( firstBlock->GetGlobalEnd() < processStartSample ||
-                  ptr->GetGlobalStart() <= firstBlock->GetGlobalStart())
-            )
-         {
-            //insert at the front of the list if we get blockfiles that are after the demand sample
-            firstBlock = ptr;
-            mBlockFiles.insert(mBlockFiles.begin(), unorderedBlocks[i]);
-         }
-         else
-         {
-            //otherwise no priority
-            if ( !firstBlock )
-               firstBlock = ptr;
-            mBlockFiles.push_back(unorderedBlocks[i]);
-         }
-         if(mMaxBlockFiles< (int) mBlockFiles.size())
-            mMaxBlockFiles = mBlockFiles.size();
-      }
+         order.push_back({ focus.Distance(ptr->GetGlobalStart(), ptr->GetGlobalEnd()), i });
       else
       {
          // The block file disappeared.
          // Let it be deleted and forget about it.
       }
    }
+   std::sort(order.begin(), order.end());
+
+   for(const auto &entry : order)
+      mBlockFiles.push_back(unorderedBlocks[entry.second]);
+   if(mMaxBlockFiles< (int) mBlockFiles.size())
+      mMaxBlockFiles = mBlockFiles.size();
 }
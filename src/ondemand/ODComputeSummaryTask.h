@@ -56,13 +56,22 @@ protected:
    ///recalculates the percentage complete.
    void CalculatePercentComplete() override;
 
-   ///Computes and writes the data for one BlockFile if it still has a refcount.
+   ///Computes and writes the data for the next BlockFile if it still has a refcount,
+   ///and for the queued blocks that follow it in its aliased file.
    void DoSomeInternal() override;
 
    ///Readjusts the blockfile order in the default manner.  If we have had an ODRequest
    ///Then it updates in the OD manner.
    void Update() override;
 
+   ///Blocks to read with head in one pass over its aliased file, head first.
+   std::vector< std::shared_ptr< ODPCMAliasBlockFile > >
+      GatherBatch(const std::shared_ptr< ODPCMAliasBlockFile > &head);
+
+   ///Frames of an aliased file, from the start of the first block, that
+   ///one batch may cover.
+   static const size_t kMaxBatchFrames = 1 << 20;
+
    ///Orders the input as either On-Demand or default layered order.
    void OrderBlockFiles
       (std::vector< std::weak_ptr< ODPCMAliasBlockFile > > &unorderedBlocks);
@@ -0,0 +1,127 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODCopyInTask.cpp
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+******************************************************************//**
+
+\class ODCopyInTask
+\brief Copies the samples of the ODPCMAliasBlockFiles of an import into
+blocks of the project, so the project no longer needs the imported file.
+
+*//*******************************************************************/
+
+#include "ODCopyInTask.h"
+#include "../AudacityException.h"
+#include "../blockfile/ODPCMAliasBlockFile.h"
+#include "../Sequence.h"
+#include "../WaveTrack.h"
+#include <wx/wx.h>
+
+///Creates a NEW task that copies in the blocks of a wavetrack that needs to be specified through AddWaveTrack()
+ODCopyInTask::ODCopyInTask()
+{
+   mMaxBlockFiles = 0;
+   mHasUpdateRan = false;
+}
+
+movable_ptr<ODTask> ODCopyInTask::Clone() const
+{
+   auto clone = make_movable<ODCopyInTask>();
+   clone->mDemandSample = GetDemandSample();
+   // This std::move is needed to "upcast" the pointer type
+   return std::move(clone);
+}
+
+///releases memory that the ODTask owns.  Subclasses should override.
+void ODCopyInTask::Terminate()
+{
+   ODLocker locker{ &mBlockFilesMutex };
+   mBlockFiles.clear();
+}
+
+void ODCopyInTask::DoSomeInternal()
+{
+   Item item;
+   {
+      ODLocker locker{ &mBlockFilesMutex };
+      if (mBlockFiles.empty()) {
+         mPercentCompleteMutex.Lock();
+         mPercentComplete = 1.0;
+         mPercentCompleteMutex.Unlock();
+         return;
+      }
+      item = mBlockFiles.front();
+      mBlockFiles.erase(mBlockFiles.begin());
+   }
+
+   // Copy without the lock, so that Terminate() does not wait on the disk
+   if (const auto bf = item.file.lock()) {
+      // DoCopyIn might throw, but this is a worker thread, so stop the
+      // exceptions here!  A block that can't be read, as when its aliased
+      // file is missing, stays an alias, and that is reported where it is
+      // read.
+      GuardedCall( [&] { bf->DoCopyIn(*item.dirManager, item.format); },
+         MakeSimpleGuard(), [](AudacityException *){} );
+      AddWorkDone(1, bf->GetLength());
+   }
+   else {
+      // The block file disappeared, so there is less work to do.
+      ODLocker locker{ &mBlockFilesMutex };
+      mMaxBlockFiles--;
+   }
+
+   //update percentage complete.
+   CalculatePercentComplete();
+}
+
+void ODCopyInTask::CalculatePercentComplete()
+{
+   size_t remaining;
+   {
+      ODLocker locker{ &mBlockFilesMutex };
+      remaining = mBlockFiles.size();
+   }
+   mPercentCompleteMutex.Lock();
+   if (mHasUpdateRan)
+      mPercentComplete = (float) 1.0 - ((float)remaining / (mMaxBlockFiles+1));
+   else
+      mPercentComplete = 0.0;
+   mPercentCompleteMutex.Unlock();
+}
+
+void ODCopyInTask::Update()
+{
+   std::vector< Item > tempBlocks;
+
+   mWaveTrackMutex.Lock();
+   for (const auto track : mWaveTracks) {
+      if (!track)
+         continue;
+      for (const auto &clip : track->GetAllClips()) {
+         const auto seq = clip->GetSequence();
+         //See Sequence::Delete() for why need this for now..
+         Sequence::DeleteUpdateMutexLocker locker(*seq);
+         for (const auto &block : *clip->GetSequenceBlockArray()) {
+            const auto &file = block.f;
+            if (file->CanCopyIn())
+               tempBlocks.push_back({
+                  std::static_pointer_cast<ODPCMAliasBlockFile>(file),
+                  track->GetDirManager(),
+                  track->GetSampleFormat()
+               });
+         }
+      }
+   }
+   mWaveTrackMutex.Unlock();
+
+   ODLocker locker{ &mBlockFilesMutex };
+   mBlockFiles.swap(tempBlocks);
+   if (mMaxBlockFiles < (int) mBlockFiles.size())
+      mMaxBlockFiles = mBlockFiles.size();
+   mHasUpdateRan = true;
+}
@@ -0,0 +1,82 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODCopyInTask.h
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+******************************************************************//**
+
+\class ODCopyInTask
+\brief Copies the samples of the ODPCMAliasBlockFiles of an import into
+blocks of the project, so the project no longer needs the imported file.
+
+A copy import of a long uncompressed file is made of alias blocks, as an
+edit import is, so the project is usable at once.  This task then runs
+after the summaries, as the last task of the track, and each block turns
+self-contained when its copy is written; see ODPCMAliasBlockFile::DoCopyIn().
+
+*//*******************************************************************/
+
+#ifndef __AUDACITY_ODCopyInTask__
+#define __AUDACITY_ODCopyInTask__
+
+#include <vector>
+#include "ODTask.h"
+#include "ODTaskThread.h"
+#include "../SampleFormat.h"
+class DirManager;
+class ODPCMAliasBlockFile;
+class WaveTrack;
+
+/// A class representing a modular task to be used with the On-Demand structures.
+class ODCopyInTask final : public ODTask
+{
+ public:
+
+   // Constructor / Destructor
+
+   /// Constructs an ODTask
+   ODCopyInTask();
+   virtual ~ODCopyInTask(){};
+
+   movable_ptr<ODTask> Clone() const override;
+
+   ///Subclasses should override to return respective type.
+   unsigned int GetODType() override { return eODPCMCopyIn; }
+
+   ///Return the task name
+   const char* GetTaskName() override { return "ODCopyInTask"; }
+
+   const wxChar* GetTip() override { return _("Copying imported audio into the project"); }
+
+   ///releases memory that the ODTask owns.  Subclasses should override.
+   void Terminate() override;
+
+protected:
+   ///recalculates the percentage complete.
+   void CalculatePercentComplete() override;
+
+   ///Copies in the next BlockFile if it still has a refcount
+   void DoSomeInternal() override;
+
+   ///Gathers the blocks of the tracks that are not copied in yet, in the
+   ///order of the tracks
+   void Update() override;
+
+   struct Item {
+      std::weak_ptr< ODPCMAliasBlockFile > file;
+      std::shared_ptr< DirManager > dirManager;
+      sampleFormat format;
+   };
+
+   //mBlockFiles is touched on several threads- the OD terminate thread, and the task thread, so we need to mutex it.
+   ODLock  mBlockFilesMutex;
+   std::vector< Item > mBlockFiles;
+   int mMaxBlockFiles;
+   bool mHasUpdateRan;
+};
+
+#endif
@@ -15,6 +15,8 @@
 #include <wx/utils.h>
 #include <wx/file.h>
 #include <wx/ffile.h>
+#include <wx/thread.h>
+#include <algorithm>
 
 #define FLAC_HEADER "fLaC"
 
@@ -103,54 +105,44 @@ void ODFLACFile::error_callback(FLAC__StreamDecoderErrorStatus status)
 }
 
 
+void ODFLACFile::Store(const FLAC__int32 *samples, size_t len)
+{
+   //the decodeBuffer was allocated in the native format of the flac, but libflac gives
+   //every sample as a 32 bit int, so narrow each one as ImportFLAC does.
+   const auto format = mDecoder->mFormat;
+   if (format == int16Sample) {
+      auto dst = (short *)mDecodeBuffer + mDecodeBufferWritePosition;
+      for (size_t i = 0; i < len; i++)
+         dst[i] = samples[i];
+   }
+   else if (format == int24Sample) {
+      auto dst = (int *)mDecodeBuffer + mDecodeBufferWritePosition;
+      std::copy(samples, samples + len, dst);
+   }
+   else {
+      auto dst = (float *)mDecodeBuffer + mDecodeBufferWritePosition;
+      const float scale = 1.0f / (1u << (mDecoder->mBitsPerSample - 1));
+      for (size_t i = 0; i < len; i++)
+         dst[i] = samples[i] * scale;
+   }
+   mDecodeBufferWritePosition += len;
+}
+
 //the inside of the read loop.
 FLAC__StreamDecoderWriteStatus ODFLACFile::write_callback(const FLAC__Frame *frame,
                        const FLAC__int32 * const buffer[])
 {
+   const size_t blocksize = frame->header.blocksize;
+   const size_t samplesToCopy =
+      std::min(blocksize, mDecodeBufferLen - mDecodeBufferWritePosition);
 
-   unsigned int bytesToCopy = frame->header.blocksize;
-   if(bytesToCopy>mDecoder->mDecodeBufferLen-mDecoder->mDecodeBufferWritePosition)
-      bytesToCopy=mDecoder->mDecodeBufferLen-mDecoder->mDecodeBufferWritePosition;
-
-   //the decodeBuffer was allocated to be the same format as the flac buffer, so we can do a straight up memcpy.
-   memcpy(mDecoder->mDecodeBuffer+SAMPLE_SIZE(mDecoder->mFormat)*mDecoder->mDecodeBufferWritePosition,buffer[mDecoder->mTargetChannel],SAMPLE_SIZE(mDecoder->mFormat) * bytesToCopy);
+   const FLAC__int32 *samples = buffer[mTargetChannel];
+   Store(samples, samplesToCopy);
 
-   mDecoder->mDecodeBufferWritePosition+=bytesToCopy;
-/*
-   ArrayOf<short> tmp{ frame->header.blocksize };
-
-   for (unsigned int chn=0; chn<mDecoder->mNumChannels; chn++) {
-      if (frame->header.bits_per_sample == 16) {
-         for (unsigned int s=0; s<frame->header.blocksize; s++) {
-            tmp[s]=buffer[chn][s];
-         }
-
-         mDecoder->mChannels[chn]->Append((samplePtr)tmp.get(),
-                  int16Sample,
-                  frame->header.blocksize);
-      }
-      else {
-         mDecoder->mChannels[chn]->Append((samplePtr)buffer[chn],
-                  int24Sample,
-                  frame->header.blocksize);
-      }
-   }
-*/
-
-   mDecoder->mSamplesDone += frame->header.blocksize;
+   //keep what the buffer has no room for; the next block of the channel begins with it.
+   mCarry.assign(samples + samplesToCopy, samples + blocksize);
 
    return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
-//   return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
-
-//   mDecoder->mUpdateResult = mDecoder->mProgress->Update((wxULongLong_t) mDecoder->mSamplesDone, mDecoder->mNumSamples != 0 ? (wxULongLong_t)mDecoder->mNumSamples : 1);
-/*
-   if (mDecoder->mUpdateResult != ProgressResult::Success)
-   {
-      return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
-   }
-
-   return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
-   */
 }
 
 
@@ -164,49 +156,118 @@ FLAC__StreamDecoderWriteStatus ODFLACFile::write_callback(const FLAC__Frame *fra
    ///the file object if it needs to.
 int ODFlacDecoder::Decode(SampleBuffer & data, sampleFormat & format, sampleCount start, size_t len, unsigned int channel)
 {
-
-   //we need to lock this so the target stays fixed over the seek/write callback.
-   mFlacFileLock.Lock();
-
-   bool usingCache=mLastDecodeStartSample==start;
-   if(usingCache)
-   {
-      //we've just decoded this, so lets use a cache.  (often so for
-   }
-
-
-   mDecodeBufferWritePosition=0;
-   mDecodeBufferLen = len;
+   ODFLACFile *file = AcquireFile(start, channel);
+   if (!file)
+      return -1;
 
    data.Allocate(len, mFormat);
-   mDecodeBuffer = data.ptr();
    format = mFormat;
 
-   mTargetChannel=channel;
+   file->mDecodeBufferWritePosition = 0;
+   file->mDecodeBufferLen = len;
+   file->mDecodeBuffer = data.ptr();
+
+   bool seek = true;
+   if (file->mNextSample == start && file->mTargetChannel == channel) {
+      //the previous decode ended here; start from the rest of its frame.
+      const size_t carried = std::min(len, file->mCarry.size());
+      file->Store(file->mCarry.data(), carried);
+      file->mCarry.erase(file->mCarry.begin(), file->mCarry.begin() + carried);
+      seek = false;
+   }
+   file->mTargetChannel = channel;
+   file->mNextSample = -1;
 
    // Third party library has its own type alias, check it
    static_assert(sizeof(sampleCount::type) <=
                  sizeof(FLAC__int64),
                  "Type FLAC__int64 is too narrow to hold a sampleCount");
-   if(!mFile->seek_absolute(static_cast<FLAC__int64>( start.as_long_long() )))
+   //libflac uses the seek table, if the file has one, and the seek decodes the first frame.
+   if(seek && !file->seek_absolute(static_cast<FLAC__int64>( start.as_long_long() )))
    {
-      mFlacFileLock.Unlock();
+      file->mCarry.clear();
+      ReleaseFile(file);
       return -1;
    }
 
-   while(mDecodeBufferWritePosition<mDecodeBufferLen)
-      mFile->process_single();
+   while(file->mDecodeBufferWritePosition < file->mDecodeBufferLen) {
+      if(!file->process_single() ||
+         file->get_state() == FLAC__STREAM_DECODER_END_OF_STREAM)
+         break;
+   }
 
-   mFlacFileLock.Unlock();
-   if(!usingCache)
-   {
-      mLastDecodeStartSample=start;
+   const bool complete = file->mDecodeBufferWritePosition == file->mDecodeBufferLen;
+   if (complete)
+      file->mNextSample = start + len;
+   else {
+      file->mCarry.clear();
+      ClearSamples(data.ptr(), mFormat, file->mDecodeBufferWritePosition,
+                   len - file->mDecodeBufferWritePosition);
    }
+   file->mDecodeBuffer = nullptr;
+   ReleaseFile(file);
+
    //insert into blockfile and
    //calculate summary happen in ODDecodeBlockFile::WriteODDecodeBlockFile, where this method is also called.
    return 1;
 }
 
+ODFLACFile *ODFlacDecoder::AcquireFile(sampleCount start, unsigned int channel)
+{
+   ODLocker locker{ &mFilesLock };
+   while (true) {
+      ODFLACFile *idle = nullptr;
+      for (const auto &file : mFiles) {
+         if (file->mLock.TryLock() != 0)
+            continue;
+         if (file->mNextSample == start && file->mTargetChannel == channel) {
+            //this one just decoded the block before; it needs no seek.
+            if (idle)
+               idle->mLock.Unlock();
+            return file.get();
+         }
+         if (idle)
+            file->mLock.Unlock();
+         else
+            idle = file.get();
+      }
+
+      if (mFiles.size() < mMaxFiles) {
+         //rather than take an idle decoder from its range, open another while
+         //there are cores to run it.  Opening reads the header, so unlock meanwhile.
+         if (idle)
+            idle->mLock.Unlock();
+         locker.reset();
+         auto file = OpenFile(false);
+         locker.reset(&mFilesLock);
+         if (!file)
+            //make do with those already open
+            mMaxFiles = mFiles.size();
+         else if (mFiles.size() < mMaxFiles) {
+            file->mLock.Lock();
+            mFiles.push_back(std::move(file));
+            return mFiles.back().get();
+         }
+         //else another thread opened the last one meanwhile; look again
+         continue;
+      }
+
+      if (idle)
+         return idle;
+
+      if (mFiles.empty())
+         return nullptr;
+      mFileReleased.Wait();
+   }
+}
+
+void ODFlacDecoder::ReleaseFile(ODFLACFile *file)
+{
+   ODLocker locker{ &mFilesLock };
+   file->mLock.Unlock();
+   mFileReleased.Signal();
+}
+
 ///Read header.  Subclasses must override.  Probably should save the info somewhere.
 ///Ideally called once per decoding of a file.  This complicates the task because
 ///returns true if the file exists and the header was read alright.
@@ -219,11 +280,32 @@ bool ODFlacDecoder::ReadHeader()
                          //we want to use the native flac type for quick conversion.
       /* (sampleFormat)
       gPrefs->Read(wxT("/SamplingRate/DefaultProjectSampleFormat"), floatSample);*/
-   mFile = std::make_unique<ODFLACFile>(this);
+   mStreamInfoDone = false;
 
-
-   if (!mHandle.Open(mFName, wxT("rb"))) {
+   auto file = OpenFile(true);
+   if (!file || !mStreamInfoDone)
       return false;
+
+   {
+      ODLocker locker{ &mFilesLock };
+      mFiles.clear();
+      mFiles.push_back(std::move(file));
+      //each concurrent decode of the file takes a decoder of its own
+      mMaxFiles = std::max(1, wxThread::GetCPUCount());
+   }
+
+   MarkInitialized();
+   return true;
+
+}
+
+std::unique_ptr<ODFLACFile> ODFlacDecoder::OpenFile(bool readMetadata)
+{
+   auto file = std::make_unique<ODFLACFile>(this, readMetadata);
+
+   wxFFile handle;
+   if (!handle.Open(mFName, wxT("rb"))) {
+      return {};
    }
 
    // Even though there is an init() method that takes a filename, use the one that
@@ -231,39 +313,38 @@ bool ODFlacDecoder::ReadHeader()
    // libflac can't (under Windows).
    //
    // Responsibility for closing the file is passed to libflac.
-   // (it happens when mFile->finish() is called)
-   bool result = mFile->init(mHandle.fp())?true:false;
-   mHandle.Detach();
+   // (it happens when file->finish() is called)
+   const auto result = file->init(handle.fp());
+   handle.Detach();
 
    if (result != FLAC__STREAM_DECODER_INIT_STATUS_OK) {
-      return false;
+      return {};
    }
 
-   //this will call the metadata_callback when it is done
-   mFile->process_until_end_of_metadata();
+   //this will call the metadata_callback when it is done.
+   //libflac keeps the seek table for seek_absolute() even when ignoring the metadata.
+   file->process_until_end_of_metadata();
    // not necessary to check state, error callback will catch errors, but here's how:
-   if (mFile->get_state() > FLAC__STREAM_DECODER_READ_FRAME) {
-      return false;
+   if (file->get_state() > FLAC__STREAM_DECODER_READ_FRAME) {
+      return {};
    }
 
-   if (!mFile->is_valid() || mFile->get_was_error()) {
+   if (!file->is_valid() || file->get_was_error()) {
       // This probably is not a FLAC file at all
-      return false;
+      return {};
    }
 
-   MarkInitialized();
-   return true;
-
+   return file;
 }
 
 ODFLACFile* ODFlacDecoder::GetFlacFile()
 {
-   return mFile.get();
+   return mFiles.empty() ? nullptr : mFiles.front().get();
 }
 
 ODFlacDecoder::~ODFlacDecoder(){
-   if(mFile)
-      mFile->finish();
+   for (const auto &file : mFiles)
+      file->finish();
 }
 
 ///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
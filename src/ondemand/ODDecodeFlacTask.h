@@ -61,15 +61,21 @@ class ODDecodeFlacTask final : public ODDecodeTask
 };
 
 
+///One libflac decoder open on the file.  ODFlacDecoder opens several, so that
+///blocks from different parts of one file decode on different threads.
 class ODFLACFile final : public FLAC::Decoder::File
 {
  public:
-   ODFLACFile(ODFlacDecoder *decoder) : mDecoder(decoder)
+   ///@param readMetadata false for the decoders after the first, whose
+   ///metadata must not write the fields of ODFlacDecoder again while others decode
+   ODFLACFile(ODFlacDecoder *decoder, bool readMetadata = true) : mDecoder(decoder)
    {
       mWasError = false;
       set_metadata_ignore_all();
-      set_metadata_respond(FLAC__METADATA_TYPE_VORBIS_COMMENT);
-      set_metadata_respond(FLAC__METADATA_TYPE_STREAMINFO);
+      if (readMetadata) {
+         set_metadata_respond(FLAC__METADATA_TYPE_VORBIS_COMMENT);
+         set_metadata_respond(FLAC__METADATA_TYPE_STREAMINFO);
+      }
    }
 
    bool get_was_error() const
@@ -82,6 +88,22 @@ class ODFLACFile final : public FLAC::Decoder::File
    bool                  mWasError;
    wxArrayString         mComments;
 
+   //converts samples of the target channel into the decode buffer
+   void Store(const FLAC__int32 *samples, size_t len);
+
+   ///held for the whole of one Decode(), so the target stays fixed over the seek/write callback.
+   ODLock                mLock;
+   //the decode in progress
+   unsigned int          mTargetChannel { 0 };
+   size_t                mDecodeBufferWritePosition { 0 };
+   size_t                mDecodeBufferLen { 0 };
+   samplePtr             mDecodeBuffer { nullptr };
+   //the rest of the frame the last decode stopped in, for its channel.  A decode of that
+   //channel from mNextSample continues from here without a seek, so each decoder
+   //runs through its own range of consecutive blocks.
+   std::vector<FLAC__int32> mCarry;
+   sampleCount           mNextSample { -1 };
+
  protected:
    FLAC__StreamDecoderWriteStatus write_callback(const FLAC__Frame *frame,
                                                          const FLAC__int32 * const buffer[]) override;
@@ -96,7 +118,7 @@ class ODFlacDecoder final : public ODFileDecoder
    friend class ODFLACFile;
 public:
    ///This should handle unicode converted to UTF-8 on mac/linux, but OD TODO:check on windows
-   ODFlacDecoder(const wxString & fileName):ODFileDecoder(fileName),mSamplesDone(0){mFile=NULL;}
+   ODFlacDecoder(const wxString & fileName):ODFileDecoder(fileName){}
    virtual ~ODFlacDecoder();
 
    ///Decodes the samples for this blockfile from the real file into a float buffer.
@@ -106,6 +128,7 @@ public:
    ///this->ReadData(sampleData, floatSample, 0, mLen);
    ///This class should call ReadHeader() first, so it knows the length, and can prepare
    ///the file object if it needs to.
+   ///Thread-safe; concurrent calls decode at once, each with its own ODFLACFile.
    int Decode(SampleBuffer & data, sampleFormat & format, sampleCount start, size_t len, unsigned int channel) override;
 
 
@@ -113,28 +136,29 @@ public:
    ///Ideally called once per decoding of a file.  This complicates the task because
    bool ReadHeader() override;
 
-   ///FLAC specific file (inherited from FLAC::Decoder::File)
+   ///FLAC specific file (inherited from FLAC::Decoder::File), the one that read the header
    ODFLACFile* GetFlacFile();
 
 private:
    friend class FLACImportFileHandle;
+
+   //opens another libflac decoder on the file; null on failure
+   std::unique_ptr<ODFLACFile> OpenFile(bool readMetadata);
+   //returns a decoder locked for this thread, preferably one that can continue
+   //from start without a seek, opening another while there are fewer than mMaxFiles
+   ODFLACFile *AcquireFile(sampleCount start, unsigned int channel);
+   void ReleaseFile(ODFLACFile *file);
+
    sampleFormat          mFormat;
-   std::unique_ptr<ODFLACFile> mFile;
-   ODLock         mFlacFileLock;//for mFile;
-   wxFFile               mHandle;
+   std::vector< std::unique_ptr<ODFLACFile> > mFiles;
+   ODLock                mFilesLock;//for mFiles, and the locking of each
+   ODCondition           mFileReleased{ &mFilesLock };
+   size_t                mMaxFiles { 1 };
    unsigned long         mSampleRate;
    unsigned long         mNumChannels;
    unsigned long         mBitsPerSample;
    FLAC__uint64          mNumSamples;
-   FLAC__uint64          mSamplesDone;
-   sampleCount          mLastDecodeStartSample;
    bool                  mStreamInfoDone;
-   int                   mUpdateResult;
-   WaveTrack           **mChannels;
-   unsigned int          mTargetChannel;
-   unsigned int         mDecodeBufferWritePosition;
-   unsigned int         mDecodeBufferLen;
-   samplePtr            mDecodeBuffer;
 };
 
 #endif
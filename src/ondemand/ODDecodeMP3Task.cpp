@@ -0,0 +1,482 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeMP3Task.cpp
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+**********************************************************************/
+
+#include "../Audacity.h"
+#include "ODDecodeMP3Task.h"
+
+#ifdef USE_LIBMAD
+
+#include <wx/file.h>
+#include <algorithm>
+#include <string.h>
+
+extern "C" {
+#include "mad.h"
+}
+
+// Reading headers, a lost sync needs only a few bytes at a time
+#define SCAN_BUFFER_SIZE 65536
+// The most bytes of earlier frames that the main data of a frame can use
+static const size_t kMaxReservoir = 511;
+
+namespace {
+
+struct MP3FrameHeader {
+   unsigned length;
+   unsigned samples;
+   unsigned rate;
+   unsigned channels;
+   int layer;
+   bool mpeg1;
+};
+
+// Parses the four bytes of a frame header, as libmad does.  Free format,
+// whose frames have no length in the header, is not indexed.
+bool ParseHeader(const unsigned char *p, MP3FrameHeader &header)
+{
+   if (p[0] != 0xFF || (p[1] & 0xE0) != 0xE0)
+      return false;
+
+   // 3 for MPEG 1, 2 for MPEG 2, 0 for MPEG 2.5
+   const int version = (p[1] >> 3) & 3;
+   const int layerBits = (p[1] >> 1) & 3;
+   const int bitrateIndex = p[2] >> 4;
+   const int rateIndex = (p[2] >> 2) & 3;
+   if (version == 1 || layerBits == 0 ||
+       bitrateIndex == 0 || bitrateIndex == 15 || rateIndex == 3)
+      return false;
+
+   // kbps, by MPEG 1 or not, then layer
+   static const unsigned short bitrates[2][3][15] = {
+      {
+         { 0, 32, 64, 96, 128, 160, 192, 224, 256, 288, 320, 352, 384, 416, 448 },
+         { 0, 32, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384 },
+         { 0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320 },
+      },
+      {
+         { 0, 32, 48, 56, 64, 80, 96, 112, 128, 144, 160, 176, 192, 224, 256 },
+         { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+         { 0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160 },
+      },
+   };
+   static const unsigned rates[3] = { 44100, 48000, 32000 };
+
+   header.mpeg1 = version == 3;
+   header.layer = 4 - layerBits;
+   header.rate = rates[rateIndex] >> (header.mpeg1 ? 0 : version == 2 ? 1 : 2);
+   header.channels = (p[3] >> 6) == 3 ? 1 : 2;
+
+   const unsigned kbps = bitrates[header.mpeg1 ? 0 : 1][header.layer - 1][bitrateIndex];
+   const unsigned padding = (p[2] >> 1) & 1;
+   if (header.layer == 1) {
+      header.length = (12000 * kbps / header.rate + padding) * 4;
+      header.samples = 384;
+   }
+   else if (header.layer == 2 || header.mpeg1) {
+      header.length = 144000 * kbps / header.rate + padding;
+      header.samples = 1152;
+   }
+   else {
+      header.length = 72000 * kbps / header.rate + padding;
+      header.samples = 576;
+   }
+   return true;
+}
+
+// Whether two headers can be frames of one stream
+bool Compatible(const MP3FrameHeader &a, const MP3FrameHeader &b)
+{
+   return a.layer == b.layer && a.mpeg1 == b.mpeg1 && a.rate == b.rate;
+}
+
+}
+
+/// Finds the frames of an mp3 file, one after another, from their headers
+class MP3FrameScanner
+{
+public:
+   struct Found {
+      wxFileOffset offset;
+      unsigned length;
+      unsigned samples;
+   };
+
+   explicit MP3FrameScanner(const wxString &fileName)
+      : mFile(fileName)
+   {
+      if (!mFile.IsOpened())
+         return;
+      mLength = mFile.Length();
+
+      // Skip an ID3v2 tag, whose bytes may look like frames
+      const unsigned char *p = Peek(0, 10);
+      if (p && p[0] == 'I' && p[1] == 'D' && p[2] == '3') {
+         mPos = 10 + ((p[6] & 0x7f) << 21 | (p[7] & 0x7f) << 14 |
+                      (p[8] & 0x7f) << 7 | (p[9] & 0x7f));
+         if (p[5] & 0x10)
+            mPos += 10; // footer
+      }
+   }
+
+   bool IsOpened() const { return mFile.IsOpened(); }
+
+   /// The first frame, before any Next()
+   bool First(MP3FrameHeader &header)
+   {
+      Found found;
+      if (!Next(found))
+         return false;
+      header = mReference;
+      mPending = true;
+      mPendingFound = found;
+      return true;
+   }
+
+   /// Finds the next frame; false at the end of the file
+   bool Next(Found &found)
+   {
+      if (mPending) {
+         mPending = false;
+         found = mPendingFound;
+         return true;
+      }
+
+      while (const unsigned char *p = Peek(mPos, 4)) {
+         MP3FrameHeader header;
+         if (ParseHeader(p, header) &&
+             mPos + header.length <= mLength &&
+             (mSynced ? Compatible(header, mReference) : Confirm(header))) {
+            if (!mSynced)
+               mReference = header;
+            mSynced = true;
+            found = { mPos, header.length, header.samples };
+            mPos += header.length;
+
+            if (mFirst) {
+               mFirst = false;
+               // A Xing or Info frame holds no audio; libmad would decode it
+               // as silence
+               if (ReadXing(found.offset, header))
+                  continue;
+            }
+            return true;
+         }
+         // Lost sync; look at the next byte
+         mSynced = false;
+         ++mPos;
+      }
+      return false;
+   }
+
+   /// The frames that the Xing or Info frame counts, or zero
+   unsigned long XingFrames() const { return mXingFrames; }
+
+private:
+   // Bytes of the file from pos, or null if there are fewer than len
+   const unsigned char *Peek(wxFileOffset pos, size_t len)
+   {
+      if (pos + (wxFileOffset)len > mLength)
+         return nullptr;
+      if (pos < mBufferStart || pos + (wxFileOffset)len > mBufferStart + (wxFileOffset)mBufferLen) {
+         if (!mBuffer)
+            mBuffer.reinit(SCAN_BUFFER_SIZE);
+         if (mFile.Seek(pos) == wxInvalidOffset)
+            return nullptr;
+         const auto read = mFile.Read(mBuffer.get(), SCAN_BUFFER_SIZE);
+         if (read == wxInvalidOffset || (size_t)read < len)
+            return nullptr;
+         mBufferStart = pos;
+         mBufferLen = read;
+      }
+      return mBuffer.get() + (pos - mBufferStart);
+   }
+
+   // After a lost sync, whether another frame follows this one
+   bool Confirm(const MP3FrameHeader &header)
+   {
+      const auto next = mPos + header.length;
+      if (next == mLength)
+         return true;
+      const unsigned char *p = Peek(next, 4);
+      MP3FrameHeader following;
+      return p && ParseHeader(p, following) && Compatible(header, following);
+   }
+
+   bool ReadXing(wxFileOffset offset, const MP3FrameHeader &header)
+   {
+      if (header.layer != 3)
+         return false;
+      // The tag follows the side information
+      const size_t side = header.mpeg1
+         ? (header.channels == 1 ? 17 : 32)
+         : (header.channels == 1 ? 9 : 17);
+      const unsigned char *p = Peek(offset + 4 + side, 12);
+      if (!p || !(memcmp(p, "Xing", 4) == 0 || memcmp(p, "Info", 4) == 0))
+         return false;
+      if (p[7] & 1)
+         mXingFrames = (unsigned long)p[8] << 24 | p[9] << 16 | p[10] << 8 | p[11];
+      return true;
+   }
+
+   wxFile mFile;
+   wxFileOffset mLength{ 0 };
+   wxFileOffset mPos{ 0 };
+   ArrayOf<unsigned char> mBuffer;
+   wxFileOffset mBufferStart{ 0 };
+   size_t mBufferLen{ 0 };
+
+   bool mSynced{ false };
+   bool mFirst{ true };
+   MP3FrameHeader mReference{};
+   unsigned long mXingFrames{ 0 };
+   bool mPending{ false };
+   Found mPendingFound{};
+};
+
+struct ODMP3Decoder::MadState {
+   MadState()
+   {
+      mad_stream_init(&stream);
+      mad_frame_init(&frame);
+      mad_synth_init(&synth);
+   }
+   ~MadState()
+   {
+      mad_synth_finish(&synth);
+      mad_frame_finish(&frame);
+      mad_stream_finish(&stream);
+   }
+   MadState(const MadState&) PROHIBITED;
+   MadState &operator= (const MadState&) PROHIBITED;
+
+   mad_stream stream;
+   mad_frame frame;
+   mad_synth synth;
+};
+
+ODDecodeMP3Task::~ODDecodeMP3Task()
+{
+}
+
+movable_ptr<ODTask> ODDecodeMP3Task::Clone() const
+{
+   auto clone = make_movable<ODDecodeMP3Task>();
+   clone->mDemandSample = GetDemandSample();
+
+   //the decoders and blockfiles should not be copied.  They are created as the task runs.
+   // This std::move is needed to "upcast" the pointer type
+   return std::move(clone);
+}
+
+///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+ODFileDecoder* ODDecodeMP3Task::CreateFileDecoder(const wxString & fileName)
+{
+   auto decoder = make_movable<ODMP3Decoder>(fileName);
+
+   mDecoders.push_back(std::move(decoder));
+   return mDecoders.back().get();
+}
+
+ODMP3Decoder::ODMP3Decoder(const wxString & fileName)
+   : ODFileDecoder(fileName)
+{
+}
+
+ODMP3Decoder::~ODMP3Decoder()
+{
+}
+
+bool ODMP3Decoder::ReadLength(const wxString &fileName,
+   sampleCount &numSamples, unsigned &numChannels, unsigned &rate)
+{
+   MP3FrameScanner scanner{ fileName };
+   MP3FrameHeader header;
+   if (!scanner.IsOpened() || !scanner.First(header))
+      return false;
+
+   numChannels = header.channels;
+   rate = header.rate;
+   if (scanner.XingFrames() > 0) {
+      numSamples = sampleCount{ scanner.XingFrames() } * header.samples;
+      return true;
+   }
+
+   numSamples = 0;
+   MP3FrameScanner::Found found;
+   while (scanner.Next(found))
+      numSamples += found.samples;
+   return true;
+}
+
+bool ODMP3Decoder::ReadHeader()
+{
+   ODLocker locker{ &mLock };
+
+   mScanner = std::make_unique<MP3FrameScanner>(mFName);
+   MP3FrameHeader header;
+   if (!mScanner->IsOpened() || !mScanner->First(header))
+      return false;
+
+   mSampleRate = header.rate;
+   mNumChannels = header.channels;
+   mFrames.clear();
+   mIndexedSamples = 0;
+   mMad = std::make_unique<MadState>();
+   mLastFrame = kNoFrame;
+   mCacheLen = 0;
+
+   MarkInitialized();
+   return true;
+}
+
+void ODMP3Decoder::IndexTo(sampleCount sample)
+{
+   MP3FrameScanner::Found found;
+   while (mScanner && mIndexedSamples <= sample) {
+      if (!mScanner->Next(found)) {
+         //the index is complete
+         mScanner.reset();
+         break;
+      }
+      mFrames.push_back({ found.offset, mIndexedSamples, found.length, found.samples });
+      mIndexedSamples += found.samples;
+   }
+}
+
+void ODMP3Decoder::DecodeFrame(size_t index)
+{
+   const auto &frame = mFrames[index];
+   auto &mad = *mMad;
+
+   //the frame, and the start of the next, which libmad reads for the size of
+   //the main data of this one
+   const auto end = frame.offset + frame.length + MAD_BUFFER_GUARD;
+   if (frame.offset < mInputStart || end > mInputEnd) {
+      //read this frame and those after it, up to a block of samples
+      auto last = index;
+      while (last + 1 < mFrames.size() &&
+             mFrames[last + 1].offset - frame.offset < SCAN_BUFFER_SIZE * 16)
+         ++last;
+      const size_t size =
+         mFrames[last].offset + mFrames[last].length + MAD_BUFFER_GUARD - frame.offset;
+      if (size > mInputSize) {
+         mInput.reinit(size);
+         mInputSize = size;
+      }
+
+      wxFile file{ mFName };
+      ssize_t read = 0;
+      if (file.IsOpened() && file.Seek(frame.offset) != wxInvalidOffset)
+         read = std::max<ssize_t>(0, file.Read(mInput.get(), size));
+      //zeroes for the guard after the last frame of the file
+      memset(mInput.get() + read, 0, size - read);
+      mInputStart = frame.offset;
+      mInputEnd = frame.offset + size;
+   }
+
+   mad_stream_buffer(&mad.stream, mInput.get() + (frame.offset - mInputStart),
+      frame.length + MAD_BUFFER_GUARD);
+   if (mad_frame_decode(&mad.frame, &mad.stream) == 0)
+      mad_synth_frame(&mad.synth, &mad.frame);
+   else {
+      //keep the samples in step with the index
+      auto &pcm = mad.synth.pcm;
+      pcm.length = frame.samples;
+      pcm.channels = mNumChannels;
+      memset(pcm.samples, 0, sizeof(pcm.samples));
+   }
+   mLastFrame = index;
+}
+
+bool ODMP3Decoder::Fill(sampleCount start, size_t len)
+{
+   const auto end = start + len;
+   IndexTo(end);
+
+   if (mCacheSize < len) {
+      mCache.reinit(size_t(mNumChannels), len);
+      mCacheSize = len;
+   }
+   for (size_t c = 0; c < mNumChannels; c++)
+      std::fill(mCache[c].get(), mCache[c].get() + len, 0.0f);
+   mCacheStart = start;
+   mCacheLen = len;
+
+   //the frame that holds start
+   auto found = std::upper_bound(mFrames.begin(), mFrames.end(), start,
+      [](sampleCount value, const Frame &frame) { return value < frame.start; });
+   if (found == mFrames.begin())
+      return !mFrames.empty();
+   size_t first = (found - mFrames.begin()) - 1;
+   if (start >= mFrames[first].start + mFrames[first].samples)
+      //after the end of the file
+      return true;
+
+   size_t index = first;
+   if (index == mLastFrame + 1 || index == mLastFrame)
+      //continue where the last block stopped
+      ;
+   else {
+      //restart libmad before the frame, so the bit reservoir is full for the
+      //frame before it, which makes the overlap
+      mMad = std::make_unique<MadState>();
+      mLastFrame = kNoFrame;
+      size_t from = index ? index - 1 : 0;
+      size_t bytes = 0;
+      while (from > 0 && bytes < kMaxReservoir)
+         bytes += mFrames[--from].length;
+      for (; from < index; from++)
+         DecodeFrame(from);
+   }
+
+   for (; index < mFrames.size() && mFrames[index].start < end; index++) {
+      if (index != mLastFrame)
+         DecodeFrame(index);
+
+      const auto &frame = mFrames[index];
+      const auto &pcm = mMad->synth.pcm;
+      const auto from = std::max(start, frame.start);
+      const auto to = std::min(end, frame.start + std::min<unsigned>(frame.samples, pcm.length));
+      for (size_t c = 0; c < mNumChannels; c++) {
+         //a mono frame in a stereo file plays in both channels
+         const auto *samples = pcm.samples[std::min<size_t>(c, pcm.channels - 1)];
+         float *out = mCache[c].get() + (from - start).as_size_t();
+         for (auto s = (from - frame.start).as_size_t(), e = (to - frame.start).as_size_t();
+              s < e; s++)
+            *out++ = (float) (samples[s] / (float) (1L << MAD_F_FRACBITS));
+      }
+   }
+   return true;
+}
+
+int ODMP3Decoder::Decode(SampleBuffer & data, sampleFormat & format, sampleCount start, size_t len, unsigned int channel)
+{
+   ODLocker locker{ &mLock };
+
+   if (!mMad || channel >= mNumChannels)
+      return -1;
+
+   //the other channels of a block usually follow at once
+   if (!(start >= mCacheStart && start + len <= mCacheStart + mCacheLen) &&
+       !Fill(start, len))
+      return -1;
+
+   data.Allocate(len, floatSample);
+   format = floatSample;
+   const float *cached = mCache[channel].get() + (start - mCacheStart).as_size_t();
+   std::copy(cached, cached + len, (float *)data.ptr());
+
+   //insert into blockfile and
+   //calculate summary happen in ODDecodeBlockFile::WriteODDecodeBlockFile, where this method is also called.
+   return 1;
+}
+
+#endif // USE_LIBMAD
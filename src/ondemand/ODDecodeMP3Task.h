@@ -0,0 +1,111 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeMP3Task.h
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+******************************************************************//**
+
+\class ODDecodeMP3Task
+\brief Decodes an mp3 file into ODDecodeBlockFiles with libmad, but not
+immediately.
+
+libmad cannot seek, so the decoder makes an index of the frames of the
+file from their headers, which takes no decoding.  A block decodes from
+the frame that holds its first sample, after enough earlier frames to
+fill the bit reservoir and the overlap, so it has the samples that a
+decode of the whole file gives.
+
+*//*******************************************************************/
+
+#ifndef __AUDACITY_ODDecodeMP3Task__
+#define __AUDACITY_ODDecodeMP3Task__
+
+#include <vector>
+#include "ODDecodeTask.h"
+#include "ODTaskThread.h"
+
+class MP3FrameScanner;
+
+/// A class representing a modular task to be used with the On-Demand structures.
+class ODDecodeMP3Task final : public ODDecodeTask
+{
+ public:
+
+   /// Constructs an ODTask
+   ODDecodeMP3Task(){}
+   virtual ~ODDecodeMP3Task();
+
+
+   movable_ptr<ODTask> Clone() const override;
+   ///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+   ODFileDecoder* CreateFileDecoder(const wxString & fileName) override;
+
+   ///Lets other classes know that this class handles mp3
+   unsigned int GetODType() override { return eODMP3; }
+};
+
+
+///class to decode a particular file (one per file).
+class ODMP3Decoder final : public ODFileDecoder
+{
+public:
+   ODMP3Decoder(const wxString & fileName);
+   virtual ~ODMP3Decoder();
+
+   ///Decodes the samples of one channel into a float buffer.  Decodes all the
+   ///channels at once, and keeps them for the other channels of the same block.
+   int Decode(SampleBuffer & data, sampleFormat & format, sampleCount start, size_t len, unsigned int channel) override;
+
+   ///Reads the first frames
+   bool ReadHeader() override;
+
+   ///The length, channels and rate of a file, for the importer to make
+   ///the blocks.  Uses the frame count of a Xing or Info header, so only
+   ///files without one are read through.  False if it has no usable frames.
+   static bool ReadLength(const wxString &fileName,
+      sampleCount &numSamples, unsigned &numChannels, unsigned &rate);
+
+private:
+   struct Frame {
+      wxFileOffset offset;
+      sampleCount start;
+      unsigned length;
+      unsigned samples;
+   };
+   struct MadState;
+
+   //indexes frames until one ends after sample, or the file ends
+   void IndexTo(sampleCount sample);
+   //decodes all the channels from start into mCache
+   bool Fill(sampleCount start, size_t len);
+   //decodes mFrames[index] into the synth; silence, if it does not decode
+   void DecodeFrame(size_t index);
+
+   ODLock mLock;//for everything below
+
+   std::unique_ptr<MP3FrameScanner> mScanner;
+   std::vector<Frame> mFrames;
+   sampleCount mIndexedSamples{ 0 };
+
+   std::unique_ptr<MadState> mMad;
+   //the frame whose samples are in the synth; kNoFrame while libmad is
+   //fresh, when decoding can start at the first frame
+   static const size_t kNoFrame = size_t(-1);
+   size_t mLastFrame{ kNoFrame };
+   //the bytes of consecutive frames, read at once
+   ArrayOf<unsigned char> mInput;
+   size_t mInputSize{ 0 };
+   wxFileOffset mInputStart{ 0 }, mInputEnd{ 0 };
+
+   //samples of all channels from mCacheStart
+   FloatBuffers mCache;
+   size_t mCacheSize{ 0 };
+   sampleCount mCacheStart{ 0 };
+   size_t mCacheLen{ 0 };
+};
+
+#endif
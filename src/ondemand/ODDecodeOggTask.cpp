@@ -0,0 +1,168 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeOggTask.cpp
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+**********************************************************************/
+
+#include "../Audacity.h"
+#include "ODDecodeOggTask.h"
+
+#ifdef USE_LIBVORBIS
+
+#include <wx/string.h>
+#include <wx/utils.h>
+/* ffile.h must be included AFTER at least one other wx header that includes
+ * wx/setup.h, as in ImportOGG.cpp */
+#include <wx/ffile.h>
+#include <algorithm>
+
+#include <vorbis/vorbisfile.h>
+
+struct ODOggDecoder::VorbisState {
+   VorbisState() {}
+   ~VorbisState()
+   {
+      if (open) {
+         ov_clear(&vorbisFile);
+         file.Detach(); // ov_clear() closed it
+      }
+   }
+   VorbisState(const VorbisState&) PROHIBITED;
+   VorbisState &operator= (const VorbisState&) PROHIBITED;
+
+   wxFFile file;
+   OggVorbis_File vorbisFile;
+   bool open{ false };
+};
+
+ODDecodeOggTask::~ODDecodeOggTask()
+{
+}
+
+movable_ptr<ODTask> ODDecodeOggTask::Clone() const
+{
+   auto clone = make_movable<ODDecodeOggTask>();
+   clone->mDemandSample = GetDemandSample();
+
+   //the decoders and blockfiles should not be copied.  They are created as the task runs.
+   // This std::move is needed to "upcast" the pointer type
+   return std::move(clone);
+}
+
+///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+ODFileDecoder* ODDecodeOggTask::CreateFileDecoder(const wxString & fileName)
+{
+   auto decoder = make_movable<ODOggDecoder>(fileName);
+
+   mDecoders.push_back(std::move(decoder));
+   return mDecoders.back().get();
+}
+
+ODOggDecoder::ODOggDecoder(const wxString & fileName)
+   : ODFileDecoder(fileName)
+{
+}
+
+ODOggDecoder::~ODOggDecoder()
+{
+}
+
+bool ODOggDecoder::ReadHeader()
+{
+   // Suppress some compiler warnings about unused global variables in the library header
+   wxUnusedVar(OV_CALLBACKS_DEFAULT);
+   wxUnusedVar(OV_CALLBACKS_NOCLOSE);
+   wxUnusedVar(OV_CALLBACKS_STREAMONLY);
+   wxUnusedVar(OV_CALLBACKS_STREAMONLY_NOCLOSE);
+
+   ODLocker locker{ &mLock };
+
+   auto vorbis = std::make_unique<VorbisState>();
+   if (!vorbis->file.Open(mFName, wxT("rb")))
+      return false;
+   if (ov_open(vorbis->file.fp(), &vorbis->vorbisFile, NULL, 0) < 0)
+      // The file is still ours to close
+      return false;
+   vorbis->open = true;
+
+   if (!ov_seekable(&vorbis->vorbisFile) || vorbis->vorbisFile.links != 1)
+      return false;
+
+   vorbis_info *vi = ov_info(&vorbis->vorbisFile, 0);
+   mSampleRate = vi->rate;
+   mNumChannels = vi->channels;
+   mVorbis = std::move(vorbis);
+   mCacheLen = 0;
+
+   MarkInitialized();
+   return true;
+}
+
+bool ODOggDecoder::Fill(sampleCount start, size_t len)
+{
+   auto vf = &mVorbis->vorbisFile;
+
+   if (mCacheSize < len) {
+      mCache.reinit(size_t(mNumChannels), len);
+      mCacheSize = len;
+   }
+   mCacheStart = start;
+   mCacheLen = len;
+
+   //the next block usually starts where the last one stopped
+   if (ov_pcm_tell(vf) != start.as_long_long() &&
+       ov_pcm_seek(vf, start.as_long_long()) != 0) {
+      mCacheLen = 0;
+      return false;
+   }
+
+   size_t done = 0;
+   while (done < len) {
+      float **pcm;
+      int bitstream;
+      const long read = ov_read_float(vf, &pcm,
+         (int) std::min<size_t>(len - done, 4096), &bitstream);
+      if (read == OV_HOLE)
+         // best effort for malformed files, as ImportOGG does
+         continue;
+      if (read <= 0)
+         break;
+      for (size_t c = 0; c < mNumChannels; c++)
+         std::copy(pcm[c], pcm[c] + read, mCache[c].get() + done);
+      done += read;
+   }
+
+   //past the end of the stream
+   for (size_t c = 0; c < mNumChannels; c++)
+      std::fill(mCache[c].get() + done, mCache[c].get() + len, 0.0f);
+   return true;
+}
+
+int ODOggDecoder::Decode(SampleBuffer & data, sampleFormat & format, sampleCount start, size_t len, unsigned int channel)
+{
+   ODLocker locker{ &mLock };
+
+   if (!mVorbis || channel >= mNumChannels)
+      return -1;
+
+   //the other channels of a block usually follow at once
+   if (!(start >= mCacheStart && start + len <= mCacheStart + mCacheLen) &&
+       !Fill(start, len))
+      return -1;
+
+   data.Allocate(len, floatSample);
+   format = floatSample;
+   const float *cached = mCache[channel].get() + (start - mCacheStart).as_size_t();
+   std::copy(cached, cached + len, (float *)data.ptr());
+
+   //insert into blockfile and
+   //calculate summary happen in ODDecodeBlockFile::WriteODDecodeBlockFile, where this method is also called.
+   return 1;
+}
+
+#endif // USE_LIBVORBIS
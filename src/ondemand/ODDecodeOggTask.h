@@ -0,0 +1,78 @@
+/**********************************************************************
+
+  Audacity: A Digital Audio Editor
+
+  ODDecodeOggTask.h
+
+  Audacity(R) is copyright (c) 1999-2018 Audacity Team.
+  License: GPL v2.  See License.txt.
+
+******************************************************************//**
+
+\class ODDecodeOggTask
+\brief Decodes an Ogg Vorbis file into ODDecodeBlockFiles, but not
+immediately.
+
+libvorbisfile seeks to a sample exactly, bisecting the file by the
+granule positions of its pages, so each block decodes from where it
+starts.  Only files of one logical bitstream are decoded on demand.
+
+*//*******************************************************************/
+
+#ifndef __AUDACITY_ODDecodeOggTask__
+#define __AUDACITY_ODDecodeOggTask__
+
+#include "ODDecodeTask.h"
+#include "ODTaskThread.h"
+
+/// A class representing a modular task to be used with the On-Demand structures.
+class ODDecodeOggTask final : public ODDecodeTask
+{
+ public:
+
+   /// Constructs an ODTask
+   ODDecodeOggTask(){}
+   virtual ~ODDecodeOggTask();
+
+
+   movable_ptr<ODTask> Clone() const override;
+   ///Creates an ODFileDecoder that decodes a file of filetype the subclass handles.
+   ODFileDecoder* CreateFileDecoder(const wxString & fileName) override;
+
+   ///Lets other classes know that this class handles Ogg Vorbis
+   unsigned int GetODType() override { return eODOGG; }
+};
+
+
+///class to decode a particular file (one per file).
+class ODOggDecoder final : public ODFileDecoder
+{
+public:
+   ODOggDecoder(const wxString & fileName);
+   virtual ~ODOggDecoder();
+
+   ///Decodes the samples of one channel into a float buffer.  Decodes all the
+   ///channels at once, and keeps them for the other channels of the same block.
+   int Decode(SampleBuffer & data, sampleFormat & format, sampleCount start, size_t len, unsigned int channel) override;
+
+   ///Opens the file, which must be seekable and of one bitstream
+   bool ReadHeader() override;
+
+private:
+   struct VorbisState;
+
+   //decodes all the channels from start into mCache
+   bool Fill(sampleCount start, size_t len);
+
+   ODLock mLock;//for everything below
+
+   std::unique_ptr<VorbisState> mVorbis;
+
+   //samples of all channels from mCacheStart
+   FloatBuffers mCache;
+   size_t mCacheSize{ 0 };
+   sampleCount mCacheStart{ 0 };
+   size_t mCacheLen{ 0 };
+};
+
+#endif
@@ -19,8 +19,10 @@ updating the ODDecodeBlockFile and the GUI of the newly available data.
 #include "../Audacity.h"
 #include "ODDecodeTask.h"
 #include "../blockfile/ODDecodeBlockFile.h"
+#include "../MixerPool.h"
 #include "../Sequence.h"
 #include "../WaveTrack.h"
+#include <algorithm>
 #include <wx/wx.h>
 
 ///Creates a NEW task that decodes files
@@ -29,8 +31,12 @@ ODDecodeTask::ODDecodeTask()
    mMaxBlockFiles = 0;
 }
 
+ODDecodeTask::~ODDecodeTask()
+{
+}
 
-///Computes and writes the data for one BlockFile if it still has a refcount.
+
+///Computes and writes the data for a batch of BlockFiles that still have a refcount.
 void ODDecodeTask::DoSomeInternal()
 {
    if(mBlockFiles.size()<=0)
@@ -41,71 +47,83 @@ void ODDecodeTask::DoSomeInternal()
       return;
    }
 
-   ODFileDecoder* decoder;
-
-   for(size_t i=0; i < mWaveTracks.size() && mBlockFiles.size();i++)
+   //Decode a run of consecutive blocks for each core at once.  mBlockFiles is in the
+   //order to decode, so the run of each thread continues through one part of the file,
+   //and the decoder, which opens the file again for each concurrent decode, seeks only
+   //at the start of the run.
+   const auto nThreads = std::max(1, wxThread::GetCPUCount());
+   if(!mPool)
+      mPool = std::make_unique<MixerPool>(unsigned(nThreads - 1));
+   const size_t runLength = kBlocksPerRun * std::max<size_t>(1, mWaveTracks.size());
+   const size_t count = std::min(mBlockFiles.size(), nThreads * runLength);
+
+   std::vector< std::shared_ptr< ODDecodeBlockFile > > blocks(count);
+   std::vector< int > results(count, 1);
    {
-      const auto bf = mBlockFiles[0].lock();
-      sampleCount blockStartSample = 0;
-      sampleCount blockEndSample = 0;
-      bool success =false;
-
-      int ret = 1;
-
-      if(bf)
+      //we need to ensure that the filename won't change or be moved.  We do this by calling LockRead(),
+      //which the dirmanager::EnsureSafeFilename also does.  The locks are held until the whole batch is done.
+      std::vector< BlockFile::ReadLock > locks;
+      locks.reserve(count);
+      for(size_t i = 0; i < count; i++)
       {
-         //OD TODO: somehow pass the bf a reference to the decoder that manages its file.
-         //we need to ensure that the filename won't change or be moved.  We do this by calling LockRead(),
-         //which the dirmanager::EnsureSafeFilename also does.
+         const auto &bf = blocks[i] = mBlockFiles[i].lock();
+         if(bf)
          {
-            auto locker = bf->LockForRead();
+            locks.push_back(bf->LockForRead());
             //Get the decoder.  If the file was moved, we need to create another one and init it.
-            decoder = GetOrCreateMatchingFileDecoder( &*bf );
+            //Not thread safe, so done here, before the decoding threads start.
+            ODFileDecoder* decoder = GetOrCreateMatchingFileDecoder( &*bf );
             if(!decoder->IsInitialized())
                decoder->Init();
             bf->SetODFileDecoder(decoder);
-            // Does not throw:
-            ret = bf->DoWriteBlockFile();
          }
+      }
 
-         if(ret >= 0) {
-            success = true;
-            blockStartSample = bf->GetStart();
-            blockEndSample = blockStartSample + bf->GetLength();
+      mPool->Run((count + runLength - 1) / runLength, [&](size_t run) {
+         const auto end = std::min(count, (run + 1) * runLength);
+         for(size_t i = run * runLength; i < end; i++)
+         {
+            if(blocks[i])
+               // Does not throw:
+               results[i] = blocks[i]->DoWriteBlockFile();
          }
-      }
-      else
+      });
+   }
+
+   //take the finished blocks out of the array - we are done with them.
+   std::vector< std::weak_ptr< ODDecodeBlockFile > > failed;
+   mWaveTrackMutex.Lock();
+   for(size_t i = 0; i < count; i++)
+   {
+      const auto &bf = blocks[i];
+      if(!bf)
       {
-         success = true;
          // The block file disappeared.
          //the waveform in the wavetrack now is shorter, so we need to update mMaxBlockFiles
          //because now there is less work to do.
          mMaxBlockFiles--;
       }
-
-      if (success)
-      {
-         //take it out of the array - we are done with it.
-         mBlockFiles.erase(mBlockFiles.begin());
-      }
+      else if(results[i] < 0)
+         // The task does not make progress with this block; try it again first next time
+         failed.push_back(mBlockFiles[i]);
       else
-         // The task does not make progress
-         ;
-
-      //Release the refcount we placed on it if we are successful
-      if( bf && success ) {
+      {
          //upddate the gui for all associated blocks.  It doesn't matter that we're hitting more wavetracks then we should
-         //because this loop runs a number of times equal to the number of tracks, they probably are getting processed in
-         //the next iteration at the same sample window.
-         mWaveTrackMutex.Lock();
-         for(size_t i=0;i<mWaveTracks.size();i++)
+         //because the batch has the blocks of all the tracks at about the same sample window.
+         const auto blockStartSample = bf->GetStart();
+         const auto blockEndSample = blockStartSample + bf->GetLength();
+         AddWorkDone(1, bf->GetLength());
+         for(size_t j = 0; j < mWaveTracks.size(); j++)
          {
-            if(mWaveTracks[i])
-               mWaveTracks[i]->AddInvalidRegion(blockStartSample,blockEndSample);
+            if(mWaveTracks[j])
+               mWaveTracks[j]->AddInvalidRegion(blockStartSample,blockEndSample);
          }
-         mWaveTrackMutex.Unlock();
       }
    }
+   mWaveTrackMutex.Unlock();
+
+   mBlockFiles.erase(mBlockFiles.begin(), mBlockFiles.begin() + count);
+   mBlockFiles.insert(mBlockFiles.begin(), failed.begin(), failed.end());
 
    //update percentage complete.
    CalculatePercentComplete();
@@ -138,7 +156,7 @@ void ODDecodeTask::Update()
    {
       if(mWaveTracks[j])
       {
-         BlockArray *blocks;
+         const BlockArray *blocks;
          Sequence *seq;
 
          //gather all the blockfiles that we should process in the wavetrack.
@@ -148,7 +166,8 @@ void ODDecodeTask::Update()
             seq->LockDeleteUpdateMutex();
 
             //See Sequence::Delete() for why need this for now..
-            blocks = clip->GetSequenceBlockArray();
+            // Read through a const clip, not to unshare its blocks
+            blocks = static_cast<const WaveClip*>(clip)->GetSequenceBlockArray();
             int i;
             int insertCursor;
 
@@ -156,7 +175,7 @@ void ODDecodeTask::Update()
             for (i = 0; i<(int)blocks->size(); i++)
             {
                //since we have more than one ODDecodeBlockFile, we will need type flags to cast.
-               SeqBlock &block = (*blocks)[i];
+               const SeqBlock &block = (*blocks)[i];
                const auto &file = block.f;
                std::shared_ptr<ODDecodeBlockFile> oddbFile;
                if (!file->IsDataAvailable() &&
@@ -199,47 +218,27 @@ void ODDecodeTask::OrderBlockFiles
    (std::vector< std::weak_ptr< ODDecodeBlockFile > > &unorderedBlocks)
 {
    mBlockFiles.clear();
-   //TODO:order the blockfiles into our queue in a fancy convenient way.  (this could be user-prefs)
-   //for now just put them in linear.  We start the order from the first block that includes the ondemand sample
-   //(which the user sets by clicking.)   note that this code is pretty hacky - it assumes that the array is sorted in time.
-
-   //find the startpoint
-   auto processStartSample = GetDemandSample();
-   std::shared_ptr< ODDecodeBlockFile > firstBlock;
-   for(auto i = unorderedBlocks.size(); i--; )
+   //Order the blockfiles into our queue by how soon the user will want them, as ODComputeSummaryTask does:
+   //first those in view, then the ones nearest the view, the playhead and the sample the user clicked.
+   //Ties go left to right.  Note that this code assumes that the array is sorted in time.
+   const auto focus = GetFocus();
+   std::vector< std::pair< long long, size_t > > order;
+   for(size_t i = 0; i < unorderedBlocks.size(); i++)
    {
       auto ptr = unorderedBlocks[i].lock();
       if(ptr)
-      {
-         //test if the blockfiles are near the task cursor.  we use the last mBlockFiles[0] as our point of reference
-         //and add ones that are closer.
-         //since the order is linear right to left, this will add blocks so that the ones on the right side of the target
-         //are processed first, with the ones closer being processed earlier.  Then the ones on the left side get processed.
-         if(mBlockFiles.size() &&
-            ptr->GetGlobalEnd() >= processStartSample &&
-                ( firstBlock->GetGlobalEnd() < processStartSample ||
-                  ptr->GetGlobalStart() <= firstBlock->GetGlobalStart()) )
-         {
-            //insert at the front of the list if we get blockfiles that are after the demand sample
-            firstBlock = ptr;
-            mBlockFiles.insert(mBlockFiles.begin(), unorderedBlocks[i]);
-         }
-         else
-         {
-            //otherwise no priority
-            if ( !firstBlock )
-               firstBlock = ptr;
-            mBlockFiles.push_back(unorderedBlocks[i]);
-         }
-         if(mMaxBlockFiles< (int) mBlockFiles.size())
-            mMaxBlockFiles = mBlockFiles.size();
-      }
+         order.push_back({ focus.Distance(ptr->GetGlobalStart(), ptr->GetGlobalEnd()), i });
       else
       {
          // The block file disappeared.
       }
    }
+   std::sort(order.begin(), order.end());
 
+   for(const auto &entry : order)
+      mBlockFiles.push_back(unorderedBlocks[entry.second]);
+   if(mMaxBlockFiles< (int) mBlockFiles.size())
+      mMaxBlockFiles = mBlockFiles.size();
 }
 
 
@@ -253,6 +252,13 @@ void ODDecodeTask::DemandTrackUpdate(WaveTrack* track, double seconds)
       ODTask::DemandTrackUpdate(track,seconds);
 }
 
+void ODDecodeTask::DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead)
+{
+   //only update if the subclass says we can seek.
+   if(SeekingAllowed())
+      ODTask::DemandViewUpdate(track,t0,t1,playhead);
+}
+
 
 ///there could be the ODDecodeBlockFiles of several FLACs in one track (after copy and pasting)
 ///so we keep a list of decoders that keep track of the file names, etc, and check the blocks against them.
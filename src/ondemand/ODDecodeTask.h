@@ -35,6 +35,7 @@ robust enough to allow all the user changes such as copy/paste, DELETE, and so o
 class ODDecodeBlockFile;
 class WaveTrack;
 class ODFileDecoder;
+class MixerPool;
 
 
 /// A class representing a modular task to be used with the On-Demand structures.
@@ -42,7 +43,7 @@ class ODDecodeTask /* not final */ : public ODTask
 {
  public:
    ODDecodeTask();
-   virtual ~ODDecodeTask(){};
+   virtual ~ODDecodeTask();
 
    // NEW virtual:
    virtual bool SeekingAllowed();
@@ -50,6 +51,7 @@ class ODDecodeTask /* not final */ : public ODTask
    ///changes the tasks associated with this Waveform to process the task from a different point in the track
    ///this is overridden from ODTask because certain classes don't allow users to seek sometimes, or not at all.
    void DemandTrackUpdate(WaveTrack* track, double seconds) override;
+   void DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead) override;
 
    ///Return the task name
    const char* GetTaskName() override { return "ODDecodeTask"; }
@@ -77,7 +79,8 @@ protected:
    ///recalculates the percentage complete.
    void CalculatePercentComplete() override;
 
-   ///Computes and writes the data for one BlockFile if it still has a refcount.
+   ///Computes and writes the data for a batch of BlockFiles that still have a refcount,
+   ///several at once.
    void DoSomeInternal() override;
 
    ///Readjusts the blockfile order in the default manner.  If we have had an ODRequest
@@ -94,6 +97,11 @@ protected:
 
    int mMaxBlockFiles;
 
+   //consecutive blocks of each track that one thread decodes in each DoSomeInternal()
+   static const size_t kBlocksPerRun = 4;
+   //helps decode a batch of blocks; made by the first DoSomeInternal()
+   std::unique_ptr<MixerPool> mPool;
+
 };
 
 ///class to decode a particular file (one per file).  Saves info such as filename and length (after the header is read.)
@@ -12,6 +12,16 @@
 \brief Singleton ODManager class.  Is the bridge between client side
 ODTask requests and internals.
 
+Tasks run on a pool of ODTaskThreads, one for each core, made once in
+Init().  A thread runs one slice of a task at a time, ODTask::DoSome(),
+which adds the task again if it is not done.  It then goes to the back of
+that thread's own deque, so the thread usually continues the task it
+knows.  A thread takes new and demanded tasks first, then its own, and
+when it has none it steals the oldest task of another thread.  The
+slices are long, so one lock serves all of the deques.  Threads wait on a
+condition while there is nothing to do, and the manager loop waits on
+another until a slice ends or a task is added.
+
 *//*******************************************************************/
 
 #include "../Audacity.h"
@@ -20,7 +30,11 @@ ODTask requests and internals.
 #include "ODTaskThread.h"
 #include "ODWaveTrackTaskQueue.h"
 #include "../Project.h"
+#include "../AudioIO.h"
+#include "../WaveTrack.h"
 #include <NonGuiThread.h>
+#include <algorithm>
+#include <cmath>
 #include <wx/utils.h>
 #include <wx/wx.h>
 #include <wx/thread.h>
@@ -56,57 +70,78 @@ ODManager::ODManager()
 {
    mTerminate = false;
    mTerminated = false;
+   mStopThreads = false;
+   mQueuesChanged = false;
    mPause = gPause;
 
    //must set up the queue condition
    mQueueNotEmptyCond = std::make_unique<ODCondition>(&mQueueNotEmptyCondLock);
+   mTaskReadyCond = std::make_unique<ODCondition>(&mTasksMutex);
+   mTerminatedCond = std::make_unique<ODCondition>(&mTerminatedMutex);
 }
 
 //private destructor - DELETE with static method Quit()
 ODManager::~ODManager()
+{
+   //Stop() has ended all of the threads
+   wxASSERT(mThreads.empty());
+}
+
+void ODManager::Stop()
 {
    mTerminateMutex.Lock();
    mTerminate = true;
    mTerminateMutex.Unlock();
 
-   //This while loop waits for ODTasks to finish and the DELETE removes all tasks from the Queue.
-   //This function is called from the main audacity event thread, so there should not be more requests for pMan
-   mTerminatedMutex.Lock();
-   while (!mTerminated)
+   //wake the ODMan thread, which waits on the queue condition, and wait for it to end.
+   WakeManager();
    {
-      mTerminatedMutex.Unlock();
-      wxThread::Sleep(200);
-
-      //signal the queue not empty condition since the ODMan thread will wait on the queue condition
-      mQueueNotEmptyCondLock.Lock();
-      mQueueNotEmptyCond->Signal();
-      mQueueNotEmptyCondLock.Unlock();
+      ODLocker locker{ &mTerminatedMutex };
+      while (!mTerminated)
+         mTerminatedCond->Wait();
+   }
 
-      mTerminatedMutex.Lock();
+   //let the task threads take no more tasks
+   {
+      ODLocker locker{ &mTasksMutex };
+      mStopThreads = true;
+      mTasks.clear();
+      for (auto &tasks : mThreadTasks)
+         tasks.clear();
+      mTaskReadyCond->Broadcast();
    }
-   mTerminatedMutex.Unlock();
 
    //get rid of all the queues.  The queues get rid of the tasks, so we don't worry abut them.
-   //nothing else should be running on OD related threads at this point, so we don't lock.
+   //Terminating the tasks cuts short the slices that are running.
    mQueues.clear();
+
+   for (auto &thread : mThreads)
+      thread->Wait();
+   mThreads.clear();
 }
 
 ///Adds a task to running queue.  Thread-safe.
 void ODManager::AddTask(ODTask* task)
 {
-   mTasksMutex.Lock();
-   mTasks.push_back(task);
-   mTasksMutex.Unlock();
-   //signal the queue not empty condition.
    bool paused;
 
    mPauseLock.Lock();
    paused=mPause;
    mPauseLock.Unlock();
 
-   //don't signal if we are paused since if we wake up the loop it will start processing other tasks while paused
+   ODLocker locker{ &mTasksMutex };
+   const auto running =
+      std::find(mRunningTasks.begin(), mRunningTasks.end(), task);
+   if (running != mRunningTasks.end())
+      //the task continues on its thread, unless another steals it first
+      mThreadTasks[running - mRunningTasks.begin()].push_back(task);
+   else
+      mTasks.push_back(task);
+
+   //signal the task ready condition.
+   //don't signal if we are paused since if we wake up a thread it will start processing other tasks while paused
    if(!paused)
-      mQueueNotEmptyCond->Signal();
+      mTaskReadyCond->Signal();
 }
 
 void ODManager::SignalTaskQueueLoop()
@@ -118,24 +153,141 @@ void ODManager::SignalTaskQueueLoop()
    mPauseLock.Unlock();
    //don't signal if we are paused
    if(!paused)
-      mQueueNotEmptyCond->Signal();
+      WakeManager();
+}
+
+void ODManager::WakeManager()
+{
+   ODLocker locker{ &mQueueNotEmptyCondLock };
+   mQueuesChanged = true;
+   mQueueNotEmptyCond->Signal();
 }
 
 ///removes a task from the active task queue
 void ODManager::RemoveTaskIfInQueue(ODTask* task)
 {
-   mTasksMutex.Lock();
+   ODLocker locker{ &mTasksMutex };
    //linear search okay for now, (probably only 1-5 tasks exist at a time.)
-   for(unsigned int i=0;i<mTasks.size();i++)
+   mTasks.erase(std::remove(mTasks.begin(), mTasks.end(), task), mTasks.end());
+   for (auto &tasks : mThreadTasks)
+      tasks.erase(std::remove(tasks.begin(), tasks.end(), task), tasks.end());
+}
+
+void ODManager::PromoteTask(ODTask* task)
+{
+   ODLocker locker{ &mTasksMutex };
+   auto found = std::find(mTasks.begin(), mTasks.end(), task);
+   if (found != mTasks.end())
+      mTasks.erase(found);
+   else {
+      //not waiting in mTasks; perhaps in the deque of a thread
+      bool waiting = false;
+      for (auto &tasks : mThreadTasks) {
+         auto it = std::find(tasks.begin(), tasks.end(), task);
+         if (it != tasks.end()) {
+            tasks.erase(it);
+            waiting = true;
+            break;
+         }
+      }
+      //a running task stays where it is
+      if (!waiting)
+         return;
+   }
+   mTasks.insert(mTasks.begin(), task);
+}
+
+ODTask* ODManager::TakeTask(unsigned index)
+{
    {
-      if(mTasks[i]==task)
+      ODLocker locker{ &mPauseLock };
+      if (mPause)
+         return nullptr;
+   }
+
+   ODTask* task = nullptr;
+   auto &own = mThreadTasks[index];
+   if (!mTasks.empty()) {
+      task = mTasks.front();
+      mTasks.erase(mTasks.begin());
+   }
+   else if (!own.empty()) {
+      task = own.back();
+      own.pop_back();
+   }
+   else {
+      //steal the oldest task of another thread, starting with the next one
+      for (size_t ii = 1; ii < mThreadTasks.size(); ++ii) {
+         auto &other = mThreadTasks[(index + ii) % mThreadTasks.size()];
+         if (!other.empty()) {
+            task = other.front();
+            other.pop_front();
+            break;
+         }
+      }
+   }
+   return task;
+}
+
+//Below this fill of the playback buffers, tasks make way for playback
+static const float kLowPlaybackFill = 0.5f;
+//How long a thread held back for playback sleeps before it looks again
+static const int kPlaybackWaitMs = 20;
+
+bool ODManager::PlaybackNeedsHeadroom()
+{
+   return gAudioIO && gAudioIO->IsBusy() &&
+      gAudioIO->GetPlaybackBufferFill() < kLowPlaybackFill;
+}
+
+void ODManager::WaitForPlayback(unsigned index)
+{
+   //while audio is busy, half of the threads, and at least one, go on working
+   const unsigned budget = std::max(1, mMaxThreads / 2);
+   for (;;) {
+      if (!gAudioIO || !gAudioIO->IsBusy())
+         return;
+      if (index < budget && !PlaybackNeedsHeadroom())
+         return;
       {
-         mTasks.erase(mTasks.begin()+i);
-         break;
+         ODLocker locker{ &mTasksMutex };
+         if (mStopThreads)
+            return;
       }
+      wxMilliSleep(kPlaybackWaitMs);
    }
-   mTasksMutex.Unlock();
+}
+
+void ODManager::RunTasks(unsigned index)
+{
+   ODLocker locker;
+   for (;;) {
+      WaitForPlayback(index);
+
+      locker.reset(&mTasksMutex);
+      ODTask* task = nullptr;
+      if (!mStopThreads && !(task = TakeTask(index))) {
+         //look at the playback again when woken
+         mTaskReadyCond->Wait();
+         locker.reset();
+         continue;
+      }
+      if (mStopThreads)
+         break;
+
+      mRunningTasks[index] = task;
+      locker.reset();
 
+      //Do at least 5 percent of the task
+      task->DoSome(0.05f);
+
+      locker.reset(&mTasksMutex);
+      mRunningTasks[index] = nullptr;
+
+      //the task may be done, or have work to show; the manager loop looks at the queues again
+      locker.reset();
+      WakeManager();
+   }
 }
 
 ///Adds a NEW task to the queue.  Creates a queue if the tracks associated with the task is not in the list
@@ -214,8 +366,17 @@ bool ODManager::IsInstanceCreated()
 ///Launches a thread for the manager and starts accepting Tasks.
 void ODManager::Init()
 {
-   mCurrentThreads = 0;
-   mMaxThreads = 5;
+   mMaxThreads = std::max(1, wxThread::GetCPUCount());
+
+   mThreadTasks.resize(mMaxThreads);
+   mRunningTasks.resize(mMaxThreads, nullptr);
+   for (int i = 0; i < mMaxThreads; i++)
+   {
+      auto thread = std::make_unique<ODTaskThread>(*this, i);
+      thread->Create();
+      thread->Run();
+      mThreads.push_back(std::move(thread));
+   }
 
    //   wxLogDebug(wxT("Initializing ODManager...Creating manager thread"));
    // This is a detached thread, so it deletes itself when it finishes
@@ -231,18 +392,9 @@ void ODManager::Init()
    //destruction of thread is taken care of by thread library
 }
 
-void ODManager::DecrementCurrentThreads()
-{
-   mCurrentThreadsMutex.Lock();
-   mCurrentThreads--;
-   mCurrentThreadsMutex.Unlock();
-}
-
-///Main loop for managing threads and tasks.
+///Main loop for managing queues and redraws; the task threads run the tasks.
 void ODManager::Start()
 {
-   bool tasksInArray;
-   bool paused;
    int  numQueues=0;
 
    mNeedsDraw=0;
@@ -258,50 +410,16 @@ void ODManager::Start()
 //    wxPrintf("ODManager thread running \n");
 
       //we should look at our WaveTrack queues to see if we can process a NEW task to the running queue.
+      //AddTask() wakes a task thread for each.
       UpdateQueues();
 
-      //start some threads if necessary
-
-      mTasksMutex.Lock();
-      tasksInArray = mTasks.size()>0;
-      mTasksMutex.Unlock();
-
-      mPauseLock.Lock();
-      paused=mPause;
-      mPauseLock.Unlock();
-
-      mCurrentThreadsMutex.Lock();
-      // keep adding tasks if there is work to do, up to the limit.
-      while(!paused && tasksInArray && (mCurrentThreads < mMaxThreads))
-      {
-         mCurrentThreads++;
-         mCurrentThreadsMutex.Unlock();
-
-         mTasksMutex.Lock();
-         //detach a NEW thread.
-         // This is a detached thread, so it deletes itself when it finishes
-         // ... except on Mac where we we don't use wxThread for reasons unexplained
-         auto thread = safenew ODTaskThread(mTasks[0]);//task);
-         //thread->SetPriority(10);//default is 50.
-         thread->Create();
-         thread->Run();
-
-         mTasks.erase(mTasks.begin());
-         tasksInArray = mTasks.size()>0;
-         mTasksMutex.Unlock();
-
-         mCurrentThreadsMutex.Lock();
-      }
-
-      mCurrentThreadsMutex.Unlock();
       //use a conditon variable to block here instead of a sleep.
-
-      // JKC: If there are no tasks ready to run, or we're paused then
-      // we wait for there to be tasks in the queue.
+      //we wait until a slice of a task ends, or something else changes the queues.
       {
          ODLocker locker{ &mQueueNotEmptyCondLock };
-         if( (!tasksInArray) || paused)
+         while (!mQueuesChanged)
             mQueueNotEmptyCond->Wait();
+         mQueuesChanged = false;
       }
 
       //if there is some ODTask running, then there will be something in the queue.  If so then redraw to show progress
@@ -328,6 +446,7 @@ void ODManager::Start()
 
    mTerminatedMutex.Lock();
    mTerminated=true;
+   mTerminatedCond->Signal();
    mTerminatedMutex.Unlock();
 
    //wxLogDebug Not thread safe.
@@ -345,9 +464,12 @@ void ODManager::Pauser::Pause(bool pause)
       pMan->mPause = pause;
       pMan->mPauseLock.Unlock();
 
-      if(!pause)
-         //we should check the queue again.
-         pMan->mQueueNotEmptyCond->Signal();
+      if(!pause) {
+         //we should check the queue again, and every thread may have a task.
+         pMan->WakeManager();
+         ODLocker locker{ &pMan->mTasksMutex };
+         pMan->mTaskReadyCond->Broadcast();
+      }
    }
    else
    {
@@ -364,6 +486,7 @@ void ODManager::Quit()
 {
    if(IsInstanceCreated())
    {
+      pMan->Stop();
       pMan.reset();
    }
 }
@@ -467,6 +590,20 @@ void ODManager::DemandTrackUpdate(WaveTrack* track, double seconds)
    for(unsigned int i=0;i<mQueues.size();i++)
    {
       mQueues[i]->DemandTrackUpdate(track,seconds);
+      //the next thread that is free continues the task the user is waiting for
+      if(mQueues[i]->ContainsWaveTrack(track))
+         if(auto task = mQueues[i]->GetFrontTask())
+            PromoteTask(task);
+   }
+   mQueuesMutex.Unlock();
+}
+
+void ODManager::DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead)
+{
+   mQueuesMutex.Lock();
+   for(unsigned int i=0;i<mQueues.size();i++)
+   {
+      mQueues[i]->DemandViewUpdate(track,t0,t1,playhead);
    }
    mQueuesMutex.Unlock();
 }
@@ -551,6 +688,55 @@ float ODManager::GetOverallPercentComplete()
    return (float) total/(totalTasks>0?totalTasks:1);
 }
 
+auto ODManager::GetTaskInfo() -> std::vector<TaskInfo>
+{
+   std::vector<TaskInfo> result;
+   ODLocker locker{ &mQueuesMutex };
+   for(const auto &queue : mQueues)
+   {
+      ODTask *task = queue->GetFrontTask();
+      if(!task)
+         continue;
+      TaskInfo info;
+      info.taskName = wxString::FromAscii(task->GetTaskName());
+      for(int i = 0; i < queue->GetNumWaveTracks(); i++)
+      {
+         if(WaveTrack *track = queue->GetWaveTrack(i))
+            info.trackNames.Add(track->GetName());
+      }
+      info.progress = task->GetProgress();
+      result.push_back(info);
+   }
+   return result;
+}
+
+double ODManager::GetOverallSecondsLeft()
+{
+   double result = -1.0;
+   for(const auto &info : GetTaskInfo())
+   {
+      //the queues run side by side, so the slowest decides
+      if(info.progress.percentComplete < 1.0f)
+      {
+         if(info.progress.secondsLeft < 0)
+            return -1.0;
+         result = std::max(result, info.progress.secondsLeft);
+      }
+   }
+   return result;
+}
+
+//static
+wxString ODManager::FormatSecondsLeft(double seconds)
+{
+   const auto total = (long) ceil(seconds);
+   if(total < 60)
+      return wxString::Format(_("%ld s"), total);
+   if(total < 3600)
+      return wxString::Format(_("%ld:%02ld min"), total / 60, total % 60);
+   return wxString::Format(_("%ld:%02ld h"), total / 3600, (total / 60) % 60);
+}
+
 ///Get Total Number of Tasks.
 int ODManager::GetTotalNumTasks()
 {
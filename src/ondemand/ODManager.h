@@ -19,6 +19,7 @@ number of threads.
 #ifndef __AUDACITY_ODMANAGER__
 #define __AUDACITY_ODMANAGER__
 
+#include <deque>
 #include <vector>
 #include "ODTask.h"
 #include "ODTaskThread.h"
@@ -52,14 +53,17 @@ class ODManager final
    ///Gets the singleton instance
    static ODManager* InstanceNormal();
 
-   ///Kills the ODMananger Thread.
+   ///Kills the ODMananger Thread and its pool of task threads.
    static void Quit();
 
-   ///changes the tasks associated with this Waveform to process the task from a different point in the track
+   ///changes the tasks associated with this Waveform to process the task from a different point in the track,
+   ///and runs them before other tasks.
    void DemandTrackUpdate(WaveTrack* track, double seconds);
 
-   ///Reduces the count of current threads running.  Meant to be called when ODTaskThreads end in their own threads.  Thread-safe.
-   void DecrementCurrentThreads();
+   ///changes the tasks associated with this Waveform to process first the blocks visible from t0 to t1,
+   ///then those nearest them and the playhead, which is negative when not playing.
+   ///Called as the view scrolls and zooms, and as play goes on.
+   void DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead);
 
    ///Adds a wavetrack, creates a queue member.
    void AddNewTask(movable_ptr<ODTask> &&mtask, bool lockMutex=true);
@@ -81,6 +85,7 @@ class ODManager final
    void ReplaceWaveTrack(WaveTrack* oldTrack,WaveTrack* newTrack);
 
    ///Adds a task to the running queue.  Threas-safe.
+   ///A task that adds itself again from its thread goes back to that thread.
    void AddTask(ODTask* task);
 
    void RemoveTaskIfInQueue(ODTask* task);
@@ -106,6 +111,25 @@ class ODManager final
    ///Get Total Number of Tasks.
    int GetTotalNumTasks();
 
+   ///The running task of each queue, for reports of how the work goes
+   struct TaskInfo {
+      wxString taskName;
+      wxArrayString trackNames;
+      ODTask::Progress progress;
+   };
+   std::vector<TaskInfo> GetTaskInfo();
+
+   ///How long until all the queues are done, as their slowest task tells;
+   ///negative if no task can tell yet.
+   double GetOverallSecondsLeft();
+
+   ///Time left, for the status bar and tips
+   static wxString FormatSecondsLeft(double seconds);
+
+   ///True while playback runs short, so that tasks end their slices early and
+   ///leave the disk and the CPU to AudioIO::FillBuffers().
+   static bool PlaybackNeedsHeadroom();
+
    // RAII object for pausing and resuming..
    class Pauser
    {
@@ -133,6 +157,29 @@ class ODManager final
    ///Start the main loop for the manager.
    void Start();
 
+   ///Stops the manager thread and the task threads, and deletes the queues.
+   ///Called by Quit() while Instance() still gives this object, because
+   ///tasks call it as they stop.
+   void Stop();
+
+   friend class ODTaskThread;
+   ///The loop of each task thread: runs slices of tasks as they are ready
+   void RunTasks(unsigned index);
+
+   ///Holds a task thread back while PlaybackNeedsHeadroom(), and, while audio
+   ///is busy at all, when it is beyond the threads that may still work.
+   ///Call without mTasksMutex locked.
+   void WaitForPlayback(unsigned index);
+
+   ///The next task for a thread, or null; call with mTasksMutex locked
+   ODTask* TakeTask(unsigned index);
+
+   ///Moves a ready task ahead of the others, if it is waiting for a thread
+   void PromoteTask(ODTask* task);
+
+   ///Has the manager loop look at the queues again.
+   void WakeManager();
+
    ///Remove references in our array to Tasks that have been completed/Schedule NEW ones
    void UpdateQueues();
 
@@ -143,10 +190,21 @@ class ODManager final
    std::vector<movable_ptr<ODWaveTrackTaskQueue>> mQueues;
    ODLock mQueuesMutex;
 
-   //List of current Task to do.
+   //List of current Task to do, that no thread has run yet, and demanded ones first.
    std::vector<ODTask*> mTasks;
-   //mutex for above variable
+   //Tasks that each thread ran last and that are not done, the latest at the back.  The
+   //thread takes its own from the back, and an idle thread steals the oldest of another.
+   std::vector<std::deque<ODTask*>> mThreadTasks;
+   //The task each thread is running now, or null
+   std::vector<ODTask*> mRunningTasks;
+   //mutex for above variables
    ODLock mTasksMutex;
+   //signalled when there is a task to take, or mStopThreads is set
+   std::unique_ptr<ODCondition> mTaskReadyCond;
+   bool mStopThreads;
+
+   //The task threads, one for each core; they last as long as the manager
+   std::vector<std::unique_ptr<ODTaskThread>> mThreads;
 
    //global pause switch for OD
    volatile bool mPause;
@@ -154,12 +212,7 @@ class ODManager final
 
    volatile int mNeedsDraw;
 
-   ///Number of threads currently running.   Accessed thru multiple threads
-   volatile int mCurrentThreads;
-   //mutex for above variable
-   ODLock mCurrentThreadsMutex;
-
-   ///Maximum number of threads allowed out.
+   ///Number of task threads.
    int mMaxThreads;
 
    volatile bool mTerminate;
@@ -167,10 +220,13 @@ class ODManager final
 
    volatile bool mTerminated;
    ODLock mTerminatedMutex;
+   std::unique_ptr<ODCondition> mTerminatedCond;
 
    //for the queue not empty comdition
    ODLock         mQueueNotEmptyCondLock;
    std::unique_ptr<ODCondition> mQueueNotEmptyCond;
+   //set with the lock above when the manager loop should run again
+   bool mQueuesChanged;
 
 #ifdef __WXMAC__
 
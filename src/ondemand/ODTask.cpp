@@ -23,6 +23,11 @@ in a background thread.
 #include "../WaveTrack.h"
 #include "../Project.h"
 #include "../UndoManager.h"
+#include "../Profiler.h"
+#include "../blockfile/BlockIOStats.h"
+#include <algorithm>
+#include <cmath>
+#include <wx/timer.h>
 //temporarilly commented out till it is added to all projects
 //#include "../Profiler.h"
 
@@ -32,6 +37,9 @@ DEFINE_EVENT_TYPE(EVT_ODTASK_COMPLETE)
 /// Constructs an ODTask
 ODTask::ODTask()
 : mDemandSample(0)
+, mViewStart(0)
+, mViewEnd(0)
+, mPlayhead(-1)
 {
 
    static int sTaskNumber=0;
@@ -40,6 +48,10 @@ ODTask::ODTask()
    mTerminate = false;
    mNeedsODUpdate=false;
    mIsRunning = false;
+   mStartMillis = -1;
+   mStartPercent = 0;
+   mBlocksDone = 0;
+   mBytesDone = 0;
 
    mTaskNumber=sTaskNumber++;
 }
@@ -68,6 +80,9 @@ void ODTask::TerminateAndBlock()
 /// will do the smallest unit of work possible
 void ODTask::DoSome(float amountWork)
 {
+   PROFILE_SCOPE("ODTask::DoSome");
+   BlockIOStats::Scope ioScope{ BlockIOStats::OnDemand };
+
    SetIsRunning(true);
    mBlockUntilTerminateMutex.Lock();
 
@@ -77,6 +92,14 @@ void ODTask::DoSome(float amountWork)
 
    float workUntil = amountWork+PercentComplete();
 
+   mProgressMutex.Lock();
+   if(mStartMillis < 0)
+   {
+      mStartMillis = wxGetLocalTimeMillis().GetValue();
+      mStartPercent = PercentComplete();
+   }
+   mProgressMutex.Unlock();
+
 
 
    //check periodically to see if we should exit.
@@ -116,6 +139,10 @@ void ODTask::DoSome(float amountWork)
 
       //But add the mutex lock back before we check the value again.
       mTerminateMutex.Lock();
+
+      //leave the rest of the slice for later if playback runs short
+      if(ODManager::PlaybackNeedsHeadroom())
+         break;
    }
    mTerminateMutex.Unlock();
    mDoingTask=false;
@@ -224,6 +251,35 @@ bool ODTask::IsRunning()
    return ret;
 }
 
+void ODTask::AddWorkDone(size_t blocks, sampleCount samples)
+{
+   mProgressMutex.Lock();
+   mBlocksDone += blocks;
+   mBytesDone += samples.as_double() * sizeof(float);
+   mProgressMutex.Unlock();
+}
+
+ODTask::Progress ODTask::GetProgress()
+{
+   Progress result{ PercentComplete(), 0.0, 0.0, -1.0 };
+
+   ODLocker locker{ &mProgressMutex };
+   if(mStartMillis < 0)
+      return result;
+   const double elapsed =
+      (wxGetLocalTimeMillis().GetValue() - mStartMillis) / 1000.0;
+   if(elapsed <= 0)
+      return result;
+
+   result.blocksPerSecond = mBlocksDone / elapsed;
+   result.bytesPerSecond = mBytesDone / elapsed;
+   //what is left goes at the pace of what was done since the start
+   const float done = result.percentComplete - mStartPercent;
+   if(done > 0)
+      result.secondsLeft = elapsed * (1.0 - result.percentComplete) / done;
+   return result;
+}
+
 sampleCount ODTask::GetDemandSample() const
 {
    sampleCount retval;
@@ -241,6 +297,34 @@ void ODTask::SetDemandSample(sampleCount sample)
    mDemandSampleMutex.Unlock();
 }
 
+ODTask::Focus ODTask::GetFocus() const
+{
+   ODLocker locker{ &mDemandSampleMutex };
+   return { mDemandSample, mViewStart, mViewEnd, mPlayhead };
+}
+
+long long ODTask::Focus::Distance(sampleCount start, sampleCount end) const
+{
+   //how many times farther is a block behind a point than one ahead
+   enum { kBehindWeight = 4 };
+   auto fromPoint = [&](sampleCount point) {
+      if (end <= point)
+         return kBehindWeight * (point - end + 1).as_long_long();
+      return std::max(0LL, (start - point).as_long_long());
+   };
+
+   long long distance = fromPoint(demand);
+   if (viewStart < viewEnd) {
+      if (start < viewEnd && end > viewStart)
+         return 0;
+      distance = std::min(distance, end <= viewStart
+         ? (viewStart - end + 1).as_long_long()
+         : (start - viewEnd + 1).as_long_long());
+   }
+   if (playhead >= 0)
+      distance = std::min(distance, fromPoint(playhead));
+   return distance;
+}
 
 ///return the amount of the task that has been completed.  0.0 to 1.0
 float ODTask::PercentComplete()
@@ -342,6 +426,39 @@ void ODTask::DemandTrackUpdate(WaveTrack* track, double seconds)
 
 }
 
+void ODTask::DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead)
+{
+   //a playhead that moves less than this does not reorder the blocks
+   static const double kPlayheadSlack = 2.0;
+
+   bool focusChanged=false;
+   mWaveTrackMutex.Lock();
+   for(size_t i=0;i<mWaveTracks.size();i++)
+   {
+      if(track == mWaveTracks[i])
+      {
+         const double rate = track->GetRate();
+         auto viewStart = (sampleCount)(std::max(0.0, t0) * rate);
+         auto viewEnd = (sampleCount)(std::max(0.0, t1) * rate);
+         auto newPlayhead = playhead < 0 ? sampleCount{ -1 } : (sampleCount)(playhead * rate);
+
+         ODLocker locker{ &mDemandSampleMutex };
+         const bool playheadMoved = (newPlayhead < 0) != (mPlayhead < 0) ||
+            std::abs((newPlayhead - mPlayhead).as_double()) > kPlayheadSlack * rate;
+         focusChanged = viewStart != mViewStart || viewEnd != mViewEnd || playheadMoved;
+         mViewStart = viewStart;
+         mViewEnd = viewEnd;
+         if (playheadMoved)
+            mPlayhead = newPlayhead;
+         break;
+      }
+   }
+   mWaveTrackMutex.Unlock();
+
+   if(focusChanged)
+      SetNeedsODUpdate();
+}
+
 
 void ODTask::StopUsingWaveTrack(WaveTrack* track)
 {
@@ -44,7 +44,9 @@ class ODTask /* not final */
       eODFLAC     =  0x00000001,
       eODMP3      =  0x00000002,
       eODFFMPEG   =  0x00000004,
+      eODOGG      =  0x00000008,
       eODPCMSummary  = 0x00001000,
+      eODPCMCopyIn   = 0x00002000,
       eODOTHER    =  0x10000000,
    } ODTypeEnum;
    // Constructor / Destructor
@@ -94,6 +96,10 @@ class ODTask /* not final */
    ///changes the tasks associated with this Waveform to process the task from a different point in the track
    virtual void DemandTrackUpdate(WaveTrack* track, double seconds);
 
+   ///changes the tasks associated with this Waveform to process first the blocks that are visible from t0 to t1,
+   ///then those nearest the view and ahead of the playhead.  playhead is negative when not playing.
+   virtual void DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead);
+
    bool IsComplete();
 
    void TerminateAndBlock();
@@ -106,6 +112,19 @@ class ODTask /* not final */
 
    virtual void SetDemandSample(sampleCount sample);
 
+   ///Where the user wants results first, in samples of the tracks
+   struct Focus {
+      sampleCount demand;     // where the user clicked
+      sampleCount viewStart;  // the visible samples; none if empty
+      sampleCount viewEnd;
+      sampleCount playhead;   // negative if not playing
+
+      ///The order in which to process a block of these samples; smaller is sooner.
+      ///Blocks behind a point count as farther than blocks the same distance ahead.
+      long long Distance(sampleCount start, sampleCount end) const;
+   };
+   Focus GetFocus() const;
+
    ///does an od update and then recalculates the data.
    virtual void RecalculatePercentComplete();
 
@@ -123,9 +142,21 @@ class ODTask /* not final */
 
    bool IsRunning();
 
+   ///How fast the task has gone since it first ran, and how long it may take yet
+   struct Progress {
+      float percentComplete;
+      double blocksPerSecond;
+      double bytesPerSecond;  // of the samples done, counted as floats
+      double secondsLeft;     // negative until there is a rate to tell from
+   };
+   Progress GetProgress();
+
 
  protected:
 
+   ///Subclasses call this as they finish blocks, for GetProgress()
+   void AddWorkDone(size_t blocks, sampleCount samples);
+
    ///calculates the percentage complete from existing data.
    virtual void CalculatePercentComplete() = 0;
 
@@ -160,11 +191,20 @@ class ODTask /* not final */
    ODLock     mWaveTrackMutex;
 
    sampleCount mDemandSample;
+   //the rest of the Focus, also guarded by mDemandSampleMutex
+   sampleCount mViewStart, mViewEnd, mPlayhead;
    mutable ODLock      mDemandSampleMutex;
 
    volatile bool mIsRunning;
    ODLock mIsRunningMutex;
 
+   //when DoSome first ran, and what it has done since, for GetProgress()
+   long long mStartMillis;
+   float mStartPercent;
+   size_t mBlocksDone;
+   double mBytesDone;
+   ODLock mProgressMutex;
+
 
    private:
 
@@ -11,7 +11,8 @@
 ******************************************************************//**
 
 \class ODTaskThread
-\brief A thread that executes a part of the task specfied by an ODTask.
+\brief One of the pool of threads of the ODManager, that executes parts
+of ODTasks for as long as the manager runs.
 
 *//*******************************************************************/
 
@@ -19,14 +20,16 @@
 #include "ODTaskThread.h"
 #include "ODTask.h"
 #include "ODManager.h"
+#include "../Profiler.h"
 
 
-ODTaskThread::ODTaskThread(ODTask* task)
+ODTaskThread::ODTaskThread(ODManager &manager, unsigned index)
+:
 #ifndef __WXMAC__
-: wxThread()
+  wxThread(wxTHREAD_JOINABLE),
 #endif
+  mManager(manager), mIndex(index)
 {
-   mTask=task;
 #ifdef __WXMAC__
    mDestroy = false;
    mThread = NULL;
@@ -44,12 +47,8 @@ void *ODTaskThread::Entry()
 {
    //TODO: Figure out why this has no effect at all.
    //wxThread::This()->SetPriority( 40);
-   //Do at least 5 percent of the task
-   mTask->DoSome(0.05f);
-
-   //release the thread count so that the ODManager knows how many active threads are alive.
-   ODManager::Instance()->DecrementCurrentThreads();
-
+   Profiler::Instance()->SetThreadName("On-demand worker");
+   mManager.RunTasks(mIndex);
 
 #ifndef __WXMAC__
    return NULL;
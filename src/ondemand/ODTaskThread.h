@@ -11,7 +11,8 @@
 ******************************************************************//**
 
 \class ODTaskThread
-\brief A thread that executes a part of the task specfied by an ODTask.
+\brief One of the pool of threads of the ODManager, that executes parts
+of ODTasks for as long as the manager runs.
 
 *//*******************************************************************/
 
@@ -26,7 +27,7 @@
 #include "../Audacity.h"	// contains the set-up of AUDACITY_DLL_API
 #include "../MemoryX.h"
 
-class ODTask;
+class ODManager;
 
 #ifdef __WXMAC__
 
@@ -39,13 +40,16 @@ class ODTask;
 class ODTaskThread {
  public:
    typedef int ExitCode;
-   ODTaskThread(ODTask* task);
+   ODTaskThread(ODManager &manager, unsigned index);
    /*ExitCode*/ void Entry();
    void Create() {}
    void Delete() {
       mDestroy = true;
       pthread_join(mThread, NULL);
    }
+   void Wait() {
+      pthread_join(mThread, NULL);
+   }
    bool TestDestroy() { return mDestroy; }
    void Sleep(int ms) {
       struct timespec spec;
@@ -78,7 +82,8 @@ class ODTaskThread {
    bool mDestroy;
    pthread_t mThread;
 
-   ODTask* mTask;
+   ODManager &mManager;
+   const unsigned mIndex;
 };
 
 class ODLock {
@@ -133,15 +138,16 @@ protected:
 class ODTaskThread final : public wxThread
 {
 public:
-   ///Constructs a ODTaskThread
-   ///@param task the task to be launched as an
-   ODTaskThread(ODTask* task);
+   ///Constructs a ODTaskThread, joinable, for the pool of the manager
+   ///@param index which thread of the pool this is
+   ODTaskThread(ODManager &manager, unsigned index);
 
 
 protected:
-   ///Executes a part of the task
+   ///Executes parts of tasks until the manager stops
    void* Entry() override;
-   ODTask* mTask;
+   ODManager &mManager;
+   const unsigned mIndex;
 
 };
 
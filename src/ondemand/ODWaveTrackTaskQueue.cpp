@@ -203,6 +203,20 @@ void ODWaveTrackTaskQueue::DemandTrackUpdate(WaveTrack* track, double seconds)
    }
 }
 
+void ODWaveTrackTaskQueue::DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead)
+{
+   if(track)
+   {
+      mTracksMutex.Lock();
+      for(unsigned int i=0;i<mTasks.size();i++)
+      {
+         mTasks[i]->DemandViewUpdate(track,t0,t1,playhead);
+      }
+
+      mTracksMutex.Unlock();
+   }
+}
+
 
 //Replaces all instances of a wavetracck with a NEW one (effectively transferes the task.)
 void ODWaveTrackTaskQueue::ReplaceWaveTrack(WaveTrack* oldTrack, WaveTrack* newTrack)
@@ -332,7 +346,14 @@ void ODWaveTrackTaskQueue::FillTipForWaveTrack( const WaveTrack * t, wxString &t
    {
 
     //  if(GetNumTasks()==1)
-      mTipMsg.Printf(_("%s %2.0f%% complete.  Click to change task focal point."), GetFrontTask()->GetTip(), GetFrontTask()->PercentComplete()*100.0 );
+      const auto progress = GetFrontTask()->GetProgress();
+      if(progress.secondsLeft >= 0)
+         mTipMsg.Printf(_("%s %2.0f%% complete, %.1f MB/s, %s left.  Click to change task focal point."),
+            GetFrontTask()->GetTip(), progress.percentComplete*100.0,
+            progress.bytesPerSecond / 1000000.0,
+            ODManager::FormatSecondsLeft(progress.secondsLeft));
+      else
+         mTipMsg.Printf(_("%s %2.0f%% complete.  Click to change task focal point."), GetFrontTask()->GetTip(), progress.percentComplete*100.0 );
      // else
        //  msg.Printf(_("%s %d additional tasks remaining."), GetFrontTask()->GetTip(), GetNumTasks());
 
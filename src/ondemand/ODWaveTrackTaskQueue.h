@@ -51,6 +51,9 @@ class ODWaveTrackTaskQueue final
    ///changes the tasks associated with this Waveform to process the task from a different point in the track
    void DemandTrackUpdate(WaveTrack* track, double seconds);
 
+   ///changes the tasks associated with this Waveform to process first what is visible, and near the playhead
+   void DemandViewUpdate(WaveTrack* track, double t0, double t1, double playhead);
+
    ///replaces all instances of a WaveTrack within this task with another.
    void ReplaceWaveTrack(WaveTrack* oldTrack,WaveTrack* newTrack);
 
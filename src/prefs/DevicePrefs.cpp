@@ -94,8 +94,18 @@ void DevicePrefs::GetNamesAndLabels()
    // FIXME: TRAP_ERR PaErrorCode not handled in DevicePrefs GetNamesAndLabels()
    // With an error code won't add hosts, but won't report a problem either.
    int nDevices = Pa_GetDeviceCount();
+   mSecondRecordNames.Add(wxT(""));
+   mSecondRecordLabels.Add(_("None"));
    for (int i = 0; i < nDevices; i++) {
       const PaDeviceInfo *info = Pa_GetDeviceInfo(i);
+      if (info != NULL && info->maxInputChannels > 0) {
+         // Any input device of the chosen host may be the second one
+         wxString name = wxSafeConvertMB2WX(info->name);
+         if (mSecondRecordNames.Index(name) == wxNOT_FOUND) {
+            mSecondRecordNames.Add(name);
+            mSecondRecordLabels.Add(name);
+         }
+      }
       if ((info!=NULL)&&(info->maxOutputChannels > 0 || info->maxInputChannels > 0)) {
          wxString name = wxSafeConvertMB2WX(Pa_GetHostApiInfo(info->hostApi)->name);
          if (mHostNames.Index(name) == wxNOT_FOUND) {
@@ -162,6 +172,24 @@ void DevicePrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 
+   S.StartStatic(_("Second Recording Device"));
+   {
+      S.StartMultiColumn(2);
+      {
+         S.TieChoice(_("Dev&ice:"),
+                     wxT("/AudioIO/SecondRecordingDevice"),
+                     wxT(""),
+                     mSecondRecordNames,
+                     mSecondRecordLabels);
+
+         S.TieSpinCtrl(_("Channe&ls:"),
+                       wxT("/AudioIO/SecondRecordChannels"),
+                       2, 64, 1);
+      }
+      S.EndMultiColumn();
+   }
+   S.EndStatic();
+
    // These previously lived in recording preferences.
    // However they are liable to become device specific.
    // Buffering also affects playback, not just recording, so is a device characteristic.
@@ -187,6 +215,10 @@ void DevicePrefs::PopulateOrExchange(ShuttleGui & S)
          if( w ) w->SetName(w->GetName() + wxT(" ") + _("milliseconds"));
       }
       S.EndThreeColumn();
+
+      S.TieCheckBox(_("Shift by the &measured latency of the devices instead"),
+                    wxT("/AudioIO/AutoLatencyCorrection"),
+                    false);
    }
    S.EndStatic();
    S.EndScroller();
@@ -41,6 +41,9 @@ class DevicePrefs final : public PrefsPanel
    wxArrayString mHostNames;
    wxArrayString mHostLabels;
 
+   wxArrayString mSecondRecordNames;
+   wxArrayString mSecondRecordLabels;
+
    wxString mPlayDevice;
    wxString mRecordDevice;
    wxString mRecordSource;
@@ -18,6 +18,7 @@
 #include "../Audacity.h"
 
 #include <math.h>
+#include <vector>
 
 #include <wx/defs.h>
 #include <wx/intl.h>
@@ -123,6 +124,69 @@ void DirectoriesPrefs::PopulateOrExchange(ShuttleGui & S)
    }
    S.EndStatic();
 #endif // DEPRECATED_AUDIO_CACHE
+
+   S.StartStatic(_("Audio cache"));
+   {
+      S.StartTwoColumn();
+      {
+         S.TieNumericTextBox(_("Memory for decoded &audio (MB):"),
+                             wxT("/Directories/BlockCacheBudget"),
+                             64,
+                             9);
+         S.TieNumericTextBox(_("Of which one project may &use (%):"),
+                             wxT("/Directories/BlockCacheProjectQuota"),
+                             100,
+                             9);
+         S.TieNumericTextBox(_("Memory for audio &waiting to be written (MB):"),
+                             wxT("/Directories/BackgroundWriteBudget"),
+                             32,
+                             9);
+      }
+      S.EndTwoColumn();
+
+      S.TieCheckBox(_("&Fill the cache when a project is opened"),
+                    wxT("/Directories/CacheBlockFiles"),
+                    false);
+   }
+   S.EndStatic();
+
+   S.StartStatic(_("Audio data"));
+   {
+#ifdef USE_LIBFLAC
+      S.TieCheckBox(_("C&ompress NEW audio data losslessly"),
+                    wxT("/Directories/CompressBlockFiles"),
+                    false);
+#endif
+      S.TieCheckBox(_("Store NEW audio data in one &pack file per project"),
+                    wxT("/Directories/PackBlockFiles"),
+                    false);
+      S.TieCheckBox(_("S&hare audio data files between projects when possible"),
+                    wxT("/Directories/ShareBlockFiles"),
+                    true);
+      S.TieCheckBox(_("Store i&dentical audio data only once"),
+                    wxT("/Directories/DedupeBlockFiles"),
+                    true);
+      S.TieCheckBox(_("Choose the block size by &timing the disk"),
+                    wxT("/Directories/CalibrateBlockSize"),
+                    false);
+
+      wxArrayString compactChoices;
+      compactChoices.Add(_("Never"));
+      compactChoices.Add(_("Only very small pieces"));
+      compactChoices.Add(_("Small pieces"));
+      compactChoices.Add(_("All pieces that can be merged"));
+      const std::vector<int> compactLevels{ 0, 1, 2, 3 };
+      S.StartTwoColumn();
+      {
+         S.TieChoice(_("&Merge pieces of audio data left by editing, when idle:"),
+                     wxT("/Directories/CompactBlocks"),
+                     1,
+                     compactChoices,
+                     compactLevels);
+      }
+      S.EndTwoColumn();
+   }
+   S.EndStatic();
    S.EndScroller();
 
 }
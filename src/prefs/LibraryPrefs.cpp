@@ -22,6 +22,7 @@ MP3 and FFmpeg encoding libraries.
 #include <wx/button.h>
 
 #include "../FFmpeg.h"
+#include "../export/ExportMP3.h"
 #include "../ShuttleGui.h"
 #include "../widgets/LinkingHtmlWindow.h"
 #include "../widgets/HelpSystem.h"
@@ -160,8 +161,9 @@ void LibraryPrefs::PopulateOrExchange(ShuttleGui & S)
 
 /// Sets the a text area on the dialog to have the name
 /// of the MP3 Library version.
-void LibraryPrefs::SetMP3VersionText()
+void LibraryPrefs::SetMP3VersionText(bool prompt)
 {
+   mMP3Version->SetLabel(GetMP3Version(this, prompt));
    mMP3Version->SetName(mMP3Version->GetLabel()); // fix for bug 577 (NVDA/Narrator screen readers do not read static text in dialogs)
 }
 
@@ -169,7 +171,7 @@ void LibraryPrefs::SetMP3VersionText()
 /// tell us where the MP3 library is.
 void LibraryPrefs::OnMP3FindButton(wxCommandEvent & WXUNUSED(event))
 {
-   SetMP3VersionText();
+   SetMP3VersionText(true);
 }
 
 /// Opens help on downloading a suitable MP3 library is.
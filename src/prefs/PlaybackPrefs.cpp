@@ -100,6 +100,14 @@ void PlaybackPrefs::PopulateOrExchange(ShuttleGui & S)
       S.EndThreeColumn();
    }
    S.EndStatic();
+
+   S.StartStatic(_("Mixing"));
+   {
+      S.TieCheckBox(_("&Mix all tracks in one buffer ahead of playing"),
+                    wxT("/AudioIO/PremixPlayback"),
+                    false);
+   }
+   S.EndStatic();
    S.EndScroller();
 
 }
@@ -85,6 +85,9 @@ void RecordingPrefs::PopulateOrExchange(ShuttleGui & S)
       S.TieCheckBox(_("Use &software to play other tracks"),
                     wxT("/AudioIO/SWPlaythrough"),
                     false);
+      S.TieCheckBox(_("Use the smallest &buffers when monitoring"),
+                    wxT("/AudioIO/LowLatencyMonitoring"),
+                    false);
 #if !defined(__WXMAC__)
       //S.AddUnits(wxString(wxT("     ")) + _("(uncheck when recording computer playback)"));
 #endif
@@ -0,0 +1,115 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SpectrogramSettings.cpp
+
+*******************************************************************//**
+
+\class SpectrogramSettings
+\brief Spectrogram settings, the defaults for all tracks.
+
+*//*******************************************************************/
+
+#include "../Audacity.h"
+#include "SpectrogramSettings.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../Prefs.h"
+
+SpectrogramSettings::SpectrogramSettings()
+{
+   LoadPrefs();
+}
+
+SpectrogramSettings& SpectrogramSettings::defaults()
+{
+   static SpectrogramSettings instance;
+   return instance;
+}
+
+bool SpectrogramSettings::Validate(bool /* quiet */)
+{
+   minFreq = std::max(0, minFreq);
+   maxFreq = std::max(minFreq + 1, maxFreq);
+   range = std::max(1, range);
+   windowType = WindowType(
+      std::max(0, std::min((int)(wtNumWindowTypes) - 1, (int)(windowType)))
+   );
+   logWindowSize = std::max((int)LogMinWindowSize,
+      std::min((int)LogMaxWindowSize, logWindowSize));
+   // A power of two, so that the length of the transform is one too, and
+   // no longer than the longest window
+   int factor = 1;
+   while (2 * factor <= zeroPaddingFactor &&
+          (2 * factor << logWindowSize) <= (1 << LogMaxWindowSize))
+      factor *= 2;
+   zeroPaddingFactor = factor;
+
+   return true;
+}
+
+void SpectrogramSettings::LoadPrefs()
+{
+   minFreq = gPrefs->Read(wxT("/Spectrum/MinFreq"), 0L);
+   maxFreq = gPrefs->Read(wxT("/Spectrum/MaxFreq"), 8000L);
+   range = gPrefs->Read(wxT("/Spectrum/Range"), 80L);
+   gain = gPrefs->Read(wxT("/Spectrum/Gain"), 20L);
+   frequencyGain = gPrefs->Read(wxT("/Spectrum/FrequencyGain"), 0L);
+   windowType = WindowType(gPrefs->Read(wxT("/Spectrum/WindowType"),
+      long(wtHann)));
+   const long windowSize = gPrefs->Read(wxT("/Spectrum/FFTSize"), 2048L);
+   logWindowSize = 0;
+   while ((2L << logWindowSize) <= windowSize)
+      ++logWindowSize;
+   zeroPaddingFactor = gPrefs->Read(wxT("/Spectrum/ZeroPaddingFactor"), 1L);
+   gPrefs->Read(wxT("/Spectrum/Grayscale"), &isGrayscale, false);
+
+   // Enforce legal values
+   Validate(true);
+}
+
+void SpectrogramSettings::SavePrefs()
+{
+   gPrefs->Write(wxT("/Spectrum/MinFreq"), long(minFreq));
+   gPrefs->Write(wxT("/Spectrum/MaxFreq"), long(maxFreq));
+   gPrefs->Write(wxT("/Spectrum/Range"), long(range));
+   gPrefs->Write(wxT("/Spectrum/Gain"), long(gain));
+   gPrefs->Write(wxT("/Spectrum/FrequencyGain"), long(frequencyGain));
+   gPrefs->Write(wxT("/Spectrum/WindowType"), long(windowType));
+   gPrefs->Write(wxT("/Spectrum/FFTSize"), long(WindowSize()));
+   gPrefs->Write(wxT("/Spectrum/ZeroPaddingFactor"), long(zeroPaddingFactor));
+   gPrefs->Write(wxT("/Spectrum/Grayscale"), isGrayscale);
+}
+
+void SpectrogramSettings::MakeWindow(std::vector<float> &window) const
+{
+   const auto size = WindowSize();
+   window.resize(size);
+   double sum = 0;
+   for (size_t ii = 0; ii < size; ++ii) {
+      const double phase = 2 * M_PI * ii / size;
+      double value;
+      switch (windowType) {
+      default:
+      case wtRectangular:
+         value = 1.0; break;
+      case wtHann:
+         value = 0.5 - 0.5 * cos(phase); break;
+      case wtHamming:
+         value = 0.54 - 0.46 * cos(phase); break;
+      case wtBlackman:
+         value = 0.42 - 0.5 * cos(phase) + 0.08 * cos(2 * phase); break;
+      }
+      window[ii] = value;
+      sum += value;
+   }
+
+   // A sine of amplitude 1 has a peak bin of magnitude sum / 2; make its
+   // power 0 dB
+   const float scale = 2.0 / sum;
+   for (auto &value : window)
+      value *= scale;
+}
@@ -0,0 +1,62 @@
+/**********************************************************************
+
+Audacity: A Digital Audio Editor
+
+SpectrogramSettings.h
+
+**********************************************************************/
+
+#ifndef __AUDACITY_SPECTROGRAM_SETTINGS__
+#define __AUDACITY_SPECTROGRAM_SETTINGS__
+
+#include "../Audacity.h"
+
+#include <stddef.h>
+#include <vector>
+
+class SpectrogramSettings
+{
+public:
+   static SpectrogramSettings &defaults();
+   SpectrogramSettings();
+
+   bool Validate(bool quiet);
+   void LoadPrefs();
+   void SavePrefs();
+
+   typedef int WindowType;
+   enum WindowTypeValues : int {
+      wtRectangular,
+      wtHann,
+      wtHamming,
+      wtBlackman,
+
+      wtNumWindowTypes,
+   };
+
+   // Lengths of the window, in samples, are powers of two in this range
+   enum {
+      LogMinWindowSize = 3,
+      LogMaxWindowSize = 15,
+   };
+
+   size_t WindowSize() const { return size_t(1) << logWindowSize; }
+   size_t ZeroPaddingFactor() const { return zeroPaddingFactor; }
+   size_t GetFFTLength() const { return WindowSize() * ZeroPaddingFactor(); }
+   size_t NBins() const { return GetFFTLength() / 2; }
+
+   /// The window, scaled so that a full scale sine has a power of 0 dB
+   void MakeWindow(std::vector<float> &window) const;
+
+   int minFreq;
+   int maxFreq;
+   int range;
+   int gain;
+   /// dB per decade, boosting the higher frequencies
+   int frequencyGain;
+   WindowType windowType;
+   int logWindowSize;
+   int zeroPaddingFactor;
+   bool isGrayscale;
+};
+#endif
@@ -57,6 +57,7 @@
 #include "MeterToolBar.h"
 
 #include "../AColor.h"
+#include "../AggregateCapture.h"
 #include "../AllThemeResources.h"
 #include "../AudioIO.h"
 #include "../Prefs.h"
@@ -536,7 +537,6 @@ int ControlToolBar::PlayPlayRegion(const SelectedRegion &selectedRegion,
                                    PlayAppearance appearance, /* = PlayOption::Straight */
                                    bool backwards, /* = false */
                                    bool playWhiteSpace /* = false */)
-// STRONG-GUARANTEE (for state of mCutPreviewTracks)
 {
    if (!CanStopAudioStream())
       return -1;
@@ -645,22 +645,19 @@ int ControlToolBar::PlayPlayRegion(const SelectedRegion &selectedRegion,
          double tcp0 = tless-beforeLen;
          double diff = tgreater - tless;
          double tcp1 = (tgreater+afterLen) - diff;
-         SetupCutPreviewTracks(tcp0, tless, tgreater, tcp1);
          if (backwards)
             std::swap(tcp0, tcp1);
-         if (mCutPreviewTracks)
-         {
-            AudioIOStartStreamOptions myOptions = options;
-            myOptions.cutPreviewGapStart = t0;
-            myOptions.cutPreviewGapLen = t1 - t0;
-            token = gAudioIO->StartStream(
-               mCutPreviewTracks->GetWaveTrackConstArray(false),
-               WaveTrackArray(),
-               tcp0, tcp1, myOptions);
-         }
-         else
-            // Cannot create cut preview tracks, clean up and exit
+         // Play the selected tracks themselves; AudioIO leaves the gap out
+         // of the times of the stream, and the mixers jump over it
+         auto tracks = t->GetWaveTrackConstArray(true);
+         if (tracks.empty())
             return -1;
+         AudioIOStartStreamOptions myOptions = options;
+         myOptions.cutPreviewGapStart = tless;
+         myOptions.cutPreviewGapLen = diff;
+         token = gAudioIO->StartStream(tracks,
+            WaveTrackArray(),
+            tcp0, tcp1, myOptions);
       }
       else {
          // Lifted the following into AudacityProject::GetDefaultPlayOptions()
@@ -814,8 +811,6 @@ void ControlToolBar::StopPlaying(bool stopStream /* = true*/)
    //Make sure you tell gAudioIO to unpause
    gAudioIO->SetPaused(mPaused);
 
-   ClearCutPreviewTracks();
-
    mBusyProject = NULL;
    // So that we continue monitoring after playing or recording.
    // also clean the MeterQueues
@@ -941,6 +936,8 @@ void ControlToolBar::OnRecord(wxCommandEvent &evt)
       }
 
       int recordingChannels = 0;
+      // Tracks for a second recording device, after the others
+      unsigned aggregateChannels = 0;
       if (appendRecord) {
          recordingChannels = gPrefs->Read(wxT("/AudioIO/RecordChannels"), 2);
          bool sel = false;
@@ -1044,6 +1041,7 @@ void ControlToolBar::OnRecord(wxCommandEvent &evt)
          numTracks++;
 
          recordingChannels = gPrefs->Read(wxT("/AudioIO/RecordChannels"), 2);
+         aggregateChannels = AggregateCapture::GetPreferredChannels();
 
          gPrefs->Read(wxT("/GUI/TrackNames/RecordingNameCustom"), &recordingNameCustom, false);
          gPrefs->Read(wxT("/GUI/TrackNames/TrackNumber"), &useTrackNumber, false);
@@ -1054,7 +1052,14 @@ void ControlToolBar::OnRecord(wxCommandEvent &evt)
 
          wxString baseTrackName = recordingNameCustom? defaultRecordingTrackName : defaultTrackName;
 
-         for (int c = 0; c < recordingChannels; c++) {
+         const int totalChannels = recordingChannels + aggregateChannels;
+         for (int c = 0; c < totalChannels; c++) {
+            // Channels of each device pair up separately
+            const bool second = c >= recordingChannels;
+            const int deviceChannels =
+               second ? (int)aggregateChannels : recordingChannels;
+            const int deviceChannel = second ? c - recordingChannels : c;
+
             std::shared_ptr<WaveTrack> newTrack{
                p->GetTrackFactory()->NewWaveTrack().release()
             };
@@ -1093,11 +1098,11 @@ void ControlToolBar::OnRecord(wxCommandEvent &evt)
                newTrack->SetName(baseTrackName + wxT("_") + nameSuffix);
             }
 
-            if (recordingChannels > 2)
+            if (totalChannels > 2)
               newTrack->SetMinimized(true);
 
-            if (recordingChannels == 2) {
-               if (c == 0) {
+            if (deviceChannels == 2) {
+               if (deviceChannel == 0) {
                   newTrack->SetChannel(Track::LeftChannel);
                   newTrack->SetLinked(true);
                }
@@ -1115,6 +1120,7 @@ void ControlToolBar::OnRecord(wxCommandEvent &evt)
       }
 
       AudioIOStartStreamOptions options(p->GetDefaultPlayOptions());
+      options.aggregateChannels = aggregateChannels;
       int token = gAudioIO->StartStream(playbackTracks,
                                         recordingTracks,
                                         t0, t1, options);
@@ -1139,6 +1145,87 @@ void ControlToolBar::OnRecord(wxCommandEvent &evt)
 }
 
 
+void ControlToolBar::OnPunch()
+// STRONG-GUARANTEE (for state of current project's tracks)
+{
+   AudacityProject *p = GetActiveProject();
+   if (!p || gAudioIO->IsBusy())
+      return;
+
+   const double punchIn = p->GetSel0();
+   const double punchOut =
+      p->GetSel1() > punchIn ? p->GetSel1() : DBL_MAX;
+   double preRoll, postRoll;
+   gPrefs->Read(wxT("/AudioIO/PunchPreRoll"), &preRoll, 2.0);
+   gPrefs->Read(wxT("/AudioIO/PunchPostRoll"), &postRoll, 1.0);
+   const double t0 = std::max(0.0, punchIn - std::max(0.0, preRoll));
+   const double t1 = punchOut == DBL_MAX
+      ? DBL_MAX
+      : punchOut + std::max(0.0, postRoll);
+
+   // The takes are recorded from the start of the pre-roll, apart from the
+   // project; StopStream() cuts them at the punch-in and punch-out and
+   // pastes them over the punched tracks
+   const int recordingChannels =
+      gPrefs->Read(wxT("/AudioIO/RecordChannels"), 2);
+   WaveTrackArray punchTracks, takes;
+   TrackListIterator it(p->GetTracks());
+   for (Track *tt = it.First(); tt; tt = it.Next()) {
+      if (tt->GetKind() != Track::Wave || !tt->GetSelected())
+         continue;
+      punchTracks.push_back(Track::Pointer<WaveTrack>(tt));
+      std::shared_ptr<WaveTrack> take{
+         p->GetTrackFactory()->NewWaveTrack().release()
+      };
+      take->SetOffset(t0);
+      takes.push_back(take);
+      if ((int)takes.size() >= recordingChannels)
+         break;
+   }
+   if (takes.empty())
+      return;
+
+   WaveTrackConstArray playbackTracks;
+   bool duplex;
+   gPrefs->Read(wxT("/AudioIO/Duplex"), &duplex, true);
+   if (duplex) {
+      playbackTracks = p->GetTracks()->GetWaveTrackConstArray(false);
+      // With no pre-roll, the punched tracks have nothing to play
+      if (t0 >= punchIn)
+         for (const auto &punched : punchTracks) {
+            auto end = playbackTracks.end();
+            auto iter = std::find(playbackTracks.begin(), end, punched);
+            if (iter != end)
+               playbackTracks.erase(iter);
+         }
+   }
+
+   SetRecord(true);
+   AudioIOStartStreamOptions options(p->GetDefaultPlayOptions());
+   options.punchTracks = punchTracks;
+   options.punchIn = punchIn;
+   options.punchOut = punchOut;
+   int token = gAudioIO->StartStream(playbackTracks, takes, t0, t1, options);
+
+   if (token != 0) {
+      p->SetAudioIOToken(token);
+      mBusyProject = p;
+
+      StartScrollingIfPreferred();
+   }
+   else {
+      SetPlay(false);
+      SetStop(false);
+      SetRecord(false);
+
+      // Show error message if stream could not be opened
+      ShowErrorDialog(this, _("Error"),
+                      _("Error opening sound device.\nTry changing the audio host, recording device and the project sample rate."),
+                      wxT("Error_opening_sound_device"));
+   }
+   UpdateStatusBar(p);
+}
+
 void ControlToolBar::OnPause(wxCommandEvent & WXUNUSED(evt))
 {
    if (!CanStopAudioStream()) {
@@ -1187,57 +1274,6 @@ void ControlToolBar::OnFF(wxCommandEvent & WXUNUSED(evt))
    }
 }
 
-void ControlToolBar::SetupCutPreviewTracks(double WXUNUSED(playStart), double cutStart,
-                                           double cutEnd, double  WXUNUSED(playEnd))
-
-// STRONG-GUARANTEE (for state of mCutPreviewTracks)
-{
-   ClearCutPreviewTracks();
-   AudacityProject *p = GetActiveProject();
-   if (p) {
-      // Find first selected track (stereo or mono) and duplicate it
-      const Track *track1 = NULL, *track2 = NULL;
-      TrackListIterator it(p->GetTracks());
-      for (Track *t = it.First(); t; t = it.Next())
-      {
-         if (t->GetSelected() && (t->GetKind() == Track::Wave))
-         {
-            track1 = t;
-            track2 = t->GetLink();
-            break;
-         }
-      }
-
-      if (track1)
-      {
-         // Duplicate and change tracks
-         // Clear has a very small chance of throwing
-         auto new1 = track1->Duplicate();
-         new1->Clear(cutStart, cutEnd);
-         decltype(new1) new2{};
-         if (track2)
-         {
-            new2 = track2->Duplicate();
-            new2->Clear(cutStart, cutEnd);
-         }
-
-         // use NOTHROW-GUARANTEE:
-
-         mCutPreviewTracks = TrackList::Create();
-         mCutPreviewTracks->Add(std::move(new1));
-         if (track2)
-            mCutPreviewTracks->Add(std::move(new2));
-      }
-   }
-}
-
-void ControlToolBar::ClearCutPreviewTracks()
-{
-   if (mCutPreviewTracks)
-      mCutPreviewTracks->Clear();
-   mCutPreviewTracks.reset();
-}
-
 // works out the width of the field in the status bar needed for the state (eg play, record pause)
 int ControlToolBar::WidthForStatusBar(wxStatusBar* const sb)
 {
@@ -57,6 +57,9 @@ class ControlToolBar final : public ToolBar {
    void OnPlay(wxCommandEvent & evt);
    void OnStop(wxCommandEvent & evt);
    void OnRecord(wxCommandEvent & evt);
+   // Re-record the selection of the selected wave tracks, after playing the
+   // pre-roll of "/AudioIO/PunchPreRoll" seconds before it
+   void OnPunch();
    void OnFF(wxCommandEvent & evt);
    void OnPause(wxCommandEvent & evt);
 
@@ -130,9 +133,6 @@ class ControlToolBar final : public ToolBar {
                             teBmps eDisabled);
 
    void ArrangeButtons();
-   void SetupCutPreviewTracks(double playStart, double cutStart,
-                             double cutEnd, double playEnd);
-   void ClearCutPreviewTracks();
    wxString StateForStatusBar();
 
    enum
@@ -165,8 +165,6 @@ class ControlToolBar final : public ToolBar {
 
    wxBoxSizer *mSizer;
 
-   std::shared_ptr<TrackList> mCutPreviewTracks;
-
    // strings for status bar
    wxString mStatePlay;
    wxString mStateStop;
@@ -59,6 +59,7 @@ END_EVENT_TABLE()
 DeviceToolBar::DeviceToolBar()
 : ToolBar(DeviceBarID, _("Device"), wxT("Device"), true)
 {
+   DeinitChildren();
 }
 
 DeviceToolBar::~DeviceToolBar()
@@ -81,6 +82,7 @@ void DeviceToolBar::DeinitChildren()
    mOutput        = NULL;
    mInputChannels = NULL;
    mHost          = NULL;
+   mFilled        = false;
 }
 
 void DeviceToolBar::Populate()
@@ -151,11 +153,21 @@ void DeviceToolBar::Populate()
 
    SetNames();
 
-   RefillCombos();
+   // Fill from the devices already scanned; a first scan waits until the
+   // project window is up
+   if (DeviceManager::Instance()->IsScanned())
+      RefillCombos();
+   else
+      CallAfter([this]{ RefillCombos(); });
 }
 
 void DeviceToolBar::RefillCombos()
 {
+   // Not populated yet; Populate() comes back here
+   if (!mHost)
+      return;
+
+   mFilled = true;
    FillHosts();
    FillHostDevices();
    FillInputChannels();
@@ -199,6 +211,10 @@ void DeviceToolBar::OnCaptureKey(wxCommandEvent &event)
 
 void DeviceToolBar::UpdatePrefs()
 {
+   // Not filled yet; RefillCombos() comes back here
+   if (!mFilled)
+      return;
+
    wxString hostName;
    wxString devName;
    wxString sourceName;
@@ -301,7 +317,7 @@ void DeviceToolBar::UpdatePrefs()
 
 void DeviceToolBar::EnableDisableButtons()
 {
-   if (gAudioIO) {
+   if (gAudioIO && mHost) {
       // we allow changes when monitoring, but not when recording
       bool audioStreamActive = gAudioIO->IsStreamActive() && !gAudioIO->IsMonitoring();
 
@@ -325,6 +341,9 @@ void DeviceToolBar::EnableDisableButtons()
 
 void DeviceToolBar::SetNames()
 {
+   if (!mHost)
+      return;
+
    /* i18n-hint: (noun) It's the device used for playback.*/
    mOutput->SetName(_("Playback Device"));
    /* i18n-hint: (noun) It's the device used for recording.*/
@@ -336,6 +355,9 @@ void DeviceToolBar::SetNames()
 void DeviceToolBar::RegenerateTooltips()
 {
 #if wxUSE_TOOLTIPS
+   if (!mHost)
+      return;
+
    SetNames();
    mOutput->SetToolTip(mOutput->GetName() + wxT(" - ") + mOutput->GetStringSelection());
    mInput->SetToolTip(mInput->GetName() + wxT(" - ") + mInput->GetStringSelection());
@@ -347,7 +369,8 @@ void DeviceToolBar::RegenerateTooltips()
 bool DeviceToolBar::Layout()
 {
    bool ret;
-   RepositionCombos();
+   if (mHost)
+      RepositionCombos();
    ret = ToolBar::Layout();
    return ret;
 }
@@ -751,24 +774,36 @@ void DeviceToolBar::OnChoice(wxCommandEvent &event)
 
 void DeviceToolBar::ShowInputDialog()
 {
+   EnsureFilled();
    ShowComboDialog(mInput);
 }
 
 void DeviceToolBar::ShowOutputDialog()
 {
+   EnsureFilled();
    ShowComboDialog(mOutput);
 }
 
 void DeviceToolBar::ShowHostDialog()
 {
+   EnsureFilled();
    ShowComboDialog(mHost);
 }
 
 void DeviceToolBar::ShowChannelsDialog()
 {
+   EnsureFilled();
    ShowComboDialog(mInputChannels);
 }
 
+// The bar may be hidden and not yet populated, or its first fill pending
+void DeviceToolBar::EnsureFilled()
+{
+   EnsurePopulated();
+   if (!mFilled)
+      RefillCombos();
+}
+
 void DeviceToolBar::ShowComboDialog(wxChoice *combo)
 {
    if (!combo || combo->GetCount() == 0) {
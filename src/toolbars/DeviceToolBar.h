@@ -38,6 +38,7 @@ class DeviceToolBar final : public ToolBar {
    void Repaint(wxDC * WXUNUSED(dc)) override {};
    void EnableDisableButtons() override;
    bool Layout() override;
+   bool PopulatesWhenShown() override { return true; }
    void OnFocus(wxFocusEvent &event);
    void OnCaptureKey(wxCommandEvent &event);
 
@@ -65,6 +66,7 @@ class DeviceToolBar final : public ToolBar {
    void RepositionCombos();
    void SetNames();
    void RegenerateTooltips() override;
+   void EnsureFilled();
    void ShowComboDialog(wxChoice *combo);
 
    wxChoice *mInput;
@@ -72,6 +74,9 @@ class DeviceToolBar final : public ToolBar {
    wxChoice *mInputChannels;
    wxChoice *mHost;
 
+   // Whether the combos have been filled from the scanned devices
+   bool mFilled;
+
  public:
 
    DECLARE_CLASS(DeviceToolBar)
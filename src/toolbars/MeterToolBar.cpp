@@ -239,6 +239,8 @@ void MeterToolBar::OnSize( wxSizeEvent & event) //WXUNUSED(event) )
 bool MeterToolBar::Expose( bool show )
 {
    if( show ) {
+      EnsurePopulated();
+
       if( mPlayMeter ) {
          mProject->SetPlaybackMeter( mPlayMeter );
       }
@@ -46,6 +46,7 @@ class MeterToolBar final : public ToolBar {
 
    void OnSize(wxSizeEvent & event);
    bool Expose(bool show) override;
+   bool PopulatesWhenShown() override { return true; }
 
    int GetInitialWidth() override {return (mWhichMeters ==
       (kWithRecordMeter + kWithPlayMeter)) ? 338 : 460;} // Separate bars used to be smaller.
@@ -53,6 +53,7 @@ in which buttons can be placed.
 #include "../widgets/AButton.h"
 #include "../widgets/Grabber.h"
 #include "../Prefs.h"
+#include "../Profiler.h"
 
 ////////////////////////////////////////////////////////////
 /// ToolBarResizer
@@ -325,6 +326,7 @@ ToolBar::ToolBar( int type,
    mParent = NULL;
    mHSizer = NULL;
    mVisible = false;
+   mDeferred = false;
    mPositioned = false;
 
    mGrabber = NULL;
@@ -417,6 +419,9 @@ bool ToolBar::Expose( bool show )
 {
    bool was = mVisible;
 
+   if( show )
+      EnsurePopulated();
+
    SetVisible( show );
 
    if( IsDocked() )
@@ -454,15 +459,35 @@ void ToolBar::Create( wxWindow *parent )
                     GetTitle() );
    wxPanelWrapper::SetLabel( GetLabel() );
 
-   // Go do the rest of the creation
-   ReCreateButtons();
+   // Go do the rest of the creation, unless the bar is hidden and can wait
+   // until it is first shown
+   mDeferred = !mVisible && PopulatesWhenShown();
+   if( !mDeferred )
+      ReCreateButtons();
 
    // ToolManager depends on this appearing to be visible for proper dock construction
    mVisible = true;
 }
 
+void ToolBar::EnsurePopulated()
+{
+   if( !mDeferred )
+      return;
+   mDeferred = false;
+
+   ReCreateButtons();
+
+   // Simulate a size event, as Create() does for bars that lay out on size
+   wxSizeEvent event( GetSize(), GetId() );
+   event.SetEventObject( this );
+   GetEventHandler()->ProcessEvent( event );
+}
+
 void ToolBar::ReCreateButtons()
 {
+   PROFILE_SCOPE("ToolBar::ReCreateButtons");
+   mDeferred = false;
+
    wxSize sz3 = GetSize();
    //wxLogDebug( "x:%i y:%i",sz3.x, sz3.y);
 
@@ -575,6 +600,10 @@ void ToolBar::SetDocked( ToolDock *dock, bool pushed )
    // Remember it
 //   mDock = dock;
 
+   // Not populated yet; ReCreateButtons() sets the state of the grabber
+   if( !mGrabber )
+      return;
+
    // Change the tooltip of the grabber
 #if wxUSE_TOOLTIPS
    mGrabber->SetToolTip( GetTitle() );
@@ -96,6 +96,12 @@ class ToolBar /* not final */ : public wxPanelWrapper
    virtual void UpdatePrefs();
    virtual void RegenerateTooltips() = 0;
 
+   /// Whether Create() may leave a hidden bar empty, to be populated when
+   /// first shown.  Only for bars that nothing reaches into while hidden.
+   virtual bool PopulatesWhenShown() { return false; }
+   /// Populate the bar now, if Create() left it empty
+   void EnsurePopulated();
+
    int GetType();
    wxString GetTitle();
    wxString GetLabel();
@@ -219,6 +225,7 @@ class ToolBar /* not final */ : public wxPanelWrapper
    wxBoxSizer *mHSizer;
 
    bool mVisible;
+   bool mDeferred; // true until populated, if Create() left it empty
    bool mResizable;
    bool mPositioned; // true if position floating determined.
 
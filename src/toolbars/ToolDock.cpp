@@ -662,6 +662,22 @@ void ToolDock::VisitLayout(LayoutVisitor &visitor,
 //
 void ToolDock::LayoutToolBars()
 {
+   // Resizing the window lays out the docks for each size event, though
+   // most leave the width alone
+   LayoutInput input;
+   {
+      int height;
+      GetParent()->GetClientSize( &input.width, &height );
+   }
+   for ( const auto &place : GetConfiguration() ) {
+      auto ct = place.pTree->pBar;
+      input.bars.emplace_back( ct,
+         place.position.rightOf, place.position.below, ct->GetSize() );
+   }
+   if ( mLayoutValid && input == mLastLayout )
+      return;
+   const bool widthChanged = !mLayoutValid || input.width != mLastLayout.width;
+
    struct SizeSetter final : public LayoutVisitor
    {
       SizeSetter (ToolDock *d) : dock{ d } {}
@@ -670,9 +686,11 @@ void ToolDock::LayoutToolBars()
          (ToolBar *bar, wxPoint point)
          override
       {
-         // Place the toolbar
-         if(bar)
+         // Place the toolbar, if it moved; moving it repaints it
+         if(bar && bar->GetPosition() != point) {
             bar->SetPosition( point );
+            moved = true;
+         }
       }
 
       bool ShouldVisitSpaces() override
@@ -685,14 +703,20 @@ void ToolDock::LayoutToolBars()
          override
       {
          // Set the final size of the dock window
-         dock->SetMinSize( rect.GetSize() );
+         if (dock->GetMinSize() != rect.GetSize()) {
+            dock->SetMinSize( rect.GetSize() );
+            moved = true;
+         }
       }
 
       ToolDock *dock;
+      bool moved { false };
    } sizeSetter {
       this
    };
    VisitLayout(sizeSetter, &mWrappedConfiguration);
+   mLastLayout = std::move( input );
+   mLayoutValid = true;
 
    // Set tab order
    {
@@ -705,8 +729,10 @@ void ToolDock::LayoutToolBars()
       }
    }
 
-   // Clean things up
-   Refresh( false );
+   // Redraw the gap lines, which reach to the right edge, only if the
+   // bars or the edge moved
+   if ( sizeSetter.moved || widthChanged )
+      Refresh( false );
 }
 
 // Determine the position where a NEW bar would be placed
@@ -815,6 +841,7 @@ void ToolDock::WrapConfiguration(ToolBarConfiguration &backup)
    backup.Clear();
    backup.Swap(mConfiguration);
    mConfiguration.Swap(mWrappedConfiguration);
+   mLayoutValid = false;
 }
 
 void ToolDock::RestoreConfiguration(ToolBarConfiguration &backup)
@@ -822,6 +849,8 @@ void ToolDock::RestoreConfiguration(ToolBarConfiguration &backup)
    mWrappedConfiguration.Clear();
    mWrappedConfiguration.Swap(mConfiguration);
    mConfiguration.Swap(backup);
+   // The wrapped configuration is no longer what the last layout made
+   mLayoutValid = false;
 }
 
 //
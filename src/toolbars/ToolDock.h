@@ -13,6 +13,7 @@
 #ifndef __AUDACITY_TOOLDOCK__
 #define __AUDACITY_TOOLDOCK__
 
+#include <tuple>
 #include <vector>
 #include "../MemoryX.h" // for std::move
 #include <wx/defs.h>
@@ -343,6 +344,19 @@ public:
 
    ToolBar *mBars[ ToolBarCount ];
 
+   // What the last layout was made from: the width of the parent, and each
+   // bar with its place in the configuration and its size.  A layout from
+   // the same again would move nothing, so it is skipped.
+   struct LayoutInput {
+      int width { -1 };
+      std::vector< std::tuple< ToolBar*, ToolBar*, ToolBar*, wxSize > > bars;
+
+      bool operator == (const LayoutInput &other) const
+      { return width == other.width && bars == other.bars; }
+   };
+   LayoutInput mLastLayout;
+   bool mLayoutValid { false };
+
  public:
 
    DECLARE_CLASS( ToolDock )
@@ -60,6 +60,7 @@
 #include "../AllThemeResources.h"
 #include "../AudioIO.h"
 #include "../Prefs.h"
+#include "../Profiler.h"
 #include "../Project.h"
 #include "../Theme.h"
 #include "../widgets/AButton.h"
@@ -324,6 +325,7 @@ END_EVENT_TABLE()
 ToolManager::ToolManager( AudacityProject *parent, wxWindow *topDockParent )
 : wxEvtHandler()
 {
+   PROFILE_SCOPE("ToolManager::ToolManager");
    wxPoint pt[ 3 ];
 
 #if defined(__WXMAC__)
@@ -601,6 +603,7 @@ int ToolManager::FilterEvent(wxEvent &event)
 //
 void ToolManager::ReadConfig()
 {
+   PROFILE_SCOPE("ToolManager::ReadConfig");
    wxString oldpath = gPrefs->GetPath();
    std::vector<int> unordered[ DockCount ];
    std::vector<ToolBar*> dockedAndHidden;
@@ -736,6 +739,9 @@ void ToolManager::ReadConfig()
          // Create the bar (with the top dock being temporary parent)
          bar->Create( mTopDock );
 
+         // The floater sizes itself to the bar, hidden or not
+         bar->EnsurePopulated();
+
          // Construct a NEW floater
          wxASSERT(mParent);
          ToolFrame *f = safenew ToolFrame( mParent, this, bar, wxPoint( x, y ) );
@@ -94,6 +94,7 @@ enum {
 
    OnWaveformID,
    OnWaveformDBID,
+   OnSpectrumID,
 
    OnChannelLeftID,
    OnChannelRightID,
@@ -579,6 +580,8 @@ void WaveTrackMenuTable::InitMenu(Menu *pMenu, void *pUserData)
 		   checkedIds.push_back(OnWaveformDBID);
 	   }
    }
+   else if (display == WaveTrack::Spectrum)
+      checkedIds.push_back(OnSpectrumID);
 
    const bool isMono = !pTrack->GetLink();
    if ( isMono )
@@ -617,6 +620,7 @@ BEGIN_POPUP_MENU(WaveTrackMenuTable)
 
    POPUP_MENU_RADIO_ITEM(OnWaveformID, _("Wa&veform"), OnSetDisplay)
    POPUP_MENU_RADIO_ITEM(OnWaveformDBID, _("&Waveform (dB)"), OnSetDisplay)
+   POPUP_MENU_RADIO_ITEM(OnSpectrumID, _("&Spectrogram"), OnSetDisplay)
    POPUP_MENU_SEPARATOR()
 
    POPUP_MENU_ITEM(OnSwapChannelsID, _("Swap Stereo &Channels"), OnSwapChannels)
@@ -638,7 +642,7 @@ END_POPUP_MENU()
 void WaveTrackMenuTable::OnSetDisplay(wxCommandEvent & event)
 {
    int idInt = event.GetId();
-   wxASSERT(idInt >= OnWaveformID && idInt <= OnWaveformDBID);
+   wxASSERT(idInt >= OnWaveformID && idInt <= OnSpectrumID);
    WaveTrack *const pTrack = static_cast<WaveTrack*>(mpData->pTrack);
    wxASSERT(pTrack && pTrack->GetKind() == Track::Wave);
 
@@ -650,6 +654,8 @@ void WaveTrackMenuTable::OnSetDisplay(wxCommandEvent & event)
       linear = true, id = WaveTrack::Waveform; break;
    case OnWaveformDBID:
       id = WaveTrack::Waveform; break;
+   case OnSpectrumID:
+      id = WaveTrack::Spectrum; break;
    }
 
    const bool wrongType = pTrack->GetDisplay() != id;
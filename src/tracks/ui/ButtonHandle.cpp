@@ -16,6 +16,7 @@ Paul Licameli
 #include "../../HitTestResult.h"
 #include "../../Project.h"
 #include "../../RefreshCode.h"
+#include "../../TrackPanel.h"
 #include "../../Track.h"
 #include "../../TrackPanelMouseEvent.h"
 #include "../ui/TrackControls.h"
@@ -53,7 +54,8 @@ UIHandle::Result ButtonHandle::Click
       mWasIn = true;
       mIsClicked = true;
       // Toggle visible button state
-      return RefreshCell;
+      pProject->GetTrackPanel()->RefreshArea(mRect);
+      return RefreshNone;
    }
    else
       return Cancelled;
@@ -69,9 +71,10 @@ UIHandle::Result ButtonHandle::Drag
       return Cancelled;
 
    auto isIn = mRect.Contains(event.m_x, event.m_y);
-   auto result = (isIn == mWasIn) ? RefreshNone : RefreshCell;
+   if (isIn != mWasIn)
+      pProject->GetTrackPanel()->RefreshArea(mRect);
    mWasIn = isIn;
-   return result;
+   return RefreshNone;
 }
 
 HitTestPreview ButtonHandle::Preview
@@ -391,8 +391,9 @@ UIHandle::Result SelectHandle::Click
 
       pProject->ModifyState();
 
-      // Do not start a drag
-      return RefreshAll | UpdateSelection | Cancelled;
+      // Do not start a drag; TrackPanel repaints the tracks whose
+      // selection changed
+      return UpdateSelection | Cancelled;
    }
    else if (!event.LeftDown())
       return Cancelled;
@@ -452,9 +453,9 @@ UIHandle::Result SelectHandle::Click
       // Get timer events so we can auto-scroll
       Connect(pProject);
 
-      // Full refresh since the label area may need to indicate
-      // newly selected tracks.
-      return RefreshAll | UpdateSelection;
+      // TrackPanel repaints just the tracks newly selected or deselected,
+      // label areas and all, and the bands where the times moved.
+      return UpdateSelection;
    }
 
    // II. Unmodified click starts a NEW selection
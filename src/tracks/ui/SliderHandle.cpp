@@ -14,6 +14,7 @@ Paul Licameli
 #include "../../HitTestResult.h"
 #include "../../Project.h"
 #include "../../RefreshCode.h"
+#include "../../TrackPanel.h"
 #include "../../TrackPanelMouseEvent.h"
 
 SliderHandle::SliderHandle
@@ -56,7 +57,9 @@ UIHandle::Result SliderHandle::Click
       return result | RefreshCell | Cancelled;
    else {
       mIsClicked = true;
-      return result | RefreshCell;
+      // Only the slider looks different
+      pProject->GetTrackPanel()->RefreshArea(mRect);
+      return result;
    }
 }
 
@@ -68,8 +71,11 @@ UIHandle::Result SliderHandle::Drag
    GetSlider( pProject )->OnMouseEvent(event);
    const float newValue = GetSlider( pProject )->Get();
 
+   // Only the slider looks different
+   pProject->GetTrackPanel()->RefreshArea(mRect);
+
    // Make a non-permanent change to the project data:
-   return RefreshCell | SetValue(pProject, newValue);
+   return SetValue(pProject, newValue);
 }
 
 HitTestPreview SliderHandle::Preview
@@ -67,6 +67,32 @@ void BackedPanel::DisplayBitmap(wxDC &dc)
    RepairBitmap(dc, 0, 0, mBacking->GetWidth(), mBacking->GetHeight());
 }
 
+bool BackedPanel::ScrollBacking(const wxRect &rect, int dx)
+{
+   const int width = rect.width - abs(dx);
+   if (mResizeBacking || width <= 0)
+      return false;
+   if (dx == 0)
+      return true;
+
+   const int srcX = dx > 0 ? rect.x : rect.x - dx;
+   const int destX = dx > 0 ? rect.x + dx : rect.x;
+
+   // Through another bitmap, because not every port blits correctly
+   // between overlapping areas of one DC
+   if (!mScratch ||
+       mScratch->GetWidth() < width || mScratch->GetHeight() < rect.height) {
+      mScratch = std::make_unique<wxBitmap>();
+      mScratch->Create(width, rect.height);
+   }
+   wxMemoryDC scratchDC;
+   scratchDC.SelectObject(*mScratch);
+   scratchDC.Blit(0, 0, width, rect.height, &mBackingDC, srcX, rect.y);
+   mBackingDC.Blit(destX, rect.y, width, rect.height, &scratchDC, 0, 0);
+   scratchDC.SelectObject(wxNullBitmap);
+   return true;
+}
+
 void BackedPanel::OnSize(wxSizeEvent & /* event */)
 {
    // Tell OnPaint() to recreate the backing bitmap
@@ -32,11 +32,18 @@ public:
 
    void DisplayBitmap(wxDC &dc);
 
+   // Move the pixels within rect of the backing bitmap dx to the right,
+   // or left if negative, as when the view scrolls.  The uncovered
+   // columns keep what they had.  False if the bitmap is to be created
+   // again anyway, or nothing would be left.
+   bool ScrollBacking(const wxRect &rect, int dx);
+
    void OnSize(wxSizeEvent & event);
 
 private:
    std::unique_ptr<wxBitmap> mBacking;
    wxMemoryDC mBackingDC;
+   std::unique_ptr<wxBitmap> mScratch;
    bool mResizeBacking {};
    
    DECLARE_EVENT_TABLE()
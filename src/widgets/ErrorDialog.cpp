@@ -38,6 +38,7 @@
 #include "../ShuttleGui.h"
 #include "../HelpText.h"
 #include "../Internat.h"
+#include "../AudacityApp.h"
 #include "../Project.h"
 #include "../Prefs.h"
 #include "HelpSystem.h"
@@ -139,12 +140,27 @@ void ErrorDialog::OnHelp(wxCommandEvent & WXUNUSED(event))
       EndModal(true);
 }
 
+namespace {
+
+bool ReportHeadless(const wxString &dlogTitle, const wxString &message)
+{
+   if (!wxGetApp().IsHeadless())
+      return false;
+   wxFprintf(stderr, wxT("%s: %s\n"), dlogTitle, message);
+   return true;
+}
+
+}
+
 void ShowErrorDialog(wxWindow *parent,
                      const wxString &dlogTitle,
                      const wxString &message,
                      const wxString &helpPage,
                      const bool Close)
 {
+   if (ReportHeadless(dlogTitle, message))
+      return;
+
    ErrorDialog dlog(parent, dlogTitle, message, helpPage, Close);
    dlog.CentreOnParent();
    dlog.ShowModal();
@@ -158,6 +174,9 @@ void ShowModelessErrorDialog(wxWindow *parent,
                              const wxString &helpPage,
                              const bool Close)
 {
+   if (ReportHeadless(dlogTitle, message))
+      return;
+
    // ensure it has some parent.
    if( !parent )
       parent = wxTheApp->GetTopWindow();
@@ -177,6 +196,9 @@ void ShowAliasMissingDialog(AudacityProject *parent,
                             const wxString &helpPage,
                             const bool Close)
 {
+   if (ReportHeadless(dlogTitle, message))
+      return;
+
    wxASSERT(parent); // to justify safenew
    ErrorDialog *dlog = safenew AliasedFileMissingDialog(parent, dlogTitle, message, helpPage, Close, false);
    // Don't center because in many cases (effect, export, etc) there will be a progress bar in the center that blocks this.
@@ -203,3 +225,16 @@ extern wxString AudacityMessageBoxCaptionStr()
 {
    return _("Message");
 }
+
+int AudacityMessageBox(const wxString& message, const wxString& caption,
+   long style, wxWindow *parent, int x, int y)
+{
+   if (ReportHeadless(caption, message)) {
+      if (style & wxCANCEL)
+         return wxCANCEL;
+      if (style & wxNO)
+         return wxNO;
+      return wxOK;
+   }
+   return ::wxMessageBox(message, caption, style, parent, x, y);
+}
@@ -89,14 +89,13 @@ void ShowAliasMissingDialog(AudacityProject *parent,
 extern wxString AudacityMessageBoxCaptionStr();
 
 // Do not use wxMessageBox!!  Its default window title does not translate!
-inline int AudacityMessageBox(const wxString& message,
+// When headless, the message goes to stderr, and the answer is the one that
+// changes least: Cancel if offered, else No if offered, else OK.
+AUDACITY_DLL_API int AudacityMessageBox(const wxString& message,
    const wxString& caption = AudacityMessageBoxCaptionStr(),
    long style = wxOK | wxCENTRE,
    wxWindow *parent = NULL,
-   int x = wxDefaultCoord, int y = wxDefaultCoord)
-{
-   return ::wxMessageBox(message, caption, style, parent, x, y);
-}
+   int x = wxDefaultCoord, int y = wxDefaultCoord);
 
 
 #include <wx/textdlg.h>
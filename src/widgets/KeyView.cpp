@@ -26,6 +26,9 @@
 #include <wx/dc.h>
 #include "../Internat.h"
 
+#include <algorithm>
+#include <numeric>
+
 // Various drawing constants
 #define KV_BITMAP_SIZE 16
 #define KV_LEFT_MARGIN 2
@@ -47,6 +50,39 @@ END_EVENT_TABLE();
 
 wxString    KeyView::CommandTranslated="Command";
 
+namespace {
+
+// Fill in the text of the node that is worked out from its label, prefix
+// and key
+void UpdateNodeText(KeyNode & node)
+{
+   const wxString display = node.key.Display();
+   const wxString prefixed = node.prefix.IsEmpty()
+      ? node.label
+      : node.prefix + wxT(" - ") + node.label;
+
+   node.nameSearch = node.label.Lower();
+   node.keySearch = display.Lower();
+
+   // The x"01" separator is used to prevent finding a
+   // match comprising the end of the label and beginning
+   // of the key.  It was chosen since it's not very likely
+   // to appear in the filter itself.
+   node.treeSearch = node.nameSearch + wxT("\01x") + node.keySearch;
+
+   node.nameOrder = prefixed;
+
+   // Unassigned keys sort after all others; see CmpKeyNodeByKey()
+   node.keyOrder = display.IsEmpty() ? wxString(wxT("\xff")) : display;
+   if (!node.prefix.IsEmpty())
+   {
+      node.keyOrder += node.prefix + wxT(" - ");
+   }
+   node.keyOrder += node.label;
+}
+
+}
+
 
 // ============================================================================
 // KeyView class
@@ -57,7 +93,9 @@ KeyView::KeyView(wxWindow *parent,
                  const wxSize & size)
 : wxVListBox(parent, id, pos, size, wxBORDER_THEME | wxHSCROLL | wxVSCROLL),
   mScrollX(0),
-  mWidth(0)
+  mWidth(0),
+  mMatchView(ViewByTree),
+  mMatchesValid(false)
 {
 #if wxUSE_ACCESSIBILITY
    // Create and set accessibility object
@@ -271,11 +309,14 @@ KeyView::SetKey(int index, const NormalizedKeyString & key)
 
    // Set the NEW key
    node.key = key;
+   UpdateNodeText(node);
+
+   // What the filter matched may have changed
+   mMatchesValid = false;
 
    // Check to see if the key column needs to be expanded
-   int x, y;
-   GetTextExtent(node.key.Display(), &x, &y);
-   if (x > mKeyWidth || y > mLineHeight)
+   wxSize size = MeasureText(node.key.Display());
+   if (size.x > mKeyWidth || size.y > mLineHeight)
    {
       // New key is wider than column so recalc extents (will refresh view)
       RecalcExtents();
@@ -441,45 +482,67 @@ KeyView::RecalcExtents()
    for (int i = 0; i < cnt; i++)
    {
       KeyNode & node = mNodes[i];
-      int x, y;
+      wxSize size;
 
       if (node.iscat)
       {
          // Measure the category
-         GetTextExtent(node.category, &x, &y);
+         size = MeasureText(node.category);
       }
       else if (node.ispfx)
       {
          // Measure the prefix
-         GetTextExtent(node.prefix, &x, &y);
+         size = MeasureText(node.prefix);
       }
       else
       {
          // Measure the key
-         GetTextExtent(node.key.Display(), &x, &y);
-         mLineHeight = wxMax(mLineHeight, y);
-         mKeyWidth = wxMax(mKeyWidth, x);
-
-         // Prepend prefix for view types other than tree
-         wxString label = node.label;
-         if (mViewType != ViewByTree && !node.prefix.IsEmpty())
-         {
-            label = node.prefix + wxT(" - ") + label;
-         }
-
-         // Measure the label
-         GetTextExtent(label, &x, &y);
+         size = MeasureText(node.key.Display());
+         mLineHeight = wxMax(mLineHeight, size.y);
+         mKeyWidth = wxMax(mKeyWidth, size.x);
+
+         // Measure the label, after the prefix for view types other
+         // than tree
+         size = MeasureText(
+            mViewType != ViewByTree ? node.nameOrder : node.label);
       }
 
       // Finish calc for command column
-      mLineHeight = wxMax(mLineHeight, y);
-      mCommandWidth = wxMax(mCommandWidth, x);
+      mLineHeight = wxMax(mLineHeight, size.y);
+      mCommandWidth = wxMax(mCommandWidth, size.x);
    }
 
    // Update horizontal scrollbar
    UpdateHScroll();
 }
 
+//
+// Measure text in the font of the view, remembering the result, since
+// the same labels and keys are measured again whenever the bindings or
+// the view change
+//
+wxSize
+KeyView::MeasureText(const wxString & text)
+{
+   const wxFont & font = GetFont();
+   if (!mExtentFont.IsOk() || font != mExtentFont || mExtents.size() >= 5000)
+   {
+      mExtents.clear();
+      mExtentFont = font;
+   }
+
+   auto iter = mExtents.find(text);
+   if (iter != mExtents.end())
+   {
+      return iter->second;
+   }
+
+   wxSize size;
+   GetTextExtent(text, &size.x, &size.y);
+   mExtents[text] = size;
+   return size;
+}
+
 //
 // Update the horizontal scrollbar or remove it if not needed
 //
@@ -527,6 +590,7 @@ KeyView::RefreshBindings(const wxArrayString & names,
 {
    // Start clean
    mNodes.clear();
+   mMatchesValid = false;
 
    // Same as in RecalcExtents() but do it inline
    mLineHeight = 0;
@@ -545,7 +609,7 @@ KeyView::RefreshBindings(const wxArrayString & names,
    for (int i = 0; i < cnt; i++)
    {
       wxString name = names[i];
-      int x, y;
+      wxSize size;
 
       // Remove any menu code from the category and prefix
       wxString cat = wxMenuItem::GetLabelText(categories[i]);
@@ -593,15 +657,16 @@ KeyView::RefreshBindings(const wxArrayString & names,
             node.isparent = true;
             node.depth = depth++;
             node.isopen = true;
+            UpdateNodeText(node);
 
             // Add it to the tree
             mNodes.push_back(node);
             incat = true;
 
             // Measure category
-            GetTextExtent(cat, &x, &y);
-            mLineHeight = wxMax(mLineHeight, y);
-            mCommandWidth = wxMax(mCommandWidth, x);
+            size = MeasureText(cat);
+            mLineHeight = wxMax(mLineHeight, size.y);
+            mCommandWidth = wxMax(mCommandWidth, size.x);
          }
       }
 
@@ -631,27 +696,21 @@ KeyView::RefreshBindings(const wxArrayString & names,
       node.key = keys[i];
       node.index = nodecnt++;
       node.depth = depth;
+      UpdateNodeText(node);
 
       // Add it to the tree
       mNodes.push_back(node);
 
       // Measure key
-      GetTextExtent(node.key.Display(), &x, &y);
-      mLineHeight = wxMax(mLineHeight, y);
-      mKeyWidth = wxMax(mKeyWidth, x);
-
-      // Prepend prefix for all view types to determine maximum
-      // column widths
-      wxString label = node.label;
-      if (!node.prefix.IsEmpty())
-      {
-         label = node.prefix + wxT(" - ") + label;
-      }
+      size = MeasureText(node.key.Display());
+      mLineHeight = wxMax(mLineHeight, size.y);
+      mKeyWidth = wxMax(mKeyWidth, size.x);
 
-      // Measure label
-      GetTextExtent(label, &x, &y);
-      mLineHeight = wxMax(mLineHeight, y);
-      mCommandWidth = wxMax(mCommandWidth, x);
+      // Measure label, after the prefix for all view types to
+      // determine maximum column widths
+      size = MeasureText(node.nameOrder);
+      mLineHeight = wxMax(mLineHeight, size.y);
+      mCommandWidth = wxMax(mCommandWidth, size.x);
    }
 
    // Update horizontal scrollbar
@@ -677,53 +736,71 @@ KeyView::RefreshLines(bool bSort)
    int linecnt = 0;
    mLines.clear();
 
+   // Reset line numbers; a node with one has been added to mLines
+   for (auto & node : mNodes)
+   {
+      node.line = wxNOT_FOUND;
+   }
+
    // Process a filter if one is set
    if (!mFilter.IsEmpty())
    {
-      // Examine all nodes
-      for (int i = 0; i < cnt; i++)
+      // A filter holding the last one can match only nodes that it
+      // matched, so when typing goes on only those are searched
+      std::vector<int> candidates;
+      if (mMatchesValid && mMatchView == mViewType &&
+          mFilter.Contains(mMatchFilter))
       {
-         KeyNode & node = mNodes[i];
+         candidates.swap(mMatches);
+      }
+      else
+      {
+         candidates.resize(cnt);
+         std::iota(candidates.begin(), candidates.end(), 0);
+      }
+      mMatches.clear();
+      mMatchFilter = mFilter;
+      mMatchView = mViewType;
+      mMatchesValid = true;
 
-         // Reset line number
-         node.line = wxNOT_FOUND;
+      // Examine the candidate nodes
+      for (int i : candidates)
+      {
+         KeyNode & node = mNodes[i];
 
          // Search columns based on view type
-         wxString searchit;
+         const wxString *searchit = nullptr;
          switch (mViewType)
          {
-            // The x"01" separator is used to prevent finding a
-            // match comprising the end of the label and beginning
-            // of the key.  It was chosen since it's not very likely
-            // to appear in the filter itself.
             case ViewByTree:
-               searchit = node.label.Lower() +
-                          wxT("\01x") +
-                          node.key.Display().Lower();
+               searchit = &node.treeSearch;
             break;
 
             case ViewByName:
-               searchit = node.label.Lower();
+               searchit = &node.nameSearch;
             break;
 
             case ViewByKey:
-               searchit = node.key.Display().Lower();
+               searchit = &node.keySearch;
             break;
          }
-         if (searchit.Find(mFilter) == wxNOT_FOUND)
+         if (searchit->Find(mFilter) == wxNOT_FOUND)
          {
             // Not found so continue to next node
             continue;
          }
 
+         // Remember it for the next filter
+         mMatches.push_back(i);
+
          // For the Key View, if the filter is a single character,
          // then it has to be the last character in the searchit string,
          // and be preceded by nothing or +.
          if ((mViewType == ViewByKey) && 
                (mFilter.Len() == 1) && 
-               (!mFilter.IsSameAs(searchit.Last()) ||
-                  ((searchit.Len() > 1) && 
-                     ((wxString)(searchit.GetChar(searchit.Len() - 2)) != wxT("+")))))
+               (!mFilter.IsSameAs(searchit->Last()) ||
+                  ((searchit->Len() > 1) && 
+                     ((wxString)(searchit->GetChar(searchit->Len() - 2)) != wxT("+")))))
          {
             // Not suitable so continue to next node
             continue;
@@ -753,24 +830,11 @@ KeyView::RefreshLines(bool bSort)
                // Found a parent
                if (mNodes[j].depth < depth)
                {
-                  // Examine all previously added nodes to see if this nodes
-                  // ancestors need to be added prior to adding this node.
-                  bool found = false;
-                  for (int k = (int) mLines.size() - 1; k >= 0; k--)
-                  {
-                     // The node indexes match, so we've found the parent of the
-                     // child node.
-                     if (mLines[k]->index == mNodes[j].index)
-                     {
-                        found = true;
-                        break;
-                     }
-                  }
-
-                  // The parent wasn't found so remember it for later
-                  // addition.  Can't add directory to mLines here since
-                  // they will wind up in reverse order.
-                  if (!found)
+                  // The parent has a line number if it was added already;
+                  // if not, remember it for later addition.  Can't add
+                  // directory to mLines here since they will wind up in
+                  // reverse order.
+                  if (mNodes[j].line == wxNOT_FOUND)
                   {
                      queue.push_back(&mNodes[j]);
                   }
@@ -802,9 +866,6 @@ KeyView::RefreshLines(bool bSort)
       {
          KeyNode & node = mNodes[i];
 
-         // Reset line number
-         node.line = wxNOT_FOUND;
-
          // Node is either a category or prefix
          if (node.isparent)
          {
@@ -1516,22 +1577,8 @@ KeyView::CmpKeyNodeByTree(KeyNode *t1, KeyNode *t2)
 bool
 KeyView::CmpKeyNodeByName(KeyNode *t1, KeyNode *t2)
 {
-   wxString k1 = t1->label;
-   wxString k2 = t2->label;
-
-   // Prepend prefix if available
-   if (!t1->prefix.IsEmpty())
-   {
-      k1 = t1->prefix + wxT(" - ") + k1;
-   }
-
-   // Prepend prefix if available
-   if (!t2->prefix.IsEmpty())
-   {
-      k2 = t2->prefix + wxT(" - ") + k2;
-   }
-
-   return (k1 < k2);
+   // The label, after the prefix if available
+   return (t1->nameOrder < t2->nameOrder);
 }
 
 //
@@ -1550,38 +1597,9 @@ KeyView::CmpKeyNodeByName(KeyNode *t1, KeyNode *t2)
 bool
 KeyView::CmpKeyNodeByKey(KeyNode *t1, KeyNode *t2)
 {
-   wxString k1 = t1->key.Display();
-   wxString k2 = t2->key.Display();
-
-   // Left node is unassigned, so prefix it
-   if(k1.IsEmpty())
-   {
-      k1 = wxT("\xff");
-   }
-
-   // Right node is unassigned, so prefix it
-   if(k2.IsEmpty())
-   {
-      k2 = wxT("\xff");
-   }
-
-   // Add prefix if available
-   if (!t1->prefix.IsEmpty())
-   {
-      k1 += t1->prefix + wxT(" - ");
-   }
-
-   // Add prefix if available
-   if (!t2->prefix.IsEmpty())
-   {
-      k2 += t2->prefix + wxT(" - ");
-   }
-
-   // Add labels
-   k1 += t1->label;
-   k2 += t2->label;
-
-   return (k1 < k2);
+   // The key, or 0xff if unassigned, then the prefix if available, then
+   // the label
+   return (t1->keyOrder < t2->keyOrder);
 }
 
 #if wxUSE_ACCESSIBILITY
@@ -11,8 +11,12 @@
 
 #include "../Audacity.h"
 
+#include <map>
+#include <vector>
+
 #include <wx/defs.h>
 #include <wx/arrstr.h>
+#include <wx/font.h>
 #include <wx/string.h>
 #include <wx/vlbox.h>
 
@@ -42,6 +46,16 @@ public:
    wxString prefix;
    wxString label;
    NormalizedKeyString key;
+
+   // Worked out from the above by KeyView whenever they change, so that
+   // filtering and sorting make no strings: the lower case text that
+   // each view searches, and the keys that views by name and by key sort
+   wxString treeSearch;
+   wxString nameSearch;
+   wxString keySearch;
+   wxString nameOrder;
+   wxString keyOrder;
+
    int index;
    int line;
    int depth;
@@ -113,6 +127,7 @@ private:
    void RecalcExtents();
    void UpdateHScroll();
    void RefreshLines(bool bSort = true);
+   wxSize MeasureText(const wxString & text);
 
    int LineToIndex(int line) const;
    int IndexToLine(int index) const;
@@ -152,6 +167,17 @@ private:
    ViewByType mViewType;
    wxString mFilter;
 
+   // Indexes of the nodes whose text held the filter last time, in order,
+   // so that typing more of it searches only those
+   std::vector<int> mMatches;
+   wxString mMatchFilter;
+   ViewByType mMatchView;
+   bool mMatchesValid;
+
+   // Text extents, kept while the font is the same
+   std::map<wxString, wxSize> mExtents;
+   wxFont mExtentFont;
+
    wxCoord mScrollX;
    wxCoord mWidth;
 
@@ -68,6 +68,7 @@
 #include "../ShuttleGui.h"
 
 #include "../Theme.h"
+#include "../VectorMath.h"
 #include "../AllThemeResources.h"
 #include "../Experimental.h"
 #include "../widgets/valnum.h"
@@ -75,92 +76,108 @@
 static const long MIN_REFRESH_RATE = 1;
 static const long MAX_REFRESH_RATE = 100;
 
-/* Updates to the meter are passed accross via meter updates, each contained in
- * a MeterUpdateMsg object */
-wxString MeterUpdateMsg::toString()
-{
-wxString output;  // somewhere to build up a string in
-output = wxString::Format(wxT("Meter update msg: %i channels, %i samples\n"), \
-      kMaxMeterBars, numFrames);
-for (int i = 0; i<kMaxMeterBars; i++)
-   {  // for each channel of the meters
-   output += wxString::Format(wxT("%f peak, %f rms "), peak[i], rms[i]);
-   if (clipping[i])
-      output += wxString::Format(wxT("clipped "));
-   else
-      output += wxString::Format(wxT("no clip "));
-   output += wxString::Format(wxT("%i head, %i tail\n"), headPeakCount[i], tailPeakCount[i]);
-   }
-return output;
-}
-
-wxString MeterUpdateMsg::toStringIfClipped()
-{
-   for (int i = 0; i<kMaxMeterBars; i++)
-   {
-      if (clipping[i] || (headPeakCount[i] > 0) || (tailPeakCount[i] > 0))
-         return toString();
-   }
-   return wxT("");
-}
-
 //
-// The MeterPanel passes itself messages via this queue so that it can
-// communicate between the audio thread and the GUI thread.
-// This class is as simple as possible in order to be thread-safe
-// without needing mutexes.
+// The audio thread adds the levels of each block here, and the GUI thread
+// takes what has been added at each tick of its timer, however many blocks
+// that was.  Each level is an atomic that the writer raises or adds to and
+// the reader exchanges for zero, so neither side waits on the other.
 //
 
-MeterUpdateQueue::MeterUpdateQueue(size_t maxLen):
-   mBufferSize(maxLen)
+namespace {
+
+void AtomicMax(std::atomic<float> &value, float x)
 {
-   Clear();
+   auto old = value.load(std::memory_order_relaxed);
+   while (old < x &&
+          !value.compare_exchange_weak(old, x, std::memory_order_relaxed))
+      ;
 }
 
-// destructor
-MeterUpdateQueue::~MeterUpdateQueue()
+void AtomicAdd(std::atomic<float> &value, float x)
 {
+   auto old = value.load(std::memory_order_relaxed);
+   while (!value.compare_exchange_weak(old, old + x,
+                                       std::memory_order_relaxed))
+      ;
 }
 
-void MeterUpdateQueue::Clear()
+}
+
+MeterLevels::MeterLevels()
 {
-   mStart = 0;
-   mEnd = 0;
+   for (int j = 0; j < kMaxMeterBars; j++)
+      mPeakRun[j] = 0;
+   mClearRuns.store(false, std::memory_order_relaxed);
+   Clear();
 }
 
-// Add a message to the end of the queue.  Return false if the
-// queue was full.
-bool MeterUpdateQueue::Put(MeterUpdateMsg &msg)
+void MeterLevels::Clear()
 {
-   // mStart can be greater than mEnd because it is all mod mBufferSize
-   wxASSERT( (mEnd + mBufferSize - mStart) >= 0 );
-   int len = (mEnd + mBufferSize - mStart) % mBufferSize;
+   mFrames.store(0, std::memory_order_relaxed);
+   for (int j = 0; j < kMaxMeterBars; j++) {
+      mPeak[j].store(0, std::memory_order_relaxed);
+      mSumSquares[j].store(0, std::memory_order_relaxed);
+      mClipping[j].store(false, std::memory_order_relaxed);
+   }
+   mClearRuns.store(true, std::memory_order_release);
+}
 
-   // Never completely fill the queue, because then the
-   // state is ambiguous (mStart==mEnd)
-   if (len + 1 >= (int)(mBufferSize))
-      return false;
+void MeterLevels::Add(unsigned numChannels, unsigned numBars, int numFrames,
+                      const float *sampleData, int numPeakSamplesToClip)
+{
+   if (numFrames <= 0)
+      return;
 
-   //wxLogDebug(wxT("Put: %s"), msg.toString());
+   if (mClearRuns.exchange(false, std::memory_order_acquire))
+      std::fill(mPeakRun, mPeakRun + kMaxMeterBars, 0);
+
+   const auto num = std::min<unsigned>(
+      std::min(numChannels, numBars), kMaxMeterBars);
+   float peak[kMaxMeterBars], sumSquares[kMaxMeterBars];
+   VectorLevels(sampleData, numFrames, numChannels, num, peak, sumSquares);
+
+   for (unsigned j = 0; j < num; j++) {
+      // Only a block that reaches full scale can hold a run of clipped
+      // samples; look for runs of more than numPeakSamplesToClip, which
+      // may have begun in blocks before
+      if (peak[j] >= MAX_AUDIO) {
+         bool clipping = false;
+         const float *sptr = sampleData + j;
+         for (int i = 0; i < numFrames; i++, sptr += numChannels) {
+            if (fabs(*sptr) >= MAX_AUDIO) {
+               if (++mPeakRun[j] > numPeakSamplesToClip)
+                  clipping = true;
+            }
+            else
+               mPeakRun[j] = 0;
+         }
+         if (clipping)
+            mClipping[j].store(true, std::memory_order_relaxed);
+      }
+      else
+         mPeakRun[j] = 0;
 
-   mBuffer[mEnd] = msg;
-   mEnd = (mEnd+1)%mBufferSize;
+      AtomicMax(mPeak[j], peak[j]);
+      AtomicAdd(mSumSquares[j], sumSquares[j]);
+   }
 
-   return true;
+   mFrames.fetch_add(numFrames, std::memory_order_release);
 }
 
-// Get the next message from the start of the queue.
-// Return false if the queue was empty.
-bool MeterUpdateQueue::Get(MeterUpdateMsg &msg)
+bool MeterLevels::Take(MeterUpdateMsg &msg)
 {
-   int len = (mEnd + mBufferSize - mStart) % mBufferSize;
-
-   if (len == 0)
+   const int frames = mFrames.exchange(0, std::memory_order_acquire);
+   if (frames == 0)
       return false;
 
-   msg = mBuffer[mStart];
-   mStart = (mStart+1)%mBufferSize;
-
+   msg.numFrames = frames;
+   for (int j = 0; j < kMaxMeterBars; j++) {
+      msg.peak[j] = mPeak[j].exchange(0, std::memory_order_relaxed);
+      msg.rms[j] = std::min(msg.peak[j], (float)sqrt(
+         mSumSquares[j].exchange(0, std::memory_order_relaxed) / frames));
+      msg.clipping[j] =
+         mClipping[j].exchange(false, std::memory_order_relaxed);
+   }
    return true;
 }
 
@@ -185,12 +202,10 @@ const static wxChar *PrefStyles[] =
 };
 
 enum {
-   OnMeterUpdateID = 6000,
-   OnMonitorID,
+   OnMonitorID = 6001,
 };
 
 BEGIN_EVENT_TABLE(MeterPanel, wxPanelWrapper)
-   EVT_TIMER(OnMeterUpdateID, MeterPanel::OnMeterUpdate)
    EVT_MOUSE_EVENTS(MeterPanel::OnMouse)
    EVT_CONTEXT_MENU(MeterPanel::OnContext)
    EVT_KEY_DOWN(MeterPanel::OnKeyDown)
@@ -214,7 +229,6 @@ MeterPanel::MeterPanel(AudacityProject *project,
              float fDecayRate /*= 60.0f*/)
 : wxPanelWrapper(parent, id, pos, size, wxTAB_TRAVERSAL | wxNO_BORDER | wxWANTS_CHARS),
    mProject(project),
-   mQueue(1024),
    mWidth(size.x),
    mHeight(size.y),
    mIsInput(isInput),
@@ -320,7 +334,6 @@ MeterPanel::MeterPanel(AudacityProject *project,
       }
    }
 
-   mTimer.SetOwner(this, OnMeterUpdateID);
    // TODO: Yikes.  Hard coded sample rate.
    // JKC: I've looked at this, and it's benignish.  It just means that the meter
    // balistics are right for 44KHz and a bit more frisky than they should be
@@ -330,7 +343,7 @@ MeterPanel::MeterPanel(AudacityProject *project,
 
 void MeterPanel::Clear()
 {
-   mQueue.Clear();
+   mLevels.Clear();
 }
 
 void MeterPanel::UpdatePrefs()
@@ -785,16 +798,16 @@ void MeterPanel::Reset(double sampleRate, bool resetClipping)
       ResetBar(&mBar[j], resetClipping);
    }
 
-   // wxTimers seem to be a little unreliable - sometimes they stop for
-   // no good reason, so this "primes" it every now and then...
-   mTimer.Stop();
+   mFrames.reset();
 
    // While it's stopped, empty the queue
-   mQueue.Clear();
+   mLevels.Clear();
 
    mLayoutValid = false;
 
-   mTimer.Start(1000 / mMeterRefreshRate);
+   // Only the meter of the project playing or recording needs the ticks
+   if (mActive)
+      StartUpdates();
 
    Refresh(false);
 }
@@ -826,50 +839,24 @@ static float ClipZeroToOne(float z)
       return z;
 }
 
-static float ToDB(float v, float range)
+// Converts the peaks and rms of all bars together, in one vector; zero
+// becomes far less than any range, so it still clips to zero
+static void ToDB(float *peak, float *rms, unsigned numBars, float range)
 {
-   double db;
-   if (v > 0)
-      db = LINEAR_TO_DB(fabs(v));
-   else
-      db = -999;
-   return ClipZeroToOne((db + range) / range);
+   float values[2 * kMaxMeterBars];
+   std::copy(peak, peak + numBars, values);
+   std::copy(rms, rms + numBars, values + numBars);
+   VectorLinearToDB(values, values, 2 * numBars);
+   for (unsigned int j = 0; j < numBars; j++) {
+      peak[j] = ClipZeroToOne((values[j] + range) / range);
+      rms[j] = ClipZeroToOne((values[numBars + j] + range) / range);
+   }
 }
 
 void MeterPanel::UpdateDisplay(unsigned numChannels, int numFrames, float *sampleData)
 {
-   float *sptr = sampleData;
-   auto num = std::min(numChannels, mNumBars);
-   MeterUpdateMsg msg;
-
-   memset(&msg, 0, sizeof(msg));
-   msg.numFrames = numFrames;
-
-   for(int i=0; i<numFrames; i++) {
-      for(unsigned int j=0; j<num; j++) {
-         msg.peak[j] = floatMax(msg.peak[j], fabs(sptr[j]));
-         msg.rms[j] += sptr[j]*sptr[j];
-
-         // In addition to looking for mNumPeakSamplesToClip peaked
-         // samples in a row, also send the number of peaked samples
-         // at the head and tail, in case there's a run of peaked samples
-         // that crosses block boundaries
-         if (fabs(sptr[j])>=MAX_AUDIO) {
-            if (msg.headPeakCount[j]==i)
-               msg.headPeakCount[j]++;
-            msg.tailPeakCount[j]++;
-            if (msg.tailPeakCount[j] > mNumPeakSamplesToClip)
-               msg.clipping[j] = true;
-         }
-         else
-            msg.tailPeakCount[j] = 0;
-      }
-      sptr += numChannels;
-   }
-   for(unsigned int j=0; j<mNumBars; j++)
-      msg.rms[j] = sqrt(msg.rms[j]/numFrames);
-
-   mQueue.Put(msg);
+   mLevels.Add(numChannels, mNumBars, numFrames, sampleData,
+               mNumPeakSamplesToClip);
 }
 
 // Vaughan, 2010-11-29: This not currently used. See comments in MixerTrackCluster::UpdateMeter().
@@ -917,36 +904,37 @@ void MeterPanel::UpdateDisplay(unsigned numChannels, int numFrames, float *sampl
 //   mQueue.Put(msg);
 //}
 
-void MeterPanel::OnMeterUpdate(wxTimerEvent & WXUNUSED(event))
+void MeterPanel::StartUpdates()
+{
+   mFrames = FrameClock::Get().Subscribe(1000 / mMeterRefreshRate,
+      [this]{ OnMeterUpdate(); });
+}
+
+void MeterPanel::OnMeterUpdate()
 {
    MeterUpdateMsg msg;
    int numChanges = 0;
 
    // We shouldn't receive any events if the meter is disabled, but clear it to be safe
    if (mMeterDisabled) {
-      mQueue.Clear();
+      mLevels.Clear();
       return;
    }
 
-   // There may have been several update messages since the last
-   // time we got to this function.  Catch up to real-time by
-   // popping them off until there are none left.  It is necessary
-   // to process all of them, otherwise we won't handle peaks and
-   // peak-hold bars correctly.
-   while(mQueue.Get(msg)) {
+   // Take the levels of all the audio since the last time we got to
+   // this function, however many blocks the callback passed meanwhile;
+   // decay and smoothing go by the frames, so they come out as for
+   // separate blocks.
+   if (mLevels.Take(msg)) {
       numChanges++;
       double deltaT = msg.numFrames / mRate;
 
       mT += deltaT;
+      if (mDB)
+         ToDB(msg.peak, msg.rms, mNumBars, mDBRange);
       for(unsigned int j=0; j<mNumBars; j++) {
          mBar[j].isclipping = false;
 
-         //
-         if (mDB) {
-            msg.peak[j] = ToDB(msg.peak[j], mDBRange);
-            msg.rms[j] = ToDB(msg.rms[j], mDBRange);
-         }
-
          if (mDecay) {
             if (mDB) {
                float decayAmount = mDecayRate * deltaT / mDBRange;
@@ -976,16 +964,12 @@ void MeterPanel::OnMeterUpdate(wxTimerEvent & WXUNUSED(event))
          if (mBar[j].peak > mBar[j].peakPeakHold )
             mBar[j].peakPeakHold = mBar[j].peak;
 
-         if (msg.clipping[j] ||
-             mBar[j].tailPeakCount+msg.headPeakCount[j] >=
-             mNumPeakSamplesToClip){
+         if (msg.clipping[j]) {
             mBar[j].clipping = true;
             mBar[j].isclipping = true;
          }
-
-         mBar[j].tailPeakCount = msg.tailPeakCount[j];
       }
-   } // while
+   }
 
    if (numChanges > 0) {
       RepaintBarsNow();
@@ -1024,7 +1008,8 @@ void MeterPanel::ResetBar(MeterBar *b, bool resetClipping)
       b->peakPeakHold = 0.0;
    }
    b->isclipping = false;
-   b->tailPeakCount = 0;
+   // Nothing drawn is current
+   b->drawn = { -1, -1, -1, -1, false };
 }
 
 bool MeterPanel::IsClipping() const
@@ -1421,18 +1406,37 @@ void MeterPanel::HandleLayout(wxDC &dc)
    mLayoutValid = true;
 }
 
+// Where DrawMeterBar() puts each level, as it computes them
+static MeterBar::Pixels BarPixels(const MeterBar &bar)
+{
+   // (h - 1) or (w - 1) corresponds to the mRuler.SetBounds() in HandleLayout()
+   const int len = (bar.vert ? bar.r.GetHeight() : bar.r.GetWidth()) - 1;
+   const auto pos = [=](float value) { return (int)(value * len + 0.5); };
+   return { pos(bar.peak), pos(bar.rms), pos(bar.peakHold),
+            pos(bar.peakPeakHold), bar.clipping };
+}
+
 void MeterPanel::RepaintBarsNow()
 {
    if (mLayoutValid)
    {
-      // Invalidate the bars so they get redrawn
+      // Invalidate only the bars whose levels moved by a pixel, so that
+      // the rest of the meter, and steady bars, are not drawn again
+      bool changed = false;
       for (unsigned int i = 0; i < mNumBars; i++)
       {
-         Refresh(false);
+         if (BarPixels(mBar[i]) != mBar[i].drawn)
+         {
+            RefreshRect(mBar[i].b, false);
+            if (mClip)
+               RefreshRect(mBar[i].rClip, false);
+            changed = true;
+         }
       }
 
-      // Immediate redraw (using wxPaintDC)
-      Update();
+      // Redraw (using wxPaintDC) after the other updates of this tick
+      if (changed)
+         FrameClock::Get().RequestUpdate(this);
 
       return;
    }
@@ -1696,6 +1700,8 @@ void MeterPanel::DrawMeterBar(wxDC &dc, MeterBar *bar)
                bar->rClip.GetHeight() - 1);
       dc.DrawRectangle(r);
    }
+
+   bar->drawn = BarPixels(*bar);
 }
 
 bool MeterPanel::IsMeterDisabled() const
@@ -1738,11 +1744,11 @@ void MeterPanel::OnAudioIOStatus(wxCommandEvent &evt)
    mActive = (evt.GetInt() != 0) && (p == mProject);
 
    if( mActive ){
-      mTimer.Start(1000 / mMeterRefreshRate);
+      StartUpdates();
       if (evt.GetEventType() == EVT_AUDIOIO_MONITOR)
          mMonitoring = mActive;
    } else {
-      mTimer.Stop();
+      mFrames.reset();
       mMonitoring = false;
    }
 
@@ -1769,7 +1775,7 @@ void MeterPanel::RestoreState(const State &state)
    //wxLogDebug("Restore state for %p, is %i", this, mActive );
 
    if (mActive)
-      mTimer.Start(1000 / mMeterRefreshRate);
+      StartUpdates();
 }
 
 //
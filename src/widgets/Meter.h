@@ -16,9 +16,12 @@
 #ifndef __AUDACITY_METER__
 #define __AUDACITY_METER__
 
+#include <atomic>
+
 #include <wx/defs.h>
 #include <wx/timer.h>
 
+#include "../FrameClock.h"
 #include "../SampleFormat.h"
 #include "Ruler.h"
 
@@ -41,47 +44,63 @@ struct MeterBar {
    wxRect rClip;
    bool   clipping;
    bool   isclipping; //ANSWER-ME: What's the diff between these bools?! "clipping" vs "isclipping" is not clear.
-   int    tailPeakCount;
    float  peakPeakHold;
+
+   // Where the levels were last drawn, in pixels along the bar, so that
+   // an update which moves nothing repaints nothing
+   struct Pixels {
+      int  peak, rms, peakHold, peakPeakHold;
+      bool clipping;
+      bool operator == (const Pixels &other) const
+      {
+         return peak == other.peak && rms == other.rms &&
+            peakHold == other.peakHold &&
+            peakPeakHold == other.peakPeakHold &&
+            clipping == other.clipping;
+      }
+      bool operator != (const Pixels &other) const
+         { return !(*this == other); }
+   } drawn;
 };
 
-class MeterUpdateMsg
+// The levels of the audio since the display last took them
+struct MeterUpdateMsg
 {
-   public:
    int numFrames;
    float peak[kMaxMeterBars];
    float rms[kMaxMeterBars];
    bool clipping[kMaxMeterBars];
-   int headPeakCount[kMaxMeterBars];
-   int tailPeakCount[kMaxMeterBars];
-
-   /* neither constructor nor destructor do anything */
-   MeterUpdateMsg() { }
-   ~MeterUpdateMsg() { }
-   /* for debugging purposes, printing the values out is really handy */
-   /** \brief Print out all the values in the meter update message */
-   wxString toString();
-   /** \brief Only print meter updates if clipping may be happening */
-   wxString toStringIfClipped();
 };
 
-// Thread-safe queue of update messages
-class MeterUpdateQueue
+// Accumulates the levels of the blocks the audio callback passes, for
+// the GUI thread to take at its own rate.  One writer and one reader;
+// neither ever waits, and no block or message is copied.
+class MeterLevels
 {
  public:
-   explicit MeterUpdateQueue(size_t maxLen);
-   ~MeterUpdateQueue();
+   MeterLevels();
 
-   bool Put(MeterUpdateMsg &msg);
-   bool Get(MeterUpdateMsg &msg);
+   // Writer only
+   void Add(unsigned numChannels, unsigned numBars, int numFrames,
+            const float *sampleData, int numPeakSamplesToClip);
 
+   // Reader only; false if nothing was added since the last time
+   bool Take(MeterUpdateMsg &msg);
    void Clear();
 
  private:
-   int              mStart;
-   int              mEnd;
-   size_t           mBufferSize;
-   ArrayOf<MeterUpdateMsg> mBuffer{mBufferSize};
+   // Frames are added last and taken first, so that levels are never
+   // missing for frames counted; at worst a block's levels are taken one
+   // update before its frames
+   std::atomic<int>   mFrames;
+   std::atomic<float> mPeak[kMaxMeterBars];
+   std::atomic<float> mSumSquares[kMaxMeterBars];
+   std::atomic<bool>  mClipping[kMaxMeterBars];
+
+   // Runs of clipped samples, which may cross blocks; the writer's own,
+   // but zeroed at its next block when the reader asks
+   std::atomic<bool>  mClearRuns;
+   int                mPeakRun[kMaxMeterBars];
 };
 
 class MeterAx;
@@ -210,7 +229,8 @@ class MeterPanel final : public wxPanelWrapper
 
    void OnAudioIOStatus(wxCommandEvent &evt);
 
-   void OnMeterUpdate(wxTimerEvent &evt);
+   void StartUpdates();
+   void OnMeterUpdate();
 
    void HandleLayout(wxDC &dc);
    void SetActiveStyle(Style style);
@@ -230,8 +250,8 @@ class MeterPanel final : public wxPanelWrapper
    wxString Key(const wxString & key) const;
 
    AudacityProject *mProject;
-   MeterUpdateQueue mQueue;
-   wxTimer          mTimer;
+   MeterLevels      mLevels;
+   FrameClock::Subscription mFrames;
 
    int       mWidth;
    int       mHeight;
@@ -178,8 +178,24 @@ different formats.
 #include <math.h>
 #include <limits>
 
+namespace {
+// The characters of mDigitGlyphs, in order
+const wxChar kGlyphChars[] = wxT("0123456789-");
+const int kNumGlyphs = 11;
+
+int GlyphIndex(wxChar c)
+{
+   if (c >= wxT('0') && c <= wxT('9'))
+      return c - wxT('0');
+   if (c == wxT('-'))
+      return 10;
+   return -1;
+}
+}
+
 #include <wx/wx.h>
 #include <wx/dcmemory.h>
+#include <wx/region.h>
 #include <wx/font.h>
 #include <wx/intl.h>
 #include <wx/menu.h>
@@ -875,8 +891,6 @@ void NumericConverter::ValueToControls(double rawValue, bool nearest /* = true *
    int secs;
    int frames;
 
-   mValueString = mPrefix;
-
    if(mNtscDrop && theValue >= 0) {
       frames = (int)(theValue*30./1.001 + (nearest ? 0.5f : 0.0f));
       tenMins = frames/17982;
@@ -904,16 +918,16 @@ void NumericConverter::ValueToControls(double rawValue, bool nearest /* = true *
       t_frac = frames / 30.;
    }
 
-   for(i = 0; i < mFields.size(); i++) {
+   auto fieldValue = [&](const NumericField &field) {
       int value = -1;
 
-      if (mFields[i].frac) {
+      if (field.frac) {
          // JKC: This old code looks bogus to me.
          // The rounding is not propogating to earlier fields in the frac case.
          //value = (int)(t_frac * mFields[i].base + 0.5);  // +0.5 as rounding required
          // I did the rounding earlier.
          if (t_frac >= 0)
-            value = (int)(t_frac * mFields[i].base);
+            value = (int)(t_frac * field.base);
          // JKC: TODO: Find out what the range is supposed to do.
          // It looks bogus too.
          //if (mFields[i].range > 0)
@@ -923,11 +937,39 @@ void NumericConverter::ValueToControls(double rawValue, bool nearest /* = true *
          if (t_int >= 0) {
             // UNSAFE_SAMPLE_COUNT_TRUNCATION
             // truncation danger!
-            value = (t_int.as_long_long() / mFields[i].base);
-            if (mFields[i].range > 0)
-               value = value % mFields[i].range;
+            value = (t_int.as_long_long() / field.base);
+            if (field.range > 0)
+               value = value % field.range;
          }
       }
+      return value;
+   };
+
+   // This runs many times a second during playback, so the digits are
+   // written into a copy of the template, which has the prefix and the
+   // labels in place already, rather than composed of formatted strings
+   mValueString = mValueTemplate;
+   bool fits = true;
+   for(i = 0; fits && i < mFields.size(); i++) {
+      const auto &field = mFields[i];
+      int value = fieldValue(field);
+      for (int ii = field.digits; ii-- > 0;) {
+         if (value < 0)
+            mValueString[field.pos + ii] = wxT('-');
+         else {
+            mValueString[field.pos + ii] = wxChar(wxT('0') + value % 10);
+            value /= 10;
+         }
+      }
+      fits = (value <= 0);
+   }
+   if (fits)
+      return;
+
+   // A value too big for its field makes the string longer
+   mValueString = mPrefix;
+   for(i = 0; i < mFields.size(); i++) {
+      int value = fieldValue(mFields[i]);
 
       wxString field;
       if (value < 0) {
@@ -953,10 +995,23 @@ void NumericConverter::ControlsToValue()
    }
 
    for(i = 0; i < mFields.size(); i++) {
-      long val;
-      mFields[i].str = mValueString.Mid(mFields[i].pos,
-                                        mFields[i].digits);
-      mFields[i].str.ToLong(&val);
+      auto &field = mFields[i];
+      // Only the last fields change from one tick of playback to the next
+      if (field.str.length() != (size_t)field.digits ||
+          mValueString.compare(field.pos, field.digits, field.str) != 0)
+         field.str = mValueString.Mid(field.pos, field.digits);
+
+      long val = 0;
+      bool isNumber = !field.str.empty();
+      for (auto c : field.str) {
+         if (c < wxT('0') || c > wxT('9')) {
+            isNumber = false;
+            break;
+         }
+         val = val * 10 + (c - wxT('0'));
+      }
+      if (!isNumber)
+         field.str.ToLong(&val);
       if (mFields[i].frac)
          t += (val / (double)mFields[i].base);
       else
@@ -1340,9 +1395,8 @@ void NumericTextCtrl::SetSampleRate(double sampleRate)
 
 void NumericTextCtrl::SetValue(double newValue)
 {
+   // Calls the overrides of ValueToControls() and ControlsToValue()
    NumericConverter::SetValue(newValue);
-   ValueToControls();
-   ControlsToValue();
 }
 
 void NumericTextCtrl::SetReadOnly(bool readOnly)
@@ -1415,6 +1469,32 @@ bool NumericTextCtrl::Layout()
    mDigitW = strW;
    mDigitH = strH;
 
+   mDigitGlyphs = std::make_unique<wxBitmap>(
+      kNumGlyphs * mDigitBoxW, 2 * mDigitBoxH);
+   {
+      wxMemoryDC glyphDC;
+      glyphDC.SelectObject(*mDigitGlyphs);
+      glyphDC.SetFont(*mDigitFont);
+      glyphDC.SetPen(*wxTRANSPARENT_PEN);
+      wxBrush glyphBrush;
+      for (int focused = 0; focused < 2; ++focused) {
+         theTheme.SetBrushColour( glyphBrush,
+            focused ? clrTimeBackFocus : clrTimeBack );
+         glyphDC.SetBrush(glyphBrush);
+         glyphDC.DrawRectangle(
+            0, focused * mDigitBoxH, kNumGlyphs * mDigitBoxW, mDigitBoxH);
+         glyphDC.SetTextForeground(
+            theTheme.Colour( focused ? clrTimeFontFocus : clrTimeFont ));
+         glyphDC.SetTextBackground(
+            theTheme.Colour( focused ? clrTimeBackFocus : clrTimeBack ));
+         for (int g = 0; g < kNumGlyphs; ++g)
+            glyphDC.DrawText(wxString(kGlyphChars[g]),
+               g * mDigitBoxW + (mDigitBoxW - mDigitW)/2,
+               focused * mDigitBoxH + (mDigitBoxH - mDigitH)/2);
+      }
+      glyphDC.SelectObject(wxNullBitmap);
+   }
+
    // The label font should be a little smaller
    fontSize--;
    mLabelFont = std::make_unique<wxFont>(fontSize, wxFONTFAMILY_DEFAULT, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_NORMAL);
@@ -1534,20 +1614,36 @@ void NumericTextCtrl::OnPaint(wxPaintEvent & WXUNUSED(event))
    theTheme.SetBrushColour( Brush , clrTimeBackFocus );
    dc.SetBrush( Brush );
 
+   // Copy the digits from the glyphs made in Layout(), and only those that
+   // ValueToControls() found changed, unless all are to be painted
+   const wxRegion &update = GetUpdateRegion();
+   wxMemoryDC glyphDC;
+   glyphDC.SelectObject(*mDigitGlyphs);
+
    int i;
    for(i = 0; i < (int)mDigits.size(); i++) {
       wxRect box = mDigits[i].digitBox;
-      if (focused && mFocusedDigit == i) {
+      if (update.Contains(box) == wxOutRegion)
+         continue;
+      int pos = mDigits[i].pos;
+      const bool isFocused = focused && mFocusedDigit == i;
+      int glyph = GlyphIndex(mValueString[pos]);
+      if (glyph >= 0) {
+         dc.Blit(box.x, box.y, mDigitBoxW, mDigitBoxH, &glyphDC,
+                 glyph * mDigitBoxW, isFocused ? mDigitBoxH : 0);
+         continue;
+      }
+
+      if (isFocused) {
          dc.DrawRectangle(box);
          dc.SetTextForeground(theTheme.Colour( clrTimeFontFocus ));
          dc.SetTextBackground(theTheme.Colour( clrTimeBackFocus ));
       }
-      int pos = mDigits[i].pos;
       wxString digit = mValueString.Mid(pos, 1);
       int x = box.x + (mDigitBoxW - mDigitW)/2;
       int y = box.y + (mDigitBoxH - mDigitH)/2;
       dc.DrawText(digit, x, y);
-      if (focused && mFocusedDigit == i) {
+      if (isFocused) {
          dc.SetTextForeground(theTheme.Colour( clrTimeFont ));
          dc.SetTextBackground(theTheme.Colour( clrTimeBack ));
       }
@@ -1908,8 +2004,15 @@ void NumericTextCtrl::ValueToControls()
       // significant amount of CPU. Typically, when a track is
       // playing, only one of the NumericTextCtrl actually changes
       // (the audio position). We save CPU by updating the control
-      // only when needed.
-      Refresh(false);
+      // only when needed, and then only the digits that changed,
+      // which during playback are the last few.
+      if (mValueString.length() != previousValueString.length()) {
+         Refresh(false);
+         return;
+      }
+      for (const auto &digit : mDigits)
+         if (mValueString[digit.pos] != previousValueString[digit.pos])
+            RefreshRect(digit.digitBox, false);
    }
 }
 
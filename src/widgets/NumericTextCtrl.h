@@ -225,6 +225,9 @@ private:
    bool           mReadOnly;
 
    std::unique_ptr<wxBitmap> mBackgroundBitmap;
+   // The digits and '-' drawn once in their boxes, unfocused in the first
+   // row and focused in the second, so painting is only copying
+   std::unique_ptr<wxBitmap> mDigitGlyphs;
 
    std::unique_ptr<wxFont> mDigitFont, mLabelFont;
    int            mDigitBoxW;
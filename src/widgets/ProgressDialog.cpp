@@ -52,6 +52,7 @@
 #include "ErrorDialog.h"
 #include "../Prefs.h"
 #include "../Internat.h"
+#include "../AudacityApp.h"
 
 // This really should be a Preferences setting
 static const unsigned char beep[] =
@@ -989,8 +990,13 @@ BEGIN_EVENT_TABLE(ProgressDialog, wxDialogWrapper)
    EVT_BUTTON(wxID_CANCEL, ProgressDialog::OnCancel)
    EVT_BUTTON(wxID_OK, ProgressDialog::OnStop)
    EVT_CLOSE(ProgressDialog::OnCloseWindow)
+   EVT_TIMER(wxID_ANY, ProgressDialog::OnPollTimer)
 END_EVENT_TABLE()
 
+// How often, at most, the progress shown changes, and the dialog takes the
+// events of the user
+static const int kRefreshInterval = 50;
+
 //
 // Constructor
 //
@@ -1022,6 +1028,8 @@ ProgressDialog::ProgressDialog(const wxString & title,
 //
 ProgressDialog::~ProgressDialog()
 {
+   mPollTimer.Stop();
+
    // Delete the window disabler before hiding the dialog to allow
    // focus to return to the original window.
    mDisable.reset();
@@ -1080,6 +1088,9 @@ void ProgressDialog::Reinit()
    mStartTime = wxGetLocalTimeMillis().GetValue();
    mLastUpdate = mStartTime;
    mYieldTimer = mStartTime;
+   mNextRefresh = mStartTime;
+   mLastMessage.Empty();
+   mPublished = -1;
    mCancel = false;
    mStop = false;
 
@@ -1098,7 +1109,12 @@ void ProgressDialog::Reinit()
    if (button)
       button->Enable();
 
-   wxDialogWrapper::Show(true);
+   // A headless run shows no progress; the disabler still guards
+   if (!wxGetApp().IsHeadless())
+   {
+      wxDialogWrapper::Show(true);
+      mPollTimer.Start(kRefreshInterval);
+   }
 }
 
 // Add a NEW text column each time this is called.
@@ -1318,24 +1334,72 @@ bool ProgressDialog::Create(const wxString & title,
 //
 ProgressResult ProgressDialog::Update(int value, const wxString & message)
 {
-   if (mCancel)
+   auto result = Poll();
+   if (result != ProgressResult::Success)
    {
-      // for compatibility with old Update, that returned false on cancel
-      return ProgressResult::Cancelled;
+      return result;
    }
-   else if (mStop)
+
+   if (wxGetApp().IsHeadless())
    {
-      return ProgressResult::Stopped;
+      return ProgressResult::Success;
    }
 
+   // Callers update per block of work, far more often than anyone can
+   // see, so the dialog is refreshed and its events taken only once in a
+   // while, or when the message changes or the work completes
+   const bool newMessage = !message.IsEmpty() && message != mLastMessage;
    wxLongLong_t now = wxGetLocalTimeMillis().GetValue();
-   wxLongLong_t elapsed = now - mStartTime;
+   if (now < mNextRefresh && value < 1000 && !newMessage)
+   {
+      return ProgressResult::Success;
+   }
+   mNextRefresh = now + kRefreshInterval;
 
-   if (elapsed < 500)
+   if (now - mStartTime < 500)
    {
       return ProgressResult::Success;
    }
 
+   if (newMessage)
+   {
+      mLastMessage = message;
+      SetMessage(message);
+   }
+
+   ShowProgress(value, now);
+
+   wxDialogWrapper::Update();
+
+   // Copied from wx 3.0.2 generic progress dialog
+   //
+   // we have to yield because not only we want to update the display but
+   // also to process the clicks on the cancel and skip buttons
+   // NOTE: using YieldFor() this call shouldn't give re-entrancy problems
+   //       for event handlers not interested to UI/user-input events.
+   //
+   // LL:  Added timer category to prevent extreme delays when processing effects
+   //      (and probably other things).  I do not yet know why this happens and
+   //      I'm not too keen on having timer events processed here, but you do
+   //      what you have to do.
+
+   // Nyquist effects call Update on every callback, but YieldFor is
+   // quite slow on Linux / Mac, so don't call too frequently. (bug 1575)
+   if ((now - mYieldTimer > 50) || (value >= 1000)) {
+      wxEventLoopBase::GetActive()->YieldFor(wxEVT_CATEGORY_UI | wxEVT_CATEGORY_USER_INPUT | wxEVT_CATEGORY_TIMER);
+      mYieldTimer = now;
+   }
+
+   return Poll();
+}
+
+//
+// Show the gauge and the times for a value in [0,1000]
+//
+void ProgressDialog::ShowProgress(int value, wxLongLong_t now)
+{
+   wxLongLong_t elapsed = now - mStartTime;
+
    if (mIsTransparent)
    {
       SetTransparent(255);
@@ -1355,8 +1419,6 @@ ProgressResult ProgressDialog::Update(int value, const wxString & message)
    wxLongLong_t estimate = elapsed * 1000ll / value;
    wxLongLong_t remains = (estimate + mStartTime) - now;
 
-   SetMessage(message);
-
    if (value != mLastValue)
    {
       mGauge->SetValue(value);
@@ -1381,31 +1443,54 @@ ProgressResult ProgressDialog::Update(int value, const wxString & message)
 
       mLastUpdate = now;
    }
+}
 
-   wxDialogWrapper::Update();
+//
+// Publish progress from any thread; OnPollTimer() shows it
+//
+void ProgressDialog::Publish(int value)
+{
+   mPublished.store(std::max(0, std::min(value, 1000)), std::memory_order_relaxed);
+}
 
-   // Copied from wx 3.0.2 generic progress dialog
-   //
-   // we have to yield because not only we want to update the display but
-   // also to process the clicks on the cancel and skip buttons
-   // NOTE: using YieldFor() this call shouldn't give re-entrancy problems
-   //       for event handlers not interested to UI/user-input events.
-   //
-   // LL:  Added timer category to prevent extreme delays when processing effects
-   //      (and probably other things).  I do not yet know why this happens and
-   //      I'm not too keen on having timer events processed here, but you do
-   //      what you have to do.
+void ProgressDialog::Publish(wxLongLong_t current, wxLongLong_t total)
+{
+   Publish(total != 0 ? (int)(current * 1000ll / total) : 1000);
+}
 
-   // Nyquist effects call Update on every callback, but YieldFor is
-   // quite slow on Linux / Mac, so don't call too frequently. (bug 1575)
-   if ((now - mYieldTimer > 50) || (value == 1000)) {
-      wxEventLoopBase::GetActive()->YieldFor(wxEVT_CATEGORY_UI | wxEVT_CATEGORY_USER_INPUT | wxEVT_CATEGORY_TIMER);
-      mYieldTimer = now;
+ProgressResult ProgressDialog::Poll() const
+{
+   if (mCancel)
+   {
+      // for compatibility with old Update, that returned false on cancel
+      return ProgressResult::Cancelled;
+   }
+   else if (mStop)
+   {
+      return ProgressResult::Stopped;
    }
 
    return ProgressResult::Success;
 }
 
+void ProgressDialog::OnPollTimer(wxTimerEvent & WXUNUSED(event))
+{
+   // Nothing to do unless a worker publishes
+   int value = mPublished.load(std::memory_order_relaxed);
+   if (value < 0 || Poll() != ProgressResult::Success)
+   {
+      return;
+   }
+
+   wxLongLong_t now = wxGetLocalTimeMillis().GetValue();
+   if (now - mStartTime < 500)
+   {
+      return;
+   }
+
+   ShowProgress(value, now);
+}
+
 //
 // Update the time and, optionally, the message
 //
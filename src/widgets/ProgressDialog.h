@@ -21,11 +21,13 @@
 #include "../Audacity.h"
 
 #include "../MemoryX.h"
+#include <atomic>
 #include <vector>
 #include <wx/defs.h>
 #include <wx/evtloop.h>
 #include <wx/gauge.h>
 #include <wx/stattext.h>
+#include <wx/timer.h>
 #include <wx/utils.h>
 
 #include "wxPanelWrapper.h"
@@ -104,6 +106,15 @@ public:
    ProgressResult Update(int current, int total, const wxString & message = wxEmptyString);
    void SetMessage(const wxString & message);
 
+   // For work on a thread other than the main one, while the main thread
+   // runs its event loop: publish the progress, in [0,1000], which the
+   // dialog shows at its own pace.  Safe on any thread.
+   void Publish(int value);
+   void Publish(wxLongLong_t current, wxLongLong_t total);
+
+   // Whether the user has cancelled or stopped.  Safe on any thread.
+   ProgressResult Poll() const;
+
 protected:
    wxWeakRef<wxWindow> mHadFocus;
 
@@ -116,8 +127,9 @@ protected:
    wxLongLong_t mYieldTimer;
    int mLastValue; // gauge value, range = [0,1000]
 
-   bool mCancel;
-   bool mStop;
+   // Set by the buttons, read by the worker, whatever thread it is on
+   std::atomic<bool> mCancel{ false };
+   std::atomic<bool> mStop{ false };
 
    bool mIsTransparent;
 
@@ -131,7 +143,10 @@ private:
    void OnCancel(wxCommandEvent & e);
    void OnStop(wxCommandEvent & e);
    void OnCloseWindow(wxCloseEvent & e);
+   void OnPollTimer(wxTimerEvent & e);
    void Beep() const;
+
+   void ShowProgress(int value, wxLongLong_t now);
    
    bool ConfirmAction(const wxString & sPrompt,
                       const wxString & sTitle,
@@ -147,9 +162,17 @@ private:
    std::unique_ptr<wxWindowDisabler> mDisable;
 
    wxStaticText *mMessage{} ;
+   wxString mLastMessage;
    int mLastW{ 0 };
    int mLastH{ 0 };
 
+   // Refresh the dialog no sooner than this, but at completion
+   wxLongLong_t mNextRefresh{ 0 };
+
+   // What Publish() gave last, or -1 if nothing; the timer shows it
+   std::atomic<int> mPublished{ -1 };
+   wxTimer mPollTimer{ this };
+
    DECLARE_EVENT_TABLE()
 };
 
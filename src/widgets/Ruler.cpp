@@ -458,7 +458,7 @@ wxString Ruler::LabelString(double d, bool major)
 void Ruler::Tick(int pos, double d, bool major, bool minor)
 {
    wxString l;
-   wxCoord strW, strH, strD, strL;
+   wxCoord strW, strH;
    int strPos, strLen, strLeft, strTop;
 
    // FIXME: We don't draw a tick if of end of our label arrays
@@ -484,9 +484,11 @@ void Ruler::Tick(int pos, double d, bool major, bool minor)
    label->ly = mTop - 1000;  // don't display
    label->text = wxT("");
 
-   mDC->SetFont(major? *mMajorFont: minor? *mMinorFont : *mMinorMinorFont);
    l = LabelString(d, major);
-   mDC->GetTextExtent(l, &strW, &strH, &strD, &strL);
+   const auto extent =
+      MeasureLabel(major ? MajorFont : minor ? MinorFont : MinorMinorFont, l);
+   strW = extent.x;
+   strH = extent.y;
 
    if (mOrientation == wxHORIZONTAL) {
       strLen = strW;
@@ -563,6 +565,31 @@ void Ruler::Tick(int pos, double d, bool major, bool minor)
 
 }
 
+wxSize Ruler::MeasureLabel(int font, const wxString &text)
+{
+   const wxFont &current =
+      font == MajorFont ? *mMajorFont :
+      font == MinorFont ? *mMinorFont : *mMinorMinorFont;
+   auto &extents = mExtents[font];
+   if (!(mExtentFonts[font] == current)) {
+      extents.clear();
+      mExtentFonts[font] = current;
+   }
+
+   auto iter = extents.find(text);
+   if (iter != extents.end())
+      return iter->second;
+
+   // Time labels never stop changing; start again rather than grow
+   if (extents.size() >= 1000)
+      extents.clear();
+
+   wxCoord strW, strH;
+   mDC->SetFont(current);
+   mDC->GetTextExtent(text, &strW, &strH);
+   return extents[text] = wxSize{ strW, strH };
+}
+
 void Ruler::TickCustom(int labelIdx, bool major, bool minor)
 {
    //This should only used in the mCustom case
@@ -571,7 +598,7 @@ void Ruler::TickCustom(int labelIdx, bool major, bool minor)
 
    int pos;
    wxString l;
-   wxCoord strW, strH, strD, strL;
+   wxCoord strW, strH;
    int strPos, strLen, strLeft, strTop;
 
    // FIXME: We don't draw a tick if of end of our label arrays
@@ -595,9 +622,10 @@ void Ruler::TickCustom(int labelIdx, bool major, bool minor)
    label->lx = mLeft - 1000; // don't display
    label->ly = mTop - 1000;  // don't display
 
-   mDC->SetFont(major? *mMajorFont: minor? *mMinorFont : *mMinorMinorFont);
-
-   mDC->GetTextExtent(l, &strW, &strH, &strD, &strL);
+   const auto extent =
+      MeasureLabel(major ? MajorFont : minor ? MinorFont : MinorMinorFont, l);
+   strW = extent.x;
+   strH = extent.y;
 
    if (mOrientation == wxHORIZONTAL) {
       strLen = strW;
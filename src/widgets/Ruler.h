@@ -13,6 +13,7 @@
 
 #include "OverlayPanel.h"
 #include "../MemoryX.h"
+#include <map>
 #include <wx/bitmap.h>
 #include <wx/dc.h>
 #include <wx/dcmemory.h>
@@ -144,6 +145,14 @@ class AUDACITY_DLL_API Ruler {
    // Another tick generator for custom ruler case (noauto) .
    void TickCustom(int labelIdx, bool major, bool minor);
 
+   // Text extents of labels, by font, so that labels which come back as
+   // the view scrolls, or as the vertical ruler goes from track to track,
+   // are not measured again.  Forgotten when the font changes.
+   enum { MajorFont, MinorFont, MinorMinorFont, NumFonts };
+   wxSize MeasureLabel(int font, const wxString &text);
+   wxFont       mExtentFonts[NumFonts];
+   std::map<wxString, wxSize> mExtents[NumFonts];
+
 public:
    bool mbTicksOnly; // true => no line the length of the ruler
    bool mbTicksAtExtremes;
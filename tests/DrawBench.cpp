@@ -0,0 +1,188 @@
+/* Times the drawing of a waveform at a sweep of zoom levels.
+ *
+ * A mono track is drawn by TrackArtist::DrawTrack() into a wxMemoryDC, a
+ * number of frames at each zoom, the view moving by a quarter of its width
+ * from one frame to the next, as when scrolling.  The zooms are chosen to
+ * take each path of WaveClip::GetWaveDisplay(): the whole track in view,
+ * columns of the 64K and of the 256 summaries, min/max of samples, and
+ * individual samples.
+ *
+ * Each result is one line of JSON on standard output, with the mean,
+ * median and longest time of a frame, and the bytes read from block files
+ * per frame.  The program needs a display, as the application does.
+ *
+ * Usage: DrawBench [-d directory] [-s seconds] [-w width] [-h height]
+ *                  [-f frames]
+ */
+
+#include "Audacity.h"
+#include "AColor.h"
+#include "DirManager.h"
+#include "Prefs.h"
+#include "SelectedRegion.h"
+#include "Theme.h"
+#include "Track.h"
+#include "TrackArtist.h"
+#include "TrackPanelDrawingContext.h"
+#include "ViewInfo.h"
+#include "WaveTrack.h"
+#include "blockfile/BlockIOStats.h"
+#include <wx/app.h>
+#include <wx/bitmap.h>
+#include <wx/dcmemory.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+const double kRate = 44100.0;
+
+class DrawBenchApp final : public wxApp
+{
+public:
+   bool OnInit() override { return true; }
+};
+
+struct Options
+{
+   double seconds = 600.0;
+   int width = 1920;
+   int height = 300;
+   int frames = 30;
+};
+
+std::unique_ptr<WaveTrack> MakeTrack(TrackFactory &factory, const Options &options)
+{
+   const size_t chunk = 65536;
+   std::vector<float> signal(chunk);
+   auto track = factory.NewWaveTrack(floatSample, kRate);
+   const size_t total = options.seconds * kRate;
+   size_t done = 0;
+   while (done < total) {
+      // A tone whose loudness wanders, so that the summaries differ
+      const auto len = std::min(chunk, total - done);
+      for (size_t i = 0; i < len; ++i) {
+         const double t = (done + i) / kRate;
+         signal[i] = (0.5f + 0.4f * sin(t * 0.3)) * sin(t * 2 * M_PI * 220) +
+            0.02f * (rand() / (float)RAND_MAX - 0.5f);
+      }
+      track->Append((samplePtr)signal.data(), floatSample, len);
+      done += len;
+   }
+   track->Flush();
+   return track;
+}
+
+void Sweep(TrackArtist &artist, const WaveTrack &track, const Options &options)
+{
+   wxBitmap bitmap(options.width, options.height);
+   wxMemoryDC dc;
+   dc.SelectObject(bitmap);
+   TrackPanelDrawingContext context{ dc, {}, {} };
+   const wxRect rect(0, 0, options.width, options.height);
+   const SelectedRegion selectedRegion;
+
+   struct Zoom { const char *name; double pixelsPerSecond; };
+   const Zoom zooms[] = {
+      { "whole",      options.width / options.seconds },
+      { "summary64K", kRate / 100000 },
+      { "summary256", kRate / 1000 },
+      { "minMax",     kRate / 32 },
+      { "samples",    kRate * 4 },
+   };
+
+   for (const auto &zoom : zooms) {
+      ZoomInfo zoomInfo(0.0, zoom.pixelsPerSecond);
+      const double viewSeconds = options.width / zoom.pixelsPerSecond;
+      const double range = std::max(0.0, options.seconds - viewSeconds);
+
+      std::vector<double> times;
+      const auto &stats = BlockIOStats::Program();
+      const auto bytesBefore = stats.Total(BlockIOStats::BytesRead);
+      for (int frame = 0; frame < options.frames; ++frame) {
+         zoomInfo.h = range > 0
+            ? fmod(frame * viewSeconds / 4, range)
+            : 0.0;
+
+         auto start = std::chrono::steady_clock::now();
+         artist.DrawTrack(context, &track, rect, selectedRegion, zoomInfo, false);
+         times.push_back(std::chrono::duration<double>(
+            std::chrono::steady_clock::now() - start).count());
+      }
+      const auto bytes = stats.Total(BlockIOStats::BytesRead) - bytesBefore;
+
+      double total = 0;
+      for (auto time : times)
+         total += time;
+      std::sort(times.begin(), times.end());
+
+      std::cout << "{\"bench\":\"DrawTrack\""
+                << ",\"zoom\":\"" << zoom.name << "\""
+                << ",\"pixelsPerSecond\":" << zoom.pixelsPerSecond
+                << ",\"width\":" << options.width
+                << ",\"frames\":" << times.size()
+                << ",\"meanSeconds\":" << total / times.size()
+                << ",\"medianSeconds\":" << times[times.size() / 2]
+                << ",\"worstSeconds\":" << times.back()
+                << ",\"bytesReadPerFrame\":" << (double)bytes / times.size()
+                << "}" << std::endl;
+   }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+   wxApp::SetInstance(safenew DrawBenchApp);
+   if (!wxEntryStart(argc, argv) || !wxTheApp->CallOnInit()) {
+      std::cerr << "Could not start; is there a display?\n";
+      return 1;
+   }
+
+   wxString directory = wxT("/tmp/draw-bench-dir");
+   Options options;
+
+   for (int i = 1; i + 1 < argc; i += 2) {
+      if (!strcmp(argv[i], "-d"))
+         directory = wxString::FromUTF8(argv[i + 1]);
+      else if (!strcmp(argv[i], "-s"))
+         options.seconds = std::max(1.0, atof(argv[i + 1]));
+      else if (!strcmp(argv[i], "-w"))
+         options.width = std::max(1, atoi(argv[i + 1]));
+      else if (!strcmp(argv[i], "-h"))
+         options.height = std::max(1, atoi(argv[i + 1]));
+      else if (!strcmp(argv[i], "-f"))
+         options.frames = std::max(1, atoi(argv[i + 1]));
+      else {
+         std::cerr << "Usage: " << argv[0]
+                   << " [-d directory] [-s seconds] [-w width] [-h height]"
+                      " [-f frames]\n";
+         return 1;
+      }
+   }
+
+   // Drawing reads preferences and the theme, as in the application
+   InitPreferences();
+   theTheme.EnsureInitialised();
+   AColor::Init();
+
+   DirManager::SetTempDir(directory);
+   {
+      auto dirManager = std::make_shared<DirManager>();
+      TrackFactory factory{ dirManager, nullptr };
+      srand(1);
+
+      auto track = MakeTrack(factory, options);
+      TrackArtist artist;
+      Sweep(artist, *track, options);
+   }
+
+   FinishPreferences();
+   wxEntryCleanup();
+   return 0;
+}
@@ -0,0 +1,309 @@
+/* Times exporting and importing through each codec's plugin.
+ *
+ * Reference tracks of a tone, of the given length and channel count, are
+ * exported to a file in each format of each export plugin, through the
+ * ExportStream of the plugin, as MultiExporter writes it.  Each of those
+ * files, and any others named with -i, is then imported through each
+ * import plugin that claims its extension: PCM, FLAC, MP3, Ogg Vorbis and
+ * FFmpeg, as built.
+ *
+ * Each result is one line of JSON on standard output, with the megabytes
+ * of the file and the samples of all channels done per second, and the
+ * peak resident memory during the run.  On Linux the peak is reset before
+ * each run; elsewhere it is the peak of the program so far.  The program
+ * needs a display, for the progress dialogs of the plugins.
+ *
+ * MP3 is exported only if named with -f, because the plugin may ask where
+ * LAME is.
+ *
+ * Usage: ImportExportBench [-d directory] [-s seconds] [-c channels]...
+ *                          [-f format]... [-i file]...
+ */
+
+#include "Audacity.h"
+#include "DirManager.h"
+#include "FFmpeg.h"
+#include "Prefs.h"
+#include "Track.h"
+#include "WaveTrack.h"
+#include "export/Export.h"
+#include "import/ImportFFmpeg.h"
+#include "import/ImportFLAC.h"
+#include "import/ImportMP3.h"
+#include "import/ImportOGG.h"
+#include "import/ImportPCM.h"
+#include "import/ImportPlugin.h"
+#include "widgets/ProgressDialog.h"
+#include <wx/app.h>
+#include <wx/filename.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <sys/resource.h>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const double kRate = 44100.0;
+
+class ImportExportBenchApp final : public wxApp
+{
+public:
+   bool OnInit() override { return true; }
+};
+
+struct Options
+{
+   wxString directory = wxT("/tmp/import-export-bench-dir");
+   double seconds = 60.0;
+   std::vector<unsigned> channelCounts;
+   wxArrayString formats;
+   wxArrayString files;
+};
+
+double Seconds(Clock::duration duration)
+{
+   return std::chrono::duration<double>(duration).count();
+}
+
+void ResetPeakMemory()
+{
+#ifdef __linux__
+   // Resets VmHWM of /proc/self/status
+   if (FILE *file = fopen("/proc/self/clear_refs", "w")) {
+      fputs("5", file);
+      fclose(file);
+   }
+#endif
+}
+
+double PeakMemoryBytes()
+{
+#ifdef __linux__
+   if (FILE *file = fopen("/proc/self/status", "r")) {
+      char line[256];
+      long kilobytes = -1;
+      while (fgets(line, sizeof(line), file))
+         if (sscanf(line, "VmHWM: %ld kB", &kilobytes) == 1)
+            break;
+      fclose(file);
+      if (kilobytes >= 0)
+         return kilobytes * 1024.0;
+   }
+#endif
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+   return usage.ru_maxrss;
+#else
+   return usage.ru_maxrss * 1024.0;
+#endif
+}
+
+double FileBytes(const wxString &path)
+{
+   const auto size = wxFileName::GetSize(path);
+   return size == wxInvalidSize ? 0.0 : size.ToDouble();
+}
+
+void Report(const char *bench, const wxString &format, const wxString &path,
+            unsigned channels, double samples, double seconds)
+{
+   const double megabytes = FileBytes(path) / 1e6;
+   std::cout << "{\"bench\":\"" << bench << "\""
+             << ",\"format\":\"" << format.ToStdString() << "\""
+             << ",\"file\":\""
+             << wxFileName(path).GetFullName().ToStdString() << "\""
+             << ",\"channels\":" << channels
+             << ",\"samples\":" << samples
+             << ",\"seconds\":" << seconds
+             << ",\"megabytesPerSecond\":"
+             << (seconds > 0 ? megabytes / seconds : 0)
+             << ",\"samplesPerSecond\":"
+             << (seconds > 0 ? samples / seconds : 0)
+             << ",\"peakMemoryBytes\":" << PeakMemoryBytes()
+             << "}" << std::endl;
+}
+
+// A tone of a different pitch on each channel, with some noise
+WaveTrackConstArray MakeTracks(TrackFactory &factory, unsigned channels,
+                               const Options &options)
+{
+   const size_t chunk = 65536;
+   std::vector<float> signal(chunk);
+   const size_t total = options.seconds * kRate;
+
+   WaveTrackConstArray tracks;
+   for (unsigned c = 0; c < channels; ++c) {
+      auto track = factory.NewWaveTrack(floatSample, kRate);
+      if (channels == 2)
+         track->SetChannel(c == 0 ? Track::LeftChannel : Track::RightChannel);
+      for (size_t done = 0; done < total; done += chunk) {
+         const auto len = std::min(chunk, total - done);
+         for (size_t i = 0; i < len; ++i)
+            signal[i] = (0.5f * sinf((done + i) * 0.03f * (c + 1)) +
+               0.05f * (rand() / (float)RAND_MAX - 0.5f)) / channels;
+         track->Append((samplePtr)signal.data(), floatSample, len);
+      }
+      track->Flush();
+      tracks.push_back(std::shared_ptr<const WaveTrack>{ std::move(track) });
+   }
+   return tracks;
+}
+
+// Returns the paths of the files written
+wxArrayString BenchExports(Exporter &exporter, const WaveTrackConstArray &tracks,
+                           unsigned channels, const Options &options)
+{
+   wxArrayString paths;
+   for (const auto &plugin : exporter.GetPlugins()) {
+      for (int index = 0; index < plugin->GetFormatCount(); ++index) {
+         const auto format = plugin->GetFormat(index);
+         // The generic libsndfile format is one of the others, by preference
+         if (format == wxT("LIBSNDFILE") ||
+             plugin->GetMaxChannels(index) < channels)
+            continue;
+         if (options.formats.empty()
+               ? format == wxT("MP3")
+               : options.formats.Index(format, false) == wxNOT_FOUND)
+            continue;
+
+         const auto path = options.directory + wxFILE_SEP_PATH +
+            wxString::Format(wxT("bench-%s-%u.%s"),
+               format, channels, plugin->GetExtension(index));
+
+         ResetPeakMemory();
+         const auto start = Clock::now();
+         auto stream = plugin->OpenStream(path, channels, kRate, index);
+         if (!stream)
+            continue;
+         MultiExporter multi{ kRate };
+         multi.AddOutput(std::move(stream), tracks, 0.0, options.seconds,
+                         channels);
+         ProgressDialog dialog{ wxT("Export"), format };
+         const auto result = multi.Process(dialog);
+         const double seconds = Seconds(Clock::now() - start);
+         if (result != ProgressResult::Success)
+            continue;
+
+         Report("export", format, path, channels,
+                options.seconds * kRate * channels, seconds);
+         paths.push_back(path);
+      }
+   }
+   return paths;
+}
+
+void BenchImports(const ImportPluginList &plugins, TrackFactory &factory,
+                  const wxString &path)
+{
+   const auto extension = path.AfterLast(wxT('.'));
+   for (const auto &plugin : plugins) {
+      if (!plugin->SupportsExtension(extension))
+         continue;
+
+      ResetPeakMemory();
+      const auto start = Clock::now();
+      auto handle = plugin->Open(path);
+      if (!handle || handle->GetStreamCount() == 0)
+         continue;
+      for (wxInt32 stream = 0; stream < handle->GetStreamCount(); ++stream)
+         handle->SetStreamUsage(stream, true);
+      TrackHolders tracks;
+      if (handle->PrepareImport() != ProgressResult::Success ||
+          handle->Import(&factory, tracks) != ProgressResult::Success)
+         continue;
+      const double seconds = Seconds(Clock::now() - start);
+
+      double samples = 0;
+      for (const auto &track : tracks)
+         samples += (track->GetEndTime() - track->GetStartTime()) *
+            track->GetRate();
+      Report("import", plugin->GetPluginStringID(), path,
+             tracks.size(), samples, seconds);
+   }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+   wxApp::SetInstance(safenew ImportExportBenchApp);
+   if (!wxEntryStart(argc, argv) || !wxTheApp->CallOnInit()) {
+      std::cerr << "Could not start; is there a display?\n";
+      return 1;
+   }
+
+   Options options;
+   for (int i = 1; i + 1 < argc; i += 2) {
+      if (!strcmp(argv[i], "-d"))
+         options.directory = wxString::FromUTF8(argv[i + 1]);
+      else if (!strcmp(argv[i], "-s"))
+         options.seconds = std::max(1.0, atof(argv[i + 1]));
+      else if (!strcmp(argv[i], "-c"))
+         options.channelCounts.push_back(
+            std::max(1ul, strtoul(argv[i + 1], nullptr, 10)));
+      else if (!strcmp(argv[i], "-f"))
+         options.formats.push_back(wxString::FromUTF8(argv[i + 1]));
+      else if (!strcmp(argv[i], "-i"))
+         options.files.push_back(wxString::FromUTF8(argv[i + 1]));
+      else {
+         std::cerr << "Usage: " << argv[0]
+                   << " [-d directory] [-s seconds] [-c channels]..."
+                      " [-f format]... [-i file]...\n";
+         return 1;
+      }
+   }
+   if (options.channelCounts.empty())
+      options.channelCounts = { 1, 2 };
+   wxFileName::Mkdir(options.directory, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+
+   // Settings for this run only; the file of preferences is left as it was
+   InitPreferences();
+   gPrefs->DisableAutoSave();
+   gPrefs->Write(wxT("/FileFormats/CopyOrEditUncompressedData"), wxT("copy"));
+   gPrefs->Write(wxT("/Warnings/CopyOrEditUncompressedDataFirstAsk"), false);
+   gPrefs->Write(wxT("/Warnings/CopyOrEditUncompressedDataAsk"), false);
+   gPrefs->Write(wxT("/FFmpeg/NotFoundDontShow"), 1);
+#ifdef USE_FFMPEG
+   FFmpegStartup();
+#endif
+
+   ImportPluginList importPlugins;
+   UnusableImportPluginList unusable;
+   GetPCMImportPlugin(importPlugins, unusable);
+   GetFLACImportPlugin(importPlugins, unusable);
+   GetMP3ImportPlugin(importPlugins, unusable);
+   GetOGGImportPlugin(importPlugins, unusable);
+#ifdef USE_FFMPEG
+   GetFFmpegImportPlugin(importPlugins, unusable);
+#endif
+
+   DirManager::SetTempDir(options.directory);
+   {
+      auto dirManager = std::make_shared<DirManager>();
+      TrackFactory factory{ dirManager, nullptr };
+      Exporter exporter;
+      srand(1);
+
+      auto files = options.files;
+      for (auto channels : options.channelCounts) {
+         const auto tracks = MakeTracks(factory, channels, options);
+         for (const auto &path : BenchExports(exporter, tracks, channels, options))
+            files.push_back(path);
+      }
+
+      for (const auto &path : files)
+         BenchImports(importPlugins, factory, path);
+   }
+
+   FinishPreferences();
+   wxEntryCleanup();
+   return 0;
+}
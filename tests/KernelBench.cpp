@@ -0,0 +1,522 @@
+/* Times the vector kernels of the mixing, conversion, summary, envelope
+ * and vector math code against plain scalar loops, and checks that they
+ * agree, so that work on their speed cannot change the audio unnoticed.
+ *
+ * The instruction set of the kernels is chosen at compile time, as in
+ * Mix.cpp, Dither.cpp, BlockFile.cpp and VectorMath.cpp: SSE2 on x86-64,
+ * NEON on 64 bit ARM, else the scalar loops of those files.  Run the
+ * build for each target to cover each set.  The references here are the
+ * loops as the files write them, or the functions of <cmath>.
+ *
+ * Each kernel runs over several buffer lengths, and with its input at
+ * several offsets from an aligned address.  Each result is one line of
+ * JSON on standard output:
+ *
+ *   {"kernel":"MixBuffers/2","simd":"sse2","len":1024,"offset":1,
+ *    "nsPerSample":0.21,"referenceNsPerSample":0.65,"maxError":0,
+ *    "bound":1,"agree":true}
+ *
+ * maxError is in units in the last place of the results, except for the
+ * integer conversions, where it is in codes.  The exit status is 1 if any
+ * kernel strays beyond its bound.
+ *
+ * Usage: KernelBench [-n len]... [-o offset]... [-s samplesTimed]
+ */
+
+#include "BlockFile.h"
+#include "Dither.h"
+#include "Envelope.h"
+#include "Mix.h"
+#include "SampleFormat.h"
+#include "VectorMath.h"
+#include <wx/init.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const char *SimdName()
+{
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+   return "sse2";
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+   return "neon";
+#else
+   return "scalar";
+#endif
+}
+
+struct Options
+{
+   std::vector<size_t> lengths;
+   std::vector<size_t> offsets;
+   double samplesTimed = 1 << 24;
+};
+
+bool gAllAgree = true;
+
+// Distance of two floats in steps of the representable values
+long long UlpDistance(float a, float b)
+{
+   if (a == b)
+      return 0;
+   if (std::isnan(a) || std::isnan(b))
+      return std::numeric_limits<long long>::max();
+   int32_t ia, ib;
+   memcpy(&ia, &a, sizeof(ia));
+   memcpy(&ib, &b, sizeof(ib));
+   // Order the negative values below the positive
+   const auto key = [](int32_t i) -> long long
+      { return i < 0 ? -(long long)(i & 0x7fffffff) : i; };
+   return std::abs(key(ia) - key(ib));
+}
+
+long long MaxUlps(const float *a, const float *b, size_t len, size_t stride = 1)
+{
+   long long result = 0;
+   for (size_t i = 0; i < len; i += stride)
+      result = std::max(result, UlpDistance(a[i], b[i]));
+   return result;
+}
+
+// Nanoseconds for each sample, repeating the work until about
+// samplesTimed samples are done
+template<typename Work>
+double NsPerSample(const Options &options, size_t len, Work work)
+{
+   const size_t reps =
+      std::max<size_t>(1, (size_t)(options.samplesTimed / len));
+   work();   // warm the caches
+   const auto start = Clock::now();
+   for (size_t r = 0; r < reps; ++r)
+      work();
+   const double seconds =
+      std::chrono::duration<double>(Clock::now() - start).count();
+   return seconds * 1e9 / (double(reps) * len);
+}
+
+void Report(const char *kernel, size_t len, size_t offset,
+            double ns, double referenceNs, long long maxError, long long bound)
+{
+   const bool agree = maxError <= bound;
+   gAllAgree = gAllAgree && agree;
+   std::cout << "{\"kernel\":\"" << kernel << "\""
+             << ",\"simd\":\"" << SimdName() << "\""
+             << ",\"len\":" << len
+             << ",\"offset\":" << offset
+             << ",\"nsPerSample\":" << ns
+             << ",\"referenceNsPerSample\":" << referenceNs
+             << ",\"maxError\":" << maxError
+             << ",\"bound\":" << bound
+             << ",\"agree\":" << (agree ? "true" : "false")
+             << "}" << std::endl;
+}
+
+// A tone with some noise, a little over full scale at the peaks, so that
+// the conversions clip
+std::vector<float> MakeSignal(size_t len)
+{
+   std::vector<float> signal(len);
+   for (size_t i = 0; i < len; ++i)
+      signal[i] = 1.05f * sinf(i * 0.013f) +
+         0.05f * (rand() / (float)RAND_MAX - 0.5f);
+   return signal;
+}
+
+std::vector<double> MakeEnvelope(size_t len)
+{
+   std::vector<double> envelope(len);
+   for (size_t i = 0; i < len; ++i)
+      envelope[i] = 0.5 + 0.5 * cos(i * 0.001);
+   return envelope;
+}
+
+// The fused multiply-adds that some compilers make of the scalar loops
+const long long kMixUlps = 1;
+
+void BenchMix(const Options &options, unsigned numChannels, bool interleaved,
+              size_t len, size_t offset)
+{
+   const auto signal = MakeSignal(len + offset);
+   const auto envelope = MakeEnvelope(len + offset);
+   const float *src = signal.data() + offset;
+   const double *env = envelope.data() + offset;
+
+   // Every other channel on past the first two, to cover the masks
+   std::vector<int> flags(numChannels);
+   std::vector<float> gains(numChannels);
+   for (unsigned c = 0; c < numChannels; ++c) {
+      flags[c] = c < 2 || c % 2 == 0;
+      gains[c] = 0.25f + 0.125f * c;
+   }
+
+   const unsigned nBuffers = interleaved ? 1 : numChannels;
+   const size_t bufferLen = interleaved ? len * numChannels : len;
+   std::vector<SampleBuffer> dests(nBuffers);
+   for (auto &dest : dests) {
+      dest.Allocate(bufferLen, floatSample);
+      ClearSamples(dest.ptr(), floatSample, 0, bufferLen);
+   }
+   MixBuffers(numChannels, flags.data(), gains.data(), (constSamplePtr)src,
+              env, dests.data(), len, interleaved);
+
+   std::vector<float> reference(len * numChannels, 0.0f);
+   const auto mixReference = [&] {
+      for (unsigned c = 0; c < numChannels; ++c) {
+         if (!flags[c])
+            continue;
+         for (size_t j = 0; j < len; ++j)
+            reference[j * numChannels + c] += src[j] * float(env[j]) * gains[c];
+      }
+   };
+   mixReference();
+
+   long long maxError = 0;
+   for (unsigned c = 0; c < numChannels; ++c) {
+      const auto dest = (const float *)dests[interleaved ? 0 : c].ptr();
+      for (size_t j = 0; j < len; ++j)
+         maxError = std::max(maxError, UlpDistance(
+            interleaved ? dest[j * numChannels + c] : dest[j],
+            reference[j * numChannels + c]));
+   }
+
+   const double ns = NsPerSample(options, len, [&] {
+      MixBuffers(numChannels, flags.data(), gains.data(), (constSamplePtr)src,
+                 env, dests.data(), len, interleaved);
+   });
+   const double referenceNs = NsPerSample(options, len, mixReference);
+   const std::string name = std::string("MixBuffers/") +
+      std::to_string(numChannels) + (interleaved ? "" : "/separate");
+   Report(name.c_str(), len, offset, ns, referenceNs, maxError, kMixUlps);
+}
+
+// The loops of Dither.cpp without noise
+int ReferenceToInt(float sample, float scale, int lo, int hi)
+{
+   const float clipped = sample > 1.0f ? 1.0f : sample < -1.0f ? -1.0f : sample;
+   const long x = lrintf(clipped * scale);
+   return x > hi ? hi : x < lo ? lo : (int)x;
+}
+
+void BenchConvert(const Options &options, size_t len, size_t offset)
+{
+   const auto signal = MakeSignal(len + offset);
+   const float *src = signal.data() + offset;
+   Dither dither;
+
+   std::vector<short> shorts(len), referenceShorts(len);
+   std::vector<int> ints(len), referenceInts(len);
+   const auto toShorts = [&] {
+      for (size_t i = 0; i < len; ++i)
+         referenceShorts[i] = ReferenceToInt(src[i], 32768.0f, -32768, 32767);
+   };
+   const auto toInts = [&] {
+      for (size_t i = 0; i < len; ++i)
+         referenceInts[i] =
+            ReferenceToInt(src[i], 8388608.0f, -8388608, 8388607);
+   };
+   toShorts();
+   toInts();
+
+   const auto codes = [&](const std::vector<short> &result) {
+      long long maxError = 0;
+      for (size_t i = 0; i < len; ++i)
+         maxError = std::max<long long>(maxError,
+            std::abs(result[i] - referenceShorts[i]));
+      return maxError;
+   };
+
+   // No dither: the same codes
+   CopySamplesNoDither((samplePtr)src, floatSample,
+                       (samplePtr)shorts.data(), int16Sample, len);
+   double ns = NsPerSample(options, len, [&] {
+      CopySamplesNoDither((samplePtr)src, floatSample,
+                          (samplePtr)shorts.data(), int16Sample, len);
+   });
+   Report("CopySamples/float-int16", len, offset, ns,
+          NsPerSample(options, len, toShorts), codes(shorts), 0);
+
+   CopySamplesNoDither((samplePtr)src, floatSample,
+                       (samplePtr)ints.data(), int24Sample, len);
+   ns = NsPerSample(options, len, [&] {
+      CopySamplesNoDither((samplePtr)src, floatSample,
+                          (samplePtr)ints.data(), int24Sample, len);
+   });
+   long long maxError = 0;
+   for (size_t i = 0; i < len; ++i)
+      maxError = std::max<long long>(maxError,
+         std::abs(ints[i] - referenceInts[i]));
+   Report("CopySamples/float-int24", len, offset, ns,
+          NsPerSample(options, len, toInts), maxError, 0);
+
+   // Back to float: exact
+   std::vector<float> floats(len), referenceFloats(len);
+   const auto fromShorts = [&] {
+      for (size_t i = 0; i < len; ++i)
+         referenceFloats[i] = referenceShorts[i] / 32768.0f;
+   };
+   fromShorts();
+   CopySamplesNoDither((samplePtr)referenceShorts.data(), int16Sample,
+                       (samplePtr)floats.data(), floatSample, len);
+   ns = NsPerSample(options, len, [&] {
+      CopySamplesNoDither((samplePtr)referenceShorts.data(), int16Sample,
+                          (samplePtr)floats.data(), floatSample, len);
+   });
+   Report("CopySamples/int16-float", len, offset, ns,
+          NsPerSample(options, len, fromShorts),
+          MaxUlps(floats.data(), referenceFloats.data(), len), 0);
+
+   // Rectangle noise moves a sample by less than half a code, and triangle
+   // by less than one, so the codes differ by at most one and two
+   const struct { Dither::DitherType type; const char *name; long long bound; }
+   dithers[] = {
+      { Dither::rectangle, "Dither/rectangle-int16", 1 },
+      { Dither::triangle, "Dither/triangle-int16", 2 },
+   };
+   for (const auto &each : dithers) {
+      dither.Apply(each.type, (samplePtr)src, floatSample,
+                   (samplePtr)shorts.data(), int16Sample, len);
+      const auto error = codes(shorts);
+      ns = NsPerSample(options, len, [&] {
+         dither.Apply(each.type, (samplePtr)src, floatSample,
+                      (samplePtr)shorts.data(), int16Sample, len);
+      });
+      Report(each.name, len, offset, ns,
+             NsPerSample(options, len, toShorts), error, each.bound);
+   }
+}
+
+// Only to reach the summary kernel, which is for the subclasses
+class SummaryProbe final : public BlockFile
+{
+public:
+   explicit SummaryProbe(size_t len)
+      : BlockFile{ wxFileNameWrapper{}, len }
+   {}
+
+   void Summarize(const float *samples, size_t len,
+                  float *summary256, float *summary64K)
+   { CalcSummaryFromBuffer(samples, len, summary256, summary64K); }
+
+   size_t ReadData(samplePtr, sampleFormat, size_t, size_t, bool)
+      const override { return 0; }
+   BlockFilePtr Copy(wxFileNameWrapper &&) override { return {}; }
+   DiskByteCount GetSpaceUsage() const override { return 0; }
+   void Recover() override {}
+   bool ReadSummary(ArrayOf<char> &) override { return false; }
+};
+
+// The sums of squares go through the lanes in another order
+const long long kSummaryRmsUlps = 64;
+
+void BenchSummary(const Options &options, size_t len, size_t offset)
+{
+   const auto signal = MakeSignal(len + offset);
+   const float *src = signal.data() + offset;
+   SummaryProbe probe{ len };
+   const size_t frames64K = (len + 65535) / 65536;
+   std::vector<float> summary256(frames64K * 256 * 3);
+   std::vector<float> summary64K(frames64K * 3);
+   probe.Summarize(src, len, summary256.data(), summary64K.data());
+
+   // The loop of BlockFile.cpp, over the whole frames
+   const size_t frames = len / 256;
+   std::vector<float> reference(frames * 3);
+   const auto summarize = [&] {
+      for (size_t f = 0; f < frames; ++f) {
+         const float *samples = src + f * 256;
+         float min = samples[0], max = samples[0];
+         float sumsq = samples[0] * samples[0];
+         for (int j = 1; j < 256; j++) {
+            const float f1 = samples[j];
+            sumsq += f1 * f1;
+            if (f1 < min)
+               min = f1;
+            else if (f1 > max)
+               max = f1;
+         }
+         reference[f * 3] = min;
+         reference[f * 3 + 1] = max;
+         reference[f * 3 + 2] = (float)sqrt(sumsq / 256);
+      }
+   };
+   summarize();
+
+   // Minimum and maximum exactly, the RMS within the bound
+   long long maxError = 0;
+   for (size_t f = 0; f < frames; ++f) {
+      if (summary256[f * 3] != reference[f * 3] ||
+          summary256[f * 3 + 1] != reference[f * 3 + 1])
+         maxError = std::numeric_limits<long long>::max();
+      else
+         maxError = std::max(maxError,
+            UlpDistance(summary256[f * 3 + 2], reference[f * 3 + 2]));
+   }
+
+   const double ns = NsPerSample(options, len, [&] {
+      probe.Summarize(src, len, summary256.data(), summary64K.data());
+   });
+   Report("CalcSummaryFromBuffer", len, offset, ns,
+          NsPerSample(options, len, summarize), maxError, kSummaryRmsUlps);
+}
+
+// The mixers narrow the envelope to float
+const long long kEnvelopeUlps = 1;
+
+void BenchEnvelope(const Options &options, size_t len, size_t offset)
+{
+   const double rate = 44100.0;
+   const double tstep = 1.0 / rate;
+   // Points off the grid of samples, every few hundred samples
+   Envelope envelope{ false, 0.0, 2.0, 1.0 };
+   const double duration = (len + offset) * tstep;
+   for (double t = 0.37 * tstep; t < duration; t += 311.7 * tstep)
+      envelope.InsertOrReplaceRelative(t, 0.5 + 0.5 * sin(t * 40.0));
+
+   const double t0 = offset * tstep;
+   std::vector<double> values(len), reference(len);
+   envelope.GetValues(values.data(), len, t0, tstep);
+   const auto evaluate = [&] {
+      for (size_t i = 0; i < len; ++i)
+         reference[i] = envelope.GetValue(t0 + i * tstep, tstep);
+   };
+   evaluate();
+
+   long long maxError = 0;
+   for (size_t i = 0; i < len; ++i)
+      maxError = std::max(maxError,
+         UlpDistance(float(values[i]), float(reference[i])));
+
+   const double ns = NsPerSample(options, len, [&] {
+      envelope.GetValues(values.data(), len, t0, tstep);
+   });
+   Report("Envelope::GetValues", len, offset, ns,
+          NsPerSample(options, len, evaluate), maxError, kEnvelopeUlps);
+}
+
+// "Accurate to a few units in the last place," as VectorMath.h says;
+// decibels near zero lose more of them to the multiplication
+const long long kVectorMathUlps = 4;
+const long long kDecibelUlps = 32;
+const long long kLevelsUlps = 64;
+
+void BenchVectorMath(const Options &options, size_t len, size_t offset)
+{
+   std::vector<float> input(len + offset), output(len), reference(len);
+   const float *in = input.data() + offset;
+
+   const struct {
+      const char *name;
+      void (*kernel)(const float *, float *, size_t);
+      float (*function)(float);
+      float lo, hi;
+      long long bound;
+   } functions[] = {
+      { "VectorLog", VectorLog,
+         [](float x) { return logf(x); }, 1e-6f, 100.0f, kVectorMathUlps },
+      { "VectorExp", VectorExp,
+         [](float x) { return expf(x); }, -20.0f, 20.0f, kVectorMathUlps },
+      { "VectorLinearToDB", VectorLinearToDB,
+         [](float x) { return float(20.0 * log10(fabs(x))); },
+         1e-6f, 0.5f, kDecibelUlps },
+      { "VectorDBToLinear", VectorDBToLinear,
+         [](float x) { return float(pow(10.0, x / 20.0)); },
+         -120.0f, 12.0f, kDecibelUlps },
+   };
+   for (const auto &each : functions) {
+      for (size_t i = 0; i < input.size(); ++i)
+         input[i] = each.lo + (each.hi - each.lo) * (i + 0.5f) / input.size();
+      each.kernel(in, output.data(), len);
+      const auto evaluate = [&] {
+         for (size_t i = 0; i < len; ++i)
+            reference[i] = each.function(in[i]);
+      };
+      evaluate();
+      const auto maxError = MaxUlps(output.data(), reference.data(), len);
+      const double ns = NsPerSample(options, len,
+         [&] { each.kernel(in, output.data(), len); });
+      Report(each.name, len, offset, ns,
+             NsPerSample(options, len, evaluate), maxError, each.bound);
+   }
+
+   // Levels of stereo frames
+   const auto signal = MakeSignal(len + offset);
+   const float *src = signal.data() + offset;
+   const size_t frames = len / 2;
+   float peak[2], sumSquares[2], referencePeak[2], referenceSquares[2];
+   VectorLevels(src, frames, 2, 2, peak, sumSquares);
+   const auto levels = [&] {
+      for (unsigned c = 0; c < 2; ++c) {
+         referencePeak[c] = referenceSquares[c] = 0.0f;
+         for (size_t f = 0; f < frames; ++f) {
+            const float sample = src[f * 2 + c];
+            referencePeak[c] = std::max(referencePeak[c], fabsf(sample));
+            referenceSquares[c] += sample * sample;
+         }
+      }
+   };
+   levels();
+   long long maxError = 0;
+   for (unsigned c = 0; c < 2; ++c)
+      maxError = peak[c] != referencePeak[c]
+         ? std::numeric_limits<long long>::max()
+         : std::max(maxError, UlpDistance(sumSquares[c], referenceSquares[c]));
+   const double ns = NsPerSample(options, len,
+      [&] { VectorLevels(src, frames, 2, 2, peak, sumSquares); });
+   Report("VectorLevels/2", len, offset, ns,
+          NsPerSample(options, len, levels), maxError, kLevelsUlps);
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+   wxInitializer initializer;
+
+   Options options;
+   for (int i = 1; i + 1 < argc; i += 2) {
+      if (!strcmp(argv[i], "-n"))
+         options.lengths.push_back(
+            std::max(1ul, strtoul(argv[i + 1], nullptr, 10)));
+      else if (!strcmp(argv[i], "-o"))
+         options.offsets.push_back(strtoul(argv[i + 1], nullptr, 10));
+      else if (!strcmp(argv[i], "-s"))
+         options.samplesTimed = std::max(1.0, atof(argv[i + 1]));
+      else {
+         std::cerr << "Usage: " << argv[0]
+                   << " [-n len]... [-o offset]... [-s samplesTimed]\n";
+         return 1;
+      }
+   }
+   // A device buffer, a mixer's buffer, and a block
+   if (options.lengths.empty())
+      options.lengths = { 256, 4096, 262144 };
+   // In floats from an aligned address
+   if (options.offsets.empty())
+      options.offsets = { 0, 1, 3 };
+   srand(1);
+
+   for (auto len : options.lengths)
+      for (auto offset : options.offsets) {
+         for (unsigned numChannels : { 1u, 2u, 6u, 8u })
+            BenchMix(options, numChannels, true, len, offset);
+         BenchMix(options, 2, false, len, offset);
+         BenchConvert(options, len, offset);
+         BenchSummary(options, len, offset);
+         BenchEnvelope(options, len, offset);
+         BenchVectorMath(options, len, offset);
+      }
+
+   return gAllAgree ? 0 : 1;
+}
@@ -0,0 +1,282 @@
+/* Measures how many tracks playback can sustain, with no audio device.
+ *
+ * A synthetic project of N mono tracks, each cut into a number of clips,
+ * is played as AudioIO plays it: a Mixer per track fills a RingBuffer per
+ * track, as AudioIO::FillBuffers() does, and a fake device callback sums
+ * the ring buffers, a buffer of frames at a time.
+ *
+ * Two runs are made for each track count:
+ *
+ *  - "throughput" mixes and drains as fast as it can, and reports the
+ *    realtime factor (seconds of audio per second of wall time) and the
+ *    longest fill of one device buffer, against the buffer's duration;
+ *
+ *  - "realtime" runs the filling on a thread of its own, sleeping when the
+ *    buffers are full as the audio thread does, and the callback on
+ *    another at the pace of a real device, and reports underruns and the
+ *    latest callback.
+ *
+ * Each result is one line of JSON on standard output.
+ *
+ * Usage: MixerBench [-d directory] [-t tracks]... [-c clips] [-s seconds]
+ *                   [-b frames] [-r realtimeSeconds]
+ */
+
+#include "DirManager.h"
+#include "Mix.h"
+#include "RingBuffer.h"
+#include "Track.h"
+#include "WaveTrack.h"
+#include <wx/init.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const double kRate = 44100.0;
+
+double Seconds(Clock::duration duration)
+{
+   return std::chrono::duration<double>(duration).count();
+}
+
+struct Options
+{
+   std::vector<unsigned> trackCounts;
+   unsigned clips = 16;
+   double seconds = 30.0;
+   size_t framesPerBuffer = 512;
+   double realtimeSeconds = 10.0;
+};
+
+// Tracks of a tone with some noise, each cut into clips
+WaveTrackConstArray MakeProject(TrackFactory &factory,
+                                unsigned numTracks, const Options &options)
+{
+   const size_t chunk = 65536;
+   std::vector<float> signal(chunk);
+   for (size_t i = 0; i < chunk; ++i)
+      signal[i] = 0.1f * sinf(i * 0.02f) + 0.01f * (rand() / (float)RAND_MAX);
+
+   // All tracks but the first are duplicates, sharing its blocks, as
+   // they would after copying and pasting; reads still go through each
+   // track's clips and sequence
+   auto first = factory.NewWaveTrack(floatSample, kRate);
+   const size_t total = options.seconds * kRate;
+   for (size_t done = 0; done < total; done += chunk)
+      first->Append((samplePtr)signal.data(), floatSample,
+                    std::min(chunk, total - done));
+   first->Flush();
+   for (unsigned c = 1; c < options.clips; ++c)
+      first->SplitAt(c * options.seconds / options.clips);
+
+   WaveTrackConstArray tracks;
+   for (unsigned t = 1; t < numTracks; ++t)
+      tracks.push_back(
+         std::shared_ptr<const WaveTrack>{ factory.DuplicateWaveTrack(*first) });
+   tracks.push_back(std::shared_ptr<const WaveTrack>{ std::move(first) });
+   return tracks;
+}
+
+// The mixers and ring buffers of playback
+class Playback
+{
+public:
+   Playback(const WaveTrackConstArray &tracks, const Options &options)
+      : mFrames{ options.framesPerBuffer }
+      , mMixBuffer(mFrames)
+      , mTemp(mFrames)
+   {
+      // AudioIO sizes its buffers for several seconds, filling them in
+      // chunks of a fraction of a second
+      mChunk = std::max<size_t>(mFrames, kRate / 10);
+      for (const auto &track : tracks) {
+         mMixers.push_back(std::make_unique<Mixer>(
+            WaveTrackConstArray{ track }, true, 0.0, options.seconds,
+            1, mChunk, false, kRate, floatSample, false));
+         mBuffers.push_back(
+            std::make_unique<RingBuffer>(floatSample, kRate * 4));
+      }
+   }
+
+   // As AudioIO::FillBuffers(): mix each track into its ring buffer, as
+   // much as all have room for.  Returns whether any was mixed.
+   bool Fill()
+   {
+      size_t avail = mChunk;
+      for (const auto &buffer : mBuffers)
+         avail = std::min(avail, buffer->AvailForPut());
+      if (avail < mChunk / 2)
+         return false;
+
+      bool any = false;
+      for (size_t t = 0; t < mMixers.size(); ++t) {
+         const auto processed = mMixers[t]->Process(avail);
+         if (processed > 0)
+            any = true;
+         mBuffers[t]->Put(mMixers[t]->GetBuffer(), floatSample, processed);
+      }
+      return any;
+   }
+
+   // As the audio callback: sum a buffer from each track.  Returns false
+   // if some track had too little ready.
+   bool Callback()
+   {
+      bool underrun = false;
+      std::fill(mMixBuffer.begin(), mMixBuffer.end(), 0.0f);
+      for (const auto &buffer : mBuffers) {
+         const auto got =
+            buffer->Get((samplePtr)mTemp.data(), floatSample, mFrames);
+         if (got < mFrames)
+            underrun = true;
+         for (size_t i = 0; i < got; ++i)
+            mMixBuffer[i] += mTemp[i];
+      }
+      return !underrun;
+   }
+
+   size_t Chunk() const { return mChunk; }
+
+private:
+   size_t mFrames;
+   size_t mChunk;
+   std::vector<std::unique_ptr<Mixer>> mMixers;
+   std::vector<std::unique_ptr<RingBuffer>> mBuffers;
+   std::vector<float> mMixBuffer;
+   std::vector<float> mTemp;
+};
+
+void Throughput(const WaveTrackConstArray &tracks, const Options &options)
+{
+   Playback playback(tracks, options);
+   const double bufferSeconds = options.framesPerBuffer / kRate;
+
+   // The longest fill, per device buffer of frames
+   double worst = 0;
+   size_t mixed = 0;
+   auto start = Clock::now();
+   for (;;) {
+      auto fillStart = Clock::now();
+      if (!playback.Fill())
+         break;
+      worst = std::max(worst, Seconds(Clock::now() - fillStart) *
+         options.framesPerBuffer / playback.Chunk());
+      while (playback.Callback())
+         mixed += options.framesPerBuffer;
+   }
+   const double wall = Seconds(Clock::now() - start);
+
+   std::cout << "{\"bench\":\"throughput\""
+             << ",\"tracks\":" << tracks.size()
+             << ",\"clips\":" << options.clips
+             << ",\"framesPerBuffer\":" << options.framesPerBuffer
+             << ",\"audioSeconds\":" << mixed / kRate
+             << ",\"wallSeconds\":" << wall
+             << ",\"realtimeFactor\":" << (wall > 0 ? mixed / kRate / wall : 0)
+             << ",\"worstFillSeconds\":" << worst
+             << ",\"bufferSeconds\":" << bufferSeconds
+             << "}" << std::endl;
+}
+
+void Realtime(const WaveTrackConstArray &tracks, const Options &options)
+{
+   Playback playback(tracks, options);
+   const auto period = std::chrono::duration_cast<Clock::duration>(
+      std::chrono::duration<double>(options.framesPerBuffer / kRate));
+
+   // Prime the buffers, as AudioIO does before starting the stream
+   while (playback.Fill())
+      ;
+
+   std::atomic<bool> done{ false };
+   std::thread filler([&]{
+      while (!done) {
+         if (!playback.Fill())
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      }
+   });
+
+   // Stop short of the end of the tracks, where the buffers run dry
+   unsigned callbacks = 0, underruns = 0;
+   double latest = 0;
+   const unsigned count =
+      std::min(options.realtimeSeconds, options.seconds * 0.9) /
+      Seconds(period);
+   auto next = Clock::now();
+   for (; callbacks < count; ++callbacks) {
+      std::this_thread::sleep_until(next);
+      if (!playback.Callback())
+         ++underruns;
+      latest = std::max(latest, Seconds(Clock::now() - next));
+      next += period;
+   }
+   done = true;
+   filler.join();
+
+   std::cout << "{\"bench\":\"realtime\""
+             << ",\"tracks\":" << tracks.size()
+             << ",\"clips\":" << options.clips
+             << ",\"framesPerBuffer\":" << options.framesPerBuffer
+             << ",\"callbacks\":" << callbacks
+             << ",\"underruns\":" << underruns
+             << ",\"worstCallbackSeconds\":" << latest
+             << ",\"bufferSeconds\":" << Seconds(period)
+             << "}" << std::endl;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+   wxInitializer initializer;
+
+   wxString directory = wxT("/tmp/mixer-bench-dir");
+   Options options;
+
+   for (int i = 1; i + 1 < argc; i += 2) {
+      if (!strcmp(argv[i], "-d"))
+         directory = wxString::FromUTF8(argv[i + 1]);
+      else if (!strcmp(argv[i], "-t"))
+         options.trackCounts.push_back(strtoul(argv[i + 1], nullptr, 10));
+      else if (!strcmp(argv[i], "-c"))
+         options.clips = std::max(1ul, strtoul(argv[i + 1], nullptr, 10));
+      else if (!strcmp(argv[i], "-s"))
+         options.seconds = atof(argv[i + 1]);
+      else if (!strcmp(argv[i], "-b"))
+         options.framesPerBuffer = std::max(1ul, strtoul(argv[i + 1], nullptr, 10));
+      else if (!strcmp(argv[i], "-r"))
+         options.realtimeSeconds = atof(argv[i + 1]);
+      else {
+         std::cerr << "Usage: " << argv[0]
+                   << " [-d directory] [-t tracks]... [-c clips] [-s seconds]"
+                      " [-b frames] [-r realtimeSeconds]\n";
+         return 1;
+      }
+   }
+   if (options.trackCounts.empty())
+      options.trackCounts = { 1, 8, 32, 128 };
+
+   DirManager::SetTempDir(directory);
+   auto dirManager = std::make_shared<DirManager>();
+   TrackFactory factory{ dirManager, nullptr };
+   srand(1);
+
+   for (auto numTracks : options.trackCounts) {
+      auto tracks = MakeProject(factory, numTracks, options);
+      Throughput(tracks, options);
+      if (options.realtimeSeconds > 0)
+         Realtime(tracks, options);
+   }
+
+   return 0;
+}
@@ -0,0 +1,245 @@
+/* Times the hot paths of Sequence and SimpleBlockFile, for each sample
+ * format and a range of block sizes, writing the blocks under a
+ * directory of the caller's choosing, so that storage can be compared.
+ *
+ * Each result is one line of JSON on standard output:
+ *
+ *   {"bench":"Sequence::Append","format":"float","blockBytes":1048576,
+ *    "samples":10000000,"seconds":0.41,"samplesPerSecond":2.4e7}
+ *
+ * Usage: SequenceBench [-d directory] [-n samples] [-b blockBytes]...
+ */
+
+#include "Sequence.h"
+#include "DirManager.h"
+#include "BlockFile.h"
+#include "SampleFormat.h"
+#include <wx/init.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+double Seconds(std::chrono::steady_clock::time_point start)
+{
+   return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+const char *FormatName(sampleFormat format)
+{
+   switch (format) {
+      case int16Sample: return "int16";
+      case int24Sample: return "int24";
+      default: return "float";
+   }
+}
+
+void Report(const char *bench, sampleFormat format, size_t blockBytes,
+            double samples, double seconds)
+{
+   std::cout << "{\"bench\":\"" << bench << "\""
+             << ",\"format\":\"" << FormatName(format) << "\""
+             << ",\"blockBytes\":" << blockBytes
+             << ",\"samples\":" << samples
+             << ",\"seconds\":" << seconds
+             << ",\"samplesPerSecond\":"
+             << (seconds > 0 ? samples / seconds : 0)
+             << "}" << std::endl;
+}
+
+// A tone with some noise, so that summaries are not trivial
+std::vector<float> MakeSignal(size_t len)
+{
+   std::vector<float> signal(len);
+   for (size_t i = 0; i < len; ++i)
+      signal[i] = 0.5f * sinf(i * 0.01f) + 0.1f * (rand() / (float)RAND_MAX - 0.5f);
+   return signal;
+}
+
+class SequenceBench
+{
+public:
+   SequenceBench(sampleFormat format, size_t blockBytes, size_t numSamples)
+      : mFormat{ format }, mBlockBytes{ blockBytes }, mNumSamples{ numSamples }
+   {}
+
+   void Run()
+   {
+      Sequence::SetMaxDiskBlockSize(mBlockBytes);
+      auto dirManager = std::make_shared<DirManager>();
+      Sequence sequence(dirManager, mFormat);
+
+      BenchAppend(sequence);
+      BenchGet(sequence);
+      BenchWaveDisplay(sequence);
+      BenchPaste(sequence);
+      BenchDelete(sequence);
+      BenchBlockFiles(*dirManager);
+   }
+
+private:
+   void BenchAppend(Sequence &sequence)
+   {
+      const auto chunk = sequence.GetIdealAppendLen();
+      const auto signal = MakeSignal(chunk);
+
+      auto start = std::chrono::steady_clock::now();
+      for (size_t done = 0; done < mNumSamples; done += chunk)
+         sequence.Append((samplePtr)signal.data(), floatSample,
+                         std::min(chunk, mNumSamples - done));
+      Report("Sequence::Append", mFormat, mBlockBytes,
+             mNumSamples, Seconds(start));
+   }
+
+   void BenchGet(const Sequence &sequence)
+   {
+      const size_t chunk = 65536;
+      std::vector<float> buffer(chunk);
+      const auto total = sequence.GetNumSamples();
+
+      auto start = std::chrono::steady_clock::now();
+      for (sampleCount pos = 0; pos < total; pos += chunk)
+         sequence.Get((samplePtr)buffer.data(), floatSample, pos,
+                      limitSampleBufferSize(chunk, total - pos), true);
+      Report("Sequence::Get", mFormat, mBlockBytes,
+             total.as_double(), Seconds(start));
+   }
+
+   void BenchWaveDisplay(const Sequence &sequence)
+   {
+      const size_t columns = 1000;
+      std::vector<float> min(columns), max(columns), rms(columns);
+      std::vector<int> bl(columns);
+      std::vector<sampleCount> where(columns + 1);
+      const auto total = sequence.GetNumSamples().as_double();
+
+      // The whole sequence in view, which reads summaries, and then
+      // 100 samples to a column, which reads samples
+      for (double perColumn : { total / columns, 100.0 }) {
+         for (size_t i = 0; i <= columns; ++i)
+            where[i] = sampleCount(i * perColumn);
+
+         const int repeats = 20;
+         auto start = std::chrono::steady_clock::now();
+         for (int i = 0; i < repeats; ++i)
+            sequence.GetWaveDisplay(min.data(), max.data(), rms.data(),
+                                    bl.data(), columns, where.data());
+         Report(perColumn > 256
+                   ? "Sequence::GetWaveDisplay(summary)"
+                   : "Sequence::GetWaveDisplay(samples)",
+                mFormat, mBlockBytes,
+                repeats * perColumn * columns, Seconds(start));
+      }
+   }
+
+   void BenchPaste(Sequence &sequence)
+   {
+      const auto total = sequence.GetNumSamples();
+      const sampleCount len = std::min<sampleCount>(total / 10, 441000);
+      auto src = sequence.Copy(total / 2, total / 2 + len);
+
+      const int repeats = 10;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < repeats; ++i)
+         sequence.Paste(sampleCount(rand() % std::max(1, (int)total.as_long_long())),
+                        src.get());
+      Report("Sequence::Paste", mFormat, mBlockBytes,
+             repeats * len.as_double(), Seconds(start));
+   }
+
+   void BenchDelete(Sequence &sequence)
+   {
+      const auto total = sequence.GetNumSamples();
+      const sampleCount len = std::min<sampleCount>(total / 20, 441000);
+
+      const int repeats = 10;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < repeats; ++i) {
+         const auto room = sequence.GetNumSamples() - len;
+         sequence.Delete(
+            sampleCount(rand() % std::max(1, (int)room.as_long_long())), len);
+      }
+      Report("Sequence::Delete", mFormat, mBlockBytes,
+             repeats * len.as_double(), Seconds(start));
+   }
+
+   void BenchBlockFiles(DirManager &dirManager)
+   {
+      const size_t len = mBlockBytes / SAMPLE_SIZE(mFormat);
+      const auto signal = MakeSignal(len);
+      SampleBuffer samples(len, mFormat);
+      CopySamples((samplePtr)signal.data(), floatSample,
+                  samples.ptr(), mFormat, len);
+
+      // Writing computes the summary too
+      const int count = 50;
+      std::vector<BlockFilePtr> files;
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; ++i)
+         files.push_back(
+            dirManager.NewSimpleBlockFile(samples.ptr(), len, mFormat));
+      Report("SimpleBlockFile::Write", mFormat, mBlockBytes,
+             (double)count * len, Seconds(start));
+
+      std::vector<float> buffer(len);
+      start = std::chrono::steady_clock::now();
+      for (const auto &file : files)
+         file->ReadData((samplePtr)buffer.data(), floatSample, 0, len, true);
+      Report("SimpleBlockFile::ReadData", mFormat, mBlockBytes,
+             (double)count * len, Seconds(start));
+
+      const size_t frames256 = (len + 255) / 256;
+      std::vector<float> summary(frames256 * 3);
+      start = std::chrono::steady_clock::now();
+      for (const auto &file : files)
+         file->ReadSummaryLevel(256, summary.data(), 0, frames256);
+      Report("SimpleBlockFile::ReadSummary", mFormat, mBlockBytes,
+             (double)count * len, Seconds(start));
+   }
+
+   sampleFormat mFormat;
+   size_t mBlockBytes;
+   size_t mNumSamples;
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+   wxInitializer initializer;
+
+   wxString directory = wxT("/tmp/sequence-bench-dir");
+   size_t numSamples = 10000000;
+   std::vector<size_t> blockSizes;
+
+   for (int i = 1; i + 1 < argc; i += 2) {
+      if (!strcmp(argv[i], "-d"))
+         directory = wxString::FromUTF8(argv[i + 1]);
+      else if (!strcmp(argv[i], "-n"))
+         numSamples = strtoul(argv[i + 1], nullptr, 10);
+      else if (!strcmp(argv[i], "-b"))
+         blockSizes.push_back(strtoul(argv[i + 1], nullptr, 10));
+      else {
+         std::cerr << "Usage: " << argv[0]
+                   << " [-d directory] [-n samples] [-b blockBytes]...\n";
+         return 1;
+      }
+   }
+   if (blockSizes.empty())
+      blockSizes = { 64 * 1024, 256 * 1024, 1024 * 1024 };
+
+   DirManager::SetTempDir(directory);
+   srand(1);
+
+   for (auto format : { int16Sample, int24Sample, floatSample })
+      for (auto blockBytes : blockSizes)
+         SequenceBench(format, blockBytes, numSamples).Run();
+
+   return 0;
+}
@@ -0,0 +1,509 @@
+/* Runs editing, undo, playback and on-demand loading at once, to shake out
+ * races between them.
+ *
+ * A synthetic project is made of tracks that alias one WAV file, as an
+ * import does without copying, and an ODComputeSummaryTask for them is
+ * given to the ODManager, whose threads then write the summaries while
+ * the rest runs:
+ *
+ *  - the main thread edits the tracks at random, as the user does: cut
+ *    and paste, clear, insert silence, copy and paste, and undo, to copies
+ *    of the tracks taken before each edit as UndoManager keeps them, with
+ *    reads of the summaries as drawing does, and demands of the ODManager
+ *    as scrolling does; after each, it checks the sequences of the track
+ *    with Sequence::ConsistencyCheck();
+ *
+ *  - player threads mix copies of the project, as AudioIO does, taking a
+ *    new copy from the main thread from time to time, as when playback
+ *    starts again after editing.
+ *
+ * The copies share the block files of the tracks, some still waiting for
+ * their summaries, as in the application.
+ *
+ * The result is one line of JSON on standard output, with the rates of
+ * edits and of playback, the reading of the on-demand threads, and the
+ * counts of failures: inconsistent sequences and other exceptions, whose
+ * messages go to standard error.  The exit status is 1 if there were any.
+ *
+ * Usage: StressTest [-d directory] [-t tracks] [-s seconds] [-r runSeconds]
+ *                   [-p players] [-x seed]
+ */
+
+#include "Audacity.h"
+#include "AudacityException.h"
+#include "DirManager.h"
+#include "InconsistencyException.h"
+#include "Mix.h"
+#include "Prefs.h"
+#include "Sequence.h"
+#include "Track.h"
+#include "WaveClip.h"
+#include "WaveTrack.h"
+#include "blockfile/BlockIOStats.h"
+#include "ondemand/ODComputeSummaryTask.h"
+#include "ondemand/ODManager.h"
+#include <wx/app.h>
+#include <wx/ffile.h>
+#include <wx/filename.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+const double kRate = 44100.0;
+
+// Undo states kept for each track, as a bound on memory
+const size_t kMaxUndoStates = 8;
+
+class StressTestApp final : public wxAppConsole
+{
+public:
+   bool OnInit() override { return true; }
+};
+
+struct Options
+{
+   wxString directory = wxT("/tmp/stress-test-dir");
+   unsigned tracks = 8;
+   double seconds = 120.0;
+   double runSeconds = 30.0;
+   unsigned players = 2;
+   unsigned seed = 1;
+};
+
+double Seconds(Clock::duration duration)
+{
+   return std::chrono::duration<double>(duration).count();
+}
+
+// A mono 16-bit WAV of a tone with some noise, for the tracks to alias
+bool WriteWav(const wxString &path, const Options &options)
+{
+   wxFFile file(path, wxT("wb"));
+   if (!file.IsOpened())
+      return false;
+
+   const wxUint32 frames = options.seconds * kRate;
+   const wxUint32 dataBytes = frames * 2;
+   const auto u32 = [&](wxUint32 value) {
+      const unsigned char bytes[4] = {
+         (unsigned char)value, (unsigned char)(value >> 8),
+         (unsigned char)(value >> 16), (unsigned char)(value >> 24) };
+      file.Write(bytes, 4);
+   };
+   const auto u16 = [&](wxUint16 value) {
+      const unsigned char bytes[2] = {
+         (unsigned char)value, (unsigned char)(value >> 8) };
+      file.Write(bytes, 2);
+   };
+   file.Write("RIFF", 4); u32(36 + dataBytes); file.Write("WAVE", 4);
+   file.Write("fmt ", 4); u32(16); u16(1); u16(1);
+   u32(kRate); u32(kRate * 2); u16(2); u16(16);
+   file.Write("data", 4); u32(dataBytes);
+
+   std::vector<unsigned char> chunk;
+   for (wxUint32 done = 0; done < frames;) {
+      const auto len = std::min<wxUint32>(65536, frames - done);
+      chunk.resize(len * 2);
+      for (wxUint32 i = 0; i < len; ++i) {
+         const auto sample = (short)(8000 * sin((done + i) * 0.03) +
+            400 * (rand() / (double)RAND_MAX - 0.5));
+         chunk[2 * i] = (unsigned char)sample;
+         chunk[2 * i + 1] = (unsigned char)(sample >> 8);
+      }
+      file.Write(chunk.data(), chunk.size());
+      done += len;
+   }
+   return file.Close();
+}
+
+using TrackPtr = std::shared_ptr<WaveTrack>;
+
+// Tracks that alias the file, block by block, summaries left to be
+// computed on demand, as PCMImportFileHandle::Import() makes them
+std::vector<TrackPtr> MakeProject(TrackFactory &factory, const wxString &path,
+                                  const Options &options)
+{
+   const sampleCount frames = (sampleCount)(options.seconds * kRate);
+   std::vector<TrackPtr> tracks;
+   auto task = make_movable<ODComputeSummaryTask>();
+   for (unsigned t = 0; t < options.tracks; ++t) {
+      TrackPtr track{ factory.NewWaveTrack(int16Sample, kRate) };
+      const auto maxBlockSize = track->GetMaxBlockSize();
+      for (sampleCount i = 0; i < frames; i += maxBlockSize)
+         track->AppendAlias(path, i,
+            limitSampleBufferSize(maxBlockSize, frames - i), 0, true);
+      track->Flush();
+      task->AddWaveTrack(track.get());
+      tracks.push_back(std::move(track));
+   }
+   ODManager::Instance()->AddNewTask(std::move(task));
+   return tracks;
+}
+
+// As EnqueueODTasks() for a project opened with blocks still to summarize
+void EnqueueSummaries(WaveTrack &track)
+{
+   if (!(track.GetODFlags() & ODTask::eODPCMSummary))
+      return;
+   auto task = make_movable<ODComputeSummaryTask>();
+   task->AddWaveTrack(&track);
+   ODManager::Instance()->AddNewTask(std::move(task));
+}
+
+using Snapshot = std::shared_ptr<const WaveTrackConstArray>;
+
+// Copies of the project that the player threads mix, as AudioIO does
+class Players
+{
+public:
+   Players(const Options &options) : mOptions{ options } {}
+
+   ~Players()
+   {
+      mDone = true;
+      for (auto &thread : mThreads)
+         thread.join();
+   }
+
+   void Start(Snapshot snapshot)
+   {
+      Give(std::move(snapshot));
+      for (unsigned p = 0; p < mOptions.players; ++p)
+         mThreads.emplace_back([this]{ Play(); });
+   }
+
+   // A new copy of the project, that each player takes when it next
+   // starts over
+   void Give(Snapshot snapshot)
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      mSnapshot = std::move(snapshot);
+   }
+
+   double MixedSeconds() const
+   {
+      return mMixedFrames.load() / kRate;
+   }
+
+   unsigned long Failures() const { return mFailures.load(); }
+
+private:
+   Snapshot Take()
+   {
+      std::lock_guard<std::mutex> lock{ mMutex };
+      return mSnapshot;
+   }
+
+   void Play()
+   {
+      const size_t chunk = 4096;
+      while (!mDone) {
+         auto snapshot = Take();
+         double end = 0;
+         for (const auto &track : *snapshot)
+            end = std::max(end, track->GetEndTime());
+         try {
+            Mixer mixer{ *snapshot, true, 0.0, end, 2, chunk, false,
+                         kRate, floatSample, false };
+            // Start over, with the latest copy, every few seconds of audio
+            for (int pass = 0; !mDone && pass < 64; ++pass) {
+               const auto processed = mixer.Process(chunk);
+               if (processed == 0)
+                  break;
+               mMixedFrames += processed;
+            }
+         }
+         catch (const AudacityException &) {
+            std::cerr << "Exception in playback\n";
+            ++mFailures;
+         }
+      }
+   }
+
+   const Options &mOptions;
+   std::mutex mMutex;
+   Snapshot mSnapshot;
+   std::vector<std::thread> mThreads;
+   std::atomic<bool> mDone{ false };
+   std::atomic<unsigned long long> mMixedFrames{ 0 };
+   std::atomic<unsigned long> mFailures{ 0 };
+};
+
+class Editor
+{
+public:
+   Editor(TrackFactory &factory, std::vector<TrackPtr> &tracks,
+          const Options &options)
+      : mFactory{ factory }
+      , mTracks{ tracks }
+      , mOptions{ options }
+      , mEngine{ options.seed }
+      , mUndo(tracks.size())
+   {}
+
+   // One edit of a track chosen at random, and a check of its sequences.
+   // Returns false if anything failed.
+   bool Step()
+   {
+      std::uniform_int_distribution<size_t> pickTrack{ 0, mTracks.size() - 1 };
+      const auto t = pickTrack(mEngine);
+      auto &track = mTracks[t];
+      const char *what = "";
+      try {
+         const double end = track->GetEndTime();
+         const double t0 = Uniform(0, end);
+         const double t1 = std::min(end, t0 + Uniform(0.01, 5.0));
+
+         switch (std::uniform_int_distribution<int>{ 0, 6 }(mEngine)) {
+         case 0:
+            what = "cut and paste";
+            PushState(t);
+            {
+               auto clip = track->Cut(t0, t1);
+               track->Paste(Uniform(0, track->GetEndTime()), clip.get());
+            }
+            break;
+         case 1:
+            what = "clear";
+            PushState(t);
+            track->Clear(t0, t1);
+            break;
+         case 2:
+            what = "insert silence";
+            PushState(t);
+            track->InsertSilence(t0, Uniform(0.01, 1.0));
+            break;
+         case 3:
+            what = "copy and paste";
+            PushState(t);
+            {
+               auto clip = track->Copy(t0, t1);
+               track->Paste(Uniform(0, end), clip.get());
+            }
+            break;
+         case 4:
+            what = "undo";
+            Undo(t);
+            break;
+         case 5:
+            what = "draw";
+            track->GetMinMax(t0, t1, false);
+            track->GetRMS(t0, t1, false);
+            break;
+         case 6:
+            what = "scroll";
+            ODManager::Instance()->DemandTrackUpdate(track.get(), t0);
+            break;
+         }
+
+         // Keep the track from growing without bound
+         if (track->GetEndTime() > 2 * mOptions.seconds) {
+            what = "trim";
+            track->Clear(mOptions.seconds, track->GetEndTime());
+         }
+
+         what = "consistency check";
+         for (const auto &clip : track->GetClips())
+            clip->GetSequence()->ConsistencyCheck(wxT("StressTest"));
+      }
+      catch (const InconsistencyException &e) {
+         std::cerr << "Inconsistent after " << what << " of track " << t
+                   << ", at line " << e.GetLine() << "\n";
+         ++mInconsistencies;
+         return false;
+      }
+      catch (const AudacityException &) {
+         std::cerr << "Exception in " << what << " of track " << t << "\n";
+         ++mExceptions;
+         return false;
+      }
+      ++mEdits;
+      return true;
+   }
+
+   Snapshot Copy() const
+   {
+      auto copy = std::make_shared<WaveTrackConstArray>();
+      for (const auto &track : mTracks)
+         copy->push_back(std::shared_ptr<const WaveTrack>{
+            mFactory.DuplicateWaveTrack(*track) });
+      return copy;
+   }
+
+   unsigned long Edits() const { return mEdits; }
+   unsigned long Undos() const { return mUndos; }
+   unsigned long Inconsistencies() const { return mInconsistencies; }
+   unsigned long Exceptions() const { return mExceptions; }
+
+private:
+   double Uniform(double low, double high)
+   {
+      return high > low
+         ? std::uniform_real_distribution<double>{ low, high }(mEngine)
+         : low;
+   }
+
+   // As UndoManager::PushState() keeps a copy of the tracks
+   void PushState(size_t t)
+   {
+      auto &states = mUndo[t];
+      states.push_back(TrackPtr{ mFactory.DuplicateWaveTrack(*mTracks[t]) });
+      if (states.size() > kMaxUndoStates)
+         states.pop_front();
+   }
+
+   // As the project takes a copy of the tracks of the state undone to,
+   // and the ODManager forgets the track that it replaces
+   void Undo(size_t t)
+   {
+      auto &states = mUndo[t];
+      if (states.empty())
+         return;
+      TrackPtr restored{ mFactory.DuplicateWaveTrack(*states.back()) };
+      states.pop_back();
+      mTracks[t] = std::move(restored);
+      EnqueueSummaries(*mTracks[t]);
+      ++mUndos;
+   }
+
+   TrackFactory &mFactory;
+   std::vector<TrackPtr> &mTracks;
+   const Options &mOptions;
+   std::mt19937 mEngine;
+   std::vector<std::deque<TrackPtr>> mUndo;
+   unsigned long mEdits{ 0 };
+   unsigned long mUndos{ 0 };
+   unsigned long mInconsistencies{ 0 };
+   unsigned long mExceptions{ 0 };
+};
+
+// Edits, with players running, for the given time; writes the result and
+// returns the count of failures
+unsigned long Run(TrackFactory &factory, std::vector<TrackPtr> &tracks,
+                  const Options &options)
+{
+   const auto &stats = BlockIOStats::Program();
+   const auto odBytesBefore =
+      stats.Get(BlockIOStats::OnDemand, BlockIOStats::BytesRead);
+
+   Editor editor{ factory, tracks, options };
+   double mixedSeconds = 0;
+   unsigned long playbackFailures = 0;
+
+   const auto start = Clock::now();
+   {
+      Players players{ options };
+      if (options.players > 0)
+         players.Start(editor.Copy());
+
+      int step = 0;
+      while (Seconds(Clock::now() - start) < options.runSeconds) {
+         editor.Step();
+         // Play again what the user has done so far
+         if (++step % 50 == 0)
+            players.Give(editor.Copy());
+      }
+      mixedSeconds = players.MixedSeconds();
+      playbackFailures = players.Failures();
+   }
+   const double wall = Seconds(Clock::now() - start);
+
+   const auto odBytes =
+      stats.Get(BlockIOStats::OnDemand, BlockIOStats::BytesRead) -
+      odBytesBefore;
+
+   std::cout << "{\"bench\":\"stress\""
+             << ",\"tracks\":" << options.tracks
+             << ",\"players\":" << options.players
+             << ",\"wallSeconds\":" << wall
+             << ",\"edits\":" << editor.Edits()
+             << ",\"undos\":" << editor.Undos()
+             << ",\"editsPerSecond\":" << (wall > 0 ? editor.Edits() / wall : 0)
+             << ",\"playbackRealtimeFactor\":"
+             << (wall > 0 ? mixedSeconds / wall : 0)
+             << ",\"onDemandBytesRead\":" << odBytes
+             << ",\"onDemandPercentComplete\":"
+             << 100.0 * ODManager::Instance()->GetOverallPercentComplete()
+             << ",\"inconsistencies\":" << editor.Inconsistencies()
+             << ",\"exceptions\":" << editor.Exceptions()
+             << ",\"playbackFailures\":" << playbackFailures
+             << "}" << std::endl;
+
+   return editor.Inconsistencies() + editor.Exceptions() + playbackFailures;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+   wxApp::SetInstance(safenew StressTestApp);
+   if (!wxEntryStart(argc, argv) || !wxAppConsole::GetInstance()->CallOnInit()) {
+      std::cerr << "Could not start\n";
+      return 1;
+   }
+
+   Options options;
+   for (int i = 1; i + 1 < argc; i += 2) {
+      if (!strcmp(argv[i], "-d"))
+         options.directory = wxString::FromUTF8(argv[i + 1]);
+      else if (!strcmp(argv[i], "-t"))
+         options.tracks = std::max(1ul, strtoul(argv[i + 1], nullptr, 10));
+      else if (!strcmp(argv[i], "-s"))
+         options.seconds = std::max(1.0, atof(argv[i + 1]));
+      else if (!strcmp(argv[i], "-r"))
+         options.runSeconds = atof(argv[i + 1]);
+      else if (!strcmp(argv[i], "-p"))
+         options.players = strtoul(argv[i + 1], nullptr, 10);
+      else if (!strcmp(argv[i], "-x"))
+         options.seed = strtoul(argv[i + 1], nullptr, 10);
+      else {
+         std::cerr << "Usage: " << argv[0]
+                   << " [-d directory] [-t tracks] [-s seconds]"
+                      " [-r runSeconds] [-p players] [-x seed]\n";
+         return 1;
+      }
+   }
+   wxFileName::Mkdir(options.directory, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL);
+
+   // Editing and mixing read preferences; the file of them is left as it was
+   InitPreferences();
+   gPrefs->DisableAutoSave();
+
+   const auto wavPath = options.directory + wxFILE_SEP_PATH + wxT("stress.wav");
+   srand(options.seed);
+   if (!WriteWav(wavPath, options)) {
+      std::cerr << "Could not write " << wavPath.ToStdString() << "\n";
+      return 1;
+   }
+
+   unsigned long failures = 0;
+   DirManager::SetTempDir(options.directory);
+   {
+      auto dirManager = std::make_shared<DirManager>();
+      TrackFactory factory{ dirManager, nullptr };
+
+      auto tracks = MakeProject(factory, wavPath, options);
+      failures = Run(factory, tracks, options);
+
+      // The tracks go first, so that the ODManager forgets them
+      tracks.clear();
+      ODManager::Quit();
+   }
+
+   FinishPreferences();
+   wxEntryCleanup();
+   return failures > 0 ? 1 : 0;
+}